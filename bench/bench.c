@@ -0,0 +1,499 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "timebase.h"
+
+#include "bench.h"
+
+#if BENCH_BUS_PERF
+#include "hardware/structs/bus_ctrl.h"
+#endif
+
+// stdio is checked this often, a USB CDC read is too slow for every poll
+#define BENCH_KEY_POLL_US 10000
+
+// latency histogram of the scenario for the percentiles of its result, 4 buckets per
+// power of two, within 25 % of the latency, up to 2^32 us
+#define BENCH_HIST_BUCKETS 124
+
+// classes of bench_cpu_split_source()
+#define BENCH_CPU_CLASSES 8
+
+#if BENCH_BUS_PERF
+// the 4 bus fabric counters take turns on the SRAM banks, the access and contested events
+// of two banks per BENCH_BUS_SAMPLE_MS. They saturate at 24 bits, 134 ms of one access per
+// cycle at 125 MHz, so they are read and cleared well before
+#define BENCH_BUS_BANKS 6
+#define BENCH_BUS_PHASES (BENCH_BUS_BANKS / 2)
+
+struct bench_bus_bank {
+    uint64_t accesses;
+    uint64_t contested;
+    uint64_t us; // time the bank was counted
+};
+
+static const uint8_t bench_bus_events[BENCH_BUS_BANKS][2] = {
+    { arbiter_sram0_perf_event_access, arbiter_sram0_perf_event_access_contested },
+    { arbiter_sram1_perf_event_access, arbiter_sram1_perf_event_access_contested },
+    { arbiter_sram2_perf_event_access, arbiter_sram2_perf_event_access_contested },
+    { arbiter_sram3_perf_event_access, arbiter_sram3_perf_event_access_contested },
+    { arbiter_sram4_perf_event_access, arbiter_sram4_perf_event_access_contested },
+    { arbiter_sram5_perf_event_access, arbiter_sram5_perf_event_access_contested },
+};
+#endif
+
+const struct bench_scenario bench_scenarios[BENCH_SCENARIOS] = {
+    [BENCH_ECHO_64]   = { "echo_64",   '1', BENCH_KIND_ECHO,     5001, 64 },
+    [BENCH_ECHO_512]  = { "echo_512",  '2', BENCH_KIND_ECHO,     5002, 512 },
+    [BENCH_ECHO_1460] = { "echo_1460", '3', BENCH_KIND_ECHO,     5003, 1460 },
+    [BENCH_SINK]      = { "sink",      '4', BENCH_KIND_SINK,     5009, 0 },
+    [BENCH_SOURCE]    = { "source",    '5', BENCH_KIND_SOURCE,   5019, 1460 },
+    [BENCH_UDP]       = { "udp",       '6', BENCH_KIND_UDP_ECHO, 5007, 0 },
+    [BENCH_CONNECT]   = { "connect",   '7', BENCH_KIND_CONNECT,  5010, 0 },
+};
+
+struct bench_latency {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+};
+
+struct bench_counters {
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t ops;
+    uint32_t errors;
+    struct bench_latency latency;
+    struct bench_latency priority; // frames of the stack's priority path, apart from the scenario
+#if BENCH_BUS_PERF
+    struct bench_bus_bank bus[BENCH_BUS_BANKS];
+#endif
+};
+
+static const char *bench_stack_name;
+static const struct bench_scenario *bench_current;
+static struct bench_counters bench_period;  // since the last report
+static struct bench_counters bench_total;   // since the scenario started
+static uint32_t bench_connections;
+static uint64_t bench_period_start_us;
+static uint64_t bench_total_start_us;
+static uint64_t bench_key_poll_us;
+// us since boot of the first link up and the first operation, 0 until then
+static uint64_t bench_boot_link_us;
+static uint64_t bench_boot_op_us;
+static bool bench_boot_printed;
+static uint32_t bench_hist[BENCH_HIST_BUCKETS];
+static uint64_t (*bench_cpu_idle_us)(void);
+static uint64_t bench_cpu_idle_start_us;
+static uint bench_cpu_split_count;
+static const char *const *bench_cpu_split_names;
+static void (*bench_cpu_split_us)(uint64_t *us);
+static uint64_t bench_cpu_split_start_us[BENCH_CPU_CLASSES];
+#if BENCH_BUS_PERF
+static uint bench_bus_phase;
+static uint64_t bench_bus_phase_start_us;
+#endif
+
+static void bench_latency_add(struct bench_latency *to, const struct bench_latency *from) {
+    if (from->count != 0) {
+        if (to->count == 0 || from->min < to->min) {
+            to->min = from->min;
+        }
+
+        if (from->max > to->max) {
+            to->max = from->max;
+        }
+    }
+
+    to->count += from->count;
+    to->sum += from->sum;
+}
+
+static uint32_t bench_latency_count(struct bench_latency *l, uint32_t start_us) {
+    uint32_t latency = time_us_32() - start_us;
+
+    if (l->count == 0 || latency < l->min) {
+        l->min = latency;
+    }
+
+    if (latency > l->max) {
+        l->max = latency;
+    }
+
+    l->count++;
+    l->sum += latency;
+
+    return latency;
+}
+
+static uint bench_hist_bucket(uint32_t us) {
+    if (us < 4) {
+        return us;
+    }
+
+    uint log = 31 - __builtin_clz(us);
+
+    return (log - 1) * 4 + ((us >> (log - 2)) & 3);
+}
+
+// the largest latency of a bucket
+static uint32_t bench_hist_bound(uint bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+
+    uint shift = bucket / 4 - 1;
+
+    return ((4u + bucket % 4) << shift) + ((1u << shift) - 1);
+}
+
+// the latency `permille` of the messages took at most, rounded up to its bucket or down
+// to the largest seen
+static uint32_t bench_hist_percentile(const struct bench_latency *l, uint permille) {
+    uint32_t count = l->count;
+    uint32_t rank = (uint32_t)(((uint64_t)count * permille + 999) / 1000);
+    uint32_t seen = 0;
+
+    for (uint i = 0; i < BENCH_HIST_BUCKETS; i++) {
+        seen += bench_hist[i];
+
+        if (seen >= rank && seen != 0) {
+            return (bench_hist_bound(i) < l->max) ? bench_hist_bound(i) : l->max;
+        }
+    }
+
+    return 0;
+}
+
+static void bench_counters_add(struct bench_counters *to, const struct bench_counters *from) {
+    to->rx_bytes += from->rx_bytes;
+    to->tx_bytes += from->tx_bytes;
+    to->ops += from->ops;
+    to->errors += from->errors;
+    bench_latency_add(&to->latency, &from->latency);
+    bench_latency_add(&to->priority, &from->priority);
+
+#if BENCH_BUS_PERF
+    for (int i = 0; i < BENCH_BUS_BANKS; i++) {
+        to->bus[i].accesses += from->bus[i].accesses;
+        to->bus[i].contested += from->bus[i].contested;
+        to->bus[i].us += from->bus[i].us;
+    }
+#endif
+}
+
+#if BENCH_BUS_PERF
+static void bench_bus_select(uint phase, uint64_t now) {
+    for (int i = 0; i < 4; i++) {
+        bus_ctrl_hw->counter[i].sel = bench_bus_events[phase * 2 + i / 2][i % 2];
+        bus_ctrl_hw->counter[i].value = 0; // any write clears
+    }
+
+    bench_bus_phase = phase;
+    bench_bus_phase_start_us = now;
+}
+
+// adds the counts of the current pair of banks to the period and moves on to the next pair
+static void bench_bus_sample(uint64_t now) {
+    for (int i = 0; i < 4; i++) {
+        struct bench_bus_bank *bank = &bench_period.bus[bench_bus_phase * 2 + i / 2];
+        uint32_t count = bus_ctrl_hw->counter[i].value;
+
+        if (i % 2) {
+            bank->contested += count;
+        } else {
+            bank->accesses += count;
+            bank->us += now - bench_bus_phase_start_us;
+        }
+    }
+
+    bench_bus_select((bench_bus_phase + 1) % BENCH_BUS_PHASES, now);
+}
+
+// accesses per second of each bank while it was counted, and the share that had to wait
+// for another master
+static void bench_bus_print(const char *what, const struct bench_counters *c) {
+    printf("bench %s %s %s bus:", bench_stack_name, bench_current->name, what);
+
+    for (int i = 0; i < BENCH_BUS_BANKS; i++) {
+        const struct bench_bus_bank *bank = &c->bus[i];
+
+        printf("%s sram%d %lu k/s %lu.%lu%%", i ? "," : "", i,
+            (unsigned long)(bank->us ? bank->accesses * 1000 / bank->us : 0),
+            (unsigned long)(bank->accesses ? bank->contested * 100 / bank->accesses : 0),
+            (unsigned long)(bank->accesses ? bank->contested * 1000 / bank->accesses % 10 : 0));
+    }
+
+    printf("\n");
+}
+#endif
+
+// one line, the same on both firmwares so their logs compare directly
+static void bench_print(const char *what, const struct bench_counters *c, uint64_t elapsed_us) {
+    if (elapsed_us == 0) {
+        elapsed_us = 1;
+    }
+
+    printf("bench %s %s %s: rx %lu kbit/s, tx %lu kbit/s, %lu op/s", bench_stack_name, bench_current->name, what,
+        (unsigned long)((uint64_t)c->rx_bytes * 8000 / elapsed_us),
+        (unsigned long)((uint64_t)c->tx_bytes * 8000 / elapsed_us),
+        (unsigned long)((uint64_t)c->ops * 1000000 / elapsed_us));
+
+    if (c->latency.count != 0) {
+        printf(", latency %lu/%lu/%lu us", (unsigned long)c->latency.min,
+            (unsigned long)(c->latency.sum / c->latency.count), (unsigned long)c->latency.max);
+    }
+
+    printf(", %lu conn, %lu err\n", (unsigned long)bench_connections, (unsigned long)c->errors);
+
+    if (c->priority.count != 0) {
+        // its max bounds the delay the scenario's traffic adds to the priority path
+        printf("bench %s %s %s prio: %lu frames, latency %lu/%lu/%lu us\n", bench_stack_name, bench_current->name, what,
+            (unsigned long)c->priority.count, (unsigned long)c->priority.min,
+            (unsigned long)(c->priority.sum / c->priority.count), (unsigned long)c->priority.max);
+    }
+}
+
+// the totals of the scenario as a pico-bench/1 record, one line of JSON for
+// tools/bench_compare.py
+static void bench_print_result(const struct bench_counters *c, uint64_t elapsed_us) {
+    const struct bench_latency *l = &c->latency;
+
+    if (elapsed_us == 0) {
+        elapsed_us = 1;
+    }
+
+    printf("bench %s %s result: {\"schema\":\"pico-bench/1\",\"source\":\"board\",\"board\":\"%s\","
+        "\"build\":\"%s\",\"clk_sys_hz\":%lu,\"clk_peri_hz\":%lu,\"options\":\"%s\",\"scenario\":\"%s\","
+        "\"duration_ms\":%lu,\"rx_kbps\":%lu,\"tx_kbps\":%lu,\"ops_per_s\":%lu,\"errors\":%lu,",
+        bench_stack_name, bench_current->name, bench_stack_name, BENCH_BUILD,
+        (unsigned long)clock_get_hz(clk_sys), (unsigned long)clock_get_hz(clk_peri), bench_stack_options(),
+        bench_current->name, (unsigned long)(elapsed_us / 1000),
+        (unsigned long)((uint64_t)c->rx_bytes * 8000 / elapsed_us),
+        (unsigned long)((uint64_t)c->tx_bytes * 8000 / elapsed_us),
+        (unsigned long)((uint64_t)c->ops * 1000000 / elapsed_us), (unsigned long)c->errors);
+
+    if (l->count != 0) {
+        printf("\"latency_us\":{\"count\":%lu,\"min\":%lu,\"mean\":%lu,\"p50\":%lu,\"p99\":%lu,\"p999\":%lu,\"max\":%lu},",
+            (unsigned long)l->count, (unsigned long)l->min, (unsigned long)(l->sum / l->count),
+            (unsigned long)bench_hist_percentile(l, 500), (unsigned long)bench_hist_percentile(l, 990),
+            (unsigned long)bench_hist_percentile(l, 999), (unsigned long)l->max);
+    } else {
+        printf("\"latency_us\":null,");
+    }
+
+    if (bench_cpu_split_us != NULL) {
+        uint64_t us[BENCH_CPU_CLASSES] = { 0 };
+
+        bench_cpu_split_us(us);
+
+        printf("\"cpu_split\":{");
+
+        for (uint i = 0; i < bench_cpu_split_count; i++) {
+            uint64_t spent = us[i] - bench_cpu_split_start_us[i];
+            uint32_t share = (spent < elapsed_us) ? (uint32_t)(spent * 1000 / elapsed_us) : 1000;
+
+            printf("%s\"%s\":%lu.%lu", i ? "," : "", bench_cpu_split_names[i], (unsigned long)(share / 10), (unsigned long)(share % 10));
+        }
+
+        printf("},");
+    }
+
+    if (bench_cpu_idle_us != NULL) {
+        uint64_t idle = bench_cpu_idle_us() - bench_cpu_idle_start_us;
+        uint32_t busy = (idle < elapsed_us) ? (uint32_t)((elapsed_us - idle) * 1000 / elapsed_us) : 0;
+
+        printf("\"cpu_pct\":%lu.%lu}\n", (unsigned long)(busy / 10), (unsigned long)(busy % 10));
+    } else {
+        printf("\"cpu_pct\":null}\n");
+    }
+}
+
+static void bench_start(const struct bench_scenario *scenario) {
+    if (bench_current != NULL) {
+        bench_counters_add(&bench_total, &bench_period);
+
+        if (bench_total.rx_bytes != 0 || bench_total.tx_bytes != 0 || bench_total.ops != 0 || bench_total.priority.count != 0) {
+            bench_print("total", &bench_total, time_us_64() - bench_total_start_us);
+#if BENCH_BUS_PERF
+            bench_bus_print("total", &bench_total);
+#endif
+            bench_print_result(&bench_total, time_us_64() - bench_total_start_us);
+        }
+
+        bench_stack_stop();
+    }
+
+    bench_current = scenario;
+
+    memset(&bench_period, 0, sizeof(bench_period));
+    memset(&bench_total, 0, sizeof(bench_total));
+    memset(bench_hist, 0, sizeof(bench_hist));
+    bench_connections = 0;
+
+    bench_stack_start(scenario);
+
+    printf("bench %s %s: %s port %u", bench_stack_name, scenario->name,
+        (scenario->kind == BENCH_KIND_UDP_ECHO) ? "UDP" : "TCP", scenario->port);
+
+    if (scenario->size != 0) {
+        printf(", %u byte messages", scenario->size);
+    }
+
+    printf("\n");
+
+    bench_period_start_us = bench_total_start_us = time_us_64();
+
+    if (bench_cpu_idle_us != NULL) {
+        bench_cpu_idle_start_us = bench_cpu_idle_us();
+    }
+
+    if (bench_cpu_split_us != NULL) {
+        bench_cpu_split_us(bench_cpu_split_start_us);
+    }
+
+#if BENCH_BUS_PERF
+    bench_bus_select(0, bench_period_start_us);
+#endif
+}
+
+static void bench_print_scenarios(void) {
+    printf("bench %s scenarios, press a key to switch:\n", bench_stack_name);
+
+    for (int i = 0; i < BENCH_SCENARIOS; i++) {
+        printf("  %c  %-9s %s port %u\n", bench_scenarios[i].key, bench_scenarios[i].name,
+            (bench_scenarios[i].kind == BENCH_KIND_UDP_ECHO) ? "UDP" : "TCP", bench_scenarios[i].port);
+    }
+}
+
+void bench_init(const char *stack) {
+    bench_stack_name = stack;
+
+    bench_print_scenarios();
+    bench_start(&bench_scenarios[BENCH_SCENARIO]);
+}
+
+void bench_poll(void) {
+    uint64_t now = time_us_64();
+
+    bench_stack_poll();
+
+    if (bench_boot_op_us != 0 && !bench_boot_printed) {
+        // boot to service, what a power cycle costs the clients
+        printf("bench %s boot: link up at %lu ms, first op at %lu ms\n", bench_stack_name,
+            (unsigned long)(bench_boot_link_us / 1000), (unsigned long)(bench_boot_op_us / 1000));
+
+        bench_boot_printed = true;
+    }
+
+#if BENCH_BUS_PERF
+    if ((now - bench_bus_phase_start_us) >= (BENCH_BUS_SAMPLE_MS * 1000ull)) {
+        bench_bus_sample(now);
+    }
+#endif
+
+    if ((now - bench_key_poll_us) >= BENCH_KEY_POLL_US) {
+        int c = getchar_timeout_us(0);
+
+        bench_key_poll_us = now;
+
+        if (c != PICO_ERROR_TIMEOUT) {
+            for (int i = 0; i < BENCH_SCENARIOS; i++) {
+                if (bench_scenarios[i].key == c) {
+                    bench_start(&bench_scenarios[i]);
+
+                    return;
+                }
+            }
+
+            bench_print_scenarios();
+        }
+    }
+
+    if ((now - bench_period_start_us) >= (BENCH_REPORT_MS * 1000ull)) {
+        // quiet while nothing is connected or running
+        if (bench_period.rx_bytes != 0 || bench_period.tx_bytes != 0 || bench_period.ops != 0 ||
+            bench_period.errors != 0 || bench_connections != 0 || bench_period.priority.count != 0) {
+            bench_print("period", &bench_period, now - bench_period_start_us);
+#if BENCH_BUS_PERF
+            bench_bus_print("period", &bench_period);
+#endif
+        }
+
+        bench_counters_add(&bench_total, &bench_period);
+        memset(&bench_period, 0, sizeof(bench_period));
+
+        bench_period_start_us = now;
+    }
+}
+
+void bench_count_rx(uint32_t bytes) {
+    bench_period.rx_bytes += bytes;
+}
+
+void bench_count_tx(uint32_t bytes) {
+    bench_period.tx_bytes += bytes;
+}
+
+void bench_count_op(void) {
+    bench_period.ops++;
+
+    if (bench_boot_op_us == 0) {
+        bench_boot_op_us = timebase_us_64();
+    }
+}
+
+void bench_count_link_up(void) {
+    if (bench_boot_link_us == 0) {
+        bench_boot_link_us = timebase_us_64();
+    }
+}
+
+void bench_count_latency(uint32_t start_us) {
+    bench_hist[bench_hist_bucket(bench_latency_count(&bench_period.latency, start_us))]++;
+}
+
+void bench_count_priority(uint32_t start_us) {
+    bench_latency_count(&bench_period.priority, start_us);
+}
+
+void bench_cpu_source(uint64_t (*idle_us)(void)) {
+    bench_cpu_idle_us = idle_us;
+
+    if (idle_us != NULL) {
+        bench_cpu_idle_start_us = idle_us();
+    }
+}
+
+void bench_cpu_split_source(uint count, const char *const *names, void (*us)(uint64_t *us)) {
+    bench_cpu_split_count = (count < BENCH_CPU_CLASSES) ? count : BENCH_CPU_CLASSES;
+    bench_cpu_split_names = names;
+    bench_cpu_split_us = us;
+
+    if (us != NULL) {
+        memset(bench_cpu_split_start_us, 0, sizeof(bench_cpu_split_start_us));
+        us(bench_cpu_split_start_us);
+    }
+}
+
+void bench_count_error(void) {
+    bench_period.errors++;
+}
+
+void bench_count_open(void) {
+    bench_connections++;
+}
+
+void bench_count_close(void) {
+    if (bench_connections != 0) {
+        bench_connections--;
+    }
+}
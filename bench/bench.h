@@ -0,0 +1,138 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Benchmark harness shared by the W5100S (ioLibrary) and LAN8720 (lwIP) firmwares.
+//
+// The board serves one scenario at a time, picked with BENCH_SCENARIO or with its key on
+// stdio, while a host drives it (tools/loopback_bench.py). bench.c does the timing and the
+// reports, the same on both boards, bench_<stack>.c serves the scenario on its stack. A
+// scenario that ends prints its totals as a "result" line too, a pico-bench/1 record of
+// tools/bench_compare.py.
+
+// interval of the report lines on stdio
+#ifndef BENCH_REPORT_MS
+#define BENCH_REPORT_MS 1000
+#endif
+
+// count the accesses of each SRAM bank on the bus fabric performance counters, and how
+// many of them waited for another master, into a "bus" line after each report
+#ifndef BENCH_BUS_PERF
+#define BENCH_BUS_PERF 0
+#endif
+
+// the counters are moved to the next pair of banks this often, from bench_poll()
+#ifndef BENCH_BUS_SAMPLE_MS
+#define BENCH_BUS_SAMPLE_MS 10
+#endif
+
+// name of the build in the results, the CMake target of the firmware
+#ifndef BENCH_BUILD
+#define BENCH_BUILD ""
+#endif
+
+// scenario served from start-up, one of enum bench_scenario_id
+#ifndef BENCH_SCENARIO
+#define BENCH_SCENARIO BENCH_ECHO_512
+#endif
+
+// largest message, a full TCP segment at a 1500 byte MTU
+#define BENCH_MESSAGE_MAX 1460
+
+// largest UDP datagram in one frame
+#define BENCH_DATAGRAM_MAX 1472
+
+enum bench_kind {
+    BENCH_KIND_ECHO,     // TCP, every message of `size` bytes is sent back once complete
+    BENCH_KIND_SINK,     // TCP, received data is read and dropped
+    BENCH_KIND_SOURCE,   // TCP, bench_pattern() bytes are sent in `size` writes
+    BENCH_KIND_UDP_ECHO, // UDP, every datagram is sent back to its source
+    BENCH_KIND_CONNECT   // TCP, connections are accepted and closed once the peer closes
+};
+
+enum bench_scenario_id {
+    BENCH_ECHO_64,
+    BENCH_ECHO_512,
+    BENCH_ECHO_1460,
+    BENCH_SINK,
+    BENCH_SOURCE,
+    BENCH_UDP,
+    BENCH_CONNECT,
+    BENCH_SCENARIOS
+};
+
+struct bench_scenario {
+    const char *name;
+    char key;          // selects it on stdio
+    enum bench_kind kind;
+    uint16_t port;
+    uint16_t size;     // message size of echo, write size of source
+};
+
+extern const struct bench_scenario bench_scenarios[BENCH_SCENARIOS];
+
+// print the scenarios and start BENCH_SCENARIO, `stack` names the firmware in the reports
+void bench_init(const char *stack);
+
+// stdio keys and the periodic report, call it every few ms from the network context
+void bench_poll(void);
+
+// counters of the running scenario, from the network context
+void bench_count_rx(uint32_t bytes);
+void bench_count_tx(uint32_t bytes);
+
+// one message, datagram or connection done
+void bench_count_op(void);
+
+// the link came up, from the stack's link callback. The first time since boot and the
+// first operation after it are printed once as a "boot" line
+void bench_count_link_up(void);
+
+// one message echoed, with the time since the harness saw it complete (time_us_32())
+void bench_count_latency(uint32_t start_us);
+
+void bench_count_error(void);
+
+// one frame of the stack's priority path, with the time since it was received, counted
+// apart from the scenario into a "prio" line after its report. Stacks without one don't call it
+void bench_count_priority(uint32_t start_us);
+
+// connections of the scenario, open ones are in the reports
+void bench_count_open(void);
+void bench_count_close(void);
+
+// idle time of the core serving the scenario, in us since boot, for the CPU use in the
+// results. Without one it is left out
+void bench_cpu_source(uint64_t (*idle_us)(void));
+
+// the time of that core split into count classes named by names, us since boot of each
+// into us[], for a "cpu_split" of their shares in the results. Up to 8 classes
+void bench_cpu_split_source(uint count, const char *const *names, void (*us)(uint64_t *us));
+
+// byte at a stream offset of the source scenario, for checking on the host
+static inline uint8_t bench_pattern(uint32_t offset) {
+    return (uint8_t)offset;
+}
+
+// stack side, one implementation per firmware
+
+// listen for the scenario
+void bench_stack_start(const struct bench_scenario *scenario);
+
+// close its sockets and connections
+void bench_stack_stop(void);
+
+// serve it, for stacks that are polled, called from bench_poll()
+void bench_stack_poll(void);
+
+// the stack and its options that make a difference to the numbers, as `key=value` pairs
+// separated by spaces, for the results
+const char *bench_stack_options(void);
+
+#endif
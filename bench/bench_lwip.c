@@ -0,0 +1,342 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// bench.h scenarios on lwIP's raw API, NO_SYS, bench_poll() runs from an lwIP timer
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "bench.h"
+
+// bench_poll() interval, it checks stdio and prints the reports
+#ifndef BENCH_LWIP_POLL_MS
+#define BENCH_LWIP_POLL_MS 10
+#endif
+
+struct bench_lwip_conn {
+    struct tcp_pcb *pcb; // NULL while the entry is free
+    struct pbuf *p;      // received data not echoed yet
+    uint32_t seen_us;    // time the first message of p was seen complete
+    uint32_t rx_us;      // time of the last recv()
+    uint32_t offset;     // stream offset of source
+};
+
+static const struct bench_scenario *bench_lwip_scenario;
+static struct tcp_pcb *bench_lwip_listen_pcb;
+static struct udp_pcb *bench_lwip_udp_pcb;
+static struct bench_lwip_conn bench_lwip_conns[MEMP_NUM_TCP_PCB];
+
+// source data, written by reference from any offset
+static uint8_t bench_lwip_pattern[256 + BENCH_MESSAGE_MAX];
+
+// echo messages are copied out of the pbuf chain so each one is a single tcp_write()
+static uint8_t bench_lwip_buf[BENCH_MESSAGE_MAX];
+
+static void bench_lwip_timer(void *arg) {
+    bench_poll();
+
+    sys_timeout(BENCH_LWIP_POLL_MS, bench_lwip_timer, NULL);
+}
+
+static void bench_lwip_conn_free(struct bench_lwip_conn *conn) {
+    if (conn->p != NULL) {
+        pbuf_free(conn->p);
+        conn->p = NULL;
+    }
+
+    conn->pcb = NULL;
+
+    bench_count_close();
+}
+
+static void bench_lwip_close(struct bench_lwip_conn *conn) {
+    struct tcp_pcb *pcb = conn->pcb;
+
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_err(pcb, NULL);
+
+    bench_lwip_conn_free(conn);
+
+    if (tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+    }
+}
+
+// write every complete message that fits in the send buffer
+static void bench_lwip_echo(struct bench_lwip_conn *conn) {
+    uint16_t size = bench_lwip_scenario->size;
+    bool written = false;
+
+    while (conn->p != NULL && conn->p->tot_len >= size && tcp_sndbuf(conn->pcb) >= size &&
+           tcp_sndqueuelen(conn->pcb) < TCP_SND_QUEUELEN) {
+        pbuf_copy_partial(conn->p, bench_lwip_buf, size, 0);
+
+        if (tcp_write(conn->pcb, bench_lwip_buf, size, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            bench_count_error();
+
+            break;
+        }
+
+        conn->p = pbuf_free_header(conn->p, size);
+        tcp_recved(conn->pcb, size);
+
+        bench_count_tx(size);
+        bench_count_op();
+        bench_count_latency(conn->seen_us);
+
+        // a next complete message came with the last recv() at the latest
+        conn->seen_us = conn->rx_us;
+        written = true;
+    }
+
+    if (written) {
+        tcp_output(conn->pcb);
+    }
+}
+
+static void bench_lwip_source(struct bench_lwip_conn *conn) {
+    uint16_t size = bench_lwip_scenario->size;
+    bool written = false;
+
+    while (tcp_sndbuf(conn->pcb) >= size && tcp_sndqueuelen(conn->pcb) < TCP_SND_QUEUELEN) {
+        if (tcp_write(conn->pcb, bench_lwip_pattern + (conn->offset & 0xff), size, 0) != ERR_OK) {
+            break;
+        }
+
+        conn->offset += size;
+        bench_count_tx(size);
+
+        written = true;
+    }
+
+    if (written) {
+        tcp_output(conn->pcb);
+    }
+}
+
+static err_t bench_lwip_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    struct bench_lwip_conn *conn = arg;
+
+    if (p == NULL) {
+        // closed by the peer, connect counts the whole connection then
+        if (bench_lwip_scenario->kind == BENCH_KIND_CONNECT) {
+            bench_count_op();
+        }
+
+        bench_lwip_close(conn);
+
+        return ERR_OK;
+    }
+
+    if (err != ERR_OK) {
+        pbuf_free(p);
+
+        return err;
+    }
+
+    bench_count_rx(p->tot_len);
+
+    if (bench_lwip_scenario->kind == BENCH_KIND_ECHO) {
+        bool complete = (conn->p != NULL) && (conn->p->tot_len >= bench_lwip_scenario->size);
+
+        conn->rx_us = time_us_32();
+
+        if (conn->p == NULL) {
+            conn->p = p;
+        } else {
+            pbuf_cat(conn->p, p);
+        }
+
+        if (!complete) {
+            // the first message is complete now, if at all
+            conn->seen_us = conn->rx_us;
+        }
+
+        bench_lwip_echo(conn);
+    } else {
+        // sink and source read and drop, connect has nothing to read
+        tcp_recved(pcb, p->tot_len);
+        pbuf_free(p);
+    }
+
+    return ERR_OK;
+}
+
+static err_t bench_lwip_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    struct bench_lwip_conn *conn = arg;
+
+    if (bench_lwip_scenario->kind == BENCH_KIND_SOURCE) {
+        bench_lwip_source(conn);
+    } else {
+        bench_lwip_echo(conn);
+    }
+
+    return ERR_OK;
+}
+
+static void bench_lwip_err(void *arg, err_t err) {
+    // the pcb is already freed
+    bench_count_error();
+    bench_lwip_conn_free(arg);
+}
+
+static err_t bench_lwip_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    struct bench_lwip_conn *conn = NULL;
+
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    for (int i = 0; i < MEMP_NUM_TCP_PCB; i++) {
+        if (bench_lwip_conns[i].pcb == NULL) {
+            conn = &bench_lwip_conns[i];
+
+            break;
+        }
+    }
+
+    if (conn == NULL) {
+        bench_count_error();
+        tcp_abort(pcb);
+
+        return ERR_ABRT;
+    }
+
+    memset(conn, 0, sizeof(*conn));
+    conn->pcb = pcb;
+
+    bench_count_open();
+
+    // echo replies straight away, like the W5x00 that has no Nagle
+    tcp_nagle_disable(pcb);
+
+    tcp_arg(pcb, conn);
+    tcp_recv(pcb, bench_lwip_recv);
+    tcp_sent(pcb, bench_lwip_sent);
+    tcp_err(pcb, bench_lwip_err);
+
+    if (bench_lwip_scenario->kind == BENCH_KIND_SOURCE) {
+        bench_lwip_source(conn);
+    }
+
+    return ERR_OK;
+}
+
+static void bench_lwip_udp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    uint32_t seen_us = time_us_32();
+    uint16_t len = p->tot_len;
+
+    bench_count_rx(len);
+
+    if (udp_sendto(pcb, p, addr, port) == ERR_OK) {
+        bench_count_tx(len);
+        bench_count_op();
+        bench_count_latency(seen_us);
+    } else {
+        bench_count_error();
+    }
+
+    pbuf_free(p);
+}
+
+void bench_stack_start(const struct bench_scenario *scenario) {
+    static bool started;
+
+    if (!started) {
+        for (uint i = 0; i < sizeof(bench_lwip_pattern); i++) {
+            bench_lwip_pattern[i] = bench_pattern(i);
+        }
+
+        sys_timeout(BENCH_LWIP_POLL_MS, bench_lwip_timer, NULL);
+
+        started = true;
+    }
+
+    bench_lwip_scenario = scenario;
+
+    if (scenario->kind == BENCH_KIND_UDP_ECHO) {
+        bench_lwip_udp_pcb = udp_new();
+
+        if (bench_lwip_udp_pcb == NULL || udp_bind(bench_lwip_udp_pcb, IP_ADDR_ANY, scenario->port) != ERR_OK) {
+            bench_count_error();
+
+            return;
+        }
+
+        udp_recv(bench_lwip_udp_pcb, bench_lwip_udp_recv, NULL);
+
+        return;
+    }
+
+    struct tcp_pcb *pcb = tcp_new();
+
+    if (pcb == NULL) {
+        bench_count_error();
+
+        return;
+    }
+
+#if SO_REUSE
+    // a scenario picked again binds while its last connections are in TIME_WAIT
+    ip_set_option(pcb, SOF_REUSEADDR);
+#endif
+
+    if (tcp_bind(pcb, IP_ADDR_ANY, scenario->port) != ERR_OK) {
+        bench_count_error();
+        tcp_close(pcb);
+
+        return;
+    }
+
+    // with TCP_LISTEN_BACKLOG at most TCP_DEFAULT_LISTEN_BACKLOG connections in the handshake
+    bench_lwip_listen_pcb = tcp_listen(pcb);
+    tcp_accept(bench_lwip_listen_pcb, bench_lwip_accept);
+}
+
+void bench_stack_stop(void) {
+    if (bench_lwip_udp_pcb != NULL) {
+        udp_remove(bench_lwip_udp_pcb);
+        bench_lwip_udp_pcb = NULL;
+    }
+
+    if (bench_lwip_listen_pcb != NULL) {
+        tcp_close(bench_lwip_listen_pcb);
+        bench_lwip_listen_pcb = NULL;
+    }
+
+    for (int i = 0; i < MEMP_NUM_TCP_PCB; i++) {
+        if (bench_lwip_conns[i].pcb != NULL) {
+            bench_lwip_close(&bench_lwip_conns[i]);
+        }
+    }
+}
+
+void bench_stack_poll(void) {
+    // lwIP calls back, there is nothing to poll
+}
+
+const char *bench_stack_options(void) {
+    static char options[96];
+
+    if (options[0] == '\0') {
+#ifdef PICO_LWIP_PROFILE
+        snprintf(options, sizeof(options), "stack=lwip profile=%d mss=%u wnd=%u snd_buf=%u pool=%u",
+            PICO_LWIP_PROFILE, TCP_MSS, TCP_WND, TCP_SND_BUF, PBUF_POOL_SIZE);
+#else
+        snprintf(options, sizeof(options), "stack=lwip mss=%u wnd=%u snd_buf=%u pool=%u",
+            TCP_MSS, TCP_WND, TCP_SND_BUF, PBUF_POOL_SIZE);
+#endif
+    }
+
+    return options;
+}
@@ -0,0 +1,272 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// bench.h scenarios on net.h, the same source on lwIP and on the ioLibrary. bench_poll()
+// is net.h's service: lwIP's timer and callbacks run it, or net_poll() in main's loop.
+// Echo moves each message from the received bytes to the sent ones with a copy between
+// the two lends, source writes the pattern into the lent buffer, sink releases what it
+// is lent
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "net.h"
+
+#include "bench.h"
+
+struct bench_net_conn {
+    bool open;
+    uint16_t left;    // echo, bytes of the message being moved
+    uint32_t seen_us; // echo, time it was seen complete
+    uint32_t offset;  // source, stream offset
+};
+
+static const struct bench_scenario *bench_net_scenario;
+static int bench_net_listener = NET_ERROR;
+static int bench_net_udp = NET_ERROR;
+static struct bench_net_conn bench_net_conns[NET_SOCKETS];
+
+// source data, copied from any offset
+static uint8_t bench_net_pattern[256 + BENCH_MESSAGE_MAX];
+
+static uint8_t bench_net_buf[NET_DATAGRAM_MAX];
+
+static void bench_net_close(int s) {
+    net_close(s);
+
+    bench_net_conns[s].open = false;
+    bench_count_close();
+}
+
+// up to len bytes from the received ones to the sent ones, the bytes moved
+static uint16_t bench_net_move(int s, uint16_t len) {
+    uint16_t moved = 0;
+
+    while (moved < len) {
+        const uint8_t *rx;
+        uint8_t *tx;
+        int32_t rx_len = net_recv_lend(s, &rx);
+        int32_t tx_len = (rx_len > 0) ? net_send_lend(s, &tx) : 0;
+
+        if (rx_len <= 0 || tx_len <= 0) {
+            break;
+        }
+
+        uint16_t n = len - moved;
+
+        n = (rx_len < n) ? rx_len : n;
+        n = (tx_len < n) ? tx_len : n;
+
+        memcpy(tx, rx, n);
+
+        if (net_send_commit(s, n) != n) {
+            bench_count_error();
+
+            break;
+        }
+
+        net_recv_release(s, n);
+        moved += n;
+    }
+
+    return moved;
+}
+
+static void bench_net_echo(int s, struct bench_net_conn *c) {
+    uint16_t size = bench_net_scenario->size;
+
+    while (true) {
+        if (c->left == 0) {
+            if (net_recv_avail(s) < size) {
+                return;
+            }
+
+            c->left = size;
+            c->seen_us = time_us_32();
+        }
+
+        uint16_t moved = bench_net_move(s, c->left);
+
+        bench_count_rx(moved);
+        bench_count_tx(moved);
+
+        if ((c->left -= moved) != 0) {
+            // no room, the rest with a later service
+            return;
+        }
+
+        bench_count_op();
+        bench_count_latency(c->seen_us);
+    }
+}
+
+static void bench_net_source(int s, struct bench_net_conn *c) {
+    uint16_t size = bench_net_scenario->size;
+    uint8_t *tx;
+    int32_t n;
+
+    while ((n = net_send_lend(s, &tx)) > 0) {
+        if (n > size) {
+            n = size;
+        }
+
+        memcpy(tx, bench_net_pattern + (c->offset & 0xff), n);
+
+        if (net_send_commit(s, n) != n) {
+            bench_count_error();
+
+            return;
+        }
+
+        c->offset += n;
+        bench_count_tx(n);
+    }
+}
+
+// sink, and what source and connect are sent, read and dropped. False once the peer closed
+static bool bench_net_drain(int s) {
+    const uint8_t *rx;
+    int32_t n;
+
+    while ((n = net_recv_lend(s, &rx)) > 0) {
+        if (bench_net_scenario->kind == BENCH_KIND_SINK) {
+            bench_count_rx(n);
+        }
+
+        net_recv_release(s, n);
+    }
+
+    return n != NET_CLOSED;
+}
+
+static void bench_net_tcp(int s) {
+    struct bench_net_conn *c = &bench_net_conns[s];
+    uint8_t ev = net_events(s);
+    bool open = !(ev & NET_EV_HUP);
+
+    if (ev & NET_EV_IN) {
+        if (bench_net_scenario->kind == BENCH_KIND_ECHO) {
+            bench_net_echo(s, c);
+
+            // the peer's close once every message is echoed
+            if (c->left == 0 && net_recv_avail(s) == 0) {
+                const uint8_t *rx;
+
+                open = open && (net_recv_lend(s, &rx) != NET_CLOSED);
+            }
+        } else {
+            open = open && bench_net_drain(s);
+        }
+    }
+
+    if (open && bench_net_scenario->kind == BENCH_KIND_SOURCE && (ev & NET_EV_OUT)) {
+        bench_net_source(s, c);
+    }
+
+    if (!open) {
+        // closed by the peer, connect counts the whole connection then
+        if (bench_net_scenario->kind == BENCH_KIND_CONNECT) {
+            bench_count_op();
+        }
+
+        bench_net_close(s);
+    }
+}
+
+static void bench_net_udp_echo(void) {
+    uint8_t addr[4];
+    uint16_t port;
+    int32_t n;
+
+    while ((n = net_recvfrom(bench_net_udp, bench_net_buf, sizeof(bench_net_buf), addr, &port)) > 0) {
+        uint32_t seen_us = time_us_32();
+
+        bench_count_rx(n);
+
+        if (net_sendto(bench_net_udp, bench_net_buf, n, addr, port) == n) {
+            bench_count_tx(n);
+            bench_count_op();
+            bench_count_latency(seen_us);
+        } else {
+            bench_count_error();
+        }
+    }
+}
+
+void bench_stack_start(const struct bench_scenario *scenario) {
+    static bool started;
+
+    if (!started) {
+        for (uint i = 0; i < sizeof(bench_net_pattern); i++) {
+            bench_net_pattern[i] = bench_pattern(i);
+        }
+
+        net_init(bench_poll);
+
+        started = true;
+    }
+
+    bench_net_scenario = scenario;
+
+    if (scenario->kind == BENCH_KIND_UDP_ECHO) {
+        if ((bench_net_udp = net_udp_open(scenario->port)) < 0) {
+            bench_count_error();
+        }
+
+        return;
+    }
+
+    if ((bench_net_listener = net_listen(scenario->port, NET_SOCKETS)) < 0) {
+        bench_count_error();
+    }
+}
+
+void bench_stack_stop(void) {
+    if (bench_net_udp >= 0) {
+        net_close(bench_net_udp);
+        bench_net_udp = NET_ERROR;
+    }
+
+    if (bench_net_listener >= 0) {
+        net_unlisten(bench_net_listener);
+        bench_net_listener = NET_ERROR;
+    }
+
+    for (int s = 0; s < NET_SOCKETS; s++) {
+        if (bench_net_conns[s].open) {
+            bench_net_close(s);
+        }
+    }
+}
+
+void bench_stack_poll(void) {
+    int s;
+
+    if (bench_net_udp >= 0) {
+        bench_net_udp_echo();
+    }
+
+    if (bench_net_listener < 0) {
+        return;
+    }
+
+    while ((s = net_accept(bench_net_listener)) >= 0) {
+        memset(&bench_net_conns[s], 0, sizeof(bench_net_conns[s]));
+        bench_net_conns[s].open = true;
+
+        bench_count_open();
+    }
+
+    for (s = 0; s < NET_SOCKETS; s++) {
+        if (bench_net_conns[s].open) {
+            bench_net_tcp(s);
+        }
+    }
+}
+
+const char *bench_stack_options(void) {
+    return net_options();
+}
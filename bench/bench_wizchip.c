@@ -0,0 +1,317 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// bench.h scenarios on the ioLibrary socket API, polled from bench_poll() in main's loop
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "wizchip_conf.h"
+#include "socket.h"
+
+#include "w5x00_spi_profile.h"
+
+#include "bench.h"
+
+// sockets serving the scenario, all listening on its port, UDP uses the first one only
+#ifndef BENCH_WIZCHIP_SOCKETS
+#define BENCH_WIZCHIP_SOCKETS _WIZCHIP_SOCK_NUM_
+#endif
+
+// SO_PROFILE of the TCP sockets, for the RTT of each: 0 SF_TCP_NODELAY only, 1 SOCK_PROFILE_DEFAULT,
+// the chip's delayed ACK and retransmission timers, 2 SOCK_PROFILE_LOW_LATENCY
+#ifndef BENCH_WIZCHIP_PROFILE
+#define BENCH_WIZCHIP_PROFILE 0
+#endif
+
+#if BENCH_WIZCHIP_PROFILE == 1
+static const wiz_SockProfile bench_wizchip_profile = SOCK_PROFILE_DEFAULT;
+#elif BENCH_WIZCHIP_PROFILE == 2
+static const wiz_SockProfile bench_wizchip_profile = SOCK_PROFILE_LOW_LATENCY;
+#endif
+
+struct bench_wizchip_socket {
+    bool connected;
+    uint16_t pending;    // echo message read but not sent yet, the TX buffer was busy
+    uint32_t seen_us;    // time the pending message was seen complete
+    uint32_t offset;     // stream offset of source
+    uint8_t buf[BENCH_DATAGRAM_MAX];
+};
+
+static const struct bench_scenario *bench_wizchip_scenario;
+static struct bench_wizchip_socket bench_wizchip_sockets[BENCH_WIZCHIP_SOCKETS];
+
+// source data, sent from any offset
+static uint8_t bench_wizchip_pattern[256 + BENCH_MESSAGE_MAX];
+
+// status, interrupt, received and free sizes of a socket
+static void bench_wizchip_state(uint8_t sn, uint8_t *sr, uint8_t *ir, uint16_t *rsr, uint16_t *fsr) {
+#if _WIZCHIP_ == W5100S
+    // one burst instead of a register access each
+    wiz_SnSnapshot snap;
+
+    wiz_socket_snapshot(sn, &snap);
+
+    *sr = snap.sr;
+    *ir = snap.ir;
+    *rsr = snap.rx_rsr;
+    *fsr = snap.tx_fsr;
+#else
+    *sr = getSn_SR(sn);
+    *ir = getSn_IR(sn);
+    *rsr = getSn_RX_RSR(sn);
+    *fsr = getSn_TX_FSR(sn);
+#endif
+}
+
+// send the pending echo message, false while the TX buffer is busy
+static bool bench_wizchip_echo_send(uint8_t sn, struct bench_wizchip_socket *s) {
+    int32_t ret = W5X00_SPI_PROFILE_CALL(W5X00_SPI_PROFILE_SEND, send(sn, s->buf, s->pending));
+
+    if (ret == SOCK_BUSY) {
+        return false;
+    }
+
+    if (ret < 0) {
+        bench_count_error();
+    } else {
+        bench_count_tx(ret);
+        bench_count_op();
+        bench_count_latency(s->seen_us);
+    }
+
+    s->pending = 0;
+
+    return true;
+}
+
+static void bench_wizchip_established(uint8_t sn, struct bench_wizchip_socket *s, uint16_t rsr, uint16_t fsr) {
+    uint16_t size = bench_wizchip_scenario->size;
+    int32_t ret;
+
+    switch (bench_wizchip_scenario->kind) {
+    case BENCH_KIND_ECHO:
+        if (s->pending != 0 && !bench_wizchip_echo_send(sn, s)) {
+            return;
+        }
+
+        // every complete message in the RX buffer, while they can be sent
+        while (rsr >= size) {
+            s->seen_us = time_us_32();
+
+            if ((ret = W5X00_SPI_PROFILE_CALL(W5X00_SPI_PROFILE_RECV, recv(sn, s->buf, size))) <= 0) {
+                if (ret < 0) {
+                    bench_count_error();
+                }
+
+                return;
+            }
+
+            bench_count_rx(ret);
+            rsr -= ret;
+
+            s->pending = ret;
+
+            if (!bench_wizchip_echo_send(sn, s)) {
+                return;
+            }
+        }
+        break;
+
+    case BENCH_KIND_SINK:
+        if (rsr != 0) {
+            if ((ret = W5X00_SPI_PROFILE_CALL(W5X00_SPI_PROFILE_RECV, recv(sn, s->buf, (rsr < sizeof(s->buf)) ? rsr : sizeof(s->buf)))) > 0) {
+                bench_count_rx(ret);
+            } else if (ret < 0) {
+                bench_count_error();
+            }
+        }
+        break;
+
+    case BENCH_KIND_SOURCE:
+        if (rsr != 0) {
+            W5X00_SPI_PROFILE_CALL(W5X00_SPI_PROFILE_RECV, recv(sn, s->buf, (rsr < sizeof(s->buf)) ? rsr : sizeof(s->buf)));
+        }
+
+        if (fsr >= size) {
+            if ((ret = W5X00_SPI_PROFILE_CALL(W5X00_SPI_PROFILE_SEND, send(sn, bench_wizchip_pattern + (s->offset & 0xff), size))) > 0) {
+                s->offset += ret;
+                bench_count_tx(ret);
+            } else if (ret < 0) {
+                bench_count_error();
+            }
+        }
+        break;
+
+    default:
+        // connect has nothing to read
+        if (rsr != 0) {
+            W5X00_SPI_PROFILE_CALL(W5X00_SPI_PROFILE_RECV, recv(sn, s->buf, (rsr < sizeof(s->buf)) ? rsr : sizeof(s->buf)));
+        }
+        break;
+    }
+}
+
+static void bench_wizchip_tcp(uint8_t sn) {
+    struct bench_wizchip_socket *s = &bench_wizchip_sockets[sn];
+    uint8_t sr, ir;
+    uint16_t rsr, fsr;
+
+    bench_wizchip_state(sn, &sr, &ir, &rsr, &fsr);
+
+    if (s->connected && sr != SOCK_ESTABLISHED) {
+        s->connected = false;
+        s->pending = 0;
+
+        bench_count_close();
+
+        if (bench_wizchip_scenario->kind == BENCH_KIND_CONNECT) {
+            bench_count_op();
+        }
+    }
+
+    switch (sr) {
+    case SOCK_ESTABLISHED:
+        if (ir & Sn_IR_CON) {
+            setSn_IR(sn, Sn_IR_CON);
+        }
+
+        if (!s->connected) {
+            s->connected = true;
+            s->offset = 0;
+
+            bench_count_open();
+        }
+
+        bench_wizchip_established(sn, s, rsr, fsr);
+        break;
+
+    case SOCK_CLOSE_WAIT:
+        // non-blocking, the socket is CLOSED once the FIN is acknowledged
+        disconnect(sn);
+        break;
+
+    case SOCK_INIT:
+        if (listen(sn) != SOCK_OK) {
+            bench_count_error();
+        }
+        break;
+
+    case SOCK_CLOSED:
+#if BENCH_WIZCHIP_PROFILE
+        // Sn_MR_ND from the profile
+        if (socket(sn, Sn_MR_TCP, bench_wizchip_scenario->port, SF_IO_NONBLOCK) != sn) {
+#else
+        // the W5x00 delays no ACK then, lwIP's pcbs turn Nagle off instead
+        if (socket(sn, Sn_MR_TCP, bench_wizchip_scenario->port, SF_IO_NONBLOCK | SF_TCP_NODELAY) != sn) {
+#endif
+            bench_count_error();
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void bench_wizchip_udp(uint8_t sn) {
+    struct bench_wizchip_socket *s = &bench_wizchip_sockets[sn];
+    uint8_t sr, ir;
+    uint16_t rsr, fsr;
+    uint8_t addr[4];
+    uint16_t port;
+    int32_t ret;
+
+    bench_wizchip_state(sn, &sr, &ir, &rsr, &fsr);
+
+    if (sr == SOCK_CLOSED) {
+        // blocking, sendto() returns once the datagram is out
+        if (socket(sn, Sn_MR_UDP, bench_wizchip_scenario->port, 0x00) != sn) {
+            bench_count_error();
+        }
+
+        return;
+    }
+
+    // RX_RSR includes the 8 byte header of each datagram
+    if (sr != SOCK_UDP || rsr == 0) {
+        return;
+    }
+
+    uint32_t seen_us = time_us_32();
+
+    if ((ret = W5X00_SPI_PROFILE_CALL(W5X00_SPI_PROFILE_RECVFROM, recvfrom(sn, s->buf, sizeof(s->buf), addr, &port))) <= 0) {
+        bench_count_error();
+
+        return;
+    }
+
+    bench_count_rx(ret);
+
+    if ((ret = W5X00_SPI_PROFILE_CALL(W5X00_SPI_PROFILE_SENDTO, sendto(sn, s->buf, ret, addr, port))) > 0) {
+        bench_count_tx(ret);
+        bench_count_op();
+        bench_count_latency(seen_us);
+    } else {
+        bench_count_error();
+    }
+}
+
+void bench_stack_start(const struct bench_scenario *scenario) {
+    for (uint i = 0; i < sizeof(bench_wizchip_pattern); i++) {
+        bench_wizchip_pattern[i] = bench_pattern(i);
+    }
+
+    memset(bench_wizchip_sockets, 0, sizeof(bench_wizchip_sockets));
+
+#if BENCH_WIZCHIP_PROFILE
+    for (uint8_t sn = 0; sn < BENCH_WIZCHIP_SOCKETS; sn++) {
+        setsockopt(sn, SO_PROFILE, (void *)&bench_wizchip_profile);
+    }
+#endif
+
+    // the sockets are opened by the first bench_stack_poll()
+    bench_wizchip_scenario = scenario;
+
+#if W5X00_SPI_PROFILE
+    w5x00_spi_profile_reset();
+#endif
+}
+
+void bench_stack_stop(void) {
+    for (uint8_t sn = 0; sn < BENCH_WIZCHIP_SOCKETS; sn++) {
+        close(sn);
+    }
+
+#if W5X00_SPI_PROFILE
+    // the SPI cost of each socket call over the scenario
+    w5x00_spi_profile_print();
+#endif
+}
+
+void bench_stack_poll(void) {
+    if (bench_wizchip_scenario->kind == BENCH_KIND_UDP_ECHO) {
+        bench_wizchip_udp(0);
+
+        return;
+    }
+
+    for (uint8_t sn = 0; sn < BENCH_WIZCHIP_SOCKETS; sn++) {
+        bench_wizchip_tcp(sn);
+    }
+}
+
+const char *bench_stack_options(void) {
+    static char options[80];
+
+    if (options[0] == '\0') {
+        snprintf(options, sizeof(options), "stack=iolibrary io=%s sockets=%d profile=%d spi_profile=%d",
+            (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_) ? "bus" : "spi",
+            BENCH_WIZCHIP_SOCKETS, BENCH_WIZCHIP_PROFILE, W5X00_SPI_PROFILE);
+    }
+
+    return options;
+}
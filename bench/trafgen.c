@@ -0,0 +1,367 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "timebase.h"
+
+#include "trafgen.h"
+
+// stdio is checked this often, a USB CDC read is too slow for every poll
+#define TRAFGEN_KEY_POLL_US 10000
+
+struct trafgen_flow {
+    uint32_t tx_seq;   // of the next message sent
+    uint32_t rx_next;  // sequence number expected next
+};
+
+struct trafgen_counters {
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t messages;
+    int32_t lost;      // gaps, less the messages that came late into them
+    uint32_t reordered;
+    uint32_t errors;
+};
+
+struct trafgen_config trafgen_config;
+
+static const char *trafgen_stack_name;
+static struct trafgen_flow trafgen_flows[TRAFGEN_FLOWS_MAX];
+static struct trafgen_counters trafgen_period;  // since the last report
+static struct trafgen_counters trafgen_total;   // since the start or `r`
+static uint32_t trafgen_connections;
+static uint64_t trafgen_period_start_us;
+static uint64_t trafgen_total_start_us;
+static uint64_t trafgen_key_poll_us;
+static bool trafgen_paused;
+
+// pacing: bits the rate allowed and not sent yet, up to a burst, and the rest of the
+// division that gave them
+static uint32_t trafgen_credit_bits;
+static uint32_t trafgen_credit_rest;
+static uint32_t trafgen_credit_us;
+static bool trafgen_on;
+
+// the message sent, only its header changes
+static uint8_t trafgen_message[TRAFGEN_DATAGRAM_MAX];
+
+static inline void trafgen_put32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline uint32_t trafgen_get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void trafgen_counters_add(struct trafgen_counters *to, const struct trafgen_counters *from) {
+    to->rx_bytes += from->rx_bytes;
+    to->tx_bytes += from->tx_bytes;
+    to->messages += from->messages;
+    to->lost += from->lost;
+    to->reordered += from->reordered;
+    to->errors += from->errors;
+}
+
+// one line, the same on both firmwares so their logs compare directly
+static void trafgen_print(const char *what, const struct trafgen_counters *c, uint64_t elapsed_us) {
+    if (elapsed_us == 0) {
+        elapsed_us = 1;
+    }
+
+    printf("trafgen %s %s %s %s: rx %lu kbit/s, tx %lu kbit/s, %lu msg/s", trafgen_stack_name,
+        (trafgen_config.role == TRAFGEN_ROLE_SOURCE) ? "source" : "sink",
+        (trafgen_config.proto == TRAFGEN_PROTO_TCP) ? "tcp" : "udp", what,
+        (unsigned long)((uint64_t)c->rx_bytes * 8000 / elapsed_us),
+        (unsigned long)((uint64_t)c->tx_bytes * 8000 / elapsed_us),
+        (unsigned long)((uint64_t)c->messages * 1000000 / elapsed_us));
+
+    if (trafgen_config.role == TRAFGEN_ROLE_SINK) {
+        printf(", lost %ld, reordered %lu", (long)c->lost, (unsigned long)c->reordered);
+    }
+
+    printf(", %lu conn, %lu err\n", (unsigned long)trafgen_connections, (unsigned long)c->errors);
+}
+
+static void trafgen_print_config(void) {
+    const struct trafgen_config *c = &trafgen_config;
+
+    if (c->role == TRAFGEN_ROLE_SINK) {
+        printf("trafgen %s sink: %s port %u\n", trafgen_stack_name,
+            (c->proto == TRAFGEN_PROTO_TCP) ? "TCP" : "UDP", c->port);
+
+        return;
+    }
+
+    printf("trafgen %s source: %s to %u.%u.%u.%u port %u, %u x %u byte messages", trafgen_stack_name,
+        (c->proto == TRAFGEN_PROTO_TCP) ? "TCP" : "UDP", c->peer[0], c->peer[1], c->peer[2], c->peer[3],
+        c->port, c->connections, c->size);
+
+    if (c->rate_kbps != 0) {
+        printf(", %lu kbit/s in bursts of %u", (unsigned long)c->rate_kbps, c->burst);
+    }
+
+    if (c->off_ms != 0) {
+        printf(", on %u ms off %u ms", c->on_ms, c->off_ms);
+    }
+
+    printf("%s\n", trafgen_paused ? ", paused" : "");
+}
+
+static void trafgen_restart(uint64_t now) {
+    memset(&trafgen_period, 0, sizeof(trafgen_period));
+    memset(&trafgen_total, 0, sizeof(trafgen_total));
+
+    trafgen_period_start_us = trafgen_total_start_us = now;
+}
+
+// the rate's credit since the last poll, and whether the on/off pattern is on
+static void trafgen_pace(uint64_t now) {
+    const struct trafgen_config *c = &trafgen_config;
+    uint32_t now_us = (uint32_t)now;
+
+    if (c->off_ms != 0) {
+        trafgen_on = ((now - trafgen_total_start_us) / 1000 % (c->on_ms + c->off_ms)) < c->on_ms;
+    } else {
+        trafgen_on = true;
+    }
+
+    if (c->rate_kbps != 0) {
+        // kbit/s are bits per ms, the rest keeps rates below 1 bit/us exact
+        uint64_t bits = (uint64_t)c->rate_kbps * (now_us - trafgen_credit_us) + trafgen_credit_rest;
+        uint32_t limit = (uint32_t)c->burst * c->size * 8;
+
+        trafgen_credit_rest = bits % 1000;
+        trafgen_credit_bits += (bits / 1000 < limit) ? (uint32_t)(bits / 1000) : limit;
+
+        // idle times save up for a burst at most, off and paused ones for nothing
+        if (!trafgen_on || trafgen_paused) {
+            trafgen_credit_bits = 0;
+        } else if (trafgen_credit_bits > limit) {
+            trafgen_credit_bits = limit;
+        }
+    }
+
+    trafgen_credit_us = now_us;
+}
+
+void trafgen_init(const char *stack, const struct trafgen_config *config) {
+    trafgen_stack_name = stack;
+    trafgen_config = *config;
+
+    uint16_t size_max = (trafgen_config.proto == TRAFGEN_PROTO_TCP) ? TRAFGEN_MESSAGE_MAX : TRAFGEN_DATAGRAM_MAX;
+
+    if (trafgen_config.size < TRAFGEN_HEADER_SIZE) {
+        trafgen_config.size = TRAFGEN_HEADER_SIZE;
+    } else if (trafgen_config.size > size_max) {
+        trafgen_config.size = size_max;
+    }
+
+    if (trafgen_config.connections == 0) {
+        trafgen_config.connections = 1;
+    } else if (trafgen_config.connections > TRAFGEN_FLOWS_MAX) {
+        trafgen_config.connections = TRAFGEN_FLOWS_MAX;
+    }
+
+    if (trafgen_config.burst == 0) {
+        trafgen_config.burst = 1;
+    }
+
+    if (trafgen_config.on_ms == 0) {
+        trafgen_config.on_ms = 1;
+    }
+
+    for (uint i = TRAFGEN_HEADER_SIZE; i < sizeof(trafgen_message); i++) {
+        trafgen_message[i] = (uint8_t)i;
+    }
+
+    // the stack may take fewer connections than asked for
+    trafgen_stack_start();
+    trafgen_print_config();
+
+    trafgen_restart(timebase_us_64());
+    trafgen_credit_us = (uint32_t)trafgen_total_start_us;
+}
+
+void trafgen_poll(void) {
+    uint64_t now = timebase_us_64();
+
+    if (trafgen_config.role == TRAFGEN_ROLE_SOURCE) {
+        trafgen_pace(now);
+    }
+
+    trafgen_stack_poll();
+
+    if ((now - trafgen_key_poll_us) >= TRAFGEN_KEY_POLL_US) {
+        int c = getchar_timeout_us(0);
+
+        trafgen_key_poll_us = now;
+
+        if (c == ' ') {
+            trafgen_paused = !trafgen_paused;
+        } else if (c == 'r') {
+            trafgen_counters_add(&trafgen_total, &trafgen_period);
+            trafgen_print("total", &trafgen_total, now - trafgen_total_start_us);
+            trafgen_restart(now);
+        }
+
+        if (c != PICO_ERROR_TIMEOUT) {
+            trafgen_print_config();
+        }
+    }
+
+    if ((now - trafgen_period_start_us) >= (TRAFGEN_REPORT_MS * 1000ull)) {
+        // quiet while nothing is connected or running
+        if (trafgen_period.rx_bytes != 0 || trafgen_period.tx_bytes != 0 || trafgen_period.errors != 0 ||
+            trafgen_connections != 0) {
+            trafgen_print("period", &trafgen_period, now - trafgen_period_start_us);
+        }
+
+        trafgen_counters_add(&trafgen_total, &trafgen_period);
+        memset(&trafgen_period, 0, sizeof(trafgen_period));
+
+        trafgen_period_start_us = now;
+    }
+}
+
+bool trafgen_tx_ready(void) {
+    if (trafgen_paused || !trafgen_on) {
+        return false;
+    }
+
+    return trafgen_config.rate_kbps == 0 || trafgen_credit_bits >= (uint32_t)trafgen_config.size * 8;
+}
+
+const uint8_t *trafgen_tx_message(uint16_t flow) {
+    uint8_t *h = trafgen_message;
+
+    trafgen_put32(h, TRAFGEN_MAGIC);
+    h[4] = flow >> 8;
+    h[5] = flow;
+    h[6] = trafgen_config.size >> 8;
+    h[7] = trafgen_config.size;
+    trafgen_put32(h + 8, trafgen_flows[flow].tx_seq);
+    trafgen_put32(h + 12, timebase_us());
+
+    return trafgen_message;
+}
+
+void trafgen_tx_sent(uint16_t flow) {
+    trafgen_flows[flow].tx_seq++;
+
+    trafgen_period.tx_bytes += trafgen_config.size;
+    trafgen_period.messages++;
+
+    if (trafgen_config.rate_kbps != 0) {
+        trafgen_credit_bits -= (trafgen_credit_bits < trafgen_config.size * 8u) ? trafgen_credit_bits : trafgen_config.size * 8u;
+    }
+}
+
+// the header of a message received, false when it isn't one
+static bool trafgen_rx_header(const uint8_t *h) {
+    uint16_t flow = (h[4] << 8) | h[5];
+    uint32_t seq = trafgen_get32(h + 8);
+
+    if (trafgen_get32(h) != TRAFGEN_MAGIC || flow >= TRAFGEN_FLOWS_MAX) {
+        trafgen_period.errors++;
+
+        return false;
+    }
+
+    struct trafgen_flow *f = &trafgen_flows[flow];
+
+    trafgen_period.messages++;
+
+    if (seq == f->rx_next) {
+        f->rx_next++;
+    } else if (seq == 0) {
+        // the source started again
+        f->rx_next = 1;
+    } else if (seq > f->rx_next) {
+        trafgen_period.lost += seq - f->rx_next;
+        f->rx_next = seq + 1;
+    } else {
+        // into a gap counted before, a duplicate counts the same
+        trafgen_period.lost--;
+        trafgen_period.reordered++;
+    }
+
+    return true;
+}
+
+void trafgen_rx_datagram(const uint8_t *data, uint16_t len) {
+    trafgen_period.rx_bytes += len;
+
+    if (len < TRAFGEN_HEADER_SIZE) {
+        trafgen_period.errors++;
+
+        return;
+    }
+
+    trafgen_rx_header(data);
+}
+
+void trafgen_rx_stream(struct trafgen_stream *stream, const uint8_t *data, uint32_t len) {
+    trafgen_period.rx_bytes += len;
+
+    while (len != 0 && !stream->lost_sync) {
+        uint32_t n;
+
+        if (stream->have < TRAFGEN_HEADER_SIZE) {
+            n = TRAFGEN_HEADER_SIZE - stream->have;
+            n = (n < len) ? n : len;
+
+            memcpy(stream->header + stream->have, data, n);
+            stream->have += n;
+
+            if (stream->have == TRAFGEN_HEADER_SIZE) {
+                uint16_t size = (stream->header[6] << 8) | stream->header[7];
+
+                if (!trafgen_rx_header(stream->header) || size < TRAFGEN_HEADER_SIZE) {
+                    stream->lost_sync = true;
+                }
+
+                stream->left = size - TRAFGEN_HEADER_SIZE;
+            }
+        } else {
+            n = (stream->left < len) ? stream->left : len;
+            stream->left -= n;
+        }
+
+        if (stream->have == TRAFGEN_HEADER_SIZE && stream->left == 0) {
+            stream->have = 0;
+        }
+
+        data += n;
+        len -= n;
+    }
+}
+
+void trafgen_stream_reset(struct trafgen_stream *stream) {
+    memset(stream, 0, sizeof(*stream));
+}
+
+void trafgen_count_rx(uint32_t bytes) {
+    trafgen_period.rx_bytes += bytes;
+}
+
+void trafgen_count_error(void) {
+    trafgen_period.errors++;
+}
+
+void trafgen_count_open(void) {
+    trafgen_connections++;
+}
+
+void trafgen_count_close(void) {
+    if (trafgen_connections != 0) {
+        trafgen_connections--;
+    }
+}
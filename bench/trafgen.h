@@ -0,0 +1,173 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _TRAFGEN_H_
+#define _TRAFGEN_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Traffic generator shared by the W5100S (ioLibrary) and LAN8720 (lwIP) firmwares, so one
+// board loads another without a host in the timing.
+//
+// A source board sends sequenced messages to its peer over TCP connections or UDP flows,
+// paced to a rate and in bursts, and a sink board counts what arrives and the messages
+// lost or out of order per flow. trafgen.c does the pacing, the sequencing and the
+// reports, trafgen_<stack>.c moves the messages on its stack. A source also loads the
+// sink and udp scenarios of bench.h, which drop or echo the messages uncounted.
+
+// interval of the report lines on stdio
+#ifndef TRAFGEN_REPORT_MS
+#define TRAFGEN_REPORT_MS 1000
+#endif
+
+// defaults of struct trafgen_config, the examples build a source and a sink from them
+#ifndef TRAFGEN_ROLE
+#define TRAFGEN_ROLE TRAFGEN_ROLE_SOURCE
+#endif
+
+#ifndef TRAFGEN_PROTO
+#define TRAFGEN_PROTO TRAFGEN_PROTO_TCP
+#endif
+
+// the sink's address, the address of both benchmark firmwares
+#ifndef TRAFGEN_PEER
+#define TRAFGEN_PEER { 192, 168, 1, 15 }
+#endif
+
+// the sink scenario of bench.h, TCP and UDP alike
+#ifndef TRAFGEN_PORT
+#define TRAFGEN_PORT 5009
+#endif
+
+// bytes per message, TCP writes or UDP datagrams, header included
+#ifndef TRAFGEN_SIZE
+#define TRAFGEN_SIZE 1024
+#endif
+
+// kbit/s of payload over all flows, 0 for as fast as the stack takes it
+#ifndef TRAFGEN_RATE_KBPS
+#define TRAFGEN_RATE_KBPS 0
+#endif
+
+// TCP connections or UDP flows, the messages take turns on them
+#ifndef TRAFGEN_CONNECTIONS
+#define TRAFGEN_CONNECTIONS 1
+#endif
+
+// messages sent back to back once the rate allows, the depth of the pacing bucket
+#ifndef TRAFGEN_BURST
+#define TRAFGEN_BURST 1
+#endif
+
+// on/off pattern of the source, sending for TRAFGEN_ON_MS then quiet for TRAFGEN_OFF_MS,
+// TRAFGEN_OFF_MS 0 sends all the time
+#ifndef TRAFGEN_ON_MS
+#define TRAFGEN_ON_MS 1000
+#endif
+
+#ifndef TRAFGEN_OFF_MS
+#define TRAFGEN_OFF_MS 0
+#endif
+
+// flows a sink tells apart, connections or UDP flows of the source
+#define TRAFGEN_FLOWS_MAX 8
+
+// largest TCP message, a full segment at a 1500 byte MTU, and UDP datagram in one frame
+#define TRAFGEN_MESSAGE_MAX 1460
+#define TRAFGEN_DATAGRAM_MAX 1472
+
+// every message starts with it, big endian:
+//   0  magic "TGEN"
+//   4  flow, 16 bits
+//   6  message size, 16 bits, header included
+//   8  sequence number of the message in its flow, from 0
+//   12 time the source sent it, its us since boot
+// a byte counter of the message offset follows, as bench_pattern()
+#define TRAFGEN_HEADER_SIZE 16
+#define TRAFGEN_MAGIC 0x5447454eu
+
+enum trafgen_role {
+    TRAFGEN_ROLE_SOURCE,
+    TRAFGEN_ROLE_SINK
+};
+
+enum trafgen_proto {
+    TRAFGEN_PROTO_TCP,
+    TRAFGEN_PROTO_UDP
+};
+
+struct trafgen_config {
+    enum trafgen_role role;
+    enum trafgen_proto proto;
+    uint8_t peer[4];      // sink's address, unused by the sink
+    uint16_t port;        // sink's port
+    uint16_t size;
+    uint32_t rate_kbps;
+    uint8_t connections;
+    uint8_t burst;
+    uint16_t on_ms;
+    uint16_t off_ms;
+};
+
+#define TRAFGEN_CONFIG_DEFAULT {            \
+        .role = TRAFGEN_ROLE,               \
+        .proto = TRAFGEN_PROTO,             \
+        .peer = TRAFGEN_PEER,               \
+        .port = TRAFGEN_PORT,               \
+        .size = TRAFGEN_SIZE,               \
+        .rate_kbps = TRAFGEN_RATE_KBPS,     \
+        .connections = TRAFGEN_CONNECTIONS, \
+        .burst = TRAFGEN_BURST,             \
+        .on_ms = TRAFGEN_ON_MS,             \
+        .off_ms = TRAFGEN_OFF_MS,           \
+    }
+
+// the byte stream of a TCP connection on the sink, cut into messages
+struct trafgen_stream {
+    uint8_t header[TRAFGEN_HEADER_SIZE];
+    uint16_t have;       // header bytes of the current message
+    uint16_t left;       // its bytes after the header still to come
+    bool lost_sync;      // a message without the magic, nothing after it is counted
+};
+
+extern struct trafgen_config trafgen_config;
+
+// print the configuration and start it, the size clamped to what one frame carries and
+// the connections to TRAFGEN_FLOWS_MAX. `stack` names the firmware in the reports
+void trafgen_init(const char *stack, const struct trafgen_config *config);
+
+// pacing, stdio keys and the periodic report, call it every ms or so from the network
+// context. A space pauses and resumes the source, `r` prints the totals and restarts them
+void trafgen_poll(void);
+
+// source side: whether a message may go now, the message of `flow` to send when it may,
+// trafgen_config.size bytes, and the count once the stack took it. A message not taken
+// is built again with the same sequence number
+bool trafgen_tx_ready(void);
+const uint8_t *trafgen_tx_message(uint16_t flow);
+void trafgen_tx_sent(uint16_t flow);
+
+// sink side: a datagram, `len` bytes of which `data` holds at least the header, and the
+// bytes of a TCP connection as they come
+void trafgen_rx_datagram(const uint8_t *data, uint16_t len);
+void trafgen_rx_stream(struct trafgen_stream *stream, const uint8_t *data, uint32_t len);
+void trafgen_stream_reset(struct trafgen_stream *stream);
+
+// both sides, the rx functions above count their bytes themselves
+void trafgen_count_rx(uint32_t bytes);
+void trafgen_count_error(void);
+void trafgen_count_open(void);
+void trafgen_count_close(void);
+
+// stack side, one implementation per firmware
+
+// open the connections or flows of trafgen_config, or listen for them, lowering
+// trafgen_config.connections to what the stack has
+void trafgen_stack_start(void);
+
+// send what the pacing allows and read what came, called from trafgen_poll()
+void trafgen_stack_poll(void);
+
+#endif
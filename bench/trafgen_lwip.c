@@ -0,0 +1,358 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// trafgen.h on lwIP's raw API, NO_SYS, trafgen_poll() runs from an lwIP timer
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "timebase.h"
+
+#include "trafgen.h"
+
+// trafgen_poll() interval, the pacing's resolution
+#ifndef TRAFGEN_LWIP_POLL_MS
+#define TRAFGEN_LWIP_POLL_MS 1
+#endif
+
+// a source connection closed or refused is opened again after this
+#ifndef TRAFGEN_LWIP_RETRY_MS
+#define TRAFGEN_LWIP_RETRY_MS 1000
+#endif
+
+// most datagrams sent per poll without a rate, lwIP has no flow control for UDP and the
+// driver would take them for as long as it is polled
+#ifndef TRAFGEN_LWIP_UDP_BATCH
+#define TRAFGEN_LWIP_UDP_BATCH 16
+#endif
+
+struct trafgen_lwip_conn {
+    struct tcp_pcb *pcb;   // NULL while the entry is free
+    bool connected;
+    uint32_t closed_us;    // time the source's connection closed
+    struct trafgen_stream stream;
+};
+
+static struct tcp_pcb *trafgen_lwip_listen_pcb;
+static struct udp_pcb *trafgen_lwip_udp_pcbs[TRAFGEN_FLOWS_MAX];
+static struct trafgen_lwip_conn trafgen_lwip_conns[TRAFGEN_FLOWS_MAX];
+static ip_addr_t trafgen_lwip_peer;
+static uint trafgen_lwip_next;   // connection or flow of the next message
+
+static void trafgen_lwip_timer(void *arg) {
+    trafgen_poll();
+
+    sys_timeout(TRAFGEN_LWIP_POLL_MS, trafgen_lwip_timer, NULL);
+}
+
+static void trafgen_lwip_conn_free(struct trafgen_lwip_conn *conn) {
+    if (conn->connected) {
+        trafgen_count_close();
+    }
+
+    conn->pcb = NULL;
+    conn->connected = false;
+    conn->closed_us = timebase_us();
+}
+
+static void trafgen_lwip_close(struct trafgen_lwip_conn *conn) {
+    struct tcp_pcb *pcb = conn->pcb;
+
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_err(pcb, NULL);
+
+    trafgen_lwip_conn_free(conn);
+
+    if (tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+    }
+}
+
+// messages while the pacing allows, taking turns on the connections with room for one
+static void trafgen_lwip_tcp_send(void) {
+    uint16_t size = trafgen_config.size;
+    uint written = 0;
+
+    while (trafgen_tx_ready()) {
+        struct trafgen_lwip_conn *conn = NULL;
+        uint flow = 0;
+
+        for (uint i = 0; i < trafgen_config.connections; i++) {
+            flow = (trafgen_lwip_next + i) % trafgen_config.connections;
+
+            struct trafgen_lwip_conn *c = &trafgen_lwip_conns[flow];
+
+            if (c->connected && tcp_sndbuf(c->pcb) >= size && tcp_sndqueuelen(c->pcb) < TCP_SND_QUEUELEN) {
+                conn = c;
+
+                break;
+            }
+        }
+
+        if (conn == NULL) {
+            break;
+        }
+
+        if (tcp_write(conn->pcb, trafgen_tx_message(flow), size, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            trafgen_count_error();
+
+            break;
+        }
+
+        trafgen_tx_sent(flow);
+        trafgen_lwip_next = flow + 1;
+        written |= 1u << flow;
+    }
+
+    for (uint flow = 0; written != 0; flow++, written >>= 1) {
+        if (written & 1) {
+            tcp_output(trafgen_lwip_conns[flow].pcb);
+        }
+    }
+}
+
+static void trafgen_lwip_udp_send(void) {
+    uint16_t size = trafgen_config.size;
+
+    for (uint n = 0; n < TRAFGEN_LWIP_UDP_BATCH && trafgen_tx_ready(); n++) {
+        uint flow = trafgen_lwip_next % trafgen_config.connections;
+        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, size, PBUF_RAM);
+
+        if (p == NULL) {
+            break;
+        }
+
+        pbuf_take(p, trafgen_tx_message(flow), size);
+
+        err_t err = udp_sendto(trafgen_lwip_udp_pcbs[flow], p, &trafgen_lwip_peer, trafgen_config.port);
+
+        pbuf_free(p);
+
+        if (err != ERR_OK) {
+            // sent again with the same sequence number, ERR_MEM is the driver being full
+            if (err != ERR_MEM) {
+                trafgen_count_error();
+            }
+
+            break;
+        }
+
+        trafgen_tx_sent(flow);
+        trafgen_lwip_next = flow + 1;
+    }
+}
+
+static err_t trafgen_lwip_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    struct trafgen_lwip_conn *conn = arg;
+
+    if (p == NULL) {
+        trafgen_lwip_close(conn);
+
+        return ERR_OK;
+    }
+
+    if (err != ERR_OK) {
+        pbuf_free(p);
+
+        return err;
+    }
+
+    if (trafgen_config.role == TRAFGEN_ROLE_SINK) {
+        for (struct pbuf *q = p; q != NULL; q = q->next) {
+            trafgen_rx_stream(&conn->stream, q->payload, q->len);
+        }
+    } else {
+        // whatever the sink sends back is dropped
+        trafgen_count_rx(p->tot_len);
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    return ERR_OK;
+}
+
+static err_t trafgen_lwip_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    trafgen_lwip_tcp_send();
+
+    return ERR_OK;
+}
+
+static void trafgen_lwip_err(void *arg, err_t err) {
+    // the pcb is already freed
+    trafgen_count_error();
+    trafgen_lwip_conn_free(arg);
+}
+
+static void trafgen_lwip_setup(struct trafgen_lwip_conn *conn, struct tcp_pcb *pcb) {
+    conn->pcb = pcb;
+
+    // every message goes out as it is written, its timestamp the time it was sent
+    tcp_nagle_disable(pcb);
+
+    tcp_arg(pcb, conn);
+    tcp_recv(pcb, trafgen_lwip_recv);
+    tcp_sent(pcb, trafgen_lwip_sent);
+    tcp_err(pcb, trafgen_lwip_err);
+}
+
+static err_t trafgen_lwip_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    struct trafgen_lwip_conn *conn = arg;
+
+    conn->connected = true;
+    trafgen_count_open();
+
+    trafgen_lwip_tcp_send();
+
+    return ERR_OK;
+}
+
+static void trafgen_lwip_connect(struct trafgen_lwip_conn *conn) {
+    struct tcp_pcb *pcb = tcp_new();
+
+    if (pcb == NULL) {
+        trafgen_count_error();
+        conn->closed_us = timebase_us();
+
+        return;
+    }
+
+    trafgen_lwip_setup(conn, pcb);
+
+    if (tcp_connect(pcb, &trafgen_lwip_peer, trafgen_config.port, trafgen_lwip_connected) != ERR_OK) {
+        trafgen_count_error();
+        trafgen_lwip_close(conn);
+    }
+}
+
+static err_t trafgen_lwip_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    struct trafgen_lwip_conn *conn = NULL;
+
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    for (int i = 0; i < TRAFGEN_FLOWS_MAX; i++) {
+        if (trafgen_lwip_conns[i].pcb == NULL) {
+            conn = &trafgen_lwip_conns[i];
+
+            break;
+        }
+    }
+
+    if (conn == NULL) {
+        trafgen_count_error();
+        tcp_abort(pcb);
+
+        return ERR_ABRT;
+    }
+
+    memset(conn, 0, sizeof(*conn));
+    trafgen_lwip_setup(conn, pcb);
+
+    conn->connected = true;
+    trafgen_count_open();
+
+    return ERR_OK;
+}
+
+static void trafgen_lwip_udp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    uint8_t header[TRAFGEN_HEADER_SIZE];
+
+    if (trafgen_config.role == TRAFGEN_ROLE_SINK) {
+        pbuf_copy_partial(p, header, sizeof(header), 0);
+        trafgen_rx_datagram(header, p->tot_len);
+    } else {
+        // the udp scenario of bench.h echoes them
+        trafgen_count_rx(p->tot_len);
+    }
+
+    pbuf_free(p);
+}
+
+void trafgen_stack_start(void) {
+    struct trafgen_config *c = &trafgen_config;
+
+    if (c->proto == TRAFGEN_PROTO_TCP && c->connections > MEMP_NUM_TCP_PCB) {
+        c->connections = MEMP_NUM_TCP_PCB;
+    }
+
+    IP_ADDR4(&trafgen_lwip_peer, c->peer[0], c->peer[1], c->peer[2], c->peer[3]);
+
+    if (c->proto == TRAFGEN_PROTO_UDP) {
+        // a pcb per flow, each from a port of its own
+        uint flows = (c->role == TRAFGEN_ROLE_SOURCE) ? c->connections : 1;
+
+        for (uint i = 0; i < flows; i++) {
+            struct udp_pcb *pcb = udp_new();
+            u16_t port = (c->role == TRAFGEN_ROLE_SOURCE) ? 0 : c->port;
+
+            if (pcb == NULL || udp_bind(pcb, IP_ADDR_ANY, port) != ERR_OK) {
+                trafgen_count_error();
+
+                return;
+            }
+
+            udp_recv(pcb, trafgen_lwip_udp_recv, NULL);
+            trafgen_lwip_udp_pcbs[i] = pcb;
+        }
+    } else if (c->role == TRAFGEN_ROLE_SINK) {
+        struct tcp_pcb *pcb = tcp_new();
+
+        if (pcb == NULL) {
+            trafgen_count_error();
+
+            return;
+        }
+
+        if (tcp_bind(pcb, IP_ADDR_ANY, c->port) != ERR_OK) {
+            trafgen_count_error();
+            tcp_close(pcb);
+
+            return;
+        }
+
+        trafgen_lwip_listen_pcb = tcp_listen(pcb);
+        tcp_accept(trafgen_lwip_listen_pcb, trafgen_lwip_accept);
+    } else {
+        // connected from the first trafgen_stack_poll()
+        for (uint i = 0; i < c->connections; i++) {
+            trafgen_lwip_conns[i].closed_us = timebase_us() - TRAFGEN_LWIP_RETRY_MS * 1000;
+        }
+    }
+
+    sys_timeout(TRAFGEN_LWIP_POLL_MS, trafgen_lwip_timer, NULL);
+}
+
+void trafgen_stack_poll(void) {
+    if (trafgen_config.role == TRAFGEN_ROLE_SINK) {
+        // lwIP calls back, there is nothing to poll
+        return;
+    }
+
+    if (trafgen_config.proto == TRAFGEN_PROTO_UDP) {
+        trafgen_lwip_udp_send();
+
+        return;
+    }
+
+    for (uint i = 0; i < trafgen_config.connections; i++) {
+        struct trafgen_lwip_conn *conn = &trafgen_lwip_conns[i];
+
+        if (conn->pcb == NULL && (timebase_us() - conn->closed_us) >= TRAFGEN_LWIP_RETRY_MS * 1000) {
+            trafgen_lwip_connect(conn);
+        }
+    }
+
+    // the pacing gave credit since the last sent() callback
+    trafgen_lwip_tcp_send();
+}
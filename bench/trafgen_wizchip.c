@@ -0,0 +1,236 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// trafgen.h on the ioLibrary socket API, polled from trafgen_poll() in main's loop
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "wizchip_conf.h"
+#include "socket.h"
+
+#include "timebase.h"
+
+#include "trafgen.h"
+
+// a source socket closed or refused is connected again after this
+#ifndef TRAFGEN_WIZCHIP_RETRY_MS
+#define TRAFGEN_WIZCHIP_RETRY_MS 1000
+#endif
+
+struct trafgen_wizchip_socket {
+    bool connected;
+    uint32_t opened_us;   // time the source last opened it
+    struct trafgen_stream stream;
+};
+
+static struct trafgen_wizchip_socket trafgen_wizchip_sockets[_WIZCHIP_SOCK_NUM_];
+static uint8_t trafgen_wizchip_sockets_used;
+static uint8_t trafgen_wizchip_next;   // socket of the next message
+
+// received data, read and counted
+static uint8_t trafgen_wizchip_buf[TRAFGEN_DATAGRAM_MAX];
+
+static void trafgen_wizchip_read(uint8_t sn, struct trafgen_wizchip_socket *s, uint16_t rsr) {
+    int32_t ret;
+
+    while (rsr != 0) {
+        if ((ret = recv(sn, trafgen_wizchip_buf, (rsr < sizeof(trafgen_wizchip_buf)) ? rsr : sizeof(trafgen_wizchip_buf))) <= 0) {
+            if (ret < 0) {
+                trafgen_count_error();
+            }
+
+            return;
+        }
+
+        if (trafgen_config.role == TRAFGEN_ROLE_SINK) {
+            trafgen_rx_stream(&s->stream, trafgen_wizchip_buf, ret);
+        } else {
+            // whatever the sink sends back is dropped
+            trafgen_count_rx(ret);
+        }
+
+        rsr -= ret;
+    }
+}
+
+static void trafgen_wizchip_tcp(uint8_t sn) {
+    struct trafgen_wizchip_socket *s = &trafgen_wizchip_sockets[sn];
+    uint8_t sr = getSn_SR(sn);
+
+    if (s->connected && sr != SOCK_ESTABLISHED) {
+        s->connected = false;
+
+        trafgen_count_close();
+    }
+
+    switch (sr) {
+    case SOCK_ESTABLISHED:
+        if (getSn_IR(sn) & Sn_IR_CON) {
+            setSn_IR(sn, Sn_IR_CON);
+        }
+
+        if (!s->connected) {
+            s->connected = true;
+            trafgen_stream_reset(&s->stream);
+
+            trafgen_count_open();
+        }
+
+        trafgen_wizchip_read(sn, s, getSn_RX_RSR(sn));
+        break;
+
+    case SOCK_CLOSE_WAIT:
+        // non-blocking, the socket is CLOSED once the FIN is acknowledged
+        disconnect(sn);
+        break;
+
+    case SOCK_INIT:
+        if (trafgen_config.role == TRAFGEN_ROLE_SINK) {
+            if (listen(sn) != SOCK_OK) {
+                trafgen_count_error();
+            }
+        } else {
+            // non-blocking, SOCK_BUSY until SYNSENT turns ESTABLISHED or the chip times out
+            int8_t ret = connect(sn, trafgen_config.peer, trafgen_config.port);
+
+            if (ret != SOCK_OK && ret != SOCK_BUSY) {
+                trafgen_count_error();
+                close(sn);
+            }
+        }
+        break;
+
+    case SOCK_CLOSED:
+        if (trafgen_config.role == TRAFGEN_ROLE_SINK) {
+            if (socket(sn, Sn_MR_TCP, trafgen_config.port, SF_IO_NONBLOCK | SF_TCP_NODELAY) != sn) {
+                trafgen_count_error();
+            }
+        } else if ((timebase_us() - s->opened_us) >= TRAFGEN_WIZCHIP_RETRY_MS * 1000) {
+            // from a port of the ioLibrary's own
+            s->opened_us = timebase_us();
+
+            if (socket(sn, Sn_MR_TCP, 0, SF_IO_NONBLOCK | SF_TCP_NODELAY) != sn) {
+                trafgen_count_error();
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void trafgen_wizchip_udp(uint8_t sn) {
+    uint8_t addr[4];
+    uint16_t port;
+    int32_t ret;
+
+    if (getSn_SR(sn) == SOCK_CLOSED) {
+        uint16_t local = (trafgen_config.role == TRAFGEN_ROLE_SINK) ? trafgen_config.port : 0;
+
+        if (socket(sn, Sn_MR_UDP, local, SF_IO_NONBLOCK) != sn) {
+            trafgen_count_error();
+        }
+
+        return;
+    }
+
+    // RX_RSR includes the 8 byte header of each datagram
+    while (getSn_RX_RSR(sn) != 0) {
+        if ((ret = recvfrom(sn, trafgen_wizchip_buf, sizeof(trafgen_wizchip_buf), addr, &port)) <= 0) {
+            if (ret < 0) {
+                trafgen_count_error();
+            }
+
+            return;
+        }
+
+        if (trafgen_config.role == TRAFGEN_ROLE_SINK) {
+            trafgen_rx_datagram(trafgen_wizchip_buf, ret);
+        } else {
+            // the udp scenario of bench.h echoes them
+            trafgen_count_rx(ret);
+        }
+    }
+}
+
+// messages while the pacing allows, taking turns on the sockets that take one
+static void trafgen_wizchip_send(void) {
+    uint8_t n = trafgen_wizchip_sockets_used;
+    uint8_t busy = 0;
+
+    while (busy < n && trafgen_tx_ready()) {
+        uint8_t sn = trafgen_wizchip_next;
+        int32_t ret;
+
+        trafgen_wizchip_next = (sn + 1) % n;
+
+        if (trafgen_config.proto == TRAFGEN_PROTO_TCP) {
+            if (!trafgen_wizchip_sockets[sn].connected) {
+                busy++;
+
+                continue;
+            }
+
+            // SOCK_BUSY while the TX buffer has no room for the message
+            ret = send(sn, (uint8_t *)trafgen_tx_message(sn), trafgen_config.size);
+        } else if (getSn_SR(sn) == SOCK_UDP) {
+            // SOCK_BUSY until the last datagram is out
+            ret = sendto(sn, (uint8_t *)trafgen_tx_message(sn), trafgen_config.size, trafgen_config.peer, trafgen_config.port);
+        } else {
+            busy++;
+
+            continue;
+        }
+
+        if (ret == trafgen_config.size) {
+            trafgen_tx_sent(sn);
+            busy = 0;
+        } else {
+            if (ret != SOCK_BUSY) {
+                trafgen_count_error();
+            }
+
+            busy++;
+        }
+    }
+}
+
+void trafgen_stack_start(void) {
+    struct trafgen_config *c = &trafgen_config;
+
+    if (c->connections > _WIZCHIP_SOCK_NUM_) {
+        c->connections = _WIZCHIP_SOCK_NUM_;
+    }
+
+    memset(trafgen_wizchip_sockets, 0, sizeof(trafgen_wizchip_sockets));
+
+    // a sink listens on every socket for TCP, the one port takes every flow for UDP
+    if (c->role == TRAFGEN_ROLE_SINK) {
+        trafgen_wizchip_sockets_used = (c->proto == TRAFGEN_PROTO_TCP) ? _WIZCHIP_SOCK_NUM_ : 1;
+    } else {
+        trafgen_wizchip_sockets_used = c->connections;
+    }
+
+    // opened by the first trafgen_stack_poll()
+    for (uint8_t sn = 0; sn < trafgen_wizchip_sockets_used; sn++) {
+        trafgen_wizchip_sockets[sn].opened_us = timebase_us() - TRAFGEN_WIZCHIP_RETRY_MS * 1000;
+    }
+}
+
+void trafgen_stack_poll(void) {
+    for (uint8_t sn = 0; sn < trafgen_wizchip_sockets_used; sn++) {
+        if (trafgen_config.proto == TRAFGEN_PROTO_TCP) {
+            trafgen_wizchip_tcp(sn);
+        } else {
+            trafgen_wizchip_udp(sn);
+        }
+    }
+
+    if (trafgen_config.role == TRAFGEN_ROLE_SOURCE) {
+        trafgen_wizchip_send();
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _BOOT_H_
+#define _BOOT_H_
+
+#include <stdint.h>
+
+#include "pico.h"
+#include "hardware/gpio.h"
+
+#if LIB_PICO_STDIO_USB
+#include "pico/stdio_usb.h"
+#endif
+
+#include "timebase.h"
+
+// Start-up of both firmwares without fixed sleeps: the network comes up as soon as the
+// chips are ready, and the console is only waited for when there is one to wait for.
+
+// VBUS sense of the Pico and the W5100S-EVB-Pico, high while a USB cable powers the board
+#ifndef BOOT_VBUS_PIN
+#define BOOT_VBUS_PIN 24
+#endif
+
+// longest wait of boot_stdio_wait() for a terminal on USB CDC, 0 never waits
+#ifndef BOOT_STDIO_USB_WAIT_MS
+#define BOOT_STDIO_USB_WAIT_MS 0
+#endif
+
+// With USB stdio, waits up to BOOT_STDIO_USB_WAIT_MS for a terminal to open the CDC port,
+// so it gets the start-up messages. Only with VBUS on BOOT_VBUS_PIN: a board on a power
+// supply starts at once, and so does one with UART stdio
+static inline void boot_stdio_wait(void) {
+#if LIB_PICO_STDIO_USB && BOOT_STDIO_USB_WAIT_MS
+    gpio_init(BOOT_VBUS_PIN);
+
+    if (gpio_get(BOOT_VBUS_PIN)) {
+        uint32_t start = timebase_ms();
+
+        // enumeration runs from the USB IRQ
+        while (!stdio_usb_connected() && (timebase_ms() - start) < BOOT_STDIO_USB_WAIT_MS) {
+            tight_loop_contents();
+        }
+    }
+#endif
+}
+
+#endif
@@ -0,0 +1,312 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "hardware/vreg.h"
+
+#if PICO_RP2350
+#include "hardware/structs/qmi.h"
+#else
+#include "hardware/structs/ssi.h"
+#endif
+
+#include "timebase.h"
+#include "clock_profile.h"
+
+#define CLOCK_PROFILE_RAM_WORDS (CLOCK_PROFILE_SELFTEST_RAM / 4)
+#define CLOCK_PROFILE_RAM_HALF (CLOCK_PROFILE_RAM_WORDS / 2)
+
+#if CLOCK_PROFILE_SELFTEST_RAM < 64 || CLOCK_PROFILE_SELFTEST_RAM % 8
+#error "CLOCK_PROFILE_SELFTEST_RAM must be a multiple of 8, 64 or more"
+#endif
+
+// clk_peri from clk_sys up to 200 MHz. The flash divider is the smallest that keeps SCK at
+// or under 133 MHz, the RP2040's SSI only divides by even numbers
+static const struct clock_profile clock_profiles[] = {
+#if PICO_RP2350
+    { CLOCK_PROFILE_RATED_KHZ, VREG_VOLTAGE_DEFAULT, 2, 1 },
+    { 200000, VREG_VOLTAGE_1_15, 2, 1 },
+    { 250000, VREG_VOLTAGE_1_20, 2, 2 },
+    { 300000, VREG_VOLTAGE_1_30, 3, 2 },
+#else
+    { CLOCK_PROFILE_RATED_KHZ, VREG_VOLTAGE_DEFAULT, 2, 1 },
+    { 200000, VREG_VOLTAGE_1_15, 2, 1 },
+    { 250000, VREG_VOLTAGE_1_20, 2, 0 },
+    { 300000, VREG_VOLTAGE_1_30, 4, 0 },
+#endif
+};
+
+static const struct clock_profile *clock_profile_current = &clock_profiles[0];
+static enum vreg_voltage clock_profile_vreg = VREG_VOLTAGE_DEFAULT;
+
+// of the image at the clock clock_profile_apply() was called at
+static uint32_t clock_profile_flash_crc;
+
+static uint32_t clock_profile_ram[CLOCK_PROFILE_RAM_WORDS];
+static uint32_t clock_profile_crc_table[256];
+static uint32_t clock_profile_dma_sink;
+
+#if !PICO_NO_FLASH
+// end of the image in flash, from the SDK's linker scripts
+extern char __flash_binary_end;
+#endif
+
+const struct clock_profile *clock_profile_get(uint32_t sys_khz) {
+    for (uint i = 0; i < count_of(clock_profiles); i++) {
+        if (clock_profiles[i].sys_khz == sys_khz) {
+            return &clock_profiles[i];
+        }
+    }
+
+    return NULL;
+}
+
+static uint clock_profile_flash_div_get(void) {
+#if PICO_RP2350
+    return (qmi_hw->m[0].timing & QMI_M0_TIMING_CLKDIV_BITS) >> QMI_M0_TIMING_CLKDIV_LSB;
+#else
+    return ssi_hw->baudr;
+#endif
+}
+
+// from RAM with interrupts off, XIP stalls while the flash interface is reconfigured
+static void __no_inline_not_in_flash_func(clock_profile_flash_div_set)(uint div) {
+    uint32_t irq = save_and_disable_interrupts();
+
+#if PICO_RP2350
+    qmi_hw->m[0].timing = (qmi_hw->m[0].timing & ~QMI_M0_TIMING_CLKDIV_BITS) | (div << QMI_M0_TIMING_CLKDIV_LSB);
+#else
+    // the SSI only takes a new divider while disabled, its XIP setup and the flash's
+    // continuous read mode stay as the boot stage 2 left them
+    ssi_hw->ssienr = 0;
+    ssi_hw->baudr = div;
+    ssi_hw->ssienr = 1;
+#endif
+
+    restore_interrupts(irq);
+}
+
+// CRC32R with the result reversed and inverted is the 802.3 CRC-32, as the RMII driver's
+// FCS check. Little endian 32-bit reads, len a multiple of 4
+static uint32_t clock_profile_dma_crc(const volatile void *src, uint32_t len) {
+    uint chan = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(chan);
+
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_sniff_enable(&config, true);
+
+    dma_sniffer_enable(chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    hw_set_bits(&dma_hw->sniff_ctrl, DMA_SNIFF_CTRL_OUT_REV_BITS | DMA_SNIFF_CTRL_OUT_INV_BITS);
+    dma_hw->sniff_data = 0xffffffff;
+
+    dma_channel_configure(chan, &config, &clock_profile_dma_sink, src, len / 4, true);
+    dma_channel_wait_for_finish_blocking(chan);
+
+    uint32_t crc = dma_hw->sniff_data;
+
+    dma_sniffer_disable();
+    dma_channel_unclaim(chan);
+
+    return crc;
+}
+
+static uint32_t clock_profile_crc32(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0xffffffff;
+
+    while (len--) {
+        crc = clock_profile_crc_table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+static uint32_t clock_profile_flash_len(void) {
+#if PICO_NO_FLASH
+    return 0;
+#else
+    return ((uintptr_t)&__flash_binary_end - XIP_BASE) & ~3u;
+#endif
+}
+
+// the image through the alias that neither hits nor fills the XIP cache, every byte
+// comes from the flash at the clock now
+static uint32_t clock_profile_flash_check(void) {
+    if (clock_profile_flash_len() == 0) {
+        return 0;
+    }
+
+    return clock_profile_dma_crc((const volatile void *)XIP_NOCACHE_NOALLOC_BASE, clock_profile_flash_len());
+}
+
+void clock_profile_apply(const struct clock_profile *profile) {
+    uint div = clock_profile_flash_div_get();
+
+    if (clock_profile_crc_table[1] == 0) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+
+            for (uint j = 0; j < 8; j++) {
+                crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+            }
+
+            clock_profile_crc_table[i] = crc;
+        }
+    }
+
+    clock_profile_flash_crc = clock_profile_flash_check();
+
+    // up: the voltage and the flash divider first, down: the clock first
+    if (profile->vreg > clock_profile_vreg) {
+        vreg_set_voltage(profile->vreg);
+        sleep_ms(10);
+    }
+
+    if (profile->flash_div > div) {
+        clock_profile_flash_div_set(profile->flash_div);
+    }
+
+    set_sys_clock_khz(profile->sys_khz, true);
+
+    if (profile->peri_div) {
+        clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLK_SYS,
+            profile->sys_khz * KHZ, profile->sys_khz * KHZ / profile->peri_div);
+    } else {
+        clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+            48 * MHZ, 48 * MHZ);
+    }
+
+    if (profile->vreg < clock_profile_vreg) {
+        vreg_set_voltage(profile->vreg);
+    }
+
+    clock_profile_vreg = profile->vreg;
+    clock_profile_current = profile;
+}
+
+// xorshift32, never 0 from a seed that isn't
+static inline uint32_t clock_profile_next(uint32_t x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return x;
+}
+
+static uint32_t clock_profile_ram_round(uint32_t seed, uint32_t *copy_us) {
+    uint32_t errors = 0;
+    uint32_t x = seed;
+    uint32_t start;
+
+    for (uint i = 0; i < CLOCK_PROFILE_RAM_WORDS; i++) {
+        x = clock_profile_next(x);
+        clock_profile_ram[i] = x;
+    }
+
+    x = seed;
+
+    for (uint i = 0; i < CLOCK_PROFILE_RAM_WORDS; i++) {
+        x = clock_profile_next(x);
+        errors += clock_profile_ram[i] != x;
+    }
+
+    start = timebase_us();
+    memcpy(&clock_profile_ram[CLOCK_PROFILE_RAM_HALF], clock_profile_ram, CLOCK_PROFILE_RAM_HALF * 4);
+    *copy_us += timebase_us() - start;
+
+    for (uint i = 0; i < CLOCK_PROFILE_RAM_HALF; i++) {
+        errors += clock_profile_ram[CLOCK_PROFILE_RAM_HALF + i] != clock_profile_ram[i];
+    }
+
+    return errors;
+}
+
+uint32_t clock_profile_selftest(struct clock_profile_result *result, clock_profile_traffic_t traffic, void *arg) {
+    uint32_t flash_len = clock_profile_flash_len();
+    uint32_t crc_us = 0, copy_us = 0, flash_us = 0, traffic_us = 0;
+    uint32_t begin = timebase_us();
+    uint32_t elapsed, start, crc;
+
+    memset(result, 0, sizeof(*result));
+    result->sys_khz = clock_get_hz(clk_sys) / KHZ;
+
+    do {
+        uint32_t seed = (result->rounds + 1) * 2654435761u;
+
+        result->ram_errors += clock_profile_ram_round(seed ? seed : 1, &copy_us);
+
+        start = timebase_us();
+        crc = clock_profile_crc32((const uint8_t *)clock_profile_ram, sizeof(clock_profile_ram));
+        crc_us += timebase_us() - start;
+
+        result->crc_errors += crc != clock_profile_dma_crc(clock_profile_ram, sizeof(clock_profile_ram));
+
+        if (flash_len) {
+            start = timebase_us();
+            result->flash_errors += clock_profile_flash_check() != clock_profile_flash_crc;
+            flash_us += timebase_us() - start;
+        }
+
+        if (traffic) {
+            start = timebase_us();
+            result->traffic_errors += traffic(arg);
+            traffic_us += timebase_us() - start;
+        }
+
+        result->rounds++;
+        elapsed = timebase_us() - begin;
+    } while (elapsed < CLOCK_PROFILE_SELFTEST_MS * 1000u);
+
+    result->duration_ms = elapsed / 1000;
+
+    // bytes per ms are KB/s
+    if (crc_us) {
+        result->crc_kb_s = (uint64_t)result->rounds * sizeof(clock_profile_ram) * 1000 / crc_us;
+    }
+    if (copy_us) {
+        result->copy_kb_s = (uint64_t)result->rounds * CLOCK_PROFILE_RAM_HALF * 4 * 1000 / copy_us;
+    }
+    if (flash_us) {
+        result->flash_kb_s = (uint64_t)result->rounds * flash_len * 1000 / flash_us;
+    }
+    if (traffic_us) {
+        result->traffic_per_s = (uint64_t)result->rounds * 1000000 / traffic_us;
+    }
+
+    return result->ram_errors + result->crc_errors + result->flash_errors + result->traffic_errors;
+}
+
+void clock_profile_report(const struct clock_profile_result *result, const char *board, const char *build) {
+    const struct clock_profile *profile = clock_profile_current;
+    uint32_t errors = result->ram_errors + result->crc_errors + result->flash_errors + result->traffic_errors;
+    // 50 mV steps from 0.55 V on both chips
+    uint32_t vreg_mv = 550 + 50 * (uint32_t)profile->vreg;
+    uint32_t duration_ms = result->duration_ms ? result->duration_ms : 1;
+
+    printf("clock %lu MHz at %lu.%02lu V, flash /%u: %lu rounds in %lu ms, %s, ram %lu, crc %lu, flash %lu, traffic %lu errors, "
+        "crc32 %lu KB/s, memcpy %lu KB/s, flash %lu KB/s, traffic %lu/s\n",
+        (unsigned long)(result->sys_khz / 1000), (unsigned long)(vreg_mv / 1000), (unsigned long)(vreg_mv % 1000 / 10),
+        clock_profile_flash_div_get(), (unsigned long)result->rounds, (unsigned long)result->duration_ms,
+        errors ? "FAILED" : "passed", (unsigned long)result->ram_errors, (unsigned long)result->crc_errors,
+        (unsigned long)result->flash_errors, (unsigned long)result->traffic_errors,
+        (unsigned long)result->crc_kb_s, (unsigned long)result->copy_kb_s, (unsigned long)result->flash_kb_s,
+        (unsigned long)result->traffic_per_s);
+
+    // the same record as bench/bench.c, the profile in its options
+    printf("bench %s clock_selftest result: {\"schema\":\"pico-bench/1\",\"source\":\"board\",\"board\":\"%s\","
+        "\"build\":\"%s\",\"clk_sys_hz\":%lu,\"clk_peri_hz\":%lu,\"options\":\"profile=%lu vreg_mv=%lu flash_div=%u\","
+        "\"scenario\":\"clock_selftest\",\"duration_ms\":%lu,\"rx_kbps\":null,\"tx_kbps\":null,\"ops_per_s\":%lu,"
+        "\"errors\":%lu,\"latency_us\":null,\"cpu_pct\":null}\n",
+        board, board, build, (unsigned long)clock_get_hz(clk_sys), (unsigned long)clock_get_hz(clk_peri),
+        (unsigned long)profile->sys_khz, (unsigned long)vreg_mv, clock_profile_flash_div_get(),
+        (unsigned long)result->duration_ms, (unsigned long)((uint64_t)result->rounds * 1000 / duration_ms),
+        (unsigned long)errors);
+}
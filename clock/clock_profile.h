@@ -0,0 +1,97 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _CLOCK_PROFILE_H_
+#define _CLOCK_PROFILE_H_
+
+#include <stdint.h>
+
+#include "pico.h"
+#include "hardware/vreg.h"
+
+// clk_sys profiles of both firmwares, each with the core voltage, flash clock and clk_peri
+// it was set up with, and a self-test to run at boot before a board is trusted with one.
+//
+// A profile is a clk_sys and what goes with it:
+// - the core voltage, raised before clk_sys goes up and lowered after it comes down
+// - the flash SCK divider, so XIP stays within the 133 MHz of the W25Q flash
+// - clk_peri, from clk_sys up to 200 MHz, above that from pll_usb's 48 MHz on the RP2040,
+//   whose clk_peri has no divider, and clk_sys / 2 on the RP2350
+//
+// The SPI and PIO dividers of the drivers are worked out from clock_get_hz() when they are
+// initialised, so a profile is applied first. Anything set up from the clocks before, a
+// UART's baud rate for one, has to be set up again.
+//
+// The self-test runs for CLOCK_PROFILE_SELFTEST_MS and checks, round after round:
+// - RAM: CLOCK_PROFILE_SELFTEST_RAM bytes written with a pseudo-random pattern and read
+//   back, then copied by memcpy() and compared
+// - checksums: a CRC-32 of that RAM by the CPU against the DMA sniffer's of the same bytes
+// - flash: the CRC-32 of the image read through the uncached XIP alias against the one
+//   clock_profile_apply() took at the clock it was called at
+// - traffic: a callback of the firmware's, through its network chip
+// and times each part, which clock_profile_report() prints as a benchmark of the profile.
+// The DMA sniffer is borrowed for the CRCs, so both run before a driver that keeps it, the
+// RMII driver's FCS check, is initialised.
+
+// clk_sys without an overclock
+#if PICO_RP2350
+#define CLOCK_PROFILE_RATED_KHZ 150000
+#else
+#define CLOCK_PROFILE_RATED_KHZ 133000
+#endif
+
+// for #if checks of a firmware's choice
+#define CLOCK_PROFILE_VALID(khz) \
+    ((khz) == CLOCK_PROFILE_RATED_KHZ || (khz) == 200000 || (khz) == 250000 || (khz) == 300000)
+
+#ifndef CLOCK_PROFILE_SELFTEST_MS
+#define CLOCK_PROFILE_SELFTEST_MS 1000
+#endif
+
+// RAM the self-test writes, half of it copied to the other half
+#ifndef CLOCK_PROFILE_SELFTEST_RAM
+#define CLOCK_PROFILE_SELFTEST_RAM 16384
+#endif
+
+struct clock_profile {
+    uint32_t sys_khz;
+    enum vreg_voltage vreg;
+    uint8_t flash_div;  // flash SCK = clk_sys / flash_div, a larger divider of the boot stage 2 stays
+    uint8_t peri_div;   // clk_peri = clk_sys / peri_div, 0 from pll_usb
+};
+
+struct clock_profile_result {
+    uint32_t sys_khz;         // clk_sys the test ran at
+    uint32_t rounds;
+    uint32_t duration_ms;
+    uint32_t ram_errors;      // words read back or copied wrong
+    uint32_t crc_errors;      // rounds the CPU's and the sniffer's CRC differed
+    uint32_t flash_errors;    // rounds the image's CRC changed
+    uint32_t traffic_errors;  // of the callback
+    uint32_t crc_kb_s;        // CRC-32 by the CPU, KB/s
+    uint32_t copy_kb_s;       // memcpy()
+    uint32_t flash_kb_s;      // image reads by the DMA
+    uint32_t traffic_per_s;   // callbacks
+};
+
+// A round of traffic through the network chip, called once per round of the self-test.
+// Errors found, 0 for a good round
+typedef uint32_t (*clock_profile_traffic_t)(void *arg);
+
+// The profile of clk_sys sys_khz, CLOCK_PROFILE_RATED_KHZ, 200000, 250000 or 300000, NULL
+// for any other
+const struct clock_profile *clock_profile_get(uint32_t sys_khz);
+
+// Switches to profile, from core 0 with core 1 not started yet: nothing may run from
+// flash while its divider changes. Takes the image's CRC for the self-test first
+void clock_profile_apply(const struct clock_profile *profile);
+
+// The self-test at the profile applied last, traffic may be NULL. The errors of all parts
+uint32_t clock_profile_selftest(struct clock_profile_result *result, clock_profile_traffic_t traffic, void *arg);
+
+// Prints result and the same as a pico-bench/1 record, "scenario":"clock_selftest", for
+// tools/bench_compare.py with a log per profile
+void clock_profile_report(const struct clock_profile_result *result, const char *board, const char *build);
+
+#endif
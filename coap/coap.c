@@ -0,0 +1,766 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "net.h"
+#include "timebase.h"
+#include "coap.h"
+
+#define COAP_VERSION 1
+
+enum coap_type {
+    COAP_CON,
+    COAP_NON,
+    COAP_ACK,
+    COAP_RST
+};
+
+// option numbers, the odd ones are critical
+#define COAP_OPT_IF_MATCH 1
+#define COAP_OPT_URI_HOST 3
+#define COAP_OPT_ETAG 4
+#define COAP_OPT_IF_NONE_MATCH 5
+#define COAP_OPT_OBSERVE 6
+#define COAP_OPT_URI_PORT 7
+#define COAP_OPT_URI_PATH 11
+#define COAP_OPT_CONTENT_FORMAT 12
+#define COAP_OPT_URI_QUERY 15
+#define COAP_OPT_ACCEPT 17
+#define COAP_OPT_BLOCK2 23
+#define COAP_OPT_BLOCK1 27
+#define COAP_OPT_SIZE2 28
+#define COAP_OPT_SIZE1 60
+
+#define COAP_PAYLOAD_MARKER 0xff
+
+#define COAP_BLOCK_MAX (16u << COAP_BLOCK_SZX)
+
+// most a response has ahead of its payload: Observe, Content-Format, Block2 and Size2
+#define COAP_OPTIONS_MAX 16
+
+#define COAP_MESSAGE_MAX (4 + 8 + COAP_OPTIONS_MAX + 1 + COAP_BLOCK_MAX)
+
+#define COAP_WELL_KNOWN ".well-known/core"
+
+enum coap_target_kind {
+    COAP_TARGET_RESOURCE,
+    COAP_TARGET_CONTENT,
+    COAP_TARGET_WELL_KNOWN
+};
+
+// what a path is served from
+struct coap_target {
+    uint8_t kind;
+    const struct coap_resource *resource;
+    struct coap_content content;
+};
+
+struct coap_request {
+    uint8_t type;
+    uint8_t code;
+    uint8_t tkl;
+    uint16_t mid;
+    const uint8_t *token;
+    char path[COAP_PATH_MAX + 1];
+    uint16_t path_len;
+    bool path_long;
+    int32_t observe;      // -1 without the option
+    int32_t accept;
+    uint16_t format;
+    bool block2;
+    uint32_t block2_num;
+    uint8_t block2_szx;
+    bool block1_more;
+    bool bad_option;      // a critical option the server does not process
+    const uint8_t *payload;
+    uint16_t payload_len;
+};
+
+struct coap_observer {
+    bool used;
+    uint8_t addr[4];
+    uint16_t port;
+    uint8_t tkl;
+    uint8_t token[8];
+    const struct coap_resource *resource;
+    uint8_t szx;
+    uint8_t count;        // notifications since the last confirmable one
+    bool pending;         // the last confirmable one is not acknowledged
+    uint16_t mid;         // of the last notification
+    uint8_t retransmissions;
+    uint32_t timeout_ms;
+    uint32_t sent_ms;     // of the last notification
+};
+
+// options written one after the other, each as a delta from the last
+struct coap_writer {
+    uint8_t *p;
+    uint16_t last;
+};
+
+// the bytes of a representation from offset, a block of what is made in full
+struct coap_window {
+    uint32_t pos;
+    uint32_t offset;
+    uint8_t *buf;
+    uint16_t len;
+};
+
+static struct {
+    const struct coap_resource *resources;
+    uint16_t count;
+    coap_content_find_t content;
+    int socket;
+    uint16_t mid;
+    uint32_t observe_seq;
+    struct coap_observer observers[COAP_OBSERVERS];
+    struct coap_stats stats;
+    uint8_t rx[NET_DATAGRAM_MAX];
+    uint8_t tx[COAP_MESSAGE_MAX];
+} coap = {.socket = NET_ERROR};
+
+static uint32_t coap_get_uint(const uint8_t *p, uint16_t len) {
+    uint32_t v = 0;
+
+    while (len--) {
+        v = (v << 8) | *p++;
+    }
+
+    return v;
+}
+
+// a delta or a length of the option header: its nibble, and the extended bytes at *ext
+static uint8_t coap_option_nibble(uint16_t v, uint8_t **ext) {
+    if (v < 13) {
+        return v;
+    }
+
+    if (v < 269) {
+        *(*ext)++ = v - 13;
+
+        return 13;
+    }
+
+    *(*ext)++ = (v - 269) >> 8;
+    *(*ext)++ = v - 269;
+
+    return 14;
+}
+
+static void coap_put_option(struct coap_writer *w, uint16_t number, const uint8_t *value, uint16_t len) {
+    uint8_t *head = w->p++;
+    uint8_t delta = coap_option_nibble(number - w->last, &w->p);
+
+    *head = (delta << 4) | coap_option_nibble(len, &w->p);
+
+    memcpy(w->p, value, len);
+    w->p += len;
+    w->last = number;
+}
+
+// in as few bytes as it takes, none for 0
+static void coap_put_uint_option(struct coap_writer *w, uint16_t number, uint32_t v) {
+    uint8_t value[4] = {v >> 24, v >> 16, v >> 8, v};
+    uint16_t skip = 0;
+
+    while (skip < 4 && value[skip] == 0) {
+        skip++;
+    }
+
+    coap_put_option(w, number, value + skip, 4 - skip);
+}
+
+// a delta or a length after its nibble, -1 when malformed
+static int32_t coap_get_nibble(uint8_t nibble, const uint8_t **p, const uint8_t *end) {
+    int32_t v;
+
+    switch (nibble) {
+    case 13:
+        if (end - *p < 1) {
+            return -1;
+        }
+
+        v = 13 + (*p)[0];
+        *p += 1;
+
+        return v;
+    case 14:
+        if (end - *p < 2) {
+            return -1;
+        }
+
+        v = 269 + (((*p)[0] << 8) | (*p)[1]);
+        *p += 2;
+
+        return v;
+    case 15:
+        return -1;
+    default:
+        return nibble;
+    }
+}
+
+// the header and options of a message, false when it is malformed
+static bool coap_parse(const uint8_t *msg, uint16_t len, struct coap_request *r) {
+    const uint8_t *end = msg + len;
+    const uint8_t *p;
+    uint16_t number = 0;
+
+    if (len < 4 || (msg[0] >> 6) != COAP_VERSION) {
+        return false;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->type = (msg[0] >> 4) & 3;
+    r->tkl = msg[0] & 0x0f;
+    r->code = msg[1];
+    r->mid = (msg[2] << 8) | msg[3];
+    r->token = msg + 4;
+    r->observe = -1;
+    r->accept = -1;
+    r->format = COAP_FORMAT_NONE;
+
+    if (r->tkl > 8 || len < 4 + r->tkl) {
+        return false;
+    }
+
+    p = msg + 4 + r->tkl;
+
+    while (p < end) {
+        if (*p == COAP_PAYLOAD_MARKER) {
+            r->payload = p + 1;
+            r->payload_len = end - p - 1;
+
+            // a marker without a payload is a format error
+            return r->payload_len != 0;
+        }
+
+        uint8_t head = *p++;
+        int32_t delta = coap_get_nibble(head >> 4, &p, end);
+        int32_t olen = coap_get_nibble(head & 0x0f, &p, end);
+
+        if (delta < 0 || olen < 0 || end - p < olen) {
+            return false;
+        }
+
+        number += delta;
+
+        switch (number) {
+        case COAP_OPT_URI_PATH:
+            if (r->path_len + 1 + olen > COAP_PATH_MAX) {
+                r->path_long = true;
+                break;
+            }
+
+            if (r->path_len != 0) {
+                r->path[r->path_len++] = '/';
+            }
+
+            memcpy(r->path + r->path_len, p, olen);
+            r->path_len += olen;
+            r->path[r->path_len] = 0;
+            break;
+        case COAP_OPT_OBSERVE:
+            r->observe = coap_get_uint(p, (olen < 3) ? olen : 3);
+            break;
+        case COAP_OPT_ACCEPT:
+            r->accept = coap_get_uint(p, (olen < 2) ? olen : 2);
+            break;
+        case COAP_OPT_CONTENT_FORMAT:
+            r->format = coap_get_uint(p, (olen < 2) ? olen : 2);
+            break;
+        case COAP_OPT_BLOCK2: {
+            uint32_t v = coap_get_uint(p, (olen < 3) ? olen : 3);
+
+            r->block2 = true;
+            r->block2_num = v >> 4;
+            r->block2_szx = v & 7;
+            break;
+        }
+        case COAP_OPT_BLOCK1:
+            r->block1_more = (coap_get_uint(p, (olen < 3) ? olen : 3) >> 3) & 1;
+            break;
+        case COAP_OPT_URI_HOST:
+        case COAP_OPT_URI_PORT:
+        case COAP_OPT_URI_QUERY:
+            // the server is the host and port, and no resource takes a query
+            break;
+        default:
+            if (number & 1) {
+                r->bad_option = true;
+            }
+
+            break;
+        }
+
+        p += olen;
+    }
+
+    return true;
+}
+
+static void coap_window_put(struct coap_window *w, const char *s, uint16_t n) {
+    for (uint16_t i = 0; i < n; i++, w->pos++) {
+        if (w->pos >= w->offset && w->pos - w->offset < w->len) {
+            w->buf[w->pos - w->offset] = s[i];
+        }
+    }
+}
+
+// RFC 6690's links of the table, made again for each block
+static uint8_t coap_well_known(uint32_t offset, uint8_t *buf, uint16_t *len, uint32_t *size) {
+    struct coap_window w = {0, offset, buf, *len};
+    char attr[24];
+
+    for (uint16_t i = 0; i < coap.count; i++) {
+        const struct coap_resource *r = &coap.resources[i];
+
+        coap_window_put(&w, (i != 0) ? ",</" : "</", (i != 0) ? 3 : 2);
+        coap_window_put(&w, r->path, strlen(r->path));
+        coap_window_put(&w, ">", 1);
+
+        if (r->format != COAP_FORMAT_NONE) {
+            coap_window_put(&w, attr, snprintf(attr, sizeof(attr), ";ct=%u", r->format));
+        }
+
+        if (r->observable) {
+            coap_window_put(&w, ";obs", 4);
+        }
+    }
+
+    *size = w.pos;
+    *len = (w.pos > offset) ? ((w.pos - offset < *len) ? w.pos - offset : *len) : 0;
+
+    return COAP_CONTENT;
+}
+
+static bool coap_find(const char *path, struct coap_target *t) {
+    memset(t, 0, sizeof(*t));
+
+    for (uint16_t i = 0; i < coap.count; i++) {
+        if (strcmp(path, coap.resources[i].path) == 0) {
+            t->kind = COAP_TARGET_RESOURCE;
+            t->resource = &coap.resources[i];
+
+            return true;
+        }
+    }
+
+    if (strcmp(path, COAP_WELL_KNOWN) == 0) {
+        t->kind = COAP_TARGET_WELL_KNOWN;
+
+        return true;
+    }
+
+    if (coap.content != NULL && coap.content(path, &t->content)) {
+        t->kind = COAP_TARGET_CONTENT;
+
+        return true;
+    }
+
+    return false;
+}
+
+static uint16_t coap_target_format(const struct coap_target *t) {
+    switch (t->kind) {
+    case COAP_TARGET_RESOURCE:
+        return t->resource->format;
+    case COAP_TARGET_CONTENT:
+        return t->content.format;
+    default:
+        return COAP_FORMAT_LINK;
+    }
+}
+
+static uint8_t coap_target_read(const struct coap_target *t, uint32_t offset, uint8_t *buf, uint16_t *len,
+                                uint32_t *size) {
+    switch (t->kind) {
+    case COAP_TARGET_RESOURCE:
+        return t->resource->get(t->resource->arg, offset, buf, len, size);
+    case COAP_TARGET_CONTENT:
+        *size = t->content.len;
+        *len = (offset < t->content.len) ? ((t->content.len - offset < *len) ? t->content.len - offset : *len) : 0;
+        memcpy(buf, t->content.data + offset, *len);
+
+        return COAP_CONTENT;
+    default:
+        return coap_well_known(offset, buf, len, size);
+    }
+}
+
+// the header and token of a message, the options and payload go at w
+static void coap_start(struct coap_writer *w, uint8_t type, uint8_t code, uint16_t mid, const uint8_t *token,
+                       uint8_t tkl) {
+    coap.tx[0] = (COAP_VERSION << 6) | (type << 4) | tkl;
+    coap.tx[1] = code;
+    coap.tx[2] = mid >> 8;
+    coap.tx[3] = mid;
+    // no token on the RSTs, NULL isn't memcpy()'s even for 0 bytes
+    if (tkl) {
+        memcpy(coap.tx + 4, token, tkl);
+    }
+
+    w->p = coap.tx + 4 + tkl;
+    w->last = 0;
+}
+
+// block num of 16 << szx bytes of t's representation as the payload, with Observe when
+// observe is not -1, and the response code
+static uint8_t coap_represent(struct coap_writer *w, const struct coap_target *t, uint32_t num, uint8_t szx,
+                              bool block, int32_t observe) {
+    // read where the payload may go at the latest, moved down behind the options after
+    uint8_t *payload = w->p + COAP_OPTIONS_MAX + 1;
+    uint32_t offset = num << (szx + 4);
+    uint16_t len = 16u << szx;
+    uint32_t size = 0;
+    uint16_t format = coap_target_format(t);
+    uint8_t code = coap_target_read(t, offset, payload, &len, &size);
+
+    if (code != COAP_CONTENT) {
+        return code;
+    }
+
+    if (offset != 0 && offset >= size) {
+        // past the end of the representation
+        return COAP_BAD_OPTION;
+    }
+
+    bool more = offset + len < size;
+
+    if (observe >= 0) {
+        coap_put_uint_option(w, COAP_OPT_OBSERVE, observe & 0xffffff);
+    }
+
+    if (format != COAP_FORMAT_NONE) {
+        coap_put_uint_option(w, COAP_OPT_CONTENT_FORMAT, format);
+    }
+
+    if (block || more) {
+        coap_put_uint_option(w, COAP_OPT_BLOCK2, (num << 4) | (more << 3) | szx);
+        coap.stats.blocks++;
+
+        if (num == 0) {
+            coap_put_uint_option(w, COAP_OPT_SIZE2, size);
+        }
+    }
+
+    if (len != 0) {
+        *w->p++ = COAP_PAYLOAD_MARKER;
+        memmove(w->p, payload, len);
+        w->p += len;
+    }
+
+    return COAP_CONTENT;
+}
+
+static void coap_send(const struct coap_writer *w, const uint8_t addr[4], uint16_t port) {
+    if (net_sendto(coap.socket, coap.tx, w->p - coap.tx, addr, port) < 0) {
+        coap.stats.unsent++;
+    }
+}
+
+static struct coap_observer *coap_observer_find(const uint8_t addr[4], uint16_t port, const uint8_t *token,
+                                                uint8_t tkl) {
+    for (int i = 0; i < COAP_OBSERVERS; i++) {
+        struct coap_observer *o = &coap.observers[i];
+
+        if (o->used && o->port == port && memcmp(o->addr, addr, 4) == 0 && o->tkl == tkl &&
+            memcmp(o->token, token, tkl) == 0) {
+            return o;
+        }
+    }
+
+    return NULL;
+}
+
+// the client's entry for its token, a new one or NULL when there is no room
+static struct coap_observer *coap_observer_add(const struct coap_request *r, const struct coap_resource *resource,
+                                               const uint8_t addr[4], uint16_t port, uint8_t szx) {
+    struct coap_observer *o = coap_observer_find(addr, port, r->token, r->tkl);
+
+    for (int i = 0; o == NULL && i < COAP_OBSERVERS; i++) {
+        if (!coap.observers[i].used) {
+            o = &coap.observers[i];
+            coap.stats.observers++;
+        }
+    }
+
+    if (o == NULL) {
+        return NULL;
+    }
+
+    memset(o, 0, sizeof(*o));
+    o->used = true;
+    memcpy(o->addr, addr, 4);
+    o->port = port;
+    o->tkl = r->tkl;
+    memcpy(o->token, r->token, r->tkl);
+    o->resource = resource;
+    o->szx = szx;
+    o->sent_ms = timebase_ms();
+
+    return o;
+}
+
+static void coap_observer_remove(struct coap_observer *o, bool lost) {
+    o->used = false;
+    coap.stats.observers--;
+
+    if (lost) {
+        coap.stats.observers_lost++;
+    }
+}
+
+// the representation to an observer, its last confirmable one again when retransmit
+static void coap_notify_one(struct coap_observer *o, bool retransmit) {
+    struct coap_target t = {.kind = COAP_TARGET_RESOURCE, .resource = o->resource};
+    struct coap_writer w;
+    bool con = retransmit || o->pending || ++o->count >= COAP_OBSERVE_CON_EVERY;
+
+    if (!retransmit) {
+        // a new state replaces the one a confirmable notification waits to deliver
+        o->mid = coap.mid++;
+
+        if (con && !o->pending) {
+            o->pending = true;
+            o->retransmissions = 0;
+            o->timeout_ms = COAP_ACK_TIMEOUT_MS;
+            o->count = 0;
+        }
+    }
+
+    coap_start(&w, con ? COAP_CON : COAP_NON, COAP_CONTENT, o->mid, o->token, o->tkl);
+
+    uint8_t code = coap_represent(&w, &t, 0, o->szx, false, ++coap.observe_seq);
+
+    o->sent_ms = timebase_ms();
+    coap.stats.notifications++;
+
+    if (con) {
+        coap.stats.confirmable++;
+    }
+
+    if (code != COAP_CONTENT) {
+        // an error ends the observation
+        coap.tx[1] = code;
+        w.p = coap.tx + 4 + o->tkl;
+        coap_send(&w, o->addr, o->port);
+        coap_observer_remove(o, false);
+
+        return;
+    }
+
+    coap_send(&w, o->addr, o->port);
+}
+
+void coap_notify(const struct coap_resource *resource) {
+    for (int i = 0; i < COAP_OBSERVERS; i++) {
+        struct coap_observer *o = &coap.observers[i];
+
+        if (o->used && o->resource == resource) {
+            coap_notify_one(o, false);
+        }
+    }
+}
+
+// retransmissions of the confirmable notifications, and the periodic ones
+static void coap_observers_run(void) {
+    uint32_t now = timebase_ms();
+
+    for (int i = 0; i < COAP_OBSERVERS; i++) {
+        struct coap_observer *o = &coap.observers[i];
+
+        if (!o->used) {
+            continue;
+        }
+
+        if (o->pending && now - o->sent_ms >= o->timeout_ms) {
+            if (o->retransmissions == COAP_MAX_RETRANSMIT) {
+                coap_observer_remove(o, true);
+                continue;
+            }
+
+            o->retransmissions++;
+            o->timeout_ms *= 2;
+            coap.stats.retransmissions++;
+            coap_notify_one(o, true);
+        } else if (o->resource->notify_ms != 0 && now - o->sent_ms >= o->resource->notify_ms) {
+            coap_notify_one(o, false);
+        }
+    }
+}
+
+// an empty ACK or RST of a client for a notification
+static void coap_reply(const struct coap_request *r, const uint8_t addr[4], uint16_t port) {
+    for (int i = 0; i < COAP_OBSERVERS; i++) {
+        struct coap_observer *o = &coap.observers[i];
+
+        if (o->used && o->mid == r->mid && o->port == port && memcmp(o->addr, addr, 4) == 0) {
+            if (r->type == COAP_RST) {
+                coap_observer_remove(o, true);
+            } else {
+                o->pending = false;
+            }
+
+            return;
+        }
+    }
+
+    coap.stats.ignored++;
+}
+
+static void coap_request(const struct coap_request *r, const uint8_t addr[4], uint16_t port) {
+    struct coap_target t;
+    struct coap_writer w;
+    struct coap_observer *o = NULL;
+    uint8_t code;
+
+    coap.stats.requests++;
+
+    // piggybacked on the ACK of a confirmable request, on its own for a non-confirmable one
+    coap_start(&w, (r->type == COAP_CON) ? COAP_ACK : COAP_NON, 0, (r->type == COAP_CON) ? r->mid : coap.mid++,
+               r->token, r->tkl);
+
+    if (r->bad_option) {
+        code = COAP_BAD_OPTION;
+    } else if (r->path_long || !coap_find(r->path, &t)) {
+        code = COAP_NOT_FOUND;
+    } else if (r->code == COAP_GET) {
+        uint32_t num = 0;
+        uint8_t szx = COAP_BLOCK_SZX;
+
+        if (r->block2 && r->block2_szx < szx) {
+            szx = r->block2_szx;
+        }
+
+        if (r->block2) {
+            // the block of the client's size that holds the same offset, when it is larger
+            num = r->block2_num << (r->block2_szx - szx);
+        }
+
+        if ((t.kind == COAP_TARGET_CONTENT && t.content.encoded) ||
+            (r->accept >= 0 && r->accept != coap_target_format(&t))) {
+            code = COAP_NOT_ACCEPTABLE;
+        } else if (r->block2 && r->block2_szx == 7) {
+            code = COAP_BAD_REQUEST;
+        } else {
+            int32_t observe = -1;
+
+            if (t.kind == COAP_TARGET_RESOURCE && t.resource->observable && r->observe == 0 && num == 0) {
+                // without the option in the response, the client knows it is not registered
+                if ((o = coap_observer_add(r, t.resource, addr, port, szx)) != NULL) {
+                    observe = ++coap.observe_seq;
+                }
+            } else if (r->observe == 1 && (o = coap_observer_find(addr, port, r->token, r->tkl)) != NULL) {
+                coap_observer_remove(o, false);
+                o = NULL;
+            }
+
+            code = coap_represent(&w, &t, num, szx, r->block2, observe);
+
+            if (code != COAP_CONTENT && o != NULL) {
+                coap_observer_remove(o, false);
+            }
+        }
+
+        if (t.kind == COAP_TARGET_CONTENT && code == COAP_CONTENT) {
+            coap.stats.contents++;
+        }
+    } else if (r->code == COAP_PUT && t.kind == COAP_TARGET_RESOURCE && t.resource->put != NULL) {
+        code = r->block1_more ? COAP_REQUEST_TOO_LARGE
+                              : t.resource->put(t.resource->arg, r->payload, r->payload_len, r->format);
+    } else {
+        code = COAP_METHOD_NOT_ALLOWED;
+    }
+
+    if (code != COAP_CONTENT) {
+        // no options or payload with an error, or with 2.04
+        w.p = coap.tx + 4 + r->tkl;
+    }
+
+    if ((code >> 5) >= 4) {
+        coap.stats.errors++;
+    }
+
+    coap.tx[1] = code;
+    coap_send(&w, addr, port);
+
+    if (code == COAP_CHANGED && t.resource->observable) {
+        coap_notify(t.resource);
+    }
+}
+
+static void coap_input(const uint8_t *msg, uint16_t len, const uint8_t addr[4], uint16_t port) {
+    struct coap_request r;
+    struct coap_writer w;
+
+    if (!coap_parse(msg, len, &r)) {
+        // a confirmable message is rejected, anything else is ignored
+        if (len >= 4 && (msg[0] >> 6) == COAP_VERSION && ((msg[0] >> 4) & 3) == COAP_CON) {
+            coap_start(&w, COAP_RST, 0, (msg[2] << 8) | msg[3], NULL, 0);
+            coap_send(&w, addr, port);
+        }
+
+        coap.stats.ignored++;
+
+        return;
+    }
+
+    if (r.code == 0) {
+        if (r.type == COAP_ACK || r.type == COAP_RST) {
+            coap_reply(&r, addr, port);
+        } else if (r.type == COAP_CON) {
+            // a ping
+            coap_start(&w, COAP_RST, 0, r.mid, NULL, 0);
+            coap_send(&w, addr, port);
+        } else {
+            coap.stats.ignored++;
+        }
+
+        return;
+    }
+
+    if ((r.code >> 5) != 0 || r.type == COAP_ACK || r.type == COAP_RST) {
+        // a response, the server asks nothing
+        coap.stats.ignored++;
+
+        return;
+    }
+
+    coap_request(&r, addr, port);
+}
+
+static void coap_service(void) {
+    uint8_t addr[4];
+    uint16_t port;
+    int32_t n;
+
+    while ((n = net_recvfrom(coap.socket, coap.rx, sizeof(coap.rx), addr, &port)) > 0) {
+        coap_input(coap.rx, n, addr, port);
+    }
+
+    coap_observers_run();
+}
+
+void coap_init(const struct coap_resource *resources, uint16_t count, coap_content_find_t content) {
+    coap.resources = resources;
+    coap.count = count;
+    coap.content = content;
+    coap.mid = timebase_ms();
+
+    net_init(coap_service);
+
+    coap.socket = net_udp_open(COAP_PORT);
+
+    printf("coap: port %d, %u resources%s, blocks of %u, %s\n", COAP_PORT, count,
+           (content != NULL) ? " and the HTTP content" : "", COAP_BLOCK_MAX, net_options());
+}
+
+void coap_get_stats(struct coap_stats *stats) {
+    *stats = coap.stats;
+}
@@ -0,0 +1,143 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _COAP_H_
+#define _COAP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "net.h"
+
+// CoAP server of both firmwares (RFC 7252), written once on net.h's UDP: lwIP's raw API
+// with net_lwip, or a socket of the W5100S with net_wizchip. A query is a datagram each
+// way, with no handshake, no connection and no socket per client, so any number of
+// pollers share the one socket.
+//
+// The resources are the application's table, looked up by their path. A path that is not
+// in it is looked up in the static content of the firmware's HTTP server, through a find
+// function: coap_web_pack.h for the ioLibrary httpServer's web pack, coap_fs.h for lwIP
+// httpd's fsdata. The same files are then served over both protocols. /.well-known/core
+// lists the table (RFC 6690).
+//
+// A representation larger than a block goes out in blocks (RFC 7959 Block2), the client
+// asks for the next ones. GET with Observe (RFC 7641) registers the client for the
+// notifications of the resource: when a PUT changes it, when coap_notify() tells of a
+// change, and every notify_ms of the resource for a value that always changes, as a
+// sensor's or a clock's. They are non-confirmable, every COAP_OBSERVE_CON_EVERY-th one
+// is confirmable, and a client that does not acknowledge it through COAP_MAX_RETRANSMIT
+// retransmissions, or resets a notification, is dropped.
+//
+// GET and PUT are idempotent, so a retransmitted request is answered again rather than
+// from a cache of the exchanges.
+
+#ifndef COAP_PORT
+#define COAP_PORT 5683
+#endif
+
+// clients observing at once, over all the resources
+#ifndef COAP_OBSERVERS
+#define COAP_OBSERVERS 8
+#endif
+
+// largest block, 16 << COAP_BLOCK_SZX bytes: 1024, the most RFC 7959 has
+#ifndef COAP_BLOCK_SZX
+#define COAP_BLOCK_SZX 6
+#endif
+
+#ifndef COAP_OBSERVE_CON_EVERY
+#define COAP_OBSERVE_CON_EVERY 8
+#endif
+
+// RFC 7252's transmission parameters, the timeout doubles with each retransmission
+#ifndef COAP_ACK_TIMEOUT_MS
+#define COAP_ACK_TIMEOUT_MS 2000
+#endif
+
+#ifndef COAP_MAX_RETRANSMIT
+#define COAP_MAX_RETRANSMIT 4
+#endif
+
+// longest path, its segments joined with '/', without a leading one
+#define COAP_PATH_MAX 64
+
+#define COAP_CODE(class, detail) (((class) << 5) | (detail))
+
+// request methods
+#define COAP_GET COAP_CODE(0, 1)
+#define COAP_POST COAP_CODE(0, 2)
+#define COAP_PUT COAP_CODE(0, 3)
+#define COAP_DELETE COAP_CODE(0, 4)
+
+// response codes
+#define COAP_CHANGED COAP_CODE(2, 4)
+#define COAP_CONTENT COAP_CODE(2, 5)
+#define COAP_BAD_REQUEST COAP_CODE(4, 0)
+#define COAP_BAD_OPTION COAP_CODE(4, 2)
+#define COAP_NOT_FOUND COAP_CODE(4, 4)
+#define COAP_METHOD_NOT_ALLOWED COAP_CODE(4, 5)
+#define COAP_NOT_ACCEPTABLE COAP_CODE(4, 6)
+#define COAP_REQUEST_TOO_LARGE COAP_CODE(4, 13)
+#define COAP_INTERNAL_ERROR COAP_CODE(5, 0)
+
+// Content-Formats
+#define COAP_FORMAT_TEXT 0  // text/plain; charset=utf-8
+#define COAP_FORMAT_LINK 40 // application/link-format
+#define COAP_FORMAT_XML 41
+#define COAP_FORMAT_OCTETS 42
+#define COAP_FORMAT_JSON 50
+#define COAP_FORMAT_CBOR 60
+#define COAP_FORMAT_NONE 0xffff
+
+struct coap_resource {
+    const char *path;  // "sensors/temp", without the leading '/'
+    uint16_t format;
+    bool observable;
+    // up to *len bytes of the representation from offset into buf, their count at *len and
+    // the representation's size at *size. COAP_CONTENT or an error code
+    uint8_t (*get)(void *arg, uint32_t offset, uint8_t *buf, uint16_t *len, uint32_t *size);
+    // the representation a client puts, in one datagram. COAP_CHANGED, which notifies the
+    // observers, or an error code. NULL: read only
+    uint8_t (*put)(void *arg, const uint8_t *data, uint16_t len, uint16_t format);
+    void *arg;
+    // observable: each observer is also notified every notify_ms, 0 only on a change
+    uint32_t notify_ms;
+};
+
+// a file of the HTTP server's content, in flash: sent from data, a block at a time
+struct coap_content {
+    const uint8_t *data;
+    uint32_t len;
+    uint16_t format;
+    bool encoded;  // stored gzipped for HTTP, CoAP has no content coding for it: 4.06
+};
+
+// the content at path, false when there is none
+typedef bool (*coap_content_find_t)(const char *path, struct coap_content *content);
+
+struct coap_stats {
+    uint32_t requests;
+    uint32_t blocks;           // of the responses, blocks of a larger representation
+    uint32_t contents;         // of the responses, from the HTTP server's content
+    uint32_t errors;           // of the responses, 4.xx and 5.xx
+    uint32_t ignored;          // datagrams that were not CoAP, or an empty ACK or RST of nothing
+    uint32_t unsent;           // responses and notifications the stack had no room for
+    uint32_t observers;        // registered now
+    uint32_t notifications;
+    uint32_t confirmable;      // of them, confirmable
+    uint32_t retransmissions;
+    uint32_t observers_lost;   // dropped unacknowledged or reset
+};
+
+// serve the resources on COAP_PORT as net.h's service, after the network is up. content
+// may be NULL. resources are not copied
+void coap_init(const struct coap_resource *resources, uint16_t count, coap_content_find_t content);
+
+// tell the observers of resource of its new representation, in the service's context:
+// from a callback of the table, or from main's loop on the ioLibrary
+void coap_notify(const struct coap_resource *resource);
+
+void coap_get_stats(struct coap_stats *stats);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "timebase.h"
+#include "coap.h"
+#include "coap_demo.h"
+
+static uint32_t coap_demo_counter;
+
+// the window of a representation made in full at each request, they are a few bytes
+static uint8_t coap_demo_window(const char *text, uint32_t offset, uint8_t *buf, uint16_t *len, uint32_t *size) {
+    uint32_t n = strlen(text);
+
+    *size = n;
+    *len = (offset < n) ? ((n - offset < *len) ? n - offset : *len) : 0;
+    memcpy(buf, text + offset, *len);
+
+    return COAP_CONTENT;
+}
+
+static uint8_t coap_demo_get_uptime(void *arg, uint32_t offset, uint8_t *buf, uint16_t *len, uint32_t *size) {
+    char text[12];
+
+    (void)arg;
+
+    snprintf(text, sizeof(text), "%lu", (unsigned long)timebase_ms());
+
+    return coap_demo_window(text, offset, buf, len, size);
+}
+
+static uint8_t coap_demo_get_counter(void *arg, uint32_t offset, uint8_t *buf, uint16_t *len, uint32_t *size) {
+    char text[12];
+
+    (void)arg;
+
+    snprintf(text, sizeof(text), "%lu", (unsigned long)coap_demo_counter);
+
+    return coap_demo_window(text, offset, buf, len, size);
+}
+
+static uint8_t coap_demo_put_counter(void *arg, const uint8_t *data, uint16_t len, uint16_t format) {
+    char text[12];
+    char *end;
+
+    (void)arg;
+
+    if ((format != COAP_FORMAT_TEXT && format != COAP_FORMAT_NONE) || len == 0 || len >= sizeof(text)) {
+        return COAP_BAD_REQUEST;
+    }
+
+    memcpy(text, data, len);
+    text[len] = 0;
+
+    uint32_t v = strtoul(text, &end, 10);
+
+    if (*end != 0) {
+        return COAP_BAD_REQUEST;
+    }
+
+    coap_demo_counter = v;
+
+    return COAP_CHANGED;
+}
+
+static uint8_t coap_demo_get_stats(void *arg, uint32_t offset, uint8_t *buf, uint16_t *len, uint32_t *size) {
+    struct coap_stats s;
+    char text[288];
+
+    (void)arg;
+
+    coap_get_stats(&s);
+    snprintf(text, sizeof(text),
+             "{\"requests\":%lu,\"blocks\":%lu,\"contents\":%lu,\"errors\":%lu,\"ignored\":%lu,\"unsent\":%lu,"
+             "\"observers\":%lu,\"notifications\":%lu,\"confirmable\":%lu,\"retransmissions\":%lu,"
+             "\"observers_lost\":%lu}",
+             (unsigned long)s.requests, (unsigned long)s.blocks, (unsigned long)s.contents, (unsigned long)s.errors,
+             (unsigned long)s.ignored, (unsigned long)s.unsent, (unsigned long)s.observers,
+             (unsigned long)s.notifications, (unsigned long)s.confirmable, (unsigned long)s.retransmissions,
+             (unsigned long)s.observers_lost);
+
+    return coap_demo_window(text, offset, buf, len, size);
+}
+
+static uint8_t coap_demo_get_blob(void *arg, uint32_t offset, uint8_t *buf, uint16_t *len, uint32_t *size) {
+    (void)arg;
+
+    *size = COAP_DEMO_BLOB;
+    *len = (offset < COAP_DEMO_BLOB) ? ((COAP_DEMO_BLOB - offset < *len) ? COAP_DEMO_BLOB - offset : *len) : 0;
+
+    for (uint16_t i = 0; i < *len; i++) {
+        buf[i] = offset + i;
+    }
+
+    return COAP_CONTENT;
+}
+
+static const struct coap_resource coap_demo_resources[] = {
+    {"uptime", COAP_FORMAT_TEXT, true, coap_demo_get_uptime, NULL, NULL, 1000},
+    {"counter", COAP_FORMAT_TEXT, true, coap_demo_get_counter, coap_demo_put_counter, NULL, 0},
+    {"stats", COAP_FORMAT_JSON, false, coap_demo_get_stats, NULL, NULL, 0},
+    {"blob", COAP_FORMAT_OCTETS, false, coap_demo_get_blob, NULL, NULL, 0},
+};
+
+void coap_demo_init(coap_content_find_t content) {
+    coap_init(coap_demo_resources, sizeof(coap_demo_resources) / sizeof(coap_demo_resources[0]), content);
+}
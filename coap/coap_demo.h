@@ -0,0 +1,24 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _COAP_DEMO_H_
+#define _COAP_DEMO_H_
+
+#include "coap.h"
+
+// The CoAP resources of both firmwares' coap examples, on coap.h:
+//  - uptime: the milliseconds since boot as text, observable, notified every second
+//  - counter: a number as text, PUT sets it and notifies its observers
+//  - stats: the server's counters as JSON
+//  - blob: COAP_DEMO_BLOB bytes of i & 0xff, in blocks
+// and the firmware's HTTP content after them. tools/coap_bench.py polls them
+
+#ifndef COAP_DEMO_BLOB
+#define COAP_DEMO_BLOB 4096
+#endif
+
+// serve the resources with coap_init(), after the network is up. content may be NULL
+void coap_demo_init(coap_content_find_t content);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "lwip/apps/fs.h"
+
+#include "coap.h"
+#include "coap_fs.h"
+
+static const struct {
+    const char *type;
+    uint16_t format;
+} coap_fs_formats[] = {
+    {"text/plain", COAP_FORMAT_TEXT},
+    {"application/json", COAP_FORMAT_JSON},
+    {"text/xml", COAP_FORMAT_XML},
+    {"application/xml", COAP_FORMAT_XML},
+    {"application/link-format", COAP_FORMAT_LINK},
+    {"application/cbor", COAP_FORMAT_CBOR},
+    {"application/octet-stream", COAP_FORMAT_OCTETS},
+    {"image/", COAP_FORMAT_OCTETS},
+};
+
+// the value of a header line of the header from h to end, NULL without it
+static const char *coap_fs_header(const char *h, const char *end, const char *name) {
+    size_t n = strlen(name);
+
+    for (; h < end; h++) {
+        if (h[-1] == '\n' && (size_t)(end - h) >= n && strncmp(h, name, n) == 0) {
+            return h + n;
+        }
+    }
+
+    return NULL;
+}
+
+bool coap_fs_find(const char *path, struct coap_content *content) {
+    char name[COAP_PATH_MAX + 2] = "/";
+    struct fs_file file;
+    const char *data;
+    const char *end;
+    const char *type;
+
+    strncpy(name + 1, path, COAP_PATH_MAX);
+
+    if (fs_open(&file, name) != ERR_OK) {
+        return false;
+    }
+
+    data = file.data;
+    content->data = (const uint8_t *)file.data;
+    content->len = file.len;
+    content->format = COAP_FORMAT_NONE;
+    content->encoded = false;
+
+    if (file.flags & FS_FILE_FLAGS_HEADER_INCLUDED) {
+        for (end = data; end + 4 <= data + file.len && memcmp(end, "\r\n\r\n", 4) != 0; end++) {
+        }
+
+        if (end + 4 > data + file.len) {
+            fs_close(&file);
+
+            return false;
+        }
+
+        content->data = (const uint8_t *)end + 4;
+        content->len = data + file.len - (end + 4);
+        content->encoded = coap_fs_header(data + 1, end, "Content-Encoding: gzip") != NULL;
+
+        if ((type = coap_fs_header(data + 1, end, "Content-Type: ")) != NULL) {
+            for (size_t i = 0; i < sizeof(coap_fs_formats) / sizeof(coap_fs_formats[0]); i++) {
+                if (strncmp(type, coap_fs_formats[i].type, strlen(coap_fs_formats[i].type)) == 0) {
+                    content->format = coap_fs_formats[i].format;
+                    break;
+                }
+            }
+        }
+    }
+
+    // the fsdata files stay in flash, the pointer outlives the handle
+    fs_close(&file);
+
+    return true;
+}
@@ -0,0 +1,21 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _COAP_FS_H_
+#define _COAP_FS_H_
+
+#include <stdbool.h>
+
+#include "coap.h"
+
+// The content of lwIP's httpd for coap.h: the fsdata of tools/makefsdata.py, opened with
+// fs_open() as httpd opens it. The HTTP header stored ahead of each file is skipped, its
+// Content-Type gives the Content-Format. A file makefsdata.py stored gzipped is HTTP's
+// only, CoAP has no content coding: the status files to share are best kept small enough
+// for it to leave them as they are
+
+// the coap_content_find_t of coap_init()
+bool coap_fs_find(const char *path, struct coap_content *content);
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "httpParser.h"
+#include "httpServer.h"
+
+#include "coap.h"
+#include "coap_web_pack.h"
+
+static const httpServer_webPack *coap_web_pack;
+
+// webPack_hash() of httpServer.c, static there: FNV-1a from a seeded basis and a final mix
+static uint32_t coap_web_pack_hash(uint32_t seed, const char *name) {
+    uint32_t hash = 2166136261u ^ seed;
+
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+static uint16_t coap_web_pack_format(uint8_t type) {
+    switch (type) {
+    case PTYPE_TEXT:
+        return COAP_FORMAT_TEXT;
+    case PTYPE_JSON:
+        return COAP_FORMAT_JSON;
+    case PTYPE_XML:
+        return COAP_FORMAT_XML;
+    case PTYPE_GIF:
+    case PTYPE_JPEG:
+    case PTYPE_PNG:
+    case PTYPE_ICO:
+    case PTYPE_PDF:
+        return COAP_FORMAT_OCTETS;
+    default:
+        // HTML, CSS and scripts have no Content-Format of their own
+        return COAP_FORMAT_NONE;
+    }
+}
+
+void coap_web_pack_register(const httpServer_webPack *pack) {
+    coap_web_pack = pack;
+}
+
+bool coap_web_pack_find(const char *path, struct coap_content *content) {
+    const httpServer_webPack *pack = coap_web_pack;
+    const httpServer_webContent *c;
+    int16_t d;
+    uint32_t num;
+
+    if (pack == NULL || pack->content_cnt == 0) {
+        return false;
+    }
+
+    d = pack->index[coap_web_pack_hash(0, path) % pack->content_cnt];
+    num = (d < 0) ? (uint32_t)(-1 - d) : coap_web_pack_hash(d, path) % pack->content_cnt;
+    c = &pack->content[num];
+
+    if (strcmp(path, (const char *)c->content_name) != 0) {
+        return false;
+    }
+
+    content->data = c->content;
+    content->len = c->content_len;
+    content->format = coap_web_pack_format(c->content_type);
+    content->encoded = c->content_gzip != 0;
+
+    return true;
+}
@@ -0,0 +1,25 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _COAP_WEB_PACK_H_
+#define _COAP_WEB_PACK_H_
+
+#include <stdbool.h>
+
+#include "httpServer.h"
+
+#include "coap.h"
+
+// The content of the ioLibrary httpServer for coap.h: the web pack of tools/web_pack.py,
+// found by its hash as find_webPack_content() of httpServer.c finds it, so a file costs
+// the same to look up over both protocols. The gzip variants are HTTP's only, CoAP has
+// no content coding
+
+// the pack, the one given to reg_httpServer_webPack()
+void coap_web_pack_register(const httpServer_webPack *pack);
+
+// the coap_content_find_t of coap_init()
+bool coap_web_pack_find(const char *path, struct coap_content *content);
+
+#endif
@@ -0,0 +1,262 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "compress.h"
+
+#if COMPRESS_WINDOW + COMPRESS_BLOCK_MAX > 0xffff
+#error "COMPRESS_WINDOW + COMPRESS_BLOCK_MAX must stay below 64 KB, the offsets of LZ4"
+#endif
+
+// shortest match, and the LZ4 block rules: the last match starts 12 bytes before the end
+// of the block at the latest, the last 5 bytes are literals
+#define COMPRESS_MIN_MATCH 4
+#define COMPRESS_MF_LIMIT 12
+#define COMPRESS_LAST_LITERALS 5
+
+// stored flag of a block's size in the frame
+#define COMPRESS_BLOCK_STORED 0x80000000u
+
+static const uint8_t compress_frame_head[COMPRESS_FRAME_HEAD_LEN] = { 0x04, 0x22, 0x4d, 0x18, 0x40, 0x40, 0xc0 };
+
+// the M0+ has no unaligned loads, byte loads it is
+static uint32_t compress_read32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void compress_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// Knuth's multiplicative hash, the RP2040's multiplier takes one cycle
+static uint32_t compress_hash(uint32_t seq) {
+    return (seq * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+}
+
+// a length of 15 or more, its remainder in bytes of 255 and the last below it
+static uint8_t *compress_length(uint8_t *op, size_t len) {
+    for (len -= 15; len >= 255; len -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (uint8_t)len;
+
+    return op;
+}
+
+// one sequence: the literals, then the match unless it is the last one
+static uint8_t *compress_sequence(uint8_t *op, const uint8_t *literals, size_t literal_len, uint16_t offset,
+                                  size_t match_len) {
+    uint8_t *token = op++;
+
+    *token = (uint8_t)((literal_len < 15 ? literal_len : 15) << 4);
+    if (literal_len >= 15) {
+        op = compress_length(op, literal_len);
+    }
+    memcpy(op, literals, literal_len);
+    op += literal_len;
+
+    if (match_len == 0) {
+        return op;
+    }
+
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+
+    match_len -= COMPRESS_MIN_MATCH;
+    *token |= (uint8_t)(match_len < 15 ? match_len : 15);
+    if (match_len >= 15) {
+        op = compress_length(op, match_len);
+    }
+
+    return op;
+}
+
+// The pending bytes as an LZ4 block into op, matched against the history and themselves.
+// Returns its length, up to COMPRESS_BOUND(pending) - 4
+static size_t compress_block(struct compress *c, uint8_t *op) {
+    const uint8_t *buf = c->buf;
+    uint8_t *start = op;
+    size_t end = (size_t)c->hist + c->pending;
+    size_t anchor = c->hist;
+    size_t i = c->hist;
+
+    if (c->pending > COMPRESS_MF_LIMIT) {
+        size_t mf_limit = end - COMPRESS_MF_LIMIT;
+        size_t match_limit = end - COMPRESS_LAST_LITERALS;
+
+        while (i < mf_limit) {
+            uint32_t seq = compress_read32(buf + i);
+            uint32_t h = compress_hash(seq);
+            uint16_t offset = (uint16_t)(c->base + i - c->hash[h]);
+            size_t m;
+
+            c->hash[h] = (uint16_t)(c->base + i);
+
+            // the table is only a hint: an entry may be stale or of another sequence, the
+            // bytes decide, anywhere in buf before i is history the decoder has too
+            if ((offset == 0) || (offset > i) || (compress_read32(buf + i - offset) != seq)) {
+                i++;
+                continue;
+            }
+
+            while ((i > anchor) && (i > offset) && (buf[i - 1] == buf[i - 1 - offset])) {
+                i--;
+            }
+
+            m = i + COMPRESS_MIN_MATCH;
+            while ((m < match_limit) && (buf[m] == buf[m - offset])) {
+                m++;
+            }
+
+            op = compress_sequence(op, buf + anchor, i - anchor, offset, m - i);
+            anchor = i = m;
+
+            // the end of the match is in the table for the next one, as LZ4 does
+            if (i < mf_limit) {
+                c->hash[compress_hash(compress_read32(buf + i - 2))] = (uint16_t)(c->base + i - 2);
+            }
+        }
+    }
+
+    op = compress_sequence(op, buf + anchor, end - anchor, 0, 0);
+
+    return (size_t)(op - start);
+}
+
+// the block written becomes history, the oldest of it beyond the window goes
+static void compress_advance(struct compress *c) {
+    c->hist += c->pending;
+    c->pending = 0;
+
+    if (c->hist > COMPRESS_WINDOW) {
+        size_t shift = c->hist - COMPRESS_WINDOW;
+
+        memmove(c->buf, c->buf + shift, COMPRESS_WINDOW);
+        c->base += shift;
+        c->hist = COMPRESS_WINDOW;
+    }
+}
+
+// back to the dictionary alone, its positions hashed again
+static void compress_restart(struct compress *c) {
+    c->base += (uint32_t)c->hist + c->pending;
+    c->hist = c->dict_len;
+    c->pending = 0;
+
+    if (c->dict_len != 0) {
+        memcpy(c->buf, c->dict, c->dict_len);
+    }
+
+    for (size_t i = 0; i + COMPRESS_MIN_MATCH <= c->dict_len; i++) {
+        c->hash[compress_hash(compress_read32(c->buf + i))] = (uint16_t)(c->base + i);
+    }
+}
+
+void compress_init(struct compress *c, const uint8_t *dict, size_t dict_len) {
+    // the end of a long dictionary, the nearest to the records
+    if (dict_len > COMPRESS_WINDOW) {
+        dict += dict_len - COMPRESS_WINDOW;
+        dict_len = COMPRESS_WINDOW;
+    }
+
+    memset(c->hash, 0, sizeof(c->hash));
+    c->base = 0;
+    c->hist = 0;
+    c->pending = 0;
+    c->dict = dict;
+    c->dict_len = dict ? (uint16_t)dict_len : 0;
+    c->framed = 0;
+    c->in_bytes = 0;
+    c->out_bytes = 0;
+
+    compress_restart(c);
+}
+
+size_t compress_write(struct compress *c, const void *data, size_t len) {
+    size_t room = compress_room(c);
+
+    if (len > room) {
+        len = room;
+    }
+
+    memcpy(c->buf + c->hist + c->pending, data, len);
+    c->pending += (uint16_t)len;
+
+    return len;
+}
+
+size_t compress_flush(struct compress *c) {
+    uint8_t *op = c->out;
+    size_t len;
+
+    if (c->pending == 0) {
+        return 0;
+    }
+
+    if (!c->framed) {
+        memcpy(op, compress_frame_head, COMPRESS_FRAME_HEAD_LEN);
+        op += COMPRESS_FRAME_HEAD_LEN;
+        c->framed = 1;
+    }
+
+    len = compress_block(c, op + 4);
+    if (len >= c->pending) {
+        len = c->pending;
+        memcpy(op + 4, c->buf + c->hist, len);
+        compress_put32(op, (uint32_t)len | COMPRESS_BLOCK_STORED);
+    } else {
+        compress_put32(op, (uint32_t)len);
+    }
+    op += 4 + len;
+
+    c->in_bytes += c->pending;
+    c->out_bytes += (uint32_t)(op - c->out);
+
+    compress_advance(c);
+
+    return (size_t)(op - c->out);
+}
+
+size_t compress_end(struct compress *c) {
+    if (!c->framed) {
+        return 0;
+    }
+
+    compress_put32(c->out, 0);
+    c->out_bytes += 4;
+    c->framed = 0;
+
+    compress_restart(c);
+
+    return 4;
+}
+
+size_t compress_message(struct compress *c, const void *data, size_t len) {
+    size_t block_len;
+
+    if (len > COMPRESS_BLOCK_MAX) {
+        return 0;
+    }
+
+    compress_restart(c);
+    c->framed = 0;
+
+    memcpy(c->buf + c->hist, data, len);
+    c->pending = (uint16_t)len;
+
+    compress_put32(c->out, (uint32_t)len);
+    block_len = compress_block(c, c->out + 4);
+
+    c->in_bytes += (uint32_t)len;
+    c->out_bytes += (uint32_t)(4 + block_len);
+
+    // the message isn't history, the next one starts from the dictionary again
+    c->pending = 0;
+
+    return 4 + block_len;
+}
@@ -0,0 +1,93 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _COMPRESS_H_
+#define _COMPRESS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming LZ77 compressor for telemetry, shared by both firmwares, in front of send(),
+// tcp_write() or an MQTT publish. Its output is LZ4's, so the host decodes it with the
+// stock tools: a stream is an LZ4 frame of linked blocks (`lz4 -d`, `lz4 -d -D dict` with
+// a dictionary), a message is a raw block after its little endian size (python-lz4's
+// lz4.block.decompress(), dict= with a dictionary). Static buffers in struct compress, no
+// allocation and no SDK, so the host builds it too.
+//
+// Matches reach back COMPRESS_WINDOW bytes, the dictionary included, and are found through
+// a hash of the 4 bytes at each position, the last position of a hash only: one probe per
+// byte, no chains. A stream of JSON records goes to about a quarter of its size, CSV to
+// under half; a short message gains only with a dictionary. examples/compress_bench of the
+// LAN8720 firmware measures the ratio and the cycles.
+
+// history the matches reach back into, and the most of the dictionary that is kept
+#ifndef COMPRESS_WINDOW
+#define COMPRESS_WINDOW 2048
+#endif
+
+// input of a block, compress_write() takes no more before a flush
+#ifndef COMPRESS_BLOCK_MAX
+#define COMPRESS_BLOCK_MAX 1024
+#endif
+
+// entries of the hash table are 1 << COMPRESS_HASH_BITS, 2 bytes each
+#ifndef COMPRESS_HASH_BITS
+#define COMPRESS_HASH_BITS 10
+#endif
+
+// LZ4 frame magic, FLG (version 1, linked blocks, no checksums) and BD (64 KB blocks),
+// then the checksum byte of the two
+#define COMPRESS_FRAME_HEAD_LEN 7
+
+// a block of the frame or a message, its 4 byte size and the worst case of n bytes that
+// don't compress, LZ4_COMPRESSBOUND()
+#define COMPRESS_BOUND(n) (4 + (n) + (n) / 255 + 16)
+
+#define COMPRESS_OUT_MAX (COMPRESS_FRAME_HEAD_LEN + COMPRESS_BOUND(COMPRESS_BLOCK_MAX))
+
+struct compress {
+    uint8_t buf[COMPRESS_WINDOW + COMPRESS_BLOCK_MAX]; // the history, then the input of the block
+    uint16_t hash[1 << COMPRESS_HASH_BITS];           // position of a hash, low 16 bits of base + index in buf
+    uint32_t base;                                     // position of buf[0]
+    uint16_t hist;                                     // bytes of history in buf
+    uint16_t pending;                                  // bytes of input after them
+    const uint8_t *dict;
+    uint16_t dict_len;
+    uint8_t framed;                                    // the frame head has been sent
+    uint8_t out[COMPRESS_OUT_MAX];                     // output of the last flush or message
+    uint32_t in_bytes;                                 // compressed, in total
+    uint32_t out_bytes;                                // output of them, heads included
+};
+
+// Starts a stream, with the dictionary as its history when dict isn't NULL: sample
+// records, their keys and the values that come back. dict is kept, not copied
+void compress_init(struct compress *c, const uint8_t *dict, size_t dict_len);
+
+// room left in the block
+static inline size_t compress_room(const struct compress *c) {
+    return COMPRESS_BLOCK_MAX - c->pending;
+}
+
+// Copies up to compress_room() bytes into the block. Returns the bytes taken, fewer than
+// len when the block is full: flush, send the block, then write the rest
+size_t compress_write(struct compress *c, const void *data, size_t len);
+
+// Compresses the written bytes into c->out as the next block of the frame, the frame head
+// before the first one. Returns its length, 0 when nothing was written. A block that
+// doesn't compress is stored as it is. c->out is overwritten by the next flush, the stream
+// goes on from the bytes written whether the block is sent or not: a stream that loses a
+// block starts again with compress_init()
+size_t compress_flush(struct compress *c);
+
+// The end mark of the frame into c->out, returns its length. The next flush starts a new
+// frame from the dictionary
+size_t compress_end(struct compress *c);
+
+// Compresses a message on its own into c->out: its size, little endian, then a block that
+// reaches back only into the dictionary, so each message decodes alone (MQTT, UDP).
+// Returns the length, 0 when len is over COMPRESS_BLOCK_MAX. Written bytes not flushed
+// are dropped, a stream doesn't mix with messages
+size_t compress_message(struct compress *c, const void *data, size_t len);
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "metrics.h"
+
+// "00" to "99", two digits per division by 100
+static const char metrics_pairs[200] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static uint8_t metrics_digits32(uint32_t v) {
+    if (v < 100000) {
+        return v < 10 ? 1 : v < 100 ? 2 : v < 1000 ? 3 : v < 10000 ? 4 : 5;
+    }
+
+    return v < 1000000 ? 6 : v < 10000000 ? 7 : v < 100000000 ? 8 : v < 1000000000 ? 9 : 10;
+}
+
+uint8_t metrics_digits(uint64_t v) {
+    uint8_t n = 0;
+
+    // most counters fit in 32 bits, the 64-bit compares and divisions only above
+    while (v > UINT32_MAX) {
+        v /= 1000000000;
+        n += 9;
+    }
+
+    return n + metrics_digits32((uint32_t)v);
+}
+
+// v's digits backwards from end, n of them, the leading ones zeros when v has fewer
+static void metrics_utoa32(char *end, uint32_t v, uint8_t n) {
+    while (n >= 2) {
+        const char *pair = &metrics_pairs[(v % 100) * 2];
+
+        v /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+        n -= 2;
+    }
+
+    if (n) {
+        *--end = (char)('0' + v % 10);
+    }
+}
+
+char *metrics_utoa(char *p, uint64_t v) {
+    char *end = p + metrics_digits(v);
+    char *q = end;
+
+    // 9 digits at a time in 32 bits
+    while (v > UINT32_MAX) {
+        metrics_utoa32(q, (uint32_t)(v % 1000000000), 9);
+        v /= 1000000000;
+        q -= 9;
+    }
+
+    metrics_utoa32(q, (uint32_t)v, metrics_digits32((uint32_t)v));
+
+    return end;
+}
+
+uint16_t metrics_section_values(const metrics_section_t *section) {
+    uint16_t n = 0;
+
+    for (uint16_t i = 0; i < section->count; i++) {
+        n += section->lines[i].sample;
+    }
+
+    return n;
+}
+
+static void metrics_rewind(metrics_scrape_t *scrape) {
+    scrape->offset = 0;
+    scrape->section = 0;
+    scrape->line = 0;
+    scrape->value = 0;
+    scrape->pos = 0;
+}
+
+uint32_t metrics_scrape_begin(metrics_scrape_t *scrape, const metrics_section_t *const *sections,
+                              uint8_t nsections, uint64_t *values) {
+    uint32_t length = 0;
+    uint64_t *v = values;
+
+    for (uint8_t s = 0; s < nsections; s++) {
+        const metrics_section_t *section = sections[s];
+
+        section->collect(v);
+
+        for (uint16_t i = 0; i < section->count; i++) {
+            length += section->lines[i].len;
+
+            if (section->lines[i].sample) {
+                length += metrics_digits(*v++) + 1;
+            }
+        }
+    }
+
+    scrape->sections = sections;
+    scrape->nsections = nsections;
+    scrape->values = values;
+    scrape->length = length;
+    metrics_rewind(scrape);
+
+    return length;
+}
+
+// bytes of the current line, its value and '\n' included
+static uint32_t metrics_line_len(const metrics_scrape_t *scrape, const metrics_line_t *line) {
+    return line->len + (line->sample ? metrics_digits(scrape->values[scrape->value]) + 1 : 0);
+}
+
+static void metrics_next_line(metrics_scrape_t *scrape, const metrics_line_t *line) {
+    scrape->value += line->sample;
+    scrape->pos = 0;
+
+    if (++scrape->line == scrape->sections[scrape->section]->count) {
+        scrape->line = 0;
+        scrape->section++;
+    }
+}
+
+// moves the cursor to offset by the lengths of the lines, nothing rendered
+static void metrics_seek(metrics_scrape_t *scrape, uint32_t offset) {
+    if (offset < scrape->offset) {
+        metrics_rewind(scrape);
+    }
+
+    while (scrape->offset < offset && scrape->section < scrape->nsections) {
+        const metrics_line_t *line = &scrape->sections[scrape->section]->lines[scrape->line];
+        uint32_t left = metrics_line_len(scrape, line) - scrape->pos;
+
+        if (offset - scrape->offset < left) {
+            scrape->pos += offset - scrape->offset;
+            scrape->offset = offset;
+        } else {
+            scrape->offset += left;
+            metrics_next_line(scrape, line);
+        }
+    }
+}
+
+size_t metrics_scrape_read(metrics_scrape_t *scrape, uint32_t offset, char *buf, size_t size) {
+    size_t n = 0;
+
+    if (offset != scrape->offset) {
+        metrics_seek(scrape, offset);
+    }
+
+    while (n < size && scrape->section < scrape->nsections) {
+        const metrics_line_t *line = &scrape->sections[scrape->section]->lines[scrape->line];
+
+        if (scrape->pos < line->len) {
+            size_t k = line->len - scrape->pos;
+
+            if (k > size - n) {
+                k = size - n;
+            }
+
+            memcpy(buf + n, line->text + scrape->pos, k);
+            n += k;
+            scrape->pos += k;
+
+            if (scrape->pos < line->len) {
+                break;
+            }
+        }
+
+        if (line->sample) {
+            uint64_t v = scrape->values[scrape->value];
+
+            if (scrape->pos == line->len && size - n > METRICS_DIGITS_MAX) {
+                // room for all of it, rendered in place
+                char *end = metrics_utoa(buf + n, v);
+
+                *end++ = '\n';
+                n = end - buf;
+            } else {
+                // split across reads, rendered aside and the part that fits copied
+                char tmp[METRICS_DIGITS_MAX + 1];
+                char *end = metrics_utoa(tmp, v);
+                size_t from = scrape->pos - line->len;
+                size_t k;
+
+                *end++ = '\n';
+                k = (end - tmp) - from;
+
+                if (k > size - n) {
+                    k = size - n;
+                }
+
+                memcpy(buf + n, tmp + from, k);
+                n += k;
+                scrape->pos += k;
+
+                if (from + k < (size_t)(end - tmp)) {
+                    break;
+                }
+            }
+        }
+
+        metrics_next_line(scrape, line);
+    }
+
+    scrape->offset += n;
+
+    return n;
+}
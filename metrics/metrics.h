@@ -0,0 +1,78 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Prometheus text format (0.0.4) of counters for the /metrics of lwIP's httpd and of the
+// W5100S httpServer. The text around the numbers is a template built at compile time:
+// the HELP and TYPE lines of each family and the name and labels of each sample are string
+// literals, only the values are rendered, by metrics_utoa(), two digits at a time. A scrape
+// takes the values once, so its length is known before the first byte and goes in the
+// Content-Length, then renders the text piece by piece straight into the buffers the
+// server writes to the connection, at the offset the last write left. No allocation, no
+// printf and no SDK, so the host builds it too.
+
+typedef struct metrics_line {
+    const char *text;
+    uint16_t len;
+    uint8_t sample;   // the text is a name and labels, a value and '\n' follow
+} metrics_line_t;
+
+// # HELP and # TYPE lines of a family, name and help string literals, type one of
+// "counter", "gauge" or "untyped"
+#define METRICS_FAMILY(name, type, help) \
+    { "# HELP " name " " help "\n# TYPE " name " " type "\n", \
+      sizeof("# HELP " name " " help "\n# TYPE " name " " type "\n") - 1, 0 }
+
+// a sample of the last family, series its name and labels: "name" or "name{label=\"v\"}"
+#define METRICS_SAMPLE(series) { series " ", sizeof(series " ") - 1, 1 }
+
+// longest value rendered, UINT64_MAX
+#define METRICS_DIGITS_MAX 20
+
+// The lines of a group of families and the function taking their values, one per sample
+// in the order of the lines
+typedef struct metrics_section {
+    const metrics_line_t *lines;
+    uint16_t count;
+    void (*collect)(uint64_t *values);
+} metrics_section_t;
+
+// samples of a section, the values its collect() writes
+uint16_t metrics_section_values(const metrics_section_t *section);
+
+// A scrape of sections: their values as collect() gave them and where the rendering is
+typedef struct metrics_scrape {
+    const metrics_section_t *const *sections;
+    uint8_t nsections;
+    const uint64_t *values;
+    uint32_t length;      // bytes of the text
+    uint32_t offset;      // of the next byte metrics_scrape_read() renders without a seek
+    uint8_t section;
+    uint16_t line;
+    uint16_t value;
+    uint16_t pos;         // in the line, its value and '\n' included
+} metrics_scrape_t;
+
+// Starts a scrape: the values of the sections into values, room for the
+// metrics_section_values() of all of them, and the length of the text, returned
+uint32_t metrics_scrape_begin(metrics_scrape_t *scrape, const metrics_section_t *const *sections,
+                              uint8_t nsections, uint64_t *values);
+
+// Renders up to size bytes of the text from offset, returns them, 0 at the end. Reads
+// following each other render from where the last one stopped, another offset walks the
+// lengths of the lines to it
+size_t metrics_scrape_read(metrics_scrape_t *scrape, uint32_t offset, char *buf, size_t size);
+
+// decimal digits of v, 1 for 0
+uint8_t metrics_digits(uint64_t v);
+
+// v in decimal at p, no terminator, returns the end
+char *metrics_utoa(char *p, uint64_t v);
+
+#endif
@@ -0,0 +1,471 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "net.h"
+#include "modbus.h"
+
+// a connection, and the frame it has split between two lends
+struct modbus_conn {
+    bool open;
+    uint16_t frame_len;   // bytes of frame held
+    uint16_t frame_size;  // its size, 0 until its header is held
+    uint8_t frame[MODBUS_FRAME_MAX];
+};
+
+// responses of one service, written at data and committed together
+struct modbus_tx {
+    uint8_t *data;
+    int32_t room;
+    uint16_t used;
+};
+
+static struct {
+    const struct modbus_range *map;
+    uint16_t ranges;
+    int listener;
+    struct modbus_stats stats;
+    struct modbus_conn conns[NET_SOCKETS];
+    uint8_t scratch[MODBUS_FRAME_MAX];
+} modbus = {.listener = NET_ERROR};
+
+uint16_t modbus_frame_size(const uint8_t *mbap) {
+    uint16_t len = modbus_get_u16(mbap + 4);
+
+    // the unit id and at least a function code, at most a 253 byte PDU
+    if (modbus_get_u16(mbap + 2) != 0 || len < 2 || len > MODBUS_FRAME_MAX - 6) {
+        return 0;
+    }
+
+    return 6 + len;
+}
+
+uint16_t modbus_response_size(const uint8_t *frame) {
+    const uint8_t *pdu = frame + MODBUS_MBAP_SIZE;
+    uint16_t qty;
+
+    // anything that is not answered in full is an exception, a function code and a byte
+    if (modbus_frame_size(frame) < MODBUS_MBAP_SIZE + 5) {
+        return MODBUS_MBAP_SIZE + 2;
+    }
+
+    qty = modbus_get_u16(pdu + 3);
+
+    switch (pdu[0]) {
+    case MODBUS_READ_COILS:
+    case MODBUS_READ_DISCRETE_INPUTS:
+        return (qty >= 1 && qty <= 2000) ? MODBUS_MBAP_SIZE + 2 + (qty + 7) / 8 : MODBUS_MBAP_SIZE + 2;
+    case MODBUS_READ_HOLDING_REGISTERS:
+    case MODBUS_READ_INPUT_REGISTERS:
+    case MODBUS_READ_WRITE_MULTIPLE_REGISTERS:
+        return (qty >= 1 && qty <= 125) ? MODBUS_MBAP_SIZE + 2 + 2 * qty : MODBUS_MBAP_SIZE + 2;
+    case MODBUS_WRITE_SINGLE_COIL:
+    case MODBUS_WRITE_SINGLE_REGISTER:
+    case MODBUS_WRITE_MULTIPLE_COILS:
+    case MODBUS_WRITE_MULTIPLE_REGISTERS:
+        return MODBUS_MBAP_SIZE + 5;
+    default:
+        return MODBUS_MBAP_SIZE + 2;
+    }
+}
+
+// the range of table that holds all of count items from addr
+static const struct modbus_range *modbus_find(const struct modbus_range *map, uint16_t ranges, uint8_t table,
+                                              uint16_t addr, uint16_t count) {
+    for (uint16_t i = 0; i < ranges; i++) {
+        const struct modbus_range *r = &map[i];
+
+        if (r->table == table && addr >= r->start && (uint32_t)addr + count <= (uint32_t)r->start + r->count) {
+            return r;
+        }
+    }
+
+    return NULL;
+}
+
+static const struct modbus_range *modbus_find_write(const struct modbus_range *map, uint16_t ranges, uint8_t table,
+                                                    uint16_t addr, uint16_t count) {
+    const struct modbus_range *r = modbus_find(map, ranges, table, addr, count);
+
+    return (r != NULL && r->write != NULL) ? r : NULL;
+}
+
+uint16_t modbus_respond(const struct modbus_range *map, uint16_t ranges, const uint8_t *frame, uint8_t *rsp) {
+    const uint8_t *pdu = frame + MODBUS_MBAP_SIZE;
+    uint16_t pdu_len = modbus_frame_size(frame) - MODBUS_MBAP_SIZE;
+    const struct modbus_range *r, *w;
+    uint16_t addr, qty, waddr, wqty;
+    uint8_t ex = MODBUS_EX_ILLEGAL_VALUE;
+    uint8_t bit;
+    uint16_t n = 0;  // bytes of the response's PDU after the function code, the writes
+                     // answer with their address and quantity, or value
+
+    // the transaction, protocol and unit ids, the length is the response's
+    memcpy(rsp, frame, MODBUS_MBAP_SIZE);
+    rsp[MODBUS_MBAP_SIZE] = pdu[0];
+
+    uint8_t *data = rsp + MODBUS_MBAP_SIZE + 1;
+
+    addr = (pdu_len >= 5) ? modbus_get_u16(pdu + 1) : 0;
+    qty = (pdu_len >= 5) ? modbus_get_u16(pdu + 3) : 0;
+
+    switch (pdu[0]) {
+    case MODBUS_READ_COILS:
+    case MODBUS_READ_DISCRETE_INPUTS:
+        if (pdu_len != 5 || qty < 1 || qty > 2000) {
+            break;
+        }
+
+        r = modbus_find(map, ranges, (pdu[0] == MODBUS_READ_COILS) ? MODBUS_COILS : MODBUS_DISCRETE_INPUTS, addr, qty);
+
+        if (r == NULL) {
+            ex = MODBUS_EX_ILLEGAL_ADDRESS;
+            break;
+        }
+
+        data[0] = (qty + 7) / 8;
+        memset(data + 1, 0, data[0]);
+
+        ex = r->read(r->arg, addr, qty, data + 1);
+        n = 1 + data[0];
+        break;
+
+    case MODBUS_READ_HOLDING_REGISTERS:
+    case MODBUS_READ_INPUT_REGISTERS:
+        if (pdu_len != 5 || qty < 1 || qty > 125) {
+            break;
+        }
+
+        r = modbus_find(map, ranges,
+                        (pdu[0] == MODBUS_READ_HOLDING_REGISTERS) ? MODBUS_HOLDING_REGISTERS : MODBUS_INPUT_REGISTERS,
+                        addr, qty);
+
+        if (r == NULL) {
+            ex = MODBUS_EX_ILLEGAL_ADDRESS;
+            break;
+        }
+
+        data[0] = 2 * qty;
+
+        ex = r->read(r->arg, addr, qty, data + 1);
+        n = 1 + data[0];
+        break;
+
+    case MODBUS_WRITE_SINGLE_COIL:
+        if (pdu_len != 5 || (qty != 0xff00 && qty != 0x0000)) {
+            break;
+        }
+
+        if ((r = modbus_find_write(map, ranges, MODBUS_COILS, addr, 1)) == NULL) {
+            ex = MODBUS_EX_ILLEGAL_ADDRESS;
+            break;
+        }
+
+        bit = (qty != 0);
+
+        ex = r->write(r->arg, addr, 1, &bit);
+        n = 4;
+        memcpy(data, pdu + 1, n);
+        break;
+
+    case MODBUS_WRITE_SINGLE_REGISTER:
+        if (pdu_len != 5) {
+            break;
+        }
+
+        if ((r = modbus_find_write(map, ranges, MODBUS_HOLDING_REGISTERS, addr, 1)) == NULL) {
+            ex = MODBUS_EX_ILLEGAL_ADDRESS;
+            break;
+        }
+
+        ex = r->write(r->arg, addr, 1, pdu + 3);
+        n = 4;
+        memcpy(data, pdu + 1, n);
+        break;
+
+    case MODBUS_WRITE_MULTIPLE_COILS:
+        if (pdu_len < 6 || pdu_len != 6 + pdu[5] || qty < 1 || qty > 1968 || pdu[5] != (qty + 7) / 8) {
+            break;
+        }
+
+        if ((r = modbus_find_write(map, ranges, MODBUS_COILS, addr, qty)) == NULL) {
+            ex = MODBUS_EX_ILLEGAL_ADDRESS;
+            break;
+        }
+
+        ex = r->write(r->arg, addr, qty, pdu + 6);
+        n = 4;
+        memcpy(data, pdu + 1, n);
+        break;
+
+    case MODBUS_WRITE_MULTIPLE_REGISTERS:
+        if (pdu_len < 6 || pdu_len != 6 + pdu[5] || qty < 1 || qty > 123 || pdu[5] != 2 * qty) {
+            break;
+        }
+
+        if ((r = modbus_find_write(map, ranges, MODBUS_HOLDING_REGISTERS, addr, qty)) == NULL) {
+            ex = MODBUS_EX_ILLEGAL_ADDRESS;
+            break;
+        }
+
+        ex = r->write(r->arg, addr, qty, pdu + 6);
+        n = 4;
+        memcpy(data, pdu + 1, n);
+        break;
+
+    case MODBUS_READ_WRITE_MULTIPLE_REGISTERS:
+        if (pdu_len < 10 || pdu_len != 10 + pdu[9]) {
+            break;
+        }
+
+        waddr = modbus_get_u16(pdu + 5);
+        wqty = modbus_get_u16(pdu + 7);
+
+        if (qty < 1 || qty > 125 || wqty < 1 || wqty > 121 || pdu[9] != 2 * wqty) {
+            break;
+        }
+
+        r = modbus_find(map, ranges, MODBUS_HOLDING_REGISTERS, addr, qty);
+        w = modbus_find_write(map, ranges, MODBUS_HOLDING_REGISTERS, waddr, wqty);
+
+        if (r == NULL || w == NULL) {
+            ex = MODBUS_EX_ILLEGAL_ADDRESS;
+            break;
+        }
+
+        // the write first, the read sees it
+        if ((ex = w->write(w->arg, waddr, wqty, pdu + 10)) != 0) {
+            break;
+        }
+
+        data[0] = 2 * qty;
+
+        ex = r->read(r->arg, addr, qty, data + 1);
+        n = 1 + data[0];
+        break;
+
+    default:
+        ex = MODBUS_EX_ILLEGAL_FUNCTION;
+        break;
+    }
+
+    if (ex != 0) {
+        rsp[MODBUS_MBAP_SIZE] |= 0x80;
+        data[0] = ex;
+        n = 1;
+    }
+
+    modbus_put_u16(rsp + 4, 2 + n);
+
+    return MODBUS_MBAP_SIZE + 1 + n;
+}
+
+static void modbus_tx_commit(int s, struct modbus_tx *tx) {
+    if (tx->used != 0) {
+        net_send_commit(s, tx->used);
+    }
+
+    tx->room = 0;
+    tx->used = 0;
+}
+
+// 1 when the frame is answered, 0 when there is no room for it yet, NET_CLOSED
+static int modbus_answer(int s, struct modbus_tx *tx, const uint8_t *frame) {
+    uint16_t need = modbus_response_size(frame);
+    uint8_t *rsp;
+
+    if (tx->room - tx->used < need) {
+        // what is written goes, then the next lend
+        modbus_tx_commit(s, tx);
+
+        tx->room = net_send_lend(s, &tx->data);
+
+        if (tx->room == NET_CLOSED || tx->room == NET_ERROR) {
+            tx->room = 0;
+
+            return NET_CLOSED;
+        }
+
+        if (tx->room < 0) {
+            tx->room = 0;
+        }
+    }
+
+    if (tx->room - tx->used >= need) {
+        rsp = tx->data + tx->used;
+        tx->used += modbus_respond(modbus.map, modbus.ranges, frame, rsp);
+    } else if (net_send_room(s) >= need) {
+        // lwIP's lend stops at the end of its ring, net_send() goes on from its start
+        rsp = modbus.scratch;
+        net_send(s, rsp, modbus_respond(modbus.map, modbus.ranges, frame, rsp));
+        tx->room = 0;
+    } else {
+        modbus.stats.deferred++;
+
+        return 0;
+    }
+
+    modbus.stats.requests++;
+
+    if (rsp[MODBUS_MBAP_SIZE] & 0x80) {
+        modbus.stats.exceptions++;
+    }
+
+    return 1;
+}
+
+// what the connection's held frame still needs from a lend of avail bytes, and a false
+// return when its header is not Modbus/TCP
+static bool modbus_hold(struct modbus_conn *c, const uint8_t *rx, uint16_t avail, uint16_t *taken) {
+    uint16_t want = (c->frame_size != 0) ? c->frame_size : MODBUS_MBAP_SIZE;
+    uint16_t n = want - c->frame_len;
+
+    if (n > avail) {
+        n = avail;
+    }
+
+    memcpy(c->frame + c->frame_len, rx, n);
+    c->frame_len += n;
+    *taken = n;
+
+    if (c->frame_size == 0 && c->frame_len == MODBUS_MBAP_SIZE) {
+        return (c->frame_size = modbus_frame_size(c->frame)) != 0;
+    }
+
+    return true;
+}
+
+static bool modbus_held(const struct modbus_conn *c) {
+    return c->frame_size != 0 && c->frame_len == c->frame_size;
+}
+
+// every request received that there is room to answer, false once the connection is to close
+static bool modbus_serve(int s, struct modbus_conn *c) {
+    struct modbus_tx tx = {NULL, 0, 0};
+    uint32_t answered = 0;
+    int ret = 1;
+    bool open = true;
+
+    // a split frame that waited for room
+    if (modbus_held(c)) {
+        if ((ret = modbus_answer(s, &tx, c->frame)) == 1) {
+            c->frame_len = c->frame_size = 0;
+            answered++;
+        }
+    }
+
+    while (ret == 1) {
+        const uint8_t *rx;
+        int32_t len = net_recv_lend(s, &rx);
+        uint16_t off = 0;
+        uint16_t n;
+
+        if (len <= 0) {
+            open = (len == NET_AGAIN);
+            break;
+        }
+
+        while (off < len && ret == 1) {
+            const uint8_t *frame = rx + off;
+            uint16_t avail = len - off;
+            uint16_t size;
+
+            if (c->frame_len == 0 && avail >= MODBUS_MBAP_SIZE) {
+                if ((size = modbus_frame_size(frame)) == 0) {
+                    ret = NET_ERROR;
+                    break;
+                }
+
+                if (size <= avail) {
+                    // whole in the lend, answered where it is
+                    if ((ret = modbus_answer(s, &tx, frame)) == 1) {
+                        off += size;
+                        answered++;
+                    }
+
+                    continue;
+                }
+            }
+
+            // split between this lend and the next, held until the rest comes
+            if (!modbus_hold(c, frame, avail, &n)) {
+                ret = NET_ERROR;
+                break;
+            }
+
+            off += n;
+
+            if (modbus_held(c)) {
+                modbus.stats.split++;
+
+                if ((ret = modbus_answer(s, &tx, c->frame)) == 1) {
+                    c->frame_len = c->frame_size = 0;
+                    answered++;
+                }
+            }
+        }
+
+        net_recv_release(s, off);
+    }
+
+    modbus_tx_commit(s, &tx);
+
+    if (answered != 0) {
+        modbus.stats.services++;
+
+        if (answered > modbus.stats.batch_max) {
+            modbus.stats.batch_max = answered;
+        }
+    }
+
+    if (ret == NET_ERROR) {
+        modbus.stats.dropped++;
+    }
+
+    return open && ret != NET_ERROR && ret != NET_CLOSED;
+}
+
+static void modbus_service(void) {
+    int s;
+
+    while ((s = net_accept(modbus.listener)) >= 0) {
+        memset(&modbus.conns[s], 0, sizeof(modbus.conns[s]));
+        modbus.conns[s].open = true;
+        modbus.stats.connections++;
+    }
+
+    for (s = 0; s < NET_SOCKETS; s++) {
+        struct modbus_conn *c = &modbus.conns[s];
+
+        if (!c->open) {
+            continue;
+        }
+
+        uint8_t ev = net_events(s);
+
+        if ((ev & NET_EV_HUP) || (((ev & NET_EV_IN) || modbus_held(c)) && !modbus_serve(s, c))) {
+            net_close(s);
+            c->open = false;
+        }
+    }
+}
+
+void modbus_init(const struct modbus_range *map, uint16_t ranges) {
+    modbus.map = map;
+    modbus.ranges = ranges;
+
+    net_init(modbus_service);
+
+    modbus.listener = net_listen(MODBUS_PORT, MODBUS_CONNECTIONS);
+
+    printf("modbus: port %d, %u ranges, %s\n", MODBUS_PORT, ranges, net_options());
+}
+
+void modbus_get_stats(struct modbus_stats *stats) {
+    *stats = modbus.stats;
+}
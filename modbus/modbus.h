@@ -0,0 +1,127 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _MODBUS_H_
+#define _MODBUS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "net.h"
+
+// Modbus/TCP server of both firmwares, written once on net.h: lwIP's raw API (the LAN8720,
+// or the W5100S in MACRAW) or the W5100S's own sockets, with net_lwip or net_wizchip.
+//
+// A service answers every request a connection has received, not one per poll. The frames
+// are parsed where the stack holds them, net_recv_lend(). The responses are written one
+// behind the other where the stack sends from, net_send_lend(), and committed together, so
+// a SCADA master that pipelines N requests gets N responses in one segment. Only a frame
+// split between two lends is copied, into the connection's frame buffer. A request whose
+// response finds no room waits, unread, until the master has taken the earlier ones.
+//
+// The registers are the application's: a table of ranges whose callbacks read into the
+// response and write from the request, in place. A request is served by the one range that
+// holds all of it, looked up in order, so the cost of a request depends only on its size
+// and its place in the table.
+
+#ifndef MODBUS_PORT
+#define MODBUS_PORT 502
+#endif
+
+// connections at once, the listener's backlog
+#ifndef MODBUS_CONNECTIONS
+#define MODBUS_CONNECTIONS NET_SOCKETS
+#endif
+
+// MBAP header: transaction id, protocol id 0, length of what follows, unit id. All big endian
+#define MODBUS_MBAP_SIZE 7
+
+// largest frame, the header and a 253 byte PDU
+#define MODBUS_FRAME_MAX 260
+
+// function codes
+#define MODBUS_READ_COILS 0x01
+#define MODBUS_READ_DISCRETE_INPUTS 0x02
+#define MODBUS_READ_HOLDING_REGISTERS 0x03
+#define MODBUS_READ_INPUT_REGISTERS 0x04
+#define MODBUS_WRITE_SINGLE_COIL 0x05
+#define MODBUS_WRITE_SINGLE_REGISTER 0x06
+#define MODBUS_WRITE_MULTIPLE_COILS 0x0f
+#define MODBUS_WRITE_MULTIPLE_REGISTERS 0x10
+#define MODBUS_READ_WRITE_MULTIPLE_REGISTERS 0x17
+
+// exception codes, also what the callbacks return, 0 for none
+#define MODBUS_EX_ILLEGAL_FUNCTION 0x01
+#define MODBUS_EX_ILLEGAL_ADDRESS 0x02
+#define MODBUS_EX_ILLEGAL_VALUE 0x03
+#define MODBUS_EX_DEVICE_FAILURE 0x04
+
+enum modbus_table {
+    MODBUS_COILS,
+    MODBUS_DISCRETE_INPUTS,
+    MODBUS_INPUT_REGISTERS,
+    MODBUS_HOLDING_REGISTERS
+};
+
+// count items of a range from addr, an absolute address, and an exception code or 0.
+// Registers are 2 bytes each, big endian. Bits are 8 to a byte from bit 0, the one of addr
+// first, and read() finds the bytes zeroed. out points into the response, in into the request
+struct modbus_range {
+    uint8_t table;  // enum modbus_table
+    uint16_t start;
+    uint16_t count;
+    uint8_t (*read)(void *arg, uint16_t addr, uint16_t count, uint8_t *out);
+    uint8_t (*write)(void *arg, uint16_t addr, uint16_t count, const uint8_t *in); // NULL: read only
+    void *arg;
+};
+
+struct modbus_stats {
+    uint32_t requests;
+    uint32_t exceptions;  // of them, answered with an exception
+    uint32_t services;    // services that answered requests
+    uint32_t batch_max;   // most requests one service answered on a connection
+    uint32_t split;       // frames split between two lends, copied
+    uint32_t deferred;    // times a request waited for room for its response
+    uint32_t connections;
+    uint32_t dropped;     // connections closed on a frame that is not Modbus/TCP
+};
+
+static inline uint16_t modbus_get_u16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline void modbus_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static inline bool modbus_get_bit(const uint8_t *bits, uint16_t i) {
+    return (bits[i >> 3] >> (i & 7)) & 1;
+}
+
+static inline void modbus_put_bit(uint8_t *bits, uint16_t i, bool v) {
+    if (v) {
+        bits[i >> 3] |= 1u << (i & 7);
+    }
+}
+
+// serve the ranges of map on MODBUS_PORT as net.h's service, after the network is up.
+// map is not copied
+void modbus_init(const struct modbus_range *map, uint16_t ranges);
+
+void modbus_get_stats(struct modbus_stats *stats);
+
+// the engine, for a transport of the application's own
+
+// size of the frame that starts with these MODBUS_MBAP_SIZE bytes, 0 when it is not Modbus/TCP
+uint16_t modbus_frame_size(const uint8_t *mbap);
+
+// room the response to a whole frame takes, at most MODBUS_FRAME_MAX
+uint16_t modbus_response_size(const uint8_t *frame);
+
+// write the response to a whole frame at rsp, with modbus_response_size() bytes of room,
+// and return its size. rsp may not overlap the frame
+uint16_t modbus_respond(const struct modbus_range *map, uint16_t ranges, const uint8_t *frame, uint8_t *rsp);
+
+#endif
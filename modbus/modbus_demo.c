@@ -0,0 +1,79 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "modbus.h"
+#include "modbus_demo.h"
+
+#define MODBUS_DEMO_INPUTS 10
+
+static uint8_t modbus_demo_coils[(MODBUS_DEMO_COILS + 7) / 8];
+static uint8_t modbus_demo_registers[MODBUS_DEMO_REGISTERS * 2];
+
+static uint8_t modbus_demo_read_coils(void *arg, uint16_t addr, uint16_t count, uint8_t *out) {
+    for (uint16_t i = 0; i < count; i++) {
+        modbus_put_bit(out, i, modbus_get_bit(modbus_demo_coils, addr + i));
+    }
+
+    return 0;
+}
+
+static uint8_t modbus_demo_write_coils(void *arg, uint16_t addr, uint16_t count, const uint8_t *in) {
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t bit = addr + i;
+
+        modbus_demo_coils[bit >> 3] &= ~(1u << (bit & 7));
+        modbus_put_bit(modbus_demo_coils, bit, modbus_get_bit(in, i));
+    }
+
+    return 0;
+}
+
+// the registers are kept as they go on the wire, a copy each way
+static uint8_t modbus_demo_read_registers(void *arg, uint16_t addr, uint16_t count, uint8_t *out) {
+    memcpy(out, modbus_demo_registers + 2 * addr, 2 * count);
+
+    return 0;
+}
+
+static uint8_t modbus_demo_write_registers(void *arg, uint16_t addr, uint16_t count, const uint8_t *in) {
+    memcpy(modbus_demo_registers + 2 * addr, in, 2 * count);
+
+    return 0;
+}
+
+static uint8_t modbus_demo_read_inputs(void *arg, uint16_t addr, uint16_t count, uint8_t *out) {
+    struct modbus_stats stats;
+    uint32_t values[MODBUS_DEMO_INPUTS / 2];
+
+    modbus_get_stats(&stats);
+
+    values[0] = to_ms_since_boot(get_absolute_time());
+    values[1] = stats.requests;
+    values[2] = stats.exceptions;
+    values[3] = stats.services;
+    values[4] = stats.batch_max;
+
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t reg = addr + i;
+        uint32_t v = values[reg / 2];
+
+        modbus_put_u16(out + 2 * i, (reg & 1) ? (uint16_t)v : (uint16_t)(v >> 16));
+    }
+
+    return 0;
+}
+
+static const struct modbus_range modbus_demo_map[] = {
+    {MODBUS_HOLDING_REGISTERS, 0, MODBUS_DEMO_REGISTERS, modbus_demo_read_registers, modbus_demo_write_registers, NULL},
+    {MODBUS_COILS, 0, MODBUS_DEMO_COILS, modbus_demo_read_coils, modbus_demo_write_coils, NULL},
+    {MODBUS_INPUT_REGISTERS, 0, MODBUS_DEMO_INPUTS, modbus_demo_read_inputs, NULL, NULL},
+};
+
+void modbus_demo_init(void) {
+    modbus_init(modbus_demo_map, sizeof(modbus_demo_map) / sizeof(modbus_demo_map[0]));
+}
@@ -0,0 +1,27 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _MODBUS_DEMO_H_
+#define _MODBUS_DEMO_H_
+
+// The Modbus/TCP device of both firmwares' modbus examples, on modbus.h:
+//  - coils 0 to MODBUS_DEMO_COILS - 1, in RAM
+//  - holding registers 0 to MODBUS_DEMO_REGISTERS - 1, in RAM
+//  - input registers 0 to 9, read only: the milliseconds since boot, then the server's
+//    requests, exceptions, services and most requests of a service, 32 bits each, high
+//    half first
+// tools/modbus_bench.py writes and reads them back
+
+#ifndef MODBUS_DEMO_COILS
+#define MODBUS_DEMO_COILS 2000
+#endif
+
+#ifndef MODBUS_DEMO_REGISTERS
+#define MODBUS_DEMO_REGISTERS 1000
+#endif
+
+// serve the map with modbus_init(), after the network is up
+void modbus_demo_init(void);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _NET_H_
+#define _NET_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Socket-like API of both firmwares, so that an application written once runs on lwIP
+// (the LAN8720, or the W5100S in MACRAW) or on the W5100S's own TCP/IP (the ioLibrary).
+// net_<stack>.c implements it, the firmware links one of them.
+//
+// Everything is non-blocking. Each call does what it can now, and returns NET_AGAIN when
+// it can do nothing yet. The application runs in a service function given to net_init(),
+// which checks its sockets with net_events() and does the next step. On lwIP, the service
+// runs in lwIP's context from a timer every NET_POLL_MS, and again after each callback
+// that brings something new. On the ioLibrary, net_poll() in main's loop runs it.
+//
+// A TCP server listens with net_listen() and takes its connections with net_accept(). On
+// the ioLibrary, a listener holds `backlog` of the chip's sockets, each listening on the
+// port, and a closed connection's socket listens again.
+//
+// Lending skips the copy into the application's buffer. net_recv_lend() points into what
+// the stack holds: lwIP's pbufs, or the backend's buffer that a single burst read from the
+// chip. net_send_lend() points into what the stack sends from: a ring that lwIP sends by
+// reference and frees as it is acknowledged, or the buffer the backend writes to the chip
+// in one burst. Lending is for TCP only.
+
+// sockets, connections and UDP together
+#ifndef NET_SOCKETS
+#define NET_SOCKETS 4
+#endif
+
+#ifndef NET_LISTENERS
+#define NET_LISTENERS 2
+#endif
+
+// service interval on lwIP, when nothing happens
+#ifndef NET_POLL_MS
+#define NET_POLL_MS 10
+#endif
+
+// largest UDP datagram in one frame, net_recvfrom() should have room for it
+#define NET_DATAGRAM_MAX 1472
+
+// results below 0
+#define NET_AGAIN -1   // nothing now, try again from a later service
+#define NET_CLOSED -2  // the peer closed the connection, or it is gone
+#define NET_ERROR -3   // no such socket, or the stack refused
+
+// net_events()
+#define NET_EV_IN 0x01  // something to read: data, a datagram, or the peer's close
+#define NET_EV_OUT 0x02 // room to send
+#define NET_EV_HUP 0x04 // the connection is gone, net_close() it
+
+// start the backend, service is the application's loop body
+void net_init(void (*service)(void));
+
+// on the ioLibrary, the sockets' states and the service, from main's loop. Nothing on
+// lwIP, its timers run the service
+void net_poll(void);
+
+// a TCP listener on port, NET_ERROR when none is left
+int net_listen(uint16_t port, uint8_t backlog);
+
+// the next connection of a listener, NET_AGAIN when there is none
+int net_accept(int listener);
+
+// stop listening, the accepted connections stay open
+void net_unlisten(int listener);
+
+// a UDP socket bound to port
+int net_udp_open(uint16_t port);
+
+// TCP: up to len bytes, NET_AGAIN when none are there, NET_CLOSED once the peer closed and
+// everything is read
+int32_t net_recv(int s, void *buf, uint16_t len);
+
+// TCP: as much of len bytes as there is room for, NET_AGAIN when there is none
+int32_t net_send(int s, const void *buf, uint16_t len);
+
+// bytes net_recv() can return now, and room net_send() has now
+uint32_t net_recv_avail(int s);
+uint32_t net_send_room(int s);
+
+// UDP: the next datagram, cut at len, and where it came from. NET_AGAIN when none came
+int32_t net_recvfrom(int s, void *buf, uint16_t len, uint8_t addr[4], uint16_t *port);
+
+// UDP: a datagram, len or NET_AGAIN when the stack has no room now
+int32_t net_sendto(int s, const void *buf, uint16_t len, const uint8_t addr[4], uint16_t port);
+
+// NET_EV_ of a socket
+uint8_t net_events(int s);
+
+// close a connection or a UDP socket, data not acknowledged yet still goes out
+void net_close(int s);
+
+// TCP: the next received bytes in the stack's memory, as returned by net_recv(). They
+// stay valid until net_recv_release() of up to that many
+int32_t net_recv_lend(int s, const uint8_t **data);
+void net_recv_release(int s, uint16_t len);
+
+// TCP: room in the stack's memory to write the next bytes to send, NET_AGAIN when there is
+// none. net_send_commit() sends up to that many of them, until then nothing else may send
+int32_t net_send_lend(int s, uint8_t **data);
+int32_t net_send_commit(int s, uint16_t len);
+
+// the backend and its options, as `key=value` pairs separated by spaces
+const char *net_options(void);
+
+#endif
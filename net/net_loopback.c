@@ -0,0 +1,88 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "net.h"
+#include "net_loopback.h"
+
+static int net_loopback_listener = NET_ERROR;
+static int net_loopback_udp = NET_ERROR;
+static bool net_loopback_open[NET_SOCKETS];
+
+static uint8_t net_loopback_buf[NET_DATAGRAM_MAX];
+
+// everything received that there is room for, false once the peer closed
+static bool net_loopback_echo(int s) {
+    while (true) {
+        const uint8_t *rx;
+        uint8_t *tx;
+        int32_t rx_len = net_recv_lend(s, &rx);
+
+        if (rx_len <= 0) {
+            return rx_len != NET_CLOSED;
+        }
+
+        int32_t tx_len = net_send_lend(s, &tx);
+
+        if (tx_len <= 0) {
+            // the rest once there is room
+            return tx_len != NET_CLOSED;
+        }
+
+        uint16_t n = (rx_len < tx_len) ? rx_len : tx_len;
+
+        memcpy(tx, rx, n);
+        net_send_commit(s, n);
+        net_recv_release(s, n);
+    }
+}
+
+static void net_loopback_service(void) {
+    uint8_t addr[4];
+    uint16_t port;
+    int32_t n;
+    int s;
+
+    while ((s = net_accept(net_loopback_listener)) >= 0) {
+        net_loopback_open[s] = true;
+
+        printf("net loopback: %d connected\n", s);
+    }
+
+    for (s = 0; s < NET_SOCKETS; s++) {
+        if (!net_loopback_open[s]) {
+            continue;
+        }
+
+        uint8_t ev = net_events(s);
+
+        if ((ev & NET_EV_HUP) || ((ev & NET_EV_IN) && !net_loopback_echo(s))) {
+            net_close(s);
+            net_loopback_open[s] = false;
+
+            printf("net loopback: %d closed\n", s);
+        }
+    }
+
+    if (net_loopback_udp < 0) {
+        return;
+    }
+
+    while ((n = net_recvfrom(net_loopback_udp, net_loopback_buf, sizeof(net_loopback_buf), addr, &port)) > 0) {
+        net_sendto(net_loopback_udp, net_loopback_buf, n, addr, port);
+    }
+}
+
+void net_loopback_init(void) {
+    net_init(net_loopback_service);
+
+    net_loopback_udp = net_udp_open(NET_LOOPBACK_PORT);
+    net_loopback_listener = net_listen(NET_LOOPBACK_PORT, NET_SOCKETS - 1);
+
+    printf("net loopback: TCP and UDP echo on port %d, %s\n", NET_LOOPBACK_PORT, net_options());
+}
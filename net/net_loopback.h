@@ -0,0 +1,20 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _NET_LOOPBACK_H_
+#define _NET_LOOPBACK_H_
+
+// The loopback of both firmwares written once on net.h: a TCP echo on NET_LOOPBACK_PORT
+// and a UDP echo on the same port number, each on a socket of its own. What comes in goes
+// back from the received bytes to the sent ones with one copy between the two lends
+
+#ifndef NET_LOOPBACK_PORT
+#define NET_LOOPBACK_PORT 5000
+#endif
+
+// start it as net.h's service, after the network is up. The TCP echo takes all sockets but
+// the UDP one
+void net_loopback_init(void);
+
+#endif
@@ -0,0 +1,667 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// net.h on lwIP's raw API, NO_SYS, the service runs from lwIP's timer and callbacks
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "net.h"
+
+// bytes a connection sends from, by reference until they are acknowledged
+#ifndef NET_LWIP_SND_RING
+#define NET_LWIP_SND_RING TCP_SND_BUF
+#endif
+
+// datagrams a UDP socket holds until they are read, later ones are dropped
+#ifndef NET_LWIP_UDP_QUEUE
+#define NET_LWIP_UDP_QUEUE 4
+#endif
+
+enum net_lwip_type {
+    NET_LWIP_FREE,
+    NET_LWIP_PENDING, // accepted by lwIP, not by net_accept() yet
+    NET_LWIP_TCP,
+    NET_LWIP_CLOSING, // closed, its ring is sent by reference until acknowledged
+    NET_LWIP_UDP,
+};
+
+struct net_lwip_dgram {
+    struct pbuf *p;
+    ip_addr_t addr;
+    u16_t port;
+};
+
+struct net_lwip_socket {
+    uint8_t type;
+    int8_t listener;           // of a pending connection
+    bool fin;                  // the peer closed
+    bool gone;                 // lwIP freed the pcb
+    union {
+        struct tcp_pcb *tcp;
+        struct udp_pcb *udp;
+    } pcb;
+
+    struct pbuf *rx;           // TCP, received and not read
+    struct net_lwip_dgram dgrams[NET_LWIP_UDP_QUEUE];
+    uint8_t dgram_first;
+    uint8_t dgram_count;
+
+    uint16_t tx_head;          // where the next bytes go in tx
+    uint16_t tx_used;          // bytes of tx not acknowledged
+    uint16_t tx_pending;       // committed at tx_head, lwIP had no memory to queue them
+    uint8_t tx[NET_LWIP_SND_RING] __attribute__((aligned(4)));
+};
+
+static struct {
+    void (*service)(void);
+    bool in_service;
+    struct tcp_pcb *listeners[NET_LISTENERS];
+    struct net_lwip_socket sockets[NET_SOCKETS];
+} net_lwip;
+
+static struct net_lwip_socket *net_lwip_get(int s, uint8_t type) {
+    if (s < 0 || s >= NET_SOCKETS || net_lwip.sockets[s].type != type) {
+        return NULL;
+    }
+
+    return &net_lwip.sockets[s];
+}
+
+static void net_lwip_service(void) {
+    // the service's own calls may call back
+    if (net_lwip.service == NULL || net_lwip.in_service) {
+        return;
+    }
+
+    net_lwip.in_service = true;
+    net_lwip.service();
+    net_lwip.in_service = false;
+}
+
+// the committed bytes into lwIP's send queue, by reference
+static void net_lwip_write(struct net_lwip_socket *s) {
+    if (tcp_write(s->pcb.tcp, s->tx + s->tx_head, s->tx_pending, 0) != ERR_OK) {
+        // again from the timer or the next acknowledgement
+        return;
+    }
+
+    s->tx_head = (s->tx_head + s->tx_pending) % NET_LWIP_SND_RING;
+    s->tx_used += s->tx_pending;
+    s->tx_pending = 0;
+
+    tcp_output(s->pcb.tcp);
+}
+
+static void net_lwip_timer(void *arg) {
+    LWIP_UNUSED_ARG(arg);
+
+    for (int i = 0; i < NET_SOCKETS; i++) {
+        struct net_lwip_socket *s = &net_lwip.sockets[i];
+
+        if (s->type == NET_LWIP_TCP && s->tx_pending != 0 && s->pcb.tcp != NULL) {
+            net_lwip_write(s);
+        }
+    }
+
+    net_lwip_service();
+
+    sys_timeout(NET_POLL_MS, net_lwip_timer, NULL);
+}
+
+static void net_lwip_free(struct net_lwip_socket *s) {
+    if (s->rx != NULL) {
+        pbuf_free(s->rx);
+    }
+
+    for (uint i = 0; i < s->dgram_count; i++) {
+        pbuf_free(s->dgrams[(s->dgram_first + i) % NET_LWIP_UDP_QUEUE].p);
+    }
+
+    memset(s, 0, offsetof(struct net_lwip_socket, tx));
+}
+
+static struct net_lwip_socket *net_lwip_alloc(uint8_t type) {
+    for (int i = 0; i < NET_SOCKETS; i++) {
+        struct net_lwip_socket *s = &net_lwip.sockets[i];
+
+        if (s->type == NET_LWIP_FREE) {
+            memset(s, 0, offsetof(struct net_lwip_socket, tx));
+            s->type = type;
+
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
+static void net_lwip_detach(struct tcp_pcb *pcb) {
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_err(pcb, NULL);
+}
+
+static err_t net_lwip_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    struct net_lwip_socket *s = arg;
+
+    LWIP_UNUSED_ARG(pcb);
+
+    if (p == NULL) {
+        s->fin = true;
+    } else if (err != ERR_OK) {
+        pbuf_free(p);
+
+        return err;
+    } else if (s->rx == NULL) {
+        s->rx = p;
+    } else {
+        pbuf_cat(s->rx, p);
+    }
+
+    net_lwip_service();
+
+    return ERR_OK;
+}
+
+static err_t net_lwip_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    struct net_lwip_socket *s = arg;
+
+    s->tx_used -= len;
+
+    if (s->type == NET_LWIP_CLOSING) {
+        if (s->tx_used == 0) {
+            net_lwip_detach(pcb);
+            net_lwip_free(s);
+        }
+
+        return ERR_OK;
+    }
+
+    if (s->tx_pending != 0) {
+        net_lwip_write(s);
+    }
+
+    net_lwip_service();
+
+    return ERR_OK;
+}
+
+static void net_lwip_err(void *arg, err_t err) {
+    struct net_lwip_socket *s = arg;
+
+    LWIP_UNUSED_ARG(err);
+
+    // the pcb is already freed
+    s->pcb.tcp = NULL;
+
+    if (s->type == NET_LWIP_CLOSING) {
+        net_lwip_free(s);
+
+        return;
+    }
+
+    s->gone = true;
+
+    net_lwip_service();
+}
+
+static err_t net_lwip_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    struct net_lwip_socket *s = net_lwip_alloc(NET_LWIP_PENDING);
+
+    if (s == NULL) {
+        tcp_abort(pcb);
+
+        return ERR_ABRT;
+    }
+
+    s->listener = (int8_t)(intptr_t)arg;
+    s->pcb.tcp = pcb;
+
+    // writes go out as they come, like the W5x00 sockets
+    tcp_nagle_disable(pcb);
+
+    tcp_arg(pcb, s);
+    tcp_recv(pcb, net_lwip_recv);
+    tcp_sent(pcb, net_lwip_sent);
+    tcp_err(pcb, net_lwip_err);
+
+    net_lwip_service();
+
+    return ERR_OK;
+}
+
+static void net_lwip_udp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    struct net_lwip_socket *s = arg;
+
+    LWIP_UNUSED_ARG(pcb);
+
+    if (s->dgram_count == NET_LWIP_UDP_QUEUE) {
+        pbuf_free(p);
+
+        return;
+    }
+
+    struct net_lwip_dgram *d = &s->dgrams[(s->dgram_first + s->dgram_count) % NET_LWIP_UDP_QUEUE];
+
+    d->p = p;
+    ip_addr_copy(d->addr, *addr);
+    d->port = port;
+    s->dgram_count++;
+
+    net_lwip_service();
+}
+
+void net_init(void (*service)(void)) {
+    net_lwip.service = service;
+
+    sys_timeout(NET_POLL_MS, net_lwip_timer, NULL);
+}
+
+void net_poll(void) {
+    // lwIP's timer runs the service
+}
+
+int net_listen(uint16_t port, uint8_t backlog) {
+    int l;
+
+    for (l = 0; l < NET_LISTENERS && net_lwip.listeners[l] != NULL; l++) {
+    }
+
+    if (l == NET_LISTENERS) {
+        return NET_ERROR;
+    }
+
+    struct tcp_pcb *pcb = tcp_new();
+
+    if (pcb == NULL) {
+        return NET_ERROR;
+    }
+
+#if SO_REUSE
+    // listening again while the last connections are in TIME_WAIT
+    ip_set_option(pcb, SOF_REUSEADDR);
+#endif
+
+    if (tcp_bind(pcb, IP_ADDR_ANY, port) != ERR_OK) {
+        tcp_close(pcb);
+
+        return NET_ERROR;
+    }
+
+    struct tcp_pcb *listen_pcb = tcp_listen_with_backlog(pcb, backlog);
+
+    if (listen_pcb == NULL) {
+        tcp_close(pcb);
+
+        return NET_ERROR;
+    }
+
+    tcp_arg(listen_pcb, (void *)(intptr_t)l);
+    tcp_accept(listen_pcb, net_lwip_accept);
+
+    net_lwip.listeners[l] = listen_pcb;
+
+    return l;
+}
+
+int net_accept(int listener) {
+    for (int i = 0; i < NET_SOCKETS; i++) {
+        struct net_lwip_socket *s = &net_lwip.sockets[i];
+
+        if (s->type == NET_LWIP_PENDING && s->listener == listener) {
+            s->type = NET_LWIP_TCP;
+
+            return i;
+        }
+    }
+
+    return NET_AGAIN;
+}
+
+void net_unlisten(int listener) {
+    if (listener < 0 || listener >= NET_LISTENERS || net_lwip.listeners[listener] == NULL) {
+        return;
+    }
+
+    tcp_close(net_lwip.listeners[listener]);
+    net_lwip.listeners[listener] = NULL;
+
+    // connections it had and nobody took
+    for (int i = 0; i < NET_SOCKETS; i++) {
+        if (net_lwip.sockets[i].type == NET_LWIP_PENDING && net_lwip.sockets[i].listener == listener) {
+            net_lwip.sockets[i].type = NET_LWIP_TCP;
+            net_close(i);
+        }
+    }
+}
+
+int net_udp_open(uint16_t port) {
+    struct net_lwip_socket *s = net_lwip_alloc(NET_LWIP_UDP);
+
+    if (s == NULL) {
+        return NET_ERROR;
+    }
+
+    s->pcb.udp = udp_new();
+
+    if (s->pcb.udp == NULL || udp_bind(s->pcb.udp, IP_ADDR_ANY, port) != ERR_OK) {
+        if (s->pcb.udp != NULL) {
+            udp_remove(s->pcb.udp);
+        }
+        net_lwip_free(s);
+
+        return NET_ERROR;
+    }
+
+    udp_recv(s->pcb.udp, net_lwip_udp_recv, s);
+
+    return s - net_lwip.sockets;
+}
+
+int32_t net_recv_lend(int s, const uint8_t **data) {
+    struct net_lwip_socket *sock = net_lwip_get(s, NET_LWIP_TCP);
+
+    if (sock == NULL) {
+        return NET_ERROR;
+    }
+
+    if (sock->rx != NULL) {
+        *data = sock->rx->payload;
+
+        return sock->rx->len;
+    }
+
+    return (sock->fin || sock->gone) ? NET_CLOSED : NET_AGAIN;
+}
+
+void net_recv_release(int s, uint16_t len) {
+    struct net_lwip_socket *sock = net_lwip_get(s, NET_LWIP_TCP);
+
+    if (sock == NULL || sock->rx == NULL) {
+        return;
+    }
+
+    if (len > sock->rx->tot_len) {
+        len = sock->rx->tot_len;
+    }
+
+    sock->rx = pbuf_free_header(sock->rx, len);
+
+    if (sock->pcb.tcp != NULL) {
+        tcp_recved(sock->pcb.tcp, len);
+    }
+}
+
+int32_t net_recv(int s, void *buf, uint16_t len) {
+    struct net_lwip_socket *sock = net_lwip_get(s, NET_LWIP_TCP);
+
+    if (sock == NULL) {
+        return NET_ERROR;
+    }
+
+    if (sock->rx == NULL) {
+        return (sock->fin || sock->gone) ? NET_CLOSED : NET_AGAIN;
+    }
+
+    len = pbuf_copy_partial(sock->rx, buf, len, 0);
+    net_recv_release(s, len);
+
+    return len;
+}
+
+uint32_t net_recv_avail(int s) {
+    struct net_lwip_socket *sock = net_lwip_get(s, NET_LWIP_TCP);
+
+    return (sock != NULL && sock->rx != NULL) ? sock->rx->tot_len : 0;
+}
+
+uint32_t net_send_room(int s) {
+    struct net_lwip_socket *sock = net_lwip_get(s, NET_LWIP_TCP);
+
+    if (sock == NULL || sock->pcb.tcp == NULL || sock->tx_pending != 0 ||
+        tcp_sndqueuelen(sock->pcb.tcp) >= TCP_SND_QUEUELEN) {
+        return 0;
+    }
+
+    uint32_t room = NET_LWIP_SND_RING - sock->tx_used;
+    uint32_t sndbuf = tcp_sndbuf(sock->pcb.tcp);
+
+    return (room < sndbuf) ? room : sndbuf;
+}
+
+int32_t net_send_lend(int s, uint8_t **data) {
+    struct net_lwip_socket *sock = net_lwip_get(s, NET_LWIP_TCP);
+
+    if (sock == NULL) {
+        return NET_ERROR;
+    }
+
+    if (sock->gone) {
+        return NET_CLOSED;
+    }
+
+    uint32_t room = net_send_room(s);
+
+    if (room == 0) {
+        return NET_AGAIN;
+    }
+
+    // up to the end of the ring, the rest comes with the next lend
+    if (room > (uint32_t)(NET_LWIP_SND_RING - sock->tx_head)) {
+        room = NET_LWIP_SND_RING - sock->tx_head;
+    }
+
+    *data = sock->tx + sock->tx_head;
+
+    return room;
+}
+
+int32_t net_send_commit(int s, uint16_t len) {
+    struct net_lwip_socket *sock = net_lwip_get(s, NET_LWIP_TCP);
+
+    if (sock == NULL || sock->pcb.tcp == NULL) {
+        return NET_ERROR;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    // by reference, the ring keeps the bytes until net_lwip_sent()
+    sock->tx_pending = len;
+    net_lwip_write(sock);
+
+    return len;
+}
+
+int32_t net_send(int s, const void *buf, uint16_t len) {
+    const uint8_t *src = buf;
+    int32_t sent = 0;
+
+    // twice when the ring wraps
+    while (sent < len) {
+        uint8_t *data;
+        int32_t n = net_send_lend(s, &data);
+
+        if (n < 0) {
+            return sent ? sent : n;
+        }
+
+        if (n > len - sent) {
+            n = len - sent;
+        }
+
+        memcpy(data, src + sent, n);
+
+        if ((n = net_send_commit(s, n)) < 0) {
+            return sent ? sent : n;
+        }
+
+        sent += n;
+    }
+
+    return sent;
+}
+
+int32_t net_recvfrom(int s, void *buf, uint16_t len, uint8_t addr[4], uint16_t *port) {
+    struct net_lwip_socket *sock = net_lwip_get(s, NET_LWIP_UDP);
+
+    if (sock == NULL) {
+        return NET_ERROR;
+    }
+
+    if (sock->dgram_count == 0) {
+        return NET_AGAIN;
+    }
+
+    struct net_lwip_dgram *d = &sock->dgrams[sock->dgram_first];
+    uint32_t a = IP_IS_V4(&d->addr) ? ip4_addr_get_u32(ip_2_ip4(&d->addr)) : 0;
+
+    len = pbuf_copy_partial(d->p, buf, len, 0);
+
+    addr[0] = a;
+    addr[1] = a >> 8;
+    addr[2] = a >> 16;
+    addr[3] = a >> 24;
+    *port = d->port;
+
+    pbuf_free(d->p);
+    sock->dgram_first = (sock->dgram_first + 1) % NET_LWIP_UDP_QUEUE;
+    sock->dgram_count--;
+
+    return len;
+}
+
+int32_t net_sendto(int s, const void *buf, uint16_t len, const uint8_t addr[4], uint16_t port) {
+    struct net_lwip_socket *sock = net_lwip_get(s, NET_LWIP_UDP);
+    ip_addr_t dst;
+
+    if (sock == NULL) {
+        return NET_ERROR;
+    }
+
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+
+    if (p == NULL) {
+        return NET_AGAIN;
+    }
+
+    pbuf_take(p, buf, len);
+    IP_ADDR4(&dst, addr[0], addr[1], addr[2], addr[3]);
+
+    err_t err = udp_sendto(sock->pcb.udp, p, &dst, port);
+
+    pbuf_free(p);
+
+    if (err != ERR_OK) {
+        return (err == ERR_MEM || err == ERR_BUF) ? NET_AGAIN : NET_ERROR;
+    }
+
+    return len;
+}
+
+uint8_t net_events(int s) {
+    struct net_lwip_socket *sock;
+
+    if ((sock = net_lwip_get(s, NET_LWIP_UDP)) != NULL) {
+        // pbufs are taken when the datagram is sent
+        return ((sock->dgram_count != 0) ? NET_EV_IN : 0) | NET_EV_OUT;
+    }
+
+    if ((sock = net_lwip_get(s, NET_LWIP_TCP)) == NULL) {
+        return NET_EV_HUP;
+    }
+
+    uint8_t ev = 0;
+
+    if (sock->rx != NULL || sock->fin || sock->gone) {
+        ev |= NET_EV_IN;
+    }
+
+    if (net_send_room(s) != 0) {
+        ev |= NET_EV_OUT;
+    }
+
+    if (sock->gone) {
+        ev |= NET_EV_HUP;
+    }
+
+    return ev;
+}
+
+void net_close(int s) {
+    struct net_lwip_socket *sock;
+
+    if ((sock = net_lwip_get(s, NET_LWIP_UDP)) != NULL) {
+        udp_remove(sock->pcb.udp);
+        net_lwip_free(sock);
+
+        return;
+    }
+
+    if ((sock = net_lwip_get(s, NET_LWIP_TCP)) == NULL) {
+        return;
+    }
+
+    struct tcp_pcb *pcb = sock->pcb.tcp;
+
+    if (pcb == NULL) {
+        net_lwip_free(sock);
+
+        return;
+    }
+
+    // what wasn't read is taken, or tcp_close() resets the connection at once
+    if (sock->rx != NULL) {
+        tcp_recved(pcb, sock->rx->tot_len);
+    }
+
+    tcp_recv(pcb, NULL);
+
+    if (tcp_close(pcb) != ERR_OK) {
+        net_lwip_detach(pcb);
+        tcp_abort(pcb);
+        net_lwip_free(sock);
+
+        return;
+    }
+
+    if (sock->tx_used == 0) {
+        net_lwip_detach(pcb);
+        net_lwip_free(sock);
+
+        return;
+    }
+
+    // net_lwip_sent() or net_lwip_err() frees it
+    if (sock->rx != NULL) {
+        pbuf_free(sock->rx);
+        sock->rx = NULL;
+    }
+    sock->type = NET_LWIP_CLOSING;
+}
+
+const char *net_options(void) {
+    static char options[64];
+
+    if (options[0] == '\0') {
+        snprintf(options, sizeof(options), "net=lwip sockets=%d snd_ring=%d", NET_SOCKETS, NET_LWIP_SND_RING);
+    }
+
+    return options;
+}
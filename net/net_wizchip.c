@@ -0,0 +1,549 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// net.h on the ioLibrary socket API, net_poll() in main's loop runs the service
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "wizchip_conf.h"
+#include "socket.h"
+
+#include "net.h"
+
+#if NET_SOCKETS > _WIZCHIP_SOCK_NUM_
+#error "NET_SOCKETS is more than the chip has"
+#endif
+
+// bytes of a lend, one burst to or from the chip
+#ifndef NET_WIZCHIP_BUF
+#define NET_WIZCHIP_BUF 1460
+#endif
+
+enum net_wizchip_type {
+    NET_WIZCHIP_FREE,
+    NET_WIZCHIP_LISTEN,  // listening for its listener, or connected and not accepted yet
+    NET_WIZCHIP_TCP,
+    NET_WIZCHIP_CLOSING, // disconnecting, then it listens again or is free
+    NET_WIZCHIP_UDP,
+};
+
+struct net_wizchip_socket {
+    uint8_t type;
+    int8_t listener;     // the socket listens for it again once closed, -1 for none
+    uint16_t rx_len;     // of rx, read from the chip
+    uint16_t rx_off;     // of rx, released
+    uint16_t tx_pending; // of tx, committed while the chip was busy with the last SEND
+    uint8_t rx[NET_WIZCHIP_BUF];
+    uint8_t tx[NET_WIZCHIP_BUF];
+};
+
+static struct {
+    void (*service)(void);
+    bool listening[NET_LISTENERS];
+    uint16_t ports[NET_LISTENERS];
+    struct net_wizchip_socket sockets[NET_SOCKETS];
+} net_wizchip;
+
+static struct net_wizchip_socket *net_wizchip_get(int s, uint8_t type) {
+    if (s < 0 || s >= NET_SOCKETS || net_wizchip.sockets[s].type != type) {
+        return NULL;
+    }
+
+    return &net_wizchip.sockets[s];
+}
+
+// status, received and free sizes of a socket
+static void net_wizchip_state(uint8_t sn, uint8_t *sr, uint16_t *rsr, uint16_t *fsr) {
+#if _WIZCHIP_ == W5100S
+    // one burst instead of a register access each
+    wiz_SnSnapshot snap;
+
+    wiz_socket_snapshot(sn, &snap);
+
+    *sr = snap.sr;
+    *rsr = snap.rx_rsr;
+    *fsr = snap.tx_fsr;
+#else
+    *sr = getSn_SR(sn);
+    *rsr = getSn_RX_RSR(sn);
+    *fsr = getSn_TX_FSR(sn);
+#endif
+}
+
+static bool net_wizchip_connected(uint8_t sr) {
+    return (sr == SOCK_ESTABLISHED) || (sr == SOCK_CLOSE_WAIT);
+}
+
+// a listener's socket open and listening, a step per call
+static void net_wizchip_listen(uint8_t sn, uint8_t sr) {
+    struct net_wizchip_socket *s = &net_wizchip.sockets[sn];
+
+    if (sr == SOCK_CLOSED) {
+        // the W5x00 delays no ACK then, like lwIP's pcbs without Nagle
+        socket(sn, Sn_MR_TCP, net_wizchip.ports[s->listener], SF_IO_NONBLOCK | SF_TCP_NODELAY);
+    } else if (sr == SOCK_INIT) {
+        listen(sn);
+    }
+}
+
+// a closed connection's socket back to its listener, or free
+static void net_wizchip_release(uint8_t sn) {
+    struct net_wizchip_socket *s = &net_wizchip.sockets[sn];
+
+    s->rx_len = s->rx_off = s->tx_pending = 0;
+
+    if (s->listener >= 0 && net_wizchip.listening[s->listener]) {
+        s->type = NET_WIZCHIP_LISTEN;
+    } else {
+        s->type = NET_WIZCHIP_FREE;
+        s->listener = -1;
+    }
+}
+
+// the bytes committed while the chip was busy
+static void net_wizchip_send_pending(uint8_t sn) {
+    struct net_wizchip_socket *s = &net_wizchip.sockets[sn];
+    int32_t ret = send(sn, s->tx, s->tx_pending);
+
+    if (ret != SOCK_BUSY) {
+        // sent, or the connection is gone with them
+        s->tx_pending = 0;
+    }
+}
+
+static int net_wizchip_alloc(uint8_t type) {
+    for (int sn = 0; sn < NET_SOCKETS; sn++) {
+        struct net_wizchip_socket *s = &net_wizchip.sockets[sn];
+
+        if (s->type == NET_WIZCHIP_FREE) {
+            s->type = type;
+            s->listener = -1;
+            s->rx_len = s->rx_off = s->tx_pending = 0;
+
+            return sn;
+        }
+    }
+
+    return NET_ERROR;
+}
+
+void net_init(void (*service)(void)) {
+    net_wizchip.service = service;
+
+    for (int sn = 0; sn < NET_SOCKETS; sn++) {
+        net_wizchip.sockets[sn].listener = -1;
+    }
+}
+
+void net_poll(void) {
+    for (uint8_t sn = 0; sn < NET_SOCKETS; sn++) {
+        struct net_wizchip_socket *s = &net_wizchip.sockets[sn];
+        uint8_t sr;
+
+        switch (s->type) {
+        case NET_WIZCHIP_LISTEN:
+            sr = getSn_SR(sn);
+
+            if (sr == SOCK_CLOSED || sr == SOCK_INIT) {
+                net_wizchip_listen(sn, sr);
+            }
+            break;
+
+        case NET_WIZCHIP_CLOSING:
+            if (getSn_SR(sn) == SOCK_CLOSED) {
+                net_wizchip_release(sn);
+            }
+            break;
+
+        case NET_WIZCHIP_TCP:
+            if (s->tx_pending != 0) {
+                net_wizchip_send_pending(sn);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (net_wizchip.service != NULL) {
+        net_wizchip.service();
+    }
+}
+
+int net_listen(uint16_t port, uint8_t backlog) {
+    int l, sockets = 0;
+
+    for (l = 0; l < NET_LISTENERS && net_wizchip.listening[l]; l++) {
+    }
+
+    if (l == NET_LISTENERS) {
+        return NET_ERROR;
+    }
+
+    net_wizchip.listening[l] = true;
+    net_wizchip.ports[l] = port;
+
+    // a socket per connection the listener may have
+    while (sockets < backlog) {
+        int sn = net_wizchip_alloc(NET_WIZCHIP_LISTEN);
+
+        if (sn < 0) {
+            break;
+        }
+
+        net_wizchip.sockets[sn].listener = l;
+        net_wizchip_listen(sn, getSn_SR(sn));
+        sockets++;
+    }
+
+    if (sockets == 0) {
+        net_wizchip.listening[l] = false;
+
+        return NET_ERROR;
+    }
+
+    return l;
+}
+
+int net_accept(int listener) {
+    for (uint8_t sn = 0; sn < NET_SOCKETS; sn++) {
+        struct net_wizchip_socket *s = &net_wizchip.sockets[sn];
+
+        if (s->type != NET_WIZCHIP_LISTEN || s->listener != listener) {
+            continue;
+        }
+
+        uint8_t sr = getSn_SR(sn);
+
+        if (sr == SOCK_INIT) {
+            // opened by net_poll(), listening from this call
+            listen(sn);
+        } else if (net_wizchip_connected(sr)) {
+            if (getSn_IR(sn) & Sn_IR_CON) {
+                setSn_IR(sn, Sn_IR_CON);
+            }
+
+            s->type = NET_WIZCHIP_TCP;
+
+            return sn;
+        }
+    }
+
+    return NET_AGAIN;
+}
+
+void net_unlisten(int listener) {
+    if (listener < 0 || listener >= NET_LISTENERS || !net_wizchip.listening[listener]) {
+        return;
+    }
+
+    net_wizchip.listening[listener] = false;
+
+    for (uint8_t sn = 0; sn < NET_SOCKETS; sn++) {
+        struct net_wizchip_socket *s = &net_wizchip.sockets[sn];
+
+        if (s->listener != listener) {
+            continue;
+        }
+
+        // the accepted connections are free once closed
+        s->listener = -1;
+
+        if (s->type == NET_WIZCHIP_LISTEN) {
+            close(sn);
+            s->type = NET_WIZCHIP_FREE;
+        }
+    }
+}
+
+int net_udp_open(uint16_t port) {
+    int sn = net_wizchip_alloc(NET_WIZCHIP_UDP);
+
+    if (sn < 0) {
+        return NET_ERROR;
+    }
+
+    if (socket(sn, Sn_MR_UDP, port, SF_IO_NONBLOCK) != sn) {
+        net_wizchip.sockets[sn].type = NET_WIZCHIP_FREE;
+
+        return NET_ERROR;
+    }
+
+    return sn;
+}
+
+int32_t net_recv_lend(int s, const uint8_t **data) {
+    struct net_wizchip_socket *sock = net_wizchip_get(s, NET_WIZCHIP_TCP);
+
+    if (sock == NULL) {
+        return NET_ERROR;
+    }
+
+    if (sock->rx_off == sock->rx_len) {
+        // as much as there is in one burst
+        int32_t ret = recv(s, sock->rx, NET_WIZCHIP_BUF);
+
+        if (ret == SOCK_BUSY) {
+            return NET_AGAIN;
+        }
+
+        if (ret <= 0) {
+            return NET_CLOSED;
+        }
+
+        sock->rx_len = ret;
+        sock->rx_off = 0;
+    }
+
+    *data = sock->rx + sock->rx_off;
+
+    return sock->rx_len - sock->rx_off;
+}
+
+void net_recv_release(int s, uint16_t len) {
+    struct net_wizchip_socket *sock = net_wizchip_get(s, NET_WIZCHIP_TCP);
+
+    if (sock == NULL) {
+        return;
+    }
+
+    sock->rx_off += (len < sock->rx_len - sock->rx_off) ? len : sock->rx_len - sock->rx_off;
+}
+
+int32_t net_recv(int s, void *buf, uint16_t len) {
+    struct net_wizchip_socket *sock = net_wizchip_get(s, NET_WIZCHIP_TCP);
+
+    if (sock == NULL) {
+        return NET_ERROR;
+    }
+
+    // what a lend read first
+    if (sock->rx_off != sock->rx_len) {
+        uint16_t n = sock->rx_len - sock->rx_off;
+
+        if (n > len) {
+            n = len;
+        }
+
+        memcpy(buf, sock->rx + sock->rx_off, n);
+        sock->rx_off += n;
+
+        return n;
+    }
+
+    // straight from the chip, up to what it has
+    int32_t ret = recv(s, buf, len);
+
+    if (ret == SOCK_BUSY) {
+        return NET_AGAIN;
+    }
+
+    return (ret > 0) ? ret : NET_CLOSED;
+}
+
+uint32_t net_recv_avail(int s) {
+    struct net_wizchip_socket *sock = net_wizchip_get(s, NET_WIZCHIP_TCP);
+
+    if (sock == NULL) {
+        return 0;
+    }
+
+    return (sock->rx_len - sock->rx_off) + getSn_RX_RSR(s);
+}
+
+uint32_t net_send_room(int s) {
+    struct net_wizchip_socket *sock = net_wizchip_get(s, NET_WIZCHIP_TCP);
+    uint8_t sr;
+    uint16_t rsr, fsr;
+
+    if (sock == NULL || sock->tx_pending != 0) {
+        return 0;
+    }
+
+    net_wizchip_state(s, &sr, &rsr, &fsr);
+
+    return net_wizchip_connected(sr) ? fsr : 0;
+}
+
+int32_t net_send_lend(int s, uint8_t **data) {
+    struct net_wizchip_socket *sock = net_wizchip_get(s, NET_WIZCHIP_TCP);
+    uint8_t sr;
+    uint16_t rsr, fsr;
+
+    if (sock == NULL) {
+        return NET_ERROR;
+    }
+
+    net_wizchip_state(s, &sr, &rsr, &fsr);
+
+    if (!net_wizchip_connected(sr)) {
+        return NET_CLOSED;
+    }
+
+    if (sock->tx_pending != 0 || fsr == 0) {
+        return NET_AGAIN;
+    }
+
+    *data = sock->tx;
+
+    return (fsr < NET_WIZCHIP_BUF) ? fsr : NET_WIZCHIP_BUF;
+}
+
+int32_t net_send_commit(int s, uint16_t len) {
+    struct net_wizchip_socket *sock = net_wizchip_get(s, NET_WIZCHIP_TCP);
+
+    if (sock == NULL) {
+        return NET_ERROR;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    int32_t ret = send(s, sock->tx, len);
+
+    if (ret == SOCK_BUSY) {
+        // the last SEND is still going, net_poll() sends them after it
+        sock->tx_pending = len;
+
+        return len;
+    }
+
+    return (ret > 0) ? ret : NET_CLOSED;
+}
+
+int32_t net_send(int s, const void *buf, uint16_t len) {
+    struct net_wizchip_socket *sock = net_wizchip_get(s, NET_WIZCHIP_TCP);
+
+    if (sock == NULL) {
+        return NET_ERROR;
+    }
+
+    if (sock->tx_pending != 0) {
+        return NET_AGAIN;
+    }
+
+    uint32_t room = net_send_room(s);
+
+    if (room == 0) {
+        return NET_AGAIN;
+    }
+
+    // straight to the chip, non-blocking send() takes it whole or not at all
+    int32_t ret = send(s, (uint8_t *)buf, (len < room) ? len : room);
+
+    if (ret == SOCK_BUSY) {
+        return NET_AGAIN;
+    }
+
+    return (ret > 0) ? ret : NET_CLOSED;
+}
+
+int32_t net_recvfrom(int s, void *buf, uint16_t len, uint8_t addr[4], uint16_t *port) {
+    if (net_wizchip_get(s, NET_WIZCHIP_UDP) == NULL) {
+        return NET_ERROR;
+    }
+
+    // RX_RSR includes the 8 byte header of each datagram
+    if (getSn_RX_RSR(s) == 0) {
+        return NET_AGAIN;
+    }
+
+    int32_t ret = recvfrom(s, buf, len, addr, port);
+
+    return (ret > 0) ? ret : (ret == SOCK_BUSY) ? NET_AGAIN : NET_ERROR;
+}
+
+int32_t net_sendto(int s, const void *buf, uint16_t len, const uint8_t addr[4], uint16_t port) {
+    if (net_wizchip_get(s, NET_WIZCHIP_UDP) == NULL) {
+        return NET_ERROR;
+    }
+
+    // returns once the chip sent it
+    int32_t ret = sendto(s, (uint8_t *)buf, len, (uint8_t *)addr, port);
+
+    return (ret > 0) ? ret : (ret == SOCK_BUSY) ? NET_AGAIN : NET_ERROR;
+}
+
+uint8_t net_events(int s) {
+    struct net_wizchip_socket *sock;
+    uint8_t sr;
+    uint16_t rsr, fsr;
+
+    if ((sock = net_wizchip_get(s, NET_WIZCHIP_UDP)) != NULL) {
+        return ((getSn_RX_RSR(s) != 0) ? NET_EV_IN : 0) | NET_EV_OUT;
+    }
+
+    if ((sock = net_wizchip_get(s, NET_WIZCHIP_TCP)) == NULL) {
+        return NET_EV_HUP;
+    }
+
+    net_wizchip_state(s, &sr, &rsr, &fsr);
+
+    uint8_t ev = 0;
+
+    if (sock->rx_off != sock->rx_len || rsr != 0 || sr != SOCK_ESTABLISHED) {
+        ev |= NET_EV_IN;
+    }
+
+    if (net_wizchip_connected(sr) && fsr != 0 && sock->tx_pending == 0) {
+        ev |= NET_EV_OUT;
+    }
+
+    if (!net_wizchip_connected(sr)) {
+        ev |= NET_EV_HUP;
+    }
+
+    return ev;
+}
+
+void net_close(int s) {
+    struct net_wizchip_socket *sock;
+
+    if ((sock = net_wizchip_get(s, NET_WIZCHIP_UDP)) != NULL) {
+        close(s);
+        sock->type = NET_WIZCHIP_FREE;
+
+        return;
+    }
+
+    if ((sock = net_wizchip_get(s, NET_WIZCHIP_TCP)) == NULL) {
+        return;
+    }
+
+    uint8_t sr = getSn_SR(s);
+
+    if (net_wizchip_connected(sr)) {
+        if (sock->tx_pending != 0) {
+            net_wizchip_send_pending(s);
+        }
+
+        // non-blocking, the FIN follows what the chip still has to send
+        disconnect(s);
+        sock->type = NET_WIZCHIP_CLOSING;
+
+        return;
+    }
+
+    if (sr != SOCK_CLOSED) {
+        close(s);
+    }
+
+    net_wizchip_release(s);
+}
+
+const char *net_options(void) {
+    static char options[64];
+
+    if (options[0] == '\0') {
+        snprintf(options, sizeof(options), "net=iolibrary io=%s sockets=%d buf=%d",
+            (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_) ? "bus" : "spi", NET_SOCKETS, NET_WIZCHIP_BUF);
+    }
+
+    return options;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+
+#include "rmii_ethernet/netif.h"
+
+#include "bench.h"
+#include "boot.h"
+
+// the scenarios of bench/bench.h, driven from a host with tools/loopback_bench.py,
+// the same as w5x00_bench of the W5100S firmware
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+#if PICO_RMII_ETHERNET_DUAL_CORE
+#error "the priority callback counts into the harness, which runs on the lwIP core"
+#endif
+
+// control datagrams of tools/loopback_bench.py --control-port, alongside the scenario
+#define BENCH_PRIORITY_PORT 5008
+#endif
+
+// LWIP network interface
+struct netif g_netif;
+
+void netif_link_callback(struct netif *netif)
+{
+    uint speed;
+    enum netif_rmii_ethernet_duplex duplex;
+
+    netif_rmii_ethernet_netif_get_link(netif, &speed, &duplex);
+
+    if (netif_is_link_up(netif)) {
+        bench_count_link_up();
+        printf("netif link status changed up, %u Mbit/s %s duplex\n", speed, (duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL) ? "full" : "half");
+    } else {
+        printf("netif link status changed down\n");
+    }
+}
+
+#if PICO_RMII_ETHERNET_CPU_STATS
+static const char *const bench_cpu_names[NETIF_RMII_ETHERNET_CPU_CLASSES] = {
+    "driver", "lwip", "app", "empty", "sleep"
+};
+
+// the split of the core running lwIP and the harness
+static void bench_cpu_split(uint64_t *us) {
+    struct netif_rmii_ethernet_cpu_stats stats;
+
+    netif_rmii_ethernet_get_cpu_stats(get_core_num(), &stats);
+
+    for (uint i = 0; i < NETIF_RMII_ETHERNET_CPU_CLASSES; i++) {
+        us[i] = stats.us[i];
+    }
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+// past lwIP, timed from the end of the frame in the CRS_DV interrupt
+static void bench_priority_callback(struct netif *netif, const uint8_t *frame, uint length, uint32_t received_us, void *arg) {
+    bench_count_priority(received_us);
+}
+#endif
+
+int main() {
+    struct netif_rmii_ethernet_config netif_config = {
+        pio0, // PIO:            0
+        0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+        6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+        10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+        14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+        NULL, // MAC address (optional - NULL generates one based on flash id) 
+        10,   // speed:          10 Mbit/s, as the W5100S firmware
+        NETIF_RMII_ETHERNET_DUPLEX_FULL,
+    };
+
+    // change the system clock to use the RMII reference clock from pin 20    
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+
+    // initialize stdio after the clock change, a terminal is only waited for with
+    // BOOT_STDIO_USB_WAIT_MS and a USB host attached
+    stdio_init_all();
+    boot_stdio_wait();
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // initialize the PIO base RMII Ethernet network interface
+    netif_rmii_ethernet_init(&g_netif, &netif_config);
+    
+    // set ip configuration, the address of the W5100S firmware
+    IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+
+    netif_set_link_callback(&g_netif, netif_link_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    // serves from lwIP timers on the core running lwIP
+    bench_init("lan8720");
+
+#if PICO_RMII_ETHERNET_CPU_STATS
+    // busy is what wasn't asleep or in an empty pass, split by class, on either layout
+    bench_cpu_source(netif_rmii_ethernet_cpu_idle_us);
+    bench_cpu_split_source(NETIF_RMII_ETHERNET_CPU_CLASSES, bench_cpu_names, bench_cpu_split);
+#elif PICO_RMII_ETHERNET_LOOP_WFE && !PICO_RMII_ETHERNET_DUAL_CORE
+    // the loop's sleeps are the idle time of the core running lwIP and the driver
+    bench_cpu_source(netif_rmii_ethernet_idle_us);
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    netif_rmii_ethernet_rx_priority_set(0, BENCH_PRIORITY_PORT, bench_priority_callback, NULL);
+#endif
+
+    // setup core 1 to monitor the RMII ethernet interface
+    multicore_launch_core1(netif_rmii_ethernet_loop);
+
+    while (1) {
+#if PICO_RMII_ETHERNET_DUAL_CORE
+        // core 1 only runs the driver, lwIP and the benchmark stay on this core
+        netif_rmii_ethernet_poll();
+#endif
+    }
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/timeouts.h"
+#include "netif/bridgeif.h"
+
+#include "rmii_ethernet/netif.h"
+
+// a station of a daisy chain: two LAN8720 ports, on pio0 and pio1, bridged by lwIP's
+// bridgeif. Frames between the ports are forwarded from the driver's poll by the port's
+// netif->input(), with the MAC learning table of the bridge, and never reach the IP
+// stack. Frames for the station go up through the bridge's netif, 192.168.1.15.
+//
+// Both PHYs have to run from the 50 MHz REF_CLK on pin 20 that clk_sys is taken from,
+// the second board's oscillator removed, see the README
+#ifndef BRIDGE_REPORT_MS
+#define BRIDGE_REPORT_MS 10000
+#endif
+
+// MAC addresses the bridge learns, one per station down the line each way and the hosts
+#ifndef BRIDGE_FDB_ENTRIES
+#define BRIDGE_FDB_ENTRIES 32
+#endif
+
+// LWIP network interfaces, the ports and the bridge
+struct netif g_port_netifs[2];
+struct netif g_netif;
+
+static void bridge_report(void *arg) {
+    for (int i = 0; i < 2; i++) {
+        struct netif_rmii_ethernet_stats stats;
+
+        netif_rmii_ethernet_netif_get_stats(&g_port_netifs[i], &stats);
+
+        printf("port %c%c: link %s, rx %lu ok %lu crc %lu nobuf %lu overrun, tx %lu ok %lu nobuf\n",
+            g_port_netifs[i].name[0], g_port_netifs[i].name[1], netif_is_link_up(&g_port_netifs[i]) ? "up" : "down",
+            (unsigned long)stats.rx_ok, (unsigned long)stats.rx_crc_err, (unsigned long)stats.rx_nobuf,
+            (unsigned long)stats.rx_overrun, (unsigned long)stats.tx_ok, (unsigned long)stats.tx_nobuf);
+    }
+
+    sys_timeout(BRIDGE_REPORT_MS, bridge_report, NULL);
+}
+
+void netif_link_callback(struct netif *netif)
+{
+    uint speed;
+    enum netif_rmii_ethernet_duplex duplex;
+
+    netif_rmii_ethernet_netif_get_link(netif, &speed, &duplex);
+
+    if (netif_is_link_up(netif)) {
+        printf("netif %c%c link status changed up, %u Mbit/s %s duplex\n", netif->name[0], netif->name[1],
+            speed, (duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL) ? "full" : "half");
+    } else {
+        printf("netif %c%c link status changed down\n", netif->name[0], netif->name[1]);
+    }
+}
+
+void netif_status_callback(struct netif *netif)
+{
+    printf("netif status changed %s\n", ip4addr_ntoa(netif_ip4_addr(netif)));
+}
+
+int main() {
+    struct netif_rmii_ethernet_config port_configs[2] = {
+        {
+            pio0, // PIO:            0
+            0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+            6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+            10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+            14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+            NULL, // MAC address (optional - NULL generates one based on flash id)
+            10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+            NETIF_RMII_ETHERNET_DUPLEX_FULL,
+            20,   // ref clk pin:    20, shared by both PHYs
+        },
+        {
+            pio1, // PIO:            1
+            0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+            16,   // rx pin start:   16, 17, 18 => RX0, RX1, CRS
+            2,    // tx pin start:   2, 3, 4    => TX0, TX1, TX-EN
+            26,   // mdio pin start: 26, 27     => MDIO, MDC
+            NULL, // MAC address (optional - NULL generates one based on flash id)
+            10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+            NETIF_RMII_ETHERNET_DUPLEX_FULL,
+            20,   // ref clk pin:    20, shared by both PHYs
+        },
+    };
+
+    // change the system clock to use the RMII reference clock from pin 20
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+    sleep_ms(100);
+
+    // initialize stdio after the clock change
+    stdio_init_all();
+    sleep_ms(5000);
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // initialize the two PIO base RMII Ethernet ports, e0 and e1
+    for (int i = 0; i < 2; i++) {
+        if (netif_rmii_ethernet_init(&g_port_netifs[i], &port_configs[i]) != ERR_OK) {
+            printf("port %d init failed\n", i);
+
+            while (1) {
+                tight_loop_contents();
+            }
+        }
+
+        netif_set_link_callback(&g_port_netifs[i], netif_link_callback);
+    }
+
+    // the bridge has a MAC of its own, the second port's made locally administered
+    bridgeif_initdata_t bridge_initdata = {
+        .max_ports = 2,
+        .max_fdb_dynamic_entries = BRIDGE_FDB_ENTRIES,
+        .max_fdb_static_entries = 0,
+    };
+
+    memcpy(&bridge_initdata.ethaddr, g_port_netifs[1].hwaddr, ETH_HWADDR_LEN);
+    bridge_initdata.ethaddr.addr[0] |= 0x02; // locally administered
+
+    ip4_addr_t addr, netmask, gw;
+
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    IP4_ADDR(&gw, 192, 168, 1, 1);
+
+    netif_add(&g_netif, &addr, &netmask, &gw, &bridge_initdata, bridgeif_init, netif_input);
+
+    for (int i = 0; i < 2; i++) {
+        bridgeif_add_port(&g_netif, &g_port_netifs[i]);
+
+        // frames for the stations down the line are addressed to their MACs, not the port's
+        netif_rmii_ethernet_netif_set_promiscuous(&g_port_netifs[i], true);
+        netif_set_up(&g_port_netifs[i]);
+    }
+
+    // assign callbacks for status
+    netif_set_status_callback(&g_netif, netif_status_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    sys_timeout(BRIDGE_REPORT_MS, bridge_report, NULL);
+
+    // setup core 1 to monitor the RMII ethernet interfaces
+    multicore_launch_core1(netif_rmii_ethernet_loop);
+
+    while (1) {
+#if PICO_RMII_ETHERNET_DUAL_CORE
+        // core 1 only runs the driver, lwIP and the bridge stay on this core
+        netif_rmii_ethernet_poll();
+#endif
+    }
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/opt.h"
+#include "lwip/inet_chksum.h"
+
+// times lwIP's lwip_standard_chksum(), built with LWIP_CHKSUM_ALGORITHM 1, 2 or 3,
+// against lwip_rp2040_chksum() on typical segment sizes and alignments, then lwIP's
+// memcpy + checksum against the fused lwip_rp2040_chksum_copy()
+
+// not in lwIP's headers, it is only built when LWIP_CHKSUM is left to lwIP
+u16_t lwip_standard_chksum(const void *dataptr, int len);
+
+u16_t lwip_rp2040_chksum(const void *dataptr, int len);
+u16_t lwip_rp2040_chksum_copy(void *dst, const void *src, u16_t len);
+
+#define ITERATIONS 1000
+
+static const int sizes[] = { 20, 64, 536, 1460 };
+
+static uint8_t buffer[1460 + 4] __attribute__((aligned(4)));
+static uint8_t copy_buffer[1460 + 4] __attribute__((aligned(4)));
+
+typedef u16_t (*chksum_fn)(const void *dataptr, int len);
+
+static uint32_t time_chksum(chksum_fn fn, const void *data, int len) {
+    uint32_t start = time_us_32();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        fn(data, len);
+    }
+
+    return time_us_32() - start;
+}
+
+static u16_t stock_chksum_copy(void *dst, const void *src, u16_t len) {
+    memcpy(dst, src, len);
+    return lwip_standard_chksum(dst, len);
+}
+
+typedef u16_t (*chksum_copy_fn)(void *dst, const void *src, u16_t len);
+
+static uint32_t time_chksum_copy(chksum_copy_fn fn, void *dst, const void *src, u16_t len) {
+    uint32_t start = time_us_32();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        fn(dst, src, len);
+    }
+
+    return time_us_32() - start;
+}
+
+int main() {
+    stdio_init_all();
+
+    sleep_ms(5000);
+
+    for (uint i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = rand();
+    }
+
+    // cycles per byte = us * (clk_sys / 1 MHz) / (ITERATIONS * len)
+    uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+
+    printf("LWIP_CHKSUM_ALGORITHM %d, clk_sys %lu MHz, %d iterations\n", LWIP_CHKSUM_ALGORITHM, mhz, ITERATIONS);
+    printf("  len off      stock us  rp2040 us   stock c/B  rp2040 c/B\n");
+
+    for (uint s = 0; s < count_of(sizes); s++) {
+        for (int offset = 0; offset < 4; offset++) {
+            const uint8_t *data = buffer + offset;
+            int len = sizes[s];
+
+            if (lwip_standard_chksum(data, len) != lwip_rp2040_chksum(data, len)) {
+                printf("MISMATCH len %d offset %d: %04x != %04x\n", len, offset,
+                    lwip_standard_chksum(data, len), lwip_rp2040_chksum(data, len));
+            }
+
+            uint32_t stock = time_chksum(lwip_standard_chksum, data, len);
+            uint32_t rp2040 = time_chksum(lwip_rp2040_chksum, data, len);
+
+            printf("%5d %3d %13lu %10lu %11.2f %11.2f\n", len, offset, stock, rp2040,
+                (float)stock * mhz / (ITERATIONS * len), (float)rp2040 * mhz / (ITERATIONS * len));
+        }
+    }
+
+    printf("copy len src dst  stock us  rp2040 us   stock c/B  rp2040 c/B\n");
+
+    for (uint s = 0; s < count_of(sizes); s++) {
+        for (int offset = 0; offset < 4; offset++) {
+            // source always word aligned, destination offset like a pbuf payload after headers
+            uint8_t *dst = copy_buffer + offset;
+            u16_t len = sizes[s];
+
+            if (stock_chksum_copy(dst, buffer, len) != lwip_rp2040_chksum_copy(dst, buffer, len) ||
+                memcmp(dst, buffer, len) != 0) {
+                printf("MISMATCH copy len %d offset %d\n", len, offset);
+            }
+
+            uint32_t stock = time_chksum_copy(stock_chksum_copy, dst, buffer, len);
+            uint32_t rp2040 = time_chksum_copy(lwip_rp2040_chksum_copy, dst, buffer, len);
+
+            printf("%8d   0 %3d %9lu %10lu %11.2f %11.2f\n", len, offset, stock, rp2040,
+                (float)stock * mhz / (ITERATIONS * len), (float)rp2040 * mhz / (ITERATIONS * len));
+        }
+    }
+
+    while (1) {
+        tight_loop_contents();
+    }
+
+    return 0;
+}
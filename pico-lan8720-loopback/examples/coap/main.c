@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/apps/httpd.h"
+
+#include "rmii_ethernet/netif.h"
+
+#include "boot.h"
+#include "coap_demo.h"
+#include "coap_fs.h"
+
+// the CoAP resources of coap/coap_demo.h on lwIP, the same source as w5x00_coap, and the
+// httpd content of fs/ over both HTTP on port 80 and CoAP on port 5683
+
+// LWIP network interface
+struct netif g_netif;
+
+void netif_link_callback(struct netif *netif)
+{
+    uint speed;
+    enum netif_rmii_ethernet_duplex duplex;
+
+    netif_rmii_ethernet_netif_get_link(netif, &speed, &duplex);
+
+    if (netif_is_link_up(netif)) {
+        printf("netif link status changed up, %u Mbit/s %s duplex\n", speed, (duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL) ? "full" : "half");
+    } else {
+        printf("netif link status changed down\n");
+    }
+}
+
+int main() {
+    struct netif_rmii_ethernet_config netif_config = {
+        pio0, // PIO:            0
+        0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+        6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+        10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+        14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+        NULL, // MAC address (optional - NULL generates one based on flash id) 
+        10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+        NETIF_RMII_ETHERNET_DUPLEX_FULL,
+    };
+    // change the system clock to use the RMII reference clock from pin 20    
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+
+    // initialize stdio after the clock change, a terminal is only waited for with
+    // BOOT_STDIO_USB_WAIT_MS and a USB host attached
+    stdio_init_all();
+    boot_stdio_wait();
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // initialize the PIO base RMII Ethernet network interface
+    netif_rmii_ethernet_init(&g_netif, &netif_config);
+
+    // set ip configuration
+    IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+
+    netif_set_link_callback(&g_netif, netif_link_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    // runs from lwIP's timer and callbacks, on the core running lwIP
+    httpd_init();
+    coap_demo_init(coap_fs_find);
+
+    // setup core 1 to monitor the RMII ethernet interface
+    multicore_launch_core1(netif_rmii_ethernet_loop);
+
+    while (1) {
+#if PICO_RMII_ETHERNET_DUAL_CORE
+        // core 1 only runs the driver, lwIP and the server stay on this core
+        netif_rmii_ethernet_poll();
+#endif
+    }
+
+    return 0;
+}
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "hardware/clocks.h"
+
+#include "compress.h"
+
+// times compress.c on telemetry records, JSON and CSV, each case over the same RECORDS:
+//   msg        compress_message() per record, decoded alone (an MQTT publish)
+//   msg+dict   the same with DICT_RECORDS records of another run as the dictionary
+//   flush N    a stream flushed every N records (a writer's deadline), 0 when the block is full
+// and prints the output against the input, the time per record and the cycles per input
+// byte. Every output is decoded back and compared, a wrong byte prints MISMATCH
+
+#define RECORDS 256
+#define DICT_RECORDS 4
+
+#define RECORD_MAX 128
+
+enum kind {
+    KIND_JSON,
+    KIND_CSV,
+};
+
+static const char *const kind_names[] = { "json", "csv" };
+
+static char records[RECORDS][RECORD_MAX];
+static uint16_t record_len[RECORDS];
+
+static uint8_t dict[DICT_RECORDS * RECORD_MAX];
+static size_t dict_len;
+
+static struct compress compressor;
+
+// the output of a case and its decoding, after the dictionary
+static uint8_t output[RECORDS * COMPRESS_BOUND(RECORD_MAX) + COMPRESS_FRAME_HEAD_LEN];
+static uint8_t decoded[sizeof(dict) + RECORDS * RECORD_MAX];
+
+// a sensor's record at second t, the values wander the way readings do
+static uint16_t record_make(char *buf, enum kind kind, uint32_t t) {
+    int temp = 2150 + (rand() % 61) - 30;
+    int hum = 400 + (rand() % 21) - 10;
+    int rssi = -60 - (rand() % 11);
+    uint32_t vbat = 3300 - t / 64;
+
+    if (kind == KIND_JSON) {
+        return (uint16_t)snprintf(buf, RECORD_MAX,
+            "{\"ts\":%lu,\"dev\":\"pico-07\",\"temp\":%d.%02d,\"hum\":%d.%d,\"vbat\":%lu,\"rssi\":%d,\"ok\":true}\n",
+            (unsigned long)(1700000000 + t), temp / 100, temp % 100, hum / 10, hum % 10, (unsigned long)vbat, rssi);
+    }
+
+    return (uint16_t)snprintf(buf, RECORD_MAX, "%lu,pico-07,%d.%02d,%d.%d,%lu,%d\n", (unsigned long)(1700000000 + t),
+        temp / 100, temp % 100, hum / 10, hum % 10, (unsigned long)vbat, rssi);
+}
+
+static void records_make(enum kind kind) {
+    srand(1);
+    dict_len = 0;
+    for (uint i = 0; i < DICT_RECORDS; i++) {
+        dict_len += record_make((char *)dict + dict_len, kind, 100000 + i);
+    }
+
+    srand(2);
+    for (uint i = 0; i < RECORDS; i++) {
+        record_len[i] = record_make(records[i], kind, i);
+    }
+}
+
+// an LZ4 block after the len bytes of history at dst, returns the bytes it adds
+static size_t lz4_decode(const uint8_t *src, size_t src_len, uint8_t *dst, size_t len) {
+    const uint8_t *end = src + src_len;
+    size_t start = len;
+
+    while (src < end) {
+        uint8_t token = *src++;
+        size_t n = token >> 4;
+
+        if (n == 15) {
+            do {
+                n += *src;
+            } while (*src++ == 255);
+        }
+        memcpy(dst + len, src, n);
+        src += n;
+        len += n;
+
+        if (src >= end) {
+            break;
+        }
+
+        size_t offset = src[0] | (src[1] << 8);
+        src += 2;
+
+        n = token & 15;
+        if (n == 15) {
+            do {
+                n += *src;
+            } while (*src++ == 255);
+        }
+        n += 4;
+
+        // byte by byte, a match may overlap itself
+        for (size_t i = 0; i < n; i++, len++) {
+            dst[len] = dst[len - offset];
+        }
+    }
+
+    return len - start;
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static bool check(const uint8_t *out, size_t out_len, bool messages, bool with_dict) {
+    size_t base = with_dict ? dict_len : 0;
+    size_t len = base;
+    const uint8_t *end = out + out_len;
+
+    memcpy(decoded, dict, base);
+
+    if (messages) {
+        // size, block length, block, as the case stored them, each on the dictionary alone
+        for (uint i = 0; i < RECORDS; i++) {
+            size_t size = get32(out), block_len = get32(out + 4);
+
+            if ((size != record_len[i]) || (lz4_decode(out + 8, block_len, decoded, base) != size) ||
+                (memcmp(decoded + base, records[i], size) != 0)) {
+                return false;
+            }
+            out += 8 + block_len;
+        }
+
+        return out == end;
+    } else {
+        out += COMPRESS_FRAME_HEAD_LEN;
+        while (out < end) {
+            uint32_t block_len = get32(out);
+
+            out += 4;
+            if (block_len & 0x80000000u) {
+                block_len &= 0x7fffffff;
+                memcpy(decoded + len, out, block_len);
+                len += block_len;
+            } else {
+                len += lz4_decode(out, block_len, decoded, len);
+            }
+            out += block_len;
+        }
+    }
+
+    for (uint i = 0; i < RECORDS; i++) {
+        if (memcmp(decoded + base, records[i], record_len[i]) != 0) {
+            return false;
+        }
+        base += record_len[i];
+    }
+
+    return base == len;
+}
+
+// flush_every < 0 for messages
+static void bench(enum kind kind, int flush_every, bool with_dict, uint32_t mhz) {
+    size_t out_len = 0, in_len = 0;
+    uint32_t us = 0, start;
+    char name[16];
+
+    compress_init(&compressor, with_dict ? dict : NULL, with_dict ? dict_len : 0);
+
+    for (uint i = 0; i < RECORDS; i++) {
+        size_t n;
+
+        in_len += record_len[i];
+
+        if (flush_every < 0) {
+            start = time_us_32();
+            n = compress_message(&compressor, records[i], record_len[i]);
+            us += time_us_32() - start;
+
+            // the size, then the block's length for check(), not counted: MQTT carries it
+            memcpy(output + out_len, compressor.out, 4);
+            put32(output + out_len + 4, n - 4);
+            memcpy(output + out_len + 8, compressor.out + 4, n - 4);
+            out_len += 4 + n;
+            continue;
+        }
+
+        start = time_us_32();
+        if (compress_room(&compressor) < record_len[i]) {
+            n = compress_flush(&compressor);
+            memcpy(output + out_len, compressor.out, n);
+            out_len += n;
+        }
+        compress_write(&compressor, records[i], record_len[i]);
+        if ((flush_every > 0) && ((i + 1) % flush_every == 0)) {
+            n = compress_flush(&compressor);
+            memcpy(output + out_len, compressor.out, n);
+            out_len += n;
+        }
+        us += time_us_32() - start;
+    }
+
+    if (flush_every >= 0) {
+        start = time_us_32();
+        size_t n = compress_flush(&compressor);
+        us += time_us_32() - start;
+        memcpy(output + out_len, compressor.out, n);
+        out_len += n;
+    }
+
+    if (flush_every < 0) {
+        snprintf(name, sizeof(name), "msg%s", with_dict ? "+dict" : "");
+    } else {
+        snprintf(name, sizeof(name), "flush %d", flush_every);
+    }
+
+    // the lengths check() needed aren't output
+    size_t wire_len = (flush_every < 0) ? out_len - 4 * RECORDS : out_len;
+
+    printf("%-5s %-9s %6u %6u %5.1f%% %7.1f %7.1f%s\n", kind_names[kind], name, (uint)in_len, (uint)wire_len,
+        100.0f * wire_len / in_len, (float)us / RECORDS, (float)us * mhz / in_len,
+        check(output, out_len, flush_every < 0, with_dict) ? "" : "  MISMATCH");
+}
+
+int main() {
+    stdio_init_all();
+
+    sleep_ms(5000);
+
+    // cycles per byte = us * (clk_sys / 1 MHz) / input bytes
+    uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+
+    printf("COMPRESS_HASH_BITS %d, COMPRESS_WINDOW %d, clk_sys %lu MHz, %d records per case\n", COMPRESS_HASH_BITS,
+        COMPRESS_WINDOW, mhz, RECORDS);
+    printf("kind  case           in    out  ratio  us/rec     c/B\n");
+
+    for (int kind = KIND_JSON; kind <= KIND_CSV; kind++) {
+        records_make(kind);
+
+        bench(kind, -1, false, mhz);
+        bench(kind, -1, true, mhz);
+        bench(kind, 1, false, mhz);
+        bench(kind, 4, false, mhz);
+        bench(kind, 16, false, mhz);
+        bench(kind, 0, false, mhz);
+    }
+
+    while (1) {
+        tight_loop_contents();
+    }
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/timeouts.h"
+#include "lwip/apps/lwiperf.h"
+
+#include "rmii_ethernet/netif.h"
+
+// Cyclic traffic next to bulk traffic: a frame of CYCLIC_ETHERTYPE goes to CYCLIC_DST
+// every CYCLIC_PERIOD_US, sent with the scheduled TX at a time on the period's grid, while
+// the iperf 2 server on port 5001 keeps lwIP's TX ring busy. Every CYCLIC_REPORT_MS it
+// prints how far after its time the DMA started on each frame, as a histogram over USB
+// stdio. The frames carry their sequence number and time, for a capture on the other end
+//
+//   iperf -c 192.168.1.15 -r
+#ifndef CYCLIC_ETHERTYPE
+#define CYCLIC_ETHERTYPE 0x88b5 // IEEE 802 local experimental EtherType 1
+#endif
+
+#ifndef CYCLIC_PERIOD_US
+#define CYCLIC_PERIOD_US 1000
+#endif
+
+// bytes of a frame, without FCS
+#ifndef CYCLIC_FRAME_SIZE
+#define CYCLIC_FRAME_SIZE 64
+#endif
+
+#ifndef CYCLIC_REPORT_MS
+#define CYCLIC_REPORT_MS 10000
+#endif
+
+// the frames are scheduled this far ahead of their time, and a cycle the callback is
+// too late to schedule in time is skipped
+#define CYCLIC_FRAMES PICO_RMII_ETHERNET_TX_SCHEDULED_SLOTS
+#define CYCLIC_MARGIN_US 100
+
+// 0 us, then log2 buckets up to 512 us and more
+#define CYCLIC_BUCKETS 11
+
+static const uint8_t cyclic_dst[ETH_HWADDR_LEN] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+// LWIP network interface
+struct netif g_netif;
+
+static uint8_t cyclic_frames[CYCLIC_FRAMES][CYCLIC_FRAME_SIZE];
+static uint cyclic_running;
+
+static uint32_t cyclic_seq;
+static uint32_t cyclic_sent;
+static uint32_t cyclic_skipped;
+static uint32_t cyclic_dropped;
+static int32_t cyclic_late_max_us;
+static uint32_t cyclic_late[CYCLIC_BUCKETS];
+
+static void cyclic_done(const uint8_t *frame, err_t err, int32_t late_us, void *arg);
+
+// the next cycle's frame in the buffer that just came back, at launch_us or the first
+// time on the grid after it that can still be met
+static void cyclic_schedule(uint8_t *frame, uint64_t launch_us) {
+    uint64_t now = time_us_64();
+
+    while (launch_us < now + CYCLIC_MARGIN_US) {
+        launch_us += (uint64_t)CYCLIC_FRAMES * CYCLIC_PERIOD_US;
+        cyclic_skipped++;
+    }
+
+    memcpy(frame + SIZEOF_ETH_HDR, &cyclic_seq, sizeof(cyclic_seq));
+    memcpy(frame + SIZEOF_ETH_HDR + 4, &launch_us, sizeof(launch_us));
+
+    if (netif_rmii_ethernet_netif_tx_schedule(&g_netif, frame, CYCLIC_FRAME_SIZE, launch_us, cyclic_done, NULL) != ERR_OK) {
+        cyclic_running--;
+
+        return;
+    }
+
+    cyclic_seq++;
+}
+
+// from netif_rmii_ethernet_poll(), the frame is out
+static void cyclic_done(const uint8_t *frame, err_t err, int32_t late_us, void *arg) {
+    uint64_t launch_us;
+
+    if (err != ERR_OK) {
+        // the link went down, the cycle starts again with it
+        cyclic_dropped++;
+        cyclic_running--;
+
+        return;
+    }
+
+    uint bucket = 0;
+
+    while (bucket < CYCLIC_BUCKETS - 1 && late_us >= (1 << bucket)) {
+        bucket++;
+    }
+
+    cyclic_late[bucket]++;
+    cyclic_sent++;
+
+    if (late_us > cyclic_late_max_us) {
+        cyclic_late_max_us = late_us;
+    }
+
+    memcpy(&launch_us, frame + SIZEOF_ETH_HDR + 4, sizeof(launch_us));
+
+    cyclic_schedule((uint8_t *)frame, launch_us + (uint64_t)CYCLIC_FRAMES * CYCLIC_PERIOD_US);
+}
+
+static void cyclic_start(struct netif *netif) {
+    // the grid starts on a whole period, a few periods from now
+    uint64_t start_us = (time_us_64() / CYCLIC_PERIOD_US + 4) * CYCLIC_PERIOD_US;
+
+    for (uint i = 0; i < CYCLIC_FRAMES; i++) {
+        uint8_t *frame = cyclic_frames[i];
+
+        memcpy(frame, cyclic_dst, ETH_HWADDR_LEN);
+        memcpy(frame + ETH_HWADDR_LEN, netif->hwaddr, ETH_HWADDR_LEN);
+        frame[12] = CYCLIC_ETHERTYPE >> 8;
+        frame[13] = CYCLIC_ETHERTYPE & 0xff;
+
+        cyclic_running++;
+        cyclic_schedule(frame, start_us + (uint64_t)i * CYCLIC_PERIOD_US);
+    }
+}
+
+static void cyclic_report(void *arg) {
+    struct netif_rmii_ethernet_stats stats;
+
+    netif_rmii_ethernet_get_stats(&stats);
+
+    printf("cyclic: %lu sent, %lu skipped, %lu dropped, late max %ld us, tx %lu ok, late us:",
+        (unsigned long)cyclic_sent, (unsigned long)cyclic_skipped, (unsigned long)cyclic_dropped,
+        (long)cyclic_late_max_us, (unsigned long)stats.tx_ok);
+
+    for (uint i = 0; i < CYCLIC_BUCKETS; i++) {
+        printf(" %s%u:%lu", (i == CYCLIC_BUCKETS - 1) ? ">=" : "<", (i == CYCLIC_BUCKETS - 1) ? (1u << (i - 1)) : (1u << i),
+            (unsigned long)cyclic_late[i]);
+    }
+
+    printf("\n");
+
+    memset(cyclic_late, 0, sizeof(cyclic_late));
+    cyclic_late_max_us = 0;
+
+    sys_timeout(CYCLIC_REPORT_MS, cyclic_report, NULL);
+}
+
+static void iperf_report(void *arg, enum lwiperf_report_type report_type,
+    const ip_addr_t *local_addr, u16_t local_port, const ip_addr_t *remote_addr, u16_t remote_port,
+    u32_t bytes_transferred, u32_t ms_duration, u32_t bandwidth_kbitpsec)
+{
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(report_type);
+    LWIP_UNUSED_ARG(local_addr);
+    LWIP_UNUSED_ARG(local_port);
+
+    printf("iperf %s:%u: %lu bytes in %lu ms, %lu kbit/s\n", ipaddr_ntoa(remote_addr), remote_port,
+        (unsigned long)bytes_transferred, (unsigned long)ms_duration, (unsigned long)bandwidth_kbitpsec);
+}
+
+void netif_link_callback(struct netif *netif)
+{
+    uint speed;
+    enum netif_rmii_ethernet_duplex duplex;
+
+    netif_rmii_ethernet_netif_get_link(netif, &speed, &duplex);
+
+    if (netif_is_link_up(netif)) {
+        printf("netif link status changed up, %u Mbit/s %s duplex\n", speed, (duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL) ? "full" : "half");
+
+        // frames of the last link still pending come back dropped and aren't scheduled again
+        if (cyclic_running == 0) {
+            cyclic_start(netif);
+        }
+    } else {
+        printf("netif link status changed down\n");
+    }
+}
+
+int main() {
+    struct netif_rmii_ethernet_config netif_config = {
+        pio0, // PIO:            0
+        0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+        6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+        10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+        14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+        NULL, // MAC address (optional - NULL generates one based on flash id)
+        10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+        NETIF_RMII_ETHERNET_DUPLEX_FULL,
+    };
+
+    // change the system clock to use the RMII reference clock from pin 20
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+    sleep_ms(100);
+
+    // initialize stdio after the clock change
+    stdio_init_all();
+    sleep_ms(5000);
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // initialize the PIO base RMII Ethernet network interface
+    netif_rmii_ethernet_init(&g_netif, &netif_config);
+
+    // set ip configuration
+    IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+
+    netif_set_link_callback(&g_netif, netif_link_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    printf("cyclic frames of EtherType 0x%04x every %u us, iperf server on port %d\n", CYCLIC_ETHERTYPE,
+        CYCLIC_PERIOD_US, LWIPERF_TCP_PORT_DEFAULT);
+
+    lwiperf_start_tcp_server_default(iperf_report, NULL);
+
+    sys_timeout(CYCLIC_REPORT_MS, cyclic_report, NULL);
+
+    // setup core 1 to monitor the RMII ethernet interface
+    multicore_launch_core1(netif_rmii_ethernet_loop);
+
+    while (1) {
+#if PICO_RMII_ETHERNET_DUAL_CORE
+        // core 1 only runs the driver, lwIP, the cycle and its alarm stay on this core
+        netif_rmii_ethernet_poll();
+#endif
+    }
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "hardware/clocks.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/ip_addr.h"
+#include "lwip/sockets.h"
+#include "lwip/tcpip.h"
+
+#include "rmii_ethernet/netif.h"
+
+// blocking BSD socket echo server, lwIP runs in its tcpip thread (NO_SYS=0)
+#define SERVER_PORT 5000
+
+#define DRIVER_TASK_PRIO (tskIDLE_PRIORITY + 4)
+#define ECHO_TASK_PRIO   (tskIDLE_PRIORITY + 2)
+
+// LWIP network interface
+struct netif g_netif;
+
+static struct netif_rmii_ethernet_config netif_config = {
+    pio0, // PIO:            0
+    0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+    6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+    10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+    14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+    NULL, // MAC address (optional - NULL generates one based on flash id) 
+    10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+    NETIF_RMII_ETHERNET_DUPLEX_FULL,
+};
+
+void netif_link_callback(struct netif *netif)
+{
+    uint speed;
+    enum netif_rmii_ethernet_duplex duplex;
+
+    netif_rmii_ethernet_netif_get_link(netif, &speed, &duplex);
+
+    if (netif_is_link_up(netif)) {
+        printf("netif link status changed up, %u Mbit/s %s duplex\n", speed, (duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL) ? "full" : "half");
+    } else {
+        printf("netif link status changed down\n");
+    }
+}
+
+void netif_status_callback(struct netif *netif)
+{
+    printf("netif status changed %s\n", ip4addr_ntoa(netif_ip4_addr(netif)));
+}
+
+static void driver_task(void *arg)
+{
+    // blocks on task notifications from the RX/TX interrupts between polls
+    netif_rmii_ethernet_loop();
+}
+
+static void echo_client(int s)
+{
+    char buf[536];
+    int len;
+
+    while ((len = recv(s, buf, sizeof(buf), 0)) > 0) {
+        char *p = buf;
+
+        while (len > 0) {
+            int sent = send(s, p, len, 0);
+
+            if (sent <= 0) {
+                return;
+            }
+
+            p += sent;
+            len -= sent;
+        }
+    }
+}
+
+static void echo_task(void *arg)
+{
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_len = sizeof(addr),
+        .sin_family = AF_INET,
+        .sin_port = PP_HTONS(SERVER_PORT),
+        .sin_addr.s_addr = PP_HTONL(INADDR_ANY),
+    };
+
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 1) < 0) {
+        printf("echo server socket setup failed\n");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    printf("echo server listening on port %d\n", SERVER_PORT);
+
+    while (1) {
+        int s = accept(listen_fd, NULL, NULL);
+
+        if (s < 0) {
+            continue;
+        }
+
+        echo_client(s);
+        close(s);
+    }
+}
+
+static void main_task(void *arg)
+{
+    // starts the tcpip thread, lwIP can only be entered with its core lock from here on
+    tcpip_init(NULL, NULL);
+
+    LOCK_TCPIP_CORE();
+
+    // initialize the PIO base RMII Ethernet network interface
+    netif_rmii_ethernet_init(&g_netif, &netif_config);
+
+    // set ip configuration
+    IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+
+    // assign callbacks for link and status
+    netif_set_link_callback(&g_netif, netif_link_callback);
+    netif_set_status_callback(&g_netif, netif_status_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    UNLOCK_TCPIP_CORE();
+
+    TaskHandle_t driver;
+
+    xTaskCreate(driver_task, "rmii", 1024, NULL, DRIVER_TASK_PRIO, &driver);
+#if configUSE_CORE_AFFINITY && configNUMBER_OF_CORES > 1
+    // keep the driver's polling on core 1, the tcpip thread and the application
+    // tasks are free to run on either core
+    vTaskCoreAffinitySet(driver, 1 << 1);
+#endif
+
+    xTaskCreate(echo_task, "echo", 1024, NULL, ECHO_TASK_PRIO, NULL);
+
+    vTaskDelete(NULL);
+}
+
+int main() {
+    // change the system clock to use the RMII reference clock from pin 20    
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+    sleep_ms(100);
+
+    // initialize stdio after the clock change
+    stdio_init_all();
+    sleep_ms(5000);
+
+    xTaskCreate(main_task, "main", 1024, NULL, tskIDLE_PRIORITY + 1, NULL);
+
+    vTaskStartScheduler();
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/apps/lwiperf.h"
+
+#include "rmii_ethernet/netif.h"
+
+// iperf 2 server on port 5001 (iperf -c 192.168.1.15), and optionally a client that
+// sends to IPERF_CLIENT_ADDR (iperf -s on that host) every time the link comes up
+#ifndef IPERF_CLIENT_ADDR
+#define IPERF_CLIENT_ADDR NULL // e.g. "192.168.1.2"
+#endif
+
+// LWIPERF_CLIENT (TX only), LWIPERF_DUAL or LWIPERF_TRADEOFF
+#ifndef IPERF_CLIENT_TYPE
+#define IPERF_CLIENT_TYPE LWIPERF_CLIENT
+#endif
+
+// LWIP network interface
+struct netif g_netif;
+
+static const char *const iperf_report_names[] = {
+    "server done",
+    "client done",
+    "aborted by local",
+    "aborted, data check error",
+    "aborted, tx error",
+    "aborted by remote",
+};
+
+static void iperf_report(void *arg, enum lwiperf_report_type report_type,
+    const ip_addr_t *local_addr, u16_t local_port, const ip_addr_t *remote_addr, u16_t remote_port,
+    u32_t bytes_transferred, u32_t ms_duration, u32_t bandwidth_kbitpsec)
+{
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(local_addr);
+    LWIP_UNUSED_ARG(local_port);
+
+    printf("iperf %s, %s:%u: %lu bytes in %lu ms, %lu kbit/s\n",
+        (uint)report_type < count_of(iperf_report_names) ? iperf_report_names[report_type] : "report",
+        ipaddr_ntoa(remote_addr), remote_port,
+        (unsigned long)bytes_transferred, (unsigned long)ms_duration, (unsigned long)bandwidth_kbitpsec);
+}
+
+void netif_link_callback(struct netif *netif)
+{
+    uint speed;
+    enum netif_rmii_ethernet_duplex duplex;
+
+    netif_rmii_ethernet_netif_get_link(netif, &speed, &duplex);
+
+    if (netif_is_link_up(netif)) {
+        printf("netif link status changed up, %u Mbit/s %s duplex\n", speed, (duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL) ? "full" : "half");
+    } else {
+        printf("netif link status changed down\n");
+    }
+
+    const char *client_addr = IPERF_CLIENT_ADDR;
+    ip_addr_t remote_addr;
+
+    if (netif_is_link_up(netif) && client_addr != NULL && ipaddr_aton(client_addr, &remote_addr)) {
+        printf("iperf client to %s:%d\n", client_addr, LWIPERF_TCP_PORT_DEFAULT);
+
+        lwiperf_start_tcp_client(&remote_addr, LWIPERF_TCP_PORT_DEFAULT, IPERF_CLIENT_TYPE, iperf_report, NULL);
+    }
+}
+
+void netif_status_callback(struct netif *netif)
+{
+    printf("netif status changed %s\n", ip4addr_ntoa(netif_ip4_addr(netif)));
+}
+
+int main() {
+    struct netif_rmii_ethernet_config netif_config = {
+        pio0, // PIO:            0
+        0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+        6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+        10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+        14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+        NULL, // MAC address (optional - NULL generates one based on flash id) 
+        10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+        NETIF_RMII_ETHERNET_DUPLEX_FULL,
+    };
+
+    // change the system clock to use the RMII reference clock from pin 20    
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+    sleep_ms(100);
+
+    // initialize stdio after the clock change
+    stdio_init_all();
+    sleep_ms(5000);
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // initialize the PIO base RMII Ethernet network interface
+    netif_rmii_ethernet_init(&g_netif, &netif_config);
+    
+    // set ip configuration
+    IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+
+    // assign callbacks for link and status
+    netif_set_link_callback(&g_netif, netif_link_callback);
+    netif_set_status_callback(&g_netif, netif_status_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    printf("start iperf server on port %d\n", LWIPERF_TCP_PORT_DEFAULT);
+
+    lwiperf_start_tcp_server_default(iperf_report, NULL);
+
+    // setup core 1 to monitor the RMII ethernet interface
+    multicore_launch_core1(netif_rmii_ethernet_loop);
+
+    while (1) {
+#if PICO_RMII_ETHERNET_DUAL_CORE
+        // core 1 only runs the driver, lwIP and iperf stay on this core
+        netif_rmii_ethernet_poll();
+#endif
+    }
+
+    return 0;
+}
@@ -4,6 +4,9 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include <stdio.h>
+#include <string.h>
+
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
 
@@ -11,19 +14,115 @@
 
 #include "lwip/dhcp.h"
 #include "lwip/init.h"
+#include "lwip/memp.h"
+#include "lwip/sys.h"
 #include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+#include "lwip/stats.h"
 #include "lwip/apps/httpd.h"
+#include "lwip/priv/tcp_priv.h"
 
 #include "rmii_ethernet/netif.h"
 
+#include "boot.h"
+#include "clock_profile.h"
+
+#if PICO_RMII_ETHERNET_TRACE
+#include "trace.h"
+#endif
+
+#include "lwip_dhcp_lease.h"
+#include "lwip_metrics.h"
+#include "lwip_telemetry.h"
+
+#if LWIP_HTTPD_WEBSOCKET
+#include "websocket.h"
+#endif
+
+#if LWIP_MDNS_RESPONDER
+#include "lwip/apps/mdns.h"
+#endif
+
+
+/* Ports */
+#define SERVER_PORT 5000  /* echo, RX and TX */
+#define DISCARD_PORT 9    /* discard (RFC 863), RX only */
+#define CHARGEN_PORT 19   /* character generator (RFC 864), TX only */
+#define STATS_PORT 5100   /* UDP, any datagram is answered with the stats of each connection */
+
+/* Interval of the per-connection counters report on stdio, 0 disables it */
+#ifndef BENCH_REPORT_MS
+#define BENCH_REPORT_MS 1000
+#endif
+
+/* Interval of the driver's RX/TX stage histograms on stdio, with PICO_RMII_ETHERNET_PROFILE,
+   they are reset after each report */
+#ifndef PROFILE_REPORT_MS
+#define PROFILE_REPORT_MS 10000
+#endif
+
+/* Interval of the lwIP heap and pool report on stdio, 0 disables it. Define
+   TELEMETRY_SYSLOG_ADDR (e.g. "192.168.1.2") to also send it to a syslog collector */
+#ifndef TELEMETRY_REPORT_MS
+#define TELEMETRY_REPORT_MS 10000
+#endif
+
+/* With PICO_RMII_ETHERNET_CAPTURE, define CAPTURE_ADDR (e.g. "192.168.1.2") to stream the
+   frames to it as pcapng over UDP, read with "nc -lu 5555 | wireshark -k -i -" */
+#ifndef CAPTURE_PORT
+#define CAPTURE_PORT 5555
+#endif
+
+/* Echo without copying: received pbufs are queued with tcp_write() by reference and
+   held until the data is acknowledged, 0 copies them into lwIP's send buffer */
+#ifndef ECHO_ZERO_COPY
+#define ECHO_ZERO_COPY 1
+#endif
+
+/* enum tcp_echoserver_policy of the echo port, discard and chargen are POLICY_THROUGHPUT */
+#ifndef ECHO_POLICY
+#define ECHO_POLICY POLICY_LOW_LATENCY
+#endif
 
-/* Port */
-#define SERVER_PORT 5000
+/* clk_sys profile of clock_profile.h with PICO_RMII_ETHERNET_REF_CLK_SYNC, otherwise clk_sys
+   is the 50 MHz REF_CLK. 100 Mbit/s needs 200 MHz or more, the RP2350 defaults to its rated
+   150 MHz, enough for 10 */
+#ifndef CLOCK_PROFILE_KHZ
+#if PICO_RP2350
+#define CLOCK_PROFILE_KHZ CLOCK_PROFILE_RATED_KHZ
+#else
+#define CLOCK_PROFILE_KHZ 250000
+#endif
+#endif
 
-/* CPU clock */
-#define CPU_FREQ 250000000
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC && !CLOCK_PROFILE_VALID(CLOCK_PROFILE_KHZ)
+#error "CLOCK_PROFILE_KHZ isn't one of the profiles of clock_profile.h"
+#endif
+
+/* Interval of the counters pushed to the WebSocket clients of WS_PUSH_URI, the status
+   page shows them live instead of polling, 0 disables it */
+#ifndef WS_PUSH_MS
+#define WS_PUSH_MS 200
+#endif
+#define WS_PUSH_URI "/live"
+
+/* connections of a push message, the first ones of tcp_echoserver_connections */
+#define WS_PUSH_CONNECTIONS 8
+
+/* the board answers mDNS as <MDNS_HOST_NAME>.local, with the status page and the echo
+   server for service browsers */
+#ifndef MDNS_HOST_NAME
+#define MDNS_HOST_NAME "pico-rmii"
+#endif
+#define MDNS_RECORD_TTL 120
+
+/* take the address from DHCP instead of 192.168.1.15, resuming the lease kept in flash
+   (lwip_dhcp_lease.h) after a reset. The new address is printed once it is bound */
+#ifndef DHCP_LEASE
+#define DHCP_LEASE 0
+#endif
 
-static struct tcp_pcb *tcp_echoserver_pcb;
 // LWIP network interface
 struct netif g_netif;
 
@@ -36,16 +135,98 @@ enum tcp_echoserver_states
   ES_CLOSING
 };
 
+/* states of an echo latency sample */
+enum tcp_echoserver_timing
+{
+  TIMING_NONE = 0,
+  TIMING_RECEIVED,      /* since rx_time, until the data is all passed to tcp_write() */
+  TIMING_WRITTEN        /* since write_time, until it is all acknowledged */
+};
+
+/* log2 buckets of an echo latency histogram: bucket 0 is under 2 us, bucket i from 2^i
+   to 2^(i+1) us, the last one 2^(LATENCY_BUCKETS-1) us (0.5 s) and more */
+#define LATENCY_BUCKETS 20
+
+struct tcp_echoserver_latency
+{
+  u32_t min;              /* in us */
+  u32_t max;
+  u32_t sum;
+  u32_t count;
+  u32_t buckets[LATENCY_BUCKETS];
+};
+
+/* Benchmark services, one listener each */
+enum bench_service
+{
+  BENCH_ECHO = 0,
+  BENCH_DISCARD,
+  BENCH_CHARGEN,
+  BENCH_SERVICES
+};
+
+static const char *const bench_service_names[] = { "echo", "discard", "chargen" };
+
+/* Latency policies of a listener, taken over by the connections it accepts */
+enum tcp_echoserver_policy
+{
+  POLICY_THROUGHPUT = 0,  /* lwIP's defaults: Nagle coalesces small segments, ACKs wait
+                             for data to ride on or the fast timer (TCP_TMR_INTERVAL) */
+  POLICY_LOW_LATENCY      /* Nagle off, received data ACKed at once, each batch of
+                             writes pushed out with tcp_output() */
+};
+
+static const char *const tcp_echoserver_policy_names[] = { "throughput", "low-latency" };
+
+/* a listening pcb, passed as its argument */
+struct tcp_echoserver_listener
+{
+  struct tcp_pcb *pcb;
+  u8_t service;           /* enum bench_service */
+  u8_t policy;            /* enum tcp_echoserver_policy */
+};
+
+static struct tcp_echoserver_listener tcp_echoserver_listeners[BENCH_SERVICES];
+
 /* structure for maintaing connection infos to be passed as argument 
    to LwIP callbacks*/
 struct tcp_echoserver_struct
 {
   u8_t state;             /* current connection state */
   u8_t retries;
+  u8_t service;           /* enum bench_service */
+  u8_t timing;            /* enum tcp_echoserver_timing of the echo latency sample */
+  u8_t policy;            /* enum tcp_echoserver_policy */
   struct tcp_pcb *pcb;    /* pointer on the current tcp_pcb */
   struct pbuf *p;         /* pointer on the received/to be transmitted pbuf */
+  u16_t offset;           /* bytes of the first pbuf of p already written */
+  u16_t chargen_offset;   /* position in chargen_pattern */
+  struct pbuf *unacked;   /* written by reference, held until acknowledged */
+  u32_t acked;            /* acknowledged bytes not yet matched to unacked */
+  struct tcp_echoserver_struct *next; /* list of open connections, for the report */
+
+  /* counters */
+  u32_t start_ms;         /* sys_now() at accept */
+  u32_t rx_bytes;         /* received */
+  u32_t tx_bytes;         /* sent and acknowledged */
+  u32_t report_rx_bytes;  /* rx_bytes at the last report */
+  u32_t report_tx_bytes;  /* tx_bytes at the last report */
+  u32_t rx_time;          /* time_us_32() when the echo data being timed arrived */
+  u32_t write_time;       /* time_us_32() when it was all passed to tcp_write() */
+  struct tcp_echoserver_latency latency; /* receive to acknowledgement of the echo */
+  struct tcp_echoserver_latency process; /* receive to tcp_write(), the device */
+  struct tcp_echoserver_latency network; /* tcp_write() to acknowledgement, the network and the peer */
 };
 
+/* connection state comes from its own pool, one per TCP pcb */
+LWIP_MEMPOOL_DECLARE(TCP_ECHOSERVER, MEMP_NUM_TCP_PCB, sizeof(struct tcp_echoserver_struct), "tcp_echoserver");
+
+static struct tcp_echoserver_struct *tcp_echoserver_connections;
+
+/* 72 character lines of the rotating printable ASCII pattern, written by reference */
+#define CHARGEN_LINE 74
+static u8_t chargen_pattern[95 * CHARGEN_LINE];
+
 
 static err_t tcp_echoserver_accept(void *arg, struct tcp_pcb *newpcb, err_t err);
 static err_t tcp_echoserver_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
@@ -54,6 +235,25 @@ static err_t tcp_echoserver_poll(void *arg, struct tcp_pcb *tpcb);
 static err_t tcp_echoserver_sent(void *arg, struct tcp_pcb *tpcb, u16_t len);
 static void tcp_echoserver_send(struct tcp_pcb *tpcb, struct tcp_echoserver_struct *es);
 static void tcp_echoserver_connection_close(struct tcp_pcb *tpcb, struct tcp_echoserver_struct *es);
+static void tcp_echoserver_free(struct tcp_echoserver_struct *es);
+static struct pbuf *tcp_echoserver_pbuf_pop(struct pbuf *p);
+static void tcp_chargen_send(struct tcp_pcb *tpcb, struct tcp_echoserver_struct *es);
+static void tcp_echoserver_policy_apply(struct tcp_pcb *tpcb, struct tcp_echoserver_struct *es);
+static void tcp_echoserver_policy_flush(struct tcp_pcb *tpcb, struct tcp_echoserver_struct *es);
+static void bench_report(void *arg);
+static void bench_report_connection(struct tcp_echoserver_struct *es, const char *event);
+static void bench_report_latency(struct tcp_echoserver_struct *es);
+static void tcp_echoserver_latency_add(struct tcp_echoserver_latency *latency, u32_t us);
+static void stats_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+#if PICO_RMII_ETHERNET_PROFILE && PROFILE_REPORT_MS
+static void profile_report(void *arg);
+#endif
+#if LWIP_HTTPD_WEBSOCKET && WS_PUSH_MS
+static void ws_push_init(void);
+#endif
+#if LWIP_HTTPD_CUSTOM_FILES
+static void metrics_init(void);
+#endif
 
 
 void netif_link_callback(struct netif *netif)
@@ -63,69 +263,187 @@ void netif_link_callback(struct netif *netif)
 
 void netif_status_callback(struct netif *netif)
 {
+#if DHCP_LEASE
+    printf("netif address %s\n", ip4addr_ntoa(netif_ip4_addr(netif)));
+#else
     //printf("netif status changed %s\n", ip4addr_ntoa(netif_ip4_addr(netif)));
+#endif
 }
 
 /**
-  * @brief  Initializes the tcp echo server
-  * @param  None
+  * @brief  Starts listening for one benchmark service
+  * @param  port: TCP port
+  * @param  service: enum bench_service handed to tcp_echoserver_accept
+  * @param  policy: enum tcp_echoserver_policy of its connections
   * @retval None
   */
-void tcp_echoserver_init(void)
+static void tcp_echoserver_listen(u16_t port, enum bench_service service, enum tcp_echoserver_policy policy)
 {
+  struct tcp_echoserver_listener *listener = &tcp_echoserver_listeners[service];
+
+  listener->service = (u8_t)service;
+  listener->policy = (u8_t)policy;
+
   /* create new tcp pcb */
-  tcp_echoserver_pcb = tcp_new();
+  struct tcp_pcb *pcb = tcp_new();
 
-  if (tcp_echoserver_pcb != NULL)
+  if (pcb != NULL)
   {
     err_t err;
     
-    /* bind echo_pcb to port 5000 (ECHO protocol) */
-    //err = tcp_bind(tcp_echoserver_pcb, IP_ADDR_ANY, SERVER_PORT);
-    err = tcp_bind(tcp_echoserver_pcb, &g_netif.ip_addr, SERVER_PORT);
+#if SO_REUSE
+    /* bind again while connections of an earlier listener are in TIME_WAIT */
+    ip_set_option(pcb, SOF_REUSEADDR);
+#endif
+
+    //err = tcp_bind(pcb, IP_ADDR_ANY, port);
+    err = tcp_bind(pcb, &g_netif.ip_addr, port);
     
     if (err == ERR_OK)
     {
-      /* start tcp listening for echo_pcb */
-      tcp_echoserver_pcb = tcp_listen(tcp_echoserver_pcb);
+      /* start tcp listening for pcb, with TCP_LISTEN_BACKLOG at most
+         TCP_DEFAULT_LISTEN_BACKLOG connections in the handshake */
+      pcb = tcp_listen(pcb);
+      listener->pcb = pcb;
       
       /* initialize LwIP tcp_accept callback function */
-      tcp_accept(tcp_echoserver_pcb, tcp_echoserver_accept);
+      tcp_arg(pcb, listener);
+      tcp_accept(pcb, tcp_echoserver_accept);
     }
     else 
     {
       /* deallocate the pcb */
-      memp_free(MEMP_TCP_PCB, tcp_echoserver_pcb);
+      memp_free(MEMP_TCP_PCB, pcb);
+    }
+  }
+}
+
+/**
+  * @brief  Selects the latency policy of a service's listener, for the connections it
+  *         accepts from now on and the ones it has open
+  * @param  service: enum bench_service
+  * @param  policy: enum tcp_echoserver_policy
+  * @retval None
+  */
+void tcp_echoserver_set_policy(enum bench_service service, enum tcp_echoserver_policy policy)
+{
+  struct tcp_echoserver_struct *es;
+
+  tcp_echoserver_listeners[service].policy = (u8_t)policy;
+
+  for (es = tcp_echoserver_connections; es != NULL; es = es->next)
+  {
+    if (es->service == service)
+    {
+      es->policy = (u8_t)policy;
+      tcp_echoserver_policy_apply(es->pcb, es);
+    }
+  }
+}
+
+/**
+  * @brief  Initializes the tcp echo, discard and chargen servers
+  * @param  None
+  * @retval None
+  */
+void tcp_echoserver_init(void)
+{
+  LWIP_MEMPOOL_INIT(TCP_ECHOSERVER);
+
+  for (uint line = 0; line < 95; line++)
+  {
+    for (uint i = 0; i < 72; i++)
+    {
+      chargen_pattern[line * CHARGEN_LINE + i] = ' ' + (line + i) % 95;
+    }
+
+    chargen_pattern[line * CHARGEN_LINE + 72] = '\r';
+    chargen_pattern[line * CHARGEN_LINE + 73] = '\n';
+  }
+
+  tcp_echoserver_listen(SERVER_PORT, BENCH_ECHO, ECHO_POLICY);
+  tcp_echoserver_listen(DISCARD_PORT, BENCH_DISCARD, POLICY_THROUGHPUT);
+  tcp_echoserver_listen(CHARGEN_PORT, BENCH_CHARGEN, POLICY_THROUGHPUT);
+
+  struct udp_pcb *stats_pcb = udp_new();
+
+  if (stats_pcb != NULL)
+  {
+    if (udp_bind(stats_pcb, &g_netif.ip_addr, STATS_PORT) == ERR_OK)
+    {
+      udp_recv(stats_pcb, stats_recv, NULL);
+    }
+    else
+    {
+      udp_remove(stats_pcb);
     }
   }
+
+#if BENCH_REPORT_MS
+  sys_timeout(BENCH_REPORT_MS, bench_report, NULL);
+#endif
+
+#if PICO_RMII_ETHERNET_PROFILE && PROFILE_REPORT_MS
+  sys_timeout(PROFILE_REPORT_MS, profile_report, NULL);
+#endif
+
+#if TELEMETRY_REPORT_MS
+#ifdef TELEMETRY_SYSLOG_ADDR
+  ip_addr_t syslog_addr;
+
+  ipaddr_aton(TELEMETRY_SYSLOG_ADDR, &syslog_addr);
+  lwip_telemetry_start(TELEMETRY_REPORT_MS, &syslog_addr);
+#else
+  lwip_telemetry_start(TELEMETRY_REPORT_MS, NULL);
+#endif
+#endif
+
+#if PICO_RMII_ETHERNET_CAPTURE && defined(CAPTURE_ADDR)
+  ip_addr_t capture_addr;
+
+  ipaddr_aton(CAPTURE_ADDR, &capture_addr);
+  netif_rmii_ethernet_capture_start(&capture_addr, CAPTURE_PORT);
+#endif
 }
 
 /**
   * @brief  This function is the implementation of tcp_accept LwIP callback
-  * @param  arg: not used
+  * @param  arg: struct tcp_echoserver_listener of the listening pcb
   * @param  newpcb: pointer on tcp_pcb struct for the newly created tcp connection
-  * @param  err: not used 
+  * @param  err: ERR_MEM when lwIP ran out of pcbs
   * @retval err_t: error status
   */
 static err_t tcp_echoserver_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
 {
   err_t ret_err;
   struct tcp_echoserver_struct *es;
+  const struct tcp_echoserver_listener *listener = (const struct tcp_echoserver_listener *)arg;
 
-  LWIP_UNUSED_ARG(arg);
-  LWIP_UNUSED_ARG(err);
+  /* lwIP reports a failed pcb allocation as an accept with no pcb */
+  if ((err != ERR_OK) || (newpcb == NULL))
+  {
+    return ERR_VAL;
+  }
 
   /* set priority for the newly accepted tcp connection newpcb */
   tcp_setprio(newpcb, TCP_PRIO_MIN);
 
   /* allocate structure es to maintain tcp connection informations */
-  es = (struct tcp_echoserver_struct *)mem_malloc(sizeof(struct tcp_echoserver_struct));
+  es = (struct tcp_echoserver_struct *)LWIP_MEMPOOL_ALLOC(TCP_ECHOSERVER);
   if (es != NULL)
   {
+    memset(es, 0, sizeof(*es));
     es->state = ES_ACCEPTED;
+    es->service = listener->service;
+    es->policy = listener->policy;
     es->pcb = newpcb;
-    es->retries = 0;
-    es->p = NULL;
+    es->start_ms = sys_now();
+    es->latency.min = UINT32_MAX;
+    es->process.min = UINT32_MAX;
+    es->network.min = UINT32_MAX;
+
+    es->next = tcp_echoserver_connections;
+    tcp_echoserver_connections = es;
     
     /* pass newly allocated es structure as argument to newpcb */
     tcp_arg(newpcb, es);
@@ -138,6 +456,17 @@ static err_t tcp_echoserver_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
     
     /* initialize lwip tcp_poll callback function for newpcb */
     tcp_poll(newpcb, tcp_echoserver_poll, 0);
+
+    /* acknowledged bytes are counted for every service */
+    tcp_sent(newpcb, tcp_echoserver_sent);
+
+    tcp_echoserver_policy_apply(newpcb, es);
+
+    if (es->service == BENCH_CHARGEN)
+    {
+      /* chargen starts sending straight away */
+      tcp_chargen_send(newpcb, es);
+    }
     
     ret_err = ERR_OK;
   }
@@ -174,7 +503,7 @@ static err_t tcp_echoserver_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p
   {
     /* remote host closed connection */
     es->state = ES_CLOSING;
-    if(es->p == NULL)
+    if(es->p == NULL && es->unacked == NULL)
     {
        /* we're done sending, close connection */
        tcp_echoserver_connection_close(tpcb, es);
@@ -196,15 +525,30 @@ static err_t tcp_echoserver_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p
     /* free received pbuf*/
     if (p != NULL)
     {
-      es->p = NULL;
       pbuf_free(p);
     }
     ret_err = err;
   }
+  else if (es->service != BENCH_ECHO)
+  {
+    /* discard and chargen drop whatever they receive */
+    es->rx_bytes += p->tot_len;
+    tcp_recved(tpcb, p->tot_len);
+    pbuf_free(p);
+
+    /* nothing goes back for the ACK to ride on */
+    tcp_echoserver_policy_flush(tpcb, es);
+    ret_err = ERR_OK;
+  }
   else if(es->state == ES_ACCEPTED)
   {
     /* first data chunk in p->payload */
     es->state = ES_RECEIVED;
+    es->rx_bytes += p->tot_len;
+
+    /* time until all of it has been echoed and acknowledged */
+    es->timing = TIMING_RECEIVED;
+    es->rx_time = time_us_32();
     
     /* store reference to incoming pbuf (chain) */
     es->p = p;
@@ -219,6 +563,14 @@ static err_t tcp_echoserver_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p
   }
   else if (es->state == ES_RECEIVED)
   {
+    es->rx_bytes += p->tot_len;
+
+    if (es->timing == TIMING_NONE)
+    {
+      es->timing = TIMING_RECEIVED;
+      es->rx_time = time_us_32();
+    }
+
     /* more data received from client and previous data has been already sent*/
     if(es->p == NULL)
     {
@@ -229,11 +581,11 @@ static err_t tcp_echoserver_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p
     }
     else
     {
-      struct pbuf *ptr;
+      /* chain pbufs to the end of what we recv'ed previously, taking over the reference */
+      pbuf_cat(es->p, p);
 
-      /* chain pbufs to the end of what we recv'ed previously  */
-      ptr = es->p;
-      pbuf_chain(ptr,p);
+      /* the window may have room for some of it */
+      tcp_echoserver_send(tpcb, es);
     }
     ret_err = ERR_OK;
   }
@@ -241,7 +593,6 @@ static err_t tcp_echoserver_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p
   {
     /* odd case, remote side closing twice, trash data */
     tcp_recved(tpcb, p->tot_len);
-    es->p = NULL;
     pbuf_free(p);
     ret_err = ERR_OK;
   }
@@ -249,7 +600,6 @@ static err_t tcp_echoserver_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p
   {
     /* unkown es->state, trash data  */
     tcp_recved(tpcb, p->tot_len);
-    es->p = NULL;
     pbuf_free(p);
     ret_err = ERR_OK;
   }
@@ -272,8 +622,8 @@ static void tcp_echoserver_error(void *arg, err_t err)
   es = (struct tcp_echoserver_struct *)arg;
   if (es != NULL)
   {
-    /*  free es structure */
-    mem_free(es);
+    /* the pcb and its segments are already gone, free es structure and its pbufs */
+    tcp_echoserver_free(es);
   }
 }
 
@@ -291,7 +641,12 @@ static err_t tcp_echoserver_poll(void *arg, struct tcp_pcb *tpcb)
   es = (struct tcp_echoserver_struct *)arg;
   if (es != NULL)
   {
-    if (es->p != NULL)
+    if (es->service == BENCH_CHARGEN && es->state != ES_CLOSING)
+    {
+      /* retry after running out of segments */
+      tcp_chargen_send(tpcb, es);
+    }
+    else if (es->p != NULL)
     {
       tcp_sent(tpcb, tcp_echoserver_sent);
       /* there is a remaining pbuf (chain) , try to send data */
@@ -300,7 +655,7 @@ static err_t tcp_echoserver_poll(void *arg, struct tcp_pcb *tpcb)
     else
     {
       /* no remaining pbuf (chain)  */
-      if(es->state == ES_CLOSING)
+      if(es->state == ES_CLOSING && es->unacked == NULL)
       {
         /*  close tcp connection */
         tcp_echoserver_connection_close(tpcb, es);
@@ -328,10 +683,36 @@ static err_t tcp_echoserver_sent(void *arg, struct tcp_pcb *tpcb, u16_t len)
 {
   struct tcp_echoserver_struct *es;
 
-  LWIP_UNUSED_ARG(len);
-
   es = (struct tcp_echoserver_struct *)arg;
   es->retries = 0;
+  es->tx_bytes += len;
+
+  if (es->service == BENCH_CHARGEN)
+  {
+    if (es->state != ES_CLOSING)
+    {
+      tcp_chargen_send(tpcb, es);
+    }
+    return ERR_OK;
+  }
+
+#if ECHO_ZERO_COPY
+  /* release the pbufs that are fully acknowledged and open the window by as much */
+  es->acked += len;
+
+  while (es->unacked != NULL && es->acked >= es->unacked->len)
+  {
+    struct pbuf *ptr = es->unacked;
+
+    es->acked -= ptr->len;
+    es->unacked = tcp_echoserver_pbuf_pop(ptr);
+
+    tcp_recved(tpcb, ptr->len);
+    pbuf_free(ptr);
+  }
+#else
+  LWIP_UNUSED_ARG(len);
+#endif
   
   if(es->p != NULL)
   {
@@ -339,8 +720,18 @@ static err_t tcp_echoserver_sent(void *arg, struct tcp_pcb *tpcb, u16_t len)
     tcp_sent(tpcb, tcp_echoserver_sent);
     tcp_echoserver_send(tpcb, es);
   }
-  else
+  else if (es->unacked == NULL)
   {
+    if (es->timing == TIMING_WRITTEN)
+    {
+      /* everything received so far is echoed and acknowledged */
+      u32_t now = time_us_32();
+
+      es->timing = TIMING_NONE;
+      tcp_echoserver_latency_add(&es->latency, now - es->rx_time);
+      tcp_echoserver_latency_add(&es->network, now - es->write_time);
+    }
+
     /* if no more data to send and client closed connection*/
     if(es->state == ES_CLOSING)
       tcp_echoserver_connection_close(tpcb, es);
@@ -358,56 +749,543 @@ static err_t tcp_echoserver_sent(void *arg, struct tcp_pcb *tpcb, u16_t len)
   */
 static void tcp_echoserver_send(struct tcp_pcb *tpcb, struct tcp_echoserver_struct *es)
 {
-  struct pbuf *ptr;
   err_t wr_err = ERR_OK;
- 
+
+  /* fill tcp_sndbuf() across pbuf boundaries, splitting a pbuf when it doesn't fit */
   while ((wr_err == ERR_OK) &&
-         (es->p != NULL) && 
-         (es->p->len <= tcp_sndbuf(tpcb)))
+         (es->p != NULL) &&
+         (tcp_sndbuf(tpcb) > 0))
   {
-    
-    /* get pointer on pbuf from es structure */
-    ptr = es->p;
+    struct pbuf *ptr = es->p;
+    u16_t len = ptr->len - es->offset;
+    u8_t flags = ECHO_ZERO_COPY ? 0 : TCP_WRITE_FLAG_COPY;
+
+    if (len > tcp_sndbuf(tpcb))
+    {
+      len = tcp_sndbuf(tpcb);
+    }
+
+    if ((ptr->next != NULL) || (es->offset + len < ptr->len))
+    {
+      /* more to come, don't set PSH yet */
+      flags |= TCP_WRITE_FLAG_MORE;
+    }
+
+    if (len > 0)
+    {
+      /* enqueue data for transmission */
+      wr_err = tcp_write(tpcb, (u8_t *)ptr->payload + es->offset, len, flags);
+    }
 
-    /* enqueue data for transmission */
-    wr_err = tcp_write(tpcb, ptr->payload, ptr->len, 1);
-    
     if (wr_err == ERR_OK)
     {
-      u16_t plen;
-      u8_t freed;
+      es->offset += len;
 
-      plen = ptr->len;
-      //printf("send data %u bytes\n", plen);      
-      /* continue with next pbuf in chain (if any) */
-      es->p = ptr->next;
-      
-      if(es->p != NULL)
+      if (es->offset == ptr->len)
       {
-        /* increment reference count for es->p */
-        pbuf_ref(es->p);
+        /* continue with next pbuf in chain (if any) */
+        es->p = tcp_echoserver_pbuf_pop(ptr);
+        es->offset = 0;
+
+#if ECHO_ZERO_COPY
+        /* lwIP references the payload, keep it until tcp_echoserver_sent() */
+        if (es->unacked == NULL)
+        {
+          es->unacked = ptr;
+        }
+        else
+        {
+          pbuf_cat(es->unacked, ptr);
+        }
+#else
+        /* we can read more data now */
+        tcp_recved(tpcb, ptr->len);
+        pbuf_free(ptr);
+#endif
       }
-      
-     /* chop first pbuf from chain */
-      do
+    }
+    /* ERR_MEM: we are low on memory, try later / harder, defer to poll and sent */
+  }
+
+  if ((es->timing == TIMING_RECEIVED) && (es->p == NULL))
+  {
+    /* the timed data is all queued, the rest of its latency is the network's */
+    es->timing = TIMING_WRITTEN;
+    es->write_time = time_us_32();
+    tcp_echoserver_latency_add(&es->process, es->write_time - es->rx_time);
+  }
+
+  tcp_echoserver_policy_flush(tpcb, es);
+}
+
+/**
+  * @brief  Fills tcp_sndbuf() from the chargen pattern
+  * @param  tpcb: pointer on the tcp_pcb connection
+  * @param  es: pointer on echo_state structure
+  * @retval None
+  */
+static void tcp_chargen_send(struct tcp_pcb *tpcb, struct tcp_echoserver_struct *es)
+{
+  err_t wr_err = ERR_OK;
+
+  /* the pattern never changes, so it's written by reference without a copy */
+  while ((wr_err == ERR_OK) && (tcp_sndbuf(tpcb) > 0))
+  {
+    u16_t len = sizeof(chargen_pattern) - es->chargen_offset;
+
+    if (len > tcp_sndbuf(tpcb))
+    {
+      len = tcp_sndbuf(tpcb);
+    }
+
+    wr_err = tcp_write(tpcb, chargen_pattern + es->chargen_offset, len, TCP_WRITE_FLAG_MORE);
+
+    if (wr_err == ERR_OK)
+    {
+      es->chargen_offset += len;
+
+      if (es->chargen_offset == sizeof(chargen_pattern))
       {
-        /* try hard to free pbuf */
-        freed = pbuf_free(ptr);
+        es->chargen_offset = 0;
       }
-      while(freed == 0);
-     /* we can read more data now */
-     tcp_recved(tpcb, plen);
-   }
-   else if(wr_err == ERR_MEM)
-   {
-      /* we are low on memory, try later / harder, defer to poll */
-     es->p = ptr;
-   }
-   else
-   {
-     /* other problem ?? */
-   }
-  }  
+    }
+  }
+
+  tcp_echoserver_policy_flush(tpcb, es);
+}
+
+/**
+  * @brief  Sets up a connection's pcb for its latency policy
+  * @param  tpcb: pointer on the tcp_pcb connection
+  * @param  es: pointer on echo_state structure
+  * @retval None
+  */
+static void tcp_echoserver_policy_apply(struct tcp_pcb *tpcb, struct tcp_echoserver_struct *es)
+{
+  if (es->policy == POLICY_LOW_LATENCY)
+  {
+    /* a small echo goes out while an earlier one is unacknowledged, rather than
+       waiting on the peer's delayed ACK */
+    tcp_nagle_disable(tpcb);
+  }
+  else
+  {
+    tcp_nagle_enable(tpcb);
+  }
+}
+
+/**
+  * @brief  Ends a batch of tcp_write() calls, or a receive, under the latency policy
+  * @param  tpcb: pointer on the tcp_pcb connection
+  * @param  es: pointer on echo_state structure
+  * @retval None
+  */
+static void tcp_echoserver_policy_flush(struct tcp_pcb *tpcb, struct tcp_echoserver_struct *es)
+{
+  if (es->policy == POLICY_LOW_LATENCY)
+  {
+    /* quick ACK: a delayed ACK goes with this output, on the echo or alone, not up to
+       TCP_TMR_INTERVAL later. From lwIP's input processing the output waits for the end
+       of the segment, outside of it it's immediate */
+    if (tpcb->flags & TF_ACK_DELAY)
+    {
+      tcp_ack_now(tpcb);
+    }
+    tcp_output(tpcb);
+  }
+}
+
+/**
+  * @brief  Adds a sample to an echo latency histogram
+  * @param  latency: the histogram
+  * @param  us: the sample
+  * @retval None
+  */
+static void tcp_echoserver_latency_add(struct tcp_echoserver_latency *latency, u32_t us)
+{
+  uint bucket = (us < 2) ? 0 : (31 - __builtin_clz(us));
+
+  if (bucket >= LATENCY_BUCKETS)
+  {
+    bucket = LATENCY_BUCKETS - 1;
+  }
+
+  latency->buckets[bucket]++;
+  latency->sum += us;
+  latency->count++;
+
+  if (us < latency->min)
+  {
+    latency->min = us;
+  }
+
+  if (us > latency->max)
+  {
+    latency->max = us;
+  }
+}
+
+/**
+  * @brief  Ends a report line with the echo latency, if there are samples
+  * @param  es: pointer on echo_state structure
+  * @retval None
+  */
+static void bench_report_latency(struct tcp_echoserver_struct *es)
+{
+  if (es->latency.count)
+  {
+    printf(", echo latency min/avg/max %lu/%lu/%lu us (process %lu, network %lu avg)", (unsigned long)es->latency.min,
+      (unsigned long)(es->latency.sum / es->latency.count), (unsigned long)es->latency.max,
+      (unsigned long)(es->process.sum / es->process.count), (unsigned long)(es->network.sum / es->network.count));
+  }
+
+  printf("\n");
+}
+
+/**
+  * @brief  Appends one latency histogram to a stats reply
+  * @param  buf: the reply
+  * @param  size: space left in it
+  * @param  name: label of the histogram
+  * @param  latency: the histogram
+  * @retval length appended, truncated to fit
+  */
+static size_t stats_format_latency(char *buf, size_t size, const char *name, const struct tcp_echoserver_latency *latency)
+{
+  size_t len = snprintf(buf, size, "%s min/avg/max %lu/%lu/%lu us [", name,
+    (unsigned long)(latency->count ? latency->min : 0),
+    (unsigned long)(latency->count ? latency->sum / latency->count : 0),
+    (unsigned long)latency->max);
+
+  for (int i = 0; i < LATENCY_BUCKETS && len < size; i++)
+  {
+    len += snprintf(buf + len, size - len, (i == 0) ? "%lu" : " %lu", (unsigned long)latency->buckets[i]);
+  }
+
+  if (len < size)
+  {
+    len += snprintf(buf + len, size - len, "]\n");
+  }
+
+  return LWIP_MIN(len, size - 1);
+}
+
+/**
+  * @brief  Answers a datagram on the stats port with one datagram per connection: its
+  *         counters, the echo latency histograms and lwIP's RTT estimate and window
+  * @param  arg: not used
+  * @param  pcb: the stats pcb
+  * @param  p: the request, its contents are ignored
+  * @param  addr: address of the client
+  * @param  port: port of the client
+  * @retval None
+  */
+static void stats_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  struct tcp_echoserver_struct *es;
+  static char buf[1024];
+
+  LWIP_UNUSED_ARG(arg);
+
+  pbuf_free(p);
+
+  for (es = tcp_echoserver_connections; es != NULL; es = es->next)
+  {
+    struct tcp_pcb *tpcb = es->pcb;
+    size_t len;
+
+    /* sa is 8 times the smoothed RTT and sv 4 times its mean deviation, both in ticks of
+       TCP_SLOW_INTERVAL like rto, they stay 0 and 6 s until the first measurement */
+    len = snprintf(buf, sizeof(buf), "%s %s:%u %lu ms rx %lu tx %lu\n"
+      "srtt %lu ms rttvar %lu ms rto %lu ms nrtx %u cwnd %lu ssthresh %lu snd_wnd %lu snd_buf %u\n",
+      bench_service_names[es->service], ipaddr_ntoa(&tpcb->remote_ip), tpcb->remote_port,
+      (unsigned long)(sys_now() - es->start_ms), (unsigned long)es->rx_bytes, (unsigned long)es->tx_bytes,
+      (unsigned long)((tpcb->sa >> 3) * TCP_SLOW_INTERVAL), (unsigned long)((tpcb->sv >> 2) * TCP_SLOW_INTERVAL),
+      (unsigned long)(tpcb->rto * TCP_SLOW_INTERVAL), tpcb->nrtx, (unsigned long)tpcb->cwnd,
+      (unsigned long)tpcb->ssthresh, (unsigned long)tpcb->snd_wnd, tcp_sndbuf(tpcb));
+
+    len = LWIP_MIN(len, sizeof(buf) - 1);
+
+#if LWIP_TCP_MEM_SHARE
+    /* pbufs the echo server holds of what it received, and queued to send */
+    len += snprintf(buf + len, sizeof(buf) - len, "mem rx %u pbufs tx %u pbufs%s\n", tcp_mem_rx_pbufs(tpcb),
+      tcp_sndqueuelen(tpcb), tpcb->mem_rx_closed ? " closed" : "");
+    len = LWIP_MIN(len, sizeof(buf) - 1);
+#endif
+
+    if (es->service == BENCH_ECHO)
+    {
+      len += stats_format_latency(buf + len, sizeof(buf) - len, "latency", &es->latency);
+      len += stats_format_latency(buf + len, sizeof(buf) - len, "process", &es->process);
+      len += stats_format_latency(buf + len, sizeof(buf) - len, "network", &es->network);
+    }
+
+    struct pbuf *reply = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+
+    if (reply != NULL)
+    {
+      memcpy(reply->payload, buf, len);
+      udp_sendto(pcb, reply, addr, port);
+      pbuf_free(reply);
+    }
+  }
+}
+
+/**
+  * @brief  Prints the counters of one connection
+  * @param  es: pointer on echo_state structure
+  * @param  event: what triggered the report
+  * @retval None
+  */
+static void bench_report_connection(struct tcp_echoserver_struct *es, const char *event)
+{
+  u32_t elapsed_ms = sys_now() - es->start_ms;
+
+  printf("%s %s:%u %s: %lu ms, rx %lu bytes, tx %lu bytes, %s",
+    bench_service_names[es->service], ipaddr_ntoa(&es->pcb->remote_ip), es->pcb->remote_port, event,
+    (unsigned long)elapsed_ms, (unsigned long)es->rx_bytes, (unsigned long)es->tx_bytes,
+    tcp_echoserver_policy_names[es->policy]);
+
+  bench_report_latency(es);
+}
+
+/**
+  * @brief  Periodic report of the RX and TX rate of every connection
+  * @param  arg: not used
+  * @retval None
+  */
+static void bench_report(void *arg)
+{
+  struct tcp_echoserver_struct *es;
+
+  LWIP_UNUSED_ARG(arg);
+
+  for (es = tcp_echoserver_connections; es != NULL; es = es->next)
+  {
+    // bytes per BENCH_REPORT_MS to kbit/s
+    u32_t rx_kbits = (es->rx_bytes - es->report_rx_bytes) * 8 / BENCH_REPORT_MS;
+    u32_t tx_kbits = (es->tx_bytes - es->report_tx_bytes) * 8 / BENCH_REPORT_MS;
+
+    es->report_rx_bytes = es->rx_bytes;
+    es->report_tx_bytes = es->tx_bytes;
+
+    printf("%s %s:%u: rx %lu kbit/s, tx %lu kbit/s", bench_service_names[es->service],
+      ipaddr_ntoa(&es->pcb->remote_ip), es->pcb->remote_port, (unsigned long)rx_kbits, (unsigned long)tx_kbits);
+    bench_report_latency(es);
+  }
+
+  sys_timeout(BENCH_REPORT_MS, bench_report, NULL);
+}
+
+#if PICO_RMII_ETHERNET_PROFILE && PROFILE_REPORT_MS
+/**
+  * @brief  Prints where the driver spent the time of the frames of the last period
+  * @param  arg: not used
+  * @retval None
+  */
+static void profile_report(void *arg)
+{
+  LWIP_UNUSED_ARG(arg);
+
+  printf("driver stages over %u ms:\n", PROFILE_REPORT_MS);
+  netif_rmii_ethernet_profile_dump();
+  netif_rmii_ethernet_profile_reset();
+
+  sys_timeout(PROFILE_REPORT_MS, profile_report, NULL);
+}
+#endif
+
+#if LWIP_HTTPD_WEBSOCKET && WS_PUSH_MS
+/* upgraded connections of WS_PUSH_URI, nothing is built while there are none */
+static u16_t ws_push_clients;
+
+static void ws_push_put32(u8_t *p, u32_t value)
+{
+  p[0] = (u8_t)value;
+  p[1] = (u8_t)(value >> 8);
+  p[2] = (u8_t)(value >> 16);
+  p[3] = (u8_t)(value >> 24);
+}
+
+/**
+  * @brief  Pushes the counters to every WebSocket client, one binary frame of little
+  *         endian fields: ms since boot, heap used, pbuf pool used and the number of
+  *         connections (u32 each), then service, rx and tx bytes (u32 each) per connection
+  * @param  arg: not used
+  * @retval None
+  */
+static void ws_push(void *arg)
+{
+  u8_t msg[16 + 12 * WS_PUSH_CONNECTIONS];
+  struct tcp_echoserver_struct *es;
+  u32_t count = 0;
+
+  LWIP_UNUSED_ARG(arg);
+
+  if (ws_push_clients > 0)
+  {
+    for (es = tcp_echoserver_connections; (es != NULL) && (count < WS_PUSH_CONNECTIONS); es = es->next)
+    {
+      u8_t *p = msg + 16 + 12 * count;
+
+      ws_push_put32(p, es->service);
+      ws_push_put32(p + 4, es->rx_bytes);
+      ws_push_put32(p + 8, es->tx_bytes);
+      count++;
+    }
+
+    ws_push_put32(msg, sys_now());
+    ws_push_put32(msg + 4, lwip_stats.mem.used);
+    ws_push_put32(msg + 8, lwip_stats.memp[MEMP_PBUF_POOL]->used);
+    ws_push_put32(msg + 12, count);
+
+    /* a client without room for it skips this one, the next has the totals anyway */
+    httpd_websocket_broadcast(WS_OP_BINARY, msg, (u16_t)(16 + 12 * count));
+  }
+
+  sys_timeout(WS_PUSH_MS, ws_push, NULL);
+}
+
+static err_t ws_push_open(void *connection, const char *uri)
+{
+  LWIP_UNUSED_ARG(connection);
+
+  if (strcmp(uri, WS_PUSH_URI) != 0)
+  {
+    return ERR_VAL;
+  }
+
+  ws_push_clients++;
+
+  return ERR_OK;
+}
+
+static void ws_push_close(void *connection)
+{
+  LWIP_UNUSED_ARG(connection);
+
+  ws_push_clients--;
+}
+
+/**
+  * @brief  Serves WS_PUSH_URI on the httpd port, the clients only listen
+  * @retval None
+  */
+static void ws_push_init(void)
+{
+  http_set_websocket_handlers(ws_push_open, NULL, ws_push_close);
+  sys_timeout(WS_PUSH_MS, ws_push, NULL);
+}
+#endif
+
+#if LWIP_HTTPD_CUSTOM_FILES
+/* the driver's counters on /metrics, after lwIP's */
+static const metrics_line_t metrics_driver_lines[] = {
+  METRICS_FAMILY("rmii_frames_received_total", "counter", "Frames handed to lwIP"),
+  METRICS_SAMPLE("rmii_frames_received_total"),
+  METRICS_FAMILY("rmii_frames_sent_total", "counter", "Frames queued for DMA"),
+  METRICS_SAMPLE("rmii_frames_sent_total"),
+  METRICS_FAMILY("rmii_frames_dropped_total", "counter", "Frames dropped by the driver"),
+  METRICS_SAMPLE("rmii_frames_dropped_total{reason=\"crc\"}"),
+  METRICS_SAMPLE("rmii_frames_dropped_total{reason=\"rx_nobuf\"}"),
+  METRICS_SAMPLE("rmii_frames_dropped_total{reason=\"rx_overrun\"}"),
+  METRICS_SAMPLE("rmii_frames_dropped_total{reason=\"tx_nobuf\"}"),
+  METRICS_FAMILY("rmii_tx_busy_wait_microseconds_total", "counter", "Time spent waiting for a free TX ring slot"),
+  METRICS_SAMPLE("rmii_tx_busy_wait_microseconds_total"),
+  METRICS_FAMILY("rmii_link_flaps_total", "counter", "Link up to down transitions"),
+  METRICS_SAMPLE("rmii_link_flaps_total"),
+  METRICS_FAMILY("echo_connections", "gauge", "Open echo, discard and chargen connections"),
+  METRICS_SAMPLE("echo_connections"),
+};
+
+static void metrics_driver_collect(uint64_t *values)
+{
+  struct netif_rmii_ethernet_stats stats;
+  struct tcp_echoserver_struct *es;
+  u32_t count = 0;
+
+  netif_rmii_ethernet_get_stats(&stats);
+
+  for (es = tcp_echoserver_connections; es != NULL; es = es->next)
+  {
+    count++;
+  }
+
+  values[0] = stats.rx_ok;
+  values[1] = stats.tx_ok;
+  values[2] = stats.rx_crc_err;
+  values[3] = stats.rx_nobuf;
+  values[4] = stats.rx_overrun;
+  values[5] = stats.tx_nobuf;
+  values[6] = stats.tx_busy_wait_us;
+  values[7] = stats.link_flaps;
+  values[8] = count;
+}
+
+static const metrics_section_t metrics_driver = {
+  metrics_driver_lines,
+  sizeof(metrics_driver_lines) / sizeof(metrics_driver_lines[0]),
+  metrics_driver_collect
+};
+
+/**
+  * @brief  Adds the driver's counters to httpd's /metrics
+  * @retval None
+  */
+static void metrics_init(void)
+{
+  if (lwip_metrics_add(&metrics_driver) != ERR_OK)
+  {
+    printf("lwip_metrics_add failed\n");
+  }
+}
+#endif
+
+/**
+  * @brief  Removes the first pbuf from a chain
+  * @param  p: pbuf chain, the first pbuf keeps the caller's reference
+  * @retval the rest of the chain, with its own reference, or NULL
+  */
+static struct pbuf *tcp_echoserver_pbuf_pop(struct pbuf *p)
+{
+  struct pbuf *rest = p->next;
+
+  if (rest != NULL)
+  {
+    pbuf_ref(rest);
+    pbuf_dechain(p);
+  }
+
+  return rest;
+}
+
+/**
+  * @brief  Frees the echo_state structure and the pbufs it still holds
+  * @param  es: pointer on echo_state structure
+  * @retval None
+  */
+static void tcp_echoserver_free(struct tcp_echoserver_struct *es)
+{
+  if (es->p != NULL)
+  {
+    pbuf_free(es->p);
+  }
+
+  if (es->unacked != NULL)
+  {
+    pbuf_free(es->unacked);
+  }
+
+  for (struct tcp_echoserver_struct **link = &tcp_echoserver_connections; *link != NULL; link = &(*link)->next)
+  {
+    if (*link == es)
+    {
+      *link = es->next;
+      break;
+    }
+  }
+
+  LWIP_MEMPOOL_FREE(TCP_ECHOSERVER, es);
 }
 
 /**
@@ -429,7 +1307,8 @@ static void tcp_echoserver_connection_close(struct tcp_pcb *tpcb, struct tcp_ech
   /* delete es structure */
   if (es != NULL)
   {
-    mem_free(es);
+    bench_report_connection(es, "closed");
+    tcp_echoserver_free(es);
   }  
   
   /* close tcp connection */
@@ -437,25 +1316,55 @@ static void tcp_echoserver_connection_close(struct tcp_pcb *tpcb, struct tcp_ech
 }
 
 
+#if LWIP_MDNS_RESPONDER
+static void mdns_http_txt(struct mdns_service *service, void *txt_userdata) {
+    LWIP_UNUSED_ARG(txt_userdata);
+
+    mdns_resp_add_service_txtitem(service, "path=/", 6);
+}
+#endif
+
 int main() {
 
     
     struct netif_rmii_ethernet_config netif_config = {
         pio0, // PIO:            0
-        0,    // pio SM:         0 and 1
+        0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
         6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
         10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
         14,   // mdio pin start: 14, 15   => ?MDIO, MDC
         NULL, // MAC address (optional - NULL generates one based on flash id) 
+        10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+        NETIF_RMII_ETHERNET_DUPLEX_FULL,
+        20,   // ref clk pin:    20, read by the RX/TX programs with PICO_RMII_ETHERNET_REF_CLK_SYNC
     };
 
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    // run the system clock from the PLL, with the core voltage, flash divider and clk_peri
+    // of the profile
+    clock_profile_apply(clock_profile_get(CLOCK_PROFILE_KHZ));
+#else
     // change the system clock to use the RMII reference clock from pin 20    
     clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
-    sleep_ms(100);
+#endif
 
-    // initialize stdio after the clock change
+    // initialize stdio after the clock change, a terminal is only waited for with
+    // BOOT_STDIO_USB_WAIT_MS and a USB host attached
     stdio_init_all();
-    sleep_ms(5000);
+    boot_stdio_wait();
+
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    // before the driver takes the DMA sniffer, a board that fails at this profile stops
+    // here and needs a lower one
+    struct clock_profile_result clock_result;
+    uint32_t clock_errors = clock_profile_selftest(&clock_result, NULL, NULL);
+
+    clock_profile_report(&clock_result, "lan8720", "pico_rmii_ethernet_loopback");
+
+    while (clock_errors) {
+        tight_loop_contents();
+    }
+#endif
 
     // initialize LWIP in NO SYS mode
     lwip_init();
@@ -463,10 +1372,12 @@ int main() {
     // initialize the PIO base RMII Ethernet network interface
     netif_rmii_ethernet_init(&g_netif, &netif_config);
     
+#if !DHCP_LEASE
     // set ip configuration
     IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
     IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
     IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+#endif
 
     // assign callbacks for link and status
     netif_set_link_callback(&g_netif, netif_link_callback);
@@ -476,17 +1387,48 @@ int main() {
     netif_set_default(&g_netif);
     netif_set_up(&g_netif);
 
-    printf("start tcp echoserver\n");
+#if DHCP_LEASE
+    // the link is still down, the saved lease is asked for once it is up
+    lwip_dhcp_lease_start(&g_netif);
+#endif
+
+    printf("start tcp echo (%d), discard (%d), chargen (%d) and http (%d) servers\n", SERVER_PORT, DISCARD_PORT, CHARGEN_PORT, HTTPD_SERVER_PORT);
 
     // initialize tcp echoserver 
     tcp_echoserver_init();
 
+    // status page on port 80, sent from flash by reference
+    httpd_init();
+#if LWIP_HTTPD_WEBSOCKET && WS_PUSH_MS
+    // and its live counters, pushed over WebSocket
+    ws_push_init();
+#endif
+#if LWIP_HTTPD_CUSTOM_FILES
+    // and lwIP's and the driver's counters for Prometheus on /metrics
+    metrics_init();
+#endif
+
+#if LWIP_MDNS_RESPONDER
+    // zero-config discovery: http://pico-rmii.local/ and the echo server in a service browser
+    mdns_resp_init();
+    mdns_resp_add_netif(&g_netif, MDNS_HOST_NAME, MDNS_RECORD_TTL);
+    mdns_resp_add_service(&g_netif, MDNS_HOST_NAME, "_http", DNSSD_PROTO_TCP, HTTPD_SERVER_PORT, MDNS_RECORD_TTL, mdns_http_txt, NULL);
+    mdns_resp_add_service(&g_netif, MDNS_HOST_NAME, "_echo", DNSSD_PROTO_TCP, SERVER_PORT, MDNS_RECORD_TTL, NULL, NULL);
+#endif
+
     // setup core 1 to monitor the RMII ethernet interface
     // this let's core 0 do other things :)
     multicore_launch_core1(netif_rmii_ethernet_loop);
 
     while (1) {        
-        
+#if PICO_RMII_ETHERNET_DUAL_CORE
+        // core 1 only runs the driver, lwIP and the echo server stay on this core
+        netif_rmii_ethernet_poll();
+#endif
+#if PICO_RMII_ETHERNET_TRACE
+        // the driver's records of both cores, formatted here off its path
+        trace_drain(TRACE_DRAIN_MAX);
+#endif
     }
 
     return 0;
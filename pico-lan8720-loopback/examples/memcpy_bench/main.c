@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/opt.h"
+
+#include "lwip_memcpy.h"
+
+// times memcpy() against the two paths of lwip_rp2040_memcpy(), the CPU's word loop and
+// the DMA with the CPU's share, from lwIP's header sizes to a full segment with the
+// destination at each offset from a word aligned source, as a payload after headers
+// lands. Then, per offset, the smallest size from which the DMA wins over both CPU
+// copies: PICO_LWIP_MEMCPY_DMA_MIN in lwipopts.h should be about the word aligned one
+
+#define ITERATIONS 1000
+
+static const uint sizes[] = { 16, 32, 64, 128, 192, 256, 384, 536, 1024, 1460 };
+
+static uint8_t buffer[1460 + 4] __attribute__((aligned(4)));
+static uint8_t copy_buffer[1460 + 4] __attribute__((aligned(4)));
+
+static void libc_memcpy(void *dst, const void *src, unsigned int len) {
+    memcpy(dst, src, len);
+}
+
+static void dma_memcpy(void *dst, const void *src, unsigned int len) {
+    lwip_rp2040_memcpy_dma(dst, src, len);
+}
+
+typedef void (*memcpy_fn)(void *dst, const void *src, unsigned int len);
+
+static uint32_t time_memcpy(memcpy_fn fn, void *dst, const void *src, uint len) {
+    uint32_t start = time_us_32();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        fn(dst, src, len);
+    }
+
+    return time_us_32() - start;
+}
+
+static bool check(memcpy_fn fn, uint8_t *dst, const uint8_t *src, uint len) {
+    memset(copy_buffer, 0xa5, sizeof(copy_buffer));
+    fn(dst, src, len);
+
+    // the copy, and nothing around it
+    return memcmp(dst, src, len) == 0 &&
+        (dst == copy_buffer || dst[-1] == 0xa5) &&
+        (dst + len == copy_buffer + sizeof(copy_buffer) || dst[len] == 0xa5);
+}
+
+int main() {
+    stdio_init_all();
+
+    sleep_ms(5000);
+
+    for (uint i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = rand();
+    }
+
+    if (!lwip_rp2040_memcpy_dma(copy_buffer, buffer, 4)) {
+        printf("no free DMA channel\n");
+    }
+
+    // cycles per copy = us * (clk_sys / 1 MHz) / ITERATIONS
+    uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+    uint crossover[4] = { 0, 0, 0, 0 };
+
+    printf("clk_sys %lu MHz, %d iterations, cycles per copy\n", mhz, ITERATIONS);
+    printf("  len dst   memcpy      cpu      dma\n");
+
+    for (uint s = 0; s < count_of(sizes); s++) {
+        for (int offset = 0; offset < 4; offset++) {
+            uint8_t *dst = copy_buffer + offset;
+            uint len = sizes[s];
+
+            if (!check(libc_memcpy, dst, buffer, len) || !check(lwip_rp2040_memcpy_cpu, dst, buffer, len) ||
+                !check(dma_memcpy, dst, buffer, len)) {
+                printf("MISMATCH len %u offset %d\n", len, offset);
+            }
+
+            uint32_t libc = time_memcpy(libc_memcpy, dst, buffer, len);
+            uint32_t cpu = time_memcpy(lwip_rp2040_memcpy_cpu, dst, buffer, len);
+            uint32_t dma = time_memcpy(dma_memcpy, dst, buffer, len);
+
+            printf("%5u %3d %8lu %8lu %8lu\n", len, offset, libc * mhz / ITERATIONS,
+                cpu * mhz / ITERATIONS, dma * mhz / ITERATIONS);
+
+            // from where it wins and keeps winning
+            if (dma < libc && dma < cpu) {
+                if (crossover[offset] == 0) {
+                    crossover[offset] = len;
+                }
+            } else {
+                crossover[offset] = 0;
+            }
+        }
+    }
+
+    for (int offset = 0; offset < 4; offset++) {
+        if (crossover[offset]) {
+            printf("dst offset %d: DMA from %u bytes\n", offset, crossover[offset]);
+        } else {
+            printf("dst offset %d: DMA never wins\n", offset);
+        }
+    }
+
+    while (1) {
+        tight_loop_contents();
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/timeouts.h"
+#include "lwip/apps/httpd.h"
+
+#include "rmii_ethernet/netif.h"
+
+#include "lwip_ota_rp2040.h"
+#include "lwip_post_flash.h"
+
+// firmware updates over TFTP on 192.168.1.15: `python3 tools/ota_push.py 192.168.1.15
+// build/examples/ota/pico_rmii_ethernet_ota.bin` stages the image in the upper half of
+// flash and the board applies it at the next reset, see src/lwip/lwip_ota_rp2040.h. The
+// plain .bin POSTed to http://192.168.1.15/upload goes the same way, see
+// src/lwip/lwip_post_flash.h
+#ifndef OTA_REPORT_MS
+#define OTA_REPORT_MS 1000
+#endif
+
+#ifndef OTA_VERSION
+#define OTA_VERSION 1
+#endif
+
+// LWIP network interface
+struct netif g_netif;
+
+static struct lwip_ota ota;
+static uint8_t ota_state = LWIP_OTA_IDLE;
+
+static const char *const ota_states[] = { "idle", "receiving", "committed, reset to apply", "failed" };
+
+static struct lwip_post_flash post;
+static uint8_t post_state = LWIP_POST_FLASH_IDLE;
+
+static const char *const post_states[] = { "idle", "receiving", "in flash", "failed" };
+
+// the body of a POST is the firmware itself, committed with the header ota_push.py would
+// have put in front of it
+static void post_commit(void) {
+    struct lwip_ota_header header = { LWIP_OTA_MAGIC, post.length, post.crc, 0 };
+
+    if (post.length == 0 || lwip_ota_rp2040_flash.commit(&header) != 0) {
+        printf("post: %lu bytes not committed\n", (unsigned long)post.length);
+        return;
+    }
+    printf("post: committed, reset to apply\n");
+}
+
+static void ota_report(void *arg) {
+    if (ota.state != ota_state || ota.state == LWIP_OTA_RECEIVING) {
+        ota_state = ota.state;
+
+        printf("ota: %s, %lu of %lu bytes programmed, %lu erases, %lu programs, %lu ACKs held\n",
+            ota_states[ota.state], (unsigned long)ota.programmed, (unsigned long)ota.header.length,
+            (unsigned long)ota.erases, (unsigned long)ota.programs, (unsigned long)ota.holds);
+    }
+
+    if (post.state != post_state || post.state == LWIP_POST_FLASH_RECEIVING) {
+        post_state = post.state;
+
+        printf("post: %s, %lu of %lu bytes programmed, %lu erases, %lu programs, %lu bytes queued at most\n",
+            post_states[post.state], (unsigned long)post.programmed, (unsigned long)post.length,
+            (unsigned long)post.erases, (unsigned long)post.programs, (unsigned long)post.queued_max);
+
+        if (post.state == LWIP_POST_FLASH_DONE) {
+            post_commit();
+        }
+    }
+
+    sys_timeout(OTA_REPORT_MS, ota_report, NULL);
+}
+
+void netif_link_callback(struct netif *netif)
+{
+    uint speed;
+    enum netif_rmii_ethernet_duplex duplex;
+
+    netif_rmii_ethernet_netif_get_link(netif, &speed, &duplex);
+
+    if (netif_is_link_up(netif)) {
+        printf("netif link status changed up, %u Mbit/s %s duplex\n", speed, (duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL) ? "full" : "half");
+    } else {
+        printf("netif link status changed down\n");
+    }
+}
+
+int main() {
+    struct netif_rmii_ethernet_config netif_config = {
+        pio0, // PIO:            0
+        0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+        6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+        10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+        14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+        NULL, // MAC address (optional - NULL generates one based on flash id)
+        10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+        NETIF_RMII_ETHERNET_DUPLEX_FULL,
+    };
+
+    // an image committed before the reset goes over this one, which then doesn't return
+    lwip_ota_rp2040_boot();
+
+    // change the system clock to use the RMII reference clock from pin 20
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+    sleep_ms(100);
+
+    // initialize stdio after the clock change
+    stdio_init_all();
+    sleep_ms(5000);
+
+    printf("firmware version %d\n", OTA_VERSION);
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // initialize the PIO base RMII Ethernet network interface
+    netif_rmii_ethernet_init(&g_netif, &netif_config);
+
+    // set ip configuration
+    IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+
+    netif_set_link_callback(&g_netif, netif_link_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    // the TFTP server on port 69 writes what it is sent to the staging area
+    lwip_ota_init(&ota, &lwip_ota_rp2040_flash);
+
+    // httpd on port 80 writes the body of a POST to /upload to the same staging area
+    lwip_post_flash_init(&post, &lwip_ota_rp2040_flash, "/upload", "/index.html", "/404.html");
+    httpd_init();
+
+    sys_timeout(OTA_REPORT_MS, ota_report, NULL);
+
+    // setup core 1 to monitor the RMII ethernet interface
+    multicore_launch_core1(netif_rmii_ethernet_loop);
+
+    // core 0 erases and programs flash for lwip_ota.c
+    lwip_ota_rp2040_worker();
+
+    return 0;
+}
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/timeouts.h"
+
+#include "rmii_ethernet/netif.h"
+
+#include "clock_profile.h"
+
+// Self-benchmark of the board without a link partner or a cable: the PHY is put in
+// loopback, frames of each size in PHY_LOOPBACK_SIZES are sent back to back for
+// PHY_LOOPBACK_PHASE_MS and every one that comes back is checked. What it measures is
+// the driver and the PIO programs, TX to RX through the LAN8720, with nothing of the
+// wire or of a host in it
+#ifndef PHY_LOOPBACK_ETHERTYPE
+#define PHY_LOOPBACK_ETHERTYPE 0x88b5 // IEEE 802 local experimental EtherType 1
+#endif
+
+// Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+#ifndef PHY_LOOPBACK_SPEED
+#define PHY_LOOPBACK_SPEED 10
+#endif
+
+#ifndef PHY_LOOPBACK_PHASE_MS
+#define PHY_LOOPBACK_PHASE_MS 5000
+#endif
+
+// frames on their way out, each is sent again as soon as it is done
+#ifndef PHY_LOOPBACK_BUFFERS
+#define PHY_LOOPBACK_BUFFERS 4
+#endif
+
+// clk_sys profile of clock_profile.h with PICO_RMII_ETHERNET_REF_CLK_SYNC, otherwise clk_sys
+// is the 50 MHz REF_CLK. The phases then are the traffic half of the profile's self-test
+#ifndef CLOCK_PROFILE_KHZ
+#define CLOCK_PROFILE_KHZ CLOCK_PROFILE_RATED_KHZ
+#endif
+
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC && !CLOCK_PROFILE_VALID(CLOCK_PROFILE_KHZ)
+#error "CLOCK_PROFILE_KHZ isn't one of the profiles of clock_profile.h"
+#endif
+
+// frame sizes without the FCS
+static const uint16_t phy_loopback_sizes[] = { 64, 128, 256, 512, 1024, 1514 };
+
+#define PHY_LOOPBACK_HEADER (2 * ETH_HWADDR_LEN + 2)
+#define PHY_LOOPBACK_SEQ_OFFSET PHY_LOOPBACK_HEADER
+#define PHY_LOOPBACK_DATA_OFFSET (PHY_LOOPBACK_HEADER + 4)
+
+// LWIP network interface
+struct netif g_netif;
+
+static uint8_t phy_loopback_buffers[PHY_LOOPBACK_BUFFERS][1514];
+
+static uint phy_loopback_phase;
+static uint16_t phy_loopback_size;
+static bool phy_loopback_running;
+static absolute_time_t phy_loopback_start;
+
+static uint32_t phy_loopback_seq;
+static uint32_t phy_loopback_expected;
+static uint32_t phy_loopback_sent;
+static uint32_t phy_loopback_received;
+static uint32_t phy_loopback_lost;
+static uint32_t phy_loopback_bad;
+static uint32_t phy_loopback_errors; // of all the phases
+
+static struct netif_rmii_ethernet_stats phy_loopback_stats;
+
+static void phy_loopback_send(uint8_t *frame);
+
+static void phy_loopback_done(const uint8_t *frame, void *arg) {
+    if (phy_loopback_running) {
+        phy_loopback_send((uint8_t *)frame);
+    }
+}
+
+// the next sequence number into a frame laid out by phy_loopback_start_phase(), and out
+static void phy_loopback_send(uint8_t *frame) {
+    uint32_t seq = phy_loopback_seq;
+
+    memcpy(frame + PHY_LOOPBACK_SEQ_OFFSET, &seq, sizeof(seq));
+
+    if (netif_rmii_ethernet_netif_raw_send(&g_netif, frame, phy_loopback_size, phy_loopback_done, NULL) == ERR_OK) {
+        phy_loopback_seq++;
+        phy_loopback_sent++;
+    }
+}
+
+// from netif_rmii_ethernet_poll(), the frame is still in the RX ring
+static void phy_loopback_input(struct netif *netif, const uint8_t *frame, uint length, void *arg) {
+    uint32_t seq;
+
+    if (length != phy_loopback_size) {
+        phy_loopback_bad++;
+
+        return;
+    }
+
+    for (uint i = PHY_LOOPBACK_DATA_OFFSET; i < length; i++) {
+        if (frame[i] != (uint8_t)i) {
+            phy_loopback_bad++;
+
+            return;
+        }
+    }
+
+    memcpy(&seq, frame + PHY_LOOPBACK_SEQ_OFFSET, sizeof(seq));
+
+    // in order, the ones skipped were lost, an older one is a leftover of the last phase
+    if ((int32_t)(seq - phy_loopback_expected) < 0) {
+        return;
+    }
+
+    phy_loopback_lost += seq - phy_loopback_expected;
+    phy_loopback_expected = seq + 1;
+    phy_loopback_received++;
+}
+
+static void phy_loopback_start_phase(void) {
+    phy_loopback_size = phy_loopback_sizes[phy_loopback_phase];
+    phy_loopback_expected = phy_loopback_seq;
+    phy_loopback_sent = 0;
+    phy_loopback_received = 0;
+    phy_loopback_lost = 0;
+    phy_loopback_bad = 0;
+
+    for (uint i = 0; i < PHY_LOOPBACK_BUFFERS; i++) {
+        uint8_t *frame = phy_loopback_buffers[i];
+
+        // to this netif from this netif, the PHY hands it straight back
+        memcpy(frame, g_netif.hwaddr, ETH_HWADDR_LEN);
+        memcpy(frame + ETH_HWADDR_LEN, g_netif.hwaddr, ETH_HWADDR_LEN);
+        frame[2 * ETH_HWADDR_LEN] = PHY_LOOPBACK_ETHERTYPE >> 8;
+        frame[2 * ETH_HWADDR_LEN + 1] = PHY_LOOPBACK_ETHERTYPE & 0xff;
+
+        for (uint j = PHY_LOOPBACK_DATA_OFFSET; j < sizeof(phy_loopback_buffers[i]); j++) {
+            frame[j] = (uint8_t)j;
+        }
+    }
+
+    netif_rmii_ethernet_get_stats(&phy_loopback_stats);
+
+    phy_loopback_running = true;
+    phy_loopback_start = get_absolute_time();
+
+    for (uint i = 0; i < PHY_LOOPBACK_BUFFERS; i++) {
+        phy_loopback_send(phy_loopback_buffers[i]);
+    }
+}
+
+static void phy_loopback_report(uint64_t elapsed_us) {
+    struct netif_rmii_ethernet_stats stats;
+    char scenario[32];
+
+    netif_rmii_ethernet_get_stats(&stats);
+
+    // the frames still on their way back when the phase ended aren't lost
+    uint32_t errors = phy_loopback_lost + phy_loopback_bad;
+
+    phy_loopback_errors += errors;
+    uint32_t frames_per_s = (uint32_t)((uint64_t)phy_loopback_received * 1000000 / elapsed_us);
+    uint32_t kbps = (uint32_t)((uint64_t)phy_loopback_received * phy_loopback_size * 8000 / elapsed_us);
+
+    printf("phy loopback %4u B: %lu sent, %lu received, %lu lost, %lu bad, %lu frames/s, %lu.%03lu Mbit/s, "
+        "rx overrun +%lu, crc +%lu\n", phy_loopback_size,
+        (unsigned long)phy_loopback_sent, (unsigned long)phy_loopback_received,
+        (unsigned long)phy_loopback_lost, (unsigned long)phy_loopback_bad,
+        (unsigned long)frames_per_s, (unsigned long)(kbps / 1000), (unsigned long)(kbps % 1000),
+        (unsigned long)(stats.rx_overrun - phy_loopback_stats.rx_overrun),
+        (unsigned long)(stats.rx_crc_err - phy_loopback_stats.rx_crc_err));
+
+    // the same record as bench/bench.c, for tools/bench_compare.py
+    snprintf(scenario, sizeof(scenario), "phy_loopback_%u", phy_loopback_size);
+
+    printf("bench lan8720 %s result: {\"schema\":\"pico-bench/1\",\"source\":\"board\",\"board\":\"lan8720\","
+        "\"build\":\"phy_loopback\",\"clk_sys_hz\":%lu,\"clk_peri_hz\":%lu,\"options\":\"%u Mbit/s\",\"scenario\":\"%s\","
+        "\"duration_ms\":%lu,\"rx_kbps\":%lu,\"tx_kbps\":%lu,\"ops_per_s\":%lu,\"errors\":%lu,"
+        "\"latency_us\":null,\"cpu_pct\":null}\n",
+        scenario, (unsigned long)clock_get_hz(clk_sys), (unsigned long)clock_get_hz(clk_peri), PHY_LOOPBACK_SPEED,
+        scenario, (unsigned long)(elapsed_us / 1000), (unsigned long)kbps,
+        (unsigned long)((uint64_t)phy_loopback_sent * phy_loopback_size * 8000 / elapsed_us),
+        (unsigned long)frames_per_s, (unsigned long)errors);
+}
+
+static void phy_loopback_next(void *arg) {
+    uint64_t elapsed_us = absolute_time_diff_us(phy_loopback_start, get_absolute_time());
+
+    // the frames on their way out aren't sent again
+    phy_loopback_running = false;
+
+    phy_loopback_report(elapsed_us ? elapsed_us : 1);
+
+    if (++phy_loopback_phase == sizeof(phy_loopback_sizes) / sizeof(phy_loopback_sizes[0])) {
+        netif_rmii_ethernet_netif_phy_loopback(&g_netif, false, 0);
+
+        printf("phy loopback: done at %lu MHz, %s, %lu frames lost or bad\n",
+            (unsigned long)(clock_get_hz(clk_sys) / MHZ), phy_loopback_errors ? "FAILED" : "passed",
+            (unsigned long)phy_loopback_errors);
+
+        return;
+    }
+
+    phy_loopback_start_phase();
+
+    sys_timeout(PHY_LOOPBACK_PHASE_MS, phy_loopback_next, NULL);
+}
+
+static void phy_loopback_begin(void *arg) {
+    err_t err = netif_rmii_ethernet_netif_phy_loopback(&g_netif, true, PHY_LOOPBACK_SPEED);
+
+    if (err != ERR_OK) {
+        printf("phy loopback: %u Mbit/s not available in this build (%d)\n", PHY_LOOPBACK_SPEED, err);
+
+        return;
+    }
+
+    printf("phy loopback at %u Mbit/s, %u ms per size\n", PHY_LOOPBACK_SPEED, PHY_LOOPBACK_PHASE_MS);
+
+    phy_loopback_phase = 0;
+    phy_loopback_start_phase();
+
+    sys_timeout(PHY_LOOPBACK_PHASE_MS, phy_loopback_next, NULL);
+}
+
+int main() {
+    struct netif_rmii_ethernet_config netif_config = {
+        pio0, // PIO:            0
+        0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+        6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+        10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+        14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+        NULL, // MAC address (optional - NULL generates one based on flash id)
+        PHY_LOOPBACK_SPEED,
+        NETIF_RMII_ETHERNET_DUPLEX_FULL,
+        20,   // ref clk pin:    20, read by the RX/TX programs with PICO_RMII_ETHERNET_REF_CLK_SYNC
+    };
+
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    // run the system clock from the PLL, with the core voltage, flash divider and clk_peri
+    // of the profile
+    clock_profile_apply(clock_profile_get(CLOCK_PROFILE_KHZ));
+#else
+    // change the system clock to use the RMII reference clock from pin 20
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+#endif
+    sleep_ms(100);
+
+    // initialize stdio after the clock change
+    stdio_init_all();
+    sleep_ms(5000);
+
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    // RAM, checksums and flash before the driver takes the DMA sniffer, the traffic follows
+    struct clock_profile_result clock_result;
+    uint32_t clock_errors = clock_profile_selftest(&clock_result, NULL, NULL);
+
+    clock_profile_report(&clock_result, "lan8720", "phy_loopback");
+
+    while (clock_errors) {
+        tight_loop_contents();
+    }
+#endif
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // initialize the PIO base RMII Ethernet network interface
+    netif_rmii_ethernet_init(&g_netif, &netif_config);
+
+    // up without an address, the test frames don't go through lwIP
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    if (netif_rmii_ethernet_raw_rx_register(PHY_LOOPBACK_ETHERTYPE, phy_loopback_input, NULL) != ERR_OK) {
+        printf("phy loopback: EtherType 0x%04x not taken\n", PHY_LOOPBACK_ETHERTYPE);
+    }
+
+    // once the driver's own PHY setup is through
+    sys_timeout(1000, phy_loopback_begin, NULL);
+
+    // setup core 1 to monitor the RMII ethernet interface
+    multicore_launch_core1(netif_rmii_ethernet_loop);
+
+    while (1) {
+#if PICO_RMII_ETHERNET_DUAL_CORE
+        // core 1 only runs the driver, lwIP and the test stay on this core
+        netif_rmii_ethernet_poll();
+#endif
+    }
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/uart.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/timeouts.h"
+#include "lwip/apps/lwiperf.h"
+
+#include "lwip_pppos_rp2040.h"
+
+// PPP over UART0 with the DMA port of src/lwip/lwip_pppos_rp2040.c, and the iperf 2
+// server on port 5001 over it. The other end is a modem, or a host with a USB serial
+// adapter running pppd:
+//
+//   pppd /dev/ttyUSB0 921600 local noauth nodetach 10.0.0.1:10.0.0.2
+//   iperf -c 10.0.0.2
+//
+// Every PPPOS_REPORT_MS it prints the bytes moved over the UART and the time the core
+// spent in them
+#ifndef PPPOS_BAUDRATE
+#define PPPOS_BAUDRATE 921600
+#endif
+
+#define PPPOS_UART uart0
+#define PPPOS_TX_PIN 0
+#define PPPOS_RX_PIN 1
+#define PPPOS_CTS_PIN 2
+#define PPPOS_RTS_PIN 3
+
+// RTS/CTS on PPPOS_CTS_PIN and PPPOS_RTS_PIN, modems want it at these rates
+#ifndef PPPOS_FLOW_CONTROL
+#define PPPOS_FLOW_CONTROL 0
+#endif
+
+// PAP or CHAP login, as a carrier's APN asks
+#ifndef PPPOS_USER
+#define PPPOS_USER NULL // e.g. "user"
+#endif
+#ifndef PPPOS_PASSWORD
+#define PPPOS_PASSWORD NULL
+#endif
+
+#ifndef PPPOS_REPORT_MS
+#define PPPOS_REPORT_MS 1000
+#endif
+
+// LWIP network interface
+struct netif g_netif;
+
+static ppp_pcb *pppos_pcb;
+
+// time spent in the polls that passed bytes on, pppos_input() and what lwIP ran from it
+static uint64_t pppos_busy_us;
+
+static struct lwip_pppos_rp2040_stats pppos_last;
+static uint64_t pppos_last_busy_us;
+static absolute_time_t pppos_last_time;
+
+static void pppos_status(ppp_pcb *pcb, int err_code, void *ctx) {
+    struct netif *netif = ppp_netif(pcb);
+
+    if (err_code == PPPERR_NONE) {
+        printf("ppp up, %s", ip4addr_ntoa(netif_ip4_addr(netif)));
+        printf(" peer %s\n", ip4addr_ntoa(netif_ip4_gw(netif)));
+
+        return;
+    }
+
+    printf("ppp down (%d)\n", err_code);
+
+    // PPPERR_USER is ppp_close(), anything else dials again after a second
+    if (err_code != PPPERR_USER) {
+        ppp_connect(pcb, 1);
+    }
+}
+
+static void pppos_report(void *arg) {
+    struct lwip_pppos_rp2040_stats stats;
+    absolute_time_t now = get_absolute_time();
+    uint64_t elapsed_us = absolute_time_diff_us(pppos_last_time, now);
+
+    lwip_pppos_rp2040_get_stats(&stats);
+
+    if (elapsed_us == 0) {
+        elapsed_us = 1;
+    }
+
+    uint32_t rx_bytes = stats.rx_bytes - pppos_last.rx_bytes;
+    uint32_t tx_bytes = stats.tx_bytes - pppos_last.tx_bytes;
+    uint32_t batches = stats.rx_batches - pppos_last.rx_batches;
+    uint32_t rx_kbps = (uint32_t)((uint64_t)rx_bytes * 8000 / elapsed_us);
+    uint32_t tx_kbps = (uint32_t)((uint64_t)tx_bytes * 8000 / elapsed_us);
+    uint32_t cpu_pct = (uint32_t)((pppos_busy_us - pppos_last_busy_us) * 100 / elapsed_us);
+
+    printf("pppos rx %lu kbit/s in %lu batches (%lu B each, %lu on idle), tx %lu kbit/s in %lu transfers, "
+        "overrun +%lu (%lu B), tx dropped +%lu B, cpu %lu%%\n",
+        (unsigned long)rx_kbps, (unsigned long)batches, (unsigned long)(batches ? rx_bytes / batches : 0),
+        (unsigned long)(stats.rx_idle - pppos_last.rx_idle), (unsigned long)tx_kbps,
+        (unsigned long)(stats.tx_transfers - pppos_last.tx_transfers),
+        (unsigned long)(stats.rx_overrun - pppos_last.rx_overrun), (unsigned long)(stats.rx_lost - pppos_last.rx_lost),
+        (unsigned long)(stats.tx_dropped - pppos_last.tx_dropped), (unsigned long)cpu_pct);
+
+    // the same record as bench/bench.c, for tools/bench_compare.py, while bytes move
+    if (rx_bytes + tx_bytes != 0) {
+        printf("bench pppos uart result: {\"schema\":\"pico-bench/1\",\"source\":\"board\",\"board\":\"pppos\","
+            "\"build\":\"pppos\",\"clk_sys_hz\":%lu,\"clk_peri_hz\":%lu,\"options\":\"%u baud\",\"scenario\":\"pppos_iperf\","
+            "\"duration_ms\":%lu,\"rx_kbps\":%lu,\"tx_kbps\":%lu,\"ops_per_s\":%lu,\"errors\":%lu,"
+            "\"latency_us\":null,\"cpu_pct\":%lu}\n",
+            (unsigned long)clock_get_hz(clk_sys), (unsigned long)clock_get_hz(clk_peri), PPPOS_BAUDRATE,
+            (unsigned long)(elapsed_us / 1000), (unsigned long)rx_kbps, (unsigned long)tx_kbps,
+            (unsigned long)((uint64_t)batches * 1000000 / elapsed_us),
+            (unsigned long)(stats.rx_overrun - pppos_last.rx_overrun), (unsigned long)cpu_pct);
+    }
+
+    pppos_last = stats;
+    pppos_last_busy_us = pppos_busy_us;
+    pppos_last_time = now;
+
+    sys_timeout(PPPOS_REPORT_MS, pppos_report, NULL);
+}
+
+static void iperf_report(void *arg, enum lwiperf_report_type report_type,
+    const ip_addr_t *local_addr, u16_t local_port, const ip_addr_t *remote_addr, u16_t remote_port,
+    u32_t bytes_transferred, u32_t ms_duration, u32_t bandwidth_kbitpsec)
+{
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(report_type);
+    LWIP_UNUSED_ARG(local_addr);
+    LWIP_UNUSED_ARG(local_port);
+
+    printf("iperf %s:%u: %lu bytes in %lu ms, %lu kbit/s\n", ipaddr_ntoa(remote_addr), remote_port,
+        (unsigned long)bytes_transferred, (unsigned long)ms_duration, (unsigned long)bandwidth_kbitpsec);
+}
+
+int main() {
+    stdio_init_all();
+    sleep_ms(5000);
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    gpio_set_function(PPPOS_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(PPPOS_RX_PIN, GPIO_FUNC_UART);
+#if PPPOS_FLOW_CONTROL
+    gpio_set_function(PPPOS_CTS_PIN, GPIO_FUNC_UART);
+    gpio_set_function(PPPOS_RTS_PIN, GPIO_FUNC_UART);
+#endif
+
+    pppos_pcb = lwip_pppos_rp2040_create(&g_netif, PPPOS_UART, PPPOS_BAUDRATE, pppos_status, NULL);
+    if (pppos_pcb == NULL) {
+        printf("pppos: no DMA channels or PPP pcb\n");
+
+        while (1) {
+            tight_loop_contents();
+        }
+    }
+
+#if PPPOS_FLOW_CONTROL
+    uart_set_hw_flow(PPPOS_UART, true, true);
+#endif
+
+    if (PPPOS_USER != NULL) {
+        ppp_set_auth(pppos_pcb, PPPAUTHTYPE_ANY, PPPOS_USER, PPPOS_PASSWORD);
+    }
+
+    ppp_set_default(pppos_pcb);
+    ppp_connect(pppos_pcb, 0);
+
+    printf("pppos at %u baud, iperf server on port %d\n", PPPOS_BAUDRATE, LWIPERF_TCP_PORT_DEFAULT);
+
+    lwiperf_start_tcp_server_default(iperf_report, NULL);
+
+    pppos_last_time = get_absolute_time();
+    sys_timeout(PPPOS_REPORT_MS, pppos_report, NULL);
+
+    while (1) {
+        uint64_t start = time_us_64();
+
+        if (lwip_pppos_rp2040_poll() != 0) {
+            pppos_busy_us += time_us_64() - start;
+        }
+
+        sys_check_timeouts();
+    }
+
+    return 0;
+}
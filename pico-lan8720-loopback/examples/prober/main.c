@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/timeouts.h"
+
+#include "rmii_ethernet/netif.h"
+
+#include "boot.h"
+#include "lwip_prober.h"
+
+// the network's latency as this board sees it: ICMP echo to the gateway and UDP probes
+// to the other boards running this, their round trips timed from the driver's hardware
+// timestamps and reported every PROBER_REPORT_MS. Each board also answers the UDP probes
+// of the others on LWIP_PROBER_PORT
+
+#ifndef PROBER_REPORT_MS
+#define PROBER_REPORT_MS 10000
+#endif
+
+static const struct {
+    const char *addr;
+    enum lwip_prober_type type;
+    uint32_t interval_ms;
+    uint16_t size;
+} probes[] = {
+    { "192.168.1.1", LWIP_PROBER_ICMP, 1000, 56 },  // the gateway
+    { "192.168.1.16", LWIP_PROBER_UDP, 100, 64 },   // another board
+    { "192.168.1.16", LWIP_PROBER_UDP, 1000, 1400 },
+};
+
+// LWIP network interface
+struct netif g_netif;
+
+void netif_link_callback(struct netif *netif)
+{
+    uint speed;
+    enum netif_rmii_ethernet_duplex duplex;
+
+    netif_rmii_ethernet_netif_get_link(netif, &speed, &duplex);
+
+    if (netif_is_link_up(netif)) {
+        printf("netif link status changed up, %u Mbit/s %s duplex\n", speed, (duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL) ? "full" : "half");
+    } else {
+        printf("netif link status changed down\n");
+    }
+}
+
+static void prober_report(void *arg) {
+    lwip_prober_report();
+
+    sys_timeout(PROBER_REPORT_MS, prober_report, arg);
+}
+
+int main() {
+    struct netif_rmii_ethernet_config netif_config = {
+        pio0, // PIO:            0
+        0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO, 3 counts the timestamps
+        6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+        10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+        14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+        NULL, // MAC address (optional - NULL generates one based on flash id)
+        10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+        NETIF_RMII_ETHERNET_DUPLEX_FULL,
+    };
+    // change the system clock to use the RMII reference clock from pin 20
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+
+    // initialize stdio after the clock change, a terminal is only waited for with
+    // BOOT_STDIO_USB_WAIT_MS and a USB host attached
+    stdio_init_all();
+    boot_stdio_wait();
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // initialize the PIO base RMII Ethernet network interface
+    netif_rmii_ethernet_init(&g_netif, &netif_config);
+
+    // set ip configuration
+    IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+
+    netif_set_link_callback(&g_netif, netif_link_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    // runs from lwIP's timers and callbacks, on the core running lwIP
+    if (lwip_prober_init(&g_netif) != ERR_OK) {
+        printf("lwip_prober_init failed\n");
+    }
+
+    for (uint i = 0; i < sizeof(probes) / sizeof(probes[0]); i++) {
+        ip_addr_t addr;
+
+        if (!ipaddr_aton(probes[i].addr, &addr) ||
+            lwip_prober_add(&addr, probes[i].type, probes[i].interval_ms, probes[i].size) < 0) {
+            printf("no probes to %s\n", probes[i].addr);
+        }
+    }
+
+    sys_timeout(PROBER_REPORT_MS, prober_report, NULL);
+
+    // setup core 1 to monitor the RMII ethernet interface
+    multicore_launch_core1(netif_rmii_ethernet_loop);
+
+    while (1) {
+#if PICO_RMII_ETHERNET_DUAL_CORE
+        // core 1 only runs the driver, lwIP and the prober stay on this core
+        netif_rmii_ethernet_poll();
+#endif
+    }
+
+    return 0;
+}
@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lwip/ip.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "rmii_ethernet/netif.h"
+
+#include "ptp_client.h"
+
+// a slave in the style of PTPd's: the best master of the Announces heard is followed,
+// its two step (Sync, Follow_Up) or one step Syncs give the offset, a Delay_Req after a
+// Sync, at most one per PTP_DELAY_REQ_MS, gives the path delay. The clock is the driver's
+// timestamp counter, which isn't adjusted: the servo keeps the offset and rate that map
+// it to the master's time, stepped once, then steered by a PI loop as adjtimex() is in PTPd
+
+#define PTP_EVENT_PORT 319
+#define PTP_GENERAL_PORT 320
+
+#define PTP_SYNC 0x0
+#define PTP_DELAY_REQ 0x1
+#define PTP_FOLLOW_UP 0x8
+#define PTP_DELAY_RESP 0x9
+#define PTP_ANNOUNCE 0xb
+
+#define PTP_HEADER_SIZE 34
+#define PTP_DELAY_REQ_SIZE 44
+#define PTP_ANNOUNCE_SIZE 64
+#define PTP_FLAG_TWO_STEP 0x02 // of the first flag byte
+
+// the master is given up after 3 Announces of its default, 2 s, interval
+#ifndef PTP_ANNOUNCE_TIMEOUT_MS
+#define PTP_ANNOUNCE_TIMEOUT_MS 6000
+#endif
+
+#ifndef PTP_DELAY_REQ_MS
+#define PTP_DELAY_REQ_MS 1000
+#endif
+
+// offsets beyond this step the clock, as PTPd does beyond 1 s
+#ifndef PTP_STEP_NS
+#define PTP_STEP_NS 1000000
+#endif
+
+// PI servo: the rate follows offset / PTP_SERVO_AP, the drift integrates offset / PTP_SERVO_AI
+#ifndef PTP_SERVO_AP
+#define PTP_SERVO_AP 2
+#endif
+
+#ifndef PTP_SERVO_AI
+#define PTP_SERVO_AI 16
+#endif
+
+// PTPd's ADJ_FREQ_MAX
+#define PTP_RATE_MAX 512000
+
+// 224.0.1.129, all PTP messages but the peer delay ones
+static const ip_addr_t ptp_group = IPADDR4_INIT_BYTES(224, 0, 1, 129);
+
+static struct {
+    struct netif *netif;
+    struct udp_pcb *event_pcb;
+    struct udp_pcb *general_pcb;
+    uint8_t domain;
+    uint8_t port_id[10]; // clock identity, the EUI-64 of the MAC, and port number 1
+    uint32_t hz;
+
+    // the 32-bit counts extended, from the last one seen: counts are a Sync interval or so
+    // apart, half the wrap of the counter is 43 s at the 50 MHz REF_CLK
+    int64_t count;
+    uint32_t count_last;
+    bool count_valid;
+
+    // the master, and the Announce fields it was picked by, lower is better
+    bool master;
+    uint8_t master_id[10];
+    uint8_t master_rank[14];
+    u32_t master_heard;
+
+    // the Sync waiting for its Follow_Up, then the last complete one
+    uint16_t sync_seq;
+    bool sync_pending;
+    int64_t sync_local;  // ns of the counter
+    int64_t sync_correction;
+    int64_t sync_t1;     // the master's send time, corrected
+    int64_t sync_t2;     // local receive time, in sync_local's ns
+    bool sync_valid;
+    int64_t prev_t1;
+    int64_t prev_t2;
+
+    // the Delay_Req on its way
+    uint16_t delay_req_seq;
+    bool delay_req_pending; // waiting for its TX timestamp or its Delay_Resp
+    int64_t delay_req_t3;   // local send time, counter ns
+    bool delay_req_sent;
+    u32_t delay_req_time;   // sys_now() at the send
+    uint delay_req_tries;
+
+    // the servo: master time = local + clock_offset + (local - clock_anchor) * clock_rate / 1e9
+    int64_t clock_offset;
+    int64_t clock_anchor;
+    int32_t clock_rate;
+    int32_t drift;
+    bool stepped;
+    bool locked;
+    bool path_delay_valid;
+    int64_t path_delay;
+    int64_t offset;
+    uint32_t syncs;
+    uint32_t unstamped;
+} ptp;
+
+static uint16_t get_be16(const uint8_t *b) {
+    return (b[0] << 8) | b[1];
+}
+
+static uint32_t get_be32(const uint8_t *b) {
+    return ((uint32_t)b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+static void put_be16(uint8_t *b, uint16_t v) {
+    b[0] = v >> 8;
+    b[1] = v;
+}
+
+// a 10 byte PTP timestamp: 48 bits of s, 32 of ns
+static int64_t get_timestamp(const uint8_t *b) {
+    int64_t s = ((int64_t)get_be16(b) << 32) | get_be32(b + 2);
+
+    return s * 1000000000 + get_be32(b + 6);
+}
+
+// correctionField, ns in 48.16 fixed point
+static int64_t get_correction(const uint8_t *header) {
+    int64_t c = ((int64_t)get_be32(header + 8) << 32) | get_be32(header + 12);
+
+    return c >> 16;
+}
+
+// a count of the driver's, in ns of the counter since the first one seen
+static int64_t ptp_local_ns(uint32_t count) {
+    if (!ptp.count_valid) {
+        ptp.count_last = count;
+        ptp.count_valid = true;
+    }
+
+    ptp.count += (int32_t)(count - ptp.count_last);
+    ptp.count_last = count;
+
+    return (ptp.count / ptp.hz) * 1000000000 + ((ptp.count % ptp.hz) * 1000000000) / ptp.hz;
+}
+
+static int64_t ptp_clock(int64_t local) {
+    return local + ptp.clock_offset + ((local - ptp.clock_anchor) * ptp.clock_rate) / 1000000000;
+}
+
+// as much behind as the clock was ahead, and at rate from local on
+static void ptp_clock_adjust(int64_t local, int64_t step, int32_t rate) {
+    ptp.clock_offset = ptp_clock(local) - local - step;
+    ptp.clock_anchor = local;
+    ptp.clock_rate = rate;
+}
+
+static void ptp_servo_reset() {
+    ptp.stepped = false;
+    ptp.locked = false;
+    ptp.path_delay_valid = false;
+    ptp.path_delay = 0;
+    ptp.drift = 0;
+    ptp.sync_pending = false;
+    ptp.sync_valid = false;
+    ptp.prev_t2 = 0;
+    ptp.syncs = 0;
+}
+
+static void ptp_delay_req_poll(void *arg);
+
+// armed, the Delay_Req is the next frame out
+static void ptp_delay_req_send(void *arg) {
+    LWIP_UNUSED_ARG(arg);
+
+    err_t err = netif_rmii_ethernet_netif_timestamp_tx_arm(ptp.netif);
+
+    if (err == ERR_INPROGRESS && ++ptp.delay_req_tries < 10) {
+        // frames still on their way out
+        sys_timeout(1, ptp_delay_req_send, NULL);
+
+        return;
+    }
+
+    if (err != ERR_OK) {
+        ptp.delay_req_pending = false;
+
+        return;
+    }
+
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, PTP_DELAY_REQ_SIZE, PBUF_RAM);
+
+    if (p == NULL) {
+        ptp.delay_req_pending = false;
+
+        return;
+    }
+
+    uint8_t *b = p->payload;
+
+    memset(b, 0, PTP_DELAY_REQ_SIZE);
+    b[0] = PTP_DELAY_REQ;
+    b[1] = 2;
+    put_be16(b + 2, PTP_DELAY_REQ_SIZE);
+    b[4] = ptp.domain;
+    memcpy(b + 20, ptp.port_id, sizeof(ptp.port_id));
+    put_be16(b + 30, ++ptp.delay_req_seq);
+    b[32] = 1;    // controlField, Delay_Req
+    b[33] = 0x7f; // logMessageInterval
+
+    udp_sendto(ptp.event_pcb, p, &ptp_group, PTP_EVENT_PORT);
+    pbuf_free(p);
+
+    ptp.delay_req_sent = false;
+    ptp.delay_req_time = sys_now();
+
+    sys_timeout(1, ptp_delay_req_poll, NULL);
+}
+
+// its TX timestamp, until the driver has it
+static void ptp_delay_req_poll(void *arg) {
+    uint32_t timestamp;
+
+    LWIP_UNUSED_ARG(arg);
+
+    err_t err = netif_rmii_ethernet_netif_timestamp_tx_get(ptp.netif, &timestamp);
+
+    if (err == ERR_INPROGRESS) {
+        sys_timeout(1, ptp_delay_req_poll, NULL);
+    } else if (err == ERR_OK) {
+        ptp.delay_req_t3 = ptp_local_ns(timestamp);
+        ptp.delay_req_sent = true;
+    } else {
+        ptp.unstamped++;
+        ptp.delay_req_pending = false;
+    }
+}
+
+static void ptp_sync_done() {
+    int64_t t2 = ptp_clock(ptp.sync_local);
+
+    ptp.sync_t2 = ptp.sync_local;
+    ptp.sync_valid = true;
+    ptp.syncs++;
+
+    // this clock minus the master's, the path delay taken out
+    int64_t offset = t2 - ptp.sync_t1 - ptp.path_delay;
+
+    ptp.offset = offset;
+
+    if (!ptp.stepped || offset > PTP_STEP_NS || offset < -PTP_STEP_NS) {
+        ptp_clock_adjust(ptp.sync_local, offset, ptp.clock_rate);
+        ptp.stepped = true;
+        ptp.locked = false;
+        ptp.prev_t1 = ptp.sync_t1;
+        ptp.prev_t2 = ptp.sync_local;
+
+        printf("ptp step %lld ns\n", (long long)offset);
+    } else if (!ptp.locked) {
+        // the master's frequency, from the two Syncs since the step
+        int64_t local_delta = ptp.sync_local - ptp.prev_t2;
+        int64_t master_delta = ptp.sync_t1 - ptp.prev_t1;
+
+        if (local_delta > 0) {
+            int64_t rate = ((master_delta - local_delta) * 1000000000) / local_delta;
+
+            ptp.drift = rate > PTP_RATE_MAX ? PTP_RATE_MAX : (rate < -PTP_RATE_MAX ? -PTP_RATE_MAX : rate);
+            ptp_clock_adjust(ptp.sync_local, offset, ptp.drift);
+            ptp.locked = true;
+
+            printf("ptp locked, rate %ld ppb\n", (long)ptp.drift);
+        }
+    } else {
+        ptp.drift -= offset / PTP_SERVO_AI;
+        ptp.drift = ptp.drift > PTP_RATE_MAX ? PTP_RATE_MAX : (ptp.drift < -PTP_RATE_MAX ? -PTP_RATE_MAX : ptp.drift);
+
+        int64_t rate = ptp.drift - offset / PTP_SERVO_AP;
+
+        ptp_clock_adjust(ptp.sync_local, 0, rate > PTP_RATE_MAX ? PTP_RATE_MAX : (rate < -PTP_RATE_MAX ? -PTP_RATE_MAX : rate));
+
+        printf("ptp offset %lld ns, path delay %lld ns, rate %ld ppb\n", (long long)offset,
+            (long long)ptp.path_delay, (long)ptp.clock_rate);
+    }
+
+    if (!ptp.delay_req_pending && (ptp.path_delay_valid == false || (sys_now() - ptp.delay_req_time) >= PTP_DELAY_REQ_MS)) {
+        ptp.delay_req_pending = true;
+        ptp.delay_req_tries = 0;
+
+        ptp_delay_req_send(NULL);
+    }
+}
+
+static void ptp_delay_resp(const uint8_t *b) {
+    if (!ptp.delay_req_pending || !ptp.delay_req_sent || !ptp.sync_valid ||
+        memcmp(b + 44, ptp.port_id, sizeof(ptp.port_id)) != 0 || get_be16(b + 30) != ptp.delay_req_seq) {
+        return;
+    }
+
+    ptp.delay_req_pending = false;
+
+    int64_t t4 = get_timestamp(b + 34) - get_correction(b);
+
+    // both ways in the clock as it is now
+    int64_t master_to_slave = ptp_clock(ptp.sync_t2) - ptp.sync_t1;
+    int64_t slave_to_master = t4 - ptp_clock(ptp.delay_req_t3);
+    int64_t delay = (master_to_slave + slave_to_master) / 2;
+
+    if (delay < 0) {
+        // the clock was stepped in between
+        return;
+    }
+
+    if (!ptp.path_delay_valid) {
+        ptp.path_delay = delay;
+        ptp.path_delay_valid = true;
+    } else {
+        // PTPd's one pole filter
+        ptp.path_delay += (delay - ptp.path_delay) / 8;
+    }
+}
+
+static void ptp_announce(const uint8_t *b, u16_t len) {
+    // priority1, grandmasterClockQuality, priority2 and grandmasterIdentity, in the order
+    // the best master clock algorithm compares them
+    const uint8_t *rank = b + 47;
+
+    if (len < PTP_ANNOUNCE_SIZE) {
+        return;
+    }
+
+    bool same = ptp.master && memcmp(b + 20, ptp.master_id, sizeof(ptp.master_id)) == 0;
+
+    if (!same && ptp.master && memcmp(rank, ptp.master_rank, sizeof(ptp.master_rank)) >= 0) {
+        return;
+    }
+
+    if (!same) {
+        memcpy(ptp.master_id, b + 20, sizeof(ptp.master_id));
+        ptp.master = true;
+        ptp_servo_reset();
+
+        printf("ptp master %02x%02x%02x.%02x%02x.%02x%02x%02x-%u\n", b[20], b[21], b[22], b[23], b[24], b[25], b[26], b[27],
+            get_be16(b + 28));
+    }
+
+    memcpy(ptp.master_rank, rank, sizeof(ptp.master_rank));
+    ptp.master_heard = sys_now();
+}
+
+// the header checks of both ports, and whether it is the master's
+static bool ptp_header_check(const uint8_t *b, u16_t len, bool *from_master) {
+    if (len < PTP_HEADER_SIZE || (b[1] & 0x0f) != 2 || b[4] != ptp.domain || get_be16(b + 2) > len) {
+        return false;
+    }
+
+    *from_master = ptp.master && memcmp(b + 20, ptp.master_id, sizeof(ptp.master_id)) == 0;
+
+    return true;
+}
+
+static void ptp_event_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    uint8_t b[PTP_DELAY_REQ_SIZE];
+    uint32_t timestamp;
+    bool from_master;
+
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(addr);
+    LWIP_UNUSED_ARG(port);
+
+    // only valid while the frame is being input
+    bool stamped = netif_rmii_ethernet_netif_timestamp_rx(ip_current_input_netif(), &timestamp);
+    u16_t len = pbuf_copy_partial(p, b, sizeof(b), 0);
+
+    pbuf_free(p);
+
+    if (!ptp_header_check(b, len, &from_master) || (b[0] & 0x0f) != PTP_SYNC || !from_master || len < PTP_DELAY_REQ_SIZE) {
+        // the Delay_Reqs of other slaves, and other masters
+        return;
+    }
+
+    if (!stamped) {
+        ptp.unstamped++;
+        ptp.sync_pending = false;
+
+        return;
+    }
+
+    ptp.sync_seq = get_be16(b + 30);
+    ptp.sync_local = ptp_local_ns(timestamp);
+    ptp.sync_correction = get_correction(b);
+
+    if (b[6] & PTP_FLAG_TWO_STEP) {
+        ptp.sync_pending = true;
+    } else {
+        ptp.sync_pending = false;
+        ptp.sync_t1 = get_timestamp(b + 34) + ptp.sync_correction;
+
+        ptp_sync_done();
+    }
+}
+
+static void ptp_general_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    uint8_t b[PTP_ANNOUNCE_SIZE];
+    bool from_master;
+
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(addr);
+    LWIP_UNUSED_ARG(port);
+
+    u16_t len = pbuf_copy_partial(p, b, sizeof(b), 0);
+
+    pbuf_free(p);
+
+    if (!ptp_header_check(b, len, &from_master)) {
+        return;
+    }
+
+    switch (b[0] & 0x0f) {
+        case PTP_ANNOUNCE:
+            ptp_announce(b, len);
+            break;
+
+        case PTP_FOLLOW_UP:
+            if (from_master && ptp.sync_pending && len >= PTP_DELAY_REQ_SIZE && get_be16(b + 30) == ptp.sync_seq) {
+                ptp.sync_pending = false;
+                ptp.sync_t1 = get_timestamp(b + 34) + ptp.sync_correction + get_correction(b);
+
+                ptp_sync_done();
+            }
+            break;
+
+        case PTP_DELAY_RESP:
+            if (from_master && len >= PTP_DELAY_REQ_SIZE + 10) {
+                ptp_delay_resp(b);
+            }
+            break;
+    }
+}
+
+static void ptp_master_check(void *arg) {
+    LWIP_UNUSED_ARG(arg);
+
+    if (ptp.master && (sys_now() - ptp.master_heard) >= PTP_ANNOUNCE_TIMEOUT_MS) {
+        printf("ptp master lost\n");
+
+        ptp.master = false;
+        ptp_servo_reset();
+    }
+
+    sys_timeout(1000, ptp_master_check, NULL);
+}
+
+err_t ptp_client_init(struct netif *netif, uint8_t domain) {
+    memset(&ptp, 0, sizeof(ptp));
+
+    ptp.netif = netif;
+    ptp.domain = domain;
+    ptp.hz = netif_rmii_ethernet_timestamp_hz();
+
+    // EUI-64 of the MAC
+    memcpy(ptp.port_id, netif->hwaddr, 3);
+    ptp.port_id[3] = 0xff;
+    ptp.port_id[4] = 0xfe;
+    memcpy(ptp.port_id + 5, netif->hwaddr + 3, 3);
+    put_be16(ptp.port_id + 8, 1);
+
+    ptp.event_pcb = udp_new();
+    ptp.general_pcb = udp_new();
+
+    if (ptp.event_pcb == NULL || ptp.general_pcb == NULL) {
+        return ERR_MEM;
+    }
+
+    udp_bind(ptp.event_pcb, IP_ADDR_ANY, PTP_EVENT_PORT);
+    udp_bind(ptp.general_pcb, IP_ADDR_ANY, PTP_GENERAL_PORT);
+    udp_recv(ptp.event_pcb, ptp_event_recv, NULL);
+    udp_recv(ptp.general_pcb, ptp_general_recv, NULL);
+
+    sys_timeout(1000, ptp_master_check, NULL);
+
+    return ERR_OK;
+}
+
+void ptp_client_get_status(struct ptp_client_status *status) {
+    status->master = ptp.master;
+    memcpy(status->master_id, ptp.master_id, sizeof(status->master_id));
+    status->locked = ptp.locked;
+    status->offset_ns = ptp.offset;
+    status->path_delay_ns = ptp.path_delay;
+    status->rate_ppb = ptp.clock_rate;
+    status->syncs = ptp.syncs;
+    status->unstamped = ptp.unstamped;
+}
+
+int64_t ptp_client_time(uint32_t timestamp) {
+    return ptp_clock(ptp_local_ns(timestamp));
+}
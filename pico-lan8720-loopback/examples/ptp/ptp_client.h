@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PTP_CLIENT_H_
+#define _PTP_CLIENT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lwip/netif.h"
+
+// the state of the servo, from lwIP context
+struct ptp_client_status {
+    bool master;         // a master has been heard and is followed
+    uint8_t master_id[10]; // its clock identity and port number
+    bool locked;         // the servo has the master's frequency and follows its offset
+    int64_t offset_ns;   // of the last Sync, this clock minus the master's
+    int64_t path_delay_ns;
+    int32_t rate_ppb;    // how much faster than the timestamp counter this clock runs
+    uint32_t syncs;      // Syncs with a timestamp on both ends since the master was picked
+    uint32_t unstamped;  // Syncs and Delay_Reqs dropped without a local timestamp
+};
+
+// an IEEE 1588-2008 (PTPv2) ordinary clock, slave only, over UDP/IPv4 multicast with
+// end to end delay requests, on netif (an RMII Ethernet netif built with
+// PICO_RMII_ETHERNET_TIMESTAMP). Call after lwip_init(), from lwIP context
+err_t ptp_client_init(struct netif *netif, uint8_t domain);
+
+void ptp_client_get_status(struct ptp_client_status *status);
+
+// the master's time, in ns since its epoch, at a count of the driver's timestamp counter:
+// the timestamp of a frame netif sent or received
+int64_t ptp_client_time(uint32_t timestamp);
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/timeouts.h"
+
+#include "rmii_ethernet/netif.h"
+
+// Layer 2 echo next to lwIP: frames of RAW_ECHO_ETHERTYPE are taken past lwIP, by the
+// raw RX callback, and sent back to their source from one of RAW_ECHO_BUFFERS buffers
+// by the raw send, while lwIP answers ARP and ping on 192.168.1.15 as usual
+#ifndef RAW_ECHO_ETHERTYPE
+#define RAW_ECHO_ETHERTYPE 0x88b5 // IEEE 802 local experimental EtherType 1
+#endif
+
+// echoes on their way out, a frame that finds none free is dropped
+#ifndef RAW_ECHO_BUFFERS
+#define RAW_ECHO_BUFFERS 4
+#endif
+
+#ifndef RAW_ECHO_REPORT_MS
+#define RAW_ECHO_REPORT_MS 10000
+#endif
+
+// LWIP network interface
+struct netif g_netif;
+
+static uint8_t raw_echo_buffers[RAW_ECHO_BUFFERS][1514];
+static bool raw_echo_busy[RAW_ECHO_BUFFERS];
+
+static uint32_t raw_echo_count;
+static uint32_t raw_echo_dropped;
+
+static void raw_echo_done(const uint8_t *frame, void *arg) {
+    raw_echo_busy[(uintptr_t)arg] = false;
+}
+
+// from netif_rmii_ethernet_poll(), the frame is still in the RX ring
+static void raw_echo_input(struct netif *netif, const uint8_t *frame, uint length, void *arg) {
+    for (uintptr_t i = 0; i < RAW_ECHO_BUFFERS; i++) {
+        if (raw_echo_busy[i]) {
+            continue;
+        }
+
+        uint8_t *echo = raw_echo_buffers[i];
+
+        // back to the source, from this netif, with the rest as it came
+        memcpy(echo, frame + ETH_HWADDR_LEN, ETH_HWADDR_LEN);
+        memcpy(echo + ETH_HWADDR_LEN, netif->hwaddr, ETH_HWADDR_LEN);
+        memcpy(echo + 2 * ETH_HWADDR_LEN, frame + 2 * ETH_HWADDR_LEN, length - 2 * ETH_HWADDR_LEN);
+
+        if (netif_rmii_ethernet_netif_raw_send(netif, echo, length, raw_echo_done, (void *)i) == ERR_OK) {
+            raw_echo_busy[i] = true;
+            raw_echo_count++;
+
+            return;
+        }
+
+        break;
+    }
+
+    raw_echo_dropped++;
+}
+
+static void raw_echo_report(void *arg) {
+    struct netif_rmii_ethernet_stats stats;
+
+    netif_rmii_ethernet_get_stats(&stats);
+
+    printf("raw echo: %lu echoed, %lu dropped, rx %lu raw %lu lwIP, tx %lu ok\n",
+        (unsigned long)raw_echo_count, (unsigned long)raw_echo_dropped,
+        (unsigned long)stats.rx_raw, (unsigned long)stats.rx_ok, (unsigned long)stats.tx_ok);
+
+    sys_timeout(RAW_ECHO_REPORT_MS, raw_echo_report, NULL);
+}
+
+void netif_link_callback(struct netif *netif)
+{
+    uint speed;
+    enum netif_rmii_ethernet_duplex duplex;
+
+    netif_rmii_ethernet_netif_get_link(netif, &speed, &duplex);
+
+    if (netif_is_link_up(netif)) {
+        printf("netif link status changed up, %u Mbit/s %s duplex\n", speed, (duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL) ? "full" : "half");
+    } else {
+        printf("netif link status changed down\n");
+    }
+}
+
+int main() {
+    struct netif_rmii_ethernet_config netif_config = {
+        pio0, // PIO:            0
+        0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+        6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+        10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+        14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+        NULL, // MAC address (optional - NULL generates one based on flash id)
+        10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+        NETIF_RMII_ETHERNET_DUPLEX_FULL,
+    };
+
+    // change the system clock to use the RMII reference clock from pin 20
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+    sleep_ms(100);
+
+    // initialize stdio after the clock change
+    stdio_init_all();
+    sleep_ms(5000);
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // initialize the PIO base RMII Ethernet network interface
+    netif_rmii_ethernet_init(&g_netif, &netif_config);
+
+    // set ip configuration
+    IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+
+    netif_set_link_callback(&g_netif, netif_link_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    if (netif_rmii_ethernet_raw_rx_register(RAW_ECHO_ETHERTYPE, raw_echo_input, NULL) != ERR_OK) {
+        printf("raw echo: EtherType 0x%04x not taken\n", RAW_ECHO_ETHERTYPE);
+    }
+
+    printf("raw echo of EtherType 0x%04x on %02x:%02x:%02x:%02x:%02x:%02x\n", RAW_ECHO_ETHERTYPE,
+        g_netif.hwaddr[0], g_netif.hwaddr[1], g_netif.hwaddr[2], g_netif.hwaddr[3], g_netif.hwaddr[4], g_netif.hwaddr[5]);
+
+    sys_timeout(RAW_ECHO_REPORT_MS, raw_echo_report, NULL);
+
+    // setup core 1 to monitor the RMII ethernet interface
+    multicore_launch_core1(netif_rmii_ethernet_loop);
+
+    while (1) {
+#if PICO_RMII_ETHERNET_DUAL_CORE
+        // core 1 only runs the driver, lwIP and the echo stay on this core
+        netif_rmii_ethernet_poll();
+#endif
+    }
+
+    return 0;
+}
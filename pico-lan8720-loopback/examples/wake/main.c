@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+
+#include "hardware/clocks.h"
+#include "hardware/uart.h"
+#include "hardware/structs/scb.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/timeouts.h"
+
+#include "rmii_ethernet/netif.h"
+
+// low power node: it answers ARP and ping on 192.168.1.15 and goes to sleep once it hasn't
+// sent anything for WAKE_IDLE_MS. A magic packet for its MAC or any frame to it wakes it up,
+// e.g. `wakeonlan <mac>` or a ping after the host's ARP entry for it is in
+#ifndef WAKE_IDLE_MS
+#define WAKE_IDLE_MS 30000
+#endif
+
+#ifndef WAKE_CHECK_MS
+#define WAKE_CHECK_MS 1000
+#endif
+
+// LWIP network interface
+struct netif g_netif;
+
+static uint32_t wake_tx_ok;
+static uint32_t wake_idle_ms;
+
+// from netif_rmii_ethernet_poll(), before lwIP sees the frame that woke us
+static void wake_up(struct netif *netif, void *arg) {
+    struct netif_rmii_ethernet_stats stats;
+
+    netif_rmii_ethernet_netif_get_stats(netif, &stats);
+
+    printf("awake: %lu wake-ups, %lu frames dropped asleep\n",
+        (unsigned long)stats.wakeups, (unsigned long)stats.rx_asleep);
+}
+
+static void wake_idle_check(void *arg) {
+    struct netif_rmii_ethernet_stats stats;
+
+    netif_rmii_ethernet_get_stats(&stats);
+
+    if (stats.tx_ok != wake_tx_ok) {
+        wake_tx_ok = stats.tx_ok;
+        wake_idle_ms = 0;
+    } else {
+        wake_idle_ms += WAKE_CHECK_MS;
+    }
+
+    if (wake_idle_ms >= WAKE_IDLE_MS && netif_is_link_up(&g_netif)) {
+        printf("asleep\n");
+
+        // the UART is gated with the rest while asleep
+        uart_default_tx_wait_blocking();
+
+        if (netif_rmii_ethernet_sleep(NETIF_RMII_ETHERNET_WAKE_MAGIC | NETIF_RMII_ETHERNET_WAKE_UNICAST, wake_up, NULL) == ERR_OK) {
+            wake_idle_ms = 0;
+        }
+    }
+
+    // held while asleep, it runs again right after the wake-up
+    sys_timeout(WAKE_CHECK_MS, wake_idle_check, NULL);
+}
+
+void netif_link_callback(struct netif *netif)
+{
+    uint speed;
+    enum netif_rmii_ethernet_duplex duplex;
+
+    netif_rmii_ethernet_netif_get_link(netif, &speed, &duplex);
+
+    if (netif_is_link_up(netif)) {
+        printf("netif link status changed up, %u Mbit/s %s duplex\n", speed, (duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL) ? "full" : "half");
+    } else {
+        printf("netif link status changed down\n");
+    }
+}
+
+int main() {
+    struct netif_rmii_ethernet_config netif_config = {
+        pio0, // PIO:            0
+        0,    // pio SM:         0, 1 and 2 => RX, TX, MDIO
+        6,    // rx pin start:   6, 7, 8    => RX0, RX1, CRS
+        10,   // tx pin start:   10, 11, 12 => TX0, TX1, TX-EN
+        14,   // mdio pin start: 14, 15   => ?MDIO, MDC
+        NULL, // MAC address (optional - NULL generates one based on flash id)
+        10,   // speed:          10 Mbit/s, 100 needs PICO_RMII_ETHERNET_100M
+        NETIF_RMII_ETHERNET_DUPLEX_FULL,
+    };
+
+    // change the system clock to use the RMII reference clock from pin 20
+    clock_configure_gpin(clk_sys, 20, 50 * MHZ, 50 * MHZ);
+    sleep_ms(100);
+
+    // initialize stdio after the clock change
+    stdio_init_all();
+    sleep_ms(5000);
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // initialize the PIO base RMII Ethernet network interface
+    netif_rmii_ethernet_init(&g_netif, &netif_config);
+
+    // set ip configuration
+    IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+
+    netif_set_link_callback(&g_netif, netif_link_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    printf("wake on %02x:%02x:%02x:%02x:%02x:%02x after %u ms idle\n",
+        g_netif.hwaddr[0], g_netif.hwaddr[1], g_netif.hwaddr[2], g_netif.hwaddr[3], g_netif.hwaddr[4], g_netif.hwaddr[5],
+        WAKE_IDLE_MS);
+
+    sys_timeout(WAKE_CHECK_MS, wake_idle_check, NULL);
+
+    // setup core 1 to monitor the RMII ethernet interface
+    multicore_launch_core1(netif_rmii_ethernet_loop);
+
+    // the clocks are only gated while both cores sleep, this one has nothing else to do
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+
+    while (1) {
+        __wfi();
+    }
+
+    return 0;
+}
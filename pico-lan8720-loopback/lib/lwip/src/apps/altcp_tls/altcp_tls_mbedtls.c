@@ -78,9 +78,15 @@
 #include "mbedtls/platform.h"
 #include "mbedtls/memory_buffer_alloc.h"
 #include "mbedtls/ssl_cache.h"
+#include "mbedtls/ssl_ticket.h"
 
 #include "mbedtls/ssl_internal.h" /* to call mbedtls_flush_output after ERR_MEM */
 
+#if ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD
+#include "lwip/apps/altcp_tls_mbedtls_offload.h"
+#include "lwip/timeouts.h"
+#endif
+
 #include <string.h>
 
 #ifndef ALTCP_MBEDTLS_ENTROPY_PTR
@@ -106,6 +112,15 @@ struct altcp_tls_config {
   /** Inter-connection cache for fast connection startup */
   struct mbedtls_ssl_cache_context cache;
 #endif
+#if defined(MBEDTLS_SSL_TICKET_C) && ALTCP_MBEDTLS_USE_SESSION_TICKETS
+  /** Session ticket keys (server) */
+  mbedtls_ssl_ticket_context ticket_ctx;
+#endif
+#if ALTCP_MBEDTLS_CLIENT_SESSION_REUSE
+  /** Session of the last handshake, offered to the next connection (client) */
+  struct altcp_tls_session session;
+  u8_t have_session;
+#endif
 };
 
 static err_t altcp_mbedtls_lower_recv(void *arg, struct altcp_pcb *inner_conn, struct pbuf *p, err_t err);
@@ -113,6 +128,7 @@ static err_t altcp_mbedtls_setup(void *conf, struct altcp_pcb *conn, struct altc
 static err_t altcp_mbedtls_lower_recv_process(struct altcp_pcb *conn, altcp_mbedtls_state_t *state);
 static err_t altcp_mbedtls_handle_rx_appldata(struct altcp_pcb *conn, altcp_mbedtls_state_t *state);
 static int altcp_mbedtls_bio_send(void *ctx, const unsigned char *dataptr, size_t size);
+static int altcp_mbedtls_bio_recv(void *ctx, unsigned char *buf, size_t len);
 
 
 /* callback functions from inner/lower connection: */
@@ -246,12 +262,358 @@ altcp_mbedtls_lower_recv(void *arg, struct altcp_pcb *inner_conn, struct pbuf *p
   return altcp_mbedtls_lower_recv_process(conn, state);
 }
 
+#if ALTCP_MBEDTLS_CLIENT_SESSION_REUSE
+/* A client config offers the session of its last handshake to its next connection */
+static void
+altcp_mbedtls_keep_session(altcp_mbedtls_state_t *state)
+{
+  struct altcp_tls_config *config = (struct altcp_tls_config *)state->conf;
+  if (config->conf.endpoint != MBEDTLS_SSL_IS_CLIENT) {
+    return;
+  }
+  mbedtls_ssl_session_free(&config->session.data);
+  mbedtls_ssl_session_init(&config->session.data);
+  config->have_session = (mbedtls_ssl_get_session(&state->ssl_context, &config->session.data) == 0);
+}
+#endif
+
+/* Connection setup once the handshake is done or has failed */
+static err_t
+altcp_mbedtls_handshake_result(struct altcp_pcb *conn, altcp_mbedtls_state_t *state, int ret)
+{
+  if (ret != 0) {
+    LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_ssl_handshake failed: %d\n", ret));
+    /* handshake failed, connection has to be closed */
+    if (conn->err) {
+      conn->err(conn->arg, ERR_CLSD);
+    }
+
+    if (altcp_close(conn) != ERR_OK) {
+      altcp_abort(conn);
+    }
+    return ERR_OK;
+  }
+  /* If we come here, handshake succeeded. */
+  LWIP_ASSERT("state", state->bio_bytes_read == 0);
+  LWIP_ASSERT("state", state->bio_bytes_appl == 0);
+  state->flags |= ALTCP_MBEDTLS_FLAGS_HANDSHAKE_DONE;
+#if ALTCP_MBEDTLS_CLIENT_SESSION_REUSE
+  altcp_mbedtls_keep_session(state);
+#endif
+  /* issue "connect" callback" to upper connection (this can only happen for active open) */
+  if (conn->connected) {
+    err_t err;
+    err = conn->connected(conn->arg, conn, ERR_OK);
+    if (err != ERR_OK) {
+      return err;
+    }
+  }
+  if (state->rx == NULL) {
+    return ERR_OK;
+  }
+  /* handle application data */
+  return altcp_mbedtls_handle_rx_appldata(conn, state);
+}
+
+#if ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD
+#if !defined(MBEDTLS_THREADING_C)
+#error "ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD needs MBEDTLS_THREADING_C, mbedTLS's RNG, caches and allocator are used from two cores"
+#endif
+#if ALTCP_MBEDTLS_OFFLOAD_RING_SIZE & (ALTCP_MBEDTLS_OFFLOAD_RING_SIZE - 1)
+#error "ALTCP_MBEDTLS_OFFLOAD_RING_SIZE must be a power of 2"
+#endif
+
+#define ALTCP_MBEDTLS_OFFLOAD_MASK  (ALTCP_MBEDTLS_OFFLOAD_RING_SIZE - 1)
+
+/** The handshake running on the other core. Its ssl_context belongs to the job until
+ * 'done' is set, everything else to lwIP. Each ring has one writer per count: lwIP
+ * moves rx_in and tx_out, the job rx_out and tx_in (free running counts).
+ */
+struct altcp_mbedtls_offload {
+  /** the connection, NULL when it went away before the job was done */
+  struct altcp_pcb *conn;
+  /** its state, not NULL while there is a job */
+  altcp_mbedtls_state_t *state;
+  u8_t rx[ALTCP_MBEDTLS_OFFLOAD_RING_SIZE];
+  u8_t tx[ALTCP_MBEDTLS_OFFLOAD_RING_SIZE];
+  volatile u32_t rx_in;
+  volatile u32_t rx_out;
+  volatile u32_t tx_in;
+  volatile u32_t tx_out;
+  /** rx_out the inner connection has been told about */
+  u32_t rx_recved;
+  volatile u8_t abort;
+  volatile u8_t done;
+  int ret;
+};
+
+static struct altcp_mbedtls_offload altcp_mbedtls_offload;
+
+static void altcp_mbedtls_offload_poll(void *arg);
+
+static void
+altcp_mbedtls_ring_put(u8_t *ring, u32_t in, const u8_t *data, size_t len)
+{
+  size_t part = LWIP_MIN(len, ALTCP_MBEDTLS_OFFLOAD_RING_SIZE - (in & ALTCP_MBEDTLS_OFFLOAD_MASK));
+  MEMCPY(&ring[in & ALTCP_MBEDTLS_OFFLOAD_MASK], data, part);
+  MEMCPY(ring, &data[part], len - part);
+}
+
+static void
+altcp_mbedtls_ring_get(const u8_t *ring, u32_t out, u8_t *data, size_t len)
+{
+  size_t part = LWIP_MIN(len, ALTCP_MBEDTLS_OFFLOAD_RING_SIZE - (out & ALTCP_MBEDTLS_OFFLOAD_MASK));
+  MEMCPY(data, &ring[out & ALTCP_MBEDTLS_OFFLOAD_MASK], part);
+  MEMCPY(&data[part], ring, len - part);
+}
+
+/** Receive callback of the offloaded handshake, on the other core: reads the rx ring */
+static int
+altcp_mbedtls_offload_bio_recv(void *ctx, unsigned char *buf, size_t len)
+{
+  struct altcp_mbedtls_offload *offload = (struct altcp_mbedtls_offload *)ctx;
+  u32_t out = offload->rx_out;
+  size_t avail = offload->rx_in - out;
+
+  if (offload->abort) {
+    return MBEDTLS_ERR_NET_CONN_RESET;
+  }
+  if (avail == 0) {
+    return MBEDTLS_ERR_SSL_WANT_READ;
+  }
+  len = LWIP_MIN(len, avail);
+  altcp_mbedtls_offload_sync();
+  altcp_mbedtls_ring_get(offload->rx, out, buf, len);
+  /* the bytes are copied before lwIP may reuse them */
+  altcp_mbedtls_offload_sync();
+  offload->rx_out = out + (u32_t)len;
+  return (int)len;
+}
+
+/** Send callback of the offloaded handshake, on the other core: fills the tx ring */
+static int
+altcp_mbedtls_offload_bio_send(void *ctx, const unsigned char *dataptr, size_t size)
+{
+  struct altcp_mbedtls_offload *offload = (struct altcp_mbedtls_offload *)ctx;
+  u32_t in = offload->tx_in;
+  size_t room = ALTCP_MBEDTLS_OFFLOAD_RING_SIZE - (in - offload->tx_out);
+
+  if (offload->abort) {
+    return MBEDTLS_ERR_NET_CONN_RESET;
+  }
+  if (room == 0) {
+    return MBEDTLS_ERR_SSL_WANT_WRITE;
+  }
+  size = LWIP_MIN(size, room);
+  altcp_mbedtls_offload_sync();
+  altcp_mbedtls_ring_put(offload->tx, in, dataptr, size);
+  altcp_mbedtls_offload_sync();
+  offload->tx_in = in + (u32_t)size;
+  return (int)size;
+}
+
+/** The job: runs the handshake to its end, waiting while it can't go on */
+static void
+altcp_mbedtls_offload_run(void *arg)
+{
+  struct altcp_mbedtls_offload *offload = (struct altcp_mbedtls_offload *)arg;
+  int ret;
+
+  do {
+    u32_t rx_in = offload->rx_in;
+    u32_t tx_out = offload->tx_out;
+
+    ret = mbedtls_ssl_handshake(&offload->state->ssl_context);
+    if ((ret != MBEDTLS_ERR_SSL_WANT_READ) && (ret != MBEDTLS_ERR_SSL_WANT_WRITE)) {
+      break;
+    }
+    /* until lwIP brings more data or takes what was written */
+    while (!offload->abort && (offload->rx_in == rx_in) && (offload->tx_out == tx_out)) {
+      altcp_mbedtls_offload_wait();
+    }
+    if (offload->abort) {
+      ret = MBEDTLS_ERR_NET_CONN_RESET;
+    }
+  } while (!offload->abort);
+
+  offload->ret = ret;
+  altcp_mbedtls_offload_sync();
+  offload->done = 1;
+}
+
+/** Moves the handshake's bytes between its rings and the inner connection */
+static void
+altcp_mbedtls_offload_pump(struct altcp_pcb *conn, altcp_mbedtls_state_t *state)
+{
+  struct altcp_mbedtls_offload *offload = &altcp_mbedtls_offload;
+  u32_t rx_in = offload->rx_in;
+  u32_t rx_out = offload->rx_out;
+  u32_t tx_in = offload->tx_in;
+  u32_t tx_out = offload->tx_out;
+  u8_t written = 0;
+
+  altcp_mbedtls_offload_sync();
+
+  /* the window opens by what the handshake has read */
+  altcp_mbedtls_lower_recved(conn->inner_conn, (int)(rx_out - offload->rx_recved));
+  offload->rx_recved = rx_out;
+
+  while ((state->rx != NULL) && ((rx_in - rx_out) < ALTCP_MBEDTLS_OFFLOAD_RING_SIZE)) {
+    struct pbuf *p = state->rx;
+    u16_t len = (u16_t)LWIP_MIN(p->len, ALTCP_MBEDTLS_OFFLOAD_RING_SIZE - (rx_in - rx_out));
+    altcp_mbedtls_ring_put(offload->rx, rx_in, (const u8_t *)p->payload, len);
+    rx_in += len;
+    pbuf_remove_header(p, len);
+    if (p->len == 0) {
+      /* the first pbuf has been fully read, free it */
+      state->rx = p->next;
+      p->next = NULL;
+      pbuf_free(p);
+    }
+  }
+
+  while (tx_out != tx_in) {
+    u16_t len = (u16_t)LWIP_MIN(tx_in - tx_out, ALTCP_MBEDTLS_OFFLOAD_RING_SIZE - (tx_out & ALTCP_MBEDTLS_OFFLOAD_MASK));
+    len = LWIP_MIN(len, altcp_sndbuf(conn->inner_conn));
+    if ((len == 0) ||
+        (altcp_write(conn->inner_conn, &offload->tx[tx_out & ALTCP_MBEDTLS_OFFLOAD_MASK], len, TCP_WRITE_FLAG_COPY) != ERR_OK)) {
+      /* the rest goes when there is room in the send buffer */
+      break;
+    }
+    tx_out += len;
+    written = 1;
+  }
+  if (written) {
+    altcp_output(conn->inner_conn);
+  }
+
+  altcp_mbedtls_offload_sync();
+  offload->rx_in = rx_in;
+  offload->tx_out = tx_out;
+  altcp_mbedtls_offload_signal();
+}
+
+/** Hands the context back to lwIP once the job is done */
+static err_t
+altcp_mbedtls_offload_end(struct altcp_pcb *conn, altcp_mbedtls_state_t *state)
+{
+  struct altcp_mbedtls_offload *offload = &altcp_mbedtls_offload;
+  u32_t left = offload->rx_in - offload->rx_out;
+  int ret = offload->ret;
+
+  /* what the peer sent after its last handshake message goes back in front, unread
+     and not acknowledged yet */
+  if ((ret == 0) && (left != 0)) {
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, (u16_t)left, PBUF_RAM);
+    if (p == NULL) {
+      ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    } else {
+      altcp_mbedtls_ring_get(offload->rx, offload->rx_out, (u8_t *)p->payload, left);
+      if (state->rx != NULL) {
+        pbuf_cat(p, state->rx);
+      }
+      state->rx = p;
+    }
+  }
+
+  sys_untimeout(altcp_mbedtls_offload_poll, NULL);
+  offload->conn = NULL;
+  offload->state = NULL;
+  state->flags &= (u8_t)~ALTCP_MBEDTLS_FLAGS_OFFLOADED;
+  mbedtls_ssl_set_bio(&state->ssl_context, conn, altcp_mbedtls_bio_send, altcp_mbedtls_bio_recv, NULL);
+
+  return altcp_mbedtls_handshake_result(conn, state, ret);
+}
+
+/** Feeds the job, and ends it once it is done and all it wrote is sent */
+static err_t
+altcp_mbedtls_offload_step(struct altcp_pcb *conn, altcp_mbedtls_state_t *state)
+{
+  struct altcp_mbedtls_offload *offload = &altcp_mbedtls_offload;
+
+  altcp_mbedtls_offload_pump(conn, state);
+  if (!offload->done || (offload->tx_out != offload->tx_in)) {
+    /* altcp_mbedtls_offload_poll() comes back to it */
+    return ERR_OK;
+  }
+  altcp_mbedtls_offload_sync();
+  return altcp_mbedtls_offload_end(conn, state);
+}
+
+/** Timer for the job: the records it writes and its end don't come with a recv callback */
+static void
+altcp_mbedtls_offload_poll(void *arg)
+{
+  struct altcp_mbedtls_offload *offload = &altcp_mbedtls_offload;
+  LWIP_UNUSED_ARG(arg);
+
+  if (offload->state == NULL) {
+    return;
+  }
+  if (offload->conn == NULL) {
+    /* the connection went away, its state goes once the job let go of it */
+    if (!offload->done) {
+      sys_timeout(ALTCP_MBEDTLS_OFFLOAD_POLL_MS, altcp_mbedtls_offload_poll, NULL);
+      return;
+    }
+    altcp_mbedtls_offload_sync();
+    mbedtls_ssl_free(&offload->state->ssl_context);
+    altcp_mbedtls_free(offload->state->conf, offload->state);
+    offload->state = NULL;
+    return;
+  }
+  /* altcp_mbedtls_offload_end() takes this out again */
+  sys_timeout(ALTCP_MBEDTLS_OFFLOAD_POLL_MS, altcp_mbedtls_offload_poll, NULL);
+  altcp_mbedtls_offload_step(offload->conn, offload->state);
+}
+
+/** Starts the handshake of a connection on the other core, returns 0 if it is busy */
+static int
+altcp_mbedtls_offload_begin(struct altcp_pcb *conn, altcp_mbedtls_state_t *state)
+{
+  struct altcp_mbedtls_offload *offload = &altcp_mbedtls_offload;
+
+  if (offload->state != NULL) {
+    /* one handshake at a time, this one runs inline */
+    return 0;
+  }
+  offload->conn = conn;
+  offload->state = state;
+  offload->rx_in = 0;
+  offload->rx_out = 0;
+  offload->tx_in = 0;
+  offload->tx_out = 0;
+  offload->rx_recved = 0;
+  offload->abort = 0;
+  offload->done = 0;
+  mbedtls_ssl_set_bio(&state->ssl_context, offload, altcp_mbedtls_offload_bio_send, altcp_mbedtls_offload_bio_recv, NULL);
+  altcp_mbedtls_offload_sync();
+
+  if (!altcp_mbedtls_offload_start(altcp_mbedtls_offload_run, offload)) {
+    mbedtls_ssl_set_bio(&state->ssl_context, conn, altcp_mbedtls_bio_send, altcp_mbedtls_bio_recv, NULL);
+    offload->conn = NULL;
+    offload->state = NULL;
+    return 0;
+  }
+  state->flags |= ALTCP_MBEDTLS_FLAGS_OFFLOADED;
+  sys_timeout(ALTCP_MBEDTLS_OFFLOAD_POLL_MS, altcp_mbedtls_offload_poll, NULL);
+  return 1;
+}
+#endif /* ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD */
+
 static err_t
 altcp_mbedtls_lower_recv_process(struct altcp_pcb *conn, altcp_mbedtls_state_t *state)
 {
   if (!(state->flags & ALTCP_MBEDTLS_FLAGS_HANDSHAKE_DONE)) {
+    int ret;
+#if ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD
+    /* the handshake runs on the other core, this only feeds it */
+    if ((state->flags & ALTCP_MBEDTLS_FLAGS_OFFLOADED) || altcp_mbedtls_offload_begin(conn, state)) {
+      return altcp_mbedtls_offload_step(conn, state);
+    }
+#endif
     /* handle connection setup (handshake not done) */
-    int ret = mbedtls_ssl_handshake(&state->ssl_context);
+    ret = mbedtls_ssl_handshake(&state->ssl_context);
     /* try to send data... */
     altcp_output(conn->inner_conn);
     if (state->bio_bytes_read) {
@@ -265,33 +627,7 @@ altcp_mbedtls_lower_recv_process(struct altcp_pcb *conn, altcp_mbedtls_state_t *
       LWIP_ASSERT("in this state, the rx chain should be empty", state->rx == NULL);
       return ERR_OK;
     }
-    if (ret != 0) {
-      LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_ssl_handshake failed: %d\n", ret));
-      /* handshake failed, connection has to be closed */
-      if (conn->err) {
-        conn->err(conn->arg, ERR_CLSD);
-      }
-
-      if (altcp_close(conn) != ERR_OK) {
-        altcp_abort(conn);
-      }
-      return ERR_OK;
-    }
-    /* If we come here, handshake succeeded. */
-    LWIP_ASSERT("state", state->bio_bytes_read == 0);
-    LWIP_ASSERT("state", state->bio_bytes_appl == 0);
-    state->flags |= ALTCP_MBEDTLS_FLAGS_HANDSHAKE_DONE;
-    /* issue "connect" callback" to upper connection (this can only happen for active open) */
-    if (conn->connected) {
-      err_t err;
-      err = conn->connected(conn->arg, conn, ERR_OK);
-      if (err != ERR_OK) {
-        return err;
-      }
-    }
-    if (state->rx == NULL) {
-      return ERR_OK;
-    }
+    return altcp_mbedtls_handshake_result(conn, state, ret);
   }
   /* handle application data */
   return altcp_mbedtls_handle_rx_appldata(conn, state);
@@ -522,8 +858,8 @@ altcp_mbedtls_lower_poll(void *arg, struct altcp_pcb *inner_conn)
   LWIP_UNUSED_ARG(inner_conn); /* for LWIP_NOASSERT */
   if (conn) {
     LWIP_ASSERT("pcb mismatch", conn->inner_conn == inner_conn);
-    /* check if there's unreceived rx data */
-    if (conn->state) {
+    /* check if there's unreceived rx data (an offloaded handshake has the context) */
+    if (conn->state && !(((altcp_mbedtls_state_t *)conn->state)->flags & ALTCP_MBEDTLS_FLAGS_OFFLOADED)) {
       altcp_mbedtls_state_t *state = (altcp_mbedtls_state_t *)conn->state;
       /* try to send more if we failed before */
       mbedtls_ssl_flush_output(&state->ssl_context);
@@ -601,6 +937,12 @@ altcp_mbedtls_setup(void *conf, struct altcp_pcb *conn, struct altcp_pcb *inner_
   }
   /* tell mbedtls about our I/O functions */
   mbedtls_ssl_set_bio(&state->ssl_context, conn, altcp_mbedtls_bio_send, altcp_mbedtls_bio_recv, NULL);
+#if ALTCP_MBEDTLS_CLIENT_SESSION_REUSE
+  if (config->have_session) {
+    /* resumed if the server still has it, a full handshake otherwise */
+    mbedtls_ssl_set_session(&state->ssl_context, &config->session.data);
+  }
+#endif
 
   altcp_mbedtls_setup_callbacks(conn, inner_conn);
   conn->inner_conn = inner_conn;
@@ -636,6 +978,60 @@ altcp_tls_context(struct altcp_pcb *conn)
   return NULL;
 }
 
+struct altcp_tls_session *
+altcp_tls_alloc_session(void)
+{
+  struct altcp_tls_session *session;
+  session = (struct altcp_tls_session *)altcp_mbedtls_alloc_config(sizeof(struct altcp_tls_session));
+  if (session != NULL) {
+    mbedtls_ssl_session_init(&session->data);
+  }
+  return session;
+}
+
+err_t
+altcp_tls_get_session(struct altcp_pcb *conn, struct altcp_tls_session *dest)
+{
+  if (conn && conn->state && dest) {
+    altcp_mbedtls_state_t *state = (altcp_mbedtls_state_t *)conn->state;
+    if (!(state->flags & ALTCP_MBEDTLS_FLAGS_HANDSHAKE_DONE)) {
+      return ERR_INPROGRESS;
+    }
+    mbedtls_ssl_session_free(&dest->data);
+    mbedtls_ssl_session_init(&dest->data);
+    if (mbedtls_ssl_get_session(&state->ssl_context, &dest->data) != 0) {
+      return ERR_MEM;
+    }
+    return ERR_OK;
+  }
+  return ERR_VAL;
+}
+
+err_t
+altcp_tls_set_session(struct altcp_pcb *conn, struct altcp_tls_session *from)
+{
+  if (conn && conn->state && from) {
+    altcp_mbedtls_state_t *state = (altcp_mbedtls_state_t *)conn->state;
+    if (state->flags & (ALTCP_MBEDTLS_FLAGS_HANDSHAKE_DONE | ALTCP_MBEDTLS_FLAGS_OFFLOADED)) {
+      return ERR_ISCONN;
+    }
+    if (mbedtls_ssl_set_session(&state->ssl_context, &from->data) != 0) {
+      return ERR_VAL;
+    }
+    return ERR_OK;
+  }
+  return ERR_VAL;
+}
+
+void
+altcp_tls_free_session(struct altcp_tls_session *session)
+{
+  if (session) {
+    mbedtls_ssl_session_free(&session->data);
+    altcp_mbedtls_free_config(session);
+  }
+}
+
 #if ALTCP_MBEDTLS_DEBUG != LWIP_DBG_OFF
 static void
 altcp_mbedtls_debug(void *ctx, int level, const char *file, int line, const char *str)
@@ -739,9 +1135,37 @@ altcp_tls_create_config(int is_server, int have_cert, int have_pkey, int have_ca
   mbedtls_ssl_conf_dbg(&conf->conf, altcp_mbedtls_debug, stdout);
 #endif
 #if defined(MBEDTLS_SSL_CACHE_C) && ALTCP_MBEDTLS_SESSION_CACHE_TIMEOUT_SECONDS
-  mbedtls_ssl_conf_session_cache(&conf->conf, &conf->cache, mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
-  mbedtls_ssl_cache_set_timeout(&conf->cache, 30);
-  mbedtls_ssl_cache_set_max_entries(&conf->cache, 30);
+  mbedtls_ssl_cache_init(&conf->cache);
+  mbedtls_ssl_cache_set_timeout(&conf->cache, ALTCP_MBEDTLS_SESSION_CACHE_TIMEOUT_SECONDS);
+  mbedtls_ssl_cache_set_max_entries(&conf->cache, ALTCP_MBEDTLS_SESSION_CACHE_SIZE);
+  if (is_server) {
+    mbedtls_ssl_conf_session_cache(&conf->conf, &conf->cache, mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
+  }
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C) && ALTCP_MBEDTLS_USE_SESSION_TICKETS
+  mbedtls_ssl_ticket_init(&conf->ticket_ctx);
+  if (is_server) {
+    ret = mbedtls_ssl_ticket_setup(&conf->ticket_ctx, mbedtls_ctr_drbg_random, &conf->ctr_drbg,
+                                   ALTCP_MBEDTLS_SESSION_TICKET_CIPHER, ALTCP_MBEDTLS_SESSION_TICKET_TIMEOUT_SECONDS);
+    if (ret != 0) {
+      LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_ssl_ticket_setup failed: %d\n", ret));
+#if defined(MBEDTLS_SSL_CACHE_C) && ALTCP_MBEDTLS_SESSION_CACHE_TIMEOUT_SECONDS
+      mbedtls_ssl_cache_free(&conf->cache);
+#endif
+      mbedtls_ssl_ticket_free(&conf->ticket_ctx);
+      altcp_mbedtls_free_config(conf);
+      return NULL;
+    }
+    mbedtls_ssl_conf_session_tickets_cb(&conf->conf, mbedtls_ssl_ticket_write, mbedtls_ssl_ticket_parse, &conf->ticket_ctx);
+  }
+#endif
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  /* whether a client asks for a ticket */
+  mbedtls_ssl_conf_session_tickets(&conf->conf, ALTCP_MBEDTLS_USE_SESSION_TICKETS ?
+                                   MBEDTLS_SSL_SESSION_TICKETS_ENABLED : MBEDTLS_SSL_SESSION_TICKETS_DISABLED);
+#endif
+#if ALTCP_MBEDTLS_CLIENT_SESSION_REUSE
+  mbedtls_ssl_session_init(&conf->session.data);
 #endif
 
   return conf;
@@ -886,7 +1310,16 @@ altcp_tls_free_config(struct altcp_tls_config *conf)
   }
   if (conf->ca) {
     mbedtls_x509_crt_free(conf->ca);
-  }  
+  }
+#if defined(MBEDTLS_SSL_CACHE_C) && ALTCP_MBEDTLS_SESSION_CACHE_TIMEOUT_SECONDS
+  mbedtls_ssl_cache_free(&conf->cache);
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C) && ALTCP_MBEDTLS_USE_SESSION_TICKETS
+  mbedtls_ssl_ticket_free(&conf->ticket_ctx);
+#endif
+#if ALTCP_MBEDTLS_CLIENT_SESSION_REUSE
+  mbedtls_ssl_session_free(&conf->session.data);
+#endif
   altcp_mbedtls_free_config(conf);
 }
 
@@ -1133,6 +1566,21 @@ altcp_mbedtls_dealloc(struct altcp_pcb *conn)
   /* clean up and free tls state */
   if (conn) {
     altcp_mbedtls_state_t *state = (altcp_mbedtls_state_t *)conn->state;
+#if ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD
+    if (state && (state->flags & ALTCP_MBEDTLS_FLAGS_OFFLOADED)) {
+      /* the job still has the ssl context: stop it, altcp_mbedtls_offload_poll()
+         frees the state when it is done */
+      altcp_mbedtls_offload.conn = NULL;
+      altcp_mbedtls_offload.abort = 1;
+      altcp_mbedtls_offload_signal();
+      if (state->rx) {
+        pbuf_free(state->rx);
+        state->rx = NULL;
+      }
+      conn->state = NULL;
+      return;
+    }
+#endif
     if (state) {
       mbedtls_ssl_free(&state->ssl_context);
       state->flags = 0;
@@ -61,6 +61,9 @@
 #include "lwip/mem.h"
 
 #include "mbedtls/platform.h"
+#if ALTCP_MBEDTLS_MEM_STATIC_SIZE
+#include "mbedtls/memory_buffer_alloc.h"
+#endif
 
 #include <string.h>
 
@@ -68,7 +71,10 @@
 #define ALTCP_MBEDTLS_MEM_DEBUG   LWIP_DBG_OFF
 #endif
 
-#if defined(MBEDTLS_PLATFORM_MEMORY) && \
+#if ALTCP_MBEDTLS_MEM_STATIC_SIZE
+/* mbedtls_memory_buffer_alloc_init() sets mbedTLS's calloc/free itself */
+#define ALTCP_MBEDTLS_PLATFORM_ALLOC 0
+#elif defined(MBEDTLS_PLATFORM_MEMORY) && \
    (!defined(MBEDTLS_PLATFORM_FREE_MACRO) || \
     defined(MBEDTLS_PLATFORM_CALLOC_MACRO))
 #define ALTCP_MBEDTLS_PLATFORM_ALLOC 1
@@ -76,6 +82,19 @@
 #define ALTCP_MBEDTLS_PLATFORM_ALLOC 0
 #endif
 
+#if ALTCP_MBEDTLS_MEM_STATIC_SIZE
+#if !defined(MBEDTLS_MEMORY_BUFFER_ALLOC_C)
+#error "ALTCP_MBEDTLS_MEM_STATIC_SIZE needs MBEDTLS_MEMORY_BUFFER_ALLOC_C"
+#endif
+
+/* everything mbedTLS allocates: record buffers, handshake state, parsed certificates
+   and the session caches */
+static unsigned char altcp_mbedtls_heap[ALTCP_MBEDTLS_MEM_STATIC_SIZE];
+static u8_t altcp_mbedtls_heap_ready;
+#elif ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD
+#error "ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD needs ALTCP_MBEDTLS_MEM_STATIC_SIZE, lwIP's heap can't be used from the other core"
+#endif
+
 #if ALTCP_MBEDTLS_PLATFORM_ALLOC
 
 #ifndef ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
@@ -162,6 +181,14 @@ altcp_mbedtls_mem_init(void)
 {
   /* not much to do here when using the heap */
 
+#if ALTCP_MBEDTLS_MEM_STATIC_SIZE
+  /* once, every config allocates from the same buffer */
+  if (!altcp_mbedtls_heap_ready) {
+    mbedtls_memory_buffer_alloc_init(altcp_mbedtls_heap, sizeof(altcp_mbedtls_heap));
+    altcp_mbedtls_heap_ready = 1;
+  }
+#endif
+
 #if ALTCP_MBEDTLS_PLATFORM_ALLOC
   /* set mbedtls allocation methods */
   mbedtls_platform_set_calloc_free(&tls_malloc, &tls_free);
@@ -61,6 +61,7 @@ extern "C" {
 #define ALTCP_MBEDTLS_FLAGS_RX_CLOSE_QUEUED   0x04
 #define ALTCP_MBEDTLS_FLAGS_RX_CLOSED         0x08
 #define ALTCP_MBEDTLS_FLAGS_APPLDATA_SENT     0x10
+#define ALTCP_MBEDTLS_FLAGS_OFFLOADED         0x20
 
 typedef struct altcp_mbedtls_state_s {
   void *conf;
@@ -74,6 +75,11 @@ typedef struct altcp_mbedtls_state_s {
   int bio_bytes_appl;
 } altcp_mbedtls_state_t;
 
+/** A session to resume, see altcp_tls_get_session() */
+struct altcp_tls_session {
+  mbedtls_ssl_session data;
+};
+
 #ifdef __cplusplus
 }
 #endif
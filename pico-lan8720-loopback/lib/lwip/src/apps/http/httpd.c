@@ -107,6 +107,9 @@
 #if LWIP_HTTPD_TIMING
 #include "lwip/sys.h"
 #endif /* LWIP_HTTPD_TIMING */
+#if LWIP_HTTPD_WEBSOCKET
+#include "websocket.h"
+#endif /* LWIP_HTTPD_WEBSOCKET */
 
 #include <string.h> /* memset */
 #include <stdlib.h> /* atoi */
@@ -285,6 +288,12 @@ struct http_state {
   u8_t post_finished;
 #endif /* LWIP_HTTPD_POST_MANUAL_WND */
 #endif /* LWIP_HTTPD_SUPPORT_POST*/
+#if LWIP_HTTPD_WEBSOCKET
+  struct http_state *ws_next; /* on the list of upgraded connections */
+  u8_t websocket;   /* upgraded, frames are exchanged from then on */
+  u8_t ws_closing;  /* CLOSE sent, or a frame could not be written whole */
+  struct ws_rx ws_rx;
+#endif /* LWIP_HTTPD_WEBSOCKET */
 };
 
 #if HTTPD_USE_MEM_POOL
@@ -412,6 +421,28 @@ http_kill_oldest_connection(u8_t ssi_required)
 
 #endif /* LWIP_HTTPD_KILL_OLD_ON_CONNECTIONS_EXCEEDED */
 
+#if LWIP_HTTPD_WEBSOCKET
+/* WebSocket handlers */
+static tWSOpenHandler httpd_ws_open_handler;
+static tWSRecvHandler httpd_ws_recv_handler;
+static tWSCloseHandler httpd_ws_close_handler;
+
+/** list of the upgraded connections, for httpd_websocket_broadcast */
+static struct http_state *http_websockets;
+
+static void
+http_websocket_remove(struct http_state *hs)
+{
+  struct http_state **last;
+  for (last = &http_websockets; *last != NULL; last = &(*last)->ws_next) {
+    if (*last == hs) {
+      *last = hs->ws_next;
+      break;
+    }
+  }
+}
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
 #if LWIP_HTTPD_SSI
 /** Allocate as struct http_ssi_state. */
 static struct http_ssi_state *
@@ -514,6 +545,14 @@ static void
 http_state_free(struct http_state *hs)
 {
   if (hs != NULL) {
+#if LWIP_HTTPD_WEBSOCKET
+    if (hs->websocket) {
+      http_websocket_remove(hs);
+      if (httpd_ws_close_handler != NULL) {
+        httpd_ws_close_handler(hs);
+      }
+    }
+#endif /* LWIP_HTTPD_WEBSOCKET */
     http_state_eof(hs);
     http_remove_connection(hs);
     HTTP_FREE_HTTP_STATE(hs);
@@ -1937,6 +1976,146 @@ http_continue(void *connection)
 }
 #endif /* LWIP_HTTPD_FS_ASYNC_READ */
 
+#if LWIP_HTTPD_WEBSOCKET
+/** Find the header 'name' (with its ':', case-insensitive) in the header lines
+ * of a request, 'hdr' up to 'hdr_len' following the CRLF of its request line.
+ *
+ * @return its value without the spaces around, and its length in value_len,
+ *         or NULL when it is missing
+ */
+static const char *
+http_find_header(const char *hdr, u16_t hdr_len, const char *name, u16_t *value_len)
+{
+  const char *end = hdr + hdr_len;
+  const char *line = hdr;
+  size_t name_len = strlen(name);
+
+  while (line < end) {
+    const char *eol = lwip_strnstr(line, CRLF, (size_t)(end - line));
+    if ((eol == NULL) || (eol == line)) {
+      /* the end of the headers */
+      break;
+    }
+    if (((size_t)(eol - line) >= name_len) && !lwip_strnicmp(line, name, name_len)) {
+      const char *value = line + name_len;
+      while ((value < eol) && (*value == ' ')) {
+        value++;
+      }
+      while ((eol > value) && (eol[-1] == ' ')) {
+        eol--;
+      }
+      *value_len = (u16_t)(eol - value);
+      return value;
+    }
+    line = eol + 2;
+  }
+  return NULL;
+}
+
+/** Switch a GET with "Upgrade: websocket" to the WebSocket protocol: ask the
+ * open handler, send the 101 with the Sec-WebSocket-Accept of the key.
+ *
+ * @return ERR_VAL when the request asks for no upgrade (it is served as a file)
+ *         ERR_OK when upgraded
+ *         the error file otherwise: 400 for a bad handshake, 404 when denied
+ */
+static err_t
+http_websocket_upgrade(struct http_state *hs, struct altcp_pcb *pcb, const char *uri,
+                       const char *hdr, u16_t hdr_len)
+{
+  static const char ws_response[] = "HTTP/1.1 101 Switching Protocols" CRLF
+                                    "Upgrade: websocket" CRLF
+                                    "Connection: Upgrade" CRLF
+                                    "Sec-WebSocket-Accept: ";
+  char accept[WS_ACCEPT_LEN + 1];
+  const char *value;
+  const char *key;
+  u16_t value_len, key_len;
+
+  value = http_find_header(hdr, hdr_len, "Upgrade:", &value_len);
+  if ((value == NULL) || (value_len != 9) || lwip_strnicmp(value, "websocket", 9)) {
+    return ERR_VAL;
+  }
+  key = http_find_header(hdr, hdr_len, "Sec-WebSocket-Key:", &key_len);
+  value = http_find_header(hdr, hdr_len, "Sec-WebSocket-Version:", &value_len);
+  if ((key == NULL) || (key_len == 0) ||
+      (value == NULL) || (value_len != 2) || strncmp(value, "13", 2)) {
+    LWIP_DEBUGF(HTTPD_DEBUG, ("WebSocket upgrade without a key or version 13\n"));
+    return http_find_error_file(hs, 400);
+  }
+  if ((httpd_ws_open_handler == NULL) || (httpd_ws_open_handler(hs, uri) != ERR_OK)) {
+    LWIP_DEBUGF(HTTPD_DEBUG, ("WebSocket upgrade of \"%s\" denied\n", uri));
+    return http_find_error_file(hs, 404);
+  }
+
+  /* upgraded from here on, the close handler is called when it goes */
+  hs->websocket = 1;
+  hs->ws_next = http_websockets;
+  http_websockets = hs;
+  ws_rx_init(&hs->ws_rx);
+
+  ws_accept_key(key, key_len, accept);
+  if ((altcp_write(pcb, ws_response, sizeof(ws_response) - 1, TCP_WRITE_FLAG_MORE) != ERR_OK) ||
+      (altcp_write(pcb, accept, WS_ACCEPT_LEN, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE) != ERR_OK) ||
+      (altcp_write(pcb, CRLF CRLF, 4, 0) != ERR_OK)) {
+    return ERR_ARG;
+  }
+  /* the frames are small and are to go out as they are written */
+  altcp_nagle_disable(pcb);
+  altcp_output(pcb);
+  LWIP_DEBUGF(HTTPD_DEBUG, ("WebSocket upgrade of \"%s\"\n", uri));
+  return ERR_OK;
+}
+
+/** ws_rx_fn of the frames from the client: PING and CLOSE are answered here,
+ * the data goes to the recv handler */
+static void
+http_websocket_frame(void *arg, uint8_t opcode, const uint8_t *data, size_t len, bool last)
+{
+  struct http_state *hs = (struct http_state *)arg;
+
+  if (hs->ws_closing) {
+    return;
+  }
+  switch (opcode) {
+    case WS_OP_PING:
+      httpd_websocket_write(hs, WS_OP_PONG, data, (u16_t)len);
+      break;
+    case WS_OP_PONG:
+      break;
+    case WS_OP_CLOSE:
+      /* echo the status code */
+      httpd_websocket_write(hs, WS_OP_CLOSE, data, (u16_t)LWIP_MIN(len, 2));
+      hs->ws_closing = 1;
+      break;
+    default:
+      if (httpd_ws_recv_handler != NULL) {
+        httpd_ws_recv_handler(hs, opcode, data, (u16_t)len, last);
+      }
+      break;
+  }
+}
+
+/** Frames received on an upgraded connection, a protocol error is closed with
+ * its status code */
+static void
+http_websocket_recv(struct http_state *hs, struct pbuf *p)
+{
+  struct pbuf *q;
+
+  for (q = p; (q != NULL) && !hs->ws_closing; q = q->next) {
+    u16_t code = ws_rx_input(&hs->ws_rx, (u8_t *)q->payload, q->len, http_websocket_frame, hs);
+    if (code != 0) {
+      u8_t frame[4];
+      LWIP_DEBUGF(HTTPD_DEBUG, ("WebSocket protocol error, close %"U16_F"\n", code));
+      ws_close_frame(frame, code);
+      altcp_write(hs->pcb, frame, sizeof(frame), TCP_WRITE_FLAG_COPY);
+      hs->ws_closing = 1;
+    }
+  }
+}
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
 /**
  * When data has been received in the correct state, try to parse it
  * as a HTTP request.
@@ -2095,6 +2274,15 @@ http_parse_request(struct pbuf *inp, struct http_state *hs, struct altcp_pcb *pc
           } else
 #endif /* LWIP_HTTPD_SUPPORT_POST */
           {
+#if LWIP_HTTPD_WEBSOCKET
+            if (!is_09) {
+              err_t err_ws = http_websocket_upgrade(hs, pcb, uri, crlf + 2,
+                                                    (u16_t)(data_len - ((crlf + 2) - data)));
+              if (err_ws != ERR_VAL) {
+                return err_ws;
+              }
+            }
+#endif /* LWIP_HTTPD_WEBSOCKET */
             return http_find_file(hs, uri, is_09);
           }
         }
@@ -2429,6 +2617,17 @@ http_err(void *arg, err_t err)
   LWIP_DEBUGF(HTTPD_DEBUG, ("http_err: %s", lwip_strerr(err)));
 
   if (hs != NULL) {
+#if LWIP_HTTPD_SUPPORT_POST
+    if ((hs->post_content_len_left != 0)
+#if LWIP_HTTPD_POST_MANUAL_WND
+        || ((hs->no_auto_wnd != 0) && (hs->unrecved_bytes != 0))
+#endif /* LWIP_HTTPD_POST_MANUAL_WND */
+       ) {
+      /* as in http_close_or_abort_conn(): the post code may still hold hs */
+      http_uri_buf[0] = 0;
+      httpd_post_finished(hs, http_uri_buf, LWIP_HTTPD_URI_BUF_LEN);
+    }
+#endif /* LWIP_HTTPD_SUPPORT_POST */
     http_state_free(hs);
   }
 }
@@ -2452,6 +2651,13 @@ http_sent(void *arg, struct altcp_pcb *pcb, u16_t len)
 
   hs->retries = 0;
 
+#if LWIP_HTTPD_WEBSOCKET
+  if (hs->websocket) {
+    /* no file, the application pushes the frames */
+    return ERR_OK;
+  }
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
   http_send(pcb, hs);
 
   return ERR_OK;
@@ -2492,6 +2698,19 @@ http_poll(void *arg, struct altcp_pcb *pcb)
       return ERR_OK;
     }
 
+#if LWIP_HTTPD_WEBSOCKET
+    if (hs->websocket) {
+      if (hs->ws_closing) {
+        http_close_conn(pcb, hs);
+      } else if (hs->retries > 1) {
+        /* nothing acknowledged for a poll interval: a PING, whose ACK resets
+           the retries, so a peer gone away is closed after HTTPD_MAX_RETRIES */
+        httpd_websocket_write(hs, WS_OP_PING, NULL, 0);
+      }
+      return ERR_OK;
+    }
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
     /* If this connection has a file open, try to send some more data. If
      * it has not yet received a GET request, don't do this since it will
      * cause the connection to close immediately. */
@@ -2544,6 +2763,17 @@ http_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
     altcp_recved(pcb, p->tot_len);
   }
 
+#if LWIP_HTTPD_WEBSOCKET
+  if (hs->websocket) {
+    http_websocket_recv(hs, p);
+    pbuf_free(p);
+    if (hs->ws_closing) {
+      http_close_conn(pcb, hs);
+    }
+    return ERR_OK;
+  }
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
 #if LWIP_HTTPD_SUPPORT_POST
   if (hs->post_content_len_left > 0) {
     /* reset idle counter when POST data is received */
@@ -2574,6 +2804,11 @@ http_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
 #endif /* LWIP_HTTPD_SUPPORT_REQUESTLIST */
       pbuf_free(p);
       if (parsed == ERR_OK) {
+#if LWIP_HTTPD_WEBSOCKET
+        if (hs->websocket) {
+          /* the 101 is out, there is no file to send */
+        } else
+#endif /* LWIP_HTTPD_WEBSOCKET */
 #if LWIP_HTTPD_SUPPORT_POST
         if (hs->post_content_len_left == 0)
 #endif /* LWIP_HTTPD_SUPPORT_POST */
@@ -2743,4 +2978,97 @@ http_set_cgi_handlers(const tCGI *cgis, int num_handlers)
 }
 #endif /* LWIP_HTTPD_CGI */
 
+#if LWIP_HTTPD_WEBSOCKET
+/**
+ * @ingroup httpd
+ * Set the handlers of the WebSocket upgrade. Without an open handler every
+ * upgrade is denied.
+ *
+ * @param open_handler called for an upgrade, accepts or denies it
+ * @param recv_handler called for the data of the client (may be NULL)
+ * @param close_handler called when an upgraded connection goes (may be NULL)
+ */
+void
+http_set_websocket_handlers(tWSOpenHandler open_handler, tWSRecvHandler recv_handler,
+                            tWSCloseHandler close_handler)
+{
+  httpd_ws_open_handler = open_handler;
+  httpd_ws_recv_handler = recv_handler;
+  httpd_ws_close_handler = close_handler;
+}
+
+/**
+ * @ingroup httpd
+ * Send a message in one frame on an upgraded connection: the head and the
+ * payload are copied into the send buffer of the pcb next to each other and
+ * sent right away (Nagle is off). A frame is queued whole or not at all.
+ *
+ * @param connection as passed to the open handler
+ * @param opcode WS_OP_BINARY or WS_OP_TEXT (or a control frame)
+ * @param data payload
+ * @param len length of the payload
+ * @return ERR_OK: the frame is queued
+ *         ERR_MEM: no room for it now, try again on a later poll or call
+ *         ERR_CONN: the connection is closing
+ */
+err_t
+httpd_websocket_write(void *connection, u8_t opcode, const void *data, u16_t len)
+{
+  struct http_state *hs = (struct http_state *)connection;
+  struct altcp_pcb *pcb;
+  u8_t head[WS_HEAD_MAX];
+  u16_t head_len;
+  err_t err;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ERROR("httpd_websocket_write: invalid connection", (hs != NULL) && hs->websocket, return ERR_ARG;);
+
+  if (hs->ws_closing) {
+    return ERR_CONN;
+  }
+  pcb = hs->pcb;
+  head_len = (u16_t)ws_frame_head(head, opcode, len);
+  /* one pbuf for the head, one for each MSS of the payload at most */
+  if ((altcp_sndbuf(pcb) < (u32_t)head_len + len) ||
+      (altcp_sndqueuelen(pcb) + 2 + len / TCP_MSS > TCP_SND_QUEUELEN)) {
+    return ERR_MEM;
+  }
+  err = altcp_write(pcb, head, head_len, TCP_WRITE_FLAG_COPY | (len ? TCP_WRITE_FLAG_MORE : 0));
+  if (err != ERR_OK) {
+    return err;
+  }
+  if (len > 0) {
+    err = altcp_write(pcb, data, len, TCP_WRITE_FLAG_COPY);
+    if (err != ERR_OK) {
+      /* the head without its payload is out: the stream is broken, close it */
+      LWIP_DEBUGF(HTTPD_DEBUG, ("httpd_websocket_write: payload failed, close\n"));
+      hs->ws_closing = 1;
+      return ERR_CONN;
+    }
+  }
+  altcp_output(pcb);
+  return ERR_OK;
+}
+
+/**
+ * @ingroup httpd
+ * httpd_websocket_write the message to every upgraded connection.
+ *
+ * @return the number of connections it was queued on
+ */
+int
+httpd_websocket_broadcast(u8_t opcode, const void *data, u16_t len)
+{
+  struct http_state *hs;
+  int count = 0;
+
+  for (hs = http_websockets; hs != NULL; hs = hs->ws_next) {
+    if (httpd_websocket_write(hs, opcode, data, len) == ERR_OK) {
+      count++;
+    }
+  }
+  return count;
+}
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
 #endif /* LWIP_TCP && LWIP_CALLBACK_API */
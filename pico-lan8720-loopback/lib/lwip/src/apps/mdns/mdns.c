@@ -64,6 +64,7 @@
 #include "lwip/prot/dns.h"
 #include "lwip/prot/iana.h"
 #include "lwip/timeouts.h"
+#include "lwip/sys.h"
 
 #include <string.h>
 
@@ -177,6 +178,27 @@ struct mdns_service {
   u16_t port;
 };
 
+#if MDNS_RESP_CACHE
+/** A response as it was sent, for the same answers asked for again */
+struct mdns_resp_cache_entry {
+  /** Reply bitmasks of the answers, as in struct mdns_outpacket */
+  u8_t host_replies;
+  u8_t host_reverse_v6_replies;
+  u8_t serv_replies[MDNS_MAX_SERVICES];
+  u8_t cache_flush;
+  /** Sent over IPv6 */
+  u8_t v6;
+  /** Set once the entry has a response */
+  u8_t used;
+  /** Set once the response was multicast, at mcast_time (sys_now()) */
+  u8_t mcast_sent;
+  u32_t mcast_time;
+  /** Length of data, 0 when the response was too big to keep */
+  u16_t len;
+  u8_t data[MDNS_RESP_CACHE_SIZE];
+};
+#endif /* MDNS_RESP_CACHE */
+
 /** Description of a host/netif */
 struct mdns_host {
   /** Hostname */
@@ -189,6 +211,12 @@ struct mdns_host {
   u8_t probes_sent;
   /** State in probing sequence */
   u8_t probing_state;
+#if MDNS_RESP_CACHE
+  /** Responses sent, the next one replaces cache[cache_next] */
+  struct mdns_resp_cache_entry cache[MDNS_RESP_CACHE_ENTRIES];
+  u8_t cache_next;
+  struct mdns_resp_cache_stats cache_stats;
+#endif /* MDNS_RESP_CACHE */
 };
 
 /** Information about received packet */
@@ -1298,6 +1326,121 @@ mdns_init_outpacket(struct mdns_outpacket *out, struct mdns_packet *in)
   }
 }
 
+/**
+ * Send a response pbuf unicast or to the multicast group of the destination's IP version
+ */
+static err_t
+mdns_send_outpbuf(struct mdns_outpacket *outpkt, struct pbuf *p)
+{
+  const ip_addr_t *mcast_destaddr;
+
+  if (IP_IS_V6_VAL(outpkt->dest_addr)) {
+#if LWIP_IPV6
+    mcast_destaddr = &v6group;
+#endif
+  } else {
+#if LWIP_IPV4
+    mcast_destaddr = &v4group;
+#endif
+  }
+  LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Sending packet, len=%d, unicast=%d\n", p->tot_len, outpkt->unicast_reply));
+  if (outpkt->unicast_reply) {
+    return udp_sendto_if(mdns_pcb, p, &outpkt->dest_addr, outpkt->dest_port, outpkt->netif);
+  }
+  return udp_sendto_if(mdns_pcb, p, mcast_destaddr, LWIP_IANA_PORT_MDNS, outpkt->netif);
+}
+
+#if MDNS_RESP_CACHE
+/**
+ * Forget the responses sent, their answers are not the netif's any more
+ */
+static void
+mdns_resp_cache_flush(struct mdns_host *mdns)
+{
+  int i;
+
+  for (i = 0; i < MDNS_RESP_CACHE_ENTRIES; i++) {
+    mdns->cache[i].used = 0;
+  }
+}
+
+/**
+ * Find the response sent before with the answers chosen for outpkt
+ */
+static struct mdns_resp_cache_entry *
+mdns_resp_cache_lookup(struct mdns_host *mdns, struct mdns_outpacket *outpkt)
+{
+  int i;
+
+  for (i = 0; i < MDNS_RESP_CACHE_ENTRIES; i++) {
+    struct mdns_resp_cache_entry *entry = &mdns->cache[i];
+    if (entry->used &&
+        (entry->host_replies == outpkt->host_replies) &&
+        (entry->host_reverse_v6_replies == outpkt->host_reverse_v6_replies) &&
+        (entry->cache_flush == outpkt->cache_flush) &&
+        (entry->v6 == IP_IS_V6_VAL(outpkt->dest_addr)) &&
+        (memcmp(entry->serv_replies, outpkt->serv_replies, sizeof(entry->serv_replies)) == 0)) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Take an entry for the answers chosen for outpkt, the oldest one goes
+ */
+static struct mdns_resp_cache_entry *
+mdns_resp_cache_new(struct mdns_host *mdns, struct mdns_outpacket *outpkt)
+{
+  struct mdns_resp_cache_entry *entry = &mdns->cache[mdns->cache_next];
+
+  mdns->cache_next = (u8_t)((mdns->cache_next + 1) % MDNS_RESP_CACHE_ENTRIES);
+
+  entry->host_replies = outpkt->host_replies;
+  entry->host_reverse_v6_replies = outpkt->host_reverse_v6_replies;
+  MEMCPY(entry->serv_replies, outpkt->serv_replies, sizeof(entry->serv_replies));
+  entry->cache_flush = outpkt->cache_flush;
+  entry->v6 = IP_IS_V6_VAL(outpkt->dest_addr) ? 1 : 0;
+  entry->used = 1;
+  entry->mcast_sent = 0;
+  entry->len = 0;
+  return entry;
+}
+
+/**
+ * Whether the response of entry was multicast less than MDNS_RESP_MCAST_INTERVAL ago
+ */
+static int
+mdns_resp_cache_mcast_recent(struct mdns_resp_cache_entry *entry)
+{
+#if MDNS_RESP_MCAST_INTERVAL
+  return entry->mcast_sent && ((u32_t)(sys_now() - entry->mcast_time) < MDNS_RESP_MCAST_INTERVAL);
+#else
+  LWIP_UNUSED_ARG(entry);
+  return 0;
+#endif
+}
+
+/**
+ * Send the response of entry as it was serialised, only the destination changes
+ */
+static err_t
+mdns_resp_cache_send(struct mdns_resp_cache_entry *entry, struct mdns_outpacket *outpkt)
+{
+  struct pbuf *p;
+  err_t res;
+
+  p = pbuf_alloc(PBUF_TRANSPORT, entry->len, PBUF_RAM);
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+  pbuf_take(p, entry->data, entry->len);
+  res = mdns_send_outpbuf(outpkt, p);
+  pbuf_free(p);
+  return res;
+}
+#endif /* MDNS_RESP_CACHE */
+
 /**
  * Send chosen answers as a reply
  *
@@ -1313,6 +1456,33 @@ mdns_send_outpacket(struct mdns_outpacket *outpkt, u8_t flags)
   int i;
   struct mdns_host *mdns = NETIF_TO_HOST(outpkt->netif);
   u16_t answers = 0;
+#if MDNS_RESP_CACHE
+  struct mdns_resp_cache_entry *entry = NULL;
+  /* responses to queries and announcements, not probes or legacy replies with their
+     question and ID */
+  u8_t cacheable = (flags == (DNS_FLAG1_RESPONSE | DNS_FLAG1_AUTHORATIVE)) &&
+                   !outpkt->legacy_query && (outpkt->pbuf == NULL);
+
+  if (cacheable) {
+    entry = mdns_resp_cache_lookup(mdns, outpkt);
+    if (entry != NULL) {
+      if (!outpkt->unicast_reply && mdns_resp_cache_mcast_recent(entry)) {
+        LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Same response multicast less than %d ms ago, not sent\n", MDNS_RESP_MCAST_INTERVAL));
+        mdns->cache_stats.suppressed++;
+        return ERR_OK;
+      }
+      if (entry->len != 0) {
+        mdns->cache_stats.hits++;
+        res = mdns_resp_cache_send(entry, outpkt);
+        if ((res == ERR_OK) && !outpkt->unicast_reply) {
+          entry->mcast_sent = 1;
+          entry->mcast_time = sys_now();
+        }
+        return res;
+      }
+    }
+  }
+#endif /* MDNS_RESP_CACHE */
 
   /* Write answers to host questions */
 #if LWIP_IPV4
@@ -1468,7 +1638,6 @@ mdns_send_outpacket(struct mdns_outpacket *outpkt, u8_t flags)
   }
 
   if (outpkt->pbuf) {
-    const ip_addr_t *mcast_destaddr;
     struct dns_hdr hdr;
 
     /* Write header */
@@ -1484,22 +1653,27 @@ mdns_send_outpacket(struct mdns_outpacket *outpkt, u8_t flags)
     /* Shrink packet */
     pbuf_realloc(outpkt->pbuf, outpkt->write_offset);
 
-    if (IP_IS_V6_VAL(outpkt->dest_addr)) {
-#if LWIP_IPV6
-      mcast_destaddr = &v6group;
-#endif
-    } else {
-#if LWIP_IPV4
-      mcast_destaddr = &v4group;
-#endif
+#if MDNS_RESP_CACHE
+    /* kept before it is sent, the pbuf gets the UDP and IP headers in front */
+    if (cacheable) {
+      mdns->cache_stats.misses++;
+      if (entry == NULL) {
+        entry = mdns_resp_cache_new(mdns, outpkt);
+      }
+      if (outpkt->write_offset <= MDNS_RESP_CACHE_SIZE) {
+        entry->len = pbuf_copy_partial(outpkt->pbuf, entry->data, outpkt->write_offset, 0);
+      }
     }
+#endif /* MDNS_RESP_CACHE */
+
     /* Send created packet */
-    LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Sending packet, len=%d, unicast=%d\n", outpkt->write_offset, outpkt->unicast_reply));
-    if (outpkt->unicast_reply) {
-      res = udp_sendto_if(mdns_pcb, outpkt->pbuf, &outpkt->dest_addr, outpkt->dest_port, outpkt->netif);
-    } else {
-      res = udp_sendto_if(mdns_pcb, outpkt->pbuf, mcast_destaddr, LWIP_IANA_PORT_MDNS, outpkt->netif);
+    res = mdns_send_outpbuf(outpkt, outpkt->pbuf);
+#if MDNS_RESP_CACHE
+    if ((entry != NULL) && (res == ERR_OK) && !outpkt->unicast_reply) {
+      entry->mcast_sent = 1;
+      entry->mcast_time = sys_now();
     }
+#endif /* MDNS_RESP_CACHE */
   }
 
 cleanup:
@@ -2252,6 +2426,9 @@ mdns_resp_del_service(struct netif *netif, s8_t slot)
   srv = mdns->services[slot];
   mdns->services[slot] = NULL;
   mem_free(srv);
+#if MDNS_RESP_CACHE
+  mdns_resp_cache_flush(mdns);
+#endif
   return ERR_OK;
 }
 
@@ -2325,6 +2502,11 @@ mdns_resp_announce(struct netif *netif)
     return;
   }
 
+#if MDNS_RESP_CACHE
+  /* addresses or TXT data changed */
+  mdns_resp_cache_flush(mdns);
+#endif
+
   if (mdns->probing_state == MDNS_PROBING_COMPLETE) {
     /* Announce on IPv6 and IPv4 */
 #if LWIP_IPV6
@@ -2367,12 +2549,38 @@ mdns_resp_restart(struct netif *netif)
   if (mdns->probing_state == MDNS_PROBING_ONGOING) {
     sys_untimeout(mdns_probe, netif);
   }
+#if MDNS_RESP_CACHE
+  mdns_resp_cache_flush(mdns);
+#endif
   /* @todo if we've failed 15 times within a 10 second period we MUST wait 5 seconds (or wait 5 seconds every time except first)*/
   mdns->probes_sent = 0;
   mdns->probing_state = MDNS_PROBING_ONGOING;
   sys_timeout(MDNS_INITIAL_PROBE_DELAY_MS, mdns_probe, netif);
 }
 
+#if MDNS_RESP_CACHE
+/**
+ * @ingroup mdns
+ * Get the counters of the response cache of a netif
+ * @param netif The network interface
+ * @param stats Filled with the counters
+ * @return ERR_OK, ERR_VAL if mDNS is not active on netif
+ */
+err_t
+mdns_resp_get_cache_stats(struct netif *netif, struct mdns_resp_cache_stats *stats)
+{
+  struct mdns_host *mdns;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ERROR("mdns_resp_get_cache_stats: netif != NULL", (netif != NULL), return ERR_VAL);
+  mdns = NETIF_TO_HOST(netif);
+  LWIP_ERROR("mdns_resp_get_cache_stats: Not an mdns netif", (mdns != NULL), return ERR_VAL);
+
+  *stats = mdns->cache_stats;
+  return ERR_OK;
+}
+#endif /* MDNS_RESP_CACHE */
+
 /**
  * @ingroup mdns
  * Initiate MDNS responder. Will open UDP sockets on port 5353
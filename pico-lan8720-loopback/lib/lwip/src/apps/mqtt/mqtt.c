@@ -59,8 +59,16 @@
 #include "lwip/altcp_tls.h"
 #include <string.h>
 
+#if MQTT_PUBLISH_REF
+#include "lwip/priv/tcp_priv.h"
+#endif
+
 #if LWIP_TCP && LWIP_CALLBACK_API
 
+#if MQTT_PUBLISH_REF && LWIP_ALTCP
+#error "MQTT_PUBLISH_REF needs LWIP_ALTCP==0, it follows the tcp_pcb's sequence numbers"
+#endif
+
 /**
  * MQTT_DEBUG: Default is off.
  */
@@ -219,8 +227,9 @@ mqtt_ringbuf_len(struct mqtt_ringbuf_t *rb)
   return (u16_t)len;
 }
 
-/** Return number of bytes free in ring buffer */
-#define mqtt_ringbuf_free(rb) (MQTT_OUTPUT_RINGBUF_SIZE - mqtt_ringbuf_len(rb))
+/** Return number of bytes free in ring buffer, one short of the unused ones as a full
+    ring buffer (put == get) would read as empty */
+#define mqtt_ringbuf_free(rb) (MQTT_OUTPUT_RINGBUF_SIZE - 1 - mqtt_ringbuf_len(rb))
 
 /** Return number of bytes possible to read without wrapping around */
 #define mqtt_ringbuf_linear_read_length(rb) LWIP_MIN(mqtt_ringbuf_len(rb), (MQTT_OUTPUT_RINGBUF_SIZE - (rb)->get))
@@ -235,6 +244,12 @@ mqtt_output_send(struct mqtt_ringbuf_t *rb, struct altcp_pcb *tpcb)
 {
   err_t err;
   u8_t wrap = 0;
+#if MQTT_OUTPUT_BATCH
+  /* Held output leaves PSH and tcp_output() to mqtt_output_flush() */
+  u8_t hold = rb->hold;
+#else
+  const u8_t hold = 0;
+#endif
   u16_t ringbuf_lin_len = mqtt_ringbuf_linear_read_length(rb);
   u16_t send_len = altcp_sndbuf(tpcb);
   LWIP_ASSERT("mqtt_output_send: tpcb != NULL", tpcb != NULL);
@@ -252,18 +267,20 @@ mqtt_output_send(struct mqtt_ringbuf_t *rb, struct altcp_pcb *tpcb)
     /* Wrap around if more data in ring buffer after linear portion */
     wrap = (mqtt_ringbuf_len(rb) > ringbuf_lin_len);
   }
-  err = altcp_write(tpcb, mqtt_ringbuf_get_ptr(rb), send_len, TCP_WRITE_FLAG_COPY | (wrap ? TCP_WRITE_FLAG_MORE : 0));
+  err = altcp_write(tpcb, mqtt_ringbuf_get_ptr(rb), send_len, TCP_WRITE_FLAG_COPY | ((wrap || hold) ? TCP_WRITE_FLAG_MORE : 0));
   if ((err == ERR_OK) && wrap) {
     mqtt_ringbuf_advance_get_idx(rb, send_len);
     /* Use the lesser one of ring buffer linear length and TCP send buffer size */
     send_len = LWIP_MIN(altcp_sndbuf(tpcb), mqtt_ringbuf_linear_read_length(rb));
-    err = altcp_write(tpcb, mqtt_ringbuf_get_ptr(rb), send_len, TCP_WRITE_FLAG_COPY);
+    err = altcp_write(tpcb, mqtt_ringbuf_get_ptr(rb), send_len, TCP_WRITE_FLAG_COPY | (hold ? TCP_WRITE_FLAG_MORE : 0));
   }
 
   if (err == ERR_OK) {
     mqtt_ringbuf_advance_get_idx(rb, send_len);
     /* Flush */
-    altcp_output(tpcb);
+    if (!hold) {
+      altcp_output(tpcb);
+    }
   } else {
     LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_output_send: Send failed with err %d (\"%s\")\n", err, lwip_strerr(err)));
   }
@@ -443,6 +460,50 @@ mqtt_init_requests(struct mqtt_request_t *r_objs, size_t r_objs_len)
   }
 }
 
+#if MQTT_PUBLISH_REF
+/**
+ * Queue the callback of a mqtt_publish_ref() payload, the caller checked there is room
+ * @param client MQTT client
+ * @param seq Sequence number after the payload's last byte
+ * @param cb Callback
+ * @param arg Callback argument
+ */
+static void
+mqtt_publish_ref_push(mqtt_client_t *client, u32_t seq, mqtt_request_cb_t cb, void *arg)
+{
+  struct mqtt_publish_ref_t *ref;
+
+  ref = &client->ref_queue[(client->ref_get + client->ref_len) % MQTT_PUBLISH_REF_QUEUE];
+  ref->seq = seq;
+  ref->cb = cb;
+  ref->arg = arg;
+  client->ref_len++;
+}
+
+/**
+ * Call the callbacks of mqtt_publish_ref() payloads lwIP is done with
+ * @param client MQTT client
+ * @param err ERR_OK for the acknowledged ones, otherwise all of them, the connection is gone
+ */
+static void
+mqtt_publish_ref_release(mqtt_client_t *client, err_t err)
+{
+  while (client->ref_len > 0) {
+    struct mqtt_publish_ref_t *ref = &client->ref_queue[client->ref_get];
+    mqtt_request_cb_t cb = ref->cb;
+    void *arg = ref->arg;
+
+    if ((err == ERR_OK) && TCP_SEQ_LT(client->conn->lastack, ref->seq)) {
+      break;
+    }
+    /* Taken before the callback, which may publish again */
+    client->ref_get = (u8_t)((client->ref_get + 1) % MQTT_PUBLISH_REF_QUEUE);
+    client->ref_len--;
+    cb(arg, err);
+  }
+}
+#endif
+
 /*--------------------------------------------------------------------------------------------------------------------- */
 /* Output message build helpers */
 
@@ -544,14 +605,26 @@ mqtt_close(mqtt_client_t *client, mqtt_connection_status_t reason)
     altcp_recv(client->conn, NULL);
     altcp_err(client->conn,  NULL);
     altcp_sent(client->conn, NULL);
-    res = altcp_close(client->conn);
-    if (res != ERR_OK) {
+#if MQTT_PUBLISH_REF
+    /* A closed pcb would go on sending from payloads whose callbacks are called below */
+    if (client->ref_len > 0) {
       altcp_abort(client->conn);
-      LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_close: Close err=%s\n", lwip_strerr(res)));
+    } else
+#endif
+    {
+      res = altcp_close(client->conn);
+      if (res != ERR_OK) {
+        altcp_abort(client->conn);
+        LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_close: Close err=%s\n", lwip_strerr(res)));
+      }
     }
     client->conn = NULL;
   }
 
+#if MQTT_PUBLISH_REF
+  mqtt_publish_ref_release(client, ERR_CONN);
+#endif
+
   /* Remove all pending requests */
   mqtt_clear_requests(&client->pend_req_queue);
   /* Stop cyclic timer */
@@ -980,6 +1053,10 @@ mqtt_tcp_sent_cb(void *arg, struct altcp_pcb *tpcb, u16_t len)
   LWIP_UNUSED_ARG(tpcb);
   LWIP_UNUSED_ARG(len);
 
+#if MQTT_PUBLISH_REF
+  mqtt_publish_ref_release(client, ERR_OK);
+#endif
+
   if (client->conn_state == MQTT_CONNECTED) {
     struct mqtt_request_t *r;
 
@@ -1157,6 +1234,157 @@ mqtt_publish(mqtt_client_t *client, const char *topic, const void *payload, u16_
   return ERR_OK;
 }
 
+#if MQTT_PUBLISH_REF
+/**
+ * @ingroup mqtt
+ * MQTT QoS 0 publish of a payload TCP refers to instead of copying. The payload must stay
+ * as it is until cb is called, once: with ERR_OK once the server acknowledged its last
+ * byte, or with another error once the connection is closed. A publish that can't be
+ * written to TCP at once (TCP's send buffer or queue is short, the output ring buffer has
+ * data to send first, the client isn't connected yet) is copied as mqtt_publish() does,
+ * its cb still called in order with the others. With a cb, each publish takes one of
+ * MQTT_PUBLISH_REF_QUEUE entries, ERR_MEM when there is none left.
+ * @param client MQTT client
+ * @param topic Publish topic string
+ * @param payload Data to publish
+ * @param payload_length Length of payload
+ * @param retain MQTT retain flag
+ * @param cb Callback to call when the payload can be reused, NULL for data that never changes
+ * @param arg User supplied argument to publish callback
+ * @return ERR_OK if successful
+ *         ERR_CONN if client is disconnected
+ *         ERR_MEM if short on memory
+ */
+err_t
+mqtt_publish_ref(mqtt_client_t *client, const char *topic, const void *payload, u16_t payload_length, u8_t retain,
+                 mqtt_request_cb_t cb, void *arg)
+{
+  struct tcp_pcb *pcb;
+  u8_t header[1 + 3 + 2];
+  u16_t header_len = 0;
+  size_t topic_strlen;
+  size_t total_len;
+  u16_t topic_len;
+  u16_t remaining_length;
+  u16_t queuelen;
+  err_t err;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ASSERT("mqtt_publish_ref: client != NULL", client);
+  LWIP_ASSERT("mqtt_publish_ref: topic != NULL", topic);
+  LWIP_ERROR("mqtt_publish_ref: TCP disconnected", (client->conn_state != TCP_DISCONNECTED), return ERR_CONN);
+
+  topic_strlen = strlen(topic);
+  LWIP_ERROR("mqtt_publish_ref: topic length overflow", (topic_strlen <= (0xFFFF - 2)), return ERR_ARG);
+  topic_len = (u16_t)topic_strlen;
+  total_len = 2 + topic_len + payload_length;
+  LWIP_ERROR("mqtt_publish_ref: total length overflow", (total_len <= 0xFFFF), return ERR_ARG);
+  remaining_length = (u16_t)total_len;
+
+  pcb = client->conn;
+  /* pbufs for the worst case: the header and the topic each in a segment of their own,
+     the payload in a header and a PBUF_ROM pbuf per segment, and one more for the
+     first part of each write appended to the last queued segment */
+  queuelen = (u16_t)(3 + topic_len / tcp_mss(pcb) + 1 + 2 * (payload_length / tcp_mss(pcb) + 1));
+
+  if ((cb != NULL) && (client->ref_len == MQTT_PUBLISH_REF_QUEUE)) {
+    LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_publish_ref: Reference queue full\n"));
+    return ERR_MEM;
+  }
+
+  if ((client->conn_state != MQTT_CONNECTED) || (mqtt_ringbuf_len(&client->output) != 0) ||
+      (payload_length == 0) || (tcp_sndbuf(pcb) < (1 + 3 + total_len)) ||
+      ((tcp_sndqueuelen(pcb) + queuelen) > TCP_SND_QUEUELEN)) {
+    /* Copied, cb waits behind the references before it all the same */
+    err = mqtt_publish(client, topic, payload, payload_length, 0, retain, NULL, NULL);
+    if ((err == ERR_OK) && (cb != NULL)) {
+      mqtt_publish_ref_push(client, pcb->snd_lbb, cb, arg);
+    }
+    return err;
+  }
+
+  LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_publish_ref: Publish with payload length %d to topic \"%s\"\n", payload_length, topic));
+
+  /* The fixed header as mqtt_output_append_fixed_header() puts it, then the topic length */
+  header[header_len++] = (u8_t)((MQTT_MSG_TYPE_PUBLISH << 4) | (retain & 1));
+  do {
+    header[header_len++] = (u8_t)((remaining_length & 0x7f) | (remaining_length >= 128 ? 0x80 : 0));
+    remaining_length >>= 7;
+  } while (remaining_length > 0);
+  header[header_len++] = (u8_t)(topic_len >> 8);
+  header[header_len++] = (u8_t)(topic_len & 0xff);
+
+  /* Nothing is queued when the first write fails */
+  err = tcp_write(pcb, header, header_len, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
+  if (err != ERR_OK) {
+    return err;
+  }
+  err = tcp_write(pcb, topic, topic_len, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
+  if (err == ERR_OK) {
+#if MQTT_OUTPUT_BATCH
+    err = tcp_write(pcb, payload, payload_length, client->output.hold ? TCP_WRITE_FLAG_MORE : 0);
+#else
+    err = tcp_write(pcb, payload, payload_length, 0);
+#endif
+  }
+  if (err != ERR_OK) {
+    /* Out of memory half way, the stream can't go on without the rest of the message */
+    LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_publish_ref: Send failed with err %d (\"%s\")\n", err, lwip_strerr(err)));
+    mqtt_close(client, MQTT_CONNECT_DISCONNECTED);
+    return err;
+  }
+
+  if (cb != NULL) {
+    mqtt_publish_ref_push(client, pcb->snd_lbb, cb, arg);
+  }
+
+#if MQTT_OUTPUT_BATCH
+  if (client->output.hold) {
+    return ERR_OK;
+  }
+#endif
+  tcp_output(pcb);
+  return ERR_OK;
+}
+#endif /* MQTT_PUBLISH_REF */
+
+#if MQTT_OUTPUT_BATCH
+/**
+ * @ingroup mqtt
+ * Hold the output of the publishes, subscribes and unsubscribes that follow. They are
+ * queued to TCP but not sent with tcp_output() until mqtt_output_flush(), although lwIP
+ * still sends queued data when an ACK comes in.
+ * @param client MQTT client
+ */
+void
+mqtt_output_hold(mqtt_client_t *client)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ASSERT("mqtt_output_hold: client != NULL", client);
+  client->output.hold = 1;
+}
+
+/**
+ * @ingroup mqtt
+ * Send what was queued since mqtt_output_hold(), without waiting for the ACK of data
+ * in flight as Nagle's algorithm would make a small last segment do
+ * @param client MQTT client
+ */
+void
+mqtt_output_flush(mqtt_client_t *client)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ASSERT("mqtt_output_flush: client != NULL", client);
+  client->output.hold = 0;
+  if (client->conn != NULL) {
+    mqtt_output_send(&client->output, client->conn);
+    altcp_nagle_disable(client->conn);
+    altcp_output(client->conn);
+    altcp_nagle_enable(client->conn);
+  }
+}
+#endif /* MQTT_OUTPUT_BATCH */
+
 
 /**
  * @ingroup mqtt
@@ -63,6 +63,12 @@
 #define TFTP_DATA  3
 #define TFTP_ACK   4
 #define TFTP_ERROR 5
+#define TFTP_OACK  6
+
+#if TFTP_OPTIONS
+/* Option names and values of a request taken, the rest is ignored */
+#define TFTP_MAX_OPTIONS_LEN 64
+#endif
 
 enum tftp_error {
   TFTP_ERROR_FILE_NOT_FOUND    = 1,
@@ -88,6 +94,16 @@ struct tftp_state {
   u16_t blknum;
   u8_t retries;
   u8_t mode_write;
+#if TFTP_OPTIONS
+  u16_t blksize;
+  u16_t windowsize;
+  /* blocks in order since the last ACK */
+  u16_t window_blocks;
+  /* blocks out of order since the last one in order */
+  u16_t unexpected;
+  /* an ACK waits for tftp_resume() */
+  u8_t ack_held;
+#endif
 };
 
 static struct tftp_state tftp_state;
@@ -99,6 +115,9 @@ close_handle(void)
 {
   tftp_state.port = 0;
   ip_addr_set_any(0, &tftp_state.addr);
+#if TFTP_OPTIONS
+  tftp_state.ack_held = 0;
+#endif
 
   if (tftp_state.last_data != NULL) {
     pbuf_free(tftp_state.last_data);
@@ -153,6 +172,114 @@ send_ack(u16_t blknum)
   pbuf_free(p);
 }
 
+#if TFTP_OPTIONS
+/* Value of an option in the NUL separated name and value pairs of a request, or NULL */
+static const char *
+find_option(const char *options, u16_t len, const char *name)
+{
+  u16_t pos = 0;
+
+  while (pos < len) {
+    const char *option = &options[pos];
+    u16_t value_pos = (u16_t)(pos + strlen(option) + 1);
+
+    if (value_pos >= len) {
+      break;
+    }
+    if (lwip_stricmp(option, name) == 0) {
+      return &options[value_pos];
+    }
+    pos = (u16_t)(value_pos + strlen(&options[value_pos]) + 1);
+  }
+  return NULL;
+}
+
+/* Decimal option value from min to max, 0 when it isn't one */
+static u32_t
+option_value(const char *value, u32_t min, u32_t max)
+{
+  u32_t n = 0;
+
+  if (*value == 0) {
+    return 0;
+  }
+  for (; *value != 0; value++) {
+    if ((*value < '0') || (*value > '9') || (n > (0xFFFFFFFFUL - 9) / 10)) {
+      return 0;
+    }
+    n = n * 10 + (u32_t)(*value - '0');
+  }
+  return ((n >= min) && (n <= max)) ? n : 0;
+}
+
+/* Name and value of an option at len in an OACK of size bytes, the caller sized it */
+static void
+append_option(char *buf, u16_t size, u16_t *len, const char *name, u32_t value)
+{
+  u16_t name_len = (u16_t)(strlen(name) + 1);
+
+  MEMCPY(&buf[*len], name, name_len);
+  *len = (u16_t)(*len + name_len);
+  lwip_itoa(&buf[*len], (size_t)(size - *len), (int)value);
+  *len = (u16_t)(*len + strlen(&buf[*len]) + 1);
+}
+
+/* Take the options of a write request starting at offset, answering them with an OACK.
+   Returns 0 when the request had none this server knows, it then gets an ACK */
+static u8_t
+take_options(struct pbuf *p, u16_t offset)
+{
+  char options[TFTP_MAX_OPTIONS_LEN + 1];
+  char buf[2 + sizeof("blksize") + 6 + sizeof("windowsize") + 6 + sizeof("tsize") + 11];
+  const u16_t size = sizeof(buf);
+  const char *value;
+  u16_t len = 0;
+  u16_t options_len;
+  u32_t n;
+  struct pbuf *reply;
+
+  if (offset >= p->tot_len) {
+    return 0;
+  }
+  options_len = pbuf_copy_partial(p, options, LWIP_MIN(p->tot_len - offset, TFTP_MAX_OPTIONS_LEN), offset);
+  options[options_len] = 0;
+
+  buf[len++] = 0;
+  buf[len++] = TFTP_OACK;
+
+  value = find_option(options, options_len, "blksize");
+  if ((value != NULL) && ((n = option_value(value, 8, 65464)) != 0)) {
+    tftp_state.blksize = (u16_t)LWIP_MIN(n, TFTP_MAX_BLKSIZE);
+    append_option(buf, size, &len, "blksize", tftp_state.blksize);
+  }
+  value = find_option(options, options_len, "windowsize");
+  if ((value != NULL) && ((n = option_value(value, 1, 65535)) != 0)) {
+    tftp_state.windowsize = (u16_t)LWIP_MIN(n, TFTP_MAX_WINDOWSIZE);
+    append_option(buf, size, &len, "windowsize", tftp_state.windowsize);
+  }
+  /* The size the client announces goes back as it is (RFC 2349), the write
+     callback finds out what fits */
+  value = find_option(options, options_len, "tsize");
+  if ((value != NULL) && ((n = option_value(value, 1, 0x7FFFFFFFUL)) != 0)) {
+    append_option(buf, size, &len, "tsize", n);
+  }
+
+  if (len == 2) {
+    return 0;
+  }
+
+  reply = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+  if (reply == NULL) {
+    /* Lost like an ACK send_ack() can't allocate */
+    return 1;
+  }
+  MEMCPY(reply->payload, buf, len);
+  udp_sendto(tftp_state.upcb, reply, &tftp_state.addr, tftp_state.port);
+  pbuf_free(reply);
+  return 1;
+}
+#endif /* TFTP_OPTIONS */
+
 static void
 resend_data(void)
 {
@@ -255,6 +382,12 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
 
       tftp_state.handle = tftp_state.ctx->open(filename, mode, opcode == PP_HTONS(TFTP_WRQ));
       tftp_state.blknum = 1;
+#if TFTP_OPTIONS
+      tftp_state.blksize = TFTP_MAX_PAYLOAD_SIZE;
+      tftp_state.windowsize = 1;
+      tftp_state.window_blocks = 0;
+      tftp_state.unexpected = 0;
+#endif
 
       if (!tftp_state.handle) {
         send_error(addr, port, TFTP_ERROR_FILE_NOT_FOUND, "Unable to open requested file.");
@@ -270,7 +403,12 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
 
       if (opcode == PP_HTONS(TFTP_WRQ)) {
         tftp_state.mode_write = 1;
-        send_ack(0);
+#if TFTP_OPTIONS
+        if (!take_options(p, mode_end_offset + 1))
+#endif
+        {
+          send_ack(0);
+        }
       } else {
         tftp_state.mode_write = 0;
         send_data();
@@ -294,6 +432,44 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       }
 
       blknum = lwip_ntohs(sbuf[1]);
+#if TFTP_OPTIONS
+      if (blknum == tftp_state.blknum) {
+        u8_t last;
+
+        pbuf_remove_header(p, TFTP_HEADER_LENGTH);
+        last = (p->tot_len < tftp_state.blksize);
+
+        ret = tftp_state.ctx->write(tftp_state.handle, p);
+        if (ret < 0) {
+          send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "error writing file");
+          close_handle();
+          break;
+        }
+
+        /* One ACK per window, and for the last block */
+        tftp_state.unexpected = 0;
+        tftp_state.window_blocks++;
+        if (last || (tftp_state.window_blocks >= tftp_state.windowsize)) {
+          tftp_state.window_blocks = 0;
+          if (!last && (tftp_state.ctx->ack_ready != NULL) && !tftp_state.ctx->ack_ready(tftp_state.handle)) {
+            tftp_state.ack_held = 1;
+          } else {
+            send_ack(blknum);
+          }
+        }
+
+        if (last) {
+          close_handle();
+        } else {
+          tftp_state.blknum++;
+        }
+      } else if (!tftp_state.ack_held && ((tftp_state.unexpected++ % tftp_state.windowsize) == 0)) {
+        /* A block was lost, or the client sent a window again: ACK the last block in
+           order, once a window, and the client goes on after it (RFC 7440) */
+        tftp_state.window_blocks = 0;
+        send_ack((u16_t)(tftp_state.blknum - 1));
+      }
+#else
       if (blknum == tftp_state.blknum) {
         pbuf_remove_header(p, TFTP_HEADER_LENGTH);
 
@@ -316,6 +492,7 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       } else {
         send_error(addr, port, TFTP_ERROR_UNKNOWN_TRFR_ID, "Wrong block number");
       }
+#endif /* TFTP_OPTIONS */
       break;
     }
 
@@ -421,6 +598,23 @@ tftp_init(const struct tftp_context *ctx)
   return ERR_OK;
 }
 
+#if TFTP_OPTIONS
+/** @ingroup tftp
+ * Send the ACK tftp_context::ack_ready() held back, the client then sends the next
+ * window
+ */
+void
+tftp_resume(void)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+
+  if (tftp_state.ack_held && (tftp_state.handle != NULL)) {
+    tftp_state.ack_held = 0;
+    send_ack((u16_t)(tftp_state.blknum - 1));
+  }
+}
+#endif
+
 /** @ingroup tftp
  * Deinitialize ("turn off") TFTP server.
  */
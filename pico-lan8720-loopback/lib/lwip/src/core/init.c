@@ -157,6 +157,36 @@ PACK_STRUCT_END
 #if (LWIP_TCP && (TCP_SND_QUEUELEN < 2))
 #error "TCP_SND_QUEUELEN must be at least 2 for no-copy TCP writes to work"
 #endif
+#if (IP_REASSEMBLY && IP_REASS_CONTIGUOUS && !LWIP_SUPPORT_CUSTOM_PBUF)
+#error "IP_REASS_CONTIGUOUS needs LWIP_SUPPORT_CUSTOM_PBUF, so, you have to enable it in your lwipopts.h"
+#endif
+#if (IP_REASSEMBLY && IP_REASS_CONTIGUOUS && ((IP_REASS_CONTIGUOUS_SIZE & 7) || (IP_REASS_CONTIGUOUS_SIZE > (0xFFFF - IP_HLEN)) || (IP_REASS_CONTIGUOUS_BUFS < 1)))
+#error "IP_REASS_CONTIGUOUS_SIZE must be a multiple of 8 below 64 KB and IP_REASS_CONTIGUOUS_BUFS at least 1, so, you have to change them in your lwipopts.h"
+#endif
+#if (LWIP_ARP && ETHARP_TABLE_HASH && ((ETHARP_HASH_SIZE < 1) || (ETHARP_HASH_SIZE & (ETHARP_HASH_SIZE - 1))))
+#error "ETHARP_HASH_SIZE must be a power of 2, so, you have to change it in your lwipopts.h"
+#endif
+#if (LWIP_IPV6 && LWIP_ND6_CACHE_HASH && ((LWIP_ND6_HASH_SIZE < 1) || (LWIP_ND6_HASH_SIZE & (LWIP_ND6_HASH_SIZE - 1))))
+#error "LWIP_ND6_HASH_SIZE must be a power of 2, so, you have to change it in your lwipopts.h"
+#endif
+#if (LWIP_IPV6 && (LWIP_ND6_NUM_NEIGHBORS > 127))
+#error "LWIP_ND6_NUM_NEIGHBORS must be 127 at most, so, you have to change it in your lwipopts.h"
+#endif
+#if (LWIP_UDP && LWIP_UDP_PCB_HASH && ((UDP_PCB_HASH_SIZE < 1) || (UDP_PCB_HASH_SIZE & (UDP_PCB_HASH_SIZE - 1))))
+#error "UDP_PCB_HASH_SIZE must be a power of 2, so, you have to change it in your lwipopts.h"
+#endif
+#if (LWIP_TCP && LWIP_TCP_PCB_HASH && ((TCP_PCB_HASH_SIZE < 1) || (TCP_PCB_HASH_SIZE & (TCP_PCB_HASH_SIZE - 1))))
+#error "TCP_PCB_HASH_SIZE must be a power of 2, so, you have to change it in your lwipopts.h"
+#endif
+#if (LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE && ((TCP_RCV_AUTOTUNE_INIT_WND > TCP_WND) || (TCP_RCV_AUTOTUNE_INIT_WND > 0xffff)))
+#error "TCP_RCV_AUTOTUNE_INIT_WND must fit in an u16_t and not be larger than TCP_WND, so, you have to change it in your lwipopts.h"
+#endif
+#if (LWIP_TCP && LWIP_TCP_CC && ((TCP_CC_LEDBAT_TARGET_MS < 1) || (TCP_CC_LEDBAT_TARGET_MS > 1000)))
+#error "TCP_CC_LEDBAT_TARGET_MS must be between 1 and 1000, so, you have to change it in your lwipopts.h"
+#endif
+#if (LWIP_TCP && LWIP_TCP_MEM_SHARE && ((TCP_MEM_SHARE_MIN < 1) || (TCP_MEM_SHARE_MIN > TCP_MEM_SHARE_RX_PBUFS) || (TCP_MEM_SHARE_MIN > TCP_MEM_SHARE_TX_PBUFS)))
+#error "TCP_MEM_SHARE_MIN must be between 1 and TCP_MEM_SHARE_RX_PBUFS and TCP_MEM_SHARE_TX_PBUFS, so, you have to change it in your lwipopts.h"
+#endif
 #if (LWIP_TCP && ((TCP_MAXRTX > 12) || (TCP_SYNMAXRTX > 12)))
 #error "If you want to use TCP, TCP_MAXRTX and TCP_SYNMAXRTX must less or equal to 12 (due to tcp_backoff table), so, you have to reduce them in your lwipopts.h"
 #endif
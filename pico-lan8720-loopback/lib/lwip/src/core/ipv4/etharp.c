@@ -100,10 +100,23 @@ struct etharp_entry {
   struct eth_addr ethaddr;
   u16_t ctime;
   u8_t state;
+#if ETHARP_TABLE_HASH
+  /** next entry in the same bucket of etharp_hash_heads, as index + 1, 0 ends it */
+  netif_addr_idx_t hash_next;
+#endif /* ETHARP_TABLE_HASH */
+#if ETHARP_REFRESH_AHEAD
+  /** a packet was sent to this entry since it was last updated */
+  u8_t used;
+#endif /* ETHARP_REFRESH_AHEAD */
 };
 
 static struct etharp_entry arp_table[ARP_TABLE_SIZE];
 
+#if ETHARP_TABLE_HASH
+/** first entry of each bucket, as index + 1, 0 for an empty bucket */
+static netif_addr_idx_t etharp_hash_heads[ETHARP_HASH_SIZE];
+#endif /* ETHARP_TABLE_HASH */
+
 #if !LWIP_NETIF_HWADDRHINT
 static netif_addr_idx_t etharp_cached_entry;
 #endif /* !LWIP_NETIF_HWADDRHINT */
@@ -137,6 +150,75 @@ static err_t etharp_raw(struct netif *netif,
                         const struct eth_addr *hwdst_addr, const ip4_addr_t *ipdst_addr,
                         const u16_t opcode);
 
+#if ETHARP_TABLE_HASH
+/** The bucket of an IP address: the bytes folded onto each other, so the host
+ * part of addresses on one subnet spreads over all buckets. */
+static u32_t
+etharp_hash(const ip4_addr_t *ipaddr)
+{
+  u32_t h = ip4_addr_get_u32(ipaddr);
+
+  h ^= h >> 16;
+  h ^= h >> 8;
+  return h & (ETHARP_HASH_SIZE - 1);
+}
+
+/** Link entry i into the bucket of its IP address */
+static void
+etharp_hash_add(int i)
+{
+  u32_t h = etharp_hash(&arp_table[i].ipaddr);
+
+  arp_table[i].hash_next = etharp_hash_heads[h];
+  etharp_hash_heads[h] = (netif_addr_idx_t)(i + 1);
+}
+
+/** Unlink entry i from the bucket of its IP address */
+static void
+etharp_hash_remove(int i)
+{
+  netif_addr_idx_t *link = &etharp_hash_heads[etharp_hash(&arp_table[i].ipaddr)];
+
+  while (*link != 0) {
+    if (*link == i + 1) {
+      *link = arp_table[i].hash_next;
+      return;
+    }
+    link = &arp_table[*link - 1].hash_next;
+  }
+}
+
+/**
+ * Search the bucket of an IP address for its entry.
+ *
+ * @param ipaddr IP address to find
+ * @param netif netif of the entry, NULL for any (with ETHARP_TABLE_MATCH_NETIF)
+ * @param state lowest state accepted, ETHARP_STATE_PENDING for any entry in use
+ *
+ * @return the index of the entry, -1 if there is none
+ */
+static s16_t
+etharp_hash_find(const ip4_addr_t *ipaddr, struct netif *netif, u8_t state)
+{
+  netif_addr_idx_t next = etharp_hash_heads[etharp_hash(ipaddr)];
+
+  LWIP_UNUSED_ARG(netif);
+
+  while (next != 0) {
+    struct etharp_entry *entry = &arp_table[next - 1];
+    if ((entry->state >= state) &&
+#if ETHARP_TABLE_MATCH_NETIF
+        ((netif == NULL) || (netif == entry->netif)) &&
+#endif /* ETHARP_TABLE_MATCH_NETIF */
+        ip4_addr_cmp(ipaddr, &entry->ipaddr)) {
+      return (s16_t)(next - 1);
+    }
+    next = entry->hash_next;
+  }
+  return -1;
+}
+#endif /* ETHARP_TABLE_HASH */
+
 #if ARP_QUEUEING
 /**
  * Free a complete queue of etharp entries
@@ -176,6 +258,11 @@ etharp_free_entry(int i)
     free_etharp_q(arp_table[i].q);
     arp_table[i].q = NULL;
   }
+#if ETHARP_TABLE_HASH
+  if (arp_table[i].state != ETHARP_STATE_EMPTY) {
+    etharp_hash_remove(i);
+  }
+#endif /* ETHARP_TABLE_HASH */
   /* recycle entry for re-use */
   arp_table[i].state = ETHARP_STATE_EMPTY;
 #ifdef LWIP_DEBUG
@@ -187,6 +274,26 @@ etharp_free_entry(int i)
 #endif /* LWIP_DEBUG */
 }
 
+/** Re-request a stable entry that is about to expire: unicast to its known
+ * address first, broadcast in the last seconds. The entry is marked so no
+ * further request goes out in the next 2 seconds.
+ */
+static void
+etharp_rerequest(netif_addr_idx_t i)
+{
+  if (arp_table[i].ctime >= ARP_AGE_REREQUEST_USED_BROADCAST) {
+    /* issue a standard request using broadcast */
+    if (etharp_request(arp_table[i].netif, &arp_table[i].ipaddr) == ERR_OK) {
+      arp_table[i].state = ETHARP_STATE_STABLE_REREQUESTING_1;
+    }
+  } else if (arp_table[i].ctime >= ARP_AGE_REREQUEST_USED_UNICAST) {
+    /* issue a unicast request (for 15 seconds) to prevent unnecessary broadcast */
+    if (etharp_request_dst(arp_table[i].netif, &arp_table[i].ipaddr, &arp_table[i].ethaddr) == ERR_OK) {
+      arp_table[i].state = ETHARP_STATE_STABLE_REREQUESTING_1;
+    }
+  }
+}
+
 /**
  * Clears expired entries in the ARP table.
  *
@@ -226,6 +333,13 @@ etharp_tmr(void)
       } else if (arp_table[i].state == ETHARP_STATE_PENDING) {
         /* still pending, resend an ARP query */
         etharp_request(arp_table[i].netif, &arp_table[i].ipaddr);
+#if ETHARP_REFRESH_AHEAD
+      } else if ((arp_table[i].state == ETHARP_STATE_STABLE) && arp_table[i].used &&
+                 (arp_table[i].ctime >= ARP_AGE_REREQUEST_USED_UNICAST)) {
+        /* used since the last update: re-request it now, the next packet
+           might come only after the entry expired and have to wait */
+        etharp_rerequest((netif_addr_idx_t)i);
+#endif /* ETHARP_REFRESH_AHEAD */
       }
     }
   }
@@ -265,6 +379,21 @@ etharp_find_entry(const ip4_addr_t *ipaddr, u8_t flags, struct netif *netif)
 
   LWIP_UNUSED_ARG(netif);
 
+#if ETHARP_TABLE_HASH
+  /* an existing entry is in the bucket of its address, the sweep below is only
+     needed to pick one for a new entry */
+  if (ipaddr != NULL) {
+    i = etharp_hash_find(ipaddr, netif, ETHARP_STATE_PENDING);
+    if (i >= 0) {
+      LWIP_DEBUGF(ETHARP_DEBUG | LWIP_DBG_TRACE, ("etharp_find_entry: found matching entry %d\n", (int)i));
+      return i;
+    }
+    if ((flags & ETHARP_FLAG_FIND_ONLY) != 0) {
+      return (s16_t)ERR_MEM;
+    }
+  }
+#endif /* ETHARP_TABLE_HASH */
+
   /**
    * a) do a search through the cache, remember candidates
    * b) select candidate entry
@@ -392,8 +521,14 @@ etharp_find_entry(const ip4_addr_t *ipaddr, u8_t flags, struct netif *netif)
   if (ipaddr != NULL) {
     /* set IP address */
     ip4_addr_copy(arp_table[i].ipaddr, *ipaddr);
+#if ETHARP_TABLE_HASH
+    etharp_hash_add(i);
+#endif /* ETHARP_TABLE_HASH */
   }
   arp_table[i].ctime = 0;
+#if ETHARP_REFRESH_AHEAD
+  arp_table[i].used = 0;
+#endif /* ETHARP_REFRESH_AHEAD */
 #if ETHARP_TABLE_MATCH_NETIF
   arp_table[i].netif = netif;
 #endif /* ETHARP_TABLE_MATCH_NETIF */
@@ -465,6 +600,9 @@ etharp_update_arp_entry(struct netif *netif, const ip4_addr_t *ipaddr, struct et
   SMEMCPY(&arp_table[i].ethaddr, ethaddr, ETH_HWADDR_LEN);
   /* reset time stamp */
   arp_table[i].ctime = 0;
+#if ETHARP_REFRESH_AHEAD
+  arp_table[i].used = 0;
+#endif /* ETHARP_REFRESH_AHEAD */
   /* this is where we will send out queued packets! */
 #if ARP_QUEUEING
   while (arp_table[i].q != NULL) {
@@ -625,6 +763,24 @@ etharp_get_entry(size_t i, ip4_addr_t **ipaddr, struct netif **netif, struct eth
   }
 }
 
+/**
+ * Adds or updates the entry of a host that sent an ARP request for our
+ * address, as etharp_input() does for one, and sends the packets queued on it.
+ * For a netif driver that answered the request itself instead of passing it on.
+ *
+ * @param netif The lwIP network interface the request arrived on.
+ * @param ipaddr The sender's IP address.
+ * @param ethaddr The sender's MAC address.
+ * @return etharp_update_arp_entry()'s result
+ */
+err_t
+etharp_update_entry(struct netif *netif, const ip4_addr_t *ipaddr, struct eth_addr *ethaddr)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+
+  return etharp_update_arp_entry(netif, ipaddr, ethaddr, ETHARP_FLAG_TRY_HARD);
+}
+
 /**
  * Responds to ARP requests to us. Upon ARP replies to us, add entry to cache
  * send out queued IP packets. Updates cache with snooped address pairs.
@@ -753,18 +909,11 @@ etharp_output_to_arp_index(struct netif *netif, struct pbuf *q, netif_addr_idx_t
      but only if its state is ETHARP_STATE_STABLE to prevent flooding the
      network with ARP requests if this address is used frequently. */
   if (arp_table[arp_idx].state == ETHARP_STATE_STABLE) {
-    if (arp_table[arp_idx].ctime >= ARP_AGE_REREQUEST_USED_BROADCAST) {
-      /* issue a standard request using broadcast */
-      if (etharp_request(netif, &arp_table[arp_idx].ipaddr) == ERR_OK) {
-        arp_table[arp_idx].state = ETHARP_STATE_STABLE_REREQUESTING_1;
-      }
-    } else if (arp_table[arp_idx].ctime >= ARP_AGE_REREQUEST_USED_UNICAST) {
-      /* issue a unicast request (for 15 seconds) to prevent unnecessary broadcast */
-      if (etharp_request_dst(netif, &arp_table[arp_idx].ipaddr, &arp_table[arp_idx].ethaddr) == ERR_OK) {
-        arp_table[arp_idx].state = ETHARP_STATE_STABLE_REREQUESTING_1;
-      }
-    }
+    etharp_rerequest(arp_idx);
   }
+#if ETHARP_REFRESH_AHEAD
+  arp_table[arp_idx].used = 1;
+#endif /* ETHARP_REFRESH_AHEAD */
 
   return ethernet_output(netif, q, (struct eth_addr *)(netif->hwaddr), &arp_table[arp_idx].ethaddr, ETHTYPE_IP);
 }
@@ -874,6 +1023,17 @@ etharp_output(struct netif *netif, struct pbuf *q, const ip4_addr_t *ipaddr)
 
     /* find stable entry: do this here since this is a critical path for
        throughput and etharp_find_entry() is kind of slow */
+#if ETHARP_TABLE_HASH
+    {
+      s16_t found = etharp_hash_find(dst_addr, netif, ETHARP_STATE_STABLE);
+      if (found >= 0) {
+        /* found an existing, stable entry */
+        i = (netif_addr_idx_t)found;
+        ETHARP_SET_ADDRHINT(netif, i);
+        return etharp_output_to_arp_index(netif, q, i);
+      }
+    }
+#else /* ETHARP_TABLE_HASH */
     for (i = 0; i < ARP_TABLE_SIZE; i++) {
       if ((arp_table[i].state >= ETHARP_STATE_STABLE) &&
 #if ETHARP_TABLE_MATCH_NETIF
@@ -885,6 +1045,7 @@ etharp_output(struct netif *netif, struct pbuf *q, const ip4_addr_t *ipaddr)
         return etharp_output_to_arp_index(netif, q, i);
       }
     }
+#endif /* ETHARP_TABLE_HASH */
     /* no stable entry found, use the (slower) query function:
        queue on destination Ethernet address belonging to ipaddr */
     return etharp_query(netif, dst_addr, q);
@@ -48,10 +48,350 @@
 #include "lwip/netif.h"
 #include "lwip/stats.h"
 #include "lwip/icmp.h"
+#include "lwip/sys.h"
 
 #include <string.h>
 
 #if IP_REASSEMBLY
+#if IP_REASS_CONTIGUOUS
+/**
+ * IP_REASS_CONTIGUOUS: every datagram being reassembled has a buffer of its own, the
+ * IP header (of the first fragment that came in, then of the one at offset 0) and
+ * IP_REASS_CONTIGUOUS_SIZE bytes after it. Fragments are copied in at their offset,
+ * a bitmap of 8 byte blocks counts what has arrived (an overlap or a duplicate only
+ * counts its new blocks) and the datagram is complete once the last fragment and all
+ * the blocks before its end are in. The datagram is then passed up in place, as a
+ * custom pbuf over the buffer, and the buffer is free again when that pbuf is.
+ * IP header options are not supported, as with the pbuf chains.
+ */
+
+#define IP_REASS_BLOCKS         (IP_REASS_CONTIGUOUS_SIZE / 8)
+
+#define IP_REASS_BUF_FREE       0
+#define IP_REASS_BUF_FILLING    1
+#define IP_REASS_BUF_PASSED_UP  2
+
+struct ip_reass_buf {
+  /* first, so that the pbuf passed up is the buffer */
+  struct pbuf_custom pc;
+  u32_t last_ms;        /* sys_now() of the last fragment */
+  u16_t datagram_len;   /* bytes after the IP header, once the last fragment is in */
+  u16_t blocks;         /* 8 byte blocks received */
+  u8_t state;
+  u8_t flags;
+  u8_t timer;           /* IP_TMR_INTERVALs left */
+  u32_t map[(IP_REASS_BLOCKS + 31) / 32];
+  u32_t data[(IP_HLEN + IP_REASS_CONTIGUOUS_SIZE + 3) / 4];
+};
+
+static struct ip_reass_buf ip_reass_bufs[IP_REASS_CONTIGUOUS_BUFS];
+
+/**
+ * Datagrams given up while their fragments are still coming in: a fragment that had no
+ * buffer, a datagram dropped early or too large. The rest of their fragments are
+ * dropped rather than take a buffer for a datagram that can't complete.
+ */
+struct ip_reass_doomed {
+  ip4_addr_p_t src;
+  ip4_addr_p_t dest;
+  u16_t id;
+};
+
+#define IP_REASS_DOOMED         (2 * IP_REASS_CONTIGUOUS_BUFS)
+
+static struct ip_reass_doomed ip_reass_doomed[IP_REASS_DOOMED];
+static u8_t ip_reass_doomed_next;
+
+#define IP_REASS_FLAG_LASTFRAG 0x01
+
+#define IP_ADDRESSES_AND_ID_MATCH(iphdrA, iphdrB)  \
+  (ip4_addr_cmp(&(iphdrA)->src, &(iphdrB)->src) && \
+   ip4_addr_cmp(&(iphdrA)->dest, &(iphdrB)->dest) && \
+   IPH_ID(iphdrA) == IPH_ID(iphdrB)) ? 1 : 0
+
+/** Remembers a datagram given up, in place of the oldest */
+static void
+ip_reass_doom(struct ip_hdr *iphdr)
+{
+  struct ip_reass_doomed *d = &ip_reass_doomed[ip_reass_doomed_next];
+
+  ip_reass_doomed_next = (u8_t)((ip_reass_doomed_next + 1) % IP_REASS_DOOMED);
+  d->src = iphdr->src;
+  d->dest = iphdr->dest;
+  d->id = IPH_ID(iphdr);
+}
+
+static int
+ip_reass_is_doomed(struct ip_hdr *fraghdr)
+{
+  int i;
+
+  for (i = 0; i < IP_REASS_DOOMED; i++) {
+    struct ip_reass_doomed *d = &ip_reass_doomed[i];
+    if ((d->id == IPH_ID(fraghdr)) && ip4_addr_cmp(&d->src, &fraghdr->src) &&
+        ip4_addr_cmp(&d->dest, &fraghdr->dest)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** The pbuf of a complete datagram was freed */
+static void
+ip_reass_buf_pbuf_free(struct pbuf *p)
+{
+  struct ip_reass_buf *buf = (struct ip_reass_buf *)p;
+  SYS_ARCH_DECL_PROTECT(old_level);
+
+  /* the application may free it from another thread */
+  SYS_ARCH_PROTECT(old_level);
+  buf->state = IP_REASS_BUF_FREE;
+  SYS_ARCH_UNPROTECT(old_level);
+}
+
+/**
+ * Gives up a datagram being reassembled, with an ICMP time exceeded when its first
+ * fragment was received and it timed out.
+ */
+static void
+ip_reass_buf_drop(struct ip_reass_buf *buf, int timed_out)
+{
+  struct ip_hdr *iphdr = (struct ip_hdr *)buf->data;
+
+  MIB2_STATS_INC(mib2.ipreasmfails);
+#if LWIP_ICMP
+  if (timed_out && (buf->map[0] & 1)) {
+    /* the header and the first 8 bytes of the datagram, as ICMP quotes them */
+    struct pbuf *p = pbuf_alloc(PBUF_IP, IP_HLEN + 8, PBUF_RAM);
+    if (p != NULL) {
+      SMEMCPY(p->payload, iphdr, IP_HLEN + 8);
+      icmp_time_exceeded(p, ICMP_TE_FRAG);
+      pbuf_free(p);
+    }
+  }
+#else /* LWIP_ICMP */
+  LWIP_UNUSED_ARG(timed_out);
+  LWIP_UNUSED_ARG(iphdr);
+#endif /* LWIP_ICMP */
+  buf->state = IP_REASS_BUF_FREE;
+}
+
+/**
+ * Reassembly timer base function
+ * for both NO_SYS == 0 and 1 (!).
+ *
+ * Should be called every 1000 msec (defined by IP_TMR_INTERVAL).
+ */
+void
+ip_reass_tmr(void)
+{
+  int i;
+
+  for (i = 0; i < IP_REASS_CONTIGUOUS_BUFS; i++) {
+    struct ip_reass_buf *buf = &ip_reass_bufs[i];
+    if (buf->state == IP_REASS_BUF_FILLING) {
+      if (buf->timer > 0) {
+        buf->timer--;
+      } else {
+        LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_reass_tmr: timer timed out\n"));
+        ip_reass_buf_drop(buf, 1);
+      }
+    }
+  }
+}
+
+/**
+ * The buffer of the datagram a fragment belongs to, a free one for a new datagram or
+ * NULL. With none free, the datagram that has waited longest for a fragment is given
+ * up if that's IP_REASS_EARLY_DROP_MS or more.
+ */
+static struct ip_reass_buf *
+ip_reass_buf_get(struct ip_hdr *fraghdr, u32_t now, int may_alloc)
+{
+  struct ip_reass_buf *free_buf = NULL, *idlest = NULL;
+  int i;
+
+  for (i = 0; i < IP_REASS_CONTIGUOUS_BUFS; i++) {
+    struct ip_reass_buf *buf = &ip_reass_bufs[i];
+    if (buf->state == IP_REASS_BUF_FILLING) {
+      if (IP_ADDRESSES_AND_ID_MATCH((struct ip_hdr *)buf->data, fraghdr)) {
+        IPFRAG_STATS_INC(ip_frag.cachehit);
+        return buf;
+      }
+      if ((idlest == NULL) || ((u32_t)(now - buf->last_ms) > (u32_t)(now - idlest->last_ms))) {
+        idlest = buf;
+      }
+    } else if ((buf->state == IP_REASS_BUF_FREE) && (free_buf == NULL)) {
+      free_buf = buf;
+    }
+  }
+
+  if (!may_alloc) {
+    return NULL;
+  }
+  if ((free_buf == NULL) && (idlest != NULL) &&
+      ((u32_t)(now - idlest->last_ms) >= IP_REASS_EARLY_DROP_MS)) {
+    LWIP_DEBUGF(IP_REASS_DEBUG, ("ip4_reass: early drop of an idle datagram\n"));
+    ip_reass_doom((struct ip_hdr *)idlest->data);
+    ip_reass_buf_drop(idlest, 0);
+    free_buf = idlest;
+  }
+  if (free_buf == NULL) {
+    ip_reass_doom(fraghdr);
+    IPFRAG_STATS_INC(ip_frag.memerr);
+    LWIP_DEBUGF(IP_REASS_DEBUG, ("ip4_reass: no free buffer\n"));
+    return NULL;
+  }
+
+  free_buf->state = IP_REASS_BUF_FILLING;
+  free_buf->flags = 0;
+  free_buf->datagram_len = 0;
+  free_buf->blocks = 0;
+  free_buf->timer = IP_REASS_MAXAGE;
+  memset(free_buf->map, 0, sizeof(free_buf->map));
+  /* the header for the matching, replaced by the first fragment's */
+  SMEMCPY(free_buf->data, fraghdr, IP_HLEN);
+  return free_buf;
+}
+
+/**
+ * Marks the blocks [first, last) received, a word of the bitmap at a time. Only an
+ * overlap has its new blocks counted one by one.
+ */
+static void
+ip_reass_buf_mark(struct ip_reass_buf *buf, u16_t first, u16_t last)
+{
+  while (first < last) {
+    u16_t bits = (u16_t)LWIP_MIN(32 - (first & 31), last - first);
+    u32_t mask = ((bits == 32) ? 0xFFFFFFFFUL : ((1UL << bits) - 1)) << (first & 31);
+    u32_t *word = &buf->map[first / 32];
+    u32_t fresh = mask & ~*word;
+
+    if (fresh == mask) {
+      buf->blocks = (u16_t)(buf->blocks + bits);
+    } else {
+      for (; fresh != 0; fresh &= fresh - 1) {
+        buf->blocks++;
+      }
+    }
+    *word |= mask;
+    first = (u16_t)(first + bits);
+  }
+}
+
+/**
+ * Reassembles incoming IP fragments into an IP datagram.
+ *
+ * @param p points to a pbuf chain of the fragment
+ * @return NULL if reassembly is incomplete, pbuf pointing to
+ *         IP header if reassembly is complete
+ */
+struct pbuf *
+ip4_reass(struct pbuf *p)
+{
+  struct ip_hdr *fraghdr;
+  struct ip_reass_buf *buf;
+  u16_t offset, len;
+  u32_t end, now;
+  int is_last;
+
+  IPFRAG_STATS_INC(ip_frag.recv);
+  MIB2_STATS_INC(mib2.ipreasmreqds);
+
+  fraghdr = (struct ip_hdr *)p->payload;
+
+  if (IPH_HL_BYTES(fraghdr) != IP_HLEN) {
+    LWIP_DEBUGF(IP_REASS_DEBUG, ("ip4_reass: IP options currently not supported!\n"));
+    IPFRAG_STATS_INC(ip_frag.err);
+    goto nullreturn;
+  }
+
+  offset = IPH_OFFSET_BYTES(fraghdr);
+  len = lwip_ntohs(IPH_LEN(fraghdr));
+  if ((len < IP_HLEN) || (p->tot_len < len)) {
+    /* invalid datagram */
+    goto nullreturn;
+  }
+  len = (u16_t)(len - IP_HLEN);
+  end = (u32_t)offset + len;
+  is_last = (IPH_OFFSET(fraghdr) & PP_NTOHS(IP_MF)) == 0;
+
+  if ((len == 0) || (!is_last && (len & 7))) {
+    /* only the last fragment may end off an 8 byte block */
+    IPFRAG_STATS_INC(ip_frag.err);
+    goto nullreturn;
+  }
+
+  now = sys_now();
+
+  if (end > IP_REASS_CONTIGUOUS_SIZE) {
+    /* won't fit, give it up now rather than when it times out */
+    buf = ip_reass_buf_get(fraghdr, now, 0);
+    if (buf != NULL) {
+      ip_reass_buf_drop(buf, 0);
+    }
+    ip_reass_doom(fraghdr);
+    LWIP_DEBUGF(IP_REASS_DEBUG, ("ip4_reass: datagram larger than IP_REASS_CONTIGUOUS_SIZE\n"));
+    IPFRAG_STATS_INC(ip_frag.lenerr);
+    goto nullreturn;
+  }
+
+  buf = ip_reass_buf_get(fraghdr, now, !ip_reass_is_doomed(fraghdr));
+  if (buf == NULL) {
+    goto nullreturn;
+  }
+
+  if (is_last) {
+    if ((buf->flags & IP_REASS_FLAG_LASTFRAG) && (buf->datagram_len != end)) {
+      /* two different ends */
+      ip_reass_doom((struct ip_hdr *)buf->data);
+      ip_reass_buf_drop(buf, 0);
+      IPFRAG_STATS_INC(ip_frag.err);
+      goto nullreturn;
+    }
+    buf->datagram_len = (u16_t)end;
+    buf->flags |= IP_REASS_FLAG_LASTFRAG;
+  }
+  if (offset == 0) {
+    SMEMCPY(buf->data, fraghdr, IP_HLEN);
+  }
+
+  pbuf_copy_partial(p, (u8_t *)buf->data + IP_HLEN + offset, len, IP_HLEN);
+  pbuf_free(p);
+
+  ip_reass_buf_mark(buf, (u16_t)(offset / 8), (u16_t)((end + 7) / 8));
+  buf->last_ms = now;
+
+  if ((buf->flags & IP_REASS_FLAG_LASTFRAG) && (buf->blocks == (buf->datagram_len + 7) / 8)) {
+    u16_t datagram_len = (u16_t)(buf->datagram_len + IP_HLEN);
+
+    fraghdr = (struct ip_hdr *)buf->data;
+    IPH_LEN_SET(fraghdr, lwip_htons(datagram_len));
+    IPH_OFFSET_SET(fraghdr, 0);
+    IPH_CHKSUM_SET(fraghdr, 0);
+#if CHECKSUM_GEN_IP
+    IF__NETIF_CHECKSUM_ENABLED(ip_current_input_netif(), NETIF_CHECKSUM_GEN_IP) {
+      IPH_CHKSUM_SET(fraghdr, inet_chksum(fraghdr, IP_HLEN));
+    }
+#endif /* CHECKSUM_GEN_IP */
+
+    buf->state = IP_REASS_BUF_PASSED_UP;
+    buf->pc.custom_free_function = ip_reass_buf_pbuf_free;
+    MIB2_STATS_INC(mib2.ipreasmoks);
+
+    return pbuf_alloced_custom(PBUF_RAW, datagram_len, PBUF_REF, &buf->pc, buf->data, sizeof(buf->data));
+  }
+  /* the datagram is not (yet?) reassembled completely */
+  return NULL;
+
+nullreturn:
+  LWIP_DEBUGF(IP_REASS_DEBUG, ("ip4_reass: nullreturn\n"));
+  IPFRAG_STATS_INC(ip_frag.drop);
+  pbuf_free(p);
+  return NULL;
+}
+
+#else /* IP_REASS_CONTIGUOUS */
 /**
  * The IP reassembly code currently has the following limitations:
  * - IP header options are not supported
@@ -690,6 +1030,7 @@ nullreturn:
   pbuf_free(p);
   return NULL;
 }
+#endif /* IP_REASS_CONTIGUOUS */
 #endif /* IP_REASSEMBLY */
 
 #if IP_FRAG
@@ -87,6 +87,12 @@ u32_t retrans_timer = LWIP_ND6_RETRANS_TIMER; /* @todo implement this value in t
 static u8_t nd6_cached_neighbor_index;
 static netif_addr_idx_t nd6_cached_destination_index;
 
+#if LWIP_ND6_CACHE_HASH
+/* first entry of each bucket, as index + 1, 0 for an empty bucket */
+static u8_t nd6_neighbor_hash_heads[LWIP_ND6_HASH_SIZE];
+static netif_addr_idx_t nd6_destination_hash_heads[LWIP_ND6_HASH_SIZE];
+#endif /* LWIP_ND6_CACHE_HASH */
+
 /* Multicast address holder. */
 static ip6_addr_t multicast_address;
 
@@ -135,6 +141,103 @@ static void nd6_free_q(struct nd6_q_entry *q);
 #endif /* LWIP_ND6_QUEUEING */
 static void nd6_send_q(s8_t i);
 
+#if LWIP_ND6_CACHE_HASH
+/** The bucket of an IPv6 address: the interface identifier folded onto itself,
+ * so the neighbors of one prefix spread over all buckets. */
+static u32_t
+nd6_hash(const ip6_addr_t *ip6addr)
+{
+  u32_t h = ip6addr->addr[2] ^ ip6addr->addr[3];
+
+  h ^= h >> 16;
+  h ^= h >> 8;
+  return h & (LWIP_ND6_HASH_SIZE - 1);
+}
+
+/** Link neighbor cache entry i into the bucket of its address */
+static void
+nd6_neighbor_hash_add(s8_t i)
+{
+  u32_t h = nd6_hash(&neighbor_cache[i].next_hop_address);
+
+  neighbor_cache[i].hash_next = nd6_neighbor_hash_heads[h];
+  nd6_neighbor_hash_heads[h] = (u8_t)(i + 1);
+}
+
+/** Unlink neighbor cache entry i from the bucket of its address */
+static void
+nd6_neighbor_hash_remove(s8_t i)
+{
+  u8_t *link = &nd6_neighbor_hash_heads[nd6_hash(&neighbor_cache[i].next_hop_address)];
+
+  while (*link != 0) {
+    if (*link == i + 1) {
+      *link = neighbor_cache[i].hash_next;
+      return;
+    }
+    link = &neighbor_cache[*link - 1].hash_next;
+  }
+}
+
+/** Link destination cache entry i into the bucket of its address */
+static void
+nd6_destination_hash_add(s16_t i)
+{
+  u32_t h = nd6_hash(&destination_cache[i].destination_addr);
+
+  destination_cache[i].hash_next = nd6_destination_hash_heads[h];
+  nd6_destination_hash_heads[h] = (netif_addr_idx_t)(i + 1);
+}
+
+/** Unlink destination cache entry i from the bucket of its address */
+static void
+nd6_destination_hash_remove(s16_t i)
+{
+  netif_addr_idx_t *link = &nd6_destination_hash_heads[nd6_hash(&destination_cache[i].destination_addr)];
+
+  while (*link != 0) {
+    if (*link == i + 1) {
+      *link = destination_cache[i].hash_next;
+      return;
+    }
+    link = &destination_cache[*link - 1].hash_next;
+  }
+}
+#endif /* LWIP_ND6_CACHE_HASH */
+
+/** Give neighbor cache entry i, a free one, its address */
+static void
+nd6_neighbor_set_address(s8_t i, const ip6_addr_t *ip6addr)
+{
+  ip6_addr_set(&(neighbor_cache[i].next_hop_address), ip6addr);
+#if LWIP_ND6_CACHE_HASH
+  nd6_neighbor_hash_add(i);
+#endif /* LWIP_ND6_CACHE_HASH */
+}
+
+/** Mark destination cache entry i unused */
+static void
+nd6_destination_clear(s16_t i)
+{
+#if LWIP_ND6_CACHE_HASH
+  if (!ip6_addr_isany(&destination_cache[i].destination_addr)) {
+    nd6_destination_hash_remove(i);
+  }
+#endif /* LWIP_ND6_CACHE_HASH */
+  ip6_addr_set_any(&destination_cache[i].destination_addr);
+}
+
+/** Give destination cache entry i, a new or a recycled one, its address */
+static void
+nd6_destination_set_address(s16_t i, const ip6_addr_t *ip6addr)
+{
+  nd6_destination_clear(i);
+  ip6_addr_set(&(destination_cache[i].destination_addr), ip6addr);
+#if LWIP_ND6_CACHE_HASH
+  nd6_destination_hash_add(i);
+#endif /* LWIP_ND6_CACHE_HASH */
+}
+
 
 /**
  * A local address has been determined to be a duplicate. Take the appropriate
@@ -537,7 +640,7 @@ nd6_input(struct pbuf *p, struct netif *inp)
         }
         neighbor_cache[i].netif = inp;
         MEMCPY(neighbor_cache[i].lladdr, lladdr_opt->addr, inp->hwaddr_len);
-        ip6_addr_set(&(neighbor_cache[i].next_hop_address), ip6_current_src_addr());
+        nd6_neighbor_set_address(i, ip6_current_src_addr());
 
         /* Receiving a message does not prove reachability: only in one direction.
          * Delay probe in case we get confirmation of reachability from upper layer (TCP). */
@@ -871,7 +974,7 @@ nd6_input(struct pbuf *p, struct netif *inp)
           if (i >= 0) {
             neighbor_cache[i].netif = inp;
             MEMCPY(neighbor_cache[i].lladdr, lladdr_opt->addr, inp->hwaddr_len);
-            ip6_addr_copy(neighbor_cache[i].next_hop_address, target_address);
+            nd6_neighbor_set_address(i, &target_address);
 
             /* Receiving a message does not prove reachability: only in one direction.
              * Delay probe in case we get confirmation of reachability from upper layer (TCP). */
@@ -1034,7 +1137,7 @@ nd6_tmr(void)
         for (j = 0; j < LWIP_ND6_NUM_DESTINATIONS; j++) {
           if (ip6_addr_cmp(&destination_cache[j].next_hop_addr,
                &default_router_list[i].neighbor_entry->next_hop_address)) {
-             ip6_addr_set_any(&destination_cache[j].destination_addr);
+             nd6_destination_clear(j);
           }
         }
         default_router_list[i].neighbor_entry->isrouter = 0;
@@ -1400,12 +1503,23 @@ nd6_send_rs(struct netif *netif)
 static s8_t
 nd6_find_neighbor_cache_entry(const ip6_addr_t *ip6addr)
 {
+#if LWIP_ND6_CACHE_HASH
+  u8_t next = nd6_neighbor_hash_heads[nd6_hash(ip6addr)];
+
+  while (next != 0) {
+    if (ip6_addr_cmp(ip6addr, &(neighbor_cache[next - 1].next_hop_address))) {
+      return (s8_t)(next - 1);
+    }
+    next = neighbor_cache[next - 1].hash_next;
+  }
+#else /* LWIP_ND6_CACHE_HASH */
   s8_t i;
   for (i = 0; i < LWIP_ND6_NUM_NEIGHBORS; i++) {
     if (ip6_addr_cmp(ip6addr, &(neighbor_cache[i].next_hop_address))) {
       return i;
     }
   }
+#endif /* LWIP_ND6_CACHE_HASH */
   return -1;
 }
 
@@ -1542,6 +1656,11 @@ nd6_free_neighbor_cache_entry(s8_t i)
     neighbor_cache[i].q = NULL;
   }
 
+#if LWIP_ND6_CACHE_HASH
+  if (neighbor_cache[i].state != ND6_NO_ENTRY) {
+    nd6_neighbor_hash_remove(i);
+  }
+#endif /* LWIP_ND6_CACHE_HASH */
   neighbor_cache[i].state = ND6_NO_ENTRY;
   neighbor_cache[i].isrouter = 0;
   neighbor_cache[i].netif = NULL;
@@ -1559,6 +1678,19 @@ nd6_free_neighbor_cache_entry(s8_t i)
 static s16_t
 nd6_find_destination_cache_entry(const ip6_addr_t *ip6addr)
 {
+#if LWIP_ND6_CACHE_HASH
+  netif_addr_idx_t next;
+
+  IP6_ADDR_ZONECHECK(ip6addr);
+
+  next = nd6_destination_hash_heads[nd6_hash(ip6addr)];
+  while (next != 0) {
+    if (ip6_addr_cmp(ip6addr, &(destination_cache[next - 1].destination_addr))) {
+      return (s16_t)(next - 1);
+    }
+    next = destination_cache[next - 1].hash_next;
+  }
+#else /* LWIP_ND6_CACHE_HASH */
   s16_t i;
 
   IP6_ADDR_ZONECHECK(ip6addr);
@@ -1568,6 +1700,7 @@ nd6_find_destination_cache_entry(const ip6_addr_t *ip6addr)
       return i;
     }
   }
+#endif /* LWIP_ND6_CACHE_HASH */
   return -1;
 }
 
@@ -1597,6 +1730,7 @@ nd6_new_destination_cache_entry(void)
   for (i = 0; i < LWIP_ND6_NUM_DESTINATIONS; i++) {
     if (destination_cache[i].age > age) {
       j = i;
+      age = destination_cache[i].age;
     }
   }
 
@@ -1615,7 +1749,7 @@ nd6_clear_destination_cache(void)
   int i;
 
   for (i = 0; i < LWIP_ND6_NUM_DESTINATIONS; i++) {
-    ip6_addr_set_any(&destination_cache[i].destination_addr);
+    nd6_destination_clear(i);
   }
 }
 
@@ -1819,7 +1953,7 @@ nd6_new_router(const ip6_addr_t *router_addr, struct netif *netif)
       /* Could not create neighbor entry for this router. */
       return -1;
     }
-    ip6_addr_set(&(neighbor_cache[neighbor_index].next_hop_address), router_addr);
+    nd6_neighbor_set_address(neighbor_index, router_addr);
     neighbor_cache[neighbor_index].netif = netif;
     neighbor_cache[neighbor_index].q = NULL;
     neighbor_cache[neighbor_index].state = ND6_INCOMPLETE;
@@ -1966,7 +2100,7 @@ nd6_get_next_hop_entry(const ip6_addr_t *ip6addr, struct netif *netif)
       }
 
       /* Copy dest address to destination cache. */
-      ip6_addr_set(&(destination_cache[nd6_cached_destination_index].destination_addr), ip6addr);
+      nd6_destination_set_address(nd6_cached_destination_index, ip6addr);
 
       /* Now find the next hop. is it a neighbor? */
       if (ip6_addr_islinklocal(ip6addr) ||
@@ -1985,7 +2119,7 @@ nd6_get_next_hop_entry(const ip6_addr_t *ip6addr, struct netif *netif)
         i = nd6_select_router(ip6addr, netif);
         if (i < 0) {
           /* No router found. */
-          ip6_addr_set_any(&(destination_cache[nd6_cached_destination_index].destination_addr));
+          nd6_destination_clear(nd6_cached_destination_index);
           return ERR_RTE;
         }
         destination_cache[nd6_cached_destination_index].pmtu = netif_mtu6(netif); /* Start with netif mtu, correct through ICMPv6 if necessary */
@@ -2024,8 +2158,7 @@ nd6_get_next_hop_entry(const ip6_addr_t *ip6addr, struct netif *netif)
       }
 
       /* Initialize fields. */
-      ip6_addr_copy(neighbor_cache[i].next_hop_address,
-                   destination_cache[nd6_cached_destination_index].next_hop_addr);
+      nd6_neighbor_set_address(i, &(destination_cache[nd6_cached_destination_index].next_hop_addr));
       neighbor_cache[i].isrouter = 0;
       neighbor_cache[i].netif = netif;
       neighbor_cache[i].state = ND6_INCOMPLETE;
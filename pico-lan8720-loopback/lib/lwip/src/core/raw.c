@@ -175,7 +175,7 @@ raw_input(struct pbuf *p, struct netif *inp)
 #endif
         ret = RAW_INPUT_DELIVERED;
         /* the receive callback function did not eat the packet? */
-        eaten = pcb->recv(pcb->recv_arg, pcb, p, ip_current_src_addr());
+        LWIP_APP_CALLBACK(eaten = pcb->recv(pcb->recv_arg, pcb, p, ip_current_src_addr()));
         if (eaten != 0) {
           /* receive function ate the packet */
           p = NULL;
@@ -108,6 +108,7 @@
 #include "lwip/priv/tcp_priv.h"
 #include "lwip/debug.h"
 #include "lwip/stats.h"
+#include "lwip/sys.h"
 #include "lwip/ip6.h"
 #include "lwip/ip6_addr.h"
 #include "lwip/nd6.h"
@@ -184,6 +185,27 @@ struct tcp_pcb **const tcp_pcb_lists[] = {&tcp_listen_pcbs.pcbs, &tcp_bound_pcbs
 
 u8_t tcp_active_pcbs_changed;
 
+#if LWIP_TCP_PCB_HASH
+/** The active pcbs hashed over remote ip, remote port and local port */
+struct tcp_pcb *tcp_active_pcbs_hash[TCP_PCB_HASH_SIZE];
+#endif /* LWIP_TCP_PCB_HASH */
+
+#if LWIP_TCP_RCV_AUTOTUNE
+/** Bytes of receive window the pcbs have grown beyond TCP_RCV_AUTOTUNE_INIT_WND */
+u32_t tcp_rcv_autotune_used;
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+
+#if LWIP_TCP_MEM_SHARE
+/** The pcbs on tcp_active_pcbs without a cap of their own, for received data
+ * and for the send queue */
+u16_t tcp_mem_rx_pcbs;
+u16_t tcp_mem_tx_pcbs;
+/** Counters of tcp_mem_get_stats() */
+static u32_t tcp_mem_rx_closed;
+static u32_t tcp_mem_rx_dropped;
+static u32_t tcp_mem_tx_refused;
+#endif /* LWIP_TCP_MEM_SHARE */
+
 /** Timer counter to handle calling slow-timer from tcp_tmr() */
 static u8_t tcp_timer;
 static u8_t tcp_timer_ctr;
@@ -212,6 +234,9 @@ tcp_free(struct tcp_pcb *pcb)
   LWIP_ASSERT("tcp_free: LISTEN", pcb->state != LISTEN);
 #if LWIP_TCP_PCB_NUM_EXT_ARGS
   tcp_ext_arg_invoke_callbacks_destroyed(pcb->ext_args);
+#endif
+#if LWIP_TCP_OUTPUT_BATCH
+  tcp_output_batch_remove(pcb);
 #endif
   memp_free(MEMP_TCP_PCB, pcb);
 }
@@ -919,6 +944,168 @@ done:
   return (struct tcp_pcb *)lpcb;
 }
 
+#if LWIP_TCP_MEM_SHARE
+/* the share of a pcb without a cap of its own, of pbufs shared among pcbs */
+static u16_t
+tcp_mem_share(u16_t pbufs, u16_t pcbs)
+{
+  u16_t share = (u16_t)(pbufs / LWIP_MAX(pcbs, 1));
+
+  return LWIP_MAX(share, TCP_MEM_SHARE_MIN);
+}
+
+static u16_t
+tcp_mem_rx_share(const struct tcp_pcb *pcb)
+{
+  return (pcb->mem_rx_max != 0) ? pcb->mem_rx_max : tcp_mem_share(TCP_MEM_SHARE_RX_PBUFS, tcp_mem_rx_pcbs);
+}
+
+/* a zero window from the next segment sent on, tcp_update_rcv_ann_wnd() opens
+   it again once the application freed half of the share */
+static void
+tcp_mem_rx_close(struct tcp_pcb *pcb)
+{
+  if (!pcb->mem_rx_closed) {
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_mem_rx_close: %"U16_F" pbufs held, window closed\n", pcb->mem_rx_pbufs));
+    pcb->mem_rx_closed = 1;
+    pcb->rcv_ann_wnd = 0;
+    tcp_mem_rx_closed++;
+  }
+}
+
+/**
+ * Called by tcp_input() with the data it delivers to the application, which
+ * holds it until tcp_recved(). Refused data is charged once, when it first
+ * arrives.
+ */
+void
+tcp_mem_rx_charge(struct tcp_pcb *pcb, const struct pbuf *p)
+{
+  pcb->mem_rx_pbufs = (u16_t)(pcb->mem_rx_pbufs + pbuf_clen(p));
+  pcb->mem_rx_bytes += p->tot_len;
+
+  if (pcb->mem_rx_pbufs >= tcp_mem_rx_share(pcb)) {
+    tcp_mem_rx_close(pcb);
+  }
+}
+
+/**
+ * Called by tcp_receive() for a segment in the window. Returns 1 when its data
+ * would take pcb over its share, the segment is then dropped and ACKed with a
+ * zero window as if it was out of the window. A pcb that holds nothing takes
+ * any segment, so that one larger than the share cannot stall it.
+ */
+u8_t
+tcp_mem_rx_over(struct tcp_pcb *pcb, const struct pbuf *p)
+{
+  if ((p->tot_len == 0) || (pcb->mem_rx_pbufs == 0) ||
+      (pcb->mem_rx_pbufs + pbuf_clen(p) <= tcp_mem_rx_share(pcb))) {
+    return 0;
+  }
+
+  tcp_mem_rx_close(pcb);
+  tcp_mem_rx_dropped++;
+  return 1;
+}
+
+/* len bytes freed by tcp_recved(), the pbufs they take with them in proportion */
+static void
+tcp_mem_rx_discharge(struct tcp_pcb *pcb, u16_t len)
+{
+  if (len >= pcb->mem_rx_bytes) {
+    pcb->mem_rx_bytes = 0;
+    pcb->mem_rx_pbufs = 0;
+  } else {
+    u32_t left = pcb->mem_rx_bytes - len;
+
+    pcb->mem_rx_pbufs = (u16_t)(((u32_t)pcb->mem_rx_pbufs * left + pcb->mem_rx_bytes - 1) / pcb->mem_rx_bytes);
+    pcb->mem_rx_bytes = left;
+  }
+}
+
+/**
+ * Called by tcp_write(). Returns 1 when pcb queues its share of pbufs to send or
+ * more, tcp_write() refuses with ERR_MEM then.
+ */
+u8_t
+tcp_mem_tx_over(struct tcp_pcb *pcb)
+{
+  u16_t share = (pcb->mem_tx_max != 0) ? pcb->mem_tx_max : tcp_mem_share(TCP_MEM_SHARE_TX_PBUFS, tcp_mem_tx_pcbs);
+
+  if (pcb->snd_queuelen < share) {
+    return 0;
+  }
+
+  tcp_mem_tx_refused++;
+  return 1;
+}
+
+/**
+ * @ingroup tcp_raw
+ * Sets the pbufs a connection may hold, see LWIP_TCP_MEM_SHARE. A pcb with a
+ * cap of its own leaves the pcbs the pbufs are shared among, the cap is not
+ * taken from them. An application that keeps received data until a whole
+ * message is there needs a cap that holds the largest message, or it waits for
+ * data that is never accepted.
+ *
+ * @param pcb the tcp_pcb to limit
+ * @param rx_pbufs received pbufs the application may hold before tcp_recved(),
+ *        0 for the share of the pcb
+ * @param tx_pbufs pbufs queued to send, counted as in tcp_sndqueuelen(), 0 for
+ *        the share of the pcb
+ */
+void
+tcp_set_mem_limit(struct tcp_pcb *pcb, u16_t rx_pbufs, u16_t tx_pbufs)
+{
+  u8_t active;
+
+  LWIP_ASSERT_CORE_LOCKED();
+
+  LWIP_ERROR("tcp_set_mem_limit: invalid pcb", pcb != NULL, return);
+  LWIP_ERROR("tcp_set_mem_limit: called on a listen pcb", pcb->state != LISTEN, return);
+
+  /* counted again as TCP_REG does, when the pcb is on tcp_active_pcbs */
+  active = (pcb->state != CLOSED) && (pcb->state != TIME_WAIT);
+  if (active) {
+    TCP_RMV_MEM(&tcp_active_pcbs, pcb);
+  }
+  pcb->mem_rx_max = rx_pbufs;
+  pcb->mem_tx_max = tx_pbufs;
+  if (active) {
+    TCP_REG_MEM(&tcp_active_pcbs, pcb);
+  }
+}
+
+/**
+ * @ingroup tcp_raw
+ * What the pcbs hold of the pbufs they share, and how often they were held to
+ * their shares, see LWIP_TCP_MEM_SHARE.
+ *
+ * @param stats filled in
+ */
+void
+tcp_mem_get_stats(struct tcp_mem_stats *stats)
+{
+  struct tcp_pcb *pcb;
+
+  LWIP_ASSERT_CORE_LOCKED();
+
+  LWIP_ERROR("tcp_mem_get_stats: invalid stats", stats != NULL, return);
+
+  stats->rx_pcbs = tcp_mem_rx_pcbs;
+  stats->tx_pcbs = tcp_mem_tx_pcbs;
+  stats->rx_share = tcp_mem_share(TCP_MEM_SHARE_RX_PBUFS, tcp_mem_rx_pcbs);
+  stats->tx_share = tcp_mem_share(TCP_MEM_SHARE_TX_PBUFS, tcp_mem_tx_pcbs);
+  stats->rx_pbufs = 0;
+  for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+    stats->rx_pbufs = (u16_t)(stats->rx_pbufs + pcb->mem_rx_pbufs);
+  }
+  stats->rx_closed = tcp_mem_rx_closed;
+  stats->rx_dropped = tcp_mem_rx_dropped;
+  stats->tx_refused = tcp_mem_tx_refused;
+}
+#endif /* LWIP_TCP_MEM_SHARE */
+
 /**
  * Update the state that tracks the available window space to advertise.
  *
@@ -931,6 +1118,16 @@ tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
   u32_t new_right_edge;
 
   LWIP_ASSERT("tcp_update_rcv_ann_wnd: invalid pcb", pcb != NULL);
+#if LWIP_TCP_MEM_SHARE
+  if (pcb->mem_rx_closed) {
+    if (pcb->mem_rx_pbufs > tcp_mem_rx_share(pcb) / 2) {
+      /* the window stays closed, the zero window sent moved the right edge back */
+      pcb->rcv_ann_wnd = 0;
+      return 0;
+    }
+    pcb->mem_rx_closed = 0;
+  }
+#endif /* LWIP_TCP_MEM_SHARE */
   new_right_edge = pcb->rcv_nxt + pcb->rcv_wnd;
 
   if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((TCP_WND / 2), pcb->mss))) {
@@ -985,6 +1182,9 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
   } else  {
     pcb->rcv_wnd = rcv_wnd;
   }
+#if LWIP_TCP_MEM_SHARE
+  tcp_mem_rx_discharge(pcb, len);
+#endif /* LWIP_TCP_MEM_SHARE */
 
   wnd_inflation = tcp_update_rcv_ann_wnd(pcb);
 
@@ -1001,6 +1201,71 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
                           len, pcb->rcv_wnd, (u16_t)(TCP_WND_MAX(pcb) - pcb->rcv_wnd)));
 }
 
+#if LWIP_TCP_RCV_AUTOTUNE
+/**
+ * Called by tcp_receive() for in-sequence data. The round trip time is taken
+ * from the handshake (the first data arrives a round trip after the SYN) and
+ * from how long a window of data takes to arrive, whichever is shorter. The
+ * receive window is grown to twice the data of a round trip at the rate of the
+ * last window, at most doubled per window and within TCP_WND and
+ * TCP_RCV_AUTOTUNE_BUDGET: a window that arrives in a round trip means the
+ * window, not the path, holds the sender back. A sender or application slower
+ * than the window makes the window take longer and it stays. Below 2 ms
+ * sys_now() can't tell the two apart and nothing grows.
+ *
+ * @param pcb the tcp_pcb that received data
+ */
+void
+tcp_rcv_autotune(struct tcp_pcb *pcb)
+{
+  u32_t now = sys_now();
+  u32_t bytes, elapsed, target, wnd_max, grow;
+
+  elapsed = now - pcb->rcv_tune_time;
+  if (pcb->rcv_tune_wnd == 0) {
+    /* the first data, rcv_tune_time is the SYN (tcp_alloc() or tcp_connect()) */
+    pcb->rcv_tune_rtt = (u16_t)LWIP_MIN(elapsed, 0xffff);
+  } else {
+    bytes = pcb->rcv_nxt - pcb->rcv_tune_seq;
+    if (bytes < pcb->rcv_tune_wnd) {
+      return;
+    }
+    if ((elapsed >= 2) && (elapsed <= 0xffff)) {
+      if (elapsed < pcb->rcv_tune_rtt) {
+        pcb->rcv_tune_rtt = (u16_t)elapsed;
+      }
+      /* 2 * bytes * rtt / elapsed, without overflow as rtt <= elapsed <= 0xffff */
+      target = 2 * ((bytes / elapsed) * pcb->rcv_tune_rtt + ((bytes % elapsed) * pcb->rcv_tune_rtt) / elapsed);
+
+#if LWIP_WND_SCALE
+      wnd_max = (pcb->flags & TF_WND_SCALE) ? TCP_WND : TCPWND16(TCP_WND);
+#else /* LWIP_WND_SCALE */
+      wnd_max = TCP_WND;
+#endif /* LWIP_WND_SCALE */
+      if (target > pcb->rcv_wnd_max) {
+        grow = LWIP_MIN(target - pcb->rcv_wnd_max, pcb->rcv_wnd_max);
+        grow = LWIP_MIN(grow, wnd_max - pcb->rcv_wnd_max);
+        grow = LWIP_MIN(grow, TCP_RCV_AUTOTUNE_BUDGET - tcp_rcv_autotune_used);
+        if (grow != 0) {
+          pcb->rcv_wnd_max = (tcpwnd_size_t)(pcb->rcv_wnd_max + grow);
+          pcb->rcv_wnd = (tcpwnd_size_t)(pcb->rcv_wnd + grow);
+          tcp_rcv_autotune_used += grow;
+          tcp_update_rcv_ann_wnd(pcb);
+
+          LWIP_DEBUGF(TCP_DEBUG, ("tcp_rcv_autotune: window grown to %"TCPWNDSIZE_F", rtt %"U16_F" ms, %"U32_F" of the budget used\n",
+                                  pcb->rcv_wnd_max, pcb->rcv_tune_rtt, tcp_rcv_autotune_used));
+        }
+      }
+    }
+  }
+
+  /* the next period lasts a window */
+  pcb->rcv_tune_seq = pcb->rcv_nxt;
+  pcb->rcv_tune_wnd = pcb->rcv_wnd_max;
+  pcb->rcv_tune_time = now;
+}
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+
 /**
  * Allocate a new local TCP port.
  *
@@ -1148,8 +1413,11 @@ tcp_connect(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port,
   pcb->snd_lbb = iss - 1;
   /* Start with a window that does not need scaling. When window scaling is
      enabled and used, the window is enlarged when both sides agree on scaling. */
-  pcb->rcv_wnd = pcb->rcv_ann_wnd = TCPWND_MIN16(TCP_WND);
+  pcb->rcv_wnd = pcb->rcv_ann_wnd = TCPWND_MIN16(TCP_RCV_WND_INIT);
   pcb->rcv_ann_right_edge = pcb->rcv_nxt;
+#if LWIP_TCP_RCV_AUTOTUNE
+  pcb->rcv_tune_time = sys_now();
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
   pcb->snd_wnd = TCP_WND;
   /* As initial send MSS, we use TCP_MSS but limit it to 536.
      The send MSS is updated when an MSS option is received. */
@@ -1191,7 +1459,9 @@ void
 tcp_slowtmr(void)
 {
   struct tcp_pcb *pcb, *prev;
+#if !LWIP_TCP_CC
   tcpwnd_size_t eff_wnd;
+#endif /* !LWIP_TCP_CC */
   u8_t pcb_remove;      /* flag if a PCB should be removed */
   u8_t pcb_reset;       /* flag if a RST should be sent when removing */
   err_t err;
@@ -1292,12 +1562,16 @@ tcp_slowtmr_start:
             pcb->rtime = 0;
 
             /* Reduce congestion window and ssthresh. */
+#if LWIP_TCP_CC
+            pcb->cc->rto(pcb);
+#else /* LWIP_TCP_CC */
             eff_wnd = LWIP_MIN(pcb->cwnd, pcb->snd_wnd);
             pcb->ssthresh = eff_wnd >> 1;
             if (pcb->ssthresh < (tcpwnd_size_t)(pcb->mss << 1)) {
               pcb->ssthresh = (tcpwnd_size_t)(pcb->mss << 1);
             }
             pcb->cwnd = pcb->mss;
+#endif /* LWIP_TCP_CC */
             LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"TCPWNDSIZE_F
                                          " ssthresh %"TCPWNDSIZE_F"\n",
                                          pcb->cwnd, pcb->ssthresh));
@@ -1392,6 +1666,9 @@ tcp_slowtmr_start:
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_active_pcbs", tcp_active_pcbs == pcb);
         tcp_active_pcbs = pcb->next;
       }
+#if LWIP_TCP_PCB_HASH
+      tcp_pcb_hash_remove(pcb);
+#endif /* LWIP_TCP_PCB_HASH */
 
       if (pcb_reset) {
         tcp_rst(pcb, pcb->snd_nxt, pcb->rcv_nxt, &pcb->local_ip, &pcb->remote_ip,
@@ -1649,6 +1926,166 @@ tcp_setprio(struct tcp_pcb *pcb, u8_t prio)
   pcb->prio = prio;
 }
 
+#if LWIP_TCP_CC
+/**
+ * @ingroup tcp
+ * Sets the congestion control of a connection, see LWIP_TCP_CC. A connection
+ * from tcp_accept() gets TCP_CC_DEFAULT, set it from the accept callback to
+ * have it from the first data on.
+ *
+ * @param pcb the tcp_pcb to manipulate
+ * @param cc &tcp_cc_newreno, &tcp_cc_ledbat or the application's own
+ */
+void
+tcp_set_cc(struct tcp_pcb *pcb, const struct tcp_cc_ops *cc)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+
+  LWIP_ERROR("tcp_set_cc: invalid pcb", pcb != NULL, return);
+  LWIP_ERROR("tcp_set_cc: invalid cc", cc != NULL, return);
+  LWIP_ERROR("tcp_set_cc: called on a listen pcb", pcb->state != LISTEN, return);
+
+  pcb->cc = cc;
+  if (cc->init != NULL) {
+    cc->init(pcb);
+  }
+}
+
+static void
+tcp_cc_newreno_ack(struct tcp_pcb *pcb, tcpwnd_size_t acked, u32_t rtt_ms)
+{
+  LWIP_UNUSED_ARG(rtt_ms);
+
+  if (pcb->cwnd < pcb->ssthresh) {
+    tcpwnd_size_t increase;
+    /* limit to 1 SMSS segment during period following RTO */
+    u8_t num_seg = (pcb->flags & TF_RTO) ? 1 : 2;
+    /* RFC 3465, section 2.2 Slow Start */
+    increase = LWIP_MIN(acked, (tcpwnd_size_t)(num_seg * pcb->mss));
+    TCP_WND_INC(pcb->cwnd, increase);
+  } else {
+    /* RFC 3465, section 2.1 Congestion Avoidance */
+    TCP_WND_INC(pcb->bytes_acked, acked);
+    if (pcb->bytes_acked >= pcb->cwnd) {
+      pcb->bytes_acked = (tcpwnd_size_t)(pcb->bytes_acked - pcb->cwnd);
+      TCP_WND_INC(pcb->cwnd, pcb->mss);
+    }
+  }
+}
+
+/* ssthresh to half of the minimum of the current cwnd and the advertised
+   window, at least 2 MSS */
+static void
+tcp_cc_newreno_halve(struct tcp_pcb *pcb)
+{
+  pcb->ssthresh = LWIP_MIN(pcb->cwnd, pcb->snd_wnd) / 2;
+  if (pcb->ssthresh < (2U * pcb->mss)) {
+    pcb->ssthresh = (tcpwnd_size_t)(2U * pcb->mss);
+  }
+}
+
+static void
+tcp_cc_newreno_loss(struct tcp_pcb *pcb)
+{
+  tcp_cc_newreno_halve(pcb);
+  pcb->cwnd = (tcpwnd_size_t)(pcb->ssthresh + 3U * pcb->mss);
+}
+
+static void
+tcp_cc_newreno_rto(struct tcp_pcb *pcb)
+{
+  tcp_cc_newreno_halve(pcb);
+  pcb->cwnd = pcb->mss;
+}
+
+const struct tcp_cc_ops tcp_cc_newreno = {
+  "newreno",
+  NULL,
+  tcp_cc_newreno_ack,
+  tcp_cc_newreno_loss,
+  tcp_cc_newreno_rto
+};
+
+static void
+tcp_cc_ledbat_init(struct tcp_pcb *pcb)
+{
+  pcb->cc_base_time = sys_now();
+  pcb->cc_base_last = 0;
+  pcb->cc_base_cur = 0;
+  pcb->cc_delay = 0;
+}
+
+/* the queueing delay of a round trip sample: what it took above the lowest of
+   this base period and the last one */
+static void
+tcp_cc_ledbat_sample(struct tcp_pcb *pcb, u32_t rtt_ms)
+{
+  u32_t now = sys_now();
+  u16_t rtt = (u16_t)LWIP_MIN(rtt_ms, 0xffff);
+  u16_t base;
+
+  if ((u32_t)(now - pcb->cc_base_time) >= TCP_CC_LEDBAT_BASE_MS) {
+    pcb->cc_base_last = pcb->cc_base_cur;
+    pcb->cc_base_cur = 0;
+    pcb->cc_base_time = now;
+  }
+  if (pcb->cc_base_cur == 0 || rtt < pcb->cc_base_cur) {
+    pcb->cc_base_cur = rtt;
+  }
+
+  base = pcb->cc_base_cur;
+  if (pcb->cc_base_last != 0 && pcb->cc_base_last < base) {
+    base = pcb->cc_base_last;
+  }
+  pcb->cc_delay = (u16_t)(rtt - base);
+}
+
+/* RFC 6817 with GAIN 1, once per window of data acked instead of per ACK: cwnd
+   grows by a MSS times how far below TCP_CC_LEDBAT_TARGET_MS the queueing delay
+   is, at most a MSS as NewReno, and shrinks by as much above it, at most by half
+   and not below 2 MSS. Slow start ends at half the target */
+static void
+tcp_cc_ledbat_ack(struct tcp_pcb *pcb, tcpwnd_size_t acked, u32_t rtt_ms)
+{
+  s32_t change;
+
+  if (rtt_ms != 0) {
+    tcp_cc_ledbat_sample(pcb, rtt_ms);
+  }
+
+  if (pcb->cwnd < pcb->ssthresh) {
+    if (pcb->cc_delay < TCP_CC_LEDBAT_TARGET_MS / 2) {
+      tcp_cc_newreno_ack(pcb, acked, rtt_ms);
+      return;
+    }
+    pcb->ssthresh = pcb->cwnd;
+    pcb->bytes_acked = 0;
+  }
+
+  TCP_WND_INC(pcb->bytes_acked, acked);
+  if (pcb->bytes_acked < pcb->cwnd) {
+    return;
+  }
+  pcb->bytes_acked = (tcpwnd_size_t)(pcb->bytes_acked - pcb->cwnd);
+
+  change = ((s32_t)TCP_CC_LEDBAT_TARGET_MS - (s32_t)pcb->cc_delay) * pcb->mss / TCP_CC_LEDBAT_TARGET_MS;
+  if (change >= 0) {
+    TCP_WND_INC(pcb->cwnd, (tcpwnd_size_t)change);
+  } else if (pcb->cwnd > 2U * pcb->mss) {
+    u32_t decrease = LWIP_MIN((u32_t)-change, (u32_t)pcb->cwnd / 2);
+    pcb->cwnd = (tcpwnd_size_t)LWIP_MAX(pcb->cwnd - decrease, 2U * pcb->mss);
+  }
+}
+
+const struct tcp_cc_ops tcp_cc_ledbat = {
+  "ledbat",
+  tcp_cc_ledbat_init,
+  tcp_cc_ledbat_ack,
+  tcp_cc_newreno_loss,
+  tcp_cc_newreno_rto
+};
+#endif /* LWIP_TCP_CC */
+
 #if TCP_QUEUE_OOSEQ
 /**
  * Returns a copy of the given TCP segment.
@@ -1801,6 +2238,27 @@ tcp_kill_timewait(void)
   }
 }
 
+#if LWIP_TCP_TIME_WAIT_MAX
+/**
+ * Kills the oldest connection in TIME_WAIT state if LWIP_TCP_TIME_WAIT_MAX
+ * are. Called from tcp_process() before a pcb enters TIME_WAIT.
+ */
+void
+tcp_timewait_limit(void)
+{
+  struct tcp_pcb *pcb;
+  u16_t count = 0;
+
+  for (pcb = tcp_tw_pcbs; pcb != NULL; pcb = pcb->next) {
+    count++;
+  }
+  if (count >= LWIP_TCP_TIME_WAIT_MAX) {
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_timewait_limit: %"U16_F" TIME-WAIT PCBs\n", count));
+    tcp_kill_timewait();
+  }
+}
+#endif /* LWIP_TCP_TIME_WAIT_MAX */
+
 /* Called when allocating a pcb fails.
  * In this case, we want to handle all pcbs that want to close first: if we can
  * now send the FIN (which failed before), the pcb might be in a state that is
@@ -1891,7 +2349,11 @@ tcp_alloc(u8_t prio)
     pcb->snd_buf = TCP_SND_BUF;
     /* Start with a window that does not need scaling. When window scaling is
        enabled and used, the window is enlarged when both sides agree on scaling. */
-    pcb->rcv_wnd = pcb->rcv_ann_wnd = TCPWND_MIN16(TCP_WND);
+    pcb->rcv_wnd = pcb->rcv_ann_wnd = TCPWND_MIN16(TCP_RCV_WND_INIT);
+#if LWIP_TCP_RCV_AUTOTUNE
+    pcb->rcv_wnd_max = TCP_RCV_WND_INIT;
+    pcb->rcv_tune_time = sys_now();
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
     pcb->ttl = TCP_TTL;
     /* As initial send MSS, we use TCP_MSS but limit it to 536.
        The send MSS is updated when an MSS option is received. */
@@ -1910,6 +2372,12 @@ tcp_alloc(u8_t prio)
     connection is established. To avoid these complications, we set ssthresh to the
     largest effective cwnd (amount of in-flight data) that the sender can have. */
     pcb->ssthresh = TCP_SND_BUF;
+#if LWIP_TCP_CC
+    pcb->cc = TCP_CC_DEFAULT;
+    if (pcb->cc->init != NULL) {
+      pcb->cc->init(pcb);
+    }
+#endif /* LWIP_TCP_CC */
 
 #if LWIP_CALLBACK_API
     pcb->recv = tcp_recv_null;
@@ -2116,6 +2584,74 @@ tcp_poll(struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interval)
   pcb->pollinterval = interval;
 }
 
+#if LWIP_TCP_PCB_HASH
+/**
+ * Bucket of a connection in tcp_active_pcbs_hash. The remote address and both
+ * ports are folded into its low bits, so connections from one host differ by
+ * remote port and connections to one server by local port.
+ *
+ * @param remote_ip remote address of the connection
+ * @param remote_port remote port, host byte order
+ * @param local_port local port, host byte order
+ * @return index into tcp_active_pcbs_hash
+ */
+u16_t
+tcp_pcb_hash(const ip_addr_t *remote_ip, u16_t remote_port, u16_t local_port)
+{
+  u32_t h;
+
+#if LWIP_IPV6
+  if (IP_IS_V6(remote_ip)) {
+    const u32_t *addr = ip_2_ip6(remote_ip)->addr;
+    h = addr[0] ^ addr[1] ^ addr[2] ^ addr[3];
+  } else
+#endif /* LWIP_IPV6 */
+  {
+    h = ip4_addr_get_u32(ip_2_ip4(remote_ip));
+  }
+  h ^= ((u32_t)remote_port << 16) ^ local_port;
+  h ^= h >> 16;
+  h ^= h >> 8;
+
+  return (u16_t)(h & (TCP_PCB_HASH_SIZE - 1));
+}
+
+/**
+ * Adds a pcb to tcp_active_pcbs_hash, called by TCP_REG for tcp_active_pcbs.
+ * Its remote ip and ports must not change until it is removed again.
+ *
+ * @param pcb tcp_pcb to add
+ */
+void
+tcp_pcb_hash_add(struct tcp_pcb *pcb)
+{
+  struct tcp_pcb **bucket = &tcp_active_pcbs_hash[tcp_pcb_hash(&pcb->remote_ip, pcb->remote_port, pcb->local_port)];
+
+  pcb->hash_next = *bucket;
+  *bucket = pcb;
+}
+
+/**
+ * Removes a pcb from tcp_active_pcbs_hash, called by TCP_RMV for
+ * tcp_active_pcbs. Does nothing for a pcb that is not in the table.
+ *
+ * @param pcb tcp_pcb to remove
+ */
+void
+tcp_pcb_hash_remove(struct tcp_pcb *pcb)
+{
+  struct tcp_pcb **p = &tcp_active_pcbs_hash[tcp_pcb_hash(&pcb->remote_ip, pcb->remote_port, pcb->local_port)];
+
+  for (; *p != NULL; p = &(*p)->hash_next) {
+    if (*p == pcb) {
+      *p = pcb->hash_next;
+      break;
+    }
+  }
+  pcb->hash_next = NULL;
+}
+#endif /* LWIP_TCP_PCB_HASH */
+
 /**
  * Purges a TCP PCB. Removes any buffered data and frees the buffer memory
  * (pcb->ooseq, pcb->unsent and pcb->unacked are freed).
@@ -2163,6 +2699,20 @@ tcp_pcb_purge(struct tcp_pcb *pcb)
 #if TCP_OVERSIZE
     pcb->unsent_oversize = 0;
 #endif /* TCP_OVERSIZE */
+#if LWIP_TCP_RCV_AUTOTUNE
+    /* nothing more is received, the growth of the window goes back to the budget */
+    tcp_rcv_autotune_used -= pcb->rcv_wnd_max - TCP_RCV_WND_INIT;
+    pcb->rcv_wnd_max = TCP_RCV_WND_INIT;
+    if (pcb->rcv_wnd > pcb->rcv_wnd_max) {
+      pcb->rcv_wnd = pcb->rcv_wnd_max;
+    }
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+#if LWIP_TCP_MEM_SHARE
+    /* nothing more is received, what the application holds is its own */
+    pcb->mem_rx_bytes = 0;
+    pcb->mem_rx_pbufs = 0;
+    pcb->mem_rx_closed = 0;
+#endif /* LWIP_TCP_MEM_SHARE */
   }
 }
 
@@ -53,6 +53,9 @@
 #include "lwip/memp.h"
 #include "lwip/inet_chksum.h"
 #include "lwip/stats.h"
+#if LWIP_TCP_CC
+#include "lwip/sys.h"
+#endif
 #include "lwip/ip6.h"
 #include "lwip/ip6_addr.h"
 #if LWIP_ND6_TCP_REACHABILITY_HINTS
@@ -245,6 +248,29 @@ tcp_input(struct pbuf *p, struct netif *inp)
 
   /* Demultiplex an incoming segment. First, we check if it is destined
      for an active connection. */
+#if LWIP_TCP_PCB_HASH
+  /* Only the pcbs in the bucket of the segment are compared, the list needs
+     no reordering. */
+  for (pcb = tcp_active_pcbs_hash[tcp_pcb_hash(ip_current_src_addr(), tcphdr->src, tcphdr->dest)];
+       pcb != NULL; pcb = pcb->hash_next) {
+    LWIP_ASSERT("tcp_input: active pcb->state != CLOSED", pcb->state != CLOSED);
+    LWIP_ASSERT("tcp_input: active pcb->state != TIME-WAIT", pcb->state != TIME_WAIT);
+    LWIP_ASSERT("tcp_input: active pcb->state != LISTEN", pcb->state != LISTEN);
+
+    /* check if PCB is bound to specific netif */
+    if ((pcb->netif_idx != NETIF_NO_INDEX) &&
+        (pcb->netif_idx != netif_get_index(ip_data.current_input_netif))) {
+      continue;
+    }
+
+    if (pcb->remote_port == tcphdr->src &&
+        pcb->local_port == tcphdr->dest &&
+        ip_addr_cmp(&pcb->remote_ip, ip_current_src_addr()) &&
+        ip_addr_cmp(&pcb->local_ip, ip_current_dest_addr())) {
+      break;
+    }
+  }
+#else /* LWIP_TCP_PCB_HASH */
   prev = NULL;
 
   for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
@@ -279,6 +305,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
     }
     prev = pcb;
   }
+#endif /* LWIP_TCP_PCB_HASH */
 
   if (pcb == NULL) {
     /* If it did not go to an active connection, we check the connections
@@ -296,6 +323,18 @@ tcp_input(struct pbuf *p, struct netif *inp)
           pcb->local_port == tcphdr->dest &&
           ip_addr_cmp(&pcb->remote_ip, ip_current_src_addr()) &&
           ip_addr_cmp(&pcb->local_ip, ip_current_dest_addr())) {
+#if LWIP_TCP_TIME_WAIT_RECYCLE
+        /* RFC 1122 4.2.2.13: a new connection's SYN above the old one's
+           sequence space ends TIME-WAIT, the listener takes it */
+        if (((flags & (TCP_SYN | TCP_ACK | TCP_RST)) == TCP_SYN) &&
+            TCP_SEQ_GT(seqno, pcb->rcv_nxt)) {
+          LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: SYN recycles TIME_WAITing connection.\n"));
+          tcp_pcb_remove(&tcp_tw_pcbs, pcb);
+          tcp_free(pcb);
+          pcb = NULL;
+          break;
+        }
+#endif /* LWIP_TCP_TIME_WAIT_RECYCLE */
         /* We don't really care enough to move this PCB to the front
            of the list since we are not very likely to receive that
            many segments for connections in TIME-WAIT. */
@@ -497,6 +536,9 @@ tcp_input(struct pbuf *p, struct netif *inp)
             goto aborted;
           }
 
+#if LWIP_TCP_MEM_SHARE
+          tcp_mem_rx_charge(pcb, recv_data);
+#endif /* LWIP_TCP_MEM_SHARE */
           /* Notify application that data has been received. */
           TCP_EVENT_RECV(pcb, recv_data, ERR_OK, err);
           if (err == ERR_ABRT) {
@@ -512,6 +554,9 @@ tcp_input(struct pbuf *p, struct netif *inp)
           if (err != ERR_OK) {
 #if TCP_QUEUE_OOSEQ && LWIP_WND_SCALE
             if (rest != NULL) {
+#if LWIP_TCP_MEM_SHARE
+              tcp_mem_rx_charge(pcb, rest);
+#endif /* LWIP_TCP_MEM_SHARE */
               pbuf_cat(recv_data, rest);
             }
 #endif /* TCP_QUEUE_OOSEQ && LWIP_WND_SCALE */
@@ -995,6 +1040,7 @@ tcp_process(struct tcp_pcb *pcb)
           tcp_ack_now(pcb);
           tcp_pcb_purge(pcb);
           TCP_RMV_ACTIVE(pcb);
+          TCP_TIME_WAIT_LIMIT();
           pcb->state = TIME_WAIT;
           TCP_REG(&tcp_tw_pcbs, pcb);
         } else {
@@ -1013,6 +1059,7 @@ tcp_process(struct tcp_pcb *pcb)
         tcp_ack_now(pcb);
         tcp_pcb_purge(pcb);
         TCP_RMV_ACTIVE(pcb);
+        TCP_TIME_WAIT_LIMIT();
         pcb->state = TIME_WAIT;
         TCP_REG(&tcp_tw_pcbs, pcb);
       }
@@ -1023,6 +1070,7 @@ tcp_process(struct tcp_pcb *pcb)
         LWIP_DEBUGF(TCP_DEBUG, ("TCP connection closed: CLOSING %"U16_F" -> %"U16_F".\n", inseg.tcphdr->src, inseg.tcphdr->dest));
         tcp_pcb_purge(pcb);
         TCP_RMV_ACTIVE(pcb);
+        TCP_TIME_WAIT_LIMIT();
         pcb->state = TIME_WAIT;
         TCP_REG(&tcp_tw_pcbs, pcb);
       }
@@ -1254,6 +1302,15 @@ tcp_receive(struct tcp_pcb *pcb)
       /* Update the congestion control variables (cwnd and
          ssthresh). */
       if (pcb->state >= ESTABLISHED) {
+#if LWIP_TCP_CC
+        /* with a sample in ms when this acks the segment timed below */
+        u32_t rtt_ms = 0;
+        if (pcb->rttest && TCP_SEQ_LT(pcb->rtseq, ackno)) {
+          rtt_ms = LWIP_MAX(sys_now() - pcb->rttest_ms, 1);
+        }
+        pcb->cc->ack(pcb, acked, rtt_ms);
+        LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: %s cwnd %"TCPWNDSIZE_F"\n", pcb->cc->name, pcb->cwnd));
+#else /* LWIP_TCP_CC */
         if (pcb->cwnd < pcb->ssthresh) {
           tcpwnd_size_t increase;
           /* limit to 1 SMSS segment during period following RTO */
@@ -1271,6 +1328,7 @@ tcp_receive(struct tcp_pcb *pcb)
           }
           LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: congestion avoidance cwnd %"TCPWNDSIZE_F"\n", pcb->cwnd));
         }
+#endif /* LWIP_TCP_CC */
       }
       LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_receive: ACK for %"U32_F", unacked->seqno %"U32_F":%"U32_F"\n",
                                     ackno,
@@ -1455,7 +1513,12 @@ tcp_receive(struct tcp_pcb *pcb)
        and below rcv_nxt + rcv_wnd) in order to be further
        processed. */
     if (TCP_SEQ_BETWEEN(seqno, pcb->rcv_nxt,
-                        pcb->rcv_nxt + pcb->rcv_wnd - 1)) {
+                        pcb->rcv_nxt + pcb->rcv_wnd - 1)
+#if LWIP_TCP_MEM_SHARE
+        /* a pcb that holds its share of the pbufs takes no more data */
+        && !tcp_mem_rx_over(pcb, inseg.p)
+#endif /* LWIP_TCP_MEM_SHARE */
+       ) {
       if (pcb->rcv_nxt == seqno) {
         /* The incoming segment is the next in sequence. We check if
            we have to trim the end of the segment and update rcv_nxt
@@ -1544,6 +1607,9 @@ tcp_receive(struct tcp_pcb *pcb)
         pcb->rcv_wnd -= tcplen;
 
         tcp_update_rcv_ann_wnd(pcb);
+#if LWIP_TCP_RCV_AUTOTUNE
+        tcp_rcv_autotune(pcb);
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
 
         /* If there is data in the segment, we make preparations to
            pass this up to the application. The ->recv_data variable
@@ -1962,9 +2028,9 @@ tcp_parseopt(struct tcp_pcb *pcb)
             pcb->rcv_scale = TCP_RCV_SCALE;
             tcp_set_flags(pcb, TF_WND_SCALE);
             /* window scaling is enabled, we can use the full receive window */
-            LWIP_ASSERT("window not at default value", pcb->rcv_wnd == TCPWND_MIN16(TCP_WND));
-            LWIP_ASSERT("window not at default value", pcb->rcv_ann_wnd == TCPWND_MIN16(TCP_WND));
-            pcb->rcv_wnd = pcb->rcv_ann_wnd = TCP_WND;
+            LWIP_ASSERT("window not at default value", pcb->rcv_wnd == TCPWND_MIN16(TCP_RCV_WND_INIT));
+            LWIP_ASSERT("window not at default value", pcb->rcv_ann_wnd == TCPWND_MIN16(TCP_RCV_WND_INIT));
+            pcb->rcv_wnd = pcb->rcv_ann_wnd = TCP_RCV_WND_INIT;
           }
           break;
 #endif /* LWIP_WND_SCALE */
@@ -74,7 +74,7 @@
 #include "lwip/stats.h"
 #include "lwip/ip6.h"
 #include "lwip/ip6_addr.h"
-#if LWIP_TCP_TIMESTAMPS
+#if LWIP_TCP_TIMESTAMPS || LWIP_TCP_CC
 #include "lwip/sys.h"
 #endif
 
@@ -127,6 +127,63 @@
 /* Forward declarations.*/
 static err_t tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb, struct netif *netif);
 
+#if LWIP_TCP_OUTPUT_BATCH
+/* the pcbs tcp_output() was called for since tcp_output_batch_begin(), the last first */
+static struct tcp_pcb *tcp_output_batch;
+static u8_t tcp_output_batching;
+
+/**
+ * @ingroup tcp_raw
+ * Defer tcp_output() until tcp_output_batch_end(), which outputs each pcb it
+ * was called for once. See LWIP_TCP_OUTPUT_BATCH.
+ */
+void
+tcp_output_batch_begin(void)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+
+  tcp_output_batching = 1;
+}
+
+/**
+ * @ingroup tcp_raw
+ * Output the pcbs tcp_output() was called for since tcp_output_batch_begin().
+ */
+void
+tcp_output_batch_end(void)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+
+  tcp_output_batching = 0;
+
+  while (tcp_output_batch != NULL) {
+    struct tcp_pcb *pcb = tcp_output_batch;
+
+    tcp_output_batch = pcb->batch_next;
+    tcp_clear_flags(pcb, TF_BATCHED);
+    tcp_output(pcb);
+  }
+}
+
+void
+tcp_output_batch_remove(struct tcp_pcb *pcb)
+{
+  struct tcp_pcb **link;
+
+  if (!(pcb->flags & TF_BATCHED)) {
+    return;
+  }
+
+  for (link = &tcp_output_batch; *link != NULL; link = &(*link)->batch_next) {
+    if (*link == pcb) {
+      *link = pcb->batch_next;
+      break;
+    }
+  }
+  tcp_clear_flags(pcb, TF_BATCHED);
+}
+#endif /* LWIP_TCP_OUTPUT_BATCH */
+
 /* tcp_route: common code that returns a fixed bound netif or calls ip_route */
 static struct netif *
 tcp_route(const struct tcp_pcb *pcb, const ip_addr_t *src, const ip_addr_t *dst)
@@ -327,6 +384,17 @@ tcp_write_checks(struct tcp_pcb *pcb, u16_t len)
 
   LWIP_DEBUGF(TCP_QLEN_DEBUG, ("tcp_write: queuelen: %"TCPWNDSIZE_F"\n", (tcpwnd_size_t)pcb->snd_queuelen));
 
+#if LWIP_TCP_MEM_SHARE
+  /* a pcb that queues its share of the pbufs takes no more data */
+  if (tcp_mem_tx_over(pcb)) {
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SEVERE, ("tcp_write: queue at the share of the pcb %"U16_F"\n",
+                pcb->snd_queuelen));
+    TCP_STATS_INC(tcp.memerr);
+    tcp_set_flags(pcb, TF_NAGLEMEMERR);
+    return ERR_MEM;
+  }
+#endif /* LWIP_TCP_MEM_SHARE */
+
   /* If total number of pbufs on the unsent/unacked queues exceeds the
    * configured maximum, return an error */
   /* check for configured max queuelen and possible overflow */
@@ -1259,6 +1327,22 @@ tcp_output(struct tcp_pcb *pcb)
     return ERR_OK;
   }
 
+#if LWIP_TCP_OUTPUT_BATCH
+  /* a duplicate ACK per segment after a loss, not one for the batch */
+  if (tcp_output_batching
+#if TCP_QUEUE_OOSEQ
+      && (pcb->ooseq == NULL)
+#endif /* TCP_QUEUE_OOSEQ */
+     ) {
+    if (!(pcb->flags & TF_BATCHED)) {
+      tcp_set_flags(pcb, TF_BATCHED);
+      pcb->batch_next = tcp_output_batch;
+      tcp_output_batch = pcb;
+    }
+    return ERR_OK;
+  }
+#endif /* LWIP_TCP_OUTPUT_BATCH */
+
   wnd = LWIP_MIN(pcb->snd_wnd, pcb->cwnd);
 
   seg = pcb->unsent;
@@ -1538,6 +1622,9 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb, struct netif *netif
   if (pcb->rttest == 0) {
     pcb->rttest = tcp_ticks;
     pcb->rtseq = lwip_ntohl(seg->tcphdr->seqno);
+#if LWIP_TCP_CC
+    pcb->rttest_ms = sys_now();
+#endif /* LWIP_TCP_CC */
 
     LWIP_DEBUGF(TCP_RTO_DEBUG, ("tcp_output_segment: rtseq %"U32_F"\n", pcb->rtseq));
   }
@@ -1792,6 +1879,9 @@ tcp_rexmit_fast(struct tcp_pcb *pcb)
                  (u16_t)pcb->dupacks, pcb->lastack,
                  lwip_ntohl(pcb->unacked->tcphdr->seqno)));
     if (tcp_rexmit(pcb) == ERR_OK) {
+#if LWIP_TCP_CC
+      pcb->cc->loss(pcb);
+#else /* LWIP_TCP_CC */
       /* Set ssthresh to half of the minimum of the current
        * cwnd and the advertised window */
       pcb->ssthresh = LWIP_MIN(pcb->cwnd, pcb->snd_wnd) / 2;
@@ -1806,6 +1896,7 @@ tcp_rexmit_fast(struct tcp_pcb *pcb)
       }
 
       pcb->cwnd = pcb->ssthresh + 3 * pcb->mss;
+#endif /* LWIP_TCP_CC */
       tcp_set_flags(pcb, TF_INFR);
 
       /* Reset the retransmission timer to prevent immediate rto retransmissions */
@@ -80,6 +80,58 @@ static u16_t udp_port = UDP_LOCAL_PORT_RANGE_START;
 /* exported in udp.h (was static) */
 struct udp_pcb *udp_pcbs;
 
+#if LWIP_UDP_PCB_HASH
+/* The pcbs of udp_pcbs again, chained by hash_next in the bucket of their
+   local port, each chain in the order of udp_pcbs. Kept by udp_bind(),
+   udp_connect() and udp_remove(), for udp_input(). */
+static struct udp_pcb *udp_pcbs_hash[UDP_PCB_HASH_SIZE];
+
+#define UDP_PCB_HASH(port) ((port) & (UDP_PCB_HASH_SIZE - 1))
+
+/**
+ * Adds a pcb of udp_pcbs to udp_pcbs_hash, after the pcbs of its bucket that
+ * come before it in udp_pcbs, so that a walk of the bucket meets the pcbs of a
+ * port in the order udp_input() would meet them in the list. A pcb just put
+ * at the head of udp_pcbs goes to the head of its bucket without a search.
+ *
+ * @param pcb udp_pcb to add, its local port must not change until removed
+ */
+static void
+udp_pcb_hash_add(struct udp_pcb *pcb)
+{
+  struct udp_pcb **p = &udp_pcbs_hash[UDP_PCB_HASH(pcb->local_port)];
+  struct udp_pcb *ipcb;
+
+  for (ipcb = udp_pcbs; ipcb != NULL && ipcb != pcb; ipcb = ipcb->next) {
+    if (*p == ipcb) {
+      p = &ipcb->hash_next;
+    }
+  }
+  pcb->hash_next = *p;
+  *p = pcb;
+}
+
+/**
+ * Removes a pcb from udp_pcbs_hash. Does nothing for a pcb that is not in
+ * the table.
+ *
+ * @param pcb udp_pcb to remove
+ */
+static void
+udp_pcb_hash_remove(struct udp_pcb *pcb)
+{
+  struct udp_pcb **p = &udp_pcbs_hash[UDP_PCB_HASH(pcb->local_port)];
+
+  for (; *p != NULL; p = &(*p)->hash_next) {
+    if (*p == pcb) {
+      *p = pcb->hash_next;
+      break;
+    }
+  }
+  pcb->hash_next = NULL;
+}
+#endif /* LWIP_UDP_PCB_HASH */
+
 /**
  * Initialize this module.
  */
@@ -194,7 +246,10 @@ void
 udp_input(struct pbuf *p, struct netif *inp)
 {
   struct udp_hdr *udphdr;
-  struct udp_pcb *pcb, *prev;
+  struct udp_pcb *pcb;
+#if !LWIP_UDP_PCB_HASH
+  struct udp_pcb *prev;
+#endif /* !LWIP_UDP_PCB_HASH */
   struct udp_pcb *uncon_pcb;
   u16_t src, dest;
   u8_t broadcast;
@@ -244,13 +299,19 @@ udp_input(struct pbuf *p, struct netif *inp)
   LWIP_DEBUGF(UDP_DEBUG, (", %"U16_F")\n", lwip_ntohs(udphdr->src)));
 
   pcb = NULL;
-  prev = NULL;
   uncon_pcb = NULL;
   /* Iterate through the UDP pcb list for a matching pcb.
    * 'Perfect match' pcbs (connected to the remote port & ip address) are
    * preferred. If no perfect match is found, the first unconnected pcb that
    * matches the local port and ip address gets the datagram. */
+#if LWIP_UDP_PCB_HASH
+  /* Only the pcbs in the bucket of the destination port are compared, in the
+     order of udp_pcbs, which needs no reordering. */
+  for (pcb = udp_pcbs_hash[UDP_PCB_HASH(dest)]; pcb != NULL; pcb = pcb->hash_next) {
+#else /* LWIP_UDP_PCB_HASH */
+  prev = NULL;
   for (pcb = udp_pcbs; pcb != NULL; pcb = pcb->next) {
+#endif /* LWIP_UDP_PCB_HASH */
     /* print the PCB local and remote address */
     LWIP_DEBUGF(UDP_DEBUG, ("pcb ("));
     ip_addr_debug_print_val(UDP_DEBUG, pcb->local_ip);
@@ -290,6 +351,7 @@ udp_input(struct pbuf *p, struct netif *inp)
           (ip_addr_isany_val(pcb->remote_ip) ||
            ip_addr_cmp(&pcb->remote_ip, ip_current_src_addr()))) {
         /* the first fully matching PCB */
+#if !LWIP_UDP_PCB_HASH
         if (prev != NULL) {
           /* move the pcb to the front of udp_pcbs so that is
              found faster next time */
@@ -299,11 +361,14 @@ udp_input(struct pbuf *p, struct netif *inp)
         } else {
           UDP_STATS_INC(udp.cachehit);
         }
+#endif /* !LWIP_UDP_PCB_HASH */
         break;
       }
     }
 
+#if !LWIP_UDP_PCB_HASH
     prev = pcb;
+#endif /* !LWIP_UDP_PCB_HASH */
   }
   /* no fully matching pcb found? then look for an unconnected pcb */
   if (pcb == NULL) {
@@ -380,7 +445,11 @@ udp_input(struct pbuf *p, struct netif *inp)
         /* pass broadcast- or multicast packets to all multicast pcbs
            if SOF_REUSEADDR is set on the first match */
         struct udp_pcb *mpcb;
+#if LWIP_UDP_PCB_HASH
+        for (mpcb = udp_pcbs_hash[UDP_PCB_HASH(dest)]; mpcb != NULL; mpcb = mpcb->hash_next) {
+#else /* LWIP_UDP_PCB_HASH */
         for (mpcb = udp_pcbs; mpcb != NULL; mpcb = mpcb->next) {
+#endif /* LWIP_UDP_PCB_HASH */
           if (mpcb != pcb) {
             /* compare PCB local addr+port to UDP destination addr+port */
             if ((mpcb->local_port == dest) &&
@@ -390,7 +459,7 @@ udp_input(struct pbuf *p, struct netif *inp)
                 struct pbuf *q;
                 q = pbuf_clone(PBUF_RAW, PBUF_POOL, p);
                 if (q != NULL) {
-                  mpcb->recv(mpcb->recv_arg, mpcb, q, ip_current_src_addr(), src);
+                  LWIP_APP_CALLBACK(mpcb->recv(mpcb->recv_arg, mpcb, q, ip_current_src_addr(), src));
                 }
               }
             }
@@ -401,7 +470,7 @@ udp_input(struct pbuf *p, struct netif *inp)
       /* callback */
       if (pcb->recv != NULL) {
         /* now the recv function is responsible for freeing p */
-        pcb->recv(pcb->recv_arg, pcb, p, ip_current_src_addr(), src);
+        LWIP_APP_CALLBACK(pcb->recv(pcb->recv_arg, pcb, p, ip_current_src_addr(), src));
       } else {
         /* no recv function registered? then we have to free the pbuf! */
         pbuf_free(p);
@@ -1012,6 +1081,12 @@ udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
 
   ip_addr_set_ipaddr(&pcb->local_ip, ipaddr);
 
+#if LWIP_UDP_PCB_HASH
+  if (rebind) {
+    /* the bucket follows the port */
+    udp_pcb_hash_remove(pcb);
+  }
+#endif /* LWIP_UDP_PCB_HASH */
   pcb->local_port = port;
   mib2_udp_bind(pcb);
   /* pcb not active yet? */
@@ -1020,6 +1095,9 @@ udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
     pcb->next = udp_pcbs;
     udp_pcbs = pcb;
   }
+#if LWIP_UDP_PCB_HASH
+  udp_pcb_hash_add(pcb);
+#endif /* LWIP_UDP_PCB_HASH */
   LWIP_DEBUGF(UDP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, ("udp_bind: bound to "));
   ip_addr_debug_print_val(UDP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, pcb->local_ip);
   LWIP_DEBUGF(UDP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, (", port %"U16_F")\n", pcb->local_port));
@@ -1112,6 +1190,9 @@ udp_connect(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
   /* PCB not yet on the list, add PCB now */
   pcb->next = udp_pcbs;
   udp_pcbs = pcb;
+#if LWIP_UDP_PCB_HASH
+  udp_pcb_hash_add(pcb);
+#endif /* LWIP_UDP_PCB_HASH */
   return ERR_OK;
 }
 
@@ -1185,6 +1266,9 @@ udp_remove(struct udp_pcb *pcb)
   LWIP_ERROR("udp_remove: invalid pcb", pcb != NULL, return);
 
   mib2_udp_unbind(pcb);
+#if LWIP_UDP_PCB_HASH
+  udp_pcb_hash_remove(pcb);
+#endif /* LWIP_UDP_PCB_HASH */
   /* pcb to be removed is first in list? */
   if (udp_pcbs == pcb) {
     /* make list start at 2nd pcb */
@@ -108,6 +108,32 @@ struct altcp_pcb *altcp_tls_alloc(void *arg, u8_t ip_type);
  */
 void *altcp_tls_context(struct altcp_pcb *conn);
 
+/** @ingroup altcp_tls
+ * ALTCP_TLS session handle, content depends on port (e.g. mbedtls)
+ */
+struct altcp_tls_session;
+
+/** @ingroup altcp_tls
+ * Allocate an ALTCP_TLS session handle, for a client to resume a session on its
+ * next connection instead of a full handshake
+ */
+struct altcp_tls_session *altcp_tls_alloc_session(void);
+
+/** @ingroup altcp_tls
+ * Copy the session of a connection whose handshake is done into 'dest'
+ */
+err_t altcp_tls_get_session(struct altcp_pcb *conn, struct altcp_tls_session *dest);
+
+/** @ingroup altcp_tls
+ * Offer the session in 'from' on a client connection that isn't connected yet
+ */
+err_t altcp_tls_set_session(struct altcp_pcb *conn, struct altcp_tls_session *from);
+
+/** @ingroup altcp_tls
+ * Free an ALTCP_TLS session handle
+ */
+void altcp_tls_free_session(struct altcp_tls_session *session);
+
 #ifdef __cplusplus
 }
 #endif
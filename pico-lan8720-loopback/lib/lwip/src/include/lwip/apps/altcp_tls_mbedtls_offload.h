@@ -0,0 +1,81 @@
+/**
+ * @file
+ * Application layered TCP/TLS connection API (to be used from TCPIP thread)
+ *
+ * This file contains the functions a port provides for
+ * ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD.
+ */
+
+/*
+ * Copyright (c) 2017 Simon Goldschmidt
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+#ifndef LWIP_HDR_ALTCP_TLS_OFFLOAD_H
+#define LWIP_HDR_ALTCP_TLS_OFFLOAD_H
+
+#include "lwip/opt.h"
+
+#if LWIP_ALTCP /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/apps/altcp_tls_mbedtls_opts.h"
+
+#if LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS && ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A job for the other core */
+typedef void (*altcp_mbedtls_offload_fn)(void *arg);
+
+/** Called from lwIP: runs fn(arg) on the other core. Returns 1 if the job was taken,
+ * 0 if the other core can't take one now (the handshake then runs inline).
+ */
+int altcp_mbedtls_offload_start(altcp_mbedtls_offload_fn fn, void *arg);
+
+/** Called from the job: waits until lwIP has signalled, or a little while
+ */
+void altcp_mbedtls_offload_wait(void);
+
+/** Called from either side after writing memory the other side reads: a memory
+ * barrier, then wakes the other side's wait
+ */
+void altcp_mbedtls_offload_signal(void);
+
+/** Called from either side between reading what the other side signalled and
+ * reading the memory that goes with it: a memory barrier
+ */
+void altcp_mbedtls_offload_sync(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS && ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD */
+#endif /* LWIP_ALTCP */
+#endif /* LWIP_HDR_ALTCP_TLS_OFFLOAD_H */
@@ -62,6 +62,76 @@
 #define ALTCP_MBEDTLS_SESSION_CACHE_TIMEOUT_SECONDS   0
 #endif
 
+/** Maximum number of sessions kept in the server's session cache
+ */
+#ifndef ALTCP_MBEDTLS_SESSION_CACHE_SIZE
+#define ALTCP_MBEDTLS_SESSION_CACHE_SIZE              30
+#endif
+
+/** Use session tickets (RFC 5077) to speed up connection setup: the server hands the
+ * client its session encrypted with a key of its own (needs MBEDTLS_SSL_TICKET_C),
+ * so resuming costs the server no cache entry
+ * ATTENTION: Using session tickets can lower security by reusing keys!
+ */
+#ifndef ALTCP_MBEDTLS_USE_SESSION_TICKETS
+#define ALTCP_MBEDTLS_USE_SESSION_TICKETS             0
+#endif
+
+/** Cipher the server encrypts its session tickets with
+ */
+#ifndef ALTCP_MBEDTLS_SESSION_TICKET_CIPHER
+#define ALTCP_MBEDTLS_SESSION_TICKET_CIPHER           MBEDTLS_CIPHER_AES_256_GCM
+#endif
+
+/** Lifetime of a session ticket in seconds, the ticket key changes as often
+ */
+#ifndef ALTCP_MBEDTLS_SESSION_TICKET_TIMEOUT_SECONDS
+#define ALTCP_MBEDTLS_SESSION_TICKET_TIMEOUT_SECONDS  (60 * 60 * 24)
+#endif
+
+/** ALTCP_MBEDTLS_CLIENT_SESSION_REUSE==1: a client configuration keeps the session of
+ * its last handshake and offers it to the next connection it is used for, which
+ * resumes it with an abbreviated handshake if the server still knows it (by session
+ * ticket or session ID) and falls back to a full one otherwise.
+ * altcp_tls_set_session() overrides this for one connection.
+ */
+#ifndef ALTCP_MBEDTLS_CLIENT_SESSION_REUSE
+#define ALTCP_MBEDTLS_CLIENT_SESSION_REUSE            0
+#endif
+
+/** ALTCP_MBEDTLS_MEM_STATIC_SIZE > 0: mbedTLS allocates from a static buffer of this
+ * many bytes (needs MBEDTLS_MEMORY_BUFFER_ALLOC_C) instead of lwIP's heap, so TLS
+ * connections can't take the heap's memory from the rest of the stack and the rest of
+ * the stack can't fragment mbedTLS's.
+ */
+#ifndef ALTCP_MBEDTLS_MEM_STATIC_SIZE
+#define ALTCP_MBEDTLS_MEM_STATIC_SIZE                 0
+#endif
+
+/** ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD==1: run a connection's handshake in a job the port
+ * runs on another core (see lwip/apps/altcp_tls_mbedtls_offload.h), so the ECDHE and
+ * signature math doesn't hold up lwIP. The handshake talks to lwIP through two byte
+ * rings, one connection at a time, the others handshake inline meanwhile. Needs
+ * ALTCP_MBEDTLS_MEM_STATIC_SIZE and MBEDTLS_THREADING_C, mbedTLS's RNG, caches and
+ * allocator are then used from both cores.
+ */
+#ifndef ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD
+#define ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD               0
+#endif
+
+/** Size of each of the offloaded handshake's rings (a power of 2)
+ */
+#ifndef ALTCP_MBEDTLS_OFFLOAD_RING_SIZE
+#define ALTCP_MBEDTLS_OFFLOAD_RING_SIZE               2048
+#endif
+
+/** Interval in milliseconds at which lwIP sends what the offloaded handshake wrote
+ * and checks whether it is done
+ */
+#ifndef ALTCP_MBEDTLS_OFFLOAD_POLL_MS
+#define ALTCP_MBEDTLS_OFFLOAD_POLL_MS                 1
+#endif
+
 #endif /* LWIP_ALTCP */
 
 #endif /* LWIP_HDR_ALTCP_TLS_OPTS_H */
@@ -241,6 +241,46 @@ void httpd_post_data_recved(void *connection, u16_t recved_len);
 
 #endif /* LWIP_HTTPD_SUPPORT_POST */
 
+#if LWIP_HTTPD_WEBSOCKET
+
+/**
+ * @ingroup httpd
+ * Called for a GET asking for a WebSocket upgrade, before the 101 is sent.
+ *
+ * @param connection Unique connection identifier, valid until the close
+ *        handler is called.
+ * @param uri The HTTP header URI.
+ * @return ERR_OK: Accept the upgrade.
+ *         another err_t: Deny it, a 404 is sent back.
+ */
+typedef err_t (*tWSOpenHandler)(void *connection, const char *uri);
+
+/**
+ * @ingroup httpd
+ * Called for the payload of the data frames from the client, in pieces as
+ * they arrive: data is the unmasked payload, opcode that of the message
+ * (WS_OP_TEXT or WS_OP_BINARY) and last is set on its last piece. PING and
+ * CLOSE are answered by httpd.
+ */
+typedef void (*tWSRecvHandler)(void *connection, u8_t opcode, const u8_t *data,
+                               u16_t len, u8_t last);
+
+/**
+ * @ingroup httpd
+ * Called when an upgraded connection is closed or aborted, the connection
+ * is not to be written to from then on.
+ */
+typedef void (*tWSCloseHandler)(void *connection);
+
+void http_set_websocket_handlers(tWSOpenHandler open_handler,
+                                 tWSRecvHandler recv_handler,
+                                 tWSCloseHandler close_handler);
+
+err_t httpd_websocket_write(void *connection, u8_t opcode, const void *data, u16_t len);
+int httpd_websocket_broadcast(u8_t opcode, const void *data, u16_t len);
+
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
 void httpd_init(void);
 
 #if HTTPD_ENABLE_HTTPS
@@ -126,6 +126,16 @@
 #define LWIP_HTTPD_SUPPORT_POST   0
 #endif
 
+/** Set this to 1 to support the WebSocket upgrade of a GET (RFC 6455), see
+ * http_set_websocket_handlers. Needs the websocket library (framing) linked in.
+ * An upgraded connection stays open after the 101, the application pushes its
+ * messages with httpd_websocket_write; when it is idle for a poll interval
+ * httpd sends a PING and closes it after HTTPD_MAX_RETRIES without an ACK.
+ */
+#if !defined LWIP_HTTPD_WEBSOCKET || defined __DOXYGEN__
+#define LWIP_HTTPD_WEBSOCKET      0
+#endif
+
 /* The maximum number of parameters that the CGI handler can be sent. */
 #if !defined LWIP_HTTPD_MAX_CGI_PARAMETERS || defined __DOXYGEN__
 #define LWIP_HTTPD_MAX_CGI_PARAMETERS 16
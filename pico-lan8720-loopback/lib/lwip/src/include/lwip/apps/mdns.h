@@ -86,6 +86,21 @@ err_t mdns_resp_add_service_txtitem(struct mdns_service *service, const char *tx
 void mdns_resp_restart(struct netif *netif);
 void mdns_resp_announce(struct netif *netif);
 
+#if MDNS_RESP_CACHE
+/** Counters of the response cache of a netif */
+struct mdns_resp_cache_stats {
+  /** Responses sent from the cache */
+  u32_t hits;
+  /** Responses written record by record */
+  u32_t misses;
+  /** Multicast responses not sent, the same went out less than
+   *  MDNS_RESP_MCAST_INTERVAL before */
+  u32_t suppressed;
+};
+
+err_t mdns_resp_get_cache_stats(struct netif *netif, struct mdns_resp_cache_stats *stats);
+#endif /* MDNS_RESP_CACHE */
+
 /**
  * @ingroup mdns
  * Announce IP settings have changed on netif.
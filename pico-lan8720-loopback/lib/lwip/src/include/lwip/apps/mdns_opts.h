@@ -66,6 +66,34 @@
 #define MDNS_RESP_USENETIF_EXTCALLBACK  LWIP_NETIF_EXT_STATUS_CALLBACK
 #endif
 
+/** MDNS_RESP_CACHE==1: keep the responses sent, serialised, per netif and send a copy
+ * when the same answers are asked for again instead of writing them record by record.
+ * The cache is flushed when the responder restarts, a service is deleted or
+ * mdns_resp_announce() is called, which the ext_callback does on an address change.
+ * A TXT record that changes needs a mdns_resp_announce() too.
+ */
+#ifndef MDNS_RESP_CACHE
+#define MDNS_RESP_CACHE                 0
+#endif
+
+/** Responses kept per netif, one per service and one for the host by default */
+#ifndef MDNS_RESP_CACHE_ENTRIES
+#define MDNS_RESP_CACHE_ENTRIES         (MDNS_MAX_SERVICES + 1)
+#endif
+
+/** Largest response kept, bigger ones are written every time */
+#ifndef MDNS_RESP_CACHE_SIZE
+#define MDNS_RESP_CACHE_SIZE            320
+#endif
+
+/** Least time in milliseconds between two multicasts of the same response on a netif
+ * (RFC 6762 section 6 asks for a second), queries answered meanwhile get nothing.
+ * Unicast replies are not limited. 0 turns the limit off. Needs MDNS_RESP_CACHE.
+ */
+#ifndef MDNS_RESP_MCAST_INTERVAL
+#define MDNS_RESP_MCAST_INTERVAL        1000
+#endif
+
 /**
  * MDNS_DEBUG: Enable debugging for multicast DNS.
  */
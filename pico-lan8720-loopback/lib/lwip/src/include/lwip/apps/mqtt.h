@@ -198,6 +198,16 @@ err_t mqtt_sub_unsub(mqtt_client_t *client, const char *topic, u8_t qos, mqtt_re
 err_t mqtt_publish(mqtt_client_t *client, const char *topic, const void *payload, u16_t payload_length, u8_t qos, u8_t retain,
                                     mqtt_request_cb_t cb, void *arg);
 
+#if MQTT_PUBLISH_REF
+err_t mqtt_publish_ref(mqtt_client_t *client, const char *topic, const void *payload, u16_t payload_length, u8_t retain,
+                       mqtt_request_cb_t cb, void *arg);
+#endif
+
+#if MQTT_OUTPUT_BATCH
+void mqtt_output_hold(mqtt_client_t *client);
+void mqtt_output_flush(mqtt_client_t *client);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -92,6 +92,31 @@ extern "C" {
 #define MQTT_CONNECT_TIMOUT 100
 #endif
 
+/**
+ * MQTT_PUBLISH_REF==1: add mqtt_publish_ref(), a QoS 0 publish that leaves the payload
+ * in the caller's buffer and passes it to TCP by reference, without copying it into
+ * the output ring buffer and from there into pbufs. Needs LWIP_ALTCP==0.
+ */
+#ifndef MQTT_PUBLISH_REF
+#define MQTT_PUBLISH_REF 0
+#endif
+
+/**
+ * Number of mqtt_publish_ref() payloads with a callback that can wait for their
+ * acknowledgement at the same time.
+ */
+#ifndef MQTT_PUBLISH_REF_QUEUE
+#define MQTT_PUBLISH_REF_QUEUE 8
+#endif
+
+/**
+ * MQTT_OUTPUT_BATCH==1: add mqtt_output_hold() and mqtt_output_flush(), so a run of small
+ * publishes is queued to TCP and sent with one tcp_output() rather than one each.
+ */
+#ifndef MQTT_OUTPUT_BATCH
+#define MQTT_OUTPUT_BATCH 0
+#endif
+
 /**
  * @}
  */
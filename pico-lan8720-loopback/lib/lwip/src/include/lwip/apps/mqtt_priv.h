@@ -64,8 +64,22 @@ struct mqtt_ringbuf_t {
   u16_t put;
   u16_t get;
   u8_t buf[MQTT_OUTPUT_RINGBUF_SIZE];
+#if MQTT_OUTPUT_BATCH
+  /** Set by mqtt_output_hold(), nothing is sent with tcp_output() until mqtt_output_flush() */
+  u8_t hold;
+#endif
 };
 
+#if MQTT_PUBLISH_REF
+/** mqtt_publish_ref() payload waiting for its acknowledgement */
+struct mqtt_publish_ref_t {
+  /** Sequence number after the payload's last byte */
+  u32_t seq;
+  mqtt_request_cb_t cb;
+  void *arg;
+};
+#endif
+
 /** MQTT client */
 struct mqtt_client_s
 {
@@ -95,6 +109,12 @@ struct mqtt_client_s
   u8_t rx_buffer[MQTT_VAR_HEADER_BUFFER_LEN];
   /** Output ring-buffer */
   struct mqtt_ringbuf_t output;
+#if MQTT_PUBLISH_REF
+  /** Payloads lwIP still refers to, in the order they were written */
+  struct mqtt_publish_ref_t ref_queue[MQTT_PUBLISH_REF_QUEUE];
+  u8_t ref_get;
+  u8_t ref_len;
+#endif
 };
 
 #ifdef __cplusplus
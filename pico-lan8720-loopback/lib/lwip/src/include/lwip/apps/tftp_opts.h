@@ -99,6 +99,31 @@
 #define TFTP_MAX_MODE_LEN     7
 #endif
 
+/**
+ * TFTP_OPTIONS==1: answer the blksize (RFC 2348), windowsize (RFC 7440) and tsize
+ * (RFC 2349) options of write requests with an OACK, and let tftp_context::ack_ready()
+ * hold back an ACK until tftp_resume(). Read requests keep 512 byte blocks one at a
+ * time.
+ */
+#if !defined TFTP_OPTIONS || defined __DOXYGEN__
+#define TFTP_OPTIONS          0
+#endif
+
+/**
+ * Largest blksize accepted, 1428 fits a block in an Ethernet frame with room for
+ * tunnels on the way
+ */
+#if !defined TFTP_MAX_BLKSIZE || defined __DOXYGEN__
+#define TFTP_MAX_BLKSIZE      1428
+#endif
+
+/**
+ * Largest windowsize accepted, the blocks the client sends before it waits for an ACK
+ */
+#if !defined TFTP_MAX_WINDOWSIZE || defined __DOXYGEN__
+#define TFTP_MAX_WINDOWSIZE   4
+#endif
+
 /**
  * @}
  */
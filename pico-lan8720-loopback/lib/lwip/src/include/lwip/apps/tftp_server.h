@@ -83,10 +83,22 @@ struct tftp_context {
    * @returns &gt;= 0: Success; &lt; 0: Error
    */
   int (*write)(void* handle, struct pbuf* p);
+#if TFTP_OPTIONS
+  /**
+   * Optional, asked before each ACK of a write but the last one
+   * @param handle File handle returned by open()
+   * @returns != 0: send the ACK; 0: the ACK waits for tftp_resume(), and the
+   *          client sends nothing new meanwhile
+   */
+  int (*ack_ready)(void* handle);
+#endif
 };
 
 err_t tftp_init(const struct tftp_context* ctx);
 void tftp_cleanup(void);
+#if TFTP_OPTIONS
+void tftp_resume(void);
+#endif
 
 #ifdef __cplusplus
 }
@@ -706,6 +706,35 @@
 #if !defined ETHARP_TABLE_MATCH_NETIF || defined __DOXYGEN__
 #define ETHARP_TABLE_MATCH_NETIF        !LWIP_SINGLE_NETIF
 #endif
+
+/**
+ * ETHARP_TABLE_HASH==1: look ARP table entries up in a hash table keyed over the
+ * IP address, instead of searching all ARP_TABLE_SIZE entries on every
+ * etharp_output() that misses the address hint. Costs one netif_addr_idx_t per
+ * entry and ETHARP_HASH_SIZE of them, pays off with large ARP tables.
+ */
+#if !defined ETHARP_TABLE_HASH || defined __DOXYGEN__
+#define ETHARP_TABLE_HASH               0
+#endif
+
+/**
+ * ETHARP_HASH_SIZE: the number of buckets of ETHARP_TABLE_HASH, a power of 2.
+ * One per entry keeps the chains short.
+ */
+#if !defined ETHARP_HASH_SIZE || defined __DOXYGEN__
+#define ETHARP_HASH_SIZE                16
+#endif
+
+/**
+ * ETHARP_REFRESH_AHEAD==1: the ARP timer re-requests a stable entry that was
+ * used since its last update as soon as it is about to expire, while it is
+ * still used for sending. Without it only the next packet to the address does,
+ * so an address sent to less often than every 30 seconds expires and its next
+ * packet waits for a new ARP request.
+ */
+#if !defined ETHARP_REFRESH_AHEAD || defined __DOXYGEN__
+#define ETHARP_REFRESH_AHEAD            0
+#endif
 /**
  * @}
  */
@@ -794,6 +823,47 @@
 #define IP_REASS_MAX_PBUFS              10
 #endif
 
+/**
+ * IP_REASS_CONTIGUOUS==1: reassemble each datagram in one of IP_REASS_CONTIGUOUS_BUFS
+ * preallocated buffers instead of chaining its fragments. A fragment is copied in at
+ * its offset and its pbuf freed at once, so fragments don't hold on to PBUF_POOL
+ * (IP_REASS_MAX_PBUFS and MEMP_NUM_REASSDATA don't apply), and the complete datagram
+ * is passed up as a single custom PBUF_REF pbuf over the buffer, which is reused once
+ * that pbuf is freed. Needs LWIP_SUPPORT_CUSTOM_PBUF.
+ */
+#if !defined IP_REASS_CONTIGUOUS || defined __DOXYGEN__
+#define IP_REASS_CONTIGUOUS             0
+#endif
+
+/**
+ * IP_REASS_CONTIGUOUS_BUFS: the number of datagrams IP_REASS_CONTIGUOUS reassembles
+ * at once.
+ */
+#if !defined IP_REASS_CONTIGUOUS_BUFS || defined __DOXYGEN__
+#define IP_REASS_CONTIGUOUS_BUFS        2
+#endif
+
+/**
+ * IP_REASS_CONTIGUOUS_SIZE: the largest datagram IP_REASS_CONTIGUOUS reassembles, in
+ * bytes after the IP header, a multiple of 8. A fragment that reaches past it drops
+ * its datagram at once. The default is 8 KB of UDP payload and the UDP header.
+ */
+#if !defined IP_REASS_CONTIGUOUS_SIZE || defined __DOXYGEN__
+#define IP_REASS_CONTIGUOUS_SIZE        (8192 + 8)
+#endif
+
+/**
+ * IP_REASS_EARLY_DROP_MS: with IP_REASS_CONTIGUOUS, a datagram that has had no
+ * fragment for this many ms gives up its buffer when a new datagram needs one and
+ * none is free. Fragments of one datagram arrive back to back (one every 1.2 ms even
+ * at 10 Mbit/s), so it has lost one. A datagram that is still filling keeps its
+ * buffer and the new one is dropped, along with the rest of its fragments.
+ * IP_REASS_MAXAGE still frees buffers that no new datagram asks for.
+ */
+#if !defined IP_REASS_EARLY_DROP_MS || defined __DOXYGEN__
+#define IP_REASS_EARLY_DROP_MS          2
+#endif
+
 /**
  * IP_DEFAULT_TTL: Default value for Time-To-Live used by transport layers.
  */
@@ -1187,6 +1257,27 @@
 #define LWIP_UDPLITE                    0
 #endif
 
+/**
+ * LWIP_UDP_PCB_HASH==1: udp_input() looks the pcbs of an incoming datagram up
+ * in a hash table of udp_pcbs keyed over the local port instead of searching
+ * the whole list. Each bucket keeps the order of udp_pcbs, so the connected pcb
+ * that matches fully and else the first unconnected one that matches still get
+ * the datagram; udp_pcbs is no longer moved to front. The table is kept by
+ * udp_bind(), udp_connect() and udp_remove(). Costs one pointer per udp pcb and
+ * UDP_PCB_HASH_SIZE pointers, pays off with many bound pcbs.
+ */
+#if !defined LWIP_UDP_PCB_HASH || defined __DOXYGEN__
+#define LWIP_UDP_PCB_HASH               0
+#endif
+
+/**
+ * UDP_PCB_HASH_SIZE: the number of buckets in the table of LWIP_UDP_PCB_HASH,
+ * a power of 2. The bucket of a port is its low bits.
+ */
+#if !defined UDP_PCB_HASH_SIZE || defined __DOXYGEN__
+#define UDP_PCB_HASH_SIZE               16
+#endif
+
 /**
  * UDP_TTL: Default Time-To-Live value.
  */
@@ -1470,6 +1561,36 @@
 #define TCP_RCV_SCALE                   0
 #endif
 
+/**
+ * LWIP_TCP_RCV_AUTOTUNE==1: a connection starts with a receive window of
+ * TCP_RCV_AUTOTUNE_INIT_WND and grows it up to TCP_WND with the data that
+ * arrives per round trip, as measured by the receiver: the window is kept at
+ * twice that while the window is what holds the sender back. The growth of all
+ * connections together is bounded by TCP_RCV_AUTOTUNE_BUDGET and returned when
+ * a connection stops receiving (tcp_pcb_purge()). With LWIP_WND_SCALE the window
+ * can grow beyond 64 KB when the peer scales too.
+ */
+#if !defined LWIP_TCP_RCV_AUTOTUNE || defined __DOXYGEN__
+#define LWIP_TCP_RCV_AUTOTUNE           0
+#endif
+
+/**
+ * TCP_RCV_AUTOTUNE_INIT_WND: the receive window a connection starts with when
+ * LWIP_TCP_RCV_AUTOTUNE is enabled, at most 64 KB and TCP_WND.
+ */
+#if !defined TCP_RCV_AUTOTUNE_INIT_WND || defined __DOXYGEN__
+#define TCP_RCV_AUTOTUNE_INIT_WND       LWIP_MIN(TCP_WND, 4 * TCP_MSS)
+#endif
+
+/**
+ * TCP_RCV_AUTOTUNE_BUDGET: the bytes of receive window all connections together
+ * may grow beyond TCP_RCV_AUTOTUNE_INIT_WND. The received data a window lets in
+ * ends up in PBUF_POOL pbufs, so this is what the pool can spare for it.
+ */
+#if !defined TCP_RCV_AUTOTUNE_BUDGET || defined __DOXYGEN__
+#define TCP_RCV_AUTOTUNE_BUDGET         (TCP_WND - TCP_RCV_AUTOTUNE_INIT_WND)
+#endif
+
 /**
  * LWIP_TCP_PCB_NUM_EXT_ARGS:
  * When this is > 0, every tcp pcb (including listen pcb) includes a number of
@@ -1479,6 +1600,136 @@
 #define LWIP_TCP_PCB_NUM_EXT_ARGS       0
 #endif
 
+/**
+ * LWIP_TCP_PCB_HASH==1: tcp_input() looks the pcb of an incoming segment up in
+ * a hash table of the active pcbs, keyed over remote ip, remote port and local
+ * port, instead of searching tcp_active_pcbs. The table is kept by TCP_REG and
+ * TCP_RMV, the lists stay as they are for the timers. Costs one pointer per tcp
+ * pcb and TCP_PCB_HASH_SIZE pointers, pays off with many connections.
+ */
+#if !defined LWIP_TCP_PCB_HASH || defined __DOXYGEN__
+#define LWIP_TCP_PCB_HASH               0
+#endif
+
+/**
+ * TCP_PCB_HASH_SIZE: the number of buckets in the table of LWIP_TCP_PCB_HASH,
+ * a power of 2. One per active pcb keeps the chains short.
+ */
+#if !defined TCP_PCB_HASH_SIZE || defined __DOXYGEN__
+#define TCP_PCB_HASH_SIZE               16
+#endif
+
+/**
+ * LWIP_TCP_OUTPUT_BATCH==1: between tcp_output_batch_begin() and
+ * tcp_output_batch_end() tcp_output() only notes the pcb, and
+ * tcp_output_batch_end() outputs each noted pcb once. A netif driver brackets
+ * the frames of one RX pass with them, so the ACKs and segments that tcp_input()
+ * and the callbacks of a burst would send one frame at a time go out together
+ * after it: one ACK for the burst. A pcb with out of order data queued outputs
+ * at once, so every segment after a loss still gets its duplicate ACK.
+ */
+#if !defined LWIP_TCP_OUTPUT_BATCH || defined __DOXYGEN__
+#define LWIP_TCP_OUTPUT_BATCH           0
+#endif
+
+/**
+ * LWIP_TCP_TIME_WAIT_MAX: when > 0, at most this many pcbs are kept in
+ * TIME_WAIT. A connection entering TIME_WAIT with the list full frees the
+ * oldest one first, so a server that closes first leaves pcbs free for new
+ * connections instead of waiting for tcp_alloc() to run out. 0 keeps every
+ * pcb for its 2 * TCP_MSL.
+ */
+#if !defined LWIP_TCP_TIME_WAIT_MAX || defined __DOXYGEN__
+#define LWIP_TCP_TIME_WAIT_MAX          0
+#endif
+
+/**
+ * LWIP_TCP_TIME_WAIT_RECYCLE==1: a SYN for a pcb in TIME_WAIT whose sequence
+ * number is above everything received on the old connection frees that pcb
+ * and goes to the listener, as RFC 1122 4.2.2.13 allows, instead of being
+ * answered with an ACK or a RST. A client that reuses its ports quickly, or a
+ * NAT in front of many of them, then connects at once.
+ */
+#if !defined LWIP_TCP_TIME_WAIT_RECYCLE || defined __DOXYGEN__
+#define LWIP_TCP_TIME_WAIT_RECYCLE      0
+#endif
+
+/**
+ * LWIP_TCP_CC==1: the congestion window is updated through the struct
+ * tcp_cc_ops of each pcb, called on ACKs of new data, on a fast retransmit and
+ * on a retransmission timeout, and chosen per pcb with tcp_set_cc(). lwIP has
+ * tcp_cc_newreno, the RFC 5681/3465 updates lwIP makes without this option, and
+ * tcp_cc_ledbat, which keeps the queueing delay it adds to the path near
+ * TCP_CC_LEDBAT_TARGET_MS and gives way to other traffic (RFC 6817, from round
+ * trip times). Fast recovery itself stays in tcp_in.c.
+ */
+#if !defined LWIP_TCP_CC || defined __DOXYGEN__
+#define LWIP_TCP_CC                     0
+#endif
+
+/**
+ * TCP_CC_DEFAULT: the congestion control of new pcbs when LWIP_TCP_CC is
+ * enabled.
+ */
+#if !defined TCP_CC_DEFAULT || defined __DOXYGEN__
+#define TCP_CC_DEFAULT                  (&tcp_cc_newreno)
+#endif
+
+/**
+ * TCP_CC_LEDBAT_TARGET_MS: the queueing delay tcp_cc_ledbat aims for, the
+ * round trip above the lowest one seen, in ms. RFC 6817 allows up to 100.
+ */
+#if !defined TCP_CC_LEDBAT_TARGET_MS || defined __DOXYGEN__
+#define TCP_CC_LEDBAT_TARGET_MS         25
+#endif
+
+/**
+ * TCP_CC_LEDBAT_BASE_MS: how long the lowest round trip seen is kept by
+ * tcp_cc_ledbat, in ms. The base is the lowest of this period and the last one,
+ * so it follows a route that got longer within two periods.
+ */
+#if !defined TCP_CC_LEDBAT_BASE_MS || defined __DOXYGEN__
+#define TCP_CC_LEDBAT_BASE_MS           60000
+#endif
+
+/**
+ * LWIP_TCP_MEM_SHARE==1: each pcb accounts the pbufs it delivered to the
+ * application that are not tcp_recved() yet, and holds at most its share of
+ * TCP_MEM_SHARE_RX_PBUFS: that many divided by the active pcbs without a cap of
+ * their own, or the cap of tcp_set_mem_limit(). A pcb at its share announces a
+ * zero window and drops the data segments that would take it over with an
+ * ACK, until the application freed half of the share. tcp_write() refuses with ERR_MEM while a pcb queues its share of
+ * TCP_MEM_SHARE_TX_PBUFS or more. One connection whose application stops
+ * reading can then no longer take every pbuf of the others.
+ */
+#if !defined LWIP_TCP_MEM_SHARE || defined __DOXYGEN__
+#define LWIP_TCP_MEM_SHARE              0
+#endif
+
+/**
+ * TCP_MEM_SHARE_RX_PBUFS: the pbufs the pcbs share for received data when
+ * LWIP_TCP_MEM_SHARE is enabled, the pool incoming frames are taken from.
+ */
+#if !defined TCP_MEM_SHARE_RX_PBUFS || defined __DOXYGEN__
+#define TCP_MEM_SHARE_RX_PBUFS          PBUF_POOL_SIZE
+#endif
+
+/**
+ * TCP_MEM_SHARE_TX_PBUFS: the pbufs the pcbs share for their send queues when
+ * LWIP_TCP_MEM_SHARE is enabled, counted as in snd_queuelen.
+ */
+#if !defined TCP_MEM_SHARE_TX_PBUFS || defined __DOXYGEN__
+#define TCP_MEM_SHARE_TX_PBUFS          MEMP_NUM_TCP_SEG
+#endif
+
+/**
+ * TCP_MEM_SHARE_MIN: the smallest share of a pcb in pbufs, however many pcbs
+ * are active.
+ */
+#if !defined TCP_MEM_SHARE_MIN || defined __DOXYGEN__
+#define TCP_MEM_SHARE_MIN               2
+#endif
+
 /** LWIP_ALTCP==1: enable the altcp API.
  * altcp is an abstraction layer that prevents applications linking against the
  * tcp.h functions but provides the same functionality. It is used to e.g. add
@@ -2568,6 +2819,25 @@
 #define LWIP_ND6_NUM_DESTINATIONS       10
 #endif
 
+/**
+ * LWIP_ND6_CACHE_HASH==1: look neighbor and destination cache entries up in
+ * hash tables keyed over the IPv6 address, instead of searching all
+ * LWIP_ND6_NUM_NEIGHBORS or LWIP_ND6_NUM_DESTINATIONS entries on every packet
+ * that misses the cached entry. Costs one index per entry and
+ * 2 x LWIP_ND6_HASH_SIZE of them, pays off with large caches.
+ */
+#if !defined LWIP_ND6_CACHE_HASH || defined __DOXYGEN__
+#define LWIP_ND6_CACHE_HASH             0
+#endif
+
+/**
+ * LWIP_ND6_HASH_SIZE: the number of buckets of each LWIP_ND6_CACHE_HASH table,
+ * a power of 2. One per entry keeps the chains short.
+ */
+#if !defined LWIP_ND6_HASH_SIZE || defined __DOXYGEN__
+#define LWIP_ND6_HASH_SIZE              16
+#endif
+
 /**
  * LWIP_ND6_NUM_PREFIXES: number of entries in IPv6 on-link prefixes cache
  */
@@ -2741,6 +3011,17 @@
 #define LWIP_HOOK_FILENAME "path/to/my/lwip_hooks.h"
 #endif
 
+/**
+ * LWIP_APP_CALLBACK(call):
+ * Wraps lwIP's calls of the application's TCP callbacks (accept, sent, recv,
+ * connected, poll, err) and its UDP and raw recv callbacks, e.g. to count the
+ * time spent in them apart from lwIP's own. call is the whole statement,
+ * assignment of the result included.
+ */
+#if !defined LWIP_APP_CALLBACK || defined __DOXYGEN__
+#define LWIP_APP_CALLBACK(call)         call
+#endif
+
 /**
  * LWIP_HOOK_TCP_ISN:
  * Hook for generation of the Initial Sequence Number (ISN) for a new TCP
@@ -56,9 +56,9 @@ LWIP_MEMPOOL(TCP_SEG,        MEMP_NUM_TCP_SEG,         sizeof(struct tcp_seg),
 LWIP_MEMPOOL(ALTCP_PCB,      MEMP_NUM_ALTCP_PCB,       sizeof(struct altcp_pcb),      "ALTCP_PCB")
 #endif /* LWIP_ALTCP && LWIP_TCP */
 
-#if LWIP_IPV4 && IP_REASSEMBLY
+#if LWIP_IPV4 && IP_REASSEMBLY && !IP_REASS_CONTIGUOUS
 LWIP_MEMPOOL(REASSDATA,      MEMP_NUM_REASSDATA,       sizeof(struct ip_reassdata),   "REASSDATA")
-#endif /* LWIP_IPV4 && IP_REASSEMBLY */
+#endif /* LWIP_IPV4 && IP_REASSEMBLY && !IP_REASS_CONTIGUOUS */
 #if (IP_FRAG && !LWIP_NETIF_TX_SINGLE_PBUF) || (LWIP_IPV6 && LWIP_IPV6_FRAG)
 LWIP_MEMPOOL(FRAG_PBUF,      MEMP_NUM_FRAG_PBUF,       sizeof(struct pbuf_custom_ref),"FRAG_PBUF")
 #endif /* IP_FRAG && !LWIP_NETIF_TX_SINGLE_PBUF || (LWIP_IPV6 && LWIP_IPV6_FRAG) */
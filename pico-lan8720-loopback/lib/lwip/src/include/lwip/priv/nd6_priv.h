@@ -88,6 +88,10 @@ struct nd6_neighbor_cache_entry {
     u32_t probes_sent;
     u32_t stale_time;     /* ticks (ND6_TMR_INTERVAL) */
   } counter;
+#if LWIP_ND6_CACHE_HASH
+  /** next entry in the same bucket, as index + 1, 0 ends it */
+  u8_t hash_next;
+#endif /* LWIP_ND6_CACHE_HASH */
 };
 
 struct nd6_destination_cache_entry {
@@ -95,6 +99,10 @@ struct nd6_destination_cache_entry {
   ip6_addr_t next_hop_addr;
   u16_t pmtu;
   u32_t age;
+#if LWIP_ND6_CACHE_HASH
+  /** next entry in the same bucket, as index + 1, 0 ends it */
+  netif_addr_idx_t hash_next;
+#endif /* LWIP_ND6_CACHE_HASH */
 };
 
 struct nd6_prefix_list_entry {
@@ -86,6 +86,9 @@ void             tcp_rexmit_rto_commit(struct tcp_pcb *pcb);
 void             tcp_rexmit_rto  (struct tcp_pcb *pcb);
 void             tcp_rexmit_fast (struct tcp_pcb *pcb);
 u32_t            tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb);
+#if LWIP_TCP_RCV_AUTOTUNE
+void             tcp_rcv_autotune(struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
 err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
 
 /**
@@ -187,21 +190,21 @@ err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
 #define TCP_EVENT_ACCEPT(lpcb,pcb,arg,err,ret)                 \
   do {                                                         \
     if((lpcb)->accept != NULL)                                 \
-      (ret) = (lpcb)->accept((arg),(pcb),(err));               \
+      LWIP_APP_CALLBACK((ret) = (lpcb)->accept((arg),(pcb),(err))); \
     else (ret) = ERR_ARG;                                      \
   } while (0)
 
 #define TCP_EVENT_SENT(pcb,space,ret)                          \
   do {                                                         \
     if((pcb)->sent != NULL)                                    \
-      (ret) = (pcb)->sent((pcb)->callback_arg,(pcb),(space));  \
+      LWIP_APP_CALLBACK((ret) = (pcb)->sent((pcb)->callback_arg,(pcb),(space))); \
     else (ret) = ERR_OK;                                       \
   } while (0)
 
 #define TCP_EVENT_RECV(pcb,p,err,ret)                          \
   do {                                                         \
     if((pcb)->recv != NULL) {                                  \
-      (ret) = (pcb)->recv((pcb)->callback_arg,(pcb),(p),(err));\
+      LWIP_APP_CALLBACK((ret) = (pcb)->recv((pcb)->callback_arg,(pcb),(p),(err))); \
     } else {                                                   \
       (ret) = tcp_recv_null(NULL, (pcb), (p), (err));          \
     }                                                          \
@@ -210,7 +213,7 @@ err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
 #define TCP_EVENT_CLOSED(pcb,ret)                                \
   do {                                                           \
     if(((pcb)->recv != NULL)) {                                  \
-      (ret) = (pcb)->recv((pcb)->callback_arg,(pcb),NULL,ERR_OK);\
+      LWIP_APP_CALLBACK((ret) = (pcb)->recv((pcb)->callback_arg,(pcb),NULL,ERR_OK)); \
     } else {                                                     \
       (ret) = ERR_OK;                                            \
     }                                                            \
@@ -219,14 +222,14 @@ err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
 #define TCP_EVENT_CONNECTED(pcb,err,ret)                         \
   do {                                                           \
     if((pcb)->connected != NULL)                                 \
-      (ret) = (pcb)->connected((pcb)->callback_arg,(pcb),(err)); \
+      LWIP_APP_CALLBACK((ret) = (pcb)->connected((pcb)->callback_arg,(pcb),(err))); \
     else (ret) = ERR_OK;                                         \
   } while (0)
 
 #define TCP_EVENT_POLL(pcb,ret)                                \
   do {                                                         \
     if((pcb)->poll != NULL)                                    \
-      (ret) = (pcb)->poll((pcb)->callback_arg,(pcb));          \
+      LWIP_APP_CALLBACK((ret) = (pcb)->poll((pcb)->callback_arg,(pcb))); \
     else (ret) = ERR_OK;                                       \
   } while (0)
 
@@ -234,7 +237,7 @@ err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
   do {                                                         \
     LWIP_UNUSED_ARG(last_state);                               \
     if((errf) != NULL)                                         \
-      (errf)((arg),(err));                                     \
+      LWIP_APP_CALLBACK((errf)((arg),(err)));                  \
   } while (0)
 
 #endif /* LWIP_EVENT_API */
@@ -325,6 +328,9 @@ struct tcp_seg {
 /* Global variables: */
 extern struct tcp_pcb *tcp_input_pcb;
 extern u32_t tcp_ticks;
+#if LWIP_TCP_RCV_AUTOTUNE
+extern u32_t tcp_rcv_autotune_used;
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
 extern u8_t tcp_active_pcbs_changed;
 
 /* The TCP PCB lists. */
@@ -343,6 +349,78 @@ extern struct tcp_pcb *tcp_tw_pcbs;      /* List of all TCP PCBs in TIME-WAIT. *
 #define NUM_TCP_PCB_LISTS               4
 extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
 
+#if LWIP_TCP_PCB_HASH
+/* The pcbs of tcp_active_pcbs again, chained by hash_next in the bucket of
+   tcp_pcb_hash(), for tcp_input(). TCP_REG and TCP_RMV keep it in step with
+   the list. */
+extern struct tcp_pcb *tcp_active_pcbs_hash[TCP_PCB_HASH_SIZE];
+
+u16_t tcp_pcb_hash(const ip_addr_t *remote_ip, u16_t remote_port, u16_t local_port);
+void tcp_pcb_hash_add(struct tcp_pcb *pcb);
+void tcp_pcb_hash_remove(struct tcp_pcb *pcb);
+
+#define TCP_REG_HASH(pcbs, npcb)                   \
+  do {                                             \
+    if ((pcbs) == &tcp_active_pcbs) {              \
+      tcp_pcb_hash_add(npcb);                      \
+    }                                              \
+  } while (0)
+
+#define TCP_RMV_HASH(pcbs, npcb)                   \
+  do {                                             \
+    if ((pcbs) == &tcp_active_pcbs) {              \
+      tcp_pcb_hash_remove(npcb);                   \
+    }                                              \
+  } while (0)
+#else /* LWIP_TCP_PCB_HASH */
+#define TCP_REG_HASH(pcbs, npcb)
+#define TCP_RMV_HASH(pcbs, npcb)
+#endif /* LWIP_TCP_PCB_HASH */
+
+#if LWIP_TCP_MEM_SHARE
+/* The pcbs of tcp_active_pcbs without a cap of their own, the pbufs are shared
+   among them. TCP_REG, TCP_RMV and tcp_set_mem_limit() count them. */
+extern u16_t tcp_mem_rx_pcbs;
+extern u16_t tcp_mem_tx_pcbs;
+
+void tcp_mem_rx_charge(struct tcp_pcb *pcb, const struct pbuf *p);
+u8_t tcp_mem_rx_over(struct tcp_pcb *pcb, const struct pbuf *p);
+u8_t tcp_mem_tx_over(struct tcp_pcb *pcb);
+
+#define TCP_REG_MEM(pcbs, npcb)                    \
+  do {                                             \
+    if ((pcbs) == &tcp_active_pcbs) {              \
+      tcp_mem_rx_pcbs += ((npcb)->mem_rx_max == 0);\
+      tcp_mem_tx_pcbs += ((npcb)->mem_tx_max == 0);\
+    }                                              \
+  } while (0)
+
+#define TCP_RMV_MEM(pcbs, npcb)                    \
+  do {                                             \
+    if ((pcbs) == &tcp_active_pcbs) {              \
+      tcp_mem_rx_pcbs -= ((npcb)->mem_rx_max == 0);\
+      tcp_mem_tx_pcbs -= ((npcb)->mem_tx_max == 0);\
+    }                                              \
+  } while (0)
+#else /* LWIP_TCP_MEM_SHARE */
+#define TCP_REG_MEM(pcbs, npcb)
+#define TCP_RMV_MEM(pcbs, npcb)
+#endif /* LWIP_TCP_MEM_SHARE */
+
+#if LWIP_TCP_OUTPUT_BATCH
+/* takes a pcb that is freed off the batch of tcp_output_batch_end() */
+void tcp_output_batch_remove(struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_OUTPUT_BATCH */
+
+#if LWIP_TCP_TIME_WAIT_MAX
+/* frees the oldest TIME_WAIT pcb when LWIP_TCP_TIME_WAIT_MAX of them are kept,
+   called before another pcb enters TIME_WAIT */
+void tcp_timewait_limit(void);
+#define TCP_TIME_WAIT_LIMIT() tcp_timewait_limit()
+#else /* LWIP_TCP_TIME_WAIT_MAX */
+#define TCP_TIME_WAIT_LIMIT()
+#endif /* LWIP_TCP_TIME_WAIT_MAX */
+
 /* Axioms about the above lists:
    1) Every TCP PCB that is not CLOSED is in one of the lists.
    2) A PCB is only in one of the lists.
@@ -367,6 +445,8 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                             (npcb)->next = *(pcbs); \
                             LWIP_ASSERT("TCP_REG: npcb->next != npcb", (npcb)->next != (npcb)); \
                             *(pcbs) = (npcb); \
+                            TCP_REG_HASH(pcbs, npcb); \
+                            TCP_REG_MEM(pcbs, npcb); \
                             LWIP_ASSERT("TCP_REG: tcp_pcbs sane", tcp_pcbs_sane()); \
               tcp_timer_needed(); \
                             } while(0)
@@ -383,6 +463,8 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                                } \
                             } \
                             (npcb)->next = NULL; \
+                            TCP_RMV_HASH(pcbs, npcb); \
+                            TCP_RMV_MEM(pcbs, npcb); \
                             LWIP_ASSERT("TCP_RMV: tcp_pcbs sane", tcp_pcbs_sane()); \
                             LWIP_DEBUGF(TCP_DEBUG, ("TCP_RMV: removed %p from %p\n", (void *)(npcb), (void *)(*(pcbs)))); \
                             } while(0)
@@ -393,6 +475,8 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
   do {                                             \
     (npcb)->next = *pcbs;                          \
     *(pcbs) = (npcb);                              \
+    TCP_REG_HASH(pcbs, npcb);                      \
+    TCP_REG_MEM(pcbs, npcb);                       \
     tcp_timer_needed();                            \
   } while (0)
 
@@ -413,6 +497,8 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
       }                                            \
     }                                              \
     (npcb)->next = NULL;                           \
+    TCP_RMV_HASH(pcbs, npcb);                      \
+    TCP_RMV_MEM(pcbs, npcb);                       \
   } while(0)
 
 #endif /* LWIP_DEBUG */
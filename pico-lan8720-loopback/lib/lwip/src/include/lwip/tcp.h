@@ -137,12 +137,21 @@ typedef err_t (*tcp_connected_fn)(void *arg, struct tcp_pcb *tpcb, err_t err);
 #define RCV_WND_SCALE(pcb, wnd) (((wnd) >> (pcb)->rcv_scale))
 #define SND_WND_SCALE(pcb, wnd) (((wnd) << (pcb)->snd_scale))
 #define TCPWND16(x)             ((u16_t)LWIP_MIN((x), 0xFFFF))
-#define TCP_WND_MAX(pcb)        ((tcpwnd_size_t)(((pcb)->flags & TF_WND_SCALE) ? TCP_WND : TCPWND16(TCP_WND)))
 #else
 #define RCV_WND_SCALE(pcb, wnd) (wnd)
 #define SND_WND_SCALE(pcb, wnd) (wnd)
 #define TCPWND16(x)             (x)
+#endif
+#if LWIP_TCP_RCV_AUTOTUNE
+/* every pcb grows its own window from TCP_RCV_AUTOTUNE_INIT_WND */
+#define TCP_WND_MAX(pcb)        ((pcb)->rcv_wnd_max)
+#define TCP_RCV_WND_INIT        TCP_RCV_AUTOTUNE_INIT_WND
+#elif LWIP_WND_SCALE
+#define TCP_WND_MAX(pcb)        ((tcpwnd_size_t)(((pcb)->flags & TF_WND_SCALE) ? TCP_WND : TCPWND16(TCP_WND)))
+#define TCP_RCV_WND_INIT        TCP_WND
+#else
 #define TCP_WND_MAX(pcb)        TCP_WND
+#define TCP_RCV_WND_INIT        TCP_WND
 #endif
 /* Increments a tcpwnd_size_t and holds at max value rather than rollover */
 #define TCP_WND_INC(wnd, inc)   do { \
@@ -153,6 +162,30 @@ typedef err_t (*tcp_connected_fn)(void *arg, struct tcp_pcb *tpcb, err_t err);
                                   } \
                                 } while(0)
 
+#if LWIP_TCP_CC
+/** Congestion control of a pcb, see LWIP_TCP_CC and tcp_set_cc(). The
+ * functions update pcb->cwnd and pcb->ssthresh. */
+struct tcp_cc_ops {
+  /** for debug output and the host benches */
+  const char *name;
+  /** optional, called by tcp_set_cc() to reset the algorithm's state */
+  void (*init)(struct tcp_pcb *pcb);
+  /** an ACK of new data in ESTABLISHED or later, acked bytes of it, with a round
+   * trip sample in ms (at least 1) when it acked the segment being timed, 0 when
+   * not. Also the ACK that ends fast recovery, after cwnd went back to ssthresh */
+  void (*ack)(struct tcp_pcb *pcb, tcpwnd_size_t acked, u32_t rtt_ms);
+  /** three duplicate ACKs, the first unacked segment was retransmitted: sets
+   * ssthresh and the cwnd fast recovery starts with. Further duplicates inflate
+   * it by a MSS each, the end of recovery sets it to ssthresh */
+  void (*loss)(struct tcp_pcb *pcb);
+  /** a retransmission timeout, before the first unacked segment goes again */
+  void (*rto)(struct tcp_pcb *pcb);
+};
+
+extern const struct tcp_cc_ops tcp_cc_newreno;
+extern const struct tcp_cc_ops tcp_cc_ledbat;
+#endif /* LWIP_TCP_CC */
+
 #if LWIP_TCP_SACK_OUT
 /** SACK ranges to include in ACK packets.
  * SACK entry is invalid if left==right. */
@@ -245,6 +278,15 @@ struct tcp_pcb {
 /** protocol specific PCB members */
   TCP_PCB_COMMON(struct tcp_pcb);
 
+#if LWIP_TCP_PCB_HASH
+  /* next pcb in the same bucket of tcp_active_pcbs_hash */
+  struct tcp_pcb *hash_next;
+#endif /* LWIP_TCP_PCB_HASH */
+#if LWIP_TCP_OUTPUT_BATCH
+  /* next pcb noted for output by the batch, while TF_BATCHED */
+  struct tcp_pcb *batch_next;
+#endif /* LWIP_TCP_OUTPUT_BATCH */
+
   /* ports are in host byte order */
   u16_t remote_port;
 
@@ -269,6 +311,9 @@ struct tcp_pcb {
 #define TF_RTO         0x0800U /* RTO timer has fired, in-flight data moved to unsent and being retransmitted */
 #if LWIP_TCP_SACK_OUT
 #define TF_SACK        0x1000U /* Selective ACKs enabled */
+#endif
+#if LWIP_TCP_OUTPUT_BATCH
+#define TF_BATCHED     0x2000U /* tcp_output() was deferred to tcp_output_batch_end() */
 #endif
 
   /* the rest of the fields are in host byte order
@@ -284,6 +329,20 @@ struct tcp_pcb {
   tcpwnd_size_t rcv_wnd;   /* receiver window available */
   tcpwnd_size_t rcv_ann_wnd; /* receiver window to announce */
   u32_t rcv_ann_right_edge; /* announced right edge of window */
+#if LWIP_TCP_RCV_AUTOTUNE
+  tcpwnd_size_t rcv_wnd_max; /* receiver window grown to, TCP_WND_MAX() */
+  tcpwnd_size_t rcv_tune_wnd; /* window of the period measured, 0 before the first */
+  u32_t rcv_tune_seq;  /* rcv_nxt at its start */
+  u32_t rcv_tune_time; /* sys_now() at its start, or of the SYN */
+  u16_t rcv_tune_rtt;  /* round trip time in ms */
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+#if LWIP_TCP_MEM_SHARE
+  u32_t mem_rx_bytes;  /* bytes delivered to the application, not tcp_recved() yet */
+  u16_t mem_rx_pbufs;  /* the pbufs they came in */
+  u16_t mem_rx_max;    /* cap of tcp_set_mem_limit(), 0 for the share */
+  u16_t mem_tx_max;    /* of snd_queuelen, the same */
+  u8_t mem_rx_closed;  /* the window is closed, the pcb holds its share */
+#endif /* LWIP_TCP_MEM_SHARE */
 
 #if LWIP_TCP_SACK_OUT
   /* SACK ranges to include in ACK packets (entry is invalid if left==right) */
@@ -311,6 +370,14 @@ struct tcp_pcb {
   /* congestion avoidance/control variables */
   tcpwnd_size_t cwnd;
   tcpwnd_size_t ssthresh;
+#if LWIP_TCP_CC
+  const struct tcp_cc_ops *cc;
+  u32_t rttest_ms;     /* sys_now() when rtseq was sent */
+  u32_t cc_base_time;  /* sys_now() the current base period started */
+  u16_t cc_base_last;  /* lowest round trip of the last period in ms, 0 for none */
+  u16_t cc_base_cur;   /* of the current one */
+  u16_t cc_delay;      /* queueing delay of the last sample in ms */
+#endif /* LWIP_TCP_CC */
 
   /* first byte following last rto byte */
   u32_t rto_end;
@@ -477,6 +544,36 @@ void             tcp_setprio (struct tcp_pcb *pcb, u8_t prio);
 
 err_t            tcp_output  (struct tcp_pcb *pcb);
 
+#if LWIP_TCP_CC
+void             tcp_set_cc  (struct tcp_pcb *pcb, const struct tcp_cc_ops *cc);
+#endif /* LWIP_TCP_CC */
+
+#if LWIP_TCP_MEM_SHARE
+/** What the pcbs hold of the pbufs they share, see LWIP_TCP_MEM_SHARE and
+ * tcp_mem_get_stats() */
+struct tcp_mem_stats {
+  u16_t rx_pcbs;      /* pcbs the pbufs for received data are shared among */
+  u16_t tx_pcbs;      /* and those of the send queues */
+  u16_t rx_share;     /* pbufs a pcb without a cap of its own may hold now */
+  u16_t tx_share;     /* and queue to send */
+  u16_t rx_pbufs;     /* pbufs the applications hold, not tcp_recved() yet */
+  u32_t rx_closed;    /* windows closed, their pcb held its share */
+  u32_t rx_dropped;   /* data segments dropped, their pcb held its share */
+  u32_t tx_refused;   /* tcp_write() calls refused, their pcb queued its share */
+};
+
+void             tcp_set_mem_limit(struct tcp_pcb *pcb, u16_t rx_pbufs, u16_t tx_pbufs);
+void             tcp_mem_get_stats(struct tcp_mem_stats *stats);
+/** @ingroup tcp_raw
+ * pbufs the application holds of a pcb, delivered and not tcp_recved() yet */
+#define          tcp_mem_rx_pbufs(pcb) ((pcb)->mem_rx_pbufs)
+#endif /* LWIP_TCP_MEM_SHARE */
+
+#if LWIP_TCP_OUTPUT_BATCH
+void             tcp_output_batch_begin(void);
+void             tcp_output_batch_end  (void);
+#endif /* LWIP_TCP_OUTPUT_BATCH */
+
 err_t            tcp_tcp_get_tcp_addrinfo(struct tcp_pcb *pcb, int local, ip_addr_t *addr, u16_t *port);
 
 #define tcp_dbg_get_tcp_state(pcb) ((pcb)->state)
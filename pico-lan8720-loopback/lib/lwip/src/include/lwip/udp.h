@@ -85,6 +85,10 @@ struct udp_pcb {
 /* Protocol specific PCB members */
 
   struct udp_pcb *next;
+#if LWIP_UDP_PCB_HASH
+  /* next pcb in the same bucket of udp_pcbs_hash */
+  struct udp_pcb *hash_next;
+#endif /* LWIP_UDP_PCB_HASH */
 
   u8_t flags;
   /** ports are in host byte order */
@@ -0,0 +1,312 @@
+# lwIP 2.1 of lib/lwip with the ports and options of src/lwip, as the INTERFACE library
+# pico_lwip. Included from this project and from pico-w5100s-loopback, whose MACRAW netif
+# runs the same stack
+
+set(LWIP_PATH ${CMAKE_CURRENT_LIST_DIR}/lib/lwip)
+
+add_library(pico_lwip INTERFACE)
+
+target_sources(pico_lwip INTERFACE
+    ${LWIP_PATH}/src/core/altcp.c
+    ${LWIP_PATH}/src/core/altcp_alloc.c
+    ${LWIP_PATH}/src/core/altcp_tcp.c
+    ${LWIP_PATH}/src/core/def.c
+    ${LWIP_PATH}/src/core/dns.c
+    ${LWIP_PATH}/src/core/inet_chksum.c
+    ${LWIP_PATH}/src/core/init.c
+    ${LWIP_PATH}/src/core/ip.c
+    ${LWIP_PATH}/src/core/netif.c
+    ${LWIP_PATH}/src/core/raw.c
+    ${LWIP_PATH}/src/core/stats.c
+    ${LWIP_PATH}/src/core/sys.c
+    ${LWIP_PATH}/src/core/tcp.c
+    ${LWIP_PATH}/src/core/tcp_in.c
+    ${LWIP_PATH}/src/core/tcp_out.c
+    ${LWIP_PATH}/src/core/udp.c
+    ${LWIP_PATH}/src/core/ipv4/autoip.c
+    ${LWIP_PATH}/src/core/ipv4/dhcp.c
+    ${LWIP_PATH}/src/core/ipv4/etharp.c
+    ${LWIP_PATH}/src/core/ipv4/icmp.c
+    ${LWIP_PATH}/src/core/ipv4/igmp.c
+    ${LWIP_PATH}/src/core/ipv4/ip4.c
+    ${LWIP_PATH}/src/core/ipv4/ip4_addr.c
+    ${LWIP_PATH}/src/core/ipv4/ip4_frag.c
+    ${LWIP_PATH}/src/core/ipv6/dhcp6.c
+    ${LWIP_PATH}/src/core/ipv6/ethip6.c
+    ${LWIP_PATH}/src/core/ipv6/icmp6.c
+    ${LWIP_PATH}/src/core/ipv6/inet6.c
+    ${LWIP_PATH}/src/core/ipv6/ip6.c
+    ${LWIP_PATH}/src/core/ipv6/ip6_addr.c
+    ${LWIP_PATH}/src/core/ipv6/ip6_frag.c
+    ${LWIP_PATH}/src/core/ipv6/mld6.c
+    ${LWIP_PATH}/src/core/ipv6/nd6.c
+    ${LWIP_PATH}/src/netif/ethernet.c
+    ${LWIP_PATH}/src/netif/bridgeif.c
+    ${LWIP_PATH}/src/netif/bridgeif_fdb.c
+
+    ${LWIP_PATH}/src/apps/http/httpd.c
+    ${LWIP_PATH}/src/apps/http/fs.c
+
+    ${LWIP_PATH}/src/apps/lwiperf/lwiperf.c
+
+    ${LWIP_PATH}/src/apps/mqtt/mqtt.c
+
+    ${LWIP_PATH}/src/apps/mdns/mdns.c
+
+    ${LWIP_PATH}/src/apps/tftp/tftp_server.c
+
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_arena.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_chksum.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_chksum_m0plus.S
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_chksum_m33.S
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_lro.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_mem.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_ota.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_post_flash.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_memp.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_metrics.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_pbuf.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_prober.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_tcp_writer.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_telemetry.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_timeouts.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_tlsf.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_udp_flow.c
+)
+
+if (PICO_LWIP_FREERTOS)
+    target_sources(pico_lwip INTERFACE
+        ${LWIP_PATH}/src/api/api_lib.c
+        ${LWIP_PATH}/src/api/api_msg.c
+        ${LWIP_PATH}/src/api/err.c
+        ${LWIP_PATH}/src/api/if_api.c
+        ${LWIP_PATH}/src/api/netbuf.c
+        ${LWIP_PATH}/src/api/netdb.c
+        ${LWIP_PATH}/src/api/netifapi.c
+        ${LWIP_PATH}/src/api/sockets.c
+        ${LWIP_PATH}/src/api/tcpip.c
+
+        ${CMAKE_CURRENT_LIST_DIR}/src/lwip/sys_arch_freertos.c
+    )
+
+    # FreeRTOSConfig.h comes from the application, see examples/freertos_socket
+    target_compile_definitions(pico_lwip INTERFACE NO_SYS=0)
+    target_link_libraries(pico_lwip INTERFACE FreeRTOS-Kernel FreeRTOS-Kernel-Heap4)
+else()
+    target_sources(pico_lwip INTERFACE
+        ${CMAKE_CURRENT_LIST_DIR}/src/lwip/sys_arch.c
+    )
+endif()
+
+# lwipopts.h memory/throughput profile
+set(PICO_LWIP_PROFILE "balanced" CACHE STRING "lwIP profile: low_mem, balanced, throughput, high_loss or conn_rate")
+
+set(PICO_LWIP_PROFILES low_mem balanced throughput high_loss conn_rate)
+set_property(CACHE PICO_LWIP_PROFILE PROPERTY STRINGS ${PICO_LWIP_PROFILES})
+
+if (NOT PICO_LWIP_PROFILE IN_LIST PICO_LWIP_PROFILES)
+    message(FATAL_ERROR "PICO_LWIP_PROFILE must be one of: ${PICO_LWIP_PROFILES}")
+endif()
+
+string(TOUPPER ${PICO_LWIP_PROFILE} PICO_LWIP_PROFILE_NAME)
+target_compile_definitions(pico_lwip INTERFACE PICO_LWIP_PROFILE=PICO_LWIP_PROFILE_${PICO_LWIP_PROFILE_NAME})
+
+# hashed demultiplexing of TCP segments to their pcb, see src/lwip/lwipopts.h
+option(PICO_LWIP_TCP_PCB_HASH "Look up the pcb of incoming TCP segments in a hash table" OFF)
+
+if (PICO_LWIP_TCP_PCB_HASH)
+    target_compile_definitions(pico_lwip INTERFACE LWIP_TCP_PCB_HASH=1)
+endif()
+
+# hashed demultiplexing of UDP datagrams to their pcb, see src/lwip/lwipopts.h
+option(PICO_LWIP_UDP_PCB_HASH "Look up the pcbs of incoming UDP datagrams in a hash table" OFF)
+
+if (PICO_LWIP_UDP_PCB_HASH)
+    target_compile_definitions(pico_lwip INTERFACE LWIP_UDP_PCB_HASH=1)
+endif()
+
+# TCP output deferred to the end of each RX pass, see src/lwip/lwipopts.h
+option(PICO_LWIP_TCP_OUTPUT_BATCH "Send what lwIP outputs for a burst of received frames after the burst" OFF)
+
+if (PICO_LWIP_TCP_OUTPUT_BATCH)
+    target_compile_definitions(pico_lwip INTERFACE LWIP_TCP_OUTPUT_BATCH=1)
+endif()
+
+# per-pcb TCP congestion control with NewReno and LEDBAT, see src/lwip/lwipopts.h
+option(PICO_LWIP_TCP_CC "Pick the TCP congestion control per connection, NewReno or LEDBAT" OFF)
+
+if (PICO_LWIP_TCP_CC)
+    target_compile_definitions(pico_lwip INTERFACE LWIP_TCP_CC=1)
+endif()
+
+# per-connection shares of the pbufs for received and queued data, see src/lwip/lwipopts.h
+option(PICO_LWIP_TCP_MEM_SHARE "Hold each TCP connection to its share of the pbufs" OFF)
+
+if (PICO_LWIP_TCP_MEM_SHARE)
+    target_compile_definitions(pico_lwip INTERFACE LWIP_TCP_MEM_SHARE=1)
+endif()
+
+# receive window autotuning with window scaling, see src/lwip/lwipopts.h
+option(PICO_LWIP_TCP_RCV_AUTOTUNE "Grow the TCP receive window with the bandwidth-delay product" OFF)
+
+if (PICO_LWIP_TCP_RCV_AUTOTUNE)
+    target_compile_definitions(pico_lwip INTERFACE LWIP_TCP_RCV_AUTOTUNE=1)
+endif()
+
+# hashed ARP table lookups, see src/lwip/lwipopts.h
+option(PICO_LWIP_ETHARP_HASH "Look up ARP table entries in a hash table" ON)
+
+if (NOT PICO_LWIP_ETHARP_HASH)
+    target_compile_definitions(pico_lwip INTERFACE ETHARP_TABLE_HASH=0)
+endif()
+
+# dual stack IPv4 and IPv6, see src/lwip/lwipopts.h
+option(PICO_LWIP_IPV6 "Build lwIP with IPv6 next to IPv4" OFF)
+
+if (PICO_LWIP_IPV6)
+    target_compile_definitions(pico_lwip INTERFACE LWIP_IPV6=1)
+endif()
+
+# mDNS responder with cached responses, see src/lwip/lwipopts.h
+option(PICO_LWIP_MDNS "Build lwIP's mDNS responder with its response cache" ON)
+
+if (PICO_LWIP_MDNS)
+    target_compile_definitions(pico_lwip INTERFACE LWIP_MDNS_RESPONDER=1)
+endif()
+
+# 802.1Q tagging of sent frames, see src/lwip/lwipopts.h
+option(PICO_LWIP_VLAN "Build lwIP with 802.1Q VLAN tags, set by the driver" OFF)
+
+if (PICO_LWIP_VLAN)
+    target_compile_definitions(pico_lwip INTERFACE PICO_LWIP_VLAN=1)
+endif()
+
+# IP reassembly in preallocated buffers, see src/lwip/lwipopts.h
+option(PICO_LWIP_REASS_CONTIGUOUS "Reassemble IP fragments in preallocated buffers instead of pbuf chains" ON)
+
+if (NOT PICO_LWIP_REASS_CONTIGUOUS)
+    target_compile_definitions(pico_lwip INTERFACE IP_REASS_CONTIGUOUS=0)
+endif()
+
+# lwIP's heap and the driver's RX buffers carved from one arena, see src/lwip/lwipopts.h
+set(PICO_LWIP_ARENA_SIZE 0 CACHE STRING "Bytes of one arena for lwIP's heap and the RX buffers, 0 for separate arrays")
+
+if (PICO_LWIP_ARENA_SIZE)
+    target_compile_definitions(pico_lwip INTERFACE PICO_LWIP_ARENA_SIZE=${PICO_LWIP_ARENA_SIZE})
+endif()
+
+# the allocator behind mem_malloc(), see src/lwip/lwipopts.h
+set(PICO_LWIP_MEM_ALLOCATOR "first_fit" CACHE STRING "lwIP mem_malloc(): first_fit, pools or tlsf")
+
+set(PICO_LWIP_MEM_ALLOCATORS first_fit pools tlsf)
+set_property(CACHE PICO_LWIP_MEM_ALLOCATOR PROPERTY STRINGS ${PICO_LWIP_MEM_ALLOCATORS})
+
+if (NOT PICO_LWIP_MEM_ALLOCATOR IN_LIST PICO_LWIP_MEM_ALLOCATORS)
+    message(FATAL_ERROR "PICO_LWIP_MEM_ALLOCATOR must be one of: ${PICO_LWIP_MEM_ALLOCATORS}")
+endif()
+
+string(TOUPPER ${PICO_LWIP_MEM_ALLOCATOR} PICO_LWIP_MEM_ALLOCATOR_NAME)
+target_compile_definitions(pico_lwip INTERFACE PICO_LWIP_MEM_ALLOCATOR=PICO_LWIP_MEM_ALLOCATOR_${PICO_LWIP_MEM_ALLOCATOR_NAME})
+
+# lwIP's larger copies by DMA, see src/lwip/lwipopts.h
+option(PICO_LWIP_MEMCPY_DMA "Copy lwIP's MEMCPYs of 256 bytes or more by DMA" OFF)
+
+if (PICO_LWIP_MEMCPY_DMA)
+    target_sources(pico_lwip INTERFACE
+        ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_memcpy.c
+    )
+
+    target_compile_definitions(pico_lwip INTERFACE PICO_LWIP_MEMCPY_DMA=1)
+    target_link_libraries(pico_lwip INTERFACE hardware_dma)
+endif()
+
+# per core caches of PBUF_POOL elements in front of the pool's lock, see src/lwip/lwipopts.h
+option(PICO_LWIP_PBUF_CACHE "Allocate and free PBUF_POOL pbufs through a cache per core" OFF)
+
+if (PICO_LWIP_PBUF_CACHE)
+    target_compile_definitions(pico_lwip INTERFACE PICO_LWIP_PBUF_CACHE=1)
+endif()
+
+# PPP over a UART with DMA RX and TX, see src/lwip/lwip_pppos_rp2040.h
+option(PICO_LWIP_PPPOS "Build lwIP's PPP with the DMA PPPoS port" OFF)
+
+if (PICO_LWIP_PPPOS)
+    if (PICO_LWIP_FREERTOS)
+        message(FATAL_ERROR "PICO_LWIP_PPPOS is polled from a NO_SYS main loop, not with PICO_LWIP_FREERTOS")
+    endif()
+
+    target_sources(pico_lwip INTERFACE
+        ${LWIP_PATH}/src/netif/ppp/auth.c
+        ${LWIP_PATH}/src/netif/ppp/chap-md5.c
+        ${LWIP_PATH}/src/netif/ppp/chap-new.c
+        ${LWIP_PATH}/src/netif/ppp/fsm.c
+        ${LWIP_PATH}/src/netif/ppp/ipcp.c
+        ${LWIP_PATH}/src/netif/ppp/ipv6cp.c
+        ${LWIP_PATH}/src/netif/ppp/lcp.c
+        ${LWIP_PATH}/src/netif/ppp/magic.c
+        ${LWIP_PATH}/src/netif/ppp/ppp.c
+        ${LWIP_PATH}/src/netif/ppp/pppcrypt.c
+        ${LWIP_PATH}/src/netif/ppp/pppos.c
+        ${LWIP_PATH}/src/netif/ppp/upap.c
+        ${LWIP_PATH}/src/netif/ppp/utils.c
+        ${LWIP_PATH}/src/netif/ppp/vj.c
+        ${LWIP_PATH}/src/netif/ppp/polarssl/md5.c
+
+        ${CMAKE_CURRENT_LIST_DIR}/src/lwip/lwip_pppos_rp2040.c
+    )
+
+    target_compile_definitions(pico_lwip INTERFACE PPP_SUPPORT=1)
+    target_link_libraries(pico_lwip INTERFACE hardware_dma hardware_uart)
+endif()
+
+# the per frame functions of the driver and lwIP's per packet path in SRAM instead of
+# flash, see src/lwip/arch/cc.h, tools/ram_code_size.py lists them from the map
+option(PICO_RMII_HOT_IN_RAM "Run the RMII driver and lwIP fast path from SRAM" OFF)
+
+if (PICO_RMII_HOT_IN_RAM)
+    target_compile_definitions(pico_lwip INTERFACE PICO_RMII_HOT_IN_RAM=1)
+endif()
+
+# altcp_tls with the SDK's mbedTLS, session resumption and static buffers, see
+# src/lwip/mbedtls_config.h and src/lwip/altcp_tls_rp2040.h
+option(PICO_LWIP_TLS "Build altcp_tls over mbedTLS with session resumption" OFF)
+option(PICO_LWIP_TLS_OFFLOAD "Run TLS handshakes on the core that doesn't run lwIP" OFF)
+
+if (PICO_LWIP_TLS)
+    if (NOT TARGET pico_mbedtls)
+        message(FATAL_ERROR "PICO_LWIP_TLS needs the pico-sdk's pico_mbedtls, SDK 1.5 or later with lib/mbedtls checked out")
+    endif()
+
+    target_sources(pico_lwip INTERFACE
+        ${LWIP_PATH}/src/apps/altcp_tls/altcp_tls_mbedtls.c
+        ${LWIP_PATH}/src/apps/altcp_tls/altcp_tls_mbedtls_mem.c
+
+        ${CMAKE_CURRENT_LIST_DIR}/src/lwip/altcp_tls_rp2040.c
+    )
+
+    target_compile_definitions(pico_lwip INTERFACE PICO_LWIP_TLS=1 MBEDTLS_CONFIG_FILE=\"mbedtls_config.h\")
+    target_link_libraries(pico_lwip INTERFACE pico_mbedtls)
+
+    if (PICO_LWIP_TLS_OFFLOAD)
+        target_compile_definitions(pico_lwip INTERFACE PICO_LWIP_TLS_OFFLOAD=1)
+    endif()
+elseif (PICO_LWIP_TLS_OFFLOAD)
+    message(FATAL_ERROR "PICO_LWIP_TLS_OFFLOAD needs PICO_LWIP_TLS")
+endif()
+
+# sys_now()
+target_link_libraries(pico_lwip INTERFACE timebase)
+
+# RFC 6455 framing of httpd's WebSocket upgrade (LWIP_HTTPD_WEBSOCKET)
+target_link_libraries(pico_lwip INTERFACE websocket)
+
+# the compressed writes of lwip_tcp_writer_compress()
+target_link_libraries(pico_lwip INTERFACE compress)
+
+# the Prometheus text of httpd's /metrics
+target_link_libraries(pico_lwip INTERFACE metrics)
+
+target_include_directories(pico_lwip INTERFACE
+	${LWIP_PATH}/src/include
+	${CMAKE_CURRENT_LIST_DIR}/src/lwip
+)
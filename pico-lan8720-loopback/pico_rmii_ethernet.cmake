@@ -0,0 +1,25 @@
+# The PIO/DMA RMII driver of src and its lwIP netif, as the INTERFACE library
+# pico_rmii_ethernet. Included from this project and from pico-w5100s-loopback, whose
+# dual_uplink firmware runs it next to the W5100S MACRAW netif, after pico_lwip.cmake
+# and the trace and timebase libraries
+
+add_library(pico_rmii_ethernet INTERFACE)
+
+target_sources(pico_rmii_ethernet INTERFACE
+    ${CMAKE_CURRENT_LIST_DIR}/src/rmii_ethernet.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/rmii_ethernet_capture.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/rmii_ethernet_crc.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/rmii_ethernet_frame.c
+    ${CMAKE_CURRENT_LIST_DIR}/src/rmii_ethernet_profile.c
+)
+
+target_include_directories(pico_rmii_ethernet INTERFACE
+	${CMAKE_CURRENT_LIST_DIR}/src/include
+)
+
+pico_generate_pio_header(pico_rmii_ethernet ${CMAKE_CURRENT_LIST_DIR}/src/rmii_ethernet_phy_rx.pio)
+pico_generate_pio_header(pico_rmii_ethernet ${CMAKE_CURRENT_LIST_DIR}/src/rmii_ethernet_phy_tx.pio)
+pico_generate_pio_header(pico_rmii_ethernet ${CMAKE_CURRENT_LIST_DIR}/src/rmii_ethernet_mdio.pio)
+pico_generate_pio_header(pico_rmii_ethernet ${CMAKE_CURRENT_LIST_DIR}/src/rmii_ethernet_timestamp.pio)
+
+target_link_libraries(pico_rmii_ethernet INTERFACE hardware_pio hardware_dma pico_stdlib pico_multicore pico_unique_id pico_lwip trace timebase)
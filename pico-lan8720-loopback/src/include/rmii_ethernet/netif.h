@@ -11,13 +11,154 @@
 
 #include "lwip/netif.h"
 
+// run the PIO/DMA driver on the core calling netif_rmii_ethernet_loop() and lwIP on the
+// core calling netif_rmii_ethernet_poll(), with SIO FIFO doorbells between them
+#ifndef PICO_RMII_ETHERNET_DUAL_CORE
+#define PICO_RMII_ETHERNET_DUAL_CORE 0
+#endif
+
+// timestamp frames through the RX/TX stages of the driver with the 1 us timer and keep
+// per stage histograms, see netif_rmii_ethernet_profile_dump()
+#ifndef PICO_RMII_ETHERNET_PROFILE
+#define PICO_RMII_ETHERNET_PROFILE 0
+#endif
+
+// time of each core that polls split by what it spent it on: the driver, lwIP, the
+// application's callbacks, passes that found nothing to do and sleep, see
+// netif_rmii_ethernet_get_cpu_stats(). NO_SYS only
+#ifndef PICO_RMII_ETHERNET_CPU_STATS
+#define PICO_RMII_ETHERNET_CPU_STATS 0
+#endif
+
+// record the frames and link changes to the binary trace ring of trace/, for trace_drain()
+// on core 0 or tools/trace_decode.py, without formatting in the driver
+#ifndef PICO_RMII_ETHERNET_TRACE
+#define PICO_RMII_ETHERNET_TRACE 0
+#endif
+
+// keep the first PICO_RMII_ETHERNET_CAPTURE_SNAPLEN bytes and a timestamp of the last
+// PICO_RMII_ETHERNET_CAPTURE_SLOTS frames in both directions, CRC errors included, for
+// netif_rmii_ethernet_capture_start() to stream as pcapng
+#ifndef PICO_RMII_ETHERNET_CAPTURE
+#define PICO_RMII_ETHERNET_CAPTURE 0
+#endif
+
+// must be a power of 2
+#ifndef PICO_RMII_ETHERNET_CAPTURE_SLOTS
+#define PICO_RMII_ETHERNET_CAPTURE_SLOTS 64
+#endif
+
+// Ethernet, IP and TCP headers with options
+#ifndef PICO_RMII_ETHERNET_CAPTURE_SNAPLEN
+#define PICO_RMII_ETHERNET_CAPTURE_SNAPLEN 96
+#endif
+
+// the ring is drained this often while streaming
+#ifndef PICO_RMII_ETHERNET_CAPTURE_EXPORT_MS
+#define PICO_RMII_ETHERNET_CAPTURE_EXPORT_MS 100
+#endif
+
+// drop frames in the CRS_DV interrupt, before their FCS check and a pbuf, when they are
+// for another MAC, for a multicast group the netif hasn't joined or of an EtherType
+// lwIP doesn't take (IPv4, ARP, IPv6 and VLAN as configured)
+#ifndef PICO_RMII_ETHERNET_RX_FILTER
+#define PICO_RMII_ETHERNET_RX_FILTER 1
+#endif
+
+// EtherTypes the filter passes, lwIP's own included
+#ifndef PICO_RMII_ETHERNET_RX_FILTER_ETHERTYPES
+#define PICO_RMII_ETHERNET_RX_FILTER_ETHERTYPES 8
+#endif
+
+// police received frames in the CRS_DV interrupt, after the RX filter and before their
+// FCS check and a pbuf: a token bucket per traffic class and one per source drop the
+// frames over their rate, see netif_rmii_ethernet_netif_rx_police_set()
+#ifndef PICO_RMII_ETHERNET_RX_POLICE
+#define PICO_RMII_ETHERNET_RX_POLICE 0
+#endif
+
+// place the RX/TX DMA buffers in SRAM3 and lwIP's pbuf pool in SRAM2, away from the
+// banks the rest of the firmware uses. Set by pico_rmii_ethernet_sram_banks() in CMake,
+// along with the memory map it needs, see src/rmii_ethernet_sram_banks.ld
+#ifndef PICO_RMII_ETHERNET_SRAM_BANKS
+#define PICO_RMII_ETHERNET_SRAM_BANKS 0
+#endif
+
+// run clk_sys from the PLL instead of REF_CLK: the RX/TX programs wait on the REF_CLK
+// pin for every dibit. Needs clk_sys of 100 MHz or more, 200 MHz or more for 100 Mbit/s,
+// and PICO_RMII_ETHERNET_100M, frames are sent encoded as for 100 Mbit/s at both speeds
+#ifndef PICO_RMII_ETHERNET_REF_CLK_SYNC
+#define PICO_RMII_ETHERNET_REF_CLK_SYNC 0
+#endif
+
+// interfaces netif_rmii_ethernet_init() can add, each on a PIO block of its own, up to
+// NUM_PIOS. They share the DMA and GPIO interrupts and are all polled by
+// netif_rmii_ethernet_poll() and netif_rmii_ethernet_loop()
+#ifndef PICO_RMII_ETHERNET_INSTANCES
+#define PICO_RMII_ETHERNET_INSTANCES 1
+#endif
+
+// stamp frames in hardware for PTP: a spare state machine of the PIO block (the 4th,
+// pio_sm_start must be 0) counts clk_sys / 2 and latches the count on the rising edge of
+// CRS_DV, and of TX-EN for a frame armed with netif_rmii_ethernet_netif_timestamp_tx_arm().
+// Not with PICO_RMII_ETHERNET_REF_CLK_SYNC, its programs leave no room for the counter
+#ifndef PICO_RMII_ETHERNET_TIMESTAMP
+#define PICO_RMII_ETHERNET_TIMESTAMP 0
+#endif
+
+// divert frames of one EtherType, or UDP datagrams to one port, from the CRS_DV interrupt
+// to a ring of their own, past lwIP to a callback the driver runs ahead of the other frames,
+// see netif_rmii_ethernet_netif_rx_priority_set()
+#ifndef PICO_RMII_ETHERNET_RX_PRIORITY
+#define PICO_RMII_ETHERNET_RX_PRIORITY 0
+#endif
+
+// hand received frames of the EtherTypes registered with netif_rmii_ethernet_netif_raw_rx_register()
+// to the application in their RX buffer, and send frames straight from the application's
+// memory with netif_rmii_ethernet_netif_raw_send(), next to lwIP on the same link
+#ifndef PICO_RMII_ETHERNET_RAW
+#define PICO_RMII_ETHERNET_RAW 0
+#endif
+
+// EtherTypes an interface can have raw RX callbacks for
+#ifndef PICO_RMII_ETHERNET_RAW_RX_HANDLERS
+#define PICO_RMII_ETHERNET_RAW_RX_HANDLERS 4
+#endif
+
+// send frames at a time_us_64() of the application's with netif_rmii_ethernet_netif_tx_schedule():
+// a hardware alarm hands them to the DMA, and lwIP's frames are held back so the wire is
+// free then, for cyclic traffic with a jitter of microseconds
+#ifndef PICO_RMII_ETHERNET_TX_SCHEDULED
+#define PICO_RMII_ETHERNET_TX_SCHEDULED 0
+#endif
+
+// frames an interface can have scheduled and not yet reported done, each with a TX
+// descriptor and, with PICO_RMII_ETHERNET_100M, ~3 KB for its encoding
+#ifndef PICO_RMII_ETHERNET_TX_SCHEDULED_SLOTS
+#define PICO_RMII_ETHERNET_TX_SCHEDULED_SLOTS 2
+#endif
+
+// let netif_rmii_ethernet_netif_sleep() put an interface to sleep until a magic packet or a
+// frame to its MAC, netif_rmii_ethernet_loop() sleeps with most clocks gated meanwhile
+#ifndef PICO_RMII_ETHERNET_WAKE
+#define PICO_RMII_ETHERNET_WAKE 0
+#endif
+
+enum netif_rmii_ethernet_duplex {
+    NETIF_RMII_ETHERNET_DUPLEX_HALF,
+    NETIF_RMII_ETHERNET_DUPLEX_FULL
+};
+
 struct netif_rmii_ethernet_config {
     PIO pio;
-    uint pio_sm_start; // uses 2 PIO sm's
+    uint pio_sm_start; // uses 3 PIO sm's: RX, TX, MDIO, and a 4th with PICO_RMII_ETHERNET_TIMESTAMP
     uint rx_pin_start; // RX0, RX1, CRS
     uint tx_pin_start; // TX0, TX1, TX-EN
     uint mdio_pin_start; // MDIO, MDC
     uint8_t *mac_addr; // 6 bytes
+    uint speed; // highest advertised Mbit/s, 10 or 100 (needs PICO_RMII_ETHERNET_100M)
+    enum netif_rmii_ethernet_duplex duplex; // full also advertises half duplex
+    uint ref_clk_pin; // the PHY's 50 MHz REF_CLK, read with PICO_RMII_ETHERNET_REF_CLK_SYNC
 };
 
 #define NETIF_RMII_ETHERNET_DEFAULT_CONFIG() { \
@@ -26,13 +167,314 @@ struct netif_rmii_ethernet_config {
     .rx_pin_start = 6, \
     .tx_pin_start = 10, \
     .mdio_pin_start = 14, \
-    .mac_addr = NULL \
+    .mac_addr = NULL, \
+    .speed = 10, \
+    .duplex = NETIF_RMII_ETHERNET_DUPLEX_FULL, \
+    .ref_clk_pin = 20 \
 }
 
+// driver counters, since netif_rmii_ethernet_init(). They are also added to lwIP's
+// LINK_STATS and, with MIB2_STATS, to the netif's MIB-II ifTable counters
+struct netif_rmii_ethernet_stats {
+    uint32_t rx_ok;           // frames handed to netif->input()
+    uint32_t rx_crc_err;      // no valid FCS found, runts included
+    uint32_t rx_nobuf;        // valid frames dropped, no PBUF_POOL pbuf for them
+    uint32_t rx_overrun;      // frames missed while the RX ring was full or out of zero copy buffers
+    uint32_t rx_filtered;     // frames dropped by PICO_RMII_ETHERNET_RX_FILTER, FCS unchecked
+    uint32_t rx_policed;      // frames dropped by PICO_RMII_ETHERNET_RX_POLICE, FCS unchecked
+    uint32_t rx_priority;     // frames handed to the PICO_RMII_ETHERNET_RX_PRIORITY callback
+    uint32_t rx_priority_overrun; // priority frames dropped, the callback was behind on all its buffers
+    uint32_t rx_raw;          // frames handed to a PICO_RMII_ETHERNET_RAW callback
+    uint32_t rx_icmp_reflected; // echo requests PICO_RMII_ETHERNET_ICMP_REFLECT answered, counted in rx_ok too
+    uint32_t rx_responded_arp; // ARP requests PICO_RMII_ETHERNET_RESPONDER answered from the driver, counted in rx_ok too
+    uint32_t rx_responded_echo; // echo requests PICO_RMII_ETHERNET_RESPONDER answered from the driver, counted in rx_ok too
+    uint32_t rx_lro_merged;   // frames PICO_RMII_ETHERNET_LRO chained behind another one, counted in rx_ok too
+    uint32_t rx_chksum_verified; // frames whose TCP, UDP or ICMP checksum PICO_RMII_ETHERNET_RX_CHKSUM verified, counted in rx_ok too
+    uint32_t rx_asleep;       // valid frames dropped while asleep, not wake-up frames
+    uint32_t wakeups;         // wake-up frames, magic packets or frames to the netif's MAC
+    uint32_t tx_ok;           // frames queued for DMA
+    uint32_t tx_nobuf;        // frames dropped, no pbuf to coalesce a long chain into
+    uint32_t tx_busy_wait_us; // time linkoutput waited for a free TX ring slot
+    uint32_t tx_cut_through;  // frames PICO_RMII_ETHERNET_TX_CUT_THROUGH handed to the DMA before they were built
+    uint32_t tx_cut_late;     // of those, frames the DMA may have caught up with the build on, sent with a bad FCS
+    uint32_t rx_pause;        // PICO_RMII_ETHERNET_PAUSE frames received, not passed to lwIP
+    uint32_t tx_pause;        // PICO_RMII_ETHERNET_PAUSE frames sent, those letting the partner go on too
+    uint32_t tx_scheduled;    // PICO_RMII_ETHERNET_TX_SCHEDULED frames sent, not counted in tx_ok
+    uint32_t tx_scheduled_late; // of those, frames started more than PICO_RMII_ETHERNET_TX_SCHEDULED_LATE_US after their time
+    uint32_t tx_scheduled_late_max_us; // the furthest after its time a scheduled frame was started
+    uint32_t tx_scheduled_dropped; // scheduled frames dropped, the link went down or changed speed before their time
+    uint32_t link_flaps;      // link up to down transitions
+};
+
+// adds the next interface as e0, e1, ..., ERR_MEM once PICO_RMII_ETHERNET_INSTANCES are
+// added and ERR_ARG for the PIO block of another one. netif->state is the driver's.
+// With NO_SYS=0 (PICO_LWIP_FREERTOS) call it after tcpip_init(), holding LOCK_TCPIP_CORE()
 err_t netif_rmii_ethernet_init(struct netif *netif, struct netif_rmii_ethernet_config *config);
 
+// completion of an MDIO access, value is the register contents for reads
+typedef void (*netif_rmii_ethernet_mdio_callback_t)(uint16_t value, void *arg);
+
+// the calls without a netif below act on the first interface, the netif_rmii_ethernet_netif_
+// ones on the interface of netif
+
+// queue a PHY register access, the callback runs from netif_rmii_ethernet_poll(),
+// returns ERR_MEM while the MDIO queue is full
+err_t netif_rmii_ethernet_mdio_read_async(uint reg, netif_rmii_ethernet_mdio_callback_t callback, void *arg);
+err_t netif_rmii_ethernet_mdio_write_async(uint reg, uint16_t value, netif_rmii_ethernet_mdio_callback_t callback, void *arg);
+err_t netif_rmii_ethernet_netif_mdio_read_async(struct netif *netif, uint reg, netif_rmii_ethernet_mdio_callback_t callback, void *arg);
+err_t netif_rmii_ethernet_netif_mdio_write_async(struct netif *netif, uint reg, uint16_t value, netif_rmii_ethernet_mdio_callback_t callback, void *arg);
+
+// the speed (Mbit/s) and duplex autonegotiation picked, speed is 0 while the link is down.
+// Both are set before netif_set_link_up(), so the netif's link callback sees the new link
+void netif_rmii_ethernet_get_link(uint *speed, enum netif_rmii_ethernet_duplex *duplex);
+void netif_rmii_ethernet_netif_get_link(struct netif *netif, uint *speed, enum netif_rmii_ethernet_duplex *duplex);
+
+// PHY loopback (BMCR bit 14) at speed Mbit/s and full duplex, for a self-test without a
+// link partner: what the driver sends comes back to its RX, nothing goes out on the wire.
+// The link checks hold off meanwhile, the netif's link state is left as it was. Disabling
+// it restarts autonegotiation and takes the link down until it is back. From lwIP context,
+// ERR_ARG for a speed the build can't run
+err_t netif_rmii_ethernet_netif_phy_loopback(struct netif *netif, bool enable, uint speed);
+
+// copy of the counters, from lwIP context
+void netif_rmii_ethernet_get_stats(struct netif_rmii_ethernet_stats *stats);
+void netif_rmii_ethernet_netif_get_stats(struct netif *netif, struct netif_rmii_ethernet_stats *stats);
+
+#if PICO_RMII_ETHERNET_RX_FILTER
+// pass every frame on to lwIP, and to the capture ring, while on. Bridge ports need it
+void netif_rmii_ethernet_set_promiscuous(bool on);
+void netif_rmii_ethernet_netif_set_promiscuous(struct netif *netif, bool on);
+
+// let frames to a multicast MAC through, or stop them again. Groups share 64 hash bins,
+// so others may get through too. IGMP and MLD groups of the netif are added by lwIP
+err_t netif_rmii_ethernet_mac_filter(const uint8_t *mac, enum netif_mac_filter_action action);
+err_t netif_rmii_ethernet_netif_mac_filter(struct netif *netif, const uint8_t *mac, enum netif_mac_filter_action action);
+
+// pass an EtherType on, for LWIP_HOOK_UNKNOWN_ETH_PROTOCOL or PPPoE, ERR_MEM once
+// PICO_RMII_ETHERNET_RX_FILTER_ETHERTYPES are passed
+err_t netif_rmii_ethernet_rx_filter_ethertype_add(uint16_t type);
+err_t netif_rmii_ethernet_netif_rx_filter_ethertype_add(struct netif *netif, uint16_t type);
+#endif
+
+#if PICO_RMII_ETHERNET_RX_POLICE
+// the buckets of netif_rmii_ethernet_netif_rx_police_set(): one per traffic class, a frame
+// is in the first class it matches, and the one each source has
+enum netif_rmii_ethernet_rx_police {
+    NETIF_RMII_ETHERNET_RX_POLICE_BROADCAST, // to a broadcast or multicast MAC
+    NETIF_RMII_ETHERNET_RX_POLICE_ARP,
+    NETIF_RMII_ETHERNET_RX_POLICE_ICMP,      // ICMP and ICMPv6
+    NETIF_RMII_ETHERNET_RX_POLICE_TCP,
+    NETIF_RMII_ETHERNET_RX_POLICE_UDP,
+    NETIF_RMII_ETHERNET_RX_POLICE_OTHER,     // other protocols, IPv4 fragments past the first, other EtherTypes
+    NETIF_RMII_ETHERNET_RX_POLICE_SOURCE,    // each IPv4 source address, or source MAC for the rest
+    NETIF_RMII_ETHERNET_RX_POLICERS
+};
+
+struct netif_rmii_ethernet_rx_police_stats {
+    uint32_t dropped[NETIF_RMII_ETHERNET_RX_POLICERS]; // frames each bucket dropped
+    uint32_t shared; // frames of a source policed with another one's bucket, those it could have were busy
+};
+
+// let up to rate frames a second of a class, or of each source, through with bursts of up
+// to burst frames, and drop the rest. A frame a source bucket drops doesn't count against
+// its class. rate 0 passes them all, the default for all but BROADCAST and SOURCE, which
+// start at PICO_RMII_ETHERNET_RX_POLICE_BROADCAST_RATE and _SOURCE_RATE. ERR_ARG for a rate
+// over 1000000, or a burst of 0 or over 1000. From lwIP context, the sources share
+// PICO_RMII_ETHERNET_RX_POLICE_SOURCES buckets: a source whose buckets are both held by
+// others that aren't idle shares one of them
+err_t netif_rmii_ethernet_rx_police_set(enum netif_rmii_ethernet_rx_police police, uint rate, uint burst);
+err_t netif_rmii_ethernet_netif_rx_police_set(struct netif *netif, enum netif_rmii_ethernet_rx_police police, uint rate, uint burst);
+
+// copy of the policing counters, from lwIP context
+void netif_rmii_ethernet_rx_police_get_stats(struct netif_rmii_ethernet_rx_police_stats *stats);
+void netif_rmii_ethernet_netif_rx_police_get_stats(struct netif *netif, struct netif_rmii_ethernet_rx_police_stats *stats);
+#endif
+
+#if PICO_RMII_ETHERNET_RAW
+// a frame of a registered EtherType with a valid FCS, without it, in the RX buffer it came
+// in. The buffer is the driver's again once the callback returns
+typedef void (*netif_rmii_ethernet_raw_rx_callback_t)(struct netif *netif, const uint8_t *frame, uint length, void *arg);
+
+// a frame of netif_rmii_ethernet_netif_raw_send() is out, its memory is the caller's again
+typedef void (*netif_rmii_ethernet_raw_tx_callback_t)(const uint8_t *frame, void *arg);
+
+// take the frames of EtherType type past lwIP to callback, NULL hands them back. ERR_ARG for
+// the EtherTypes lwIP takes, ERR_MEM once PICO_RMII_ETHERNET_RAW_RX_HANDLERS are registered
+// or the RX filter has no room left for it. From lwIP context, the callback runs from
+// netif_rmii_ethernet_poll() in the order the frames came in, lwIP's included
+err_t netif_rmii_ethernet_raw_rx_register(uint16_t type, netif_rmii_ethernet_raw_rx_callback_t callback, void *arg);
+err_t netif_rmii_ethernet_netif_raw_rx_register(struct netif *netif, uint16_t type, netif_rmii_ethernet_raw_rx_callback_t callback, void *arg);
+
+// queue length bytes of frame, from the destination MAC to the payload, which the TX DMA
+// streams straight from there (padded to 60 bytes, FCS added, at 100 Mbit/s encoded from
+// there when the driver gets to it). Leave it untouched until
+// done runs from netif_rmii_ethernet_poll(). From lwIP context, in line with lwIP's frames:
+// waits for a free TX ring slot as linkoutput does. ERR_MEM while PICO_RMII_ETHERNET_TX_RING_SIZE
+// raw frames are pending, ERR_VAL for a length outside 14 to 1514
+err_t netif_rmii_ethernet_raw_send(const uint8_t *frame, uint length, netif_rmii_ethernet_raw_tx_callback_t done, void *arg);
+err_t netif_rmii_ethernet_netif_raw_send(struct netif *netif, const uint8_t *frame, uint length, netif_rmii_ethernet_raw_tx_callback_t done, void *arg);
+#endif
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+// a scheduled frame is out, or dropped, and its memory is the caller's again. ERR_OK with
+// late_us, the time from its launch_us to the DMA starting on it, ERR_CONN when the link
+// went down or changed speed before launch_us
+typedef void (*netif_rmii_ethernet_tx_scheduled_callback_t)(const uint8_t *frame, err_t err, int32_t late_us, void *arg);
+
+// send length bytes of frame, from the destination MAC to the payload, at time_us_64()
+// launch_us. It is built now (padded, FCS added, encoded at 100 Mbit/s) and a hardware
+// alarm hands it to the DMA at launch_us, ahead of the TX rings and a pause. Frames of the
+// rings that wouldn't be off the wire by then wait until it is out. A launch_us that has
+// passed sends it as soon as the frame on the wire is out. Leave the frame untouched until
+// done runs from netif_rmii_ethernet_poll(), which may schedule the next one of a cycle.
+// From lwIP context, the alarm's interrupt runs on the core of the first call: ERR_MEM
+// while PICO_RMII_ETHERNET_TX_SCHEDULED_SLOTS frames are pending, ERR_CONN while the link
+// is down, ERR_VAL for a length outside 14 to 1514. The frames aren't in the capture ring
+err_t netif_rmii_ethernet_tx_schedule(const uint8_t *frame, uint length, uint64_t launch_us, netif_rmii_ethernet_tx_scheduled_callback_t done, void *arg);
+err_t netif_rmii_ethernet_netif_tx_schedule(struct netif *netif, const uint8_t *frame, uint length, uint64_t launch_us, netif_rmii_ethernet_tx_scheduled_callback_t done, void *arg);
+#endif
+
+#if PICO_RMII_ETHERNET_WAKE
+// frames that wake up an interface, or-ed for netif_rmii_ethernet_netif_sleep()
+#define NETIF_RMII_ETHERNET_WAKE_MAGIC   0x01 // magic packet for the netif's MAC, UDP or EtherType 0x0842, dropped
+#define NETIF_RMII_ETHERNET_WAKE_UNICAST 0x02 // any frame to the netif's MAC, goes on to lwIP
+
+// the interface is awake again, for the frame that woke it, before lwIP sees it
+typedef void (*netif_rmii_ethernet_wake_callback_t)(struct netif *netif, void *arg);
+
+// put the interface to sleep until one of the wake-up frames in match: the rest are dropped
+// after their FCS check, raw frames included (priority frames still go to their callback).
+// Once all interfaces sleep,
+// lwIP's timeouts (the link check too) are held and netif_rmii_ethernet_loop() sleeps in
+// __wfi() between frames, with the clocks RX doesn't need gated whenever the other core
+// sleeps too. ERR_ARG for an empty match, ERR_MEM when the RX filter has no room for
+// EtherType 0x0842. From lwIP context, the callback runs from netif_rmii_ethernet_poll()
+err_t netif_rmii_ethernet_sleep(uint match, netif_rmii_ethernet_wake_callback_t callback, void *arg);
+err_t netif_rmii_ethernet_netif_sleep(struct netif *netif, uint match, netif_rmii_ethernet_wake_callback_t callback, void *arg);
+
+// wake the interface up without a frame and without the callback, from lwIP context
+void netif_rmii_ethernet_wake();
+void netif_rmii_ethernet_netif_wake(struct netif *netif);
+
+// true while the interface sleeps
+bool netif_rmii_ethernet_netif_asleep(struct netif *netif);
+#endif
+
+#if PICO_LWIP_VLAN
+// send frames tagged with 802.1Q VLAN vid, 1 to 4094, and take tagged frames of that VID
+// (and VID 0) only. -1, the default, sends untagged. ERR_ARG for another VID
+err_t netif_rmii_ethernet_set_vlan(int vid);
+err_t netif_rmii_ethernet_netif_set_vlan(struct netif *netif, int vid);
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+// a priority frame with a valid FCS, without it. received_us is timebase_us() at its end,
+// in the CRS_DV interrupt. The frame is the driver's again once the callback returns
+typedef void (*netif_rmii_ethernet_rx_priority_callback_t)(struct netif *netif, const uint8_t *frame, uint length, uint32_t received_us, void *arg);
+
+// divert frames of EtherType type, and IPv4 or IPv6 UDP datagrams (unfragmented, no VLAN tag)
+// to port, 0 for neither, to callback: NULL turns it off. They stay out of lwIP, its stats
+// and the capture ring. The callback runs from netif_rmii_ethernet_loop() on the driver core
+// in PICO_RMII_ETHERNET_DUAL_CORE builds, else from netif_rmii_ethernet_poll() and between
+// the frames it hands to lwIP, and must not call lwIP. While lwIP is behind on the RX ring,
+// RX goes on into the free priority buffers and keeps the priority frames only. Set it up
+// before the traffic starts, a frame queued under the old setting may go to the new callback
+void netif_rmii_ethernet_rx_priority_set(uint16_t type, uint16_t port, netif_rmii_ethernet_rx_priority_callback_t callback, void *arg);
+void netif_rmii_ethernet_netif_rx_priority_set(struct netif *netif, uint16_t type, uint16_t port, netif_rmii_ethernet_rx_priority_callback_t callback, void *arg);
+#endif
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+// counts per second of the timestamps, clk_sys / 2. They are 32 bits and wrap, 171 s at
+// the 50 MHz REF_CLK. A timestamp is the end of the SFD, which is the count at CRS_DV or
+// TX-EN plus the 64 bits of preamble and SFD at the link speed. The PHY's own RX and TX
+// latencies aren't taken out
+uint32_t netif_rmii_ethernet_timestamp_hz();
+
+// the timestamp of the frame netif->input() is handling, for the raw API receive
+// callbacks it runs. false for a frame without one: it came in while a TX timestamp was
+// armed, or its carrier started before RX was armed for it
+bool netif_rmii_ethernet_netif_timestamp_rx(struct netif *netif, uint32_t *timestamp);
+
+// stamp the next frame netif sends, a PTP event message sent right after. Received
+// frames go unstamped until its timestamp is in. ERR_INPROGRESS while frames are queued
+// or going out, or the last TX timestamp is still pending, try again from a later poll
+err_t netif_rmii_ethernet_netif_timestamp_tx_arm(struct netif *netif);
+
+// the timestamp of the armed frame, ERR_INPROGRESS until it is out, ERR_TIMEOUT when
+// nothing went out in time, ERR_VAL when nothing was armed
+err_t netif_rmii_ethernet_netif_timestamp_tx_get(struct netif *netif, uint32_t *timestamp);
+#endif
+
+// lwIP side: hands received frames to lwIP, releases sent ones and runs lwIP timers,
+// in single core builds it also does the driver's work. With NO_SYS=0 it takes the
+// tcpip core lock and leaves the timers to the tcpip thread
 void netif_rmii_ethernet_poll();
 
+// never returns, polls the driver (and lwIP in single core builds), with NO_SYS=0 run
+// it in its own FreeRTOS task, which blocks until an RX/TX interrupt has work for it
 void netif_rmii_ethernet_loop();
 
+#if PICO_RMII_ETHERNET_LOOP_WFE
+// time netif_rmii_ethernet_loop() slept waiting for work, in us since boot, in NO_SYS
+// builds without PICO_RMII_ETHERNET_DUAL_CORE, for bench_cpu_source()
+uint64_t netif_rmii_ethernet_idle_us();
+#endif
+
+#if PICO_RMII_ETHERNET_CPU_STATS
+enum netif_rmii_ethernet_cpu_class {
+    NETIF_RMII_ETHERNET_CPU_DRIVER, // RX re-arm and checks, TX builds, MDIO
+    NETIF_RMII_ETHERNET_CPU_LWIP,   // frames through lwIP, its timers and what it sends
+    NETIF_RMII_ETHERNET_CPU_APP,    // lwIP's TCP and UDP callbacks, raw RX callbacks and
+                                    // everything the core does outside the driver
+    NETIF_RMII_ETHERNET_CPU_EMPTY,  // passes that moved nothing through the rings
+    NETIF_RMII_ETHERNET_CPU_SLEEP,  // __wfe()/__wfi() in netif_rmii_ethernet_loop()
+    NETIF_RMII_ETHERNET_CPU_CLASSES
+};
+
+struct netif_rmii_ethernet_cpu_stats {
+    uint64_t us[NETIF_RMII_ETHERNET_CPU_CLASSES]; // since the core's first pass
+    uint32_t passes;       // of netif_rmii_ethernet_poll(), and of the driver loop of the
+                           // PICO_RMII_ETHERNET_DUAL_CORE driver core
+    uint32_t passes_empty;
+};
+
+// the time of a core by class, zero for a core that never polled. Interrupt handlers
+// count to what they interrupt. Read from the other core, a class can be a pass behind
+void netif_rmii_ethernet_get_cpu_stats(uint core, struct netif_rmii_ethernet_cpu_stats *stats);
+
+// SLEEP and EMPTY of the core running lwIP, in us, for bench_cpu_source()
+uint64_t netif_rmii_ethernet_cpu_idle_us();
+
+// count the calling core's time to cls from now on, and back to what it was with
+// netif_rmii_ethernet_cpu_leave(), for application work lwIP doesn't call back into
+uint netif_rmii_ethernet_cpu_enter(enum netif_rmii_ethernet_cpu_class cls);
+
+void netif_rmii_ethernet_cpu_leave(uint prev);
+#endif
+
+#if PICO_RMII_ETHERNET_PROFILE
+// print the count, min/avg/max and log2 histogram of each RX/TX stage with printf(),
+// over USB CDC when stdio is on USB
+void netif_rmii_ethernet_profile_dump();
+
+void netif_rmii_ethernet_profile_reset();
+#endif
+
+#if PICO_RMII_ETHERNET_CAPTURE
+struct netif_rmii_ethernet_capture_stats {
+    uint32_t captured; // frames recorded since boot
+    uint32_t lost;     // overwritten before they were exported
+    uint32_t exported;
+};
+
+// stream the ring to addr:port as pcapng over UDP from lwIP context: a section header,
+// then what the ring holds and every new frame, except the stream's own datagrams.
+// Read it with "nc -lu <port> | wireshark -k -i -", started before the stream
+err_t netif_rmii_ethernet_capture_start(const ip_addr_t *addr, uint16_t port);
+
+void netif_rmii_ethernet_capture_stop();
+
+void netif_rmii_ethernet_capture_get_stats(struct netif_rmii_ethernet_capture_stats *stats);
+#endif
+
 #endif
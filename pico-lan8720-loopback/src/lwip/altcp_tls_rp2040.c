@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pico/stdlib.h"
+#include "pico/mutex.h"
+#include "hardware/sync.h"
+
+#include "lwip/apps/altcp_tls_mbedtls_offload.h"
+
+#include "altcp_tls_rp2040.h"
+
+#if ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD
+
+#include "mbedtls/threading.h"
+
+#if PICO_RMII_ETHERNET_DUAL_CORE
+#error "the handshake worker takes the core PICO_RMII_ETHERNET_DUAL_CORE runs lwIP on"
+#endif
+
+#if !defined(MBEDTLS_THREADING_ALT)
+#error "altcp_tls_rp2040.c's mutexes are those of MBEDTLS_THREADING_ALT"
+#endif
+
+/* the job posted to the worker, started when seq moves on and done when done does */
+static struct {
+  altcp_mbedtls_offload_fn fn;
+  void *arg;
+  volatile u32_t seq;
+  volatile u32_t done;
+} altcp_tls_rp2040_job;
+
+static volatile u8_t altcp_tls_rp2040_worker_running;
+
+static void
+altcp_tls_rp2040_mutex_init(mbedtls_threading_mutex_t *mutex)
+{
+  mutex_init(&mutex->mutex);
+}
+
+static void
+altcp_tls_rp2040_mutex_free(mbedtls_threading_mutex_t *mutex)
+{
+  /* a pico mutex has nothing to free */
+  LWIP_UNUSED_ARG(mutex);
+}
+
+static int
+altcp_tls_rp2040_mutex_lock(mbedtls_threading_mutex_t *mutex)
+{
+  mutex_enter_blocking(&mutex->mutex);
+  return 0;
+}
+
+static int
+altcp_tls_rp2040_mutex_unlock(mbedtls_threading_mutex_t *mutex)
+{
+  mutex_exit(&mutex->mutex);
+  return 0;
+}
+
+int
+altcp_mbedtls_offload_start(altcp_mbedtls_offload_fn fn, void *arg)
+{
+  if (!altcp_tls_rp2040_worker_running || (altcp_tls_rp2040_job.done != altcp_tls_rp2040_job.seq)) {
+    return 0;
+  }
+  altcp_tls_rp2040_job.fn = fn;
+  altcp_tls_rp2040_job.arg = arg;
+  __dmb();
+  altcp_tls_rp2040_job.seq++;
+  __sev();
+  return 1;
+}
+
+void
+altcp_mbedtls_offload_wait(void)
+{
+  __wfe();
+}
+
+void
+altcp_mbedtls_offload_signal(void)
+{
+  __dmb();
+  __sev();
+}
+
+void
+altcp_mbedtls_offload_sync(void)
+{
+  __dmb();
+}
+
+void
+altcp_tls_rp2040_worker(void)
+{
+  u32_t done = altcp_tls_rp2040_job.done;
+
+  altcp_tls_rp2040_worker_running = 1;
+
+  while (1) {
+    while (altcp_tls_rp2040_job.seq == done) {
+      __wfe();
+    }
+    __dmb();
+
+    altcp_tls_rp2040_job.fn(altcp_tls_rp2040_job.arg);
+
+    done = altcp_tls_rp2040_job.seq;
+    __dmb();
+    altcp_tls_rp2040_job.done = done;
+  }
+}
+
+#endif /* ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD */
+
+void
+altcp_tls_rp2040_init(void)
+{
+#if ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD
+  /* mbedTLS sets up the mutexes of its contexts with these from here on */
+  mbedtls_threading_set_alt(altcp_tls_rp2040_mutex_init, altcp_tls_rp2040_mutex_free,
+                            altcp_tls_rp2040_mutex_lock, altcp_tls_rp2040_mutex_unlock);
+#endif
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef ALTCP_TLS_RP2040_H
+#define ALTCP_TLS_RP2040_H
+
+#include "lwip/apps/altcp_tls_mbedtls_opts.h"
+
+/* The RP2040 side of lib/lwip's altcp_tls_mbedtls (-DPICO_LWIP_TLS=ON), with the
+   mbedTLS of the SDK's pico_mbedtls built as src/lwip/mbedtls_config.h says. Entropy
+   comes from the SDK's mbedtls_hardware_poll().
+
+   With -DPICO_LWIP_TLS_OFFLOAD=ON a handshake runs on the core that doesn't run lwIP,
+   in altcp_tls_rp2040_worker(), while the core running lwIP and the driver goes on
+   with the other connections (ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD). One handshake at a
+   time is offloaded, the others run inline meanwhile. mbedTLS's RNG, session cache,
+   ticket keys and heap are then shared by both cores, behind pico mutexes
+   (MBEDTLS_THREADING_ALT, src/lwip/threading_alt.h) */
+
+/* Before the first altcp_tls_create_config_*() */
+void altcp_tls_rp2040_init(void);
+
+#if ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD
+/* Runs the offloaded handshakes, never returns. Called on the core that doesn't run
+   lwIP, with multicore_launch_core1() or at the end of main(). Handshakes run inline
+   until it does */
+void altcp_tls_rp2040_worker(void);
+#endif
+
+#endif
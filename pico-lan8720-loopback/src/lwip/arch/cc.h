@@ -36,6 +36,74 @@
 
 typedef int sys_prot_t;
 
+/* sys_arch_protect() locks, see sys_arch.c. memp.c and pbuf.c are built through
+   wrappers that pick SYS_ARCH_LOCK_POOL when PICO_LWIP_SYS_ARCH_SPLIT_LOCKS is set,
+   so pool allocation doesn't contend with the rest of the stack */
+#define SYS_ARCH_LOCK_CORE  0
+#define SYS_ARCH_LOCK_POOL  1
+#define SYS_ARCH_LOCK_COUNT 2
+
+#ifndef SYS_ARCH_PROTECT_LOCK
+#define SYS_ARCH_PROTECT_LOCK SYS_ARCH_LOCK_CORE
+#endif
+
+sys_prot_t sys_arch_protect_lock(unsigned lock);
+void sys_arch_unprotect_lock(unsigned lock, sys_prot_t pval);
+
+#define SYS_ARCH_DECL_PROTECT(lev) sys_prot_t lev
+#define SYS_ARCH_PROTECT(lev)      lev = sys_arch_protect_lock(SYS_ARCH_PROTECT_LOCK)
+#define SYS_ARCH_UNPROTECT(lev)    sys_arch_unprotect_lock(SYS_ARCH_PROTECT_LOCK, lev)
+
+/* PICO_RMII_HOT_IN_RAM: the per packet functions of Ethernet, IPv4, TCP/UDP input and
+   TCP output are linked into SRAM with the driver's, in the section of the SDK's
+   __not_in_flash_func(). Declaring them here, ahead of lwIP's own prototypes, puts the
+   attribute on the definitions without touching lib/lwip. Their static helpers are
+   mostly called once and inlined into them, the ones that aren't stay in flash. The
+   allocators need lwIP's types and are marked in lwip_mem.c, lwip_memp.c and lwip_pbuf.c */
+#if PICO_RMII_HOT_IN_RAM
+#include <stddef.h>
+#include <stdint.h>
+
+#define LWIP_HOT_FUNC(func) __attribute__((section(".time_critical." #func))) func
+
+struct eth_addr;
+struct ip4_addr;
+struct netif;
+struct pbuf;
+struct tcp_pcb;
+struct tcp_seg;
+
+int8_t LWIP_HOT_FUNC(ethernet_input)(struct pbuf *p, struct netif *netif);
+int8_t LWIP_HOT_FUNC(ethernet_output)(struct netif *netif, struct pbuf *p, const struct eth_addr *src, const struct eth_addr *dst, uint16_t eth_type);
+int8_t LWIP_HOT_FUNC(etharp_output)(struct netif *netif, struct pbuf *q, const struct ip4_addr *ipaddr);
+int8_t LWIP_HOT_FUNC(ip4_input)(struct pbuf *p, struct netif *inp);
+int8_t LWIP_HOT_FUNC(ip4_output_if)(struct pbuf *p, const struct ip4_addr *src, const struct ip4_addr *dest, uint8_t ttl, uint8_t tos, uint8_t proto, struct netif *netif);
+int8_t LWIP_HOT_FUNC(ip4_output_if_src)(struct pbuf *p, const struct ip4_addr *src, const struct ip4_addr *dest, uint8_t ttl, uint8_t tos, uint8_t proto, struct netif *netif);
+struct netif *LWIP_HOT_FUNC(ip4_route)(const struct ip4_addr *dest);
+uint8_t LWIP_HOT_FUNC(ip4_addr_isbroadcast_u32)(uint32_t addr, const struct netif *netif);
+void LWIP_HOT_FUNC(tcp_input)(struct pbuf *p, struct netif *inp);
+uint16_t LWIP_HOT_FUNC(tcp_pcb_hash)(const struct ip4_addr *remote_ip, uint16_t remote_port, uint16_t local_port);
+int8_t LWIP_HOT_FUNC(tcp_write)(struct tcp_pcb *pcb, const void *arg, uint16_t len, uint8_t apiflags);
+int8_t LWIP_HOT_FUNC(tcp_output)(struct tcp_pcb *pcb);
+int8_t LWIP_HOT_FUNC(tcp_send_empty_ack)(struct tcp_pcb *pcb);
+void LWIP_HOT_FUNC(tcp_recved)(struct tcp_pcb *pcb, uint16_t len);
+void LWIP_HOT_FUNC(tcp_seg_free)(struct tcp_seg *seg);
+void LWIP_HOT_FUNC(tcp_segs_free)(struct tcp_seg *seg);
+void LWIP_HOT_FUNC(udp_input)(struct pbuf *p, struct netif *inp);
+uint16_t LWIP_HOT_FUNC(inet_chksum)(const void *dataptr, uint16_t len);
+uint16_t LWIP_HOT_FUNC(inet_chksum_pseudo)(struct pbuf *p, uint8_t proto, uint16_t proto_len, const struct ip4_addr *src, const struct ip4_addr *dest);
+uint16_t LWIP_HOT_FUNC(lwip_standard_chksum)(const void *dataptr, int len);
+void LWIP_HOT_FUNC(sys_check_timeouts)(void);
+#else
+#define LWIP_HOT_FUNC(func) func
+#endif
+
+#if !NO_SYS
+/* the socket API uses newlib's errno values and struct timeval */
+#define LWIP_ERRNO_STDINCLUDE 1
+#include <sys/time.h>
+#endif
+
 
 
 /* define compiler specific symbols */
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef __SYS_ARCH_H__
+#define __SYS_ARCH_H__
+
+/* NO_SYS=0 types on FreeRTOS, only included by lwIP when it has an OS, see
+   sys_arch_freertos.c */
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "task.h"
+
+typedef SemaphoreHandle_t sys_sem_t;
+typedef SemaphoreHandle_t sys_mutex_t;
+typedef QueueHandle_t sys_mbox_t;
+typedef TaskHandle_t sys_thread_t;
+
+#define sys_sem_valid(sem)             (*(sem) != NULL)
+#define sys_sem_set_invalid(sem)       (*(sem) = NULL)
+#define sys_mutex_valid(mutex)         (*(mutex) != NULL)
+#define sys_mutex_set_invalid(mutex)   (*(mutex) = NULL)
+#define sys_mbox_valid(mbox)           (*(mbox) != NULL)
+#define sys_mbox_set_invalid(mbox)     (*(mbox) = NULL)
+
+#endif /* __SYS_ARCH_H__ */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+
+#include "lwip/opt.h"
+
+#include "lwip_arena.h"
+
+#if PICO_LWIP_ARENA_SIZE
+
+static u8_t lwip_arena[PICO_LWIP_ARENA_SIZE] __attribute__((aligned(MEM_ALIGNMENT)));
+static size_t lwip_arena_used;
+
+static struct lwip_arena_owner lwip_arena_owners[LWIP_ARENA_OWNERS_MAX];
+static u8_t lwip_arena_owner_count;
+
+/* TCP_RCV_AUTOTUNE_BUDGET beyond the profile's, see lwipopts.h */
+unsigned int lwip_arena_tcp_budget;
+
+void *
+lwip_arena_alloc(size_t size, const char *owner)
+{
+  void *mem;
+  u8_t i;
+
+  size = LWIP_MEM_ALIGN_SIZE(size);
+  if (size > PICO_LWIP_ARENA_SIZE - lwip_arena_used) {
+    return NULL;
+  }
+
+  mem = &lwip_arena[lwip_arena_used];
+  lwip_arena_used += size;
+
+  for (i = 0; i < lwip_arena_owner_count; i++) {
+    if (lwip_arena_owners[i].name == owner) {
+      break;
+    }
+  }
+  if (i == lwip_arena_owner_count) {
+    if (i == LWIP_ARENA_OWNERS_MAX) {
+      /* counted in the arena, not in the report */
+      return mem;
+    }
+    lwip_arena_owners[i].name = owner;
+    lwip_arena_owner_count++;
+  }
+  lwip_arena_owners[i].size += size;
+
+  return mem;
+}
+
+size_t
+lwip_arena_left(void)
+{
+  return PICO_LWIP_ARENA_SIZE - lwip_arena_used;
+}
+
+void
+lwip_arena_rx_grant(u32_t buffers)
+{
+  lwip_arena_tcp_budget += buffers * TCP_MSS;
+}
+
+void
+lwip_arena_format(char *line, size_t size)
+{
+  int len = snprintf(line, size, "lwip ARENA");
+
+  for (u8_t i = 0; i < lwip_arena_owner_count && len >= 0 && (size_t)len < size; i++) {
+    len += snprintf(line + len, size - len, " %s %u,", lwip_arena_owners[i].name, (unsigned)lwip_arena_owners[i].size);
+  }
+
+  if (len >= 0 && (size_t)len < size) {
+    snprintf(line + len, size - len, " left %u of %u, window +%u", (unsigned)lwip_arena_left(),
+             (unsigned)PICO_LWIP_ARENA_SIZE, lwip_arena_tcp_budget);
+  }
+}
+
+#endif /* PICO_LWIP_ARENA_SIZE */
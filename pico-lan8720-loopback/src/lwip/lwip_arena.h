@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_ARENA_H
+#define LWIP_ARENA_H
+
+#include <stddef.h>
+
+#include "lwip/opt.h"
+
+/* One static arena of PICO_LWIP_ARENA_SIZE bytes, carved at init by lwIP's heap
+   (mem_init() from lwip_init()) and then the RMII driver's RX buffers, see lwipopts.h.
+   Nothing is given back, the carves are only made from lwIP context while the stack
+   and the interfaces are set up. */
+
+#if PICO_LWIP_ARENA_SIZE
+
+/* Owners the report tells apart, carves of an owner already there add up */
+#define LWIP_ARENA_OWNERS_MAX 4
+
+struct lwip_arena_owner {
+  const char *name;
+  size_t size;
+};
+
+/* size bytes, rounded up to MEM_ALIGNMENT, for owner (a string constant, kept), NULL
+   when less than that is left */
+void *lwip_arena_alloc(size_t size, const char *owner);
+
+/* Bytes not carved yet */
+size_t lwip_arena_left(void);
+
+/* buffers of up to TCP_MSS of received data each, beyond the ones the driver needs for
+   itself, added to the receive window all connections grow into */
+void lwip_arena_rx_grant(u32_t buffers);
+
+/* "lwip ARENA heap 16400, rmii_ethernet 50112, left 1024 of 69632, window +37960" */
+void lwip_arena_format(char *line, size_t size);
+
+#endif /* PICO_LWIP_ARENA_SIZE */
+
+#endif /* LWIP_ARENA_H */
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/inet_chksum.h"
+
+/* Assembly inner loop over 16 byte blocks, lwip_chksum_m0plus.S on the RP2040 and
+   lwip_chksum_m33.S on the RP2350 */
+u32_t lwip_rp2040_chksum_blocks(const u32_t *words, u32_t blocks, u32_t sum);
+u32_t lwip_rp2040_chksum_copy_blocks(u32_t *dst, const u32_t *src, u32_t blocks, u32_t sum);
+
+/* Same contract as lwip_standard_chksum(): the start may be an odd address, the
+   result is the host order, non-inverted Internet sum. Head and tail bytes are
+   handled like LWIP_CHKSUM_ALGORITHM 3, the word aligned middle in assembly. */
+u16_t
+LWIP_HOT_FUNC(lwip_rp2040_chksum)(const void *dataptr, int len)
+{
+  const u8_t *pb = (const u8_t *)dataptr;
+  const u16_t *ps;
+  u16_t t = 0;
+  const u32_t *pl;
+  u32_t sum = 0, tmp;
+  int odd = ((mem_ptr_t)pb & 1);
+
+  if (odd && len > 0) {
+    ((u8_t *)&t)[1] = *pb++;
+    len--;
+  }
+
+  ps = (const u16_t *)(const void *)pb;
+
+  if (((mem_ptr_t)ps & 3) && len > 1) {
+    sum += *ps++;
+    len -= 2;
+  }
+
+  pl = (const u32_t *)(const void *)ps;
+
+  if (len >= 16) {
+    u32_t blocks = (u32_t)len >> 4;
+
+    sum = lwip_rp2040_chksum_blocks(pl, blocks, sum);
+    pl += blocks * 4;
+    len &= 15;
+  }
+
+  while (len > 3) {
+    tmp = sum + *pl++;
+    if (tmp < sum) {
+      tmp++;
+    }
+    sum = tmp;
+    len -= 4;
+  }
+
+  sum = FOLD_U32T(sum);
+
+  ps = (const u16_t *)pl;
+
+  if (len > 1) {
+    sum += *ps++;
+    len -= 2;
+  }
+
+  if (len > 0) {
+    ((u8_t *)&t)[0] = *(const u8_t *)ps;
+  }
+
+  sum += t;
+
+  sum = FOLD_U32T(sum);
+  sum = FOLD_U32T(sum);
+
+  if (odd) {
+    sum = SWAP_BYTES_IN_WORD(sum);
+  }
+
+  return (u16_t)sum;
+}
+
+#if LWIP_CHECKSUM_ON_COPY
+/* LWIP_CHKSUM_COPY: copy len bytes and return their checksum, touching the data
+   once. Buffers with the same word alignment go through the assembly loop, the same
+   halfword alignment through a halfword loop, anything else is copied then summed. */
+u16_t
+LWIP_HOT_FUNC(lwip_rp2040_chksum_copy)(void *dst, const void *src, u16_t len)
+{
+  u8_t *db = (u8_t *)dst;
+  const u8_t *sb = (const u8_t *)src;
+  u16_t *dh;
+  const u16_t *sh;
+  u16_t t = 0;
+  u32_t sum = 0;
+  int n = len;
+  int odd;
+
+  if (((mem_ptr_t)db ^ (mem_ptr_t)sb) & 1) {
+    MEMCPY(dst, src, len);
+    return lwip_rp2040_chksum(dst, len);
+  }
+
+  odd = ((mem_ptr_t)sb & 1);
+
+  if (odd && n > 0) {
+    *db = *sb++;
+    ((u8_t *)&t)[1] = *db++;
+    n--;
+  }
+
+  dh = (u16_t *)(void *)db;
+  sh = (const u16_t *)(const void *)sb;
+
+  if ((((mem_ptr_t)dh ^ (mem_ptr_t)sh) & 2) == 0) {
+    if (((mem_ptr_t)sh & 3) && n > 1) {
+      *dh = *sh++;
+      sum += *dh++;
+      n -= 2;
+    }
+
+    if (n >= 16) {
+      u32_t blocks = (u32_t)n >> 4;
+
+      sum = lwip_rp2040_chksum_copy_blocks((u32_t *)(void *)dh, (const u32_t *)(const void *)sh, blocks, sum);
+      sum = FOLD_U32T(sum);
+      dh += blocks * 8;
+      sh += blocks * 8;
+      n &= 15;
+    }
+  }
+
+  /* at most 32767 halfwords, the 32-bit sum can't overflow */
+  while (n > 1) {
+    *dh = *sh++;
+    sum += *dh++;
+    n -= 2;
+  }
+
+  if (n > 0) {
+    *(u8_t *)dh = *(const u8_t *)sh;
+    ((u8_t *)&t)[0] = *(u8_t *)dh;
+  }
+
+  sum += t;
+
+  sum = FOLD_U32T(sum);
+  sum = FOLD_U32T(sum);
+
+  if (odd) {
+    sum = SWAP_BYTES_IN_WORD(sum);
+  }
+
+  return (u16_t)sum;
+}
+#endif /* LWIP_CHECKSUM_ON_COPY */
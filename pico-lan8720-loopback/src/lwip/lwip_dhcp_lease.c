@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "lwip/dhcp.h"
+#include "lwip/prot/dhcp.h"
+#include "lwip/timeouts.h"
+
+#include "lwip_dhcp_lease.h"
+
+#if LWIP_DHCP
+
+#define LWIP_DHCP_LEASE_MAGIC           0x5345454cUL /* "LEES" */
+
+struct lwip_dhcp_lease {
+  u32_t magic;
+  u32_t sum;        /* of the rest, an interrupted erase or program doesn't load */
+  u8_t hwaddr[6];
+  u8_t reserved[2];
+  u32_t ip;         /* network order, as ip4_addr_t keeps them */
+  u32_t netmask;
+  u32_t gw;
+  u32_t server;
+  u32_t t0_lease;   /* seconds, as the server gave them */
+  u32_t t1_renew;
+  u32_t t2_rebind;
+};
+
+/* the page programmed, off the stack */
+static u8_t lwip_dhcp_lease_page[FLASH_PAGE_SIZE] __attribute__((aligned(4)));
+
+static struct netif *lwip_dhcp_lease_netif;
+
+static const struct lwip_dhcp_lease *
+lwip_dhcp_lease_saved(void)
+{
+  return (const struct lwip_dhcp_lease *)(XIP_BASE + LWIP_DHCP_LEASE_OFFSET);
+}
+
+static u32_t
+lwip_dhcp_lease_sum(const struct lwip_dhcp_lease *lease)
+{
+  const u8_t *data = (const u8_t *)lease + offsetof(struct lwip_dhcp_lease, hwaddr);
+  u32_t sum = 0;
+
+  for (size_t i = 0; i < sizeof(*lease) - offsetof(struct lwip_dhcp_lease, hwaddr); i++) {
+    sum = ((sum << 1) | (sum >> 31)) + data[i];
+  }
+
+  return sum;
+}
+
+/* the saved lease when it is intact and for netif's MAC address, NULL otherwise */
+static const struct lwip_dhcp_lease *
+lwip_dhcp_lease_load(struct netif *netif)
+{
+  const struct lwip_dhcp_lease *lease = lwip_dhcp_lease_saved();
+
+  if (lease->magic != LWIP_DHCP_LEASE_MAGIC || lease->sum != lwip_dhcp_lease_sum(lease)) {
+    return NULL;
+  }
+
+  if (memcmp(lease->hwaddr, netif->hwaddr, sizeof(lease->hwaddr)) != 0) {
+    return NULL;
+  }
+
+  return lease;
+}
+
+static void
+lwip_dhcp_lease_write(const struct lwip_dhcp_lease *lease)
+{
+  u32_t save;
+
+  memset(lwip_dhcp_lease_page, 0xff, sizeof(lwip_dhcp_lease_page));
+  if (lease != NULL) {
+    memcpy(lwip_dhcp_lease_page, lease, sizeof(*lease));
+  }
+
+  /* XIP is off while erasing and programming, nothing may run from flash */
+  save = save_and_disable_interrupts();
+  flash_range_erase(LWIP_DHCP_LEASE_OFFSET, FLASH_SECTOR_SIZE);
+  if (lease != NULL) {
+    flash_range_program(LWIP_DHCP_LEASE_OFFSET, lwip_dhcp_lease_page, FLASH_PAGE_SIZE);
+  }
+  restore_interrupts(save);
+}
+
+/* saves the lease lwIP is bound to when it isn't the saved one */
+static void
+lwip_dhcp_lease_check(void *arg)
+{
+  struct netif *netif = lwip_dhcp_lease_netif;
+  struct dhcp *dhcp = netif_dhcp_data(netif);
+  struct lwip_dhcp_lease lease;
+
+  LWIP_UNUSED_ARG(arg);
+
+  if (dhcp == NULL) {
+    /* dhcp_stop() or dhcp_cleanup(), the check ends */
+    lwip_dhcp_lease_netif = NULL;
+    return;
+  }
+
+  sys_timeout(LWIP_DHCP_LEASE_CHECK_MS, lwip_dhcp_lease_check, NULL);
+
+  if (!dhcp_supplied_address(netif)) {
+    return;
+  }
+
+  memset(&lease, 0, sizeof(lease));
+  lease.magic = LWIP_DHCP_LEASE_MAGIC;
+  memcpy(lease.hwaddr, netif->hwaddr, sizeof(lease.hwaddr));
+  lease.ip = ip4_addr_get_u32(&dhcp->offered_ip_addr);
+  lease.netmask = ip4_addr_get_u32(netif_ip4_netmask(netif));
+  lease.gw = ip4_addr_get_u32(netif_ip4_gw(netif));
+  lease.server = ip4_addr_get_u32(ip_2_ip4(&dhcp->server_ip_addr));
+  lease.t0_lease = dhcp->offered_t0_lease;
+  lease.t1_renew = dhcp->offered_t1_renew;
+  lease.t2_rebind = dhcp->offered_t2_rebind;
+  lease.sum = lwip_dhcp_lease_sum(&lease);
+
+  if (memcmp(lwip_dhcp_lease_saved(), &lease, sizeof(lease)) != 0) {
+    lwip_dhcp_lease_write(&lease);
+  }
+}
+
+err_t
+lwip_dhcp_lease_start(struct netif *netif)
+{
+  const struct lwip_dhcp_lease *lease = lwip_dhcp_lease_load(netif);
+  struct dhcp *dhcp;
+  err_t err;
+
+  /* with the link still down, as it usually is this early, nothing is sent yet */
+  err = dhcp_start(netif);
+  if (err != ERR_OK) {
+    return err;
+  }
+
+  if (lwip_dhcp_lease_netif == NULL) {
+    sys_timeout(LWIP_DHCP_LEASE_CHECK_MS, lwip_dhcp_lease_check, NULL);
+  }
+  lwip_dhcp_lease_netif = netif;
+
+  if (lease == NULL) {
+    return ERR_OK;
+  }
+
+  /* the lease as lwIP keeps a bound one, REBOOTING asks for offered_ip_addr */
+  dhcp = netif_dhcp_data(netif);
+  ip4_addr_set_u32(&dhcp->offered_ip_addr, lease->ip);
+  ip4_addr_set_u32(&dhcp->offered_sn_mask, lease->netmask);
+  ip4_addr_set_u32(&dhcp->offered_gw_addr, lease->gw);
+  ip_addr_set_ip4_u32(&dhcp->server_ip_addr, lease->server);
+  dhcp->subnet_mask_given = 1;
+  dhcp->offered_t0_lease = lease->t0_lease;
+  dhcp->offered_t1_renew = lease->t1_renew;
+  dhcp->offered_t2_rebind = lease->t2_rebind;
+  dhcp->state = DHCP_STATE_REBOOTING;
+  dhcp->tries = 0;
+  dhcp->request_timeout = 0;
+
+#if LWIP_DHCP_LEASE_EARLY_BIND
+  netif_set_addr(netif, &dhcp->offered_ip_addr, &dhcp->offered_sn_mask, &dhcp->offered_gw_addr);
+#endif
+
+  /* the REQUEST goes now with the link up, otherwise when it comes up: lwIP reboots a
+     lease from dhcp_network_changed() */
+  if (netif_is_link_up(netif)) {
+    dhcp_network_changed(netif);
+  }
+
+  return ERR_OK;
+}
+
+void
+lwip_dhcp_lease_erase(void)
+{
+  if (lwip_dhcp_lease_saved()->magic == LWIP_DHCP_LEASE_MAGIC) {
+    lwip_dhcp_lease_write(NULL);
+  }
+}
+
+#endif /* LWIP_DHCP */
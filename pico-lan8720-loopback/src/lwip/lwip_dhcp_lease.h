@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_DHCP_LEASE_H
+#define LWIP_DHCP_LEASE_H
+
+#include "hardware/flash.h"
+
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+
+/* The last DHCP lease of a netif kept in a flash sector, so a board coming back from a
+   reset or a power cycle asks for it again (INIT-REBOOT, RFC 2131 3.2) with a single
+   broadcast REQUEST instead of going through DISCOVER, OFFER, REQUEST and ACK, and the
+   ARP probes of DHCP_DOES_ARP_CHECK lwIP only sends for a lease it hasn't had before.
+   A NAK or a server that doesn't answer in REBOOT_TRIES takes lwIP back to DISCOVER,
+   as it would after a link flap. A lease is written when lwIP binds one that differs
+   from the saved one, renewals of the same lease don't wear the sector.
+
+   The write erases the sector with this core's interrupts off and XIP disabled, like
+   w5x00_pico_port_flash_save() on the W5100S: nothing may run from flash on the other
+   core meanwhile, and RX frames that arrive during the erase are lost. It happens once
+   per new lease */
+
+#if LWIP_DHCP
+
+/* the sector below lwip_ota_rp2040.c's record, the top of its staging area: an image
+   that reaches it can't be staged together with a saved lease */
+#ifndef LWIP_DHCP_LEASE_OFFSET
+#define LWIP_DHCP_LEASE_OFFSET          (PICO_FLASH_SIZE_BYTES - 2 * FLASH_SECTOR_SIZE)
+#endif
+
+/* put a saved lease of this MAC address on the netif at start, before the server
+   confirmed it: the address is usable at once, and taken away again on a NAK */
+#ifndef LWIP_DHCP_LEASE_EARLY_BIND
+#define LWIP_DHCP_LEASE_EARLY_BIND      0
+#endif
+
+/* how often a bound lease is compared with the saved one */
+#define LWIP_DHCP_LEASE_CHECK_MS        1000
+
+/* dhcp_start(netif) that resumes the saved lease, if there is one for netif's MAC
+   address, in REBOOTING. From lwIP context after netif_set_up(), in place of
+   dhcp_start(). Returns dhcp_start()'s error */
+err_t lwip_dhcp_lease_start(struct netif *netif);
+
+/* Forgets the saved lease, the next start goes through DISCOVER */
+void lwip_dhcp_lease_erase(void);
+
+#endif /* LWIP_DHCP */
+
+#endif /* LWIP_DHCP_LEASE_H */
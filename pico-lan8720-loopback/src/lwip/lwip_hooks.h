@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_HOOKS_H
+#define LWIP_HOOKS_H
+
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/prot/ethernet.h"
+
+/* LWIP_HOOK_FILENAME of lwipopts.h, included by the lwIP sources that run hooks */
+
+#if PICO_LWIP_VLAN
+/* the PCP and VID to tag a frame going out on netif with, -1 to send it untagged:
+   defined in src/rmii_ethernet.c */
+s32_t netif_rmii_ethernet_vlan_set(struct netif *netif, struct pbuf *p, const struct eth_addr *src, const struct eth_addr *dst, u16_t eth_type);
+
+/* non-zero to take a tagged frame received on netif */
+int netif_rmii_ethernet_vlan_check(struct netif *netif, const struct eth_hdr *ethhdr, const struct eth_vlan_hdr *vlan);
+#endif
+
+#if LWIP_UPLINK
+/* the netif of a packet from src to dest: defined in lwip_uplink.c */
+struct netif *lwip_uplink_route(const ip4_addr_t *src, const ip4_addr_t *dest);
+#endif
+
+#endif /* LWIP_HOOKS_H */
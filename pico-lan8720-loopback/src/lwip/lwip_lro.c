@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/ip.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+
+#include "lwip_lro.h"
+
+#if LWIP_IPV4 && LWIP_TCP
+
+/* a merged segment of 1500 byte frames, its Ethernet header included, fits a pbuf's u16_t */
+#if (LWIP_LRO_MAX_SEGS < 2) || (LWIP_LRO_MAX_SEGS > 43)
+#error "LWIP_LRO_MAX_SEGS must be 2 to 43"
+#endif
+
+/* the headers of a TCP/IPv4 segment, in the first pbuf of its frame */
+struct lwip_lro_seg {
+  struct ip_hdr *iphdr;
+  struct tcp_hdr *tcphdr;
+  u16_t tcphlen;
+  u16_t len;   /* TCP payload */
+  u32_t seqno;
+  u8_t flags;  /* ECE and CWR included */
+};
+
+/* ones complement sum of 16-bit words in network order, len even */
+static u32_t
+lwip_lro_sum(const void *data, u16_t len)
+{
+  const u8_t *bytes = (const u8_t *)data;
+  u32_t sum = 0;
+
+  for (u16_t i = 0; i < len; i += 2) {
+    sum += ((u32_t)bytes[i] << 8) | bytes[i + 1];
+  }
+
+  return sum;
+}
+
+static u16_t
+lwip_lro_fold(u32_t sum)
+{
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+
+  return (u16_t)sum;
+}
+
+/* The sum of a segment's payload, from its headers: a valid checksum makes the pseudo
+   header, the TCP header and the payload add up to 0xffff. A segment that doesn't is
+   off by the same amount in the merged segment's checksum, which lwIP then rejects */
+static u32_t
+lwip_lro_payload_sum(struct ip_hdr *iphdr, u16_t tcphlen, u16_t len)
+{
+  u32_t sum = lwip_lro_sum(&iphdr->src, 2 * sizeof(ip4_addr_p_t)) + IP_PROTO_TCP + tcphlen + len;
+
+  sum += lwip_lro_sum((u8_t *)iphdr + IP_HLEN, tcphlen);
+
+  return (u16_t)~lwip_lro_fold(sum);
+}
+
+static int
+lwip_lro_parse(struct lwip_lro *lro, struct pbuf *p, struct lwip_lro_seg *seg)
+{
+  u8_t *frame = (u8_t *)p->payload;
+  u16_t iphlen, ip_len;
+
+  if (p->len < lro->link_hlen + IP_HLEN + TCP_HLEN) {
+    return 0;
+  }
+
+  if ((lro->link_hlen >= SIZEOF_ETH_HDR) &&
+      ((((u16_t)frame[lro->link_hlen - 2] << 8) | frame[lro->link_hlen - 1]) != ETHTYPE_IP)) {
+    return 0;
+  }
+
+  seg->iphdr = (struct ip_hdr *)(frame + lro->link_hlen);
+  iphlen = IPH_HL_BYTES(seg->iphdr);
+  ip_len = lwip_ntohs(IPH_LEN(seg->iphdr));
+
+  /* fragments go up as they are, only the first would have the ports */
+  if ((IPH_V(seg->iphdr) != 4) || (IPH_PROTO(seg->iphdr) != IP_PROTO_TCP) ||
+      (lwip_ntohs(IPH_OFFSET(seg->iphdr)) & (IP_MF | IP_OFFMASK)) ||
+      (iphlen < IP_HLEN) || (p->len < lro->link_hlen + iphlen + TCP_HLEN) ||
+      (ip_len > p->tot_len - lro->link_hlen)) {
+    return 0;
+  }
+
+  seg->tcphdr = (struct tcp_hdr *)((u8_t *)seg->iphdr + iphlen);
+  seg->tcphlen = TCPH_HDRLEN_BYTES(seg->tcphdr);
+
+  if ((seg->tcphlen < TCP_HLEN) || (p->len < lro->link_hlen + iphlen + seg->tcphlen) ||
+      (ip_len < iphlen + seg->tcphlen)) {
+    return 0;
+  }
+
+  seg->len = ip_len - iphlen - seg->tcphlen;
+  seg->seqno = lwip_ntohl(seg->tcphdr->seqno);
+  seg->flags = (u8_t)lwip_ntohs(seg->tcphdr->_hdrlen_rsvd_flags);
+
+  return 1;
+}
+
+/* data with ACK and maybe PSH, to this netif, with a header merging can rewrite */
+static int
+lwip_lro_mergeable(struct lwip_lro *lro, struct pbuf *p, struct lwip_lro_seg *seg, struct netif *inp)
+{
+  if ((seg->len == 0) || ((seg->flags & ~TCP_PSH) != TCP_ACK) || (IPH_HL_BYTES(seg->iphdr) != IP_HLEN)) {
+    return 0;
+  }
+
+  if ((lro->link_hlen >= ETH_HWADDR_LEN) && (memcmp(p->payload, inp->hwaddr, ETH_HWADDR_LEN) != 0)) {
+    return 0;
+  }
+
+#if CHECKSUM_CHECK_IP
+  /* the merged header is updated incrementally, the ones dropped must be good */
+  IF__NETIF_CHECKSUM_ENABLED(inp, NETIF_CHECKSUM_CHECK_IP) {
+    if (inet_chksum(seg->iphdr, IP_HLEN) != 0) {
+      return 0;
+    }
+  }
+#endif
+
+  return 1;
+}
+
+static struct lwip_lro_flow *
+lwip_lro_find(struct lwip_lro *lro, struct lwip_lro_seg *seg)
+{
+  for (int i = 0; i < LWIP_LRO_FLOWS; i++) {
+    struct lwip_lro_flow *flow = &lro->flows[i];
+
+    /* addresses and ports */
+    if ((flow->head != NULL) &&
+        (memcmp(&flow->iphdr->src, &seg->iphdr->src, 2 * sizeof(ip4_addr_p_t)) == 0) &&
+        (memcmp((u8_t *)flow->iphdr + IP_HLEN, seg->tcphdr, 4) == 0)) {
+      return flow;
+    }
+  }
+
+  return NULL;
+}
+
+/* the established pcb the headers are for, as tcp_input() finds it */
+static struct tcp_pcb *
+lwip_lro_pcb(struct ip_hdr *iphdr, struct tcp_hdr *tcphdr)
+{
+  ip4_addr_t src, dest;
+
+  ip4_addr_copy(src, iphdr->src);
+  ip4_addr_copy(dest, iphdr->dest);
+
+  for (struct tcp_pcb *pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+    if ((pcb->remote_port == lwip_ntohs(tcphdr->src)) && (pcb->local_port == lwip_ntohs(tcphdr->dest)) &&
+        IP_IS_V4_VAL(pcb->remote_ip) && ip4_addr_cmp(ip_2_ip4(&pcb->remote_ip), &src) &&
+        ip4_addr_cmp(ip_2_ip4(&pcb->local_ip), &dest)) {
+      return (pcb->state == ESTABLISHED) ? pcb : NULL;
+    }
+  }
+
+  return NULL;
+}
+
+/* a merge starts where lwIP expects the next segment, not after a loss */
+static int
+lwip_lro_in_order(struct lwip_lro_seg *seg)
+{
+  struct tcp_pcb *pcb = lwip_lro_pcb(seg->iphdr, seg->tcphdr);
+
+  if ((pcb == NULL) || (pcb->rcv_nxt != seg->seqno)) {
+    return 0;
+  }
+
+#if TCP_QUEUE_OOSEQ
+  if (pcb->ooseq != NULL) {
+    return 0;
+  }
+#endif
+
+  return 1;
+}
+
+/* the next segment of flow, with the same link header, TOS and TCP options */
+static int
+lwip_lro_follows(struct lwip_lro *lro, struct lwip_lro_flow *flow, struct pbuf *p, struct lwip_lro_seg *seg)
+{
+  u8_t *head = (u8_t *)flow->iphdr;
+
+  return (seg->seqno == flow->next_seq) && (seg->tcphlen == flow->tcphlen) &&
+         (IPH_TOS(seg->iphdr) == IPH_TOS(flow->iphdr)) &&
+         (memcmp(head - lro->link_hlen, p->payload, lro->link_hlen) == 0) &&
+         (memcmp(head + IP_HLEN + TCP_HLEN, (u8_t *)seg->tcphdr + TCP_HLEN, seg->tcphlen - TCP_HLEN) == 0);
+}
+
+/* chains q behind the flow's head, without its headers */
+static void
+lwip_lro_absorb(struct lwip_lro *lro, struct lwip_lro_flow *flow, struct pbuf *q, struct lwip_lro_seg *seg)
+{
+  struct tcp_hdr *head_tcphdr = (struct tcp_hdr *)((u8_t *)flow->iphdr + IP_HLEN);
+  u16_t hlen = IP_HLEN + flow->tcphlen;
+  u32_t sum;
+
+  if (flow->segs == 1) {
+    /* the first merge: the head's payload starts the sum, its frame padding goes */
+    flow->payload_sum = lwip_lro_payload_sum(flow->iphdr, flow->tcphlen, flow->payload_len);
+    pbuf_realloc(flow->head, lro->link_hlen + hlen + flow->payload_len);
+  }
+
+  /* after an odd length, the words of this payload straddle those of the sum */
+  sum = lwip_lro_payload_sum(seg->iphdr, flow->tcphlen, seg->len);
+  if (flow->payload_len & 1) {
+    sum = SWAP_BYTES_IN_WORD(sum);
+  }
+
+  flow->payload_sum = lwip_lro_fold(flow->payload_sum + sum);
+  flow->payload_len += seg->len;
+  flow->next_seq += seg->len;
+  flow->segs++;
+
+  /* the merged segment acknowledges and pushes what its last segment did */
+  head_tcphdr->ackno = seg->tcphdr->ackno;
+  head_tcphdr->wnd = seg->tcphdr->wnd;
+  TCPH_SET_FLAG(head_tcphdr, seg->flags & TCP_PSH);
+
+  pbuf_realloc(q, lro->link_hlen + hlen + seg->len);
+  pbuf_remove_header(q, lro->link_hlen + hlen);
+  pbuf_cat(flow->head, q);
+
+  lro->merged++;
+}
+
+/* the merged length and the checksums of the head */
+static void
+lwip_lro_finish(struct lwip_lro_flow *flow)
+{
+  struct ip_hdr *iphdr = flow->iphdr;
+  struct tcp_hdr *tcphdr = (struct tcp_hdr *)((u8_t *)iphdr + IP_HLEN);
+  u16_t old_len = lwip_ntohs(IPH_LEN(iphdr));
+  u16_t new_len = IP_HLEN + flow->tcphlen + flow->payload_len;
+  u32_t sum;
+
+  /* RFC 1624: HC' = ~(~HC + ~m + m'), a header that was bad stays bad */
+  IPH_LEN_SET(iphdr, lwip_htons(new_len));
+  sum = (u16_t)~lwip_ntohs(IPH_CHKSUM(iphdr)) + (u16_t)~old_len + new_len;
+  IPH_CHKSUM_SET(iphdr, lwip_htons((u16_t)~lwip_lro_fold(sum)));
+
+  tcphdr->chksum = 0;
+  sum = lwip_lro_sum(&iphdr->src, 2 * sizeof(ip4_addr_p_t)) + IP_PROTO_TCP + flow->tcphlen + flow->payload_len;
+  sum += lwip_lro_sum(tcphdr, flow->tcphlen) + flow->payload_sum;
+  tcphdr->chksum = lwip_htons((u16_t)~lwip_lro_fold(sum));
+}
+
+static void
+lwip_lro_flow_flush(struct lwip_lro *lro, struct lwip_lro_flow *flow, struct netif *inp)
+{
+  struct pbuf *head = flow->head;
+
+  if (head == NULL) {
+    return;
+  }
+
+  flow->head = NULL;
+
+  if (flow->segs > 1) {
+    struct tcp_pcb *pcb = lwip_lro_pcb(flow->iphdr, (struct tcp_hdr *)((u8_t *)flow->iphdr + IP_HLEN));
+
+    lwip_lro_finish(flow);
+    lro->chains++;
+
+    /* tcp_ack() takes it as the second segment and acknowledges at once */
+    if (pcb != NULL) {
+      tcp_set_flags(pcb, TF_ACK_DELAY);
+    }
+  }
+
+  if (inp->input(head, inp) != ERR_OK) {
+    pbuf_free(head);
+  }
+}
+
+void
+lwip_lro_init(struct lwip_lro *lro, u16_t link_hlen)
+{
+  memset(lro, 0, sizeof(*lro));
+  lro->link_hlen = link_hlen;
+}
+
+err_t
+lwip_lro_input(struct lwip_lro *lro, struct pbuf *p, struct netif *inp)
+{
+  struct lwip_lro_seg seg;
+  struct lwip_lro_flow *flow;
+  int mergeable;
+
+  if (!lwip_lro_parse(lro, p, &seg)) {
+    return inp->input(p, inp);
+  }
+
+  mergeable = lwip_lro_mergeable(lro, p, &seg, inp);
+  flow = lwip_lro_find(lro, &seg);
+
+  if (flow != NULL) {
+    if (mergeable && lwip_lro_follows(lro, flow, p, &seg)) {
+      lwip_lro_absorb(lro, flow, p, &seg);
+
+      if ((seg.flags & TCP_PSH) || (flow->segs == LWIP_LRO_MAX_SEGS)) {
+        lwip_lro_flow_flush(lro, flow, inp);
+      }
+
+      return ERR_OK;
+    }
+
+    /* out of order, or not data: what came before goes first */
+    lwip_lro_flow_flush(lro, flow, inp);
+  }
+
+  if (!mergeable || (seg.flags & TCP_PSH) || !lwip_lro_in_order(&seg)) {
+    return inp->input(p, inp);
+  }
+
+  /* a free flow, or the oldest */
+  flow = &lro->flows[0];
+  for (int i = 0; (i < LWIP_LRO_FLOWS) && (flow->head != NULL); i++) {
+    if ((lro->flows[i].head == NULL) || ((u8_t)(lro->age - lro->flows[i].age) > (u8_t)(lro->age - flow->age))) {
+      flow = &lro->flows[i];
+    }
+  }
+
+  lwip_lro_flow_flush(lro, flow, inp);
+
+  flow->head = p;
+  flow->iphdr = seg.iphdr;
+  flow->tcphlen = seg.tcphlen;
+  flow->next_seq = seg.seqno + seg.len;
+  flow->payload_len = seg.len;
+  flow->segs = 1;
+  flow->age = lro->age++;
+
+  return ERR_OK;
+}
+
+void
+lwip_lro_flush(struct lwip_lro *lro, struct netif *inp)
+{
+  for (int i = 0; i < LWIP_LRO_FLOWS; i++) {
+    lwip_lro_flow_flush(lro, &lro->flows[i], inp);
+  }
+}
+
+#endif /* LWIP_IPV4 && LWIP_TCP */
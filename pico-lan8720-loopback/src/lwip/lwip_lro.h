@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_LRO_H
+#define LWIP_LRO_H
+
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+
+/* Software large receive offload in front of netif->input(). The in-order TCP/IPv4
+   segments of a flow that arrive in one pass over the RX ring are chained behind the
+   first one, which takes the total length and the last one's ACK, window and PSH, and
+   lwIP takes them in one ip4_input()/tcp_input(). Merged are data segments to the
+   netif's MAC with only ACK (and PSH) set, no IP options or fragments, and the TOS and
+   TCP options of the first. Anything else of a held flow passes it up first, a PSH
+   segment ends the merge, and lwip_lro_flush() ends the pass.
+
+   The ACKs stay as lwIP would send them for the segments one by one: a merge only
+   starts at the pcb's rcv_nxt, with no out of order data queued, so every segment
+   after a loss goes up alone and gets its duplicate ACK. A merge of two or more
+   segments is acknowledged at once, as two segments are (one ACK for the pass instead
+   of one for every second segment). The TCP checksum of the merged segment is derived
+   from the segments' own, not from their data, so lwIP's check still catches a bad one,
+   and drops the segments it was merged with too. Called from lwIP context */
+
+/* flows held at the same time, a segment of another flow passes up the oldest */
+#ifndef LWIP_LRO_FLOWS
+#define LWIP_LRO_FLOWS                  2
+#endif
+
+/* segments merged into one at most */
+#ifndef LWIP_LRO_MAX_SEGS
+#define LWIP_LRO_MAX_SEGS               8
+#endif
+
+struct ip_hdr;
+
+struct lwip_lro_flow {
+  struct pbuf *head;   /* the first segment, with the merged ones chained behind */
+  struct ip_hdr *iphdr; /* the head's, its TCP header follows */
+  u32_t next_seq;      /* where the next in-order segment starts */
+  u32_t payload_sum;   /* ones complement sum of the merged payload */
+  u16_t payload_len;
+  u16_t tcphlen;
+  u8_t segs;
+  u8_t age;
+};
+
+struct lwip_lro {
+  struct lwip_lro_flow flows[LWIP_LRO_FLOWS];
+  u16_t link_hlen;     /* bytes in front of the IP header, SIZEOF_ETH_HDR or 0 */
+  u8_t age;
+  u32_t merged;        /* segments chained behind another one */
+  u32_t chains;        /* merged segments passed up */
+};
+
+/* link_hlen is SIZEOF_ETH_HDR for Ethernet frames (IPv4 EtherType only, no VLAN tags),
+   0 for a netif->input() of bare IP packets */
+void lwip_lro_init(struct lwip_lro *lro, u16_t link_hlen);
+
+/* Takes p or passes it to inp->input(). Returns ERR_OK when p was taken, otherwise
+   inp->input()'s error, p is the caller's to free then as without lwip_lro */
+err_t lwip_lro_input(struct lwip_lro *lro, struct pbuf *p, struct netif *inp);
+
+/* Passes up what is held, at the end of a pass over the RX ring */
+void lwip_lro_flush(struct lwip_lro *lro, struct netif *inp);
+
+#endif
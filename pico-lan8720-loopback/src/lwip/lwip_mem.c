@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* lwip's mem.c, with a walk of the heap's block list for lwip_telemetry, or mem_malloc()
+   on lwip_tlsf.c or the pools of lwippools.h, see PICO_LWIP_MEM_ALLOCATOR in lwipopts.h */
+/* PICO_RMII_HOT_IN_RAM, see arch/cc.h */
+#if PICO_RMII_HOT_IN_RAM
+#include "lwip/mem.h"
+
+void *LWIP_HOT_FUNC(mem_malloc)(mem_size_t size);
+void LWIP_HOT_FUNC(mem_free)(void *mem);
+#endif
+
+/* mem_clib_malloc() and the others of MEM_LIBC_MALLOC */
+#include "lwip/opt.h"
+
+#if PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_TLSF
+#include "lwip_tlsf.h"
+#endif
+
+#if PICO_LWIP_ARENA_SIZE
+#include "lwip_arena.h"
+
+/* the heap and its two struct mems come from the arena when mem_init() runs, lwipopts.h
+   makes sure they fit */
+#define LWIP_RAM_HEAP_POINTER lwip_arena_alloc(MEM_SIZE_ALIGNED + (2U * SIZEOF_STRUCT_MEM), "heap")
+#endif
+
+#include "../../lib/lwip/src/core/mem.c"
+
+#include "lwip_telemetry.h"
+
+#if !MEM_LIBC_MALLOC && !MEM_USE_POOLS
+void
+lwip_mem_heap_walk(struct lwip_telemetry_heap *heap)
+{
+  struct mem *mem;
+  LWIP_MEM_FREE_DECL_PROTECT();
+
+  heap->free = 0;
+  heap->largest_free = 0;
+  heap->free_blocks = 0;
+  heap->used_blocks = 0;
+
+  if (ram == NULL) {
+    return;
+  }
+
+  /* mem_free() merges blocks under the same protection */
+  LWIP_MEM_FREE_PROTECT();
+
+  for (mem = (struct mem *)(void *)ram; mem != ram_end; mem = ptr_to_mem(mem->next)) {
+    mem_size_t size = (mem_size_t)(mem->next - mem_to_ptr(mem) - SIZEOF_STRUCT_MEM);
+
+    if (mem->used) {
+      heap->used_blocks++;
+    } else {
+      heap->free_blocks++;
+      heap->free += size;
+      if (size > heap->largest_free) {
+        heap->largest_free = size;
+      }
+    }
+  }
+
+  LWIP_MEM_FREE_UNPROTECT();
+}
+#endif
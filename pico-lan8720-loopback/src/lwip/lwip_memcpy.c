@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* MEMCPY by DMA and the CPU together, see lwip_memcpy.h */
+
+#include <string.h>
+
+#include "pico/platform.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+
+#include "lwip/opt.h"
+
+#include "lwip_memcpy.h"
+
+#define LWIP_MEMCPY_CHAN_NONE           (-1) /* not claimed yet */
+#define LWIP_MEMCPY_CHAN_FAILED         (-2) /* none was free, the CPU copies */
+
+static int lwip_rp2040_memcpy_chan[NUM_CORES] = { LWIP_MEMCPY_CHAN_NONE, LWIP_MEMCPY_CHAN_NONE };
+
+/* the core's channel is copying, a copy that interrupts it goes to the CPU */
+static volatile u8_t lwip_rp2040_memcpy_busy[NUM_CORES];
+
+void
+LWIP_HOT_FUNC(lwip_rp2040_memcpy_cpu)(void *dst, const void *src, unsigned int len)
+{
+  u8_t *db;
+  const u8_t *sb;
+
+  if (((mem_ptr_t)dst | (mem_ptr_t)src) & 3) {
+    memcpy(dst, src, len);
+    return;
+  }
+
+  /* short copies lose more to memcpy()'s dispatch than the loop costs */
+  {
+    u32_t *dw = (u32_t *)dst;
+    const u32_t *sw = (const u32_t *)src;
+
+    for (; len >= 8; len -= 8) {
+      dw[0] = sw[0];
+      dw[1] = sw[1];
+      dw += 2;
+      sw += 2;
+    }
+    if (len >= 4) {
+      *dw++ = *sw++;
+      len -= 4;
+    }
+    db = (u8_t *)dw;
+    sb = (const u8_t *)sw;
+  }
+
+  while (len--) {
+    *db++ = *sb++;
+  }
+}
+
+int
+LWIP_HOT_FUNC(lwip_rp2040_memcpy_dma)(void *dst, const void *src, unsigned int len)
+{
+  uint core = get_core_num();
+  u8_t *db = (u8_t *)dst;
+  const u8_t *sb = (const u8_t *)src;
+  mem_ptr_t diff = (mem_ptr_t)db ^ (mem_ptr_t)sb;
+  enum dma_channel_transfer_size size;
+  dma_channel_config config;
+  unsigned int shift, head, count, done;
+  u32_t save;
+  int chan;
+
+  save = save_and_disable_interrupts();
+  if (lwip_rp2040_memcpy_busy[core]) {
+    restore_interrupts(save);
+    return 0;
+  }
+  lwip_rp2040_memcpy_busy[core] = 1;
+  restore_interrupts(save);
+
+  chan = lwip_rp2040_memcpy_chan[core];
+  if (chan == LWIP_MEMCPY_CHAN_NONE) {
+    chan = dma_claim_unused_channel(false);
+    lwip_rp2040_memcpy_chan[core] = (chan < 0) ? LWIP_MEMCPY_CHAN_FAILED : chan;
+  }
+  if (chan < 0) {
+    lwip_rp2040_memcpy_busy[core] = 0;
+    return 0;
+  }
+
+  /* the widest transfer both ends can be aligned for */
+  if ((diff & 3) == 0) {
+    size = DMA_SIZE_32;
+    shift = 2;
+  } else if ((diff & 1) == 0) {
+    size = DMA_SIZE_16;
+    shift = 1;
+  } else {
+    size = DMA_SIZE_8;
+    shift = 0;
+  }
+
+  head = (unsigned int)(-(mem_ptr_t)sb) & ((1u << shift) - 1);
+  if (head > len) {
+    head = len;
+  }
+  count = (len - head) >> shift;
+#if PICO_LWIP_MEMCPY_DMA_CPU_SHARE
+  count -= count / PICO_LWIP_MEMCPY_DMA_CPU_SHARE;
+#endif
+
+  if (count != 0) {
+    config = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&config, size);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, true);
+
+    /* what the CPU wrote to the source is in memory before the DMA reads it */
+    __compiler_memory_barrier();
+    dma_channel_configure(chan, &config, db + head, sb + head, count, true);
+  }
+
+  /* the CPU's share while the DMA runs: the head bytes, then everything after the
+     DMA's transfers */
+  done = head + (count << shift);
+  lwip_rp2040_memcpy_cpu(db, sb, head);
+  memcpy(db + done, sb + done, len - done);
+
+  if (count != 0) {
+    dma_channel_wait_for_finish_blocking(chan);
+    __compiler_memory_barrier();
+  }
+
+  lwip_rp2040_memcpy_busy[core] = 0;
+
+  return 1;
+}
+
+void
+LWIP_HOT_FUNC(lwip_rp2040_memcpy)(void *dst, const void *src, unsigned int len)
+{
+  if ((len >= PICO_LWIP_MEMCPY_DMA_MIN) && lwip_rp2040_memcpy_dma(dst, src, len)) {
+    return;
+  }
+
+  lwip_rp2040_memcpy_cpu(dst, src, len);
+}
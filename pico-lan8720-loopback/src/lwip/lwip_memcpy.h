@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_MEMCPY_H
+#define LWIP_MEMCPY_H
+
+#include "lwip/arch.h"
+
+/* lwIP's MEMCPY with PICO_LWIP_MEMCPY_DMA, for pbuf_copy(), pbuf_take(),
+   pbuf_copy_partial() and tcp_write() with TCP_WRITE_FLAG_COPY. A copy of
+   PICO_LWIP_MEMCPY_DMA_MIN bytes or more goes to a DMA channel of the calling core,
+   claimed at its first copy, in 32-bit transfers when source and destination have the
+   same word alignment, 16 or 8-bit ones otherwise. While the DMA copies the front,
+   the CPU copies the last 1/PICO_LWIP_MEMCPY_DMA_CPU_SHARE of the words itself, and
+   the copy returns once both are done. A shorter copy, and one that finds the channel
+   taken (from an interrupt handler, or a task that preempted another in the middle of
+   a copy under FreeRTOS), is copied by the CPU: a word loop when both ends are word
+   aligned, memcpy() otherwise. examples/memcpy_bench times the three for the
+   crossover */
+
+/* MEMCPY */
+void lwip_rp2040_memcpy(void *dst, const void *src, unsigned int len);
+
+/* the two halves of lwip_rp2040_memcpy() for examples/memcpy_bench, any length:
+   the CPU's copy, and the DMA's with the CPU's share, false without a free channel */
+void lwip_rp2040_memcpy_cpu(void *dst, const void *src, unsigned int len);
+int lwip_rp2040_memcpy_dma(void *dst, const void *src, unsigned int len);
+
+#endif /* LWIP_MEMCPY_H */
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* lwip's memp.c, optionally protected by the pool lock instead of the core one */
+#if PICO_LWIP_SYS_ARCH_SPLIT_LOCKS
+#define SYS_ARCH_PROTECT_LOCK SYS_ARCH_LOCK_POOL
+#endif
+
+/* PICO_RMII_HOT_IN_RAM, see arch/cc.h */
+#if PICO_RMII_HOT_IN_RAM
+#include "lwip/memp.h"
+
+#if !MEMP_OVERFLOW_CHECK
+/* memp_malloc() is a macro around memp_malloc_fn() with the overflow check */
+void *LWIP_HOT_FUNC(memp_malloc)(memp_t type);
+#endif
+void LWIP_HOT_FUNC(memp_free)(memp_t type, void *mem);
+#endif
+
+/* PICO_RMII_ETHERNET_SRAM_BANKS: the pbuf pool in SRAM2, see rmii_ethernet_sram_banks.ld.
+   The declaration gives the definition in memp.c its section, memp_init() sets it up */
+#if PICO_RMII_ETHERNET_SRAM_BANKS
+#include "lwip/arch.h"
+
+extern u8_t memp_memory_PBUF_POOL_base[] __attribute__((section(".sram2.memp_memory_PBUF_POOL_base")));
+#endif
+
+#include "../../lib/lwip/src/core/memp.c"
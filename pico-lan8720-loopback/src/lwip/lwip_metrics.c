@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/apps/fs.h"
+#include "lwip/def.h"
+#include "lwip/stats.h"
+
+#include "lwip_metrics.h"
+
+#if LWIP_STATS
+
+/* the protocols with their stats on, X(label, field of lwip_stats) */
+#if LINK_STATS
+#define LWIP_METRICS_LINK(X) X("link", link)
+#else
+#define LWIP_METRICS_LINK(X)
+#endif
+#if ETHARP_STATS
+#define LWIP_METRICS_ETHARP(X) X("etharp", etharp)
+#else
+#define LWIP_METRICS_ETHARP(X)
+#endif
+#if IPFRAG_STATS
+#define LWIP_METRICS_IPFRAG(X) X("ip_frag", ip_frag)
+#else
+#define LWIP_METRICS_IPFRAG(X)
+#endif
+#if IP_STATS
+#define LWIP_METRICS_IP(X) X("ip", ip)
+#else
+#define LWIP_METRICS_IP(X)
+#endif
+#if ICMP_STATS
+#define LWIP_METRICS_ICMP(X) X("icmp", icmp)
+#else
+#define LWIP_METRICS_ICMP(X)
+#endif
+#if UDP_STATS
+#define LWIP_METRICS_UDP(X) X("udp", udp)
+#else
+#define LWIP_METRICS_UDP(X)
+#endif
+#if TCP_STATS
+#define LWIP_METRICS_TCP(X) X("tcp", tcp)
+#else
+#define LWIP_METRICS_TCP(X)
+#endif
+#if IP6_STATS
+#define LWIP_METRICS_IP6(X) X("ip6", ip6)
+#else
+#define LWIP_METRICS_IP6(X)
+#endif
+#if ICMP6_STATS
+#define LWIP_METRICS_ICMP6(X) X("icmp6", icmp6)
+#else
+#define LWIP_METRICS_ICMP6(X)
+#endif
+
+#define LWIP_METRICS_PROTOS(X) \
+  LWIP_METRICS_LINK(X) LWIP_METRICS_ETHARP(X) LWIP_METRICS_IPFRAG(X) LWIP_METRICS_IP(X) \
+  LWIP_METRICS_ICMP(X) LWIP_METRICS_UDP(X) LWIP_METRICS_TCP(X) LWIP_METRICS_IP6(X) \
+  LWIP_METRICS_ICMP6(X)
+
+#define LWIP_METRICS_PROTO_POINTER(label, field) &lwip_stats.field,
+#define LWIP_METRICS_SENT(label, field) METRICS_SAMPLE("lwip_packets_sent_total{proto=\"" label "\"}"),
+#define LWIP_METRICS_RECEIVED(label, field) METRICS_SAMPLE("lwip_packets_received_total{proto=\"" label "\"}"),
+#define LWIP_METRICS_DROPPED(label, field) METRICS_SAMPLE("lwip_packets_dropped_total{proto=\"" label "\"}"),
+#define LWIP_METRICS_ERRORS(label, field) METRICS_SAMPLE("lwip_packet_errors_total{proto=\"" label "\"}"),
+
+static const metrics_line_t lwip_metrics_lines[] = {
+#if MEM_STATS
+  METRICS_FAMILY("lwip_mem_used_bytes", "gauge", "Bytes of lwIP's heap in use"),
+  METRICS_SAMPLE("lwip_mem_used_bytes"),
+  METRICS_FAMILY("lwip_mem_max_bytes", "gauge", "High-water mark of lwIP's heap"),
+  METRICS_SAMPLE("lwip_mem_max_bytes"),
+  METRICS_FAMILY("lwip_mem_size_bytes", "gauge", "Bytes of lwIP's heap"),
+  METRICS_SAMPLE("lwip_mem_size_bytes"),
+  METRICS_FAMILY("lwip_mem_errors_total", "counter", "Failed allocations from lwIP's heap"),
+  METRICS_SAMPLE("lwip_mem_errors_total"),
+#endif /* MEM_STATS */
+#if MEMP_STATS
+  METRICS_FAMILY("lwip_memp_used", "gauge", "Elements of a pool in use"),
+#define LWIP_MEMPOOL(name, num, size, desc) METRICS_SAMPLE("lwip_memp_used{pool=\"" #name "\"}"),
+#include "lwip/priv/memp_std.h"
+  METRICS_FAMILY("lwip_memp_max", "gauge", "High-water mark of a pool"),
+#define LWIP_MEMPOOL(name, num, size, desc) METRICS_SAMPLE("lwip_memp_max{pool=\"" #name "\"}"),
+#include "lwip/priv/memp_std.h"
+  METRICS_FAMILY("lwip_memp_size", "gauge", "Elements of a pool"),
+#define LWIP_MEMPOOL(name, num, size, desc) METRICS_SAMPLE("lwip_memp_size{pool=\"" #name "\"}"),
+#include "lwip/priv/memp_std.h"
+  METRICS_FAMILY("lwip_memp_errors_total", "counter", "Failed allocations from a pool"),
+#define LWIP_MEMPOOL(name, num, size, desc) METRICS_SAMPLE("lwip_memp_errors_total{pool=\"" #name "\"}"),
+#include "lwip/priv/memp_std.h"
+#endif /* MEMP_STATS */
+  METRICS_FAMILY("lwip_packets_sent_total", "counter", "Packets sent by a protocol"),
+  LWIP_METRICS_PROTOS(LWIP_METRICS_SENT)
+  METRICS_FAMILY("lwip_packets_received_total", "counter", "Packets received by a protocol"),
+  LWIP_METRICS_PROTOS(LWIP_METRICS_RECEIVED)
+  METRICS_FAMILY("lwip_packets_dropped_total", "counter", "Packets dropped by a protocol"),
+  LWIP_METRICS_PROTOS(LWIP_METRICS_DROPPED)
+  METRICS_FAMILY("lwip_packet_errors_total", "counter", "Checksum, length, memory, routing, protocol and option errors of a protocol"),
+  LWIP_METRICS_PROTOS(LWIP_METRICS_ERRORS)
+};
+
+static struct stats_proto *const lwip_metrics_protos[] = {
+  LWIP_METRICS_PROTOS(LWIP_METRICS_PROTO_POINTER)
+};
+
+#define LWIP_METRICS_NPROTOS (sizeof(lwip_metrics_protos) / sizeof(lwip_metrics_protos[0]))
+
+/* in the order of lwip_metrics_lines */
+static void
+lwip_metrics_collect(uint64_t *values)
+{
+  size_t i;
+
+#if MEM_STATS
+  *values++ = lwip_stats.mem.used;
+  *values++ = lwip_stats.mem.max;
+  *values++ = lwip_stats.mem.avail;
+  *values++ = lwip_stats.mem.err;
+#endif /* MEM_STATS */
+#if MEMP_STATS
+  for (i = 0; i < MEMP_MAX; i++) {
+    values[i] = lwip_stats.memp[i]->used;
+    values[MEMP_MAX + i] = lwip_stats.memp[i]->max;
+    values[2 * MEMP_MAX + i] = lwip_stats.memp[i]->avail;
+    values[3 * MEMP_MAX + i] = lwip_stats.memp[i]->err;
+  }
+  values += 4 * MEMP_MAX;
+#endif /* MEMP_STATS */
+  for (i = 0; i < LWIP_METRICS_NPROTOS; i++) {
+    const struct stats_proto *proto = lwip_metrics_protos[i];
+
+    values[i] = proto->xmit;
+    values[LWIP_METRICS_NPROTOS + i] = proto->recv;
+    values[2 * LWIP_METRICS_NPROTOS + i] = proto->drop;
+    values[3 * LWIP_METRICS_NPROTOS + i] = (uint64_t)proto->chkerr + proto->lenerr + proto->memerr +
+                                           proto->rterr + proto->proterr + proto->opterr + proto->err;
+  }
+}
+
+static const metrics_section_t lwip_metrics_section = {
+  lwip_metrics_lines,
+  sizeof(lwip_metrics_lines) / sizeof(lwip_metrics_lines[0]),
+  lwip_metrics_collect
+};
+
+/* samples of lwip_metrics_lines */
+#define LWIP_METRICS_OWN_VALUES (4 * MEM_STATS + 4 * MEMP_MAX * MEMP_STATS + 4 * LWIP_METRICS_NPROTOS)
+
+#define LWIP_METRICS_FIRST 1
+#else /* LWIP_STATS */
+#define LWIP_METRICS_OWN_VALUES 0
+#define LWIP_METRICS_FIRST 0
+#endif /* LWIP_STATS */
+
+static const metrics_section_t *lwip_metrics_sections[LWIP_METRICS_SECTIONS] = {
+#if LWIP_STATS
+  &lwip_metrics_section
+#else /* LWIP_STATS */
+  NULL
+#endif /* LWIP_STATS */
+};
+static u8_t lwip_metrics_nsections = LWIP_METRICS_FIRST;
+
+#define LWIP_METRICS_HEAD "HTTP/1.0 200 OK\r\nServer: lwIP\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+#define LWIP_METRICS_HEAD_LEN (sizeof(LWIP_METRICS_HEAD) - 1)
+
+/* the header is the first head_len bytes of the file, the text after it */
+struct lwip_metrics_scrape {
+  u8_t used;
+  u8_t head_len;
+  char head[LWIP_METRICS_HEAD_LEN + 10 + 4];
+  metrics_scrape_t scrape;
+  uint64_t values[LWIP_METRICS_OWN_VALUES + LWIP_METRICS_VALUES];
+};
+
+static struct lwip_metrics_scrape lwip_metrics_scrapes[LWIP_METRICS_SCRAPES];
+
+err_t
+lwip_metrics_add(const metrics_section_t *section)
+{
+  if (lwip_metrics_nsections == LWIP_METRICS_SECTIONS ||
+      lwip_metrics_values() + metrics_section_values(section) > LWIP_METRICS_OWN_VALUES + LWIP_METRICS_VALUES) {
+    return ERR_MEM;
+  }
+
+  lwip_metrics_sections[lwip_metrics_nsections++] = section;
+
+  return ERR_OK;
+}
+
+u16_t
+lwip_metrics_values(void)
+{
+  u16_t values = 0;
+
+  for (u8_t i = 0; i < lwip_metrics_nsections; i++) {
+    values += metrics_section_values(lwip_metrics_sections[i]);
+  }
+
+  return values;
+}
+
+u32_t
+lwip_metrics_begin(metrics_scrape_t *scrape, uint64_t *values)
+{
+  return metrics_scrape_begin(scrape, lwip_metrics_sections, lwip_metrics_nsections, values);
+}
+
+int
+fs_open_custom(struct fs_file *file, const char *name)
+{
+  struct lwip_metrics_scrape *s = NULL;
+  u32_t length;
+  char *end;
+
+  if (strcmp(name, LWIP_METRICS_URI) != 0) {
+    return 0;
+  }
+
+  for (int i = 0; i < LWIP_METRICS_SCRAPES; i++) {
+    if (!lwip_metrics_scrapes[i].used) {
+      s = &lwip_metrics_scrapes[i];
+      break;
+    }
+  }
+
+  if (s == NULL) {
+    return 0;
+  }
+
+  length = lwip_metrics_begin(&s->scrape, s->values);
+
+  memcpy(s->head, LWIP_METRICS_HEAD, LWIP_METRICS_HEAD_LEN);
+  end = metrics_utoa(s->head + LWIP_METRICS_HEAD_LEN, length);
+  memcpy(end, "\r\n\r\n", 4);
+  s->head_len = (u8_t)(end + 4 - s->head);
+  s->used = 1;
+
+  file->data = NULL;   /* read through fs_read_custom() */
+  file->len = (int)(s->head_len + length);
+  file->index = 0;
+  file->pextension = s;
+  file->flags = FS_FILE_FLAGS_HEADER_INCLUDED;
+
+  return 1;
+}
+
+void
+fs_close_custom(struct fs_file *file)
+{
+  struct lwip_metrics_scrape *s = (struct lwip_metrics_scrape *)file->pextension;
+
+  if (s != NULL) {
+    s->used = 0;
+    file->pextension = NULL;
+  }
+}
+
+int
+fs_read_custom(struct fs_file *file, char *buffer, int count)
+{
+  struct lwip_metrics_scrape *s = (struct lwip_metrics_scrape *)file->pextension;
+  int n = 0;
+
+  if (s == NULL || file->index >= file->len) {
+    return FS_READ_EOF;
+  }
+
+  if (file->index < s->head_len) {
+    n = LWIP_MIN(count, s->head_len - file->index);
+    memcpy(buffer, s->head + file->index, n);
+  }
+
+  if (n < count) {
+    n += (int)metrics_scrape_read(&s->scrape, (u32_t)(file->index + n - s->head_len),
+                                  buffer + n, (size_t)(count - n));
+  }
+
+  file->index += n;
+
+  return n;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_METRICS_H
+#define LWIP_METRICS_H
+
+#include "lwip/opt.h"
+#include "lwip/err.h"
+
+#include "metrics.h"
+
+/* Prometheus metrics on httpd: a GET of LWIP_METRICS_URI answers lwIP's counters (heap,
+   pools, and the packets, drops and errors of each protocol with its stats on) and those
+   of the sections added with lwip_metrics_add(), in the text format of metrics/ of the
+   repository root. A custom file of httpd's fs (LWIP_HTTPD_CUSTOM_FILES): the values are
+   taken as it opens, the header with their Content-Length is written then, and the text
+   is rendered as httpd reads the file, into the buffer it passes to tcp_write(), as much
+   as the send buffer takes each time. Up to LWIP_METRICS_SCRAPES scrapes at once, one
+   more finds no file (404). Called from httpd, so from lwIP context. */
+
+#ifndef LWIP_METRICS_URI
+#define LWIP_METRICS_URI "/metrics"
+#endif
+
+/* sections, lwIP's own included */
+#ifndef LWIP_METRICS_SECTIONS
+#define LWIP_METRICS_SECTIONS 4
+#endif
+
+/* samples of the sections added, the values a scrape keeps on top of lwIP's */
+#ifndef LWIP_METRICS_VALUES
+#define LWIP_METRICS_VALUES 64
+#endif
+
+#ifndef LWIP_METRICS_SCRAPES
+#define LWIP_METRICS_SCRAPES 2
+#endif
+
+/* Adds section to the scrapes, after lwIP's and those added before. section is kept, not
+   copied. ERR_MEM without room for it or its values */
+err_t lwip_metrics_add(const metrics_section_t *section);
+
+/* samples of lwIP's section and the added ones */
+u16_t lwip_metrics_values(void);
+
+/* Starts a scrape of the sections for another transport than httpd, values room for
+   lwip_metrics_values(). Returns the length of the text, read with metrics_scrape_read() */
+u32_t lwip_metrics_begin(metrics_scrape_t *scrape, uint64_t *values);
+
+#endif /* LWIP_METRICS_H */
@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/pbuf.h"
+#include "lwip/timeouts.h"
+
+#include "lwip_ota.h"
+
+#define LWIP_OTA_CAPACITY               (LWIP_OTA_BUFFERS * LWIP_OTA_SECTOR_SIZE)
+
+#define LWIP_OTA_OP_NONE                0
+#define LWIP_OTA_OP_ERASE               1
+#define LWIP_OTA_OP_PROGRAM             2
+
+static struct lwip_ota *lwip_ota_instance;
+
+/* CRC-32 a nibble at a time, 64 bytes of table */
+static const u32_t lwip_ota_crc_table[16] = {
+  0x00000000UL, 0x1db71064UL, 0x3b6e20c8UL, 0x26d930acUL,
+  0x76dc4190UL, 0x6b6b51f4UL, 0x4db26158UL, 0x5005713cUL,
+  0xedb88320UL, 0xf00f9344UL, 0xd6d6a3e8UL, 0xcb61b38cUL,
+  0x9b64c2b0UL, 0x86d3d2d4UL, 0xa00ae278UL, 0xbdbdf21cUL
+};
+
+u32_t
+lwip_ota_crc32(u32_t crc, const void *data, u32_t len)
+{
+  const u8_t *bytes = (const u8_t *)data;
+
+  crc = ~crc;
+  while (len-- != 0) {
+    crc ^= *bytes++;
+    crc = (crc >> 4) ^ lwip_ota_crc_table[crc & 0xf];
+    crc = (crc >> 4) ^ lwip_ota_crc_table[crc & 0xf];
+  }
+  return ~crc;
+}
+
+/* the staging bytes the image takes, erased whole sectors */
+static u32_t
+lwip_ota_erase_end(struct lwip_ota *ota)
+{
+  if (ota->header_len < sizeof(ota->header)) {
+    return 0;
+  }
+  return (ota->header.length + LWIP_OTA_SECTOR_SIZE - 1) & ~(u32_t)(LWIP_OTA_SECTOR_SIZE - 1);
+}
+
+/* room in the buffers for blocks to come */
+static u32_t
+lwip_ota_room(struct lwip_ota *ota)
+{
+  return LWIP_OTA_CAPACITY - (ota->received - ota->programmed);
+}
+
+static void
+lwip_ota_op_done(struct lwip_ota *ota)
+{
+  if (ota->op == LWIP_OTA_OP_ERASE) {
+    ota->erased += ota->op_len;
+  } else {
+    /* the bytes as they are in flash now, the padding of the last page left out */
+    u32_t len = LWIP_MIN(ota->op_len, ota->header.length - ota->op_offset);
+
+    ota->crc = lwip_ota_crc32(ota->crc, &ota->flash->mapped[ota->op_offset], len);
+    ota->programmed = ota->op_offset + len;
+  }
+  ota->op = LWIP_OTA_OP_NONE;
+}
+
+/* Starts the next erase or program, programs first so the buffers drain. Returns 0 when
+   there is nothing to start */
+static u8_t
+lwip_ota_op_start(struct lwip_ota *ota)
+{
+  const struct lwip_ota_flash *flash = ota->flash;
+  u32_t erase_end = lwip_ota_erase_end(ota);
+  u32_t offset = ota->programmed;
+  u32_t end;
+
+  /* whole pages within one sector buffer and what is erased, the last page once the
+     image is in */
+  end = ota->received & ~(u32_t)(LWIP_OTA_PAGE_SIZE - 1);
+  if ((ota->received == ota->header.length) && (ota->received != end) && (erase_end != 0)) {
+    u32_t pad = ota->received % LWIP_OTA_PAGE_SIZE;
+
+    memset(&ota->buffers[ota->received % LWIP_OTA_CAPACITY], 0xff, LWIP_OTA_PAGE_SIZE - pad);
+    end += LWIP_OTA_PAGE_SIZE;
+  }
+  end = LWIP_MIN(end, (offset & ~(u32_t)(LWIP_OTA_SECTOR_SIZE - 1)) + LWIP_OTA_SECTOR_SIZE);
+  end = LWIP_MIN(end, ota->erased);
+
+  if (end > offset) {
+    ota->op = LWIP_OTA_OP_PROGRAM;
+    ota->op_offset = offset;
+    ota->op_len = end - offset;
+    ota->programs++;
+    flash->program(offset, &ota->buffers[offset % LWIP_OTA_CAPACITY], ota->op_len);
+    return 1;
+  }
+
+  if (ota->erased < erase_end) {
+    ota->op = LWIP_OTA_OP_ERASE;
+    ota->op_offset = ota->erased;
+    /* a block erase takes about as long as four sector ones */
+    if (((ota->erased % LWIP_OTA_BLOCK_SIZE) == 0) && ((erase_end - ota->erased) >= LWIP_OTA_BLOCK_SIZE)) {
+      ota->op_len = LWIP_OTA_BLOCK_SIZE;
+    } else {
+      ota->op_len = LWIP_OTA_SECTOR_SIZE;
+    }
+    ota->erases++;
+    flash->erase(ota->op_offset, ota->op_len);
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Ends the operation that is done and starts the next, and lets a held ACK go once
+   there is room for a window */
+static void
+lwip_ota_step(struct lwip_ota *ota)
+{
+  if (ota->op != LWIP_OTA_OP_NONE) {
+    if (ota->flash->busy()) {
+      return;
+    }
+    lwip_ota_op_done(ota);
+  }
+  lwip_ota_op_start(ota);
+
+  if (ota->held && (lwip_ota_room(ota) >= LWIP_OTA_WINDOW)) {
+    ota->held = 0;
+    tftp_resume();
+  }
+}
+
+static void
+lwip_ota_timeout(void *arg)
+{
+  struct lwip_ota *ota = (struct lwip_ota *)arg;
+
+  lwip_ota_step(ota);
+  sys_timeout(1, lwip_ota_timeout, ota);
+}
+
+static void
+lwip_ota_stop(struct lwip_ota *ota, u8_t state)
+{
+  sys_untimeout(lwip_ota_timeout, ota);
+  if (ota->op != LWIP_OTA_OP_NONE) {
+    ota->flash->wait();
+    ota->op = LWIP_OTA_OP_NONE;
+  }
+  ota->held = 0;
+  ota->state = state;
+}
+
+/* The last block is in: what is left is programmed while the client waits for its ACK,
+   which reports whether the image made it */
+static int
+lwip_ota_finish(struct lwip_ota *ota)
+{
+  do {
+    if (ota->op != LWIP_OTA_OP_NONE) {
+      ota->flash->wait();
+      lwip_ota_op_done(ota);
+    }
+  } while (lwip_ota_op_start(ota));
+
+  if ((ota->programmed != ota->header.length) || (ota->crc != ota->header.crc) ||
+      (ota->flash->commit(&ota->header) != 0)) {
+    lwip_ota_stop(ota, LWIP_OTA_FAILED);
+    return -1;
+  }
+  ota->updates++;
+  lwip_ota_stop(ota, LWIP_OTA_DONE);
+  return 0;
+}
+
+static void *
+lwip_ota_open(const char *fname, const char *mode, u8_t is_write)
+{
+  struct lwip_ota *ota = lwip_ota_instance;
+
+  LWIP_UNUSED_ARG(fname);
+
+  /* netascii would change the bytes */
+  if (!is_write || (ota->state == LWIP_OTA_RECEIVING) || (lwip_stricmp(mode, "octet") != 0)) {
+    return NULL;
+  }
+
+  /* the image staged before is written over */
+  if (ota->flash->commit(NULL) != 0) {
+    return NULL;
+  }
+
+  ota->header_len = 0;
+  ota->received = 0;
+  ota->programmed = 0;
+  ota->erased = 0;
+  ota->crc = 0;
+  ota->op = LWIP_OTA_OP_NONE;
+  ota->held = 0;
+  ota->state = LWIP_OTA_RECEIVING;
+  sys_timeout(1, lwip_ota_timeout, ota);
+
+  return ota;
+}
+
+static void
+lwip_ota_close(void *handle)
+{
+  struct lwip_ota *ota = (struct lwip_ota *)handle;
+
+  /* a transfer that was given up or went wrong */
+  if (ota->state == LWIP_OTA_RECEIVING) {
+    lwip_ota_stop(ota, LWIP_OTA_FAILED);
+  }
+}
+
+static int
+lwip_ota_read(void *handle, void *buf, int bytes)
+{
+  LWIP_UNUSED_ARG(handle);
+  LWIP_UNUSED_ARG(buf);
+  LWIP_UNUSED_ARG(bytes);
+
+  return -1;
+}
+
+static int
+lwip_ota_write(void *handle, struct pbuf *p)
+{
+  struct lwip_ota *ota = (struct lwip_ota *)handle;
+  u16_t offset = 0;
+  u16_t len;
+
+  if (ota->state != LWIP_OTA_RECEIVING) {
+    return -1;
+  }
+
+  /* the header, which may come in more than one block */
+  if (ota->header_len < sizeof(ota->header)) {
+    len = (u16_t)LWIP_MIN(sizeof(ota->header) - ota->header_len, p->tot_len);
+    pbuf_copy_partial(p, (u8_t *)&ota->header + ota->header_len, len, 0);
+    ota->header_len += len;
+    offset = len;
+
+    if ((ota->header_len == sizeof(ota->header)) &&
+        ((ota->header.magic != LWIP_OTA_MAGIC) || (ota->header.length == 0) ||
+         (ota->header.length > ota->flash->size))) {
+      lwip_ota_stop(ota, LWIP_OTA_FAILED);
+      return -1;
+    }
+  }
+
+  len = (u16_t)(p->tot_len - offset);
+  if (len != 0) {
+    u32_t pos = ota->received % LWIP_OTA_CAPACITY;
+    u16_t first = (u16_t)LWIP_MIN(len, LWIP_OTA_CAPACITY - pos);
+
+    if ((ota->header_len < sizeof(ota->header)) || (len > ota->header.length - ota->received)) {
+      lwip_ota_stop(ota, LWIP_OTA_FAILED);
+      return -1;
+    }
+
+    /* a client that sends more than it was told to has to wait for the flash */
+    while (lwip_ota_room(ota) < len) {
+      if (ota->op != LWIP_OTA_OP_NONE) {
+        ota->flash->wait();
+      }
+      lwip_ota_step(ota);
+    }
+
+    pbuf_copy_partial(p, &ota->buffers[pos], first, offset);
+    if (first != len) {
+      pbuf_copy_partial(p, ota->buffers, (u16_t)(len - first), (u16_t)(offset + first));
+    }
+    ota->received += len;
+  }
+
+  if ((ota->header_len == sizeof(ota->header)) && (ota->received == ota->header.length)) {
+    return lwip_ota_finish(ota);
+  }
+
+  lwip_ota_step(ota);
+  return 0;
+}
+
+/* Asked before the ACK of a window, the client sends the next one after it */
+static int
+lwip_ota_ack_ready(void *handle)
+{
+  struct lwip_ota *ota = (struct lwip_ota *)handle;
+
+  if (lwip_ota_room(ota) >= LWIP_OTA_WINDOW) {
+    return 1;
+  }
+  ota->held = 1;
+  ota->holds++;
+  return 0;
+}
+
+static const struct tftp_context lwip_ota_tftp = {
+  lwip_ota_open,
+  lwip_ota_close,
+  lwip_ota_read,
+  lwip_ota_write,
+  lwip_ota_ack_ready
+};
+
+err_t
+lwip_ota_init(struct lwip_ota *ota, const struct lwip_ota_flash *flash)
+{
+  memset(ota, 0, sizeof(*ota));
+  ota->flash = flash;
+  ota->state = LWIP_OTA_IDLE;
+  lwip_ota_instance = ota;
+
+  return tftp_init(&lwip_ota_tftp);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_OTA_H
+#define LWIP_OTA_H
+
+#include "lwip/opt.h"
+#include "lwip/apps/tftp_server.h"
+
+/* Firmware updates written by TFTP (a put of any name in octet mode) into a staging area
+   of flash, see tools/ota_push.py. The image is the firmware behind a struct
+   lwip_ota_header. Its bytes go into LWIP_OTA_BUFFERS sector buffers, and the flash
+   backend programs them page by page while the next blocks come in: erases and
+   programs run at the backend's pace (on the other core with the RP2040's, see
+   lwip_ota_rp2040.c) and only the ACK of a window waits, when the buffers don't have
+   room for another window. The CRC is computed from flash, and the backend's commit()
+   of a matching image marks it for the next boot. All the functions are called from
+   lwIP context. The transfer takes a sys_timeout (a 1 ms step) and tftp_server.c's
+   timer, two of the 5 MEMP_NUM_SYS_TIMEOUT keeps for the apps */
+
+#if !TFTP_OPTIONS
+#error "lwip_ota.c holds back ACKs through tftp_context::ack_ready(), it needs TFTP_OPTIONS"
+#endif
+
+/* flash geometry the staging area is erased and programmed in */
+#define LWIP_OTA_PAGE_SIZE              256
+#define LWIP_OTA_SECTOR_SIZE            4096
+#define LWIP_OTA_BLOCK_SIZE             65536
+
+/* the most a client sends before it waits for an ACK */
+#define LWIP_OTA_WINDOW                 (TFTP_MAX_BLKSIZE * TFTP_MAX_WINDOWSIZE)
+
+/* sector buffers between the TFTP blocks and flash, room for two windows so one comes
+   in while the other is programmed */
+#ifndef LWIP_OTA_BUFFERS
+#define LWIP_OTA_BUFFERS                ((2 * LWIP_OTA_WINDOW + LWIP_OTA_SECTOR_SIZE - 1) / LWIP_OTA_SECTOR_SIZE)
+#endif
+
+#if LWIP_OTA_BUFFERS * LWIP_OTA_SECTOR_SIZE < 2 * LWIP_OTA_WINDOW
+#error "LWIP_OTA_BUFFERS must hold two windows of TFTP_MAX_BLKSIZE * TFTP_MAX_WINDOWSIZE"
+#endif
+
+#define LWIP_OTA_MAGIC                  0x41544f50UL /* "POTA" */
+
+/* in front of the firmware, little endian. crc is the CRC-32 (IEEE 802.3, zlib's) of
+   the length bytes that follow */
+struct lwip_ota_header {
+  u32_t magic;
+  u32_t length;
+  u32_t crc;
+  u32_t version;
+};
+
+/* the staging area. erase() and program() start an operation and return, busy() tells
+   it is still going on and wait() waits for its end. mapped is read between
+   operations only. commit() writes the record that has the image applied at the next
+   boot, or with NULL withdraws the one of an image staged before. Offsets are from the
+   start of the staging area, erases are whole sectors or blocks and programs whole
+   pages */
+struct lwip_ota_flash {
+  u32_t size;
+  const u8_t *mapped;
+  void (*erase)(u32_t offset, u32_t len);
+  void (*program)(u32_t offset, const u8_t *data, u32_t len);
+  int (*busy)(void);
+  void (*wait)(void);
+  int (*commit)(const struct lwip_ota_header *header);
+};
+
+enum lwip_ota_state {
+  LWIP_OTA_IDLE,
+  LWIP_OTA_RECEIVING,
+  LWIP_OTA_DONE,    /* committed, for the next boot */
+  LWIP_OTA_FAILED
+};
+
+struct lwip_ota {
+  const struct lwip_ota_flash *flash;
+  struct lwip_ota_header header;
+  u8_t buffers[LWIP_OTA_BUFFERS * LWIP_OTA_SECTOR_SIZE];
+  u32_t header_len;  /* header bytes received */
+  u32_t received;    /* image bytes received */
+  u32_t programmed;  /* image bytes programmed and read back */
+  u32_t erased;      /* staging bytes erased */
+  u32_t op_offset;   /* the operation going on */
+  u32_t op_len;
+  u32_t crc;
+  u8_t op;
+  u8_t held;         /* the TFTP server holds an ACK */
+  u8_t timer;        /* the step's sys_timeout is pending */
+  u8_t state;
+  /* for the stats of the app */
+  u32_t holds;       /* ACKs held back for room in the buffers */
+  u32_t erases;
+  u32_t programs;
+  u32_t updates;     /* images committed */
+};
+
+/* Starts lwIP's TFTP server writing to flash through ota, a single transfer at a time */
+err_t lwip_ota_init(struct lwip_ota *ota, const struct lwip_ota_flash *flash);
+
+/* CRC-32 of len bytes going on from crc, with the pre and post inversion: 0 starts one */
+u32_t lwip_ota_crc32(u32_t crc, const void *data, u32_t len);
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "hardware/watchdog.h"
+
+#include "lwip_ota_rp2040.h"
+
+#if !PICO_COPY_TO_RAM
+#error "lwip_ota_rp2040.c writes flash while the other core runs, the firmware must be a copy_to_ram binary"
+#endif
+
+#if PICO_RMII_ETHERNET_DUAL_CORE
+#error "the flash worker takes the core PICO_RMII_ETHERNET_DUAL_CORE runs lwIP on"
+#endif
+
+/* the record is "pending" until the image is applied */
+#define LWIP_OTA_RP2040_PENDING         0x444e4550UL /* "PEND" */
+
+#define LWIP_OTA_RP2040_ERASE           1
+#define LWIP_OTA_RP2040_PROGRAM         2
+
+struct lwip_ota_rp2040_record {
+  u32_t pending;
+  struct lwip_ota_header header;
+};
+
+/* the job posted to the worker, started when seq moves on and done when done does */
+static struct {
+  u32_t op;
+  u32_t offset; /* from the start of flash */
+  const u8_t *data;
+  u32_t len;
+  volatile u32_t seq;
+  volatile u32_t done;
+} lwip_ota_rp2040_job;
+
+/* the record's page, programmed from RAM */
+static u8_t lwip_ota_rp2040_page[FLASH_PAGE_SIZE] __attribute__((aligned(4)));
+
+static const struct lwip_ota_rp2040_record *
+lwip_ota_rp2040_record(void)
+{
+  return (const struct lwip_ota_rp2040_record *)(XIP_BASE + LWIP_OTA_RP2040_RECORD_OFFSET);
+}
+
+static void
+lwip_ota_rp2040_post(u32_t op, u32_t offset, const u8_t *data, u32_t len)
+{
+  lwip_ota_rp2040_job.op = op;
+  lwip_ota_rp2040_job.offset = offset;
+  lwip_ota_rp2040_job.data = data;
+  lwip_ota_rp2040_job.len = len;
+  __dmb();
+  lwip_ota_rp2040_job.seq++;
+  __sev();
+}
+
+static void
+lwip_ota_rp2040_erase(u32_t offset, u32_t len)
+{
+  lwip_ota_rp2040_post(LWIP_OTA_RP2040_ERASE, LWIP_OTA_RP2040_STAGING_OFFSET + offset, NULL, len);
+}
+
+static void
+lwip_ota_rp2040_program(u32_t offset, const u8_t *data, u32_t len)
+{
+  lwip_ota_rp2040_post(LWIP_OTA_RP2040_PROGRAM, LWIP_OTA_RP2040_STAGING_OFFSET + offset, data, len);
+}
+
+static int
+lwip_ota_rp2040_busy(void)
+{
+  return lwip_ota_rp2040_job.done != lwip_ota_rp2040_job.seq;
+}
+
+static void
+lwip_ota_rp2040_wait(void)
+{
+  while (lwip_ota_rp2040_busy()) {
+    __wfe();
+  }
+  __dmb();
+}
+
+static int
+lwip_ota_rp2040_commit(const struct lwip_ota_header *header)
+{
+  if (header == NULL) {
+    /* withdrawn when there is one, the sector isn't erased for nothing */
+    if (lwip_ota_rp2040_record()->pending != LWIP_OTA_RP2040_PENDING) {
+      return 0;
+    }
+    lwip_ota_rp2040_post(LWIP_OTA_RP2040_ERASE, LWIP_OTA_RP2040_RECORD_OFFSET, NULL, FLASH_SECTOR_SIZE);
+    lwip_ota_rp2040_wait();
+    return 0;
+  }
+
+  /* the image is copied to offset 0, it must leave the staging area alone */
+  if (header->length > LWIP_OTA_RP2040_STAGING_OFFSET) {
+    return -1;
+  }
+
+  memset(lwip_ota_rp2040_page, 0xff, sizeof(lwip_ota_rp2040_page));
+  ((struct lwip_ota_rp2040_record *)lwip_ota_rp2040_page)->pending = LWIP_OTA_RP2040_PENDING;
+  ((struct lwip_ota_rp2040_record *)lwip_ota_rp2040_page)->header = *header;
+
+  lwip_ota_rp2040_post(LWIP_OTA_RP2040_ERASE, LWIP_OTA_RP2040_RECORD_OFFSET, NULL, FLASH_SECTOR_SIZE);
+  lwip_ota_rp2040_wait();
+  lwip_ota_rp2040_post(LWIP_OTA_RP2040_PROGRAM, LWIP_OTA_RP2040_RECORD_OFFSET, lwip_ota_rp2040_page, FLASH_PAGE_SIZE);
+  lwip_ota_rp2040_wait();
+
+  return (memcmp(lwip_ota_rp2040_record(), lwip_ota_rp2040_page, sizeof(struct lwip_ota_rp2040_record)) == 0) ? 0 : -1;
+}
+
+const struct lwip_ota_flash lwip_ota_rp2040_flash = {
+  LWIP_OTA_RP2040_RECORD_OFFSET - LWIP_OTA_RP2040_STAGING_OFFSET,
+  (const u8_t *)(XIP_BASE + LWIP_OTA_RP2040_STAGING_OFFSET),
+  lwip_ota_rp2040_erase,
+  lwip_ota_rp2040_program,
+  lwip_ota_rp2040_busy,
+  lwip_ota_rp2040_wait,
+  lwip_ota_rp2040_commit
+};
+
+void
+lwip_ota_rp2040_worker(void)
+{
+  u32_t done = lwip_ota_rp2040_job.done;
+
+  while (1) {
+    u32_t save;
+
+    while (lwip_ota_rp2040_job.seq == done) {
+      __wfe();
+    }
+    __dmb();
+
+    /* XIP is off while erasing and programming, nothing may run from flash, this core's
+       interrupts included. The other core runs from RAM too */
+    save = save_and_disable_interrupts();
+    if (lwip_ota_rp2040_job.op == LWIP_OTA_RP2040_ERASE) {
+      flash_range_erase(lwip_ota_rp2040_job.offset, lwip_ota_rp2040_job.len);
+    } else {
+      flash_range_program(lwip_ota_rp2040_job.offset, lwip_ota_rp2040_job.data, lwip_ota_rp2040_job.len);
+    }
+    restore_interrupts(save);
+
+    done = lwip_ota_rp2040_job.seq;
+    __dmb();
+    lwip_ota_rp2040_job.done = done;
+    __sev();
+  }
+}
+
+void
+lwip_ota_rp2040_boot(void)
+{
+  static u8_t sector[FLASH_SECTOR_SIZE] __attribute__((aligned(4)));
+  const struct lwip_ota_rp2040_record *record = lwip_ota_rp2040_record();
+  const u8_t *staged = (const u8_t *)(XIP_BASE + LWIP_OTA_RP2040_STAGING_OFFSET);
+  struct lwip_ota_header header;
+  u32_t save;
+
+  if (record->pending != LWIP_OTA_RP2040_PENDING) {
+    return;
+  }
+  header = record->header;
+
+  /* a staged image went bad since its commit, the firmware that runs stays */
+  if ((header.length > LWIP_OTA_RP2040_STAGING_OFFSET) ||
+      (lwip_ota_crc32(0, staged, header.length) != header.crc)) {
+    save = save_and_disable_interrupts();
+    flash_range_erase(LWIP_OTA_RP2040_RECORD_OFFSET, FLASH_SECTOR_SIZE);
+    restore_interrupts(save);
+    return;
+  }
+
+  /* this copy of the firmware runs from RAM, the one in flash is free to go */
+  for (u32_t offset = 0; offset < header.length; offset += FLASH_SECTOR_SIZE) {
+    memcpy(sector, &staged[offset], FLASH_SECTOR_SIZE);
+
+    save = save_and_disable_interrupts();
+    flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    flash_range_program(offset, sector, FLASH_SECTOR_SIZE);
+    restore_interrupts(save);
+  }
+
+  save = save_and_disable_interrupts();
+  flash_range_erase(LWIP_OTA_RP2040_RECORD_OFFSET, FLASH_SECTOR_SIZE);
+  restore_interrupts(save);
+
+  watchdog_reboot(0, 0, 0);
+  while (1) {
+    tight_loop_contents();
+  }
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_OTA_RP2040_H
+#define LWIP_OTA_RP2040_H
+
+#include "hardware/flash.h"
+
+#include "lwip_ota.h"
+
+/* lwip_ota.c's flash on the RP2040. The image is staged from the middle of flash up to
+   the last sector, which keeps the record of a committed image, and at the next boot
+   lwip_ota_rp2040_boot() copies it over the firmware at offset 0 sector by sector.
+   There is no bootloader to fall back to: a power loss during that copy leaves a
+   board that has to be flashed over USB again.
+
+   Erases and programs turn XIP off for their duration, and they run on the core that
+   doesn't run lwIP, in lwip_ota_rp2040_worker(). The core running lwIP and the driver
+   goes on with its interrupts on, so the next blocks come in while the flash is
+   written. That only holds when nothing runs from flash: the firmware must be a
+   copy_to_ram binary, see examples/ota */
+
+#ifndef LWIP_OTA_RP2040_STAGING_OFFSET
+#define LWIP_OTA_RP2040_STAGING_OFFSET  (PICO_FLASH_SIZE_BYTES / 2)
+#endif
+
+#define LWIP_OTA_RP2040_RECORD_OFFSET   (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
+extern const struct lwip_ota_flash lwip_ota_rp2040_flash;
+
+/* Runs the erases and programs lwip_ota.c starts, never returns. Called on the core
+   that doesn't run lwIP, with multicore_launch_core1() or at the end of main() */
+void lwip_ota_rp2040_worker(void);
+
+/* First thing in main(): applies a committed image whose CRC is right and resets, and
+   returns without one */
+void lwip_ota_rp2040_boot(void);
+
+#endif
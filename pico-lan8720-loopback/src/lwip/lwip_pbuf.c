@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* lwip's pbuf.c, optionally protected by the pool lock instead of the core one */
+#if PICO_LWIP_SYS_ARCH_SPLIT_LOCKS
+#define SYS_ARCH_PROTECT_LOCK SYS_ARCH_LOCK_POOL
+#endif
+
+/* PICO_RMII_HOT_IN_RAM, see arch/cc.h */
+#if PICO_RMII_HOT_IN_RAM
+#include "lwip/pbuf.h"
+
+struct pbuf *LWIP_HOT_FUNC(pbuf_alloc)(pbuf_layer l, u16_t length, pbuf_type type);
+#if LWIP_SUPPORT_CUSTOM_PBUF
+struct pbuf *LWIP_HOT_FUNC(pbuf_alloced_custom)(pbuf_layer l, u16_t length, pbuf_type type,
+                                                struct pbuf_custom *p, void *payload_mem, u16_t payload_mem_len);
+#endif
+u8_t LWIP_HOT_FUNC(pbuf_add_header)(struct pbuf *p, size_t header_size_increment);
+u8_t LWIP_HOT_FUNC(pbuf_remove_header)(struct pbuf *p, size_t header_size);
+u8_t LWIP_HOT_FUNC(pbuf_free)(struct pbuf *p);
+void LWIP_HOT_FUNC(pbuf_ref)(struct pbuf *p);
+u16_t LWIP_HOT_FUNC(pbuf_clen)(const struct pbuf *p);
+void LWIP_HOT_FUNC(pbuf_cat)(struct pbuf *head, struct pbuf *tail);
+u16_t LWIP_HOT_FUNC(pbuf_copy_partial)(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset);
+err_t LWIP_HOT_FUNC(pbuf_take)(struct pbuf *buf, const void *dataptr, u16_t len);
+#endif
+
+/* PICO_LWIP_PBUF_CACHE: the PBUF_POOL allocations of pbuf.c go through a cache per core, see below */
+#if PICO_LWIP_PBUF_CACHE
+#include "lwip/opt.h"
+#include "lwip/memp.h"
+
+#include "hardware/sync.h"
+
+#if MEMP_OVERFLOW_CHECK
+#error "PICO_LWIP_PBUF_CACHE wraps memp_malloc(), MEMP_OVERFLOW_CHECK makes it a macro"
+#endif
+
+#if PBUF_POOL_SIZE < 2 * NUM_CORES * PICO_LWIP_PBUF_CACHE_SIZE
+#error "PICO_LWIP_PBUF_CACHE_SIZE is too large for PBUF_POOL_SIZE, the caches could hold more than half the pool"
+#endif
+
+/* a full cache gives half of it back, and its count is a u8_t */
+#if PICO_LWIP_PBUF_CACHE_SIZE < 2 || PICO_LWIP_PBUF_CACHE_SIZE > 255
+#error "PICO_LWIP_PBUF_CACHE_SIZE must be from 2 to 255"
+#endif
+
+static void *pbuf_cache_malloc(memp_t type);
+static void pbuf_cache_free(memp_t type, void *mem);
+
+#define memp_malloc(type)    pbuf_cache_malloc(type)
+#define memp_free(type, mem) pbuf_cache_free(type, mem)
+#endif
+
+#include "../../lib/lwip/src/core/pbuf.c"
+
+#if PICO_LWIP_PBUF_CACHE
+#undef memp_malloc
+#undef memp_free
+
+/* elements moved between a cache and the pool under one lock */
+#define PBUF_CACHE_BATCH (PICO_LWIP_PBUF_CACHE_SIZE / 2)
+
+/* Free PBUF_POOL elements of one core. Only that core uses it, with its interrupts masked
+   against the IRQs that free pbufs, so an allocation or a free that the cache can serve
+   takes no lock shared with the other core. An empty cache takes PBUF_CACHE_BATCH elements
+   from the pool, a full one gives PBUF_CACHE_BATCH back. The pool's MEMP_STATS count the
+   cached elements as used */
+struct pbuf_cache {
+  void *mem[PICO_LWIP_PBUF_CACHE_SIZE];
+  u8_t count;
+};
+
+static struct pbuf_cache pbuf_caches[NUM_CORES];
+
+static void *
+LWIP_HOT_FUNC(pbuf_cache_malloc)(memp_t type)
+{
+  struct pbuf_cache *cache;
+  void *batch[PBUF_CACHE_BATCH];
+  void *mem = NULL;
+  u8_t n = 0;
+  uint32_t save;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  if (type != MEMP_PBUF_POOL) {
+    return memp_malloc(type);
+  }
+
+  save = save_and_disable_interrupts();
+  cache = &pbuf_caches[get_core_num()];
+  if (cache->count != 0) {
+    mem = cache->mem[--cache->count];
+  }
+  restore_interrupts(save);
+
+  if (mem != NULL) {
+    return mem;
+  }
+
+  /* memp_malloc() nests in the lock, it is taken once for the batch */
+  SYS_ARCH_PROTECT(lev);
+  while (n < PBUF_CACHE_BATCH) {
+    if ((batch[n] = memp_malloc(MEMP_PBUF_POOL)) == NULL) {
+      break;
+    }
+    n++;
+  }
+  SYS_ARCH_UNPROTECT(lev);
+
+  if (n == 0) {
+    return NULL;
+  }
+
+  mem = batch[--n];
+
+  /* an IRQ may have freed into the cache meanwhile, what doesn't fit goes back */
+  save = save_and_disable_interrupts();
+  while ((n != 0) && (cache->count < PICO_LWIP_PBUF_CACHE_SIZE)) {
+    cache->mem[cache->count++] = batch[--n];
+  }
+  restore_interrupts(save);
+
+  if (n != 0) {
+    SYS_ARCH_PROTECT(lev);
+    while (n != 0) {
+      memp_free(MEMP_PBUF_POOL, batch[--n]);
+    }
+    SYS_ARCH_UNPROTECT(lev);
+  }
+
+  return mem;
+}
+
+static void
+LWIP_HOT_FUNC(pbuf_cache_free)(memp_t type, void *mem)
+{
+  struct pbuf_cache *cache;
+  void *batch[PBUF_CACHE_BATCH];
+  u8_t n = 0;
+  uint32_t save;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  if (type != MEMP_PBUF_POOL) {
+    memp_free(type, mem);
+    return;
+  }
+
+  save = save_and_disable_interrupts();
+  cache = &pbuf_caches[get_core_num()];
+  if (cache->count == PICO_LWIP_PBUF_CACHE_SIZE) {
+    while (n < PBUF_CACHE_BATCH) {
+      batch[n++] = cache->mem[--cache->count];
+    }
+  }
+  cache->mem[cache->count++] = mem;
+  restore_interrupts(save);
+
+  if (n != 0) {
+    SYS_ARCH_PROTECT(lev);
+    while (n != 0) {
+      memp_free(MEMP_PBUF_POOL, batch[--n]);
+    }
+    SYS_ARCH_UNPROTECT(lev);
+  }
+}
+#endif
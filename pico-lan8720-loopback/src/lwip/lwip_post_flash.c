@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/pbuf.h"
+#include "lwip/timeouts.h"
+
+#include "lwip_post_flash.h"
+
+#define LWIP_POST_FLASH_CAPACITY        (LWIP_POST_FLASH_BUFFERS * LWIP_OTA_SECTOR_SIZE)
+
+#define LWIP_POST_FLASH_OP_NONE         0
+#define LWIP_POST_FLASH_OP_ERASE        1
+#define LWIP_POST_FLASH_OP_PROGRAM      2
+
+static struct lwip_post_flash *lwip_post_flash_instance;
+
+/* the staging bytes the body takes, erased whole sectors */
+static u32_t
+lwip_post_flash_erase_end(struct lwip_post_flash *post)
+{
+  return (post->length + LWIP_OTA_SECTOR_SIZE - 1) & ~(u32_t)(LWIP_OTA_SECTOR_SIZE - 1);
+}
+
+/* room in the buffers for the queued pbufs */
+static u32_t
+lwip_post_flash_room(struct lwip_post_flash *post)
+{
+  return LWIP_POST_FLASH_CAPACITY - (post->received - post->programmed);
+}
+
+/* Ends the operation that is done, returns the body bytes it programmed */
+static u16_t
+lwip_post_flash_op_done(struct lwip_post_flash *post)
+{
+  u16_t len = 0;
+
+  if (post->op == LWIP_POST_FLASH_OP_ERASE) {
+    post->erased += post->op_len;
+  } else {
+    /* the bytes as they are in flash now, the padding of the last page left out */
+    len = (u16_t)LWIP_MIN(post->op_len, post->length - post->op_offset);
+
+    post->crc = lwip_ota_crc32(post->crc, &post->flash->mapped[post->op_offset], len);
+    post->programmed = post->op_offset + len;
+  }
+  post->op = LWIP_POST_FLASH_OP_NONE;
+  return len;
+}
+
+/* Starts the next erase or program, programs first so the buffers drain. Returns 0 when
+   there is nothing to start */
+static u8_t
+lwip_post_flash_op_start(struct lwip_post_flash *post)
+{
+  const struct lwip_ota_flash *flash = post->flash;
+  u32_t erase_end = lwip_post_flash_erase_end(post);
+  u32_t offset = post->programmed;
+  u32_t end;
+
+  /* whole pages within one sector buffer and what is erased, the last page once the
+     body is in */
+  end = post->received & ~(u32_t)(LWIP_OTA_PAGE_SIZE - 1);
+  if ((post->received == post->length) && (post->received != end)) {
+    u32_t pad = post->received % LWIP_OTA_PAGE_SIZE;
+
+    memset(&post->buffers[post->received % LWIP_POST_FLASH_CAPACITY], 0xff, LWIP_OTA_PAGE_SIZE - pad);
+    end += LWIP_OTA_PAGE_SIZE;
+  }
+  end = LWIP_MIN(end, (offset & ~(u32_t)(LWIP_OTA_SECTOR_SIZE - 1)) + LWIP_OTA_SECTOR_SIZE);
+  end = LWIP_MIN(end, post->erased);
+
+  /* programmed only counts the body, the padded last page isn't programmed again */
+  if ((end > offset) && (offset < post->length)) {
+    post->op = LWIP_POST_FLASH_OP_PROGRAM;
+    post->op_offset = offset;
+    post->op_len = end - offset;
+    post->programs++;
+    flash->program(offset, &post->buffers[offset % LWIP_POST_FLASH_CAPACITY], post->op_len);
+    return 1;
+  }
+
+  if (post->erased < erase_end) {
+    post->op = LWIP_POST_FLASH_OP_ERASE;
+    post->op_offset = post->erased;
+    /* a block erase takes about as long as four sector ones */
+    if (((post->erased % LWIP_OTA_BLOCK_SIZE) == 0) && ((erase_end - post->erased) >= LWIP_OTA_BLOCK_SIZE)) {
+      post->op_len = LWIP_OTA_BLOCK_SIZE;
+    } else {
+      post->op_len = LWIP_OTA_SECTOR_SIZE;
+    }
+    post->erases++;
+    flash->erase(post->op_offset, post->op_len);
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Copies the queued pbufs into the buffers as far as there is room, a copy doesn't cross
+   the end of the buffers */
+static void
+lwip_post_flash_fill(struct lwip_post_flash *post)
+{
+  while ((post->queue != NULL) && (lwip_post_flash_room(post) != 0)) {
+    u32_t pos = post->received % LWIP_POST_FLASH_CAPACITY;
+    u16_t len = (u16_t)LWIP_MIN(LWIP_MIN(lwip_post_flash_room(post), LWIP_POST_FLASH_CAPACITY - pos),
+                                post->queue->tot_len);
+
+    pbuf_copy_partial(post->queue, &post->buffers[pos], len, 0);
+    post->crc_in = lwip_ota_crc32(post->crc_in, &post->buffers[pos], len);
+    post->received += len;
+    post->queue = pbuf_free_header(post->queue, len);
+  }
+}
+
+/* Ends the operation that is done, fills the buffers and starts the next operation. The
+   window is opened last for what was programmed: with the body all programmed httpd
+   calls httpd_post_finished() from there */
+static void
+lwip_post_flash_step(struct lwip_post_flash *post)
+{
+  u16_t programmed = 0;
+
+  if (post->op != LWIP_POST_FLASH_OP_NONE) {
+    if (post->flash->busy()) {
+      return;
+    }
+    programmed = lwip_post_flash_op_done(post);
+  }
+  lwip_post_flash_fill(post);
+  lwip_post_flash_op_start(post);
+
+  if (programmed != 0) {
+    httpd_post_data_recved(post->connection, programmed);
+  }
+}
+
+static void
+lwip_post_flash_timeout(void *arg)
+{
+  struct lwip_post_flash *post = (struct lwip_post_flash *)arg;
+
+  lwip_post_flash_step(post);
+  if (post->state == LWIP_POST_FLASH_RECEIVING) {
+    sys_timeout(1, lwip_post_flash_timeout, post);
+  }
+}
+
+static void
+lwip_post_flash_stop(struct lwip_post_flash *post, u8_t state)
+{
+  sys_untimeout(lwip_post_flash_timeout, post);
+  if (post->op != LWIP_POST_FLASH_OP_NONE) {
+    post->flash->wait();
+    post->op = LWIP_POST_FLASH_OP_NONE;
+  }
+  if (post->queue != NULL) {
+    pbuf_free(post->queue);
+    post->queue = NULL;
+  }
+  post->state = state;
+}
+
+static void
+lwip_post_flash_response(char *response_uri, u16_t response_uri_len, const char *uri)
+{
+  if ((uri != NULL) && (response_uri_len != 0)) {
+    strncpy(response_uri, uri, response_uri_len - 1);
+    response_uri[response_uri_len - 1] = 0;
+  }
+}
+
+err_t
+httpd_post_begin(void *connection, const char *uri, const char *http_request,
+                 u16_t http_request_len, int content_len, char *response_uri,
+                 u16_t response_uri_len, u8_t *post_auto_wnd)
+{
+  struct lwip_post_flash *post = lwip_post_flash_instance;
+
+  LWIP_UNUSED_ARG(http_request);
+  LWIP_UNUSED_ARG(http_request_len);
+
+  /* no URI to take, httpd's 404 */
+  if ((post == NULL) || (strcmp(uri, post->uri) != 0)) {
+    return ERR_VAL;
+  }
+
+  /* the body written over the image staged before, which is withdrawn first */
+  if ((post->state == LWIP_POST_FLASH_RECEIVING) || (content_len < 0) ||
+      ((u32_t)content_len > post->flash->size) || (post->flash->commit(NULL) != 0)) {
+    lwip_post_flash_response(response_uri, response_uri_len, post->error_uri);
+    return ERR_VAL;
+  }
+
+  post->connection = connection;
+  post->queue = NULL;
+  post->length = (u32_t)content_len;
+  post->received = 0;
+  post->programmed = 0;
+  post->erased = 0;
+  post->crc_in = 0;
+  post->crc = 0;
+  post->op = LWIP_POST_FLASH_OP_NONE;
+  post->state = LWIP_POST_FLASH_RECEIVING;
+  sys_timeout(1, lwip_post_flash_timeout, post);
+
+  /* the window opens as the flash takes the body */
+  *post_auto_wnd = 0;
+  return ERR_OK;
+}
+
+err_t
+httpd_post_receive_data(void *connection, struct pbuf *p)
+{
+  struct lwip_post_flash *post = lwip_post_flash_instance;
+  u32_t queued;
+
+  if ((post == NULL) || (connection != post->connection) || (post->state != LWIP_POST_FLASH_RECEIVING)) {
+    pbuf_free(p);
+    return ERR_VAL;
+  }
+
+  /* bytes behind the body are not the flash's to wait for, their window opens now */
+  queued = (post->queue != NULL) ? post->queue->tot_len : 0;
+  if (post->received + queued + p->tot_len > post->length) {
+    u16_t extra = (u16_t)(post->received + queued + p->tot_len - post->length);
+
+    httpd_post_data_recved(connection, extra);
+    if (extra == p->tot_len) {
+      pbuf_free(p);
+      p = NULL;
+    } else {
+      pbuf_realloc(p, (u16_t)(p->tot_len - extra));
+    }
+  }
+
+  if ((p != NULL) && (p->tot_len == 0)) {
+    pbuf_free(p);
+  } else if (p != NULL) {
+    if (post->queue == NULL) {
+      post->queue = p;
+    } else {
+      pbuf_cat(post->queue, p);
+    }
+    post->queued_max = LWIP_MAX(post->queued_max, post->queue->tot_len);
+  }
+
+  lwip_post_flash_step(post);
+  return ERR_OK;
+}
+
+void
+httpd_post_finished(void *connection, char *response_uri, u16_t response_uri_len)
+{
+  struct lwip_post_flash *post = lwip_post_flash_instance;
+
+  if ((post == NULL) || (connection != post->connection)) {
+    return;
+  }
+
+  /* all of it programmed, or the connection went before */
+  if (post->state == LWIP_POST_FLASH_RECEIVING) {
+    if ((post->programmed == post->length) && (post->crc == post->crc_in)) {
+      post->uploads++;
+      lwip_post_flash_stop(post, LWIP_POST_FLASH_DONE);
+    } else {
+      lwip_post_flash_stop(post, LWIP_POST_FLASH_FAILED);
+    }
+  }
+  post->connection = NULL;
+
+  lwip_post_flash_response(response_uri, response_uri_len,
+                           (post->state == LWIP_POST_FLASH_DONE) ? post->ok_uri : post->error_uri);
+}
+
+void
+lwip_post_flash_init(struct lwip_post_flash *post, const struct lwip_ota_flash *flash,
+                     const char *uri, const char *ok_uri, const char *error_uri)
+{
+  memset(post, 0, sizeof(*post));
+  post->flash = flash;
+  post->uri = uri;
+  post->ok_uri = ok_uri;
+  post->error_uri = error_uri;
+  post->state = LWIP_POST_FLASH_IDLE;
+  lwip_post_flash_instance = post;
+}
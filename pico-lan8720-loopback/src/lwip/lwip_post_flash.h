@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_POST_FLASH_H
+#define LWIP_POST_FLASH_H
+
+#include "lwip/opt.h"
+#include "lwip/apps/httpd.h"
+
+#include "lwip_ota.h"
+
+/* The body of an HTTP POST to one URI streamed into the staging area of lwip_ota.c's
+   flash backend, from its start: `curl --data-binary @file http://<board>/upload`.
+   httpd's pbufs queue as they come, are copied into two sector buffers as there is room
+   and the backend programs one buffer page by page while the other fills. The receive
+   window is only opened (httpd_post_data_recved()) for the bytes programmed, so the
+   client is paced by the flash and the RAM an upload takes is the window and the two
+   buffers, whatever its size. The CRC-32 of the body is kept as it is copied and
+   compared with the one read back from flash, the response is ok_uri when they match,
+   error_uri otherwise. One upload at a time, and not together with a TFTP update: the
+   staging area is the same, and an image committed there is withdrawn by a POST.
+   Implements httpd's POST hooks (LWIP_HTTPD_SUPPORT_POST and LWIP_HTTPD_POST_MANUAL_WND),
+   without lwip_post_flash_init() every POST is refused. The transfer takes a
+   sys_timeout (a 1 ms step) */
+
+#if !LWIP_HTTPD_SUPPORT_POST || !LWIP_HTTPD_POST_MANUAL_WND
+#error "lwip_post_flash.c opens the window of a POST itself, it needs LWIP_HTTPD_SUPPORT_POST and LWIP_HTTPD_POST_MANUAL_WND"
+#endif
+
+/* sector buffers between httpd and flash, one is programmed while the other fills */
+#ifndef LWIP_POST_FLASH_BUFFERS
+#define LWIP_POST_FLASH_BUFFERS         2
+#endif
+
+enum lwip_post_flash_state {
+  LWIP_POST_FLASH_IDLE,
+  LWIP_POST_FLASH_RECEIVING,
+  LWIP_POST_FLASH_DONE,     /* the body is in flash, length bytes with crc */
+  LWIP_POST_FLASH_FAILED
+};
+
+struct lwip_post_flash {
+  const struct lwip_ota_flash *flash;
+  const char *uri;
+  const char *ok_uri;
+  const char *error_uri;
+  u8_t buffers[LWIP_POST_FLASH_BUFFERS * LWIP_OTA_SECTOR_SIZE];
+  void *connection;  /* of the upload going on */
+  struct pbuf *queue; /* received, waiting for room in the buffers */
+  u32_t length;      /* Content-Length */
+  u32_t received;    /* bytes copied into the buffers */
+  u32_t programmed;  /* bytes programmed and read back */
+  u32_t erased;      /* staging bytes erased */
+  u32_t op_offset;   /* the operation going on */
+  u32_t op_len;
+  u32_t crc_in;      /* of the bytes received */
+  u32_t crc;         /* of the bytes read back */
+  u8_t op;
+  u8_t state;
+  /* for the stats of the app */
+  u32_t queued_max;  /* most bytes waiting in pbufs */
+  u32_t erases;
+  u32_t programs;
+  u32_t uploads;     /* bodies that made it */
+};
+
+/* Takes the POSTs to uri into flash from then on, answered with the file ok_uri or
+   error_uri of httpd's fs */
+void lwip_post_flash_init(struct lwip_post_flash *post, const struct lwip_ota_flash *flash,
+                          const char *uri, const char *ok_uri, const char *error_uri);
+
+#endif
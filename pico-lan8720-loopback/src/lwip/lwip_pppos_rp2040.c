@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* PPPoS over a UART with DMA on both directions, see lwip_pppos_rp2040.h */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/uart.h"
+
+#include "lwip/opt.h"
+
+#include "lwip_pppos_rp2040.h"
+
+#if PPP_SUPPORT && PPPOS_SUPPORT
+
+#if (LWIP_PPPOS_RP2040_RX_RING & (LWIP_PPPOS_RP2040_RX_RING - 1)) || LWIP_PPPOS_RP2040_RX_RING > 32768
+#error "LWIP_PPPOS_RP2040_RX_RING must be a power of 2 up to 32768"
+#endif
+#if (LWIP_PPPOS_RP2040_TX_RING & (LWIP_PPPOS_RP2040_TX_RING - 1)) || LWIP_PPPOS_RP2040_TX_RING > 32768
+#error "LWIP_PPPOS_RP2040_TX_RING must be a power of 2 up to 32768"
+#endif
+
+#define LWIP_PPPOS_RP2040_RX_MASK       (LWIP_PPPOS_RP2040_RX_RING - 1)
+#define LWIP_PPPOS_RP2040_TX_MASK       (LWIP_PPPOS_RP2040_TX_RING - 1)
+
+/* transfers of one RX DMA run, 28 bits as the RP2350 counts them: 48 minutes of bytes at
+   921600 baud before the completion interrupt starts the next */
+#define LWIP_PPPOS_RP2040_RX_COUNT      0x0fffffffUL
+
+/* the DMA wraps its address inside the rings, which must be aligned to their size */
+static u8_t lwip_pppos_rp2040_rx_ring[LWIP_PPPOS_RP2040_RX_RING] __attribute__((aligned(LWIP_PPPOS_RP2040_RX_RING)));
+static u8_t lwip_pppos_rp2040_tx_ring[LWIP_PPPOS_RP2040_TX_RING] __attribute__((aligned(LWIP_PPPOS_RP2040_TX_RING)));
+
+/* positions are byte totals, the ring offset is the total masked */
+static struct lwip_pppos_rp2040 {
+  uart_inst_t *uart;
+  ppp_pcb *ppp;
+  int rx_chan;
+  int tx_chan;
+
+  volatile u32_t rx_base;   /* bytes of the RX DMA runs completed */
+  u32_t rx_read;            /* passed to pppos_input() */
+  u32_t rx_seen;            /* written at the last poll that saw it move */
+  u32_t rx_seen_us;
+  u32_t rx_idle_us;
+
+  u32_t tx_head;            /* queued by the output callback */
+  u32_t tx_tail;            /* sent */
+  u32_t tx_sending;         /* of the transfer in flight */
+
+  struct lwip_pppos_rp2040_stats stats;
+} lwip_pppos_rp2040;
+
+/* the RX DMA's total, from the lwIP core: the completion interrupt runs on the same
+   core, between two reads of rx_base or not at all */
+static u32_t
+lwip_pppos_rp2040_rx_written(void)
+{
+  struct lwip_pppos_rp2040 *pppos = &lwip_pppos_rp2040;
+  u32_t base, left;
+
+  do {
+    base = pppos->rx_base;
+    left = dma_channel_hw_addr(pppos->rx_chan)->transfer_count;
+  } while (base != pppos->rx_base);
+
+  return base + (LWIP_PPPOS_RP2040_RX_COUNT - left);
+}
+
+/* DMA_IRQ_1, shared with the RMII driver: the next run carries on from the write
+   address the last one ended at */
+static void
+lwip_pppos_rp2040_rx_handler(void)
+{
+  struct lwip_pppos_rp2040 *pppos = &lwip_pppos_rp2040;
+
+  if (dma_channel_get_irq1_status(pppos->rx_chan)) {
+    dma_channel_acknowledge_irq1(pppos->rx_chan);
+    dma_channel_set_trans_count(pppos->rx_chan, LWIP_PPPOS_RP2040_RX_COUNT, true);
+    pppos->rx_base += LWIP_PPPOS_RP2040_RX_COUNT;
+  }
+}
+
+/* retires a finished transfer and sends everything queued since in the next one, the
+   DMA reads across the end of the ring */
+static void
+lwip_pppos_rp2040_tx_start(void)
+{
+  struct lwip_pppos_rp2040 *pppos = &lwip_pppos_rp2040;
+  u32_t len;
+
+  if (pppos->tx_sending != 0) {
+    if (dma_channel_is_busy(pppos->tx_chan)) {
+      return;
+    }
+    pppos->tx_tail += pppos->tx_sending;
+    pppos->tx_sending = 0;
+  }
+
+  len = pppos->tx_head - pppos->tx_tail;
+  if (len == 0) {
+    return;
+  }
+
+  /* the copies into the ring are in memory before the DMA reads them */
+  __compiler_memory_barrier();
+  dma_channel_transfer_from_buffer_now(pppos->tx_chan,
+                                       &lwip_pppos_rp2040_tx_ring[pppos->tx_tail & LWIP_PPPOS_RP2040_TX_MASK], len);
+
+  pppos->tx_sending = len;
+  pppos->stats.tx_transfers++;
+}
+
+/* pppos's output callback, with an escaped chunk of a frame of up to PBUF_POOL_BUFSIZE */
+static u32_t
+lwip_pppos_rp2040_output(ppp_pcb *pcb, u8_t *data, u32_t len, void *ctx)
+{
+  struct lwip_pppos_rp2040 *pppos = &lwip_pppos_rp2040;
+  u32_t pos, first;
+
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(ctx);
+
+  if (len > LWIP_PPPOS_RP2040_TX_RING - (pppos->tx_head - pppos->tx_tail)) {
+    /* a transfer that has finished since gives its bytes back */
+    lwip_pppos_rp2040_tx_start();
+
+    if (len > LWIP_PPPOS_RP2040_TX_RING - (pppos->tx_head - pppos->tx_tail)) {
+      pppos->stats.tx_dropped += len;
+      return 0;
+    }
+  }
+
+  pos = pppos->tx_head & LWIP_PPPOS_RP2040_TX_MASK;
+  first = LWIP_MIN(len, LWIP_PPPOS_RP2040_TX_RING - pos);
+  memcpy(&lwip_pppos_rp2040_tx_ring[pos], data, first);
+  memcpy(lwip_pppos_rp2040_tx_ring, data + first, len - first);
+
+  pppos->tx_head += len;
+  pppos->stats.tx_bytes += len;
+
+  lwip_pppos_rp2040_tx_start();
+
+  return len;
+}
+
+ppp_pcb *
+lwip_pppos_rp2040_create(struct netif *pppif, uart_inst_t *uart, uint baudrate,
+                         ppp_link_status_cb_fn link_status_cb, void *ctx_cb)
+{
+  struct lwip_pppos_rp2040 *pppos = &lwip_pppos_rp2040;
+  dma_channel_config config;
+  int rx_chan, tx_chan;
+  ppp_pcb *ppp;
+
+  if (pppos->ppp != NULL) {
+    return NULL;
+  }
+
+  rx_chan = dma_claim_unused_channel(false);
+  tx_chan = dma_claim_unused_channel(false);
+  if (rx_chan < 0 || tx_chan < 0) {
+    goto unclaim;
+  }
+
+  ppp = pppos_create(pppif, lwip_pppos_rp2040_output, link_status_cb, ctx_cb);
+  if (ppp == NULL) {
+    goto unclaim;
+  }
+
+  memset(pppos, 0, sizeof(*pppos));
+  pppos->uart = uart;
+  pppos->ppp = ppp;
+  pppos->rx_chan = rx_chan;
+  pppos->tx_chan = tx_chan;
+
+  uart_init(uart, baudrate);
+  uart_set_format(uart, 8, 1, UART_PARITY_NONE);
+  uart_set_fifo_enabled(uart, true);
+
+  /* what the poll waits for on a quiet line, 10 bits a character */
+  pppos->rx_idle_us = LWIP_MAX(1, (u32_t)((u64_t)LWIP_PPPOS_RP2040_RX_IDLE_CHARS * 10 * 1000000 / baudrate));
+
+  /* RX: the data register into the ring, wrapping, paced by the UART */
+  config = dma_channel_get_default_config(rx_chan);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+  channel_config_set_read_increment(&config, false);
+  channel_config_set_write_increment(&config, true);
+  channel_config_set_ring(&config, true, __builtin_ctz(LWIP_PPPOS_RP2040_RX_RING));
+  channel_config_set_dreq(&config, uart_get_dreq(uart, false));
+  dma_channel_configure(rx_chan, &config, lwip_pppos_rp2040_rx_ring, &uart_get_hw(uart)->dr,
+                        LWIP_PPPOS_RP2040_RX_COUNT, true);
+
+  dma_channel_set_irq1_enabled(rx_chan, true);
+  irq_add_shared_handler(DMA_IRQ_1, lwip_pppos_rp2040_rx_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(DMA_IRQ_1, true);
+
+  /* TX: from the ring, wrapping, into the data register; started per run queued */
+  config = dma_channel_get_default_config(tx_chan);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+  channel_config_set_read_increment(&config, true);
+  channel_config_set_write_increment(&config, false);
+  channel_config_set_ring(&config, false, __builtin_ctz(LWIP_PPPOS_RP2040_TX_RING));
+  channel_config_set_dreq(&config, uart_get_dreq(uart, true));
+  dma_channel_configure(tx_chan, &config, &uart_get_hw(uart)->dr, lwip_pppos_rp2040_tx_ring, 0, false);
+
+  pppos->rx_seen_us = time_us_32();
+
+  return ppp;
+
+unclaim:
+  if (rx_chan >= 0) {
+    dma_channel_unclaim(rx_chan);
+  }
+  if (tx_chan >= 0) {
+    dma_channel_unclaim(tx_chan);
+  }
+  return NULL;
+}
+
+u32_t
+lwip_pppos_rp2040_poll(void)
+{
+  struct lwip_pppos_rp2040 *pppos = &lwip_pppos_rp2040;
+  u32_t written, waiting, now, pos, first;
+
+  if (pppos->ppp == NULL) {
+    return 0;
+  }
+
+  lwip_pppos_rp2040_tx_start();
+
+  written = lwip_pppos_rp2040_rx_written();
+  now = time_us_32();
+
+  if (written != pppos->rx_seen) {
+    pppos->rx_seen = written;
+    pppos->rx_seen_us = now;
+  }
+
+  waiting = written - pppos->rx_read;
+  if (waiting == 0) {
+    return 0;
+  }
+
+  if (waiting > LWIP_PPPOS_RP2040_RX_RING) {
+    /* the DMA has gone round past the poll, what is left of the frame in progress
+       fails its FCS and pppos picks up again at the next flag */
+    pppos->stats.rx_overrun++;
+    pppos->stats.rx_lost += waiting;
+    pppos->rx_read = written;
+    return 0;
+  }
+
+  if (waiting < LWIP_PPPOS_RP2040_RX_BATCH) {
+    if (now - pppos->rx_seen_us < pppos->rx_idle_us) {
+      return 0;
+    }
+    pppos->stats.rx_idle++;
+  }
+
+  pos = pppos->rx_read & LWIP_PPPOS_RP2040_RX_MASK;
+  first = LWIP_MIN(waiting, LWIP_PPPOS_RP2040_RX_RING - pos);
+
+  pppos_input(pppos->ppp, &lwip_pppos_rp2040_rx_ring[pos], (int)first);
+  pppos->stats.rx_batches++;
+  if (waiting > first) {
+    pppos_input(pppos->ppp, lwip_pppos_rp2040_rx_ring, (int)(waiting - first));
+    pppos->stats.rx_batches++;
+  }
+
+  pppos->rx_read += waiting;
+  pppos->stats.rx_bytes += waiting;
+
+  /* what lwIP sent in answer goes out now rather than at the next poll */
+  lwip_pppos_rp2040_tx_start();
+
+  return waiting;
+}
+
+void
+lwip_pppos_rp2040_get_stats(struct lwip_pppos_rp2040_stats *stats)
+{
+  memcpy(stats, &lwip_pppos_rp2040.stats, sizeof(*stats));
+}
+
+#endif /* PPP_SUPPORT && PPPOS_SUPPORT */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_PPPOS_RP2040_H
+#define LWIP_PPPOS_RP2040_H
+
+#include "hardware/uart.h"
+
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+
+#if PPP_SUPPORT && PPPOS_SUPPORT
+
+#include "netif/ppp/pppos.h"
+
+/* PPP over a UART of the RP2040 (PICO_LWIP_PPPOS in CMake) with the UART's bytes moved
+   by DMA instead of an interrupt per byte or per FIFO level. RX DMA runs without a stop
+   into a ring, lwip_pppos_rp2040_poll() hands what came in to pppos_input() in one or
+   two calls (two when it wraps) once LWIP_PPPOS_RP2040_RX_BATCH bytes are waiting, or
+   when the line has been idle for LWIP_PPPOS_RP2040_RX_IDLE_CHARS character times, the
+   end of a frame. The idle line is told from the DMA's count by the poll: the UART's
+   own RX timeout interrupt needs bytes left in its FIFO, which the DMA keeps empty.
+
+   lwIP's pppos escapes a frame into PBUF_POOL buffers before output, so what reaches
+   the UART is already a copy. It goes into a TX ring that a second DMA channel sends
+   from, a transfer per run of bytes queued meanwhile. A chunk that doesn't fit in the
+   ring is dropped whole and the peer discards the frame on its FCS.
+
+   One UART, from lwIP context on one core: the RX DMA is re-armed from DMA_IRQ_1 on the
+   core that called lwip_pppos_rp2040_create(), the poll must run on the same core. At
+   921600 baud the 4 KB RX ring holds 44 ms, the poll has to come round sooner */
+
+/* bytes of the RX ring, a power of 2 up to 32 KB */
+#ifndef LWIP_PPPOS_RP2040_RX_RING
+#define LWIP_PPPOS_RP2040_RX_RING       4096
+#endif
+
+/* bytes of the TX ring, a power of 2 up to 32 KB */
+#ifndef LWIP_PPPOS_RP2040_TX_RING
+#define LWIP_PPPOS_RP2040_TX_RING       4096
+#endif
+
+/* bytes waiting in the RX ring that are passed on without waiting for an idle line */
+#ifndef LWIP_PPPOS_RP2040_RX_BATCH
+#define LWIP_PPPOS_RP2040_RX_BATCH      512
+#endif
+
+/* character times without a byte after which what is waiting is passed on */
+#ifndef LWIP_PPPOS_RP2040_RX_IDLE_CHARS
+#define LWIP_PPPOS_RP2040_RX_IDLE_CHARS 4
+#endif
+
+struct lwip_pppos_rp2040_stats {
+  u32_t rx_bytes;       /* passed to pppos_input() */
+  u32_t rx_batches;     /* pppos_input() calls */
+  u32_t rx_idle;        /* batches passed on an idle line, before RX_BATCH */
+  u32_t rx_overrun;     /* times the DMA went round the ring past the poll */
+  u32_t rx_lost;        /* bytes those overwrote */
+  u32_t tx_bytes;       /* queued in the TX ring */
+  u32_t tx_transfers;   /* DMA transfers started */
+  u32_t tx_dropped;     /* bytes of chunks that didn't fit */
+};
+
+/* Sets up uart at baudrate 8N1 with its RX and TX on two claimed DMA channels and
+   creates the PPP pcb of pppif with pppos_create(). The pins are the caller's, with
+   gpio_set_function(pin, GPIO_FUNC_UART), and uart_set_hw_flow() as the modem needs.
+   Returns the pcb for ppp_connect() and the auth settings, NULL when it fails */
+ppp_pcb *lwip_pppos_rp2040_create(struct netif *pppif, uart_inst_t *uart, uint baudrate,
+                                  ppp_link_status_cb_fn link_status_cb, void *ctx_cb);
+
+/* From the main loop next to sys_check_timeouts(): passes the RX ring's bytes to
+   pppos_input() as above and starts the TX DMA on what was queued. Returns the bytes
+   passed, 0 when it had nothing to do */
+u32_t lwip_pppos_rp2040_poll(void);
+
+void lwip_pppos_rp2040_get_stats(struct lwip_pppos_rp2040_stats *stats);
+
+#endif /* PPP_SUPPORT && PPPOS_SUPPORT */
+
+#endif /* LWIP_PPPOS_RP2040_H */
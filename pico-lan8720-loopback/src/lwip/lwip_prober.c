@@ -0,0 +1,698 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/etharp.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/ip.h"
+#include "lwip/pbuf.h"
+#include "lwip/raw.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+#include "lwip/prot/icmp.h"
+#include "lwip/prot/ip4.h"
+
+#include "timebase.h"
+#include "lwip_prober.h"
+
+#ifndef PICO_RMII_ETHERNET_TIMESTAMP
+#define PICO_RMII_ETHERNET_TIMESTAMP 0
+#endif
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+#include "rmii_ethernet/netif.h"
+#endif
+
+#if (LWIP_PROBER_WINDOW & (LWIP_PROBER_WINDOW - 1)) != 0
+#error "LWIP_PROBER_WINDOW must be a power of 2"
+#endif
+
+/* the prober's fields, first in the payload of both types, big endian:
+   magic, peer, flags, sequence number, the responder's hold of the request in ns */
+#define LWIP_PROBER_MAGIC 0x4c505242UL /* "LPRB" */
+#define LWIP_PROBER_FLAG_REPLY 0x01
+
+#define LWIP_PROBER_TS_NONE 0
+#define LWIP_PROBER_TS_ARMED 1
+#define LWIP_PROBER_TS_VALID 2
+
+/* pending: a probe in flight, since before the last lwip_prober_reset() for
+   LWIP_PROBER_PENDING_OLD, which isn't counted in either */
+#define LWIP_PROBER_PENDING 1
+#define LWIP_PROBER_PENDING_OLD 2
+
+struct lwip_prober_slot {
+  u32_t sent_us;
+  u32_t sent_ms;
+  u32_t sent_ts;   /* the driver's TX timestamp, with ts LWIP_PROBER_TS_VALID */
+  u16_t seq;
+  u8_t pending;
+  u8_t ts;
+};
+
+struct lwip_prober_peer {
+  struct lwip_prober_stats stats;
+  u8_t used;
+  u16_t seq;
+  u32_t next_ms;
+  struct lwip_prober_slot slots[LWIP_PROBER_WINDOW];
+};
+
+static struct lwip_prober_peer lwip_prober_peers[LWIP_PROBER_PEERS];
+static struct raw_pcb *lwip_prober_icmp_pcb;
+static struct udp_pcb *lwip_prober_udp_pcb;
+static struct udp_pcb *lwip_prober_responder_pcb;
+static struct netif *lwip_prober_timestamp_netif;
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+/* the probe whose TX timestamp is armed, -1 for none */
+static int lwip_prober_armed_peer = -1;
+static u16_t lwip_prober_armed_seq;
+#endif
+
+static void
+lwip_prober_fields_put(u8_t *b, u8_t peer, u8_t flags, u16_t seq, u32_t held_ns)
+{
+  b[0] = (u8_t)(LWIP_PROBER_MAGIC >> 24);
+  b[1] = (u8_t)(LWIP_PROBER_MAGIC >> 16);
+  b[2] = (u8_t)(LWIP_PROBER_MAGIC >> 8);
+  b[3] = (u8_t)LWIP_PROBER_MAGIC;
+  b[4] = peer;
+  b[5] = flags;
+  b[6] = (u8_t)(seq >> 8);
+  b[7] = (u8_t)seq;
+  b[8] = (u8_t)(held_ns >> 24);
+  b[9] = (u8_t)(held_ns >> 16);
+  b[10] = (u8_t)(held_ns >> 8);
+  b[11] = (u8_t)held_ns;
+}
+
+static int
+lwip_prober_fields_valid(const u8_t *b)
+{
+  return ((u32_t)b[0] << 24 | (u32_t)b[1] << 16 | (u32_t)b[2] << 8 | b[3]) == LWIP_PROBER_MAGIC;
+}
+
+static u16_t
+lwip_prober_fields_seq(const u8_t *b)
+{
+  return (u16_t)(b[6] << 8 | b[7]);
+}
+
+static u32_t
+lwip_prober_fields_held(const u8_t *b)
+{
+  return (u32_t)b[8] << 24 | (u32_t)b[9] << 16 | (u32_t)b[10] << 8 | b[11];
+}
+
+static void
+lwip_prober_record(struct lwip_prober_stats *stats, u32_t ns)
+{
+  u32_t us = ns / 1000;
+  int b = us == 0 ? 0 : 32 - __builtin_clz(us);
+
+  if (b > LWIP_PROBER_BUCKETS - 1) {
+    b = LWIP_PROBER_BUCKETS - 1;
+  }
+
+  stats->received++;
+  stats->last_ns = ns;
+  stats->sum_ns += ns;
+  stats->buckets[b]++;
+
+  if (ns < stats->min_ns) {
+    stats->min_ns = ns;
+  }
+  if (ns > stats->max_ns) {
+    stats->max_ns = ns;
+  }
+}
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+static u32_t
+lwip_prober_ts_ns(u32_t counts)
+{
+  return (u32_t)(((u64_t)counts * 1000000000u) / netif_rmii_ethernet_timestamp_hz());
+}
+
+/* the TX timestamp of the armed probe, until the driver has it */
+static void
+lwip_prober_tx_poll(void *arg)
+{
+  struct lwip_prober_peer *peer;
+  struct lwip_prober_slot *slot;
+  u32_t timestamp;
+  err_t err;
+
+  LWIP_UNUSED_ARG(arg);
+
+  err = netif_rmii_ethernet_netif_timestamp_tx_get(lwip_prober_timestamp_netif, &timestamp);
+
+  if (err == ERR_INPROGRESS) {
+    sys_timeout(1, lwip_prober_tx_poll, NULL);
+    return;
+  }
+
+  peer = &lwip_prober_peers[lwip_prober_armed_peer];
+  slot = &peer->slots[lwip_prober_armed_seq & (LWIP_PROBER_WINDOW - 1)];
+  lwip_prober_armed_peer = -1;
+
+  /* the peer may have been removed, or the probe's slot taken again */
+  if (!peer->used || slot->seq != lwip_prober_armed_seq || slot->ts != LWIP_PROBER_TS_ARMED) {
+    return;
+  }
+
+  if (err == ERR_OK) {
+    slot->sent_ts = timestamp;
+    slot->ts = LWIP_PROBER_TS_VALID;
+  } else {
+    slot->ts = LWIP_PROBER_TS_NONE;
+  }
+}
+
+/* armed when the probe is the next frame out: its next hop resolved, no ARP request
+   first, and no other TX timestamp pending */
+static void
+lwip_prober_tx_arm(int index, struct lwip_prober_slot *slot)
+{
+  struct netif *netif = lwip_prober_timestamp_netif;
+  const ip4_addr_t *addr = ip_2_ip4(&lwip_prober_peers[index].stats.addr);
+  const ip4_addr_t *hop = addr;
+  struct eth_addr *eth;
+  const ip4_addr_t *ip;
+
+  if (netif == NULL || lwip_prober_armed_peer >= 0 || ip4_route(addr) != netif) {
+    return;
+  }
+
+  if (!ip4_addr_netcmp(addr, netif_ip4_addr(netif), netif_ip4_netmask(netif))) {
+    hop = netif_ip4_gw(netif);
+  }
+
+  if (etharp_find_addr(netif, hop, &eth, &ip) < 0 ||
+      netif_rmii_ethernet_netif_timestamp_tx_arm(netif) != ERR_OK) {
+    return;
+  }
+
+  slot->ts = LWIP_PROBER_TS_ARMED;
+  lwip_prober_armed_peer = index;
+  lwip_prober_armed_seq = slot->seq;
+  sys_timeout(1, lwip_prober_tx_poll, NULL);
+}
+#endif /* PICO_RMII_ETHERNET_TIMESTAMP */
+
+/* the reply to probe seq of peer index, at rx_us on the timer and at rx_ts of the driver
+   when rx_stamped */
+static void
+lwip_prober_reply(u8_t index, enum lwip_prober_type type, const ip_addr_t *addr, u16_t seq,
+                  u32_t held_ns, u32_t rx_us, int rx_stamped, u32_t rx_ts)
+{
+  struct lwip_prober_peer *peer;
+  struct lwip_prober_slot *slot;
+  u32_t ns;
+
+  LWIP_UNUSED_ARG(rx_stamped);
+  LWIP_UNUSED_ARG(rx_ts);
+
+  if (index >= LWIP_PROBER_PEERS) {
+    return;
+  }
+
+  peer = &lwip_prober_peers[index];
+
+  if (!peer->used || peer->stats.type != type || !ip_addr_cmp(addr, &peer->stats.addr)) {
+    return;
+  }
+
+  slot = &peer->slots[seq & (LWIP_PROBER_WINDOW - 1)];
+
+  if (!slot->pending || slot->seq != seq) {
+    peer->stats.late++;
+    return;
+  }
+
+  if (slot->pending == LWIP_PROBER_PENDING_OLD) {
+    slot->pending = 0;
+    return;
+  }
+
+  slot->pending = 0;
+
+  if ((u32_t)(sys_now() - slot->sent_ms) > LWIP_PROBER_TIMEOUT_MS) {
+    peer->stats.lost++;
+    peer->stats.late++;
+    return;
+  }
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+  if (slot->ts == LWIP_PROBER_TS_ARMED) {
+    /* the request is long out, its timestamp is in by now */
+    sys_untimeout(lwip_prober_tx_poll, NULL);
+    lwip_prober_tx_poll(NULL);
+  }
+
+  if (slot->ts == LWIP_PROBER_TS_VALID && rx_stamped) {
+    ns = lwip_prober_ts_ns(rx_ts - slot->sent_ts);
+    peer->stats.stamped++;
+  } else
+#endif
+  {
+    ns = (rx_us - slot->sent_us) * 1000u;
+  }
+
+  ns -= LWIP_MIN(held_ns, ns);
+
+  lwip_prober_record(&peer->stats, ns);
+}
+
+/* the driver's timestamp of the frame being input */
+static int
+lwip_prober_rx_stamp(u32_t *rx_ts)
+{
+#if PICO_RMII_ETHERNET_TIMESTAMP
+  struct netif *netif = ip_current_input_netif();
+
+  if (netif != NULL && netif == lwip_prober_timestamp_netif) {
+    return netif_rmii_ethernet_netif_timestamp_rx(netif, rx_ts);
+  }
+#endif
+  *rx_ts = 0;
+
+  return 0;
+}
+
+static u8_t
+lwip_prober_icmp_recv(void *arg, struct raw_pcb *pcb, struct pbuf *p, const ip_addr_t *addr)
+{
+  u32_t rx_us;
+  struct icmp_echo_hdr iecho;
+  u8_t fields[LWIP_PROBER_SIZE_MIN];
+  u16_t hlen;
+  u16_t id;
+  u32_t rx_ts;
+  int rx_stamped;
+
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+
+  /* the IP header is in the first pbuf */
+  hlen = (u16_t)IPH_HL_BYTES((struct ip_hdr *)p->payload);
+
+  /* the echo requests lwIP answers pass by without a read of the timer */
+  if (pbuf_copy_partial(p, &iecho, sizeof(iecho), hlen) != sizeof(iecho) ||
+      ICMPH_TYPE(&iecho) != ICMP_ER) {
+    return 0;
+  }
+
+  rx_us = timebase_us();
+
+  id = (u16_t)(lwip_ntohs(iecho.id) - LWIP_PROBER_ICMP_ID);
+
+  if (id >= LWIP_PROBER_PEERS ||
+      pbuf_copy_partial(p, fields, sizeof(fields), (u16_t)(hlen + sizeof(iecho))) != sizeof(fields) ||
+      !lwip_prober_fields_valid(fields)) {
+    return 0;
+  }
+
+  rx_stamped = lwip_prober_rx_stamp(&rx_ts);
+
+  /* a peer's time to answer an echo isn't known, held is what was sent: 0 */
+  lwip_prober_reply((u8_t)id, LWIP_PROBER_ICMP, addr, lwip_prober_fields_seq(fields),
+                    0, rx_us, rx_stamped, rx_ts);
+
+  pbuf_free(p);
+
+  return 1;
+}
+
+static void
+lwip_prober_udp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  u32_t rx_us = timebase_us();
+  u8_t fields[LWIP_PROBER_SIZE_MIN];
+  u32_t rx_ts;
+  int rx_stamped = lwip_prober_rx_stamp(&rx_ts);
+
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+
+  if (port == LWIP_PROBER_PORT &&
+      pbuf_copy_partial(p, fields, sizeof(fields), 0) == sizeof(fields) &&
+      lwip_prober_fields_valid(fields)) {
+    /* an echo server sends back the request's 0, the prober its hold of it */
+    lwip_prober_reply(fields[4], LWIP_PROBER_UDP, addr, lwip_prober_fields_seq(fields),
+                      (fields[5] & LWIP_PROBER_FLAG_REPLY) ? lwip_prober_fields_held(fields) : 0,
+                      rx_us, rx_stamped, rx_ts);
+  }
+
+  pbuf_free(p);
+}
+
+/* answers the probes of the other devices, in the pbuf they came in */
+static void
+lwip_prober_responder_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  u32_t rx_us = timebase_us();
+  u8_t fields[LWIP_PROBER_SIZE_MIN];
+
+  LWIP_UNUSED_ARG(arg);
+
+  /* only requests, replies aren't answered again */
+  if (pbuf_copy_partial(p, fields, sizeof(fields), 0) == sizeof(fields) &&
+      lwip_prober_fields_valid(fields) && (fields[5] & LWIP_PROBER_FLAG_REPLY) == 0) {
+    lwip_prober_fields_put(fields, fields[4], fields[5] | LWIP_PROBER_FLAG_REPLY,
+                           lwip_prober_fields_seq(fields), (timebase_us() - rx_us) * 1000u);
+    pbuf_take(p, fields, sizeof(fields));
+    udp_sendto(pcb, p, addr, port);
+  }
+
+  pbuf_free(p);
+}
+
+static void
+lwip_prober_send(int index, u32_t now)
+{
+  struct lwip_prober_peer *peer = &lwip_prober_peers[index];
+  struct lwip_prober_stats *stats = &peer->stats;
+  u16_t header = stats->type == LWIP_PROBER_ICMP ? sizeof(struct icmp_echo_hdr) : 0;
+  struct lwip_prober_slot *slot;
+  struct pbuf *p;
+  u8_t *b;
+  err_t err;
+
+  /* the unanswered probes of the window time out, or make room for this one */
+  for (int i = 0; i < LWIP_PROBER_WINDOW; i++) {
+    slot = &peer->slots[i];
+
+    if (slot->pending && (slot == &peer->slots[peer->seq & (LWIP_PROBER_WINDOW - 1)] ||
+                          (u32_t)(now - slot->sent_ms) > LWIP_PROBER_TIMEOUT_MS)) {
+      if (slot->pending == LWIP_PROBER_PENDING) {
+        stats->lost++;
+      }
+      slot->pending = 0;
+    }
+  }
+
+  slot = &peer->slots[peer->seq & (LWIP_PROBER_WINDOW - 1)];
+  slot->seq = peer->seq++;
+  slot->ts = LWIP_PROBER_TS_NONE;
+
+  p = pbuf_alloc(stats->type == LWIP_PROBER_ICMP ? PBUF_IP : PBUF_TRANSPORT, (u16_t)(header + stats->size), PBUF_RAM);
+
+  if (p == NULL) {
+    stats->unsent++;
+    return;
+  }
+
+  b = (u8_t *)p->payload + header;
+  lwip_prober_fields_put(b, (u8_t)index, 0, slot->seq, 0);
+
+  for (u16_t i = LWIP_PROBER_SIZE_MIN; i < stats->size; i++) {
+    b[i] = (u8_t)i;
+  }
+
+  if (stats->type == LWIP_PROBER_ICMP) {
+    struct icmp_echo_hdr *iecho = (struct icmp_echo_hdr *)p->payload;
+
+    ICMPH_TYPE_SET(iecho, ICMP_ECHO);
+    ICMPH_CODE_SET(iecho, 0);
+    iecho->id = lwip_htons((u16_t)(LWIP_PROBER_ICMP_ID + index));
+    iecho->seqno = lwip_htons(slot->seq);
+    iecho->chksum = 0;
+    iecho->chksum = inet_chksum(iecho, p->len);
+  }
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+  lwip_prober_tx_arm(index, slot);
+#endif
+
+  slot->sent_ms = now;
+  slot->sent_us = timebase_us();
+
+  if (stats->type == LWIP_PROBER_ICMP) {
+    err = raw_sendto(lwip_prober_icmp_pcb, p, &stats->addr);
+  } else {
+    err = udp_sendto(lwip_prober_udp_pcb, p, &stats->addr, LWIP_PROBER_PORT);
+  }
+
+  pbuf_free(p);
+
+  if (err != ERR_OK) {
+    /* an armed timestamp times out in the driver, the poll lets it go */
+    slot->ts = LWIP_PROBER_TS_NONE;
+    stats->unsent++;
+    return;
+  }
+
+  slot->pending = LWIP_PROBER_PENDING;
+  stats->sent++;
+}
+
+/* sends the probes that are due, and waits for the next one */
+static void
+lwip_prober_timeout(void *arg)
+{
+  u32_t now = sys_now();
+  u32_t wait = 0;
+  int any = 0;
+
+  LWIP_UNUSED_ARG(arg);
+
+  for (int i = 0; i < LWIP_PROBER_PEERS; i++) {
+    struct lwip_prober_peer *peer = &lwip_prober_peers[i];
+
+    if (!peer->used) {
+      continue;
+    }
+
+    if ((s32_t)(now - peer->next_ms) >= 0) {
+      lwip_prober_send(i, now);
+
+      peer->next_ms += peer->stats.interval_ms;
+
+      /* fell behind by a whole interval, the missed probes aren't caught up with */
+      if ((s32_t)(now - peer->next_ms) >= 0) {
+        peer->next_ms = now + peer->stats.interval_ms;
+      }
+    }
+
+    if (!any || peer->next_ms - now < wait) {
+      wait = peer->next_ms - now;
+      any = 1;
+    }
+  }
+
+  if (any) {
+    sys_timeout(wait, lwip_prober_timeout, NULL);
+  }
+}
+
+static void
+lwip_prober_schedule(void)
+{
+  sys_untimeout(lwip_prober_timeout, NULL);
+  lwip_prober_timeout(NULL);
+}
+
+err_t
+lwip_prober_init(struct netif *timestamp_netif)
+{
+  if (lwip_prober_icmp_pcb != NULL) {
+    return ERR_ALREADY;
+  }
+
+  lwip_prober_icmp_pcb = raw_new_ip_type(IPADDR_TYPE_V4, IP_PROTO_ICMP);
+  lwip_prober_udp_pcb = udp_new_ip_type(IPADDR_TYPE_V4);
+  lwip_prober_responder_pcb = udp_new_ip_type(IPADDR_TYPE_V4);
+
+  if (lwip_prober_icmp_pcb == NULL || lwip_prober_udp_pcb == NULL || lwip_prober_responder_pcb == NULL ||
+      udp_bind(lwip_prober_udp_pcb, IP4_ADDR_ANY, 0) != ERR_OK ||
+      udp_bind(lwip_prober_responder_pcb, IP4_ADDR_ANY, LWIP_PROBER_PORT) != ERR_OK) {
+    if (lwip_prober_icmp_pcb != NULL) {
+      raw_remove(lwip_prober_icmp_pcb);
+      lwip_prober_icmp_pcb = NULL;
+    }
+    if (lwip_prober_udp_pcb != NULL) {
+      udp_remove(lwip_prober_udp_pcb);
+      lwip_prober_udp_pcb = NULL;
+    }
+    if (lwip_prober_responder_pcb != NULL) {
+      udp_remove(lwip_prober_responder_pcb);
+      lwip_prober_responder_pcb = NULL;
+    }
+
+    return ERR_MEM;
+  }
+
+  raw_recv(lwip_prober_icmp_pcb, lwip_prober_icmp_recv, NULL);
+  udp_recv(lwip_prober_udp_pcb, lwip_prober_udp_recv, NULL);
+  udp_recv(lwip_prober_responder_pcb, lwip_prober_responder_recv, NULL);
+
+  lwip_prober_timestamp_netif = timestamp_netif;
+
+  return ERR_OK;
+}
+
+int
+lwip_prober_add(const ip_addr_t *addr, enum lwip_prober_type type, u32_t interval_ms, u16_t size)
+{
+  if (lwip_prober_icmp_pcb == NULL || !IP_IS_V4(addr) || interval_ms == 0 ||
+      size < LWIP_PROBER_SIZE_MIN || size > 1500 - IP_HLEN - 8) {
+    return -1;
+  }
+
+  for (int i = 0; i < LWIP_PROBER_PEERS; i++) {
+    struct lwip_prober_peer *peer = &lwip_prober_peers[i];
+
+    if (peer->used) {
+      continue;
+    }
+
+    memset(peer, 0, sizeof(*peer));
+    ip_addr_copy(peer->stats.addr, *addr);
+    peer->stats.type = type;
+    peer->stats.size = size;
+    peer->stats.interval_ms = interval_ms;
+    peer->stats.min_ns = 0xffffffffUL;
+    peer->next_ms = sys_now();
+    peer->used = 1;
+
+    lwip_prober_schedule();
+
+    return i;
+  }
+
+  return -1;
+}
+
+void
+lwip_prober_remove(int peer)
+{
+  if (peer < 0 || peer >= LWIP_PROBER_PEERS) {
+    return;
+  }
+
+  lwip_prober_peers[peer].used = 0;
+
+  lwip_prober_schedule();
+}
+
+int
+lwip_prober_get(int peer, struct lwip_prober_stats *stats)
+{
+  if (peer < 0 || peer >= LWIP_PROBER_PEERS || !lwip_prober_peers[peer].used) {
+    return 0;
+  }
+
+  *stats = lwip_prober_peers[peer].stats;
+
+  return 1;
+}
+
+void
+lwip_prober_reset(int peer)
+{
+  struct lwip_prober_stats *stats;
+
+  if (peer < 0 || peer >= LWIP_PROBER_PEERS || !lwip_prober_peers[peer].used) {
+    return;
+  }
+
+  for (int i = 0; i < LWIP_PROBER_WINDOW; i++) {
+    struct lwip_prober_slot *slot = &lwip_prober_peers[peer].slots[i];
+
+    if (slot->pending) {
+      slot->pending = LWIP_PROBER_PENDING_OLD;
+    }
+  }
+
+  stats = &lwip_prober_peers[peer].stats;
+  stats->sent = 0;
+  stats->received = 0;
+  stats->lost = 0;
+  stats->late = 0;
+  stats->unsent = 0;
+  stats->stamped = 0;
+  stats->last_ns = 0;
+  stats->min_ns = 0xffffffffUL;
+  stats->max_ns = 0;
+  stats->sum_ns = 0;
+  memset(stats->buckets, 0, sizeof(stats->buckets));
+}
+
+void
+lwip_prober_format(int peer, char *line, size_t size)
+{
+  struct lwip_prober_stats stats;
+  size_t len;
+  int n;
+
+  line[0] = '\0';
+
+  if (!lwip_prober_get(peer, &stats)) {
+    return;
+  }
+
+  n = snprintf(line, size, "prober %s %s %u B every %lu ms: sent %lu recv %lu lost %lu late %lu unsent %lu stamped %lu",
+               ipaddr_ntoa(&stats.addr), stats.type == LWIP_PROBER_ICMP ? "icmp" : "udp", stats.size,
+               (unsigned long)stats.interval_ms, (unsigned long)stats.sent, (unsigned long)stats.received,
+               (unsigned long)stats.lost, (unsigned long)stats.late, (unsigned long)stats.unsent,
+               (unsigned long)stats.stamped);
+
+  if (n < 0 || (size_t)n >= size || stats.received == 0) {
+    return;
+  }
+
+  len = (size_t)n;
+
+  /* us to the ns */
+  {
+    u32_t avg = (u32_t)(stats.sum_ns / stats.received);
+
+    n = snprintf(line + len, size - len, ", rtt last %lu.%03lu min %lu.%03lu avg %lu.%03lu max %lu.%03lu us,",
+                 (unsigned long)(stats.last_ns / 1000), (unsigned long)(stats.last_ns % 1000),
+                 (unsigned long)(stats.min_ns / 1000), (unsigned long)(stats.min_ns % 1000),
+                 (unsigned long)(avg / 1000), (unsigned long)(avg % 1000),
+                 (unsigned long)(stats.max_ns / 1000), (unsigned long)(stats.max_ns % 1000));
+  }
+
+  for (int b = 0; b < LWIP_PROBER_BUCKETS; b++) {
+    if (n < 0 || len + (size_t)n >= size) {
+      return;
+    }
+
+    len += (size_t)n;
+    n = 0;
+
+    if (stats.buckets[b] == 0) {
+      continue;
+    }
+
+    if (b == LWIP_PROBER_BUCKETS - 1) {
+      n = snprintf(line + len, size - len, " >=%lu:%lu", 1ul << (b - 1), (unsigned long)stats.buckets[b]);
+    } else {
+      n = snprintf(line + len, size - len, " <%lu:%lu", 1ul << b, (unsigned long)stats.buckets[b]);
+    }
+  }
+}
+
+void
+lwip_prober_report(void)
+{
+  char line[384];
+
+  for (int i = 0; i < LWIP_PROBER_PEERS; i++) {
+    if (lwip_prober_peers[i].used) {
+      lwip_prober_format(i, line, sizeof(line));
+      printf("%s\n", line);
+    }
+  }
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_PROBER_H
+#define LWIP_PROBER_H
+
+#include <stddef.h>
+
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+#include "lwip/netif.h"
+
+/* Latency prober: ICMP echo and UDP probes to a list of IPv4 peers, each at its own
+   interval, and the round trips of their replies kept per peer in log2 histograms of us,
+   for a device to report the latency of its network itself.
+
+   A probe is timed with the 1 us timer (timebase_us()) right before raw_sendto() or
+   udp_sendto() and as its reply reaches the receive callback, from the driver's RX pass.
+   With the netif of a build with PICO_RMII_ETHERNET_TIMESTAMP given to lwip_prober_init(),
+   a probe whose frames both get the driver's hardware timestamps is timed with those, as
+   examples/ptp does: at the SFD of the request leaving and of the reply arriving, to the
+   ns, with none of either stack's time in them. One TX timestamp is armed at a time, the
+   probes sent meanwhile fall back to the timer.
+
+   UDP probes go to LWIP_PROBER_PORT, the echo service's, so any UDP echo server answers
+   them. The prober answers them too and writes into the reply how long it held the
+   request, from its receive callback to its send, which the sender takes out of the round
+   trip: between two devices running it the UDP round trip is the network's, whatever the
+   peer's load. The time a peer takes to answer an ICMP echo stays in its round trip.
+
+   A probe not answered in LWIP_PROBER_TIMEOUT_MS, or still unanswered when its slot in
+   the LWIP_PROBER_WINDOW probes in flight per peer is needed again, is lost, and a reply
+   to it later is late. All the functions are called from lwIP context (with the core lock
+   under NO_SYS=0). */
+
+#ifndef LWIP_PROBER_PEERS
+#define LWIP_PROBER_PEERS 8
+#endif
+
+/* UDP port of the probes and of the prober's responder, echo (RFC 862) */
+#ifndef LWIP_PROBER_PORT
+#define LWIP_PROBER_PORT 7
+#endif
+
+#ifndef LWIP_PROBER_TIMEOUT_MS
+#define LWIP_PROBER_TIMEOUT_MS 1000
+#endif
+
+/* probes in flight per peer, a power of 2: at least LWIP_PROBER_TIMEOUT_MS / the
+   interval for none to be lost to the window */
+#ifndef LWIP_PROBER_WINDOW
+#define LWIP_PROBER_WINDOW 16
+#endif
+
+/* ICMP identifier of the echo requests of peer 0, peer n's is this plus n */
+#ifndef LWIP_PROBER_ICMP_ID
+#define LWIP_PROBER_ICMP_ID 0x5052
+#endif
+
+/* bucket 0 counts round trips under 1 us, bucket b those in [2^(b-1), 2^b) us, the last
+   one everything from 2^(LWIP_PROBER_BUCKETS - 2) us on, as the driver's profile */
+#define LWIP_PROBER_BUCKETS 24
+
+/* payload of the probes without the ICMP or UDP header: the prober's own fields, the
+   size given to lwip_prober_add() pads them */
+#define LWIP_PROBER_SIZE_MIN 12
+
+enum lwip_prober_type {
+  LWIP_PROBER_ICMP,
+  LWIP_PROBER_UDP
+};
+
+struct lwip_prober_stats {
+  ip_addr_t addr;
+  enum lwip_prober_type type;
+  u16_t size;
+  u32_t interval_ms;
+  u32_t sent;
+  u32_t received;
+  u32_t lost;      /* unanswered in LWIP_PROBER_TIMEOUT_MS or out of the window */
+  u32_t late;      /* replies to lost probes, or again to an answered one */
+  u32_t unsent;    /* no pbuf, or the stack refused the probe */
+  u32_t stamped;   /* of received, timed by the driver's hardware timestamps */
+  u32_t last_ns;   /* round trip of the last reply */
+  u32_t min_ns;
+  u32_t max_ns;
+  u64_t sum_ns;
+  u32_t buckets[LWIP_PROBER_BUCKETS];
+};
+
+/* Binds the responder on LWIP_PROBER_PORT and the pcbs of the probes. timestamp_netif,
+   NULL for none, is the netif whose driver timestamps the frames */
+err_t lwip_prober_init(struct netif *timestamp_netif);
+
+/* Probes addr, an IPv4 address, every interval_ms with size bytes of payload, from
+   LWIP_PROBER_SIZE_MIN up to the MTU's. The peer's index, -1 without room or on wrong
+   arguments */
+int lwip_prober_add(const ip_addr_t *addr, enum lwip_prober_type type, u32_t interval_ms, u16_t size);
+
+void lwip_prober_remove(int peer);
+
+/* The counters of peer, 0 for a free index */
+int lwip_prober_get(int peer, struct lwip_prober_stats *stats);
+
+/* Restarts the counters and the histogram of peer, the probes in flight are left out */
+void lwip_prober_reset(int peer);
+
+/* One line of peer's counters and histogram, empty for a free index */
+void lwip_prober_format(int peer, char *line, size_t size);
+
+/* Reports every peer on stdio */
+void lwip_prober_report(void);
+
+#endif /* LWIP_PROBER_H */
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "lwip/opt.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+
+#include "lwip_tcp_writer.h"
+
+#if LWIP_TCP
+
+static void
+lwip_tcp_writer_timeout(void *arg)
+{
+  struct lwip_tcp_writer *writer = (struct lwip_tcp_writer *)arg;
+
+  writer->timer = 0;
+  lwip_tcp_writer_flush(writer);
+}
+
+static void
+lwip_tcp_writer_start_deadline(struct lwip_tcp_writer *writer)
+{
+  if ((writer->deadline_ms != 0) && !writer->timer) {
+    sys_timeout(writer->deadline_ms, lwip_tcp_writer_timeout, writer);
+    writer->timer = 1;
+  }
+}
+
+/* sends what tcp_write() has queued, past Nagle, and cancels the deadline */
+static err_t
+lwip_tcp_writer_output(struct lwip_tcp_writer *writer)
+{
+  err_t err;
+
+  if (writer->timer) {
+    sys_untimeout(lwip_tcp_writer_timeout, writer);
+    writer->timer = 0;
+  }
+
+  if (writer->pending == 0) {
+    return ERR_OK;
+  }
+
+  writer->pending = 0;
+  writer->outputs++;
+
+  tcp_nagle_disable(writer->pcb);
+  err = tcp_output(writer->pcb);
+  tcp_nagle_enable(writer->pcb);
+
+  return err;
+}
+
+static err_t
+lwip_tcp_writer_put(struct lwip_tcp_writer *writer, const void *data, u16_t len)
+{
+  err_t err;
+
+  /* a write that would run past the MSS starts the next segment: tcp_output() sends
+     all that is queued, so a full segment would go with a stub of this write behind */
+  if ((writer->pending != 0) && (writer->pending + len > tcp_mss(writer->pcb))) {
+    err = lwip_tcp_writer_output(writer);
+    if (err != ERR_OK) {
+      return err;
+    }
+  }
+
+  /* MORE leaves PSH to the segment's last write, the one of the flush */
+  err = tcp_write(writer->pcb, data, len, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
+  writer->writes++;
+
+  if (err != ERR_OK) {
+    /* out of send buffer or queue entries: send what is there, the ACKs make room */
+    lwip_tcp_writer_output(writer);
+    return err;
+  }
+
+  writer->pending += len;
+
+  if (writer->pending >= tcp_mss(writer->pcb)) {
+    return lwip_tcp_writer_output(writer);
+  }
+
+  lwip_tcp_writer_start_deadline(writer);
+
+  return ERR_OK;
+}
+
+/* the block in compress->out into the send buffer, kept there on an error */
+static err_t
+lwip_tcp_writer_put_block(struct lwip_tcp_writer *writer)
+{
+  err_t err;
+
+  if (writer->out_len == 0) {
+    return ERR_OK;
+  }
+
+  err = lwip_tcp_writer_put(writer, writer->compress->out, writer->out_len);
+  if (err == ERR_OK) {
+    writer->out_len = 0;
+  }
+
+  return err;
+}
+
+static err_t
+lwip_tcp_writer_write_compressed(struct lwip_tcp_writer *writer, const void *data, u16_t len)
+{
+  err_t err;
+
+  if (len > COMPRESS_BLOCK_MAX) {
+    return ERR_VAL;
+  }
+
+  /* a block the send buffer had no room for goes first */
+  err = lwip_tcp_writer_put_block(writer);
+
+  if ((err == ERR_OK) && (compress_room(writer->compress) < len)) {
+    writer->out_len = (u16_t)compress_flush(writer->compress);
+    err = lwip_tcp_writer_put_block(writer);
+  }
+
+  if (err == ERR_OK) {
+    compress_write(writer->compress, data, len);
+  }
+
+  /* the deadline covers the records in the block and a block kept back as well as the
+     bytes queued, a put that sent what was queued cancelled it */
+  lwip_tcp_writer_start_deadline(writer);
+
+  return err;
+}
+
+void
+lwip_tcp_writer_init(struct lwip_tcp_writer *writer, struct tcp_pcb *pcb, u32_t deadline_ms)
+{
+  writer->pcb = pcb;
+  writer->deadline_ms = deadline_ms;
+  writer->pending = 0;
+  writer->writes = 0;
+  writer->outputs = 0;
+  writer->timer = 0;
+  writer->compress = NULL;
+  writer->out_len = 0;
+
+  /* Nagle holds the partial segment when the ACKs call tcp_output() from tcp_input(),
+     the flushes send it past Nagle */
+  tcp_nagle_enable(pcb);
+}
+
+void
+lwip_tcp_writer_compress(struct lwip_tcp_writer *writer, struct compress *compress)
+{
+  writer->compress = compress;
+  writer->out_len = 0;
+}
+
+err_t
+lwip_tcp_writer_write(struct lwip_tcp_writer *writer, const void *data, u16_t len)
+{
+  if (writer->compress != NULL) {
+    return lwip_tcp_writer_write_compressed(writer, data, len);
+  }
+
+  return lwip_tcp_writer_put(writer, data, len);
+}
+
+err_t
+lwip_tcp_writer_flush(struct lwip_tcp_writer *writer)
+{
+  err_t err;
+
+  if (writer->compress != NULL) {
+    err = lwip_tcp_writer_put_block(writer);
+    if ((err == ERR_OK) && (writer->compress->pending != 0)) {
+      writer->out_len = (u16_t)compress_flush(writer->compress);
+      err = lwip_tcp_writer_put_block(writer);
+    }
+
+    if (err != ERR_OK) {
+      /* the put sent what was queued, the rest goes at the next deadline */
+      lwip_tcp_writer_start_deadline(writer);
+      return err;
+    }
+  }
+
+  return lwip_tcp_writer_output(writer);
+}
+
+void
+lwip_tcp_writer_detach(struct lwip_tcp_writer *writer)
+{
+  if (writer->timer) {
+    sys_untimeout(lwip_tcp_writer_timeout, writer);
+    writer->timer = 0;
+  }
+
+  writer->pending = 0;
+}
+
+#endif /* LWIP_TCP */
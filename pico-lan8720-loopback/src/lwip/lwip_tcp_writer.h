@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_TCP_WRITER_H
+#define LWIP_TCP_WRITER_H
+
+#include "lwip/opt.h"
+#include "lwip/tcp.h"
+
+#include "compress.h"
+
+/* Coalescing writes on a TCP pcb, for apps that write a few bytes at a time (telemetry
+   records, log lines) that would send a segment each with Nagle off. Each write is
+   copied with tcp_write(), and TCP_OVERSIZE puts it in the room left in the last
+   segment, which is sent once it holds a full MSS, at lwip_tcp_writer_flush() or
+   deadline_ms after its first byte. All the functions are called from lwIP context
+   (with the core lock under NO_SYS=0). A pending deadline takes a sys_timeout, one of
+   the 5 MEMP_NUM_SYS_TIMEOUT keeps for the apps */
+
+struct lwip_tcp_writer {
+  struct tcp_pcb *pcb;
+  u32_t deadline_ms; /* 0 waits for a full MSS or a flush */
+  u32_t pending;     /* bytes written since the last tcp_output() */
+  u32_t writes;      /* tcp_write() calls, for the stats of the app */
+  u32_t outputs;     /* tcp_output() calls */
+  u8_t timer;        /* the deadline's sys_timeout is pending */
+  struct compress *compress; /* NULL writes the records as they are */
+  u16_t out_len;     /* of the block in compress->out not queued yet */
+};
+
+/* Writes to pcb go through writer. Nagle stays on so the ACKs don't send the partial
+   segment, the writer's flushes pass it */
+void lwip_tcp_writer_init(struct lwip_tcp_writer *writer, struct tcp_pcb *pcb, u32_t deadline_ms);
+
+/* Queues len bytes (copied). Returns tcp_write()'s error, ERR_MEM when the send buffer
+   or queue is full: what was queued is sent then, write again from the sent callback */
+err_t lwip_tcp_writer_write(struct lwip_tcp_writer *writer, const void *data, u16_t len);
+
+/* Compresses the writes from now on with compress, initialized by the caller and at the
+   start of the connection's stream. The records collect in its block, which is compressed
+   into one LZ4 block of the frame when it is full and at each flush, the deadline's
+   included, and the blocks are queued up to an MSS as plain writes are. A write is then
+   up to COMPRESS_BLOCK_MAX bytes, ERR_VAL above, and is taken whole or not at all. With
+   ERR_MEM a compressed block is kept in compress->out and queued first on the next write
+   or flush */
+void lwip_tcp_writer_compress(struct lwip_tcp_writer *writer, struct compress *compress);
+
+/* Sends what is queued now */
+err_t lwip_tcp_writer_flush(struct lwip_tcp_writer *writer);
+
+/* Cancels the deadline, before the pcb is closed or freed. Queued bytes stay queued, a
+   tcp_close() sends them */
+void lwip_tcp_writer_detach(struct lwip_tcp_writer *writer);
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "lwip_arena.h"
+#include "lwip_telemetry.h"
+#include "lwip_tlsf.h"
+
+/* names of the pools in memp_t order, lwIP only keeps them with LWIP_DEBUG */
+static const char *const lwip_telemetry_pool_names[MEMP_MAX] = {
+#define LWIP_MEMPOOL(name, num, size, desc) #name,
+#include "lwip/priv/memp_std.h"
+};
+
+static u32_t lwip_telemetry_interval_ms;
+static struct udp_pcb *lwip_telemetry_syslog_pcb;
+static ip_addr_t lwip_telemetry_syslog_addr;
+
+void
+lwip_telemetry_get(struct lwip_telemetry *telemetry)
+{
+  memset(telemetry, 0, sizeof(*telemetry));
+
+#if MEM_STATS
+  telemetry->heap.avail = lwip_stats.mem.avail;
+  telemetry->heap.used = lwip_stats.mem.used;
+  telemetry->heap.max = lwip_stats.mem.max;
+  telemetry->heap.err = lwip_stats.mem.err;
+#endif
+#if PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_TLSF
+  lwip_tlsf_heap_walk(&telemetry->heap);
+#elif !MEM_LIBC_MALLOC && !MEM_USE_POOLS
+  lwip_mem_heap_walk(&telemetry->heap);
+#endif
+
+  for (int i = 0; i < MEMP_MAX; i++) {
+    telemetry->pools[i].name = lwip_telemetry_pool_names[i];
+#if MEMP_STATS
+    telemetry->pools[i].avail = lwip_stats.memp[i]->avail;
+    telemetry->pools[i].used = lwip_stats.memp[i]->used;
+    telemetry->pools[i].max = lwip_stats.memp[i]->max;
+    telemetry->pools[i].err = lwip_stats.memp[i]->err;
+#endif
+  }
+}
+
+void
+lwip_telemetry_reset_max(void)
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  /* the pools count under this protection */
+  SYS_ARCH_PROTECT(lev);
+#if MEM_STATS
+  lwip_stats.mem.max = lwip_stats.mem.used;
+#endif
+#if MEMP_STATS
+  for (int i = 0; i < MEMP_MAX; i++) {
+    lwip_stats.memp[i]->max = lwip_stats.memp[i]->used;
+  }
+#endif
+  SYS_ARCH_UNPROTECT(lev);
+
+#if PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_TLSF
+  lwip_tlsf_reset_max();
+#endif
+}
+
+static void
+lwip_telemetry_publish(const char *line)
+{
+  printf("%s\n", line);
+
+  if (lwip_telemetry_syslog_pcb != NULL) {
+    /* RFC 5424 with the nil values, local7.info, the collector stamps the time and
+       the source address */
+    static const char header[] = "<190>1 - - lwip - telemetry - ";
+    u16_t len = (u16_t)(sizeof(header) - 1 + strlen(line));
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+
+    if (p != NULL) {
+      memcpy(p->payload, header, sizeof(header) - 1);
+      memcpy((u8_t *)p->payload + sizeof(header) - 1, line, len - (sizeof(header) - 1));
+      udp_sendto(lwip_telemetry_syslog_pcb, p, &lwip_telemetry_syslog_addr, LWIP_TELEMETRY_SYSLOG_PORT);
+      pbuf_free(p);
+    }
+  }
+}
+
+void
+lwip_telemetry_report(void)
+{
+  struct lwip_telemetry telemetry;
+  char line[128];
+
+  lwip_telemetry_get(&telemetry);
+
+  snprintf(line, sizeof(line), "lwip HEAP used %u/%u max %u err %u, free %u in %u blocks, largest %u (%u%% fragmented)",
+           (unsigned)telemetry.heap.used, (unsigned)telemetry.heap.avail, (unsigned)telemetry.heap.max,
+           (unsigned)telemetry.heap.err, (unsigned)telemetry.heap.free, telemetry.heap.free_blocks,
+           (unsigned)telemetry.heap.largest_free,
+           telemetry.heap.free ? (unsigned)(100u - (100u * telemetry.heap.largest_free) / telemetry.heap.free) : 0u);
+  lwip_telemetry_publish(line);
+
+#if PICO_LWIP_ARENA_SIZE
+  lwip_arena_format(line, sizeof(line));
+  lwip_telemetry_publish(line);
+#endif
+
+  for (int i = 0; i < MEMP_MAX; i++) {
+    const struct lwip_telemetry_pool *pool = &telemetry.pools[i];
+
+    snprintf(line, sizeof(line), "lwip %s used %u/%u max %u err %u", pool->name,
+             pool->used, pool->avail, pool->max, (unsigned)pool->err);
+    lwip_telemetry_publish(line);
+  }
+
+#if LWIP_TCP && LWIP_TCP_MEM_SHARE
+  {
+    struct tcp_mem_stats mem;
+
+    /* what the connections hold of their shares, and how often they were held to them */
+    tcp_mem_get_stats(&mem);
+    snprintf(line, sizeof(line), "lwip TCP_MEM rx %u held, share %u of %u pcbs, tx share %u of %u pcbs, %u closed %u dropped %u refused",
+             mem.rx_pbufs, mem.rx_share, mem.rx_pcbs, mem.tx_share, mem.tx_pcbs,
+             (unsigned)mem.rx_closed, (unsigned)mem.rx_dropped, (unsigned)mem.tx_refused);
+    lwip_telemetry_publish(line);
+  }
+#endif
+}
+
+static void
+lwip_telemetry_timeout(void *arg)
+{
+  LWIP_UNUSED_ARG(arg);
+
+  lwip_telemetry_report();
+
+  sys_timeout(lwip_telemetry_interval_ms, lwip_telemetry_timeout, NULL);
+}
+
+void
+lwip_telemetry_start(u32_t interval_ms, const ip_addr_t *syslog_addr)
+{
+  lwip_telemetry_stop();
+
+  if (syslog_addr != NULL) {
+    lwip_telemetry_syslog_pcb = udp_new_ip_type(IP_GET_TYPE(syslog_addr));
+
+    if (lwip_telemetry_syslog_pcb != NULL) {
+      ip_addr_copy(lwip_telemetry_syslog_addr, *syslog_addr);
+    }
+  }
+
+  lwip_telemetry_interval_ms = interval_ms;
+
+  if (interval_ms != 0) {
+    sys_timeout(interval_ms, lwip_telemetry_timeout, NULL);
+  }
+}
+
+void
+lwip_telemetry_stop(void)
+{
+  sys_untimeout(lwip_telemetry_timeout, NULL);
+
+  if (lwip_telemetry_syslog_pcb != NULL) {
+    udp_remove(lwip_telemetry_syslog_pcb);
+    lwip_telemetry_syslog_pcb = NULL;
+  }
+}
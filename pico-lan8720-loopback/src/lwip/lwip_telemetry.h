@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_TELEMETRY_H
+#define LWIP_TELEMETRY_H
+
+#include "lwip/opt.h"
+#include "lwip/ip_addr.h"
+#include "lwip/memp.h"
+
+/* Use of lwIP's heap and memp pools, from MEM_STATS and MEMP_STATS, to size MEM_SIZE,
+   PBUF_POOL_SIZE and the MEMP_NUM_* options on the workload. All the functions are
+   called from lwIP context (with the core lock under NO_SYS=0). */
+
+/* Port of the syslog (RFC 5426) reports */
+#define LWIP_TELEMETRY_SYSLOG_PORT 514
+
+struct lwip_telemetry_pool {
+  const char *name;
+  u16_t avail;
+  u16_t used;
+  u16_t max;   /* high-water mark since boot or lwip_telemetry_reset_max() */
+  u32_t err;   /* failed allocations, the pool was empty */
+};
+
+struct lwip_telemetry_heap {
+  mem_size_t avail;
+  mem_size_t used;
+  mem_size_t max;
+  u32_t err;
+  /* from a walk of the heap: free space and its largest block, fragmentation is
+     1 - largest_free / free */
+  mem_size_t free;
+  mem_size_t largest_free;
+  u16_t free_blocks;
+  u16_t used_blocks;
+};
+
+struct lwip_telemetry {
+  struct lwip_telemetry_heap heap;
+  struct lwip_telemetry_pool pools[MEMP_MAX]; /* indexed by memp_t, PBUF_POOL is MEMP_PBUF_POOL */
+};
+
+/* Reads the counters now */
+void lwip_telemetry_get(struct lwip_telemetry *telemetry);
+
+/* Restarts the high-water marks from the current use, the error counts are kept */
+void lwip_telemetry_reset_max(void);
+
+/* Reports the heap and every pool on stdio and, if set, to the syslog collector */
+void lwip_telemetry_report(void);
+
+/* Reports every interval_ms from an lwIP timeout. With syslog_addr (copied) each
+   line is also sent as a syslog message over UDP, NULL keeps it on stdio */
+void lwip_telemetry_start(u32_t interval_ms, const ip_addr_t *syslog_addr);
+
+void lwip_telemetry_stop(void);
+
+/* lwip_mem.c, the heap fields from free on */
+void lwip_mem_heap_walk(struct lwip_telemetry_heap *heap);
+
+#endif /* LWIP_TELEMETRY_H */
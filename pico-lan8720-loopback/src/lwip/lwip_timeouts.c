@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* lwip's timeouts.c, with a look at the head of its sorted list of timeouts */
+#include "../../lib/lwip/src/core/timeouts.c"
+
+#include "lwip_timeouts.h"
+
+/* checked on every poll, it's PICO_RMII_HOT_IN_RAM's fast path, see arch/cc.h */
+u8_t
+LWIP_HOT_FUNC(lwip_timeouts_next)(u32_t *time)
+{
+  if (next_timeout == NULL) {
+    return 0;
+  }
+
+  *time = next_timeout->time;
+  return 1;
+}
@@ -0,0 +1,17 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_TIMEOUTS_H
+#define LWIP_TIMEOUTS_H
+
+#include "lwip/opt.h"
+
+/* The deadline of the first of lwIP's timeouts, in sys_now() ms, for a timer that
+   calls sys_check_timeouts() only when it is due (PICO_RMII_ETHERNET_TIMEOUT_ALARM).
+   Returns 0 when no timeout is pending. Called from lwIP context. */
+u8_t lwip_timeouts_next(u32_t *time);
+
+#endif
@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* TLSF heap behind mem_malloc(), see lwip_tlsf.h. Allocations share the pool lock
+   with memp.c when PICO_LWIP_SYS_ARCH_SPLIT_LOCKS is set */
+#if PICO_LWIP_SYS_ARCH_SPLIT_LOCKS
+#define SYS_ARCH_PROTECT_LOCK SYS_ARCH_LOCK_POOL
+#endif
+
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/stats.h"
+#include "lwip/sys.h"
+
+#include "lwip_tlsf.h"
+#include "lwip_telemetry.h"
+
+#if PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_TLSF
+
+/* Second level: 2^TLSF_SL_LOG2 classes per power of two, a request is rounded up to
+   the next class boundary so the first block of its class fits, 1/16 (6%) at most */
+#define TLSF_SL_LOG2        4
+#define TLSF_SL_COUNT       (1 << TLSF_SL_LOG2)
+
+#if MEM_ALIGNMENT == 4
+#define TLSF_ALIGN_LOG2     2
+#elif MEM_ALIGNMENT == 8
+#define TLSF_ALIGN_LOG2     3
+#else
+#error "lwip_tlsf.c: MEM_ALIGNMENT must be 4 or 8"
+#endif
+
+/* Blocks below TLSF_SMALL_SIZE are in first level 0, one class per MEM_ALIGNMENT */
+#define TLSF_FL_SHIFT       (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL_SIZE     (1 << TLSF_FL_SHIFT)
+
+/* First level: one per power of two up to the heap's size */
+#if MEM_SIZE < 0x10000
+#define TLSF_FL_MAX         16
+#elif MEM_SIZE < 0x100000
+#define TLSF_FL_MAX         20
+#else
+#error "lwip_tlsf.c: MEM_SIZE must be below 1 MB"
+#endif
+#define TLSF_FL_COUNT       (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+
+/* Low bit of a block's size */
+#define TLSF_BLOCK_FREE     1
+
+/* A block is its header and the payload that follows, the free list links are in the
+   payload of a free block. prev_phys is the block just below, so a free merges with
+   both neighbours without a search */
+struct tlsf_block {
+  struct tlsf_block *prev_phys;
+  size_t size; /* of the payload, TLSF_BLOCK_FREE in the low bit */
+  struct tlsf_block *next_free;
+  struct tlsf_block *prev_free;
+};
+
+#define TLSF_HEADER         offsetof(struct tlsf_block, next_free)
+#define TLSF_MIN_PAYLOAD    (sizeof(struct tlsf_block) - TLSF_HEADER)
+#define TLSF_MAX_PAYLOAD    (TLSF_HEAP_SIZE - 2 * TLSF_HEADER)
+
+/* MEM_SIZE of payload and headers, with the header of the first block and of the
+   zero sized, always used, block at the end that stops the merges */
+#define TLSF_HEAP_SIZE      (LWIP_MEM_ALIGN_SIZE(MEM_SIZE) + 2 * TLSF_HEADER)
+
+/* The end block is a header only, the tail room lets it be reached through a whole
+   struct tlsf_block like any other */
+static u8_t tlsf_heap[TLSF_HEAP_SIZE + TLSF_MIN_PAYLOAD] __attribute__((aligned(MEM_ALIGNMENT)));
+
+static struct {
+  u32_t fl_bitmap;
+  u32_t sl_bitmap[TLSF_FL_COUNT];
+  struct tlsf_block *blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];
+  size_t used;
+  size_t max;
+  u8_t init;
+} tlsf;
+
+static inline int
+tlsf_fls(size_t x)
+{
+  return 31 - __builtin_clz((unsigned int)x);
+}
+
+static inline size_t
+tlsf_block_size(const struct tlsf_block *block)
+{
+  return block->size & ~(size_t)TLSF_BLOCK_FREE;
+}
+
+static inline struct tlsf_block *
+tlsf_next_phys(const struct tlsf_block *block)
+{
+  return (struct tlsf_block *)(void *)((u8_t *)block + TLSF_HEADER + tlsf_block_size(block));
+}
+
+/* Class of a block of size bytes */
+static inline void
+tlsf_mapping_insert(size_t size, int *fl, int *sl)
+{
+  if (size < TLSF_SMALL_SIZE) {
+    *fl = 0;
+    *sl = (int)(size >> TLSF_ALIGN_LOG2);
+  } else {
+    int f = tlsf_fls(size);
+
+    *sl = (int)(size >> (f - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+    *fl = f - (TLSF_FL_SHIFT - 1);
+  }
+}
+
+/* First class whose every block holds size bytes */
+static inline void
+tlsf_mapping_search(size_t size, int *fl, int *sl)
+{
+  if (size >= TLSF_SMALL_SIZE) {
+    size += ((size_t)1 << (tlsf_fls(size) - TLSF_SL_LOG2)) - 1;
+  }
+
+  tlsf_mapping_insert(size, fl, sl);
+}
+
+/* The first free block of class (fl, sl) or larger, its class back in fl and sl */
+static struct tlsf_block *
+tlsf_search_suitable(int *fl, int *sl)
+{
+  u32_t sl_map = tlsf.sl_bitmap[*fl] & (~(u32_t)0 << *sl);
+
+  if (sl_map == 0) {
+    u32_t fl_map = tlsf.fl_bitmap & (~(u32_t)0 << (*fl + 1));
+
+    if (fl_map == 0) {
+      return NULL;
+    }
+
+    *fl = __builtin_ctz(fl_map);
+    sl_map = tlsf.sl_bitmap[*fl];
+  }
+
+  *sl = __builtin_ctz(sl_map);
+
+  return tlsf.blocks[*fl][*sl];
+}
+
+static void
+tlsf_insert(struct tlsf_block *block)
+{
+  int fl, sl;
+  struct tlsf_block *head;
+
+  tlsf_mapping_insert(tlsf_block_size(block), &fl, &sl);
+
+  head = tlsf.blocks[fl][sl];
+  block->next_free = head;
+  block->prev_free = NULL;
+  if (head != NULL) {
+    head->prev_free = block;
+  }
+
+  tlsf.blocks[fl][sl] = block;
+  tlsf.fl_bitmap |= (u32_t)1 << fl;
+  tlsf.sl_bitmap[fl] |= (u32_t)1 << sl;
+}
+
+static void
+tlsf_remove(struct tlsf_block *block)
+{
+  int fl, sl;
+
+  tlsf_mapping_insert(tlsf_block_size(block), &fl, &sl);
+
+  if (block->next_free != NULL) {
+    block->next_free->prev_free = block->prev_free;
+  }
+
+  if (block->prev_free != NULL) {
+    block->prev_free->next_free = block->next_free;
+  } else {
+    tlsf.blocks[fl][sl] = block->next_free;
+
+    if (block->next_free == NULL) {
+      tlsf.sl_bitmap[fl] &= ~((u32_t)1 << sl);
+      if (tlsf.sl_bitmap[fl] == 0) {
+        tlsf.fl_bitmap &= ~((u32_t)1 << fl);
+      }
+    }
+  }
+}
+
+/* One free block over the heap, and the used one of size 0 at its end */
+static void
+tlsf_init(void)
+{
+  struct tlsf_block *block = (struct tlsf_block *)(void *)tlsf_heap;
+  struct tlsf_block *end;
+
+  block->prev_phys = NULL;
+  block->size = TLSF_MAX_PAYLOAD | TLSF_BLOCK_FREE;
+
+  end = tlsf_next_phys(block);
+  end->prev_phys = block;
+  end->size = 0;
+
+  tlsf_insert(block);
+
+  MEM_STATS_AVAIL(avail, TLSF_MAX_PAYLOAD);
+
+  tlsf.init = 1;
+}
+
+void *
+lwip_tlsf_malloc(size_t size)
+{
+  struct tlsf_block *block;
+  int fl, sl;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  if ((size == 0) || (size > TLSF_MAX_PAYLOAD)) {
+    return NULL;
+  }
+
+  size = LWIP_MEM_ALIGN_SIZE(size);
+  if (size < TLSF_MIN_PAYLOAD) {
+    size = TLSF_MIN_PAYLOAD;
+  }
+
+  SYS_ARCH_PROTECT(lev);
+
+  if (!tlsf.init) {
+    tlsf_init();
+  }
+
+  tlsf_mapping_search(size, &fl, &sl);
+  block = (fl < TLSF_FL_COUNT) ? tlsf_search_suitable(&fl, &sl) : NULL;
+
+  /* nothing free in the classes above: a block of size's own class may still hold
+     it, its list is searched (first fit) only then, near the end of the heap */
+  if (block == NULL) {
+    tlsf_mapping_insert(size, &fl, &sl);
+
+    for (block = tlsf.blocks[fl][sl]; block != NULL; block = block->next_free) {
+      if (tlsf_block_size(block) >= size) {
+        break;
+      }
+    }
+
+    if (block == NULL) {
+      SYS_ARCH_UNPROTECT(lev);
+      return NULL;
+    }
+  }
+
+  tlsf_remove(block);
+
+  /* the rest as a free block when it can hold the free list links */
+  if (tlsf_block_size(block) >= size + TLSF_HEADER + TLSF_MIN_PAYLOAD) {
+    struct tlsf_block *rest = (struct tlsf_block *)(void *)((u8_t *)block + TLSF_HEADER + size);
+
+    rest->prev_phys = block;
+    rest->size = (tlsf_block_size(block) - size - TLSF_HEADER) | TLSF_BLOCK_FREE;
+    tlsf_next_phys(rest)->prev_phys = rest;
+    tlsf_insert(rest);
+
+    block->size = size;
+  } else {
+    block->size = tlsf_block_size(block);
+  }
+
+  tlsf.used += TLSF_HEADER + block->size;
+  if (tlsf.used > tlsf.max) {
+    tlsf.max = tlsf.used;
+  }
+
+  SYS_ARCH_UNPROTECT(lev);
+
+  return (u8_t *)block + TLSF_HEADER;
+}
+
+void *
+lwip_tlsf_calloc(size_t count, size_t size)
+{
+  void *mem;
+
+  if ((size != 0) && (count > TLSF_MAX_PAYLOAD / size)) {
+    return NULL;
+  }
+
+  mem = lwip_tlsf_malloc(count * size);
+  if (mem != NULL) {
+    memset(mem, 0, count * size);
+  }
+
+  return mem;
+}
+
+void
+lwip_tlsf_free(void *mem)
+{
+  struct tlsf_block *block;
+  struct tlsf_block *next;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  if (mem == NULL) {
+    return;
+  }
+
+  block = (struct tlsf_block *)(void *)((u8_t *)mem - TLSF_HEADER);
+
+  SYS_ARCH_PROTECT(lev);
+
+  LWIP_ASSERT("lwip_tlsf_free: block not allocated", !(block->size & TLSF_BLOCK_FREE));
+
+  tlsf.used -= TLSF_HEADER + block->size;
+
+  if ((block->prev_phys != NULL) && (block->prev_phys->size & TLSF_BLOCK_FREE)) {
+    struct tlsf_block *prev = block->prev_phys;
+
+    tlsf_remove(prev);
+    prev->size += TLSF_HEADER + block->size;
+    block = prev;
+  }
+
+  next = tlsf_next_phys(block);
+  if (next->size & TLSF_BLOCK_FREE) {
+    tlsf_remove(next);
+    block->size += TLSF_HEADER + tlsf_block_size(next);
+  }
+
+  block->size |= TLSF_BLOCK_FREE;
+  tlsf_next_phys(block)->prev_phys = block;
+  tlsf_insert(block);
+
+  SYS_ARCH_UNPROTECT(lev);
+}
+
+size_t
+lwip_tlsf_used(void)
+{
+  return tlsf.used;
+}
+
+size_t
+lwip_tlsf_max(void)
+{
+  return tlsf.max;
+}
+
+void
+lwip_tlsf_reset_max(void)
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  tlsf.max = tlsf.used;
+  SYS_ARCH_UNPROTECT(lev);
+}
+
+void
+lwip_tlsf_heap_walk(struct lwip_telemetry_heap *heap)
+{
+  struct tlsf_block *block;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  heap->free = 0;
+  heap->largest_free = 0;
+  heap->free_blocks = 0;
+  heap->used_blocks = 0;
+
+  SYS_ARCH_PROTECT(lev);
+
+  if (tlsf.init) {
+    for (block = (struct tlsf_block *)(void *)tlsf_heap; tlsf_block_size(block) != 0; block = tlsf_next_phys(block)) {
+      mem_size_t size = (mem_size_t)tlsf_block_size(block);
+
+      if (block->size & TLSF_BLOCK_FREE) {
+        heap->free_blocks++;
+        heap->free += size;
+        if (size > heap->largest_free) {
+          heap->largest_free = size;
+        }
+      } else {
+        heap->used_blocks++;
+      }
+    }
+  }
+
+  SYS_ARCH_UNPROTECT(lev);
+}
+
+#endif /* PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_TLSF */
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_TLSF_H
+#define LWIP_TLSF_H
+
+#include <stddef.h>
+
+#include "lwip/opt.h"
+
+/* Two-level segregated fit heap of MEM_SIZE bytes, lwIP's mem_malloc() with
+   PICO_LWIP_MEM_ALLOCATOR_TLSF (as mem_clib_malloc/free/calloc of MEM_LIBC_MALLOC).
+   Allocation and free are O(1): a size maps to one of 16 classes per power of two,
+   a bitmap finds the first non-empty class whose blocks all fit, and a freed block
+   merges with its free physical neighbours straight away. Only when no such class is
+   left is the request's own class searched. The heap sets itself up on the first
+   allocation, each call takes the SYS_ARCH_PROTECT lock */
+
+struct lwip_telemetry_heap;
+
+void *lwip_tlsf_malloc(size_t size);
+void *lwip_tlsf_calloc(size_t count, size_t size);
+void lwip_tlsf_free(void *mem);
+
+/* Bytes in allocated blocks, their headers included, and the high-water mark of that */
+size_t lwip_tlsf_used(void);
+size_t lwip_tlsf_max(void);
+
+/* Restarts the high-water mark from the current use */
+void lwip_tlsf_reset_max(void);
+
+/* Free space, its largest block and the block counts for lwip_telemetry */
+void lwip_tlsf_heap_walk(struct lwip_telemetry_heap *heap);
+
+#endif
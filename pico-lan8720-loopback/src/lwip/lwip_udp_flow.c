@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/etharp.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/ip4.h"
+#include "lwip/stats.h"
+#include "lwip/snmp.h"
+#include "lwip/sys.h"
+#include "lwip/udp.h"
+
+#include "lwip_udp_flow.h"
+
+#if LWIP_UDP && LWIP_IPV4 && LWIP_ARP
+
+#define LWIP_UDP_FLOW_HLEN (SIZEOF_ETH_HDR + IP_HLEN + UDP_HLEN)
+
+/* Builds the template for the route and ARP entry of the peer now, leaves the flow
+   without one when either is missing: udp_sendto() then sends, and queries a missing
+   ARP entry */
+static void
+lwip_udp_flow_build(struct lwip_udp_flow *flow)
+{
+  struct udp_pcb *pcb = flow->pcb;
+  const ip4_addr_t *dest;
+  const ip4_addr_t *src;
+  struct netif *netif;
+  struct eth_addr *mac;
+  const ip4_addr_t *mac_ip;
+  ssize_t i;
+
+  flow->netif = NULL;
+
+#if ETHARP_SUPPORT_VLAN
+  /* the tag is the VLAN hook's, per frame */
+  return;
+#endif
+
+  if (!IP_IS_V4(&flow->dest) || !IP_IS_V4_VAL(pcb->local_ip)) {
+    return;
+  }
+
+  dest = ip_2_ip4(&flow->dest);
+
+  if (ip4_addr_ismulticast(dest) || ip4_addr_isany(dest)) {
+    return;
+  }
+
+  /* udp_sendto()'s netif */
+  if (pcb->netif_idx != NETIF_NO_INDEX) {
+    netif = netif_get_by_index(pcb->netif_idx);
+  } else {
+    netif = ip4_route_src(ip_2_ip4(&pcb->local_ip), dest);
+  }
+
+  if ((netif == NULL) || !netif_is_up(netif) || !netif_is_link_up(netif) ||
+      !(netif->flags & NETIF_FLAG_ETHARP) || ip4_addr_isbroadcast(dest, netif)) {
+    return;
+  }
+
+  src = netif_ip4_addr(netif);
+
+  if (!ip4_addr_isany(ip_2_ip4(&pcb->local_ip)) && !ip4_addr_cmp(ip_2_ip4(&pcb->local_ip), src)) {
+    /* udp_sendto() refuses it with ERR_RTE */
+    return;
+  }
+
+  /* etharp_output()'s next hop, without LWIP_HOOK_ETHARP_GET_GW */
+  if (ip4_addr_netcmp(dest, src, netif_ip4_netmask(netif)) || ip4_addr_islinklocal(dest)) {
+    ip4_addr_copy(flow->next_hop, *dest);
+  } else if (!ip4_addr_isany_val(*netif_ip4_gw(netif))) {
+    ip4_addr_copy(flow->next_hop, *netif_ip4_gw(netif));
+  } else {
+    return;
+  }
+
+  i = etharp_find_addr(netif, &flow->next_hop, &mac, &mac_ip);
+
+  if (i < 0) {
+    return;
+  }
+
+  memset(&flow->hdr, 0, sizeof(flow->hdr));
+
+  SMEMCPY(&flow->hdr.eth.dest, mac, ETH_HWADDR_LEN);
+  SMEMCPY(&flow->hdr.eth.src, netif->hwaddr, ETH_HWADDR_LEN);
+  flow->hdr.eth.type = PP_HTONS(ETHTYPE_IP);
+
+  /* length, ID and checksum per datagram */
+  IPH_VHL_SET(&flow->hdr.ip, 4, IP_HLEN / 4);
+  IPH_TOS_SET(&flow->hdr.ip, pcb->tos);
+  IPH_TTL_SET(&flow->hdr.ip, pcb->ttl);
+  IPH_PROTO_SET(&flow->hdr.ip, IP_PROTO_UDP);
+  ip4_addr_copy(flow->hdr.ip.src, *src);
+  ip4_addr_copy(flow->hdr.ip.dest, *dest);
+  /* folded, in memory order as ip4_output_if_src() sums its inline checksum */
+  flow->ip_sum = (u16_t)~inet_chksum(&flow->hdr.ip, IP_HLEN);
+
+  /* length and checksum per datagram */
+  flow->hdr.udp.src = lwip_htons(pcb->local_port);
+  flow->hdr.udp.dest = lwip_htons(flow->port);
+
+  flow->netif = netif;
+  flow->arp_index = (s16_t)i;
+  flow->built_ms = sys_now();
+  flow->builds++;
+}
+
+/* The template holds for the next hop's ARP entry and the netif, built first when
+   there is none, a MAC of the entry that changed is taken over. When it doesn't hold,
+   or is due for the refresh, the datagram goes through udp_sendto() and the next one
+   builds the template again */
+static int
+lwip_udp_flow_valid(struct lwip_udp_flow *flow)
+{
+  struct netif *netif;
+  ip4_addr_t *ip;
+  struct netif *entry_netif;
+  struct eth_addr *mac;
+
+  if (flow->netif == NULL) {
+    lwip_udp_flow_build(flow);
+    if (flow->netif == NULL) {
+      return 0;
+    }
+  }
+
+  netif = flow->netif;
+
+  if (((u32_t)(sys_now() - flow->built_ms) >= LWIP_UDP_FLOW_REFRESH_MS) ||
+      !netif_is_up(netif) || !netif_is_link_up(netif) ||
+      !ip4_addr_cmp(netif_ip4_addr(netif), &flow->hdr.ip.src) ||
+      !etharp_get_entry((size_t)flow->arp_index, &ip, &entry_netif, &mac) ||
+      (entry_netif != netif) || !ip4_addr_cmp(ip, &flow->next_hop)) {
+    flow->netif = NULL;
+    return 0;
+  }
+
+  if (!eth_addr_cmp(mac, &flow->hdr.eth.dest)) {
+    SMEMCPY(&flow->hdr.eth.dest, mac, ETH_HWADDR_LEN);
+    flow->mac_changes++;
+  }
+
+  return 1;
+}
+
+static err_t
+lwip_udp_flow_sendto(struct lwip_udp_flow *flow, struct pbuf *p)
+{
+  flow->slow++;
+
+  return udp_sendto(flow->pcb, p, &flow->dest, flow->port);
+}
+
+err_t
+lwip_udp_flow_open(struct lwip_udp_flow *flow, struct udp_pcb *pcb, const ip_addr_t *dest, u16_t port)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+
+  memset(flow, 0, sizeof(*flow));
+
+  flow->pcb = pcb;
+  ip_addr_copy(flow->dest, *dest);
+  flow->port = port;
+#ifdef LWIP_RAND
+  flow->id = (u16_t)LWIP_RAND();
+#endif
+
+  if (pcb->local_port == 0) {
+    return udp_bind(pcb, &pcb->local_ip, 0);
+  }
+
+  return ERR_OK;
+}
+
+err_t
+lwip_udp_flow_send(struct lwip_udp_flow *flow, struct pbuf *p)
+{
+  struct netif *netif;
+  struct lwip_udp_flow_hdr *hdr;
+  u16_t udp_len;
+
+  LWIP_ASSERT_CORE_LOCKED();
+
+  if (!lwip_udp_flow_valid(flow) || (p->tot_len > flow->netif->mtu - IP_HLEN - UDP_HLEN)) {
+    return lwip_udp_flow_sendto(flow, p);
+  }
+
+  netif = flow->netif;
+  udp_len = (u16_t)(p->tot_len + UDP_HLEN);
+
+  if (pbuf_add_header(p, LWIP_UDP_FLOW_HLEN)) {
+    return lwip_udp_flow_sendto(flow, p);
+  }
+
+  hdr = (struct lwip_udp_flow_hdr *)p->payload;
+  MEMCPY(hdr, &flow->hdr, LWIP_UDP_FLOW_HLEN);
+
+  IPH_LEN_SET(&hdr->ip, lwip_htons((u16_t)(udp_len + IP_HLEN)));
+  IPH_ID_SET(&hdr->ip, lwip_htons(flow->id));
+  flow->id++;
+#if CHECKSUM_GEN_IP
+  IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_IP) {
+    /* the template's sum with the two words that change */
+    u32_t sum = flow->ip_sum + hdr->ip._len + hdr->ip._id;
+    sum = (sum >> 16) + (sum & 0xFFFF);
+    sum += sum >> 16;
+    hdr->ip._chksum = (u16_t)~sum;
+  }
+#endif /* CHECKSUM_GEN_IP */
+
+  hdr->udp.len = lwip_htons(udp_len);
+#if CHECKSUM_GEN_UDP
+  IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_UDP) {
+    u16_t chksum;
+
+    /* over the pseudo header, the UDP header and the payload */
+    pbuf_remove_header(p, SIZEOF_ETH_HDR + IP_HLEN);
+    chksum = inet_chksum_pseudo(p, IP_PROTO_UDP, udp_len, netif_ip4_addr(netif), ip_2_ip4(&flow->dest));
+    pbuf_add_header(p, SIZEOF_ETH_HDR + IP_HLEN);
+    if (chksum == 0x0000) {
+      chksum = 0xffff;
+    }
+    hdr->udp.chksum = chksum;
+  }
+#endif /* CHECKSUM_GEN_UDP */
+
+  flow->fast++;
+  UDP_STATS_INC(udp.xmit);
+  MIB2_STATS_INC(mib2.udpoutdatagrams);
+  IP_STATS_INC(ip.xmit);
+  MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
+  MIB2_STATS_NETIF_INC(netif, ifoutucastpkts);
+
+  return netif->linkoutput(netif, p);
+}
+
+void
+lwip_udp_flow_reset(struct lwip_udp_flow *flow)
+{
+  flow->netif = NULL;
+}
+
+void
+lwip_udp_flow_close(struct lwip_udp_flow *flow)
+{
+  flow->netif = NULL;
+  flow->pcb = NULL;
+}
+
+#endif /* LWIP_UDP && LWIP_IPV4 && LWIP_ARP */
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_UDP_FLOW_H
+#define LWIP_UDP_FLOW_H
+
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
+
+/* Connected UDP flows: the datagrams of a pcb to one IPv4 peer, sent with a ready-made
+   Ethernet, IP and UDP header straight to the netif's linkoutput, for streaming at high
+   rates. udp_sendto() routes each datagram, finds the next hop in the ARP table and
+   builds and sums the IP header; a flow does that once and keeps the headers as a
+   template, then per datagram copies it in front of the payload, sets the lengths and
+   its own IP ID, and updates the IP checksum from the template's sum. The UDP checksum
+   still covers the payload.
+
+   Every send checks in O(1) that the template holds: the netif up with the same address,
+   and the ARP entry of the next hop still stable, for the same address, with the same
+   MAC. A MAC that changed is copied into the template. Anything else, and every
+   LWIP_UDP_FLOW_REFRESH_MS, sends that datagram with udp_sendto(), which keeps lwIP's
+   ARP entry of the next hop refreshed and queries it when it is gone, and the next
+   datagram builds the template anew, route included. Datagrams over the MTU, to a
+   broadcast or multicast address, on a netif without ARP and with PICO_LWIP_VLAN always
+   go through udp_sendto().
+
+   The flow is the caller's, one per pcb and peer. All the functions are called from
+   lwIP context (with the core lock under NO_SYS=0) */
+
+/* ms between two datagrams sent through udp_sendto(), well under lwIP's ARP_MAXAGE for
+   the ARP entry of the next hop to be re-requested before it expires */
+#ifndef LWIP_UDP_FLOW_REFRESH_MS
+#define LWIP_UDP_FLOW_REFRESH_MS        10000
+#endif
+
+/* the headers of a datagram as they go on the wire */
+struct lwip_udp_flow_hdr {
+  struct eth_hdr eth;
+  struct ip_hdr ip;
+  struct udp_hdr udp;
+};
+
+struct lwip_udp_flow {
+  struct udp_pcb *pcb;
+  ip_addr_t dest;
+  u16_t port;
+  u16_t id;             /* IP ID of the next datagram */
+  struct netif *netif;  /* NULL without a template */
+  ip4_addr_t next_hop;
+  s16_t arp_index;      /* of the next hop's entry in lwIP's ARP table */
+  u32_t ip_sum;         /* of the template's IP header without length and ID */
+  u32_t built_ms;       /* sys_now() of the template */
+  struct lwip_udp_flow_hdr hdr;
+  /* counters */
+  u32_t fast;           /* datagrams sent with the template */
+  u32_t slow;           /* through udp_sendto() */
+  u32_t builds;         /* templates built */
+  u32_t mac_changes;    /* next hop MACs copied into the template */
+};
+
+/* Sets flow up for datagrams of pcb to dest (IPv4 for the template) and port, binding
+   pcb to a free port first as udp_sendto() does. The template is built by the first
+   send, pcb is then left to the flow until lwip_udp_flow_close() (udp_sendto() of it
+   stays fine). udp_bind()'s error */
+err_t lwip_udp_flow_open(struct lwip_udp_flow *flow, struct udp_pcb *pcb, const ip_addr_t *dest, u16_t port);
+
+/* Sends p as udp_sendto(flow->pcb, p, dest, port) would: p, allocated with
+   PBUF_TRANSPORT, holds the payload and stays the caller's to free, with the headers
+   put in front of it as udp_sendto() leaves them, so it isn't sent again. A p without
+   the room for the headers goes through udp_sendto(). The error of the netif's
+   linkoutput, or of udp_sendto() */
+err_t lwip_udp_flow_send(struct lwip_udp_flow *flow, struct pbuf *p);
+
+/* Drops the template, the next send builds it again: after the pcb's binding, TTL or
+   TOS change */
+void lwip_udp_flow_reset(struct lwip_udp_flow *flow);
+
+/* The pcb stays open, only the flow goes */
+void lwip_udp_flow_close(struct lwip_udp_flow *flow);
+
+#endif /* LWIP_UDP_FLOW_H */
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/etharp.h"
+#include "lwip/ip4_addr.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/sys.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/prot/etharp.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/prot/iana.h"
+#include "netif/ethernet.h"
+
+#include "lwip_uplink.h"
+
+#if LWIP_UPLINK
+
+#if !LWIP_IPV4 || !LWIP_ARP || !LWIP_TCP
+#error "LWIP_UPLINK needs LWIP_IPV4, LWIP_ARP and LWIP_TCP"
+#endif
+
+#if !LWIP_NETIF_LINK_CALLBACK
+#error "LWIP_UPLINK needs LWIP_NETIF_LINK_CALLBACK, the link callbacks move the addresses"
+#endif
+
+struct lwip_uplink {
+  struct netif *netif;
+  netif_input_fn input; /* the netif's own, ethernet_input() */
+  struct netif *owner;  /* sends for the address, NULL while no link is up */
+  u8_t weight;
+};
+
+static struct lwip_uplink lwip_uplinks[LWIP_UPLINK_MAX];
+static u8_t lwip_uplink_count;
+static struct lwip_uplink_stats lwip_uplink_stats;
+
+static struct lwip_uplink *
+lwip_uplink_find(const struct netif *netif)
+{
+  u8_t i;
+
+  for (i = 0; i < lwip_uplink_count; i++) {
+    if (lwip_uplinks[i].netif == netif) {
+      return &lwip_uplinks[i];
+    }
+  }
+
+  return NULL;
+}
+
+/* up, with its link and an address: it can carry new flows and take addresses over */
+static int
+lwip_uplink_usable(const struct netif *netif)
+{
+  return netif_is_up(netif) && netif_is_link_up(netif) && !ip4_addr_isany_val(*netif_ip4_addr(netif));
+}
+
+/* an ARP packet from netif's MAC: a gratuitous request for ipaddr when dst_ip is ipaddr,
+   or the reply to dst's request */
+static err_t
+lwip_uplink_arp(struct netif *netif, u16_t opcode, const ip4_addr_t *ipaddr,
+                const struct eth_addr *dst, const ip4_addr_t *dst_ip)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_LINK, SIZEOF_ETHARP_HDR, PBUF_RAM);
+  struct etharp_hdr *hdr;
+  err_t err;
+
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+
+  hdr = (struct etharp_hdr *)p->payload;
+  hdr->hwtype = PP_HTONS(LWIP_IANA_HWTYPE_ETHERNET);
+  hdr->proto = PP_HTONS(ETHTYPE_IP);
+  hdr->hwlen = ETH_HWADDR_LEN;
+  hdr->protolen = sizeof(ip4_addr_t);
+  hdr->opcode = lwip_htons(opcode);
+  SMEMCPY(&hdr->shwaddr, netif->hwaddr, ETH_HWADDR_LEN);
+  SMEMCPY(&hdr->dhwaddr, (opcode == ARP_REQUEST) ? &ethzero : dst, ETH_HWADDR_LEN);
+  IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&hdr->sipaddr, ipaddr);
+  IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&hdr->dipaddr, dst_ip);
+
+  err = ethernet_output(netif, p, (const struct eth_addr *)netif->hwaddr, dst, ETHTYPE_ARP);
+  pbuf_free(p);
+
+  return err;
+}
+
+/* the neighbours from's ARP table has resolved, into to's: the netifs are on one LAN, so
+   to can send to them at once instead of queueing a packet (one, without ARP_QUEUEING)
+   for each behind an ARP request. Each is fed to etharp_input() as the reply to to's own
+   request would be */
+static void
+lwip_uplink_arp_copy(struct netif *from, struct netif *to)
+{
+  size_t i;
+
+  for (i = 0; i < ARP_TABLE_SIZE; i++) {
+    ip4_addr_t *ipaddr;
+    struct netif *netif;
+    struct eth_addr *ethaddr;
+    struct pbuf *p;
+    struct etharp_hdr *hdr;
+
+    if (!etharp_get_entry(i, &ipaddr, &netif, &ethaddr) || (netif != from)) {
+      continue;
+    }
+
+    p = pbuf_alloc(PBUF_RAW, SIZEOF_ETHARP_HDR, PBUF_RAM);
+    if (p == NULL) {
+      return;
+    }
+
+    hdr = (struct etharp_hdr *)p->payload;
+    hdr->hwtype = PP_HTONS(LWIP_IANA_HWTYPE_ETHERNET);
+    hdr->proto = PP_HTONS(ETHTYPE_IP);
+    hdr->hwlen = ETH_HWADDR_LEN;
+    hdr->protolen = sizeof(ip4_addr_t);
+    hdr->opcode = PP_HTONS(ARP_REPLY);
+    SMEMCPY(&hdr->shwaddr, ethaddr, ETH_HWADDR_LEN);
+    SMEMCPY(&hdr->dhwaddr, to->hwaddr, ETH_HWADDR_LEN);
+    IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&hdr->sipaddr, ipaddr);
+    IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&hdr->dipaddr, netif_ip4_addr(to));
+
+    /* frees p */
+    etharp_input(p, to);
+  }
+}
+
+/* the TCP connections on addr resend what they have in flight, which went out on the
+   link that is gone, and have their peers resend what they had: 3 duplicate ACKs of
+   rcv_nxt are a fast retransmit of the peer's first unacked segment */
+static void
+lwip_uplink_kick(const ip4_addr_t *addr)
+{
+  struct tcp_pcb *pcb;
+  u8_t i;
+
+  for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+    if (!IP_IS_V4_VAL(pcb->local_ip) || !ip4_addr_cmp(ip_2_ip4(&pcb->local_ip), addr) ||
+        (pcb->state < ESTABLISHED) || (pcb->state == TIME_WAIT)) {
+      continue;
+    }
+
+    if (pcb->unacked != NULL) {
+      tcp_rexmit_rto(pcb);
+    }
+
+    for (i = 0; i < LWIP_UPLINK_DUPACKS; i++) {
+      tcp_send_empty_ack(pcb);
+    }
+
+    lwip_uplink_stats.tcp_kicked++;
+  }
+}
+
+/* the netif for uplink's address: its own while its link is up, else the one that took
+   it over while that one's link stays up, so an address doesn't move twice, else the
+   first usable one */
+static struct netif *
+lwip_uplink_pick_owner(const struct lwip_uplink *uplink)
+{
+  u8_t i;
+
+  if (netif_is_link_up(uplink->netif)) {
+    return uplink->netif;
+  }
+
+  if ((uplink->owner != NULL) && (uplink->owner != uplink->netif) && lwip_uplink_usable(uplink->owner)) {
+    return uplink->owner;
+  }
+
+  for (i = 0; i < lwip_uplink_count; i++) {
+    if ((lwip_uplinks[i].netif != uplink->netif) && lwip_uplink_usable(lwip_uplinks[i].netif)) {
+      return lwip_uplinks[i].netif;
+    }
+  }
+
+  return NULL;
+}
+
+void
+lwip_uplink_link_changed(struct netif *netif)
+{
+  u8_t i;
+
+  LWIP_UNUSED_ARG(netif);
+  LWIP_ASSERT_CORE_LOCKED();
+
+  /* a link going down or up can move any address, the one of netif and those netif
+     holds or could take */
+  for (i = 0; i < lwip_uplink_count; i++) {
+    struct lwip_uplink *uplink = &lwip_uplinks[i];
+    const ip4_addr_t *addr = netif_ip4_addr(uplink->netif);
+    struct netif *prev = uplink->owner;
+    struct netif *owner = lwip_uplink_pick_owner(uplink);
+
+    if (owner == prev) {
+      continue;
+    }
+
+    uplink->owner = owner;
+
+    if (owner == NULL) {
+      lwip_uplink_stats.lost++;
+      continue;
+    }
+
+    if (ip4_addr_isany(addr)) {
+      continue;
+    }
+
+    if (owner != uplink->netif) {
+      lwip_uplink_arp_copy(uplink->netif, owner);
+      lwip_uplink_arp(owner, ARP_REQUEST, addr, &ethbroadcast, addr);
+      lwip_uplink_stats.takeovers++;
+    } else if (prev != NULL) {
+      /* lwIP's netif_set_link_up() has sent the gratuitous ARP of the own MAC. What the
+         flows sent on the other link still arrives, they aren't kicked */
+      lwip_uplink_stats.takebacks++;
+      lwip_uplink_stats.last_move_ms = sys_now();
+      continue;
+    }
+
+    /* a takeover, or a link back after all were down: what was in flight is lost */
+    lwip_uplink_stats.last_move_ms = sys_now();
+    lwip_uplink_kick(addr);
+  }
+}
+
+/* netif->input of the uplinks: an ARP request for an address netif has taken over is
+   answered with netif's MAC, lwIP only answers for the netif's own */
+static err_t
+lwip_uplink_input(struct pbuf *p, struct netif *netif)
+{
+  struct lwip_uplink *uplink = lwip_uplink_find(netif);
+  struct {
+    struct eth_hdr eth;
+    struct etharp_hdr arp;
+  } frame;
+  u8_t i;
+
+  LWIP_ASSERT("lwip_uplink_input: not an uplink", uplink != NULL);
+
+  if ((pbuf_copy_partial(p, &frame, sizeof(frame), 0) == sizeof(frame)) &&
+      (frame.eth.type == PP_HTONS(ETHTYPE_ARP)) && (frame.arp.opcode == PP_HTONS(ARP_REQUEST))) {
+    ip4_addr_t target, sender;
+
+    IPADDR_WORDALIGNED_COPY_TO_IP4_ADDR_T(&target, &frame.arp.dipaddr);
+    IPADDR_WORDALIGNED_COPY_TO_IP4_ADDR_T(&sender, &frame.arp.sipaddr);
+
+    for (i = 0; i < lwip_uplink_count; i++) {
+      if ((lwip_uplinks[i].netif != netif) && (lwip_uplinks[i].owner == netif) &&
+          ip4_addr_cmp(&target, netif_ip4_addr(lwip_uplinks[i].netif))) {
+        if (lwip_uplink_arp(netif, ARP_REPLY, &target, &frame.arp.shwaddr, &sender) == ERR_OK) {
+          lwip_uplink_stats.arp_replies++;
+        }
+      }
+    }
+  }
+
+  return uplink->input(p, netif);
+}
+
+err_t
+lwip_uplink_add(struct netif *netif, u8_t weight)
+{
+  struct lwip_uplink *uplink;
+
+  LWIP_ASSERT_CORE_LOCKED();
+
+  if (lwip_uplink_count == LWIP_UPLINK_MAX) {
+    return ERR_MEM;
+  }
+
+  uplink = &lwip_uplinks[lwip_uplink_count++];
+  uplink->netif = netif;
+  uplink->input = netif->input;
+  uplink->owner = netif_is_link_up(netif) ? netif : NULL;
+  uplink->weight = (weight != 0) ? weight : 1;
+
+  netif->input = lwip_uplink_input;
+  netif_set_link_callback(netif, lwip_uplink_link_changed);
+
+  /* a link already down may have its address taken by one that is up */
+  lwip_uplink_link_changed(netif);
+
+  return ERR_OK;
+}
+
+struct netif *
+lwip_uplink_owner(const struct netif *netif)
+{
+  struct lwip_uplink *uplink = lwip_uplink_find(netif);
+
+  return (uplink != NULL) ? uplink->owner : NULL;
+}
+
+struct netif *
+lwip_uplink_flow_netif(const ip4_addr_t *dest, u32_t key)
+{
+  u8_t i;
+#if LWIP_UPLINK_SHARE
+  u32_t total = 0;
+  u32_t pick;
+
+  for (i = 0; i < lwip_uplink_count; i++) {
+    if (lwip_uplink_usable(lwip_uplinks[i].netif)) {
+      total += lwip_uplinks[i].weight;
+    }
+  }
+
+  if (total == 0) {
+    return NULL;
+  }
+
+  /* Fibonacci hashing of the destination and the key, scaled to the total weight from
+     the high bits, the mixed ones */
+  pick = (ip4_addr_get_u32(dest) ^ key) * 0x9e3779b1UL;
+  pick = (u32_t)(((u64_t)pick * total) >> 32);
+
+  for (i = 0; i < lwip_uplink_count; i++) {
+    if (lwip_uplink_usable(lwip_uplinks[i].netif)) {
+      if (pick < lwip_uplinks[i].weight) {
+        return lwip_uplinks[i].netif;
+      }
+
+      pick -= lwip_uplinks[i].weight;
+    }
+  }
+#else
+  LWIP_UNUSED_ARG(dest);
+  LWIP_UNUSED_ARG(key);
+
+  for (i = 0; i < lwip_uplink_count; i++) {
+    if (lwip_uplink_usable(lwip_uplinks[i].netif)) {
+      return lwip_uplinks[i].netif;
+    }
+  }
+#endif
+
+  return NULL;
+}
+
+struct netif *
+lwip_uplink_route(const ip4_addr_t *src, const ip4_addr_t *dest)
+{
+  struct netif *netif;
+  u8_t i;
+
+  if ((src != NULL) && !ip4_addr_isany(src)) {
+    for (i = 0; i < lwip_uplink_count; i++) {
+      if (ip4_addr_cmp(src, netif_ip4_addr(lwip_uplinks[i].netif))) {
+        return lwip_uplinks[i].owner;
+      }
+    }
+
+    return NULL;
+  }
+
+  if (ip4_addr_isloopback(dest)) {
+    return NULL;
+  }
+
+  /* a destination on the subnet of another netif, a PPP link say, is that netif's */
+  NETIF_FOREACH(netif) {
+    if ((lwip_uplink_find(netif) == NULL) && lwip_uplink_usable(netif) &&
+        ip4_addr_netcmp(dest, netif_ip4_addr(netif), netif_ip4_netmask(netif))) {
+      return NULL;
+    }
+  }
+
+  return lwip_uplink_flow_netif(dest, 0);
+}
+
+void
+lwip_uplink_get_stats(struct lwip_uplink_stats *stats)
+{
+  *stats = lwip_uplink_stats;
+}
+
+#endif /* LWIP_UPLINK */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef LWIP_UPLINK_H
+#define LWIP_UPLINK_H
+
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+
+/* Ethernet netifs of one lwIP instance as uplinks to the same LAN, the RMII netif and
+   the W5100S MACRAW one of pico-w5100s-loopback's dual_uplink for one, each with a MAC
+   and an address of its own. A flow leaves on the netif of its local address while that
+   netif's link is up. When a link goes down another uplink whose link is up takes its
+   address over: it announces the address with a gratuitous ARP of its own MAC, answers
+   the ARP requests for it, and the route hook sends what the flows bound to it send
+   there. Packets to the address are accepted on any netif, as lwIP does with all its
+   addresses. The TCP connections on the address retransmit what they have in flight
+   at once and send 3 duplicate ACKs, so their peers resend what was lost on the way
+   without waiting for an RTO. When the link comes back its netif announces the address
+   again (lwIP's gratuitous ARP on link up) and the flows move back.
+
+   The link callbacks drive it: lwip_uplink_add() sets lwip_uplink_link_changed() as the
+   netif's, an application with a link callback of its own calls it from there. Needs
+   LWIP_UPLINK in lwipopts.h for the route hook, set per target by the firmware that
+   builds this file. All the functions are called from lwIP context */
+
+#if LWIP_UPLINK
+
+/* netifs lwip_uplink_add() takes */
+#ifndef LWIP_UPLINK_MAX
+#define LWIP_UPLINK_MAX                 2
+#endif
+
+/* flows without a local address yet (tcp_connect() of an unbound pcb, udp_sendto() of
+   one) go out on an uplink picked by a hash of their destination over the uplinks whose
+   link is up, in proportion to their weights, instead of on the first of them that is
+   up. lwip_uplink_flow_netif() hashes a key of the application's too, for flows to one
+   host */
+#ifndef LWIP_UPLINK_SHARE
+#define LWIP_UPLINK_SHARE               0
+#endif
+
+/* duplicate ACKs a TCP connection sends when its address moves, the peer's fast
+   retransmit threshold. 0 leaves the peer to its RTO */
+#ifndef LWIP_UPLINK_DUPACKS
+#define LWIP_UPLINK_DUPACKS             3
+#endif
+
+struct lwip_uplink_stats {
+  u32_t takeovers;      /* addresses taken over by another uplink */
+  u32_t takebacks;      /* addresses back on their own uplink */
+  u32_t lost;           /* links that went down with no other uplink up */
+  u32_t arp_replies;    /* ARP requests answered for an address taken over */
+  u32_t tcp_kicked;     /* TCP connections resent and dup ACKed on a move */
+  u32_t last_move_ms;   /* sys_now() of the last takeover or takeback */
+};
+
+/* Adds netif, added with netif_add() and ethernet_input() as its input, as the next
+   uplink, the first one added is the primary. weight is its share of the new flows with
+   LWIP_UPLINK_SHARE, its bandwidth in Mbit/s say. ERR_MEM once LWIP_UPLINK_MAX are
+   added */
+err_t lwip_uplink_add(struct netif *netif, u8_t weight);
+
+/* The link callback of the uplinks */
+void lwip_uplink_link_changed(struct netif *netif);
+
+/* The netif that sends for the address of netif now: netif itself while its link is up,
+   the uplink that took the address over, or NULL */
+struct netif *lwip_uplink_owner(const struct netif *netif);
+
+/* The uplink for a new flow to dest, key tells apart flows to the same host (a port
+   say): bind the pcb to its address. NULL while no uplink is up */
+struct netif *lwip_uplink_flow_netif(const ip4_addr_t *dest, u32_t key);
+
+/* LWIP_HOOK_IP4_ROUTE_SRC: the owner of the uplink address src, and for src NULL or any
+   an uplink for dest (the first that is up, with LWIP_UPLINK_SHARE the hash's). NULL
+   leaves it to lwIP's routing */
+struct netif *lwip_uplink_route(const ip4_addr_t *src, const ip4_addr_t *dest);
+
+void lwip_uplink_get_stats(struct lwip_uplink_stats *stats);
+
+#endif /* LWIP_UPLINK */
+
+#endif
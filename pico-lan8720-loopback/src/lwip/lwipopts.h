@@ -32,12 +32,15 @@
 #ifndef __LWIPOPTS_H__
 #define __LWIPOPTS_H__
 
-/* Prevent having to link sys_arch.c (we don't test the API layers in unit tests) */
+/* Raw API only, polled from netif_rmii_ethernet_loop(). PICO_LWIP_FREERTOS in CMake
+   builds with NO_SYS=0 on FreeRTOS (sys_arch_freertos.c) for the netconn/socket APIs */
+#ifndef NO_SYS
 #define NO_SYS                          1
+#endif
 #define MEM_ALIGNMENT                   4
 #define LWIP_RAW                        1
-#define LWIP_NETCONN                    0
-#define LWIP_SOCKET                     0
+#define LWIP_NETCONN                    (!NO_SYS)
+#define LWIP_SOCKET                     (!NO_SYS)
 #define LWIP_DHCP                       1
 #define LWIP_ICMP                       1
 #define LWIP_UDP                        1
@@ -48,12 +51,531 @@
 #define LWIP_NETIF_LINK_CALLBACK        1
 #define LWIP_NETIF_STATUS_CALLBACK      1
 
+/* RMII zero copy RX passes DMA buffers up as pbuf_custom */
+#define LWIP_SUPPORT_CUSTOM_PBUF        1
+
 #define TCP_MSS                         (1500 /*mtu*/ - 20 /*iphdr*/ - 20 /*tcphhr*/)
+
+/* Internet checksum with an assembly inner loop (src/lwip/lwip_chksum.c), Thumb-1 on the
+   RP2040 and Thumb-2 on the RP2350's Cortex-M33, set to 0 to fall back to lwIP's
+   lwip_standard_chksum() and LWIP_CHKSUM_ALGORITHM. There is none for the RP2350's
+   RISC-V cores */
+#ifndef PICO_LWIP_CHKSUM_RP2040
+#if defined(__riscv)
+#define PICO_LWIP_CHKSUM_RP2040         0
+#else
+#define PICO_LWIP_CHKSUM_RP2040         1
+#endif
+#endif
+
+/* PBUF_POOL pbufs allocated and freed through a cache of up to PICO_LWIP_PBUF_CACHE_SIZE
+   elements per core (src/lwip/lwip_pbuf.c), which takes from or gives back to the pool
+   half of that at a time, under one lock. The caches hold half the pool at most */
+#ifndef PICO_LWIP_PBUF_CACHE
+#define PICO_LWIP_PBUF_CACHE            0
+#endif
+
+#ifndef PICO_LWIP_PBUF_CACHE_SIZE
+#define PICO_LWIP_PBUF_CACHE_SIZE       4
+#endif
+
+/* mem_malloc() behind the PBUF_RAM pbufs and the apps' state, selected with
+   PICO_LWIP_MEM_ALLOCATOR in CMake: lwIP's first fit heap of MEM_SIZE, the fixed
+   size pools of src/lwip/lwippools.h (MEM_USE_POOLS, from the smallest pool that fits
+   to the larger ones when it is empty) or an O(1) two-level segregated fit heap of
+   MEM_SIZE (src/lwip/lwip_tlsf.c, through MEM_LIBC_MALLOC). mem_trim() keeps the
+   whole block with the last two */
+#define PICO_LWIP_MEM_ALLOCATOR_FIRST_FIT 0
+#define PICO_LWIP_MEM_ALLOCATOR_POOLS     1
+#define PICO_LWIP_MEM_ALLOCATOR_TLSF      2
+
+#ifndef PICO_LWIP_MEM_ALLOCATOR
+#define PICO_LWIP_MEM_ALLOCATOR         PICO_LWIP_MEM_ALLOCATOR_FIRST_FIT
+#endif
+
+#if PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_POOLS
+#define MEM_USE_POOLS                   1
+#define MEMP_USE_CUSTOM_POOLS           1
+#define MEM_USE_POOLS_TRY_BIGGER_POOL   1
+#elif PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_TLSF
+#define MEM_LIBC_MALLOC                 1
+#define mem_clib_malloc                 lwip_tlsf_malloc
+#define mem_clib_calloc                 lwip_tlsf_calloc
+#define mem_clib_free                   lwip_tlsf_free
+#elif PICO_LWIP_MEM_ALLOCATOR != PICO_LWIP_MEM_ALLOCATOR_FIRST_FIT
+#error "unknown PICO_LWIP_MEM_ALLOCATOR"
+#endif
+
+/* lwIP's MEMCPY, PICO_LWIP_MEMCPY_DMA in CMake: copies of PICO_LWIP_MEMCPY_DMA_MIN
+   bytes or more by a DMA channel per core, the last 1/PICO_LWIP_MEMCPY_DMA_CPU_SHARE
+   of them (0 for none) by the CPU at the same time, shorter ones by a word loop
+   (src/lwip/lwip_memcpy.c). SMEMCPY stays memcpy(), its sizes are small constants */
+#ifndef PICO_LWIP_MEMCPY_DMA
+#define PICO_LWIP_MEMCPY_DMA            0
+#endif
+#ifndef PICO_LWIP_MEMCPY_DMA_MIN
+#define PICO_LWIP_MEMCPY_DMA_MIN        256
+#endif
+#ifndef PICO_LWIP_MEMCPY_DMA_CPU_SHARE
+#define PICO_LWIP_MEMCPY_DMA_CPU_SHARE  4
+#endif
+#if PICO_LWIP_MEMCPY_DMA
+#define MEMCPY(dst, src, len)           lwip_rp2040_memcpy(dst, src, len)
+void lwip_rp2040_memcpy(void *dst, const void *src, unsigned int len);
+#endif
+
+/* per netif checksum checks, PICO_RMII_ETHERNET_RX_CHKSUM of the RMII driver turns lwIP's
+   off for each frame it verified */
+#if PICO_RMII_ETHERNET_RX_CHKSUM
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
+#endif
+
+/* checksum TCP data while tcp_write() copies it into pbufs, instead of on a second pass */
+#ifndef LWIP_CHECKSUM_ON_COPY
+#define LWIP_CHECKSUM_ON_COPY           1
+#endif
+
+#if PICO_LWIP_CHKSUM_RP2040
+#define LWIP_CHKSUM                     lwip_rp2040_chksum
+unsigned short lwip_rp2040_chksum(const void *dataptr, int len);
+#if LWIP_CHECKSUM_ON_COPY
+#define LWIP_CHKSUM_COPY(dst, src, len) lwip_rp2040_chksum_copy(dst, src, len)
+unsigned short lwip_rp2040_chksum_copy(void *dst, const void *src, unsigned short len);
+#endif
+#endif
+
+/* Memory/throughput profiles, selected with PICO_LWIP_PROFILE in CMake. Approximate
+   lwIP RAM (heap + PBUF_POOL): low_mem ~17 KB, balanced ~40 KB, throughput ~100 KB */
+#define PICO_LWIP_PROFILE_LOW_MEM       0
+#define PICO_LWIP_PROFILE_BALANCED      1
+#define PICO_LWIP_PROFILE_THROUGHPUT    2
+#define PICO_LWIP_PROFILE_HIGH_LOSS     3
+#define PICO_LWIP_PROFILE_CONN_RATE     4
+
+#ifndef PICO_LWIP_PROFILE
+#define PICO_LWIP_PROFILE               PICO_LWIP_PROFILE_BALANCED
+#endif
+
+#if PICO_LWIP_PROFILE == PICO_LWIP_PROFILE_LOW_MEM
+#define MEM_SIZE                        (8 * 1024)
+#define PBUF_POOL_SIZE                  6
+#define PICO_LWIP_TCP_WND               (2 * TCP_MSS)
+#define PICO_LWIP_TCP_WND_MAX           (4 * TCP_MSS)
+#define PICO_LWIP_TCP_RCV_AUTOTUNE_BUDGET (2 * TCP_MSS)
 #define TCP_SND_BUF                     (2 * TCP_MSS)
+#define MEMP_NUM_TCP_PCB                4
+#define TCP_PCB_HASH_SIZE               4
+#define ARP_TABLE_SIZE                  10
+#define ETHARP_HASH_SIZE                8
+#define LWIP_ND6_NUM_NEIGHBORS          10
+#define LWIP_ND6_NUM_DESTINATIONS       10
+#define LWIP_ND6_HASH_SIZE              8
+#elif PICO_LWIP_PROFILE == PICO_LWIP_PROFILE_BALANCED
+#define MEM_SIZE                        (16 * 1024)
+#define PBUF_POOL_SIZE                  16
+#define PICO_LWIP_TCP_WND               (4 * TCP_MSS)
+#define PICO_LWIP_TCP_WND_MAX           (12 * TCP_MSS)
+#define PICO_LWIP_TCP_RCV_AUTOTUNE_BUDGET (8 * TCP_MSS)
+#define TCP_SND_BUF                     (4 * TCP_MSS)
+#define MEMP_NUM_TCP_PCB                5
+#define TCP_PCB_HASH_SIZE               8
+#define ARP_TABLE_SIZE                  48
+#define ETHARP_HASH_SIZE                64
+#define LWIP_ND6_NUM_NEIGHBORS          48
+#define LWIP_ND6_NUM_DESTINATIONS       48
+#define LWIP_ND6_HASH_SIZE              64
+#define IP_REASS_CONTIGUOUS_BUFS        2
+#elif PICO_LWIP_PROFILE == PICO_LWIP_PROFILE_THROUGHPUT
+#define MEM_SIZE                        (48 * 1024)
+#define PBUF_POOL_SIZE                  32
+#define PICO_LWIP_TCP_WND               (8 * TCP_MSS)
+#define PICO_LWIP_TCP_WND_MAX           (24 * TCP_MSS)
+#define PICO_LWIP_TCP_RCV_AUTOTUNE_BUDGET (24 * TCP_MSS)
+#define TCP_SND_BUF                     (8 * TCP_MSS)
+#define MEMP_NUM_TCP_PCB                8
+#define TCP_PCB_HASH_SIZE               8
+#define ARP_TABLE_SIZE                  64
+#define ETHARP_HASH_SIZE                64
+#define LWIP_ND6_NUM_NEIGHBORS          64
+#define LWIP_ND6_NUM_DESTINATIONS       64
+#define LWIP_ND6_HASH_SIZE              64
+#define IP_REASS_CONTIGUOUS_BUFS        4
+#elif PICO_LWIP_PROFILE == PICO_LWIP_PROFILE_HIGH_LOSS
+/* links that drop segments: the balanced heap, with 2 MSS more window so a loss still
+   leaves 3 segments behind it for the duplicate ACKs of a fast retransmit. The receiver
+   SACKs what it holds out of order (3 ranges, a 6 MSS window has no room for more
+   holes), so a SACK capable sender resends only the holes, and each pcb keeps at most
+   a window of it, the pool is shared with RX. The TCP timers run
+   every 25 ms instead of 250: the RTO is counted in slow ticks (2 x TCP_TMR_INTERVAL)
+   and settles at 3 of them on a LAN, so a loss with nothing behind it waits 150 ms
+   instead of 1.5 s. httpd's poll interval is in slow ticks too, scaled back to 2 s */
+#define MEM_SIZE                        (16 * 1024)
+#define PBUF_POOL_SIZE                  24
+#define PICO_LWIP_TCP_WND               (6 * TCP_MSS)
+#define PICO_LWIP_TCP_WND_MAX           (16 * TCP_MSS)
+#define PICO_LWIP_TCP_RCV_AUTOTUNE_BUDGET (10 * TCP_MSS)
+#define TCP_SND_BUF                     (6 * TCP_MSS)
+#define MEMP_NUM_TCP_PCB                5
+#define TCP_PCB_HASH_SIZE               8
+#define ARP_TABLE_SIZE                  48
+#define ETHARP_HASH_SIZE                64
+#define LWIP_ND6_NUM_NEIGHBORS          48
+#define LWIP_ND6_NUM_DESTINATIONS       48
+#define LWIP_ND6_HASH_SIZE              64
+#define IP_REASS_CONTIGUOUS_BUFS        2
+#define LWIP_TCP_SACK_OUT               1
+#define LWIP_TCP_MAX_SACK_NUM           3
+#define TCP_OOSEQ_MAX_BYTES             TCP_WND
+#define TCP_OOSEQ_MAX_PBUFS             8
+#define TCP_TMR_INTERVAL                25
+#define HTTPD_POLL_INTERVAL             (2000 / (2 * TCP_TMR_INTERVAL))
+#elif PICO_LWIP_PROFILE == PICO_LWIP_PROFILE_CONN_RATE
+/* many short connections, HTTP requests or one poll each: the balanced heap and
+   windows with 16 pcbs. A server that closes first keeps at most 8 of them in
+   TIME_WAIT, the oldest goes when another closes, and a SYN that reuses the ports of
+   one of them takes it over. A listener holds at most 4 connections in the
+   handshake, so a burst of SYNs can't take the pcbs of the ones being served, and
+   with SO_REUSE it binds again while its old connections are in TIME_WAIT */
+#define MEM_SIZE                        (16 * 1024)
+#define PBUF_POOL_SIZE                  16
+#define PICO_LWIP_TCP_WND               (4 * TCP_MSS)
+#define PICO_LWIP_TCP_WND_MAX           (12 * TCP_MSS)
+#define PICO_LWIP_TCP_RCV_AUTOTUNE_BUDGET (8 * TCP_MSS)
+#define TCP_SND_BUF                     (4 * TCP_MSS)
+#define MEMP_NUM_TCP_PCB                16
+#define TCP_PCB_HASH_SIZE               16
+#define ARP_TABLE_SIZE                  48
+#define ETHARP_HASH_SIZE                64
+#define LWIP_ND6_NUM_NEIGHBORS          48
+#define LWIP_ND6_NUM_DESTINATIONS       48
+#define LWIP_ND6_HASH_SIZE              64
+#define IP_REASS_CONTIGUOUS_BUFS        2
+#define LWIP_TCP_TIME_WAIT_MAX          8
+#define LWIP_TCP_TIME_WAIT_RECYCLE      1
+#define TCP_LISTEN_BACKLOG              1
+#define TCP_DEFAULT_LISTEN_BACKLOG      4
+#define SO_REUSE                        1
+#else
+#error "unknown PICO_LWIP_PROFILE"
+#endif
+
+/* the receive window of a connection is the profile's (PICO_LWIP_TCP_WND). With
+   LWIP_TCP_RCV_AUTOTUNE (PICO_LWIP_TCP_RCV_AUTOTUNE in CMake) a connection starts there
+   and doubles its window, up to PICO_LWIP_TCP_WND_MAX, while the window is what holds
+   the sender back, the bandwidth-delay product of a path longer than the LAN. Received
+   data waits in PBUF_POOL pbufs, so the maximum leaves the pool room for RX and all
+   connections together grow by at most TCP_RCV_AUTOTUNE_BUDGET. Window scaling (in
+   units of 4 bytes, up to 256 KB) is on with it, for a pool larger than the profiles' */
+#ifndef LWIP_TCP_RCV_AUTOTUNE
+#define LWIP_TCP_RCV_AUTOTUNE           0
+#endif
+
+/* lwIP's heap and the RMII driver's RX buffers carved from one static arena of
+   PICO_LWIP_ARENA_SIZE bytes at init (src/lwip/lwip_arena.c), PICO_LWIP_ARENA_SIZE in
+   CMake, instead of arrays sized apart. The heap takes the profile's MEM_SIZE first and
+   the interfaces share the rest. With PICO_RMII_ETHERNET_RX_ZERO_COPY the whole rest
+   becomes zero copy RX buffers, and those beyond the driver's own go to the connections'
+   receive windows through TCP_RCV_AUTOTUNE_BUDGET, so a KB the heap doesn't take is
+   window */
+#ifndef PICO_LWIP_ARENA_SIZE
+#define PICO_LWIP_ARENA_SIZE            0
+#endif
+
+#if PICO_LWIP_ARENA_SIZE
+#if PICO_LWIP_MEM_ALLOCATOR != PICO_LWIP_MEM_ALLOCATOR_FIRST_FIT
+#error "PICO_LWIP_ARENA_SIZE carves lwIP's first fit heap, not the pools or the tlsf heap"
+#endif
+#if PICO_LWIP_ARENA_SIZE < MEM_SIZE + 4096
+#error "PICO_LWIP_ARENA_SIZE leaves less than 4 KB next to the profile's MEM_SIZE"
+#endif
+extern unsigned int lwip_arena_tcp_budget;
+#define TCP_RCV_AUTOTUNE_BUDGET         (PICO_LWIP_TCP_RCV_AUTOTUNE_BUDGET + lwip_arena_tcp_budget)
+#else
+#define TCP_RCV_AUTOTUNE_BUDGET         PICO_LWIP_TCP_RCV_AUTOTUNE_BUDGET
+#endif
+
+#if LWIP_TCP_RCV_AUTOTUNE
+#define TCP_WND                         PICO_LWIP_TCP_WND_MAX
+#define TCP_RCV_AUTOTUNE_INIT_WND       PICO_LWIP_TCP_WND
+#define LWIP_WND_SCALE                  1
+#define TCP_RCV_SCALE                   2
+/* lwIP's default is relative to TCP_WND, keep the profile's */
+#define TCP_WND_UPDATE_THRESHOLD        LWIP_MIN((TCP_RCV_AUTOTUNE_INIT_WND / 4), (TCP_MSS * 4))
+#else
+#define TCP_WND                         PICO_LWIP_TCP_WND
+#endif
+
+/* tcp_input() finds the pcb of a segment in a hash table of the active pcbs (a bucket
+   per pcb of the profile) instead of walking tcp_active_pcbs, PICO_LWIP_TCP_PCB_HASH in
+   CMake. tools/host/tcp_demux_bench.c shows where that starts to matter */
+#ifndef LWIP_TCP_PCB_HASH
+#define LWIP_TCP_PCB_HASH               0
+#endif
+
+/* udp_input() finds the pcbs of a datagram in the bucket of its destination port (of
+   lwIP's default UDP_PCB_HASH_SIZE) instead of walking udp_pcbs, PICO_LWIP_UDP_PCB_HASH
+   in CMake. tools/host/udp_demux_bench.c shows where that starts to matter */
+#ifndef LWIP_UDP_PCB_HASH
+#define LWIP_UDP_PCB_HASH               0
+#endif
+
+/* the drivers bracket each pass over their received frames with
+   tcp_output_batch_begin()/_end(), and tcp_output() of the pass runs once per pcb at the
+   end of it: one ACK per connection for a burst, and the segments its callbacks queued
+   back to back. PICO_LWIP_TCP_OUTPUT_BATCH in CMake, tools/host/lro_bench.c compares */
+#ifndef LWIP_TCP_OUTPUT_BATCH
+#define LWIP_TCP_OUTPUT_BATCH           0
+#endif
+
+/* the congestion window of each pcb through its struct tcp_cc_ops, NewReno unless
+   tcp_set_cc() picks tcp_cc_ledbat, which holds the queue it builds on a slow uplink near
+   TCP_CC_LEDBAT_TARGET_MS and gives way to other traffic. PICO_LWIP_TCP_CC in CMake,
+   tools/host/tcp_cc_bench.c compares the two */
+#ifndef LWIP_TCP_CC
+#define LWIP_TCP_CC                     0
+#endif
+
+/* each connection holds at most its share of PBUF_POOL for data its application hasn't
+   tcp_recved() yet, the pool divided by the connections, and of the TCP segments for its
+   send queue. One at its share announces a zero window and drops what would take it over,
+   so a client whose server stops reading can't take the pool the others receive into.
+   tcp_set_mem_limit() gives a connection a cap of its own. PICO_LWIP_TCP_MEM_SHARE in
+   CMake, tools/host/tcp_mem_bench.c compares */
+#ifndef LWIP_TCP_MEM_SHARE
+#define LWIP_TCP_MEM_SHARE              0
+#endif
+
+/* etharp_output() finds the neighbour in the ARP table of the profile (lwIP's default
+   is 10 entries) through a hash table over the IP address instead of a search of all
+   entries, PICO_LWIP_ETHARP_HASH=OFF in CMake goes back to the search. Entries that
+   were sent to are re-requested by the ARP timer 30 s before they expire, not by the
+   next packet, so a neighbour polled every minute keeps its entry and the next poll
+   doesn't wait for an ARP reply */
+#ifndef ETHARP_TABLE_HASH
+#define ETHARP_TABLE_HASH               1
+#endif
+#ifndef ETHARP_REFRESH_AHEAD
+#define ETHARP_REFRESH_AHEAD            1
+#endif
+
+/* dual stack, PICO_LWIP_IPV6 in CMake: IPv6 next to IPv4 with lwIP's MLD and SLAAC,
+   the driver adds the link-local address and turns SLAAC on. The neighbour and
+   destination caches are sized as the profile's ARP table (lwIP's default is 10 entries
+   each) and looked up through a hash table over the address, as the ARP table is,
+   PICO_LWIP_ETHARP_HASH=OFF in CMake goes back to the searches. MLD joins the
+   solicited-node group of each address, which the driver's RX filter lets through */
+#ifndef LWIP_IPV6
+#define LWIP_IPV6                       0
+#endif
+#ifndef LWIP_ND6_CACHE_HASH
+#define LWIP_ND6_CACHE_HASH             ETHARP_TABLE_HASH
+#endif
+#if LWIP_IPV6
+/* a solicited-node group per address of each interface, and 2 for the application */
+#define MEMP_NUM_MLD6_GROUP             (2 * LWIP_IPV6_NUM_ADDRESSES + 2)
+#endif
+
+/* 802.1Q, PICO_LWIP_VLAN in CMake: frames are sent tagged with the VID of
+   netif_rmii_ethernet_netif_set_vlan() and a PCP of the IP precedence (the top 3 bits
+   of the DSCP), and only received untagged, priority tagged or with that VID. The hooks
+   are the driver's, in lwip_hooks.h. PBUF_LINK_HLEN takes the 4 bytes of the tag */
+#ifndef PICO_LWIP_VLAN
+#define PICO_LWIP_VLAN                  0
+#endif
+#if PICO_LWIP_VLAN
+#define ETHARP_SUPPORT_VLAN             1
+#define LWIP_HOOK_FILENAME              "lwip_hooks.h"
+#define LWIP_HOOK_VLAN_SET(netif, p, src, dst, eth_type) \
+                                        netif_rmii_ethernet_vlan_set(netif, p, src, dst, eth_type)
+#define LWIP_HOOK_VLAN_CHECK(netif, eth_hdr, vlan_hdr) \
+                                        netif_rmii_ethernet_vlan_check(netif, eth_hdr, vlan_hdr)
+#endif
+
+/* the route hook of lwip_uplink.c, which keeps the flows of an uplink whose link is down
+   going on another one. Set per target by the firmware that builds lwip_uplink.c, the
+   dual_uplink example of pico-w5100s-loopback */
+#ifndef LWIP_UPLINK
+#define LWIP_UPLINK                     0
+#endif
+#if LWIP_UPLINK
+#define LWIP_HOOK_FILENAME              "lwip_hooks.h"
+#define LWIP_HOOK_IP4_ROUTE_SRC(src, dest) \
+                                        lwip_uplink_route(src, dest)
+#endif
+
+/* the RMII driver's CPU accounting (PICO_RMII_ETHERNET_CPU_STATS) counts the time in the
+   application's TCP, UDP and raw callbacks apart from lwIP's: lwIP calls them through
+   LWIP_APP_CALLBACK(), a change to lib/lwip (opt.h, tcp_priv.h, udp.c, raw.c) */
+#if PICO_RMII_ETHERNET_CPU_STATS
+#define LWIP_APP_CALLBACK(call)         do { \
+                                          unsigned lwip_app_prev = netif_rmii_ethernet_cpu_app_enter(); \
+                                          call; \
+                                          netif_rmii_ethernet_cpu_leave(lwip_app_prev); \
+                                        } while (0)
+unsigned netif_rmii_ethernet_cpu_app_enter(void);
+void netif_rmii_ethernet_cpu_leave(unsigned prev);
+#endif
+
+/* IP fragments are copied into IP_REASS_CONTIGUOUS_BUFS preallocated buffers (set per
+   profile, none in low_mem) of 8 KB of UDP payload each, at their offset, and their
+   pool pbufs go straight back to RX. With every buffer taken, a datagram that has had
+   no fragment for IP_REASS_EARLY_DROP_MS has lost one and makes room, otherwise the new
+   datagram is dropped. PICO_LWIP_REASS_CONTIGUOUS=OFF in CMake goes back to lwIP's pbuf
+   chains, IP_REASS_MAX_PBUFS of them out of the pool */
+#ifndef IP_REASS_CONTIGUOUS
+#ifdef IP_REASS_CONTIGUOUS_BUFS
+#define IP_REASS_CONTIGUOUS             1
+#else
+#define IP_REASS_CONTIGUOUS             0
+#endif
+#endif
+
+/* mDNS, PICO_LWIP_MDNS in CMake: lwIP's responder (lib/lwip/src/apps/mdns) answers for
+   the host name and services an example registers. A response is kept as it was
+   serialised, one per service and one for the host, and sent again as a copy until the
+   responder restarts or an address changes (the netif ext_callback announces then). The
+   same response is multicast once a second at most, RFC 6762 section 6: a room of
+   browsers polling gets one answer each second. IPv4 multicast needs IGMP, and the
+   driver's RX filter then only takes the groups joined */
+#ifndef LWIP_MDNS_RESPONDER
+#define LWIP_MDNS_RESPONDER             0
+#endif
+#if LWIP_MDNS_RESPONDER
+#define LWIP_IGMP                       1
+#define LWIP_NETIF_EXT_STATUS_CALLBACK  1
+#define MDNS_MAX_SERVICES               2
+#ifndef MDNS_RESP_CACHE
+#define MDNS_RESP_CACHE                 1
+#endif
+#define MDNS_RESP_MCAST_INTERVAL        1000
+#endif
+
+/* PPP over a UART, PICO_LWIP_PPPOS in CMake: lwIP's PPP (lib/lwip/src/netif/ppp) with
+   the UART's bytes moved by DMA in src/lwip/lwip_pppos_rp2040.c, see examples/pppos. PAP
+   and CHAP for the carriers that ask for a login, CHAP's MD5 from lwIP's own polarssl
+   copy. PPP's timers are in LWIP_NUM_SYS_TIMEOUT_INTERNAL */
+#ifndef PPP_SUPPORT
+#define PPP_SUPPORT                     0
+#endif
+#if PPP_SUPPORT
+#define PPPOS_SUPPORT                   1
+#define PAP_SUPPORT                     1
+#define CHAP_SUPPORT                    1
+#endif
+
+/* lwIP sizes the timeouts for its own timers only, the driver's link check and capture
+   export and the examples' reports (telemetry, profile, counters) need theirs too, and
+   mDNS its probes */
+#ifndef MEMP_NUM_SYS_TIMEOUT
+#define MEMP_NUM_SYS_TIMEOUT            (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 5 + LWIP_MDNS_RESPONDER)
+#endif
+
+/* bridgeif keeps a port's bridge in the netif's client data, see examples/bridge, and
+   mDNS its host */
+#ifndef LWIP_NUM_NETIF_CLIENT_DATA
+#define LWIP_NUM_NETIF_CLIENT_DATA      (1 + LWIP_MDNS_RESPONDER)
+#endif
+
+/* as many segments as the send queue can hold, with the stock lwIP sizing rule */
+#define TCP_SND_QUEUELEN                ((4 * (TCP_SND_BUF) + (TCP_MSS - 1)) / (TCP_MSS))
+#define MEMP_NUM_TCP_SEG                TCP_SND_QUEUELEN
+
+/* tcp_write() with TCP_WRITE_FLAG_COPY allocates a full MSS for the last segment and
+   copies the writes that follow into it until that segment is sent, so small writes
+   share one pbuf and one queue entry. lwIP's default, kept explicit for
+   lwip_tcp_writer.c, which holds back tcp_output() to let them */
+#define TCP_OVERSIZE                    TCP_MSS
+
+#if !NO_SYS
+/* the RMII driver task feeds lwIP holding the core lock instead of posting every
+   frame to the tcpip thread's mailbox */
+#define LWIP_TCPIP_CORE_LOCKING         1
+#define TCPIP_THREAD_NAME               "tcpip"
+#define TCPIP_THREAD_STACKSIZE          4096
+#define TCPIP_THREAD_PRIO               3
+#define TCPIP_MBOX_SIZE                 16
+#define DEFAULT_THREAD_STACKSIZE        2048
+#define DEFAULT_RAW_RECVMBOX_SIZE       8
+#define DEFAULT_UDP_RECVMBOX_SIZE       8
+#define DEFAULT_TCP_RECVMBOX_SIZE       8
+#define DEFAULT_ACCEPTMBOX_SIZE         8
+#define MEMP_NUM_NETCONN                (MEMP_NUM_TCP_PCB + 4)
+#define LWIP_SO_RCVTIMEO                1
+/* newlib has struct timeval */
+#define LWIP_TIMEVAL_PRIVATE            0
+#endif
+
+/* the RMII driver adds its frame, error and drop counts to LINK_STATS (on by default),
+   MIB2_STATS also keeps the netif's ifTable counters for lwIP's snmp app */
+#ifndef MIB2_STATS
+#define MIB2_STATS                      0
+#endif
+
+/* heap and pool use, high-water marks and failed allocations (lwIP's defaults), read
+   by lwip_telemetry.c to size MEM_SIZE and the pools */
+#ifndef MEM_STATS
+#define MEM_STATS                       1
+#endif
+#ifndef MEMP_STATS
+#define MEMP_STATS                      1
+#endif
 
 #define LWIP_HTTPD_CGI                  0
 #define LWIP_HTTPD_SSI                  0
 #define LWIP_HTTPD_SSI_INCLUDE_TAG      0
+/* headers come with the files, precomputed by tools/makefsdata.py, so httpd sends
+   the header and the data by reference instead of copying generated headers */
+#define LWIP_HTTPD_DYNAMIC_HEADERS      0
+/* a GET with "Upgrade: websocket" stays open for the frames the firmware pushes,
+   framed by websocket/ of the repository root */
+#define LWIP_HTTPD_WEBSOCKET            1
+/* POST bodies go to flash as they come, src/lwip/lwip_post_flash.c implements the hooks
+   and opens the window itself as the flash takes the bytes */
+#define LWIP_HTTPD_SUPPORT_POST         1
+#define LWIP_HTTPD_POST_MANUAL_WND      1
+/* /metrics is a custom file, src/lwip/lwip_metrics.c renders it as httpd reads it into
+   the buffer it sends from. The files of fsdata are still sent by reference */
+#define LWIP_HTTPD_CUSTOM_FILES         1
+#define LWIP_HTTPD_DYNAMIC_FILE_READ    1
+
+/* the MQTT client publishes QoS 0 payloads by reference with mqtt_publish_ref(), and
+   mqtt_output_hold()/mqtt_output_flush() send a run of publishes with one tcp_output().
+   The references follow the tcp_pcb, so not over altcp (PICO_LWIP_TLS) */
+#define MQTT_PUBLISH_REF                (!LWIP_ALTCP)
+#define MQTT_OUTPUT_BATCH               1
+
+/* the TFTP server takes blksize and windowsize and lets lwip_ota.c hold back an ACK
+   while the flash catches up, see examples/ota */
+#define TFTP_OPTIONS                    1
+
+/* altcp_tls over lib/lwip's mbedTLS glue (-DPICO_LWIP_TLS=ON in CMake, mbedTLS built as
+   src/lwip/mbedtls_config.h). A server keeps the sessions of its last 4 clients for
+   an hour and gives clients tickets for a day, a client config offers its last
+   session to its next connection, so a reconnect resumes instead of running ECDHE
+   and ECDSA again. mbedTLS allocates from a 32 KB static buffer instead of the heap.
+   -DPICO_LWIP_TLS_OFFLOAD=ON runs handshakes on the other core, see
+   src/lwip/altcp_tls_rp2040.h */
+#ifndef PICO_LWIP_TLS
+#define PICO_LWIP_TLS                   0
+#endif
+#ifndef PICO_LWIP_TLS_OFFLOAD
+#define PICO_LWIP_TLS_OFFLOAD           0
+#endif
+
+#if PICO_LWIP_TLS
+#define LWIP_ALTCP                      1
+#define LWIP_ALTCP_TLS                  1
+#define LWIP_ALTCP_TLS_MBEDTLS          1
+#define ALTCP_MBEDTLS_RNG_FN            mbedtls_entropy_func
+#define ALTCP_MBEDTLS_SESSION_CACHE_TIMEOUT_SECONDS   (60 * 60)
+#define ALTCP_MBEDTLS_SESSION_CACHE_SIZE              4
+#define ALTCP_MBEDTLS_USE_SESSION_TICKETS             1
+#define ALTCP_MBEDTLS_SESSION_TICKET_CIPHER           MBEDTLS_CIPHER_AES_128_GCM
+#define ALTCP_MBEDTLS_SESSION_TICKET_TIMEOUT_SECONDS  (60 * 60 * 24)
+#define ALTCP_MBEDTLS_CLIENT_SESSION_REUSE            1
+#define ALTCP_MBEDTLS_MEM_STATIC_SIZE                 (32 * 1024)
+#define ALTCP_MBEDTLS_HANDSHAKE_OFFLOAD               PICO_LWIP_TLS_OFFLOAD
+#endif
 
 #if 0
 #define LWIP_DEBUG 1
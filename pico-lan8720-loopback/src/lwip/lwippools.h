@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* No include guard: memp_std.h includes this once per expansion of LWIP_MEMPOOL.
+   The pools behind mem_malloc() with PICO_LWIP_MEM_ALLOCATOR_POOLS, smallest first:
+   TCP ACKs and the apps' state, the 512 byte echo and DHCP messages, and full TCP_MSS
+   segments of tcp_write() (a pbuf, the Ethernet, IPv6 and TCP headers and 1460 bytes,
+   with 64-bit pointers on the host). The counts come from the peaks of the host's
+   lwip_perf_<profile>_pools: a TCP sender holds TCP_SND_BUF / TCP_MSS segments (2, 4,
+   8 and 6 with high_loss) and an echo two replies and two ACKs. The segment pool takes
+   two senders at once, three with throughput and one and a half with high_loss, whose
+   heap is balanced's, so each profile spends about its MEM_SIZE */
+#if PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_POOLS
+LWIP_MALLOC_MEMPOOL_START
+#if PICO_LWIP_PROFILE == PICO_LWIP_PROFILE_LOW_MEM
+LWIP_MALLOC_MEMPOOL(6, 128)
+LWIP_MALLOC_MEMPOOL(2, 640)
+LWIP_MALLOC_MEMPOOL(4, 1568)
+#elif PICO_LWIP_PROFILE == PICO_LWIP_PROFILE_HIGH_LOSS
+LWIP_MALLOC_MEMPOOL(6, 128)
+LWIP_MALLOC_MEMPOOL(2, 640)
+LWIP_MALLOC_MEMPOOL(9, 1568)
+#elif PICO_LWIP_PROFILE == PICO_LWIP_PROFILE_THROUGHPUT
+LWIP_MALLOC_MEMPOOL(16, 128)
+LWIP_MALLOC_MEMPOOL(12, 640)
+LWIP_MALLOC_MEMPOOL(24, 1568)
+#else
+LWIP_MALLOC_MEMPOOL(8, 128)
+LWIP_MALLOC_MEMPOOL(4, 640)
+LWIP_MALLOC_MEMPOOL(8, 1568)
+#endif
+LWIP_MALLOC_MEMPOOL_END
+#endif
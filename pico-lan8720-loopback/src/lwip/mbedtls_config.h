@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBEDTLS_CONFIG_H
+#define MBEDTLS_CONFIG_H
+
+/* mbedTLS 2.28 (the pico-sdk's lib/mbedtls) for altcp_tls with -DPICO_LWIP_TLS=ON, as
+   MBEDTLS_CONFIG_FILE. TLS 1.2 with ECDHE-ECDSA on P-256 and AES-128-GCM only: the
+   cheapest full handshake on the M0+ (no RSA private key math, one curve with its
+   NIST fast reduction) and a small build. A peer with an RSA certificate needs
+   MBEDTLS_RSA_C, MBEDTLS_PKCS1_V15 and MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED here.
+
+   Resumption, by session ID from the server's cache and by session ticket, turns a
+   reconnect into an abbreviated handshake: no key exchange and no certificate,
+   hashes and AES only. mbedTLS allocates from lwIP's static buffer
+   (ALTCP_MBEDTLS_MEM_STATIC_SIZE), never from malloc */
+
+/* time for the session cache and ticket lifetimes, from the SDK's gettimeofday().
+   Without MBEDTLS_HAVE_TIME_DATE certificate dates aren't checked */
+#define MBEDTLS_HAVE_TIME
+
+/* memory */
+#define MBEDTLS_PLATFORM_C
+#define MBEDTLS_PLATFORM_MEMORY
+#define MBEDTLS_MEMORY_BUFFER_ALLOC_C
+
+/* entropy from mbedtls_hardware_poll() of the SDK's pico_mbedtls */
+#define MBEDTLS_NO_PLATFORM_ENTROPY
+#define MBEDTLS_ENTROPY_HARDWARE_ALT
+#define MBEDTLS_ENTROPY_C
+#define MBEDTLS_ENTROPY_FORCE_SHA256
+#define MBEDTLS_CTR_DRBG_C
+
+/* symmetric and hashes */
+#define MBEDTLS_AES_C
+#define MBEDTLS_AES_FEWER_TABLES
+#define MBEDTLS_GCM_C
+#define MBEDTLS_CIPHER_C
+#define MBEDTLS_MD_C
+#define MBEDTLS_SHA256_C
+
+/* public key */
+#define MBEDTLS_BIGNUM_C
+#define MBEDTLS_ECP_C
+#define MBEDTLS_ECP_DP_SECP256R1_ENABLED
+#define MBEDTLS_ECP_NIST_OPTIM
+#define MBEDTLS_ECP_WINDOW_SIZE         4
+#define MBEDTLS_ECDH_C
+#define MBEDTLS_ECDSA_C
+#define MBEDTLS_ASN1_PARSE_C
+#define MBEDTLS_ASN1_WRITE_C
+#define MBEDTLS_OID_C
+#define MBEDTLS_PK_C
+#define MBEDTLS_PK_PARSE_C
+#define MBEDTLS_BASE64_C
+#define MBEDTLS_PEM_PARSE_C
+#define MBEDTLS_X509_USE_C
+#define MBEDTLS_X509_CRT_PARSE_C
+
+/* TLS */
+#define MBEDTLS_SSL_TLS_C
+#define MBEDTLS_SSL_CLI_C
+#define MBEDTLS_SSL_SRV_C
+#define MBEDTLS_SSL_PROTO_TLS1_2
+#define MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED
+#define MBEDTLS_SSL_SERVER_NAME_INDICATION
+#define MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+#define MBEDTLS_SSL_CIPHERSUITES        MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256
+
+/* resumption: the server's session ID cache and session tickets */
+#define MBEDTLS_SSL_CACHE_C
+#define MBEDTLS_SSL_SESSION_TICKETS
+#define MBEDTLS_SSL_TICKET_C
+
+/* 4 KB records in, 2 KB out: a peer must keep to 4 KB, by max_fragment_length or by
+   configuration */
+#define MBEDTLS_SSL_MAX_CONTENT_LEN     4096
+#define MBEDTLS_SSL_OUT_CONTENT_LEN     2048
+
+#if PICO_LWIP_TLS_OFFLOAD
+/* handshakes on the other core share the RNG, the caches and the heap, see
+   src/lwip/altcp_tls_rp2040.h */
+#define MBEDTLS_THREADING_C
+#define MBEDTLS_THREADING_ALT
+#endif
+
+#include "mbedtls/check_config.h"
+
+#endif
@@ -4,27 +4,89 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include "hardware/sync.h"
+
 #include "pico/mutex.h"
 #include "pico/stdlib.h"
 
+#include "timebase.h"
+
 #include "lwip/init.h"
+#include "lwip/sys.h"
+
+#if PICO_LWIP_SYS_ARCH_MUTEX
 
 auto_init_mutex(lwip_mutex);
 
 /* lwip has provision for using a mutex, when applicable */
-sys_prot_t sys_arch_protect(void) {
+sys_prot_t sys_arch_protect_lock(unsigned lock) {
+    (void) lock;
+
     mutex_enter_blocking(&lwip_mutex);
 
     return 0;
 }
 
-void sys_arch_unprotect(sys_prot_t pval) {
+void sys_arch_unprotect_lock(unsigned lock, sys_prot_t pval) {
+    (void) lock;
     (void) pval;
 
     mutex_exit(&lwip_mutex);
 }
 
-/* lwip needs a millisecond time source, and the TinyUSB board support code has one available */
+#else
+
+/* hardware spin locks with interrupts masked, usable from IRQs and from either core,
+   nesting on the same core is counted since lwip may re-enter a protected section */
+static volatile int lwip_lock_owner[SYS_ARCH_LOCK_COUNT] = { -1, -1 };
+static uint lwip_lock_depth[SYS_ARCH_LOCK_COUNT];
+
+static spin_lock_t *sys_arch_spin_lock(unsigned lock) {
+    return spin_lock_instance(lock == SYS_ARCH_LOCK_POOL ? PICO_SPINLOCK_ID_OS2 : PICO_SPINLOCK_ID_OS1);
+}
+
+sys_prot_t sys_arch_protect_lock(unsigned lock) {
+    uint32_t save = save_and_disable_interrupts();
+    int core = get_core_num();
+
+    if (lwip_lock_owner[lock] != core) {
+        spin_lock_unsafe_blocking(sys_arch_spin_lock(lock));
+
+        lwip_lock_owner[lock] = core;
+    }
+
+    lwip_lock_depth[lock]++;
+
+    return save;
+}
+
+void sys_arch_unprotect_lock(unsigned lock, sys_prot_t pval) {
+    if (--lwip_lock_depth[lock] == 0) {
+        lwip_lock_owner[lock] = -1;
+
+        spin_unlock_unsafe(sys_arch_spin_lock(lock));
+    }
+
+    restore_interrupts(pval);
+}
+
+#endif
+
+sys_prot_t sys_arch_protect(void) {
+    return sys_arch_protect_lock(SYS_ARCH_LOCK_CORE);
+}
+
+void sys_arch_unprotect(sys_prot_t pval) {
+    sys_arch_unprotect_lock(SYS_ARCH_LOCK_CORE, pval);
+}
+
+/* lwip needs a millisecond time source, timebase_ms() counts them without a 64-bit divide */
 uint32_t sys_now(void) {
-    return to_ms_since_boot(get_absolute_time());
+    return timebase_ms();
+}
+
+/* PPP's magic numbers are seeded from it, the microsecond timer's low bits vary more
+   between boots than milliseconds do */
+uint32_t sys_jiffies(void) {
+    return time_us_32();
 }
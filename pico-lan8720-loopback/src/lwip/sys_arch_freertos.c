@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* lwip NO_SYS=0 port on FreeRTOS (SMP), used instead of sys_arch.c when building
+   with PICO_LWIP_FREERTOS */
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "task.h"
+
+#include "lwip/opt.h"
+#include "lwip/stats.h"
+#include "lwip/sys.h"
+
+#if NO_SYS
+#error "sys_arch_freertos.c is for NO_SYS=0 builds"
+#endif
+
+void sys_init(void) {
+}
+
+u32_t sys_now(void) {
+    return (u32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+/* FreeRTOS' critical sections already take the OS1/OS2 hardware spin locks across both
+   cores, so they replace the NO_SYS spin locks, the lock split isn't needed here */
+sys_prot_t sys_arch_protect_lock(unsigned lock) {
+    (void) lock;
+
+    taskENTER_CRITICAL();
+
+    return 0;
+}
+
+void sys_arch_unprotect_lock(unsigned lock, sys_prot_t pval) {
+    (void) lock;
+    (void) pval;
+
+    taskEXIT_CRITICAL();
+}
+
+sys_prot_t sys_arch_protect(void) {
+    return sys_arch_protect_lock(SYS_ARCH_LOCK_CORE);
+}
+
+void sys_arch_unprotect(sys_prot_t pval) {
+    sys_arch_unprotect_lock(SYS_ARCH_LOCK_CORE, pval);
+}
+
+/* lwip's timeouts are in ms, 0 waits forever */
+static TickType_t sys_arch_ticks(u32_t timeout) {
+    if (timeout == 0) {
+        return portMAX_DELAY;
+    }
+
+    TickType_t ticks = pdMS_TO_TICKS(timeout);
+
+    return ticks ? ticks : 1;
+}
+
+/* ms spent waiting, or SYS_ARCH_TIMEOUT */
+static u32_t sys_arch_waited(TickType_t start, BaseType_t got) {
+    if (got != pdTRUE) {
+        return SYS_ARCH_TIMEOUT;
+    }
+
+    return (u32_t)((xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+}
+
+err_t sys_sem_new(sys_sem_t *sem, u8_t count) {
+    *sem = xSemaphoreCreateBinary();
+
+    if (*sem == NULL) {
+        SYS_STATS_INC(sem.err);
+        return ERR_MEM;
+    }
+
+    SYS_STATS_INC_USED(sem);
+
+    if (count) {
+        xSemaphoreGive(*sem);
+    }
+
+    return ERR_OK;
+}
+
+void sys_sem_free(sys_sem_t *sem) {
+    SYS_STATS_DEC(sem.used);
+
+    vSemaphoreDelete(*sem);
+    *sem = NULL;
+}
+
+void sys_sem_signal(sys_sem_t *sem) {
+    xSemaphoreGive(*sem);
+}
+
+u32_t sys_arch_sem_wait(sys_sem_t *sem, u32_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+
+    return sys_arch_waited(start, xSemaphoreTake(*sem, sys_arch_ticks(timeout)));
+}
+
+err_t sys_mutex_new(sys_mutex_t *mutex) {
+    *mutex = xSemaphoreCreateRecursiveMutex();
+
+    if (*mutex == NULL) {
+        SYS_STATS_INC(mutex.err);
+        return ERR_MEM;
+    }
+
+    SYS_STATS_INC_USED(mutex);
+
+    return ERR_OK;
+}
+
+void sys_mutex_free(sys_mutex_t *mutex) {
+    SYS_STATS_DEC(mutex.used);
+
+    vSemaphoreDelete(*mutex);
+    *mutex = NULL;
+}
+
+/* recursive, so code already holding LOCK_TCPIP_CORE() can call into lwip's locked APIs */
+void sys_mutex_lock(sys_mutex_t *mutex) {
+    xSemaphoreTakeRecursive(*mutex, portMAX_DELAY);
+}
+
+void sys_mutex_unlock(sys_mutex_t *mutex) {
+    xSemaphoreGiveRecursive(*mutex);
+}
+
+err_t sys_mbox_new(sys_mbox_t *mbox, int size) {
+    *mbox = xQueueCreate(size, sizeof(void *));
+
+    if (*mbox == NULL) {
+        SYS_STATS_INC(mbox.err);
+        return ERR_MEM;
+    }
+
+    SYS_STATS_INC_USED(mbox);
+
+    return ERR_OK;
+}
+
+void sys_mbox_free(sys_mbox_t *mbox) {
+    SYS_STATS_DEC(mbox.used);
+
+    vQueueDelete(*mbox);
+    *mbox = NULL;
+}
+
+void sys_mbox_post(sys_mbox_t *mbox, void *msg) {
+    xQueueSendToBack(*mbox, &msg, portMAX_DELAY);
+}
+
+err_t sys_mbox_trypost(sys_mbox_t *mbox, void *msg) {
+    if (xQueueSendToBack(*mbox, &msg, 0) != pdTRUE) {
+        SYS_STATS_INC(mbox.err);
+        return ERR_MEM;
+    }
+
+    return ERR_OK;
+}
+
+err_t sys_mbox_trypost_fromisr(sys_mbox_t *mbox, void *msg) {
+    BaseType_t woken = pdFALSE;
+
+    if (xQueueSendToBackFromISR(*mbox, &msg, &woken) != pdTRUE) {
+        SYS_STATS_INC(mbox.err);
+        return ERR_MEM;
+    }
+
+    portYIELD_FROM_ISR(woken);
+
+    return ERR_OK;
+}
+
+u32_t sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout) {
+    void *dummy;
+    TickType_t start = xTaskGetTickCount();
+
+    return sys_arch_waited(start, xQueueReceive(*mbox, msg != NULL ? msg : &dummy, sys_arch_ticks(timeout)));
+}
+
+u32_t sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg) {
+    void *dummy;
+
+    if (xQueueReceive(*mbox, msg != NULL ? msg : &dummy, 0) != pdTRUE) {
+        return SYS_MBOX_EMPTY;
+    }
+
+    return 0;
+}
+
+/* stacksize is in bytes, as lwip's *_THREAD_STACKSIZE options are */
+sys_thread_t sys_thread_new(const char *name, lwip_thread_fn thread, void *arg, int stacksize, int prio) {
+    TaskHandle_t task;
+
+    if (xTaskCreate(thread, name, stacksize / sizeof(StackType_t), arg, prio, &task) != pdPASS) {
+        LWIP_ASSERT("sys_thread_new failed", 0);
+        return NULL;
+    }
+
+    return task;
+}
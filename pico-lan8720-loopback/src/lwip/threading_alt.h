@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef THREADING_ALT_H
+#define THREADING_ALT_H
+
+#include "pico/mutex.h"
+
+/* mbedTLS's mutex with MBEDTLS_THREADING_ALT (-DPICO_LWIP_TLS_OFFLOAD=ON), a pico mutex
+   either core can take, see src/lwip/altcp_tls_rp2040.c */
+typedef struct {
+  mutex_t mutex;
+} mbedtls_threading_mutex_t;
+
+#endif
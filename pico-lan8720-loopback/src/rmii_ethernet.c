@@ -6,433 +6,5218 @@
 
 #include <string.h>
 
+#include "hardware/clocks.h"
 #include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/structs/clocks.h"
+#include "hardware/structs/scb.h"
 
+#include "pico/multicore.h"
 #include "pico/stdlib.h"
 #include "pico/unique_id.h"
 
+#include "timebase.h"
+
 #include "lwip/etharp.h"
+#include "lwip/ethip6.h"
 #include "lwip/netif.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/iana.h"
+#include "lwip/prot/icmp.h"
+#include "lwip/prot/ip.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/ip6.h"
+#include "lwip/prot/udp.h"
+#include "lwip/snmp.h"
+#include "lwip/stats.h"
+#include "lwip/sys.h"
+#include "lwip/tcp.h"
 #include "lwip/timeouts.h"
 
-#include "rmii_ethernet_phy_rx.pio.h"
-#include "rmii_ethernet_phy_tx.pio.h"
+#if !NO_SYS
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/tcpip.h"
+
+#if PICO_RMII_ETHERNET_DUAL_CORE
+#error "PICO_RMII_ETHERNET_DUAL_CORE is for NO_SYS builds, with an OS run netif_rmii_ethernet_loop() in its own task"
+#endif
+#endif
+
+#include "rmii_ethernet_phy_rx.pio.h"
+#include "rmii_ethernet_phy_tx.pio.h"
+#include "rmii_ethernet_mdio.pio.h"
+#include "rmii_ethernet_timestamp.pio.h"
+
+#include "rmii_ethernet/netif.h"
+
+#include "rmii_ethernet_capture.h"
+#include "rmii_ethernet_crc.h"
+#include "rmii_ethernet_frame.h"
+#include "rmii_ethernet_profile.h"
+
+#if PICO_RMII_ETHERNET_TRACE
+#include "trace.h"
+#define RMII_ETHERNET_TRACE(id, arg0, arg1, arg2) TRACE(TRACE_##id, arg0, arg1, arg2)
+#else
+#define RMII_ETHERNET_TRACE(id, arg0, arg1, arg2) ((void)0)
+#endif
+
+#if NO_SYS
+#include "lwip_timeouts.h"
+#endif
+
+#if PICO_RMII_ETHERNET_LRO
+#include "lwip_lro.h"
+#endif
+
+#if PICO_LWIP_VLAN
+#include "lwip_hooks.h"
+#endif
+
+#if PICO_LWIP_ARENA_SIZE
+#include "lwip_arena.h"
+#endif
+
+// one interface on a PIO block, state machines and pins fixed at build time by the
+// PICO_RMII_ETHERNET_FIXED_* below: the PIO registers, FIFO addresses and DREQs are then
+// constants folded into the code rather than loads through eth->config, and
+// netif_rmii_ethernet_init() refuses any other config with ERR_ARG
+#ifndef PICO_RMII_ETHERNET_FIXED_CONFIG
+#define PICO_RMII_ETHERNET_FIXED_CONFIG 0
+#endif
+
+// the PIO block's index, and the first pins, defaults of NETIF_RMII_ETHERNET_DEFAULT_CONFIG()
+#ifndef PICO_RMII_ETHERNET_FIXED_PIO
+#define PICO_RMII_ETHERNET_FIXED_PIO 0
+#endif
+
+#ifndef PICO_RMII_ETHERNET_FIXED_SM_START
+#define PICO_RMII_ETHERNET_FIXED_SM_START 0
+#endif
+
+#ifndef PICO_RMII_ETHERNET_FIXED_RX_PIN
+#define PICO_RMII_ETHERNET_FIXED_RX_PIN 6
+#endif
+
+#ifndef PICO_RMII_ETHERNET_FIXED_TX_PIN
+#define PICO_RMII_ETHERNET_FIXED_TX_PIN 10
+#endif
+
+#ifndef PICO_RMII_ETHERNET_FIXED_MDIO_PIN
+#define PICO_RMII_ETHERNET_FIXED_MDIO_PIN 14
+#endif
+
+#if PICO_RMII_ETHERNET_FIXED_CONFIG
+// the PIO blocks are 1 MB apart on both chips
+#define PICO_RMII_ETHERNET_PIO      ((PIO)(PIO0_BASE + PICO_RMII_ETHERNET_FIXED_PIO * (PIO1_BASE - PIO0_BASE)))
+#define PICO_RMII_ETHERNET_SM_RX    (PICO_RMII_ETHERNET_FIXED_SM_START)
+#define PICO_RMII_ETHERNET_SM_TX    (PICO_RMII_ETHERNET_FIXED_SM_START + 1)
+#define PICO_RMII_ETHERNET_SM_MDIO  (PICO_RMII_ETHERNET_FIXED_SM_START + 2)
+#define PICO_RMII_ETHERNET_SM_TIMESTAMP (PICO_RMII_ETHERNET_FIXED_SM_START + 3)
+#define PICO_RMII_ETHERNET_RX_PIN   (PICO_RMII_ETHERNET_FIXED_RX_PIN)
+#define PICO_RMII_ETHERNET_TX_PIN   (PICO_RMII_ETHERNET_FIXED_TX_PIN)
+#define PICO_RMII_ETHERNET_MDIO_PIN (PICO_RMII_ETHERNET_FIXED_MDIO_PIN)
+#define PICO_RMII_ETHERNET_MDC_PIN  (PICO_RMII_ETHERNET_FIXED_MDIO_PIN + 1)
+#define PICO_RMII_ETHERNET_RX_FIFO  (&PICO_RMII_ETHERNET_PIO->rxf[PICO_RMII_ETHERNET_SM_RX])
+#define PICO_RMII_ETHERNET_TX_FIFO  (&PICO_RMII_ETHERNET_PIO->txf[PICO_RMII_ETHERNET_SM_TX])
+#else
+// of the interface eth points to
+#define PICO_RMII_ETHERNET_PIO      (eth->config.pio)
+#define PICO_RMII_ETHERNET_SM_RX    (eth->config.pio_sm_start)
+#define PICO_RMII_ETHERNET_SM_TX    (eth->config.pio_sm_start + 1)
+#define PICO_RMII_ETHERNET_SM_MDIO  (eth->config.pio_sm_start + 2)
+#define PICO_RMII_ETHERNET_SM_TIMESTAMP (eth->config.pio_sm_start + 3)
+#define PICO_RMII_ETHERNET_RX_PIN   (eth->config.rx_pin_start)
+#define PICO_RMII_ETHERNET_TX_PIN   (eth->config.tx_pin_start)
+#define PICO_RMII_ETHERNET_MDIO_PIN (eth->config.mdio_pin_start)
+#define PICO_RMII_ETHERNET_MDC_PIN  (eth->config.mdio_pin_start + 1)
+// worked out once by netif_rmii_ethernet_init(), they are in every RX and TX DMA set-up
+#define PICO_RMII_ETHERNET_RX_FIFO  (eth->rx_fifo)
+#define PICO_RMII_ETHERNET_TX_FIFO  (eth->tx_fifo)
+#endif
+#define PICO_RMII_ETHERNET_MAC_ADDR (eth->config.mac_addr)
+
+// number of RX frame buffers, must be a power of 2. The RP2350's 520 KB of SRAM affords
+// twice the RP2040's, which rides out longer bursts while lwIP is busy
+#ifndef PICO_RMII_ETHERNET_RX_RING_SIZE
+#if PICO_RP2350
+#define PICO_RMII_ETHERNET_RX_RING_SIZE 8
+#else
+#define PICO_RMII_ETHERNET_RX_RING_SIZE 4
+#endif
+#endif
+
+// DMA received frames straight into pbuf_custom buffers that are handed to lwIP without a copy
+#ifndef PICO_RMII_ETHERNET_RX_ZERO_COPY
+#define PICO_RMII_ETHERNET_RX_ZERO_COPY 0
+#endif
+
+// chain the in-order segments of a TCP flow drained from the RX ring in one poll into one
+// netif->input() call, see src/lwip/lwip_lro.h
+#ifndef PICO_RMII_ETHERNET_LRO
+#define PICO_RMII_ETHERNET_LRO 0
+#endif
+
+// verify the TCP, UDP and ICMP checksums of unfragmented IPv4 frames with a DMA pass of
+// the DMA sniffer summing their halfwords, and pass the ones that are good to lwIP with its
+// own check of them turned off (NETIF_SET_CHECKSUM_CTRL) for that frame
+#ifndef PICO_RMII_ETHERNET_RX_CHKSUM
+#define PICO_RMII_ETHERNET_RX_CHKSUM 0
+#endif
+
+// answer ICMP echo requests to the interface's address from lwIP context, before
+// netif->input(), by turning the request around in its own buffer
+#ifndef PICO_RMII_ETHERNET_ICMP_REFLECT
+#define PICO_RMII_ETHERNET_ICMP_REFLECT 0
+#endif
+
+// answer ARP requests and ICMP echo requests for the interface's address from the driver's
+// FCS check, the core running netif_rmii_ethernet_loop() with PICO_RMII_ETHERNET_DUAL_CORE,
+// however far behind lwIP is. The senders of the ARP requests go on to lwIP's ARP table
+#ifndef PICO_RMII_ETHERNET_RESPONDER
+#define PICO_RMII_ETHERNET_RESPONDER 0
+#endif
+
+// replies the responder can have waiting for the TX DMA (power of 2), a request coming in
+// while all of them are goes to lwIP
+#ifndef PICO_RMII_ETHERNET_RESPONDER_SLOTS
+#define PICO_RMII_ETHERNET_RESPONDER_SLOTS 2
+#endif
+
+// longest echo request the responder answers, without FCS, longer ones go to lwIP. The
+// default takes the 56 byte pings of most ping commands and 64 byte ones of the rest
+#ifndef PICO_RMII_ETHERNET_RESPONDER_FRAME_MAX
+#define PICO_RMII_ETHERNET_RESPONDER_FRAME_MAX 128
+#endif
+
+// 802.3x flow control on full duplex links whose partner advertised it: a PAUSE frame asks
+// the partner to stop sending once the RX ring holds PICO_RMII_ETHERNET_PAUSE_HIGH frames
+// lwIP hasn't taken, and one with no pause time lets it go on at PICO_RMII_ETHERNET_PAUSE_LOW.
+// PAUSE frames received hold the TX ring for the time they ask for
+#ifndef PICO_RMII_ETHERNET_PAUSE
+#define PICO_RMII_ETHERNET_PAUSE 0
+#endif
+
+#ifndef PICO_RMII_ETHERNET_PAUSE_HIGH
+#define PICO_RMII_ETHERNET_PAUSE_HIGH (PICO_RMII_ETHERNET_RX_RING_SIZE - 1)
+#endif
+
+#ifndef PICO_RMII_ETHERNET_PAUSE_LOW
+#define PICO_RMII_ETHERNET_PAUSE_LOW (PICO_RMII_ETHERNET_PAUSE_HIGH / 2)
+#endif
+
+// pause time asked for in quanta of 512 bit times, 13 ms at 10 Mbit/s and 1.3 ms at 100.
+// It is asked for again half way through while the ring is still above the low mark
+#ifndef PICO_RMII_ETHERNET_PAUSE_QUANTA
+#define PICO_RMII_ETHERNET_PAUSE_QUANTA 256
+#endif
+
+// zero copy buffers shared by the RX ring and frames still held by lwIP
+#ifndef PICO_RMII_ETHERNET_RX_ZERO_COPY_BUFFERS
+#define PICO_RMII_ETHERNET_RX_ZERO_COPY_BUFFERS (2 * PICO_RMII_ETHERNET_RX_RING_SIZE)
+#endif
+
+// priority frames the callback can be behind on, each with a frame buffer of its own, must
+// be a power of 2
+#ifndef PICO_RMII_ETHERNET_RX_PRIORITY_RING_SIZE
+#define PICO_RMII_ETHERNET_RX_PRIORITY_RING_SIZE 4
+#endif
+
+// sources PICO_RMII_ETHERNET_RX_POLICE keeps a bucket for, must be a power of 2 of at least 2:
+// a source has two it can take, by its hash
+#ifndef PICO_RMII_ETHERNET_RX_POLICE_SOURCES
+#define PICO_RMII_ETHERNET_RX_POLICE_SOURCES 16
+#endif
+
+// the rates, in frames a second, broadcast and multicast frames and each source start at
+// with PICO_RMII_ETHERNET_RX_POLICE, 0 for no limit, and the burst of both
+#ifndef PICO_RMII_ETHERNET_RX_POLICE_BROADCAST_RATE
+#define PICO_RMII_ETHERNET_RX_POLICE_BROADCAST_RATE 1000
+#endif
+
+#ifndef PICO_RMII_ETHERNET_RX_POLICE_SOURCE_RATE
+#define PICO_RMII_ETHERNET_RX_POLICE_SOURCE_RATE 0
+#endif
+
+#ifndef PICO_RMII_ETHERNET_RX_POLICE_BURST
+#define PICO_RMII_ETHERNET_RX_POLICE_BURST 64
+#endif
+
+// pbufs in a chain that are sent straight from their payloads, longer chains are coalesced first
+#ifndef PICO_RMII_ETHERNET_TX_CHAIN_MAX
+#define PICO_RMII_ETHERNET_TX_CHAIN_MAX 8
+#endif
+
+// number of TX frames queued for DMA, must be a power of 2, doubled on the RP2350 like the
+// RX ring
+#ifndef PICO_RMII_ETHERNET_TX_RING_SIZE
+#if PICO_RP2350
+#define PICO_RMII_ETHERNET_TX_RING_SIZE 8
+#else
+#define PICO_RMII_ETHERNET_TX_RING_SIZE 4
+#endif
+#endif
+
+// a second TX ring, sent from ahead of the first: ARP, and IP with a DSCP of
+// PICO_RMII_ETHERNET_TX_PRIORITY_DSCP or more (a VLAN PCP of it >> 3 when tagged), so
+// control traffic doesn't queue behind a backlog of bulk frames
+#ifndef PICO_RMII_ETHERNET_TX_PRIORITY
+#define PICO_RMII_ETHERNET_TX_PRIORITY 0
+#endif
+
+// frames in the priority TX ring, must be a power of 2
+#ifndef PICO_RMII_ETHERNET_TX_PRIORITY_RING_SIZE
+#define PICO_RMII_ETHERNET_TX_PRIORITY_RING_SIZE 2
+#endif
+
+// lowest DSCP sent as priority, CS6 (network control)
+#ifndef PICO_RMII_ETHERNET_TX_PRIORITY_DSCP
+#define PICO_RMII_ETHERNET_TX_PRIORITY_DSCP 48
+#endif
+
+// priority frames sent in a row while bulk frames wait before one of those goes, 0 for
+// strict priority
+#ifndef PICO_RMII_ETHERNET_TX_PRIORITY_WEIGHT
+#define PICO_RMII_ETHERNET_TX_PRIORITY_WEIGHT 0
+#endif
+
+// hand a frame to the DMA before it is built when the TX is idle: at 10 Mbit/s the FCS is
+// computed while the payload streams out, at 100 Mbit/s the frame is encoded ahead of the
+// DMA once PICO_RMII_ETHERNET_TX_CUT_THROUGH_HEAD bytes are. The first bit goes out after
+// the head's build instead of the whole frame's, a frame the build fell behind the DMA on
+// goes out with a bad FCS and is counted in tx_cut_late
+#ifndef PICO_RMII_ETHERNET_TX_CUT_THROUGH
+#define PICO_RMII_ETHERNET_TX_CUT_THROUGH 0
+#endif
+
+// shortest frame sent cut-through, a shorter one is built in about the time of the head
+#ifndef PICO_RMII_ETHERNET_TX_CUT_THROUGH_MIN
+#define PICO_RMII_ETHERNET_TX_CUT_THROUGH_MIN 256
+#endif
+
+// bytes of a frame encoded before the 100 Mbit/s DMA is started on it
+#ifndef PICO_RMII_ETHERNET_TX_CUT_THROUGH_HEAD
+#define PICO_RMII_ETHERNET_TX_CUT_THROUGH_HEAD 128
+#endif
+
+// the alarm of a scheduled frame goes off this long before its time and the interrupt
+// waits out the rest, so the alarm's interrupt latency doesn't show in the frame's start
+#ifndef PICO_RMII_ETHERNET_TX_SCHEDULED_LEAD_US
+#define PICO_RMII_ETHERNET_TX_SCHEDULED_LEAD_US 20
+#endif
+
+// a scheduled frame started more than this after its time counts in tx_scheduled_late
+#ifndef PICO_RMII_ETHERNET_TX_SCHEDULED_LATE_US
+#define PICO_RMII_ETHERNET_TX_SCHEDULED_LATE_US 2
+#endif
+
+// interval of the MDIO link status check, kept out of the frame polling path
+#ifndef PICO_RMII_ETHERNET_LINK_POLL_MS
+#define PICO_RMII_ETHERNET_LINK_POLL_MS 250
+#endif
+
+// the same while the link is down, so a link coming up is reported that much sooner
+#ifndef PICO_RMII_ETHERNET_LINK_POLL_DOWN_MS
+#define PICO_RMII_ETHERNET_LINK_POLL_DOWN_MS 20
+#endif
+
+// longest wait at start-up for the PHY to answer MDIO with its reset done
+#ifndef PICO_RMII_ETHERNET_PHY_READY_MS
+#define PICO_RMII_ETHERNET_PHY_READY_MS 500
+#endif
+
+// build in 100 Mbit/s support: a 1 instruction TX program fed with pre-encoded frames,
+// which costs ~3 KB of RAM per TX ring slot, and 100BASE-TX advertisement
+#ifndef PICO_RMII_ETHERNET_100M
+#define PICO_RMII_ETHERNET_100M 0
+#endif
+
+// let netif_rmii_ethernet_loop() sleep in __wfe() until an RX/TX interrupt or the next lwIP timeout
+#ifndef PICO_RMII_ETHERNET_LOOP_WFE
+#define PICO_RMII_ETHERNET_LOOP_WFE 0
+#endif
+
+// run sys_check_timeouts() from netif_rmii_ethernet_poll() only once a hardware alarm set
+// for the next lwIP timeout has gone off, instead of on every poll (NO_SYS only)
+#ifndef PICO_RMII_ETHERNET_TIMEOUT_ALARM
+#define PICO_RMII_ETHERNET_TIMEOUT_ALARM 0
+#endif
+
+#if PICO_RMII_ETHERNET_TIMEOUT_ALARM && !NO_SYS
+#error "PICO_RMII_ETHERNET_TIMEOUT_ALARM needs NO_SYS, the tcpip thread runs lwIP's timers"
+#endif
+
+// PICO_RMII_ETHERNET_LOOP_WFE's loop polls on without sleeping once frames come in at
+// PICO_RMII_ETHERNET_BUSY_POLL_RATE per second or more, measured over at least
+// PICO_RMII_ETHERNET_BUSY_POLL_WINDOW_US, and goes back to sleeping between interrupts once
+// the RX rings stayed empty for PICO_RMII_ETHERNET_BUSY_POLL_IDLE_US. The CRS_DV interrupt
+// still re-arms RX for every frame, what is saved is the wake-up and the sleep around it
+#ifndef PICO_RMII_ETHERNET_BUSY_POLL
+#define PICO_RMII_ETHERNET_BUSY_POLL 0
+#endif
+
+#ifndef PICO_RMII_ETHERNET_BUSY_POLL_RATE
+#define PICO_RMII_ETHERNET_BUSY_POLL_RATE 2000
+#endif
+
+#ifndef PICO_RMII_ETHERNET_BUSY_POLL_WINDOW_US
+#define PICO_RMII_ETHERNET_BUSY_POLL_WINDOW_US 1000
+#endif
+
+#ifndef PICO_RMII_ETHERNET_BUSY_POLL_IDLE_US
+#define PICO_RMII_ETHERNET_BUSY_POLL_IDLE_US 200
+#endif
+
+// frames of an interface netif_rmii_ethernet_poll() hands to lwIP per call, the rest wait
+// for the next one after TX, MDIO and lwIP's timeouts had their turn. 0 takes all there are
+#ifndef PICO_RMII_ETHERNET_RX_POLL_BUDGET
+#define PICO_RMII_ETHERNET_RX_POLL_BUDGET 0
+#endif
+
+#if PICO_RMII_ETHERNET_BUSY_POLL && (!PICO_RMII_ETHERNET_LOOP_WFE || !NO_SYS || PICO_RMII_ETHERNET_DUAL_CORE)
+#error "PICO_RMII_ETHERNET_BUSY_POLL needs PICO_RMII_ETHERNET_LOOP_WFE, with NO_SYS and without PICO_RMII_ETHERNET_DUAL_CORE"
+#endif
+
+#if PICO_RMII_ETHERNET_CPU_STATS && !NO_SYS
+#error "PICO_RMII_ETHERNET_CPU_STATS needs NO_SYS, FreeRTOS runs other tasks while the driver task blocks"
+#endif
+
+// netif_rmii_ethernet_idle_us(), the time the loop of a single core NO_SYS build slept
+#define RMII_ETHERNET_IDLE_ACCOUNTING (PICO_RMII_ETHERNET_LOOP_WFE && NO_SYS && !PICO_RMII_ETHERNET_DUAL_CORE)
+
+// receive the first 14 bytes of a frame with their own DMA channel, chained to the one
+// for the rest, and run the RX filter from its completion interrupt (DMA_IRQ_1) while
+// the frame is still arriving: a frame for someone else stops there and RX waits for the
+// next one, instead of taking the whole frame and being re-armed at its end
+#ifndef PICO_RMII_ETHERNET_RX_PEEK
+#define PICO_RMII_ETHERNET_RX_PEEK 0
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PEEK && !PICO_RMII_ETHERNET_RX_FILTER
+#error "PICO_RMII_ETHERNET_RX_PEEK needs PICO_RMII_ETHERNET_RX_FILTER"
+#endif
+
+// receive with the RX program pushing 32 bit words and word sized DMA, a bus transfer and
+// FIFO entry per 4 bytes instead of per byte. The last 0 to 3 bytes of a frame are still
+// in the shift register at its end, the CRS_DV interrupt pushes them out itself
+#ifndef PICO_RMII_ETHERNET_RX_WORD
+#define PICO_RMII_ETHERNET_RX_WORD 0
+#endif
+
+#if PICO_RMII_ETHERNET_PAUSE && (PICO_RMII_ETHERNET_PAUSE_LOW >= PICO_RMII_ETHERNET_PAUSE_HIGH || PICO_RMII_ETHERNET_PAUSE_HIGH > PICO_RMII_ETHERNET_RX_RING_SIZE)
+#error "PICO_RMII_ETHERNET_PAUSE needs PICO_RMII_ETHERNET_PAUSE_LOW < PICO_RMII_ETHERNET_PAUSE_HIGH <= PICO_RMII_ETHERNET_RX_RING_SIZE"
+#endif
+
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC && !PICO_RMII_ETHERNET_100M
+#error "PICO_RMII_ETHERNET_REF_CLK_SYNC needs PICO_RMII_ETHERNET_100M, frames are sent encoded for the 100 Mbit/s program"
+#endif
+
+#if PICO_RMII_ETHERNET_INSTANCES < 1 || PICO_RMII_ETHERNET_INSTANCES > NUM_PIOS
+#error "PICO_RMII_ETHERNET_INSTANCES must be 1 to NUM_PIOS, each interface has the RX, TX and MDIO programs of a PIO block"
+#endif
+
+#if PICO_RMII_ETHERNET_FIXED_CONFIG && (PICO_RMII_ETHERNET_INSTANCES != 1 || PICO_RMII_ETHERNET_FIXED_PIO >= NUM_PIOS)
+#error "PICO_RMII_ETHERNET_FIXED_CONFIG is one interface, on PIO block PICO_RMII_ETHERNET_FIXED_PIO"
+#endif
+
+#if PICO_RMII_ETHERNET_TIMESTAMP && PICO_RMII_ETHERNET_REF_CLK_SYNC
+#error "PICO_RMII_ETHERNET_TIMESTAMP needs the PIO instructions the PICO_RMII_ETHERNET_REF_CLK_SYNC programs take"
+#endif
+
+#if PICO_RMII_ETHERNET_WAKE && (!NO_SYS || PICO_RMII_ETHERNET_DUAL_CORE)
+#error "PICO_RMII_ETHERNET_WAKE needs NO_SYS without PICO_RMII_ETHERNET_DUAL_CORE, the core running lwIP is the one that sleeps"
+#endif
+
+#if PICO_RMII_ETHERNET_RX_CHKSUM && PICO_RMII_ETHERNET_CRC == RMII_ETHERNET_CRC_SNIFFER
+#error "PICO_RMII_ETHERNET_RX_CHKSUM needs the DMA sniffer RMII_ETHERNET_CRC_SNIFFER takes for the FCS"
+#endif
+
+#if PICO_RMII_ETHERNET_TX_CUT_THROUGH && (PICO_RMII_ETHERNET_TX_CUT_THROUGH_HEAD == 0 || PICO_RMII_ETHERNET_TX_CUT_THROUGH_HEAD >= PICO_RMII_ETHERNET_TX_CUT_THROUGH_MIN)
+#error "PICO_RMII_ETHERNET_TX_CUT_THROUGH needs 0 < PICO_RMII_ETHERNET_TX_CUT_THROUGH_HEAD < PICO_RMII_ETHERNET_TX_CUT_THROUGH_MIN"
+#endif
+
+#if PICO_RMII_ETHERNET_RX_POLICE && (PICO_RMII_ETHERNET_RX_POLICE_SOURCES < 2 || (PICO_RMII_ETHERNET_RX_POLICE_SOURCES & (PICO_RMII_ETHERNET_RX_POLICE_SOURCES - 1)) != 0)
+#error "PICO_RMII_ETHERNET_RX_POLICE_SOURCES must be a power of 2 of at least 2"
+#endif
+
+#if PICO_RMII_ETHERNET_RX_CHKSUM && PICO_RMII_ETHERNET_LRO
+#error "PICO_RMII_ETHERNET_RX_CHKSUM can't be used with PICO_RMII_ETHERNET_LRO, merged segments reach lwIP after the frame that was checked"
+#endif
+
+#if PICO_RMII_ETHERNET_RESPONDER && ((PICO_RMII_ETHERNET_RESPONDER_SLOTS & (PICO_RMII_ETHERNET_RESPONDER_SLOTS - 1)) != 0 || \
+    PICO_RMII_ETHERNET_RESPONDER_FRAME_MAX < 60 || PICO_RMII_ETHERNET_RESPONDER_FRAME_MAX > 1514)
+#error "PICO_RMII_ETHERNET_RESPONDER needs a power of 2 of PICO_RMII_ETHERNET_RESPONDER_SLOTS and a PICO_RMII_ETHERNET_RESPONDER_FRAME_MAX of 60 to 1514"
+#endif
+
+// clocks left running while netif_rmii_ethernet_loop() sleeps for PICO_RMII_ETHERNET_WAKE:
+// RX (PIO, DMA, SRAM, the bus fabric, IO and pads for the CRS_DV edge), the timer and
+// watchdog tick lwIP's time comes from and the PLL and XOSC clk_sys may run from. XIP,
+// ROM, USB, the UARTs and the rest are gated until an interrupt wakes the core
+#ifndef PICO_RMII_ETHERNET_WAKE_SLEEP_EN0
+#define PICO_RMII_ETHERNET_WAKE_SLEEP_EN0 (CLOCKS_SLEEP_EN0_CLK_SYS_SRAM3_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_SRAM2_BITS | \
+    CLOCKS_SLEEP_EN0_CLK_SYS_SRAM1_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_SRAM0_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PLL_SYS_BITS | \
+    CLOCKS_SLEEP_EN0_CLK_SYS_PIO1_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PIO0_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PADS_BITS | \
+    CLOCKS_SLEEP_EN0_CLK_SYS_IO_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_DMA_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_BUSFABRIC_BITS | \
+    CLOCKS_SLEEP_EN0_CLK_SYS_BUSCTRL_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_CLOCKS_BITS)
+#endif
+
+#ifndef PICO_RMII_ETHERNET_WAKE_SLEEP_EN1
+#define PICO_RMII_ETHERNET_WAKE_SLEEP_EN1 (CLOCKS_SLEEP_EN1_CLK_SYS_XOSC_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_WATCHDOG_BITS | \
+    CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_SRAM5_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_SRAM4_BITS)
+#endif
+
+// slowest clk_sys the REF_CLK programs keep up with at 10 Mbit/s, and at 100 Mbit/s
+#define REF_CLK_SYNC_MIN_HZ 100000000
+#define REF_CLK_SYNC_FAST_MIN_HZ 200000000
+
+#if PICO_RMII_ETHERNET_SRAM_BANKS
+// a buffer the DMA streams frames through, in SRAM3. The section isn't zeroed at boot
+#define RMII_ETHERNET_DMA_BUFFER(name) __attribute__((section(".sram3." #name))) name
+#else
+#define RMII_ETHERNET_DMA_BUFFER(name) name
+#endif
+
+#define RX_RING_MASK (PICO_RMII_ETHERNET_RX_RING_SIZE - 1)
+#define TX_RING_MASK (PICO_RMII_ETHERNET_TX_RING_SIZE - 1)
+#define RX_PRIORITY_MASK (PICO_RMII_ETHERNET_RX_PRIORITY_RING_SIZE - 1)
+#define TX_PRIORITY_MASK (PICO_RMII_ETHERNET_TX_PRIORITY_RING_SIZE - 1)
+#define TX_RESPONDER_MASK (PICO_RMII_ETHERNET_RESPONDER_SLOTS - 1)
+#define RX_FRAME_MAX 1518
+#if PICO_RMII_ETHERNET_RX_WORD
+// a whole number of words, so each buffer of an array of them stays word aligned
+#define RX_FRAME_SIZE 1544
+#else
+#define RX_FRAME_SIZE 1542
+#endif
+
+#if PICO_RMII_ETHERNET_RX_WORD
+// RX DMA transfers are words, from the whole FIFO entry
+#define RX_DMA_SHIFT 2
+#define RX_PUSH_BITS 32
+#define RX_DMA_READ_ADDR ((const volatile void *)PICO_RMII_ETHERNET_RX_FIFO)
+#else
+// RX DMA transfers are bytes, from the top byte of the FIFO entry the shift right put it in
+#define RX_DMA_SHIFT 0
+#define RX_PUSH_BITS 8
+#define RX_DMA_READ_ADDR (((const volatile uint8_t *)PICO_RMII_ETHERNET_RX_FIFO) + 3)
+#endif
+
+// the longest frame in RX DMA transfers, rounded up to a whole one
+#define RX_DMA_MAX ((RX_FRAME_MAX + (1u << RX_DMA_SHIFT) - 1) >> RX_DMA_SHIFT)
+
+#if PICO_RMII_ETHERNET_RX_POLICE
+// a bucket's rate as a virtual scheduler (GCRA): frames conform interval_us apart, and up to
+// tolerance_us early for a burst. An interval of 0 passes everything
+struct rx_police_rate {
+    volatile uint32_t interval_us;
+    volatile uint32_t tolerance_us;
+};
+
+// a source's bucket, key is the IPv4 address in key[1] or the MAC with bit 16 of key[0] set
+struct rx_police_source {
+    uint32_t key[2];
+    uint32_t tat; // the time its next frame conforms at
+};
+#endif
+
+#if PICO_RMII_ETHERNET_RX_FILTER
+// multicast MACs let through, a count of the groups in each bin as a MAC's hash filter keeps
+#define RX_FILTER_HASH_BINS 64
+
+// EtherTypes passed from the start, lwIP's
+static const uint16_t rx_filter_default_types[] = {
+    ETHTYPE_IP,
+    ETHTYPE_ARP,
+#if LWIP_IPV6
+    ETHTYPE_IPV6,
+#endif
+#if ETHARP_SUPPORT_VLAN
+    ETHTYPE_VLAN,
+#endif
+};
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PEEK
+// rx_dma_chan takes the Ethernet header, RX_PEEK_SIZE bytes, then chains to rx_dma_rest_chan.
+// Words take the first 2 bytes after it too
+#if PICO_RMII_ETHERNET_RX_WORD
+#define RX_PEEK_SIZE (SIZEOF_ETH_HDR + 2)
+#else
+#define RX_PEEK_SIZE SIZEOF_ETH_HDR
+#endif
+#define RX_PEEK_DMA (RX_PEEK_SIZE >> RX_DMA_SHIFT)
+#endif
+
+#if PICO_RMII_ETHERNET_PAUSE
+// MAC control frames: PAUSE frames go to a reserved multicast MAC, with an opcode and the
+// pause time in quanta after the EtherType, padded to the minimum by the TX build
+static const uint8_t pause_mac[ETH_HWADDR_LEN] = { 0x01, 0x80, 0xc2, 0x00, 0x00, 0x01 };
+
+#define ETHTYPE_MAC_CONTROL 0x8808
+#define MAC_CONTROL_PAUSE 0x0001
+#define PAUSE_FRAME_SIZE (SIZEOF_ETH_HDR + 4)
+
+// a PAUSE frame pre-encoded for 100 Mbit/s: preamble and SFD, 60 bytes, FCS and gap
+#define PAUSE_FAST_WORDS ((8 + 60 + 4 + 1) / 2 + 6)
+#endif
+
+#if PICO_RMII_ETHERNET_RESPONDER
+// an ARP reply without padding, and a reply of the responder pre-encoded for 100 Mbit/s:
+// preamble and SFD, the padded frame, FCS and gap
+#define RESPONDER_ARP_SIZE (SIZEOF_ETH_HDR + SIZEOF_ETHARP_HDR)
+#define RESPONDER_FAST_WORDS ((8 + LWIP_MAX(PICO_RMII_ETHERNET_RESPONDER_FRAME_MAX, 60) + 4 + 1) / 2 + 6)
+
+// what the driver did with a frame of the RX ring before lwIP gets it
+enum rx_responded {
+    RX_RESPONDED_NONE,
+    RX_RESPONDED_ARP,  // a request for the netif's address, answered, its sender for etharp
+    RX_RESPONDED_ECHO, // an echo request, answered
+};
+#endif
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+// an armed TX frame gives up after this, the longest frame is out in 1.2 ms at 10 Mbit/s
+#define TIMESTAMP_TX_TIMEOUT_MS 20
+
+// the edge the timestamp SM pushes counts for
+enum timestamp_state {
+    TIMESTAMP_RX,       // CRS_DV, taken by the CRS_DV IRQ
+    TIMESTAMP_TX_ARMED, // TX-EN, until the armed frame has gone out
+    TIMESTAMP_TX_DONE,  // TX-EN still, back to CRS_DV between two received frames
+};
+#endif
+
+#if !NO_SYS
+// task running netif_rmii_ethernet_loop(), notified by the RX/TX interrupts
+static TaskHandle_t volatile rmii_eth_loop_task;
+#endif
+
+#if PICO_RMII_ETHERNET_TIMEOUT_ALARM
+static int timeouts_alarm = -1;
+static volatile bool timeouts_due = true;
+static bool timeouts_armed = false;
+static u32_t timeouts_armed_time; // the deadline the alarm is set for, in sys_now() ms
+#endif
+
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_doorbell)() {
+#if PICO_RMII_ETHERNET_DUAL_CORE
+    // wake the other core, the rings carry the actual work so a full FIFO can be skipped
+    if (multicore_fifo_wready()) {
+        multicore_fifo_push_blocking(0);
+    }
+#elif !NO_SYS
+    // wake the driver task when another task (tcpip, sockets) left it work
+    TaskHandle_t task = rmii_eth_loop_task;
+
+    if (task != NULL && task != xTaskGetCurrentTaskHandle()) {
+        xTaskNotifyGive(task);
+    }
+#endif
+}
+
+// an RX or TX interrupt left work for netif_rmii_ethernet_loop()
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_wake_from_isr)() {
+#if NO_SYS
+    // the poll loop may be waiting in __wfe() on the other core
+    __sev();
+#else
+    TaskHandle_t task = rmii_eth_loop_task;
+
+    if (task != NULL) {
+        BaseType_t woken = pdFALSE;
+
+        vTaskNotifyGiveFromISR(task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+#endif
+}
+
+struct rmii_ethernet;
+
+#if PICO_RMII_ETHERNET_RX_ZERO_COPY
+struct rx_pbuf {
+    struct pbuf_custom pc; // must be first, lwIP hands it back to the free function
+    struct rmii_ethernet *eth; // whose free list it goes back to, frames are forwarded between interfaces
+    struct rx_pbuf *next;
+    uint8_t frame[RX_FRAME_SIZE] __attribute__((aligned(4)));
+};
+#endif
+
+struct rx_descriptor {
+    uint8_t *frame; // NULL while no zero copy buffer could be attached
+    uint received;  // bytes written by DMA, valid once the IRQ handed the slot over
+    uint length;    // frame length without FCS once checked, 0 to drop it
+#if PICO_RMII_ETHERNET_PROFILE
+    uint32_t t;     // time the frame reached its last stage
+#endif
+#if PICO_RMII_ETHERNET_RX_ZERO_COPY
+    struct rx_pbuf *buf;
+#endif
+#if PICO_RMII_ETHERNET_TIMESTAMP
+    uint32_t timestamp;
+    bool timestamped;
+#endif
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    uint32_t received_us; // of a priority frame, timebase_us() in the CRS_DV IRQ
+#endif
+#if PICO_RMII_ETHERNET_RESPONDER
+    uint8_t responded; // enum rx_responded, set with length
+#endif
+};
+
+// one DMA control block, laid out like the channel's first register alias so the
+// control channel can load it with a 4 word write ending on CTRL_TRIG
+struct tx_dma_block {
+    const void *read_addr;
+    volatile void *write_addr;
+    uint32_t transfer_count;
+    uint32_t ctrl;
+};
+
+// length word, pbuf payloads, padding and FCS
+#define TX_DMA_BLOCKS (PICO_RMII_ETHERNET_TX_CHAIN_MAX + 3)
+
+struct tx_descriptor {
+    struct pbuf *p; // referenced until the frame has been streamed out
+    uint32_t length; // dibit count - 1, consumed by the PIO program
+    uint8_t tail[8]; // FCS and the spare byte for the PIO program's trailing `out null`
+    struct tx_dma_block blocks[TX_DMA_BLOCKS];
+#if PICO_RMII_ETHERNET_PROFILE
+    uint32_t t; // time the frame reached its last stage
+#endif
+};
+
+#if PICO_RMII_ETHERNET_RAW
+// a frame of netif_rmii_ethernet_netif_raw_send(), a PBUF_REF of the caller's memory while
+// the TX ring has it
+struct raw_tx {
+    struct pbuf_custom pc; // must be first, pbuf_free() hands it to raw_tx_free()
+    struct rmii_ethernet *eth;
+    const uint8_t *frame;
+    netif_rmii_ethernet_raw_tx_callback_t done;
+    void *arg;
+    struct raw_tx *next;
+};
+
+struct raw_rx_handler {
+    uint16_t type; // 0 while the entry is free
+    netif_rmii_ethernet_raw_rx_callback_t callback;
+    void *arg;
+};
+#endif
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+// preamble and SFD, FCS and the inter frame gap, the bytes of wire time around a frame
+#define TX_WIRE_OVERHEAD (8 + 4 + 12)
+
+enum tx_sched_state {
+    TX_SCHED_FREE,
+    TX_SCHED_QUEUED,  // built, waiting for its time
+    TX_SCHED_SENDING, // handed to the DMA
+    TX_SCHED_DONE,    // out or dropped, for lwIP context to report
+};
+
+// a frame of netif_rmii_ethernet_netif_tx_schedule(), built when it is scheduled
+struct tx_sched {
+    struct tx_descriptor desc;
+    struct pbuf_custom pc; // desc.p, a PBUF_REF of the caller's frame for the build only
+    volatile enum tx_sched_state state;
+    uint64_t launch_us;
+    uint64_t started_us; // time_us_64() the DMA was started on it
+    uint speed; // the link speed it was built for
+    err_t err;
+    const uint8_t *frame;
+    netif_rmii_ethernet_tx_scheduled_callback_t done;
+    void *arg;
+};
+#endif
+
+struct mdio_request {
+    uint8_t addr;
+    uint8_t reg;
+    bool write;
+    uint16_t value;
+    netif_rmii_ethernet_mdio_callback_t callback;
+    void *arg;
+};
+
+// MDIO requests are queued and run one at a time on the MDIO SM from lwIP context
+#define MDIO_QUEUE_SIZE 4
+
+// one interface: its PIO block, state machines, DMA channels and rings. The DMA buffers
+// are arrays of their own below, for their section
+struct rmii_ethernet {
+    struct netif *netif;
+    struct netif_rmii_ethernet_config config;
+
+    // counted from lwIP context, but for rx_overrun which the CRS_DV IRQ counts
+    struct netif_rmii_ethernet_stats stats;
+    volatile uint32_t rx_overrun;
+    uint32_t rx_overrun_reported; // already added to lwIP's counters
+
+#if PICO_RMII_ETHERNET_RX_FILTER
+    uint8_t rx_filter_hash[RX_FILTER_HASH_BINS];
+
+    // EtherTypes passed, rx_filter_default_types first
+    uint16_t rx_filter_types[PICO_RMII_ETHERNET_RX_FILTER_ETHERTYPES];
+    volatile uint rx_filter_type_count;
+    volatile bool rx_filter_promiscuous;
+    volatile uint32_t rx_filtered; // counted by the CRS_DV IRQ, as rx_overrun
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    // the class the CRS_DV IRQ diverts, while a callback is set
+    volatile uint16_t rx_priority_type;
+    volatile uint16_t rx_priority_port;
+    netif_rmii_ethernet_rx_priority_callback_t volatile rx_priority_callback;
+    void *volatile rx_priority_arg;
+
+    // the CRS_DV IRQ produces at rx_priority_head, swapping the frame buffer of a free slot
+    // with the one the frame came in, and the driver hands them to the callback at
+    // rx_priority_tail. rx_landing is set while RX is armed into the free slot at
+    // rx_priority_head itself, the RX ring being full
+    struct rx_descriptor rx_priority_ring[PICO_RMII_ETHERNET_RX_PRIORITY_RING_SIZE];
+    volatile uint rx_priority_head;
+    volatile uint rx_priority_tail;
+    volatile bool rx_landing;
+
+    // counted by the driver, and by the CRS_DV IRQ for rx_priority_overrun
+    volatile uint32_t rx_priority;
+    volatile uint32_t rx_priority_crc_err;
+    volatile uint32_t rx_priority_overrun;
+#endif
+
+#if PICO_RMII_ETHERNET_RX_POLICE
+    // the rates are set from lwIP context, the buckets are the CRS_DV IRQ's
+    struct rx_police_rate rx_police_rates[NETIF_RMII_ETHERNET_RX_POLICERS];
+    uint32_t rx_police_tat[NETIF_RMII_ETHERNET_RX_POLICE_SOURCE];
+    struct rx_police_source rx_police_sources[PICO_RMII_ETHERNET_RX_POLICE_SOURCES];
+
+    // counted by the CRS_DV IRQ, as rx_overrun
+    volatile uint32_t rx_police_dropped[NETIF_RMII_ETHERNET_RX_POLICERS];
+    volatile uint32_t rx_police_shared;
+#endif
+
+    uint rx_sm_offset;
+    uint tx_sm_offset;
+    uint mdio_sm_offset;
+#if PICO_RMII_ETHERNET_100M
+    uint tx_fast_sm_offset;
+#endif
+#if PICO_RMII_ETHERNET_TIMESTAMP
+    uint timestamp_sm_offset;
+    uint32_t timestamp_sfd; // counts from CRS_DV or TX-EN to the end of the SFD at the link speed
+
+    // lwIP context arms TX and switches back to RX
+    volatile enum timestamp_state timestamp_state;
+    u32_t timestamp_tx_armed; // sys_now() when it was armed
+    uint32_t timestamp_tx;
+    err_t timestamp_tx_err; // ERR_INPROGRESS while armed, ERR_OK or ERR_TIMEOUT until taken, then ERR_VAL
+
+    // of the frame in netif->input()
+    uint32_t timestamp_rx;
+    bool timestamp_rx_valid;
+#endif
+
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    // RX follows the autonegotiated speed, at 10 Mbit/s RX and TX wait ref_clk_loops delay
+    // loops per dibit
+    bool rx_fast;
+    uint ref_clk_loops;
+#else
+    // RX sampling clock divider from the REF_CLK, follows the autonegotiated speed
+    uint rx_clkdiv;
+#endif
+
+    // the autonegotiation result, link_speed in Mbit/s is 0 while the link is down
+    uint link_speed;
+    enum netif_rmii_ethernet_duplex link_duplex;
+
+    int rx_dma_chan;
+    int tx_dma_chan;
+    int tx_dma_ctrl_chan;
+
+    dma_channel_config rx_dma_channel_config;
+    dma_channel_config tx_dma_channel_config;
+
+#if !PICO_RMII_ETHERNET_FIXED_CONFIG
+    // the RX SM's RX FIFO and the TX SM's TX FIFO
+    io_ro_32 *rx_fifo;
+    io_wo_32 *tx_fifo;
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PEEK
+    int rx_dma_rest_chan;
+    dma_channel_config rx_dma_rest_channel_config;
+
+    // set when the header interrupt dropped a frame and re-armed its slot, the CRS_DV IRQ
+    // at the end of that frame leaves RX alone
+    volatile bool rx_peek_rearmed;
+#endif
+
+    int phy_address;
+
+    // netif_rmii_ethernet_netif_phy_loopback(), the link checks leave the link alone
+    bool phy_loopback;
+
+    // the CRS_DV IRQ produces at rx_ring_head, the driver checks FCS up to rx_ring_checked
+    // and lwIP context consumes at rx_ring_tail
+    struct rx_descriptor rx_ring[PICO_RMII_ETHERNET_RX_RING_SIZE];
+    volatile uint rx_ring_head;
+    volatile uint rx_ring_checked;
+    volatile uint rx_ring_tail;
+    volatile bool rx_stalled;
+    // the SM runs from frame to frame and is only (re)initialised by the next
+    // netif_rmii_ethernet_rx_start() before the first frame, after a stall and for a new speed
+    volatile bool rx_sm_init;
+
+#if PICO_RMII_ETHERNET_RX_ZERO_COPY
+    struct rx_pbuf *rx_pbuf_free_list;
+    spin_lock_t *rx_pbuf_lock;
+#endif
+
+#if PICO_RMII_ETHERNET_LRO
+    // segments held between the frames of a poll, lwIP context only
+    struct lwip_lro lro;
+#endif
+
+    // netif_rmii_ethernet_output() queues pbufs at tx_ring_head, the driver builds their DMA
+    // blocks up to tx_ring_built, the DMA IRQ sends from tx_ring_dma and lwIP context releases
+    // sent frames at tx_ring_tail
+    struct tx_descriptor *tx_ring;
+    volatile uint tx_ring_head;
+    volatile uint tx_ring_built;
+    volatile uint tx_ring_dma;
+    uint tx_ring_tail;
+    volatile bool tx_busy; // frame at tx_ring_dma is on its way to the PIO
+    spin_lock_t *tx_ring_lock;
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+    // priority frames, in the stages of tx_ring and under its lock
+    struct tx_descriptor *tx_priority_ring;
+    volatile uint tx_priority_head;
+    volatile uint tx_priority_built;
+    volatile uint tx_priority_dma;
+    uint tx_priority_tail;
+    volatile bool tx_priority_busy; // the frame on its way is tx_priority_dma's
+#if PICO_RMII_ETHERNET_TX_PRIORITY_WEIGHT
+    uint tx_priority_run; // priority frames sent in a row while tx_ring waited
+#endif
+#if PICO_RMII_ETHERNET_100M
+    uint32_t (*tx_priority_fast_frames)[RMII_ETHERNET_FRAME_FAST_WORDS];
+#endif
+#endif
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+    // scheduled frames, their states under tx_ring_lock. tx_sched_next_us is the time of the
+    // first one queued, UINT64_MAX for none, the frames of the rings must be off the wire by
+    // then. The alarm is claimed by the first frame scheduled
+    struct tx_sched tx_sched[PICO_RMII_ETHERNET_TX_SCHEDULED_SLOTS];
+    uint64_t tx_sched_next_us;
+    struct tx_sched *volatile tx_sched_busy; // the frame on its way is this one
+    int tx_sched_alarm;
+#if PICO_RMII_ETHERNET_100M
+    uint32_t (*tx_sched_fast_frames)[RMII_ETHERNET_FRAME_FAST_WORDS];
+#endif
+#endif
+
+#if PICO_LWIP_VLAN
+    // tags sent frames with this VID, -1 for untagged. lwIP context only
+    int vlan_vid;
+#endif
+
+    uint32_t tx_dma_ctrl_8;
+    uint32_t tx_dma_ctrl_32;
+    uint32_t tx_dma_ctrl_last; // no chaining, raises the completion IRQ
+
+#if PICO_RMII_ETHERNET_100M
+    uint32_t (*tx_fast_frames)[RMII_ETHERNET_FRAME_FAST_WORDS];
+    uint32_t tx_dma_ctrl_fast;
+    bool tx_fast;
+#endif
+
+#if PICO_RMII_ETHERNET_PAUSE
+    // PAUSE frames sent outside the ring, [0] lets the partner go on and [1] asks it to
+    // pause. Built for the speed at link up, tx_control is one to send before the next
+    // frame of the ring, tx_ring_lock guards both
+    struct tx_descriptor tx_pause[2];
+    uint8_t tx_pause_frames[2][PAUSE_FRAME_SIZE];
+#if PICO_RMII_ETHERNET_100M
+    uint32_t tx_pause_fast_frames[2][PAUSE_FAST_WORDS];
+#endif
+    struct tx_descriptor *volatile tx_control;
+    volatile bool tx_control_busy; // the frame on its way is tx_control's, not tx_ring_dma's
+    volatile uint32_t tx_pause_until; // timebase_us() the partner's pause ends at
+    volatile uint32_t tx_pause_sent;
+
+    // full duplex with a partner that advertised PAUSE, from its ability register
+    volatile bool link_pause;
+    bool link_pause_partner;
+
+    // the partner was asked to pause at rx_pause_us and not let go on yet. The CRS_DV IRQ
+    // asks, the driver lets it go on or asks again every rx_pause_refresh_us
+    volatile bool rx_pause_sent;
+    uint32_t rx_pause_us;
+    uint32_t rx_pause_refresh_us;
+    uint32_t rx_pause_received;
+#endif
+
+#if PICO_RMII_ETHERNET_RESPONDER
+    // replies the driver built in its FCS check, sent ahead of the rings. The driver moves
+    // tx_responder_head on, the DMA IRQ tx_responder_dma, both with tx_ring_lock held
+    struct tx_descriptor tx_responder[PICO_RMII_ETHERNET_RESPONDER_SLOTS];
+    uint8_t tx_responder_frames[PICO_RMII_ETHERNET_RESPONDER_SLOTS][PICO_RMII_ETHERNET_RESPONDER_FRAME_MAX] __attribute__((aligned(4)));
+#if PICO_RMII_ETHERNET_100M
+    uint32_t tx_responder_fast_frames[PICO_RMII_ETHERNET_RESPONDER_SLOTS][RESPONDER_FAST_WORDS];
+#endif
+    volatile uint tx_responder_head;
+    volatile uint tx_responder_dma;
+    volatile bool tx_responder_busy; // the frame on its way is tx_responder_dma's
+#endif
+
+#if PICO_RMII_ETHERNET_RAW
+    // lwIP context only
+    struct raw_rx_handler raw_rx_handlers[PICO_RMII_ETHERNET_RAW_RX_HANDLERS];
+    struct raw_tx raw_tx[PICO_RMII_ETHERNET_TX_RING_SIZE];
+    struct raw_tx *raw_tx_free_list;
+#endif
+
+#if PICO_RMII_ETHERNET_WAKE
+    // the wake-up frames of netif_rmii_ethernet_netif_sleep(), 0 while awake. lwIP context only
+    uint wake_match;
+    netif_rmii_ethernet_wake_callback_t wake_callback;
+    void *wake_arg;
+#endif
+
+    struct mdio_request mdio_queue[MDIO_QUEUE_SIZE];
+    uint mdio_queue_head;
+    uint mdio_queue_tail;
+    bool mdio_busy;
+};
+
+// in the order netif_rmii_ethernet_init() added them, the first is the one the calls
+// without a netif act on
+static struct rmii_ethernet rmii_eth_instances[PICO_RMII_ETHERNET_INSTANCES];
+static uint rmii_eth_instance_count = 0;
+
+#if PICO_RMII_ETHERNET_WAKE
+// interfaces asleep, they hold lwIP's timeouts and let the loop sleep once all are
+static uint rmii_eth_asleep_count = 0;
+#endif
+
+// the interrupt handlers are shared by the interfaces and added with the first one
+static bool tx_dma_irq_added = false;
+#if PICO_RMII_ETHERNET_RX_PEEK
+static bool rx_peek_irq_added = false;
+#endif
+
+#if PICO_RMII_ETHERNET_RX_ZERO_COPY
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+// the priority slots take theirs at init, swapping them with RX ring slots keeps the count
+#define RX_PBUF_COUNT (PICO_RMII_ETHERNET_RX_ZERO_COPY_BUFFERS + PICO_RMII_ETHERNET_RX_PRIORITY_RING_SIZE)
+#else
+#define RX_PBUF_COUNT PICO_RMII_ETHERNET_RX_ZERO_COPY_BUFFERS
+#endif
+
+#if !PICO_LWIP_ARENA_SIZE
+static struct rx_pbuf RMII_ETHERNET_DMA_BUFFER(rx_pbufs)[PICO_RMII_ETHERNET_INSTANCES][RX_PBUF_COUNT];
+#endif
+
+static struct rx_pbuf *RMII_ETHERNET_HOT_FUNC(rx_pbuf_get)(struct rmii_ethernet *eth) {
+    uint32_t save = spin_lock_blocking(eth->rx_pbuf_lock);
+
+    struct rx_pbuf *buf = eth->rx_pbuf_free_list;
+
+    if (buf != NULL) {
+        eth->rx_pbuf_free_list = buf->next;
+    }
+
+    spin_unlock(eth->rx_pbuf_lock, save);
+
+    return buf;
+}
+
+// pbuf_custom free function, may run on whichever core frees the pbuf
+static void RMII_ETHERNET_HOT_FUNC(rx_pbuf_put)(struct pbuf *p) {
+    struct rx_pbuf *buf = (struct rx_pbuf *)p;
+    struct rmii_ethernet *eth = buf->eth;
+
+    uint32_t save = spin_lock_blocking(eth->rx_pbuf_lock);
+
+    buf->next = eth->rx_pbuf_free_list;
+    eth->rx_pbuf_free_list = buf;
+
+    spin_unlock(eth->rx_pbuf_lock, save);
+}
+
+static void RMII_ETHERNET_HOT_FUNC(rx_descriptor_attach)(struct rmii_ethernet *eth, struct rx_descriptor *desc) {
+    desc->buf = rx_pbuf_get(eth);
+
+    // frame != NULL publishes the slot to the driver, possibly on the other core
+    __dmb();
+
+    desc->frame = (desc->buf != NULL) ? desc->buf->frame : NULL;
+}
+#elif !PICO_LWIP_ARENA_SIZE
+static uint8_t RMII_ETHERNET_DMA_BUFFER(rx_frames)[PICO_RMII_ETHERNET_INSTANCES][PICO_RMII_ETHERNET_RX_RING_SIZE][RX_FRAME_SIZE] __attribute__((aligned(4)));
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+static uint8_t RMII_ETHERNET_DMA_BUFFER(rx_priority_frames)[PICO_RMII_ETHERNET_INSTANCES][PICO_RMII_ETHERNET_RX_PRIORITY_RING_SIZE][RX_FRAME_SIZE] __attribute__((aligned(4)));
+#endif
+#endif
+
+#if PICO_LWIP_ARENA_SIZE && PICO_RMII_ETHERNET_RX_ZERO_COPY
+// interfaces that haven't carved their RX buffers from lwIP's arena yet, each takes an
+// even share of what is left when it is added
+static uint rx_arena_instances = PICO_RMII_ETHERNET_INSTANCES;
+#endif
+
+static struct tx_descriptor RMII_ETHERNET_DMA_BUFFER(tx_rings)[PICO_RMII_ETHERNET_INSTANCES][PICO_RMII_ETHERNET_TX_RING_SIZE];
+
+#if PICO_RMII_ETHERNET_100M
+static uint32_t RMII_ETHERNET_DMA_BUFFER(tx_fast_frames)[PICO_RMII_ETHERNET_INSTANCES][PICO_RMII_ETHERNET_TX_RING_SIZE][RMII_ETHERNET_FRAME_FAST_WORDS];
+#endif
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+static struct tx_descriptor RMII_ETHERNET_DMA_BUFFER(tx_priority_rings)[PICO_RMII_ETHERNET_INSTANCES][PICO_RMII_ETHERNET_TX_PRIORITY_RING_SIZE];
+
+#if PICO_RMII_ETHERNET_100M
+static uint32_t RMII_ETHERNET_DMA_BUFFER(tx_priority_fast_frames)[PICO_RMII_ETHERNET_INSTANCES][PICO_RMII_ETHERNET_TX_PRIORITY_RING_SIZE][RMII_ETHERNET_FRAME_FAST_WORDS];
+#endif
+#endif
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED && PICO_RMII_ETHERNET_100M
+static uint32_t RMII_ETHERNET_DMA_BUFFER(tx_sched_fast_frames)[PICO_RMII_ETHERNET_INSTANCES][PICO_RMII_ETHERNET_TX_SCHEDULED_SLOTS][RMII_ETHERNET_FRAME_FAST_WORDS];
+#endif
+
+static const uint8_t tx_padding[60];
+
+static void netif_rmii_ethernet_mdio_start(struct rmii_ethernet *eth, const struct mdio_request *req) {
+    // ST, OP, PA5, RA5, then TA and data for writes, or released lines for the PHY to drive
+    uint32_t frame = (0x1 << 30) | ((req->addr & 0x1f) << 23) | ((req->reg & 0x1f) << 18);
+
+    if (req->write) {
+        frame |= (0x1 << 28) | (0x2 << 16) | req->value;
+    } else {
+        frame |= (0x2 << 28) | 0x3ffff;
+    }
+
+    // PRE_32 then the frame, inverted for the open drain PIO program
+    pio_sm_put(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_MDIO, ~0xffffffffu);
+    pio_sm_put(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_MDIO, ~frame);
+}
+
+static void netif_rmii_ethernet_mdio_service(struct rmii_ethernet *eth) {
+    if (eth->mdio_busy && pio_sm_get_rx_fifo_level(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_MDIO) >= 2) {
+        struct mdio_request *req = &eth->mdio_queue[eth->mdio_queue_tail % MDIO_QUEUE_SIZE];
+
+        pio_sm_get(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_MDIO); // preamble
+        uint16_t value = pio_sm_get(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_MDIO) & 0xffff;
+
+        eth->mdio_queue_tail++;
+        eth->mdio_busy = false;
+
+        if (req->callback != NULL) {
+            req->callback(req->write ? req->value : value, req->arg);
+        }
+    }
+
+    if (!eth->mdio_busy && eth->mdio_queue_tail != eth->mdio_queue_head) {
+        eth->mdio_busy = true;
+        netif_rmii_ethernet_mdio_start(eth, &eth->mdio_queue[eth->mdio_queue_tail % MDIO_QUEUE_SIZE]);
+    }
+}
+
+static err_t netif_rmii_ethernet_mdio_queue(struct rmii_ethernet *eth, uint addr, uint reg, bool write, uint16_t value, netif_rmii_ethernet_mdio_callback_t callback, void *arg) {
+    if ((eth->mdio_queue_head - eth->mdio_queue_tail) == MDIO_QUEUE_SIZE) {
+        return ERR_MEM;
+    }
+
+    struct mdio_request *req = &eth->mdio_queue[eth->mdio_queue_head % MDIO_QUEUE_SIZE];
+
+    req->addr = addr;
+    req->reg = reg;
+    req->write = write;
+    req->value = value;
+    req->callback = callback;
+    req->arg = arg;
+
+    eth->mdio_queue_head++;
+
+    netif_rmii_ethernet_mdio_service(eth);
+
+#if !NO_SYS
+    // completion is polled by the driver task
+    netif_rmii_ethernet_doorbell();
+#endif
+
+    return ERR_OK;
+}
+
+err_t netif_rmii_ethernet_mdio_read_async(uint reg, netif_rmii_ethernet_mdio_callback_t callback, void *arg) {
+    return netif_rmii_ethernet_netif_mdio_read_async(rmii_eth_instances[0].netif, reg, callback, arg);
+}
+
+err_t netif_rmii_ethernet_mdio_write_async(uint reg, uint16_t value, netif_rmii_ethernet_mdio_callback_t callback, void *arg) {
+    return netif_rmii_ethernet_netif_mdio_write_async(rmii_eth_instances[0].netif, reg, value, callback, arg);
+}
+
+err_t netif_rmii_ethernet_netif_mdio_read_async(struct netif *netif, uint reg, netif_rmii_ethernet_mdio_callback_t callback, void *arg) {
+    struct rmii_ethernet *eth = netif->state;
+
+    return netif_rmii_ethernet_mdio_queue(eth, eth->phy_address, reg, false, 0, callback, arg);
+}
+
+err_t netif_rmii_ethernet_netif_mdio_write_async(struct netif *netif, uint reg, uint16_t value, netif_rmii_ethernet_mdio_callback_t callback, void *arg) {
+    struct rmii_ethernet *eth = netif->state;
+
+    return netif_rmii_ethernet_mdio_queue(eth, eth->phy_address, reg, true, value, callback, arg);
+}
+
+static void netif_rmii_ethernet_mdio_done(uint16_t value, void *arg) {
+    *(int *)arg = value;
+}
+
+static uint16_t netif_rmii_ethernet_mdio_read(struct rmii_ethernet *eth, uint addr, uint reg)
+{
+    volatile int data = -1;
+
+    while (netif_rmii_ethernet_mdio_queue(eth, addr, reg, false, 0, netif_rmii_ethernet_mdio_done, (void *)&data) != ERR_OK) {
+        netif_rmii_ethernet_mdio_service(eth);
+    }
+
+    while (data < 0) {
+        netif_rmii_ethernet_mdio_service(eth);
+    }
+
+    return data;
+}
+
+static void netif_rmii_ethernet_mdio_write(struct rmii_ethernet *eth, int addr, int reg, int val)
+{
+    volatile int data = -1;
+
+    while (netif_rmii_ethernet_mdio_queue(eth, addr, reg, true, val, netif_rmii_ethernet_mdio_done, (void *)&data) != ERR_OK) {
+        netif_rmii_ethernet_mdio_service(eth);
+    }
+
+    while (data < 0) {
+        netif_rmii_ethernet_mdio_service(eth);
+    }
+}
+
+static void RMII_ETHERNET_HOT_FUNC(tx_dma_block_set)(struct rmii_ethernet *eth, struct tx_dma_block *block, const void *data, uint count, uint32_t ctrl) {
+    block->read_addr = data;
+    block->write_addr = PICO_RMII_ETHERNET_TX_FIFO;
+    block->transfer_count = count;
+    block->ctrl = ctrl;
+}
+
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_start)(struct rmii_ethernet *eth, struct tx_descriptor *desc) {
+    RMII_ETHERNET_PROFILE_RECORD(TX_QUEUE, desc->t);
+
+    dma_channel_set_read_addr(eth->tx_dma_ctrl_chan, desc->blocks, true);
+}
+
+// built frames in the TX rings the DMA hasn't sent
+static inline bool tx_pending(struct rmii_ethernet *eth) {
+#if PICO_RMII_ETHERNET_RESPONDER
+    if (eth->tx_responder_dma != eth->tx_responder_head) {
+        return true;
+    }
+#endif
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+    if (eth->tx_priority_dma != eth->tx_priority_built) {
+        return true;
+    }
+#endif
+
+    return eth->tx_ring_dma != eth->tx_ring_built;
+}
+
+#if PICO_RMII_ETHERNET_PAUSE
+// a pause the link partner asked for isn't over
+static inline bool tx_paused(struct rmii_ethernet *eth) {
+    return (int32_t)(eth->tx_pause_until - timebase_us()) > 0;
+}
+#endif
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+// with tx_ring_lock held: the queued scheduled frame with the earliest time, NULL for none
+static struct tx_sched *RMII_ETHERNET_HOT_FUNC(tx_sched_first)(struct rmii_ethernet *eth) {
+    struct tx_sched *first = NULL;
+
+    for (uint i = 0; i < PICO_RMII_ETHERNET_TX_SCHEDULED_SLOTS; i++) {
+        struct tx_sched *sched = &eth->tx_sched[i];
+
+        if (sched->state == TX_SCHED_QUEUED && (first == NULL || sched->launch_us < first->launch_us)) {
+            first = sched;
+        }
+    }
+
+    return first;
+}
+
+// with tx_ring_lock held: the first scheduled frame's time has come
+static inline bool tx_sched_due(struct rmii_ethernet *eth) {
+    return eth->tx_sched_next_us != UINT64_MAX && eth->tx_sched_next_us <= time_us_64();
+}
+#endif
+
+// with tx_ring_lock held: a frame of length bytes from the rings mustn't start now, it
+// wouldn't be off the wire by the time of the first scheduled frame
+static inline bool tx_sched_hold(struct rmii_ethernet *eth, uint length) {
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+    if (eth->tx_sched_next_us == UINT64_MAX) {
+        return false;
+    }
+
+    uint speed = (eth->link_speed != 0) ? eth->link_speed : 10;
+    uint bits = (LWIP_MAX(length, 60) + TX_WIRE_OVERHEAD) * 8;
+
+    return time_us_64() + (bits + speed - 1) / speed > eth->tx_sched_next_us;
+#else
+    return false;
+#endif
+}
+
+// with tx_ring_lock held and tx_busy set: starts the next frame, or clears tx_busy if none
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_next)(struct rmii_ethernet *eth) {
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+    // a scheduled frame whose time has come goes first, a pause doesn't hold it
+    while (tx_sched_due(eth)) {
+        struct tx_sched *sched = tx_sched_first(eth);
+
+        sched->state = TX_SCHED_SENDING;
+
+        struct tx_sched *next = tx_sched_first(eth);
+
+        eth->tx_sched_next_us = (next != NULL) ? next->launch_us : UINT64_MAX;
+
+        if (next != NULL) {
+            // the alarm's interrupt sets it for the next one
+            hardware_alarm_force_irq(eth->tx_sched_alarm);
+        }
+
+        if (sched->speed == eth->link_speed) {
+            eth->tx_sched_busy = sched;
+            sched->started_us = time_us_64();
+            netif_rmii_ethernet_tx_start(eth, &sched->desc);
+
+            return;
+        }
+
+        // built for a link that has gone since
+        sched->err = ERR_CONN;
+        sched->state = TX_SCHED_DONE;
+    }
+#endif
+
+#if PICO_RMII_ETHERNET_PAUSE
+    struct tx_descriptor *control = eth->tx_control;
+
+    if (control != NULL && !tx_sched_hold(eth, PAUSE_FRAME_SIZE)) {
+        // MAC control frames go first, a pause doesn't hold them
+        eth->tx_control = NULL;
+        eth->tx_control_busy = true;
+        netif_rmii_ethernet_tx_start(eth, control);
+
+        return;
+    }
+
+    if (tx_paused(eth)) {
+        // netif_rmii_ethernet_tx_process() starts the ring again once the pause is over
+        eth->tx_busy = false;
+
+        return;
+    }
+#endif
+
+#if PICO_RMII_ETHERNET_RESPONDER
+    if (eth->tx_responder_dma != eth->tx_responder_head) {
+        // the driver's replies go ahead of both rings, they are short and few
+        struct tx_descriptor *responder = &eth->tx_responder[eth->tx_responder_dma & TX_RESPONDER_MASK];
+
+        if (tx_sched_hold(eth, PICO_RMII_ETHERNET_RESPONDER_FRAME_MAX)) {
+            eth->tx_busy = false;
+
+            return;
+        }
+
+        eth->tx_responder_busy = true;
+        netif_rmii_ethernet_tx_start(eth, responder);
+
+        return;
+    }
+#endif
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+    if (eth->tx_priority_dma != eth->tx_priority_built) {
+        if (tx_sched_hold(eth, eth->tx_priority_ring[eth->tx_priority_dma & TX_PRIORITY_MASK].p->tot_len)) {
+            // the DMA interrupt of the scheduled frame starts it
+            eth->tx_busy = false;
+
+            return;
+        }
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY_WEIGHT
+        bool bulk = (eth->tx_ring_dma != eth->tx_ring_built);
+
+        if (!bulk || eth->tx_priority_run < PICO_RMII_ETHERNET_TX_PRIORITY_WEIGHT) {
+            // counts while bulk frames wait, a bulk frame going out starts it over
+            eth->tx_priority_run = bulk ? eth->tx_priority_run + 1 : 0;
+#else
+        {
+#endif
+            eth->tx_priority_busy = true;
+            netif_rmii_ethernet_tx_start(eth, &eth->tx_priority_ring[eth->tx_priority_dma & TX_PRIORITY_MASK]);
+
+            return;
+        }
+    }
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY_WEIGHT
+    eth->tx_priority_run = 0;
+#endif
+#endif
+
+    struct tx_descriptor *desc = &eth->tx_ring[eth->tx_ring_dma & TX_RING_MASK];
+
+    if (eth->tx_ring_dma != eth->tx_ring_built && !tx_sched_hold(eth, desc->p->tot_len)) {
+        netif_rmii_ethernet_tx_start(eth, desc);
+    } else {
+        eth->tx_busy = false;
+    }
+}
+
+#if PICO_RMII_ETHERNET_RAW
+// pbuf_custom free function of a raw frame, from lwIP context once the TX ring is done with it
+static void RMII_ETHERNET_HOT_FUNC(raw_tx_free)(struct pbuf *p) {
+    struct raw_tx *tx = (struct raw_tx *)p;
+    struct rmii_ethernet *eth = tx->eth;
+    netif_rmii_ethernet_raw_tx_callback_t done = tx->done;
+    const uint8_t *frame = tx->frame;
+    void *arg = tx->arg;
+
+    // free before the callback, which may send the next frame
+    tx->next = eth->raw_tx_free_list;
+    eth->raw_tx_free_list = tx;
+
+    if (done != NULL) {
+        done(frame, arg);
+    }
+}
+#endif
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+// from lwIP context: a scheduled frame is out or dropped, to the stats and its callback
+static void netif_rmii_ethernet_tx_sched_report(struct rmii_ethernet *eth, struct tx_sched *sched) {
+    netif_rmii_ethernet_tx_scheduled_callback_t done = sched->done;
+    const uint8_t *frame = sched->frame;
+    void *arg = sched->arg;
+    err_t err = sched->err;
+    int32_t late_us = 0;
+
+    if (err == ERR_OK) {
+        late_us = (int32_t)(sched->started_us - sched->launch_us);
+
+        eth->stats.tx_scheduled++;
+
+        if (late_us > PICO_RMII_ETHERNET_TX_SCHEDULED_LATE_US) {
+            eth->stats.tx_scheduled_late++;
+        }
+
+        if ((uint32_t)late_us > eth->stats.tx_scheduled_late_max_us) {
+            eth->stats.tx_scheduled_late_max_us = late_us;
+        }
+
+        LINK_STATS_INC(link.xmit);
+        MIB2_STATS_NETIF_ADD(eth->netif, ifoutoctets, sched->desc.p->tot_len);
+    } else {
+        eth->stats.tx_scheduled_dropped++;
+        LINK_STATS_INC(link.drop);
+        MIB2_STATS_NETIF_INC(eth->netif, ifoutdiscards);
+    }
+
+    // free before the callback, which may schedule the next frame of a cycle
+    sched->state = TX_SCHED_FREE;
+
+    if (done != NULL) {
+        done(frame, err, late_us, arg);
+    }
+}
+#endif
+
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_release)(struct rmii_ethernet *eth) {
+    // frames are only freed from lwIP context, the DMA IRQ just moves tx_ring_dma on
+    while (eth->tx_ring_tail != eth->tx_ring_dma) {
+        struct tx_descriptor *desc = &eth->tx_ring[eth->tx_ring_tail & TX_RING_MASK];
+        struct pbuf *p = desc->p;
+
+        // the slot is given back first, a raw frame's done callback may queue the next one
+        desc->p = NULL;
+        eth->tx_ring_tail++;
+
+        if (p != NULL) {
+            pbuf_free(p);
+        }
+    }
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+    while (eth->tx_priority_tail != eth->tx_priority_dma) {
+        struct tx_descriptor *desc = &eth->tx_priority_ring[eth->tx_priority_tail & TX_PRIORITY_MASK];
+
+        pbuf_free(desc->p);
+        desc->p = NULL;
+
+        eth->tx_priority_tail++;
+    }
+#endif
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+    for (uint i = 0; i < PICO_RMII_ETHERNET_TX_SCHEDULED_SLOTS; i++) {
+        if (eth->tx_sched[i].state == TX_SCHED_DONE) {
+            netif_rmii_ethernet_tx_sched_report(eth, &eth->tx_sched[i]);
+        }
+    }
+#endif
+}
+
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_dma_irq)(struct rmii_ethernet *eth) {
+    if (dma_channel_get_irq0_status(eth->tx_dma_chan)) {
+        // raised by the last block of the list, the PIO program inserts the inter frame gap
+        dma_channel_acknowledge_irq0(eth->tx_dma_chan);
+
+        uint32_t save = spin_lock_blocking(eth->tx_ring_lock);
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+        if (eth->tx_sched_busy != NULL) {
+            eth->tx_sched_busy->state = TX_SCHED_DONE;
+            eth->tx_sched_busy = NULL;
+        } else
+#endif
+#if PICO_RMII_ETHERNET_PAUSE
+        if (eth->tx_control_busy) {
+            eth->tx_control_busy = false;
+        } else
+#endif
+#if PICO_RMII_ETHERNET_RESPONDER
+        if (eth->tx_responder_busy) {
+            eth->tx_responder_busy = false;
+            eth->tx_responder_dma++;
+        } else
+#endif
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+        if (eth->tx_priority_busy) {
+            RMII_ETHERNET_PROFILE_RECORD(TX_DMA, eth->tx_priority_ring[eth->tx_priority_dma & TX_PRIORITY_MASK].t);
+
+            eth->tx_priority_busy = false;
+            eth->tx_priority_dma++;
+        } else
+#endif
+        {
+            RMII_ETHERNET_PROFILE_RECORD(TX_DMA, eth->tx_ring[eth->tx_ring_dma & TX_RING_MASK].t);
+
+            eth->tx_ring_dma++;
+        }
+
+        netif_rmii_ethernet_tx_next(eth);
+
+        spin_unlock(eth->tx_ring_lock, save);
+
+        netif_rmii_ethernet_wake_from_isr();
+    }
+}
+
+// DMA_IRQ_0, shared with the application
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_dma_handler)() {
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        netif_rmii_ethernet_tx_dma_irq(&rmii_eth_instances[i]);
+    }
+}
+
+#if PICO_RMII_ETHERNET_TX_CUT_THROUGH
+// bytes encoded between checks of the 100 Mbit/s DMA's progress
+#define TX_CUT_SLICE 64
+
+// built is the index of desc's ring for the build to start the frame early with, NULL to
+// build it whole first
+#define TX_CUT(eth, desc, built) ((!(eth)->tx_busy && (desc)->p->tot_len >= PICO_RMII_ETHERNET_TX_CUT_THROUGH_MIN) ? (built) : NULL)
+
+// from a build with the start of desc ready: moves built on and starts the DMA if the TX
+// is still idle with nothing else to send, so the frame that goes is desc. False if it
+// got busy meanwhile, the caller then queues the frame as usual once it is built
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_cut_start)(struct rmii_ethernet *eth, struct tx_descriptor *desc, volatile uint *built) {
+    uint32_t save = spin_lock_blocking(eth->tx_ring_lock);
+    bool idle = !eth->tx_busy && !tx_pending(eth) && !tx_sched_hold(eth, desc->p->tot_len);
+
+#if PICO_RMII_ETHERNET_PAUSE
+    idle = idle && eth->tx_control == NULL && !tx_paused(eth);
+#endif
+
+    if (idle) {
+        RMII_ETHERNET_PROFILE_RECORD(TX_ENCODE, desc->t);
+
+        (*built)++;
+        eth->tx_busy = true;
+        netif_rmii_ethernet_tx_next(eth);
+    }
+
+    spin_unlock(eth->tx_ring_lock, save);
+
+    if (idle) {
+        eth->stats.tx_cut_through++;
+    }
+
+    return idle;
+}
+#else
+#define TX_CUT(eth, desc, built) NULL
+#endif
+
+// with cut, see TX_CUT(), true if the frame was handed to the DMA before it was built
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_build)(struct rmii_ethernet *eth, struct tx_descriptor *desc, volatile uint *cut) {
+    struct pbuf *p = desc->p;
+    struct tx_dma_block *block = desc->blocks;
+
+    tx_dma_block_set(eth, block++, &desc->length, 1, eth->tx_dma_ctrl_32);
+
+    // the PIO FIFO takes one byte per entry, so payloads are streamed at any alignment
+    uint tot_len = 0;
+
+    for (struct pbuf *q = p; q != NULL && tot_len < p->tot_len; q = q->next) {
+        if (q->len == 0) {
+            continue;
+        }
+
+        tx_dma_block_set(eth, block++, q->payload, q->len, eth->tx_dma_ctrl_8);
+
+        tot_len += q->len;
+    }
+
+    if (tot_len < 60) {
+        // pad
+        tx_dma_block_set(eth, block++, tx_padding, 60 - tot_len, eth->tx_dma_ctrl_8);
+
+        tot_len = 60;
+    }
+
+    struct tx_dma_block *fcs = block++;
+
+    tx_dma_block_set(eth, fcs, desc->tail, 5, eth->tx_dma_ctrl_last);
+    desc->tail[4] = 0x00;
+
+    desc->length = (tot_len + 4) * 4 - 1;
+
+    RMII_ETHERNET_TRACE(RMII_TX_FRAME, tot_len, block - desc->blocks, 0);
+
+    bool started = false;
+
+#if PICO_RMII_ETHERNET_TX_CUT_THROUGH
+    // the FCS is read last, the payload streams out while it is computed
+    started = (cut != NULL) && netif_rmii_ethernet_tx_cut_start(eth, desc, cut);
+#endif
+
+    uint32_t crc = RMII_ETHERNET_CRC32_INIT;
+
+    for (const struct tx_dma_block *b = desc->blocks + 1; b < fcs; b++) {
+        crc = rmii_ethernet_crc32_update(crc, b->read_addr, b->transfer_count);
+    }
+
+    crc = ~crc;
+
+    memcpy(desc->tail, &crc, sizeof(crc));
+
+#if PICO_RMII_ETHERNET_TX_CUT_THROUGH
+    if (started) {
+        __dmb();
+
+        // the control channel is past the FCS block once it has loaded it
+        uintptr_t loading = dma_hw->ch[eth->tx_dma_ctrl_chan].read_addr;
+
+        if (loading < (uintptr_t)desc->blocks || loading > (uintptr_t)fcs) {
+            eth->stats.tx_cut_late++;
+        }
+    }
+#endif
+
+    return started;
+}
+
+#if PICO_RMII_ETHERNET_100M
+#if PICO_RMII_ETHERNET_TX_CUT_THROUGH
+struct tx_cut {
+    volatile uint *built; // ring index for netif_rmii_ethernet_tx_cut_start()
+    uint head;            // bytes to encode before the DMA is started
+    bool started;
+    bool late;
+};
+
+// false if the DMA, started on the frame in words (count long), may have read words
+// from first on before they were written
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_cut_ahead)(struct rmii_ethernet *eth, const uint32_t *words, uint count, uint first) {
+    __dmb();
+
+    uintptr_t read = dma_hw->ch[eth->tx_dma_chan].read_addr;
+
+    // until the control channel loads the frame's block it is at the end of the last frame
+    if (read <= (uintptr_t)words || read > (uintptr_t)(words + count)) {
+        return true;
+    }
+
+    return (read - (uintptr_t)words) / sizeof(uint32_t) <= first;
+}
+
+// encodes length bytes, starting the DMA once the head is and then checking it is
+// behind after each TX_CUT_SLICE
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_cut_encode)(struct rmii_ethernet *eth, struct tx_descriptor *desc, struct rmii_ethernet_frame_encoder *encoder, struct tx_cut *cut, const uint8_t *data, uint length) {
+    while (length) {
+        uint n = LWIP_MIN(length, (cut->head != 0) ? cut->head : TX_CUT_SLICE);
+        uint first = encoder->count;
+
+        rmii_ethernet_frame_encode(encoder, data, n);
+
+        data += n;
+        length -= n;
+
+        if (cut->head != 0) {
+            cut->head -= n;
+
+            if (cut->head == 0) {
+                cut->started = netif_rmii_ethernet_tx_cut_start(eth, desc, cut->built);
+            }
+        } else if (cut->started && !cut->late) {
+            cut->late = !netif_rmii_ethernet_tx_cut_ahead(eth, encoder->words, desc->blocks[0].transfer_count, first);
+        }
+    }
+}
+#endif
+
+// words takes the encoded frame, RMII_ETHERNET_FRAME_FAST_WORDS for the longest. With cut,
+// see TX_CUT(), true if the frame was handed to the DMA before it was built
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_fast_build)(struct rmii_ethernet *eth, struct tx_descriptor *desc, uint32_t *words, volatile uint *cut) {
+    struct rmii_ethernet_frame_encoder encoder;
+    struct pbuf *p = desc->p;
+
+    rmii_ethernet_frame_encode_start(&encoder, words);
+
+    uint32_t crc = RMII_ETHERNET_CRC32_INIT;
+    uint tot_len = 0;
+
+#if PICO_RMII_ETHERNET_TX_CUT_THROUGH
+    struct tx_cut tx_cut = { cut, PICO_RMII_ETHERNET_TX_CUT_THROUGH_HEAD, false, false };
+
+    if (cut != NULL) {
+        // the word count is known ahead: preamble, padded frame and FCS two bytes a word, then the gap
+        uint bytes = 8 + LWIP_MAX(p->tot_len, 60) + 4;
+
+        tx_dma_block_set(eth, desc->blocks, words, (bytes + 1) / 2 + 6, eth->tx_dma_ctrl_fast);
+
+        for (struct pbuf *q = p; q != NULL && tot_len < p->tot_len; q = q->next) {
+            crc = rmii_ethernet_crc32_update(crc, q->payload, q->len);
+            netif_rmii_ethernet_tx_cut_encode(eth, desc, &encoder, &tx_cut, q->payload, q->len);
+
+            tot_len += q->len;
+        }
+
+        // no padding, the frame is longer than PICO_RMII_ETHERNET_TX_CUT_THROUGH_MIN
+        crc = ~crc;
+
+        netif_rmii_ethernet_tx_cut_encode(eth, desc, &encoder, &tx_cut, (const uint8_t*)&crc, sizeof(crc));
+
+        uint first = encoder.count;
+
+        rmii_ethernet_frame_encode_end(&encoder);
+
+        if (tx_cut.started && (tx_cut.late || !netif_rmii_ethernet_tx_cut_ahead(eth, words, encoder.count, first))) {
+            eth->stats.tx_cut_late++;
+        }
+
+        return tx_cut.started;
+    }
+#endif
+
+    for (struct pbuf *q = p; q != NULL && tot_len < p->tot_len; q = q->next) {
+        crc = rmii_ethernet_crc32_update(crc, q->payload, q->len);
+        rmii_ethernet_frame_encode(&encoder, q->payload, q->len);
+
+        tot_len += q->len;
+    }
+
+    if (tot_len < 60) {
+        // pad
+        crc = rmii_ethernet_crc32_update(crc, tx_padding, 60 - tot_len);
+        rmii_ethernet_frame_encode(&encoder, tx_padding, 60 - tot_len);
+    }
+
+    crc = ~crc;
+
+    rmii_ethernet_frame_encode(&encoder, (const uint8_t*)&crc, sizeof(crc));
+
+    uint count = rmii_ethernet_frame_encode_end(&encoder);
+
+    tx_dma_block_set(eth, desc->blocks, encoder.words, count, eth->tx_dma_ctrl_fast);
+
+    return false;
+}
+#endif
+
+// driver side of TX: FCS and DMA blocks for queued frames, then hand them to the DMA IRQ
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_process)(struct rmii_ethernet *eth) {
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+    // priority frames first, a bulk backlog is built after them
+    while (eth->tx_priority_built != eth->tx_priority_head) {
+        struct tx_descriptor *desc = &eth->tx_priority_ring[eth->tx_priority_built & TX_PRIORITY_MASK];
+
+        RMII_ETHERNET_PROFILE_RECORD(TX_WAIT, desc->t);
+
+        bool started;
+
+#if PICO_RMII_ETHERNET_100M
+        if (eth->tx_fast || PICO_RMII_ETHERNET_REF_CLK_SYNC) {
+            started = netif_rmii_ethernet_tx_fast_build(eth, desc, eth->tx_priority_fast_frames[desc - eth->tx_priority_ring], TX_CUT(eth, desc, &eth->tx_priority_built));
+        } else
+#endif
+        {
+            started = netif_rmii_ethernet_tx_build(eth, desc, TX_CUT(eth, desc, &eth->tx_priority_built));
+        }
+
+        if (started) {
+            // cut-through, the build moved tx_priority_built on
+            continue;
+        }
+
+        RMII_ETHERNET_PROFILE_RECORD(TX_ENCODE, desc->t);
+
+        uint32_t save = spin_lock_blocking(eth->tx_ring_lock);
+
+        eth->tx_priority_built++;
+
+        if (!eth->tx_busy) {
+            eth->tx_busy = true;
+            netif_rmii_ethernet_tx_next(eth);
+        }
+
+        spin_unlock(eth->tx_ring_lock, save);
+    }
+#endif
+
+    while (eth->tx_ring_built != eth->tx_ring_head) {
+        struct tx_descriptor *desc = &eth->tx_ring[eth->tx_ring_built & TX_RING_MASK];
+
+        RMII_ETHERNET_PROFILE_RECORD(TX_WAIT, desc->t);
+
+        bool started;
+
+#if PICO_RMII_ETHERNET_100M
+        if (eth->tx_fast || PICO_RMII_ETHERNET_REF_CLK_SYNC) {
+            started = netif_rmii_ethernet_tx_fast_build(eth, desc, eth->tx_fast_frames[desc - eth->tx_ring], TX_CUT(eth, desc, &eth->tx_ring_built));
+        } else
+#endif
+        {
+            started = netif_rmii_ethernet_tx_build(eth, desc, TX_CUT(eth, desc, &eth->tx_ring_built));
+        }
+
+        if (started) {
+            // cut-through, the build moved tx_ring_built on
+            continue;
+        }
+
+        RMII_ETHERNET_PROFILE_RECORD(TX_ENCODE, desc->t);
+
+        uint32_t save = spin_lock_blocking(eth->tx_ring_lock);
+
+        eth->tx_ring_built++;
+
+        if (!eth->tx_busy) {
+            eth->tx_busy = true;
+            netif_rmii_ethernet_tx_next(eth);
+        }
+
+        spin_unlock(eth->tx_ring_lock, save);
+    }
+
+#if PICO_RMII_ETHERNET_PAUSE
+    if (!eth->tx_busy && tx_pending(eth) && !tx_paused(eth)) {
+        // the pause that held the ring is over
+        uint32_t save = spin_lock_blocking(eth->tx_ring_lock);
+
+        if (!eth->tx_busy) {
+            eth->tx_busy = true;
+            netif_rmii_ethernet_tx_next(eth);
+        }
+
+        spin_unlock(eth->tx_ring_lock, save);
+    }
+#endif
+}
+
+#if PICO_RMII_ETHERNET_PAUSE
+// builds tx_pause[on] for the link speed, from lwIP context while link_pause is off
+static void netif_rmii_ethernet_pause_build(struct rmii_ethernet *eth, uint on) {
+    struct tx_descriptor *desc = &eth->tx_pause[on];
+    uint8_t *frame = eth->tx_pause_frames[on];
+    uint16_t quanta = on ? PICO_RMII_ETHERNET_PAUSE_QUANTA : 0;
+    struct pbuf p;
+
+    memcpy(&frame[0], pause_mac, ETH_HWADDR_LEN);
+    memcpy(&frame[ETH_HWADDR_LEN], eth->netif->hwaddr, ETH_HWADDR_LEN);
+    frame[12] = ETHTYPE_MAC_CONTROL >> 8;
+    frame[13] = ETHTYPE_MAC_CONTROL & 0xff;
+    frame[14] = MAC_CONTROL_PAUSE >> 8;
+    frame[15] = MAC_CONTROL_PAUSE & 0xff;
+    frame[16] = quanta >> 8;
+    frame[17] = quanta & 0xff;
+
+    // the DMA blocks point at the payload, the pbuf is only needed while they are built
+    memset(&p, 0, sizeof(p));
+    p.payload = frame;
+    p.len = p.tot_len = PAUSE_FRAME_SIZE;
+    desc->p = &p;
+
+#if PICO_RMII_ETHERNET_100M
+    if (eth->tx_fast || PICO_RMII_ETHERNET_REF_CLK_SYNC) {
+        netif_rmii_ethernet_tx_fast_build(eth, desc, eth->tx_pause_fast_frames[on], NULL);
+    } else
+#endif
+    {
+        netif_rmii_ethernet_tx_build(eth, desc, NULL);
+    }
+
+    desc->p = NULL;
+}
+
+// asks the link partner to pause, or to go on, from the CRS_DV IRQ or the driver. One that
+// hasn't gone out yet is replaced, only the last word counts
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_pause_send)(struct rmii_ethernet *eth, bool on) {
+    uint32_t save = spin_lock_blocking(eth->tx_ring_lock);
+
+    eth->tx_control = &eth->tx_pause[on];
+    eth->tx_pause_sent++;
+    eth->rx_pause_sent = on;
+    eth->rx_pause_us = timebase_us();
+
+    if (!eth->tx_busy) {
+        eth->tx_busy = true;
+        netif_rmii_ethernet_tx_next(eth);
+    }
+
+    spin_unlock(eth->tx_ring_lock, save);
+}
+
+// from the driver: lets the partner go on once lwIP has caught up, or asks again before
+// the last pause runs out
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_pause_service)(struct rmii_ethernet *eth) {
+    if (!eth->rx_pause_sent || !eth->link_pause) {
+        return;
+    }
+
+    if ((eth->rx_ring_head - eth->rx_ring_tail) <= PICO_RMII_ETHERNET_PAUSE_LOW) {
+        netif_rmii_ethernet_pause_send(eth, false);
+    } else if ((timebase_us() - eth->rx_pause_us) >= eth->rx_pause_refresh_us) {
+        netif_rmii_ethernet_pause_send(eth, true);
+    }
+}
+
+// a PAUSE frame, FCS checked
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_pause_frame)(const uint8_t *frame, uint length) {
+    return length >= PAUSE_FRAME_SIZE &&
+        ((frame[12] << 8) | frame[13]) == ETHTYPE_MAC_CONTROL &&
+        ((frame[14] << 8) | frame[15]) == MAC_CONTROL_PAUSE;
+}
+
+// holds the TX ring for the quanta a PAUSE frame asks for, 0 lets it go on
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_pause_take)(struct rmii_ethernet *eth, const uint8_t *frame) {
+    uint quanta = (frame[16] << 8) | frame[17];
+
+    eth->rx_pause_received++;
+
+    if (!eth->link_pause) {
+        // not negotiated, a partner that sends them anyway isn't honoured
+        return;
+    }
+
+    // quanta of 512 bit times, link_speed bits a us
+    eth->tx_pause_until = timebase_us() + (quanta * 512 + eth->link_speed - 1) / eth->link_speed;
+}
+
+// from the link callbacks: PAUSE frames on a full duplex link the partner advertised them on
+static void netif_rmii_ethernet_pause_link(struct rmii_ethernet *eth, bool up) {
+    eth->link_pause = false;
+    eth->rx_pause_sent = false;
+    eth->tx_pause_until = timebase_us();
+
+    if (!up || !eth->link_pause_partner || eth->link_duplex != NETIF_RMII_ETHERNET_DUPLEX_FULL) {
+        return;
+    }
+
+    netif_rmii_ethernet_pause_build(eth, 0);
+    netif_rmii_ethernet_pause_build(eth, 1);
+
+    eth->rx_pause_refresh_us = PICO_RMII_ETHERNET_PAUSE_QUANTA * 512 / eth->link_speed / 2;
+
+    __dmb();
+
+    eth->link_pause = true;
+}
+#endif
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+// a frame for the priority TX ring: ARP, or IP with a DSCP of
+// PICO_RMII_ETHERNET_TX_PRIORITY_DSCP or more, or tagged with a PCP of it >> 3 or more.
+// lwIP has the Ethernet and IP headers in the first pbuf
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_priority_match)(const struct pbuf *p) {
+    const uint8_t *frame = p->payload;
+
+    if (p->len < SIZEOF_ETH_HDR + 2) {
+        return false;
+    }
+
+    uint16_t type = (frame[12] << 8) | frame[13];
+    uint dscp;
+
+    switch (type) {
+    case ETHTYPE_ARP:
+        return true;
+    case ETHTYPE_VLAN:
+        return (frame[14] >> 5) >= (PICO_RMII_ETHERNET_TX_PRIORITY_DSCP >> 3);
+    case ETHTYPE_IP:
+        dscp = frame[15] >> 2;
+        break;
+    case ETHTYPE_IPV6:
+        // the traffic class straddles the first two bytes
+        dscp = ((frame[14] & 0x0f) << 2) | (frame[15] >> 6);
+        break;
+    default:
+        return false;
+    }
+
+    return dscp >= PICO_RMII_ETHERNET_TX_PRIORITY_DSCP;
+}
+#endif
+
+static err_t RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_output)(struct netif *netif, struct pbuf *p)
+{
+    struct rmii_ethernet *eth = netif->state;
+    struct tx_descriptor *desc;
+
+    netif_rmii_ethernet_tx_release(eth);
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+    bool priority = netif_rmii_ethernet_tx_priority_match(p);
+
+    if (priority) {
+        // a pause holds this ring too, the DMA IRQ drains it before any bulk frame
+        if ((eth->tx_priority_head - eth->tx_priority_tail) == PICO_RMII_ETHERNET_TX_PRIORITY_RING_SIZE) {
+            uint32_t start = timebase_us();
+
+            while ((eth->tx_priority_head - eth->tx_priority_tail) == PICO_RMII_ETHERNET_TX_PRIORITY_RING_SIZE) {
+                tight_loop_contents();
+
+#if PICO_RMII_ETHERNET_PAUSE && !PICO_RMII_ETHERNET_DUAL_CORE
+                netif_rmii_ethernet_tx_process(eth);
+#endif
+
+                netif_rmii_ethernet_tx_release(eth);
+            }
+
+            eth->stats.tx_busy_wait_us += timebase_us() - start;
+        }
+
+        desc = &eth->tx_priority_ring[eth->tx_priority_head & TX_PRIORITY_MASK];
+    } else
+#endif
+    if ((eth->tx_ring_head - eth->tx_ring_tail) == PICO_RMII_ETHERNET_TX_RING_SIZE) {
+        uint32_t start = timebase_us();
+
+        while ((eth->tx_ring_head - eth->tx_ring_tail) == PICO_RMII_ETHERNET_TX_RING_SIZE) {
+            // ring full, wait for the oldest frame to go out
+            tight_loop_contents();
+
+#if PICO_RMII_ETHERNET_PAUSE && !PICO_RMII_ETHERNET_DUAL_CORE
+            // or for the end of a pause holding it
+            netif_rmii_ethernet_tx_process(eth);
+#endif
+
+            netif_rmii_ethernet_tx_release(eth);
+        }
+
+        eth->stats.tx_busy_wait_us += timebase_us() - start;
+    }
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+    if (!priority)
+#endif
+    {
+        desc = &eth->tx_ring[eth->tx_ring_head & TX_RING_MASK];
+    }
+
+    if (pbuf_clen(p) > PICO_RMII_ETHERNET_TX_CHAIN_MAX) {
+        p = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+
+        if (p == NULL) {
+            eth->stats.tx_nobuf++;
+            LINK_STATS_INC(link.memerr);
+            LINK_STATS_INC(link.drop);
+            MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+
+            return ERR_MEM;
+        }
+    } else {
+        pbuf_ref(p);
+    }
+
+    eth->stats.tx_ok++;
+    LINK_STATS_INC(link.xmit);
+    MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
+
+    if (((uint8_t *)p->payload)[0] & 0x01) {
+        MIB2_STATS_NETIF_INC(netif, ifoutnucastpkts);
+    } else {
+        MIB2_STATS_NETIF_INC(netif, ifoutucastpkts);
+    }
+
+    RMII_ETHERNET_CAPTURE_TX(p);
+
+    desc->p = p;
+    RMII_ETHERNET_PROFILE_STAMP(desc->t);
+
+    __dmb();
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+    if (priority) {
+        eth->tx_priority_head++;
+    } else
+#endif
+    {
+        eth->tx_ring_head++;
+    }
+
+#if PICO_RMII_ETHERNET_DUAL_CORE
+    netif_rmii_ethernet_doorbell();
+#else
+    netif_rmii_ethernet_tx_process(eth);
+#endif
+
+    return ERR_OK;
+}
+
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_start)(struct rmii_ethernet *eth, struct rx_descriptor *desc) {
+#if PICO_RMII_ETHERNET_RX_PEEK
+    dma_channel_configure(
+        eth->rx_dma_rest_chan, &eth->rx_dma_rest_channel_config,
+        desc->frame + RX_PEEK_SIZE,
+        RX_DMA_READ_ADDR,
+        RX_DMA_MAX - RX_PEEK_DMA,
+        false
+    );
+
+    dma_channel_configure(
+        eth->rx_dma_chan, &eth->rx_dma_channel_config,
+        desc->frame,
+        RX_DMA_READ_ADDR,
+        RX_PEEK_DMA,
+        true
+    );
+#else
+    dma_channel_configure(
+        eth->rx_dma_chan, &eth->rx_dma_channel_config,
+        desc->frame,
+        RX_DMA_READ_ADDR,
+        RX_DMA_MAX,
+        true
+    );
+#endif
+
+    if (!eth->rx_sm_init) {
+        // the SM was restarted in place at the end of the last frame, DMA takes over from
+        // anything of this one already in the FIFO
+        return;
+    }
+
+    eth->rx_sm_init = false;
+
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    rmii_ethernet_phy_rx_sync_init(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX, eth->rx_sm_offset, PICO_RMII_ETHERNET_RX_PIN, eth->rx_fast, eth->ref_clk_loops, RX_PUSH_BITS);
+#else
+    rmii_ethernet_phy_rx_init(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX, eth->rx_sm_offset, PICO_RMII_ETHERNET_RX_PIN, eth->rx_clkdiv, RX_PUSH_BITS);
+#endif
+}
+
+#if PICO_RMII_ETHERNET_RX_FILTER
+// the bin of a multicast MAC, from its last 3 bytes where IPv4 (01:00:5e) and IPv6 (33:33)
+// groups differ
+static inline uint rx_filter_bin(const uint8_t *mac) {
+    return (mac[3] ^ mac[4] ^ mac[5]) & (RX_FILTER_HASH_BINS - 1);
+}
+
+// destination MAC and EtherType of a frame DMA has just finished, from the CRS_DV IRQ
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_accept)(struct rmii_ethernet *eth, const uint8_t *frame) {
+    if (eth->rx_filter_promiscuous) {
+        return true;
+    }
+
+    if (frame[0] & 0x01) {
+        bool broadcast = (frame[0] & frame[1] & frame[2] & frame[3] & frame[4] & frame[5]) == 0xff;
+
+#if !LWIP_IGMP
+        // lwIP takes every IPv4 group without IGMP
+        broadcast |= (frame[0] == 0x01 && frame[1] == 0x00 && frame[2] == 0x5e);
+#endif
+#if LWIP_IPV6 && !LWIP_IPV6_MLD
+        broadcast |= (frame[0] == 0x33 && frame[1] == 0x33);
+#endif
+
+        if (!broadcast && eth->rx_filter_hash[rx_filter_bin(frame)] == 0) {
+            return false;
+        }
+    } else {
+        for (int i = 0; i < ETH_HWADDR_LEN; i++) {
+            if (frame[i] != eth->netif->hwaddr[i]) {
+                return false;
+            }
+        }
+    }
+
+    uint16_t type = (frame[12] << 8) | frame[13];
+    uint count = eth->rx_filter_type_count;
+
+    for (uint i = 0; i < count; i++) {
+        if (eth->rx_filter_types[i] == type) {
+            return true;
+        }
+    }
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    // the priority EtherType isn't lwIP's
+    return type != 0 && type == eth->rx_priority_type && eth->rx_priority_callback != NULL;
+#else
+    return false;
+#endif
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+// the class of a frame DMA has just finished, from the CRS_DV IRQ. received counts the
+// FCS too, a header that is in is past it
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_priority_match)(struct rmii_ethernet *eth, const uint8_t *frame, uint received) {
+    if (eth->rx_priority_callback == NULL || received < SIZEOF_ETH_HDR) {
+        return false;
+    }
+
+    uint16_t type = (frame[12] << 8) | frame[13];
+    uint16_t port = eth->rx_priority_port;
+    const uint8_t *ip = frame + SIZEOF_ETH_HDR;
+    uint udp;
+
+    if (type != 0 && type == eth->rx_priority_type) {
+        return true;
+    }
+
+    if (port == 0) {
+        return false;
+    }
+
+    if (type == ETHTYPE_IP) {
+        // version 4, a header length of 5 words or more, UDP, neither MF nor a fragment offset
+        if (received < (SIZEOF_ETH_HDR + IP_HLEN + UDP_HLEN) || (ip[0] & 0xf0) != 0x40 || (ip[0] & 0x0f) < 5 ||
+            ip[9] != IP_PROTO_UDP || (ip[6] & 0x3f) != 0 || ip[7] != 0) {
+            return false;
+        }
+
+        udp = SIZEOF_ETH_HDR + (ip[0] & 0x0f) * 4;
+    } else if (type == ETHTYPE_IPV6) {
+        // UDP right after the fixed header, extension headers aren't followed
+        if (received < (SIZEOF_ETH_HDR + IP6_HLEN + UDP_HLEN) || ip[6] != IP6_NEXTH_UDP) {
+            return false;
+        }
+
+        udp = SIZEOF_ETH_HDR + IP6_HLEN;
+    } else {
+        return false;
+    }
+
+    return received >= (udp + UDP_HLEN) && ((frame[udp + 2] << 8) | frame[udp + 3]) == port;
+}
+
+// a priority frame came in at desc, an RX ring slot or, rx_landing, the free priority slot
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_priority_take)(struct rmii_ethernet *eth, struct rx_descriptor *desc, uint received) {
+    uint head = eth->rx_priority_head;
+    struct rx_descriptor *slot = &eth->rx_priority_ring[head & RX_PRIORITY_MASK];
+
+    if ((head - eth->rx_priority_tail) > RX_PRIORITY_MASK) {
+        // the callback is behind on all its buffers, the slot takes the next frame
+        eth->rx_priority_overrun++;
+
+        return;
+    }
+
+    if (slot != desc) {
+        // the priority slot keeps the frame, the RX ring slot takes the next one into its buffer
+        uint8_t *frame = slot->frame;
+
+        slot->frame = desc->frame;
+        desc->frame = frame;
+#if PICO_RMII_ETHERNET_RX_ZERO_COPY
+        struct rx_pbuf *buf = slot->buf;
+
+        slot->buf = desc->buf;
+        desc->buf = buf;
+#endif
+    }
+
+    slot->received = received;
+    slot->received_us = timebase_us();
+    eth->rx_priority_head = head + 1;
+
+    netif_rmii_ethernet_wake_from_isr();
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RX_POLICE
+// true when the bucket is full again: its time is now, or behind now by more than a bucket
+// can be ahead, which also holds across the wrap of any time idle
+static inline bool rx_police_idle(uint32_t tat, const struct rx_police_rate *rate, uint32_t now) {
+    uint32_t ahead = tat - now;
+
+    return ahead == 0 || ahead > (rate->tolerance_us + rate->interval_us);
+}
+
+// a frame against a bucket: true when it conforms, and the bucket takes it
+static inline bool rx_police_take(uint32_t *tat, const struct rx_police_rate *rate, uint32_t now) {
+    uint32_t interval = rate->interval_us;
+
+    if (interval == 0) {
+        return true;
+    }
+
+    uint32_t ahead = rx_police_idle(*tat, rate, now) ? 0 : (*tat - now);
+
+    if (ahead > rate->tolerance_us) {
+        return false;
+    }
+
+    *tat = now + ahead + interval;
+
+    return true;
+}
+
+// the class of a frame, and the key of its source: the IPv4 source address, else the source
+// MAC. received counts the FCS too, a header that is in is past it
+static uint RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_police_class)(const uint8_t *frame, uint received, uint32_t *key) {
+    uint16_t type = (frame[12] << 8) | frame[13];
+    uint offset = SIZEOF_ETH_HDR;
+    uint8_t proto;
+
+    if (type == ETHTYPE_VLAN && received >= (SIZEOF_ETH_HDR + SIZEOF_VLAN_HDR)) {
+        type = (frame[16] << 8) | frame[17];
+        offset += SIZEOF_VLAN_HDR;
+    }
+
+    const uint8_t *ip = frame + offset;
+    bool ip4 = type == ETHTYPE_IP && received >= (offset + IP_HLEN) && (ip[0] & 0xf0) == 0x40;
+
+    if (ip4) {
+        key[0] = 0;
+        key[1] = (ip[12] << 24) | (ip[13] << 16) | (ip[14] << 8) | ip[15];
+    } else {
+        key[0] = 0x10000 | (frame[6] << 8) | frame[7];
+        key[1] = (frame[8] << 24) | (frame[9] << 16) | (frame[10] << 8) | frame[11];
+    }
+
+    if (frame[0] & 0x01) {
+        return NETIF_RMII_ETHERNET_RX_POLICE_BROADCAST;
+    }
+
+    if (type == ETHTYPE_ARP) {
+        return NETIF_RMII_ETHERNET_RX_POLICE_ARP;
+    }
+
+    if (ip4 && (ip[6] & 0x1f) == 0 && ip[7] == 0) {
+        proto = ip[9];
+    } else if (type == ETHTYPE_IPV6 && received >= (offset + IP6_HLEN)) {
+        // the next header after the fixed one, extension headers aren't followed
+        proto = ip[6];
+    } else {
+        return NETIF_RMII_ETHERNET_RX_POLICE_OTHER;
+    }
+
+    switch (proto) {
+    case IP_PROTO_ICMP:
+    case IP6_NEXTH_ICMP6:
+        return NETIF_RMII_ETHERNET_RX_POLICE_ICMP;
+    case IP_PROTO_TCP:
+        return NETIF_RMII_ETHERNET_RX_POLICE_TCP;
+    case IP_PROTO_UDP:
+        return NETIF_RMII_ETHERNET_RX_POLICE_UDP;
+    default:
+        return NETIF_RMII_ETHERNET_RX_POLICE_OTHER;
+    }
+}
+
+// the bucket of a source: one of the two its hash picks that it has, or one of them that is
+// idle, taken over. With both held by busy sources it shares the first
+static uint32_t *RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_police_source)(struct rmii_ethernet *eth, const uint32_t *key, uint32_t now) {
+    const struct rx_police_rate *rate = &eth->rx_police_rates[NETIF_RMII_ETHERNET_RX_POLICE_SOURCE];
+    uint32_t hash = (key[0] ^ key[1] ^ (key[1] >> 16)) * 0x9e3779b1u;
+    struct rx_police_source *first = &eth->rx_police_sources[(hash >> 16) & (PICO_RMII_ETHERNET_RX_POLICE_SOURCES - 1)];
+    struct rx_police_source *second = &eth->rx_police_sources[((hash >> 16) ^ 1) & (PICO_RMII_ETHERNET_RX_POLICE_SOURCES - 1)];
+    struct rx_police_source *source;
+
+    if (first->key[0] == key[0] && first->key[1] == key[1]) {
+        return &first->tat;
+    }
+
+    if (second->key[0] == key[0] && second->key[1] == key[1]) {
+        return &second->tat;
+    }
+
+    if (rx_police_idle(first->tat, rate, now)) {
+        source = first;
+    } else if (rx_police_idle(second->tat, rate, now)) {
+        source = second;
+    } else {
+        eth->rx_police_shared++;
+
+        return &first->tat;
+    }
+
+    source->key[0] = key[0];
+    source->key[1] = key[1];
+    source->tat = now;
+
+    return &source->tat;
+}
+
+// a frame DMA has just finished through its source's bucket and its class's, from the
+// CRS_DV IRQ: false when one of them drops it
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_police)(struct rmii_ethernet *eth, const uint8_t *frame, uint received) {
+    uint32_t key[2];
+    uint police = netif_rmii_ethernet_rx_police_class(frame, received, key);
+    uint32_t now = timebase_us();
+    const struct rx_police_rate *source_rate = &eth->rx_police_rates[NETIF_RMII_ETHERNET_RX_POLICE_SOURCE];
+
+    // the source first, a flood from one of them doesn't use up its class
+    if (source_rate->interval_us != 0 &&
+        !rx_police_take(netif_rmii_ethernet_rx_police_source(eth, key, now), source_rate, now)) {
+        eth->rx_police_dropped[NETIF_RMII_ETHERNET_RX_POLICE_SOURCE]++;
+
+        return false;
+    }
+
+    if (!rx_police_take(&eth->rx_police_tat[police], &eth->rx_police_rates[police], now)) {
+        eth->rx_police_dropped[police]++;
+
+        return false;
+    }
+
+    return true;
+}
+#endif
+
+// the descriptor RX is armed into
+static inline struct rx_descriptor *rx_armed(struct rmii_ethernet *eth) {
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    if (eth->rx_landing) {
+        return &eth->rx_priority_ring[eth->rx_priority_head & RX_PRIORITY_MASK];
+    }
+#endif
+
+    return &eth->rx_ring[eth->rx_ring_head & RX_RING_MASK];
+}
+
+// the descriptor RX goes on into, from the CRS_DV IRQ or with it held off. NULL while the
+// ring is full or its next slot has no zero copy buffer, and no priority slot is free
+static struct rx_descriptor *RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_next)(struct rmii_ethernet *eth) {
+    struct rx_descriptor *desc = &eth->rx_ring[eth->rx_ring_head & RX_RING_MASK];
+
+    if ((eth->rx_ring_head - eth->rx_ring_tail) <= RX_RING_MASK && desc->frame != NULL) {
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+        eth->rx_landing = false;
+#endif
+
+        return desc;
+    }
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    if (eth->rx_priority_callback != NULL && (eth->rx_priority_head - eth->rx_priority_tail) <= RX_PRIORITY_MASK) {
+        // lwIP is behind, priority frames still come in and go past it
+        eth->rx_landing = true;
+
+        return &eth->rx_priority_ring[eth->rx_priority_head & RX_PRIORITY_MASK];
+    }
+#endif
+
+    return NULL;
+}
+
+#if PICO_RMII_ETHERNET_RX_PEEK
+// stops both RX channels, the rest one first so the header one can't chain to it
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_dma_abort)(struct rmii_ethernet *eth) {
+    dma_channel_abort(eth->rx_dma_rest_chan);
+    dma_channel_abort(eth->rx_dma_chan);
+    dma_channel_abort(eth->rx_dma_rest_chan);
+
+    // a header that completed before the abort isn't looked at any more
+    dma_hw->ints1 = 1u << eth->rx_dma_chan;
+}
+
+// the header of the frame being received is in
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_peek_irq)(struct rmii_ethernet *eth) {
+    if (!(dma_hw->ints1 & (1u << eth->rx_dma_chan))) {
+        return;
+    }
+
+    dma_hw->ints1 = 1u << eth->rx_dma_chan;
+
+    struct rx_descriptor *desc = rx_armed(eth);
+
+    if (eth->rx_stalled || netif_rmii_ethernet_rx_accept(eth, desc->frame)) {
+        return;
+    }
+
+    // not for this netif: drop the rest, RX waits for the end of the frame and the next one
+    rmii_ethernet_phy_rx_restart(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX, eth->rx_sm_offset);
+    netif_rmii_ethernet_rx_dma_abort(eth);
+    rmii_ethernet_phy_rx_flush(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX);
+
+    eth->rx_filtered++;
+    eth->rx_peek_rearmed = true;
+
+    netif_rmii_ethernet_rx_start(eth, desc);
+}
+
+// DMA_IRQ_1, shared with the application
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_peek_handler)() {
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        netif_rmii_ethernet_rx_peek_irq(&rmii_eth_instances[i]);
+    }
+}
+#endif
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+// the counts pushed since the last end of a frame: the first is the start of the frame
+// that just ended, the rest are CRS_DV toggling at its end or frames RX was too late for
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_timestamp_take)(struct rmii_ethernet *eth, uint32_t *timestamp) {
+    bool taken = false;
+
+    if (eth->timestamp_state != TIMESTAMP_RX) {
+        // the SM is on TX-EN, its counts are lwIP context's
+        return false;
+    }
+
+    while (!pio_sm_is_rx_fifo_empty(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TIMESTAMP)) {
+        uint32_t count = pio_sm_get(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TIMESTAMP);
+
+        if (!taken) {
+            *timestamp = count + eth->timestamp_sfd;
+            taken = true;
+        }
+    }
+
+    return taken;
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RX_WORD
+// the end of a frame in words, with the SM restarted in place and received bytes in from
+// DMA. Words DMA was too late for are still in the FIFO, the last 0 to 3 bytes in the top of
+// the shift register. Zero dibits shifted in after them move them down until the autopush, which puts
+// them at the bottom of a word, the number shifted in tells how many bits they were. Returns
+// the bytes in the frame buffer, whole bytes only like RX in bytes takes them
+static uint RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_tail)(struct rmii_ethernet *eth, uint8_t *frame, uint received) {
+    PIO pio = PICO_RMII_ETHERNET_PIO;
+    uint sm = PICO_RMII_ETHERNET_SM_RX;
+
+    while (!pio_sm_is_rx_fifo_empty(pio, sm)) {
+        uint32_t word = pio_sm_get(pio, sm);
+
+        if (received < (RX_DMA_MAX << RX_DMA_SHIFT)) {
+            memcpy(&frame[received], &word, 4);
+            received += 4;
+        }
+    }
+
+    // 15 fill a shift register that had 1 dibit, 16 would push an empty one
+    for (uint pad = 0; pad < 15; pad++) {
+        pio_sm_exec(pio, sm, pio_encode_in(pio_null, 2));
+
+        if (!pio_sm_is_rx_fifo_empty(pio, sm)) {
+            uint32_t word = pio_sm_get(pio, sm);
+            uint bytes = (32 - 2 * (pad + 1)) / 8;
+
+            if (received < (RX_DMA_MAX << RX_DMA_SHIFT)) {
+                memcpy(&frame[received], &word, bytes);
+                received += bytes;
+            }
+
+            break;
+        }
+    }
+
+    return received;
+}
+#endif
+
+// the end of a frame, or of a frame that went by while RX was stalled
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_dv_falling)(struct rmii_ethernet *eth) {
+#if PICO_RMII_ETHERNET_TIMESTAMP
+    uint32_t timestamp = 0;
+    bool timestamped = netif_rmii_ethernet_timestamp_take(eth, &timestamp);
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PEEK
+    if (eth->rx_peek_rearmed) {
+        // the end of a frame the header interrupt dropped, its slot already waits for the next
+        eth->rx_peek_rearmed = false;
+
+        return;
+    }
+#endif
+
+    if (eth->rx_stalled) {
+        // a frame went by with no buffer armed for it
+        eth->rx_overrun++;
+    } else {
+        // the SM waits for the next preamble straight away, it keeps running
+        rmii_ethernet_phy_rx_restart(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX, eth->rx_sm_offset);
+#if PICO_RMII_ETHERNET_RX_PEEK
+        // the rest channel only counts once the header one has chained to it
+        uint received = RX_PEEK_DMA - dma_hw->ch[eth->rx_dma_chan].transfer_count;
+
+        if (received == RX_PEEK_DMA) {
+            received += RX_DMA_MAX - RX_PEEK_DMA - dma_hw->ch[eth->rx_dma_rest_chan].transfer_count;
+        }
+
+        netif_rmii_ethernet_rx_dma_abort(eth);
+#else
+        uint received = RX_DMA_MAX - dma_hw->ch[eth->rx_dma_chan].transfer_count;
+        dma_channel_abort(eth->rx_dma_chan); //dma_hw->abort = 1u << eth->rx_dma_chan;
+#endif
+
+        struct rx_descriptor *desc = rx_armed(eth);
+
+#if PICO_RMII_ETHERNET_RX_WORD
+        received = netif_rmii_ethernet_rx_tail(eth, desc->frame, received << RX_DMA_SHIFT);
+#endif
+        rmii_ethernet_phy_rx_flush(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX);
+
+#if PICO_RMII_ETHERNET_RX_FILTER
+        if (received >= SIZEOF_ETH_HDR && !netif_rmii_ethernet_rx_accept(eth, desc->frame)) {
+            // not for this netif, the slot takes the next frame. Runts go on to fail their FCS check
+            eth->rx_filtered++;
+        } else
+#endif
+#if PICO_RMII_ETHERNET_RX_POLICE
+        if (received >= SIZEOF_ETH_HDR && !netif_rmii_ethernet_rx_police(eth, desc->frame, received)) {
+            // over a rate, the slot takes the next frame
+        } else
+#endif
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+        if (netif_rmii_ethernet_rx_priority_match(eth, desc->frame, received)) {
+            netif_rmii_ethernet_rx_priority_take(eth, desc, received);
+        } else if (eth->rx_landing) {
+            // no room for it in the RX ring
+            if (received != 0) {
+                eth->rx_overrun++;
+            }
+        } else
+#endif
+        if (received != 0) {
+            // hand the filled slot to the poll loop and move on to the next one
+            desc->received = received;
+#if PICO_RMII_ETHERNET_TIMESTAMP
+            desc->timestamp = timestamp;
+            desc->timestamped = timestamped;
+#endif
+            RMII_ETHERNET_PROFILE_STAMP(desc->t);
+            eth->rx_ring_head++;
+
+#if PICO_RMII_ETHERNET_PAUSE
+            if (eth->link_pause && !eth->rx_pause_sent &&
+                (eth->rx_ring_head - eth->rx_ring_tail) >= PICO_RMII_ETHERNET_PAUSE_HIGH) {
+                // lwIP is falling behind, ask the partner to wait for it
+                netif_rmii_ethernet_pause_send(eth, true);
+            }
+#endif
+
+            netif_rmii_ethernet_wake_from_isr();
+        }
+
+        desc = netif_rmii_ethernet_rx_next(eth);
+
+        if (desc == NULL) {
+            // ring full or out of buffers, netif_rmii_ethernet_poll() re-arms once a slot is drained.
+            // The SM stops so the FIFO doesn't fill with a frame nobody takes
+            pio_sm_set_enabled(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX, false);
+            eth->rx_sm_init = true;
+            eth->rx_stalled = true;
+
+            return;
+        }
+
+        netif_rmii_ethernet_rx_start(eth, desc);
+    }
+}
+
+// the core's GPIO IRQ callback, the CRS_DV pins of all interfaces on the core that polls the driver
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_dv_falling_callback)(uint gpio, uint32_t events) {
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        struct rmii_ethernet *eth = &rmii_eth_instances[i];
+
+        if ((PICO_RMII_ETHERNET_RX_PIN + 2) == gpio) {
+            netif_rmii_ethernet_rx_dv_falling(eth);
+        }
+    }
+}
+
+// (re)starts the TX state machine with the program for the speed
+static void netif_rmii_ethernet_tx_sm_init(struct rmii_ethernet *eth, bool fast) {
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    if (fast) {
+        rmii_ethernet_phy_tx_sync_fast_init(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TX, eth->tx_fast_sm_offset, PICO_RMII_ETHERNET_TX_PIN);
+    } else {
+        rmii_ethernet_phy_tx_sync_init(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TX, eth->tx_sm_offset, PICO_RMII_ETHERNET_TX_PIN, eth->ref_clk_loops);
+    }
+#else
+#if PICO_RMII_ETHERNET_100M
+    if (fast) {
+        rmii_ethernet_phy_tx_fast_init(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TX, eth->tx_fast_sm_offset, PICO_RMII_ETHERNET_TX_PIN);
+
+        return;
+    }
+#endif
+    rmii_ethernet_phy_tx_init(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TX, eth->tx_sm_offset, PICO_RMII_ETHERNET_TX_PIN);
+#endif
+}
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+// 64 bit times of preamble and SFD
+static uint32_t netif_rmii_ethernet_timestamp_sfd(bool fast) {
+    return (netif_rmii_ethernet_timestamp_hz() / 1000000) * 64 / (fast ? 100 : 10);
+}
+#endif
+
+static void netif_rmii_ethernet_speed_set(struct rmii_ethernet *eth, bool fast) {
+#if PICO_RMII_ETHERNET_TIMESTAMP
+    eth->timestamp_sfd = netif_rmii_ethernet_timestamp_sfd(fast);
+#endif
+
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    // RX picks the speed up when it is next re-armed
+    eth->rx_fast = fast;
+#else
+    // RX picks the divider up when it is next re-armed
+    eth->rx_clkdiv = fast ? 1 : 10;
+#endif
+    eth->rx_sm_init = true;
+
+#if PICO_RMII_ETHERNET_100M
+    if (fast == eth->tx_fast) {
+        return;
+    }
+
+    // let queued frames drain before swapping the TX program
+    while (eth->tx_busy || !pio_sm_is_tx_fifo_empty(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TX)) {
+        tight_loop_contents();
+    }
+
+    pio_sm_set_enabled(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TX, false);
+
+    eth->tx_fast = fast;
+
+    netif_rmii_ethernet_tx_sm_init(eth, eth->tx_fast);
+#endif
+}
+
+static void netif_rmii_ethernet_link_speed(uint16_t value, void *arg) {
+    struct rmii_ethernet *eth = arg;
+    // LAN8720 special control/status register, speed indication x1x is 100BASE-TX and
+    // 1xx full duplex
+    uint speed_indication = (value >> 2) & 0x07;
+    bool fast = (speed_indication & 0x02) != 0;
+
+    netif_rmii_ethernet_speed_set(eth, fast);
+
+    // before netif_set_link_up(), the link callback reads it
+    eth->link_speed = fast ? 100 : 10;
+    eth->link_duplex = (speed_indication & 0x04) ? NETIF_RMII_ETHERNET_DUPLEX_FULL : NETIF_RMII_ETHERNET_DUPLEX_HALF;
+
+#if PICO_RMII_ETHERNET_PAUSE
+    netif_rmii_ethernet_pause_link(eth, true);
+#endif
+
+#if MIB2_STATS
+    eth->netif->link_speed = eth->link_speed * 1000000;
+#endif
+    MIB2_COPY_SYSUPTIME_TO(&eth->netif->ts);
+
+    RMII_ETHERNET_TRACE(RMII_LINK_UP, eth->link_speed, 0, 0);
+    netif_set_link_up(eth->netif);
+}
+
+#if PICO_RMII_ETHERNET_PAUSE
+static void netif_rmii_ethernet_link_partner(uint16_t value, void *arg) {
+    struct rmii_ethernet *eth = arg;
+
+    // link partner ability register, PAUSE is bit 10
+    eth->link_pause_partner = (value & 0x400) != 0;
+}
+#endif
+
+static void netif_rmii_ethernet_link_status(uint16_t value, void *arg) {
+    struct rmii_ethernet *eth = arg;
+    uint16_t link_status = (value & 0x04) >> 2;
+
+    if (eth->phy_loopback) {
+        // a check queued before the loopback was set up
+        return;
+    }
+
+    if (netif_is_link_up(eth->netif) ^ link_status) {
+        if (link_status) {
+            // autonegotiation is done, pick up its result before reporting the link,
+            // if the MDIO queue is full the next check retries
+#if PICO_RMII_ETHERNET_PAUSE
+            // the partner's abilities come back first, the queue runs in order
+            netif_rmii_ethernet_mdio_queue(eth, eth->phy_address, 5, false, 0, netif_rmii_ethernet_link_partner, eth);
+#endif
+            netif_rmii_ethernet_mdio_queue(eth, eth->phy_address, 31, false, 0, netif_rmii_ethernet_link_speed, eth);
+        } else {
+#if PICO_RMII_ETHERNET_PAUSE
+            netif_rmii_ethernet_pause_link(eth, false);
+#endif
+            eth->stats.link_flaps++;
+            RMII_ETHERNET_TRACE(RMII_LINK_DOWN, eth->stats.link_flaps, 0, 0);
+            eth->link_speed = 0;
+            MIB2_COPY_SYSUPTIME_TO(&eth->netif->ts);
+            netif_set_link_down(eth->netif);
+        }
+    }
+}
+
+static void netif_rmii_ethernet_link_check(void *arg) {
+    struct rmii_ethernet *eth = arg;
+
+    if (!eth->phy_loopback) {
+        netif_rmii_ethernet_mdio_queue(eth, eth->phy_address, 1, false, 0, netif_rmii_ethernet_link_status, eth);
+    }
+
+    sys_timeout(netif_is_link_up(eth->netif) ? PICO_RMII_ETHERNET_LINK_POLL_MS : PICO_RMII_ETHERNET_LINK_POLL_DOWN_MS, netif_rmii_ethernet_link_check, eth);
+}
+
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+// loads a REF_CLK program with its `wait gpio` instructions on the REF_CLK pin and, for a
+// delay_offset of 0 or more, delay cycles on the instruction there
+static uint netif_rmii_ethernet_ref_clk_program_add(struct rmii_ethernet *eth, const pio_program_t *program, int delay_offset, uint delay) {
+    uint16_t instructions[PIO_INSTRUCTION_COUNT];
+    pio_program_t patched = *program;
+
+    for (uint i = 0; i < program->length; i++) {
+        uint16_t instr = program->instructions[i];
+
+        // WAIT is 001 in bits 15:13, source GPIO 00 in bits 6:5 and the GPIO in 4:0
+        if ((instr & 0xe060) == 0x2000) {
+            instr = (instr & ~0x1fu) | eth->config.ref_clk_pin;
+        }
+
+        if ((int)i == delay_offset) {
+            instr |= pio_encode_delay(delay);
+        }
+
+        instructions[i] = instr;
+    }
+
+    patched.instructions = instructions;
+
+    return pio_add_program(PICO_RMII_ETHERNET_PIO, &patched);
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RX_FILTER && LWIP_IGMP
+static err_t netif_rmii_ethernet_igmp_mac_filter(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action) {
+    uint32_t addr = lwip_ntohl(ip4_addr_get_u32(group));
+    const uint8_t mac[ETH_HWADDR_LEN] = { 0x01, 0x00, 0x5e, (addr >> 16) & 0x7f, addr >> 8, addr };
+
+    return netif_rmii_ethernet_netif_mac_filter(netif, mac, action);
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RX_FILTER && LWIP_IPV6 && LWIP_IPV6_MLD
+static err_t netif_rmii_ethernet_mld_mac_filter(struct netif *netif, const ip6_addr_t *group, enum netif_mac_filter_action action) {
+    uint32_t addr = lwip_ntohl(group->addr[3]);
+    const uint8_t mac[ETH_HWADDR_LEN] = { 0x33, 0x33, addr >> 24, addr >> 16, addr >> 8, addr };
+
+    return netif_rmii_ethernet_netif_mac_filter(netif, mac, action);
+}
+#endif
+
+static err_t netif_rmii_ethernet_low_init(struct netif *netif) {
+    struct rmii_ethernet *eth = netif->state;
+    uint index = eth - rmii_eth_instances;
+
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+
+    if (sys_hz < REF_CLK_SYNC_MIN_HZ) {
+        // a 10 Mbit/s dibit can't be placed within a REF_CLK cycle
+        return ERR_ARG;
+    }
+#endif
+
+    netif->linkoutput = netif_rmii_ethernet_output;
+    netif->output     = etharp_output;
+#if LWIP_IPV6
+    netif->output_ip6 = ethip6_output;
+#endif
+    netif->mtu        = 1500; 
+    netif->flags      = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_IGMP | NETIF_FLAG_MLD6;
+
+    if (PICO_RMII_ETHERNET_MAC_ADDR != NULL) {
+        memcpy(netif->hwaddr, PICO_RMII_ETHERNET_MAC_ADDR, 6);
+    } else {
+        // generate one for unique board id
+        pico_unique_board_id_t board_id;
+    
+        pico_get_unique_board_id(&board_id);
+
+        netif->hwaddr[0] = 0xb8;
+        netif->hwaddr[1] = 0x27;
+        netif->hwaddr[2] = 0xeb;
+        memcpy(&netif->hwaddr[3], &board_id.id[5], 3);
+
+        // one per interface
+        netif->hwaddr[5] += index;
+    }
+    
+    
+    netif->hwaddr_len = ETH_HWADDR_LEN;
+
+#if PICO_RMII_ETHERNET_RX_FILTER
+    uint types = LWIP_MIN(sizeof(rx_filter_default_types) / sizeof(rx_filter_default_types[0]), PICO_RMII_ETHERNET_RX_FILTER_ETHERTYPES);
+
+    memcpy(eth->rx_filter_types, rx_filter_default_types, types * sizeof(rx_filter_default_types[0]));
+    eth->rx_filter_type_count = types;
+
+#if PICO_RMII_ETHERNET_PAUSE
+    // the driver takes PAUSE frames before lwIP
+    netif_rmii_ethernet_netif_mac_filter(netif, pause_mac, NETIF_ADD_MAC_FILTER);
+    netif_rmii_ethernet_netif_rx_filter_ethertype_add(netif, ETHTYPE_MAC_CONTROL);
+#endif
+
+#if LWIP_IGMP
+    netif_set_igmp_mac_filter(netif, netif_rmii_ethernet_igmp_mac_filter);
+#endif
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+    netif_set_mld_mac_filter(netif, netif_rmii_ethernet_mld_mac_filter);
+
+    // lwIP receives on the all-nodes group, router advertisements among others, without
+    // joining it
+    ip6_addr_t all_nodes;
+
+    ip6_addr_set_allnodes_linklocal(&all_nodes);
+    netif_rmii_ethernet_mld_mac_filter(netif, &all_nodes, NETIF_ADD_MAC_FILTER);
+#endif
+#endif
+
+#if PICO_RMII_ETHERNET_RX_POLICE
+    netif_rmii_ethernet_netif_rx_police_set(netif, NETIF_RMII_ETHERNET_RX_POLICE_BROADCAST,
+                                            PICO_RMII_ETHERNET_RX_POLICE_BROADCAST_RATE, PICO_RMII_ETHERNET_RX_POLICE_BURST);
+    netif_rmii_ethernet_netif_rx_police_set(netif, NETIF_RMII_ETHERNET_RX_POLICE_SOURCE,
+                                            PICO_RMII_ETHERNET_RX_POLICE_SOURCE_RATE, PICO_RMII_ETHERNET_RX_POLICE_BURST);
+#endif
+
+    MIB2_INIT_NETIF(netif, snmp_ifType_ethernet_csmacd, 10000000);
+
+    rmii_ethernet_crc_init();
+
+#if PICO_RMII_ETHERNET_SRAM_BANKS
+    // the DMA control blocks are read by the TX DMA, the frame buffers need no clearing
+    memset(tx_rings[index], 0, sizeof(tx_rings[index]));
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+    memset(tx_priority_rings[index], 0, sizeof(tx_priority_rings[index]));
+#endif
+#endif
+
+#if PICO_RMII_ETHERNET_RX_ZERO_COPY
+#if PICO_LWIP_ARENA_SIZE
+    // the whole share, the buffers beyond RX_PBUF_COUNT hold received segments lwIP
+    // hasn't freed yet, which is what a receive window is
+    uint rx_pbuf_count = lwip_arena_left() / rx_arena_instances-- / sizeof(struct rx_pbuf);
+    struct rx_pbuf *bufs = NULL;
+
+    if (rx_pbuf_count >= RX_PBUF_COUNT) {
+        bufs = lwip_arena_alloc(rx_pbuf_count * sizeof(struct rx_pbuf), "rmii_ethernet");
+    }
+
+    if (bufs == NULL) {
+        return ERR_MEM;
+    }
+
+    lwip_arena_rx_grant(rx_pbuf_count - RX_PBUF_COUNT);
+#else
+    struct rx_pbuf *bufs = rx_pbufs[index];
+    const uint rx_pbuf_count = RX_PBUF_COUNT;
+#endif
+
+    eth->rx_pbuf_lock = spin_lock_instance(next_striped_spin_lock_num());
+
+    for (uint i = 0; i < rx_pbuf_count; i++) {
+        struct rx_pbuf *buf = &bufs[i];
+
+        buf->pc.custom_free_function = rx_pbuf_put;
+        buf->eth = eth;
+        buf->next = eth->rx_pbuf_free_list;
+        eth->rx_pbuf_free_list = buf;
+    }
+
+    for (int i = 0; i < PICO_RMII_ETHERNET_RX_RING_SIZE; i++) {
+        rx_descriptor_attach(eth, &eth->rx_ring[i]);
+    }
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    for (int i = 0; i < PICO_RMII_ETHERNET_RX_PRIORITY_RING_SIZE; i++) {
+        rx_descriptor_attach(eth, &eth->rx_priority_ring[i]);
+    }
+#endif
+#else
+#if PICO_LWIP_ARENA_SIZE
+    // the RX ring only, received frames are copied into PBUF_POOL pbufs
+    uint8_t (*frames)[RX_FRAME_SIZE] = lwip_arena_alloc(PICO_RMII_ETHERNET_RX_RING_SIZE * RX_FRAME_SIZE, "rmii_ethernet");
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    uint8_t (*priority_frames)[RX_FRAME_SIZE] = lwip_arena_alloc(PICO_RMII_ETHERNET_RX_PRIORITY_RING_SIZE * RX_FRAME_SIZE, "rmii_ethernet");
+
+    if (priority_frames == NULL) {
+        return ERR_MEM;
+    }
+#endif
+
+    if (frames == NULL) {
+        return ERR_MEM;
+    }
+#else
+    uint8_t (*frames)[RX_FRAME_SIZE] = rx_frames[index];
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    uint8_t (*priority_frames)[RX_FRAME_SIZE] = rx_priority_frames[index];
+#endif
+#endif
+
+    for (int i = 0; i < PICO_RMII_ETHERNET_RX_RING_SIZE; i++) {
+        eth->rx_ring[i].frame = frames[i];
+    }
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    for (int i = 0; i < PICO_RMII_ETHERNET_RX_PRIORITY_RING_SIZE; i++) {
+        eth->rx_priority_ring[i].frame = priority_frames[i];
+    }
+#endif
+#endif
+
+    eth->tx_ring = tx_rings[index];
+
+#if PICO_RMII_ETHERNET_RAW
+    for (int i = 0; i < PICO_RMII_ETHERNET_TX_RING_SIZE; i++) {
+        struct raw_tx *tx = &eth->raw_tx[i];
+
+        tx->pc.custom_free_function = raw_tx_free;
+        tx->eth = eth;
+        tx->next = eth->raw_tx_free_list;
+        eth->raw_tx_free_list = tx;
+    }
+#endif
+#if PICO_RMII_ETHERNET_100M
+    eth->tx_fast_frames = tx_fast_frames[index];
+#endif
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+    eth->tx_priority_ring = tx_priority_rings[index];
+#if PICO_RMII_ETHERNET_100M
+    eth->tx_priority_fast_frames = tx_priority_fast_frames[index];
+#endif
+#endif
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+    eth->tx_sched_next_us = UINT64_MAX;
+    eth->tx_sched_alarm = -1;
+#if PICO_RMII_ETHERNET_100M
+    eth->tx_sched_fast_frames = tx_sched_fast_frames[index];
+#endif
+#endif
+
+#if PICO_LWIP_VLAN
+    eth->vlan_vid = -1;
+#endif
+    
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    // a 10 Mbit/s dibit starts on a falling edge of REF_CLK and the next one 10 edges, 200 ns,
+    // later: after a dibit the programs wait out floor(190 ns * clk_sys) cycles, which ends
+    // in the REF_CLK cycle before the next edge also when the last edge was seen a clk_sys
+    // cycle late, then wait for that edge. 3 of the cycles are the instructions around the
+    // delay loop and its delay, the loop runs ref_clk_loops + 1 times at 4 cycles each
+    uint delay_cycles = (uint)(((uint64_t)sys_hz * 19) / 100000000) - 3;
+
+    eth->ref_clk_loops = delay_cycles / 4 - 1;
+
+    gpio_init(eth->config.ref_clk_pin);
+
+    eth->rx_sm_offset = netif_rmii_ethernet_ref_clk_program_add(eth, &rmii_ethernet_phy_rx_sync_program,
+        rmii_ethernet_phy_rx_sync_offset_delay, delay_cycles % 4);
+    eth->tx_sm_offset = netif_rmii_ethernet_ref_clk_program_add(eth, &rmii_ethernet_phy_tx_sync_program,
+        rmii_ethernet_phy_tx_sync_offset_delay, delay_cycles % 4);
+    eth->tx_fast_sm_offset = netif_rmii_ethernet_ref_clk_program_add(eth, &rmii_ethernet_phy_tx_sync_fast_program, -1, 0);
+#else
+    eth->rx_sm_offset = pio_add_program(PICO_RMII_ETHERNET_PIO, &rmii_ethernet_phy_rx_data_program);
+    eth->tx_sm_offset = pio_add_program(PICO_RMII_ETHERNET_PIO, &rmii_ethernet_phy_tx_data_program);
+#if PICO_RMII_ETHERNET_100M
+    eth->tx_fast_sm_offset = pio_add_program(PICO_RMII_ETHERNET_PIO, &rmii_ethernet_phy_tx_fast_program);
+#endif
+#endif
+    eth->mdio_sm_offset = pio_add_program(PICO_RMII_ETHERNET_PIO, &rmii_ethernet_mdio_program);
+#if PICO_RMII_ETHERNET_TIMESTAMP
+    eth->timestamp_sm_offset = pio_add_program(PICO_RMII_ETHERNET_PIO, &rmii_ethernet_timestamp_program);
+#endif
+#if PICO_RMII_ETHERNET_100M
+    rmii_ethernet_frame_encoding_init();
+#endif
+
+    eth->rx_dma_chan = dma_claim_unused_channel(true);
+    eth->tx_dma_chan = dma_claim_unused_channel(true);
+#if PICO_RMII_ETHERNET_RX_CHKSUM
+    netif_rmii_ethernet_rx_chksum_init();
+#endif
+
+    eth->rx_dma_channel_config = dma_channel_get_default_config(eth->rx_dma_chan);
+        
+    channel_config_set_read_increment(&eth->rx_dma_channel_config, false);
+    channel_config_set_write_increment(&eth->rx_dma_channel_config, true);
+    channel_config_set_dreq(&eth->rx_dma_channel_config, pio_get_dreq(PICO_RMII_ETHERNET_PIO,PICO_RMII_ETHERNET_SM_RX, false));
+    channel_config_set_transfer_data_size(&eth->rx_dma_channel_config, PICO_RMII_ETHERNET_RX_WORD ? DMA_SIZE_32 : DMA_SIZE_8);
+
+#if PICO_RMII_ETHERNET_RX_PEEK
+    eth->rx_dma_rest_chan = dma_claim_unused_channel(true);
+
+    eth->rx_dma_rest_channel_config = eth->rx_dma_channel_config;
+    channel_config_set_chain_to(&eth->rx_dma_rest_channel_config, eth->rx_dma_rest_chan);
+    channel_config_set_irq_quiet(&eth->rx_dma_rest_channel_config, true);
+
+    // the header channel hands over to the rest one and interrupts
+    channel_config_set_chain_to(&eth->rx_dma_channel_config, eth->rx_dma_rest_chan);
+    dma_channel_set_irq1_enabled(eth->rx_dma_chan, true);
+#endif
+
+    eth->tx_dma_ctrl_chan = dma_claim_unused_channel(true);
+
+    // data channel, loaded per block from the list and chaining back to the control channel
+    eth->tx_dma_channel_config = dma_channel_get_default_config(eth->tx_dma_chan);
+
+    channel_config_set_read_increment(&eth->tx_dma_channel_config, true);
+    channel_config_set_write_increment(&eth->tx_dma_channel_config, false);
+    channel_config_set_dreq(&eth->tx_dma_channel_config, pio_get_dreq(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TX, true));
+    channel_config_set_chain_to(&eth->tx_dma_channel_config, eth->tx_dma_ctrl_chan);
+    channel_config_set_irq_quiet(&eth->tx_dma_channel_config, true);
+
+    channel_config_set_transfer_data_size(&eth->tx_dma_channel_config, DMA_SIZE_8);
+    eth->tx_dma_ctrl_8 = channel_config_get_ctrl_value(&eth->tx_dma_channel_config);
+
+    channel_config_set_transfer_data_size(&eth->tx_dma_channel_config, DMA_SIZE_32);
+    eth->tx_dma_ctrl_32 = channel_config_get_ctrl_value(&eth->tx_dma_channel_config);
+
+    channel_config_set_transfer_data_size(&eth->tx_dma_channel_config, DMA_SIZE_8);
+    channel_config_set_chain_to(&eth->tx_dma_channel_config, eth->tx_dma_chan);
+    channel_config_set_irq_quiet(&eth->tx_dma_channel_config, false);
+    eth->tx_dma_ctrl_last = channel_config_get_ctrl_value(&eth->tx_dma_channel_config);
+
+#if PICO_RMII_ETHERNET_100M
+    channel_config_set_transfer_data_size(&eth->tx_dma_channel_config, DMA_SIZE_32);
+    eth->tx_dma_ctrl_fast = channel_config_get_ctrl_value(&eth->tx_dma_channel_config);
+#endif
+
+    // control channel, writes one tx_dma_block into the data channel's alias 0 registers
+    dma_channel_config tx_dma_ctrl_channel_config = dma_channel_get_default_config(eth->tx_dma_ctrl_chan);
+
+    channel_config_set_read_increment(&tx_dma_ctrl_channel_config, true);
+    channel_config_set_write_increment(&tx_dma_ctrl_channel_config, true);
+    channel_config_set_ring(&tx_dma_ctrl_channel_config, true, 4);
+    channel_config_set_transfer_data_size(&tx_dma_ctrl_channel_config, DMA_SIZE_32);
+
+    dma_channel_configure(
+        eth->tx_dma_ctrl_chan, &tx_dma_ctrl_channel_config,
+        &dma_hw->ch[eth->tx_dma_chan].read_addr,
+        NULL,
+        4,
+        false
+    );
+
+    eth->tx_ring_lock = spin_lock_instance(next_striped_spin_lock_num());
+
+    dma_channel_set_irq0_enabled(eth->tx_dma_chan, true);
+
+    if (!tx_dma_irq_added) {
+        tx_dma_irq_added = true;
+        irq_add_shared_handler(DMA_IRQ_0, netif_rmii_ethernet_tx_dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0, true);
+    }
+
+    netif_rmii_ethernet_tx_sm_init(eth, false);
+
+    rmii_ethernet_mdio_init(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_MDIO, eth->mdio_sm_offset, PICO_RMII_ETHERNET_MDIO_PIN, PICO_RMII_ETHERNET_MDC_PIN);
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+    eth->timestamp_sfd = netif_rmii_ethernet_timestamp_sfd(false);
+    rmii_ethernet_timestamp_init(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TIMESTAMP, eth->timestamp_sm_offset, PICO_RMII_ETHERNET_RX_PIN + 2);
+#endif
+
+    // a PHY still in reset leaves MDIO pulled up, then reads BMCR with its reset bit set
+    // until it is done, instead of waiting for the longest reset it is polled for.
+    // Without an answer, address 0 is kept and the link check keeps trying it
+    uint32_t phy_start = timebase_ms();
+    bool phy_ready = false;
+
+    do {
+        for (int i = 0; i < 32; i++) {
+            uint16_t bmcr = netif_rmii_ethernet_mdio_read(eth, i, 0);
+
+            if (bmcr != 0xffff) {
+                eth->phy_address = i;
+                phy_ready = (bmcr & 0x8000) == 0;
+
+                break;
+            }
+        }
+    } while (!phy_ready && (timebase_ms() - phy_start) < PICO_RMII_ETHERNET_PHY_READY_MS);
+
+    // netif_rmii_ethernet_mdio_write(phy_address, 0, 0x2000); // 10 Mbps, auto negeotiate disabled
+
+    // selector and 10BASE-T, plus full duplex and 100BASE-TX as configured
+    uint16_t advertise = 0x21;
+    bool full_duplex = (eth->config.duplex == NETIF_RMII_ETHERNET_DUPLEX_FULL);
+
+    if (full_duplex) {
+        advertise |= 0x40;
+#if PICO_RMII_ETHERNET_PAUSE
+        // symmetric PAUSE
+        advertise |= 0x400;
+#endif
+    }
+
+#if PICO_RMII_ETHERNET_100M
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    // below that clk_sys a 100 Mbit/s dibit is over before the programs are back at the wait
+    if (eth->config.speed >= 100 && sys_hz >= REF_CLK_SYNC_FAST_MIN_HZ) {
+#else
+    if (eth->config.speed >= 100) {
+#endif
+        advertise |= full_duplex ? 0x180 : 0x80;
+    }
+#endif
+
+    netif_rmii_ethernet_mdio_write(eth, eth->phy_address, 4, advertise);
+    netif_rmii_ethernet_mdio_write(eth, eth->phy_address, 0, 0x1200); // autonegotiate, restart with the new advertisement
+
+    sys_timeout(PICO_RMII_ETHERNET_LINK_POLL_DOWN_MS, netif_rmii_ethernet_link_check, eth);
+
+    return ERR_OK;
+}
+
+err_t netif_rmii_ethernet_init(struct netif *netif, struct netif_rmii_ethernet_config *config) {
+    const struct netif_rmii_ethernet_config default_config = NETIF_RMII_ETHERNET_DEFAULT_CONFIG();
+
+    if (rmii_eth_instance_count == PICO_RMII_ETHERNET_INSTANCES) {
+        return ERR_MEM;
+    }
+
+    if (config == NULL) {
+        config = (struct netif_rmii_ethernet_config *)&default_config;
+    }
+
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        if (rmii_eth_instances[i].config.pio == config->pio) {
+            // the RX, TX and MDIO programs of two interfaces don't fit in one PIO block
+            return ERR_ARG;
+        }
+    }
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+    if (config->pio_sm_start != 0) {
+        // the timestamp SM is the 4th of the block
+        return ERR_ARG;
+    }
+#endif
+
+#if PICO_RMII_ETHERNET_FIXED_CONFIG
+    if (config->pio != PICO_RMII_ETHERNET_PIO || config->pio_sm_start != PICO_RMII_ETHERNET_SM_RX ||
+        config->rx_pin_start != PICO_RMII_ETHERNET_RX_PIN || config->tx_pin_start != PICO_RMII_ETHERNET_TX_PIN ||
+        config->mdio_pin_start != PICO_RMII_ETHERNET_MDIO_PIN) {
+        // the driver was built for another PIO block, state machines or pins
+        return ERR_ARG;
+    }
+#endif
+
+    struct rmii_ethernet *eth = &rmii_eth_instances[rmii_eth_instance_count];
+
+    memcpy(&eth->config, config, sizeof(eth->config));
+#if !PICO_RMII_ETHERNET_FIXED_CONFIG
+    eth->rx_fifo = &config->pio->rxf[config->pio_sm_start];
+    eth->tx_fifo = &config->pio->txf[config->pio_sm_start + 1];
+#endif
+    eth->netif = netif;
+    eth->rx_stalled = true;
+    eth->rx_sm_init = true;
+#if PICO_RMII_ETHERNET_TIMESTAMP
+    eth->timestamp_tx_err = ERR_VAL;
+#endif
+#if !PICO_RMII_ETHERNET_REF_CLK_SYNC
+    eth->rx_clkdiv = 10;
+#endif
+#if PICO_RMII_ETHERNET_LRO
+    lwip_lro_init(&eth->lro, SIZEOF_ETH_HDR);
+#endif
+
+    if (netif_add(netif, IP4_ADDR_ANY4, IP4_ADDR_ANY4, IP4_ADDR_ANY4, eth, netif_rmii_ethernet_low_init, netif_input) == NULL) {
+        return ERR_IF;
+    }
+
+    netif->name[0] = 'e';
+    netif->name[1] = '0' + rmii_eth_instance_count;
+
+#if LWIP_IPV6
+    // fe80:: from the MAC, the global addresses from router advertisements
+    netif_create_ip6_linklocal_address(netif, 1);
+#if LWIP_IPV6_AUTOCONFIG
+    netif_set_ip6_autoconfig_enabled(netif, 1);
+#endif
+#endif
+
+    // the interrupt handlers only look at it once it is set up
+    __dmb();
+    rmii_eth_instance_count++;
+
+    return ERR_OK;
+}
+
+void netif_rmii_ethernet_get_link(uint *speed, enum netif_rmii_ethernet_duplex *duplex) {
+    netif_rmii_ethernet_netif_get_link(rmii_eth_instances[0].netif, speed, duplex);
+}
+
+void netif_rmii_ethernet_netif_get_link(struct netif *netif, uint *speed, enum netif_rmii_ethernet_duplex *duplex) {
+    struct rmii_ethernet *eth = netif->state;
+
+    *speed = eth->link_speed;
+    *duplex = eth->link_duplex;
+}
+
+err_t netif_rmii_ethernet_netif_phy_loopback(struct netif *netif, bool enable, uint speed) {
+    struct rmii_ethernet *eth = netif->state;
+
+    if (!enable) {
+        if (eth->phy_loopback) {
+            eth->phy_loopback = false;
+
+            // autonegotiation again, the link check reports the link once it is back
+            netif_rmii_ethernet_mdio_write(eth, eth->phy_address, 0, 0x1200);
+
+            if (netif_is_link_up(netif)) {
+                eth->link_speed = 0;
+                netif_set_link_down(netif);
+            }
+        }
+
+        return ERR_OK;
+    }
+
+    bool fast = speed >= 100;
+
+#if PICO_RMII_ETHERNET_100M
+#if PICO_RMII_ETHERNET_REF_CLK_SYNC
+    if (fast && clock_get_hz(clk_sys) < REF_CLK_SYNC_FAST_MIN_HZ) {
+        return ERR_ARG;
+    }
+#endif
+#else
+    if (fast) {
+        return ERR_ARG;
+    }
+#endif
+
+    eth->phy_loopback = true;
+
+    // BMCR: loopback, the speed, full duplex, autonegotiation off
+    netif_rmii_ethernet_mdio_write(eth, eth->phy_address, 0, 0x4100 | (fast ? 0x2000 : 0));
+
+    netif_rmii_ethernet_speed_set(eth, fast);
+
+    return ERR_OK;
+}
+
+void netif_rmii_ethernet_get_stats(struct netif_rmii_ethernet_stats *stats) {
+    netif_rmii_ethernet_netif_get_stats(rmii_eth_instances[0].netif, stats);
+}
+
+void netif_rmii_ethernet_netif_get_stats(struct netif *netif, struct netif_rmii_ethernet_stats *stats) {
+    struct rmii_ethernet *eth = netif->state;
+
+    memcpy(stats, &eth->stats, sizeof(*stats));
+    stats->rx_overrun = eth->rx_overrun;
+#if PICO_RMII_ETHERNET_RX_FILTER
+    stats->rx_filtered = eth->rx_filtered;
+#endif
+#if PICO_RMII_ETHERNET_RX_POLICE
+    for (uint i = 0; i < NETIF_RMII_ETHERNET_RX_POLICERS; i++) {
+        stats->rx_policed += eth->rx_police_dropped[i];
+    }
+#endif
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    stats->rx_priority = eth->rx_priority;
+    stats->rx_priority_overrun = eth->rx_priority_overrun;
+    stats->rx_crc_err += eth->rx_priority_crc_err;
+#endif
+#if PICO_RMII_ETHERNET_LRO
+    stats->rx_lro_merged = eth->lro.merged;
+#endif
+#if PICO_RMII_ETHERNET_PAUSE
+    stats->rx_pause = eth->rx_pause_received;
+    stats->tx_pause = eth->tx_pause_sent;
+#endif
+}
+
+#if PICO_RMII_ETHERNET_RX_FILTER
+void netif_rmii_ethernet_set_promiscuous(bool on) {
+    netif_rmii_ethernet_netif_set_promiscuous(rmii_eth_instances[0].netif, on);
+}
+
+err_t netif_rmii_ethernet_mac_filter(const uint8_t *mac, enum netif_mac_filter_action action) {
+    return netif_rmii_ethernet_netif_mac_filter(rmii_eth_instances[0].netif, mac, action);
+}
+
+err_t netif_rmii_ethernet_rx_filter_ethertype_add(uint16_t type) {
+    return netif_rmii_ethernet_netif_rx_filter_ethertype_add(rmii_eth_instances[0].netif, type);
+}
+
+void netif_rmii_ethernet_netif_set_promiscuous(struct netif *netif, bool on) {
+    struct rmii_ethernet *eth = netif->state;
+
+    eth->rx_filter_promiscuous = on;
+}
+
+err_t netif_rmii_ethernet_netif_mac_filter(struct netif *netif, const uint8_t *mac, enum netif_mac_filter_action action) {
+    struct rmii_ethernet *eth = netif->state;
+    uint8_t *count = &eth->rx_filter_hash[rx_filter_bin(mac)];
+
+    if (action == NETIF_ADD_MAC_FILTER) {
+        if (*count == UINT8_MAX) {
+            return ERR_MEM;
+        }
+
+        (*count)++;
+    } else if (*count != 0) {
+        (*count)--;
+    }
+
+    return ERR_OK;
+}
+
+err_t netif_rmii_ethernet_netif_rx_filter_ethertype_add(struct netif *netif, uint16_t type) {
+    struct rmii_ethernet *eth = netif->state;
+    uint count = eth->rx_filter_type_count;
+
+    for (uint i = 0; i < count; i++) {
+        if (eth->rx_filter_types[i] == type) {
+            return ERR_OK;
+        }
+    }
+
+    if (count == PICO_RMII_ETHERNET_RX_FILTER_ETHERTYPES) {
+        return ERR_MEM;
+    }
+
+    // the IRQ only looks at the entry once it is counted
+    eth->rx_filter_types[count] = type;
+    __dmb();
+    eth->rx_filter_type_count = count + 1;
+
+    return ERR_OK;
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RX_POLICE
+err_t netif_rmii_ethernet_rx_police_set(enum netif_rmii_ethernet_rx_police police, uint rate, uint burst) {
+    return netif_rmii_ethernet_netif_rx_police_set(rmii_eth_instances[0].netif, police, rate, burst);
+}
+
+void netif_rmii_ethernet_rx_police_get_stats(struct netif_rmii_ethernet_rx_police_stats *stats) {
+    netif_rmii_ethernet_netif_rx_police_get_stats(rmii_eth_instances[0].netif, stats);
+}
+
+err_t netif_rmii_ethernet_netif_rx_police_set(struct netif *netif, enum netif_rmii_ethernet_rx_police police, uint rate, uint burst) {
+    struct rmii_ethernet *eth = netif->state;
+
+    if ((uint)police >= NETIF_RMII_ETHERNET_RX_POLICERS || rate > 1000000 || burst == 0 || burst > 1000) {
+        return ERR_ARG;
+    }
+
+    struct rx_police_rate *r = &eth->rx_police_rates[police];
+    uint32_t interval = (rate == 0) ? 0 : (1000000 / rate);
+
+    // the IRQ only polices once the interval is set
+    r->interval_us = 0;
+    __dmb();
+    r->tolerance_us = (burst - 1) * interval;
+    __dmb();
+    r->interval_us = interval;
+
+    return ERR_OK;
+}
+
+void netif_rmii_ethernet_netif_rx_police_get_stats(struct netif *netif, struct netif_rmii_ethernet_rx_police_stats *stats) {
+    struct rmii_ethernet *eth = netif->state;
+
+    for (uint i = 0; i < NETIF_RMII_ETHERNET_RX_POLICERS; i++) {
+        stats->dropped[i] = eth->rx_police_dropped[i];
+    }
+
+    stats->shared = eth->rx_police_shared;
+}
+#endif
+
+#if PICO_RMII_ETHERNET_WAKE
+static void netif_rmii_ethernet_wake_up(struct rmii_ethernet *eth) {
+    if (eth->wake_match) {
+        eth->wake_match = 0;
+        rmii_eth_asleep_count--;
+    }
+}
+
+// all interfaces sleep, lwIP has nothing to do until a frame wakes one
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_asleep)() {
+    return rmii_eth_asleep_count != 0 && rmii_eth_asleep_count == rmii_eth_instance_count;
+}
+
+err_t netif_rmii_ethernet_sleep(uint match, netif_rmii_ethernet_wake_callback_t callback, void *arg) {
+    return netif_rmii_ethernet_netif_sleep(rmii_eth_instances[0].netif, match, callback, arg);
+}
+
+err_t netif_rmii_ethernet_netif_sleep(struct netif *netif, uint match, netif_rmii_ethernet_wake_callback_t callback, void *arg) {
+    struct rmii_ethernet *eth = netif->state;
+
+    if ((match & (NETIF_RMII_ETHERNET_WAKE_MAGIC | NETIF_RMII_ETHERNET_WAKE_UNICAST)) == 0) {
+        return ERR_ARG;
+    }
+
+#if PICO_RMII_ETHERNET_RX_FILTER
+    if (match & NETIF_RMII_ETHERNET_WAKE_MAGIC) {
+        // UDP magic packets are passed as IPv4 or IPv6 already
+        err_t err = netif_rmii_ethernet_netif_rx_filter_ethertype_add(netif, RMII_ETHERNET_FRAME_WAKE_ETHERTYPE);
+
+        if (err != ERR_OK) {
+            return err;
+        }
+    }
+#endif
+
+    eth->wake_callback = callback;
+    eth->wake_arg = arg;
+
+    if (eth->wake_match == 0) {
+        rmii_eth_asleep_count++;
+    }
+
+    eth->wake_match = match & (NETIF_RMII_ETHERNET_WAKE_MAGIC | NETIF_RMII_ETHERNET_WAKE_UNICAST);
+
+    return ERR_OK;
+}
+
+void netif_rmii_ethernet_wake() {
+    netif_rmii_ethernet_netif_wake(rmii_eth_instances[0].netif);
+}
+
+void netif_rmii_ethernet_netif_wake(struct netif *netif) {
+    netif_rmii_ethernet_wake_up(netif->state);
+}
+
+bool netif_rmii_ethernet_netif_asleep(struct netif *netif) {
+    struct rmii_ethernet *eth = netif->state;
+
+    return eth->wake_match != 0;
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RAW
+err_t netif_rmii_ethernet_raw_rx_register(uint16_t type, netif_rmii_ethernet_raw_rx_callback_t callback, void *arg) {
+    return netif_rmii_ethernet_netif_raw_rx_register(rmii_eth_instances[0].netif, type, callback, arg);
+}
+
+err_t netif_rmii_ethernet_raw_send(const uint8_t *frame, uint length, netif_rmii_ethernet_raw_tx_callback_t done, void *arg) {
+    return netif_rmii_ethernet_netif_raw_send(rmii_eth_instances[0].netif, frame, length, done, arg);
+}
+
+err_t netif_rmii_ethernet_netif_raw_rx_register(struct netif *netif, uint16_t type, netif_rmii_ethernet_raw_rx_callback_t callback, void *arg) {
+    struct rmii_ethernet *eth = netif->state;
+    struct raw_rx_handler *free = NULL;
+
+    if (type == 0 || type == ETHTYPE_IP || type == ETHTYPE_ARP ||
+        (LWIP_IPV6 && type == ETHTYPE_IPV6) || (ETHARP_SUPPORT_VLAN && type == ETHTYPE_VLAN)) {
+        // lwIP's
+        return ERR_ARG;
+    }
+
+    for (uint i = 0; i < PICO_RMII_ETHERNET_RAW_RX_HANDLERS; i++) {
+        struct raw_rx_handler *handler = &eth->raw_rx_handlers[i];
+
+        if (handler->type == type) {
+            if (callback == NULL) {
+                // the filter still passes it, lwIP drops it
+                handler->type = 0;
+            } else {
+                handler->callback = callback;
+                handler->arg = arg;
+            }
+
+            return ERR_OK;
+        }
+
+        if (handler->type == 0 && free == NULL) {
+            free = handler;
+        }
+    }
+
+    if (callback == NULL) {
+        return ERR_OK;
+    }
+
+    if (free == NULL) {
+        return ERR_MEM;
+    }
+
+#if PICO_RMII_ETHERNET_RX_FILTER
+    err_t err = netif_rmii_ethernet_netif_rx_filter_ethertype_add(netif, type);
+
+    if (err != ERR_OK) {
+        return err;
+    }
+#endif
+
+    free->callback = callback;
+    free->arg = arg;
+    free->type = type;
+
+    return ERR_OK;
+}
+
+err_t netif_rmii_ethernet_netif_raw_send(struct netif *netif, const uint8_t *frame, uint length, netif_rmii_ethernet_raw_tx_callback_t done, void *arg) {
+    struct rmii_ethernet *eth = netif->state;
+    struct raw_tx *tx = eth->raw_tx_free_list;
+
+    // an untagged frame without FCS
+    if (length < SIZEOF_ETH_HDR || length > 1514) {
+        return ERR_VAL;
+    }
+
+    if (tx == NULL) {
+        return ERR_MEM;
+    }
+
+    eth->raw_tx_free_list = tx->next;
+    tx->frame = frame;
+    tx->done = done;
+    tx->arg = arg;
+
+    struct pbuf *p = pbuf_alloced_custom(PBUF_RAW, length, PBUF_REF, &tx->pc, (void *)frame, length);
+
+    // the TX ring takes a reference of its own and drops it once the frame is out
+    err_t err = netif_rmii_ethernet_output(netif, p);
+
+    if (err != ERR_OK) {
+        // the caller has the error, not a callback
+        tx->done = NULL;
+    }
+
+    pbuf_free(p);
+
+    return err;
+}
+#endif
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+// the alarm of eth, PICO_RMII_ETHERNET_TX_SCHEDULED_LEAD_US before the first scheduled
+// frame's time or forced when that changed: sets it again for a later time, or waits out
+// the time and starts the frame if the TX is idle. A busy TX starts it from the DMA
+// interrupt of the frame on the wire, which the hold made sure ends in time
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_sched_service)(struct rmii_ethernet *eth) {
+    uint32_t save = spin_lock_blocking(eth->tx_ring_lock);
+    uint64_t launch_us = eth->tx_sched_next_us;
+
+    spin_unlock(eth->tx_ring_lock, save);
+
+    if (launch_us == UINT64_MAX) {
+        return;
+    }
+
+    // hardware_alarm_set_target() says when the target has passed already
+    if (launch_us > time_us_64() + PICO_RMII_ETHERNET_TX_SCHEDULED_LEAD_US &&
+        !hardware_alarm_set_target(eth->tx_sched_alarm, from_us_since_boot(launch_us - PICO_RMII_ETHERNET_TX_SCHEDULED_LEAD_US))) {
+        return;
+    }
+
+    while (time_us_64() < launch_us) {
+        tight_loop_contents();
+    }
+
+    save = spin_lock_blocking(eth->tx_ring_lock);
+
+    // tx_next() takes the frame, or drops it for a link that has gone since, and forces
+    // the alarm again for the next one
+    if (!eth->tx_busy) {
+        eth->tx_busy = true;
+        netif_rmii_ethernet_tx_next(eth);
+    }
+
+    spin_unlock(eth->tx_ring_lock, save);
+
+    netif_rmii_ethernet_wake_from_isr();
+}
+
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_tx_sched_alarm)(uint alarm) {
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        if (rmii_eth_instances[i].tx_sched_alarm == (int)alarm) {
+            netif_rmii_ethernet_tx_sched_service(&rmii_eth_instances[i]);
+        }
+    }
+}
+
+err_t netif_rmii_ethernet_tx_schedule(const uint8_t *frame, uint length, uint64_t launch_us, netif_rmii_ethernet_tx_scheduled_callback_t done, void *arg) {
+    return netif_rmii_ethernet_netif_tx_schedule(rmii_eth_instances[0].netif, frame, length, launch_us, done, arg);
+}
+
+err_t netif_rmii_ethernet_netif_tx_schedule(struct netif *netif, const uint8_t *frame, uint length, uint64_t launch_us, netif_rmii_ethernet_tx_scheduled_callback_t done, void *arg) {
+    struct rmii_ethernet *eth = netif->state;
+    struct tx_sched *sched = NULL;
+
+    // an untagged frame without FCS
+    if (length < SIZEOF_ETH_HDR || length > 1514) {
+        return ERR_VAL;
+    }
+
+    if (eth->link_speed == 0) {
+        return ERR_CONN;
+    }
+
+    for (uint i = 0; i < PICO_RMII_ETHERNET_TX_SCHEDULED_SLOTS; i++) {
+        if (eth->tx_sched[i].state == TX_SCHED_FREE) {
+            sched = &eth->tx_sched[i];
+            break;
+        }
+    }
+
+    if (sched == NULL) {
+        return ERR_MEM;
+    }
+
+    if (eth->tx_sched_alarm < 0) {
+        eth->tx_sched_alarm = hardware_alarm_claim_unused(true);
+        hardware_alarm_set_callback(eth->tx_sched_alarm, netif_rmii_ethernet_tx_sched_alarm);
+    }
+
+    struct tx_descriptor *desc = &sched->desc;
+
+    desc->p = pbuf_alloced_custom(PBUF_RAW, length, PBUF_REF, &sched->pc, (void *)frame, length);
+    RMII_ETHERNET_PROFILE_STAMP(desc->t);
+
+    sched->launch_us = launch_us;
+    sched->speed = eth->link_speed;
+    sched->err = ERR_OK;
+    sched->frame = frame;
+    sched->done = done;
+    sched->arg = arg;
+
+    // the whole frame now, the DMA starts on it the moment its time comes
+#if PICO_RMII_ETHERNET_100M
+    if (eth->tx_fast || PICO_RMII_ETHERNET_REF_CLK_SYNC) {
+        netif_rmii_ethernet_tx_fast_build(eth, desc, eth->tx_sched_fast_frames[sched - eth->tx_sched], NULL);
+    } else
+#endif
+    {
+        netif_rmii_ethernet_tx_build(eth, desc, NULL);
+    }
+
+    uint32_t save = spin_lock_blocking(eth->tx_ring_lock);
+    bool first = launch_us < eth->tx_sched_next_us;
+
+    sched->state = TX_SCHED_QUEUED;
+
+    if (first) {
+        // the rings are held for it from now on
+        eth->tx_sched_next_us = launch_us;
+    }
+
+    spin_unlock(eth->tx_ring_lock, save);
+
+    if (first) {
+        // the alarm's interrupt sets it for this frame, or sends it if its time has come
+        hardware_alarm_force_irq(eth->tx_sched_alarm);
+    }
+
+    return ERR_OK;
+}
+#endif
+
+#if PICO_LWIP_VLAN
+err_t netif_rmii_ethernet_set_vlan(int vid) {
+    return netif_rmii_ethernet_netif_set_vlan(rmii_eth_instances[0].netif, vid);
+}
+
+err_t netif_rmii_ethernet_netif_set_vlan(struct netif *netif, int vid) {
+    struct rmii_ethernet *eth = netif->state;
+
+    // 0 is priority tagged and 4095 reserved
+    if (vid != -1 && (vid < 1 || vid > 4094)) {
+        return ERR_ARG;
+    }
+
+    eth->vlan_vid = vid;
+
+    return ERR_OK;
+}
+
+// LWIP_HOOK_VLAN_SET: p is at the IP header, or ARP's. The PCP is the IP precedence, so a
+// tagged frame goes to the TX priority ring as an untagged one would
+s32_t netif_rmii_ethernet_vlan_set(struct netif *netif, struct pbuf *p, const struct eth_addr *src, const struct eth_addr *dst, u16_t eth_type) {
+    LWIP_UNUSED_ARG(src);
+    LWIP_UNUSED_ARG(dst);
+
+    if (netif->linkoutput != netif_rmii_ethernet_output) {
+        return -1;
+    }
+
+    struct rmii_ethernet *eth = netif->state;
+    const uint8_t *header = p->payload;
+    uint pcp = 0;
+
+    if (eth->vlan_vid < 0) {
+        return -1;
+    }
+
+    if (eth_type == ETHTYPE_IP && p->len >= 2) {
+        pcp = header[1] >> 5;
+    } else if (eth_type == ETHTYPE_IPV6 && p->len >= 1) {
+        // the top 3 bits of the traffic class, which starts in the low nibble of byte 0
+        pcp = (header[0] & 0x0f) >> 1;
+    }
+
+    return (pcp << 13) | eth->vlan_vid;
+}
+
+// LWIP_HOOK_VLAN_CHECK: priority tagged frames and those of the VID set, all when it is
+// another interface's
+int netif_rmii_ethernet_vlan_check(struct netif *netif, const struct eth_hdr *ethhdr, const struct eth_vlan_hdr *vlan) {
+    LWIP_UNUSED_ARG(ethhdr);
+
+    if (netif->linkoutput != netif_rmii_ethernet_output) {
+        return 1;
+    }
+
+    struct rmii_ethernet *eth = netif->state;
+    int vid = VLAN_ID(vlan);
+
+    return (vid == 0) || (vid == eth->vlan_vid);
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+void netif_rmii_ethernet_rx_priority_set(uint16_t type, uint16_t port, netif_rmii_ethernet_rx_priority_callback_t callback, void *arg) {
+    netif_rmii_ethernet_netif_rx_priority_set(rmii_eth_instances[0].netif, type, port, callback, arg);
+}
+
+void netif_rmii_ethernet_netif_rx_priority_set(struct netif *netif, uint16_t type, uint16_t port, netif_rmii_ethernet_rx_priority_callback_t callback, void *arg) {
+    struct rmii_ethernet *eth = netif->state;
+
+    // the CRS_DV IRQ, possibly on the other core, diverts nothing without a callback
+    eth->rx_priority_callback = NULL;
+    __dmb();
+
+    eth->rx_priority_type = type;
+    eth->rx_priority_port = port;
+    eth->rx_priority_arg = arg;
+    __dmb();
+
+    eth->rx_priority_callback = callback;
+}
+#endif
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+uint32_t netif_rmii_ethernet_timestamp_hz() {
+    return clock_get_hz(clk_sys) / 2;
+}
+
+bool netif_rmii_ethernet_netif_timestamp_rx(struct netif *netif, uint32_t *timestamp) {
+    struct rmii_ethernet *eth = netif->state;
+
+    if (!eth->timestamp_rx_valid) {
+        return false;
+    }
+
+    *timestamp = eth->timestamp_rx;
+
+    return true;
+}
+
+// the timestamp SM pushes for pin from now on, what it pushed before is dropped
+static void netif_rmii_ethernet_timestamp_pin_set(struct rmii_ethernet *eth, uint pin) {
+    rmii_ethernet_timestamp_pin_set(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TIMESTAMP, pin);
+
+    // the count of an edge of the old pin is pushed 4 cycles after it was seen
+    busy_wait_us_32(1);
+
+    while (!pio_sm_is_rx_fifo_empty(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TIMESTAMP)) {
+        pio_sm_get(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TIMESTAMP);
+    }
+}
+
+err_t netif_rmii_ethernet_netif_timestamp_tx_arm(struct netif *netif) {
+    struct rmii_ethernet *eth = netif->state;
+
+    if (eth->timestamp_state != TIMESTAMP_RX || eth->tx_ring_dma != eth->tx_ring_head || eth->tx_busy ||
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+        eth->tx_priority_dma != eth->tx_priority_head ||
+#endif
+        !pio_sm_is_tx_fifo_empty(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TX) || gpio_get(PICO_RMII_ETHERNET_TX_PIN + 2)) {
+        // the count would be of a frame before the armed one
+        return ERR_INPROGRESS;
+    }
+
+    // the CRS_DV IRQ leaves the counts alone from here
+    eth->timestamp_state = TIMESTAMP_TX_ARMED;
+    __dmb();
+
+    netif_rmii_ethernet_timestamp_pin_set(eth, PICO_RMII_ETHERNET_TX_PIN + 2);
+
+    eth->timestamp_tx_armed = sys_now();
+    eth->timestamp_tx_err = ERR_INPROGRESS;
+
+    return ERR_OK;
+}
+
+// lwIP context's side of a TX timestamp: the count of the armed frame, then back to CRS_DV
+// once no frame is coming in, one that is would be stamped at the switch
+static void netif_rmii_ethernet_timestamp_service(struct rmii_ethernet *eth) {
+    if (eth->timestamp_state == TIMESTAMP_TX_ARMED) {
+        if (!pio_sm_is_rx_fifo_empty(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TIMESTAMP)) {
+            eth->timestamp_tx = pio_sm_get(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TIMESTAMP) + eth->timestamp_sfd;
+            eth->timestamp_tx_err = ERR_OK;
+            eth->timestamp_state = TIMESTAMP_TX_DONE;
+        } else if ((sys_now() - eth->timestamp_tx_armed) >= TIMESTAMP_TX_TIMEOUT_MS) {
+            // link down, or the frame was dropped
+            eth->timestamp_tx_err = ERR_TIMEOUT;
+            eth->timestamp_state = TIMESTAMP_TX_DONE;
+        }
+    }
+
+    if (eth->timestamp_state == TIMESTAMP_TX_DONE && !gpio_get(PICO_RMII_ETHERNET_RX_PIN + 2)) {
+        // also drops the counts of frames sent after the armed one
+        netif_rmii_ethernet_timestamp_pin_set(eth, PICO_RMII_ETHERNET_RX_PIN + 2);
+
+        __dmb();
+        eth->timestamp_state = TIMESTAMP_RX;
+    }
+}
+
+err_t netif_rmii_ethernet_netif_timestamp_tx_get(struct netif *netif, uint32_t *timestamp) {
+    struct rmii_ethernet *eth = netif->state;
+
+    netif_rmii_ethernet_timestamp_service(eth);
+
+    err_t err = eth->timestamp_tx_err;
+
+    if (err == ERR_OK) {
+        *timestamp = eth->timestamp_tx;
+    }
+
+    if (err != ERR_INPROGRESS) {
+        eth->timestamp_tx_err = ERR_VAL;
+    }
+
+    return err;
+}
+#endif
+
+#if PICO_RMII_ETHERNET_CPU_STATS
+// the time of a core goes to the class it is in, switched with timebase_us() reads. A
+// pass collects its time by class and hands it over at its end, to EMPTY as a whole
+// when nothing moved through the rings meanwhile
+struct rmii_ethernet_cpu {
+    bool started;
+    bool in_pass;
+    uint8_t cls;
+    uint32_t since;
+    uint32_t pass[NETIF_RMII_ETHERNET_CPU_CLASSES];
+    uint8_t pass_cls;
+    uint pass_progress;
+    struct netif_rmii_ethernet_cpu_stats stats;
+};
+
+static struct rmii_ethernet_cpu rmii_eth_cpu[NUM_CORES];
+static uint rmii_eth_cpu_lwip_core;
+
+static uint RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_cpu_switch)(uint cls) {
+    struct rmii_ethernet_cpu *cpu = &rmii_eth_cpu[get_core_num()];
+    uint32_t now = timebase_us();
+    uint prev = cpu->cls;
+
+    if (cpu->in_pass) {
+        cpu->pass[prev] += now - cpu->since;
+    } else if (cpu->started) {
+        cpu->stats.us[prev] += now - cpu->since;
+    } else {
+        // up to the first pass the core was the application's, and isn't counted
+        prev = NETIF_RMII_ETHERNET_CPU_APP;
+        cpu->started = true;
+    }
+
+    cpu->since = now;
+    cpu->cls = cls;
+
+    return prev;
+}
+
+// frames through the rings in either direction, at the driver's end and at lwIP's. Each
+// core of a PICO_RMII_ETHERNET_DUAL_CORE build only counts its own end, the other core
+// moves the other one at the same time
+static uint RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_cpu_progress)(uint cls) {
+    uint progress = 0;
+
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        struct rmii_ethernet *eth = &rmii_eth_instances[i];
+
+        if (!PICO_RMII_ETHERNET_DUAL_CORE || cls == NETIF_RMII_ETHERNET_CPU_DRIVER) {
+            progress += eth->rx_ring_checked + eth->tx_ring_built;
+        }
+
+        if (!PICO_RMII_ETHERNET_DUAL_CORE || cls != NETIF_RMII_ETHERNET_CPU_DRIVER) {
+            progress += eth->rx_ring_tail + eth->tx_ring_head + eth->tx_ring_tail;
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+            progress += eth->rx_priority_tail;
+#endif
+        }
+    }
+
+    return progress;
+}
+
+static uint RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_cpu_pass_begin)(uint cls) {
+    struct rmii_ethernet_cpu *cpu = &rmii_eth_cpu[get_core_num()];
+    uint prev = netif_rmii_ethernet_cpu_switch(cls);
+
+    memset(cpu->pass, 0, sizeof(cpu->pass));
+    cpu->pass_cls = cls;
+    cpu->pass_progress = netif_rmii_ethernet_cpu_progress(cls);
+    cpu->in_pass = true;
+
+    return prev;
+}
+
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_cpu_pass_end)(uint prev) {
+    struct rmii_ethernet_cpu *cpu = &rmii_eth_cpu[get_core_num()];
+
+    netif_rmii_ethernet_cpu_switch(prev);
+    cpu->in_pass = false;
+
+    bool empty = (netif_rmii_ethernet_cpu_progress(cpu->pass_cls) == cpu->pass_progress);
+
+    for (uint i = 0; i < NETIF_RMII_ETHERNET_CPU_CLASSES; i++) {
+        cpu->stats.us[empty ? NETIF_RMII_ETHERNET_CPU_EMPTY : i] += cpu->pass[i];
+    }
+
+    cpu->stats.passes++;
+
+    if (empty) {
+        cpu->stats.passes_empty++;
+    }
+}
+
+void netif_rmii_ethernet_get_cpu_stats(uint core, struct netif_rmii_ethernet_cpu_stats *stats) {
+    memcpy(stats, &rmii_eth_cpu[core].stats, sizeof(*stats));
+}
+
+uint64_t netif_rmii_ethernet_cpu_idle_us() {
+    const struct netif_rmii_ethernet_cpu_stats *stats = &rmii_eth_cpu[rmii_eth_cpu_lwip_core].stats;
+
+    return stats->us[NETIF_RMII_ETHERNET_CPU_SLEEP] + stats->us[NETIF_RMII_ETHERNET_CPU_EMPTY];
+}
+
+uint netif_rmii_ethernet_cpu_enter(enum netif_rmii_ethernet_cpu_class cls) {
+    return netif_rmii_ethernet_cpu_switch(cls);
+}
+
+// LWIP_APP_CALLBACK() of lwipopts.h
+uint netif_rmii_ethernet_cpu_app_enter() {
+    return netif_rmii_ethernet_cpu_switch(NETIF_RMII_ETHERNET_CPU_APP);
+}
+
+void netif_rmii_ethernet_cpu_leave(uint prev) {
+    netif_rmii_ethernet_cpu_switch(prev);
+}
+
+#define CPU_ENTER(cls) uint cpu_prev = netif_rmii_ethernet_cpu_switch(cls)
+#define CPU_LEAVE() netif_rmii_ethernet_cpu_switch(cpu_prev)
+#else
+#define CPU_ENTER(cls)
+#define CPU_LEAVE()
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+// priority frames of an interface to the callback, FCS checked
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_priority_process)(struct rmii_ethernet *eth) {
+    while (eth->rx_priority_tail != eth->rx_priority_head) {
+        struct rx_descriptor *desc = &eth->rx_priority_ring[eth->rx_priority_tail & RX_PRIORITY_MASK];
+
+        uint length = rmii_ethernet_frame_length(desc->frame, desc->received);
+        netif_rmii_ethernet_rx_priority_callback_t callback = eth->rx_priority_callback;
+
+        if (length == 0) {
+            eth->rx_priority_crc_err++;
+        } else if (callback != NULL) {
+            eth->rx_priority++;
+
+            CPU_ENTER(NETIF_RMII_ETHERNET_CPU_APP);
+            callback(eth->netif, desc->frame, length, desc->received_us, eth->rx_priority_arg);
+            CPU_LEAVE();
+        }
+
+        // the CRS_DV IRQ may swap the buffer out from here on
+        __dmb();
+
+        eth->rx_priority_tail++;
+    }
+}
+
+// of all interfaces, ahead of and in between the frames of their RX rings
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_priority_poll)() {
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        netif_rmii_ethernet_rx_priority_process(&rmii_eth_instances[i]);
+    }
+}
+#endif
+
+#if PICO_RMII_ETHERNET_ICMP_REFLECT || PICO_RMII_ETHERNET_RESPONDER
+// RFC 1624 eqn. 3, the big endian checksum at sum after the word at word changed to value
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_chksum_adjust)(uint8_t *sum, uint8_t *word, uint16_t value) {
+    uint32_t x = (uint16_t)~((sum[0] << 8) | sum[1]) + (uint16_t)~((word[0] << 8) | word[1]) + value;
+
+    x = (x & 0xffff) + (x >> 16);
+    x = (x & 0xffff) + (x >> 16);
+    x = ~x;
+
+    word[0] = value >> 8;
+    word[1] = value;
+    sum[0] = x >> 8;
+    sum[1] = x;
+}
+
+// the IP length of an echo request to the netif's MAC and address, 0 for any other frame.
+// The first available of its length bytes are contiguous at frame. The IP header is
+// checked, anything lwIP would look at twice (options, fragments, group or broadcast
+// sources) isn't taken. Only reads the netif, from the driver too
+static uint RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_echo_request)(struct netif *netif, const uint8_t *frame, uint available, uint length) {
+    const uint8_t *ip = frame + SIZEOF_ETH_HDR;
+    const uint8_t *icmp = ip + IP_HLEN;
+
+    if (available < (SIZEOF_ETH_HDR + IP_HLEN + sizeof(struct icmp_echo_hdr)) ||
+        memcmp(frame, netif->hwaddr, ETH_HWADDR_LEN) != 0 || (frame[6] & 0x01) ||
+        ((frame[12] << 8) | frame[13]) != ETHTYPE_IP) {
+        return 0;
+    }
+
+    // version 4 with no options, ICMP, neither MF nor a fragment offset, an echo request
+    if (ip[0] != 0x45 || ip[9] != IP_PROTO_ICMP || (ip[6] & 0x3f) != 0 || ip[7] != 0 ||
+        icmp[0] != ICMP_ECHO || icmp[1] != 0) {
+        return 0;
+    }
+
+    uint ip_length = (ip[2] << 8) | ip[3];
+    ip4_addr_t src, dest;
+
+    memcpy(&src, ip + 12, sizeof(src));
+    memcpy(&dest, ip + 16, sizeof(dest));
+
+    if (ip_length < (IP_HLEN + sizeof(struct icmp_echo_hdr)) || ip_length > (length - SIZEOF_ETH_HDR) ||
+        !netif_is_up(netif) || ip4_addr_isany_val(*netif_ip4_addr(netif)) ||
+        !ip4_addr_cmp(&dest, netif_ip4_addr(netif)) || ip4_addr_isany_val(src) ||
+        ip4_addr_ismulticast(&src) || ip4_addr_isbroadcast(&src, netif) || inet_chksum(ip, IP_HLEN) != 0) {
+        return 0;
+    }
+
+    return ip_length;
+}
+
+// turns an echo request around into the reply: MACs and addresses swapped, the TTL and the
+// type set. Only those change, so both checksums are adjusted instead of summed again, and
+// a request with a bad ICMP checksum goes back with one too, for the pinger to drop
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_echo_turn)(struct netif *netif, uint8_t *frame) {
+    uint8_t *ip = frame + SIZEOF_ETH_HDR;
+    uint8_t *icmp = ip + IP_HLEN;
+    ip4_addr_t src, dest;
+
+    memcpy(&src, ip + 12, sizeof(src));
+    memcpy(&dest, ip + 16, sizeof(dest));
+
+    memcpy(frame, frame + ETH_HWADDR_LEN, ETH_HWADDR_LEN);
+    memcpy(frame + ETH_HWADDR_LEN, netif->hwaddr, ETH_HWADDR_LEN);
+    memcpy(ip + 12, &dest, sizeof(dest));
+    memcpy(ip + 16, &src, sizeof(src));
+
+    netif_rmii_ethernet_chksum_adjust(ip + 10, ip + 8, (ICMP_TTL << 8) | IP_PROTO_ICMP);
+    netif_rmii_ethernet_chksum_adjust(icmp + 2, icmp, ICMP_ER << 8);
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RESPONDER
+// the buffer of the next reply, NULL while all of them wait for the DMA
+static uint8_t *RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_responder_slot)(struct rmii_ethernet *eth) {
+    if ((eth->tx_responder_head - eth->tx_responder_dma) == PICO_RMII_ETHERNET_RESPONDER_SLOTS) {
+        return NULL;
+    }
+
+    return eth->tx_responder_frames[eth->tx_responder_head & TX_RESPONDER_MASK];
+}
+
+// builds the reply of length bytes in the buffer netif_rmii_ethernet_responder_slot()
+// gave for the link speed and hands it to the DMA, ahead of the rings
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_responder_send)(struct rmii_ethernet *eth, uint length) {
+    uint slot = eth->tx_responder_head & TX_RESPONDER_MASK;
+    struct tx_descriptor *desc = &eth->tx_responder[slot];
+    struct pbuf p;
 
-#include "rmii_ethernet/netif.h"
+    // the DMA blocks point at the payload, the pbuf is only needed while they are built
+    memset(&p, 0, sizeof(p));
+    p.payload = eth->tx_responder_frames[slot];
+    p.len = p.tot_len = length;
+    desc->p = &p;
+
+#if PICO_RMII_ETHERNET_100M
+    if (eth->tx_fast || PICO_RMII_ETHERNET_REF_CLK_SYNC) {
+        netif_rmii_ethernet_tx_fast_build(eth, desc, eth->tx_responder_fast_frames[slot], NULL);
+    } else
+#endif
+    {
+        netif_rmii_ethernet_tx_build(eth, desc, NULL);
+    }
+
+    desc->p = NULL;
 
-#define PICO_RMII_ETHERNET_PIO      (rmii_eth_netif_config.pio)
-#define PICO_RMII_ETHERNET_SM_RX    (rmii_eth_netif_config.pio_sm_start)
-#define PICO_RMII_ETHERNET_SM_TX    (rmii_eth_netif_config.pio_sm_start + 1)
-#define PICO_RMII_ETHERNET_RX_PIN   (rmii_eth_netif_config.rx_pin_start)
-#define PICO_RMII_ETHERNET_TX_PIN   (rmii_eth_netif_config.tx_pin_start)
-#define PICO_RMII_ETHERNET_MDIO_PIN (rmii_eth_netif_config.mdio_pin_start)
-#define PICO_RMII_ETHERNET_MDC_PIN  (rmii_eth_netif_config.mdio_pin_start + 1)
-#define PICO_RMII_ETHERNET_MAC_ADDR (rmii_eth_netif_config.mac_addr)
+    uint32_t save = spin_lock_blocking(eth->tx_ring_lock);
 
-static struct netif *rmii_eth_netif;
-static struct netif_rmii_ethernet_config rmii_eth_netif_config = NETIF_RMII_ETHERNET_DEFAULT_CONFIG();
+    eth->tx_responder_head++;
 
-static uint rx_sm_offset;
-static uint tx_sm_offset;
+    if (!eth->tx_busy) {
+        eth->tx_busy = true;
+        netif_rmii_ethernet_tx_next(eth);
+    }
 
-static int rx_dma_chan;
-static int tx_dma_chan;
+    spin_unlock(eth->tx_ring_lock, save);
+}
 
-static dma_channel_config rx_dma_channel_config;
-static dma_channel_config tx_dma_channel_config;
+// from the driver's FCS check: answers an ARP request for the netif's address with its
+// reply, and an echo request up to PICO_RMII_ETHERNET_RESPONDER_FRAME_MAX by turning a
+// copy of it around. RX_RESPONDED_NONE for anything else, and while all reply buffers wait
+// for the DMA: lwIP answers those
+static uint8_t RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_responder_take)(struct rmii_ethernet *eth, const uint8_t *frame, uint length) {
+    struct netif *netif = eth->netif;
+    uint8_t *reply;
 
-static int phy_address = 0;
+    if (length < SIZEOF_ETH_HDR || (frame[6] & 0x01) || !netif_is_up(netif) ||
+        ip4_addr_isany_val(*netif_ip4_addr(netif))) {
+        return RX_RESPONDED_NONE;
+    }
 
-//static uint8_t rx_frame[1518];
-static uint8_t rx_frame[1542];
-static uint8_t tx_frame[1542];
-static uint8_t tx_frame_bits[1542 * 4];
+#if PICO_LWIP_VLAN
+    if (eth->vlan_vid >= 0) {
+        // the replies would need the tag
+        return RX_RESPONDED_NONE;
+    }
+#endif
 
-static const uint32_t ethernet_polynomial_le = 0xedb88320U;
+    if (((frame[12] << 8) | frame[13]) == ETHTYPE_ARP) {
+        const struct etharp_hdr *hdr = (const struct etharp_hdr *)(frame + SIZEOF_ETH_HDR);
+        ip4_addr_t sipaddr, dipaddr;
 
-static uint ethernet_frame_crc(const uint8_t *data, int length)
-{
-    uint crc = 0xffffffff;  /* Initial value. */
+        if (length < RESPONDER_ARP_SIZE || hdr->hwtype != PP_HTONS(LWIP_IANA_HWTYPE_ETHERNET) ||
+            hdr->hwlen != ETH_HWADDR_LEN || hdr->protolen != sizeof(ip4_addr_t) ||
+            hdr->proto != PP_HTONS(ETHTYPE_IP) || hdr->opcode != PP_HTONS(ARP_REQUEST)) {
+            return RX_RESPONDED_NONE;
+        }
 
-    while(--length >= 0) 
-    {
-        uint8_t current_octet = *data++;
+        IPADDR_WORDALIGNED_COPY_TO_IP4_ADDR_T(&sipaddr, &hdr->sipaddr);
+        IPADDR_WORDALIGNED_COPY_TO_IP4_ADDR_T(&dipaddr, &hdr->dipaddr);
 
-        for (int bit = 8; --bit >= 0; current_octet >>= 1) {
-          if ((crc ^ current_octet) & 1) {
-            crc >>= 1;
-            crc ^= ethernet_polynomial_le;
-          } else
-            crc >>= 1;
+        // probes and announcements (from 0.0.0.0 or from the address itself) are for lwIP
+        // to see, a conflict is its to handle
+        if (!ip4_addr_cmp(&dipaddr, netif_ip4_addr(netif)) || ip4_addr_isany_val(sipaddr) ||
+            ip4_addr_cmp(&sipaddr, netif_ip4_addr(netif)) || (reply = netif_rmii_ethernet_responder_slot(eth)) == NULL) {
+            return RX_RESPONDED_NONE;
         }
+
+        struct etharp_hdr *out = (struct etharp_hdr *)(reply + SIZEOF_ETH_HDR);
+
+        memcpy(reply, &hdr->shwaddr, ETH_HWADDR_LEN);
+        memcpy(reply + ETH_HWADDR_LEN, netif->hwaddr, ETH_HWADDR_LEN);
+        reply[12] = ETHTYPE_ARP >> 8;
+        reply[13] = ETHTYPE_ARP & 0xff;
+
+        out->hwtype = PP_HTONS(LWIP_IANA_HWTYPE_ETHERNET);
+        out->proto = PP_HTONS(ETHTYPE_IP);
+        out->hwlen = ETH_HWADDR_LEN;
+        out->protolen = sizeof(ip4_addr_t);
+        out->opcode = PP_HTONS(ARP_REPLY);
+        SMEMCPY(&out->shwaddr, netif->hwaddr, ETH_HWADDR_LEN);
+        IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&out->sipaddr, netif_ip4_addr(netif));
+        SMEMCPY(&out->dhwaddr, &hdr->shwaddr, ETH_HWADDR_LEN);
+        IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&out->dipaddr, &sipaddr);
+
+        netif_rmii_ethernet_responder_send(eth, RESPONDER_ARP_SIZE);
+        eth->stats.rx_responded_arp++;
+
+        return RX_RESPONDED_ARP;
     }
 
-    return ~crc;
+    uint ip_length = netif_rmii_ethernet_echo_request(netif, frame, length, length);
+
+    if (ip_length == 0 || (SIZEOF_ETH_HDR + ip_length) > PICO_RMII_ETHERNET_RESPONDER_FRAME_MAX ||
+        (reply = netif_rmii_ethernet_responder_slot(eth)) == NULL) {
+        return RX_RESPONDED_NONE;
+    }
+
+    // the minimum frame's padding isn't echoed
+    memcpy(reply, frame, SIZEOF_ETH_HDR + ip_length);
+    netif_rmii_ethernet_echo_turn(netif, reply);
+
+    netif_rmii_ethernet_responder_send(eth, SIZEOF_ETH_HDR + ip_length);
+    eth->stats.rx_responded_echo++;
+
+    return RX_RESPONDED_ECHO;
 }
+#endif
 
-static uint ethernet_frame_length(const uint8_t *data, int length) {
-    uint crc = 0xffffffff;  /* Initial value. */
-    uint index = 0;
+// driver side of RX: FCS checks of received frames and re-arming a stalled receiver
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_process)(struct rmii_ethernet *eth) {
+    bool checked = false;
 
-    while(--length >= 0) 
-    {
-        uint8_t current_octet = *data++;
+    while (eth->rx_ring_checked != eth->rx_ring_head) {
+        struct rx_descriptor *desc = &eth->rx_ring[eth->rx_ring_checked & RX_RING_MASK];
+
+        RMII_ETHERNET_PROFILE_RECORD(RX_WAIT, desc->t);
+
+        desc->length = rmii_ethernet_frame_length(desc->frame, desc->received);
+        RMII_ETHERNET_TRACE(RMII_RX_FRAME, desc->length, 0, 0);
 
-        for (int bit = 8; --bit >= 0; current_octet >>= 1) {
-          if ((crc ^ current_octet) & 1) {
-            crc >>= 1;
-            crc ^= ethernet_polynomial_le;
-          } else
-            crc >>= 1;
+#if PICO_RMII_ETHERNET_PAUSE
+        if (netif_rmii_ethernet_pause_frame(desc->frame, desc->length)) {
+            netif_rmii_ethernet_pause_take(eth, desc->frame);
         }
+#endif
+
+#if PICO_RMII_ETHERNET_RESPONDER
+        // answered before the frame is lwIP's, however far behind it is
+        desc->responded = desc->length ? netif_rmii_ethernet_responder_take(eth, desc->frame, desc->length) : RX_RESPONDED_NONE;
+#endif
+
+        RMII_ETHERNET_PROFILE_RECORD(RX_FCS, desc->t);
+
+        __dmb();
+
+        eth->rx_ring_checked++;
+        checked = true;
 
-        index++;
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+        // a priority frame waits for one FCS check at most
+        netif_rmii_ethernet_rx_priority_poll();
+#endif
+    }
+
+    if (checked) {
+        netif_rmii_ethernet_doorbell();
+    }
+
+#if PICO_RMII_ETHERNET_PAUSE
+    netif_rmii_ethernet_pause_service(eth);
+#endif
 
-        uint inverted_crc = ~crc;
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    if (eth->rx_landing && (eth->rx_ring_head - eth->rx_ring_tail) <= RX_RING_MASK &&
+        eth->rx_ring[eth->rx_ring_head & RX_RING_MASK].frame != NULL) {
+        // lwIP made room: move RX back to the ring unless a frame is on its way into the
+        // priority slot, the CRS_DV IRQ at its end does it then
+        uint32_t save = save_and_disable_interrupts();
+#if PICO_RMII_ETHERNET_RX_PEEK
+        uint untouched = RX_PEEK_DMA;
+#else
+        uint untouched = RX_DMA_MAX;
+#endif
 
-        if (memcmp(data, &inverted_crc, sizeof(inverted_crc)) == 0) {
-            return index;
+        if (eth->rx_landing && !gpio_get(PICO_RMII_ETHERNET_RX_PIN + 2) && dma_hw->ch[eth->rx_dma_chan].transfer_count == untouched) {
+            rmii_ethernet_phy_rx_restart(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX, eth->rx_sm_offset);
+#if PICO_RMII_ETHERNET_RX_PEEK
+            netif_rmii_ethernet_rx_dma_abort(eth);
+#else
+            dma_channel_abort(eth->rx_dma_chan);
+#endif
+            rmii_ethernet_phy_rx_flush(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX);
+
+            netif_rmii_ethernet_rx_start(eth, netif_rmii_ethernet_rx_next(eth));
         }
+
+        restore_interrupts(save);
     }
+#endif
+
+    if (eth->rx_stalled && netif_rmii_ethernet_rx_next(eth) != NULL) {
+        // first call, or the ring filled up and a slot has been drained since: restart RX
+        // into it, or into a free priority slot while lwIP is still behind
+        uint32_t save = save_and_disable_interrupts();
+
+        eth->rx_stalled = false;
+        netif_rmii_ethernet_rx_start(eth, netif_rmii_ethernet_rx_next(eth));
 
-    return 0;
+#if PICO_RMII_ETHERNET_TIMESTAMP
+        // counts of frames that went by unarmed, RX waits for the end of one that is coming in
+        uint32_t stale;
+
+        netif_rmii_ethernet_timestamp_take(eth, &stale);
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PEEK
+        // on the core that takes the CRS_DV interrupts, the two never run at once
+        if (!rx_peek_irq_added) {
+            rx_peek_irq_added = true;
+            irq_add_shared_handler(DMA_IRQ_1, netif_rmii_ethernet_rx_peek_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+            irq_set_enabled(DMA_IRQ_1, true);
+        }
+#endif
+
+        gpio_set_irq_enabled_with_callback(PICO_RMII_ETHERNET_RX_PIN + 2, GPIO_IRQ_EDGE_FALL, true, &netif_rmii_ethernet_rx_dv_falling_callback);
+
+        restore_interrupts(save);
+    }
 }
 
-static void netif_rmii_ethernet_mdio_clock_out(int bit)
-{
-    gpio_put(PICO_RMII_ETHERNET_MDC_PIN, 0);
-    sleep_us(1);
-    gpio_put(PICO_RMII_ETHERNET_MDIO_PIN, bit);
-    gpio_put(PICO_RMII_ETHERNET_MDC_PIN, 1);
-    sleep_us(1);
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_driver_poll)() {
+    CPU_ENTER(NETIF_RMII_ETHERNET_CPU_DRIVER);
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+    netif_rmii_ethernet_rx_priority_poll();
+#endif
+
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        struct rmii_ethernet *eth = &rmii_eth_instances[i];
+
+        netif_rmii_ethernet_rx_process(eth);
+        netif_rmii_ethernet_tx_process(eth);
+    }
+
+    CPU_LEAVE();
 }
 
-static uint netif_rmii_ethernet_mdio_clock_in()
-{
-    gpio_put(PICO_RMII_ETHERNET_MDC_PIN, 0);
-    sleep_us(1);
-    gpio_put(PICO_RMII_ETHERNET_MDC_PIN, 1);
-    
-    int bit = gpio_get(PICO_RMII_ETHERNET_MDIO_PIN);
-    sleep_us(1);
+#if PICO_RMII_ETHERNET_TIMEOUT_ALARM
+static void netif_rmii_ethernet_timeouts_alarm(uint alarm) {
+    (void)alarm;
+
+    timeouts_due = true;
 
-    return bit;
+    // the other core may be polling lwIP, wake it from __wfe() too
+    __sev();
 }
 
-static uint16_t netif_rmii_ethernet_mdio_read(uint addr, uint reg)
-{
-    gpio_init(PICO_RMII_ETHERNET_MDIO_PIN);
-    gpio_init(PICO_RMII_ETHERNET_MDC_PIN);
+// the time is only read here, when the first timeout changed
+static void netif_rmii_ethernet_timeouts_arm(u32_t time) {
+    // sys_now() is timebase_ms(), whole ms of the same timer, the alarm goes off at the
+    // start of the deadline's ms, as the first poll in it would see it
+    uint64_t now_ms = timebase_us_64() / 1000;
+    s32_t delay = (s32_t)(time - (u32_t)now_ms);
 
-    gpio_set_dir(PICO_RMII_ETHERNET_MDIO_PIN, GPIO_OUT);
-    gpio_set_dir(PICO_RMII_ETHERNET_MDC_PIN, GPIO_OUT);
+    timeouts_armed = true;
+    timeouts_armed_time = time;
 
-    // PRE_32
-    for (int i = 0; i < 32; i++) {
-        netif_rmii_ethernet_mdio_clock_out(1);
+    // hardware_alarm_set_target() says when the target has passed already
+    if (delay <= 0 || hardware_alarm_set_target(timeouts_alarm, from_us_since_boot((now_ms + delay) * 1000))) {
+        timeouts_due = true;
     }
+}
 
-    // ST
-    netif_rmii_ethernet_mdio_clock_out(0);
-    netif_rmii_ethernet_mdio_clock_out(1);
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_timeouts_service)() {
+    u32_t time;
 
-    // OP
-    netif_rmii_ethernet_mdio_clock_out(1);
-    netif_rmii_ethernet_mdio_clock_out(0);
+    if (timeouts_alarm < 0) {
+        timeouts_alarm = hardware_alarm_claim_unused(true);
+        hardware_alarm_set_callback(timeouts_alarm, netif_rmii_ethernet_timeouts_alarm);
+    }
 
-    // PA5
-    for (int i = 0; i < 5; i++) {
-        uint bit = (addr >> (4 - i)) & 0x01;
+    if (timeouts_due) {
+        timeouts_due = false;
+        timeouts_armed = false;
 
-        netif_rmii_ethernet_mdio_clock_out(bit);
+        sys_check_timeouts();
     }
 
-    // RA5
-    for (int i = 0; i < 5; i++) {
-        uint bit = (reg >> (4 - i)) & 0x01;
-
-        netif_rmii_ethernet_mdio_clock_out(bit);
+    // lwIP and the application add timeouts between alarms, a new first one may be due
+    // earlier than the alarm is set for
+    if (!lwip_timeouts_next(&time)) {
+        timeouts_armed = false;
+    } else if (!timeouts_armed || time != timeouts_armed_time) {
+        netif_rmii_ethernet_timeouts_arm(time);
     }
+}
+#endif
+
+#if PICO_RMII_ETHERNET_RAW
+// a frame with a valid FCS to the callback of its EtherType, false when it has none
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_raw_input)(struct rmii_ethernet *eth, struct rx_descriptor *desc, uint length) {
+    uint16_t type = (desc->frame[12] << 8) | desc->frame[13];
+
+    for (uint i = 0; i < PICO_RMII_ETHERNET_RAW_RX_HANDLERS; i++) {
+        struct raw_rx_handler *handler = &eth->raw_rx_handlers[i];
+
+        if (handler->type != type) {
+            continue;
+        }
+
+        eth->stats.rx_raw++;
+        LINK_STATS_INC(link.recv);
+        MIB2_STATS_NETIF_ADD(eth->netif, ifinoctets, length);
+
+        if (desc->frame[0] & 0x01) {
+            MIB2_STATS_NETIF_INC(eth->netif, ifinnucastpkts);
+        } else {
+            MIB2_STATS_NETIF_INC(eth->netif, ifinucastpkts);
+        }
 
-    // TA
-    gpio_set_dir(PICO_RMII_ETHERNET_MDIO_PIN, GPIO_IN);
-    netif_rmii_ethernet_mdio_clock_out(0);
-    netif_rmii_ethernet_mdio_clock_out(0);
+#if PICO_RMII_ETHERNET_TIMESTAMP
+        eth->timestamp_rx = desc->timestamp;
+        eth->timestamp_rx_valid = desc->timestamped;
+#endif
 
-    uint16_t data = 0;
+        CPU_ENTER(NETIF_RMII_ETHERNET_CPU_APP);
+        handler->callback(eth->netif, desc->frame, length, handler->arg);
+        CPU_LEAVE();
 
-    for (int i = 0; i < 16; i++) {
-        data <<= 1;
+#if PICO_RMII_ETHERNET_TIMESTAMP
+        eth->timestamp_rx_valid = false;
+#endif
 
-        data |= netif_rmii_ethernet_mdio_clock_in();
+        return true;
     }
 
-    return data;
+    return false;
 }
+#endif
 
-void netif_rmii_ethernet_mdio_write(int addr, int reg, int val)
-{
-    gpio_init(PICO_RMII_ETHERNET_MDIO_PIN);
-    gpio_init(PICO_RMII_ETHERNET_MDC_PIN);
+#if PICO_RMII_ETHERNET_ICMP_REFLECT
+// an echo request to the netif's MAC and address sent back as the reply from the buffer it
+// came in, true when p is taken, see netif_rmii_ethernet_echo_request() for which
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_icmp_reflect)(struct rmii_ethernet *eth, struct pbuf *p) {
+    struct netif *netif = eth->netif;
+    uint ip_length = netif_rmii_ethernet_echo_request(netif, p->payload, p->len, p->tot_len);
+
+    if (ip_length == 0) {
+        return false;
+    }
+
+    ICMP_STATS_INC(icmp.recv);
+    MIB2_STATS_INC(mib2.icmpinmsgs);
+    MIB2_STATS_INC(mib2.icmpinechos);
+
+    // the minimum frame's padding isn't echoed
+    pbuf_realloc(p, SIZEOF_ETH_HDR + ip_length);
+
+    netif_rmii_ethernet_echo_turn(netif, p->payload);
+
+    eth->stats.rx_icmp_reflected++;
+    ICMP_STATS_INC(icmp.xmit);
+    MIB2_STATS_INC(mib2.icmpoutmsgs);
+    MIB2_STATS_INC(mib2.icmpoutechoreps);
+
+    // with PICO_RMII_ETHERNET_RX_ZERO_COPY the TX DMA sends it from the RX buffer
+    netif->linkoutput(netif, p);
+    pbuf_free(p);
+
+    return true;
+}
+#endif
 
-    gpio_set_dir(PICO_RMII_ETHERNET_MDIO_PIN, GPIO_OUT);
-    gpio_set_dir(PICO_RMII_ETHERNET_MDC_PIN, GPIO_OUT);
+#if PICO_RMII_ETHERNET_RESPONDER
+// a frame the driver answered, to the counters, and the sender of an ARP request to lwIP's
+// ARP table as etharp_input() would have put it there, packets queued on it go out now
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_responder_input)(struct rmii_ethernet *eth, struct rx_descriptor *desc, uint length) {
+    struct netif *netif = eth->netif;
+    uint reply_length = length;
 
-    // PRE_32
-    for (int i = 0; i < 32; i++) {
-        netif_rmii_ethernet_mdio_clock_out(1);
+    LWIP_UNUSED_ARG(reply_length);
+
+    eth->stats.rx_ok++;
+    LINK_STATS_INC(link.recv);
+    MIB2_STATS_NETIF_ADD(netif, ifinoctets, length);
+
+    if (desc->frame[0] & 0x01) {
+        MIB2_STATS_NETIF_INC(netif, ifinnucastpkts);
+    } else {
+        MIB2_STATS_NETIF_INC(netif, ifinucastpkts);
     }
 
-    // ST
-    netif_rmii_ethernet_mdio_clock_out(0);
-    netif_rmii_ethernet_mdio_clock_out(1);
+    if (desc->responded == RX_RESPONDED_ARP) {
+        const struct etharp_hdr *hdr = (const struct etharp_hdr *)(desc->frame + SIZEOF_ETH_HDR);
+        ip4_addr_t sipaddr;
+        struct eth_addr shwaddr;
+
+        IPADDR_WORDALIGNED_COPY_TO_IP4_ADDR_T(&sipaddr, &hdr->sipaddr);
+        SMEMCPY(&shwaddr, &hdr->shwaddr, ETH_HWADDR_LEN);
 
-    // OP
-    netif_rmii_ethernet_mdio_clock_out(0);
-    netif_rmii_ethernet_mdio_clock_out(1);
+        ETHARP_STATS_INC(etharp.recv);
+        ETHARP_STATS_INC(etharp.xmit);
 
-    // PA5
-    for (int i = 0; i < 5; i++) {
-        uint bit = (addr >> (4 - i)) & 0x01;
+        etharp_update_entry(netif, &sipaddr, &shwaddr);
 
-        netif_rmii_ethernet_mdio_clock_out(bit);
+        reply_length = RESPONDER_ARP_SIZE;
+    } else {
+        ICMP_STATS_INC(icmp.recv);
+        ICMP_STATS_INC(icmp.xmit);
+        MIB2_STATS_INC(mib2.icmpinmsgs);
+        MIB2_STATS_INC(mib2.icmpinechos);
+        MIB2_STATS_INC(mib2.icmpoutmsgs);
+        MIB2_STATS_INC(mib2.icmpoutechoreps);
     }
 
-    // RA5
-    for (int i = 0; i < 5; i++) {
-        uint bit = (reg >> (4 - i)) & 0x01;
+    LINK_STATS_INC(link.xmit);
+    MIB2_STATS_NETIF_ADD(netif, ifoutoctets, reply_length);
+    MIB2_STATS_NETIF_INC(netif, ifoutucastpkts);
+}
+#endif
+
+#if PICO_RMII_ETHERNET_WAKE
+// a frame with a valid FCS while the interface sleeps, true when it goes no further
+static bool netif_rmii_ethernet_wake_take(struct rmii_ethernet *eth, const uint8_t *frame, uint length) {
+    bool unicast = (eth->wake_match & NETIF_RMII_ETHERNET_WAKE_UNICAST) &&
+        memcmp(frame, eth->netif->hwaddr, ETH_HWADDR_LEN) == 0;
+    bool magic = !unicast && (eth->wake_match & NETIF_RMII_ETHERNET_WAKE_MAGIC) &&
+        rmii_ethernet_frame_magic(frame, length, eth->netif->hwaddr);
+
+    if (!unicast && !magic) {
+        eth->stats.rx_asleep++;
+        LINK_STATS_INC(link.drop);
+        MIB2_STATS_NETIF_INC(eth->netif, ifindiscards);
 
-        netif_rmii_ethernet_mdio_clock_out(bit);
+        return true;
     }
 
-    // TA
-    netif_rmii_ethernet_mdio_clock_out(1);
-    netif_rmii_ethernet_mdio_clock_out(0);
+    eth->stats.wakeups++;
 
-    for (int i = 0; i < 16; i++) {
-        uint bit = (val >> (15 - i)) & 0x01;
+    netif_rmii_ethernet_wake_up(eth);
 
-        netif_rmii_ethernet_mdio_clock_out(bit);
+    if (eth->wake_callback != NULL) {
+        eth->wake_callback(eth->netif, eth->wake_arg);
     }
 
-    gpio_set_dir(PICO_RMII_ETHERNET_MDIO_PIN, GPIO_IN);
+    // the magic packet was only for waking up, a unicast frame goes on to lwIP
+    return magic;
 }
+#endif
 
-static err_t netif_rmii_ethernet_output(struct netif *netif, struct pbuf *p)
-{
-    uint tot_len = 0;
+#if PICO_RMII_ETHERNET_RX_CHKSUM
+// one channel for all interfaces, only used from lwIP context
+static int rx_chksum_dma_chan = -1;
+static dma_channel_config rx_chksum_dma_channel_config;
+static uint32_t rx_chksum_dma_sink;
 
-    memset(tx_frame, 0x00, sizeof(tx_frame));
+static void netif_rmii_ethernet_rx_chksum_init() {
+    if (rx_chksum_dma_chan >= 0) {
+        return;
+    }
 
-    for (struct pbuf *q = p; q != NULL; q = q->next) {
-        memcpy(tx_frame + tot_len, q->payload, q->len);
+    rx_chksum_dma_chan = dma_claim_unused_channel(true);
 
-        tot_len += q->len;
+    rx_chksum_dma_channel_config = dma_channel_get_default_config(rx_chksum_dma_chan);
 
-        if (q->len == q->tot_len) {
-            break;
+    channel_config_set_transfer_data_size(&rx_chksum_dma_channel_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&rx_chksum_dma_channel_config, true);
+    channel_config_set_write_increment(&rx_chksum_dma_channel_config, false);
+    channel_config_set_dreq(&rx_chksum_dma_channel_config, DREQ_FORCE);
+    channel_config_set_sniff_enable(&rx_chksum_dma_channel_config, true);
+}
+
+// the NETIF_CHECKSUM_CHECK_ flag of the check the frame passed, 0 for anything but an
+// unfragmented IPv4 TCP, UDP or ICMP packet with a good checksum, which lwIP then checks
+// as usual, counting the bad ones. The sniffer's sum is 32 bits without end around carry,
+// fed halfwords of at most 1500 bytes it doesn't overflow and can be folded afterwards.
+// Halfwords are summed in memory order, the pseudo header too, 0xffff is the same in both
+static u16_t RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_chksum)(const uint8_t *frame, uint length) {
+    const uint8_t *ip = frame + SIZEOF_ETH_HDR;
+
+    if (length < SIZEOF_ETH_HDR + IP_HLEN || frame[12] != (ETHTYPE_IP >> 8) || frame[13] != (ETHTYPE_IP & 0xff) ||
+        (ip[0] >> 4) != 4 || ((ip[6] & 0x3f) | ip[7]) != 0) {
+        return 0;
+    }
+
+    uint ihl = (ip[0] & 0x0f) * 4;
+    uint total = (ip[2] << 8) | ip[3];
+
+    if (ihl < IP_HLEN || total < ihl || total > length - SIZEOF_ETH_HDR) {
+        return 0;
+    }
+
+    const uint8_t *l4 = ip + ihl;
+    uint l4_len = total - ihl;
+    uint32_t sum = 0;
+    u16_t flag;
+
+    switch (ip[9]) {
+    case IP_PROTO_TCP:
+        flag = NETIF_CHECKSUM_CHECK_TCP;
+        break;
+    case IP_PROTO_UDP:
+        // a checksum of 0 is none, lwIP skips it on its own
+        if (l4_len < UDP_HLEN || (l4[6] | l4[7]) == 0) {
+            return 0;
         }
+        flag = NETIF_CHECKSUM_CHECK_UDP;
+        break;
+    case IP_PROTO_ICMP:
+        flag = NETIF_CHECKSUM_CHECK_ICMP;
+        break;
+    default:
+        return 0;
     }
 
-    if (tot_len < 60) {
-        // pad
-        tot_len = 60;
+    if ((uintptr_t)l4 & 1) {
+        return 0;
     }
 
-    uint crc = ethernet_frame_crc(tx_frame, tot_len);
+    if (flag != NETIF_CHECKSUM_CHECK_ICMP) {
+        // source and destination addresses, protocol and length
+        for (uint i = 12; i < 20; i += 2) {
+            sum += ip[i] | (ip[i + 1] << 8);
+        }
+        sum += lwip_htons(ip[9]) + lwip_htons(l4_len);
+    }
 
-    // printf("TX: ");
-    // for (int i = 0; i < tot_len; i++) {
-    //     printf("%02X", tx_frame[i]);
-    // }
-    // printf("\n");
+    if (l4_len >= 2) {
+        dma_sniffer_enable(rx_chksum_dma_chan, DMA_SNIFF_CTRL_CALC_VALUE_SUM, true);
+        dma_hw->sniff_data = sum;
 
-    dma_channel_wait_for_finish_blocking(tx_dma_chan);
+        dma_channel_configure(
+            rx_chksum_dma_chan, &rx_chksum_dma_channel_config,
+            &rx_chksum_dma_sink,
+            l4,
+            l4_len / 2,
+            true
+        );
 
-    int index = 0;
+        dma_channel_wait_for_finish_blocking(rx_chksum_dma_chan);
 
-    for (int i = 0; i < 31; i++) {
-        tx_frame_bits[index++] = 0x05;
+        sum = dma_hw->sniff_data;
+        dma_sniffer_disable();
     }
 
-    for (int i = 0; i < 1; i++) {
-        tx_frame_bits[index++] = 0x07;
+    if (l4_len & 1) {
+        sum += l4[l4_len - 1];
     }
 
-    for (int i = 0; i < tot_len; i++) {
-        uint8_t b = tx_frame[i];
+    sum = FOLD_U32T(sum);
+    sum = FOLD_U32T(sum);
 
-        tx_frame_bits[index++] = 0x04 | ((b >> 0) & 0x03);
-        tx_frame_bits[index++] = 0x04 | ((b >> 2) & 0x03);
-        tx_frame_bits[index++] = 0x04 | ((b >> 4) & 0x03);
-        tx_frame_bits[index++] = 0x04 | ((b >> 6) & 0x03);
+    if (sum != 0xffff) {
+        return 0;
     }
 
-    for (int i = 0; i < 4; i++) {
-        uint8_t b = ((uint8_t*)&crc)[i];
+    return flag;
+}
+#endif
 
-        tx_frame_bits[index++] = 0x04 | ((b >> 0) & 0x03);
-        tx_frame_bits[index++] = 0x04 | ((b >> 2) & 0x03);
-        tx_frame_bits[index++] = 0x04 | ((b >> 4) & 0x03);
-        tx_frame_bits[index++] = 0x04 | ((b >> 6) & 0x03);
-    }
-    
-    for (int i = 0; i < (12 * 4); i++) {
-        tx_frame_bits[index++] = 0x00;
+// a frame with a valid FCS to netif->input(), in a pbuf
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_rx_input)(struct rmii_ethernet *eth, struct rx_descriptor *desc, uint length) {
+#if PICO_RMII_ETHERNET_RX_CHKSUM
+    // before the zero copy slot gets a fresh buffer
+    u16_t verified = netif_rmii_ethernet_rx_chksum(desc->frame, length);
+#endif
+
+#if PICO_RMII_ETHERNET_RX_ZERO_COPY
+    // lend the DMA buffer to lwIP, the slot gets a fresh one
+    struct pbuf* p = pbuf_alloced_custom(PBUF_RAW, length, PBUF_REF, &desc->buf->pc, desc->frame, RX_FRAME_SIZE);
+
+    rx_descriptor_attach(eth, desc);
+#else
+    struct pbuf* p = pbuf_alloc(PBUF_RAW, length, PBUF_POOL);
+
+    if (p != NULL) {
+        pbuf_take(p, desc->frame, length);
     }
+#endif
 
-    dma_channel_configure(
-        tx_dma_chan, &tx_dma_channel_config,
-        ((uint8_t*)&PICO_RMII_ETHERNET_PIO->txf[PICO_RMII_ETHERNET_SM_TX]) + 3,
-        tx_frame_bits,
-        index,
-        false
-    );
+    RMII_ETHERNET_PROFILE_RECORD(RX_PBUF, desc->t);
 
-    dma_channel_start(tx_dma_chan);
+    if (p != NULL) {
+        eth->stats.rx_ok++;
+        LINK_STATS_INC(link.recv);
+        MIB2_STATS_NETIF_ADD(eth->netif, ifinoctets, length);
 
-    return ERR_OK;
-}
+        if (((uint8_t *)p->payload)[0] & 0x01) {
+            MIB2_STATS_NETIF_INC(eth->netif, ifinnucastpkts);
+        } else {
+            MIB2_STATS_NETIF_INC(eth->netif, ifinucastpkts);
+        }
+
+#if PICO_RMII_ETHERNET_ICMP_REFLECT
+        if (netif_rmii_ethernet_icmp_reflect(eth, p)) {
+            return;
+        }
+#endif
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+        eth->timestamp_rx = desc->timestamp;
+        eth->timestamp_rx_valid = desc->timestamped;
+#endif
+
+#if PICO_RMII_ETHERNET_RX_CHKSUM
+        // netif->input() runs the frame through lwIP before returning, with NO_SYS and with
+        // the tcpip core lock held around the poll
+        u16_t chksum_flags = eth->netif->chksum_flags;
+
+        if (verified) {
+            eth->stats.rx_chksum_verified++;
+            NETIF_SET_CHECKSUM_CTRL(eth->netif, chksum_flags & ~verified);
+        }
+#endif
 
-static void netif_rmii_ethernet_rx_dv_falling_callback(uint gpio, uint32_t events) {
-    if ((PICO_RMII_ETHERNET_RX_PIN + 2) == gpio) {
-        pio_sm_set_enabled(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX, false);
-        dma_channel_abort(rx_dma_chan); //dma_hw->abort = 1u << rx_dma_chan;
-        gpio_set_irq_enabled_with_callback(PICO_RMII_ETHERNET_RX_PIN + 2, GPIO_IRQ_EDGE_FALL, false, netif_rmii_ethernet_rx_dv_falling_callback);
+#if PICO_RMII_ETHERNET_LRO
+        // a segment lwip_lro holds is passed up by a later frame or the end of the poll
+        if (lwip_lro_input(&eth->lro, p, eth->netif) != ERR_OK) {
+#else
+        if (eth->netif->input(p, eth->netif) != ERR_OK) {
+#endif
+            pbuf_free(p);
+        }
+
+#if PICO_RMII_ETHERNET_RX_CHKSUM
+        NETIF_SET_CHECKSUM_CTRL(eth->netif, chksum_flags);
+#endif
+
+#if PICO_RMII_ETHERNET_TIMESTAMP
+        eth->timestamp_rx_valid = false;
+#endif
+    } else {
+        eth->stats.rx_nobuf++;
+        LINK_STATS_INC(link.memerr);
+        LINK_STATS_INC(link.drop);
+        MIB2_STATS_NETIF_INC(eth->netif, ifindiscards);
     }
 }
 
-static err_t netif_rmii_ethernet_low_init(struct netif *netif) {
-    rmii_eth_netif = netif;
+// lwIP side of an interface: received frames to netif->input(), sent ones released
+static void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_lwip_poll)(struct rmii_ethernet *eth) {
+#if LWIP_TCP && LWIP_TCP_OUTPUT_BATCH
+    // what lwIP sends for the frames of this pass goes out after the last of them, one ACK
+    // per connection instead of one per second segment
+    tcp_output_batch_begin();
+#endif
 
-    netif->linkoutput = netif_rmii_ethernet_output;
-    netif->output     = etharp_output;
-    netif->mtu        = 1500; 
-    netif->flags      = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_IGMP | NETIF_FLAG_MLD6;
+#if PICO_RMII_ETHERNET_RX_POLL_BUDGET
+    uint budget_end = eth->rx_ring_tail + PICO_RMII_ETHERNET_RX_POLL_BUDGET;
 
-    if (PICO_RMII_ETHERNET_MAC_ADDR != NULL) {
-        memcpy(netif->hwaddr, PICO_RMII_ETHERNET_MAC_ADDR, 6);
-    } else {
-        // generate one for unique board id
-        pico_unique_board_id_t board_id;
-    
-        pico_get_unique_board_id(&board_id);
+    while (eth->rx_ring_tail != eth->rx_ring_checked && eth->rx_ring_tail != budget_end) {
+#else
+    while (eth->rx_ring_tail != eth->rx_ring_checked) {
+#endif
+        struct rx_descriptor *desc = &eth->rx_ring[eth->rx_ring_tail & RX_RING_MASK];
 
-        netif->hwaddr[0] = 0xb8;
-        netif->hwaddr[1] = 0x27;
-        netif->hwaddr[2] = 0xeb;
-        memcpy(&netif->hwaddr[3], &board_id.id[5], 3);
+        uint rx_frame_length = desc->length;
+
+        RMII_ETHERNET_PROFILE_RECORD(RX_QUEUE, desc->t);
+
+        if (rx_frame_length) {
+            RMII_ETHERNET_CAPTURE_RX(desc->frame, rx_frame_length);
+
+#if PICO_RMII_ETHERNET_RESPONDER
+            if (desc->responded != RX_RESPONDED_NONE) {
+                // the driver has answered it
+                netif_rmii_ethernet_responder_input(eth, desc, rx_frame_length);
+            } else
+#endif
+#if PICO_RMII_ETHERNET_PAUSE
+            if (netif_rmii_ethernet_pause_frame(desc->frame, rx_frame_length)) {
+                // the driver has honoured it, MAC control frames aren't lwIP's
+            } else
+#endif
+#if PICO_RMII_ETHERNET_WAKE
+            if (eth->wake_match && netif_rmii_ethernet_wake_take(eth, desc->frame, rx_frame_length)) {
+                // asleep, or the magic packet that woke the interface up
+            } else
+#endif
+#if PICO_RMII_ETHERNET_RAW
+            if (!netif_rmii_ethernet_raw_input(eth, desc, rx_frame_length))
+#endif
+            {
+                netif_rmii_ethernet_rx_input(eth, desc, rx_frame_length);
+            }
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY && !PICO_RMII_ETHERNET_DUAL_CORE
+            // a priority frame waits for one frame's input at most
+            netif_rmii_ethernet_rx_priority_poll();
+#endif
+
+            RMII_ETHERNET_PROFILE_RECORD(RX_INPUT, desc->t);
+        } else {
+            RMII_ETHERNET_CAPTURE_RX_CRC_ERR(desc->frame, desc->received);
+
+            eth->stats.rx_crc_err++;
+            LINK_STATS_INC(link.chkerr);
+            LINK_STATS_INC(link.drop);
+            MIB2_STATS_NETIF_INC(eth->netif, ifinerrors);
+        }
+
+        eth->rx_ring_tail++;
     }
-    
-    
-    netif->hwaddr_len = ETH_HWADDR_LEN;
-    
-    rx_sm_offset = pio_add_program(PICO_RMII_ETHERNET_PIO, &rmii_ethernet_phy_rx_data_program);
-    tx_sm_offset = pio_add_program(PICO_RMII_ETHERNET_PIO, &rmii_ethernet_phy_tx_data_program);
 
-    rx_dma_chan = dma_claim_unused_channel(true);
-    tx_dma_chan = dma_claim_unused_channel(true);
+#if PICO_RMII_ETHERNET_LRO
+    lwip_lro_flush(&eth->lro, eth->netif);
+#endif
 
-    rx_dma_channel_config = dma_channel_get_default_config(rx_dma_chan);
-        
-    channel_config_set_read_increment(&rx_dma_channel_config, false);
-    channel_config_set_write_increment(&rx_dma_channel_config, true);
-    channel_config_set_dreq(&rx_dma_channel_config, pio_get_dreq(PICO_RMII_ETHERNET_PIO,PICO_RMII_ETHERNET_SM_RX, false));
-    channel_config_set_transfer_data_size(&rx_dma_channel_config, DMA_SIZE_8);
+#if LWIP_TCP && LWIP_TCP_OUTPUT_BATCH
+    tcp_output_batch_end();
+#endif
 
-    tx_dma_channel_config = dma_channel_get_default_config(tx_dma_chan);
+    netif_rmii_ethernet_tx_release(eth);
+    netif_rmii_ethernet_mdio_service(eth);
+#if PICO_RMII_ETHERNET_TIMESTAMP
+    netif_rmii_ethernet_timestamp_service(eth);
+#endif
 
-    channel_config_set_read_increment(&tx_dma_channel_config, true);
-    channel_config_set_write_increment(&tx_dma_channel_config, false);
-    channel_config_set_dreq(&tx_dma_channel_config, pio_get_dreq(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TX, true));
-    channel_config_set_transfer_data_size(&tx_dma_channel_config, DMA_SIZE_8);
+    uint32_t overrun = eth->rx_overrun;
 
-    rmii_ethernet_phy_tx_init(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_TX, tx_sm_offset, PICO_RMII_ETHERNET_TX_PIN);
+    if (overrun != eth->rx_overrun_reported) {
+        // missed frames were never received, they count as discards
+#if LINK_STATS
+        lwip_stats.link.drop += overrun - eth->rx_overrun_reported;
+#endif
+        MIB2_STATS_NETIF_ADD(eth->netif, ifindiscards, overrun - eth->rx_overrun_reported);
 
-    for (int i = 0; i < 32; i++) {
-        if (netif_rmii_ethernet_mdio_read(i, 0) != 0xffff) {
-            phy_address = i;
+        eth->rx_overrun_reported = overrun;
+    }
 
-            break;
+#if PICO_RMII_ETHERNET_RX_ZERO_COPY
+    // retry slots that were left without a buffer while lwIP held them all
+    bool attached = false;
+
+    for (uint i = eth->rx_ring_head; i != (eth->rx_ring_tail + PICO_RMII_ETHERNET_RX_RING_SIZE); i++) {
+        if (eth->rx_ring[i & RX_RING_MASK].frame == NULL) {
+            rx_descriptor_attach(eth, &eth->rx_ring[i & RX_RING_MASK]);
+            attached = true;
         }
     }
 
-    // netif_rmii_ethernet_mdio_write(phy_address, 0, 0x2000); // 10 Mbps, auto negeotiate disabled
+    if (attached && eth->rx_stalled) {
+        netif_rmii_ethernet_doorbell();
+    }
+#endif
+}
 
-    netif_rmii_ethernet_mdio_write(phy_address, 4, 0x61);
-    netif_rmii_ethernet_mdio_write(phy_address, 0, 0x1000);
+void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_poll)() {
+#if !NO_SYS
+    // lwIP belongs to the tcpip thread, feed it holding the core lock
+    LOCK_TCPIP_CORE();
+#endif
 
-    return ERR_OK;
-}
+#if PICO_RMII_ETHERNET_CPU_STATS
+    // the pass is lwIP's, but for the driver's part and the callbacks
+    uint cpu_prev = netif_rmii_ethernet_cpu_pass_begin(NETIF_RMII_ETHERNET_CPU_LWIP);
 
-err_t netif_rmii_ethernet_init(struct netif *netif, struct netif_rmii_ethernet_config *config) {
-    if (config != NULL) {
-        memcpy(&rmii_eth_netif_config, config, sizeof(rmii_eth_netif_config));
+    rmii_eth_cpu_lwip_core = get_core_num();
+#endif
+
+#if PICO_RMII_ETHERNET_DUAL_CORE
+    // doorbells only wake this core up, the rings say what there is to do
+    while (multicore_fifo_rvalid()) {
+        multicore_fifo_pop_blocking();
     }
+#else
+    netif_rmii_ethernet_driver_poll();
+#endif
 
-    netif_add(netif, IP4_ADDR_ANY, IP4_ADDR_ANY, IP4_ADDR_ANY, NULL, netif_rmii_ethernet_low_init, netif_input);    
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        netif_rmii_ethernet_lwip_poll(&rmii_eth_instances[i]);
+    }
 
-    netif->name[0] = 'e';
-    netif->name[1] = '0';
+#if PICO_RMII_ETHERNET_WAKE
+    // lwIP's timeouts wait for the wake-up, the ones that fell due meanwhile run then
+    if (netif_rmii_ethernet_asleep()) {
+#if PICO_RMII_ETHERNET_CPU_STATS
+        netif_rmii_ethernet_cpu_pass_end(cpu_prev);
+#endif
+        return;
+    }
+#endif
+
+#if PICO_RMII_ETHERNET_TIMEOUT_ALARM
+    netif_rmii_ethernet_timeouts_service();
+#elif NO_SYS
+    sys_check_timeouts();
+#else
+    // the tcpip thread runs lwIP's timers
+    UNLOCK_TCPIP_CORE();
+#endif
+
+#if PICO_RMII_ETHERNET_CPU_STATS
+    netif_rmii_ethernet_cpu_pass_end(cpu_prev);
+#endif
 }
 
-void netif_rmii_ethernet_poll() {
-    uint16_t link_status = (netif_rmii_ethernet_mdio_read(phy_address, 1) & 0x04) >> 2;
+#if PICO_RMII_ETHERNET_LOOP_WFE || PICO_RMII_ETHERNET_WAKE || !NO_SYS
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_driver_work_pending)() {
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        struct rmii_ethernet *eth = &rmii_eth_instances[i];
 
-    if (netif_is_link_up(rmii_eth_netif) ^ link_status) {
-        if (link_status) {
-            // printf("netif_set_link_up\n");
-            netif_set_link_up(rmii_eth_netif);
-        } else {
-            // printf("netif_set_link_down\n");
-            netif_set_link_down(rmii_eth_netif);
+        if ((eth->rx_ring_checked != eth->rx_ring_head) ||
+            (eth->tx_ring_built != eth->tx_ring_head) ||
+            eth->rx_stalled) {
+            return true;
+        }
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+        if (eth->tx_priority_built != eth->tx_priority_head) {
+            return true;
         }
+#endif
+
+#if PICO_RMII_ETHERNET_PAUSE
+        // the ring waits for a pause to end, or the partner for lwIP to catch up
+        if ((!eth->tx_busy && tx_pending(eth)) || eth->rx_pause_sent) {
+            return true;
+        }
+#endif
+
+#if PICO_RMII_ETHERNET_RX_PRIORITY
+        // RX goes back to the ring once lwIP made room, as with rx_stalled
+        if ((eth->rx_priority_tail != eth->rx_priority_head) || eth->rx_landing) {
+            return true;
+        }
+#endif
     }
 
-    if (dma_channel_is_busy(rx_dma_chan)) {
+    return false;
+}
 
-    } else {
-        uint rx_frame_length = ethernet_frame_length(rx_frame, sizeof(rx_frame));
-        //printf("rx_frmae_length %d\n", rx_frame_length);
-        if (rx_frame_length) {
-            // printf("RX: ");
-            // for (int i = 0; i < rx_frame_length + 4; i++) {
-            //     printf("%02X", rx_frame[i]);
-            // }
-            // printf("\n");
-            //printf("rx_frame_length is true\n");
-            //printf("rx_frame_length is %d\n",rx_frame_length);
-            struct pbuf* p = pbuf_alloc(PBUF_RAW, rx_frame_length, PBUF_POOL);
-
-            pbuf_take(p, rx_frame, rx_frame_length);
-
-            if (rmii_eth_netif->input(p, rmii_eth_netif) != ERR_OK) {
-                pbuf_free(p);
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_work_pending)() {
+    if (netif_rmii_ethernet_driver_work_pending()) {
+        return true;
+    }
+
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        struct rmii_ethernet *eth = &rmii_eth_instances[i];
+
+        if ((eth->rx_ring_tail != eth->rx_ring_checked) ||
+            (eth->tx_ring_tail != eth->tx_ring_dma) ||
+            eth->mdio_busy) {
+            return true;
+        }
+
+#if PICO_RMII_ETHERNET_TX_PRIORITY
+        if (eth->tx_priority_tail != eth->tx_priority_dma) {
+            return true;
+        }
+#endif
+
+#if PICO_RMII_ETHERNET_TX_SCHEDULED
+        for (uint j = 0; j < PICO_RMII_ETHERNET_TX_SCHEDULED_SLOTS; j++) {
+            if (eth->tx_sched[j].state == TX_SCHED_DONE) {
+                return true;
             }
         }
+#endif
+    }
+
+    return false;
+}
 
-        memset(rx_frame, 0x00, sizeof(rx_frame));
+#if PICO_RMII_ETHERNET_WAKE
+// __wfi() until an interrupt, with only the PICO_RMII_ETHERNET_WAKE_SLEEP_EN0/1 clocks
+// running while the other core sleeps too
+static void netif_rmii_ethernet_deep_sleep() {
+    // an interrupt that comes in after the check still ends __wfi(), its handler runs once
+    // they are back on
+    uint32_t save = save_and_disable_interrupts();
 
-        dma_channel_configure(
-            rx_dma_chan, &rx_dma_channel_config,
-            rx_frame,
-            ((uint8_t*)&PICO_RMII_ETHERNET_PIO->rxf[PICO_RMII_ETHERNET_SM_RX]) + 3,
-            1518,
-            false
-        );
-        //printf("dma_channel_start and setting after\n");
-        dma_channel_start(rx_dma_chan);
+    if (!netif_rmii_ethernet_work_pending()) {
+        uint32_t sleep_en0 = clocks_hw->sleep_en0;
+        uint32_t sleep_en1 = clocks_hw->sleep_en1;
 
-        rmii_ethernet_phy_rx_init(PICO_RMII_ETHERNET_PIO, PICO_RMII_ETHERNET_SM_RX, rx_sm_offset, PICO_RMII_ETHERNET_RX_PIN);
-        //printf("call back before\n");
-        gpio_set_irq_enabled_with_callback(PICO_RMII_ETHERNET_RX_PIN + 2, GPIO_IRQ_EDGE_FALL, true, &netif_rmii_ethernet_rx_dv_falling_callback);
+        clocks_hw->sleep_en0 = PICO_RMII_ETHERNET_WAKE_SLEEP_EN0;
+        clocks_hw->sleep_en1 = PICO_RMII_ETHERNET_WAKE_SLEEP_EN1;
+        scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+
+        __wfi();
+
+        scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+        clocks_hw->sleep_en0 = sleep_en0;
+        clocks_hw->sleep_en1 = sleep_en1;
     }
 
-    sys_check_timeouts();
+    restore_interrupts(save);
+}
+#endif
+
+#if !NO_SYS
+// out of zero copy buffers on an interface, the tasks holding them have to free some
+static bool netif_rmii_ethernet_rx_starved() {
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        struct rmii_ethernet *eth = &rmii_eth_instances[i];
+
+        if (eth->rx_stalled && eth->rx_ring[eth->rx_ring_head & RX_RING_MASK].frame == NULL) {
+            return true;
+        }
+    }
+
+    return false;
+}
+#endif
+#endif
+
+#if RMII_ETHERNET_IDLE_ACCOUNTING
+static uint64_t rmii_eth_idle_us;
+
+uint64_t netif_rmii_ethernet_idle_us() {
+    return rmii_eth_idle_us;
+}
+#endif
+
+#if PICO_RMII_ETHERNET_BUSY_POLL
+static bool rmii_eth_busy_poll;
+static uint rmii_eth_busy_poll_taken;       // frames of all interfaces handed to lwIP so far
+static uint rmii_eth_busy_poll_frames;      // of them in the current window
+static uint64_t rmii_eth_busy_poll_window_us;
+static uint64_t rmii_eth_busy_poll_last_us; // when the last of them was taken
+
+// true while the loop should poll on rather than sleep, see PICO_RMII_ETHERNET_BUSY_POLL
+static bool RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_busy_poll)() {
+    uint64_t now = time_us_64();
+    uint taken = 0;
+
+    for (uint i = 0; i < rmii_eth_instance_count; i++) {
+        taken += rmii_eth_instances[i].rx_ring_tail;
+    }
+
+    if (taken != rmii_eth_busy_poll_taken) {
+        rmii_eth_busy_poll_frames += taken - rmii_eth_busy_poll_taken;
+        rmii_eth_busy_poll_taken = taken;
+        rmii_eth_busy_poll_last_us = now;
+    }
+
+    // the loop only runs on events while it sleeps, a window is however long it took
+    uint64_t window = now - rmii_eth_busy_poll_window_us;
+
+    if (window >= PICO_RMII_ETHERNET_BUSY_POLL_WINDOW_US) {
+        if ((uint64_t)rmii_eth_busy_poll_frames * 1000000u >= (uint64_t)PICO_RMII_ETHERNET_BUSY_POLL_RATE * window) {
+            rmii_eth_busy_poll = true;
+        }
+
+        rmii_eth_busy_poll_frames = 0;
+        rmii_eth_busy_poll_window_us = now;
+    }
+
+    if (rmii_eth_busy_poll && (now - rmii_eth_busy_poll_last_us) >= PICO_RMII_ETHERNET_BUSY_POLL_IDLE_US) {
+        rmii_eth_busy_poll = false;
+    }
+
+    return rmii_eth_busy_poll;
 }
+#endif
+
+void RMII_ETHERNET_HOT_FUNC(netif_rmii_ethernet_loop)() {
+#if !NO_SYS
+    rmii_eth_loop_task = xTaskGetCurrentTaskHandle();
+#endif
+
+#if PICO_RMII_ETHERNET_CPU_STATS
+    // the loop's own checks between the passes are polling as well
+    netif_rmii_ethernet_cpu_switch(NETIF_RMII_ETHERNET_CPU_EMPTY);
+#endif
 
-void netif_rmii_ethernet_loop() {
     while (1) {
+#if PICO_RMII_ETHERNET_DUAL_CORE
+#if PICO_RMII_ETHERNET_CPU_STATS
+        uint cpu_loop = netif_rmii_ethernet_cpu_pass_begin(NETIF_RMII_ETHERNET_CPU_DRIVER);
+
+        netif_rmii_ethernet_driver_poll();
+
+        netif_rmii_ethernet_cpu_pass_end(cpu_loop);
+#else
+        netif_rmii_ethernet_driver_poll();
+#endif
+
+#if PICO_RMII_ETHERNET_LOOP_WFE
+        if (!netif_rmii_ethernet_driver_work_pending()) {
+            CPU_ENTER(NETIF_RMII_ETHERNET_CPU_SLEEP);
+
+            // woken by the CRS_DV and TX DMA interrupts or a doorbell from the lwIP core
+            __wfe();
+
+            CPU_LEAVE();
+        }
+#endif
+#elif !NO_SYS
+        netif_rmii_ethernet_poll();
+
+        if (!netif_rmii_ethernet_work_pending()) {
+            // block until an RX/TX interrupt or a doorbell, other tasks run meanwhile
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        } else if (netif_rmii_ethernet_rx_starved()) {
+            // out of zero copy buffers, give the tasks holding them a chance to free some
+            ulTaskNotifyTake(pdTRUE, 1);
+        }
+#else
         netif_rmii_ethernet_poll();
+
+#if PICO_RMII_ETHERNET_WAKE
+        if (netif_rmii_ethernet_asleep()) {
+            CPU_ENTER(NETIF_RMII_ETHERNET_CPU_SLEEP);
+
+            // CRS_DV brings us back for the next frame, the poll drops it or wakes up
+            netif_rmii_ethernet_deep_sleep();
+
+            CPU_LEAVE();
+            continue;
+        }
+#endif
+
+#if PICO_RMII_ETHERNET_BUSY_POLL
+        if (netif_rmii_ethernet_busy_poll()) {
+            // the next frame is likely to be in before a sleep would be over
+            continue;
+        }
+#endif
+
+#if PICO_RMII_ETHERNET_LOOP_WFE
+        if (!netif_rmii_ethernet_work_pending()) {
+            uint64_t sleep_start = time_us_64();
+
+            CPU_ENTER(NETIF_RMII_ETHERNET_CPU_SLEEP);
+
+            // the CRS_DV and TX DMA interrupts wake us, events latched since the
+            // check above make __wfe() return straight away
+#if PICO_RMII_ETHERNET_TIMEOUT_ALARM
+            // and so does the timeout alarm
+            if (!timeouts_due) {
+                __wfe();
+            }
+#else
+            u32_t sleep_time = sys_timeouts_sleeptime();
+
+            best_effort_wfe_or_timeout(sleep_time == SYS_TIMEOUTS_SLEEPTIME_INFINITE ? at_the_end_of_time : make_timeout_time_ms(sleep_time));
+#endif
+
+            CPU_LEAVE();
+
+            rmii_eth_idle_us += time_us_64() - sleep_start;
+        }
+#endif
+#endif
     }
 }
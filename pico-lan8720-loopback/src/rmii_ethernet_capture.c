@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "timebase.h"
+
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "rmii_ethernet_capture.h"
+
+#if PICO_RMII_ETHERNET_CAPTURE
+
+struct capture_record {
+    uint64_t time_us;
+    uint32_t flags;
+    uint16_t length;   // frame length without the FCS, received bytes for CRC errors
+    uint16_t captured; // up to PICO_RMII_ETHERNET_CAPTURE_SNAPLEN
+    uint8_t data[PICO_RMII_ETHERNET_CAPTURE_SNAPLEN];
+};
+
+#define CAPTURE_RING_MASK (PICO_RMII_ETHERNET_CAPTURE_SLOTS - 1)
+
+// records are written at capture_head and exported from capture_tail, the oldest ones
+// are overwritten when the export falls behind
+static struct capture_record capture_ring[PICO_RMII_ETHERNET_CAPTURE_SLOTS];
+static uint capture_head = 0;
+static uint capture_tail = 0;
+static struct netif_rmii_ethernet_capture_stats capture_stats;
+
+static struct udp_pcb *capture_pcb = NULL;
+static ip_addr_t capture_addr;
+static uint16_t capture_port;
+static bool capture_exporting = false; // the export's own datagrams aren't captured
+
+// pcapng blocks, little endian like the RP2040
+#define PCAPNG_SHB 0x0a0d0d0au
+#define PCAPNG_IDB 0x00000001u
+#define PCAPNG_EPB 0x00000006u
+#define PCAPNG_LINKTYPE_ETHERNET 1
+#define PCAPNG_OPT_EPB_FLAGS 2
+
+// block header, interface, timestamp, lengths, flags option, end of options, trailer
+#define PCAPNG_EPB_OVERHEAD (28 + 12 + 4)
+
+// export datagram payload, under the MTU
+#define CAPTURE_DATAGRAM_MAX 1400
+
+// datagrams per export timeout, bounds the time it takes from lwIP
+#define CAPTURE_DATAGRAMS_PER_EXPORT 8
+
+static uint8_t *capture_put32(uint8_t *out, uint32_t value) {
+    memcpy(out, &value, sizeof(value));
+
+    return out + sizeof(value);
+}
+
+static struct capture_record *capture_next() {
+    if ((capture_head - capture_tail) == PICO_RMII_ETHERNET_CAPTURE_SLOTS) {
+        // lossy: drop the oldest record
+        capture_tail++;
+        capture_stats.lost++;
+    }
+
+    struct capture_record *record = &capture_ring[capture_head & CAPTURE_RING_MASK];
+
+    record->time_us = timebase_us_64();
+    capture_stats.captured++;
+    capture_head++;
+
+    return record;
+}
+
+void rmii_ethernet_capture_frame(uint32_t flags, const uint8_t *data, uint length) {
+    if (capture_exporting) {
+        return;
+    }
+
+    struct capture_record *record = capture_next();
+    uint captured = LWIP_MIN(length, PICO_RMII_ETHERNET_CAPTURE_SNAPLEN);
+
+    record->flags = flags;
+    record->length = length;
+    record->captured = captured;
+    memcpy(record->data, data, captured);
+}
+
+void rmii_ethernet_capture_pbuf(uint32_t flags, struct pbuf *p) {
+    if (capture_exporting) {
+        return;
+    }
+
+    struct capture_record *record = capture_next();
+
+    record->flags = flags;
+    record->length = p->tot_len;
+    record->captured = pbuf_copy_partial(p, record->data, PICO_RMII_ETHERNET_CAPTURE_SNAPLEN, 0);
+}
+
+static void capture_send(struct pbuf *p) {
+    capture_exporting = true;
+    udp_sendto(capture_pcb, p, &capture_addr, capture_port);
+    capture_exporting = false;
+
+    pbuf_free(p);
+}
+
+static void capture_send_header() {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, 28 + 20, PBUF_RAM);
+
+    if (p == NULL) {
+        return;
+    }
+
+    uint8_t *out = p->payload;
+
+    // section header: byte order magic, version 1.0, unknown section length
+    out = capture_put32(out, PCAPNG_SHB);
+    out = capture_put32(out, 28);
+    out = capture_put32(out, 0x1a2b3c4d);
+    out = capture_put32(out, 0x00000001);
+    out = capture_put32(out, 0xffffffff);
+    out = capture_put32(out, 0xffffffff);
+    out = capture_put32(out, 28);
+
+    // the interface, Ethernet in 1 us steps (the default resolution)
+    out = capture_put32(out, PCAPNG_IDB);
+    out = capture_put32(out, 20);
+    out = capture_put32(out, PCAPNG_LINKTYPE_ETHERNET);
+    out = capture_put32(out, PICO_RMII_ETHERNET_CAPTURE_SNAPLEN);
+    capture_put32(out, 20);
+
+    capture_send(p);
+}
+
+static void capture_export(void *arg) {
+    (void)arg;
+
+    for (int datagram = 0; datagram < CAPTURE_DATAGRAMS_PER_EXPORT && capture_tail != capture_head; datagram++) {
+        uint size = 0;
+
+        for (uint i = capture_tail; i != capture_head; i++) {
+            uint block = PCAPNG_EPB_OVERHEAD + ((capture_ring[i & CAPTURE_RING_MASK].captured + 3) & ~3u);
+
+            if ((size + block) > CAPTURE_DATAGRAM_MAX) {
+                break;
+            }
+
+            size += block;
+        }
+
+        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, size, PBUF_RAM);
+
+        if (p == NULL) {
+            break;
+        }
+
+        uint8_t *out = p->payload;
+
+        while (out < ((uint8_t *)p->payload + size)) {
+            const struct capture_record *record = &capture_ring[capture_tail & CAPTURE_RING_MASK];
+            uint padded = (record->captured + 3) & ~3u;
+            uint block = PCAPNG_EPB_OVERHEAD + padded;
+
+            out = capture_put32(out, PCAPNG_EPB);
+            out = capture_put32(out, block);
+            out = capture_put32(out, 0);
+            out = capture_put32(out, (uint32_t)(record->time_us >> 32));
+            out = capture_put32(out, (uint32_t)record->time_us);
+            out = capture_put32(out, record->captured);
+            out = capture_put32(out, record->length);
+
+            memcpy(out, record->data, record->captured);
+            memset(out + record->captured, 0, padded - record->captured);
+            out += padded;
+
+            out = capture_put32(out, PCAPNG_OPT_EPB_FLAGS | (4 << 16));
+            out = capture_put32(out, record->flags);
+            out = capture_put32(out, 0);
+            out = capture_put32(out, block);
+
+            capture_tail++;
+            capture_stats.exported++;
+        }
+
+        capture_send(p);
+    }
+
+    sys_timeout(PICO_RMII_ETHERNET_CAPTURE_EXPORT_MS, capture_export, NULL);
+}
+
+err_t netif_rmii_ethernet_capture_start(const ip_addr_t *addr, uint16_t port) {
+    netif_rmii_ethernet_capture_stop();
+
+    capture_pcb = udp_new_ip_type(IP_GET_TYPE(addr));
+
+    if (capture_pcb == NULL) {
+        return ERR_MEM;
+    }
+
+    ip_addr_copy(capture_addr, *addr);
+    capture_port = port;
+
+    // a new section, then what the ring already holds
+    capture_send_header();
+
+    sys_timeout(PICO_RMII_ETHERNET_CAPTURE_EXPORT_MS, capture_export, NULL);
+
+    return ERR_OK;
+}
+
+void netif_rmii_ethernet_capture_stop() {
+    if (capture_pcb == NULL) {
+        return;
+    }
+
+    sys_untimeout(capture_export, NULL);
+
+    udp_remove(capture_pcb);
+    capture_pcb = NULL;
+}
+
+void netif_rmii_ethernet_capture_get_stats(struct netif_rmii_ethernet_capture_stats *stats) {
+    *stats = capture_stats;
+}
+
+#endif
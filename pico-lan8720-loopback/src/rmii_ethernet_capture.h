@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_RMII_ETHERNET_CAPTURE_H_
+#define _PICO_RMII_ETHERNET_CAPTURE_H_
+
+#include "rmii_ethernet/netif.h"
+
+#include "lwip/pbuf.h"
+
+#if PICO_RMII_ETHERNET_CAPTURE
+// pcapng epb_flags of a record
+#define RMII_ETHERNET_CAPTURE_INBOUND  0x00000001u
+#define RMII_ETHERNET_CAPTURE_OUTBOUND 0x00000002u
+#define RMII_ETHERNET_CAPTURE_CRC_ERR  0x01000000u
+
+// both called from lwIP context only, like the export, so the ring isn't locked
+void rmii_ethernet_capture_frame(uint32_t flags, const uint8_t *data, uint length);
+void rmii_ethernet_capture_pbuf(uint32_t flags, struct pbuf *p);
+
+#define RMII_ETHERNET_CAPTURE_RX(data, length) rmii_ethernet_capture_frame(RMII_ETHERNET_CAPTURE_INBOUND, (data), (length))
+#define RMII_ETHERNET_CAPTURE_RX_CRC_ERR(data, received) \
+    rmii_ethernet_capture_frame(RMII_ETHERNET_CAPTURE_INBOUND | RMII_ETHERNET_CAPTURE_CRC_ERR, (data), (received))
+#define RMII_ETHERNET_CAPTURE_TX(p) rmii_ethernet_capture_pbuf(RMII_ETHERNET_CAPTURE_OUTBOUND, (p))
+#else
+#define RMII_ETHERNET_CAPTURE_RX(data, length) ((void)0)
+#define RMII_ETHERNET_CAPTURE_RX_CRC_ERR(data, received) ((void)0)
+#define RMII_ETHERNET_CAPTURE_TX(p) ((void)0)
+#endif
+
+#endif
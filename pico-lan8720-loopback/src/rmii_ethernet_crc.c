@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "rmii_ethernet_crc.h"
+
+#if PICO_RMII_ETHERNET_CRC == RMII_ETHERNET_CRC_SNIFFER
+#include "hardware/dma.h"
+#endif
+
+static const uint32_t ethernet_polynomial_le = 0xedb88320U;
+
+#if PICO_RMII_ETHERNET_CRC == RMII_ETHERNET_CRC_BITWISE
+
+void rmii_ethernet_crc_init() {
+}
+
+uint32_t RMII_ETHERNET_HOT_FUNC(rmii_ethernet_crc32_update)(uint32_t crc, const uint8_t *data, uint length)
+{
+    while (length--) {
+        uint8_t current_octet = *data++;
+
+        for (int bit = 8; --bit >= 0; current_octet >>= 1) {
+            if ((crc ^ current_octet) & 1) {
+                crc >>= 1;
+                crc ^= ethernet_polynomial_le;
+            } else {
+                crc >>= 1;
+            }
+        }
+    }
+
+    return crc;
+}
+
+#else
+
+#if PICO_RMII_ETHERNET_CRC_SLICES != 4 && PICO_RMII_ETHERNET_CRC_SLICES != 8
+#error "PICO_RMII_ETHERNET_CRC_SLICES must be 4 or 8"
+#endif
+
+// crc_table[0] is the classic byte-wise table, the others extend it to 4 or 8 bytes per step
+static uint32_t crc_table[PICO_RMII_ETHERNET_CRC_SLICES][256];
+
+static void crc_table_init() {
+    for (uint i = 0; i < 256; i++) {
+        uint32_t crc = i;
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ ethernet_polynomial_le) : (crc >> 1);
+        }
+
+        crc_table[0][i] = crc;
+    }
+
+    for (uint i = 0; i < 256; i++) {
+        for (int slice = 1; slice < PICO_RMII_ETHERNET_CRC_SLICES; slice++) {
+            uint32_t prev = crc_table[slice - 1][i];
+
+            crc_table[slice][i] = (prev >> 8) ^ crc_table[0][prev & 0xff];
+        }
+    }
+}
+
+uint32_t RMII_ETHERNET_HOT_FUNC(rmii_ethernet_crc32_update)(uint32_t crc, const uint8_t *data, uint length)
+{
+    // align to a word boundary, then consume 8 or 4 bytes per iteration
+    while (length && ((uintptr_t)data & 3)) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xff];
+        length--;
+    }
+
+    const uint32_t *words = (const uint32_t *)data;
+
+#if PICO_RMII_ETHERNET_CRC_SLICES == 8
+    while (length >= 8) {
+        uint32_t low = crc ^ *words++;
+        uint32_t high = *words++;
+
+        crc = crc_table[7][low & 0xff] ^
+              crc_table[6][(low >> 8) & 0xff] ^
+              crc_table[5][(low >> 16) & 0xff] ^
+              crc_table[4][low >> 24] ^
+              crc_table[3][high & 0xff] ^
+              crc_table[2][(high >> 8) & 0xff] ^
+              crc_table[1][(high >> 16) & 0xff] ^
+              crc_table[0][high >> 24];
+        length -= 8;
+    }
+#endif
+
+    while (length >= 4) {
+        crc ^= *words++;
+        crc = crc_table[3][crc & 0xff] ^
+              crc_table[2][(crc >> 8) & 0xff] ^
+              crc_table[1][(crc >> 16) & 0xff] ^
+              crc_table[0][crc >> 24];
+        length -= 4;
+    }
+
+    data = (const uint8_t *)words;
+
+    while (length--) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xff];
+    }
+
+    return crc;
+}
+
+#endif
+
+#if PICO_RMII_ETHERNET_CRC == RMII_ETHERNET_CRC_SNIFFER
+
+static int crc_dma_chan;
+static dma_channel_config crc_dma_channel_config;
+static uint32_t crc_dma_sink;
+
+void rmii_ethernet_crc_init() {
+    crc_table_init();
+
+    crc_dma_chan = dma_claim_unused_channel(true);
+
+    crc_dma_channel_config = dma_channel_get_default_config(crc_dma_chan);
+
+    channel_config_set_read_increment(&crc_dma_channel_config, true);
+    channel_config_set_write_increment(&crc_dma_channel_config, false);
+    channel_config_set_dreq(&crc_dma_channel_config, DREQ_FORCE);
+    channel_config_set_sniff_enable(&crc_dma_channel_config, true);
+}
+
+static void RMII_ETHERNET_HOT_FUNC(crc_dma_run)(const void *data, uint count, enum dma_channel_transfer_size size) {
+    if (count == 0) {
+        return;
+    }
+
+    channel_config_set_transfer_data_size(&crc_dma_channel_config, size);
+
+    dma_channel_configure(
+        crc_dma_chan, &crc_dma_channel_config,
+        &crc_dma_sink,
+        data,
+        count,
+        true
+    );
+
+    dma_channel_wait_for_finish_blocking(crc_dma_chan);
+}
+
+uint32_t RMII_ETHERNET_HOT_FUNC(rmii_ethernet_crc32)(const uint8_t *data, uint length)
+{
+    // CRC32R on bit reversed data, reading back reversed and inverted gives the 802.3 FCS,
+    // 32-bit reads feed the sniffer in little endian byte order so words can be used
+    uint head = (4 - ((uintptr_t)data & 3)) & 3;
+
+    if (head > length) {
+        head = length;
+    }
+
+    uint words = (length - head) / 4;
+    uint tail = (length - head) & 3;
+
+    dma_sniffer_enable(crc_dma_chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    hw_set_bits(&dma_hw->sniff_ctrl, DMA_SNIFF_CTRL_OUT_REV_BITS | DMA_SNIFF_CTRL_OUT_INV_BITS);
+    dma_hw->sniff_data = RMII_ETHERNET_CRC32_INIT;
+
+    crc_dma_run(data, head, DMA_SIZE_8);
+    crc_dma_run(data + head, words, DMA_SIZE_32);
+    crc_dma_run(data + head + words * 4, tail, DMA_SIZE_8);
+
+    uint32_t crc = dma_hw->sniff_data;
+
+    dma_sniffer_disable();
+
+    return crc;
+}
+
+#else
+
+#if PICO_RMII_ETHERNET_CRC == RMII_ETHERNET_CRC_TABLE
+void rmii_ethernet_crc_init() {
+    crc_table_init();
+}
+#endif
+
+uint32_t RMII_ETHERNET_HOT_FUNC(rmii_ethernet_crc32)(const uint8_t *data, uint length)
+{
+    return ~rmii_ethernet_crc32_update(RMII_ETHERNET_CRC32_INIT, data, length);
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_RMII_ETHERNET_CRC_H_
+#define _PICO_RMII_ETHERNET_CRC_H_
+
+#include "pico/types.h"
+
+// Ethernet FCS (CRC-32, IEEE 802.3) back-ends, selected at build time
+#define RMII_ETHERNET_CRC_BITWISE   0 // original bit-at-a-time loop, no tables
+#define RMII_ETHERNET_CRC_TABLE     1 // slice-by-4 tables (4 KB of RAM)
+#define RMII_ETHERNET_CRC_SNIFFER   2 // RP2040 DMA sniffer in CRC32R mode (claims a DMA channel)
+
+#ifndef PICO_RMII_ETHERNET_CRC
+#define PICO_RMII_ETHERNET_CRC RMII_ETHERNET_CRC_TABLE
+#endif
+
+// bytes the table back-end (and the sniffer's software updates) consume per step, 4 or 8.
+// Slice-by-8 takes 8 KB of tables, the default on the RP2350 where the Cortex-M33 extracts
+// each index with one ubfx and has the 520 KB of SRAM to spare
+#ifndef PICO_RMII_ETHERNET_CRC_SLICES
+#if PICO_RP2350
+#define PICO_RMII_ETHERNET_CRC_SLICES 8
+#else
+#define PICO_RMII_ETHERNET_CRC_SLICES 4
+#endif
+#endif
+
+// link the per frame functions of the driver (and lwIP's, see src/lwip/arch/cc.h) into
+// SRAM instead of running them from flash through the XIP cache. The section is the one
+// of the SDK's __not_in_flash_func(), spelled out as pico/types.h is all that is included
+#ifndef PICO_RMII_HOT_IN_RAM
+#define PICO_RMII_HOT_IN_RAM 0
+#endif
+
+#if PICO_RMII_HOT_IN_RAM
+#define RMII_ETHERNET_HOT_FUNC(func) __attribute__((section(".time_critical." #func))) func
+#else
+#define RMII_ETHERNET_HOT_FUNC(func) func
+#endif
+
+#define RMII_ETHERNET_CRC32_INIT 0xffffffffu
+
+void rmii_ethernet_crc_init();
+
+// complete FCS of a buffer, as transmitted on the wire (little endian)
+uint32_t rmii_ethernet_crc32(const uint8_t *data, uint length);
+
+// software running CRC, start with RMII_ETHERNET_CRC32_INIT, the FCS is ~crc
+uint32_t rmii_ethernet_crc32_update(uint32_t crc, const uint8_t *data, uint length);
+
+#endif
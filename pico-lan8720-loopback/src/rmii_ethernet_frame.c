@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "rmii_ethernet_crc.h"
+#include "rmii_ethernet_frame.h"
+
+uint RMII_ETHERNET_HOT_FUNC(rmii_ethernet_frame_length)(const uint8_t *data, uint received) {
+    uint crc = RMII_ETHERNET_CRC32_INIT;
+    uint length = 0;
+
+    if (received < 4) {
+        return 0;
+    }
+
+    if (received > (4 + RMII_ETHERNET_FRAME_TRAILING_BYTES)) {
+        length = received - 4 - RMII_ETHERNET_FRAME_TRAILING_BYTES;
+
+        crc = rmii_ethernet_crc32_update(crc, data, length);
+    }
+
+    // the FCS can only end in the last few received bytes, check just those offsets
+    for (; (length + 4) <= received; length++) {
+        uint inverted_crc = ~crc;
+
+        if (memcmp(data + length, &inverted_crc, sizeof(inverted_crc)) == 0) {
+            return length;
+        }
+
+        crc = rmii_ethernet_crc32_update(crc, data + length, 1);
+    }
+
+    return 0;
+}
+
+static uint16_t encoding[256]; // byte to 4 groups with TX-EN set
+
+void rmii_ethernet_frame_encoding_init() {
+    for (int i = 0; i < 256; i++) {
+        uint16_t groups = 0;
+
+        for (int dibit = 0; dibit < 4; dibit++) {
+            groups |= (0x04 | ((i >> (dibit * 2)) & 0x03)) << (dibit * 3);
+        }
+
+        encoding[i] = groups;
+    }
+}
+
+void RMII_ETHERNET_HOT_FUNC(rmii_ethernet_frame_encode_start)(struct rmii_ethernet_frame_encoder *encoder, uint32_t *words) {
+    static const uint8_t preamble[8] = { 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0xd5 };
+
+    encoder->words = words;
+    encoder->count = 0;
+    encoder->pending = -1;
+
+    rmii_ethernet_frame_encode(encoder, preamble, sizeof(preamble));
+}
+
+void RMII_ETHERNET_HOT_FUNC(rmii_ethernet_frame_encode)(struct rmii_ethernet_frame_encoder *encoder, const uint8_t *data, uint length) {
+    while (length--) {
+        if (encoder->pending < 0) {
+            encoder->pending = *data++;
+        } else {
+            encoder->words[encoder->count++] = encoding[encoder->pending] | (encoding[*data++] << 12);
+            encoder->pending = -1;
+        }
+    }
+}
+
+uint RMII_ETHERNET_HOT_FUNC(rmii_ethernet_frame_encode_end)(struct rmii_ethernet_frame_encoder *encoder) {
+    if (encoder->pending >= 0) {
+        encoder->words[encoder->count++] = encoding[encoder->pending];
+        encoder->pending = -1;
+    }
+
+    // inter frame gap, 12 bytes with TX-EN low
+    for (int i = 0; i < 6; i++) {
+        encoder->words[encoder->count++] = 0;
+    }
+
+    return encoder->count;
+}
+
+bool rmii_ethernet_frame_magic(const uint8_t *data, uint length, const uint8_t *mac) {
+    uint sync = 0; // 0xff bytes in a row
+
+    // anywhere past the Ethernet header, whatever the EtherType or the headers in front of it
+    for (uint i = 14; (i + 16 * 6) <= length; i++) {
+        if (data[i] == 0xff) {
+            sync++;
+            continue;
+        }
+
+        if (sync >= 6) {
+            uint repeats = 0;
+
+            while (repeats < 16 && memcmp(data + i + repeats * 6, mac, 6) == 0) {
+                repeats++;
+            }
+
+            if (repeats == 16) {
+                return true;
+            }
+        }
+
+        sync = 0;
+    }
+
+    return false;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_RMII_ETHERNET_FRAME_H_
+#define _PICO_RMII_ETHERNET_FRAME_H_
+
+#include "pico/types.h"
+
+// frame logic of the driver that doesn't touch the PIO or the DMA: finding the end of a
+// received frame, the 100M pre-encoding of frames to send and the magic packet match. Only pico/types.h and the
+// FCS back-ends are needed, so tools/host builds it natively
+
+// dibits sampled after CRS_DV first drops can trail the FCS by a few bytes
+#define RMII_ETHERNET_FRAME_TRAILING_BYTES 3
+
+// length of a received frame without its FCS, found by checking the FCS at the few offsets
+// it can end at, or 0 if none matches
+uint rmii_ethernet_frame_length(const uint8_t *data, uint received);
+
+// preamble, frame, FCS and gap as 3-bit TX0, TX1, TX-EN groups, two bytes per word
+#define RMII_ETHERNET_FRAME_FAST_WORDS ((8 + 1518 + 1) / 2 + 6)
+
+struct rmii_ethernet_frame_encoder {
+    uint32_t *words;
+    uint count;
+    int pending; // first byte of a word, -1 if none
+};
+
+// fills the byte to groups table, once before encoding
+void rmii_ethernet_frame_encoding_init();
+
+// starts a frame in words (RMII_ETHERNET_FRAME_FAST_WORDS) with the preamble and SFD
+void rmii_ethernet_frame_encode_start(struct rmii_ethernet_frame_encoder *encoder, uint32_t *words);
+
+void rmii_ethernet_frame_encode(struct rmii_ethernet_frame_encoder *encoder, const uint8_t *data, uint length);
+
+// flushes the last byte and appends the inter frame gap, returns the word count
+uint rmii_ethernet_frame_encode_end(struct rmii_ethernet_frame_encoder *encoder);
+
+// EtherType of magic packets sent straight over Ethernet, they also come as UDP datagrams
+#define RMII_ETHERNET_FRAME_WAKE_ETHERTYPE 0x0842
+
+// true when the payload of the frame (length without FCS) has a magic packet for mac:
+// at least 6 bytes of 0xff, then mac 16 times
+bool rmii_ethernet_frame_magic(const uint8_t *data, uint length, const uint8_t *mac);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+
+#include "rmii_ethernet_profile.h"
+
+#if PICO_RMII_ETHERNET_PROFILE
+
+struct rmii_ethernet_profile_histogram rmii_ethernet_profile[RMII_ETHERNET_PROFILE_STAGES];
+
+static const char *const rmii_ethernet_profile_names[RMII_ETHERNET_PROFILE_STAGES] = {
+    "rx wait", "rx fcs", "rx queue", "rx pbuf", "rx input",
+    "tx wait", "tx encode", "tx queue", "tx dma"
+};
+
+void netif_rmii_ethernet_profile_reset() {
+    uint32_t save = save_and_disable_interrupts();
+
+    memset(rmii_ethernet_profile, 0, sizeof(rmii_ethernet_profile));
+
+    restore_interrupts(save);
+}
+
+void netif_rmii_ethernet_profile_dump() {
+    for (int stage = 0; stage < RMII_ETHERNET_PROFILE_STAGES; stage++) {
+        struct rmii_ethernet_profile_histogram h;
+
+        // the driver keeps recording, a copy keeps the line consistent enough
+        uint32_t save = save_and_disable_interrupts();
+        memcpy(&h, &rmii_ethernet_profile[stage], sizeof(h));
+        restore_interrupts(save);
+
+        if (h.count == 0) {
+            printf("%-9s -\n", rmii_ethernet_profile_names[stage]);
+
+            continue;
+        }
+
+        printf("%-9s n %lu, min %lu avg %lu max %lu us,",
+            rmii_ethernet_profile_names[stage], (unsigned long)h.count, (unsigned long)h.min,
+            (unsigned long)(h.sum / h.count), (unsigned long)h.max);
+
+        for (int b = 0; b < RMII_ETHERNET_PROFILE_BUCKETS; b++) {
+            if (h.buckets[b] == 0) {
+                continue;
+            }
+
+            if (b == RMII_ETHERNET_PROFILE_BUCKETS - 1) {
+                printf(" >=%lu:%lu", 1ul << (b - 1), (unsigned long)h.buckets[b]);
+            } else {
+                printf(" <%lu:%lu", 1ul << b, (unsigned long)h.buckets[b]);
+            }
+        }
+
+        printf("\n");
+    }
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_RMII_ETHERNET_PROFILE_H_
+#define _PICO_RMII_ETHERNET_PROFILE_H_
+
+#include "rmii_ethernet/netif.h"
+
+#include "timebase.h"
+
+// intervals between the timestamps of a frame's way through the driver, in us. The stages
+// run on both cores and in IRQs, so the timer shared by the cores is used rather than the
+// per core SysTick
+enum rmii_ethernet_profile_stage {
+    RMII_ETHERNET_PROFILE_RX_WAIT,   // CRS_DV IRQ ended the RX DMA -> FCS check starts
+    RMII_ETHERNET_PROFILE_RX_FCS,    // FCS check
+    RMII_ETHERNET_PROFILE_RX_QUEUE,  // FCS checked -> picked up by netif_rmii_ethernet_poll()
+    RMII_ETHERNET_PROFILE_RX_PBUF,   // pbuf alloc (and copy)
+    RMII_ETHERNET_PROFILE_RX_INPUT,  // netif->input() until it returned
+    RMII_ETHERNET_PROFILE_TX_WAIT,   // queued by linkoutput -> encode starts
+    RMII_ETHERNET_PROFILE_TX_ENCODE, // FCS and DMA blocks, or the 100M pre-encoding
+    RMII_ETHERNET_PROFILE_TX_QUEUE,  // encoded -> DMA started, behind the frames before it
+    RMII_ETHERNET_PROFILE_TX_DMA,    // DMA start -> last block in the PIO FIFO (IRQ)
+    RMII_ETHERNET_PROFILE_STAGES
+};
+
+// log2 buckets, bucket 0 counts 0 us, bucket b intervals in [2^(b-1), 2^b) us and the
+// last one everything longer
+#define RMII_ETHERNET_PROFILE_BUCKETS 24
+
+struct rmii_ethernet_profile_histogram {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[RMII_ETHERNET_PROFILE_BUCKETS];
+};
+
+#if PICO_RMII_ETHERNET_PROFILE
+// each stage is recorded from one context only (TX_QUEUE with the TX ring lock held),
+// so the histograms aren't locked
+extern struct rmii_ethernet_profile_histogram rmii_ethernet_profile[RMII_ETHERNET_PROFILE_STAGES];
+
+static inline uint32_t rmii_ethernet_profile_now() {
+    return timebase_us();
+}
+
+// adds the time since `since` to the stage's histogram, returns the timestamp taken
+static inline uint32_t rmii_ethernet_profile_record(enum rmii_ethernet_profile_stage stage, uint32_t since) {
+    uint32_t now = rmii_ethernet_profile_now();
+    uint32_t delta = now - since;
+
+    struct rmii_ethernet_profile_histogram *h = &rmii_ethernet_profile[stage];
+    uint bucket = (delta == 0) ? 0 : (32 - __builtin_clz(delta));
+
+    if (bucket >= RMII_ETHERNET_PROFILE_BUCKETS) {
+        bucket = RMII_ETHERNET_PROFILE_BUCKETS - 1;
+    }
+
+    h->buckets[bucket]++;
+    h->sum += delta;
+
+    if (h->count++ == 0 || delta < h->min) {
+        h->min = delta;
+    }
+
+    if (delta > h->max) {
+        h->max = delta;
+    }
+
+    return now;
+}
+
+#define RMII_ETHERNET_PROFILE_STAMP(t) ((t) = rmii_ethernet_profile_now())
+#define RMII_ETHERNET_PROFILE_RECORD(stage, t) ((t) = rmii_ethernet_profile_record(RMII_ETHERNET_PROFILE_##stage, (t)))
+#else
+#define RMII_ETHERNET_PROFILE_STAMP(t) ((void)0)
+#define RMII_ETHERNET_PROFILE_RECORD(stage, t) ((void)0)
+#endif
+
+#endif
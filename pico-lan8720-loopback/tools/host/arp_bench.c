@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/etharp.h"
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/prot/etharp.h"
+#include "lwip/prot/iana.h"
+#include "lwip/prot/ethernet.h"
+#include "netif/ethernet.h"
+
+#include "bench_wire.h"
+
+// lwIP's ARP with a subnet of PLCs, ARP_BENCH_PEERS neighbours that answer ARP requests
+// a ms after they go out. Built once as stock lwIP (the search of the table, re-requests
+// only from etharp_output()) and once with ETHARP_TABLE_HASH and ETHARP_REFRESH_AHEAD.
+// The exit status is 1 when a datagram never left
+//
+// usage: arp_bench_hash [ms per step, default 200] [virtual minutes per poll interval, default 30]
+//
+// first the host time of etharp_output() with 1 to ARP_BENCH_PEERS neighbours resolved,
+// sent to round robin. Then every peer is polled once per interval, staggered, in
+// virtual time: a poll that finds no stable entry waits for an ARP reply, a stall. The
+// first round resolves every peer and isn't counted
+
+#define ARP_BENCH_PEERS 40
+
+static struct netif netif;
+static struct udp_pcb *pcb;
+static uint failures;
+static uint32_t bench_ms = 200;
+static uint32_t bench_minutes = 30;
+
+static struct {
+    uint32_t sent;
+    uint32_t delivered;
+    uint32_t requests_broadcast;
+    uint32_t requests_unicast;
+} counts;
+
+static bool delivered_now;
+
+static const struct eth_addr host_mac = {{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 }};
+
+static void peer_addr(uint i, ip4_addr_t *addr) {
+    IP4_ADDR(addr, 192, 168, 1, 100 + i);
+}
+
+static void peer_mac(uint i, struct eth_addr *mac) {
+    static const struct eth_addr base = {{ 0x02, 0x00, 0x00, 0x00, 0x01, 0x00 }};
+
+    *mac = base;
+    mac->addr[5] = i;
+}
+
+// the index of a peer's address, -1 for anything else
+static int peer_index(const ip4_addr_t *addr) {
+    ip4_addr_t first;
+
+    peer_addr(0, &first);
+
+    uint32_t i = lwip_ntohl(ip4_addr_get_u32(addr)) - lwip_ntohl(ip4_addr_get_u32(&first));
+
+    return i < ARP_BENCH_PEERS ? (int)i : -1;
+}
+
+static void reply_queue(uint i) {
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, SIZEOF_ETH_HDR + SIZEOF_ETHARP_HDR, PBUF_RAM);
+
+    if (p == NULL) {
+        failures++;
+
+        return;
+    }
+
+    struct eth_hdr *eth = p->payload;
+    struct etharp_hdr *arp = (struct etharp_hdr *)((uint8_t *)p->payload + SIZEOF_ETH_HDR);
+    struct eth_addr mac;
+    ip4_addr_t addr;
+
+    peer_mac(i, &mac);
+    peer_addr(i, &addr);
+
+    eth->dest = host_mac;
+    eth->src = mac;
+    eth->type = PP_HTONS(ETHTYPE_ARP);
+
+    arp->hwtype = PP_HTONS(LWIP_IANA_HWTYPE_ETHERNET);
+    arp->proto = PP_HTONS(ETHTYPE_IP);
+    arp->hwlen = ETH_HWADDR_LEN;
+    arp->protolen = sizeof(ip4_addr_t);
+    arp->opcode = PP_HTONS(ARP_REPLY);
+    arp->shwaddr = mac;
+    IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&arp->sipaddr, &addr);
+    arp->dhwaddr = host_mac;
+    IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&arp->dipaddr, netif_ip4_addr(&netif));
+
+    if (!wire_queue(p, &netif)) {
+        failures++;
+    }
+}
+
+// the peers' side of the wire: datagrams arrive, ARP requests are answered
+static err_t bench_linkoutput(struct netif *netif, struct pbuf *p) {
+    uint8_t frame[SIZEOF_ETH_HDR + SIZEOF_ETHARP_HDR];
+
+    LWIP_UNUSED_ARG(netif);
+
+    if (pbuf_copy_partial(p, frame, sizeof(frame), 0) < SIZEOF_ETH_HDR) {
+        failures++;
+
+        return ERR_OK;
+    }
+
+    struct eth_hdr *eth = (struct eth_hdr *)frame;
+
+    if (eth->type == PP_HTONS(ETHTYPE_IP)) {
+        struct eth_addr mac;
+
+        peer_mac(eth->dest.addr[5], &mac);
+
+        if (eth->dest.addr[5] < ARP_BENCH_PEERS && eth_addr_cmp(&eth->dest, &mac)) {
+            counts.delivered++;
+            delivered_now = true;
+        } else {
+            failures++;
+        }
+    } else if (eth->type == PP_HTONS(ETHTYPE_ARP)) {
+        struct etharp_hdr *arp = (struct etharp_hdr *)(frame + SIZEOF_ETH_HDR);
+        ip4_addr_t target;
+
+        IPADDR_WORDALIGNED_COPY_TO_IP4_ADDR_T(&target, &arp->dipaddr);
+
+        int i = peer_index(&target);
+
+        if (arp->opcode == PP_HTONS(ARP_REQUEST) && i >= 0) {
+            if (eth->dest.addr[0] & 1) {
+                counts.requests_broadcast++;
+            } else {
+                counts.requests_unicast++;
+            }
+
+            reply_queue(i);
+        }
+    }
+
+    return ERR_OK;
+}
+
+static err_t bench_netif_init(struct netif *netif) {
+    netif->output = etharp_output;
+    netif->linkoutput = bench_linkoutput;
+    netif->mtu = 1500;
+    netif->hwaddr_len = ETH_HWADDR_LEN;
+    memcpy(netif->hwaddr, host_mac.addr, ETH_HWADDR_LEN);
+    netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_LINK_UP;
+
+    return ERR_OK;
+}
+
+// one small datagram to peer i, true when it left at once
+static bool poll(uint i) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, 16, PBUF_RAM);
+    ip4_addr_t addr;
+
+    if (p == NULL) {
+        failures++;
+
+        return false;
+    }
+
+    memset(p->payload, i, p->len);
+    peer_addr(i, &addr);
+
+    delivered_now = false;
+    counts.sent++;
+
+    if (udp_sendto(pcb, p, &addr, 502) != ERR_OK) {
+        failures++;
+    }
+
+    pbuf_free(p);
+
+    return delivered_now;
+}
+
+static void bench_output(uint peers) {
+    // every peer resolved before the clock starts
+    for (uint i = 0; i < peers; i++) {
+        if (!poll(i)) {
+            wire_run();
+        }
+    }
+
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+    uint32_t packets = 0;
+    uint32_t stalls = 0;
+
+    do {
+        for (uint i = 0; i < peers; i++) {
+            if (!poll(i)) {
+                stalls++;
+            }
+        }
+
+        packets += peers;
+        elapsed = now_ns() - start;
+    } while (elapsed < bench_ms * 1000000ull);
+
+    printf("%-4s %2u peers %8.1f ns/packet%s\n", ARP_BENCH_NAME, peers, (double)elapsed / packets,
+        stalls ? ", STALLED" : "");
+
+    if (stalls) {
+        failures++;
+    }
+}
+
+static void bench_polls(uint interval_s) {
+    uint32_t interval_ms = interval_s * 1000;
+    uint32_t duration_ms = bench_minutes * 60000;
+    uint32_t stalls = 0, polls = 0;
+
+    memset(&counts, 0, sizeof(counts));
+
+    for (uint32_t t = 0; t < duration_ms; t++) {
+        for (uint i = 0; i < ARP_BENCH_PEERS; i++) {
+            if (t % interval_ms == i * (interval_ms / ARP_BENCH_PEERS)) {
+                bool at_once = poll(i);
+
+                if (t >= interval_ms) {
+                    polls++;
+                    stalls += !at_once;
+                }
+            }
+        }
+
+        wire_run();
+    }
+
+    // the last polls' replies
+    for (int i = 0; i < 10; i++) {
+        wire_run();
+    }
+
+    printf("%-4s poll every %3u s: %u stalls in %u polls, ARP requests %u broadcast %u unicast\n", ARP_BENCH_NAME,
+        interval_s, stalls, polls, counts.requests_broadcast, counts.requests_unicast);
+
+    if (counts.delivered != counts.sent) {
+        printf("%-4s %u datagrams never left\n", ARP_BENCH_NAME, counts.sent - counts.delivered);
+        failures++;
+    }
+}
+
+int main(int argc, char **argv) {
+    static const uint steps[] = { 1, 2, 4, 8, 16, 32, ARP_BENCH_PEERS };
+    static const uint intervals[] = { 10, 60, 120 };
+
+    if (argc > 1) {
+        bench_ms = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        bench_minutes = strtoul(argv[2], NULL, 0);
+    }
+
+    wire_init(ARP_BENCH_PEERS);
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif, &addr, &mask, IP4_ADDR_ANY4, NULL, bench_netif_init, ethernet_input);
+    netif_set_up(&netif);
+
+    pcb = udp_new();
+    udp_bind(pcb, IP4_ADDR_ANY, 0);
+
+    for (uint i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        bench_output(steps[i]);
+    }
+
+    for (uint i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+        bench_polls(intervals[i]);
+    }
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
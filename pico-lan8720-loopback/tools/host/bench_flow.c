@@ -0,0 +1,128 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "lwip/tcp.h"
+
+#include "bench_flow.h"
+
+struct flow flows[FLOWS_MAX];
+uint flow_count;
+
+void flow_send(struct flow *flow) {
+    static const uint8_t buf[TCP_MSS];
+    uint16_t size = flow->write_size ? flow->write_size : TCP_MSS;
+    uint16_t queuelen = flow->queuelen ? flow->queuelen : TCP_SND_QUEUELEN;
+    bool written = false;
+
+    if (!flow->connected) {
+        return;
+    }
+
+    while (flow->pcb != NULL && tcp_sndbuf(flow->pcb) >= size && tcp_sndqueuelen(flow->pcb) < queuelen) {
+        if (tcp_write(flow->pcb, buf, size, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            break;
+        }
+
+        // the small writes go out one segment each while the window lets them
+        if (size < TCP_MSS) {
+            tcp_output(flow->pcb);
+        }
+
+        written = true;
+    }
+
+    if (written) {
+        tcp_output(flow->pcb);
+    }
+}
+
+err_t flow_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(len);
+
+    flow_send(arg);
+
+    return ERR_OK;
+}
+
+err_t flow_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    struct flow *flow = arg;
+
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(err);
+
+    flow->connected = true;
+    flow_send(flow);
+
+    return ERR_OK;
+}
+
+void flow_err(void *arg, err_t err) {
+    struct flow *flow = arg;
+
+    LWIP_UNUSED_ARG(err);
+
+    flow->pcb = NULL;
+}
+
+static err_t sink_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    struct flow *flow = arg;
+
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        tcp_close(pcb);
+        flow->sink = NULL;
+
+        return ERR_OK;
+    }
+
+    flow->received += p->tot_len;
+
+    if (flow->hold) {
+        if (flow->held == NULL) {
+            flow->held = p;
+        } else {
+            pbuf_cat(flow->held, p);
+        }
+
+        return ERR_OK;
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    return ERR_OK;
+}
+
+static void sink_err(void *arg, err_t err) {
+    struct flow *flow = arg;
+
+    LWIP_UNUSED_ARG(err);
+
+    flow->sink = NULL;
+}
+
+err_t sink_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    // the flow by its sender's port
+    for (uint i = 0; i < flow_count; i++) {
+        if (flows[i].pcb != NULL && flows[i].pcb->local_port == pcb->remote_port) {
+            flows[i].sink = pcb;
+
+            tcp_arg(pcb, &flows[i]);
+            tcp_recv(pcb, sink_recv);
+            tcp_err(pcb, sink_err);
+
+            return ERR_OK;
+        }
+    }
+
+    return ERR_VAL;
+}
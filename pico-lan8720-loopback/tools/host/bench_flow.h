@@ -0,0 +1,46 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _BENCH_FLOW_H_
+#define _BENCH_FLOW_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lwip/tcp.h"
+
+// the TCP flows of the benches that move bulk data: a sender's pcb writes while its
+// queue has room, a sink's pcb takes what arrives. The bench sets up flows[0] to
+// flows[flow_count - 1] and their senders with the callbacks below, and listens with
+// sink_accept(), which finds a sink's flow by the port of its sender
+
+#define FLOWS_MAX 8
+
+struct flow {
+    struct tcp_pcb *pcb;   // the sender
+    struct tcp_pcb *sink;  // its receiver
+    struct pbuf *held;     // what a holding sink was given
+    struct netif *link;    // the netif the sender is bound to, for the bench
+    uint32_t received;
+    uint16_t write_size;   // bytes per tcp_write(), TCP_MSS when 0, smaller ones go out one by one
+    uint16_t queuelen;     // segments the sender queues, TCP_SND_QUEUELEN when 0
+    bool hold;             // the sink keeps what it is given
+    bool connected;
+};
+
+extern struct flow flows[FLOWS_MAX];
+extern uint flow_count;
+
+// writes what the sender has room for, once it is connected
+void flow_send(struct flow *flow);
+
+err_t flow_sent(void *arg, struct tcp_pcb *pcb, u16_t len);
+
+err_t flow_connected(void *arg, struct tcp_pcb *pcb, err_t err);
+
+void flow_err(void *arg, err_t err);
+
+err_t sink_accept(void *arg, struct tcp_pcb *pcb, err_t err);
+
+#endif
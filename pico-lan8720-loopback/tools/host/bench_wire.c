@@ -0,0 +1,221 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "lwip/ip4.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+
+#include "bench_wire.h"
+
+struct wire_packet {
+    struct pbuf *p;
+    struct netif *netif; // receiving side
+};
+
+u32_t now_ms;
+struct netif netif_a, netif_b;
+uint32_t wire_packets, wire_drops;
+netif_output_fn wire_netif_output = wire_output;
+bool (*wire_tap)(struct pbuf *p, const ip4_addr_t *ipaddr);
+
+static struct wire_packet *wire;
+static uint32_t wire_size;
+static uint32_t wire_head, wire_tail;
+
+u32_t sys_now(void) {
+    return now_ms;
+}
+
+sys_prot_t sys_arch_protect_lock(unsigned lock) {
+    (void)lock;
+    return 0;
+}
+
+void sys_arch_unprotect_lock(unsigned lock, sys_prot_t pval) {
+    (void)lock;
+    (void)pval;
+}
+
+uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void wire_init(uint32_t size) {
+    while (wire_tail != wire_head) {
+        pbuf_free(wire[wire_tail++ % wire_size].p);
+    }
+
+    free(wire);
+    wire = calloc(size, sizeof(wire[0]));
+    wire_size = size;
+    wire_head = wire_tail = 0;
+    wire_packets = wire_drops = 0;
+}
+
+bool wire_queue(struct pbuf *p, struct netif *netif) {
+    if ((wire_head - wire_tail) == wire_size) {
+        pbuf_free(p);
+        wire_drops++;
+
+        return false;
+    }
+
+    wire[wire_head % wire_size].p = p;
+    wire[wire_head % wire_size].netif = netif;
+    wire_head++;
+    wire_packets++;
+
+    return true;
+}
+
+uint32_t wire_pending(void) {
+    return wire_head - wire_tail;
+}
+
+struct pbuf *wire_take(struct netif **netif) {
+    if (wire_tail == wire_head) {
+        return NULL;
+    }
+
+    struct wire_packet *w = &wire[wire_tail++ % wire_size];
+
+    *netif = w->netif;
+
+    return w->p;
+}
+
+err_t wire_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(netif);
+
+    // one pool pbuf (chain) per frame, as the RMII driver receives them
+    struct pbuf *q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_POOL);
+
+    if (q == NULL || (wire_head - wire_tail) == wire_size) {
+        if (q != NULL) {
+            pbuf_free(q);
+        }
+
+        wire_drops++;
+
+        return ERR_OK;
+    }
+
+    pbuf_copy(q, p);
+
+    if (wire_tap != NULL && !wire_tap(q, ipaddr)) {
+        pbuf_free(q);
+
+        return ERR_OK;
+    }
+
+    wire_queue(q, ip4_addr_cmp(ipaddr, netif_ip4_addr(&netif_a)) ? &netif_a : &netif_b);
+
+    return ERR_OK;
+}
+
+err_t wire_netif_init(struct netif *netif) {
+    netif->output = wire_netif_output;
+    netif->mtu = 1500;
+    netif->flags = NETIF_FLAG_UP | NETIF_FLAG_LINK_UP;
+
+    return ERR_OK;
+}
+
+static void wire_deliver(struct pbuf *p, struct netif *netif) {
+    if (netif->input(p, netif) != ERR_OK) {
+        pbuf_free(p);
+    }
+}
+
+void wire_run(void) {
+    struct netif *netif = NULL;
+    struct pbuf *p;
+
+    while ((p = wire_take(&netif)) != NULL) {
+        wire_deliver(p, netif);
+    }
+
+    now_ms++;
+    sys_check_timeouts();
+}
+
+void wire_step(void) {
+    struct netif *netif = NULL;
+    uint32_t count = wire_pending();
+
+    now_ms++;
+    sys_check_timeouts();
+
+    for (; count > 0; count--) {
+        struct pbuf *p = wire_take(&netif);
+
+        wire_deliver(p, netif);
+    }
+}
+
+void wire_line_init(struct wire_line *line, uint32_t size) {
+    while (line->tail != line->head) {
+        free(line->frames[line->tail++ % line->size].data);
+    }
+
+    free(line->frames);
+    line->frames = calloc(size, sizeof(line->frames[0]));
+    line->size = size;
+    line->head = line->tail = 0;
+}
+
+bool wire_line_push(struct wire_line *line, uint8_t *data, uint16_t len, uint32_t time) {
+    if ((line->head - line->tail) == line->size) {
+        return false;
+    }
+
+    struct wire_frame *frame = &line->frames[line->head % line->size];
+
+    frame->data = data;
+    frame->len = len;
+    frame->time = time;
+    line->head++;
+
+    return true;
+}
+
+bool wire_line_send(struct wire_line *line, struct pbuf *p, uint32_t delay) {
+    if ((line->head - line->tail) == line->size) {
+        return false;
+    }
+
+    uint8_t *data = malloc(p->tot_len);
+
+    pbuf_copy_partial(p, data, p->tot_len, 0);
+
+    return wire_line_push(line, data, p->tot_len, now_ms + delay);
+}
+
+void wire_line_deliver(struct wire_line *line, struct netif *netif) {
+    while (line->tail != line->head && (int32_t)(line->frames[line->tail % line->size].time - now_ms) <= 0) {
+        struct wire_frame *frame = &line->frames[line->tail % line->size];
+        struct pbuf *q = pbuf_alloc(PBUF_RAW, frame->len, PBUF_POOL);
+
+        line->tail++;
+
+        if (q != NULL) {
+            pbuf_take(q, frame->data, frame->len);
+        } else {
+            wire_drops++;
+        }
+
+        free(frame->data);
+
+        if (q != NULL) {
+            wire_deliver(q, netif);
+        }
+    }
+}
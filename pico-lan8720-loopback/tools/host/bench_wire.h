@@ -0,0 +1,89 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _BENCH_WIRE_H_
+#define _BENCH_WIRE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+
+// what the lwIP benches share, built into each of them with LWIP_HOST_SOURCES:
+// - lwIP's clock, now_ms in virtual time the bench moves along, and the locks of
+//   sys_arch, nothing to lock in one thread. now_ns() is the host's clock
+// - the wire between netif_a and netif_b, two netifs in one subnet: wire_output() takes
+//   each frame into a pool pbuf (chain), as the RMII driver receives them, and wire_run()
+//   or wire_step() hands it to the input of the netif it is for. A bench with a wire of
+//   its own, with a delay or a rate, sets wire_netif_output before adding the netifs
+// - lines with a delay, the frames copied out of the pools while on the way
+
+extern u32_t now_ms;
+
+extern struct netif netif_a, netif_b;
+
+// frames on the wire, and those dropped for want of a pool pbuf or of room on it
+extern uint32_t wire_packets, wire_drops;
+
+// the output wire_netif_init() sets, wire_output() unless the bench changes it
+extern netif_output_fn wire_netif_output;
+
+// a look at each frame wire_output() takes, before it goes on the wire: false drops it
+extern bool (*wire_tap)(struct pbuf *p, const ip4_addr_t *ipaddr);
+
+uint64_t now_ns(void);
+
+// an empty wire of size frames, the counts cleared
+void wire_init(uint32_t size);
+
+// p to arrive on netif, false and p freed when the wire is full
+bool wire_queue(struct pbuf *p, struct netif *netif);
+
+// the frames on the wire
+uint32_t wire_pending(void);
+
+// the next frame off the wire and its netif, NULL when it is empty
+struct pbuf *wire_take(struct netif **netif);
+
+// to netif_a when ipaddr is its address, to netif_b otherwise
+err_t wire_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr);
+
+// netif_add()'s init for netif_a and netif_b
+err_t wire_netif_init(struct netif *netif);
+
+// delivers everything on the wire, including what the deliveries send, then one ms passes
+void wire_run(void);
+
+// one ms passes, then the frames sent before it arrive; what the timers or the deliveries
+// send waits for the next step
+void wire_step(void);
+
+struct wire_frame {
+    uint8_t *data;
+    uint16_t len;
+    uint32_t time; // virtual ms it arrives at the far end
+};
+
+// a direction of a line, frames in the order they arrive
+struct wire_line {
+    struct wire_frame *frames;
+    uint32_t size;
+    uint32_t head, tail;
+};
+
+// an empty line of size frames, one the line had before freed
+void wire_line_init(struct wire_line *line, uint32_t size);
+
+// data, malloc()ed and taken by the line, to arrive at time, false when the line is full
+bool wire_line_push(struct wire_line *line, uint8_t *data, uint16_t len, uint32_t time);
+
+// a copy of p to arrive delay ms from now, false when the line is full
+bool wire_line_send(struct wire_line *line, struct pbuf *p, uint32_t delay);
+
+// what has arrived by now_ms to netif's input, as the receiving driver does: a pool pbuf
+// per frame, counted in wire_drops without one
+void wire_line_deliver(struct wire_line *line, struct netif *netif);
+
+#endif
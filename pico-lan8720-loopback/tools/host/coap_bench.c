@@ -0,0 +1,795 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/udp.h"
+#include "lwip/apps/httpd.h"
+
+#include "net.h"
+#include "coap.h"
+#include "coap_demo.h"
+#include "coap_fs.h"
+
+#include "bench_wire.h"
+
+// the CoAP server of coap/coap.c on net/net_lwip.c with the resources of coap_demo.c and
+// the content of examples/coap/fs through coap_fs.c, the firmware's sources, next to
+// lwIP's httpd serving the same fsdata, in virtual time. The wire takes a ms each way.
+// Clients on the same stack poll the same file over both: a CON GET and its piggybacked
+// ACK for CoAP, a connection, a GET and the server's close for HTTP/1.0. Then a block-wise
+// GET of the 4 KB blob, observers of the counter while it is PUT, one of them going deaf
+// until it is dropped, and the responses of the edge cases. The exit status is 1 when a
+// response was wrong or a run stalled
+//
+// usage: coap_bench [requests per case, default 2000]
+//
+// one line per protocol and number of pollers: requests per virtual second, packets on
+// the wire per request both ways, the latency p50/p99/max in virtual ms and host ns per
+// request for both ends and the wire. A CoAP poll is 2 datagrams and 2 ms, an HTTP/1.0
+// one 6 segments and 4 ms with its handshake and close
+
+#define WIRE_SIZE 1024
+
+// virtual ms without a response before a run is given up
+#define STALL_MS 5000
+
+#define POLLERS_MAX 32
+// of the counter, the last observer of the server observes the uptime
+#define OBSERVERS (COAP_OBSERVERS - 1)
+#define PUTS 200
+
+#define MESSAGE_MAX 1280
+
+#define FILE_PATH "status.json"
+
+enum mode {
+    MODE_COAP,
+    MODE_HTTP,
+    MODE_BLOCK,
+    MODE_OBSERVE,
+    MODE_CHECK
+};
+
+// a response as the clients read it
+struct message {
+    uint8_t type;
+    uint8_t code;
+    uint16_t mid;
+    uint32_t token;
+    int32_t observe;
+    int32_t format;
+    int32_t block2;
+    const uint8_t *payload;
+    uint16_t len;
+};
+
+struct poller {
+    uint id;
+    struct udp_pcb *udp;
+    struct tcp_pcb *tcp;
+    uint16_t mid;
+    uint32_t sent_ms;
+    uint32_t rx_len;
+    uint8_t rx[MESSAGE_MAX];
+    // observing: notifications and the last value, deaf ones acknowledge nothing
+    uint32_t notifications;
+    uint32_t value;
+    bool registered;
+    bool deaf;
+    // the last response of MODE_CHECK
+    bool answered;
+    struct message m;
+};
+
+static struct poller pollers[POLLERS_MAX + 2];
+static uint32_t requests = 2000;
+static uint failures;
+static enum mode mode;
+
+// the run: requests sent and answered, the latency of each
+static uint32_t run_sent, run_answered;
+static uint32_t *latency;
+
+// the file both servers serve
+static struct coap_content file;
+
+// the block-wise run
+static uint8_t block_szx;
+static uint32_t block_offset;
+static uint32_t block_count;
+static bool block_done;
+
+uint32_t timebase_ms(void) {
+    return now_ms;
+}
+
+static void wire_wait(uint32_t ms) {
+    for (uint32_t start = now_ms; now_ms - start < ms; ) {
+        wire_step();
+    }
+}
+
+static uint8_t *option_put(uint8_t *p, uint16_t *last, uint16_t number, const void *value, uint16_t len) {
+    uint16_t delta = number - *last;
+
+    // the bench's options are short and close together
+    *p++ = (delta << 4) | len;
+    memcpy(p, value, len);
+    *last = number;
+
+    return p + len;
+}
+
+static uint8_t *option_put_uint(uint8_t *p, uint16_t *last, uint16_t number, uint32_t v) {
+    uint8_t value[3] = {v >> 16, v >> 8, v};
+    uint16_t len = (v > 0xffff) ? 3 : (v > 0xff) ? 2 : (v > 0) ? 1 : 0;
+
+    return option_put(p, last, number, value + 3 - len, len);
+}
+
+// a request with a 4 byte token, observe, accept and block2 when not -1
+static uint16_t request_build(uint8_t *msg, uint8_t type, uint8_t code, uint16_t mid, uint32_t token,
+                              const char *path, int32_t observe, int32_t accept, int32_t block2,
+                              const char *payload) {
+    uint8_t *p = msg + 8;
+    uint16_t last = 0;
+
+    msg[0] = 0x40 | (type << 4) | 4;
+    msg[1] = code;
+    msg[2] = mid >> 8;
+    msg[3] = mid;
+    msg[4] = token >> 24;
+    msg[5] = token >> 16;
+    msg[6] = token >> 8;
+    msg[7] = token;
+
+    if (observe >= 0) {
+        p = option_put_uint(p, &last, 6, observe);
+    }
+
+    while (path != NULL && *path) {
+        const char *end = strchr(path, '/');
+        uint16_t n = end ? (uint16_t)(end - path) : (uint16_t)strlen(path);
+
+        if (n >= 13) {
+            *p++ = ((11 - last) << 4) | 13;
+            *p++ = n - 13;
+            memcpy(p, path, n);
+            p += n;
+            last = 11;
+        } else {
+            p = option_put(p, &last, 11, path, n);
+        }
+
+        path += n + (end != NULL);
+    }
+
+    if (accept >= 0) {
+        p = option_put_uint(p, &last, 17, accept);
+    }
+
+    if (block2 >= 0) {
+        p = option_put_uint(p, &last, 23, block2);
+    }
+
+    if (payload != NULL) {
+        *p++ = 0xff;
+        memcpy(p, payload, strlen(payload));
+        p += strlen(payload);
+    }
+
+    return p - msg;
+}
+
+static bool message_parse(const uint8_t *msg, uint16_t len, struct message *m) {
+    const uint8_t *end = msg + len;
+    const uint8_t *p;
+    uint16_t number = 0;
+    uint8_t tkl = msg[0] & 0x0f;
+
+    memset(m, 0, sizeof(*m));
+    m->observe = m->format = m->block2 = -1;
+
+    if (len < 4 || (msg[0] >> 6) != 1 || tkl > 8 || len < 4 + tkl) {
+        return false;
+    }
+
+    m->type = (msg[0] >> 4) & 3;
+    m->code = msg[1];
+    m->mid = (msg[2] << 8) | msg[3];
+
+    for (uint8_t i = 0; i < tkl; i++) {
+        m->token = (m->token << 8) | msg[4 + i];
+    }
+
+    for (p = msg + 4 + tkl; p < end; ) {
+        if (*p == 0xff) {
+            m->payload = p + 1;
+            m->len = end - p - 1;
+
+            return m->len != 0;
+        }
+
+        uint16_t delta = *p >> 4;
+        uint16_t olen = *p++ & 0x0f;
+
+        if (delta == 13) {
+            delta = 13 + *p++;
+        } else if (delta == 14) {
+            delta = 269 + ((p[0] << 8) | p[1]);
+            p += 2;
+        }
+
+        if (olen == 13) {
+            olen = 13 + *p++;
+        } else if (olen >= 14) {
+            return false;
+        }
+
+        number += delta;
+
+        uint32_t v = 0;
+
+        for (uint16_t i = 0; i < olen && i < 4; i++) {
+            v = (v << 8) | p[i];
+        }
+
+        if (number == 6) {
+            m->observe = v;
+        } else if (number == 12) {
+            m->format = v;
+        } else if (number == 23) {
+            m->block2 = v;
+        }
+
+        p += olen;
+    }
+
+    return p == end;
+}
+
+static void poller_send(struct poller *pl, const uint8_t *msg, uint16_t len) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+
+    if (p == NULL) {
+        failures++;
+
+        return;
+    }
+
+    memcpy(p->payload, msg, len);
+
+    // out of the client's side, the route to the server's address is the server's netif
+    if (udp_sendto_if(pl->udp, p, netif_ip_addr4(&netif_b), COAP_PORT, &netif_a) != ERR_OK) {
+        failures++;
+    }
+
+    pbuf_free(p);
+}
+
+static void poller_get(struct poller *pl) {
+    uint8_t msg[64];
+
+    pl->mid++;
+    pl->sent_ms = now_ms;
+    poller_send(pl, msg, request_build(msg, 0, COAP_GET, pl->mid, pl->id << 16 | pl->mid, FILE_PATH, -1, -1, -1,
+                                       NULL));
+    run_sent++;
+}
+
+static void poller_block(struct poller *pl) {
+    uint8_t msg[64];
+
+    pl->mid++;
+    poller_send(pl, msg, request_build(msg, 0, COAP_GET, pl->mid, pl->mid, "blob", -1, -1,
+                                       (block_count << 4) | block_szx, NULL));
+}
+
+static void poller_put(struct poller *pl, uint32_t value) {
+    uint8_t msg[64];
+    char text[12];
+
+    snprintf(text, sizeof(text), "%u", value);
+    pl->mid++;
+    poller_send(pl, msg, request_build(msg, 0, COAP_PUT, pl->mid, pl->mid, "counter", -1, -1, -1, text));
+}
+
+static void poller_observe(struct poller *pl, const char *path, uint32_t observe) {
+    uint8_t msg[64];
+
+    pl->mid++;
+    poller_send(pl, msg, request_build(msg, 0, COAP_GET, pl->mid, pl->id, path, observe, -1, -1, NULL));
+}
+
+static void poller_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    struct poller *pl = arg;
+    uint8_t buf[MESSAGE_MAX];
+    struct message m;
+    uint16_t len = pbuf_copy_partial(p, buf, sizeof(buf), 0);
+
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(addr);
+    LWIP_UNUSED_ARG(port);
+
+    pbuf_free(p);
+
+    if (!message_parse(buf, len, &m)) {
+        failures++;
+
+        return;
+    }
+
+    switch (mode) {
+    case MODE_COAP:
+        if (m.type != 2 || m.mid != pl->mid || m.token != (pl->id << 16 | pl->mid) || m.code != COAP_CONTENT ||
+            m.format != file.format || m.len != file.len || memcmp(m.payload, file.data, m.len) != 0) {
+            failures++;
+        }
+
+        latency[run_answered++] = now_ms - pl->sent_ms;
+
+        if (run_sent < requests) {
+            poller_get(pl);
+        }
+
+        break;
+    case MODE_BLOCK: {
+        uint32_t num = (uint32_t)m.block2 >> 4;
+        uint32_t size = 16u << (m.block2 & 7);
+
+        if (m.code != COAP_CONTENT || m.block2 < 0 || num != block_count || (m.block2 & 7) != block_szx ||
+            (((m.block2 >> 3) & 1) && m.len != size)) {
+            failures++;
+            block_done = true;
+
+            break;
+        }
+
+        for (uint16_t i = 0; i < m.len; i++) {
+            if (m.payload[i] != (uint8_t)(block_offset + i)) {
+                failures++;
+                break;
+            }
+        }
+
+        block_offset += m.len;
+        block_count++;
+
+        if ((m.block2 >> 3) & 1) {
+            poller_block(pl);
+        } else {
+            block_done = true;
+        }
+
+        break;
+    }
+    case MODE_OBSERVE:
+        if (m.type == 0 || m.type == 1) {
+            // a notification, its value
+            if (m.token != pl->id || m.observe < 0) {
+                failures++;
+            }
+
+            pl->notifications++;
+            pl->value = strtoul((const char *)m.payload, NULL, 10);
+
+            if (m.type == 0 && !pl->deaf) {
+                uint8_t ack[4] = {0x60, 0, m.mid >> 8, m.mid};
+
+                poller_send(pl, ack, sizeof(ack));
+            }
+        } else if (m.mid == pl->mid) {
+            pl->registered = m.observe >= 0;
+            pl->answered = true;
+            pl->m = m;
+        }
+
+        break;
+    default:
+        pl->answered = true;
+        pl->m = m;
+        memcpy(pl->rx, buf, len);
+        pl->m.payload = m.payload ? pl->rx + (m.payload - buf) : NULL;
+        break;
+    }
+}
+
+static void http_get(struct poller *pl);
+
+static err_t http_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    struct poller *pl = arg;
+
+    LWIP_UNUSED_ARG(err);
+
+    if (p != NULL) {
+        if (pl->rx_len + p->tot_len > sizeof(pl->rx)) {
+            failures++;
+        } else {
+            pl->rx_len += pbuf_copy_partial(p, pl->rx + pl->rx_len, p->tot_len, 0);
+        }
+
+        tcp_recved(pcb, p->tot_len);
+        pbuf_free(p);
+
+        return ERR_OK;
+    }
+
+    // HTTP/1.0: the response ends with the server's close
+    const uint8_t *body = NULL;
+
+    for (uint32_t i = 0; i + 4 <= pl->rx_len; i++) {
+        if (memcmp(pl->rx + i, "\r\n\r\n", 4) == 0) {
+            body = pl->rx + i + 4;
+            break;
+        }
+    }
+
+    if (body == NULL || memcmp(pl->rx, "HTTP/1.0 200", 12) != 0 || pl->rx + pl->rx_len - body != file.len ||
+        memcmp(body, file.data, file.len) != 0) {
+        failures++;
+    }
+
+    tcp_arg(pcb, NULL);
+    tcp_close(pcb);
+    pl->tcp = NULL;
+
+    latency[run_answered++] = now_ms - pl->sent_ms;
+
+    if (run_sent < requests) {
+        http_get(pl);
+    }
+
+    return ERR_OK;
+}
+
+static err_t http_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    static const char request[] = "GET /" FILE_PATH " HTTP/1.0\r\n\r\n";
+
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    tcp_write(pcb, request, sizeof(request) - 1, 0);
+    tcp_output(pcb);
+
+    return ERR_OK;
+}
+
+static void http_err(void *arg, err_t err) {
+    struct poller *pl = arg;
+
+    LWIP_UNUSED_ARG(err);
+
+    if (pl != NULL) {
+        pl->tcp = NULL;
+        failures++;
+    }
+}
+
+static void http_get(struct poller *pl) {
+    pl->tcp = tcp_new();
+    pl->rx_len = 0;
+    pl->sent_ms = now_ms;
+    run_sent++;
+
+    if (pl->tcp == NULL) {
+        failures++;
+
+        return;
+    }
+
+    tcp_arg(pl->tcp, pl);
+    tcp_recv(pl->tcp, http_recv);
+    tcp_err(pl->tcp, http_err);
+    tcp_nagle_disable(pl->tcp);
+    tcp_bind(pl->tcp, netif_ip_addr4(&netif_a), 0);
+    tcp_connect(pl->tcp, netif_ip_addr4(&netif_b), 80, http_connected);
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void bench(enum mode m, uint count) {
+    bool stalled = false;
+
+    mode = m;
+    run_sent = run_answered = 0;
+    wire_packets = 0;
+
+    uint32_t start_ms = now_ms;
+    uint64_t start_ns = now_ns();
+
+    for (uint i = 0; i < count && run_sent < requests; i++) {
+        if (m == MODE_COAP) {
+            poller_get(&pollers[i]);
+        } else {
+            http_get(&pollers[i]);
+        }
+    }
+
+    for (uint32_t last = run_answered, last_ms = now_ms; run_answered < requests; ) {
+        wire_step();
+
+        if (run_answered != last) {
+            last = run_answered;
+            last_ms = now_ms;
+        } else if (now_ms - last_ms >= STALL_MS) {
+            stalled = true;
+            break;
+        }
+    }
+
+    uint64_t elapsed_ns = now_ns() - start_ns;
+    uint32_t elapsed_ms = now_ms - start_ms;
+    uint32_t done = run_answered;
+
+    // the closes and the TIME_WAITs of the last ones are left to the next run
+    qsort(latency, done, sizeof(uint32_t), compare_u32);
+
+    printf("%s %2u pollers: %6.0f req/s, %5.2f packets/req, latency p50/p99/max %u/%u/%u ms, %6.0f host ns/req%s\n",
+        (m == MODE_COAP) ? "coap" : "http", count, elapsed_ms ? done * 1000.0 / elapsed_ms : 0.0,
+        done ? (double)wire_packets / done : 0.0, done ? latency[done / 2] : 0, done ? latency[(done * 99) / 100] : 0,
+        done ? latency[done - 1] : 0, done ? (double)elapsed_ns / done : 0.0, stalled ? ", STALLED" : "");
+
+    if (stalled) {
+        failures++;
+    }
+
+    wire_wait(100);
+}
+
+static void bench_block(uint8_t szx) {
+    mode = MODE_BLOCK;
+    block_szx = szx;
+    block_offset = block_count = 0;
+    block_done = false;
+    wire_packets = 0;
+
+    uint32_t start_ms = now_ms;
+
+    poller_block(&pollers[0]);
+
+    while (!block_done && now_ms - start_ms < STALL_MS) {
+        wire_step();
+    }
+
+    printf("coap blob in blocks of %4u: %u blocks, %u bytes in %u ms, %u packets\n", 16u << szx, block_count,
+           block_offset, now_ms - start_ms, wire_packets);
+
+    if (!block_done || block_offset != COAP_DEMO_BLOB) {
+        failures++;
+    }
+}
+
+// OBSERVERS observe the counter while another client PUTs it PUTS times, one more observes
+// the uptime, notified every second. Then one of the counter's goes deaf and is dropped
+static void bench_observe(void) {
+    struct poller *writer = &pollers[OBSERVERS];
+    struct poller *clock = &pollers[OBSERVERS + 1];
+    struct coap_stats stats;
+    uint32_t notifications = 0;
+
+    mode = MODE_OBSERVE;
+
+    for (uint i = 0; i < OBSERVERS; i++) {
+        poller_observe(&pollers[i], "counter", 0);
+    }
+
+    poller_observe(clock, "uptime", 0);
+    wire_wait(10);
+
+    for (uint i = 0; i < OBSERVERS; i++) {
+        if (!pollers[i].registered) {
+            failures++;
+        }
+    }
+
+    uint32_t start_ms = now_ms;
+    uint64_t start_ns = now_ns();
+
+    for (uint32_t v = 1; v <= PUTS; v++) {
+        writer->answered = false;
+        poller_put(writer, v);
+
+        for (uint32_t t = now_ms; !writer->answered && now_ms - t < STALL_MS; ) {
+            wire_step();
+        }
+
+        if (!writer->answered || writer->m.code != COAP_CHANGED) {
+            failures++;
+            break;
+        }
+    }
+
+    wire_wait(10);
+
+    uint32_t elapsed_ms = now_ms - start_ms;
+    uint64_t elapsed_ns = now_ns() - start_ns;
+
+    for (uint i = 0; i < OBSERVERS; i++) {
+        notifications += pollers[i].notifications;
+
+        if (pollers[i].value != PUTS || pollers[i].notifications < PUTS) {
+            failures++;
+        }
+    }
+
+    coap_get_stats(&stats);
+    printf("coap %u observers of %u PUTs: %u notifications, %.0f/s, %u confirmable, %.0f host ns/notification\n",
+           OBSERVERS, PUTS, notifications, notifications * 1000.0 / elapsed_ms, stats.confirmable,
+           (double)elapsed_ns / notifications);
+
+    // a deaf observer: its next confirmable notification goes unacknowledged through
+    // COAP_MAX_RETRANSMIT retransmissions, 2 + 4 + 8 + 16 + 32 s
+    pollers[0].deaf = true;
+
+    for (uint32_t v = 1; v <= COAP_OBSERVE_CON_EVERY; v++) {
+        writer->answered = false;
+        poller_put(writer, PUTS + v);
+        wire_wait(5);
+    }
+
+    uint32_t uptime_before = clock->notifications;
+
+    wire_wait(64 * 1000);
+    coap_get_stats(&stats);
+
+    printf("coap deaf observer dropped after %u retransmissions, %u lost, %u observing, uptime notified %u times in 64 s\n",
+           stats.retransmissions, stats.observers_lost, stats.observers, clock->notifications - uptime_before);
+
+    if (stats.observers_lost != 1 || stats.retransmissions != COAP_MAX_RETRANSMIT ||
+        stats.observers != OBSERVERS || clock->notifications - uptime_before < 63) {
+        failures++;
+    }
+
+    // the others deregister
+    for (uint i = 1; i < OBSERVERS; i++) {
+        poller_observe(&pollers[i], "counter", 1);
+    }
+
+    poller_observe(clock, "uptime", 1);
+    wire_wait(10);
+    coap_get_stats(&stats);
+
+    if (stats.observers != 0) {
+        failures++;
+    }
+}
+
+// a request and its response, on pollers[0]
+static const struct message *exchange(const uint8_t *msg, uint16_t len) {
+    struct poller *pl = &pollers[0];
+
+    mode = MODE_CHECK;
+    pl->answered = false;
+    poller_send(pl, msg, len);
+
+    for (uint32_t start = now_ms; !pl->answered && now_ms - start < 100; ) {
+        wire_step();
+    }
+
+    return pl->answered ? &pl->m : NULL;
+}
+
+static void check(const char *name, uint8_t type, uint8_t code, const char *path, int32_t accept,
+                  const char *payload, uint8_t want_type, uint8_t want_code, const char *want_payload) {
+    uint8_t msg[96];
+    uint16_t len = request_build(msg, type, code, 0x4242, 0x42, path, -1, accept, -1, payload);
+    const struct message *m;
+
+    if (code == 0) {
+        // empty, a ping
+        msg[0] = 0x40;
+        len = 4;
+    }
+
+    m = exchange(msg, len);
+
+    bool ok = m != NULL && m->type == want_type && m->code == want_code &&
+        (want_payload == NULL || (m->len == strlen(want_payload) && memcmp(m->payload, want_payload, m->len) == 0));
+
+    printf("check %-26s %s\n", name, ok ? "ok" : "FAILED");
+
+    if (!ok) {
+        if (m != NULL) {
+            printf("  type %u code %u.%02u, %u bytes\n", m->type, m->code >> 5, m->code & 0x1f, m->len);
+        }
+
+        failures++;
+    }
+}
+
+int main(int argc, char **argv) {
+    static const uint counts[] = { 1, 8, 32 };
+
+    if (argc > 1) {
+        requests = strtoul(argv[1], NULL, 0);
+    }
+
+    latency = calloc(requests, sizeof(uint32_t));
+
+    if (latency == NULL) {
+        return 1;
+    }
+
+    wire_init(WIRE_SIZE);
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    httpd_init();
+    coap_demo_init(coap_fs_find);
+
+    if (!coap_fs_find(FILE_PATH, &file) || file.encoded) {
+        printf("no plain %s in the fsdata\n", FILE_PATH);
+
+        return 1;
+    }
+
+    for (uint i = 0; i < sizeof(pollers) / sizeof(pollers[0]); i++) {
+        pollers[i].id = i + 1;
+        pollers[i].udp = udp_new();
+
+        if (pollers[i].udp == NULL) {
+            return 1;
+        }
+
+        udp_bind(pollers[i].udp, netif_ip_addr4(&netif_a), 0);
+        udp_recv(pollers[i].udp, poller_recv, &pollers[i]);
+    }
+
+    for (uint i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        bench(MODE_COAP, counts[i]);
+    }
+
+    for (uint i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        bench(MODE_HTTP, counts[i]);
+    }
+
+    bench_block(COAP_BLOCK_SZX);
+    bench_block(2);
+    bench_observe();
+
+    check("well-known/core", 0, COAP_GET, ".well-known/core", -1, NULL, 2, COAP_CONTENT,
+          "</uptime>;ct=0;obs,</counter>;ct=0;obs,</stats>;ct=50,</blob>;ct=42");
+    check("NON GET", 1, COAP_GET, FILE_PATH, -1, NULL, 1, COAP_CONTENT, NULL);
+    check("Accept of the format", 0, COAP_GET, FILE_PATH, COAP_FORMAT_JSON, NULL, 2, COAP_CONTENT, NULL);
+    check("Accept of another", 0, COAP_GET, FILE_PATH, COAP_FORMAT_TEXT, NULL, 2, COAP_NOT_ACCEPTABLE, NULL);
+    check("gzipped file", 0, COAP_GET, "index.html", -1, NULL, 2, COAP_NOT_ACCEPTABLE, NULL);
+    check("missing", 0, COAP_GET, "nothing/here", -1, NULL, 2, COAP_NOT_FOUND, NULL);
+    check("PUT read only", 0, COAP_PUT, "stats", -1, "1", 2, COAP_METHOD_NOT_ALLOWED, NULL);
+    check("PUT not a number", 0, COAP_PUT, "counter", -1, "x", 2, COAP_BAD_REQUEST, NULL);
+    check("POST", 0, COAP_POST, "counter", -1, "1", 2, COAP_METHOD_NOT_ALLOWED, NULL);
+    check("ping", 0, 0, NULL, -1, NULL, 3, 0, NULL);
+
+    // a frame the wire dropped is a failure too
+    failures += wire_drops;
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    free(latency);
+
+    return failures ? 1 : 0;
+}
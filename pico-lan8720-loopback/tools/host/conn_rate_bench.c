@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+
+#include "bench_wire.h"
+
+// short connections one after the other, as HTTP/1.0 requests: the client connects, sends a
+// 64 byte request, the server replies with 64 bytes and closes first, so every connection
+// leaves a server pcb in TIME_WAIT. Once with a new client port per connection and once
+// with the client reusing REUSE_PORTS ports in turn, as a load generator that binds its
+// ports or a NAT in front of many clients. Built on the balanced profile and on conn_rate,
+// the reused ports run into their own TIME_WAIT pcbs on the first. The clients' pcbs are in
+// the same stack and pool. The exit status is 1 when a reply came back wrong, or with
+// LWIP_TCP_TIME_WAIT_RECYCLE when a connection failed
+//
+// usage: conn_rate_bench_conn_rate [ms per pattern, default 200]
+//
+// one line per pattern: profile, client ports, connections per second of host time and of
+// virtual time (the wire's 1 ms round trip), the host time from tcp_connect() to the
+// server's accept of the connections that got through, those refused and timed out, and the
+// pcbs left in TIME_WAIT
+
+#define MESSAGE_SIZE 64
+#define WIRE_SIZE 64
+#define REUSE_PORTS 2
+#define CLIENT_PORT 40000
+#define SERVER_PORT 80
+
+// virtual ms without the reply and the close before a connection is given up, past the
+// first retransmission of a SYN
+#define CONNECT_TIMEOUT_MS 5000
+
+struct client {
+    struct tcp_pcb *pcb;
+    uint32_t start_ms;
+    uint64_t start_ns;
+    uint64_t accept_ns; // after start_ns
+    uint32_t received;
+    bool accepted;
+    bool done;
+    bool refused;
+};
+
+struct result {
+    uint32_t connections;
+    uint32_t refused;
+    uint32_t timed_out;
+    uint64_t accept_ns; // sum
+    uint64_t accept_max_ns;
+};
+
+static struct client client;
+static uint failures;
+static uint32_t bench_ms = 200;
+
+unsigned int conn_rate_bench_isn(void) {
+    static unsigned int last;
+
+    // 250 per ms, and never the same twice within one
+    unsigned int isn = now_ms * 250;
+
+    if ((int)(isn - last) <= 0) {
+        isn = last + 1;
+    }
+
+    last = isn;
+
+    return isn;
+}
+
+static uint time_wait_count(void) {
+    uint count = 0;
+
+    for (struct tcp_pcb *pcb = tcp_tw_pcbs; pcb != NULL; pcb = pcb->next) {
+        count++;
+    }
+
+    return count;
+}
+
+// the reply, then the server closes
+static err_t server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    uint8_t reply[MESSAGE_SIZE];
+
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        tcp_close(pcb);
+
+        return ERR_OK;
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    memset(reply, 0xa5, sizeof(reply));
+
+    if (tcp_write(pcb, reply, sizeof(reply), TCP_WRITE_FLAG_COPY) != ERR_OK) {
+        failures++;
+    }
+
+    tcp_recv(pcb, NULL);
+    tcp_close(pcb);
+
+    return ERR_OK;
+}
+
+static err_t server_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    if (client.pcb != NULL && pcb->remote_port == client.pcb->local_port) {
+        client.accept_ns = now_ns() - client.start_ns;
+        client.accepted = true;
+    }
+
+    tcp_recv(pcb, server_recv);
+    tcp_nagle_disable(pcb);
+
+    return ERR_OK;
+}
+
+static err_t client_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        if (client.received != MESSAGE_SIZE) {
+            failures++;
+        }
+
+        tcp_arg(pcb, NULL);
+        tcp_err(pcb, NULL);
+        tcp_recv(pcb, NULL);
+        tcp_close(pcb);
+
+        client.pcb = NULL;
+        client.done = true;
+
+        return ERR_OK;
+    }
+
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        for (u16_t i = 0; i < q->len; i++) {
+            if (((uint8_t *)q->payload)[i] != 0xa5) {
+                failures++;
+                break;
+            }
+        }
+    }
+
+    client.received += p->tot_len;
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    return ERR_OK;
+}
+
+static err_t client_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    uint8_t request[MESSAGE_SIZE];
+
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    memset(request, 0x5a, sizeof(request));
+
+    if (tcp_write(pcb, request, sizeof(request), TCP_WRITE_FLAG_COPY) != ERR_OK) {
+        failures++;
+    }
+
+    tcp_output(pcb);
+
+    return ERR_OK;
+}
+
+static void client_err(void *arg, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    // the pcb is already freed
+    client.pcb = NULL;
+    client.refused = true;
+    client.done = true;
+}
+
+// one connection from the port, 0 for a new one
+static void connection_run(u16_t port, struct result *result) {
+    memset(&client, 0, sizeof(client));
+
+    client.pcb = tcp_new();
+
+    if (client.pcb == NULL) {
+        result->refused++;
+
+        return;
+    }
+
+    tcp_err(client.pcb, client_err);
+    tcp_recv(client.pcb, client_recv);
+    tcp_nagle_disable(client.pcb);
+
+    if (tcp_bind(client.pcb, netif_ip_addr4(&netif_a), port) != ERR_OK) {
+        tcp_abort(client.pcb);
+        result->refused++;
+
+        return;
+    }
+
+    client.start_ms = now_ms;
+    client.start_ns = now_ns();
+    tcp_connect(client.pcb, netif_ip_addr4(&netif_b), SERVER_PORT, client_connected);
+
+    while (!client.done && (now_ms - client.start_ms) < CONNECT_TIMEOUT_MS) {
+        wire_run();
+    }
+
+    if (!client.done) {
+        tcp_abort(client.pcb);
+        client.pcb = NULL;
+        result->timed_out++;
+    } else if (client.refused || !client.accepted) {
+        result->refused++;
+    } else {
+        result->accept_ns += client.accept_ns;
+
+        if (client.accept_ns > result->accept_max_ns) {
+            result->accept_max_ns = client.accept_ns;
+        }
+    }
+
+    // the client's last ACK, so its pcb is freed before the next connection
+    wire_run();
+}
+
+static void bench(const char *name, bool reuse) {
+    struct result result = { 0 };
+    uint32_t start_ms = now_ms;
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+
+    do {
+        connection_run(reuse ? (u16_t)(CLIENT_PORT + result.connections % REUSE_PORTS) : 0, &result);
+
+        result.connections++;
+        elapsed = now_ns() - start;
+    } while (elapsed < bench_ms * 1000000ull);
+
+    uint32_t virtual_ms = now_ms - start_ms;
+    uint32_t failed = result.refused + result.timed_out;
+    uint32_t accepted = result.connections - failed;
+
+    printf("%-9s %-9s %8.0f conn/s %6.0f conn/vs, accept %.2f/%.2f us avg/max, %u of %u refused, %u timed out, %u time-wait\n",
+        CONN_RATE_BENCH_NAME, name, result.connections * 1e9 / elapsed,
+        virtual_ms ? result.connections * 1e3 / virtual_ms : 0.0,
+        accepted ? result.accept_ns / 1e3 / accepted : 0.0, result.accept_max_ns / 1e3,
+        result.refused, result.connections, result.timed_out, time_wait_count());
+
+#if LWIP_TCP_TIME_WAIT_RECYCLE
+    if (failed) {
+        failures++;
+    }
+#endif
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        bench_ms = strtoul(argv[1], NULL, 0);
+    }
+
+    wire_init(WIRE_SIZE);
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    struct tcp_pcb *listener = tcp_new();
+
+    tcp_bind(listener, netif_ip_addr4(&netif_b), SERVER_PORT);
+    listener = tcp_listen(listener);
+    tcp_accept(listener, server_accept);
+
+    bench("ephemeral", false);
+    bench("reuse", true);
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
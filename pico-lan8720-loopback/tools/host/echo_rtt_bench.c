@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+
+#include "bench_wire.h"
+
+// the round trip of 64 byte messages through a server that does what examples/loopback
+// does under each of its latency policies, against an lwIP client, in virtual time. The
+// wire takes a ms each way, so 2 ms is the best round trip, and lwIP's delayed ACK waits
+// for the fast timer every TCP_TMR_INTERVAL. The exit status is 1 when data came back
+// wrong or a round stalled
+//
+// usage: echo_rtt_bench [rounds per case, default 200]
+//
+// one line per policy and workload, the round trips' min/avg/p99/max in virtual ms:
+//   ping-pong  one message, the next when its echo is back
+//   pipelined  two messages in flight, the round is over when both are back
+//   discard    two messages to a sink from a client with Nagle on, until both are
+//              acknowledged: the second waits for the ACK of the first, as the second
+//              write of a request does
+
+#define MESSAGE_SIZE 64
+#define WIRE_SIZE 64
+
+// virtual ms without progress before a round is given up
+#define STALL_MS 2000
+
+#define ECHO_PORT 5000
+#define DISCARD_PORT 9
+
+enum policy {
+    POLICY_THROUGHPUT,
+    POLICY_LOW_LATENCY,
+};
+
+static const char *const policy_names[] = { "throughput", "low-latency" };
+
+static struct tcp_pcb *client;
+static enum policy server_policy;
+static bool connected;
+static uint32_t received, acked;
+static uint32_t rounds = 200;
+static uint32_t idle_state = 1;
+static uint failures;
+
+// tcp_echoserver_policy_flush()
+static void server_flush(struct tcp_pcb *pcb) {
+    if (server_policy == POLICY_LOW_LATENCY) {
+        if (pcb->flags & TF_ACK_DELAY) {
+            tcp_ack_now(pcb);
+        }
+
+        tcp_output(pcb);
+    }
+}
+
+static err_t server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    bool echo = arg != NULL;
+
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        tcp_close(pcb);
+
+        return ERR_OK;
+    }
+
+    if (echo) {
+        for (struct pbuf *q = p; q != NULL; q = q->next) {
+            if (tcp_write(pcb, q->payload, q->len, TCP_WRITE_FLAG_COPY | (q->next ? TCP_WRITE_FLAG_MORE : 0)) != ERR_OK) {
+                failures++;
+            }
+        }
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    server_flush(pcb);
+
+    return ERR_OK;
+}
+
+static err_t server_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    // tcp_echoserver_policy_apply()
+    if (server_policy == POLICY_LOW_LATENCY) {
+        tcp_nagle_disable(pcb);
+    } else {
+        tcp_nagle_enable(pcb);
+    }
+
+    tcp_arg(pcb, arg);
+    tcp_recv(pcb, server_recv);
+
+    return ERR_OK;
+}
+
+// every byte is its offset in the stream, mod 251
+static err_t client_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        // the server's close after the client's
+        return ERR_OK;
+    }
+
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        for (u16_t i = 0; i < q->len; i++) {
+            if (((uint8_t *)q->payload)[i] != (uint8_t)(received++ % 251)) {
+                failures++;
+            }
+        }
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    return ERR_OK;
+}
+
+static err_t client_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+
+    acked += len;
+
+    return ERR_OK;
+}
+
+static err_t client_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(err);
+
+    connected = true;
+
+    return ERR_OK;
+}
+
+static bool client_open(u16_t port, bool nagle) {
+    client = tcp_new();
+    connected = false;
+    received = acked = 0;
+
+    if (client == NULL) {
+        return false;
+    }
+
+    tcp_recv(client, client_recv);
+    tcp_sent(client, client_sent);
+
+    if (!nagle) {
+        tcp_nagle_disable(client);
+    }
+
+    tcp_bind(client, netif_ip_addr4(&netif_a), 0);
+    tcp_connect(client, netif_ip_addr4(&netif_b), port, client_connected);
+
+    for (uint32_t start = now_ms; !connected && (now_ms - start) < STALL_MS; ) {
+        wire_step();
+    }
+
+    return connected;
+}
+
+static void client_close(void) {
+    tcp_close(client);
+
+    // both ends closed before the next case, TIME_WAIT is left to itself
+    for (uint32_t start = now_ms; tcp_active_pcbs != NULL && (now_ms - start) < STALL_MS; ) {
+        wire_step();
+    }
+}
+
+static bool client_write(uint32_t *offset) {
+    uint8_t buf[MESSAGE_SIZE];
+
+    for (uint i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)((*offset + i) % 251);
+    }
+
+    *offset += sizeof(buf);
+
+    return tcp_write(client, buf, sizeof(buf), TCP_WRITE_FLAG_COPY) == ERR_OK && tcp_output(client) == ERR_OK;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+// the same from run to run
+static uint32_t idle_random(void) {
+    idle_state ^= idle_state << 13;
+    idle_state ^= idle_state >> 17;
+    idle_state ^= idle_state << 5;
+
+    return idle_state;
+}
+
+// the rounds are apart by a random idle time of up to TCP_TMR_INTERVAL, so they start at
+// any phase of the fast timer and its wait is averaged. Back to back, a round would start
+// just after the tick that ended the last one and always wait the longest
+static void bench(const char *workload, u16_t port, uint in_flight, bool nagle, bool discard) {
+    uint32_t *rtt = calloc(rounds, sizeof(uint32_t));
+    uint32_t offset = 0;
+    bool stalled = false;
+
+    if (rtt == NULL || !client_open(port, nagle)) {
+        printf("%-11s %-9s connect failed\n", policy_names[server_policy], workload);
+        failures++;
+        free(rtt);
+
+        return;
+    }
+
+    uint32_t done = 0;
+
+    for (; done < rounds && !stalled; done++) {
+        uint32_t start = now_ms;
+
+        for (uint i = 0; i < in_flight; i++) {
+            if (!client_write(&offset)) {
+                failures++;
+            }
+        }
+
+        while ((discard ? acked : received) != offset) {
+            if ((now_ms - start) >= STALL_MS) {
+                stalled = true;
+                break;
+            }
+
+            wire_step();
+        }
+
+        rtt[done] = now_ms - start;
+
+        for (uint32_t idle = 1 + idle_random() % TCP_TMR_INTERVAL; idle > 0; idle--) {
+            wire_step();
+        }
+    }
+
+    client_close();
+
+    qsort(rtt, done, sizeof(uint32_t), compare_u32);
+
+    uint64_t sum = 0;
+
+    for (uint32_t i = 0; i < done; i++) {
+        sum += rtt[i];
+    }
+
+    printf("%-11s %-9s %4u rounds, rtt min/avg/p99/max %u/%.1f/%u/%u ms%s\n", policy_names[server_policy],
+        workload, done, done ? rtt[0] : 0, done ? (double)sum / done : 0.0, done ? rtt[(done * 99) / 100] : 0,
+        done ? rtt[done - 1] : 0, stalled ? ", STALLED" : "");
+
+    if (stalled) {
+        failures++;
+    }
+
+    free(rtt);
+}
+
+int main(int argc, char **argv) {
+    static const enum policy policies[] = { POLICY_THROUGHPUT, POLICY_LOW_LATENCY };
+
+    if (argc > 1) {
+        rounds = strtoul(argv[1], NULL, 0);
+    }
+
+    wire_init(WIRE_SIZE);
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    struct tcp_pcb *echo = tcp_new();
+
+    tcp_bind(echo, netif_ip_addr4(&netif_b), ECHO_PORT);
+    echo = tcp_listen(echo);
+    tcp_arg(echo, echo);
+    tcp_accept(echo, server_accept);
+
+    struct tcp_pcb *discard = tcp_new();
+
+    tcp_bind(discard, netif_ip_addr4(&netif_b), DISCARD_PORT);
+    discard = tcp_listen(discard);
+    tcp_accept(discard, server_accept);
+
+    for (uint i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        server_policy = policies[i];
+
+        bench("ping-pong", ECHO_PORT, 1, false, false);
+        bench("pipelined", ECHO_PORT, 2, false, false);
+        bench("discard", DISCARD_PORT, 2, true, true);
+    }
+
+    // a frame the wire dropped is a failure too
+    failures += wire_drops;
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
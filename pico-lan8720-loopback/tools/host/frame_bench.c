@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rmii_ethernet_crc.h"
+#include "rmii_ethernet_frame.h"
+
+// times the driver's frame logic on the host with synthetic frame streams: the FCS, the
+// end of frame search of RX, the 100M pre-encoding of TX and the magic packet match of
+// PICO_RMII_ETHERNET_WAKE. Every frame is checked on
+// the first pass, the exit status is 1 when one is wrong
+//
+// usage: rmii_frame_bench_table [ms per case, default 200]
+//
+// one line per case: FCS back-end, case, frame size (imix: 64, 594 and 1514 bytes 7:4:1),
+// good or bad FCS, then the time per frame and the rate over frames and FCS
+
+#define STREAM_FRAMES 256
+
+// a received frame as the RX DMA leaves it: frame, FCS and a few trailing bytes
+struct rx_frame {
+    uint8_t data[1518 + RMII_ETHERNET_FRAME_TRAILING_BYTES];
+    uint received;
+    uint length; // expected result of rmii_ethernet_frame_length()
+};
+
+static struct rx_frame stream[STREAM_FRAMES];
+static uint32_t words[RMII_ETHERNET_FRAME_FAST_WORDS];
+static uint failures = 0;
+static uint32_t bench_ms = 200;
+static volatile uint32_t sink;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// size 0 is the simple IMIX
+static uint frame_size(uint size, uint i) {
+    static const uint16_t imix[12] = { 64, 594, 64, 64, 594, 64, 1514, 64, 594, 64, 594, 64 };
+
+    return size ? size : imix[i % 12];
+}
+
+static void stream_fill(uint size, bool bad_fcs) {
+    srand(size + bad_fcs);
+
+    for (uint i = 0; i < STREAM_FRAMES; i++) {
+        struct rx_frame *f = &stream[i];
+        uint length = frame_size(size, i) - 4;
+
+        for (uint j = 0; j < length; j++) {
+            f->data[j] = rand();
+        }
+
+        uint32_t fcs = rmii_ethernet_crc32(f->data, length);
+
+        if (bad_fcs) {
+            fcs ^= 1u << (i % 32);
+        }
+
+        memcpy(f->data + length, &fcs, sizeof(fcs));
+
+        uint trailing = i % (RMII_ETHERNET_FRAME_TRAILING_BYTES + 1);
+
+        for (uint j = 0; j < trailing; j++) {
+            f->data[length + 4 + j] = rand();
+        }
+
+        f->received = length + 4 + trailing;
+        f->length = bad_fcs ? 0 : length;
+    }
+}
+
+static uint stream_bytes(void) {
+    uint bytes = 0;
+
+    for (uint i = 0; i < STREAM_FRAMES; i++) {
+        bytes += stream[i].length ? stream[i].length + 4 : stream[i].received;
+    }
+
+    return bytes;
+}
+
+static uint run_crc(bool check) {
+    uint32_t crc = 0;
+
+    for (uint i = 0; i < STREAM_FRAMES; i++) {
+        struct rx_frame *f = &stream[i];
+        uint32_t fcs = rmii_ethernet_crc32(f->data, f->received - (i % (RMII_ETHERNET_FRAME_TRAILING_BYTES + 1)) - 4);
+
+        if (check && f->length && memcmp(&fcs, f->data + f->length, 4) != 0) {
+            failures++;
+        }
+
+        crc ^= fcs;
+    }
+
+    return crc;
+}
+
+static uint run_rx_length(bool check) {
+    uint total = 0;
+
+    for (uint i = 0; i < STREAM_FRAMES; i++) {
+        uint length = rmii_ethernet_frame_length(stream[i].data, stream[i].received);
+
+        if (check && length != stream[i].length) {
+            failures++;
+        }
+
+        total += length;
+    }
+
+    return total;
+}
+
+// decodes the TX-EN, TX1, TX0 groups back to bytes
+static bool tx_decode_check(const struct rx_frame *f, uint32_t fcs, uint count) {
+    uint8_t bytes[8 + 1518 + 1];
+    uint n = 0;
+
+    for (uint w = 0; w < count; w++) {
+        for (int half = 0; half < 2; half++) {
+            uint32_t groups = words[w] >> (half * 12);
+
+            if ((groups & 0x924) == 0) {
+                continue; // second half of an odd last word, or the gap
+            }
+
+            uint8_t b = 0;
+
+            for (int dibit = 0; dibit < 4; dibit++) {
+                uint32_t g = (groups >> (dibit * 3)) & 0x7;
+
+                if (!(g & 0x4)) {
+                    return false;
+                }
+
+                b |= (g & 0x3) << (dibit * 2);
+            }
+
+            bytes[n++] = b;
+        }
+    }
+
+    return n == (8 + f->length + 4) &&
+        memcmp(bytes, "\x55\x55\x55\x55\x55\x55\x55\xd5", 8) == 0 &&
+        memcmp(bytes + 8, f->data, f->length) == 0 &&
+        memcmp(bytes + 8 + f->length, &fcs, 4) == 0;
+}
+
+// what netif_rmii_ethernet_tx_fast_build() does for a frame in one pbuf
+static uint run_tx_encode(bool check) {
+    uint total = 0;
+
+    for (uint i = 0; i < STREAM_FRAMES; i++) {
+        struct rx_frame *f = &stream[i];
+        struct rmii_ethernet_frame_encoder encoder;
+
+        rmii_ethernet_frame_encode_start(&encoder, words);
+
+        uint32_t crc = rmii_ethernet_crc32_update(RMII_ETHERNET_CRC32_INIT, f->data, f->length);
+
+        rmii_ethernet_frame_encode(&encoder, f->data, f->length);
+
+        crc = ~crc;
+
+        rmii_ethernet_frame_encode(&encoder, (const uint8_t *)&crc, sizeof(crc));
+
+        uint count = rmii_ethernet_frame_encode_end(&encoder);
+
+        if (check && !tx_decode_check(f, crc, count)) {
+            failures++;
+        }
+
+        total += count;
+    }
+
+    return total;
+}
+
+// planted in every 4th frame that has room for one, every 4th other one gets a magic
+// packet with the last MAC byte wrong
+static uint run_wake_magic(bool check) {
+    static const uint8_t mac[6] = { 0x02, 0x12, 0x34, 0x56, 0x78, 0x9a };
+    uint total = 0;
+
+    for (uint i = 0; i < STREAM_FRAMES; i++) {
+        struct rx_frame *f = &stream[i];
+        uint length = f->received - (i % (RMII_ETHERNET_FRAME_TRAILING_BYTES + 1)) - 4;
+        uint offset = 14 + 28 + (i % 8); // after IPv4 and UDP headers, not aligned
+        bool planted = (i % 4) == 0;
+
+        if (check && (i % 2) == 0 && (offset + 6 + 16 * 6) <= length) {
+            memset(f->data + offset, 0xff, 6);
+
+            for (uint j = 0; j < 16; j++) {
+                memcpy(f->data + offset + 6 + j * 6, mac, 6);
+            }
+
+            if (!planted) {
+                f->data[offset + 6 + 15 * 6 + 5] ^= 0x01;
+            }
+        } else {
+            planted = false;
+        }
+
+        bool magic = rmii_ethernet_frame_magic(f->data, length, mac);
+
+        if (check && magic != planted) {
+            failures++;
+        }
+
+        total += magic;
+    }
+
+    return total;
+}
+
+static void bench(const char *name, uint size, bool bad_fcs, uint (*run)(bool check)) {
+    stream_fill(size, bad_fcs);
+
+    sink = run(true);
+
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+    uint passes = 0;
+
+    do {
+        sink = run(false);
+        passes++;
+        elapsed = now_ns() - start;
+    } while (elapsed < bench_ms * 1000000ull);
+
+    double frames = (double)passes * STREAM_FRAMES;
+    double bytes = (double)passes * stream_bytes();
+
+    char frames_name[12];
+
+    if (size) {
+        snprintf(frames_name, sizeof(frames_name), "%u", size);
+    } else {
+        strcpy(frames_name, "imix");
+    }
+
+    printf("%-8s %-10s %-5s %-4s %10.1f ns/frame %8.1f Mbit/s\n", FRAME_BENCH_CRC, name, frames_name,
+        bad_fcs ? "bad" : "good", elapsed / frames, bytes * 8 * 1000 / elapsed);
+}
+
+int main(int argc, char **argv) {
+    static const uint sizes[] = { 64, 594, 1514, 0 };
+
+    if (argc > 1) {
+        bench_ms = strtoul(argv[1], NULL, 0);
+    }
+
+    rmii_ethernet_crc_init();
+    rmii_ethernet_frame_encoding_init();
+
+    for (uint i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench("crc32", sizes[i], false, run_crc);
+        bench("rx_length", sizes[i], false, run_rx_length);
+        bench("rx_length", sizes[i], true, run_rx_length);
+        bench("tx_encode", sizes[i], false, run_tx_encode);
+        bench("wake_magic", sizes[i], false, run_wake_magic);
+    }
+
+    if (failures) {
+        printf("%u frames wrong\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
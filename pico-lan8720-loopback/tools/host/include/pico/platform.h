@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_PLATFORM_H
+#define _PICO_PLATFORM_H
+
+// the part of the Pico SDK's pico/platform.h the generated fsdata uses, for host builds:
+// the files stay in the host's const data
+
+#define __in_flash(group)
+
+#endif
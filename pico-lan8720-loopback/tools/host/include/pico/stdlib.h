@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+// the part of the Pico SDK's pico/stdlib.h the shared net.h sources use, for host builds
+
+#include "pico/types.h"
+
+#endif
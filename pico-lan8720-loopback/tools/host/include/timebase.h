@@ -0,0 +1,16 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _TIMEBASE_H_
+#define _TIMEBASE_H_
+
+#include <stdint.h>
+
+// the part of timebase.h the shared coap.h sources and lwip_prober.c use, for host
+// builds: the bench gives the time, its virtual one
+uint32_t timebase_ms(void);
+
+uint32_t timebase_us(void);
+
+#endif
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/tcp.h"
+
+#include "lwip_lro.h"
+
+#include "bench_wire.h"
+
+// bulk TCP from an lwIP sender into a sink whose netif->input() is behind lwip_lro, as
+// the driver's is with PICO_RMII_ETHERNET_LRO. Each virtual ms the wire delivers what
+// was sent the ms before, the sink's frames in passes of a few, as the driver drains
+// its RX ring, with lwip_lro_flush() after each. The batch cases put each pass between
+// tcp_output_batch_begin() and _end(), as the driver does with LWIP_TCP_OUTPUT_BATCH.
+// One line per case: the goodput over virtual time, the data segments on the wire and
+// per ip4_input() of the sink, the sink's ACKs, and the host time the sink's side took
+// per data segment, lwip_lro, ip4_input(), tcp_input(), the receive callback and the
+// ACKs included. The exit status is 1 when data came out wrong, a case stalled or a
+// pbuf is left
+//
+// usage: lro_bench [MB per case, default 8]
+
+#define WIRE_SIZE 256
+
+// virtual ms without progress before a case is given up, past a backed off RTO: a loss
+// at the end of a window that no duplicate ACKs report waits for lwIP's 3 s one
+#define STALL_MS 10000
+
+#define SINK_PORT 9
+
+static struct lwip_lro lro;
+static struct tcp_pcb *client;
+static bool connected;
+static bool lro_on;
+static bool batch_on;
+static uint pass_frames;
+static uint32_t loss_ppm;
+static uint32_t loss_state = 1;
+static uint32_t bytes_total = 8u << 20;
+static uint32_t sent, received;
+static uint32_t data_segments, sink_inputs, sink_acks, lost;
+static uint64_t sink_ns;
+static uint failures;
+
+// xorshift32, enough for a loss pattern
+static uint32_t loss_random(void) {
+    loss_state ^= loss_state << 13;
+    loss_state ^= loss_state >> 17;
+    loss_state ^= loss_state << 5;
+
+    return loss_state;
+}
+
+// the TCP payload of a packet from the sender, 0 for anything else
+static u16_t wire_payload(struct pbuf *p) {
+    struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+    u16_t hlen = IPH_HL_BYTES(iphdr);
+
+    if (!ip4_addr_cmp(&iphdr->src, netif_ip4_addr(&netif_a)) || IPH_PROTO(iphdr) != IP_PROTO_TCP) {
+        return 0;
+    }
+
+    struct tcp_hdr *tcphdr = (struct tcp_hdr *)((u8_t *)p->payload + hlen);
+
+    return lwip_ntohs(IPH_LEN(iphdr)) - hlen - TCPH_HDRLEN_BYTES(tcphdr);
+}
+
+// only data is lost, the handshakes and the ACKs get through
+static bool wire_loss(struct pbuf *p, const ip4_addr_t *ipaddr) {
+    if (wire_payload(p) != 0) {
+        if (loss_ppm && (loss_random() % 1000000) < loss_ppm) {
+            lost++;
+
+            return false;
+        }
+
+        data_segments++;
+    } else if (ip4_addr_cmp(ipaddr, netif_ip4_addr(&netif_a))) {
+        sink_acks++;
+    }
+
+    return true;
+}
+
+// the sink's netif->input()
+static err_t sink_input(struct pbuf *p, struct netif *inp) {
+    sink_inputs++;
+
+    return ip4_input(p, inp);
+}
+
+static void sink_deliver(struct pbuf *p) {
+    err_t err = lro_on ? lwip_lro_input(&lro, p, &netif_b) : netif_b.input(p, &netif_b);
+
+    if (err != ERR_OK) {
+        pbuf_free(p);
+    }
+}
+
+// one ms passes, then what was sent before it arrives: the sender's ACKs, then the
+// sink's frames pass_frames at a time, timed
+static void wire_passes(void) {
+    static struct pbuf *frames[WIRE_SIZE];
+    struct netif *netif = NULL;
+    uint32_t count = wire_pending(), n = 0;
+    uint pass = 0;
+
+    now_ms++;
+    sys_check_timeouts();
+
+    for (; count > 0; count--) {
+        struct pbuf *p = wire_take(&netif);
+
+        if (netif == &netif_a) {
+            ip4_input(p, netif);
+        } else {
+            frames[n++] = p;
+        }
+    }
+
+    uint64_t start = now_ns();
+
+    if (batch_on) {
+        tcp_output_batch_begin();
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        sink_deliver(frames[i]);
+
+        if (++pass == pass_frames) {
+            if (lro_on) {
+                lwip_lro_flush(&lro, &netif_b);
+            }
+            if (batch_on) {
+                tcp_output_batch_end();
+                tcp_output_batch_begin();
+            }
+            pass = 0;
+        }
+    }
+
+    if (lro_on) {
+        lwip_lro_flush(&lro, &netif_b);
+    }
+    if (batch_on) {
+        tcp_output_batch_end();
+    }
+
+    sink_ns += now_ns() - start;
+}
+
+// every byte is its offset in the stream, mod 251
+static err_t sink_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        tcp_close(pcb);
+
+        return ERR_OK;
+    }
+
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        for (u16_t i = 0; i < q->len; i++) {
+            if (((uint8_t *)q->payload)[i] != (uint8_t)(received++ % 251)) {
+                failures++;
+            }
+        }
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    return ERR_OK;
+}
+
+static err_t sink_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    tcp_recv(pcb, sink_recv);
+
+    return ERR_OK;
+}
+
+static err_t client_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(err);
+
+    connected = true;
+
+    return ERR_OK;
+}
+
+// PSH only on the last write of each fill, as a bulk sender sets it when its buffer runs dry
+static void client_fill(void) {
+    uint8_t buf[TCP_MSS];
+
+    while (sent < bytes_total && tcp_sndbuf(client) != 0) {
+        u16_t len = LWIP_MIN(LWIP_MIN(tcp_sndbuf(client), sizeof(buf)), bytes_total - sent);
+        bool more = tcp_sndbuf(client) > len && (bytes_total - sent) > len;
+
+        for (u16_t i = 0; i < len; i++) {
+            buf[i] = (uint8_t)((sent + i) % 251);
+        }
+
+        if (tcp_write(client, buf, len, TCP_WRITE_FLAG_COPY | (more ? TCP_WRITE_FLAG_MORE : 0)) != ERR_OK) {
+            break;
+        }
+
+        sent += len;
+    }
+
+    tcp_output(client);
+}
+
+static void bench(const char *name, bool use_lro, bool use_batch, uint pass, double loss) {
+    lro_on = use_lro;
+    batch_on = use_batch;
+    pass_frames = pass;
+    loss_ppm = (uint32_t)(loss * 10000);
+    sent = received = 0;
+    data_segments = sink_inputs = sink_acks = lost = 0;
+    sink_ns = 0;
+    lwip_lro_init(&lro, 0);
+
+    client = tcp_new();
+    connected = false;
+    tcp_bind(client, netif_ip_addr4(&netif_a), 0);
+    tcp_connect(client, netif_ip_addr4(&netif_b), SINK_PORT, client_connected);
+
+    for (uint32_t start = now_ms; !connected && (now_ms - start) < STALL_MS; ) {
+        wire_passes();
+    }
+
+    if (!connected) {
+        printf("%-8s connect failed\n", name);
+        failures++;
+
+        return;
+    }
+
+    uint32_t start = now_ms, progress = now_ms, last = 0;
+    uint32_t inputs = sink_inputs, acks = sink_acks;
+    bool stalled = false;
+
+    while (received < bytes_total) {
+        client_fill();
+        wire_passes();
+
+        if (received != last) {
+            last = received;
+            progress = now_ms;
+        } else if ((now_ms - progress) >= STALL_MS) {
+            stalled = true;
+            break;
+        }
+    }
+
+    uint32_t elapsed_ms = now_ms - start;
+
+    inputs = sink_inputs - inputs;
+    acks = sink_acks - acks;
+
+    tcp_close(client);
+
+    // both ends closed before the next case, TIME_WAIT is left to itself
+    for (uint32_t close = now_ms; tcp_active_pcbs != NULL && (now_ms - close) < STALL_MS; ) {
+        wire_passes();
+    }
+
+    printf("%-8s pass %u, loss %.0f%%: %5.1f Mbit/s, %6u segs (%4u lost), %4.2f segs/input, %5u ACKs, sink %4.0f ns/seg, %u merged in %u chains%s\n",
+        name, pass, loss, elapsed_ms ? (double)bytes_total * 8 / elapsed_ms / 1000 : 0.0, (uint)data_segments,
+        (uint)lost, inputs ? (double)data_segments / inputs : 0.0, (uint)acks,
+        data_segments ? (double)sink_ns / data_segments : 0.0, (uint)lro.merged, (uint)lro.chains,
+        stalled ? ", STALLED" : "");
+
+    if (stalled) {
+        failures++;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        bytes_total = strtoul(argv[1], NULL, 0) << 20;
+    }
+
+    wire_init(WIRE_SIZE);
+    wire_tap = wire_loss;
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, sink_input);
+
+    struct tcp_pcb *sink = tcp_new();
+
+    tcp_bind(sink, netif_ip_addr4(&netif_b), SINK_PORT);
+    sink = tcp_listen(sink);
+    tcp_accept(sink, sink_accept);
+
+    bench("off", false, false, 4, 0);
+    bench("lro", true, false, 4, 0);
+    bench("lro", true, false, 8, 0);
+    bench("batch", false, true, 4, 0);
+    bench("batch", false, true, 8, 0);
+    bench("both", true, true, 8, 0);
+    bench("off", false, false, 4, 1);
+    bench("lro", true, false, 4, 1);
+    bench("lro", true, false, 8, 1);
+    bench("batch", false, true, 4, 1);
+    bench("batch", false, true, 8, 1);
+    bench("both", true, true, 8, 1);
+
+    // all the pbufs the wire and lwip_lro held are back
+    if (MEMP_STATS && lwip_stats.memp[MEMP_PBUF_POOL]->used != 0) {
+        printf("%u pool pbufs left\n", (uint)lwip_stats.memp[MEMP_PBUF_POOL]->used);
+        failures++;
+    }
+
+    // a frame the wire dropped is a failure too
+    failures += wire_drops;
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
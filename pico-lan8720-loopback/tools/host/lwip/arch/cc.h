@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HOST_CC_H_
+#define _HOST_CC_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../../../src/lwip/arch/cc.h"
+
+/* fail the run instead of spinning */
+#undef LWIP_PLATFORM_ASSERT
+#define LWIP_PLATFORM_ASSERT(x) do { printf("lwIP assert: %s at %s:%d\n", x, __FILE__, __LINE__); abort(); } while (0)
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HOST_LWIPOPTS_H_
+#define _HOST_LWIPOPTS_H_
+
+/* the firmware's lwipopts.h, with what a 64-bit host needs on top */
+#include "../../../src/lwip/lwipopts.h"
+
+/* pointers in the pools and the heap are 8 bytes */
+#undef MEM_ALIGNMENT
+#define MEM_ALIGNMENT                   8
+
+/* ip6_frag.c keeps a pointer in the fragment header, too small for 8 bytes */
+#undef IPV6_FRAG_COPYHEADER
+#define IPV6_FRAG_COPYHEADER            1
+
+/* the counters lwip_perf reports */
+#undef LWIP_STATS
+#define LWIP_STATS                      1
+#undef MEM_STATS
+#define MEM_STATS                       1
+#undef MEMP_STATS
+#define MEMP_STATS                      1
+#undef TCP_STATS
+#define TCP_STATS                       1
+/* names of the pools in the stats */
+#undef LWIP_STATS_DISPLAY
+#define LWIP_STATS_DISPLAY              1
+
+/* tcp_demux_bench: both ends of LWIP_HOST_CONNECTIONS connections and their segments, in
+   a table of the firmware's largest size, so the pcbs share buckets as they do there */
+#ifdef LWIP_HOST_CONNECTIONS
+#undef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB                (2 * LWIP_HOST_CONNECTIONS)
+#undef TCP_PCB_HASH_SIZE
+#define TCP_PCB_HASH_SIZE               16
+#undef MEMP_NUM_TCP_SEG
+#define MEMP_NUM_TCP_SEG                (4 * LWIP_HOST_CONNECTIONS)
+#undef PBUF_POOL_SIZE
+#define PBUF_POOL_SIZE                  (8 * LWIP_HOST_CONNECTIONS)
+#undef MEM_SIZE
+#define MEM_SIZE                        (1024 * 1024)
+#endif
+
+/* udp_demux_bench: LWIP_HOST_UDP_PCBS echo pcbs, a bucket each, and the datagrams of a
+   round. SO_REUSE for the pcbs sharing a port of its checks */
+#ifdef LWIP_HOST_UDP_PCBS
+#undef MEMP_NUM_UDP_PCB
+#define MEMP_NUM_UDP_PCB                (LWIP_HOST_UDP_PCBS + 8)
+#undef UDP_PCB_HASH_SIZE
+#define UDP_PCB_HASH_SIZE               LWIP_HOST_UDP_PCBS
+#undef PBUF_POOL_SIZE
+#define PBUF_POOL_SIZE                  (4 * LWIP_HOST_UDP_PCBS)
+#undef SO_REUSE
+#define SO_REUSE                        1
+#endif
+
+/* conn_rate_bench: initial sequence numbers from a 4 us clock of the virtual time, as
+   RFC 793 and a PC's stack, so a new connection on the ports of an old one starts above
+   the old one's sequence space. lwIP's own adds the slow timer's ticks */
+#ifdef CONN_RATE_BENCH_NAME
+unsigned int conn_rate_bench_isn(void);
+#define LWIP_HOOK_TCP_ISN(local_ip, local_port, remote_ip, remote_port) conn_rate_bench_isn()
+#endif
+
+/* tcp_mem_bench: both ends of its four connections and the listeners, the pools stay the
+   profile's */
+#ifdef TCP_MEM_BENCH
+#undef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB                12
+#endif
+
+/* uplink_bench: both ends of its eight connections. The remote host is a netif of the
+   same stack on the device's subnet, its packets are routed to it ahead of the device's */
+#ifdef UPLINK_BENCH
+#undef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB                20
+#undef LWIP_HOOK_IP4_ROUTE_SRC
+struct ip4_addr;
+struct netif *uplink_bench_route(const struct ip4_addr *src, const struct ip4_addr *dest);
+#define LWIP_HOOK_IP4_ROUTE_SRC(src, dest) uplink_bench_route(src, dest)
+#endif
+
+/* nd6_bench_list: lwIP's own neighbour and destination cache sizes */
+#ifdef ND6_BENCH_STOCK_CACHES
+#undef LWIP_ND6_NUM_NEIGHBORS
+#define LWIP_ND6_NUM_NEIGHBORS          10
+#undef LWIP_ND6_NUM_DESTINATIONS
+#define LWIP_ND6_NUM_DESTINATIONS       10
+#endif
+
+/* coap_bench: httpd without the firmware's WebSocket and POST hooks, both ends of its 32
+   HTTP pollers and the server's TIME_WAITs with the segments and by-reference pbufs of
+   their requests and responses, a UDP pcb per CoAP poller, and the wire's copies of a
+   packet from each */
+#ifdef COAP_BENCH
+#undef LWIP_HTTPD_WEBSOCKET
+#define LWIP_HTTPD_WEBSOCKET            0
+#undef LWIP_HTTPD_SUPPORT_POST
+#define LWIP_HTTPD_SUPPORT_POST         0
+#undef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB                96
+#undef MEMP_NUM_TCP_SEG
+#define MEMP_NUM_TCP_SEG                256
+#undef MEMP_NUM_PBUF
+#define MEMP_NUM_PBUF                   256
+#undef MEMP_NUM_UDP_PCB
+#define MEMP_NUM_UDP_PCB                40
+#undef PBUF_POOL_SIZE
+#define PBUF_POOL_SIZE                  256
+#undef MEM_SIZE
+#define MEM_SIZE                        (256 * 1024)
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* the firmware's pools of PICO_LWIP_MEM_ALLOCATOR_POOLS, memp_std.h includes it once
+   per expansion of LWIP_MEMPOOL */
+#include "../../../src/lwip/lwippools.h"
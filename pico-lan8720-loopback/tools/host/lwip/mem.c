@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* lwIP's mem.c with mem_malloc() counting the heap allocations for lwip_perf */
+#include "lwip/opt.h"
+#include "lwip/mem.h"
+
+/* mem_clib_malloc() and the others with PICO_LWIP_MEM_ALLOCATOR_TLSF */
+#if PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_TLSF
+#include "../../../src/lwip/lwip_tlsf.h"
+#endif
+
+#define mem_malloc lwip_mem_malloc
+#include "../../../lib/lwip/src/core/mem.c"
+#undef mem_malloc
+
+u32_t lwip_perf_mem_allocs;
+
+void *mem_malloc(mem_size_t size)
+{
+  lwip_perf_mem_allocs++;
+
+  return lwip_mem_malloc(size);
+}
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* lwIP's memp.c with memp_malloc() counting the allocations of each pool for lwip_perf */
+#include "lwip/opt.h"
+#include "lwip/memp.h"
+
+#define memp_malloc lwip_memp_malloc
+#include "../../../lib/lwip/src/core/memp.c"
+#undef memp_malloc
+
+u32_t lwip_perf_memp_allocs[MEMP_MAX];
+
+void *memp_malloc(memp_t type)
+{
+  lwip_perf_memp_allocs[type]++;
+
+  return lwip_memp_malloc(type);
+}
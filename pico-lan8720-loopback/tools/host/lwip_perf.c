@@ -0,0 +1,595 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/memp.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+#include "lwip/priv/tcp_priv.h"
+
+#include "bench_wire.h"
+
+// pushes bulk TCP, TCP echo and UDP echo traffic through lwIP built with the firmware's
+// lwipopts.h (and PICO_LWIP_PROFILE), between two netifs joined by a wire that copies
+// every packet into a PBUF_POOL pbuf as the RMII driver does on RX. Reports the segments
+// per second of host time, the pool and heap allocations per segment and the peak use of
+// each memp pool, so option changes show up before they are flashed. The exit status is
+// 1 when data came back wrong, a transfer stalled or memory was left allocated
+//
+// usage: lwip_perf_balanced [MB per scenario, default 16] [loss %, default 0] [RTT ms, default 0]
+//
+// With a loss rate the wire drops that share of the packets in both directions while
+// data flows, at random but the same from run to run (handshakes and closes get through,
+// a lost SYN costs lwIP's 3 s initial RTO and says nothing about the profile). The wire
+// then also runs at 100 Mbit/s, what a link_run() delivers in its ms is capped, and each
+// line adds the goodput over virtual time, so retransmission timeouts and window stalls
+// count and host speed doesn't. "lwip_perf_high_loss 4 0" is the lossless reference
+//
+// With an RTT the wire holds every packet for half of it in each direction, outside of
+// lwIP's memory, and copies it into the pool when it arrives. The client stands in for a
+// remote host: its send buffer and slow start threshold are what the segment pool allows,
+// so the server's receive window (reported as rcv wnd) sets the bulk goodput.
+// lwip_perf_balanced_autotune is built with LWIP_TCP_RCV_AUTOTUNE, "4 0 20" compares the
+// two at a 20 ms round trip
+
+extern u32_t lwip_perf_memp_allocs[MEMP_MAX];
+extern u32_t lwip_perf_mem_allocs;
+
+#define WIRE_SIZE 256
+
+// bytes per ms of 100BASE-TX, and the Ethernet header, FCS, preamble and gap of a frame
+#define WIRE_BYTES_PER_MS 12500
+#define WIRE_FRAME_OVERHEAD 38
+
+// virtual ms without progress before a scenario is given up
+#define STALL_MS 10000
+
+struct link_packet {
+    struct pbuf *p;
+    struct netif *netif; // receiving side
+    uint8_t *data;       // with an RTT: the packet, until it arrives
+    uint16_t len;
+    uint32_t due;        // virtual ms it arrives
+};
+
+static struct link_packet link_ring[WIRE_SIZE];
+static uint32_t link_head, link_tail;
+static uint32_t wire_lost;
+static uint32_t loss_ppm;
+static bool loss_on, loss_report;
+static uint32_t loss_state = 1;
+static uint32_t wire_delay_ms;
+
+static uint failures;
+
+// xorshift32, enough for a loss pattern
+static uint32_t loss_random(void) {
+    loss_state ^= loss_state << 13;
+    loss_state ^= loss_state >> 17;
+    loss_state ^= loss_state << 5;
+
+    return loss_state;
+}
+
+static err_t link_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(netif);
+
+    if (loss_on && (loss_random() % 1000000) < loss_ppm) {
+        wire_lost++;
+
+        return ERR_OK;
+    }
+
+    struct link_packet *w = &link_ring[link_head % WIRE_SIZE];
+
+    // both addresses are in one subnet, lwIP routes through either netif
+    w->netif = ip4_addr_cmp(ipaddr, netif_ip4_addr(&netif_a)) ? &netif_a : &netif_b;
+
+    if (wire_delay_ms) {
+        // on the way, the pool is only taken when it arrives
+        w->data = (link_head - link_tail) < WIRE_SIZE ? malloc(p->tot_len) : NULL;
+
+        if (w->data == NULL) {
+            wire_drops++;
+
+            return ERR_OK;
+        }
+
+        pbuf_copy_partial(p, w->data, p->tot_len, 0);
+        w->len = p->tot_len;
+        w->due = now_ms + wire_delay_ms;
+        link_head++;
+        wire_packets++;
+
+        return ERR_OK;
+    }
+
+    // what the receiving driver does: one pool pbuf (chain) per frame, dropped without one
+    struct pbuf *q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_POOL);
+
+    if (q == NULL || (link_head - link_tail) == WIRE_SIZE) {
+        if (q != NULL) {
+            pbuf_free(q);
+        }
+
+        wire_drops++;
+
+        return ERR_OK;
+    }
+
+    pbuf_copy(q, p);
+
+    w->p = q;
+    link_head++;
+    wire_packets++;
+
+    return ERR_OK;
+}
+
+// delivers everything on the wire, including what the deliveries send (a ms of it at
+// 100 Mbit/s with a loss rate, only what has arrived with an RTT), then one ms passes
+static void link_run(void) {
+    uint32_t budget = WIRE_BYTES_PER_MS;
+
+    while (link_tail != link_head && (!loss_report || budget != 0)) {
+        struct link_packet *w = &link_ring[link_tail % WIRE_SIZE];
+
+        if (wire_delay_ms && (int32_t)(w->due - now_ms) > 0) {
+            break;
+        }
+
+        uint32_t bytes = (wire_delay_ms ? w->len : w->p->tot_len) + WIRE_FRAME_OVERHEAD;
+
+        budget = (bytes < budget) ? budget - bytes : 0;
+        link_tail++;
+
+        if (wire_delay_ms) {
+            struct pbuf *q = pbuf_alloc(PBUF_RAW, w->len, PBUF_POOL);
+
+            if (q != NULL) {
+                pbuf_take(q, w->data, w->len);
+            } else {
+                wire_drops++;
+            }
+
+            free(w->data);
+
+            if (q == NULL) {
+                continue;
+            }
+
+            w->p = q;
+        }
+
+        ip4_input(w->p, w->netif);
+    }
+
+    now_ms++;
+    sys_check_timeouts();
+}
+
+static uint8_t pattern(uint32_t offset) {
+    return (uint8_t)(offset * 7 + (offset >> 8));
+}
+
+// one side of a TCP transfer
+struct peer {
+    struct tcp_pcb *pcb;
+    uint32_t total;    // bytes to send, 0 to only receive
+    uint32_t sent;
+    uint32_t received;
+    uint16_t message;  // echo message size, 0 to write as much as fits
+    bool echo;         // server writes back what it receives
+    bool check;        // received bytes follow pattern()
+};
+
+static struct peer client, server;
+
+static void peer_send(struct peer *peer) {
+    uint8_t buf[TCP_MSS];
+    bool written = false;
+
+    while (peer->pcb != NULL && peer->sent < peer->total) {
+        uint16_t len = peer->message ? peer->message : TCP_MSS;
+
+        if (peer->message && (peer->sent - peer->received) >= peer->message) {
+            break; // echo: one message in flight
+        }
+
+        if (len > peer->total - peer->sent) {
+            len = peer->total - peer->sent;
+        }
+
+        if (tcp_sndbuf(peer->pcb) < len || tcp_sndqueuelen(peer->pcb) >= TCP_SND_QUEUELEN) {
+            break;
+        }
+
+        for (uint16_t i = 0; i < len; i++) {
+            buf[i] = pattern(peer->sent + i);
+        }
+
+        if (tcp_write(peer->pcb, buf, len, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            break;
+        }
+
+        peer->sent += len;
+        written = true;
+    }
+
+    if (written) {
+        tcp_output(peer->pcb);
+    }
+}
+
+static err_t peer_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    struct peer *peer = arg;
+
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        tcp_close(pcb);
+        peer->pcb = NULL;
+
+        return ERR_OK;
+    }
+
+    if (peer->check) {
+        for (struct pbuf *q = p; q != NULL; q = q->next) {
+            for (u16_t i = 0; i < q->len; i++) {
+                if (((uint8_t *)q->payload)[i] != pattern(peer->received + i)) {
+                    failures++;
+                    break;
+                }
+            }
+
+            peer->received += q->len;
+        }
+    } else {
+        peer->received += p->tot_len;
+    }
+
+    if (peer->echo) {
+        // written back whole or not at all, the client keeps one message in flight
+        for (struct pbuf *q = p; q != NULL; q = q->next) {
+            if (tcp_write(pcb, q->payload, q->len, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+                failures++;
+            }
+        }
+
+        tcp_output(pcb);
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    return ERR_OK;
+}
+
+static err_t peer_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(len);
+
+    peer_send(arg);
+
+    return ERR_OK;
+}
+
+static err_t server_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    server.pcb = pcb;
+
+    tcp_arg(pcb, &server);
+    tcp_recv(pcb, peer_recv);
+    tcp_nagle_disable(pcb);
+
+    tcp_close(arg); // the listener, one connection per scenario
+
+    return ERR_OK;
+}
+
+static err_t client_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(err);
+
+    loss_on = loss_ppm != 0;
+
+    peer_send(arg);
+
+    return ERR_OK;
+}
+
+static void counters_reset(void) {
+    memset(lwip_perf_memp_allocs, 0, sizeof(lwip_perf_memp_allocs));
+    lwip_perf_mem_allocs = 0;
+    wire_packets = 0;
+    wire_drops = 0;
+    wire_lost = 0;
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        lwip_stats.memp[i]->max = lwip_stats.memp[i]->used;
+    }
+
+    lwip_stats.mem.max = lwip_stats.mem.used;
+    lwip_stats.tcp.memerr = 0;
+}
+
+static uint32_t allocs_total(void) {
+    uint32_t allocs = lwip_perf_mem_allocs;
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        allocs += lwip_perf_memp_allocs[i];
+    }
+
+    return allocs;
+}
+
+static void report(const char *name, uint32_t bytes, uint64_t elapsed_ns, uint32_t elapsed_ms, bool stalled) {
+    uint32_t allocs = allocs_total();
+
+    printf("%-8s %-10s %8u seg %10.0f seg/s %7.1f Mbit/s %5.2f alloc/seg (", LWIP_PERF_PROFILE, name,
+        wire_packets, wire_packets * 1e9 / elapsed_ns, bytes * 8e3 / elapsed_ns,
+        wire_packets ? (double)allocs / wire_packets : 0.0);
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        if (lwip_perf_memp_allocs[i]) {
+            printf(" %s %.2f", lwip_stats.memp[i]->name, (double)lwip_perf_memp_allocs[i] / wire_packets);
+        }
+    }
+
+    printf(" HEAP %.2f) peak", (double)lwip_perf_mem_allocs / wire_packets);
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        if (lwip_stats.memp[i]->max) {
+            printf(" %s %lu/%lu", lwip_stats.memp[i]->name, (unsigned long)lwip_stats.memp[i]->max,
+                (unsigned long)lwip_stats.memp[i]->avail);
+        }
+    }
+
+    printf(" HEAP %u/%u, %u drop %u tcp memerr", (unsigned)lwip_stats.mem.max, (unsigned)lwip_stats.mem.avail,
+        wire_drops, lwip_stats.tcp.memerr);
+
+    if (loss_report) {
+        printf(", %u lost, goodput %.1f Mbit/s over %u virtual ms", wire_lost,
+            elapsed_ms ? bytes * 8e-3 / elapsed_ms : 0.0, elapsed_ms);
+    }
+
+    if (wire_delay_ms && server.pcb != NULL) {
+        printf(", rcv wnd %u", (unsigned)TCP_WND_MAX(server.pcb));
+    }
+
+    printf("%s\n", stalled ? ", STALLED" : "");
+
+    if (stalled) {
+        failures++;
+    }
+}
+
+// client on netif_a sends to the server on netif_b, which discards or echoes
+static void run_tcp(const char *name, uint32_t total, uint16_t message) {
+    memset(&client, 0, sizeof(client));
+    memset(&server, 0, sizeof(server));
+
+    client.total = total;
+    client.message = message;
+    client.check = message != 0;
+
+    server.echo = message != 0;
+    server.check = message == 0;
+
+    struct tcp_pcb *listener = tcp_new();
+
+    tcp_bind(listener, netif_ip_addr4(&netif_b), 5000);
+    listener = tcp_listen(listener);
+    tcp_arg(listener, listener);
+    tcp_accept(listener, server_accept);
+
+    counters_reset();
+
+    client.pcb = tcp_new();
+    tcp_arg(client.pcb, &client);
+    tcp_recv(client.pcb, peer_recv);
+    tcp_sent(client.pcb, peer_sent);
+    tcp_nagle_disable(client.pcb);
+    tcp_bind(client.pcb, netif_ip_addr4(&netif_a), 0);
+
+    if (wire_delay_ms) {
+        client.pcb->snd_buf = (tcpwnd_size_t)(TCP_SND_QUEUELEN * TCP_MSS);
+        client.pcb->ssthresh = client.pcb->snd_buf;
+    }
+
+    uint64_t start = now_ns();
+    uint32_t start_ms = now_ms;
+    uint32_t progress_ms = now_ms;
+    uint32_t last = 0;
+
+    tcp_connect(client.pcb, netif_ip_addr4(&netif_b), 5000, client_connected);
+
+    while ((message ? client.received : server.received) < total) {
+        link_run();
+        peer_send(&client);
+
+        uint32_t done = message ? client.received : server.received;
+
+        if (done != last) {
+            last = done;
+            progress_ms = now_ms;
+        } else if ((now_ms - progress_ms) > STALL_MS) {
+            break;
+        }
+    }
+
+    uint64_t elapsed = now_ns() - start;
+
+    loss_on = false;
+
+    report(name, message ? client.received * 2 : server.received, elapsed, now_ms - start_ms,
+        (message ? client.received : server.received) < total);
+
+    // close both ends and let TIME_WAIT expire, so the next scenario starts empty
+    if (client.pcb != NULL) {
+        tcp_close(client.pcb);
+        client.pcb = NULL;
+    }
+
+    for (uint32_t ms = 0; ms < 2 * TCP_MSL + 1000; ms++) {
+        link_run();
+    }
+}
+
+static uint32_t udp_received;
+
+static void udp_echo_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    LWIP_UNUSED_ARG(arg);
+
+    // the pbuf goes back out as it is, with the headers prepended again. Each bound pcb
+    // sends from its own netif, routing would pick the same one for both addresses
+    udp_sendto_if(pcb, p, addr, port, &netif_b);
+    pbuf_free(p);
+}
+
+static void udp_client_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(addr);
+    LWIP_UNUSED_ARG(port);
+
+    udp_received += p->tot_len;
+    pbuf_free(p);
+}
+
+// client datagrams from netif_a echoed by a server on netif_b, a few in flight
+static void run_udp(const char *name, uint32_t total, uint16_t size) {
+    struct udp_pcb *echo = udp_new();
+    struct udp_pcb *client_pcb = udp_new();
+
+    udp_bind(echo, netif_ip_addr4(&netif_b), 5007);
+    udp_recv(echo, udp_echo_recv, NULL);
+    udp_bind(client_pcb, netif_ip_addr4(&netif_a), 0);
+    udp_recv(client_pcb, udp_client_recv, NULL);
+
+    counters_reset();
+    udp_received = 0;
+
+    uint64_t start = now_ns();
+    uint32_t start_ms = now_ms;
+    uint32_t sent = 0;
+
+    loss_on = loss_ppm != 0;
+
+    while (sent < total) {
+        for (int i = 0; i < 4 && sent < total; i++) {
+            struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, size, PBUF_RAM);
+
+            if (p == NULL) {
+                break;
+            }
+
+            memset(p->payload, 0x5a, size);
+            udp_sendto_if(client_pcb, p, netif_ip_addr4(&netif_b), 5007, &netif_a);
+            pbuf_free(p);
+
+            sent += size;
+        }
+
+        link_run();
+    }
+
+    // the echoes still on the way
+    for (uint32_t ms = 0; ms <= 2 * wire_delay_ms; ms++) {
+        link_run();
+    }
+
+    uint64_t elapsed = now_ns() - start;
+
+    loss_on = false;
+
+    report(name, udp_received * 2, elapsed, now_ms - start_ms, false);
+
+    if (udp_received + (wire_drops + wire_lost) * size < total) {
+        failures++;
+    }
+
+    udp_remove(echo);
+    udp_remove(client_pcb);
+}
+
+int main(int argc, char **argv) {
+    uint32_t total = 16u << 20;
+
+    if (argc > 1) {
+        total = strtoul(argv[1], NULL, 0) << 20;
+    }
+
+    if (argc > 2) {
+        loss_ppm = (uint32_t)(strtod(argv[2], NULL) * 10000);
+        loss_report = true;
+    }
+
+    if (argc > 3) {
+        wire_delay_ms = strtoul(argv[3], NULL, 0) / 2;
+    }
+
+    wire_netif_output = link_output;
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    mem_size_t heap_used = lwip_stats.mem.used;
+    mem_size_t memp_used[MEMP_MAX];
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        memp_used[i] = lwip_stats.memp[i]->used;
+    }
+
+    run_tcp("tcp_bulk", total, 0);
+    run_tcp("tcp_echo", total / 16, 512);
+    run_udp("udp_echo", total / 4, 1472);
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        if (lwip_stats.memp[i]->used != memp_used[i]) {
+            printf("%s: %lu left allocated\n", lwip_stats.memp[i]->name,
+                (unsigned long)(lwip_stats.memp[i]->used - memp_used[i]));
+            failures++;
+        }
+    }
+
+    if (lwip_stats.mem.used != heap_used) {
+        printf("HEAP: %u bytes left allocated\n", (unsigned)(lwip_stats.mem.used - heap_used));
+        failures++;
+    }
+
+#if LWIP_TCP_RCV_AUTOTUNE
+    if (tcp_rcv_autotune_used != 0) {
+        printf("TCP: %u bytes of receive window budget not returned\n", (unsigned)tcp_rcv_autotune_used);
+        failures++;
+    }
+#endif
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/inet_chksum.h"
+#include "lwip/ip.h"
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/timeouts.h"
+#include "lwip/apps/mdns.h"
+#include "lwip/prot/dns.h"
+#include "lwip/prot/iana.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
+
+#include "bench_wire.h"
+
+// lwIP's mDNS responder with an HTTP and an echo service, queried by browsers on the
+// wire. Built once as stock lwIP (every response written record by record) and once with
+// MDNS_RESP_CACHE. Four cases, a query each virtual interval:
+//   browse 1 s      PTR _http._tcp.local, multicast, as a browser that polls every second
+//   browse 100 ms   the same from 10 browsers out of step, 100 ms apart
+//   host QU         A pico-rmii.local asking for a unicast reply, 10 ms apart
+//   address change  the netif's address changes between two host queries
+// One line per case: the responses and their bytes, and the host time lwIP took per
+// query. Every response of a case must be byte for byte the first one, and the one after
+// the address change must carry the new address. The exit status is 1 when one doesn't
+// or a pbuf is left
+//
+// usage: mdns_bench_cache [queries per case, default 20000]
+
+#define HOST_NAME "pico-rmii"
+
+static struct netif netif;
+static uint failures;
+static uint32_t queries = 20000;
+
+// the responses of the case going on
+static struct {
+    uint32_t count;
+    uint32_t bytes;
+    uint32_t unicast;
+    uint32_t differ;
+    u16_t first_len;
+    u8_t first[1500];
+    u16_t last_len;
+    u8_t last[1500];
+} responses;
+
+// the UDP payload of what the responder sends, compared with the case's first
+static err_t bench_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(netif);
+
+    struct ip_hdr iphdr;
+
+    pbuf_copy_partial(p, &iphdr, sizeof(iphdr), 0);
+    if (IPH_PROTO(&iphdr) != IP_PROTO_UDP) {
+        return ERR_OK;
+    }
+
+    u16_t offset = IPH_HL_BYTES(&iphdr) + UDP_HLEN;
+    u16_t len = p->tot_len - offset;
+
+    responses.last_len = pbuf_copy_partial(p, responses.last, LWIP_MIN(len, sizeof(responses.last)), offset);
+    if (responses.count == 0) {
+        memcpy(responses.first, responses.last, responses.last_len);
+        responses.first_len = responses.last_len;
+    } else if (responses.last_len != responses.first_len || memcmp(responses.first, responses.last, responses.last_len) != 0) {
+        responses.differ++;
+    }
+
+    responses.count++;
+    responses.bytes += len;
+    if (!ip4_addr_ismulticast(ipaddr)) {
+        responses.unicast++;
+    }
+
+    return ERR_OK;
+}
+
+static err_t bench_netif_init(struct netif *netif) {
+    netif->name[0] = 'b';
+    netif->name[1] = 'n';
+    netif->output = bench_output;
+    netif->mtu = 1500;
+    netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_IGMP | NETIF_FLAG_LINK_UP;
+
+    return ERR_OK;
+}
+
+// appends a name of dot separated labels in DNS form
+static u16_t put_name(u8_t *out, const char *name) {
+    u16_t len = 0;
+
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        u8_t label = dot ? (u8_t)(dot - name) : (u8_t)strlen(name);
+
+        out[len++] = label;
+        memcpy(&out[len], name, label);
+        len += label;
+        name += label + (dot ? 1 : 0);
+    }
+    out[len++] = 0;
+
+    return len;
+}
+
+// a query of one question from a browser on port 5353, to the group or the board
+static void query(const char *name, u16_t type, bool unicast_response) {
+    u8_t dns[256];
+    struct dns_hdr *hdr = (struct dns_hdr *)dns;
+    u16_t len = SIZEOF_DNS_HDR;
+
+    memset(hdr, 0, SIZEOF_DNS_HDR);
+    hdr->numquestions = PP_HTONS(1);
+    len += put_name(&dns[len], name);
+    dns[len++] = type >> 8;
+    dns[len++] = type & 0xff;
+    dns[len++] = unicast_response ? 0x80 : 0x00;
+    dns[len++] = DNS_RRCLASS_IN;
+
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, IP_HLEN + UDP_HLEN + len, PBUF_RAM);
+
+    if (p == NULL) {
+        failures++;
+        return;
+    }
+
+    struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+    struct udp_hdr *udphdr = (struct udp_hdr *)((u8_t *)p->payload + IP_HLEN);
+    ip4_addr_t src, dest;
+
+    IP4_ADDR(&src, 192, 168, 1, 20);
+    IP4_ADDR(&dest, 224, 0, 0, 251);
+
+    memset(iphdr, 0, IP_HLEN);
+    IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+    IPH_LEN_SET(iphdr, lwip_htons(p->tot_len));
+    IPH_TTL_SET(iphdr, 255);
+    IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+    ip4_addr_copy(iphdr->src, src);
+    ip4_addr_copy(iphdr->dest, dest);
+    IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+
+    udphdr->src = PP_HTONS(LWIP_IANA_PORT_MDNS);
+    udphdr->dest = PP_HTONS(LWIP_IANA_PORT_MDNS);
+    udphdr->len = lwip_htons(UDP_HLEN + len);
+    udphdr->chksum = 0;
+
+    memcpy((u8_t *)udphdr + UDP_HLEN, dns, len);
+
+    netif.input(p, &netif);
+}
+
+static void run_ms(u32_t ms) {
+    for (u32_t i = 0; i < ms; i++) {
+        now_ms++;
+        sys_check_timeouts();
+    }
+}
+
+// n queries interval_ms apart, the host time of their input
+static void bench_case(const char *label, const char *name, u16_t type, bool unicast_response, u32_t interval_ms) {
+    uint64_t ns = 0;
+
+    memset(&responses, 0, sizeof(responses));
+
+    for (uint32_t i = 0; i < queries; i++) {
+        uint64_t start = now_ns();
+
+        query(name, type, unicast_response);
+        ns += now_ns() - start;
+
+        run_ms(interval_ms);
+    }
+
+    if (responses.count == 0 || responses.differ != 0) {
+        failures++;
+    }
+
+    printf("%-16s %8u queries %8u responses (%u unicast) %9u bytes %8.0f ns/query%s\n", label, queries,
+        responses.count, responses.unicast, responses.bytes, (double)ns / queries,
+        responses.differ ? " DIFFER" : "");
+}
+
+// an A query before and after the address changes, the second answered with the new one
+static void bench_address_change(void) {
+    ip4_addr_t addr;
+
+    memset(&responses, 0, sizeof(responses));
+    query(HOST_NAME ".local", DNS_RRTYPE_A, true);
+
+    IP4_ADDR(&addr, 192, 168, 1, 16);
+    netif_set_ipaddr(&netif, &addr);
+    run_ms(10);
+
+    query(HOST_NAME ".local", DNS_RRTYPE_A, true);
+
+    bool found = false;
+
+    for (u16_t i = 0; i + 4 <= responses.last_len; i++) {
+        if (memcmp(&responses.last[i], &addr, 4) == 0) {
+            found = true;
+        }
+    }
+
+    if (!found) {
+        failures++;
+    }
+
+    printf("%-16s %8u responses, the last %s 192.168.1.16\n", "address change", responses.count,
+        found ? "with" : "WITHOUT");
+}
+
+static void srv_txt(struct mdns_service *service, void *txt_userdata) {
+    mdns_resp_add_service_txtitem(service, (const char *)txt_userdata, (u8_t)strlen((const char *)txt_userdata));
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        queries = strtoul(argv[1], NULL, 0);
+    }
+
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif, &addr, &mask, IP4_ADDR_ANY4, NULL, bench_netif_init, ip4_input);
+    netif_set_up(&netif);
+
+    mdns_resp_init();
+    mdns_resp_add_netif(&netif, HOST_NAME, 120);
+    mdns_resp_add_service(&netif, "pico-rmii status", "_http", DNSSD_PROTO_TCP, 80, 120, srv_txt, "path=/");
+    mdns_resp_add_service(&netif, "pico-rmii echo", "_echo", DNSSD_PROTO_TCP, 5000, 120, srv_txt, "bench=loopback");
+
+    // probes and the announcement
+    run_ms(2000);
+
+    printf("mdns_bench_%s\n", MDNS_BENCH_NAME);
+
+    bench_case("browse 1 s", "_http._tcp.local", DNS_RRTYPE_PTR, false, 1000);
+    bench_case("browse 100 ms", "_http._tcp.local", DNS_RRTYPE_PTR, false, 100);
+    bench_case("host QU", HOST_NAME ".local", DNS_RRTYPE_A, true, 10);
+    bench_address_change();
+
+#if MDNS_RESP_CACHE
+    struct mdns_resp_cache_stats stats;
+
+    mdns_resp_get_cache_stats(&netif, &stats);
+    printf("cache: %u hits, %u misses, %u multicasts suppressed\n", stats.hits, stats.misses, stats.suppressed);
+#endif
+
+    mdns_resp_remove_netif(&netif);
+    netif_remove(&netif);
+
+    if (lwip_stats.memp[MEMP_PBUF]->used != 0 || lwip_stats.mem.used != 0) {
+        printf("pbufs or heap left\n");
+        failures++;
+    }
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
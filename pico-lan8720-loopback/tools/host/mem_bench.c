@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/mem.h"
+#include "lwip/memp.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+
+#if PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_TLSF
+#include "../../src/lwip/lwip_tlsf.h"
+#endif
+
+#include "bench_wire.h"
+
+// times mem_malloc() and mem_free() on the sizes lwIP asks the heap for, with the
+// allocator of PICO_LWIP_MEM_ALLOCATOR on the balanced profile: lwIP's first fit heap,
+// the pools of src/lwip/lwippools.h or the TLSF heap of src/lwip/lwip_tlsf.c. Each call
+// is timed on its own, the clock read included (printed first), and the exit status is 1 when a block
+// came back overlapping another or anything was left allocated
+//
+// usage: mem_bench_tlsf [rounds per case, default 200000]
+//
+// one line per case and call, the host ns at p50/p99/p99.9/max and the share of calls
+// in each power of two bucket, then the failed allocations, the peak of the bytes asked
+// for and the peak the allocator held for them (its headers, the rounding up and, for
+// the pools, whole elements of every pool). The cases:
+//   tcp_bulk  full TCP_MSS segments of tcp_write() freed in order as the ACKs come,
+//             a window of TCP_SND_BUF, and an ACK sent for every second one received
+//   tcp_echo  512 byte replies, the ACK of the request, each reply freed one later
+//   mixed     ACKs, replies, DHCP messages and segments held at random for a while, up
+//             to 3/4 of MEM_SIZE, freed in any order
+
+#define BUCKETS 12 // below 16 ns, doubling, 16 us and over
+#define MIXED_LIVE 64
+
+// what pbuf_alloc(PBUF_RAM) asks mem_malloc() for
+#define PBUF_RAM_SIZE(layer_hlen, len) \
+    (LWIP_MEM_ALIGN_SIZE(LWIP_MEM_ALIGN_SIZE(sizeof(struct pbuf)) + (layer_hlen)) + LWIP_MEM_ALIGN_SIZE(len))
+
+#define SEGMENT_SIZE PBUF_RAM_SIZE(PBUF_LINK_HLEN + PBUF_IP_HLEN + PBUF_TRANSPORT_HLEN, TCP_MSS)
+#define ACK_SIZE PBUF_RAM_SIZE(PBUF_LINK_HLEN + PBUF_IP_HLEN, PBUF_TRANSPORT_HLEN)
+#define ECHO_SIZE PBUF_RAM_SIZE(PBUF_LINK_HLEN + PBUF_IP_HLEN + PBUF_TRANSPORT_HLEN, 512)
+#define DHCP_SIZE PBUF_RAM_SIZE(PBUF_LINK_HLEN + PBUF_IP_HLEN + 8, 548)
+
+#define SEND_WINDOW (TCP_SND_BUF / TCP_MSS)
+
+struct timings {
+    uint32_t *ns;
+    uint32_t count;
+};
+
+struct block {
+    uint8_t *p;
+    uint16_t size;
+    uint8_t fill;
+};
+
+static struct timings malloc_ns, free_ns;
+static uint32_t rounds = 200000;
+static uint32_t failed;
+static uint32_t asked, asked_max;
+static uint32_t random_state = 1;
+static uint failures;
+
+static uint32_t random_next(void) {
+    random_state = random_state * 1103515245u + 12345u;
+
+    return random_state >> 8;
+}
+
+// the block is filled so an overlap shows when it is freed
+static bool block_malloc(struct block *b, uint16_t size) {
+    uint64_t start = now_ns();
+    void *p = mem_malloc(size);
+
+    malloc_ns.ns[malloc_ns.count++] = (uint32_t)(now_ns() - start);
+
+    if (p == NULL) {
+        b->p = NULL;
+        failed++;
+
+        return false;
+    }
+
+    b->p = p;
+    b->size = size;
+    b->fill = (uint8_t)random_next();
+    memset(b->p, b->fill, size);
+
+    asked += size;
+    if (asked > asked_max) {
+        asked_max = asked;
+    }
+
+    return true;
+}
+
+static void block_free(struct block *b) {
+    if (b->p == NULL) {
+        return;
+    }
+
+    for (uint i = 0; i < b->size; i++) {
+        if (b->p[i] != b->fill) {
+            printf("%s: block of %u bytes overwritten at %u\n", MEM_BENCH_NAME, b->size, i);
+            failures++;
+            break;
+        }
+    }
+
+    uint64_t start = now_ns();
+
+    mem_free(b->p);
+
+    free_ns.ns[free_ns.count++] = (uint32_t)(now_ns() - start);
+
+    asked -= b->size;
+    b->p = NULL;
+}
+
+// what the allocator held at its peak for the blocks
+static uint32_t held_max(void) {
+#if PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_POOLS
+    uint32_t held = 0;
+
+    for (memp_t i = MEMP_POOL_FIRST; i <= MEMP_POOL_LAST; i++) {
+        held += (uint32_t)lwip_stats.memp[i]->max * memp_pools[i]->size;
+    }
+
+    return held;
+#elif PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_TLSF
+    return (uint32_t)lwip_tlsf_max();
+#else
+    return lwip_stats.mem.max;
+#endif
+}
+
+static void held_reset(void) {
+#if PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_POOLS
+    for (memp_t i = MEMP_POOL_FIRST; i <= MEMP_POOL_LAST; i++) {
+        lwip_stats.memp[i]->max = lwip_stats.memp[i]->used;
+    }
+#elif PICO_LWIP_MEM_ALLOCATOR == PICO_LWIP_MEM_ALLOCATOR_TLSF
+    lwip_tlsf_reset_max();
+#endif
+    lwip_stats.mem.max = lwip_stats.mem.used;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void report_timings(const char *name, const char *call, struct timings *t) {
+    uint32_t buckets[BUCKETS] = { 0 };
+
+    if (t->count == 0) {
+        return;
+    }
+
+    qsort(t->ns, t->count, sizeof(t->ns[0]), compare_u32);
+
+    for (uint32_t i = 0; i < t->count; i++) {
+        uint b = 0;
+
+        while (b < BUCKETS - 1 && t->ns[i] >= (16u << b)) {
+            b++;
+        }
+
+        buckets[b]++;
+    }
+
+    printf("%-10s %-8s %-6s p50 %5u p99 %5u p99.9 %5u max %6u ns |", MEM_BENCH_NAME, name, call,
+        t->ns[t->count / 2], t->ns[(uint64_t)t->count * 99 / 100], t->ns[(uint64_t)t->count * 999 / 1000],
+        t->ns[t->count - 1]);
+
+    for (uint b = 0; b < BUCKETS; b++) {
+        printf(" %5.1f", 100.0 * buckets[b] / t->count);
+    }
+
+    printf("\n");
+}
+
+static void report(const char *name) {
+    report_timings(name, "malloc", &malloc_ns);
+    report_timings(name, "free", &free_ns);
+
+    printf("%-10s %-8s %u failed, peak %u bytes asked, %u held\n", MEM_BENCH_NAME, name, failed, asked_max,
+        held_max());
+}
+
+static void case_start(void) {
+    malloc_ns.count = 0;
+    free_ns.count = 0;
+    failed = 0;
+    asked_max = asked;
+    held_reset();
+}
+
+static void run_tcp_bulk(void) {
+    struct block window[SEND_WINDOW] = { 0 };
+    struct block ack;
+
+    case_start();
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        // the oldest segment is acknowledged once the window is full
+        block_free(&window[i % SEND_WINDOW]);
+        block_malloc(&window[i % SEND_WINDOW], SEGMENT_SIZE);
+
+        if (i & 1) {
+            block_malloc(&ack, ACK_SIZE);
+            block_free(&ack);
+        }
+    }
+
+    for (uint i = 0; i < SEND_WINDOW; i++) {
+        block_free(&window[i]);
+    }
+
+    report("tcp_bulk");
+}
+
+static void run_tcp_echo(void) {
+    struct block replies[2] = { 0 };
+    struct block ack;
+
+    case_start();
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        block_free(&replies[i & 1]);
+
+        block_malloc(&ack, ACK_SIZE);
+        block_malloc(&replies[i & 1], ECHO_SIZE);
+        block_free(&ack);
+    }
+
+    block_free(&replies[0]);
+    block_free(&replies[1]);
+
+    report("tcp_echo");
+}
+
+static void run_mixed(void) {
+    static const uint16_t sizes[] = {
+        ACK_SIZE, ACK_SIZE, ACK_SIZE, ACK_SIZE, ECHO_SIZE, ECHO_SIZE, DHCP_SIZE,
+        SEGMENT_SIZE, SEGMENT_SIZE, SEGMENT_SIZE,
+    };
+    struct block live[MIXED_LIVE] = { 0 };
+
+    case_start();
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        struct block *b = &live[random_next() % MIXED_LIVE];
+        uint16_t size = sizes[random_next() % (sizeof(sizes) / sizeof(sizes[0]))];
+
+        block_free(b);
+
+        if (asked + size <= MEM_SIZE * 3 / 4) {
+            block_malloc(b, size);
+        }
+    }
+
+    for (uint i = 0; i < MIXED_LIVE; i++) {
+        block_free(&live[i]);
+    }
+
+    report("mixed");
+}
+
+// the median of two clock reads with nothing between them, in every timing
+static uint32_t clock_ns(void) {
+    malloc_ns.count = 0;
+
+    for (uint i = 0; i < 10000; i++) {
+        uint64_t start = now_ns();
+
+        malloc_ns.ns[malloc_ns.count++] = (uint32_t)(now_ns() - start);
+    }
+
+    qsort(malloc_ns.ns, malloc_ns.count, sizeof(malloc_ns.ns[0]), compare_u32);
+
+    return malloc_ns.ns[malloc_ns.count / 2];
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        rounds = strtoul(argv[1], NULL, 0);
+    }
+
+    malloc_ns.ns = malloc((2 * rounds + 10000) * sizeof(uint32_t));
+    free_ns.ns = malloc(2 * rounds * sizeof(uint32_t));
+
+    lwip_init();
+
+    mem_size_t heap_used = lwip_stats.mem.used;
+
+    printf("%-10s MEM_SIZE %u, segment %lu, echo %lu, DHCP %lu, ACK %lu bytes, clock read %u ns, buckets from <16 ns doubling to >=16 us\n",
+        MEM_BENCH_NAME, MEM_SIZE, (unsigned long)SEGMENT_SIZE, (unsigned long)ECHO_SIZE, (unsigned long)DHCP_SIZE,
+        (unsigned long)ACK_SIZE, clock_ns());
+
+    run_tcp_bulk();
+    run_tcp_echo();
+    run_mixed();
+
+    if (lwip_stats.mem.used != heap_used) {
+        printf("HEAP: %u bytes left allocated\n", (unsigned)(lwip_stats.mem.used - heap_used));
+        failures++;
+    }
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/stats.h"
+#include "lwip/apps/fs.h"
+
+#include "lwip_metrics.h"
+
+#include "bench_wire.h"
+
+// src/lwip/lwip_metrics.c's /metrics through httpd's fs, read as httpd reads it: lwIP's
+// stats, set to random values, and a section of the values at the digit boundaries up to
+// UINT64_MAX, rendered by metrics/ of the repository root and checked against the same
+// text from snprintf, read whole in chunks of 1 byte up to 64 KB and from random offsets,
+// with its Content-Length. Then the time of a scrape, opened and read in chunks of a
+// 1460 byte segment, against rendering the text with snprintf.
+// The exit status is 1 when a check fails
+//
+// usage: metrics_bench [scrapes timed, default 20000]
+
+#define TEXT_MAX 32768
+#define CHUNK 1460
+
+static uint32_t seed = 1;
+static uint failures;
+
+uint32_t timebase_ms(void) {
+    return now_ms;
+}
+
+static uint32_t random32(void) {
+    seed = seed * 1103515245u + 12345u;
+
+    return (seed >> 16) | (seed << 16);
+}
+
+static void expect(const char *what, bool ok) {
+    if (!ok) {
+        printf("  FAILED %s\n", what);
+        failures++;
+    }
+}
+
+#define EDGE(n) METRICS_SAMPLE("bench_edge{n=\"" #n "\"}")
+
+static const metrics_line_t edge_lines[] = {
+    METRICS_FAMILY("bench_edge", "gauge", "Values at the digit boundaries"),
+    EDGE(0), EDGE(1), EDGE(2), EDGE(3), EDGE(4), EDGE(5), EDGE(6), EDGE(7), EDGE(8), EDGE(9),
+    EDGE(10), EDGE(11), EDGE(12), EDGE(13), EDGE(14), EDGE(15), EDGE(16), EDGE(17), EDGE(18),
+    EDGE(19), EDGE(20), EDGE(21), EDGE(22), EDGE(23), EDGE(24), EDGE(25), EDGE(26), EDGE(27),
+    EDGE(28), EDGE(29), EDGE(30), EDGE(31), EDGE(32), EDGE(33), EDGE(34), EDGE(35), EDGE(36),
+    EDGE(37), EDGE(38), EDGE(39),
+    METRICS_FAMILY("bench_max_total", "counter", "The largest counter"),
+    METRICS_SAMPLE("bench_max_total"),
+};
+
+// 10^k - 1 and 10^k for k from 0 to 19, then UINT64_MAX
+static void edge_collect(uint64_t *values) {
+    uint64_t p = 1;
+
+    for (int k = 0; k < 20; k++) {
+        values[2 * k] = p - 1;
+        values[2 * k + 1] = p;
+        p *= 10;
+    }
+
+    values[40] = UINT64_MAX;
+}
+
+static const metrics_section_t edge_section = {
+    edge_lines, sizeof(edge_lines) / sizeof(edge_lines[0]), edge_collect
+};
+
+static void randomize_proto(struct stats_proto *proto) {
+    STAT_COUNTER *c = (STAT_COUNTER *)proto;
+
+    for (size_t i = 0; i < sizeof(*proto) / sizeof(STAT_COUNTER); i++) {
+        c[i] = (STAT_COUNTER)(random32() >> (random32() % 32));
+    }
+}
+
+static void randomize_stats(void) {
+    randomize_proto(&lwip_stats.link);
+    randomize_proto(&lwip_stats.etharp);
+    randomize_proto(&lwip_stats.ip_frag);
+    randomize_proto(&lwip_stats.ip);
+    randomize_proto(&lwip_stats.icmp);
+    randomize_proto(&lwip_stats.udp);
+    randomize_proto(&lwip_stats.tcp);
+    lwip_stats.mem.used = (mem_size_t)random32();
+    lwip_stats.mem.max = (mem_size_t)random32();
+    lwip_stats.mem.err = random32();
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        lwip_stats.memp[i]->used = (mem_size_t)(random32() % 1000);
+        lwip_stats.memp[i]->max = (mem_size_t)(random32() % 1000);
+        lwip_stats.memp[i]->err = random32() % 3 ? 0 : random32();
+    }
+}
+
+// the text of a scrape with snprintf, from the values the scrape took
+static size_t reference(const metrics_scrape_t *scrape, char *text) {
+    size_t n = 0;
+    const uint64_t *v = scrape->values;
+
+    for (uint8_t s = 0; s < scrape->nsections; s++) {
+        const metrics_section_t *section = scrape->sections[s];
+
+        for (uint16_t i = 0; i < section->count; i++) {
+            const metrics_line_t *line = &section->lines[i];
+
+            n += snprintf(text + n, TEXT_MAX - n, "%.*s", line->len, line->text);
+
+            if (line->sample) {
+                n += snprintf(text + n, TEXT_MAX - n, "%" PRIu64 "\n", *v++);
+            }
+        }
+    }
+
+    return n;
+}
+
+// /metrics read to its end in chunks, its header and text, 0 when it doesn't open
+static size_t fetch(char *out, int chunk) {
+    struct fs_file file;
+    size_t n = 0;
+    int r;
+
+    if (fs_open(&file, LWIP_METRICS_URI) != ERR_OK) {
+        return 0;
+    }
+
+    while ((r = fs_read(&file, out + n, chunk)) > 0) {
+        n += r;
+    }
+
+    expect("read to the length of the file", (int)n == file.len && r == FS_READ_EOF);
+    fs_close(&file);
+
+    return n;
+}
+
+// a sample line is "name{labels} value", a value of digits
+static bool well_formed(const char *text, size_t len) {
+    const char *p = text;
+    const char *end = text + len;
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        const char *space;
+
+        if (eol == NULL) {
+            return false;
+        }
+
+        if (*p != '#') {
+            space = memchr(p, ' ', eol - p);
+
+            if (space == NULL || space == p || space + 1 == eol) {
+                return false;
+            }
+
+            for (const char *d = space + 1; d < eol; d++) {
+                if (*d < '0' || *d > '9') {
+                    return false;
+                }
+            }
+        }
+
+        p = eol + 1;
+    }
+
+    return true;
+}
+
+static double seconds(void) {
+    return now_ns() / 1e9;
+}
+
+int main(int argc, char **argv) {
+    static const int chunks[] = { 1, 2, 7, 21, 22, 100, 536, 1460, 65536 };
+    static char ref[TEXT_MAX], got[TEXT_MAX], part[TEXT_MAX];
+    static uint64_t values[LWIP_METRICS_VALUES + 512];
+    uint32_t scrapes = 20000;
+    metrics_scrape_t scrape;
+
+    if (argc > 1) {
+        scrapes = strtoul(argv[1], NULL, 0);
+    }
+
+    lwip_init();
+    randomize_stats();
+
+    expect("the edge section added", lwip_metrics_add(&edge_section) == ERR_OK);
+    expect("no room for more sections",
+           lwip_metrics_add(&edge_section) != ERR_OK || lwip_metrics_add(&edge_section) != ERR_OK ||
+           lwip_metrics_add(&edge_section) != ERR_OK);
+
+    // what a scrape takes, the sections added over the room refused
+    uint32_t length = lwip_metrics_begin(&scrape, values);
+    size_t ref_len = reference(&scrape, ref);
+
+    printf("%u sections, %u samples, %u bytes\n", scrape.nsections, lwip_metrics_values(), length);
+    expect("length of the text", length == ref_len);
+    expect("Prometheus text format", well_formed(ref, ref_len));
+
+    // whole, in chunks
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        char what[64];
+        size_t n = fetch(got, chunks[c]);
+        const char *body = strstr(got, "\r\n\r\n");
+        const char *cl = strstr(got, "Content-Length: ");
+
+        snprintf(what, sizeof(what), "the text read %d bytes at a time", chunks[c]);
+        expect(what, body != NULL && n - (body + 4 - got) == ref_len && memcmp(body + 4, ref, ref_len) == 0);
+        expect("the Content-Length", cl != NULL && strtoul(cl + 16, NULL, 10) == ref_len);
+        expect("a Prometheus content type", strstr(got, "text/plain; version=0.0.4") != NULL);
+    }
+
+    // from random offsets, seeking back and forth
+    for (int i = 0; i < 100000; i++) {
+        uint32_t offset = random32() % (length + 1);
+        size_t size = 1 + random32() % 64;
+        size_t n = metrics_scrape_read(&scrape, offset, part, size);
+        size_t want = offset + size > length ? length - offset : size;
+
+        if (n != want || memcmp(part, ref + offset, n) != 0) {
+            expect("a read from a random offset", false);
+            break;
+        }
+    }
+
+    // as many scrapes at once as there are slots
+    struct fs_file open[LWIP_METRICS_SCRAPES + 1];
+
+    for (int i = 0; i < LWIP_METRICS_SCRAPES; i++) {
+        expect("a scrape of each slot", fs_open(&open[i], LWIP_METRICS_URI) == ERR_OK);
+    }
+    expect("no more scrapes than slots", fs_open(&open[LWIP_METRICS_SCRAPES], LWIP_METRICS_URI) != ERR_OK);
+    for (int i = 0; i < LWIP_METRICS_SCRAPES; i++) {
+        fs_close(&open[i]);
+    }
+
+    // a scrape as httpd makes it, against snprintf
+    double start = seconds();
+    size_t bytes = 0;
+
+    for (uint32_t i = 0; i < scrapes; i++) {
+        bytes += fetch(got, CHUNK);
+    }
+
+    double metrics_s = seconds() - start;
+
+    expect("every scrape whole", bytes > (size_t)scrapes * length);
+
+    start = seconds();
+    for (uint32_t i = 0; i < scrapes; i++) {
+        lwip_metrics_begin(&scrape, values);
+        reference(&scrape, ref);
+    }
+
+    double snprintf_s = seconds() - start;
+
+    printf("%u scrapes of %u bytes: %.2f us each, %.2f us with snprintf (%.1fx)\n",
+           scrapes, length, metrics_s * 1e6 / scrapes, snprintf_s * 1e6 / scrapes, snprintf_s / metrics_s);
+
+    printf("%s\n", failures ? "FAILED" : "ok");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/tcp.h"
+
+#include "net.h"
+#include "modbus.h"
+
+#include "bench_wire.h"
+
+// the Modbus/TCP server of modbus/modbus.c on net/net_lwip.c, the firmware's sources,
+// against an lwIP client that keeps a number of requests in flight, in virtual time. The
+// wire takes a ms each way, so 2 ms is the best a transaction can do. The requests are
+// pairs: a write of N holding registers (function 16), then a read of them back (function
+// 3), checked against what was written. The read of every 16th pair goes past the end of
+// the map and must come back as an illegal address exception. The exit status is 1 when a
+// response was wrong or a run stalled
+//
+// usage: modbus_bench [transactions per case, default 2000]
+//
+// one line per register count and depth: transactions per virtual second, the server's
+// data segments per transaction, the latency p50/p99/max in virtual ms, host ns per
+// transaction for both ends and the wire, and the server's counters of the run: requests
+// answered per service that answered any, frames split between two lends, and requests
+// that waited for room to answer. With 120 registers the frames are 250 to 260 bytes, the
+// client's segments split them and the server's ring wraps under them
+
+#define WIRE_SIZE 256
+
+// virtual ms without a response before a run is given up
+#define STALL_MS 2000
+
+#define REGISTERS 1000
+
+#define BUF_SIZE 65536
+
+static struct tcp_pcb *client;
+static bool connected;
+static uint32_t transactions = 2000;
+static uint32_t server_segments;
+static uint failures;
+
+// the run: requests sent and answered, when each was sent
+static uint16_t run_qty;
+static uint run_depth;
+static uint32_t run_sent, run_answered;
+static uint32_t *sent_ms, *latency;
+static uint8_t rx_buf[BUF_SIZE];
+static uint32_t rx_len;
+
+// the server's registers, as they go on the wire
+static uint8_t registers[REGISTERS * 2];
+
+static uint8_t registers_read(void *arg, uint16_t addr, uint16_t count, uint8_t *out) {
+    LWIP_UNUSED_ARG(arg);
+
+    memcpy(out, registers + 2 * addr, 2 * count);
+
+    return 0;
+}
+
+static uint8_t registers_write(void *arg, uint16_t addr, uint16_t count, const uint8_t *in) {
+    LWIP_UNUSED_ARG(arg);
+
+    memcpy(registers + 2 * addr, in, 2 * count);
+
+    return 0;
+}
+
+static const struct modbus_range map[] = {
+    {MODBUS_HOLDING_REGISTERS, 0, REGISTERS, registers_read, registers_write, NULL},
+};
+
+// the data segments of the server, told by their source
+static bool wire_count(struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(ipaddr);
+
+    if (p->len < IP_HLEN) {
+        return true;
+    }
+
+    struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+    u16_t hlen = IPH_HL_BYTES(iphdr);
+
+    if (!ip4_addr_cmp(&iphdr->src, netif_ip4_addr(&netif_b)) || IPH_PROTO(iphdr) != IP_PROTO_TCP ||
+        p->len < hlen + TCP_HLEN) {
+        return true;
+    }
+
+    struct tcp_hdr *tcphdr = (struct tcp_hdr *)((u8_t *)p->payload + hlen);
+
+    if (lwip_ntohs(IPH_LEN(iphdr)) - hlen - TCPH_HDRLEN_BYTES(tcphdr) != 0) {
+        server_segments++;
+    }
+
+    return true;
+}
+
+// request i: pair i / 2, its write then its read, each pair on the next block of run_qty
+// registers, the value of a register from the pair and its place
+static uint16_t request_addr(uint32_t i) {
+    uint32_t pair = i / 2;
+
+    if ((i & 1) && pair % 16 == 15) {
+        // past the end of the map
+        return REGISTERS - run_qty / 2;
+    }
+
+    return (pair % (REGISTERS / run_qty)) * run_qty;
+}
+
+static uint16_t request_value(uint32_t pair, uint16_t k) {
+    return (uint16_t)(pair * 31 + k);
+}
+
+static uint16_t request_build(uint32_t i, uint8_t *frame) {
+    uint16_t addr = request_addr(i);
+    uint16_t pdu_len;
+
+    modbus_put_u16(frame, (uint16_t)i);
+    modbus_put_u16(frame + 2, 0);
+    frame[6] = 1;
+    modbus_put_u16(frame + 8, addr);
+    modbus_put_u16(frame + 10, run_qty);
+
+    if (i & 1) {
+        frame[7] = MODBUS_READ_HOLDING_REGISTERS;
+        pdu_len = 5;
+    } else {
+        frame[7] = MODBUS_WRITE_MULTIPLE_REGISTERS;
+        frame[12] = 2 * run_qty;
+
+        for (uint16_t k = 0; k < run_qty; k++) {
+            modbus_put_u16(frame + 13 + 2 * k, request_value(i / 2, k));
+        }
+
+        pdu_len = 6 + 2 * run_qty;
+    }
+
+    modbus_put_u16(frame + 4, 1 + pdu_len);
+
+    return MODBUS_MBAP_SIZE + pdu_len;
+}
+
+static bool response_check(uint32_t i, const uint8_t *frame, uint16_t size) {
+    uint16_t addr = request_addr(i);
+
+    if (modbus_get_u16(frame) != (uint16_t)i || frame[6] != 1) {
+        return false;
+    }
+
+    if (!(i & 1)) {
+        return size == 12 && frame[7] == MODBUS_WRITE_MULTIPLE_REGISTERS && modbus_get_u16(frame + 8) == addr &&
+            modbus_get_u16(frame + 10) == run_qty;
+    }
+
+    if (addr + run_qty > REGISTERS) {
+        return size == 9 && frame[7] == (MODBUS_READ_HOLDING_REGISTERS | 0x80) && frame[8] == MODBUS_EX_ILLEGAL_ADDRESS;
+    }
+
+    if (size != 9 + 2 * run_qty || frame[7] != MODBUS_READ_HOLDING_REGISTERS || frame[8] != 2 * run_qty) {
+        return false;
+    }
+
+    for (uint16_t k = 0; k < run_qty; k++) {
+        if (modbus_get_u16(frame + 9 + 2 * k) != request_value(i / 2, k)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// up to run_depth requests in flight, the rest when the client's send queue has room
+static void client_send(void) {
+    uint8_t frame[MODBUS_FRAME_MAX];
+
+    while (run_sent < transactions && run_sent - run_answered < run_depth) {
+        uint16_t size = request_build(run_sent, frame);
+
+        if (tcp_write(client, frame, size, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            break;
+        }
+
+        sent_ms[run_sent++] = now_ms;
+    }
+
+    tcp_output(client);
+}
+
+static err_t client_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    uint32_t off = 0;
+
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        return ERR_OK;
+    }
+
+    if (rx_len + p->tot_len > BUF_SIZE) {
+        failures++;
+        rx_len = 0;
+    }
+
+    rx_len += pbuf_copy_partial(p, rx_buf + rx_len, p->tot_len, 0);
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    while (rx_len - off >= MODBUS_MBAP_SIZE) {
+        uint16_t size = 6 + modbus_get_u16(rx_buf + off + 4);
+
+        if (rx_len - off < size) {
+            break;
+        }
+
+        if (!response_check(run_answered, rx_buf + off, size)) {
+            failures++;
+        }
+
+        latency[run_answered] = now_ms - sent_ms[run_answered];
+        run_answered++;
+        off += size;
+    }
+
+    memmove(rx_buf, rx_buf + off, rx_len - off);
+    rx_len -= off;
+
+    // a request for each response, the depth stays
+    client_send();
+
+    return ERR_OK;
+}
+
+static err_t client_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(len);
+
+    client_send();
+
+    return ERR_OK;
+}
+
+static err_t client_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(err);
+
+    connected = true;
+
+    return ERR_OK;
+}
+
+static bool client_open(void) {
+    client = tcp_new();
+    connected = false;
+
+    if (client == NULL) {
+        return false;
+    }
+
+    tcp_recv(client, client_recv);
+    tcp_sent(client, client_sent);
+    tcp_nagle_disable(client);
+
+    tcp_bind(client, netif_ip_addr4(&netif_a), 0);
+    tcp_connect(client, netif_ip_addr4(&netif_b), MODBUS_PORT, client_connected);
+
+    for (uint32_t start = now_ms; !connected && (now_ms - start) < STALL_MS; ) {
+        wire_step();
+    }
+
+    return connected;
+}
+
+static void client_close(void) {
+    tcp_close(client);
+
+    // both ends closed before the next case, TIME_WAIT is left to itself
+    for (uint32_t start = now_ms; tcp_active_pcbs != NULL && (now_ms - start) < STALL_MS; ) {
+        wire_step();
+    }
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void bench(uint16_t qty, uint depth) {
+    struct modbus_stats before, after;
+    bool stalled = false;
+
+    run_qty = qty;
+    run_depth = depth;
+    run_sent = run_answered = 0;
+    rx_len = 0;
+    memset(registers, 0, sizeof(registers));
+
+    if (!client_open()) {
+        printf("%3u registers depth %2u connect failed\n", qty, depth);
+        failures++;
+
+        return;
+    }
+
+    modbus_get_stats(&before);
+    server_segments = 0;
+
+    uint32_t start_ms = now_ms;
+    uint64_t start_ns = now_ns();
+
+    client_send();
+
+    for (uint32_t last = run_answered, last_ms = now_ms; run_answered < transactions; ) {
+        wire_step();
+
+        if (run_answered != last) {
+            last = run_answered;
+            last_ms = now_ms;
+        } else if (now_ms - last_ms >= STALL_MS) {
+            stalled = true;
+            break;
+        }
+    }
+
+    uint64_t elapsed_ns = now_ns() - start_ns;
+    uint32_t elapsed_ms = now_ms - start_ms;
+    uint32_t done = run_answered;
+
+    modbus_get_stats(&after);
+    client_close();
+
+    qsort(latency, done, sizeof(uint32_t), compare_u32);
+
+    printf("%3u registers depth %2u: %6.0f tr/s, %.2f segments/tr, latency p50/p99/max %u/%u/%u ms, %5.0f host ns/tr, batch %.1f split %u deferred %u%s\n",
+        qty, depth, elapsed_ms ? done * 1000.0 / elapsed_ms : 0.0, done ? (double)server_segments / done : 0.0,
+        done ? latency[done / 2] : 0, done ? latency[(done * 99) / 100] : 0, done ? latency[done - 1] : 0,
+        done ? (double)elapsed_ns / done : 0.0, after.services != before.services ? (double)(after.requests - before.requests) / (after.services - before.services) : 0.0, (uint)(after.split - before.split),
+        (uint)(after.deferred - before.deferred), stalled ? ", STALLED" : "");
+
+    if (stalled) {
+        failures++;
+    }
+}
+
+int main(int argc, char **argv) {
+    static const uint depths[] = { 1, 4, 16 };
+
+    if (argc > 1) {
+        transactions = strtoul(argv[1], NULL, 0);
+    }
+
+    sent_ms = calloc(transactions, sizeof(uint32_t));
+    latency = calloc(transactions, sizeof(uint32_t));
+
+    if (sent_ms == NULL || latency == NULL) {
+        return 1;
+    }
+
+    wire_init(WIRE_SIZE);
+    wire_tap = wire_count;
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    modbus_init(map, sizeof(map) / sizeof(map[0]));
+
+    for (uint i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+        bench(8, depths[i]);
+    }
+
+    for (uint i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+        bench(120, depths[i]);
+    }
+
+    // a frame the wire dropped is a failure too
+    failures += wire_drops;
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    free(sent_ms);
+    free(latency);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,444 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcp.h"
+#include "lwip/apps/mqtt.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/tcp.h"
+
+#include "bench_wire.h"
+
+// QoS 0 publishes from lwIP's MQTT client to a broker of a few lines, as many as the
+// client takes each virtual ms, four ways:
+//   copy       mqtt_publish(), the payload copied into the output ring and from there into pbufs
+//   copy xN    the same between mqtt_output_hold() and mqtt_output_flush(), N at a time
+//   ref        mqtt_publish_ref(), the payload sent from the caller's buffer
+//   ref xN     the same, held
+// The wire takes a ms each way and drops 1% of the client's data segments in the lossy
+// cases. The broker checks every payload, and ref overwrites its buffers as soon as their
+// callback says they are free, so a release before the payload's ACK shows as bad data.
+// One line per way and size: the publishes per virtual second, the client's data segments
+// per publish, and the host time the publish calls (and flushes) took. The exit status is
+// 1 when a payload came out wrong, a case stalled or a pbuf is left
+//
+// usage: mqtt_bench [publishes per case, default 20000]
+
+#define WIRE_SIZE 512
+#define BATCH 8
+#define REF_BUFFERS 16
+
+// virtual ms without progress before a case is given up, past a backed off RTO
+#define STALL_MS 10000
+
+#define TOPIC "sensors/pico/1"
+
+// control packet types, MQTT 3.1.1 2.2.1
+#define BROKER_CONNECT 1
+#define BROKER_PUBLISH 3
+
+enum mode {
+    MODE_COPY,
+    MODE_REF,
+};
+
+struct ref_buffer {
+    bool busy;
+    uint8_t data[1024];
+};
+
+static mqtt_client_t *client;
+static volatile bool connected;
+static struct ref_buffer ref_buffers[REF_BUFFERS];
+static uint32_t publishes = 20000;
+static uint32_t payload_size;
+static uint32_t loss_ppm;
+static uint32_t loss_state = 1;
+static uint32_t data_segments;
+static uint failures;
+
+// the broker's side: the bytes of the message being parsed, and the publishes checked
+static uint8_t broker_msg[2048];
+static uint32_t broker_len;
+static uint32_t broker_publishes;
+static bool broker_bad;
+
+// xorshift32, enough for a loss pattern
+static uint32_t loss_random(void) {
+    loss_state ^= loss_state << 13;
+    loss_state ^= loss_state >> 17;
+    loss_state ^= loss_state << 5;
+
+    return loss_state;
+}
+
+// the TCP payload of a packet from the client, 0 for anything else. Both ends route out
+// of the one netif of their subnet that lwIP finds first, so they are told by the source
+static u16_t wire_payload(struct pbuf *p) {
+    struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+    u16_t hlen = IPH_HL_BYTES(iphdr);
+
+    if (!ip4_addr_cmp(&iphdr->src, netif_ip4_addr(&netif_a)) || IPH_PROTO(iphdr) != IP_PROTO_TCP) {
+        return 0;
+    }
+
+    struct tcp_hdr *tcphdr = (struct tcp_hdr *)((u8_t *)p->payload + hlen);
+
+    return lwip_ntohs(IPH_LEN(iphdr)) - hlen - TCPH_HDRLEN_BYTES(tcphdr);
+}
+
+// only the client's data is lost, the handshakes and the ACKs get through
+static bool wire_loss(struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(ipaddr);
+
+    if (wire_payload(p) != 0) {
+        if (loss_ppm && (loss_random() % 1000000) < loss_ppm) {
+            return false;
+        }
+
+        data_segments++;
+    }
+
+    return true;
+}
+
+// publish n carries the bytes n + i, mod 251
+static void payload_fill(uint8_t *data, uint32_t n) {
+    for (uint32_t i = 0; i < payload_size; i++) {
+        data[i] = (uint8_t)((n + i) % 251);
+    }
+}
+
+// one whole message from the client: CONNECT gets its CONNACK, PUBLISH is checked
+static void broker_message(struct tcp_pcb *pcb, const uint8_t *msg, uint32_t len, uint32_t header) {
+    static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    uint8_t type = msg[0] >> 4;
+
+    if (type == BROKER_CONNECT) {
+        tcp_write(pcb, connack, sizeof(connack), TCP_WRITE_FLAG_COPY);
+        tcp_output(pcb);
+
+        return;
+    }
+
+    if (type != BROKER_PUBLISH) {
+        return;
+    }
+
+    uint32_t topic_len = (msg[header] << 8) | msg[header + 1];
+    const uint8_t *payload = msg + header + 2 + topic_len;
+    uint32_t payload_len = len - header - 2 - topic_len;
+    uint32_t n = broker_publishes++;
+
+    if (topic_len != strlen(TOPIC) || memcmp(msg + header + 2, TOPIC, topic_len) != 0 || payload_len != payload_size) {
+        broker_bad = true;
+
+        return;
+    }
+
+    for (uint32_t i = 0; i < payload_len; i++) {
+        if (payload[i] != (uint8_t)((n + i) % 251)) {
+            broker_bad = true;
+
+            return;
+        }
+    }
+}
+
+static err_t broker_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        tcp_close(pcb);
+
+        return ERR_OK;
+    }
+
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        for (u16_t i = 0; i < q->len; i++) {
+            if (broker_len == sizeof(broker_msg)) {
+                broker_bad = true;
+                broker_len = 0;
+            }
+
+            broker_msg[broker_len++] = ((uint8_t *)q->payload)[i];
+
+            // the fixed header's remaining length, 7 bits a byte
+            uint32_t header = 1, remaining = 0, shift = 0;
+
+            while (header < broker_len && header < 5) {
+                remaining |= (broker_msg[header] & 0x7f) << shift;
+                shift += 7;
+
+                if (!(broker_msg[header++] & 0x80)) {
+                    break;
+                }
+            }
+
+            if (header <= broker_len && !(broker_msg[header - 1] & 0x80) && header > 1 &&
+                broker_len == header + remaining) {
+                broker_message(pcb, broker_msg, broker_len, header);
+                broker_len = 0;
+            }
+        }
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    // every segment acknowledged at once, as by a broker not in delayed ACK mode, so the
+    // rate is the client's and not lwIP's 250 ms fast timer
+    tcp_ack_now(pcb);
+    tcp_output(pcb);
+
+    return ERR_OK;
+}
+
+static err_t broker_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    broker_len = 0;
+    tcp_recv(pcb, broker_recv);
+
+    return ERR_OK;
+}
+
+static void client_connection(mqtt_client_t *c, void *arg, mqtt_connection_status_t status) {
+    LWIP_UNUSED_ARG(c);
+    LWIP_UNUSED_ARG(arg);
+
+    connected = status == MQTT_CONNECT_ACCEPTED;
+}
+
+// the buffer is the client's again, scribbled on so a send from it shows
+static void ref_released(void *arg, err_t err) {
+    struct ref_buffer *buffer = arg;
+
+    LWIP_UNUSED_ARG(err);
+
+    memset(buffer->data, 0xee, sizeof(buffer->data));
+    buffer->busy = false;
+}
+
+static struct ref_buffer *ref_buffer_get(void) {
+    for (uint i = 0; i < REF_BUFFERS; i++) {
+        if (!ref_buffers[i].busy) {
+            return &ref_buffers[i];
+        }
+    }
+
+    return NULL;
+}
+
+static bool client_publish(enum mode mode, uint32_t n) {
+    if (mode == MODE_COPY) {
+        uint8_t data[1024];
+
+        payload_fill(data, n);
+
+        return mqtt_publish(client, TOPIC, data, (u16_t)payload_size, 0, 0, NULL, NULL) == ERR_OK;
+    }
+
+    struct ref_buffer *buffer = ref_buffer_get();
+
+    if (buffer == NULL) {
+        return false;
+    }
+
+    payload_fill(buffer->data, n);
+    buffer->busy = true;
+
+    if (mqtt_publish_ref(client, TOPIC, buffer->data, (u16_t)payload_size, 0, ref_released, buffer) != ERR_OK) {
+        buffer->busy = false;
+
+        return false;
+    }
+
+    return true;
+}
+
+static void bench(enum mode mode, uint batch, uint32_t size, double loss) {
+    static const char *const names[] = { "copy", "ref" };
+    struct mqtt_connect_client_info_t info = { .client_id = "pico", .keep_alive = 60 };
+    ip_addr_t broker;
+    char name[16];
+    bool stalled = false;
+
+    if (batch > 1) {
+        snprintf(name, sizeof(name), "%s x%u", names[mode], batch);
+    } else {
+        snprintf(name, sizeof(name), "%s", names[mode]);
+    }
+
+    ip_addr_copy_from_ip4(broker, *netif_ip4_addr(&netif_b));
+
+    payload_size = size;
+    loss_ppm = (uint32_t)(loss * 10000);
+    data_segments = 0;
+    broker_publishes = 0;
+    broker_bad = false;
+    connected = false;
+
+    mqtt_client_connect(client, &broker, MQTT_PORT, client_connection, NULL, &info);
+
+    for (uint32_t start = now_ms; !connected && (now_ms - start) < STALL_MS; ) {
+        wire_step();
+    }
+
+    if (!connected) {
+        printf("%-8s %4u B  connect failed\n", name, (uint)size);
+        failures++;
+
+        return;
+    }
+
+    uint32_t segments = data_segments;
+    uint32_t start = now_ms, progress = now_ms, last = 0;
+    uint64_t client_ns = 0;
+    uint32_t next = 0;
+
+    while (broker_publishes < publishes) {
+        uint64_t t = now_ns();
+        bool full = false;
+
+        // as many as the client takes this ms, batch at a time
+        while (next < publishes && !full) {
+            if (batch > 1) {
+                mqtt_output_hold(client);
+            }
+
+            for (uint i = 0; i < batch && next < publishes; i++) {
+                if (!client_publish(mode, next)) {
+                    full = true;
+                    break;
+                }
+
+                next++;
+            }
+
+            if (batch > 1) {
+                mqtt_output_flush(client);
+            }
+        }
+
+        client_ns += now_ns() - t;
+
+        wire_step();
+
+        if (broker_publishes != last) {
+            last = broker_publishes;
+            progress = now_ms;
+        } else if ((now_ms - progress) >= STALL_MS) {
+            stalled = true;
+            break;
+        }
+    }
+
+    uint32_t elapsed_ms = now_ms - start;
+
+    segments = data_segments - segments;
+
+    mqtt_disconnect(client);
+
+    // both ends closed and the wire empty before the next case, TIME_WAIT is left to itself
+    for (uint32_t close = now_ms; (tcp_active_pcbs != NULL || wire_pending() != 0) &&
+        (now_ms - close) < STALL_MS; ) {
+        wire_step();
+    }
+
+    for (uint i = 0; i < REF_BUFFERS; i++) {
+        if (ref_buffers[i].busy) {
+            printf("%-8s %4u B  buffer %u never released\n", name, (uint)size, i);
+            failures++;
+            ref_buffers[i].busy = false;
+        }
+    }
+
+    printf("%-8s %4u B  loss %.0f%%: %6.0f publishes/s, %5.2f segs/publish, host %5.0f ns/publish%s%s\n",
+        name, (uint)size, loss, elapsed_ms ? broker_publishes * 1000.0 / elapsed_ms : 0.0,
+        broker_publishes ? (double)segments / broker_publishes : 0.0,
+        broker_publishes ? (double)client_ns / broker_publishes : 0.0,
+        broker_bad ? ", BAD DATA" : "", stalled ? ", STALLED" : "");
+
+    if (broker_bad || stalled) {
+        failures++;
+    }
+}
+
+int main(int argc, char **argv) {
+    static const uint32_t sizes[] = { 16, 256, 1024 };
+
+    if (argc > 1) {
+        publishes = strtoul(argv[1], NULL, 0);
+    }
+
+    wire_init(WIRE_SIZE);
+    wire_tap = wire_loss;
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    // the client doesn't bind, it takes the address of the netif lwIP routes through: the
+    // first of the list, the one added last
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    struct tcp_pcb *listener = tcp_new();
+
+    tcp_bind(listener, netif_ip_addr4(&netif_b), MQTT_PORT);
+    listener = tcp_listen(listener);
+    tcp_accept(listener, broker_accept);
+
+    client = mqtt_client_new();
+
+    if (client == NULL) {
+        return 1;
+    }
+
+    for (uint i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (uint lossy = 0; lossy < 2; lossy++) {
+            bench(MODE_COPY, 1, sizes[i], lossy);
+            bench(MODE_COPY, BATCH, sizes[i], lossy);
+            bench(MODE_REF, 1, sizes[i], lossy);
+            bench(MODE_REF, BATCH, sizes[i], lossy);
+        }
+    }
+
+    mqtt_client_free(client);
+
+    // all the pbufs the wire and TCP held are back
+    if (MEMP_STATS && lwip_stats.memp[MEMP_PBUF_POOL]->used != 0) {
+        printf("%u pool pbufs left\n", (uint)lwip_stats.memp[MEMP_PBUF_POOL]->used);
+        failures++;
+    }
+
+    // a frame the wire dropped is a failure too
+    failures += wire_drops;
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/ethip6.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/init.h"
+#include "lwip/ip6.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/prot/icmp6.h"
+#include "lwip/prot/ip6.h"
+#include "lwip/prot/nd6.h"
+#include "netif/ethernet.h"
+
+#include "bench_wire.h"
+
+// lwIP's IPv6 neighbour discovery with a subnet of PLCs, ND6_BENCH_PEERS neighbours on
+// 2001:db8::/64 that answer neighbour solicitations a ms after they go out. Built once as
+// stock lwIP (10 neighbour and 10 destination cache entries, searched) and once with the
+// balanced profile's caches and LWIP_ND6_CACHE_HASH. The exit status is 1 when a datagram
+// never left
+//
+// usage: nd6_bench_hash [ms per step, default 200] [virtual minutes of polls, default 10]
+//
+// first the host time of a UDP send with 1 to ND6_BENCH_PEERS neighbours, sent to round
+// robin, then every peer is polled once every 10 s in virtual time: a poll that doesn't
+// leave at once waits in the neighbour's queue for a solicitation to be answered, a stall.
+// The first round resolves every peer and isn't counted
+
+#define ND6_BENCH_PEERS 40
+#define ND6_BENCH_INTERVAL_MS 10000
+
+#define ND6_BENCH_NA_SIZE (IP6_HLEN + sizeof(struct na_header) + sizeof(struct lladdr_option))
+
+static struct netif netif;
+static struct udp_pcb *pcb;
+static uint failures;
+static uint32_t bench_ms = 200;
+static uint32_t bench_minutes = 10;
+
+static struct {
+    uint32_t sent;
+    uint32_t delivered;
+    uint32_t solicits_multicast;
+    uint32_t solicits_unicast;
+} counts;
+
+static bool delivered_now;
+
+static const struct eth_addr host_mac = {{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 }};
+
+static void peer_addr(uint i, ip6_addr_t *addr) {
+    IP6_ADDR(addr, PP_HTONL(0x20010db8), 0, PP_HTONL(0x02000000), lwip_htonl(0x00000100 + i));
+}
+
+static void peer_mac(uint i, struct eth_addr *mac) {
+    static const struct eth_addr base = {{ 0x02, 0x00, 0x00, 0x00, 0x01, 0x00 }};
+
+    *mac = base;
+    mac->addr[5] = i;
+}
+
+// the index of a peer's address, -1 for anything else
+static int peer_index(const ip6_addr_t *addr) {
+    ip6_addr_t first;
+
+    peer_addr(0, &first);
+
+    if (addr->addr[0] != first.addr[0] || addr->addr[1] != first.addr[1] || addr->addr[2] != first.addr[2]) {
+        return -1;
+    }
+
+    uint32_t i = lwip_ntohl(addr->addr[3]) - lwip_ntohl(first.addr[3]);
+
+    return i < ND6_BENCH_PEERS ? (int)i : -1;
+}
+
+static void reply_queue(uint i) {
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, SIZEOF_ETH_HDR + ND6_BENCH_NA_SIZE, PBUF_RAM);
+
+    if (p == NULL) {
+        failures++;
+
+        return;
+    }
+
+    struct eth_hdr *eth = p->payload;
+    struct ip6_hdr *ip6 = (struct ip6_hdr *)((uint8_t *)p->payload + SIZEOF_ETH_HDR);
+    struct na_header *na = (struct na_header *)((uint8_t *)ip6 + IP6_HLEN);
+    struct lladdr_option *lladdr = (struct lladdr_option *)((uint8_t *)na + sizeof(struct na_header));
+    struct eth_addr mac;
+    ip6_addr_t addr;
+
+    memset(p->payload, 0, p->len);
+    peer_mac(i, &mac);
+    peer_addr(i, &addr);
+
+    eth->dest = host_mac;
+    eth->src = mac;
+    eth->type = PP_HTONS(ETHTYPE_IPV6);
+
+    IP6H_VTCFL_SET(ip6, 6, 0, 0);
+    IP6H_PLEN_SET(ip6, ND6_BENCH_NA_SIZE - IP6_HLEN);
+    IP6H_NEXTH_SET(ip6, IP6_NEXTH_ICMP6);
+    IP6H_HOPLIM_SET(ip6, 255); // as ND messages must have
+    ip6_addr_copy_to_packed(ip6->src, addr);
+    ip6_addr_copy_to_packed(ip6->dest, *netif_ip6_addr(&netif, 1));
+
+    na->type = ICMP6_TYPE_NA;
+    na->flags = ND6_FLAG_SOLICITED | ND6_FLAG_OVERRIDE;
+    ip6_addr_copy_to_packed(na->target_address, addr);
+    lladdr->type = ND6_OPTION_TYPE_TARGET_LLADDR;
+    lladdr->length = 1;
+    memcpy(lladdr->addr, mac.addr, ETH_HWADDR_LEN);
+
+    // the pseudo header sum over the ICMPv6 part only
+    pbuf_remove_header(p, SIZEOF_ETH_HDR + IP6_HLEN);
+    na->chksum = ip6_chksum_pseudo(p, IP6_NEXTH_ICMP6, p->tot_len, &addr, netif_ip6_addr(&netif, 1));
+    pbuf_add_header(p, SIZEOF_ETH_HDR + IP6_HLEN);
+
+    if (!wire_queue(p, &netif)) {
+        failures++;
+    }
+}
+
+// the peers' side of the wire: datagrams arrive, neighbour solicitations are answered
+static err_t bench_linkoutput(struct netif *netif, struct pbuf *p) {
+    uint8_t frame[SIZEOF_ETH_HDR + IP6_HLEN + sizeof(struct ns_header)];
+
+    LWIP_UNUSED_ARG(netif);
+
+    if (pbuf_copy_partial(p, frame, sizeof(frame), 0) < SIZEOF_ETH_HDR + IP6_HLEN) {
+        failures++;
+
+        return ERR_OK;
+    }
+
+    struct eth_hdr *eth = (struct eth_hdr *)frame;
+    struct ip6_hdr *ip6 = (struct ip6_hdr *)(frame + SIZEOF_ETH_HDR);
+
+    if (eth->type != PP_HTONS(ETHTYPE_IPV6)) {
+        return ERR_OK;
+    }
+
+    if (IP6H_NEXTH(ip6) == IP6_NEXTH_UDP) {
+        struct eth_addr mac;
+
+        peer_mac(eth->dest.addr[5], &mac);
+
+        if (eth->dest.addr[5] < ND6_BENCH_PEERS && eth_addr_cmp(&eth->dest, &mac)) {
+            counts.delivered++;
+            delivered_now = true;
+        } else {
+            failures++;
+        }
+    } else if (IP6H_NEXTH(ip6) == IP6_NEXTH_ICMP6) {
+        struct ns_header *ns = (struct ns_header *)(frame + SIZEOF_ETH_HDR + IP6_HLEN);
+        ip6_addr_t target;
+
+        if (ns->type != ICMP6_TYPE_NS) {
+            // MLD reports
+            return ERR_OK;
+        }
+
+        ip6_addr_copy_from_packed(target, ns->target_address);
+
+        int i = peer_index(&target);
+
+        if (i >= 0) {
+            if (eth->dest.addr[0] & 1) {
+                counts.solicits_multicast++;
+            } else {
+                counts.solicits_unicast++;
+            }
+
+            reply_queue(i);
+        }
+    }
+
+    return ERR_OK;
+}
+
+static err_t bench_netif_init(struct netif *netif) {
+    netif->output_ip6 = ethip6_output;
+    netif->linkoutput = bench_linkoutput;
+    netif->mtu = 1500;
+    netif->hwaddr_len = ETH_HWADDR_LEN;
+    memcpy(netif->hwaddr, host_mac.addr, ETH_HWADDR_LEN);
+    netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_MLD6 | NETIF_FLAG_LINK_UP;
+
+    return ERR_OK;
+}
+
+// one small datagram to peer i, true when it left at once
+static bool poll(uint i) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, 16, PBUF_RAM);
+    ip_addr_t addr;
+
+    if (p == NULL) {
+        failures++;
+
+        return false;
+    }
+
+    memset(p->payload, i, p->len);
+    IP_SET_TYPE_VAL(addr, IPADDR_TYPE_V6);
+    peer_addr(i, ip_2_ip6(&addr));
+
+    delivered_now = false;
+    counts.sent++;
+
+    if (udp_sendto(pcb, p, &addr, 502) != ERR_OK) {
+        failures++;
+    }
+
+    pbuf_free(p);
+
+    return delivered_now;
+}
+
+static void bench_output(uint peers) {
+    // every peer resolved before the clock starts
+    for (uint i = 0; i < peers; i++) {
+        if (!poll(i)) {
+            wire_run();
+        }
+    }
+
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+    uint32_t packets = 0;
+    uint32_t stalls = 0;
+
+    do {
+        for (uint i = 0; i < peers; i++) {
+            if (!poll(i)) {
+                stalls++;
+                wire_run();
+            }
+        }
+
+        packets += peers;
+        elapsed = now_ns() - start;
+    } while (elapsed < bench_ms * 1000000ull);
+
+    printf("%-4s %2u peers %8.1f ns/packet, %u of %u stalled\n", ND6_BENCH_NAME, peers, (double)elapsed / packets,
+        stalls, packets);
+}
+
+static void bench_polls(void) {
+    uint32_t duration_ms = bench_minutes * 60000;
+    uint32_t stalls = 0, polls = 0;
+
+    memset(&counts, 0, sizeof(counts));
+
+    for (uint32_t t = 0; t < duration_ms; t++) {
+        for (uint i = 0; i < ND6_BENCH_PEERS; i++) {
+            if (t % ND6_BENCH_INTERVAL_MS == i * (ND6_BENCH_INTERVAL_MS / ND6_BENCH_PEERS)) {
+                bool at_once = poll(i);
+
+                if (t >= ND6_BENCH_INTERVAL_MS) {
+                    polls++;
+                    stalls += !at_once;
+                }
+            }
+        }
+
+        wire_run();
+    }
+
+    // the last polls' replies
+    for (int i = 0; i < 10; i++) {
+        wire_run();
+    }
+
+    printf("%-4s poll every %3u s: %u stalls in %u polls, solicitations %u multicast %u unicast\n", ND6_BENCH_NAME,
+        ND6_BENCH_INTERVAL_MS / 1000, stalls, polls, counts.solicits_multicast, counts.solicits_unicast);
+
+    if (counts.delivered != counts.sent) {
+        printf("%-4s %u datagrams never left\n", ND6_BENCH_NAME, counts.sent - counts.delivered);
+        failures++;
+    }
+}
+
+int main(int argc, char **argv) {
+    static const uint steps[] = { 1, 2, 4, 8, 16, 32, ND6_BENCH_PEERS };
+
+    if (argc > 1) {
+        bench_ms = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        bench_minutes = strtoul(argv[2], NULL, 0);
+    }
+
+    wire_init(ND6_BENCH_PEERS);
+    lwip_init();
+
+    netif_add_noaddr(&netif, NULL, bench_netif_init, ethernet_input);
+
+    // a static address, its /64 is on link, without duplicate address detection
+    ip6_addr_t addr;
+
+    IP6_ADDR(&addr, PP_HTONL(0x20010db8), 0, PP_HTONL(0x02000000), PP_HTONL(0x00000015));
+    netif_ip6_addr_set(&netif, 1, &addr);
+    netif_ip6_addr_set_state(&netif, 1, IP6_ADDR_PREFERRED);
+    netif_set_up(&netif);
+
+    pcb = udp_new_ip_type(IPADDR_TYPE_V6);
+    udp_bind(pcb, IP6_ADDR_ANY, 0);
+
+    for (uint i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        bench_output(steps[i]);
+    }
+
+    bench_polls();
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
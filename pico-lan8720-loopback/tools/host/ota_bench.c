@@ -0,0 +1,584 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+#include "lwip/prot/ip4.h"
+
+#include "lwip_ota.h"
+
+#include "bench_wire.h"
+
+// A firmware image pushed to lwip_ota.c over lwIP's TFTP server by a client of a few
+// lines, on a 10 Mbit/s wire in virtual time, into a simulated NOR flash with the
+// W25Q16JV's typical times (page program 0.4 ms, sector erase 45 ms, 64 KB block erase
+// 150 ms). Two flashes:
+//   serial  erase() and program() return when done, the core running lwIP doesn't
+//           receive meanwhile but for the frame RX was armed for (one core, IRQs off)
+//   worker  they return at once and the flash works on its own (the RP2040 backend's
+//           other core), only wait() holds lwIP up, with the RX ring's 4 frames taken
+// and two transfers: stock TFTP (512 byte blocks, one at a time), and blksize 1428 with
+// windowsize 4. The flash takes data in as (NOR) programs can, clearing bits, so a
+// program before its erase or of a buffer written over before the program's end shows
+// in the staged bytes. One line per case: the virtual seconds of the transfer, the
+// image's rate, the ACKs lwip_ota.c held back, the client's retransmits, the frames the
+// board lost while blocked, and how much of the time the flash was busy. Then an image
+// with a bad CRC and one too large for the staging area, which must both be refused.
+// The exit status is 1 when a good image didn't make it or a bad one did, a case stalled
+// or a pbuf is left
+//
+// usage: ota_bench [image KB, default 256]
+
+#define WIRE_SIZE 64
+
+#define LINK_MBIT 10
+// preamble, Ethernet header, FCS and interframe gap around an IP packet
+#define LINK_OVERHEAD 38
+#define LINK_DELAY_US 20
+
+#define PAGE_PROGRAM_US 400
+#define SECTOR_ERASE_US 45000
+#define BLOCK_ERASE_US 150000
+
+#define STAGING_SIZE (1024 * 1024)
+
+#define STEP_US 50
+#define CLIENT_TIMEOUT_US 500000
+#define STALL_US 60000000ull
+
+#define TFTP_WRQ 2
+#define TFTP_DATA 3
+#define TFTP_ACK 4
+#define TFTP_ERROR 5
+#define TFTP_OACK 6
+
+struct wire_packet {
+    struct pbuf *p;
+    uint64_t arrival_us;
+};
+
+// one per direction, 0 to the client and 1 to the board
+struct wire {
+    struct wire_packet packets[WIRE_SIZE];
+    uint32_t head, tail;
+    uint64_t free_us; // the link is sending until then
+};
+
+static struct wire wires[2];
+static uint64_t now_us;
+static uint32_t loss_ppm;
+static uint32_t loss_state = 1;
+static uint failures;
+
+// the board's flash
+static uint8_t staging[STAGING_SIZE];
+static bool flash_worker;
+static uint flash_rx_frames;     // frames received while the board is blocked
+static int flash_op;             // 0 none, 1 erase, 2 program
+static uint32_t flash_offset, flash_len;
+static const uint8_t *flash_data;
+static uint64_t flash_end_us;
+static uint64_t flash_busy_us;
+static uint flash_errors;
+static uint frames_lost;
+static bool committed;
+static struct lwip_ota_header committed_header;
+
+static struct lwip_ota ota;
+
+// the client
+static struct udp_pcb *client_pcb;
+static const uint8_t *client_image;
+static uint32_t client_len;
+static bool client_options;
+static bool client_started;
+static bool client_done;
+static bool client_refused;
+static u16_t client_blksize, client_windowsize;
+static uint32_t client_blocks, client_acked;
+static uint64_t client_sent_us;
+static uint client_retransmits;
+
+// xorshift32, enough for a loss pattern and an image
+static uint32_t bench_random(void) {
+    loss_state ^= loss_state << 13;
+    loss_state ^= loss_state >> 17;
+    loss_state ^= loss_state << 5;
+
+    return loss_state;
+}
+
+// the TFTP opcode of a UDP packet
+static u16_t wire_opcode(struct pbuf *p) {
+    struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+    u16_t hlen = IPH_HL_BYTES(iphdr);
+    u8_t *udp = (u8_t *)p->payload + hlen;
+
+    if (IPH_PROTO(iphdr) != IP_PROTO_UDP || p->len < hlen + 8 + 2) {
+        return 0;
+    }
+
+    return (u16_t)((udp[8] << 8) | udp[9]);
+}
+
+static err_t link_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(netif);
+
+    uint dir = ip4_addr_cmp(ipaddr, netif_ip4_addr(&netif_b)) ? 1 : 0;
+    struct wire *wire = &wires[dir];
+    struct pbuf *q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_POOL);
+
+    if (q == NULL || (wire->head - wire->tail) == WIRE_SIZE) {
+        if (q != NULL) {
+            pbuf_free(q);
+        }
+
+        failures++;
+
+        return ERR_OK;
+    }
+
+    pbuf_copy(q, p);
+
+    // the frame takes the link in any case, only the client's data blocks are lost
+    uint64_t start = (wire->free_us > now_us) ? wire->free_us : now_us;
+
+    wire->free_us = start + (uint64_t)(q->tot_len + LINK_OVERHEAD) * 8 / LINK_MBIT;
+
+    if (dir == 1 && loss_ppm && wire_opcode(q) == TFTP_DATA && (bench_random() % 1000000) < loss_ppm) {
+        pbuf_free(q);
+
+        return ERR_OK;
+    }
+
+    wire->packets[wire->head % WIRE_SIZE].p = q;
+    wire->packets[wire->head % WIRE_SIZE].arrival_us = wire->free_us + LINK_DELAY_US;
+    wire->head++;
+
+    return ERR_OK;
+}
+
+// the board doesn't run until to: of the frames that come in meanwhile, those past
+// what RX takes on its own are lost
+static void board_block(uint64_t to) {
+    struct wire *wire = &wires[1];
+    uint64_t from = now_us;
+    uint taken = 0;
+
+    if (to <= from) {
+        return;
+    }
+
+    for (uint32_t i = wire->tail; i != wire->head; i++) {
+        struct wire_packet *w = &wire->packets[i % WIRE_SIZE];
+
+        if (w->p == NULL || w->arrival_us <= from || w->arrival_us > to) {
+            continue;
+        }
+
+        if (++taken > flash_rx_frames) {
+            pbuf_free(w->p);
+            w->p = NULL;
+            frames_lost++;
+        }
+    }
+
+    now_us = to;
+    now_ms = (u32_t)(now_us / 1000);
+}
+
+// the operation going on ends, its data goes in at the end as the flash takes it
+static void flash_settle(void) {
+    if (flash_op == 0 || now_us < flash_end_us) {
+        return;
+    }
+
+    if (flash_op == 1) {
+        memset(&staging[flash_offset], 0xff, flash_len);
+    } else {
+        for (uint32_t i = 0; i < flash_len; i++) {
+            staging[flash_offset + i] &= flash_data[i];
+        }
+    }
+
+    flash_op = 0;
+}
+
+static void flash_start(int op, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t us) {
+    if (flash_op != 0 || offset + len > STAGING_SIZE) {
+        flash_errors++;
+
+        return;
+    }
+
+    flash_op = op;
+    flash_offset = offset;
+    flash_data = data;
+    flash_len = len;
+    flash_end_us = now_us + us;
+    flash_busy_us += us;
+
+    if (!flash_worker) {
+        board_block(flash_end_us);
+        flash_settle();
+    }
+}
+
+static void flash_erase(u32_t offset, u32_t len) {
+    if ((len == LWIP_OTA_SECTOR_SIZE || len == LWIP_OTA_BLOCK_SIZE) && (offset % len) == 0) {
+        flash_start(1, offset, NULL, len, (len == LWIP_OTA_BLOCK_SIZE) ? BLOCK_ERASE_US : SECTOR_ERASE_US);
+    } else {
+        flash_errors++;
+    }
+}
+
+static void flash_program(u32_t offset, const u8_t *data, u32_t len) {
+    if ((offset % LWIP_OTA_PAGE_SIZE) == 0 && (len % LWIP_OTA_PAGE_SIZE) == 0 && len != 0) {
+        flash_start(2, offset, data, len, (len / LWIP_OTA_PAGE_SIZE) * PAGE_PROGRAM_US);
+    } else {
+        flash_errors++;
+    }
+}
+
+static int flash_busy(void) {
+    flash_settle();
+
+    return flash_op != 0;
+}
+
+static void flash_wait(void) {
+    if (flash_op != 0) {
+        board_block(flash_end_us);
+        flash_settle();
+    }
+}
+
+// the record's sector erased and its page programmed
+static int flash_commit(const struct lwip_ota_header *header) {
+    if (header != NULL) {
+        board_block(now_us + SECTOR_ERASE_US + PAGE_PROGRAM_US);
+        committed = true;
+        committed_header = *header;
+    }
+
+    return 0;
+}
+
+static const struct lwip_ota_flash bench_flash = {
+    STAGING_SIZE,
+    staging,
+    flash_erase,
+    flash_program,
+    flash_busy,
+    flash_wait,
+    flash_commit,
+};
+
+static void client_send(const void *data, u16_t len) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    ip_addr_t board;
+
+    if (p == NULL) {
+        failures++;
+
+        return;
+    }
+
+    memcpy(p->payload, data, len);
+    ip_addr_copy_from_ip4(board, *netif_ip4_addr(&netif_b));
+    udp_sendto(client_pcb, p, &board, 69);
+    pbuf_free(p);
+}
+
+static void client_request(void) {
+    char request[128];
+    int len;
+
+    len = snprintf(request, sizeof(request), "%c%cfirmware.bin%coctet%c", 0, TFTP_WRQ, 0, 0);
+
+    if (client_options) {
+        len += snprintf(&request[len], sizeof(request) - len, "blksize%c1428%cwindowsize%c4%ctsize%c%u%c",
+            0, 0, 0, 0, 0, (uint)client_len, 0);
+    }
+
+    client_send(request, (u16_t)len);
+    client_sent_us = now_us;
+}
+
+static void client_window(void) {
+    static uint8_t block[4 + 1428];
+
+    for (uint32_t n = client_acked + 1; n <= client_blocks && n <= client_acked + client_windowsize; n++) {
+        uint32_t offset = (n - 1) * client_blksize;
+        uint32_t len = (client_len - offset < client_blksize) ? client_len - offset : client_blksize;
+
+        block[0] = 0;
+        block[1] = TFTP_DATA;
+        block[2] = (uint8_t)(n >> 8);
+        block[3] = (uint8_t)n;
+        memcpy(&block[4], &client_image[offset], len);
+        client_send(block, (u16_t)(4 + len));
+    }
+
+    client_sent_us = now_us;
+}
+
+// the value of an option of an OACK, 0 without it
+static u16_t client_option(const char *options, u16_t len, const char *name) {
+    for (u16_t pos = 0; pos < len; ) {
+        const char *option = &options[pos];
+        const char *value = option + strlen(option) + 1;
+
+        if (value >= options + len) {
+            break;
+        }
+
+        if (strcmp(option, name) == 0) {
+            return (u16_t)atoi(value);
+        }
+
+        pos = (u16_t)(value + strlen(value) + 1 - options);
+    }
+
+    return 0;
+}
+
+static void client_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(addr);
+    LWIP_UNUSED_ARG(port);
+
+    char packet[128];
+    u16_t len = pbuf_copy_partial(p, packet, sizeof(packet) - 1, 0);
+    u16_t opcode = (len >= 2) ? (u16_t)((packet[0] << 8) | packet[1]) : 0;
+    u16_t number = (len >= 4) ? (u16_t)(((u8_t)packet[2] << 8) | (u8_t)packet[3]) : 0;
+
+    pbuf_free(p);
+    packet[len] = 0;
+
+    if (client_done) {
+        return;
+    }
+
+    if (opcode == TFTP_ERROR) {
+        client_refused = true;
+        client_done = true;
+
+        return;
+    }
+
+    if (!client_started) {
+        if (opcode == TFTP_OACK) {
+            u16_t blksize = client_option(&packet[2], len - 2, "blksize");
+            u16_t windowsize = client_option(&packet[2], len - 2, "windowsize");
+
+            client_blksize = blksize ? blksize : 512;
+            client_windowsize = windowsize ? windowsize : 1;
+        } else if (opcode != TFTP_ACK || number != 0) {
+            return;
+        }
+
+        client_started = true;
+        client_blocks = client_len / client_blksize + 1;
+        client_window();
+
+        return;
+    }
+
+    if (opcode != TFTP_ACK) {
+        return;
+    }
+
+    // block numbers wrap at 65536, an ACK is for a block of the window sent
+    u16_t ahead = (u16_t)(number - (u16_t)client_acked);
+
+    if (ahead > client_windowsize) {
+        return;
+    }
+
+    client_acked += ahead;
+
+    if (client_acked == client_blocks) {
+        client_done = true;
+
+        return;
+    }
+
+    // a window ACKed, or a block of it lost: the client goes on after the ACKed block
+    client_window();
+}
+
+// STEP_US passes, then what arrived by then is taken
+static void link_run(void) {
+    now_us += STEP_US;
+    now_ms = (u32_t)(now_us / 1000);
+    sys_check_timeouts();
+
+    for (uint dir = 0; dir < 2; dir++) {
+        struct wire *wire = &wires[dir];
+
+        while (wire->tail != wire->head && wire->packets[wire->tail % WIRE_SIZE].arrival_us <= now_us) {
+            struct wire_packet *w = &wire->packets[wire->tail % WIRE_SIZE];
+
+            wire->tail++;
+
+            if (w->p != NULL) {
+                ip4_input(w->p, dir ? &netif_b : &netif_a);
+            }
+        }
+    }
+
+    if (!client_done && (now_us - client_sent_us) >= CLIENT_TIMEOUT_US) {
+        client_retransmits++;
+
+        if (client_started) {
+            client_window();
+        } else {
+            client_request();
+        }
+    }
+}
+
+static void image_fill(uint8_t *image, uint32_t length, bool bad_crc) {
+    struct lwip_ota_header header;
+
+    for (uint32_t i = 0; i < length; i++) {
+        image[sizeof(header) + i] = (uint8_t)bench_random();
+    }
+
+    header.magic = LWIP_OTA_MAGIC;
+    header.length = length;
+    header.crc = lwip_ota_crc32(0, &image[sizeof(header)], length) ^ (bad_crc ? 1 : 0);
+    header.version = 2;
+    memcpy(image, &header, sizeof(header));
+}
+
+// pushes an image of length bytes, which should make it or be refused
+static void bench(const char *name, bool worker, bool options, double loss, uint32_t length, bool bad_crc, bool refused) {
+    struct lwip_ota_header header;
+    uint32_t holds = ota.holds;
+    uint8_t *image = malloc(sizeof(header) + length);
+
+    image_fill(image, length, bad_crc);
+    memcpy(&header, image, sizeof(header));
+
+    // what was staged before, programmed bits that need the erase
+    memset(staging, 0, sizeof(staging));
+
+    flash_worker = worker;
+    flash_rx_frames = worker ? 4 : 1;
+    flash_busy_us = 0;
+    flash_errors = 0;
+    frames_lost = 0;
+    committed = false;
+    loss_ppm = (uint32_t)(loss * 10000);
+
+    client_image = image;
+    client_len = sizeof(header) + length;
+    client_options = options;
+    client_started = false;
+    client_done = false;
+    client_refused = false;
+    client_blksize = 512;
+    client_windowsize = 1;
+    client_acked = 0;
+    client_retransmits = 0;
+
+    uint64_t start = now_us;
+
+    client_request();
+
+    while (!client_done && (now_us - start) < STALL_US) {
+        link_run();
+    }
+
+    double seconds = (now_us - start) / 1e6;
+    bool stalled = !client_done;
+
+    // the wire empty and the server done with the transfer before the next case
+    for (uint64_t close = now_us; (wires[0].tail != wires[0].head || wires[1].tail != wires[1].head ||
+        ota.state == LWIP_OTA_RECEIVING) && (now_us - close) < STALL_US; ) {
+        link_run();
+    }
+
+    bool staged = length <= STAGING_SIZE && memcmp(staging, &image[sizeof(header)], length) == 0;
+    bool ok = refused ? (client_refused && !committed) :
+        (!client_refused && committed && staged && ota.state == LWIP_OTA_DONE &&
+         memcmp(&committed_header, &header, sizeof(header)) == 0);
+
+    printf("%-22s %7.2f s, %4.0f kB/s, %4u held ACKs, %3u retransmits, %3u frames lost, flash busy %3.0f%%%s%s%s\n",
+        name, seconds, (seconds && !refused) ? length / seconds / 1000 : 0.0, (uint)(ota.holds - holds), client_retransmits,
+        frames_lost, seconds ? flash_busy_us / 1e4 / seconds : 0.0, refused ? (client_refused ? ", refused" : "") : "",
+        ok ? "" : ", WRONG", stalled ? ", STALLED" : "");
+
+    if (!ok || stalled || flash_errors) {
+        failures++;
+    }
+
+    free(image);
+}
+
+int main(int argc, char **argv) {
+    uint32_t length = 256 * 1024;
+
+    if (argc > 1) {
+        length = strtoul(argv[1], NULL, 0) * 1024;
+    }
+
+    wire_netif_output = link_output;
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    // the client doesn't bind to an address, it takes the one of the netif lwIP routes
+    // through: the first of the list, the one added last
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    if (lwip_ota_init(&ota, &bench_flash) != ERR_OK) {
+        return 1;
+    }
+
+    client_pcb = udp_new();
+    udp_bind(client_pcb, IP_ADDR_ANY, 5000);
+    udp_recv(client_pcb, client_recv, NULL);
+
+    bench("serial 512 x1", false, false, 0, length, false, false);
+    bench("serial 1428 x4", false, true, 0, length, false, false);
+    bench("worker 512 x1", true, false, 0, length, false, false);
+    bench("worker 1428 x4", true, true, 0, length, false, false);
+    bench("worker 1428 x4 loss 1%", true, true, 1, length, false, false);
+    bench("bad crc", true, true, 0, length, true, true);
+    bench("too large", true, true, 0, STAGING_SIZE + LWIP_OTA_SECTOR_SIZE, false, true);
+
+    udp_remove(client_pcb);
+
+    // all the pbufs the wire held are back
+    if (MEMP_STATS && lwip_stats.memp[MEMP_PBUF_POOL]->used != 0) {
+        printf("%u pool pbufs left\n", (uint)lwip_stats.memp[MEMP_PBUF_POOL]->used);
+        failures++;
+    }
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
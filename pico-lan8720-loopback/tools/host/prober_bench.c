@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/timeouts.h"
+
+#include "lwip_prober.h"
+
+#include "bench_wire.h"
+
+// src/lwip/lwip_prober.c probing a peer on the same stack, ICMP echo answered by lwIP and
+// UDP answered by the prober's responder, in virtual time to the us. The wire holds each
+// frame for its one way delay. Each phase restarts the counters, runs, prints the
+// prober's report and checks it:
+//   clean   200 us round trips, timed exactly
+//   jitter  up to 400 us more each way, the histogram's buckets add up
+//   busy    every read of the timer takes 7 us, as a loaded device's callbacks do: the
+//           UDP round trip leaves the responder's hold out, the ICMP one can't
+//   loss    a frame in 10 dropped, each lost probe counted
+//   stall   the wire stops for 1500 ms, the probes time out and their replies are late
+// The exit status is 1 when a check fails
+//
+// usage: prober_bench [virtual seconds per phase, default 5]
+
+#define ONE_WAY_US 100
+#define JITTER_US 400
+#define READ_US 7
+#define DROP_EVERY 10
+#define STALL_MS 1500
+
+#define WIRE_SIZE 8192
+
+struct link_frame {
+    uint8_t *data;
+    uint16_t len;
+    uint64_t at_us;
+    struct netif *netif; // receiving side
+};
+
+static struct link_frame link_ring[WIRE_SIZE];
+static uint32_t link_head, link_tail;
+
+static uint64_t now_us;
+static uint32_t read_us;
+static uint32_t jitter_us;
+static uint32_t drop_every;
+static uint64_t stall_until_us;
+static uint32_t seed = 1;
+static uint failures;
+
+uint32_t timebase_us(void) {
+    uint32_t us = (uint32_t)now_us;
+
+    now_us += read_us;
+    now_ms = (u32_t)(now_us / 1000);
+
+    return us;
+}
+
+uint32_t timebase_ms(void) {
+    return now_ms;
+}
+
+static uint32_t random_below(uint32_t n) {
+    seed = seed * 1103515245u + 12345u;
+
+    return (seed >> 8) % n;
+}
+
+// kept out of the pools while on the wire, a stall holds thousands of frames
+static err_t link_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(netif);
+
+    if (drop_every != 0 && random_below(drop_every) == 0) {
+        return ERR_OK;
+    }
+
+    if ((link_head - link_tail) == WIRE_SIZE) {
+        failures++;
+
+        return ERR_OK;
+    }
+
+    struct link_frame *w = &link_ring[link_head % WIRE_SIZE];
+    uint64_t at = (stall_until_us > now_us ? stall_until_us : now_us) + ONE_WAY_US;
+
+    if (jitter_us != 0) {
+        at += random_below(jitter_us + 1);
+    }
+
+    // in order, the wire doesn't reorder
+    if (link_head != link_tail && at < link_ring[(link_head - 1) % WIRE_SIZE].at_us) {
+        at = link_ring[(link_head - 1) % WIRE_SIZE].at_us;
+    }
+
+    w->data = malloc(p->tot_len);
+    w->len = p->tot_len;
+    w->at_us = at;
+    w->netif = ip4_addr_cmp(ipaddr, netif_ip4_addr(&netif_a)) ? &netif_a : &netif_b;
+    pbuf_copy_partial(p, w->data, p->tot_len, 0);
+    link_head++;
+
+    return ERR_OK;
+}
+
+// a us passes, then the frames due arrive
+static void link_run(void) {
+    u32_t ms = now_ms;
+
+    now_us++;
+    now_ms = (u32_t)(now_us / 1000);
+
+    if (now_ms != ms) {
+        sys_check_timeouts();
+    }
+
+    while (link_tail != link_head && link_ring[link_tail % WIRE_SIZE].at_us <= now_us) {
+        struct link_frame *w = &link_ring[link_tail % WIRE_SIZE];
+        struct pbuf *p = pbuf_alloc(PBUF_RAW, w->len, PBUF_POOL);
+
+        link_tail++;
+
+        if (p == NULL) {
+            failures++;
+        } else {
+            pbuf_take(p, w->data, w->len);
+            ip4_input(p, w->netif);
+        }
+
+        free(w->data);
+    }
+}
+
+static void run(uint32_t ms) {
+    uint64_t end = now_us + (uint64_t)ms * 1000;
+
+    while (now_us < end) {
+        link_run();
+    }
+}
+
+static void expect(const char *phase, const char *what, bool ok) {
+    if (!ok) {
+        printf("  %s: FAILED %s\n", phase, what);
+        failures++;
+    }
+}
+
+static uint32_t bucket_sum(const struct lwip_prober_stats *s) {
+    uint32_t sum = 0;
+
+    for (int b = 0; b < LWIP_PROBER_BUCKETS; b++) {
+        sum += s->buckets[b];
+    }
+
+    return sum;
+}
+
+static int peers[3];
+
+static void phase(const char *name, uint32_t ms) {
+    printf("%s\n", name);
+
+    for (uint i = 0; i < 3; i++) {
+        lwip_prober_reset(peers[i]);
+    }
+
+    run(ms);
+    lwip_prober_report();
+}
+
+int main(int argc, char **argv) {
+    uint32_t seconds = 5;
+
+    if (argc > 1) {
+        seconds = strtoul(argv[1], NULL, 0);
+    }
+
+    wire_netif_output = link_output;
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    if (lwip_prober_init(NULL) != ERR_OK) {
+        printf("lwip_prober_init failed\n");
+
+        return 1;
+    }
+
+    peers[0] = lwip_prober_add(netif_ip_addr4(&netif_b), LWIP_PROBER_ICMP, 10, 56);
+    peers[1] = lwip_prober_add(netif_ip_addr4(&netif_b), LWIP_PROBER_UDP, 10, 64);
+    peers[2] = lwip_prober_add(netif_ip_addr4(&netif_b), LWIP_PROBER_UDP, 1, 256);
+
+    if (peers[0] < 0 || peers[1] < 0 || peers[2] < 0) {
+        printf("lwip_prober_add failed\n");
+
+        return 1;
+    }
+
+    expect("setup", "a probe smaller than the prober's fields refused",
+           lwip_prober_add(netif_ip_addr4(&netif_b), LWIP_PROBER_UDP, 10, LWIP_PROBER_SIZE_MIN - 1) < 0);
+
+    uint32_t ms = seconds * 1000;
+    struct lwip_prober_stats s[3];
+
+    phase("clean", ms);
+    for (uint i = 0; i < 3; i++) {
+        lwip_prober_get(peers[i], &s[i]);
+        expect("clean", "probes sent at their rate",
+               s[i].sent + 1 >= ms / s[i].interval_ms && s[i].sent <= ms / s[i].interval_ms + 1);
+        expect("clean", "every probe answered", s[i].received + 1 >= s[i].sent && !s[i].lost && !s[i].late && !s[i].unsent);
+        expect("clean", "round trips of 2 one way delays",
+               s[i].min_ns == 2 * ONE_WAY_US * 1000 && s[i].max_ns == 2 * ONE_WAY_US * 1000);
+        expect("clean", "in the [128, 256) us bucket", s[i].buckets[8] == s[i].received);
+    }
+
+    jitter_us = JITTER_US;
+    phase("jitter", ms);
+    for (uint i = 0; i < 3; i++) {
+        lwip_prober_get(peers[i], &s[i]);
+        expect("jitter", "every probe answered", s[i].received + 1 >= s[i].sent && !s[i].lost && !s[i].late);
+        expect("jitter", "round trips within the jitter",
+               s[i].min_ns >= 2 * ONE_WAY_US * 1000 && s[i].max_ns <= 2 * (ONE_WAY_US + JITTER_US) * 1000);
+        expect("jitter", "histogram of every reply", bucket_sum(&s[i]) == s[i].received);
+    }
+    jitter_us = 0;
+
+    // alone on the wire, the others would add their own reads
+    lwip_prober_remove(peers[2]);
+    read_us = READ_US;
+    phase("busy", ms);
+    lwip_prober_get(peers[0], &s[0]);
+    lwip_prober_get(peers[1], &s[1]);
+    // ICMP: the read of the send and 2 one way delays. UDP: the responder's 2 reads on top,
+    // the hold between them taken out, 1 read of the 2
+    expect("busy", "ICMP round trip with the read of the send",
+           s[0].min_ns == (2 * ONE_WAY_US + READ_US) * 1000);
+    expect("busy", "UDP round trip without the responder's hold",
+           s[1].min_ns == (2 * ONE_WAY_US + 2 * READ_US) * 1000);
+    read_us = 0;
+    peers[2] = lwip_prober_add(netif_ip_addr4(&netif_b), LWIP_PROBER_UDP, 1, 256);
+
+    drop_every = DROP_EVERY;
+    phase("loss", ms);
+    for (uint i = 0; i < 3; i++) {
+        lwip_prober_get(peers[i], &s[i]);
+        expect("loss", "lost probes counted", s[i].lost != 0 && !s[i].late);
+        expect("loss", "each probe answered, lost or in flight",
+               s[i].received + s[i].lost <= s[i].sent &&
+               s[i].sent - s[i].received - s[i].lost <= LWIP_PROBER_WINDOW);
+    }
+    drop_every = 0;
+
+    printf("stall\n");
+    for (uint i = 0; i < 3; i++) {
+        lwip_prober_reset(peers[i]);
+    }
+    run(1000);
+    stall_until_us = now_us + STALL_MS * 1000;
+    run(STALL_MS + 1000);
+    lwip_prober_report();
+    for (uint i = 0; i < 3; i++) {
+        lwip_prober_get(peers[i], &s[i]);
+        expect("stall", "probes lost and their replies late", s[i].lost != 0 && s[i].late != 0);
+        expect("stall", "the others answered", s[i].received != 0 && s[i].received + s[i].lost <= s[i].sent);
+    }
+
+    lwip_prober_remove(peers[0]);
+    lwip_prober_remove(peers[1]);
+    lwip_prober_remove(peers[2]);
+    expect("remove", "removed peers have no counters", !lwip_prober_get(peers[0], &s[0]));
+    run(1000);
+
+    printf("%s\n", failures ? "FAILED" : "ok");
+
+    return failures ? 1 : 0;
+}
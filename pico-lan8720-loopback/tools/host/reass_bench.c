@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/memp.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "bench_wire.h"
+
+// large UDP datagrams from data loggers, fragmented by the sending lwIP and reassembled
+// by the board's, over a 100 Mbit/s wire in virtual time. Each logger is a stream that
+// sends its next datagram once the last one is on the wire, and the wire takes a
+// fragment of each stream in turn, so the datagrams of 2 or 4 loggers interleave as
+// they would on a switch. A fragment takes a PBUF_POOL pbuf when it arrives, as the
+// RMII driver does, and is dropped without one. Built with lwIP's pbuf chains and with
+// IP_REASS_CONTIGUOUS, on the balanced profile. The exit status is 1 when a datagram
+// came up wrong or memory was left allocated
+//
+// usage: reass_bench_contiguous [virtual s per case, default 10] [datagram bytes, default 8192] [loss %, default 1]
+//
+// one line per case: loggers, fragment loss, datagrams delivered of those sent, the
+// goodput of what was delivered, the host time of the receiving stack per datagram (not
+// the sender's or the receiver's check), the peak use of the pool and the fragments it had no pbuf for
+
+#define MAX_STREAMS 4
+#define STREAM_FRAMES 64
+#define RECEIVER_PORT 9000
+
+// bytes per ms of 100BASE-TX, and the Ethernet header, FCS, preamble and gap of a frame
+#define WIRE_BYTES_PER_MS 12500
+#define WIRE_FRAME_OVERHEAD 38
+
+struct frame {
+    uint8_t *data;
+    uint16_t len;
+};
+
+// the fragments of a stream's datagram, until the wire takes them
+struct stream {
+    struct frame frames[STREAM_FRAMES];
+    uint head, tail;
+    uint32_t seq;
+};
+
+static struct stream streams[MAX_STREAMS];
+static struct udp_pcb *sender; // one pcb for all of them, the pool of udp pcbs is small
+static uint stream_count;
+static int sending; // the stream stream_output() queues the fragments of
+
+static uint failures;
+static uint32_t bench_s = 10;
+static uint32_t datagram_size = 8192;
+static uint32_t loss_ppm = 10000;
+static uint32_t loss_case_ppm;
+static uint32_t loss_state = 1;
+
+static struct {
+    uint32_t sent;
+    uint32_t delivered;
+    uint32_t fragments;
+    uint32_t lost;
+    uint32_t pool_drops;
+    uint64_t check_ns;
+    uint64_t send_ns;
+} counts;
+
+// xorshift32, the same loss pattern on both builds
+static uint32_t loss_random(void) {
+    loss_state ^= loss_state << 13;
+    loss_state ^= loss_state >> 17;
+    loss_state ^= loss_state << 5;
+
+    return loss_state;
+}
+
+static uint8_t pattern(uint32_t stream, uint32_t seq, uint32_t offset) {
+    return (uint8_t)(stream * 31 + seq * 7 + offset);
+}
+
+static err_t stream_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(netif);
+
+    if (!ip4_addr_cmp(ipaddr, netif_ip4_addr(&netif_b)) || sending < 0) {
+        // the board's ICMP time exceeded, nobody listens
+        return ERR_OK;
+    }
+
+    struct stream *s = &streams[sending];
+    struct frame *f = &s->frames[s->head % STREAM_FRAMES];
+
+    f->data = (s->head - s->tail) < STREAM_FRAMES ? malloc(p->tot_len) : NULL;
+
+    if (f->data == NULL) {
+        failures++;
+
+        return ERR_OK;
+    }
+
+    pbuf_copy_partial(p, f->data, p->tot_len, 0);
+    f->len = p->tot_len;
+    s->head++;
+
+    return ERR_OK;
+}
+
+static void stream_send(uint i) {
+    uint64_t start = now_ns();
+    struct stream *s = &streams[i];
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, datagram_size, PBUF_RAM);
+
+    if (p == NULL) {
+        failures++;
+
+        return;
+    }
+
+    uint8_t *data = p->payload;
+
+    memcpy(data, &i, sizeof(uint32_t));
+    memcpy(data + 4, &s->seq, sizeof(uint32_t));
+
+    for (uint32_t j = 8; j < datagram_size; j++) {
+        data[j] = pattern(i, s->seq, j);
+    }
+
+    sending = i;
+
+    if (udp_sendto_if(sender, p, netif_ip_addr4(&netif_b), RECEIVER_PORT, &netif_a) != ERR_OK) {
+        failures++;
+    }
+
+    sending = -1;
+    s->seq++;
+    counts.sent++;
+
+    pbuf_free(p);
+
+    counts.send_ns += now_ns() - start;
+}
+
+// a ms of the wire, a fragment of each stream in turn; a stream with nothing left
+// sends its next datagram. The frame that runs over the ms is paid for by the next one
+static void streams_run(void) {
+    static int32_t credit;
+    bool moved = true;
+
+    credit += WIRE_BYTES_PER_MS;
+
+    while (credit > 0 && moved) {
+        moved = false;
+
+        for (uint i = 0; i < stream_count && credit > 0; i++) {
+            struct stream *s = &streams[i];
+
+            if (s->head == s->tail) {
+                stream_send(i);
+            }
+
+            if (s->head == s->tail) {
+                continue;
+            }
+
+            struct frame *f = &s->frames[s->tail % STREAM_FRAMES];
+            credit -= f->len + WIRE_FRAME_OVERHEAD;
+            s->tail++;
+            moved = true;
+            counts.fragments++;
+
+            if (loss_case_ppm && (loss_random() % 1000000) < loss_case_ppm) {
+                counts.lost++;
+                free(f->data);
+                continue;
+            }
+
+            // what the receiving driver does: one pool pbuf (chain) per frame, dropped without one
+            struct pbuf *q = pbuf_alloc(PBUF_RAW, f->len, PBUF_POOL);
+
+            if (q == NULL) {
+                counts.pool_drops++;
+                free(f->data);
+                continue;
+            }
+
+            pbuf_take(q, f->data, f->len);
+            free(f->data);
+
+            ip4_input(q, &netif_b);
+        }
+    }
+
+    now_ms++;
+    sys_check_timeouts();
+}
+
+static void receiver_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    uint64_t start = now_ns();
+    uint32_t stream, seq;
+
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(addr);
+    LWIP_UNUSED_ARG(port);
+
+    if (p->tot_len != datagram_size ||
+        pbuf_copy_partial(p, &stream, sizeof(stream), 0) != sizeof(stream) ||
+        pbuf_copy_partial(p, &seq, sizeof(seq), 4) != sizeof(seq) || stream >= stream_count) {
+        failures++;
+        pbuf_free(p);
+
+        return;
+    }
+
+    uint32_t offset = 0;
+
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        const uint8_t *data = q->payload;
+
+        for (u16_t i = 0; i < q->len; i++, offset++) {
+            if (offset >= 8 && data[i] != pattern(stream, seq, offset)) {
+                failures++;
+                pbuf_free(p);
+
+                return;
+            }
+        }
+    }
+
+    counts.delivered++;
+    pbuf_free(p);
+
+    counts.check_ns += now_ns() - start;
+}
+
+static void bench(uint count, uint32_t ppm) {
+    memset(&counts, 0, sizeof(counts));
+    stream_count = count;
+    loss_case_ppm = ppm;
+
+    for (uint i = 0; i < MEMP_MAX; i++) {
+        lwip_stats.memp[i]->max = lwip_stats.memp[i]->used;
+    }
+
+    uint64_t start = now_ns();
+
+    for (uint32_t ms = 0; ms < bench_s * 1000; ms++) {
+        streams_run();
+    }
+
+    uint64_t elapsed = now_ns() - start;
+
+    // the fragments still on the wire aren't counted
+    for (uint i = 0; i < count; i++) {
+        struct stream *s = &streams[i];
+
+        while (s->tail != s->head) {
+            free(s->frames[s->tail++ % STREAM_FRAMES].data);
+        }
+    }
+
+    // and every datagram left half reassembled times out
+    for (uint i = 0; i < (IP_REASS_MAXAGE + 2) * 1000; i++) {
+        now_ms++;
+        sys_check_timeouts();
+    }
+
+    printf("%-10s %u logger%s %4.1f%% loss: %6u of %6u delivered, %5.1f Mbit/s, %6.0f ns/datagram, pool %u/%u, %u no pbuf\n",
+        REASS_BENCH_NAME, count, count > 1 ? "s" : " ", ppm / 10000.0, counts.delivered, counts.sent,
+        (double)counts.delivered * datagram_size * 8 / (bench_s * 1e6),
+        counts.delivered ? (double)(elapsed - counts.check_ns - counts.send_ns) / counts.delivered : 0.0,
+        lwip_stats.memp[MEMP_PBUF_POOL]->max, lwip_stats.memp[MEMP_PBUF_POOL]->avail, counts.pool_drops);
+}
+
+int main(int argc, char **argv) {
+    static const uint steps[] = { 1, 2, 4 };
+
+    if (argc > 1) {
+        bench_s = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        datagram_size = strtoul(argv[2], NULL, 0);
+    }
+
+    if (argc > 3) {
+        loss_ppm = (uint32_t)(strtod(argv[3], NULL) * 10000);
+    }
+
+    if (datagram_size < 8 || datagram_size > 0xffff - 28) {
+        printf("datagram size out of range\n");
+
+        return 1;
+    }
+
+    sending = -1;
+
+    wire_netif_output = stream_output;
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    sender = udp_new();
+    udp_bind(sender, netif_ip_addr4(&netif_a), 7000);
+
+    struct udp_pcb *receiver = udp_new();
+
+    udp_bind(receiver, netif_ip_addr4(&netif_b), RECEIVER_PORT);
+    udp_recv(receiver, receiver_recv, NULL);
+
+    u16_t memp_used[MEMP_MAX];
+
+    for (uint i = 0; i < MEMP_MAX; i++) {
+        memp_used[i] = lwip_stats.memp[i]->used;
+    }
+
+    for (uint i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        bench(steps[i], 0);
+    }
+
+    if (loss_ppm) {
+        for (uint i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+            bench(steps[i], loss_ppm);
+        }
+    }
+
+    for (uint i = 0; i < MEMP_MAX; i++) {
+        if (lwip_stats.memp[i]->used != memp_used[i]) {
+            printf("%s: %u left allocated\n", lwip_stats.memp[i]->name, lwip_stats.memp[i]->used - memp_used[i]);
+            failures++;
+        }
+    }
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
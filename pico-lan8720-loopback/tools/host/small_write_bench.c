@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/tcp.h"
+
+#include "lwip_tcp_writer.h"
+
+#include "bench_wire.h"
+
+// small records (telemetry, log lines) written to a TCP sink a few per virtual ms, one
+// tcp_write() each, sent three ways:
+//   nodelay    tcp_output() after every write with Nagle off, a segment per record
+//   nagle      the same with Nagle on, a small segment waits for the ACK of the last
+//   writer Nms lwip_tcp_writer with a deadline of N ms, a segment per MSS or deadline
+// The wire takes a ms each way. One line per way and record size: the data segments
+// the client sent, their average payload and rate per virtual second (the records come
+// at the same rate in every case), the host time both ends took per record, and the
+// latency of the records from their write to the sink in virtual ms. The exit status
+// is 1 when data came out wrong or a case stalled
+//
+// usage: small_write_bench [records per case, default 20000]
+
+#define RECORDS_PER_MS 4
+#define WIRE_SIZE 256
+
+// virtual ms without progress before a case is given up
+#define STALL_MS 2000
+
+#define SINK_PORT 9
+
+enum mode {
+    MODE_NODELAY,
+    MODE_NAGLE,
+    MODE_WRITER,
+};
+
+static struct tcp_pcb *client;
+static struct lwip_tcp_writer writer;
+static bool connected;
+static uint32_t *written_ms; // when each record was generated
+static uint32_t *latency;
+static uint32_t records = 20000;
+static uint32_t record_size;
+static uint32_t received;
+static uint32_t data_segments, data_bytes;
+static uint failures;
+
+// the TCP payload of the client's segments. Both ends route out of the one netif of
+// their subnet that lwIP finds first, so the client's are told by their source
+static bool wire_count(struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(ipaddr);
+
+    if (p->len < IP_HLEN) {
+        return true;
+    }
+
+    struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+    u16_t hlen = IPH_HL_BYTES(iphdr);
+
+    if (!ip4_addr_cmp(&iphdr->src, netif_ip4_addr(&netif_a)) || IPH_PROTO(iphdr) != IP_PROTO_TCP ||
+        p->len < hlen + TCP_HLEN) {
+        return true;
+    }
+
+    struct tcp_hdr *tcphdr = (struct tcp_hdr *)((u8_t *)p->payload + hlen);
+    u16_t payload = lwip_ntohs(IPH_LEN(iphdr)) - hlen - TCPH_HDRLEN_BYTES(tcphdr);
+
+    if (payload != 0) {
+        data_segments++;
+        data_bytes += payload;
+    }
+
+    return true;
+}
+
+// every byte is its offset in the stream, mod 251. A record is in when its last byte is
+static err_t sink_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        tcp_close(pcb);
+
+        return ERR_OK;
+    }
+
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        for (u16_t i = 0; i < q->len; i++) {
+            if (((uint8_t *)q->payload)[i] != (uint8_t)(received % 251)) {
+                failures++;
+            }
+
+            received++;
+
+            if ((received % record_size) == 0) {
+                uint32_t record = received / record_size - 1;
+
+                latency[record] = now_ms - written_ms[record];
+            }
+        }
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    return ERR_OK;
+}
+
+static err_t sink_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    tcp_recv(pcb, sink_recv);
+
+    return ERR_OK;
+}
+
+static err_t client_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(err);
+
+    connected = true;
+
+    return ERR_OK;
+}
+
+static bool client_open(void) {
+    client = tcp_new();
+    connected = false;
+
+    if (client == NULL) {
+        return false;
+    }
+
+    tcp_bind(client, netif_ip_addr4(&netif_a), 0);
+    tcp_connect(client, netif_ip_addr4(&netif_b), SINK_PORT, client_connected);
+
+    for (uint32_t start = now_ms; !connected && (now_ms - start) < STALL_MS; ) {
+        wire_step();
+    }
+
+    return connected;
+}
+
+static void client_close(void) {
+    tcp_close(client);
+
+    // both ends closed before the next case, TIME_WAIT is left to itself
+    for (uint32_t start = now_ms; tcp_active_pcbs != NULL && (now_ms - start) < STALL_MS; ) {
+        wire_step();
+    }
+}
+
+// false when the send buffer is full, the record is written again the next ms
+static bool client_write(enum mode mode, uint32_t record) {
+    uint8_t buf[256];
+    uint32_t offset = record * record_size;
+
+    for (uint32_t i = 0; i < record_size; i++) {
+        buf[i] = (uint8_t)((offset + i) % 251);
+    }
+
+    if (mode == MODE_WRITER) {
+        return lwip_tcp_writer_write(&writer, buf, (u16_t)record_size) == ERR_OK;
+    }
+
+    if (tcp_write(client, buf, (u16_t)record_size, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+        return false;
+    }
+
+    tcp_output(client);
+
+    return true;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void bench(enum mode mode, u32_t deadline_ms, uint32_t size) {
+    char name[16];
+    uint32_t next = 0;
+    bool stalled = false;
+
+    if (mode == MODE_WRITER) {
+        snprintf(name, sizeof(name), "writer %ums", (uint)deadline_ms);
+    } else {
+        snprintf(name, sizeof(name), "%s", mode == MODE_NAGLE ? "nagle" : "nodelay");
+    }
+
+    record_size = size;
+    received = 0;
+    data_segments = data_bytes = 0;
+
+    if (!client_open()) {
+        printf("%-10s %3u B  connect failed\n", name, (uint)size);
+        failures++;
+
+        return;
+    }
+
+    if (mode == MODE_WRITER) {
+        lwip_tcp_writer_init(&writer, client, deadline_ms);
+    } else if (mode == MODE_NODELAY) {
+        tcp_nagle_disable(client);
+    }
+
+    uint64_t start_ns = now_ns();
+    uint32_t start = now_ms, progress = now_ms, last = 0;
+
+    // RECORDS_PER_MS records come up every ms, the ones that didn't fit wait in order
+    for (uint32_t ms = 0; received < records * size; ms++) {
+        for (uint i = 0; i < RECORDS_PER_MS && (ms * RECORDS_PER_MS + i) < records; i++) {
+            written_ms[ms * RECORDS_PER_MS + i] = now_ms;
+        }
+
+        while (next < records && next < (ms + 1) * RECORDS_PER_MS && client_write(mode, next)) {
+            next++;
+        }
+
+        if (received != last) {
+            last = received;
+            progress = now_ms;
+        } else if ((now_ms - progress) >= STALL_MS) {
+            stalled = true;
+            break;
+        }
+
+        wire_step();
+    }
+
+    uint64_t elapsed_ns = now_ns() - start_ns;
+    uint32_t elapsed_ms = now_ms - start;
+
+    if (mode == MODE_WRITER) {
+        lwip_tcp_writer_detach(&writer);
+    }
+
+    client_close();
+
+    uint32_t done = received / size;
+
+    qsort(latency, done, sizeof(uint32_t), compare_u32);
+
+    printf("%-10s %3u B  %6u segs, %6.1f B/seg, %5.0f segs/s, host %4.0f ns/record, latency p50/p99/max %u/%u/%u ms%s\n",
+        name, (uint)size, (uint)data_segments, data_segments ? (double)data_bytes / data_segments : 0.0,
+        data_segments * 1000.0 / elapsed_ms, (double)elapsed_ns / records, done ? latency[done / 2] : 0,
+        done ? latency[(done * 99) / 100] : 0, done ? latency[done - 1] : 0, stalled ? ", STALLED" : "");
+
+    if (stalled) {
+        failures++;
+    }
+}
+
+int main(int argc, char **argv) {
+    static const uint32_t sizes[] = { 16, 64, 256 };
+
+    if (argc > 1) {
+        records = strtoul(argv[1], NULL, 0);
+    }
+
+    written_ms = calloc(records, sizeof(uint32_t));
+    latency = calloc(records, sizeof(uint32_t));
+
+    if (records == 0 || written_ms == NULL || latency == NULL) {
+        return 1;
+    }
+
+    wire_init(WIRE_SIZE);
+    wire_tap = wire_count;
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    struct tcp_pcb *sink = tcp_new();
+
+    tcp_bind(sink, netif_ip_addr4(&netif_b), SINK_PORT);
+    sink = tcp_listen(sink);
+    tcp_accept(sink, sink_accept);
+
+    for (uint i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench(MODE_NODELAY, 0, sizes[i]);
+        bench(MODE_NAGLE, 0, sizes[i]);
+        bench(MODE_WRITER, 1, sizes[i]);
+        bench(MODE_WRITER, 5, sizes[i]);
+    }
+
+    // a frame the wire dropped is a failure too
+    failures += wire_drops;
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    free(written_ms);
+    free(latency);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/memp.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/priv/tcp_priv.h"
+
+#include "bench_flow.h"
+#include "bench_wire.h"
+
+// bulk TCP uploads from lwIP pcbs on netif_a, the device, to a sink on netif_b, a remote
+// host, in virtual time. The uplink is the shared one of a site: a FIFO of queue KB in
+// front of a link of kbit/s, as a switch port or a modem has, then DELAY_MS each way.
+// The senders are on the throughput profile with LWIP_TCP_CC, under tcp_cc_newreno or
+// tcp_cc_ledbat, alone and two at a time. The queueing delay is what every other packet
+// on the uplink waits behind the uploads, taken as each packet leaves the FIFO, its own
+// time on the link included. The exit status is 1 when a case stalled or memory was
+// left allocated
+//
+// usage: tcp_cc_bench [seconds per case, default 30] [uplink kbit/s, default 1000]
+//                     [queue KB, default 64]
+//
+// one line per case: the goodput of each flow, the share of the link they used, the
+// queueing delay's p50/p95/max in virtual ms and the packets the full FIFO dropped
+
+// propagation each way, a 20 ms round trip without a queue
+#define DELAY_MS 10
+
+// Ethernet header, FCS, preamble and gap of a frame
+#define FRAME_OVERHEAD 38
+
+// packets on the way in one direction, or waiting in the FIFO
+#define LINE_SIZE 1024
+
+// ms of queueing delay counted one by one, the last bucket holds the rest
+#define DELAY_BUCKETS 2048
+
+// virtual ms without progress before a case is given up
+#define STALL_MS 10000
+
+// the flows of a case at most
+#define CASE_FLOWS 2
+
+#define SINK_PORT 5000
+
+static struct wire_line fifo, up, down;
+static uint32_t fifo_bytes, fifo_limit;
+static uint32_t link_bytes_per_ms, link_credit;
+static uint32_t drops;
+static uint32_t delay_hist[DELAY_BUCKETS];
+static uint32_t delay_count;
+
+static uint failures;
+
+static err_t uplink_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(netif);
+
+    bool uplink = ip4_addr_cmp(ipaddr, netif_ip4_addr(&netif_b));
+
+    // tail drop at the FIFO, the way back has room to spare
+    if (uplink && fifo_bytes + p->tot_len > fifo_limit) {
+        drops++;
+
+        return ERR_OK;
+    }
+
+    if (!wire_line_send(uplink ? &fifo : &down, p, uplink ? 0 : DELAY_MS)) {
+        drops++;
+
+        return ERR_OK;
+    }
+
+    if (uplink) {
+        fifo_bytes += p->tot_len;
+    }
+
+    return ERR_OK;
+}
+
+// the link sends the FIFO's packets its ms covers, each once the whole of it is through,
+// then what has arrived is delivered and one ms passes
+static void link_run(void) {
+    link_credit += link_bytes_per_ms;
+
+    while (fifo.tail != fifo.head) {
+        struct wire_frame *frame = &fifo.frames[fifo.tail % fifo.size];
+        uint32_t bytes = frame->len + FRAME_OVERHEAD;
+        uint32_t delay = now_ms - frame->time;
+
+        if (bytes > link_credit) {
+            break;
+        }
+
+        link_credit -= bytes;
+        fifo_bytes -= frame->len;
+        fifo.tail++;
+
+        delay_hist[(delay < DELAY_BUCKETS) ? delay : DELAY_BUCKETS - 1]++;
+        delay_count++;
+
+        if (!wire_line_push(&up, frame->data, frame->len, now_ms + DELAY_MS)) {
+            free(frame->data);
+            drops++;
+        }
+    }
+
+    // an idle link doesn't save up
+    if (fifo.tail == fifo.head) {
+        link_credit = 0;
+    }
+
+    wire_line_deliver(&up, &netif_b);
+    wire_line_deliver(&down, &netif_a);
+
+    now_ms++;
+    sys_check_timeouts();
+}
+
+static uint32_t delay_percentile(uint32_t permille) {
+    uint32_t rank = (uint32_t)((uint64_t)delay_count * permille / 1000);
+    uint32_t seen = 0;
+
+    for (uint32_t i = 0; i < DELAY_BUCKETS; i++) {
+        seen += delay_hist[i];
+
+        if (seen > rank) {
+            return i;
+        }
+    }
+
+    return DELAY_BUCKETS - 1;
+}
+
+static uint32_t delay_max(void) {
+    for (uint32_t i = DELAY_BUCKETS; i > 0; i--) {
+        if (delay_hist[i - 1]) {
+            return i - 1;
+        }
+    }
+
+    return 0;
+}
+
+// count flows under cc[] uploading for seconds of virtual time, all started at once
+static void run_case(const char *name, uint count, const struct tcp_cc_ops *const *cc, uint32_t seconds) {
+    memset(flows, 0, sizeof(flows));
+    memset(delay_hist, 0, sizeof(delay_hist));
+    delay_count = 0;
+    drops = 0;
+    wire_drops = 0;
+    flow_count = count;
+
+    struct tcp_pcb *listener = tcp_new();
+
+    tcp_bind(listener, netif_ip_addr4(&netif_b), SINK_PORT);
+    listener = tcp_listen(listener);
+    tcp_accept(listener, sink_accept);
+
+    for (uint i = 0; i < count; i++) {
+        struct flow *flow = &flows[i];
+
+        flow->pcb = tcp_new();
+        tcp_set_cc(flow->pcb, cc[i]);
+        tcp_arg(flow->pcb, flow);
+        tcp_sent(flow->pcb, flow_sent);
+        tcp_err(flow->pcb, flow_err);
+        tcp_nagle_disable(flow->pcb);
+        tcp_bind(flow->pcb, netif_ip_addr4(&netif_a), 0);
+        tcp_connect(flow->pcb, netif_ip_addr4(&netif_b), SINK_PORT, flow_connected);
+    }
+
+    uint32_t start_ms = now_ms;
+    uint32_t progress_ms = now_ms;
+    uint32_t last = 0;
+    bool stalled = false;
+
+    while ((now_ms - start_ms) < seconds * 1000) {
+        uint32_t total = 0;
+
+        link_run();
+
+        for (uint i = 0; i < count; i++) {
+            flow_send(&flows[i]);
+            total += flows[i].received;
+        }
+
+        if (total != last) {
+            last = total;
+            progress_ms = now_ms;
+        } else if ((now_ms - progress_ms) > STALL_MS) {
+            stalled = true;
+            break;
+        }
+    }
+
+    uint32_t elapsed_ms = now_ms - start_ms;
+    uint32_t total = 0;
+
+    printf("%-16s", name);
+
+    for (uint i = 0; i < count; i++) {
+        printf("%s%4u", i ? "+" : " ", (unsigned)((uint64_t)flows[i].received * 8 / elapsed_ms));
+        total += flows[i].received;
+    }
+
+    printf(" kbit/s%*s link %3u%%  delay p50 %3u p95 %3u max %3u ms  %u drops%s\n", (int)(CASE_FLOWS - count) * 5, "",
+        (unsigned)((uint64_t)total * 100 / ((uint64_t)link_bytes_per_ms * elapsed_ms)), delay_percentile(500),
+        delay_percentile(950), delay_max(), drops + wire_drops, stalled ? ", STALLED" : "");
+
+    if (stalled) {
+        failures++;
+    }
+
+    // reset both ends, drain the lines and let the pcbs go
+    for (uint i = 0; i < count; i++) {
+        if (flows[i].pcb != NULL) {
+            tcp_abort(flows[i].pcb);
+            flows[i].pcb = NULL;
+        }
+    }
+
+    for (uint32_t ms = 0; ms < 5000; ms++) {
+        link_run();
+    }
+
+    for (uint i = 0; i < count; i++) {
+        if (flows[i].sink != NULL) {
+            tcp_abort(flows[i].sink);
+            flows[i].sink = NULL;
+        }
+    }
+
+    tcp_close(listener);
+
+    for (uint32_t ms = 0; ms < 1000; ms++) {
+        link_run();
+    }
+}
+
+int main(int argc, char **argv) {
+    static const struct tcp_cc_ops *const newreno[] = { &tcp_cc_newreno, &tcp_cc_newreno };
+    static const struct tcp_cc_ops *const ledbat[] = { &tcp_cc_ledbat, &tcp_cc_ledbat };
+    static const struct tcp_cc_ops *const mixed[] = { &tcp_cc_ledbat, &tcp_cc_newreno };
+    uint32_t seconds = 30;
+    uint32_t kbps = 1000;
+
+    fifo_limit = 64 * 1024;
+
+    if (argc > 1) {
+        seconds = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        kbps = strtoul(argv[2], NULL, 0);
+    }
+
+    if (argc > 3) {
+        fifo_limit = strtoul(argv[3], NULL, 0) * 1024;
+    }
+
+    link_bytes_per_ms = kbps / 8;
+
+    if (seconds == 0 || link_bytes_per_ms == 0 || fifo_limit < TCP_MSS) {
+        printf("usage: tcp_cc_bench [seconds] [uplink kbit/s, 8 or more] [queue KB, 2 or more]\n");
+
+        return 2;
+    }
+
+    wire_line_init(&fifo, LINE_SIZE);
+    wire_line_init(&up, LINE_SIZE);
+    wire_line_init(&down, LINE_SIZE);
+    wire_netif_output = uplink_output;
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    mem_size_t heap_used = lwip_stats.mem.used;
+    u16_t memp_used[MEMP_MAX];
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        memp_used[i] = lwip_stats.memp[i]->used;
+    }
+
+    printf("%u kbit/s uplink, %u KB queue, %u ms round trip, ledbat target %u ms, %u s per case\n", (unsigned)kbps,
+        (unsigned)(fifo_limit / 1024), 2 * DELAY_MS, TCP_CC_LEDBAT_TARGET_MS, (unsigned)seconds);
+
+    run_case("newreno", 1, newreno, seconds);
+    run_case("ledbat", 1, ledbat, seconds);
+    run_case("newreno+newreno", 2, newreno, seconds);
+    run_case("ledbat+ledbat", 2, ledbat, seconds);
+    run_case("ledbat+newreno", 2, mixed, seconds);
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        if (lwip_stats.memp[i]->used != memp_used[i]) {
+            printf("%s: %u left allocated\n", lwip_stats.memp[i]->name, lwip_stats.memp[i]->used - memp_used[i]);
+            failures++;
+        }
+    }
+
+    if (lwip_stats.mem.used != heap_used) {
+        printf("HEAP: %u bytes left allocated\n", (unsigned)(lwip_stats.mem.used - heap_used));
+        failures++;
+    }
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
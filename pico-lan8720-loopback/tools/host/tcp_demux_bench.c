@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+
+#include "bench_wire.h"
+
+// times lwIP's TCP input with more and more open connections: every connection echoes a
+// small message per round, all of them in turn, so the segments of one connection never
+// arrive back to back and the move to front of tcp_active_pcbs doesn't help. Built once
+// with the linear search and once with LWIP_TCP_PCB_HASH, the time per segment should
+// grow with the connections for the first and stay flat for the second. The clients'
+// input is the half timed: their connections all go to one server ip:port, as the
+// firmware's own do, and only the local port tells them apart in the table. The exit
+// status is 1 when an echo came back wrong or a round stalled
+//
+// usage: tcp_demux_bench_hash [ms per step, default 200]
+//
+// one line per step: demux, open connections (both ends of each are pcbs in the same
+// stack), time per segment into the clients and segments per second of host time
+
+#define MAX_CONNECTIONS LWIP_HOST_CONNECTIONS
+#define MESSAGE_SIZE 64
+#define WIRE_SIZE (8 * MAX_CONNECTIONS)
+
+// virtual ms without an echo before a round is given up
+#define STALL_MS 1000
+
+struct connection {
+    struct tcp_pcb *client;
+    uint32_t sent;
+    uint32_t received;
+    bool connected;
+};
+
+static struct connection connections[MAX_CONNECTIONS];
+static uint connection_count;
+static uint failures;
+static uint32_t bench_ms = 200;
+static uint64_t client_ns;
+static uint32_t client_segments;
+
+// netif_a's input, the clients' side, timed
+static err_t client_input(struct pbuf *p, struct netif *netif) {
+    uint64_t start = now_ns();
+    err_t err = ip4_input(p, netif);
+
+    client_ns += now_ns() - start;
+    client_segments++;
+
+    return err;
+}
+
+static err_t server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        tcp_close(pcb);
+
+        return ERR_OK;
+    }
+
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        if (tcp_write(pcb, q->payload, q->len, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            failures++;
+        }
+    }
+
+    tcp_output(pcb);
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    return ERR_OK;
+}
+
+static err_t server_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    LWIP_UNUSED_ARG(arg);
+
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+
+    tcp_recv(pcb, server_recv);
+    tcp_nagle_disable(pcb);
+
+    return ERR_OK;
+}
+
+// every byte of connection i is i
+static err_t client_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    struct connection *c = arg;
+    uint8_t expected = (uint8_t)(c - connections);
+
+    LWIP_UNUSED_ARG(err);
+
+    if (p == NULL) {
+        failures++;
+
+        return ERR_OK;
+    }
+
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        for (u16_t i = 0; i < q->len; i++) {
+            if (((uint8_t *)q->payload)[i] != expected) {
+                failures++;
+                break;
+            }
+        }
+    }
+
+    c->received += p->tot_len;
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    return ERR_OK;
+}
+
+static err_t client_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    struct connection *c = arg;
+
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(err);
+
+    c->connected = true;
+
+    return ERR_OK;
+}
+
+static bool connection_open(struct connection *c) {
+    c->client = tcp_new();
+
+    if (c->client == NULL) {
+        return false;
+    }
+
+    tcp_arg(c->client, c);
+    tcp_recv(c->client, client_recv);
+    tcp_nagle_disable(c->client);
+    tcp_bind(c->client, netif_ip_addr4(&netif_a), 0);
+    tcp_connect(c->client, netif_ip_addr4(&netif_b), 5000, client_connected);
+
+    for (uint32_t start = now_ms; !c->connected && (now_ms - start) < STALL_MS; ) {
+        wire_run();
+    }
+
+    return c->connected;
+}
+
+// one message on every connection, then the wire runs until all of them are back
+static bool round_run(void) {
+    uint8_t buf[MESSAGE_SIZE];
+
+    for (uint i = 0; i < connection_count; i++) {
+        struct connection *c = &connections[i];
+
+        memset(buf, i, sizeof(buf));
+
+        if (tcp_write(c->client, buf, sizeof(buf), TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            return false;
+        }
+
+        tcp_output(c->client);
+        c->sent += sizeof(buf);
+    }
+
+    uint32_t start = now_ms;
+
+    for (uint i = 0; i < connection_count; ) {
+        if (connections[i].received == connections[i].sent) {
+            i++;
+        } else if ((now_ms - start) < STALL_MS) {
+            wire_run();
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void bench(uint count) {
+    while (connection_count < count) {
+        if (!connection_open(&connections[connection_count])) {
+            printf("%-5s %4u conn: connect failed\n", DEMUX_BENCH_NAME, connection_count + 1);
+            failures++;
+
+            return;
+        }
+
+        connection_count++;
+    }
+
+    // the timing starts with every pcb in place and the handshakes' segments gone
+    wire_run();
+    wire_packets = 0;
+    wire_drops = 0;
+    client_ns = 0;
+    client_segments = 0;
+
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+    bool stalled = false;
+
+    do {
+        if (!round_run()) {
+            stalled = true;
+            break;
+        }
+
+        elapsed = now_ns() - start;
+    } while (elapsed < bench_ms * 1000000ull);
+
+    elapsed = now_ns() - start;
+
+    printf("%-5s %4u conn %8.1f ns/seg %10.0f seg/s, %u drop%s\n", DEMUX_BENCH_NAME, count,
+        client_segments ? (double)client_ns / client_segments : 0.0, wire_packets * 1e9 / elapsed, wire_drops,
+        stalled ? ", STALLED" : "");
+
+    if (stalled) {
+        failures++;
+    }
+}
+
+int main(int argc, char **argv) {
+    static const uint steps[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    if (argc > 1) {
+        bench_ms = strtoul(argv[1], NULL, 0);
+    }
+
+    wire_init(WIRE_SIZE);
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, client_input);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    struct tcp_pcb *listener = tcp_new();
+
+    tcp_bind(listener, netif_ip_addr4(&netif_b), 5000);
+    listener = tcp_listen(listener);
+    tcp_accept(listener, server_accept);
+
+    for (uint i = 0; i < sizeof(steps) / sizeof(steps[0]) && steps[i] <= MAX_CONNECTIONS; i++) {
+        bench(steps[i]);
+    }
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
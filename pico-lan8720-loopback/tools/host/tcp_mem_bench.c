@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/memp.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/prot/ip.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/tcp.h"
+#include "lwip/stats.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/priv/tcp_priv.h"
+
+#include "bench_flow.h"
+#include "bench_wire.h"
+
+// bulk TCP transfers between lwIP pcbs on netif_a, the device, and netif_b, a remote host,
+// in virtual time, and one connection that misbehaves next to them on the balanced
+// profile. Received frames take a PBUF_POOL pbuf each, as the driver's do, which is the
+// memory the device's connections share. In the upload cases three clients upload to the
+// device, and in "+hold" a fourth sends small segments to a server that never reads them:
+// it keeps every pbuf they came in. In the download cases the device sends to three
+// clients, and in "+silent" it also sends small writes to a fourth that goes away after
+// a second, so that they stay queued. Built with LWIP_TCP_MEM_SHARE off and on. The
+// remote host's pcbs have caps of their own (they stand for another machine's memory).
+// The exit status is 1 when a case collapsed with LWIP_TCP_MEM_SHARE, or memory was left
+// allocated
+//
+// usage: tcp_mem_bench [seconds per case, default 10]
+//
+// one line per case: the goodput of the three bulk flows and of them together, that in
+// percent of the case without the fourth connection, and the frames dropped for an empty
+// pool. With LWIP_TCP_MEM_SHARE the windows closed, the segments dropped and the writes
+// refused at a share follow
+
+// propagation each way
+#define DELAY_MS 1
+
+// packets on the way in one direction
+#define LINE_SIZE 1024
+
+// virtual ms without progress of the bulk flows before a case is given up
+#define STALL_MS 5000
+
+// the writes of the fourth connection, and when the silent one's peer goes away
+#define SMALL_WRITE 32
+#define SILENT_AFTER_MS 1000
+
+// segments a sender of the remote host queues, the remote host and the device share one
+// pool of them here and the device's SYN-ACKs need some
+#define REMOTE_QUEUELEN 3
+
+#define BULK_FLOWS 3
+#define SINK_PORT 5000
+
+enum flow_kind {
+    FLOW_BULK,
+    FLOW_HOLD,   // the receiver keeps what it is given
+    FLOW_SILENT, // the receiver goes away
+};
+
+static struct wire_line up, down;
+static uint16_t silent_port;
+static uint32_t silent_from;
+
+static bool upload;
+
+static uint failures;
+
+// a packet of the silent connection once its peer has gone
+static bool wire_silenced(struct pbuf *p) {
+    uint8_t head[IP_HLEN_MAX + TCP_HLEN];
+    uint16_t len = pbuf_copy_partial(p, head, sizeof(head), 0);
+
+    if (silent_port == 0 || (int32_t)(now_ms - silent_from) < 0 || len < IP_HLEN + TCP_HLEN) {
+        return false;
+    }
+
+    uint16_t hlen = (head[0] & 0x0f) * 4;
+
+    if (head[9] != IP_PROTO_TCP || len < hlen + TCP_HLEN) {
+        return false;
+    }
+
+    uint16_t src = (head[hlen] << 8) | head[hlen + 1];
+    uint16_t dst = (head[hlen + 2] << 8) | head[hlen + 3];
+
+    return src == silent_port || dst == silent_port;
+}
+
+static err_t line_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr) {
+    LWIP_UNUSED_ARG(netif);
+
+    if (wire_silenced(p)) {
+        return ERR_OK;
+    }
+
+    wire_line_send(ip4_addr_cmp(ipaddr, netif_ip4_addr(&netif_b)) ? &up : &down, p, DELAY_MS);
+
+    return ERR_OK;
+}
+
+static void lines_run(void) {
+    wire_line_deliver(&up, &netif_b);
+    wire_line_deliver(&down, &netif_a);
+
+    now_ms++;
+    sys_check_timeouts();
+}
+
+// the remote host's pcbs don't draw on the device's shares
+static void remote_limit(struct tcp_pcb *pcb) {
+#if LWIP_TCP_MEM_SHARE
+    tcp_set_mem_limit(pcb, PBUF_POOL_SIZE, TCP_SND_QUEUELEN);
+#else
+    LWIP_UNUSED_ARG(pcb);
+#endif
+}
+
+// a download's sinks are the remote host's pcbs
+static err_t remote_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    err_t ret = sink_accept(arg, pcb, err);
+
+    if (ret == ERR_OK && !upload) {
+        remote_limit(pcb);
+    }
+
+    return ret;
+}
+
+static struct tcp_pcb *listen_on(struct netif *netif) {
+    struct tcp_pcb *listener = tcp_new();
+
+    tcp_bind(listener, netif_ip_addr4(netif), SINK_PORT);
+    listener = tcp_listen(listener);
+    tcp_accept(listener, remote_accept);
+
+    return listener;
+}
+
+// BULK_FLOWS bulk transfers and the fourth connection of kind, for seconds of virtual
+// time. The bulk goodput in kbit/s
+static uint32_t run_case(const char *name, bool up_dir, enum flow_kind kind, uint32_t seconds, uint32_t baseline) {
+    struct netif *local = up_dir ? &netif_b : &netif_a;
+    struct netif *remote = up_dir ? &netif_a : &netif_b;
+
+    memset(flows, 0, sizeof(flows));
+    wire_drops = 0;
+    silent_port = 0;
+    upload = up_dir;
+    flow_count = BULK_FLOWS + (kind != FLOW_BULK);
+
+#if LWIP_TCP_MEM_SHARE
+    struct tcp_mem_stats before, after;
+
+    tcp_mem_get_stats(&before);
+#endif
+
+    struct tcp_pcb *listener = listen_on(remote);
+
+    for (uint i = 0; i < flow_count; i++) {
+        struct flow *flow = &flows[i];
+
+        if (i >= BULK_FLOWS) {
+            flow->write_size = SMALL_WRITE;
+            flow->hold = (kind == FLOW_HOLD);
+        }
+
+        if (up_dir) {
+            flow->queuelen = REMOTE_QUEUELEN;
+        }
+
+        flow->pcb = tcp_new();
+        tcp_arg(flow->pcb, flow);
+        tcp_sent(flow->pcb, flow_sent);
+        tcp_err(flow->pcb, flow_err);
+        tcp_nagle_disable(flow->pcb);
+        tcp_bind(flow->pcb, netif_ip_addr4(local), 0);
+
+        if (up_dir) {
+            remote_limit(flow->pcb);
+        }
+
+        tcp_connect(flow->pcb, netif_ip_addr4(remote), SINK_PORT, flow_connected);
+
+        if (i >= BULK_FLOWS && kind == FLOW_SILENT) {
+            silent_port = flow->pcb->local_port;
+            silent_from = now_ms + SILENT_AFTER_MS;
+        }
+    }
+
+    uint32_t start_ms = now_ms;
+    uint32_t progress_ms = now_ms;
+    uint32_t last = 0;
+    bool collapsed = false;
+
+    while ((now_ms - start_ms) < seconds * 1000) {
+        uint32_t total = 0;
+
+        lines_run();
+
+        for (uint i = 0; i < flow_count; i++) {
+            flow_send(&flows[i]);
+
+            if (i < BULK_FLOWS) {
+                total += flows[i].received;
+            }
+        }
+
+        if (total != last) {
+            last = total;
+            progress_ms = now_ms;
+        } else if ((now_ms - progress_ms) > STALL_MS) {
+            collapsed = true;
+            break;
+        }
+    }
+
+    // a collapsed case counts its whole time
+    uint32_t elapsed_ms = collapsed ? seconds * 1000 : now_ms - start_ms;
+    uint32_t total = 0;
+
+    printf("%-16s", name);
+
+    for (uint i = 0; i < BULK_FLOWS; i++) {
+        printf("%s%6u", i ? "+" : " ", (unsigned)((uint64_t)flows[i].received * 8 / elapsed_ms));
+        total += flows[i].received;
+    }
+
+    uint32_t kbps = (uint32_t)((uint64_t)total * 8 / elapsed_ms);
+
+    printf(" = %6u kbit/s", (unsigned)kbps);
+
+    if (baseline) {
+        printf(" %3u%%", (unsigned)((uint64_t)kbps * 100 / baseline));
+    } else {
+        printf("     ");
+    }
+
+    printf("  %5u pool drops", (unsigned)wire_drops);
+
+#if LWIP_TCP_MEM_SHARE
+    tcp_mem_get_stats(&after);
+
+    printf("  share rx %u tx %u: %u closed %u dropped %u refused", after.rx_share, after.tx_share,
+        (unsigned)(after.rx_closed - before.rx_closed), (unsigned)(after.rx_dropped - before.rx_dropped),
+        (unsigned)(after.tx_refused - before.tx_refused));
+
+    if (collapsed) {
+        failures++;
+    }
+#endif
+
+    printf("%s\n", collapsed ? ", COLLAPSED" : "");
+
+    // the held pbufs go back first, the resets need the pool; then both ends are reset,
+    // the lines drained and the pcbs let go
+    for (uint i = 0; i < flow_count; i++) {
+        if (flows[i].held != NULL) {
+            pbuf_free(flows[i].held);
+            flows[i].held = NULL;
+        }
+    }
+
+    silent_port = 0;
+
+    for (uint i = 0; i < flow_count; i++) {
+        if (flows[i].pcb != NULL) {
+            tcp_abort(flows[i].pcb);
+            flows[i].pcb = NULL;
+        }
+    }
+
+    for (uint32_t ms = 0; ms < 1000; ms++) {
+        lines_run();
+    }
+
+    for (uint i = 0; i < flow_count; i++) {
+        if (flows[i].sink != NULL) {
+            tcp_abort(flows[i].sink);
+            flows[i].sink = NULL;
+        }
+    }
+
+    tcp_close(listener);
+
+    for (uint32_t ms = 0; ms < 1000; ms++) {
+        lines_run();
+    }
+
+    return kbps;
+}
+
+int main(int argc, char **argv) {
+    uint32_t seconds = 10;
+
+    if (argc > 1) {
+        seconds = strtoul(argv[1], NULL, 0);
+    }
+
+    if (seconds == 0) {
+        printf("usage: tcp_mem_bench [seconds]\n");
+
+        return 2;
+    }
+
+    wire_line_init(&up, LINE_SIZE);
+    wire_line_init(&down, LINE_SIZE);
+    wire_netif_output = line_output;
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    mem_size_t heap_used = lwip_stats.mem.used;
+    u16_t memp_used[MEMP_MAX];
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        memp_used[i] = lwip_stats.memp[i]->used;
+    }
+
+    printf("LWIP_TCP_MEM_SHARE=%d, %u pool pbufs, %u TCP segments, %u ms round trip, %u s per case\n",
+        LWIP_TCP_MEM_SHARE, PBUF_POOL_SIZE, MEMP_NUM_TCP_SEG, 2 * DELAY_MS, (unsigned)seconds);
+
+    uint32_t up_kbps = run_case("upload", true, FLOW_BULK, seconds, 0);
+
+    run_case("upload+hold", true, FLOW_HOLD, seconds, up_kbps);
+
+    uint32_t down_kbps = run_case("download", false, FLOW_BULK, seconds, 0);
+
+    run_case("download+silent", false, FLOW_SILENT, seconds, down_kbps);
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        if (lwip_stats.memp[i]->used != memp_used[i]) {
+            printf("%s: %u left allocated\n", lwip_stats.memp[i]->name, lwip_stats.memp[i]->used - memp_used[i]);
+            failures++;
+        }
+    }
+
+    if (lwip_stats.mem.used != heap_used) {
+        printf("HEAP: %u bytes left allocated\n", (unsigned)(lwip_stats.mem.used - heap_used));
+        failures++;
+    }
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
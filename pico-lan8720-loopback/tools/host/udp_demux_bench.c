@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+#include "bench_wire.h"
+
+// times lwIP's UDP input with more and more bound pcbs: a client sends a small datagram
+// to every echo pcb per round, all of them in turn, so the datagrams for one pcb never
+// arrive back to back and the move to front of udp_pcbs doesn't help. Built once with the
+// linear search and once with LWIP_UDP_PCB_HASH, the time per datagram should grow with
+// the pcbs for the first and stay flat for the second.
+//
+// Both builds first check which pcb gets a datagram when several match: a connected pcb
+// before the unconnected ones, of those the one bound to the address before the wildcard,
+// ports that share a bucket, and a pcb bound again to another port. The exit status is 1
+// when a check fails, an echo came back wrong or a round stalled
+//
+// usage: udp_demux_bench_hash [ms per step, default 200]
+//
+// one line per step: demux, bound echo pcbs, time per datagram and datagrams per second
+// of host time
+
+#define MAX_PCBS LWIP_HOST_UDP_PCBS
+#define MESSAGE_SIZE 64
+#define WIRE_SIZE (4 * MAX_PCBS)
+
+#define ECHO_PORT 5000
+#define CLIENT_PORT 4000
+#define CHECK_PORT 7000
+
+// virtual ms without an echo before a round is given up
+#define STALL_MS 1000
+
+static struct udp_pcb *client;
+static struct udp_pcb *echoes[MAX_PCBS];
+static uint32_t sent[MAX_PCBS], received[MAX_PCBS];
+static uint echo_count;
+static uint failures;
+static uint32_t bench_ms = 200;
+
+static void echo_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    LWIP_UNUSED_ARG(arg);
+
+    if (udp_sendto(pcb, p, addr, port) != ERR_OK) {
+        failures++;
+    }
+
+    pbuf_free(p);
+}
+
+// every byte sent to echo pcb i is i
+static void client_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    uint i = port - ECHO_PORT;
+
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(addr);
+
+    if (i >= echo_count || p->tot_len != MESSAGE_SIZE) {
+        failures++;
+        pbuf_free(p);
+
+        return;
+    }
+
+    for (u16_t j = 0; j < p->tot_len; j++) {
+        if (pbuf_get_at(p, j) != (uint8_t)i) {
+            failures++;
+            break;
+        }
+    }
+
+    received[i]++;
+    pbuf_free(p);
+}
+
+static bool send_to(struct udp_pcb *pcb, u16_t port, uint8_t fill) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, MESSAGE_SIZE, PBUF_RAM);
+
+    if (p == NULL) {
+        return false;
+    }
+
+    memset(p->payload, fill, MESSAGE_SIZE);
+
+    err_t err = udp_sendto(pcb, p, netif_ip_addr4(&netif_b), port);
+
+    pbuf_free(p);
+
+    return err == ERR_OK;
+}
+
+// one datagram to every echo pcb, then the wire runs until all of them are back
+static bool round_run(void) {
+    for (uint i = 0; i < echo_count; i++) {
+        if (!send_to(client, ECHO_PORT + i, (uint8_t)i)) {
+            return false;
+        }
+
+        sent[i]++;
+    }
+
+    uint32_t start = now_ms;
+
+    for (uint i = 0; i < echo_count; ) {
+        if (received[i] == sent[i]) {
+            i++;
+        } else if ((now_ms - start) < STALL_MS) {
+            wire_run();
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void bench(uint count) {
+    while (echo_count < count) {
+        struct udp_pcb *pcb = udp_new();
+
+        if (pcb == NULL || udp_bind(pcb, netif_ip_addr4(&netif_b), ECHO_PORT + echo_count) != ERR_OK) {
+            printf("%-5s %4u pcbs: bind failed\n", DEMUX_BENCH_NAME, echo_count + 1);
+            failures++;
+
+            return;
+        }
+
+        udp_recv(pcb, echo_recv, NULL);
+        echoes[echo_count++] = pcb;
+    }
+
+    wire_packets = 0;
+    wire_drops = 0;
+
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+    bool stalled = false;
+
+    do {
+        if (!round_run()) {
+            stalled = true;
+            break;
+        }
+
+        elapsed = now_ns() - start;
+    } while (elapsed < bench_ms * 1000000ull);
+
+    elapsed = now_ns() - start;
+
+    printf("%-5s %4u pcbs %8.1f ns/dgram %10.0f dgram/s, %u drop%s\n", DEMUX_BENCH_NAME, count,
+        wire_packets ? (double)elapsed / wire_packets : 0.0, wire_packets * 1e9 / elapsed, wire_drops,
+        stalled ? ", STALLED" : "");
+
+    if (stalled) {
+        failures++;
+    }
+}
+
+// the check pcbs note in got which of them the last datagram reached
+static struct udp_pcb *got;
+
+static void check_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(addr);
+    LWIP_UNUSED_ARG(port);
+
+    got = pcb;
+    pbuf_free(p);
+}
+
+static struct udp_pcb *check_pcb(const ip_addr_t *addr, u16_t port) {
+    struct udp_pcb *pcb = udp_new();
+
+    ip_set_option(pcb, SOF_REUSEADDR);
+    udp_bind(pcb, addr, port);
+    if (ip_addr_cmp(addr, netif_ip_addr4(&netif_a))) {
+        // both netifs are on the subnet, the route would take the other one
+        udp_bind_netif(pcb, &netif_a);
+    }
+    udp_recv(pcb, check_recv, NULL);
+
+    return pcb;
+}
+
+static void expect(const char *what, struct udp_pcb *from, u16_t port, struct udp_pcb *pcb) {
+    got = NULL;
+
+    if (!send_to(from, port, 0)) {
+        failures++;
+    }
+
+    wire_run();
+
+    if (got != pcb) {
+        printf("%-5s check: FAILED %s\n", DEMUX_BENCH_NAME, what);
+        failures++;
+    }
+}
+
+static void check(void) {
+    struct udp_pcb *from = check_pcb(netif_ip_addr4(&netif_a), CLIENT_PORT + 1);
+    struct udp_pcb *other = check_pcb(netif_ip_addr4(&netif_a), CLIENT_PORT + 2);
+
+    // udp_pcbs has the newest first: the wildcard comes before the address and the
+    // connected pcb before both
+    struct udp_pcb *specific = check_pcb(netif_ip_addr4(&netif_b), CHECK_PORT);
+    struct udp_pcb *any = check_pcb(IP4_ADDR_ANY, CHECK_PORT);
+    struct udp_pcb *connected = check_pcb(IP4_ADDR_ANY, CHECK_PORT);
+    struct udp_pcb *shared = check_pcb(netif_ip_addr4(&netif_b), CHECK_PORT + UDP_PCB_HASH_SIZE);
+
+    udp_connect(connected, netif_ip_addr4(&netif_a), CLIENT_PORT + 1);
+
+    expect("a connected pcb before the unconnected ones", from, CHECK_PORT, connected);
+    expect("a pcb bound to the address before the wildcard", other, CHECK_PORT, specific);
+    expect("a port of the same bucket", other, CHECK_PORT + UDP_PCB_HASH_SIZE, shared);
+
+    udp_remove(specific);
+    expect("the wildcard once the address is gone", other, CHECK_PORT, any);
+
+    udp_bind(any, IP4_ADDR_ANY, CHECK_PORT + 1);
+    expect("a pcb at the port it is bound to again", other, CHECK_PORT + 1, any);
+    expect("nothing at its old port", other, CHECK_PORT, NULL);
+
+    udp_remove(any);
+    udp_remove(connected);
+    udp_remove(shared);
+    udp_remove(other);
+    udp_remove(from);
+}
+
+int main(int argc, char **argv) {
+    static const uint steps[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    if (argc > 1) {
+        bench_ms = strtoul(argv[1], NULL, 0);
+    }
+
+    wire_init(WIRE_SIZE);
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    netif_add(&netif_a, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+    IP4_ADDR(&addr, 192, 168, 1, 2);
+    netif_add(&netif_b, &addr, &mask, IP4_ADDR_ANY4, NULL, wire_netif_init, ip4_input);
+
+    check();
+
+    client = udp_new();
+    udp_bind(client, netif_ip_addr4(&netif_a), CLIENT_PORT);
+    udp_bind_netif(client, &netif_a);
+    udp_recv(client, client_recv, NULL);
+
+    for (uint i = 0; i < sizeof(steps) / sizeof(steps[0]) && steps[i] <= MAX_PCBS; i++) {
+        bench(steps[i]);
+    }
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
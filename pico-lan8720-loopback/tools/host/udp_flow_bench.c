@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/etharp.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/prot/etharp.h"
+#include "lwip/prot/iana.h"
+#include "lwip/prot/ethernet.h"
+#include "netif/ethernet.h"
+
+#include "lwip_udp_flow.h"
+
+#include "bench_wire.h"
+
+// src/lwip/lwip_udp_flow.c against udp_sendto() on an Ethernet netif whose linkoutput
+// takes the frames, with a peer on the subnet and a gateway that answer ARP requests a
+// ms later. First the checks:
+//   frames   a flow's frames are udp_sendto()'s but for the IP ID, both checksums good
+//   mac      the peer's MAC changes (gratuitous ARP), the next frame goes to the new one
+//   gone     the ARP table is flushed: udp_sendto() queries it, then the template again
+//   gateway  a peer off the subnet gets the gateway's MAC
+//   refresh  after LWIP_UDP_FLOW_REFRESH_MS one datagram goes through udp_sendto()
+//   large    a datagram over the MTU goes through udp_sendto()
+// then the host time per datagram of both for payloads of 16 to 1472 bytes. The exit
+// status is 1 when a check fails
+//
+// usage: udp_flow_bench [ms per size, default 200]
+
+#define PEER_PORT 9000
+#define FRAME_MAX 1514
+
+static struct netif netif;
+static uint failures;
+static uint32_t bench_ms = 200;
+
+static const struct eth_addr host_mac = {{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 }};
+static struct eth_addr peer_mac = {{ 0x02, 0x00, 0x00, 0x00, 0x01, 0x02 }};
+static const struct eth_addr gw_mac = {{ 0x02, 0x00, 0x00, 0x00, 0x01, 0x01 }};
+static ip4_addr_t peer_ip, gw_ip, far_ip;
+
+// the last frame, while capture is set
+static bool capture;
+static uint8_t frame[FRAME_MAX];
+static u16_t frame_len;
+static uint32_t frames, arp_requests;
+
+// on the wire back, delivered by wire_run()
+static void arp_reply(const ip4_addr_t *addr, const struct eth_addr *mac) {
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, SIZEOF_ETH_HDR + SIZEOF_ETHARP_HDR, PBUF_RAM);
+
+    if (p == NULL) {
+        failures++;
+
+        return;
+    }
+
+    struct eth_hdr *eth = p->payload;
+    struct etharp_hdr *arp = (struct etharp_hdr *)((uint8_t *)p->payload + SIZEOF_ETH_HDR);
+
+    eth->dest = host_mac;
+    eth->src = *mac;
+    eth->type = PP_HTONS(ETHTYPE_ARP);
+
+    arp->hwtype = PP_HTONS(LWIP_IANA_HWTYPE_ETHERNET);
+    arp->proto = PP_HTONS(ETHTYPE_IP);
+    arp->hwlen = ETH_HWADDR_LEN;
+    arp->protolen = sizeof(ip4_addr_t);
+    arp->opcode = PP_HTONS(ARP_REPLY);
+    arp->shwaddr = *mac;
+    IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&arp->sipaddr, addr);
+    arp->dhwaddr = host_mac;
+    IPADDR_WORDALIGNED_COPY_FROM_IP4_ADDR_T(&arp->dipaddr, netif_ip4_addr(&netif));
+
+    if (!wire_queue(p, &netif)) {
+        failures++;
+    }
+}
+
+// the wire: datagrams are taken, ARP requests for the peer and the gateway answered
+static err_t bench_linkoutput(struct netif *netif, struct pbuf *p) {
+    LWIP_UNUSED_ARG(netif);
+
+    frames++;
+
+    if (!capture) {
+        return ERR_OK;
+    }
+
+    frame_len = pbuf_copy_partial(p, frame, sizeof(frame), 0);
+
+    struct eth_hdr *eth = (struct eth_hdr *)frame;
+
+    if (eth->type == PP_HTONS(ETHTYPE_ARP)) {
+        struct etharp_hdr *arp = (struct etharp_hdr *)(frame + SIZEOF_ETH_HDR);
+        ip4_addr_t target;
+
+        IPADDR_WORDALIGNED_COPY_TO_IP4_ADDR_T(&target, &arp->dipaddr);
+
+        if (arp->opcode == PP_HTONS(ARP_REQUEST)) {
+            arp_requests++;
+
+            if (ip4_addr_cmp(&target, &peer_ip)) {
+                arp_reply(&peer_ip, &peer_mac);
+            } else if (ip4_addr_cmp(&target, &gw_ip)) {
+                arp_reply(&gw_ip, &gw_mac);
+            }
+        }
+    }
+
+    return ERR_OK;
+}
+
+static err_t bench_netif_init(struct netif *netif) {
+    netif->output = etharp_output;
+    netif->linkoutput = bench_linkoutput;
+    netif->mtu = 1500;
+    netif->hwaddr_len = ETH_HWADDR_LEN;
+    memcpy(netif->hwaddr, host_mac.addr, ETH_HWADDR_LEN);
+    netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_LINK_UP;
+
+    return ERR_OK;
+}
+
+static struct pbuf *payload(u16_t len, uint8_t fill) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+
+    if (p != NULL) {
+        memset(p->payload, fill, len);
+    }
+
+    return p;
+}
+
+// sends len bytes through the flow or udp_sendto(), captures the frame
+static bool send_one(struct lwip_udp_flow *flow, u16_t len, bool through_flow) {
+    struct pbuf *p = payload(len, (uint8_t)len);
+
+    if (p == NULL) {
+        return false;
+    }
+
+    frame_len = 0;
+
+    err_t err = through_flow ? lwip_udp_flow_send(flow, p) : udp_sendto(flow->pcb, p, &flow->dest, flow->port);
+
+    pbuf_free(p);
+
+    return err == ERR_OK;
+}
+
+static void expect(const char *check, const char *what, bool ok) {
+    if (!ok) {
+        printf("  %s: FAILED %s\n", check, what);
+        failures++;
+    }
+}
+
+// the captured frame is a good UDP datagram of len bytes to mac
+static bool frame_good(u16_t len, const struct eth_addr *mac) {
+    struct eth_hdr *eth = (struct eth_hdr *)frame;
+    struct ip_hdr *ip = (struct ip_hdr *)(frame + SIZEOF_ETH_HDR);
+    ip4_addr_t src, dest;
+    struct pbuf *p;
+    bool ok;
+
+    if (frame_len != SIZEOF_ETH_HDR + IP_HLEN + UDP_HLEN + len || eth->type != PP_HTONS(ETHTYPE_IP) ||
+        !eth_addr_cmp(&eth->dest, mac) || inet_chksum(ip, IP_HLEN) != 0) {
+        return false;
+    }
+
+    p = pbuf_alloc(PBUF_RAW, UDP_HLEN + len, PBUF_RAM);
+    pbuf_take(p, frame + SIZEOF_ETH_HDR + IP_HLEN, UDP_HLEN + len);
+    ip4_addr_copy(src, ip->src);
+    ip4_addr_copy(dest, ip->dest);
+    ok = inet_chksum_pseudo(p, IP_PROTO_UDP, p->tot_len, &src, &dest) == 0;
+    pbuf_free(p);
+
+    return ok;
+}
+
+static void check_frames(struct lwip_udp_flow *flow) {
+    static const u16_t sizes[] = { 0, 1, 16, 255, 1472 };
+    uint8_t reference[FRAME_MAX];
+
+    for (uint i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint32_t fast = flow->fast;
+
+        send_one(flow, sizes[i], false);
+        memcpy(reference, frame, frame_len);
+        send_one(flow, sizes[i], true);
+
+        expect("frames", "sent with the template", flow->fast == fast + 1);
+        expect("frames", "a good datagram", frame_good(sizes[i], &peer_mac));
+
+        // the IP ID and checksum aside
+        struct ip_hdr *ip = (struct ip_hdr *)(frame + SIZEOF_ETH_HDR);
+        struct ip_hdr *ref = (struct ip_hdr *)(reference + SIZEOF_ETH_HDR);
+
+        ip->_id = ref->_id;
+        ip->_chksum = ref->_chksum;
+        expect("frames", "udp_sendto()'s frame", memcmp(frame, reference, frame_len) == 0);
+    }
+}
+
+static void check(void) {
+    struct udp_pcb *pcb = udp_new();
+    struct udp_pcb *far_pcb = udp_new();
+    struct lwip_udp_flow flow, far_flow;
+    ip_addr_t addr;
+
+    capture = true;
+
+    ip_addr_copy_from_ip4(addr, peer_ip);
+    lwip_udp_flow_open(&flow, pcb, &addr, PEER_PORT);
+
+    // the first is queued on the ARP query, the reply sends it
+    send_one(&flow, 16, true);
+    wire_run();
+    expect("frames", "the first datagram through udp_sendto()", flow.slow == 1 && flow.fast == 0);
+    expect("frames", "the ARP entry resolved", frame_good(16, &peer_mac));
+    check_frames(&flow);
+
+    printf("mac\n");
+    peer_mac.addr[5]++;
+    arp_reply(&peer_ip, &peer_mac);
+    wire_run();
+    send_one(&flow, 16, true);
+    expect("mac", "to the new MAC", frame_good(16, &peer_mac) && flow.mac_changes == 1);
+
+    printf("gone\n");
+    uint32_t slow = flow.slow;
+    uint32_t requests = arp_requests;
+
+    etharp_cleanup_netif(&netif);
+    send_one(&flow, 16, true);
+    expect("gone", "through udp_sendto(), which queries the ARP entry",
+           flow.slow == slow + 1 && arp_requests == requests + 1);
+    wire_run();
+    send_one(&flow, 16, true);
+    expect("gone", "with the template again", flow.slow == slow + 1 && frame_good(16, &peer_mac));
+
+    printf("gateway\n");
+    ip_addr_copy_from_ip4(addr, far_ip);
+    lwip_udp_flow_open(&far_flow, far_pcb, &addr, PEER_PORT);
+    send_one(&far_flow, 16, true);
+    wire_run();
+    send_one(&far_flow, 16, true);
+    expect("gateway", "to the gateway's MAC", far_flow.fast == 1 && frame_good(16, &gw_mac));
+
+    printf("refresh\n");
+    slow = flow.slow;
+    now_ms += LWIP_UDP_FLOW_REFRESH_MS;
+    send_one(&flow, 16, true);
+    send_one(&flow, 16, true);
+    expect("refresh", "one datagram through udp_sendto()", flow.slow == slow + 1 && frame_good(16, &peer_mac));
+
+    printf("large\n");
+    slow = flow.slow;
+    send_one(&flow, 1473, true);
+    send_one(&flow, 1472, true);
+    expect("large", "over the MTU through udp_sendto()", flow.slow == slow + 1 && frame_good(1472, &peer_mac));
+
+    lwip_udp_flow_close(&far_flow);
+    udp_remove(far_pcb);
+    lwip_udp_flow_close(&flow);
+    udp_remove(pcb);
+
+    capture = false;
+}
+
+// a new pbuf per datagram for both, they leave their headers in it
+static double bench_size(struct lwip_udp_flow *flow, u16_t len, bool through_flow) {
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+    uint32_t sent = 0;
+
+    do {
+        for (uint i = 0; i < 256; i++) {
+            struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+
+            if (p == NULL ||
+                (through_flow ? lwip_udp_flow_send(flow, p) : udp_sendto(flow->pcb, p, &flow->dest, flow->port)) != ERR_OK) {
+                failures++;
+            }
+
+            pbuf_free(p);
+        }
+
+        sent += 256;
+        elapsed = now_ns() - start;
+    } while (elapsed < bench_ms * 1000000ull);
+
+    return (double)elapsed / sent;
+}
+
+int main(int argc, char **argv) {
+    static const u16_t sizes[] = { 16, 64, 256, 1024, 1472 };
+
+    if (argc > 1) {
+        bench_ms = strtoul(argv[1], NULL, 0);
+    }
+
+    // the ARP replies on their way back
+    wire_init(4);
+    lwip_init();
+
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, 15);
+    IP4_ADDR(&gw_ip, 192, 168, 1, 1);
+    IP4_ADDR(&peer_ip, 192, 168, 1, 2);
+    IP4_ADDR(&far_ip, 10, 0, 0, 5);
+    netif_add(&netif, &addr, &mask, &gw_ip, NULL, bench_netif_init, ethernet_input);
+    netif_set_default(&netif);
+    netif_set_up(&netif);
+
+    printf("frames\n");
+    check();
+
+    struct udp_pcb *pcb = udp_new();
+    struct lwip_udp_flow flow;
+    ip_addr_t peer;
+
+    ip_addr_copy_from_ip4(peer, peer_ip);
+    lwip_udp_flow_open(&flow, pcb, &peer, PEER_PORT);
+
+    // resolved for both
+    capture = true;
+    send_one(&flow, 16, true);
+    wire_run();
+    capture = false;
+
+    for (uint i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        double sendto_ns = bench_size(&flow, sizes[i], false);
+        double flow_ns = bench_size(&flow, sizes[i], true);
+
+        printf("%5u bytes  udp_sendto %7.1f ns %9.0f dgram/s  flow %7.1f ns %9.0f dgram/s  x%.2f\n",
+               sizes[i], sendto_ns, 1e9 / sendto_ns, flow_ns, 1e9 / flow_ns, sendto_ns / flow_ns);
+    }
+
+    printf("%s\n", failures ? "FAILED" : "ok");
+
+    return failures ? 1 : 0;
+}
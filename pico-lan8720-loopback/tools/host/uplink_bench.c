@@ -0,0 +1,642 @@
+/*
+ * Copyright (c) 2021 Sandeep Mistry
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/etharp.h"
+#include "lwip/init.h"
+#include "lwip/ip4.h"
+#include "lwip/memp.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/prot/ethernet.h"
+#include "netif/ethernet.h"
+
+#if LWIP_UPLINK
+#include "lwip_uplink.h"
+#endif
+
+#include "bench_flow.h"
+#include "bench_wire.h"
+
+// the dual uplink firmware's lwIP in virtual time: the device has netif_a, the LAN8720
+// at 100 Mbit/s, and netif_b, the W5100S in MACRAW at UPLINK_B_KBPS, plugged into a
+// learning switch, as is netif_r, a remote host on the same subnet. Each port sends its
+// frames at the rate of its link, both ways. The switch forgets the MACs of a port whose
+// cable is pulled and floods frames to unknown MACs, the netifs take frames to their MAC,
+// broadcasts and multicasts only, as the chips' filters do. The device polls its PHYs
+// every LINK_POLL_MS and sets the netif's link from it. Built as stock lwIP (two netifs,
+// lwIP's routing), with lwip_uplink.c, and with lwip_uplink.c and LWIP_UPLINK_SHARE.
+// The exit status is 1 when a failover took longer than FAILOVER_MAX_MS or memory was
+// left allocated
+//
+// usage: uplink_bench [ms netif_a's cable stays pulled, default 3000]
+//
+// first a bulk upload from the remote host to the device's address on netif_a, then a
+// bulk download from it, while netif_a's cable is pulled and put back: the goodput
+// before, with the cable out and after, the time from the pull to the first byte the
+// flow moves again and the longest stall in the second after the cable is back. Then
+// COMBINED_FLOWS downloads from the device at once, each bound to the address the build
+// picks for it: netif_a's with stock lwIP, lwip_uplink_flow_netif()'s otherwise, and the
+// goodput they have on each link
+
+// the W5100S's MACRAW netif, its SPI is the limit
+#define UPLINK_B_KBPS 12000
+#define UPLINK_A_KBPS 100000
+#define REMOTE_KBPS 1000000
+
+// Ethernet preamble, FCS and gap of a frame
+#define FRAME_OVERHEAD 24
+
+// frames on a line, and the bytes a switch port holds for a link, tail dropped beyond
+#define LINE_SIZE 512
+#define PORT_QUEUE_BYTES (64 * 1024)
+
+// the PHY polling of the firmware, PICO_RMII_ETHERNET_LINK_POLL_MS and
+// W5X00_LWIP_NETIF_LINK_POLL_MS in examples/dual_uplink
+#define LINK_POLL_MS 20
+
+#define FAILOVER_MAX_MS 500
+
+// the failover timeline: the flow runs this long before the pull and after the cable
+// is back, the goodput before is taken from the second before the pull
+#define SETTLE_MS 2000
+#define TAKEBACK_WINDOW_MS 1000
+
+#define COMBINED_FLOWS 8
+#define COMBINED_MS 5000
+
+#if COMBINED_FLOWS > FLOWS_MAX
+#error "the combined flows are more than bench_flow.h has"
+#endif
+
+#define DEVICE_PORT 5000
+#define REMOTE_PORT 5001
+
+enum { PORT_R, PORT_A, PORT_B, PORTS };
+
+struct packet {
+    uint8_t *data;
+    uint16_t len;
+};
+
+// a direction of a link, the frames wait to be sent at its rate
+struct line {
+    struct packet packets[LINE_SIZE];
+    uint32_t head, tail;
+    uint32_t bytes;
+    uint32_t credit;
+};
+
+struct port {
+    struct netif *netif;
+    uint32_t bytes_per_ms;
+    uint8_t octet;    // of its MAC and address
+    bool cable;       // plugged in
+    struct line in;   // from the netif to the switch
+    struct line out;  // from the switch to the netif
+};
+
+// the switch's MAC table
+struct fdb_entry {
+    struct eth_addr mac;
+    int port;
+};
+
+static struct port ports[PORTS];
+static struct fdb_entry fdb[8];
+static uint fdb_count;
+static uint32_t drops;
+
+static struct netif netif_r;
+static uint failures;
+
+// the remote host's packets leave on its own netif, as they would from another machine;
+// the device's go as the build routes them
+struct netif *uplink_bench_route(const ip4_addr_t *src, const ip4_addr_t *dest) {
+    if (src != NULL && ip4_addr_cmp(src, netif_ip4_addr(&netif_r))) {
+        return &netif_r;
+    }
+
+#if LWIP_UPLINK
+    return lwip_uplink_route(src, dest);
+#else
+    LWIP_UNUSED_ARG(dest);
+
+    return NULL;
+#endif
+}
+
+static bool line_push(struct line *line, const uint8_t *data, uint16_t len) {
+    if ((line->head - line->tail) == LINE_SIZE || line->bytes + len > PORT_QUEUE_BYTES) {
+        drops++;
+
+        return false;
+    }
+
+    struct packet *packet = &line->packets[line->head % LINE_SIZE];
+
+    packet->data = malloc(len);
+    packet->len = len;
+    memcpy(packet->data, data, len);
+    line->bytes += len;
+    line->head++;
+
+    return true;
+}
+
+static void line_flush(struct line *line) {
+    while (line->tail != line->head) {
+        free(line->packets[line->tail++ % LINE_SIZE].data);
+    }
+
+    line->bytes = 0;
+    line->credit = 0;
+}
+
+static int fdb_lookup(const struct eth_addr *mac) {
+    for (uint i = 0; i < fdb_count; i++) {
+        if (eth_addr_cmp(&fdb[i].mac, mac)) {
+            return fdb[i].port;
+        }
+    }
+
+    return -1;
+}
+
+static void fdb_learn(const struct eth_addr *mac, int port) {
+    for (uint i = 0; i < fdb_count; i++) {
+        if (eth_addr_cmp(&fdb[i].mac, mac)) {
+            fdb[i].port = port;
+
+            return;
+        }
+    }
+
+    if (fdb_count < sizeof(fdb) / sizeof(fdb[0])) {
+        fdb[fdb_count].mac = *mac;
+        fdb[fdb_count++].port = port;
+    }
+}
+
+static void fdb_forget(int port) {
+    for (uint i = 0; i < fdb_count; ) {
+        if (fdb[i].port == port) {
+            fdb[i] = fdb[--fdb_count];
+        } else {
+            i++;
+        }
+    }
+}
+
+static void port_cable(int port, bool plugged) {
+    ports[port].cable = plugged;
+
+    if (!plugged) {
+        line_flush(&ports[port].in);
+        line_flush(&ports[port].out);
+        fdb_forget(port);
+    }
+}
+
+static err_t switch_linkoutput(struct netif *netif, struct pbuf *p) {
+    struct port *port = netif->state;
+    uint8_t frame[1514];
+
+    if (!port->cable || p->tot_len > sizeof(frame)) {
+        return ERR_OK;
+    }
+
+    pbuf_copy_partial(p, frame, p->tot_len, 0);
+    line_push(&port->in, frame, p->tot_len);
+
+    return ERR_OK;
+}
+
+// a frame through the switch: learned from, then to the port of its destination, or
+// flooded
+static void switch_forward(const struct packet *packet, int from) {
+    const struct eth_hdr *eth = (const struct eth_hdr *)packet->data;
+    int to = (eth->dest.addr[0] & 1) ? -1 : fdb_lookup(&eth->dest);
+
+    fdb_learn(&eth->src, from);
+
+    for (int i = 0; i < PORTS; i++) {
+        if (i != from && ports[i].cable && (to < 0 || to == i)) {
+            line_push(&ports[i].out, packet->data, packet->len);
+        }
+    }
+}
+
+// the frames of a line its ms covers, each once the whole of it is through
+static void line_send(struct line *line, uint32_t bytes_per_ms, int port, bool to_netif) {
+    line->credit += bytes_per_ms;
+
+    while (line->tail != line->head) {
+        struct packet *packet = &line->packets[line->tail % LINE_SIZE];
+        uint32_t bytes = packet->len + FRAME_OVERHEAD;
+
+        if (bytes > line->credit) {
+            return;
+        }
+
+        line->credit -= bytes;
+        line->bytes -= packet->len;
+        line->tail++;
+
+        if (!to_netif) {
+            switch_forward(packet, port);
+        } else {
+            struct netif *netif = ports[port].netif;
+            const struct eth_hdr *eth = (const struct eth_hdr *)packet->data;
+
+            // the MAC filter of the chip, as the driver's pool pbuf per frame
+            if ((eth->dest.addr[0] & 1) || memcmp(eth->dest.addr, netif->hwaddr, ETH_HWADDR_LEN) == 0) {
+                struct pbuf *q = pbuf_alloc(PBUF_RAW, packet->len, PBUF_POOL);
+
+                if (q == NULL) {
+                    drops++;
+                } else {
+                    pbuf_take(q, packet->data, packet->len);
+
+                    if (netif->input(q, netif) != ERR_OK) {
+                        pbuf_free(q);
+                    }
+                }
+            }
+        }
+
+        free(packet->data);
+    }
+
+    // an idle link doesn't save up a burst
+    line->credit = 0;
+}
+
+static void switch_run(void) {
+    for (int i = 0; i < PORTS; i++) {
+        line_send(&ports[i].out, ports[i].bytes_per_ms, i, true);
+    }
+
+    for (int i = 0; i < PORTS; i++) {
+        line_send(&ports[i].in, ports[i].bytes_per_ms, i, false);
+    }
+
+    now_ms++;
+    sys_check_timeouts();
+}
+
+// the firmware's PHY polling, from an lwIP timer as the drivers do
+static void link_poll(void *arg) {
+    struct port *port = arg;
+
+    if (port->cable && !netif_is_link_up(port->netif)) {
+        netif_set_link_up(port->netif);
+    } else if (!port->cable && netif_is_link_up(port->netif)) {
+        netif_set_link_down(port->netif);
+    }
+
+    sys_timeout(LINK_POLL_MS, link_poll, arg);
+}
+
+static err_t switch_netif_init(struct netif *netif) {
+    struct port *port = netif->state;
+
+    netif->hwaddr[0] = 0x02;
+    netif->hwaddr[5] = port->octet;
+    netif->linkoutput = switch_linkoutput;
+    netif->output = etharp_output;
+    netif->mtu = 1500;
+    netif->hwaddr_len = ETH_HWADDR_LEN;
+    netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET;
+
+    return ERR_OK;
+}
+
+static void port_add(int index, struct netif *netif, uint32_t kbps, uint8_t last_octet) {
+    struct port *port = &ports[index];
+    ip4_addr_t addr, mask;
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&addr, 192, 168, 1, last_octet);
+
+    port->netif = netif;
+    port->bytes_per_ms = kbps / 8;
+    port->octet = last_octet;
+    port->cable = true;
+
+    netif_add(netif, &addr, &mask, IP4_ADDR_ANY4, port, switch_netif_init, ethernet_input);
+    netif_set_up(netif);
+    netif_set_link_up(netif);
+}
+
+// the receivers listen on the device's addresses in an upload, on the remote host's in
+// a download
+static struct tcp_pcb *listen_for(bool up_dir) {
+    struct tcp_pcb *listener = tcp_new();
+
+    if (up_dir) {
+        tcp_bind(listener, IP4_ADDR_ANY, DEVICE_PORT);
+    } else {
+        tcp_bind(listener, netif_ip_addr4(&netif_r), REMOTE_PORT);
+    }
+
+    listener = tcp_listen(listener);
+    tcp_accept(listener, sink_accept);
+
+    return listener;
+}
+
+// flow i, from the remote host to the device's address on link, or from that address
+// to the remote host
+static void flow_start(uint i, bool up_dir, struct netif *link) {
+    struct flow *flow = &flows[i];
+
+    memset(flow, 0, sizeof(*flow));
+    flow->link = link;
+    flow->pcb = tcp_new();
+    tcp_arg(flow->pcb, flow);
+    tcp_sent(flow->pcb, flow_sent);
+    tcp_err(flow->pcb, flow_err);
+    tcp_nagle_disable(flow->pcb);
+
+    if (up_dir) {
+        tcp_bind(flow->pcb, netif_ip_addr4(&netif_r), 0);
+        tcp_connect(flow->pcb, netif_ip_addr4(link), DEVICE_PORT, flow_connected);
+    } else {
+        tcp_bind(flow->pcb, netif_ip_addr4(link), 0);
+        tcp_connect(flow->pcb, netif_ip_addr4(&netif_r), REMOTE_PORT, flow_connected);
+    }
+}
+
+static uint32_t flows_received(void) {
+    uint32_t total = 0;
+
+    for (uint i = 0; i < flow_count; i++) {
+        total += flows[i].received;
+    }
+
+    return total;
+}
+
+static void run_ms(uint32_t ms) {
+    for (uint32_t end = now_ms + ms; now_ms != end; ) {
+        switch_run();
+
+        for (uint i = 0; i < flow_count; i++) {
+            flow_send(&flows[i]);
+        }
+    }
+}
+
+// both ends reset, the lines drained and the pcbs let go
+static void flows_stop(struct tcp_pcb *listener) {
+    for (uint i = 0; i < flow_count; i++) {
+        if (flows[i].pcb != NULL) {
+            tcp_abort(flows[i].pcb);
+            flows[i].pcb = NULL;
+        }
+    }
+
+    run_ms(1000);
+
+    for (uint i = 0; i < flow_count; i++) {
+        if (flows[i].sink != NULL) {
+            tcp_abort(flows[i].sink);
+            flows[i].sink = NULL;
+        }
+    }
+
+    tcp_close(listener);
+    flow_count = 0;
+    run_ms(1000);
+}
+
+static uint32_t kbps(uint32_t bytes, uint32_t ms) {
+    return ms ? (uint32_t)((uint64_t)bytes * 8 / ms) : 0;
+}
+
+// a bulk flow on netif_a's address while its cable is pulled for down_ms
+static void run_failover(const char *name, bool up_dir, uint32_t down_ms) {
+    struct tcp_pcb *listener = listen_for(up_dir);
+
+    flow_count = 1;
+    flow_start(0, up_dir, &netif_a);
+
+    run_ms(SETTLE_MS - 1000);
+
+    uint32_t mark = flows_received();
+
+    run_ms(1000);
+
+    uint32_t before = flows_received() - mark;
+
+    // the pull, then each ms until the first byte moves again
+    uint32_t cut_ms = now_ms;
+    uint32_t resumed_ms = 0;
+
+    mark = flows_received();
+    port_cable(PORT_A, false);
+
+    while ((now_ms - cut_ms) < down_ms) {
+        uint32_t last = flows_received();
+
+        run_ms(1);
+
+        if (resumed_ms == 0 && flows_received() != last) {
+            resumed_ms = now_ms;
+        }
+    }
+
+    uint32_t during = flows_received() - mark;
+
+    // the cable back, and the longest time without a byte in the window after it
+    uint32_t back_ms = now_ms;
+    uint32_t last_rx_ms = now_ms;
+    uint32_t stall_ms = 0;
+
+    port_cable(PORT_A, true);
+
+    while ((now_ms - back_ms) < TAKEBACK_WINDOW_MS) {
+        uint32_t last = flows_received();
+
+        run_ms(1);
+
+        if (flows_received() != last) {
+            last_rx_ms = now_ms;
+        } else if ((now_ms - last_rx_ms) > stall_ms) {
+            stall_ms = now_ms - last_rx_ms;
+        }
+    }
+
+    mark = flows_received();
+    run_ms(SETTLE_MS - TAKEBACK_WINDOW_MS);
+
+    uint32_t after = flows_received() - mark;
+
+    printf("%-9s %6u kbit/s, pulled %6u kbit/s, back %6u kbit/s  ", name, (unsigned)kbps(before, 1000),
+        (unsigned)kbps(during, down_ms), (unsigned)kbps(after, SETTLE_MS - TAKEBACK_WINDOW_MS));
+
+    if (resumed_ms != 0) {
+        printf("failover %4u ms", (unsigned)(resumed_ms - cut_ms));
+    } else {
+        printf("failover never  ");
+    }
+
+    printf(", stall after back %4u ms", (unsigned)stall_ms);
+
+#if LWIP_UPLINK
+    if (resumed_ms == 0 || (resumed_ms - cut_ms) > FAILOVER_MAX_MS) {
+        printf(", SLOW");
+        failures++;
+    }
+#endif
+
+    printf("\n");
+
+    flows_stop(listener);
+}
+
+// COMBINED_FLOWS downloads from the device at once
+static void run_combined(void) {
+    struct tcp_pcb *listener = listen_for(false);
+
+    flow_count = COMBINED_FLOWS;
+
+    for (uint i = 0; i < flow_count; i++) {
+#if LWIP_UPLINK
+        struct netif *link = lwip_uplink_flow_netif(netif_ip4_addr(&netif_r), i);
+#else
+        // what lwIP's routing picks for an unbound pcb
+        struct netif *link = ip4_route(netif_ip4_addr(&netif_r));
+#endif
+
+        flow_start(i, false, link);
+    }
+
+    run_ms(1000);
+
+    uint32_t start[COMBINED_FLOWS];
+
+    for (uint i = 0; i < flow_count; i++) {
+        start[i] = flows[i].received;
+    }
+
+    run_ms(COMBINED_MS);
+
+    uint32_t bytes_a = 0, bytes_b = 0;
+    uint on_a = 0, on_b = 0;
+
+    for (uint i = 0; i < flow_count; i++) {
+        uint32_t bytes = flows[i].received - start[i];
+
+        if (flows[i].link == &netif_a) {
+            bytes_a += bytes;
+            on_a++;
+        } else {
+            bytes_b += bytes;
+            on_b++;
+        }
+    }
+
+    printf("combined  %u flows on a %6u kbit/s + %u flows on b %6u kbit/s = %6u kbit/s\n", on_a,
+        (unsigned)kbps(bytes_a, COMBINED_MS), on_b, (unsigned)kbps(bytes_b, COMBINED_MS),
+        (unsigned)kbps(bytes_a + bytes_b, COMBINED_MS));
+
+    flows_stop(listener);
+}
+
+int main(int argc, char **argv) {
+    uint32_t down_ms = 3000;
+
+    if (argc > 1) {
+        down_ms = strtoul(argv[1], NULL, 0);
+    }
+
+    if (down_ms < TAKEBACK_WINDOW_MS) {
+        printf("usage: uplink_bench [ms the cable stays pulled, %u or more]\n", TAKEBACK_WINDOW_MS);
+
+        return 2;
+    }
+
+    lwip_init();
+
+    // the primary first in netif_list, where lwIP's routing looks first
+    port_add(PORT_R, &netif_r, REMOTE_KBPS, 10);
+    port_add(PORT_B, &netif_b, UPLINK_B_KBPS, 21);
+    port_add(PORT_A, &netif_a, UPLINK_A_KBPS, 20);
+
+#if LWIP_UPLINK
+    lwip_uplink_add(&netif_a, UPLINK_A_KBPS / 1000);
+    lwip_uplink_add(&netif_b, UPLINK_B_KBPS / 1000);
+#endif
+
+    sys_timeout(LINK_POLL_MS, link_poll, &ports[PORT_A]);
+    sys_timeout(LINK_POLL_MS, link_poll, &ports[PORT_B]);
+
+    // the ARP entries of the first flows and the timers
+    run_ms(100);
+
+    mem_size_t heap_used = lwip_stats.mem.used;
+    u16_t memp_used[MEMP_MAX];
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        memp_used[i] = lwip_stats.memp[i]->used;
+    }
+
+    printf("%s, a %u kbit/s, b %u kbit/s, links polled every %u ms, cable out %u ms\n",
+#if LWIP_UPLINK && LWIP_UPLINK_SHARE
+        "lwip_uplink with LWIP_UPLINK_SHARE",
+#elif LWIP_UPLINK
+        "lwip_uplink",
+#else
+        "stock lwIP",
+#endif
+        UPLINK_A_KBPS, UPLINK_B_KBPS, LINK_POLL_MS, (unsigned)down_ms);
+
+    run_failover("upload", true, down_ms);
+    run_failover("download", false, down_ms);
+    run_combined();
+
+#if LWIP_UPLINK
+    struct lwip_uplink_stats stats;
+
+    lwip_uplink_get_stats(&stats);
+    printf("uplink: %u takeovers, %u takebacks, %u ARP replies, %u TCP kicked\n", (unsigned)stats.takeovers,
+        (unsigned)stats.takebacks, (unsigned)stats.arp_replies, (unsigned)stats.tcp_kicked);
+#endif
+
+    printf("%u frames dropped\n", (unsigned)drops);
+
+    // the pool pbufs of packets queued on an incomplete ARP entry go with it
+    etharp_cleanup_netif(&netif_a);
+    etharp_cleanup_netif(&netif_b);
+    etharp_cleanup_netif(&netif_r);
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        if (lwip_stats.memp[i]->used != memp_used[i]) {
+            printf("%s: %u left allocated\n", lwip_stats.memp[i]->name, lwip_stats.memp[i]->used - memp_used[i]);
+            failures++;
+        }
+    }
+
+    if (lwip_stats.mem.used != heap_used) {
+        printf("HEAP: %u bytes left allocated\n", (unsigned)(lwip_stats.mem.used - heap_used));
+        failures++;
+    }
+
+    if (failures) {
+        printf("%u failures\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
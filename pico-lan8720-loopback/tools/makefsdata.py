@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021 Sandeep Mistry
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+# Generates the fsdata file of lwIP's httpd (the format of lwIP's makefsdata) from a
+# directory: every file gets its HTTP/1.0 header precomputed, and is stored gzipped
+# when that makes it smaller. The arrays are placed in flash with __in_flash(), so
+# httpd hands them to tcp_write() by reference and they are read from XIP.
+#
+# usage: makefsdata.py <content dir> <output file>
+
+import gzip
+import os
+import sys
+
+# types already compressed are sent as they are
+CONTENT_TYPES = {
+    ".html": ("text/html", True),
+    ".htm": ("text/html", True),
+    ".shtml": ("text/html", True),
+    ".css": ("text/css", True),
+    ".js": ("application/javascript", True),
+    ".json": ("application/json", True),
+    ".txt": ("text/plain", True),
+    ".xml": ("text/xml", True),
+    ".svg": ("image/svg+xml", True),
+    ".ico": ("image/x-icon", True),
+    ".gif": ("image/gif", False),
+    ".png": ("image/png", False),
+    ".jpg": ("image/jpeg", False),
+    ".jpeg": ("image/jpeg", False),
+}
+
+# HTML is revalidated on every load, the other files are cached by the browser for a day
+CACHE_MAX_AGE = 86400
+
+# offset of the file data in its array, as the data after the name is word aligned
+ALIGNMENT = 4
+
+
+def header(path, length, encoding):
+    ext = os.path.splitext(path)[1].lower()
+    content_type = CONTENT_TYPES.get(ext, ("application/octet-stream", False))[0]
+
+    if os.path.basename(path).startswith("404."):
+        status = "HTTP/1.0 404 File not found"
+    else:
+        status = "HTTP/1.0 200 OK"
+
+    lines = [status, "Server: lwIP", "Content-Length: %d" % length, "Content-Type: %s" % content_type]
+    if encoding:
+        lines.append("Content-Encoding: %s" % encoding)
+    if content_type != "text/html":
+        lines.append("Cache-Control: max-age=%d" % CACHE_MAX_AGE)
+
+    return ("\r\n".join(lines) + "\r\n\r\n").encode("ascii")
+
+
+def content(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    ext = os.path.splitext(path)[1].lower()
+    if CONTENT_TYPES.get(ext, (None, False))[1]:
+        # mtime=0 keeps the output the same from build to build
+        packed = gzip.compress(data, compresslevel=9, mtime=0)
+        if len(packed) < len(data):
+            return packed, "gzip"
+
+    return data, None
+
+
+def c_array(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("".join("0x%02x," % b for b in data[i:i + 16]))
+    return "\n".join(lines)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: makefsdata.py <content dir> <output file>")
+
+    root, output = sys.argv[1], sys.argv[2]
+
+    files = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames.sort()
+        for filename in sorted(filenames):
+            files.append(os.path.join(dirpath, filename))
+
+    if not files:
+        sys.exit("makefsdata.py: no files in %s" % root)
+
+    out = []
+    out.append("/* Generated by tools/makefsdata.py from %s, do not edit */" % os.path.basename(os.path.abspath(root)))
+    out.append("")
+    out.append("#include \"lwip/apps/fs.h\"")
+    out.append("#include \"lwip/def.h\"")
+    out.append("#include \"pico/platform.h\"")
+    out.append("")
+    out.append("#define file_NULL (struct fsdata_file *) NULL")
+    out.append("")
+
+    previous = "file_NULL"
+    total_raw = 0
+    total_sent = 0
+
+    for path in files:
+        name = "/" + os.path.relpath(path, root).replace(os.sep, "/")
+        var = "".join(c if c.isalnum() else "_" for c in name)
+
+        data, encoding = content(path)
+        body = header(name, len(data), encoding) + data
+
+        name_bytes = name.encode("ascii") + b"\0"
+        name_bytes += b"\0" * (-len(name_bytes) % ALIGNMENT)
+
+        with open(path, "rb") as f:
+            total_raw += len(header(name, os.path.getsize(path), None)) + len(f.read())
+        total_sent += len(body)
+
+        out.append("/* %s, %d bytes%s */" % (name, len(data), ", gzip" if encoding else ""))
+        out.append("static const unsigned char __in_flash(\"httpd\") data_%s[] = {" % var)
+        out.append(c_array(name_bytes + body))
+        out.append("};")
+        out.append("")
+        out.append("const struct fsdata_file file_%s[] = { {" % var)
+        out.append("%s," % previous)
+        out.append("data_%s," % var)
+        out.append("data_%s + %d," % (var, len(name_bytes)))
+        out.append("sizeof(data_%s) - %d," % (var, len(name_bytes)))
+        out.append("FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_HEADER_PERSISTENT,")
+        out.append("}};")
+        out.append("")
+
+        previous = "file_" + var
+
+    out.append("#define FS_ROOT %s" % previous)
+    out.append("#define FS_NUMFILES %d" % len(files))
+    out.append("")
+
+    with open(output, "w") as f:
+        f.write("\n".join(out))
+
+    print("makefsdata.py: %d files, %d bytes with headers, %d uncompressed" % (len(files), total_sent, total_raw))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021 Sandeep Mistry
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+# Sends a firmware .bin to a board running src/lwip/lwip_ota.c (examples/ota), by a TFTP
+# put with the blksize, windowsize and tsize options. The image is the firmware behind
+# lwip_ota.h's header: magic, length, CRC-32 and version, four little endian words. The
+# last ACK comes once the board has the image in flash with the right CRC, an ERROR
+# means it didn't take it. The update is applied at the board's next reset.
+#
+# usage: ota_push.py <board address> <firmware>.bin [version, default 0]
+
+import socket
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = 0x41544F50
+BLKSIZE = 1428
+WINDOWSIZE = 4
+TIMEOUT = 0.5
+RETRIES = 10
+
+RRQ, WRQ, DATA, ACK, ERROR, OACK = 1, 2, 3, 4, 5, 6
+
+
+def options(packet):
+    fields = packet[2:].split(b"\0")
+    return {k.decode().lower(): int(v) for k, v in zip(fields[0::2], fields[1::2]) if k}
+
+
+def push(address, image):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(TIMEOUT)
+
+    request = struct.pack("!H", WRQ) + b"firmware.bin\0octet\0"
+    request += b"blksize\0%d\0windowsize\0%d\0tsize\0%d\0" % (BLKSIZE, WINDOWSIZE, len(image))
+
+    # a server that takes no options answers with ACK 0: 512 byte blocks one at a time
+    blksize, windowsize = 512, 1
+    peer = None
+    for _ in range(RETRIES):
+        sock.sendto(request, (address, 69))
+        try:
+            packet, peer = sock.recvfrom(2048)
+        except socket.timeout:
+            continue
+        opcode = struct.unpack("!H", packet[:2])[0]
+        if opcode == OACK:
+            taken = options(packet)
+            blksize = taken.get("blksize", blksize)
+            windowsize = taken.get("windowsize", windowsize)
+        elif opcode == ERROR:
+            sys.exit("ota_push.py: %s" % packet[4:].rstrip(b"\0").decode(errors="replace"))
+        elif opcode != ACK:
+            continue
+        break
+    else:
+        sys.exit("ota_push.py: no answer from %s" % address)
+
+    # the last block is shorter than blksize, empty when the image fills the one before
+    blocks = len(image) // blksize + 1
+    acked = 0
+    retries = 0
+    start = time.monotonic()
+
+    while acked < blocks:
+        for n in range(acked + 1, min(acked + windowsize, blocks) + 1):
+            data = image[(n - 1) * blksize:n * blksize]
+            sock.sendto(struct.pack("!HH", DATA, n & 0xFFFF) + data, peer)
+
+        try:
+            packet, source = sock.recvfrom(2048)
+        except socket.timeout:
+            retries += 1
+            if retries > RETRIES:
+                sys.exit("ota_push.py: no ACK after block %d" % acked)
+            continue
+        if source != peer:
+            continue
+
+        opcode, number = struct.unpack("!HH", packet[:4])
+        if opcode == ERROR:
+            sys.exit("ota_push.py: %s" % packet[4:].rstrip(b"\0").decode(errors="replace"))
+        if opcode != ACK:
+            continue
+
+        # block numbers wrap at 65536, an ACK is for a block of the window just sent
+        ahead = (number - acked) & 0xFFFF
+        if 0 < ahead <= windowsize:
+            acked += ahead
+            retries = 0
+
+    seconds = time.monotonic() - start
+    print("%d bytes in %.1f s, %.0f kB/s, blksize %d windowsize %d" %
+          (len(image), seconds, len(image) / seconds / 1000, blksize, windowsize))
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        sys.exit("usage: ota_push.py <board address> <firmware>.bin [version]")
+
+    with open(sys.argv[2], "rb") as f:
+        firmware = f.read()
+    version = int(sys.argv[3]) if len(sys.argv) == 4 else 0
+
+    header = struct.pack("<IIII", MAGIC, len(firmware), zlib.crc32(firmware), version)
+    push(sys.argv[1], header + firmware)
+
+
+if __name__ == "__main__":
+    main()
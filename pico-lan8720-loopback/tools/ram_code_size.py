@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021 Sandeep Mistry
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+# Lists the functions an ELF links into SRAM through the .time_critical sections (the
+# SDK's __not_in_flash_func(), and PICO_RMII_HOT_IN_RAM) from its linker map, with the
+# total: the RAM the option costs, as the flash copy of .data stays the same size.
+#
+# usage: ram_code_size.py <elf>.map
+#
+# pico_add_extra_outputs() writes the map next to the ELF, for example
+# build/examples/loopback/pico_rmii_ethernet_loopback.elf.map
+
+import re
+import sys
+
+# " .time_critical.name 0xaddr 0xsize object", wrapped after the name when it is long
+SECTION = re.compile(r"^ \.time_critical\.(\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+))?$")
+WRAPPED = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)$")
+
+
+def sections(lines):
+    name = None
+    for line in lines:
+        if name is not None:
+            m = WRAPPED.match(line)
+            if m:
+                yield name, int(m.group(2), 16), m.group(3)
+            name = None
+            continue
+
+        m = SECTION.match(line)
+        if m and m.group(2) is None:
+            name = m.group(1)
+        elif m:
+            yield m.group(1), int(m.group(3), 16), m.group(4)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: ram_code_size.py <elf>.map")
+
+    with open(sys.argv[1]) as f:
+        lines = f.read().splitlines()
+
+    # the discarded input sections are listed first, with no address
+    try:
+        lines = lines[lines.index("Linker script and memory map"):]
+    except ValueError:
+        sys.exit("ram_code_size.py: %s is not a GNU ld map" % sys.argv[1])
+
+    found = sorted(((size, name, obj) for name, size, obj in sections(lines) if size), reverse=True)
+    total = sum(size for size, _, _ in found)
+
+    for size, name, obj in found:
+        print("%6d  %-44s %s" % (size, name, obj.rsplit("/", 1)[-1].replace(".obj", "")))
+
+    print("%6d  total, %d functions" % (total, len(found)))
+
+
+if __name__ == "__main__":
+    main()
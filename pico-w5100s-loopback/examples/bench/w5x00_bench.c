@@ -0,0 +1,352 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/binary_info.h"
+#include "hardware/clocks.h"
+
+#include "wizchip_conf.h"
+#include "wizchip_port_rp2040.h"
+#include "socket.h"
+
+#include "w5x00_pico_port.h"
+#include "w5x00_spi_profile.h"
+
+#include "bench.h"
+#include "boot.h"
+#if BENCH_NET
+#include "net.h"
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* SPI, as the loopback example */
+#define SPI_PORT spi0
+
+#define PIN_SCK 18
+#define PIN_MOSI 19
+#define PIN_MISO 16
+#define PIN_CS 17
+#define PIN_RST 20
+#define PIN_INT 21
+
+/* W5100S indirect bus over PIO instead of SPI, configured with -DWIZCHIP_BUS_INDIR=ON */
+#if _WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_
+#define USE_BUS_PIO
+
+#define BUS_PIO_HZ (62500 * 1000) // PIO clock, a byte every 8 cycles
+
+#define PIN_BUS_D0 0
+#define PIN_BUS_CS 10
+#endif
+
+/* Clock */
+#ifdef USE_BUS_PIO
+#define PLL_SYS_KHZ (125 * 1000)
+#elif _WIZCHIP_ == W5500
+#define PLL_SYS_KHZ (133 * 1000) // the RP2040 maximum, SPI_PORT gets 66.5MHz
+#else
+#define PLL_SYS_KHZ (50 * 1000)
+#endif
+
+/* SPI clock, PLL_SYS_KHZ / 2 from SPI_PORT */
+#if _WIZCHIP_ == W5500
+#define SPI_HZ (80 * 1000 * 1000) // W5500 maximum
+#define WIZCHIP_VERSION 0x04
+#else
+#define SPI_HZ (50 * 1000 * 1000)
+#define WIZCHIP_VERSION 0x51
+#endif
+
+/* Scenarios served by bench_net.c on net.h, the source shared with the LAN8720 firmware, instead of
+   bench_wizchip.c. net_poll() runs bench_poll() then */
+#ifndef BENCH_NET
+#define BENCH_NET 0
+#endif
+
+/* Sockets served on INTn instead of polled, with the coalescing of w5x00_pico_port_int_coalesce().
+   The loop sleeps until an interrupt and an "int" line follows each report: the INTn edges and
+   the held ones per second, for the IRQ rate against the RTT tools/loopback_bench.py measures.
+   Build it once per setting, BENCH_INT_COUNT 0 for one edge per interrupt */
+#ifndef BENCH_INT
+#define BENCH_INT 0
+#endif
+
+#if BENCH_INT
+#if _WIZCHIP_ != W5100S
+#error "BENCH_INT needs the socket events of the W5100S"
+#endif
+
+#ifndef BENCH_INT_INTPTMR
+#define BENCH_INT_INTPTMR 0
+#endif
+
+#ifndef BENCH_INT_COUNT
+#define BENCH_INT_COUNT 4
+#endif
+
+#ifndef BENCH_INT_WINDOW_US
+#define BENCH_INT_WINDOW_US 500
+#endif
+
+#ifndef BENCH_INT_WINDOW_MAX_US // more than BENCH_INT_WINDOW_US for the adaptive window
+#define BENCH_INT_WINDOW_MAX_US BENCH_INT_WINDOW_US
+#endif
+
+#define BENCH_INT_WAIT_US 10000 // longest sleep, for the stdio keys and the reports of bench_poll()
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Network, the address of the loopback example and of the LAN8720 firmware */
+static wiz_NetInfo g_net_info =
+    {
+        .mac = {0x00, 0x08, 0xDC, 0x12, 0x34, 0x56}, // MAC address
+        .ip = {192, 168, 1, 15},                     // IP address
+        .sn = {255, 255, 255, 0},                    // Subnet Mask
+        .gw = {192, 168, 1, 1},                      // Gateway
+        .dns = {8, 8, 8, 8},                         // DNS server
+        .dhcp = NETINFO_STATIC                       // DHCP
+};
+
+/* 10Mbit/s full duplex, the speed of the LAN8720 firmware */
+static wiz_PhyConf g_phy_conf = {.by = PHY_CONFBY_SW,
+                                 .mode = PHY_MODE_MANUAL,
+                                 .speed = PHY_SPEED_10,
+                                 .duplex = PHY_DUPLEX_FULL};
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void);
+static void wizchip_initialize(void);
+static void wizchip_link(bool up);
+#if BENCH_INT
+static void bench_int_initialize(void);
+static void bench_int_poll(void);
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Main
+  * ----------------------------------------------------------------------------------------------------
+  */
+int main()
+{
+    uint32_t baudrate;
+
+    // a terminal is only waited for with BOOT_STDIO_USB_WAIT_MS and a USB host attached
+    stdio_init_all();
+    boot_stdio_wait();
+
+    set_sys_clock_khz(PLL_SYS_KHZ, true);
+
+#ifndef USE_BUS_PIO
+    // SPI_PORT from the system PLL, for PLL_SYS_KHZ / 2
+    clock_configure(
+        clk_peri,
+        0,                                                // No glitchless mux
+        CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, // System PLL on AUX mux
+        PLL_SYS_KHZ * 1000,                               // Input frequency
+        PLL_SYS_KHZ * 1000                                // Output (must be same as no divider)
+    );
+#endif
+
+    baudrate = wizchip_port_initialize();
+
+#if W5X00_SPI_PROFILE
+    // every scenario switch prints the transactions of its socket calls
+    w5x00_spi_profile_install();
+#endif
+    w5x00_pico_port_reset();
+    wizchip_initialize();
+
+    ctlwizchip(CW_SET_PHYCONF, &g_phy_conf);
+    ctlwizchip(CW_RESET_PHY, 0);
+
+    ctlnetwork(CN_SET_NETINFO, (void *)&g_net_info);
+
+    // the sockets listen at once, the link is reported, and announced, once it is up
+    w5x00_pico_port_link_callback(wizchip_link);
+
+    printf(" %d.%d.%d.%d, interface clock %luHz\n", g_net_info.ip[0], g_net_info.ip[1], g_net_info.ip[2], g_net_info.ip[3], (unsigned long)baudrate);
+
+#if _WIZCHIP_ == W5500
+    bench_init("w5500");
+#else
+    bench_init("w5100s");
+#endif
+
+#if BENCH_INT
+    bench_int_initialize();
+#endif
+
+    /* Infinite loop */
+    while (1)
+    {
+        w5x00_pico_port_link_poll();
+#if BENCH_INT
+        bench_int_poll();
+#endif
+#if BENCH_NET
+        net_poll();
+#else
+        bench_poll();
+#endif
+    }
+}
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void)
+{
+    w5x00_pico_port_config_t config;
+
+    w5x00_pico_port_get_default_config(&config);
+
+    config.spi = SPI_PORT;
+    config.pin_sck = PIN_SCK;
+    config.pin_mosi = PIN_MOSI;
+    config.pin_miso = PIN_MISO;
+    config.pin_cs = PIN_CS;
+    config.pin_rst = PIN_RST;
+#if BENCH_INT
+    config.pin_int = PIN_INT;
+#else
+    config.pin_int = W5X00_PICO_PORT_PIN_NONE;
+#endif
+#ifdef USE_BUS_PIO
+    config.pin_bus_d0 = PIN_BUS_D0;
+    config.pin_bus_cs = PIN_BUS_CS;
+    config.baudrate = BUS_PIO_HZ;
+#else
+    config.baudrate = SPI_HZ;
+#endif
+
+    return w5x00_pico_port_init(&config);
+}
+
+static void wizchip_initialize(void)
+{
+    wizchip_port_rp2040_init(WIZCHIP_PORT_LOCK_SOCKET);
+
+    // TX then RX sizes in KB, an equal share for every socket of the scenario
+#if _WIZCHIP_ == W5500
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{2, 2, 2, 2, 2, 2, 2, 2}, {2, 2, 2, 2, 2, 2, 2, 2}};
+#else
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{2, 2, 2, 2}, {2, 2, 2, 2}};
+#endif
+
+    if (ctlwizchip(CW_INIT_WIZCHIP, (void *)memsize) == -1)
+    {
+        printf(" W5x00 initialized fail\n");
+
+        return;
+    }
+
+#if _WIZCHIP_ == W5500
+    if (getVERSIONR() != WIZCHIP_VERSION)
+#else
+    if (getVER() != WIZCHIP_VERSION)
+#endif
+    {
+        printf(" ACCESS ERR : VERSIONR != 0x%02x\n", WIZCHIP_VERSION);
+
+        while (1)
+            ;
+    }
+}
+
+static void wizchip_link(bool up)
+{
+    if (up)
+    {
+        bench_count_link_up();
+        printf(" PHY link status changed up\n");
+    }
+    else
+    {
+        printf(" PHY link status changed down\n");
+    }
+}
+
+#if BENCH_INT
+static void bench_int_event(uint8_t sn, uint8_t events)
+{
+    // the sockets are served by bench_poll(), the callback only releases INTn
+}
+
+static void bench_int_initialize(void)
+{
+    const w5x00_pico_port_coalesce_t coalesce = {.intptmr = BENCH_INT_INTPTMR,
+                                                 .count = BENCH_INT_COUNT,
+                                                 .window_us = BENCH_INT_WINDOW_US,
+                                                 .window_max_us = BENCH_INT_WINDOW_MAX_US};
+
+    for (uint8_t sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++)
+    {
+        reg_sockevent_cbfunc(sn, SIK_CONNECTED | SIK_DISCONNECTED | SIK_RECEIVED, bench_int_event);
+    }
+
+    w5x00_pico_port_int_enable();
+    w5x00_pico_port_int_coalesce(&coalesce);
+
+    printf(" INTn coalescing: INTPTMR %u, %u edges per %lu-%lu us\n", BENCH_INT_INTPTMR, BENCH_INT_COUNT,
+           (unsigned long)BENCH_INT_WINDOW_US, (unsigned long)BENCH_INT_WINDOW_MAX_US);
+}
+
+static void bench_int_poll(void)
+{
+    static w5x00_pico_port_int_stats_t last;
+    static uint64_t last_us;
+    w5x00_pico_port_int_stats_t stats;
+    absolute_time_t timeout = make_timeout_time_us(BENCH_INT_WAIT_US);
+    uint64_t now;
+
+    // the GPIO IRQ of INTn or the alarm of a held edge ends the wfe
+    while (!sockevent_pending() && !best_effort_wfe_or_timeout(timeout))
+        ;
+
+    if (sockevent_pending())
+        sockevent_dispatch();
+
+    now = time_us_64();
+
+    if ((now - last_us) >= (BENCH_REPORT_MS * 1000ull))
+    {
+        w5x00_pico_port_int_get_stats(&stats);
+
+        if (stats.edges != last.edges)
+        {
+            printf("bench w5100s int: %lu edges/s, %lu held/s, window %lu us\n",
+                   (unsigned long)((uint64_t)(stats.edges - last.edges) * 1000000 / (now - last_us)),
+                   (unsigned long)((uint64_t)(stats.held - last.held) * 1000000 / (now - last_us)),
+                   (unsigned long)stats.window_us);
+        }
+
+        last = stats;
+        last_us = now;
+    }
+}
+#endif
@@ -0,0 +1,230 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/binary_info.h"
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/timeouts.h"
+
+#include "wizchip_conf.h"
+#include "wizchip_port_rp2040.h"
+
+#include "w5x00_pico_port.h"
+#include "w5x00_lwip_netif.h"
+
+#include "bench.h"
+#include "boot.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* SPI, as the loopback example */
+#define SPI_PORT spi0
+
+#define PIN_SCK 18
+#define PIN_MOSI 19
+#define PIN_MISO 16
+#define PIN_CS 17
+#define PIN_RST 20
+
+/* W5100S indirect bus over PIO instead of SPI, configured with -DWIZCHIP_BUS_INDIR=ON */
+#if _WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_
+#define USE_BUS_PIO
+
+#define BUS_PIO_HZ (62500 * 1000) // PIO clock, a byte every 8 cycles
+
+#define PIN_BUS_D0 0
+#define PIN_BUS_CS 10
+#endif
+
+/* Clock */
+#ifdef USE_BUS_PIO
+#define PLL_SYS_KHZ (125 * 1000)
+#elif _WIZCHIP_ == W5500
+#define PLL_SYS_KHZ (133 * 1000) // the RP2040 maximum, SPI_PORT gets 66.5MHz
+#else
+#define PLL_SYS_KHZ (50 * 1000)
+#endif
+
+/* SPI clock, PLL_SYS_KHZ / 2 from SPI_PORT */
+#if _WIZCHIP_ == W5500
+#define SPI_HZ (80 * 1000 * 1000) // W5500 maximum
+#define WIZCHIP_VERSION 0x04
+#else
+#define SPI_HZ (50 * 1000 * 1000)
+#define WIZCHIP_VERSION 0x51
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* MAC address of w5x00_bench, the IP configuration is lwIP's */
+static const uint8_t g_mac[6] = {0x00, 0x08, 0xDC, 0x12, 0x34, 0x56};
+
+/* 10Mbit/s full duplex, the speed of the LAN8720 firmware */
+static wiz_PhyConf g_phy_conf = {.by = PHY_CONFBY_SW,
+                                 .mode = PHY_MODE_MANUAL,
+                                 .speed = PHY_SPEED_10,
+                                 .duplex = PHY_DUPLEX_FULL};
+
+/* LWIP network interface */
+static struct netif g_netif;
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void);
+static void netif_link_callback(struct netif *netif);
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Main
+  * ----------------------------------------------------------------------------------------------------
+  */
+int main()
+{
+    uint32_t baudrate;
+
+    // a terminal is only waited for with BOOT_STDIO_USB_WAIT_MS and a USB host attached
+    stdio_init_all();
+    boot_stdio_wait();
+
+    set_sys_clock_khz(PLL_SYS_KHZ, true);
+
+#ifndef USE_BUS_PIO
+    // SPI_PORT from the system PLL, for PLL_SYS_KHZ / 2
+    clock_configure(
+        clk_peri,
+        0,                                                // No glitchless mux
+        CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, // System PLL on AUX mux
+        PLL_SYS_KHZ * 1000,                               // Input frequency
+        PLL_SYS_KHZ * 1000                                // Output (must be same as no divider)
+    );
+#endif
+
+    baudrate = wizchip_port_initialize();
+
+    w5x00_pico_port_reset();
+    wizchip_port_rp2040_init(WIZCHIP_PORT_LOCK_SOCKET);
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // socket 0 in MACRAW mode with all the buffer memory, lwIP on top
+    if (w5x00_lwip_netif_init(&g_netif, g_mac) != ERR_OK)
+    {
+        printf(" W5x00 MACRAW netif initialized fail\n");
+
+        while (1)
+            ;
+    }
+
+#if _WIZCHIP_ == W5500
+    if (getVERSIONR() != WIZCHIP_VERSION)
+#else
+    if (getVER() != WIZCHIP_VERSION)
+#endif
+    {
+        printf(" ACCESS ERR : VERSIONR != 0x%02x\n", WIZCHIP_VERSION);
+
+        while (1)
+            ;
+    }
+
+    ctlwizchip(CW_SET_PHYCONF, &g_phy_conf);
+    ctlwizchip(CW_RESET_PHY, 0);
+
+    // the address of w5x00_bench and of the LAN8720 firmware
+    IP_ADDR4(&g_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_netif.gw, 192, 168, 1, 1);
+
+    netif_set_link_callback(&g_netif, netif_link_callback);
+
+    // set the default interface and bring it up
+    netif_set_default(&g_netif);
+    netif_set_up(&g_netif);
+
+    printf(" %s, interface clock %luHz\n", ip4addr_ntoa(netif_ip4_addr(&g_netif)), (unsigned long)baudrate);
+
+    // serves from lwIP timers, as pico_rmii_ethernet_bench
+#if _WIZCHIP_ == W5500
+    bench_init("w5500-lwip");
+#else
+    bench_init("w5100s-lwip");
+#endif
+
+    /* Infinite loop */
+    while (1)
+    {
+        w5x00_lwip_netif_poll(&g_netif);
+        sys_check_timeouts();
+    }
+}
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void)
+{
+    w5x00_pico_port_config_t config;
+
+    w5x00_pico_port_get_default_config(&config);
+
+    config.spi = SPI_PORT;
+    config.pin_sck = PIN_SCK;
+    config.pin_mosi = PIN_MOSI;
+    config.pin_miso = PIN_MISO;
+    config.pin_cs = PIN_CS;
+    config.pin_rst = PIN_RST;
+    config.pin_int = W5X00_PICO_PORT_PIN_NONE;
+#ifdef USE_BUS_PIO
+    config.pin_bus_d0 = PIN_BUS_D0;
+    config.pin_bus_cs = PIN_BUS_CS;
+    config.baudrate = BUS_PIO_HZ;
+#else
+    config.baudrate = SPI_HZ;
+#endif
+
+    return w5x00_pico_port_init(&config);
+}
+
+static void netif_link_callback(struct netif *netif)
+{
+    w5x00_lwip_netif_stats_t stats;
+
+    w5x00_lwip_netif_get_stats(&stats);
+
+    if (netif_is_link_up(netif))
+    {
+        bench_count_link_up();
+        printf(" netif link status changed up\n");
+    }
+    else
+    {
+        printf(" netif link status changed down, rx %lu frames %lu nobuf %lu errors, tx %lu frames %lu timeouts\n",
+               (unsigned long)stats.rx_frames, (unsigned long)stats.rx_nobuf, (unsigned long)stats.rx_errors,
+               (unsigned long)stats.tx_frames, (unsigned long)stats.tx_timeout);
+    }
+}
@@ -0,0 +1,308 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "wizchip_conf.h"
+#include "wizchip_port_rp2040.h"
+#include "socket.h"
+
+#include "w5x00_pico_port.h"
+
+#include "boot.h"
+#include "bulk.h"
+#include "timebase.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* SPI, as the loopback example */
+#define SPI_PORT spi0
+
+#define PIN_SCK 18
+#define PIN_MOSI 19
+#define PIN_MISO 16
+#define PIN_CS 17
+#define PIN_RST 20
+
+/* W5100S indirect bus over PIO instead of SPI, configured with -DWIZCHIP_BUS_INDIR=ON */
+#if _WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_
+#define USE_BUS_PIO
+
+#define BUS_PIO_HZ (62500 * 1000) // PIO clock, a byte every 8 cycles
+
+#define PIN_BUS_D0 0
+#define PIN_BUS_CS 10
+#endif
+
+/* Clock */
+#ifdef USE_BUS_PIO
+#define PLL_SYS_KHZ (125 * 1000)
+#elif _WIZCHIP_ == W5500
+#define PLL_SYS_KHZ (133 * 1000) // the RP2040 maximum, SPI_PORT gets 66.5MHz
+#else
+#define PLL_SYS_KHZ (50 * 1000)
+#endif
+
+/* SPI clock, PLL_SYS_KHZ / 2 from SPI_PORT */
+#if _WIZCHIP_ == W5500
+#define SPI_HZ (80 * 1000 * 1000) // W5500 maximum
+#define WIZCHIP_VERSION 0x04
+#else
+#define SPI_HZ (50 * 1000 * 1000)
+#define WIZCHIP_VERSION 0x51
+#endif
+
+/* Socket of the transfers, it gets the whole TX memory of the chip */
+#define SOCKET_BULK 0
+
+/* Sources a REQ names, tools/bulk_recv.py --source */
+#define BULK_SOURCE_PATTERN 0 // BULK_PATTERN_SIZE bytes of a counter, for the throughput and the check
+#define BULK_SOURCE_FLASH 1   // the firmware image, as it is in flash
+
+#ifndef BULK_PATTERN_SIZE
+#define BULK_PATTERN_SIZE (4 * 1024 * 1024)
+#endif
+
+#define BULK_REPORT_MS 1000
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Network, the address of the loopback example and of the LAN8720 firmware */
+static wiz_NetInfo g_net_info =
+    {
+        .mac = {0x00, 0x08, 0xDC, 0x12, 0x34, 0x56}, // MAC address
+        .ip = {192, 168, 1, 15},                     // IP address
+        .sn = {255, 255, 255, 0},                    // Subnet Mask
+        .gw = {192, 168, 1, 1},                      // Gateway
+        .dns = {8, 8, 8, 8},                         // DNS server
+        .dhcp = NETINFO_STATIC                       // DHCP
+};
+
+/* 100Mbit/s full duplex, the wire is not what limits a transfer */
+static wiz_PhyConf g_phy_conf = {.by = PHY_CONFBY_SW,
+                                 .mode = PHY_MODE_MANUAL,
+                                 .speed = PHY_SPEED_100,
+                                 .duplex = PHY_DUPLEX_FULL};
+
+/* Datagrams of a batch */
+static uint8_t g_bulk_buf[BULK_BUF_SIZE];
+
+/* The image, from the linker script */
+extern char __flash_binary_start;
+extern char __flash_binary_end;
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void);
+static void wizchip_initialize(void);
+static void wizchip_link(bool up);
+static uint32_t pattern_size(void *arg);
+static int32_t pattern_read(void *arg, uint32_t offset, uint8_t *buf, uint16_t len);
+static uint32_t flash_size(void *arg);
+static int32_t flash_read(void *arg, uint32_t offset, uint8_t *buf, uint16_t len);
+static void bulk_report(void);
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Main
+  * ----------------------------------------------------------------------------------------------------
+  */
+int main()
+{
+    const wiz_BulkSource pattern = {pattern_size, pattern_read, NULL};
+    const wiz_BulkSource flash = {flash_size, flash_read, NULL};
+    uint32_t baudrate;
+    uint32_t report_ms;
+
+    // a terminal is only waited for with BOOT_STDIO_USB_WAIT_MS and a USB host attached
+    stdio_init_all();
+    boot_stdio_wait();
+
+    set_sys_clock_khz(PLL_SYS_KHZ, true);
+
+#ifndef USE_BUS_PIO
+    // SPI_PORT from the system PLL, for PLL_SYS_KHZ / 2
+    clock_configure(
+        clk_peri,
+        0,                                                // No glitchless mux
+        CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, // System PLL on AUX mux
+        PLL_SYS_KHZ * 1000,                               // Input frequency
+        PLL_SYS_KHZ * 1000                                // Output (must be same as no divider)
+    );
+#endif
+
+    baudrate = wizchip_port_initialize();
+
+    w5x00_pico_port_reset();
+    wizchip_initialize();
+
+    ctlwizchip(CW_SET_PHYCONF, &g_phy_conf);
+    ctlwizchip(CW_RESET_PHY, 0);
+
+    ctlnetwork(CN_SET_NETINFO, (void *)&g_net_info);
+
+    w5x00_pico_port_link_callback(wizchip_link);
+
+    BULK_source(BULK_SOURCE_PATTERN, &pattern);
+    BULK_source(BULK_SOURCE_FLASH, &flash);
+    BULK_init(SOCKET_BULK, g_bulk_buf);
+
+    printf(" %d.%d.%d.%d, interface clock %luHz, bulk on UDP port %d\n", g_net_info.ip[0], g_net_info.ip[1], g_net_info.ip[2],
+           g_net_info.ip[3], (unsigned long)baudrate, BULK_PORT);
+
+    report_ms = timebase_ms();
+
+    /* Infinite loop */
+    while (1)
+    {
+        w5x00_pico_port_link_poll();
+        BULK_run();
+
+        if (timebase_ms() - report_ms >= BULK_REPORT_MS)
+        {
+            report_ms += BULK_REPORT_MS;
+            bulk_report();
+        }
+    }
+}
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void)
+{
+    w5x00_pico_port_config_t config;
+
+    w5x00_pico_port_get_default_config(&config);
+
+    config.spi = SPI_PORT;
+    config.pin_sck = PIN_SCK;
+    config.pin_mosi = PIN_MOSI;
+    config.pin_miso = PIN_MISO;
+    config.pin_cs = PIN_CS;
+    config.pin_rst = PIN_RST;
+    config.pin_int = W5X00_PICO_PORT_PIN_NONE;
+#ifdef USE_BUS_PIO
+    config.pin_bus_d0 = PIN_BUS_D0;
+    config.pin_bus_cs = PIN_BUS_CS;
+    config.baudrate = BUS_PIO_HZ;
+#else
+    config.baudrate = SPI_HZ;
+#endif
+
+    return w5x00_pico_port_init(&config);
+}
+
+static void wizchip_initialize(void)
+{
+    wizchip_port_rp2040_init(WIZCHIP_PORT_LOCK_SOCKET);
+
+    // TX then RX sizes in KB: the transfers take all of TX, a window of datagrams in the chip,
+    // and only the REQs and STATUSes come in
+#if _WIZCHIP_ == W5500
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{16, 0, 0, 0, 0, 0, 0, 0}, {2, 2, 2, 2, 2, 2, 2, 2}};
+#else
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{8, 0, 0, 0}, {2, 2, 2, 2}};
+#endif
+
+    if (ctlwizchip(CW_INIT_WIZCHIP, (void *)memsize) == -1)
+    {
+        printf(" W5x00 initialized fail\n");
+
+        return;
+    }
+
+#if _WIZCHIP_ == W5500
+    if (getVERSIONR() != WIZCHIP_VERSION)
+#else
+    if (getVER() != WIZCHIP_VERSION)
+#endif
+    {
+        printf(" ACCESS ERR : VERSIONR != 0x%02x\n", WIZCHIP_VERSION);
+
+        while (1)
+            ;
+    }
+}
+
+static void wizchip_link(bool up)
+{
+    if (up)
+    {
+        printf(" PHY link status changed up\n");
+    }
+    else
+    {
+        printf(" PHY link status changed down\n");
+    }
+}
+
+static uint32_t pattern_size(void *arg)
+{
+    return BULK_PATTERN_SIZE;
+}
+
+// the byte at offset n is n & 0xff, bulk_recv.py --check counter
+static int32_t pattern_read(void *arg, uint32_t offset, uint8_t *buf, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+    {
+        buf[i] = (uint8_t)(offset + i);
+    }
+
+    return len;
+}
+
+static uint32_t flash_size(void *arg)
+{
+    return (uint32_t)(&__flash_binary_end - &__flash_binary_start);
+}
+
+static int32_t flash_read(void *arg, uint32_t offset, uint8_t *buf, uint16_t len)
+{
+    memcpy(buf, &__flash_binary_start + offset, len);
+
+    return len;
+}
+
+// the counters of the last BULK_REPORT_MS, while there is something to tell
+static void bulk_report(void)
+{
+    static wiz_BulkStats last;
+    wiz_BulkStats stats;
+
+    BULK_get_stats(&stats);
+
+    if ((stats.sent != last.sent) || (stats.transfers != last.transfers))
+    {
+        printf("bulk: %lu datagrams, %lu resent, %lu busy, rate %lu kbit/s, transfers %lu, completed %lu, aborted %lu\n",
+               (unsigned long)(stats.sent - last.sent), (unsigned long)(stats.resent - last.resent),
+               (unsigned long)(stats.busy - last.busy), (unsigned long)stats.rate_kbps, (unsigned long)stats.transfers,
+               (unsigned long)stats.completed, (unsigned long)stats.aborted);
+    }
+
+    last = stats;
+}
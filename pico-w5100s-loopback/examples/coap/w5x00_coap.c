@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "wizchip_conf.h"
+#include "wizchip_port_rp2040.h"
+
+#include "w5x00_pico_port.h"
+
+#include "boot.h"
+#include "net.h"
+#include "coap_demo.h"
+#include "coap_web_pack.h"
+
+#include "web_pack.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* SPI, as the loopback example */
+#define SPI_PORT spi0
+
+#define PIN_SCK 18
+#define PIN_MOSI 19
+#define PIN_MISO 16
+#define PIN_CS 17
+#define PIN_RST 20
+
+/* W5100S indirect bus over PIO instead of SPI, configured with -DWIZCHIP_BUS_INDIR=ON */
+#if _WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_
+#define USE_BUS_PIO
+
+#define BUS_PIO_HZ (62500 * 1000) // PIO clock, a byte every 8 cycles
+
+#define PIN_BUS_D0 0
+#define PIN_BUS_CS 10
+#endif
+
+/* Clock */
+#ifdef USE_BUS_PIO
+#define PLL_SYS_KHZ (125 * 1000)
+#elif _WIZCHIP_ == W5500
+#define PLL_SYS_KHZ (133 * 1000) // the RP2040 maximum, SPI_PORT gets 66.5MHz
+#else
+#define PLL_SYS_KHZ (50 * 1000)
+#endif
+
+/* SPI clock, PLL_SYS_KHZ / 2 from SPI_PORT */
+#if _WIZCHIP_ == W5500
+#define SPI_HZ (80 * 1000 * 1000) // W5500 maximum
+#define WIZCHIP_VERSION 0x04
+#else
+#define SPI_HZ (50 * 1000 * 1000)
+#define WIZCHIP_VERSION 0x51
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Network, the address of the loopback example and of the LAN8720 firmware */
+static wiz_NetInfo g_net_info =
+    {
+        .mac = {0x00, 0x08, 0xDC, 0x12, 0x34, 0x56}, // MAC address
+        .ip = {192, 168, 1, 15},                     // IP address
+        .sn = {255, 255, 255, 0},                    // Subnet Mask
+        .gw = {192, 168, 1, 1},                      // Gateway
+        .dns = {8, 8, 8, 8},                         // DNS server
+        .dhcp = NETINFO_STATIC                       // DHCP
+};
+
+/* 100Mbit/s full duplex */
+static wiz_PhyConf g_phy_conf = {.by = PHY_CONFBY_SW,
+                                 .mode = PHY_MODE_MANUAL,
+                                 .speed = PHY_SPEED_100,
+                                 .duplex = PHY_DUPLEX_FULL};
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void);
+static void wizchip_initialize(void);
+static void wizchip_link(bool up);
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Main
+  * ----------------------------------------------------------------------------------------------------
+  */
+int main()
+{
+    uint32_t baudrate;
+
+    // a terminal is only waited for with BOOT_STDIO_USB_WAIT_MS and a USB host attached
+    stdio_init_all();
+    boot_stdio_wait();
+
+    set_sys_clock_khz(PLL_SYS_KHZ, true);
+
+#ifndef USE_BUS_PIO
+    // SPI_PORT from the system PLL, for PLL_SYS_KHZ / 2
+    clock_configure(
+        clk_peri,
+        0,                                                // No glitchless mux
+        CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, // System PLL on AUX mux
+        PLL_SYS_KHZ * 1000,                               // Input frequency
+        PLL_SYS_KHZ * 1000                                // Output (must be same as no divider)
+    );
+#endif
+
+    baudrate = wizchip_port_initialize();
+
+    w5x00_pico_port_reset();
+    wizchip_initialize();
+
+    ctlwizchip(CW_SET_PHYCONF, &g_phy_conf);
+    ctlwizchip(CW_RESET_PHY, 0);
+
+    ctlnetwork(CN_SET_NETINFO, (void *)&g_net_info);
+
+    w5x00_pico_port_link_callback(wizchip_link);
+
+    printf(" %d.%d.%d.%d, interface clock %luHz\n", g_net_info.ip[0], g_net_info.ip[1], g_net_info.ip[2],
+           g_net_info.ip[3], (unsigned long)baudrate);
+
+    // the CoAP resources of coap/coap_demo.h on a socket of the chip, the same source as
+    // pico_rmii_ethernet_coap, then the files of web/ as the httpServer would serve them
+    coap_web_pack_register(&web_pack);
+    coap_demo_init(coap_web_pack_find);
+
+    /* Infinite loop */
+    while (1)
+    {
+        w5x00_pico_port_link_poll();
+        net_poll();
+    }
+}
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void)
+{
+    w5x00_pico_port_config_t config;
+
+    w5x00_pico_port_get_default_config(&config);
+
+    config.spi = SPI_PORT;
+    config.pin_sck = PIN_SCK;
+    config.pin_mosi = PIN_MOSI;
+    config.pin_miso = PIN_MISO;
+    config.pin_cs = PIN_CS;
+    config.pin_rst = PIN_RST;
+    config.pin_int = W5X00_PICO_PORT_PIN_NONE;
+#ifdef USE_BUS_PIO
+    config.pin_bus_d0 = PIN_BUS_D0;
+    config.pin_bus_cs = PIN_BUS_CS;
+    config.baudrate = BUS_PIO_HZ;
+#else
+    config.baudrate = SPI_HZ;
+#endif
+
+    return w5x00_pico_port_init(&config);
+}
+
+static void wizchip_initialize(void)
+{
+    wizchip_port_rp2040_init(WIZCHIP_PORT_LOCK_SOCKET);
+
+    // TX then RX sizes in KB, an equal share for every socket, the server takes one
+#if _WIZCHIP_ == W5500
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{2, 2, 2, 2, 2, 2, 2, 2}, {2, 2, 2, 2, 2, 2, 2, 2}};
+#else
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{2, 2, 2, 2}, {2, 2, 2, 2}};
+#endif
+
+    if (ctlwizchip(CW_INIT_WIZCHIP, (void *)memsize) == -1)
+    {
+        printf(" W5x00 initialized fail\n");
+
+        return;
+    }
+
+#if _WIZCHIP_ == W5500
+    if (getVERSIONR() != WIZCHIP_VERSION)
+#else
+    if (getVER() != WIZCHIP_VERSION)
+#endif
+    {
+        printf(" ACCESS ERR : VERSIONR != 0x%02x\n", WIZCHIP_VERSION);
+
+        while (1)
+            ;
+    }
+}
+
+static void wizchip_link(bool up)
+{
+    if (up)
+    {
+        printf(" PHY link status changed up\n");
+    }
+    else
+    {
+        printf(" PHY link status changed down\n");
+    }
+}
@@ -0,0 +1,262 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/binary_info.h"
+#include "hardware/clocks.h"
+
+#include "wizchip_conf.h"
+#include "wizchip_port_rp2040.h"
+#include "socket.h"
+
+#include "w5x00_pico_port.h"
+#include "w5x00_co.hpp"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* SPI, as the loopback example */
+#define SPI_PORT spi0
+
+#define PIN_SCK 18
+#define PIN_MOSI 19
+#define PIN_MISO 16
+#define PIN_CS 17
+#define PIN_RST 20
+#define PIN_INT 21
+
+/* Buffer, one per socket */
+#define ETHERNET_BUF_MAX_SIZE (1024 * 2)
+
+/* Port */
+#define PORT_LOOPBACK 5000
+
+/* Clock */
+#if _WIZCHIP_ == W5500
+#define PLL_SYS_KHZ (133 * 1000) // the RP2040 maximum, SPI_PORT gets 66.5MHz
+#else
+#define PLL_SYS_KHZ (50 * 1000)
+#endif
+
+/* SPI clock, PLL_SYS_KHZ / 2 from SPI_PORT */
+#if _WIZCHIP_ == W5500
+#define SPI_HZ (80 * 1000 * 1000) // W5500 maximum
+#define WIZCHIP_VERSION 0x04
+#else
+#define SPI_HZ (50 * 1000 * 1000)
+#define WIZCHIP_VERSION 0x51
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Network */
+static wiz_NetInfo g_net_info =
+    {
+        .mac = {0x00, 0x08, 0xDC, 0x12, 0x34, 0x56}, // MAC address
+        .ip = {192, 168, 1, 15},                     // IP address
+        .sn = {255, 255, 255, 0},                    // Subnet Mask
+        .gw = {192, 168, 1, 1},                      // Gateway
+        .dns = {8, 8, 8, 8},                         // DNS server
+        .dhcp = NETINFO_STATIC                       // DHCP
+};
+
+/* 10Mbit/s full duplex, as the loopback example */
+static wiz_PhyConf g_phy_conf = {.by = PHY_CONFBY_SW,
+                                 .mode = PHY_MODE_MANUAL,
+                                 .speed = PHY_SPEED_10,
+                                 .duplex = PHY_DUPLEX_FULL};
+
+/* Loopback */
+static uint8_t g_loopback_buf[_WIZCHIP_SOCK_NUM_][ETHERNET_BUF_MAX_SIZE];
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void);
+static void wizchip_initialize(void);
+static wiz::task loopback_serve(uint8_t sn);
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Main
+  * ----------------------------------------------------------------------------------------------------
+  */
+int main()
+{
+    uint32_t baudrate;
+    uint8_t sn;
+
+    stdio_init_all();
+
+    set_sys_clock_khz(PLL_SYS_KHZ, true);
+
+    // SPI_PORT from the system PLL, for PLL_SYS_KHZ / 2
+    clock_configure(
+        clk_peri,
+        0,                                                // No glitchless mux
+        CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, // System PLL on AUX mux
+        PLL_SYS_KHZ * 1000,                               // Input frequency
+        PLL_SYS_KHZ * 1000                                // Output (must be same as no divider)
+    );
+
+    baudrate = wizchip_port_initialize();
+
+    w5x00_pico_port_reset();
+    wizchip_initialize();
+
+    ctlwizchip(CW_SET_PHYCONF, &g_phy_conf);
+    ctlwizchip(CW_RESET_PHY, 0);
+
+    ctlnetwork(CN_SET_NETINFO, (void *)&g_net_info);
+
+    printf(" %d.%d.%d.%d:%d, spi clock %luHz\n", g_net_info.ip[0], g_net_info.ip[1], g_net_info.ip[2], g_net_info.ip[3],
+           PORT_LOOPBACK, (unsigned long)baudrate);
+
+    // INTn falling edges call sockevent_isr(), wiz::run() sleeps in wiz_poll() until one
+    w5x00_pico_port_int_enable();
+
+    bi_decl(bi_1pin_with_name(PIN_INT, "W5x00 INTERRUPT"));
+
+    // a coroutine per socket, all listening on PORT_LOOPBACK
+    for (sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++)
+    {
+        if (!wiz::spawn(loopback_serve(sn)))
+        {
+            printf(" %d : coroutine frame not available\n", sn);
+        }
+    }
+
+    wiz::run();
+}
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void)
+{
+    w5x00_pico_port_config_t config;
+
+    w5x00_pico_port_get_default_config(&config);
+
+    config.spi = SPI_PORT;
+    config.pin_sck = PIN_SCK;
+    config.pin_mosi = PIN_MOSI;
+    config.pin_miso = PIN_MISO;
+    config.pin_cs = PIN_CS;
+    config.pin_rst = PIN_RST;
+    config.pin_int = PIN_INT;
+    config.baudrate = SPI_HZ;
+
+    return w5x00_pico_port_init(&config);
+}
+
+static void wizchip_initialize(void)
+{
+    uint8_t link;
+
+    wizchip_port_rp2040_init(WIZCHIP_PORT_LOCK_SOCKET);
+
+    // 2KB each way per socket, the defaults of both chips
+    if (ctlwizchip(CW_INIT_WIZCHIP, nullptr) == -1)
+    {
+        printf(" W5x00 initialized fail\n");
+
+        return;
+    }
+
+#if _WIZCHIP_ == W5500
+    if (getVERSIONR() != WIZCHIP_VERSION)
+#else
+    if (getVER() != WIZCHIP_VERSION)
+#endif
+    {
+        printf(" ACCESS ERR : VERSIONR != 0x%02x\n", WIZCHIP_VERSION);
+
+        while (1)
+            ;
+    }
+
+    do
+    {
+        if (ctlwizchip(CW_GET_PHYLINK, (void *)&link) == -1)
+        {
+            printf(" Unknown PHY link status\n");
+
+            return;
+        }
+    } while (link == PHY_LINK_OFF);
+}
+
+/* The echo of loopback_tcps(), one connection after another on socket sn */
+static wiz::task loopback_serve(uint8_t sn)
+{
+    uint8_t *buf = g_loopback_buf[sn];
+    int32_t ret;
+
+    while (true)
+    {
+        if ((ret = socket(sn, Sn_MR_TCP, PORT_LOOPBACK, SF_IO_NONBLOCK)) != sn)
+        {
+            printf(" %d : socket error %ld\n", sn, (long)ret);
+
+            co_await wiz::sleep(1000);
+
+            continue;
+        }
+
+        listen(sn);
+
+        if (co_await wiz::established(sn) == SOCK_OK)
+        {
+            printf(" %d : connected\n", sn);
+
+            // recv() returns an error once the peer has closed and everything was read
+            while ((ret = co_await wiz::recv(sn, buf, ETHERNET_BUF_MAX_SIZE)) > 0)
+            {
+                int32_t sent = 0;
+
+                while (sent < ret)
+                {
+                    int32_t n = co_await wiz::send(sn, buf + sent, (uint16_t)(ret - sent));
+
+                    if (n < 0)
+                        break;
+
+                    sent += n;
+                }
+
+                if (sent < ret)
+                    break;
+            }
+
+            disconnect(sn);
+
+            // FIN sent, the chip closes the socket on the peer's ACK or its own timeout
+            for (uint32_t ms = 0; (getSn_SR(sn) != SOCK_CLOSED) && (ms < 100); ms++)
+                co_await wiz::sleep(1);
+
+            printf(" %d : closed\n", sn);
+        }
+
+        close(sn);
+    }
+}
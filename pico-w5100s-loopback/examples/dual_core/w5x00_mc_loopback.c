@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/binary_info.h"
+#include "pico/multicore.h"
+#include "hardware/clocks.h"
+
+#include "wizchip_conf.h"
+#include "wizchip_port_rp2040.h"
+#include "socket.h"
+
+#include "w5x00_pico_port.h"
+#include "w5x00_mc.h"
+
+#include "boot.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* SPI, as the loopback example */
+#define SPI_PORT spi0
+
+#define PIN_SCK 18
+#define PIN_MOSI 19
+#define PIN_MISO 16
+#define PIN_CS 17
+#define PIN_RST 20
+#define PIN_INT 21
+
+/* Buffer of the application core, shared by the sockets */
+#define ETHERNET_BUF_MAX_SIZE (1024 * 2)
+
+/* Port */
+#define PORT_LOOPBACK 5000
+
+/* Longest sleep of the application core between doorbells */
+#define LOOPBACK_WAIT_US (100 * 1000)
+
+/* Clock */
+#if _WIZCHIP_ == W5500
+#define PLL_SYS_KHZ (133 * 1000) // the RP2040 maximum, SPI_PORT gets 66.5MHz
+#else
+#define PLL_SYS_KHZ (50 * 1000)
+#endif
+
+/* SPI clock, PLL_SYS_KHZ / 2 from SPI_PORT */
+#if _WIZCHIP_ == W5500
+#define SPI_HZ (80 * 1000 * 1000) // W5500 maximum
+#define WIZCHIP_VERSION 0x04
+#else
+#define SPI_HZ (50 * 1000 * 1000)
+#define WIZCHIP_VERSION 0x51
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Network */
+static wiz_NetInfo g_net_info =
+    {
+        .mac = {0x00, 0x08, 0xDC, 0x12, 0x34, 0x56}, // MAC address
+        .ip = {192, 168, 1, 15},                     // IP address
+        .sn = {255, 255, 255, 0},                    // Subnet Mask
+        .gw = {192, 168, 1, 1},                      // Gateway
+        .dns = {8, 8, 8, 8},                         // DNS server
+        .dhcp = NETINFO_STATIC                       // DHCP
+};
+
+/* 10Mbit/s full duplex, as the loopback example */
+static wiz_PhyConf g_phy_conf = {.by = PHY_CONFBY_SW,
+                                 .mode = PHY_MODE_MANUAL,
+                                 .speed = PHY_SPEED_10,
+                                 .duplex = PHY_DUPLEX_FULL};
+
+/* Loopback */
+static uint8_t g_loopback_buf[ETHERNET_BUF_MAX_SIZE];
+static w5x00_mc_state_t g_loopback_state[W5X00_MC_SOCKETS];
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static void wizchip_core1_main(void);
+static uint32_t wizchip_port_initialize(void);
+static void wizchip_initialize(void);
+static void wizchip_link(bool up);
+static void loopback_mc(uint8_t sn);
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Main
+  * ----------------------------------------------------------------------------------------------------
+  */
+int main()
+{
+    uint8_t sn;
+
+    // a terminal is only waited for with BOOT_STDIO_USB_WAIT_MS and a USB host attached
+    stdio_init_all();
+    boot_stdio_wait();
+
+    set_sys_clock_khz(PLL_SYS_KHZ, true);
+
+    // SPI_PORT from the system PLL, for PLL_SYS_KHZ / 2
+    clock_configure(
+        clk_peri,
+        0,                                                // No glitchless mux
+        CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, // System PLL on AUX mux
+        PLL_SYS_KHZ * 1000,                               // Input frequency
+        PLL_SYS_KHZ * 1000                                // Output (must be same as no divider)
+    );
+
+    bi_decl(bi_1pin_with_name(PIN_INT, "W5x00 INTERRUPT"));
+
+    // the chip is set up and served on core 1, the FIFOs are free once it runs
+    multicore_launch_core1(wizchip_core1_main);
+
+    // all the sockets listen on PORT_LOOPBACK, as the loopback example with USE_LOOPBACK_MULTI
+    for (sn = 0; sn < W5X00_MC_SOCKETS; sn++)
+        w5x00_mc_listen(sn, PORT_LOOPBACK);
+
+    /* Infinite loop */
+    while (1)
+    {
+        for (sn = 0; sn < W5X00_MC_SOCKETS; sn++)
+            loopback_mc(sn);
+
+        w5x00_mc_wait(LOOPBACK_WAIT_US);
+    }
+}
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Core 1: the port, its DMA and INTn interrupts and everything of socket.c */
+static void wizchip_core1_main(void)
+{
+    uint32_t baudrate;
+
+    baudrate = wizchip_port_initialize();
+
+    w5x00_pico_port_reset();
+    wizchip_initialize();
+
+    ctlwizchip(CW_SET_PHYCONF, &g_phy_conf);
+    ctlwizchip(CW_RESET_PHY, 0);
+
+    ctlnetwork(CN_SET_NETINFO, (void *)&g_net_info);
+
+    // the sockets listen at once, the link is reported, and announced, once it is up
+    w5x00_pico_port_link_callback(wizchip_link);
+
+    printf(" %d.%d.%d.%d:%d, spi clock %luHz, sockets on core 1\n", g_net_info.ip[0], g_net_info.ip[1], g_net_info.ip[2],
+           g_net_info.ip[3], PORT_LOOPBACK, (unsigned long)baudrate);
+
+    w5x00_mc_run();
+}
+
+static uint32_t wizchip_port_initialize(void)
+{
+    w5x00_pico_port_config_t config;
+
+    w5x00_pico_port_get_default_config(&config);
+
+    config.spi = SPI_PORT;
+    config.pin_sck = PIN_SCK;
+    config.pin_mosi = PIN_MOSI;
+    config.pin_miso = PIN_MISO;
+    config.pin_cs = PIN_CS;
+    config.pin_rst = PIN_RST;
+    config.pin_int = PIN_INT;
+    config.baudrate = SPI_HZ;
+
+    return w5x00_pico_port_init(&config);
+}
+
+static void wizchip_initialize(void)
+{
+    // socket.c runs on core 1 only, no lock between the cores
+    wizchip_port_rp2040_init(WIZCHIP_PORT_LOCK_SOCKET);
+
+    // 2KB each way per socket, the defaults of both chips
+    if (ctlwizchip(CW_INIT_WIZCHIP, NULL) == -1)
+    {
+        printf(" W5x00 initialized fail\n");
+
+        return;
+    }
+
+#if _WIZCHIP_ == W5500
+    if (getVERSIONR() != WIZCHIP_VERSION)
+#else
+    if (getVER() != WIZCHIP_VERSION)
+#endif
+    {
+        printf(" ACCESS ERR : VERSIONR != 0x%02x\n", WIZCHIP_VERSION);
+
+        while (1)
+            ;
+    }
+}
+
+static void wizchip_link(bool up)
+{
+    if (up)
+    {
+        printf(" PHY link status changed up\n");
+
+        w5x00_pico_port_gratuitous_arp();
+    }
+    else
+    {
+        printf(" PHY link status changed down\n");
+    }
+}
+
+/* Core 0: the echo of loopback_tcps() over the rings of socket sn */
+static void loopback_mc(uint8_t sn)
+{
+    w5x00_mc_state_t state = w5x00_mc_state(sn);
+    uint32_t len, space;
+
+    if (state != g_loopback_state[sn])
+    {
+        if (state == W5X00_MC_ESTABLISHED)
+            printf(" %d : connected\n", sn);
+        else if ((state == W5X00_MC_LISTEN) && (g_loopback_state[sn] == W5X00_MC_CLOSING))
+            printf(" %d : closed\n", sn);
+
+        g_loopback_state[sn] = state;
+    }
+
+    if ((state != W5X00_MC_ESTABLISHED) && (state != W5X00_MC_CLOSE_WAIT) && (state != W5X00_MC_ABORTED))
+        return;
+
+    // no more than the TX ring takes, nothing read is dropped
+    space = w5x00_mc_send_space(sn);
+
+    if (space > ETHERNET_BUF_MAX_SIZE)
+        space = ETHERNET_BUF_MAX_SIZE;
+
+    len = w5x00_mc_recv(sn, g_loopback_buf, space);
+
+    if (len != 0)
+    {
+        w5x00_mc_send(sn, g_loopback_buf, len);
+    }
+    else if (((state == W5X00_MC_CLOSE_WAIT) || (state == W5X00_MC_ABORTED)) && (w5x00_mc_recv_available(sn) == 0))
+    {
+        // everything the peer sent was echoed, the TX ring is sent before the FIN
+        w5x00_mc_close(sn);
+    }
+}
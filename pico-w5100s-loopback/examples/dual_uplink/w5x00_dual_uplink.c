@@ -0,0 +1,280 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "lwip/init.h"
+#include "lwip/ip_addr.h"
+#include "lwip/timeouts.h"
+#include "lwip/apps/lwiperf.h"
+
+#include "rmii_ethernet/netif.h"
+
+#include "wizchip_conf.h"
+#include "wizchip_port_rp2040.h"
+
+#include "w5x00_pico_port.h"
+#include "w5x00_lwip_netif.h"
+
+#include "lwip_uplink.h"
+
+#include "boot.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* SPI, the W5100S-EVB-Pico wiring, RSTn on GP20 */
+#define SPI_PORT spi0
+
+#define PIN_SCK 18
+#define PIN_MOSI 19
+#define PIN_MISO 16
+#define PIN_CS 17
+#define PIN_RST 20
+
+/* The LAN8720's 50MHz REF_CLK, the system clock, on GPIN1: GPIN0 (GP20) is RSTn above */
+#define PIN_RMII_REF_CLK 22
+
+#define RMII_CLK_HZ (50 * 1000 * 1000)
+
+/* SPI clock, RMII_CLK_HZ / 2 from SPI_PORT */
+#define SPI_HZ (25 * 1000 * 1000)
+#define WIZCHIP_VERSION 0x51
+
+/* Shares of the new flows with LWIP_UPLINK_SHARE, the Mbit/s each gets through */
+#define RMII_UPLINK_WEIGHT 10
+#define W5X00_UPLINK_WEIGHT 6
+
+/* Per uplink frame counters every STATS_MS while iperf runs, 0 disables them */
+#ifndef STATS_MS
+#define STATS_MS 1000
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* MAC address of the W5100S, the LAN8720's comes from the flash id */
+static const uint8_t g_mac[6] = {0x00, 0x08, 0xDC, 0x12, 0x34, 0x56};
+
+/* LWIP network interfaces, the primary uplink first */
+static struct netif g_rmii_netif;
+static struct netif g_w5x00_netif;
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void);
+static void netif_link_callback(struct netif *netif);
+static void iperf_report(void *arg, enum lwiperf_report_type report_type,
+                         const ip_addr_t *local_addr, u16_t local_port, const ip_addr_t *remote_addr, u16_t remote_port,
+                         u32_t bytes_transferred, u32_t ms_duration, u32_t bandwidth_kbitpsec);
+#if STATS_MS
+static void stats_timeout(void *arg);
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Main
+  * ----------------------------------------------------------------------------------------------------
+  */
+int main()
+{
+    struct netif_rmii_ethernet_config rmii_config = NETIF_RMII_ETHERNET_DEFAULT_CONFIG();
+    uint32_t baudrate;
+
+    rmii_config.ref_clk_pin = PIN_RMII_REF_CLK;
+
+    // the system clock from the RMII reference clock, as the LAN8720 firmware, and SPI_PORT
+    // from it, so the SDK knows the SPI divider's input
+    clock_configure_gpin(clk_sys, PIN_RMII_REF_CLK, RMII_CLK_HZ, RMII_CLK_HZ);
+    clock_configure(
+        clk_peri,
+        0,                                           // No glitchless mux
+        CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLK_SYS,   // System clock on AUX mux
+        RMII_CLK_HZ,                                 // Input frequency
+        RMII_CLK_HZ                                  // Output (must be same as no divider)
+    );
+
+    // a terminal is only waited for with BOOT_STDIO_USB_WAIT_MS and a USB host attached
+    stdio_init_all();
+    boot_stdio_wait();
+
+    baudrate = wizchip_port_initialize();
+
+    w5x00_pico_port_reset();
+    wizchip_port_rp2040_init(WIZCHIP_PORT_LOCK_SOCKET);
+
+    // initialize LWIP in NO SYS mode
+    lwip_init();
+
+    // the PIO RMII netif, then socket 0 in MACRAW mode with all the buffer memory
+    if (netif_rmii_ethernet_init(&g_rmii_netif, &rmii_config) != ERR_OK ||
+        w5x00_lwip_netif_init(&g_w5x00_netif, g_mac) != ERR_OK)
+    {
+        printf(" netif initialized fail\n");
+
+        while (1)
+            ;
+    }
+
+    if (getVER() != WIZCHIP_VERSION)
+    {
+        printf(" ACCESS ERR : VERSIONR != 0x%02x\n", WIZCHIP_VERSION);
+
+        while (1)
+            ;
+    }
+
+    // an address each on the same subnet, the gateway is reached through either
+    IP_ADDR4(&g_rmii_netif.ip_addr, 192, 168, 1, 15);
+    IP_ADDR4(&g_rmii_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_rmii_netif.gw, 192, 168, 1, 1);
+
+    IP_ADDR4(&g_w5x00_netif.ip_addr, 192, 168, 1, 16);
+    IP_ADDR4(&g_w5x00_netif.netmask, 255, 255, 255, 0);
+    IP_ADDR4(&g_w5x00_netif.gw, 192, 168, 1, 1);
+
+    netif_set_default(&g_rmii_netif);
+    netif_set_up(&g_rmii_netif);
+    netif_set_up(&g_w5x00_netif);
+
+    // both links are still down, lwip_uplink sees them come up from the callbacks
+    lwip_uplink_add(&g_rmii_netif, RMII_UPLINK_WEIGHT);
+    lwip_uplink_add(&g_w5x00_netif, W5X00_UPLINK_WEIGHT);
+
+    netif_set_link_callback(&g_rmii_netif, netif_link_callback);
+    netif_set_link_callback(&g_w5x00_netif, netif_link_callback);
+
+    printf(" LAN8720 %s", ip4addr_ntoa(netif_ip4_addr(&g_rmii_netif)));
+    printf(", W5100S %s, SPI clock %luHz\n", ip4addr_ntoa(netif_ip4_addr(&g_w5x00_netif)), (unsigned long)baudrate);
+
+    // iperf 2 server on port 5001 of both addresses (iperf -c 192.168.1.15 and -c 192.168.1.16)
+    lwiperf_start_tcp_server_default(iperf_report, NULL);
+
+#if STATS_MS
+    sys_timeout(STATS_MS, stats_timeout, NULL);
+#endif
+
+    /* Infinite loop */
+    while (1)
+    {
+        // the RMII driver and lwIP's timers, then the W5100S, all on this core
+        netif_rmii_ethernet_poll();
+        w5x00_lwip_netif_poll(&g_w5x00_netif);
+    }
+}
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void)
+{
+    w5x00_pico_port_config_t config;
+
+    w5x00_pico_port_get_default_config(&config);
+
+    config.spi = SPI_PORT;
+    config.pin_sck = PIN_SCK;
+    config.pin_mosi = PIN_MOSI;
+    config.pin_miso = PIN_MISO;
+    config.pin_cs = PIN_CS;
+    config.pin_rst = PIN_RST;
+    config.pin_int = W5X00_PICO_PORT_PIN_NONE;
+    config.baudrate = SPI_HZ;
+
+    return w5x00_pico_port_init(&config);
+}
+
+static const char *netif_uplink_name(const struct netif *netif)
+{
+    return netif == &g_rmii_netif ? "LAN8720" : netif == &g_w5x00_netif ? "W5100S" : "none";
+}
+
+static void netif_link_callback(struct netif *netif)
+{
+    struct lwip_uplink_stats stats;
+    struct netif *other = netif == &g_rmii_netif ? &g_w5x00_netif : &g_rmii_netif;
+
+    // the uplinks move the addresses first, the counters are theirs after
+    lwip_uplink_link_changed(netif);
+    lwip_uplink_get_stats(&stats);
+
+    if (netif_is_link_up(netif))
+    {
+        printf(" %s link up, %s on %s\n", netif_uplink_name(netif),
+               ip4addr_ntoa(netif_ip4_addr(netif)), netif_uplink_name(lwip_uplink_owner(netif)));
+    }
+    else
+    {
+        // taken over within a link poll of the pull, PICO_RMII_ETHERNET_LINK_POLL_MS or W5X00_LWIP_NETIF_LINK_POLL_MS
+        printf(" %s link down at %lums, %s on %s, %lu TCP connections resent\n", netif_uplink_name(netif),
+               (unsigned long)stats.last_move_ms, ip4addr_ntoa(netif_ip4_addr(netif)),
+               netif_uplink_name(lwip_uplink_owner(netif)), (unsigned long)stats.tcp_kicked);
+    }
+
+    printf(" %s on %s, %lu takeovers %lu takebacks %lu lost %lu ARP replies\n",
+           ip4addr_ntoa(netif_ip4_addr(other)), netif_uplink_name(lwip_uplink_owner(other)),
+           (unsigned long)stats.takeovers, (unsigned long)stats.takebacks,
+           (unsigned long)stats.lost, (unsigned long)stats.arp_replies);
+}
+
+static void iperf_report(void *arg, enum lwiperf_report_type report_type,
+                         const ip_addr_t *local_addr, u16_t local_port, const ip_addr_t *remote_addr, u16_t remote_port,
+                         u32_t bytes_transferred, u32_t ms_duration, u32_t bandwidth_kbitpsec)
+{
+    LWIP_UNUSED_ARG(arg);
+    LWIP_UNUSED_ARG(local_port);
+    LWIP_UNUSED_ARG(remote_port);
+
+    printf(" iperf %d to %s", (int)report_type, ipaddr_ntoa(local_addr));
+    printf(" from %s: %lu bytes in %lums, %lukbit/s\n", ipaddr_ntoa(remote_addr),
+           (unsigned long)bytes_transferred, (unsigned long)ms_duration, (unsigned long)bandwidth_kbitpsec);
+}
+
+#if STATS_MS
+static void stats_timeout(void *arg)
+{
+    static uint32_t rmii_rx, rmii_tx, w5x00_rx, w5x00_tx;
+    struct netif_rmii_ethernet_stats rmii;
+    w5x00_lwip_netif_stats_t w5x00;
+
+    LWIP_UNUSED_ARG(arg);
+
+    netif_rmii_ethernet_netif_get_stats(&g_rmii_netif, &rmii);
+    w5x00_lwip_netif_get_stats(&w5x00);
+
+    // only while frames go through, an idle LAN stays quiet
+    if (rmii.rx_ok - rmii_rx + rmii.tx_ok - rmii_tx + w5x00.rx_frames - w5x00_rx + w5x00.tx_frames - w5x00_tx > 2 * STATS_MS / 100)
+    {
+        printf(" LAN8720 rx %lu tx %lu, W5100S rx %lu tx %lu frames/%ums\n",
+               (unsigned long)(rmii.rx_ok - rmii_rx), (unsigned long)(rmii.tx_ok - rmii_tx),
+               (unsigned long)(w5x00.rx_frames - w5x00_rx), (unsigned long)(w5x00.tx_frames - w5x00_tx), STATS_MS);
+    }
+
+    rmii_rx = rmii.rx_ok;
+    rmii_tx = rmii.tx_ok;
+    w5x00_rx = w5x00.rx_frames;
+    w5x00_tx = w5x00.tx_frames;
+
+    sys_timeout(STATS_MS, stats_timeout, NULL);
+}
+#endif
@@ -14,14 +14,23 @@
 
 #include "pico/stdlib.h"
 #include "pico/binary_info.h"
-#include "hardware/spi.h"
-#include "hardware/dma.h"
 #include "hardware/clocks.h"
 
 #include "wizchip_conf.h"
-#include "w5100s.h"
+#include "wizchip_port_rp2040.h"
+#include "socket.h"
 
 #include "loopback.h"
+#include "dhcp.h"
+
+#ifdef _LOOPBACK_TRACE_
+#include "trace.h"
+#endif
+
+#include "w5x00_pico_port.h"
+
+#include "boot.h"
+#include "clock_profile.h"
 
 /**
   * ----------------------------------------------------------------------------------------------------
@@ -37,21 +46,118 @@
 #define PIN_MISO 16
 #define PIN_CS 17
 #define PIN_RST 20
+#define PIN_INT 21
 
 /* Buffer */
 #define ETHERNET_BUF_MAX_SIZE (1024 * 2)
 
 /* Socket */
 #define SOCKET_LOOPBACK 0
+#define SOCKET_DHCP (_WIZCHIP_SOCK_NUM_ - 1)
 
 /* Port */
 #define PORT_LOOPBACK 5000
 
+/* Use SPI DMA */
+#define USE_SPI_DMA // if you want to use SPI DMA, uncomment.
+
+/* Clock the W5100S from a PIO state machine instead of SPI_PORT, clk_sys isn't lowered for clk_peri then */
+//#define USE_SPI_PIO // if you want to use the PIO SPI, uncomment.
+
+/* Step SCK down from SPI_HZ at start-up to the fastest one the wiring holds, with some margin */
+//#define USE_SPI_CALIBRATE // if you want to calibrate the SPI clock, uncomment.
+
+/* W5100S indirect bus over PIO instead of SPI, configured with -DWIZCHIP_BUS_INDIR=ON */
+#if _WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_
+#define USE_BUS_PIO
+#undef USE_SPI_DMA
+#undef USE_SPI_PIO
+#undef USE_SPI_CALIBRATE
+#endif
+
+/* WIZCHIP_READ()/WIZCHIP_WRITE() inlined over w5x00_spi_port.h, configured with -DWIZCHIP_SPI_INLINE=ON */
+#if defined(_WIZCHIP_SPI_INLINE_) && defined(USE_SPI_PIO)
+#error "w5x00_spi_port.h drives SPI_PORT, comment out USE_SPI_PIO"
+#endif
+
 /* Clock */
+#ifdef USE_BUS_PIO
+#define PLL_SYS_KHZ (125 * 1000)
+#elif defined(USE_SPI_PIO)
+#define PLL_SYS_KHZ (200 * 1000)
+#elif _WIZCHIP_ == W5500
+#define PLL_SYS_KHZ (133 * 1000) // the RP2040 maximum, SPI_PORT gets 66.5MHz
+#else
 #define PLL_SYS_KHZ (50 * 1000)
+#endif
 
-/* Use SPI DMA */
-#define USE_SPI_DMA // if you want to use SPI DMA, uncomment.
+/* Run clk_sys at a profile of clock_profile.h instead, with its core voltage, flash divider and clk_peri, checked by a self-test at boot */
+//#define USE_CLOCK_PROFILE // if you want to run faster than PLL_SYS_KHZ, uncomment.
+
+#define CLOCK_PROFILE_KHZ (200 * 1000) // SPI_PORT gets clk_peri, 48MHz from pll_usb above 200MHz on the RP2040
+
+#if defined(USE_CLOCK_PROFILE) && !CLOCK_PROFILE_VALID(CLOCK_PROFILE_KHZ)
+#error "CLOCK_PROFILE_KHZ isn't one of the profiles of clock_profile.h"
+#endif
+
+/* SPI clock, PLL_SYS_KHZ / 2 from SPI_PORT, clk_sys / 4 / a whole divider from the PIO */
+#if _WIZCHIP_ == W5500
+#define SPI_HZ (80 * 1000 * 1000) // W5500 maximum
+#else
+#define SPI_HZ (50 * 1000 * 1000)
+#endif
+
+#ifdef USE_BUS_PIO
+/* Bus, D7:D0 and A1:A0 on PIN_BUS_D0 to PIN_BUS_D0 + 9, CSn, WRn and RDn on PIN_BUS_CS to PIN_BUS_CS + 2 */
+#define BUS_PIO_HZ (62500 * 1000) // PIO clock, a byte every 8 cycles
+
+#define PIN_BUS_D0 0
+#define PIN_BUS_CS 10
+#endif
+
+/* Measure the WIZCHIP_READ_BUF()/WIZCHIP_WRITE_BUF() bandwidth at start-up */
+//#define USE_WIZCHIP_BENCH // if you want to compare the SPI and bus interfaces, uncomment.
+
+/* Echo from the RX to the TX buffer of the W5100S, without recv()/send() */
+#define USE_LOOPBACK_FWD // if you want to use loopback_tcps(), comment out.
+
+/* Service the loopback socket on INTn interrupts and sleep in between, with wiz_poll() */
+#define USE_SOCKEVENT // if you want to poll in a loop, comment out.
+
+/* Serve the loopback on all the W5100S sockets, all listening on PORT_LOOPBACK */
+#define USE_LOOPBACK_MULTI // if you want to use SOCKET_LOOPBACK only, comment out.
+
+/* With USE_LOOPBACK_MULTI, the sockets without a connection listen again at once and one is recycled when none listens */
+//#define USE_LOOPBACK_POOL // if you want to test the connection rate, uncomment.
+
+/* Get the network information from a DHCP server, the lease is kept in flash for an INIT-REBOOT after a reset */
+//#define USE_DHCP // if you want to use DHCP, uncomment.
+
+/* Ping the gateway every GATEWAY_PING_MS with the W5100S socket-less commands, no socket is used */
+//#define USE_GATEWAY_PING // if you want to report the gateway's reachability, uncomment.
+
+#define GATEWAY_PING_MS 1000
+#define GATEWAY_PING_RTR 1000 // 100 ms per try, in 100us
+#define GATEWAY_PING_RCR 2    // retries, 3 tries in all
+
+#ifdef USE_DHCP
+#define DHCP_TICK_MS 10 // DHCP retransmission timer resolution
+#undef USE_LOOPBACK_MULTI // the DHCP client keeps SOCKET_DHCP
+#endif
+
+#ifndef USE_LOOPBACK_MULTI
+#undef USE_LOOPBACK_POOL
+#endif
+
+/* W5500 instead of the W5100S, configured with -DWIZCHIP_W5500=ON */
+#if _WIZCHIP_ == W5500
+#define WIZCHIP_VERSION 0x04
+#undef USE_LOOPBACK_FWD // the RX to TX copy and the socket events are W5100S only
+#undef USE_SOCKEVENT
+#undef USE_GATEWAY_PING
+#else
+#define WIZCHIP_VERSION 0x51
+#endif
 
 /**
   * ----------------------------------------------------------------------------------------------------
@@ -82,35 +188,69 @@ static uint8_t g_loopback_buf[ETHERNET_BUF_MAX_SIZE] = {
 static uint8_t g_loopback_socket = SOCKET_LOOPBACK;
 static uint16_t g_loopback_port = PORT_LOOPBACK;
 
+#ifdef USE_DHCP
+/* DHCP */
+static uint8_t g_dhcp_buf[ETHERNET_BUF_MAX_SIZE] = {
+    0,
+};
+static struct repeating_timer g_dhcp_timer;
+#endif
+
+#ifdef USE_GATEWAY_PING
+/* Gateway ping */
+static uint32_t g_gateway_ping_ms;
+static int8_t g_gateway_up = -1; // unknown until the first ping completes
+#endif
+
 /**
   * ----------------------------------------------------------------------------------------------------
   * Functions
   * ----------------------------------------------------------------------------------------------------
   */
 /* W5x00 */
-static inline void wizchip_select(void);
-static inline void wizchip_deselect(void);
-static void wizchip_reset(void);
-static uint8_t wizchip_read(void);
-static void wizchip_write(uint8_t tx_data);
+static uint32_t wizchip_port_initialize(void);
+static void wizchip_initialize(void);
+static void wizchip_check(void);
+#ifdef USE_WIZCHIP_BENCH
+static void wizchip_benchmark(void);
+#endif
 
-#ifdef USE_SPI_DMA
-static void wizchip_read_burst(uint8_t *pBuf, uint16_t len);
-static void wizchip_write_burst(uint8_t *pBuf, uint16_t len);
+#ifdef USE_SPI_CALIBRATE
+static void spi_calibrate(uint32_t *baudrate);
 #endif
 
-static void wizchip_initialize(void);
-static void wizchip_check(void);
+#ifdef USE_CLOCK_PROFILE
+static uint32_t clock_traffic(void *arg);
+static void clock_selftest(void);
+#endif
 
 /* Network */
 static void network_initialize(void);
+static void network_link(bool up);
 static void print_network_information(void);
 
-#ifdef USE_SPI_DMA
-uint dma_tx;
-uint dma_rx;
-dma_channel_config dma_channel_config_tx;
-dma_channel_config dma_channel_config_rx;
+#ifdef USE_DHCP
+/* DHCP */
+static void dhcp_initialize(void);
+static bool dhcp_timer_callback(struct repeating_timer *t);
+static void dhcp_assign(void);
+static void dhcp_conflict(void);
+static uint8_t dhcp_lease_flash_load(wiz_DhcpLease *lease);
+static void dhcp_lease_flash_save(const wiz_DhcpLease *lease);
+#endif
+
+#ifdef USE_GATEWAY_PING
+/* Gateway ping */
+static void gateway_ping(void);
+static void gateway_ping_done(wiz_SLResult *res, void *arg);
+#endif
+
+/* Loopback */
+static int32_t loopback_run(void);
+
+#ifdef USE_SOCKEVENT
+/* Socket event */
+static void loopback_wait(void);
 #endif
 
 /**
@@ -124,11 +264,18 @@ int main()
     int32_t retval = 0;
     uint32_t spi_badurate = 0;    
 
+    // a terminal is only waited for with BOOT_STDIO_USB_WAIT_MS and a USB host attached
     stdio_init_all();
+    boot_stdio_wait();
 
-    // set main clock to 50MHz
+#ifdef USE_CLOCK_PROFILE
+    // the port works out its SPI and PIO dividers from these clocks
+    clock_profile_apply(clock_profile_get(CLOCK_PROFILE_KHZ));
+#else
+    // set main clock to 125MHz for the bus, 200MHz for the PIO SPI or 50MHz for SPI_PORT
     set_sys_clock_khz(PLL_SYS_KHZ, true);
 
+#if !defined(USE_BUS_PIO) && !defined(USE_SPI_PIO)
     // clock_configuration
     clock_configure(
         clk_peri,
@@ -137,54 +284,45 @@ int main()
         PLL_SYS_KHZ * 1000,                               // Input frequency
         PLL_SYS_KHZ * 1000                                // Output (must be same as no divider)
     );
-
-    // this example will use SPI0 at 25MHz
-    spi_badurate = spi_init(SPI_PORT, 50000 * 1000);
-
-    gpio_set_function(PIN_SCK, GPIO_FUNC_SPI);
-    gpio_set_function(PIN_MOSI, GPIO_FUNC_SPI);
-    gpio_set_function(PIN_MISO, GPIO_FUNC_SPI);
-
-    // make the SPI pins available to picotool
-    bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_SPI));
-
-    // chip select is active-low, so we'll initialise it to a driven-high state
-    gpio_init(PIN_CS);
-    gpio_set_dir(PIN_CS, GPIO_OUT);
-    gpio_put(PIN_CS, 1);
-
-    // make the SPI pins available to picotool
-    bi_decl(bi_1pin_with_name(PIN_CS, "W5x00 CHIP SELECT"));
-
-#ifdef USE_SPI_DMA
-    dma_tx = dma_claim_unused_channel(true);
-    dma_rx = dma_claim_unused_channel(true);
-
-    dma_channel_config_tx = dma_channel_get_default_config(dma_tx);
-    channel_config_set_transfer_data_size(&dma_channel_config_tx, DMA_SIZE_8);
-    channel_config_set_dreq(&dma_channel_config_tx, DREQ_SPI0_TX);
-
-    // We set the inbound DMA to transfer from the SPI receive FIFO to a memory buffer paced by the SPI RX FIFO DREQ
-    // We coinfigure the read address to remain unchanged for each element, but the write
-    // address to increment (so data is written throughout the buffer)
-    dma_channel_config_rx = dma_channel_get_default_config(dma_rx);
-    channel_config_set_transfer_data_size(&dma_channel_config_rx, DMA_SIZE_8);
-    channel_config_set_dreq(&dma_channel_config_rx, DREQ_SPI0_RX);
-    channel_config_set_read_increment(&dma_channel_config_rx, false);
-    channel_config_set_write_increment(&dma_channel_config_rx, true);
+#endif
 #endif
 
-    
-    wizchip_reset();
+    spi_badurate = wizchip_port_initialize();
+    // polled until the chip answers, wizchip_check() reports one that doesn't
+    w5x00_pico_port_reset();
+#ifdef USE_SPI_CALIBRATE
+    spi_calibrate(&spi_badurate);
+#endif
     wizchip_initialize();
     wizchip_check();
+#ifdef USE_CLOCK_PROFILE
+    clock_selftest();
+#endif
+#ifdef USE_SPI_DMA
+    // bursts too short to make up for the DMA setup go through a CPU loop, the loopback socket isn't open yet
+    printf(" DMA from %d byte bursts\n", w5x00_pico_port_dma_calibrate(SOCKET_LOOPBACK));
+#endif
+#ifdef USE_WIZCHIP_BENCH
+    wizchip_benchmark();
+#endif
     
-    // set the w5100s chip to link speed 10MHz
+    // set the w5x00 chip to link speed 10MHz, the PHY reset is polled until done
     ctlwizchip(CW_SET_PHYCONF, &gPhyConf);
     ctlwizchip(CW_RESET_PHY, 0);
     
     network_initialize();
-    sleep_ms(3000); 
+
+    // the loopback runs once the link is up, announced with a gratuitous ARP
+    w5x00_pico_port_link_callback(network_link);
+
+#ifdef USE_DHCP
+    // the first DISCOVER would be lost before the link is up
+    while (!w5x00_pico_port_link_poll())
+        tight_loop_contents();
+
+    // INIT-REBOOT with the lease in flash, or DISCOVER
+    dhcp_initialize();
+#endif
 
     // get network information
     print_network_information();
@@ -196,16 +334,67 @@ int main()
 #endif
 
     // get spi baudrate
+#ifdef USE_BUS_PIO
+    printf("PIO bus clock = %dHz\r\n", spi_badurate);
+#elif defined(USE_SPI_PIO)
+    printf("PIO SPI clock = %dHz\r\n", spi_badurate);
+#else
     printf("spi_init return = %dHz\r\n", spi_badurate);
+#endif
+
+#ifdef USE_SOCKEVENT
+    // INTn falling edges call sockevent_isr(), wiz_poll() sleeps until one
+    w5x00_pico_port_int_enable();
+
+    bi_decl(bi_1pin_with_name(PIN_INT, "W5x00 INTERRUPT"));
+
+    /* Infinite loop */
+    while (1)
+    {
+#ifdef USE_DHCP
+        DHCP_run();
+#endif
+
+#ifdef USE_GATEWAY_PING
+        gateway_ping();
+#endif
 
+        // the loopback skips the sockets wiz_poll() has nothing for
+        if (w5x00_pico_port_link_poll() && (retval = loopback_run()) < 0)
+        {
+            printf(" Loopback error : %d\n", retval);
+        }
+
+#ifdef _LOOPBACK_TRACE_
+        // the loopback's messages, formatted between its runs
+        trace_drain(TRACE_DRAIN_MAX);
+#endif
+
+        loopback_wait();
+    }
+#else
     /* Infinite loop */
     while (1)
     {
-        if ((retval = loopback_tcps(g_loopback_socket, g_loopback_buf, g_loopback_port)) < 0)
+#ifdef USE_DHCP
+        DHCP_run();
+#endif
+
+#ifdef USE_GATEWAY_PING
+        gateway_ping();
+#endif
+
+        if (w5x00_pico_port_link_poll() && (retval = loopback_run()) < 0)
         {
             printf(" Loopback error : %d\n", retval);
         }
+
+#ifdef _LOOPBACK_TRACE_
+        // the loopback's messages, formatted between its runs
+        trace_drain(TRACE_DRAIN_MAX);
+#endif
     }
+#endif
 }
 
 /**
@@ -214,137 +403,212 @@ int main()
   * ----------------------------------------------------------------------------------------------------
   */
 /* W5x00 */
-static inline void wizchip_select(void)
+static uint32_t wizchip_port_initialize(void)
 {
-    gpio_put(PIN_CS, 0);
-}
+    w5x00_pico_port_config_t config;
+
+    w5x00_pico_port_get_default_config(&config);
+
+    config.spi = SPI_PORT;
+    config.pin_sck = PIN_SCK;
+    config.pin_mosi = PIN_MOSI;
+    config.pin_miso = PIN_MISO;
+    config.pin_cs = PIN_CS;
+    config.pin_rst = PIN_RST;
+    config.pin_int = PIN_INT;
+#ifdef USE_BUS_PIO
+    config.pin_bus_d0 = PIN_BUS_D0;
+    config.pin_bus_cs = PIN_BUS_CS;
+    config.baudrate = BUS_PIO_HZ;
+
+    // make the bus pins available to picotool
+    bi_decl(bi_pin_range_with_func(PIN_BUS_D0, PIN_BUS_D0 + 9, GPIO_FUNC_PIO0));
+    bi_decl(bi_pin_range_with_func(PIN_BUS_CS, PIN_BUS_CS + 2, GPIO_FUNC_PIO0));
+#else
+    config.baudrate = SPI_HZ;
+#ifdef USE_SPI_PIO
+    config.use_pio = true;
 
-static inline void wizchip_deselect(void)
-{
-    gpio_put(PIN_CS, 1);
+    // make the SPI pins available to picotool
+    bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_PIO0));
+#else
+    // make the SPI pins available to picotool
+    bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_SPI));
+#endif
+    bi_decl(bi_1pin_with_name(PIN_CS, "W5x00 CHIP SELECT"));
+#ifndef USE_SPI_DMA
+    config.use_dma = false;
+#endif
+#endif
+
+    bi_decl(bi_1pin_with_name(PIN_RST, "W5x00 RESET"));
+
+    return w5x00_pico_port_init(&config);
 }
 
-static void wizchip_reset(void)
+static void wizchip_initialize(void)
 {
-    gpio_set_dir(PIN_RST, GPIO_OUT);
+    /* Critical section register, the DMA and GPIO IRQ handlers and core 1 may access the W5100S too.
+       Code on core 1 holds wizchip_port_sock_lock() around the SOCKET functions it calls. */
+    wizchip_port_rp2040_init(WIZCHIP_PORT_LOCK_SOCKET);
 
-    gpio_put(PIN_RST, 0);
-    sleep_ms(100);
+    /* W5x00 initialize */
+#if _WIZCHIP_ == W5500
+    // TX then RX sizes in KB, the W5500 has 8 sockets sharing 16KB each way
+#ifdef USE_LOOPBACK_MULTI
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{2, 2, 2, 2, 2, 2, 2, 2}, {2, 2, 2, 2, 2, 2, 2, 2}};
+#else
+    // SOCKET_LOOPBACK, socket 0, is used alone : 16KB/16KB for a larger TCP window
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{16, 0, 0, 0, 0, 0, 0, 0}, {16, 0, 0, 0, 0, 0, 0, 0}};
+#endif
+#else
+    // TX then RX sizes in KB, the W5100S has 4 sockets sharing 8KB each way
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{2, 2, 2, 2}, {2, 2, 2, 2}};
+#endif
 
-    gpio_put(PIN_RST, 1);
-    sleep_ms(100);
+    if (ctlwizchip(CW_INIT_WIZCHIP, (void *)memsize) == -1)
+    {
+        printf(" W5x00 initialized fail\n");
 
-    bi_decl(bi_1pin_with_name(PIN_RST, "W5x00 RESET"));
-}
+        return;
+    }
 
-static uint8_t wizchip_read(void)
-{
-    uint8_t rx_data = 0;
-    uint8_t tx_data = 0xFF;
+#if !defined(USE_LOOPBACK_MULTI) && (_WIZCHIP_ == W5100S)
+    // SOCKET_LOOPBACK, socket 0, is used alone : 8KB/8KB for a larger TCP window
+    wiz_BufProfile profile = {.profile = BUF_ONE_FAT};
 
-    spi_read_blocking(SPI_PORT, tx_data, &rx_data, 1);
+    if (ctlwizchip(CW_INIT_WIZCHIP_PROFILE, (void *)&profile) == -1)
+    {
+        printf(" W5x00 buffer profile fail\n");
 
-    return rx_data;
+        return;
+    }
+#endif
 }
 
-static void wizchip_write(uint8_t tx_data)
+#ifdef USE_WIZCHIP_BENCH
+static void wizchip_benchmark(void)
 {
-    spi_write_blocking(SPI_PORT, &tx_data, 1);
-}
+    const uint32_t rounds = 256;
+#if _WIZCHIP_ == W5500
+    uint32_t addr = (uint32_t)WIZCHIP_TXBUF_BLOCK(0) << 3;
+#else
+    uint16_t addr = getSn_TxBASE(0);
+#endif
+    uint16_t len = getSn_TxMAX(0);
+    uint64_t start, write_us, read_us;
+    uint32_t i;
 
-#ifdef USE_SPI_DMA
-static void wizchip_read_burst(uint8_t *pBuf, uint16_t len)
-{
-    uint8_t dummy_data = 0xFF;
-
-    channel_config_set_read_increment(&dma_channel_config_tx, false);
-    channel_config_set_write_increment(&dma_channel_config_tx, false);
-    dma_channel_configure(dma_tx, &dma_channel_config_tx,
-                          &spi_get_hw(SPI_PORT)->dr, // write address
-                          &dummy_data,               // read address
-                          len,                       // element count (each element is of size transfer_data_size)
-                          false);                    // don't start yet
-
-    channel_config_set_read_increment(&dma_channel_config_rx, false);
-    channel_config_set_write_increment(&dma_channel_config_rx, true);
-    dma_channel_configure(dma_rx, &dma_channel_config_rx,
-                          pBuf,                      // write address
-                          &spi_get_hw(SPI_PORT)->dr, // read address
-                          len,                       // element count (each element is of size transfer_data_size)
-                          false);                    // don't start yet
-
-    dma_start_channel_mask((1u << dma_tx) | (1u << dma_rx));
-    dma_channel_wait_for_finish_blocking(dma_rx);
+    if (len > ETHERNET_BUF_MAX_SIZE)
+        len = ETHERNET_BUF_MAX_SIZE;
+
+    // socket 0 TX memory, overwritten before it is ever sent
+    for (i = 0; i < len; i++)
+        g_loopback_buf[i] = (uint8_t)i;
+
+    start = time_us_64();
+    for (i = 0; i < rounds; i++)
+        WIZCHIP_WRITE_BUF(addr, g_loopback_buf, len);
+    write_us = time_us_64() - start;
+
+    start = time_us_64();
+    for (i = 0; i < rounds; i++)
+        WIZCHIP_READ_BUF(addr, g_loopback_buf, len);
+    read_us = time_us_64() - start;
+
+    for (i = 0; i < len; i++)
+    {
+        if (g_loopback_buf[i] != (uint8_t)i)
+        {
+            printf(" W5x00 buffer read back mismatch at %d\n", i);
+            break;
+        }
+    }
+
+    printf(" W5x00 %d x %d bytes : write %d KB/s, read %d KB/s\n", rounds, len,
+           (uint32_t)((uint64_t)rounds * len * 1000 / 1024 / write_us),
+           (uint32_t)((uint64_t)rounds * len * 1000 / 1024 / read_us));
 }
+#endif
 
-static void wizchip_write_burst(uint8_t *pBuf, uint16_t len)
+#ifdef USE_SPI_CALIBRATE
+static void spi_calibrate(uint32_t *baudrate)
 {
-    uint8_t dummy_data;
-    //uint8_t dummy_arry[1024];
-
-    channel_config_set_read_increment(&dma_channel_config_tx, true);
-    channel_config_set_write_increment(&dma_channel_config_tx, false);
-    dma_channel_configure(dma_tx, &dma_channel_config_tx,
-                          &spi_get_hw(SPI_PORT)->dr, // write address
-                          pBuf,                      // read address
-                          len,                       // element count (each element is of size transfer_data_size)
-                          false);                    // don't start yet
-
-    channel_config_set_read_increment(&dma_channel_config_rx, false);
-    channel_config_set_write_increment(&dma_channel_config_rx, false);
-    dma_channel_configure(dma_rx, &dma_channel_config_rx,
-                          &dummy_data,               // write address
-                          &spi_get_hw(SPI_PORT)->dr, // read address
-                          len,                       // element count (each element is of size transfer_data_size)
-                          false);                    // don't start yet
-
-    dma_start_channel_mask((1u << dma_tx) | (1u << dma_rx));
-    dma_channel_wait_for_finish_blocking(dma_rx);
+    w5x00_pico_port_cal_t cal;
+    const uint8_t drive_ma[] = {2, 4, 8, 12};
+
+    // the TX buffer of SOCKET_LOOPBACK, it isn't open yet
+    if (w5x00_pico_port_calibrate(SOCKET_LOOPBACK, &cal) == 0)
+    {
+        printf(" SPI calibration failed, %d settings with %d errors, staying at %dHz\n", cal.tested, cal.errors, *baudrate);
+
+        return;
+    }
+
+    printf(" SPI calibrated to %dHz, fastest %dHz, %dmA drive, %s sample, %d settings with %d errors\n",
+           cal.baudrate, cal.fastest, drive_ma[cal.drive & 3], cal.sample_early ? "early" : "late", cal.tested, cal.errors);
+
+    *baudrate = cal.baudrate;
 }
 #endif
 
-static void wizchip_initialize(void)
+#ifdef USE_CLOCK_PROFILE
+/* A round of the clock self-test's traffic, through the TX buffer of SOCKET_LOOPBACK, it isn't open yet */
+static uint32_t clock_traffic(void *arg)
 {
-    /* Deselect the FLASH : chip select high */
-    wizchip_deselect();
+#if _WIZCHIP_ == W5500
+    uint32_t addr = (uint32_t)WIZCHIP_TXBUF_BLOCK(SOCKET_LOOPBACK) << 3;
+#else
+    uint16_t addr = getSn_TxBASE(SOCKET_LOOPBACK);
+#endif
+    uint16_t len = getSn_TxMAX(SOCKET_LOOPBACK);
+    static uint8_t seed;
+    uint32_t errors = 0;
+    uint16_t i;
 
-    /* CS function register */
-    reg_wizchip_cs_cbfunc(wizchip_select, wizchip_deselect);
+    // written from the first half of g_loopback_buf, read back into the second
+    if (len > ETHERNET_BUF_MAX_SIZE / 2)
+        len = ETHERNET_BUF_MAX_SIZE / 2;
 
-    /* SPI function register */
-    reg_wizchip_spi_cbfunc(wizchip_read, wizchip_write);
-#ifdef USE_SPI_DMA
-    reg_wizchip_spiburst_cbfunc(wizchip_read_burst, wizchip_write_burst);
-#endif
-    /* W5x00 initialize */
-    uint8_t temp;
-    uint8_t memsize[2][8] = {{2, 2, 2, 2, 2, 2, 2, 2}, {2, 2, 2, 2, 2, 2, 2, 2}};
+    // another pattern every round, so a byte that kept the last one shows
+    seed++;
+    for (i = 0; i < len; i++)
+        g_loopback_buf[i] = (uint8_t)(i * 7 + seed);
 
-    if (ctlwizchip(CW_INIT_WIZCHIP, (void *)memsize) == -1)
-    {
-        printf(" W5x00 initialized fail\n");
+    WIZCHIP_WRITE_BUF(addr, g_loopback_buf, len);
+    WIZCHIP_READ_BUF(addr, g_loopback_buf + len, len);
 
-        return;
-    }
+    for (i = 0; i < len; i++)
+        errors += g_loopback_buf[len + i] != g_loopback_buf[i];
 
-    /* PHY link status check */
-    do
-    {
-        if (ctlwizchip(CW_GET_PHYLINK, (void *)&temp) == -1)
-        {
-            printf(" Unknown PHY link status\n");
+    return errors;
+}
 
-            return;
-        }
-    } while (temp == PHY_LINK_OFF);
+static void clock_selftest(void)
+{
+    struct clock_profile_result result;
+    uint32_t errors = clock_profile_selftest(&result, clock_traffic, NULL);
+
+    clock_profile_report(&result, "w5100s", "w5x00_loopback");
+
+    // a board that fails at this profile stops here, it needs a lower one
+    while (errors)
+        ;
 }
+#endif
 
 static void wizchip_check(void)
 {
     /* Read version register */
-    if (getVER() != 0x51) // W5100S
+#if _WIZCHIP_ == W5500
+    uint8_t version = getVERSIONR();
+#else
+    uint8_t version = getVER();
+#endif
+
+    if (version != WIZCHIP_VERSION)
     {
-        printf(" ACCESS ERR : VERSIONR != 0x51, read value = 0x%02x\n", getVER());
+        printf(" ACCESS ERR : VERSIONR != 0x%02x, read value = 0x%02x\n", WIZCHIP_VERSION, version);
 
         while (1)
             ;
@@ -357,6 +621,155 @@ static void network_initialize(void)
     ctlnetwork(CN_SET_NETINFO, (void *)&g_net_info);
 }
 
+static void network_link(bool up)
+{
+    printf(" PHY link %s at %lu ms\n", up ? "up" : "down", (unsigned long)timebase_ms());
+}
+
+#ifdef USE_DHCP
+/* DHCP */
+static void dhcp_initialize(void)
+{
+    uint64_t start;
+    uint8_t retval;
+
+    reg_dhcp_cbfunc(dhcp_assign, dhcp_assign, dhcp_conflict);
+    reg_dhcp_lease_cbfunc(dhcp_lease_flash_load, dhcp_lease_flash_save);
+
+    DHCP_init(SOCKET_DHCP, g_dhcp_buf);
+    add_repeating_timer_ms(DHCP_TICK_MS, dhcp_timer_callback, NULL, &g_dhcp_timer);
+
+    start = time_us_64();
+
+    while ((retval = DHCP_run()) != DHCP_IP_LEASED)
+    {
+        if (retval == DHCP_FAILED)
+            printf(" DHCP failed, retrying\n");
+    }
+
+    printf(" DHCP leased in %lld ms, lease time %lu s\n", (time_us_64() - start) / 1000, (unsigned long)getDHCPLeasetime());
+}
+
+static bool dhcp_timer_callback(struct repeating_timer *t)
+{
+    DHCP_time_handler_ms(DHCP_TICK_MS);
+
+    return true;
+}
+
+static void dhcp_assign(void)
+{
+    getIPfromDHCP(g_net_info.ip);
+    getGWfromDHCP(g_net_info.gw);
+    getSNfromDHCP(g_net_info.sn);
+    getDNSfromDHCP(g_net_info.dns);
+    g_net_info.dhcp = NETINFO_DHCP;
+
+    network_initialize();
+}
+
+static void dhcp_conflict(void)
+{
+    printf(" DHCP leased IP conflicts, declined\n");
+}
+
+static uint8_t dhcp_lease_flash_load(wiz_DhcpLease *lease)
+{
+    return w5x00_pico_port_flash_load(lease, sizeof(*lease)) ? 1 : 0;
+}
+
+static void dhcp_lease_flash_save(const wiz_DhcpLease *lease)
+{
+    w5x00_pico_port_flash_save(lease, sizeof(*lease));
+}
+#endif
+
+#ifdef USE_SOCKEVENT
+/* Socket event */
+static void loopback_wait(void)
+{
+    wiz_pollfd fds[_WIZCHIP_SOCK_NUM_];
+    uint8_t nfds = 0;
+
+#ifdef USE_LOOPBACK_MULTI
+    for (uint8_t sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++)
+        fds[nfds++].sn = sn;
+#else
+    fds[nfds++].sn = g_loopback_socket;
+#endif
+
+    for (uint8_t i = 0; i < nfds; i++)
+    {
+#if defined(USE_LOOPBACK_FWD) || defined(_LOOPBACK_SEND_STREAM_)
+        // SENDOK hands the data queued behind the last SEND to the chip
+        fds[i].events = WIZ_POLLIN | WIZ_POLLOUT;
+#else
+        fds[i].events = WIZ_POLLIN;
+#endif
+    }
+
+#ifdef USE_DHCP
+    // DHCP_run() goes on with the DHCP timer
+    wiz_poll(fds, nfds, DHCP_TICK_MS);
+#else
+    // the link changes don't interrupt, w5x00_pico_port_link_poll() reads them
+    wiz_poll(fds, nfds, W5X00_PICO_PORT_LINK_POLL_MS);
+#endif
+}
+#endif
+
+#ifdef USE_GATEWAY_PING
+/* Gateway ping */
+static void gateway_ping(void)
+{
+    uint32_t now = timebase_ms();
+
+#ifndef USE_SOCKEVENT
+    // wiz_poll() completes it with USE_SOCKEVENT
+    wizchip_sl_poll();
+#endif
+
+    if ((now - g_gateway_ping_ms) < GATEWAY_PING_MS || !w5x00_pico_port_link_poll())
+        return;
+
+    // -1 while the last one or the gratuitous ARP runs, tried again on the next call
+    if (wizchip_sl_start(SLCMD_PING, g_net_info.gw, GATEWAY_PING_RTR, GATEWAY_PING_RCR, gateway_ping_done, NULL) == 0)
+        g_gateway_ping_ms = now;
+}
+
+static void gateway_ping_done(wiz_SLResult *res, void *arg)
+{
+    // the changes only, the loopback's output stays readable
+    if (res->ok == g_gateway_up)
+        return;
+
+    g_gateway_up = res->ok;
+
+    if (res->ok)
+        printf(" Gateway %d.%d.%d.%d reachable, %lu us\n", res->ip[0], res->ip[1], res->ip[2], res->ip[3], (unsigned long)res->rtt_us);
+    else
+        printf(" Gateway %d.%d.%d.%d unreachable\n", res->ip[0], res->ip[1], res->ip[2], res->ip[3]);
+}
+#endif
+
+/* Loopback */
+static int32_t loopback_run(void)
+{
+#if defined(USE_LOOPBACK_POOL) && defined(USE_LOOPBACK_FWD)
+    return loopback_tcps_pool(g_loopback_buf, g_loopback_port, loopback_tcps_fwd);
+#elif defined(USE_LOOPBACK_POOL)
+    return loopback_tcps_pool(g_loopback_buf, g_loopback_port, loopback_tcps);
+#elif defined(USE_LOOPBACK_MULTI) && defined(USE_LOOPBACK_FWD)
+    return loopback_tcps_multi(g_loopback_buf, g_loopback_port, loopback_tcps_fwd);
+#elif defined(USE_LOOPBACK_MULTI)
+    return loopback_tcps_multi(g_loopback_buf, g_loopback_port, loopback_tcps);
+#elif defined(USE_LOOPBACK_FWD)
+    return loopback_tcps_fwd(g_loopback_socket, g_loopback_buf, g_loopback_port);
+#else
+    return loopback_tcps(g_loopback_socket, g_loopback_buf, g_loopback_port);
+#endif
+}
+
 static void print_network_information(void)
 {
     uint8_t tmp_str[8] = {
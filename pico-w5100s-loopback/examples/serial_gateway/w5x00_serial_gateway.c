@@ -0,0 +1,243 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "wizchip_conf.h"
+#include "wizchip_port_rp2040.h"
+#include "socket.h"
+
+#include "w5x00_pico_port.h"
+#include "w5x00_serial.h"
+
+#include "boot.h"
+#include "timebase.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* SPI, as the loopback example */
+#define SPI_PORT spi0
+
+#define PIN_SCK 18
+#define PIN_MOSI 19
+#define PIN_MISO 16
+#define PIN_CS 17
+#define PIN_RST 20
+
+/* Clock, the UARTs divide it to 3Mbaud exactly */
+#define PLL_SYS_KHZ (96 * 1000)
+
+/* SPI clock, PLL_SYS_KHZ / 2 from SPI_PORT */
+#define SPI_HZ (48 * 1000 * 1000)
+
+#if _WIZCHIP_ == W5500
+#define WIZCHIP_VERSION 0x04
+#else
+#define WIZCHIP_VERSION 0x51
+#endif
+
+/* Both UARTs, uart0 on GP0 and GP1 to TCP port 5020, uart1 on GP4 and GP5 to 5021. Jumper GP0
+   to GP5 and GP4 to GP1 for tools/serial_gw_bench.py */
+#ifndef SERIAL_BAUDRATE
+#define SERIAL_BAUDRATE 3000000
+#endif
+
+#define SERIAL_REPORT_MS 1000
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Network, the address of the loopback example and of the LAN8720 firmware */
+static wiz_NetInfo g_net_info =
+    {
+        .mac = {0x00, 0x08, 0xDC, 0x12, 0x34, 0x56}, // MAC address
+        .ip = {192, 168, 1, 15},                     // IP address
+        .sn = {255, 255, 255, 0},                    // Subnet Mask
+        .gw = {192, 168, 1, 1},                      // Gateway
+        .dns = {8, 8, 8, 8},                         // DNS server
+        .dhcp = NETINFO_STATIC                       // DHCP
+};
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void);
+static void wizchip_initialize(void);
+static void wizchip_link(bool up);
+static void serial_report(void);
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Main
+  * ----------------------------------------------------------------------------------------------------
+  */
+int main()
+{
+    w5x00_serial_config_t config;
+    uint32_t baudrate;
+    uint32_t report_ms;
+
+    // a terminal is only waited for with BOOT_STDIO_USB_WAIT_MS and a USB host attached
+    stdio_init_all();
+    boot_stdio_wait();
+
+    set_sys_clock_khz(PLL_SYS_KHZ, true);
+
+    // SPI_PORT and the UARTs from the system PLL
+    clock_configure(
+        clk_peri,
+        0,                                                // No glitchless mux
+        CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, // System PLL on AUX mux
+        PLL_SYS_KHZ * 1000,                               // Input frequency
+        PLL_SYS_KHZ * 1000                                // Output (must be same as no divider)
+    );
+
+    baudrate = wizchip_port_initialize();
+
+    w5x00_pico_port_reset();
+    wizchip_initialize();
+
+    ctlnetwork(CN_SET_NETINFO, (void *)&g_net_info);
+
+    w5x00_pico_port_link_callback(wizchip_link);
+
+    printf(" %d.%d.%d.%d, SPI clock %luHz\n", g_net_info.ip[0], g_net_info.ip[1], g_net_info.ip[2], g_net_info.ip[3],
+           (unsigned long)baudrate);
+
+    for (uint8_t i = 0; i < W5X00_SERIAL_PORTS; i++)
+    {
+        w5x00_serial_get_default_config(i, &config);
+        config.baudrate = SERIAL_BAUDRATE;
+
+        baudrate = w5x00_serial_init(i, &config);
+
+        printf(" uart%d on GP%u and GP%u at %lu baud, TCP port %u\n", i, config.pin_tx, config.pin_rx,
+               (unsigned long)baudrate, config.port);
+    }
+
+    report_ms = timebase_ms();
+
+    /* Infinite loop */
+    while (1)
+    {
+        w5x00_pico_port_link_poll();
+        w5x00_serial_poll();
+
+        if (timebase_ms() - report_ms >= SERIAL_REPORT_MS)
+        {
+            report_ms += SERIAL_REPORT_MS;
+            serial_report();
+        }
+    }
+}
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static uint32_t wizchip_port_initialize(void)
+{
+    w5x00_pico_port_config_t config;
+
+    w5x00_pico_port_get_default_config(&config);
+
+    config.spi = SPI_PORT;
+    config.pin_sck = PIN_SCK;
+    config.pin_mosi = PIN_MOSI;
+    config.pin_miso = PIN_MISO;
+    config.pin_cs = PIN_CS;
+    config.pin_rst = PIN_RST;
+    config.pin_int = W5X00_PICO_PORT_PIN_NONE;
+    config.baudrate = SPI_HZ;
+
+    return w5x00_pico_port_init(&config);
+}
+
+static void wizchip_initialize(void)
+{
+    wizchip_port_rp2040_init(WIZCHIP_PORT_LOCK_SOCKET);
+
+    // TX then RX sizes in KB, split between the sockets of the pairs. The RX buffer is the
+    // TCP window, it opens as fast as the UART sends
+#if _WIZCHIP_ == W5500
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{8, 8, 0, 0, 0, 0, 0, 0}, {8, 8, 0, 0, 0, 0, 0, 0}};
+#else
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{4, 4, 0, 0}, {4, 4, 0, 0}};
+#endif
+
+    if (ctlwizchip(CW_INIT_WIZCHIP, (void *)memsize) == -1)
+    {
+        printf(" W5x00 initialized fail\n");
+
+        return;
+    }
+
+#if _WIZCHIP_ == W5500
+    if (getVERSIONR() != WIZCHIP_VERSION)
+#else
+    if (getVER() != WIZCHIP_VERSION)
+#endif
+    {
+        printf(" ACCESS ERR : VERSIONR != 0x%02x\n", WIZCHIP_VERSION);
+
+        while (1)
+            ;
+    }
+}
+
+static void wizchip_link(bool up)
+{
+    if (up)
+    {
+        printf(" PHY link status changed up\n");
+    }
+    else
+    {
+        printf(" PHY link status changed down\n");
+    }
+}
+
+// the bytes of the last SERIAL_REPORT_MS of each pair, while there is something to tell
+static void serial_report(void)
+{
+    static w5x00_serial_stats_t last[W5X00_SERIAL_PORTS];
+    w5x00_serial_stats_t stats;
+
+    for (uint8_t i = 0; i < W5X00_SERIAL_PORTS; i++)
+    {
+        w5x00_serial_get_stats(i, &stats);
+
+        if ((stats.uart_rx != last[i].uart_rx) || (stats.tcp_rx != last[i].tcp_rx) ||
+            (stats.connections != last[i].connections) || (stats.overruns != last[i].overruns))
+        {
+            printf("serial%d: uart rx %lu tcp tx %lu, tcp rx %lu, flushes %lu size %lu idle %lu deadline, %lu dropped, %lu overruns, %s\n",
+                   i, (unsigned long)(stats.uart_rx - last[i].uart_rx), (unsigned long)(stats.tcp_tx - last[i].tcp_tx),
+                   (unsigned long)(stats.tcp_rx - last[i].tcp_rx), (unsigned long)(stats.flush_size - last[i].flush_size),
+                   (unsigned long)(stats.flush_idle - last[i].flush_idle),
+                   (unsigned long)(stats.flush_deadline - last[i].flush_deadline),
+                   (unsigned long)(stats.dropped - last[i].dropped), (unsigned long)stats.overruns,
+                   stats.connected ? "connected" : "listening");
+        }
+
+        last[i] = stats;
+    }
+}
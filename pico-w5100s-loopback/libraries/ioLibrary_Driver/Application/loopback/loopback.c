@@ -3,32 +3,69 @@
 #include "socket.h"
 #include "wizchip_conf.h"
 
+#ifdef _LOOPBACK_TRACE_
+#include "trace.h"
+
+/* the event and its arguments to the trace ring, msg isn't formatted */
+#define LOOPBACK_LOG(event, a0, a1, a2, msg)   TRACE(TRACE_LOOPBACK_##event, a0, a1, a2)
+#else
+#define LOOPBACK_LOG(event, a0, a1, a2, msg)   printf msg
+#endif
+
+/* destip in one trace argument, first byte highest */
+#define LOOPBACK_IP(ip)   (((uint32_t)(ip)[0] << 24) | ((uint32_t)(ip)[1] << 16) | ((uint32_t)(ip)[2] << 8) | (ip)[3])
+
 #if LOOPBACK_MODE == LOOPBACK_MAIN_NOBLCOK
 
 int32_t loopback_tcps(uint8_t sn, uint8_t* buf, uint16_t port)
 {
    int32_t ret;
    uint16_t size = 0, sentsize=0;
+#if _WIZCHIP_ == W5100S
+   wiz_SnSnapshot snap;
+#ifdef _LOOPBACK_SEND_STREAM_
+   wiz_pollfd pfd = {sn, WIZ_POLLIN | WIZ_POLLOUT, 0};   // the queued data goes out on SENDOK
+#else
+   wiz_pollfd pfd = {sn, WIZ_POLLIN, 0};
+#endif
+#endif
 
 #ifdef _LOOPBACK_DEBUG_
    uint8_t destip[4];
    uint16_t destport;
 #endif
 
+#if _WIZCHIP_ == W5100S
+   // nothing received and the state unchanged, the socket isn't read
+   if(wiz_poll(&pfd, 1, 0) == 0) return 1;
+   // SR, IR and RX_RSR with one burst, instead of a register access each
+   wiz_socket_snapshot(sn, &snap);
+   switch(snap.sr)
+#else
    switch(getSn_SR(sn))
+#endif
    {
       case SOCK_ESTABLISHED :
+#if _WIZCHIP_ == W5100S
+         if(snap.ir & Sn_IR_CON)
+#else
          if(getSn_IR(sn) & Sn_IR_CON)
+#endif
          {
 #ifdef _LOOPBACK_DEBUG_
 			getSn_DIPR(sn, destip);
 			destport = getSn_DPORT(sn);
 
-			printf("%d:Connected - %d.%d.%d.%d : %d\r\n",sn, destip[0], destip[1], destip[2], destip[3], destport);
+			LOOPBACK_LOG(CONNECTED, sn, LOOPBACK_IP(destip), destport,
+			             ("%d:Connected - %d.%d.%d.%d : %d\r\n",sn, destip[0], destip[1], destip[2], destip[3], destport));
 #endif
-			setSn_IR(sn,Sn_IR_CON);
+			sockevent_clear(sn, Sn_IR_CON);
          }
+#if _WIZCHIP_ == W5100S
+		 if((size = snap.rx_rsr) > 0) // Don't need to check SOCKERR_BUSY because it doesn't not occur.
+#else
 		 if((size = getSn_RX_RSR(sn)) > 0) // Don't need to check SOCKERR_BUSY because it doesn't not occur.
+#endif
          {
 			if(size > DATA_BUF_SIZE) size = DATA_BUF_SIZE;
 			ret = recv(sn, buf, size);
@@ -48,6 +85,13 @@ int32_t loopback_tcps(uint8_t sn, uint8_t* buf, uint16_t port)
 				sentsize += ret; // Don't care SOCKERR_BUSY, because it is zero.
 			}
          }
+#if (_WIZCHIP_ == W5100S) && defined(_LOOPBACK_SEND_STREAM_)
+         else if((ret = send(sn, buf, 0)) < 0) // hand the queued data over once SENDOK is in
+         {
+            close(sn);
+            return ret;
+         }
+#endif
          break;
       case SOCK_CLOSE_WAIT :
 #ifdef _LOOPBACK_DEBUG_
@@ -55,12 +99,12 @@ int32_t loopback_tcps(uint8_t sn, uint8_t* buf, uint16_t port)
 #endif
          if((ret = disconnect(sn)) != SOCK_OK) return ret;
 #ifdef _LOOPBACK_DEBUG_
-         printf("%d:Socket Closed\r\n", sn);
+         LOOPBACK_LOG(CLOSED, sn, 0, 0, ("%d:Socket Closed\r\n", sn));
 #endif
          break;
       case SOCK_INIT :
 #ifdef _LOOPBACK_DEBUG_
-    	 printf("%d:Listen, TCP server loopback, port [%d]\r\n", sn, port);
+    	 LOOPBACK_LOG(LISTEN, sn, port, 0, ("%d:Listen, TCP server loopback, port [%d]\r\n", sn, port));
 #endif
          if( (ret = listen(sn)) != SOCK_OK) return ret;
          break;
@@ -69,6 +113,12 @@ int32_t loopback_tcps(uint8_t sn, uint8_t* buf, uint16_t port)
          //printf("%d:TCP server loopback start\r\n",sn);
 #endif
          if((ret = socket(sn, Sn_MR_TCP, port, 0x00)) != sn) return ret;
+#if (_WIZCHIP_ == W5100S) && defined(_LOOPBACK_SEND_STREAM_)
+         {
+            uint8_t mode = SOCK_SEND_STREAM;
+            ctlsocket(sn, CS_SET_SENDMODE, &mode);
+         }
+#endif
 #ifdef _LOOPBACK_DEBUG_
          //printf("%d:Socket opened\r\n",sn);
 #endif
@@ -94,6 +144,12 @@ int32_t loopback_tcpc(uint8_t sn, uint8_t* buf, uint8_t* destip, uint16_t destpo
    // Port number for TCP client (will be increased)
    static uint16_t any_port = 	50000;
 
+#if _WIZCHIP_ == W5100S
+   wiz_pollfd pfd = {sn, WIZ_POLLIN, 0};
+
+   if(wiz_poll(&pfd, 1, 0) == 0) return 1;
+#endif
+
    // Socket Status Transitions
    // Check the W5500 Socket n status register (Sn_SR, The 'Sn_SR' controlled by Sn_CR command or Packet send/recv status)
    switch(getSn_SR(sn))
@@ -102,9 +158,10 @@ int32_t loopback_tcpc(uint8_t sn, uint8_t* buf, uint8_t* destip, uint16_t destpo
          if(getSn_IR(sn) & Sn_IR_CON)	// Socket n interrupt register mask; TCP CON interrupt = connection with peer is successful
          {
 #ifdef _LOOPBACK_DEBUG_
-			printf("%d:Connected to - %d.%d.%d.%d : %d\r\n",sn, destip[0], destip[1], destip[2], destip[3], destport);
+			LOOPBACK_LOG(CONNECTED, sn, LOOPBACK_IP(destip), destport,
+			             ("%d:Connected to - %d.%d.%d.%d : %d\r\n",sn, destip[0], destip[1], destip[2], destip[3], destport));
 #endif
-			setSn_IR(sn, Sn_IR_CON);  // this interrupt should be write the bit cleared to '1'
+			sockevent_clear(sn, Sn_IR_CON);  // this interrupt should be write the bit cleared to '1'
          }
 
          //////////////////////////////////////////////////////////////////////////////////////////////
@@ -140,13 +197,14 @@ int32_t loopback_tcpc(uint8_t sn, uint8_t* buf, uint8_t* destip, uint16_t destpo
 #endif
          if((ret=disconnect(sn)) != SOCK_OK) return ret;
 #ifdef _LOOPBACK_DEBUG_
-         printf("%d:Socket Closed\r\n", sn);
+         LOOPBACK_LOG(CLOSED, sn, 0, 0, ("%d:Socket Closed\r\n", sn));
 #endif
          break;
 
       case SOCK_INIT :
 #ifdef _LOOPBACK_DEBUG_
-    	 printf("%d:Try to connect to the %d.%d.%d.%d : %d\r\n", sn, destip[0], destip[1], destip[2], destip[3], destport);
+    	 LOOPBACK_LOG(CONNECTING, sn, LOOPBACK_IP(destip), destport,
+    	              ("%d:Try to connect to the %d.%d.%d.%d : %d\r\n", sn, destip[0], destip[1], destip[2], destip[3], destport));
 #endif
     	 if( (ret = connect(sn, destip, destport)) != SOCK_OK) return ret;	//	Try to TCP connect to the TCP server (destination)
          break;
@@ -175,6 +233,11 @@ int32_t loopback_udps(uint8_t sn, uint8_t* buf, uint16_t port)
    uint16_t size, sentsize;
    uint8_t  destip[4];
    uint16_t destport;
+#if _WIZCHIP_ == W5100S
+   wiz_pollfd pfd = {sn, WIZ_POLLIN, 0};
+
+   if(wiz_poll(&pfd, 1, 0) == 0) return 1;
+#endif
 
    switch(getSn_SR(sn))
    {
@@ -186,7 +249,7 @@ int32_t loopback_udps(uint8_t sn, uint8_t* buf, uint16_t port)
             if(ret <= 0)
             {
 #ifdef _LOOPBACK_DEBUG_
-               printf("%d: recvfrom error. %ld\r\n",sn,ret);
+               LOOPBACK_LOG(RECVFROM_ERROR, sn, ret, 0, ("%d: recvfrom error. %ld\r\n",sn,ret));
 #endif
                return ret;
             }
@@ -198,7 +261,7 @@ int32_t loopback_udps(uint8_t sn, uint8_t* buf, uint16_t port)
                if(ret < 0)
                {
 #ifdef _LOOPBACK_DEBUG_
-                  printf("%d: sendto error. %ld\r\n",sn,ret);
+                  LOOPBACK_LOG(SENDTO_ERROR, sn, ret, 0, ("%d: sendto error. %ld\r\n",sn,ret));
 #endif
                   return ret;
                }
@@ -213,7 +276,7 @@ int32_t loopback_udps(uint8_t sn, uint8_t* buf, uint16_t port)
          if((ret = socket(sn, Sn_MR_UDP, port, 0x00)) != sn)
             return ret;
 #ifdef _LOOPBACK_DEBUG_
-         printf("%d:Opened, UDP loopback, port [%d]\r\n", sn, port);
+         LOOPBACK_LOG(UDP_OPEN, sn, port, 0, ("%d:Opened, UDP loopback, port [%d]\r\n", sn, port));
 #endif
          break;
       default :
@@ -222,4 +285,402 @@ int32_t loopback_udps(uint8_t sn, uint8_t* buf, uint16_t port)
    return 1;
 }
 
+#if _WIZCHIP_ == W5100S
+/*
+ * loopback_tcps_fwd() copies the received data straight from the RX buffer to the
+ * TX buffer of the chip, LOOPBACK_FWD_CHUNK bytes at a time through buf, with no
+ * recv()/send() in between. Sn_RX_RD, RECV and Sn_TX_WR, SEND are written once per
+ * batch. With asynchronous bursts registered, each completion starts the next
+ * transfer so the batch runs from the DMA interrupt and the call returns at once.
+ */
+#define FWD_IDLE     0
+#define FWD_RUNNING  1
+#define FWD_COPIED   2  // copied, Sn_RX_RD not moved yet
+
+typedef struct
+{
+   volatile uint8_t state;
+   uint8_t  sn;
+   uint8_t* buf;
+   uint16_t rx_rd;      // chip RX pointer of the next chunk
+   uint16_t tx_wr;      // chip TX pointer of the next chunk
+   uint16_t len;        // chunk in flight
+   uint16_t left;       // batch bytes not copied yet
+   uint16_t size;       // batch size
+}loopback_fwd;
+
+// one SPI bus, a single batch at a time whatever the socket
+static loopback_fwd fwd;
+static uint16_t fwd_tx_queued[_WIZCHIP_SOCK_NUM_];   // copied past Sn_TX_WR, not handed to the chip yet
+static uint16_t fwd_sending = 0;
+
+static void fwd_read_done(void* arg);
+static void fwd_write_done(void* arg);
+
+static uint16_t fwd_chunk_len(loopback_fwd* b)
+{
+   const wiz_SnBuf* sb = wiz_sn_buf(b->sn);
+   uint16_t len = b->left;
+   uint16_t contig;
+
+   if(len > LOOPBACK_FWD_CHUNK) len = LOOPBACK_FWD_CHUNK;
+   // a chunk doesn't wrap around either ring
+   contig = sb->rxmax - (b->rx_rd & (sb->rxmax - 1));
+   if(len > contig) len = contig;
+   contig = sb->txmax - (b->tx_wr & (sb->txmax - 1));
+   if(len > contig) len = contig;
+   return len;
+}
+
+static uint32_t fwd_rx_addr(loopback_fwd* b)
+{
+   const wiz_SnBuf* sb = wiz_sn_buf(b->sn);
+   return sb->rxbase + (b->rx_rd & (sb->rxmax - 1));
+}
+
+static uint32_t fwd_tx_addr(loopback_fwd* b)
+{
+   const wiz_SnBuf* sb = wiz_sn_buf(b->sn);
+   return sb->txbase + (b->tx_wr & (sb->txmax - 1));
+}
+
+static void fwd_next(loopback_fwd* b)
+{
+   if(b->left == 0)
+   {
+      b->state = FWD_COPIED;
+      return;
+   }
+   b->len = fwd_chunk_len(b);
+   WIZCHIP_READ_BUF_ASYNC(fwd_rx_addr(b), b->buf, b->len, fwd_read_done, b);
+}
+
+static void fwd_read_done(void* arg)
+{
+   loopback_fwd* b = (loopback_fwd*)arg;
+
+   WIZCHIP_WRITE_BUF_ASYNC(fwd_tx_addr(b), b->buf, b->len, fwd_write_done, b);
+}
+
+static void fwd_write_done(void* arg)
+{
+   loopback_fwd* b = (loopback_fwd*)arg;
+
+   b->rx_rd += b->len;
+   b->tx_wr += b->len;
+   b->left  -= b->len;
+   fwd_next(b);
+}
+
+// Sn_RX_RD and RECV for the copied batch, its SEND waits for the one in flight
+static void fwd_commit(void)
+{
+   setSn_RX_RD(fwd.sn, fwd.rx_rd);
+   setSn_CR(fwd.sn, Sn_CR_RECV);
+   while(getSn_CR(fwd.sn));
+   fwd_tx_queued[fwd.sn] += fwd.size;
+   fwd.state = FWD_IDLE;
+}
+
+static void fwd_start(uint8_t sn, uint8_t* buf, uint16_t rx_rd, uint16_t tx_wr, uint16_t size)
+{
+   fwd.sn    = sn;
+   fwd.buf   = buf;
+   fwd.rx_rd = rx_rd;
+   fwd.tx_wr = tx_wr;
+   fwd.left  = size;
+   fwd.size  = size;
+   fwd.state = FWD_RUNNING;
+
+   if(wizchip_spiburst_async_enabled())
+   {
+      fwd_next(&fwd);
+      return;
+   }
+   // blocking bursts, loop here rather than nest the completion callbacks
+   while(fwd.left)
+   {
+      fwd.len = fwd_chunk_len(&fwd);
+      WIZCHIP_READ_BUF(fwd_rx_addr(&fwd), buf, fwd.len);
+      WIZCHIP_WRITE_BUF(fwd_tx_addr(&fwd), buf, fwd.len);
+      fwd.rx_rd += fwd.len;
+      fwd.tx_wr += fwd.len;
+      fwd.left  -= fwd.len;
+   }
+   fwd.state = FWD_COPIED;
+}
+
+int32_t loopback_tcps_fwd(uint8_t sn, uint8_t* buf, uint16_t port)
+{
+   int32_t ret;
+   uint16_t size = 0;
+   uint8_t committed = 0;
+   wiz_SnSnapshot snap;
+   wiz_pollfd pfd = {sn, WIZ_POLLIN | WIZ_POLLOUT, 0};
+
+#ifdef _LOOPBACK_DEBUG_
+   uint8_t destip[4];
+   uint16_t destport;
+#endif
+
+   // the chip is busy with a batch, of this socket or another one
+   if(fwd.state == FWD_RUNNING) return 1;
+   if((fwd.state == FWD_COPIED) && (fwd.sn == sn))
+   {
+      fwd_commit();
+      committed = 1;
+   }
+   // the commit left data to SEND, otherwise a SENDOK or something to copy
+   else if(wiz_poll(&pfd, 1, 0) == 0) return 1;
+
+   wiz_socket_snapshot(sn, &snap);
+   switch(snap.sr)
+   {
+      case SOCK_ESTABLISHED :
+      case SOCK_CLOSE_WAIT :
+         if(snap.ir & Sn_IR_CON)
+         {
+#ifdef _LOOPBACK_DEBUG_
+			getSn_DIPR(sn, destip);
+			destport = getSn_DPORT(sn);
+
+			LOOPBACK_LOG(CONNECTED, sn, LOOPBACK_IP(destip), destport,
+			             ("%d:Connected - %d.%d.%d.%d : %d\r\n",sn, destip[0], destip[1], destip[2], destip[3], destport));
+#endif
+			sockevent_clear(sn, Sn_IR_CON);
+         }
+         if(snap.ir & Sn_IR_TIMEOUT)
+         {
+            close(sn);
+            return SOCKERR_TIMEOUT;
+         }
+         if((fwd_sending & (1<<sn)) && (snap.ir & Sn_IR_SENDOK))
+         {
+            sockevent_clear(sn, Sn_IR_SENDOK);
+            fwd_sending &= ~(1<<sn);
+         }
+         if(!(fwd_sending & (1<<sn)) && fwd_tx_queued[sn])
+         {
+            // like snap was read after the SEND, free size counts from Sn_TX_WR
+            snap.tx_wr  += fwd_tx_queued[sn];
+            snap.tx_fsr -= fwd_tx_queued[sn];
+            fwd_tx_queued[sn] = 0;
+            setSn_TX_WR(sn, snap.tx_wr);
+            setSn_CR(sn, Sn_CR_SEND);
+            fwd_sending |= (1<<sn);
+         }
+         // after a batch of its own the next one is left to the other sockets
+         if((fwd.state != FWD_IDLE) || committed) break;
+         // queued behind the SEND in progress, if any
+         if((size = snap.rx_rsr) > snap.tx_fsr - fwd_tx_queued[sn]) size = snap.tx_fsr - fwd_tx_queued[sn];
+         if(size > 0)
+         {
+            fwd_start(sn, buf, snap.rx_rd, snap.tx_wr + fwd_tx_queued[sn], size);
+            // copied already with blocking bursts
+            if(fwd.state == FWD_COPIED) fwd_commit();
+            break;
+         }
+         if((snap.sr == SOCK_CLOSE_WAIT) && !(fwd_sending & (1<<sn)) && !fwd_tx_queued[sn])
+         {
+            if((ret = disconnect(sn)) != SOCK_OK) return ret;
+#ifdef _LOOPBACK_DEBUG_
+            LOOPBACK_LOG(CLOSED, sn, 0, 0, ("%d:Socket Closed\r\n", sn));
+#endif
+         }
+         break;
+      case SOCK_INIT :
+#ifdef _LOOPBACK_DEBUG_
+    	 LOOPBACK_LOG(LISTEN, sn, port, 0, ("%d:Listen, TCP server loopback, port [%d]\r\n", sn, port));
+#endif
+         if( (ret = listen(sn)) != SOCK_OK) return ret;
+         break;
+      case SOCK_CLOSED:
+         // a batch copied for the previous connection is dropped with it
+         if((fwd.state == FWD_COPIED) && (fwd.sn == sn)) fwd.state = FWD_IDLE;
+         fwd_tx_queued[sn] = 0;
+         fwd_sending &= ~(1<<sn);
+         if((ret = socket(sn, Sn_MR_TCP, port, 0x00)) != sn) return ret;
+         break;
+      default:
+         break;
+   }
+   return 1;
+}
+#endif
+
+/*
+ * loopback_tcps_multi() serves every socket on the same port. Each pass starts one
+ * socket further, and a socket moves at most one buffer per call of serve, so no
+ * client can starve the others.
+ *
+ * On the W5100S the 8KB TX and RX memories are shared out again whenever a socket is
+ * reopened. It gets the largest size that still leaves 1KB to each socket above it, as
+ * the next connection lands on it. A socket's base depends only on the sizes below it,
+ * so this is done only while every socket above is idle, and those still listening
+ * are closed to be reopened with their new size. Other chips keep the sizes of
+ * wizchip_init().
+ */
+static uint8_t multi_next = 0;
+
+#if _WIZCHIP_ == W5100S
+static uint8_t multi_idle(uint8_t sn)
+{
+   uint8_t sr = getSn_SR(sn);
+
+   return (sr == SOCK_CLOSED) || (sr == SOCK_INIT) || (sr == SOCK_LISTEN);
+}
+
+static void multi_set_size(uint8_t sn, uint8_t kb)
+{
+   uint8_t j = 0;
+
+   while((kb >> j) != 1) j++;
+   setSn_TXMEM_SIZE(sn, j);
+   setSn_RXMEM_SIZE(sn, j);
+}
+
+static void multi_layout(uint8_t sn)
+{
+   uint8_t i, kb, used = 0, above = 0;
+   uint8_t avail;
+
+   // bases move under a batch in flight
+   if(fwd.state == FWD_RUNNING) return;
+
+   for(i = sn + 1; i < _WIZCHIP_SOCK_NUM_; i++)
+   {
+      if(!multi_idle(i)) return;
+      above += getSn_TxMAX(i) >> 10;
+   }
+   for(i = 0; i < sn; i++) used += getSn_TxMAX(i) >> 10;
+   if(used + (_WIZCHIP_SOCK_NUM_ - sn) > 8) return;
+
+   avail = 8 - used - (_WIZCHIP_SOCK_NUM_ - 1 - sn);
+   for(kb = 8; kb > avail; kb >>= 1);
+   if(kb == (getSn_TxMAX(sn) >> 10)) return;
+
+   // shrink the listeners above first when they don't fit anymore
+   if(used + kb + above > 8)
+   {
+      for(i = sn + 1; i < _WIZCHIP_SOCK_NUM_; i++)
+      {
+         if(getSn_TxMAX(i) == 1024) continue;
+         if(getSn_SR(i) != SOCK_CLOSED) close(i);
+         multi_set_size(i, 1);
+      }
+   }
+   multi_set_size(sn, kb);
+}
+#endif
+
+int32_t loopback_tcps_multi(uint8_t* buf, uint16_t port, int32_t (*serve)(uint8_t sn, uint8_t* buf, uint16_t port))
+{
+   int32_t ret, err = 1;
+   uint8_t i, sn;
+#if _WIZCHIP_ == W5100S
+   wiz_pollfd pfd = {0, 0, 0};
+#endif
+
+   for(i = 0; i < _WIZCHIP_SOCK_NUM_; i++)
+   {
+      sn = (multi_next + i) % _WIZCHIP_SOCK_NUM_;
+#if _WIZCHIP_ == W5100S
+      // only the sockets wiz_poll() reports closed or not listening yet have their state read
+      pfd.sn = sn;
+      if((wiz_poll(&pfd, 1, 0) > 0) && (pfd.revents & WIZ_POLLHUP) && (getSn_SR(sn) == SOCK_CLOSED)) multi_layout(sn);
+#endif
+      if((ret = serve(sn, buf, port)) < 0)
+      {
+#ifdef _LOOPBACK_DEBUG_
+         LOOPBACK_LOG(ERROR, sn, ret, 0, ("%d:Loopback error : %ld\r\n", sn, ret));
+#endif
+         err = ret;
+      }
+   }
+   multi_next = (multi_next + 1) % _WIZCHIP_SOCK_NUM_;
+   return err;
+}
+
+/*
+ * loopback_tcps_pool() keeps the sockets that serve no connection listening. A closed
+ * socket is opened by serve, which resets its own state for the next connection, and
+ * listens within the same call, not a call later. The sockets are put in non-block io
+ * mode, so the disconnect() of serve on SOCK_CLOSE_WAIT returns once the FIN is out
+ * instead of waiting for SOCK_CLOSED. When no socket is left listening, one that is
+ * closing with all its data acknowledged is closed at once and listens again, the
+ * peer's last FIN or ACK is then answered by a RST. The socket sizes of wizchip_init()
+ * are kept.
+ */
+static uint8_t pool_next = 0;
+
+static int32_t pool_listen(uint8_t sn)
+{
+   uint8_t mode = SOCK_IO_NONBLOCK;
+   int32_t ret;
+
+   if((ret = ctlsocket(sn, CS_SET_IOMODE, &mode)) != SOCK_OK) return ret;
+   return listen(sn);
+}
+
+int32_t loopback_tcps_pool(uint8_t* buf, uint16_t port, int32_t (*serve)(uint8_t sn, uint8_t* buf, uint16_t port))
+{
+   int32_t ret, err = 1;
+   uint8_t i, sn, sr;
+   uint8_t listening = 0, spare = _WIZCHIP_SOCK_NUM_;
+
+   for(i = 0; i < _WIZCHIP_SOCK_NUM_; i++)
+   {
+      sn = (pool_next + i) % _WIZCHIP_SOCK_NUM_;
+      ret = 1;
+      switch(sr = getSn_SR(sn))
+      {
+         case SOCK_CLOSED :
+            // serve opens it, then it listens at once
+            if((ret = serve(sn, buf, port)) < 0) break;
+            if(getSn_SR(sn) != SOCK_INIT) break;
+            // no break
+         case SOCK_INIT :
+#ifdef _LOOPBACK_DEBUG_
+            LOOPBACK_LOG(LISTEN, sn, port, 0, ("%d:Listen, TCP server loopback, port [%d]\r\n", sn, port));
+#endif
+            if((ret = pool_listen(sn)) == SOCK_OK) listening++;
+            break;
+         case SOCK_LISTEN :
+            listening++;
+            break;
+         case SOCK_ESTABLISHED :
+         case SOCK_CLOSE_WAIT :
+            ret = serve(sn, buf, port);
+            break;
+         case SOCK_FIN_WAIT :
+         case SOCK_CLOSING :
+         case SOCK_TIME_WAIT :
+         case SOCK_LAST_ACK :
+            // our FIN is out, nothing is lost once the peer has acknowledged all the data
+            if(getSn_TX_FSR(sn) == getSn_TxMAX(sn)) spare = sn;
+            break;
+         default :
+            break;
+      }
+      if(ret < 0)
+      {
+#ifdef _LOOPBACK_DEBUG_
+         LOOPBACK_LOG(ERROR, sn, ret, 0, ("%d:Loopback error : %ld\r\n", sn, ret));
+#endif
+         err = ret;
+      }
+   }
+
+   if(!listening && (spare < _WIZCHIP_SOCK_NUM_))
+   {
+#ifdef _LOOPBACK_DEBUG_
+      LOOPBACK_LOG(RECYCLED, spare, 0, 0, ("%d:Recycled, no socket listening\r\n", spare));
+#endif
+      close(spare);
+      if(((ret = serve(spare, buf, port)) < 0) || ((getSn_SR(spare) == SOCK_INIT) && ((ret = pool_listen(spare)) != SOCK_OK))) err = ret;
+   }
+   pool_next = (pool_next + 1) % _WIZCHIP_SOCK_NUM_;
+   return err;
+}
+
 #endif
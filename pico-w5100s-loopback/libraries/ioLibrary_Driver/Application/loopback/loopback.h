@@ -6,10 +6,17 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include "wizchip_conf.h"
 
 /* Loopback test debug message printout enable */
 #define	_LOOPBACK_DEBUG_
 
+/* Debug messages recorded to the binary trace ring of trace/ instead of printf, formatted later by trace_drain() or on the host */
+//#define _LOOPBACK_TRACE_
+
+/* TCP loopback queues send() data behind the SEND in progress, W5100S only (refer to CS_SET_SENDMODE) */
+#define _LOOPBACK_SEND_STREAM_
+
 /* DATA_BUF_SIZE define for Loopback example */
 #ifndef DATA_BUF_SIZE
 	#define DATA_BUF_SIZE			2048
@@ -31,6 +38,22 @@ int32_t loopback_tcpc(uint8_t sn, uint8_t* buf, uint8_t* destip, uint16_t destpo
 /* UDP Loopback test example */
 int32_t loopback_udps(uint8_t sn, uint8_t* buf, uint16_t port);
 
+#if _WIZCHIP_ == W5100S
+/* Chunk copied from the RX to the TX buffer per SPI burst, buf of loopback_tcps_fwd() holds at least one */
+#ifndef LOOPBACK_FWD_CHUNK
+	#define LOOPBACK_FWD_CHUNK		512
+#endif
+
+/* TCP server Loopback test example, forwarding from the RX to the TX buffer of the chip without recv()/send() */
+int32_t loopback_tcps_fwd(uint8_t sn, uint8_t* buf, uint16_t port);
+#endif
+
+/* TCP server Loopback test example on all the sockets, serve (loopback_tcps() or loopback_tcps_fwd()) is called round-robin */
+int32_t loopback_tcps_multi(uint8_t* buf, uint16_t port, int32_t (*serve)(uint8_t sn, uint8_t* buf, uint16_t port));
+
+/* TCP server Loopback test example on all the sockets as loopback_tcps_multi(), the sockets without a connection listen again in the same call and one is recycled when none listens */
+int32_t loopback_tcps_pool(uint8_t* buf, uint16_t port, int32_t (*serve)(uint8_t sn, uint8_t* buf, uint16_t port));
+
 #ifdef __cplusplus
 }
 #endif
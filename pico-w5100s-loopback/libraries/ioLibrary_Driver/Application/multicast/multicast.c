@@ -1,5 +1,6 @@
 #include "multicast.h"
 #include <stdio.h>
+#include <string.h>
 #include "socket.h"
 #include "wizchip_conf.h"
 
@@ -11,6 +12,13 @@ int32_t multicast_loopback(uint8_t sn, uint8_t* buf, uint8_t* multicast_ip, uint
    uint8_t destip[4];
    uint16_t destport, port=3000;
 
+#if _WIZCHIP_ == W5100S
+   wiz_pollfd pfd = {sn, WIZ_POLLIN, 0};
+
+   // no datagram, and no socket to open
+   if(wiz_poll(&pfd, 1, 0) == 0) return 1;
+#endif
+
    switch(getSn_SR(sn))
    {
       case SOCK_UDP :
@@ -46,8 +54,8 @@ int32_t multicast_loopback(uint8_t sn, uint8_t* buf, uint8_t* multicast_ip, uint
 #ifdef _MULTICAST_DEBUG_
          printf("%d:Multicast Loopback start\r\n",sn);
 #endif
-         setSn_DIPR(0, multicast_ip);
-         setSn_DPORT(0, multicast_port);
+         setSn_DIPR(sn, multicast_ip);
+         setSn_DPORT(sn, multicast_port);
          if((ret = socket(sn, Sn_MR_UDP, port, Sn_MR_MULTI)) != sn)
             return ret;
 #ifdef _MULTICAST_DEBUG_
@@ -69,6 +77,12 @@ int32_t multicast_recv(uint8_t sn, uint8_t* buf, uint8_t* multicast_ip, uint16_t
    uint8_t destip[4];
    uint16_t destport;
 
+#if _WIZCHIP_ == W5100S
+   wiz_pollfd pfd = {sn, WIZ_POLLIN, 0};
+
+   if(wiz_poll(&pfd, 1, 0) == 0) return 1;
+#endif
+
    switch(getSn_SR(sn))
    {
       case SOCK_UDP :
@@ -111,3 +125,180 @@ int32_t multicast_recv(uint8_t sn, uint8_t* buf, uint8_t* multicast_ip, uint16_t
    }
    return 1;
 }
+
+#if _WIZCHIP_ == W5100S
+/*
+ * multicast_loopback_batch() reads the RX buffer with one burst, with the 8 byte header
+ * (IP, port and length) the W5100S puts before each datagram, and parses the headers in
+ * buf. The payloads are moved down over the headers and written to the TX buffer with
+ * one burst. A UDP SEND sends one datagram, from Sn_TX_RD to Sn_TX_WR, so Sn_TX_WR is
+ * then stepped over one payload per SEND. That leaves Sn_TX_WR, the command and its
+ * SENDOK per datagram, and the destination when it changes, where recvfrom() and
+ * sendto() read and write the pointers, sizes and destination of each one.
+ */
+static struct
+{
+   uint32_t datagrams;  // looped back
+   uint32_t bytes;      // of their payloads
+   uint32_t batches;    // burst reads of the RX buffer
+   uint32_t dropped;    // larger than buf or the TX buffer
+} mc_stats;
+
+static int32_t mc_send(uint8_t sn, uint16_t tx_wr)
+{
+   uint8_t ir;
+
+   setSn_TX_WR(sn, tx_wr);
+   setSn_CR(sn, Sn_CR_SEND);
+   while(getSn_CR(sn));
+   while(1)
+   {
+      ir = getSn_IR(sn);
+      if(ir & Sn_IR_SENDOK)
+      {
+         sockevent_clear(sn, Sn_IR_SENDOK);
+         return SOCK_OK;
+      }
+      if(ir & Sn_IR_TIMEOUT)
+      {
+         sockevent_clear(sn, Sn_IR_TIMEOUT);
+         return SOCKERR_TIMEOUT;
+      }
+   }
+}
+
+int32_t multicast_loopback_batch(uint8_t sn, uint8_t* buf, uint8_t* multicast_ip, uint16_t multicast_port, uint8_t fanout)
+{
+   int32_t  ret;
+   uint16_t size, off, total, port=3000;
+   uint32_t len;
+   uint8_t  count = 0, i;
+   uint8_t  destip[MULTICAST_BATCH_MAX][4];
+   uint16_t destport[MULTICAST_BATCH_MAX];
+   uint16_t destlen[MULTICAST_BATCH_MAX];
+   wiz_SnSnapshot snap;
+   wiz_pollfd pfd = {sn, WIZ_POLLIN, 0};
+
+   if(wiz_poll(&pfd, 1, 0) == 0) return 1;
+   wiz_socket_snapshot(sn, &snap);
+   switch(snap.sr)
+   {
+      case SOCK_UDP :
+         if((size = snap.rx_rsr) == 0) break;
+         if(size > DATA_BUF_SIZE) size = DATA_BUF_SIZE;
+         wiz_recv_data_at(sn, snap.rx_rd, buf, size);
+         mc_stats.batches++;
+
+         off = 0;
+         total = 0;
+         while((off + 8 <= size) && (count < MULTICAST_BATCH_MAX))
+         {
+            len = ((uint16_t)buf[off + 6] << 8) + buf[off + 7];
+            if(off + 8 + len > size)
+            {
+               // too large for buf even alone, the others wait for the next call
+               if(off == 0)
+               {
+                  off = (8 + len > snap.rx_rsr) ? snap.rx_rsr : (uint16_t)(8 + len);
+                  mc_stats.dropped++;
+               }
+               break;
+            }
+            if(len > wiz_sn_buf(sn)->txmax)
+               mc_stats.dropped++;
+            else if(len > 0)
+            {
+               if(total + len > snap.tx_fsr) break;
+               memcpy(destip[count], buf + off, 4);
+               destport[count] = ((uint16_t)buf[off + 4] << 8) + buf[off + 5];
+               destlen[count] = (uint16_t)len;
+               memmove(buf + total, buf + off + 8, len);
+               total += len;
+               count++;
+            }
+            off += 8 + len;
+         }
+         if(off == 0) break;
+
+         setSn_RX_RD(sn, (uint16_t)(snap.rx_rd + off));
+         setSn_CR(sn, Sn_CR_RECV);
+         while(getSn_CR(sn));
+         if(count == 0) break;
+
+         wiz_send_data_at(sn, snap.tx_wr, buf, total);
+         if(fanout)
+         {
+            setSn_DIPR(sn, multicast_ip);
+            setSn_DPORT(sn, multicast_port);
+         }
+         for(i = 0; i < count; i++)
+         {
+            if(!fanout && ((i == 0) || memcmp(destip[i], destip[i - 1], 4) || (destport[i] != destport[i - 1])))
+            {
+               setSn_DIPR(sn, destip[i]);
+               setSn_DPORT(sn, destport[i]);
+            }
+            snap.tx_wr += destlen[i];
+            if((ret = mc_send(sn, snap.tx_wr)) != SOCK_OK)
+            {
+#ifdef _MULTICAST_DEBUG_
+               printf("%d: sendto error. %ld\r\n",sn,ret);
+#endif
+               return ret;
+            }
+            mc_stats.datagrams++;
+            mc_stats.bytes += destlen[i];
+         }
+         return count;
+      case SOCK_CLOSED:
+#ifdef _MULTICAST_DEBUG_
+         printf("%d:Multicast Loopback start\r\n",sn);
+#endif
+         setSn_DIPR(sn, multicast_ip);
+         setSn_DPORT(sn, multicast_port);
+         if((ret = socket(sn, Sn_MR_UDP, port, Sn_MR_MULTI)) != sn)
+            return ret;
+#ifdef _MULTICAST_DEBUG_
+         printf("%d:Opened, UDP Multicast Socket\r\n", sn);
+         printf("%d:Multicast Group IP - %d.%d.%d.%d\r\n", sn, multicast_ip[0], multicast_ip[1], multicast_ip[2], multicast_ip[3]);
+         printf("%d:Multicast Group Port - %d\r\n", sn, multicast_port);
+#endif
+         break;
+      default :
+         break;
+   }
+   return 0;
+}
+
+int32_t multicast_bench(uint8_t sn, uint8_t* buf, uint8_t* multicast_ip, uint16_t multicast_port, uint8_t fanout,
+                        uint32_t (*millis)(void), uint32_t period_ms)
+{
+   static uint8_t  running = 0;
+   static uint32_t start;
+   int32_t  ret;
+   uint32_t now, elapsed;
+
+   if((ret = multicast_loopback_batch(sn, buf, multicast_ip, multicast_port, fanout)) < 0)
+      return ret;
+
+   now = millis();
+   if(!running)
+   {
+      memset(&mc_stats, 0, sizeof(mc_stats));
+      start = now;
+      running = 1;
+      return ret;
+   }
+   if((elapsed = now - start) < period_ms) return ret;
+   if(elapsed == 0) elapsed = 1;
+
+   printf("%d: %lu datagrams/s, %lu KB/s, %lu datagrams per burst, %lu dropped\r\n", sn,
+          (unsigned long)((uint64_t)mc_stats.datagrams * 1000 / elapsed),
+          (unsigned long)((uint64_t)mc_stats.bytes * 1000 / 1024 / elapsed),
+          (unsigned long)(mc_stats.batches ? mc_stats.datagrams / mc_stats.batches : 0),
+          (unsigned long)mc_stats.dropped);
+   memset(&mc_stats, 0, sizeof(mc_stats));
+   start = now;
+   return ret;
+}
+#endif
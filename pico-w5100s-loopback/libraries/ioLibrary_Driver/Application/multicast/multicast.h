@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include "wizchip_conf.h"
 
 /* Multicast test debug message printout enable */
 #define _MULTICAST_DEBUG_
@@ -20,6 +21,21 @@ int32_t multicast_loopback(uint8_t sn, uint8_t* buf, uint8_t* multicast_ip, uint
 /* UDP Multicast Recv test example */
 int32_t multicast_recv(uint8_t sn, uint8_t* buf, uint8_t* multicast_ip, uint16_t multicast_port);
 
+#if _WIZCHIP_ == W5100S
+/* Datagrams looped back per call of multicast_loopback_batch() at most */
+#ifndef MULTICAST_BATCH_MAX
+	#define MULTICAST_BATCH_MAX		32
+#endif
+
+/* UDP Multicast Loopback test example, all the datagrams in the RX buffer with one burst read and one TX buffer write.
+ * They go back to their senders, or to the group with fanout. Don't mix with recvfrom() on the same socket. */
+int32_t multicast_loopback_batch(uint8_t sn, uint8_t* buf, uint8_t* multicast_ip, uint16_t multicast_port, uint8_t fanout);
+
+/* multicast_loopback_batch() printing the datagrams per second every period_ms, millis() is a free running ms counter */
+int32_t multicast_bench(uint8_t sn, uint8_t* buf, uint8_t* multicast_ip, uint16_t multicast_port, uint8_t fanout,
+                        uint32_t (*millis)(void), uint32_t period_ms);
+#endif
+
 
 #ifdef __cplusplus
 }
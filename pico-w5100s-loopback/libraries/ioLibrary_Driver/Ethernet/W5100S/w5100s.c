@@ -38,21 +38,49 @@
 //
 //*****************************************************************************
 
+#include <string.h>
+
 #include "w5100s.h"
 
 #if   (_WIZCHIP_ == W5100S)
 /**
+@brief  Enters the critical section with no asynchronous burst in flight.
+
+An asynchronous burst keeps the chip selected until it completes, the next access
+has to wait for it. Its completion may start another one, so check again inside.
+*/
+static void wizchip_critical_enter_idle(void)
+{
+   WIZCHIP_CRITICAL_ENTER();
+
+   while(wizchip_spiburst_async_busy())
+   {
+      WIZCHIP_CRITICAL_EXIT();
+      WIZCHIP_CRITICAL_ENTER();
+   }
+}
+
+#ifndef _WIZCHIP_SPI_INLINE_   // or static inline in w5100s_inline.h
+/**
 @brief  This function writes the data into W5100S registers.
 */
 void     WIZCHIP_WRITE(uint32_t AddrSel, uint8_t wb )
 {
    uint8_t spi_data[4];
 
-   WIZCHIP_CRITICAL_ENTER();
+   wizchip_critical_enter_idle();
    WIZCHIP.CS._select();
 
 #if( (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_SPI_))
-   if(!WIZCHIP.IF.SPI._write_burst) 	// byte operation
+   if(WIZCHIP.IF.SPI._xfer_reg)     // register frame operation
+   {
+      spi_data[0] = 0xF0;
+      spi_data[1] = (AddrSel & 0xFF00) >>  8;
+      spi_data[2] = (AddrSel & 0x00FF) >>  0;
+      spi_data[3] = wb;
+      WIZCHIP.IF.SPI._xfer_reg(spi_data);
+   }
+   else if(!WIZCHIP.IF.SPI._write_burst) 	// byte operation
    {
       WIZCHIP.IF.SPI._write_byte(0xF0);
       WIZCHIP.IF.SPI._write_byte((AddrSel & 0xFF00) >>  8);
@@ -107,25 +135,36 @@ void     WIZCHIP_WRITE(uint32_t AddrSel, uint8_t wb )
 uint8_t  WIZCHIP_READ(uint32_t AddrSel)
 {
    uint8_t ret;
-   uint8_t spi_data[3];
-   WIZCHIP_CRITICAL_ENTER();
+   uint8_t spi_data[4];
+   wizchip_critical_enter_idle();
    WIZCHIP.CS._select();
 
 #if( (_WIZCHIP_IO_MODE_ ==  _WIZCHIP_IO_MODE_SPI_))
-   if(!WIZCHIP.IF.SPI._read_burst || !WIZCHIP.IF.SPI._write_burst) 	// byte operation
-   {
-        WIZCHIP.IF.SPI._write_byte(0x0F);
-        WIZCHIP.IF.SPI._write_byte((AddrSel & 0xFF00) >>  8);
-        WIZCHIP.IF.SPI._write_byte((AddrSel & 0x00FF) >>  0);
-   }
-   else
+   if(WIZCHIP.IF.SPI._xfer_reg)     // register frame operation
    {
         spi_data[0] = 0x0F;
         spi_data[1] = (AddrSel & 0xFF00) >>  8;
         spi_data[2] = (AddrSel & 0x00FF) >>  0;
-        WIZCHIP.IF.SPI._write_burst(spi_data, 3);
+        spi_data[3] = 0xFF;      // dummy, clocks the data in
+        ret = WIZCHIP.IF.SPI._xfer_reg(spi_data);
+   }
+   else
+   {
+      if(!WIZCHIP.IF.SPI._read_burst || !WIZCHIP.IF.SPI._write_burst) 	// byte operation
+      {
+           WIZCHIP.IF.SPI._write_byte(0x0F);
+           WIZCHIP.IF.SPI._write_byte((AddrSel & 0xFF00) >>  8);
+           WIZCHIP.IF.SPI._write_byte((AddrSel & 0x00FF) >>  0);
+      }
+      else
+      {
+           spi_data[0] = 0x0F;
+           spi_data[1] = (AddrSel & 0xFF00) >>  8;
+           spi_data[2] = (AddrSel & 0x00FF) >>  0;
+           WIZCHIP.IF.SPI._write_burst(spi_data, 3);
+      }
+      ret = WIZCHIP.IF.SPI._read_byte();
    }
-   ret = WIZCHIP.IF.SPI._read_byte(); 
 #elif ( (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_SPI_5500_) )
    if(!WIZCHIP.IF.SPI._read_burst || !WIZCHIP.IF.SPI._write_burst) 	// burst operation
 	{
@@ -160,6 +199,7 @@ uint8_t  WIZCHIP_READ(uint32_t AddrSel)
    WIZCHIP_CRITICAL_EXIT();
    return ret;
 }
+#endif
 
 
 /**
@@ -170,7 +210,7 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len)
    uint8_t spi_data[3];
    uint16_t i = 0;
 
-   WIZCHIP_CRITICAL_ENTER();
+   wizchip_critical_enter_idle();
    WIZCHIP.CS._select();   //M20150601 : Moved here.
 
 #if((_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_SPI_))
@@ -191,8 +231,16 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len)
 		spi_data[0] = 0xF0;
 		spi_data[1] = (((uint16_t)(AddrSel+i)) & 0xFF00) >>  8;
 		spi_data[2] = (((uint16_t)(AddrSel+i)) & 0x00FF) >>  0;
-		WIZCHIP.IF.SPI._write_burst(spi_data, 3);
-		WIZCHIP.IF.SPI._write_burst(pBuf, len);
+		if(WIZCHIP.IF.SPI._write_burst_vec)    // header and data in one transfer
+		{
+			wiz_iovec iov[2] = {{spi_data, 3}, {pBuf, len}};
+			WIZCHIP.IF.SPI._write_burst_vec(iov, len ? 2 : 1);
+		}
+		else
+		{
+			WIZCHIP.IF.SPI._write_burst(spi_data, 3);
+			WIZCHIP.IF.SPI._write_burst(pBuf, len);
+		}
    }
 
 #elif ( (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_SPI_5500_) )
@@ -225,12 +273,16 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len)
       WIZCHIP.IF.BUS._write_byte(IDM_DR,pBuf[i]);
    WIZCHIP_WRITE(MR, WIZCHIP_READ(MR) & ~MR_AI);   
    */
-   setMR(getMR()|MR_AI);     
+   // MR_AI is set by wizchip_sw_reset()
    WIZCHIP.IF.BUS._write_data(IDM_AR0,(AddrSel & 0xFF00) >>  8);
    WIZCHIP.IF.BUS._write_data(IDM_AR1,(AddrSel & 0x00FF));
-   for(i = 0 ; i < len; i++)
-      WIZCHIP.IF.BUS._write_data(IDM_DR,pBuf[i]);
-   setMR(getMR() & ~MR_AI);   
+   if(WIZCHIP.IF.BUS._write_data_buf)
+      WIZCHIP.IF.BUS._write_data_buf(IDM_DR, pBuf, len);
+   else
+   {
+      for(i = 0 ; i < len; i++)
+         WIZCHIP.IF.BUS._write_data(IDM_DR,pBuf[i]);
+   }
 
 #else
    #error "Unknown _WIZCHIP_IO_MODE_ in W5100S. !!!!"
@@ -248,7 +300,7 @@ void     WIZCHIP_READ_BUF (uint32_t AddrSel, uint8_t* pBuf, uint16_t len)
 {
    uint8_t spi_data[3];
    uint16_t i = 0;
-   WIZCHIP_CRITICAL_ENTER();
+   wizchip_critical_enter_idle();
    WIZCHIP.CS._select();   //M20150601 : Moved here.
    
 #if( (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_SPI_) )
@@ -268,8 +320,17 @@ void     WIZCHIP_READ_BUF (uint32_t AddrSel, uint8_t* pBuf, uint16_t len)
 		spi_data[0] = 0x0F;
 		spi_data[1] = (uint16_t)((AddrSel+i) & 0xFF00) >>  8;
 		spi_data[2] = (uint16_t)((AddrSel+i) & 0x00FF) >>  0;
-		WIZCHIP.IF.SPI._write_burst(spi_data, 3);
-		WIZCHIP.IF.SPI._read_burst(pBuf, len);
+		if(WIZCHIP.IF.SPI._read_burst_vec)     // header and data in one transfer
+		{
+			wiz_iovec wr = {spi_data, 3};
+			wiz_iovec rd = {pBuf, len};
+			WIZCHIP.IF.SPI._read_burst_vec(&wr, &rd);
+		}
+		else
+		{
+			WIZCHIP.IF.SPI._write_burst(spi_data, 3);
+			WIZCHIP.IF.SPI._read_burst(pBuf, len);
+		}
 
    }
 #elif ( (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_SPI_5500_) )
@@ -304,12 +365,16 @@ void     WIZCHIP_READ_BUF (uint32_t AddrSel, uint8_t* pBuf, uint16_t len)
       pBuf[i]	= WIZCHIP.IF.BUS._read_byte(IDM_DR);
    WIZCHIP_WRITE(MR, WIZCHIP_READ(MR) & ~MR_AI); 
    */
-   setMR(getMR() | MR_AI);
+   // MR_AI is set by wizchip_sw_reset()
    WIZCHIP.IF.BUS._write_data(IDM_AR0,(AddrSel & 0xFF00) >>  8);
    WIZCHIP.IF.BUS._write_data(IDM_AR1,(AddrSel & 0x00FF));	
-   for(i = 0 ; i < len; i++)
-      pBuf[i]	= WIZCHIP.IF.BUS._read_data(IDM_DR);
-   setMR(getMR() & ~MR_AI); 
+   if(WIZCHIP.IF.BUS._read_data_buf)
+      WIZCHIP.IF.BUS._read_data_buf(IDM_DR, pBuf, len);
+   else
+   {
+      for(i = 0 ; i < len; i++)
+         pBuf[i]	= WIZCHIP.IF.BUS._read_data(IDM_DR);
+   }
    
 #else
    #error "Unknown _WIZCHIP_IO_MODE_ in W5100S. !!!!"
@@ -319,6 +384,193 @@ void     WIZCHIP_READ_BUF (uint32_t AddrSel, uint8_t* pBuf, uint16_t len)
    WIZCHIP_CRITICAL_EXIT();
 }
 
+/**
+@brief  This function writes into W5100S memory(Buffer) across the end of a socket buffer
+*/
+void     WIZCHIP_WRITE_BUF_WRAP(uint32_t AddrSel, uint8_t* pBuf, uint16_t len, uint32_t AddrWrap, uint16_t wraplen)
+{
+#if((_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_SPI_))
+   uint8_t spi_data[2][3];
+
+   if(WIZCHIP.IF.SPI._write_burst_wrap)   // both bursts prepared at once
+   {
+      wiz_iovec iov[4] = {{spi_data[0], 3}, {pBuf, len}, {spi_data[1], 3}, {pBuf + len, wraplen}};
+
+      spi_data[0][0] = 0xF0;
+      spi_data[0][1] = (((uint16_t)AddrSel) & 0xFF00) >>  8;
+      spi_data[0][2] = (((uint16_t)AddrSel) & 0x00FF) >>  0;
+      spi_data[1][0] = 0xF0;
+      spi_data[1][1] = (((uint16_t)AddrWrap) & 0xFF00) >>  8;
+      spi_data[1][2] = (((uint16_t)AddrWrap) & 0x00FF) >>  0;
+
+      wizchip_critical_enter_idle();
+      WIZCHIP.CS._select();
+      WIZCHIP.IF.SPI._write_burst_wrap(iov);
+      WIZCHIP.CS._deselect();
+      WIZCHIP_CRITICAL_EXIT();
+      return;
+   }
+#elif ( (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_) )
+   uint16_t i;
+
+   // the address is only rewritten, no need to leave the critical section in between
+   wizchip_critical_enter_idle();
+   WIZCHIP.CS._select();
+   WIZCHIP.IF.BUS._write_data(IDM_AR0,(AddrSel & 0xFF00) >>  8);
+   WIZCHIP.IF.BUS._write_data(IDM_AR1,(AddrSel & 0x00FF));
+   if(WIZCHIP.IF.BUS._write_data_buf)
+      WIZCHIP.IF.BUS._write_data_buf(IDM_DR, pBuf, len);
+   else
+   {
+      for(i = 0 ; i < len; i++)
+         WIZCHIP.IF.BUS._write_data(IDM_DR,pBuf[i]);
+   }
+   WIZCHIP.IF.BUS._write_data(IDM_AR0,(AddrWrap & 0xFF00) >>  8);
+   WIZCHIP.IF.BUS._write_data(IDM_AR1,(AddrWrap & 0x00FF));
+   if(WIZCHIP.IF.BUS._write_data_buf)
+      WIZCHIP.IF.BUS._write_data_buf(IDM_DR, pBuf + len, wraplen);
+   else
+   {
+      for(i = 0 ; i < wraplen; i++)
+         WIZCHIP.IF.BUS._write_data(IDM_DR,pBuf[len + i]);
+   }
+   WIZCHIP.CS._deselect();
+   WIZCHIP_CRITICAL_EXIT();
+   return;
+#endif
+
+   WIZCHIP_WRITE_BUF(AddrSel, pBuf, len);
+   WIZCHIP_WRITE_BUF(AddrWrap, pBuf + len, wraplen);
+}
+
+/**
+@brief  This function reads from W5100S memory(Buffer) across the end of a socket buffer
+*/
+void     WIZCHIP_READ_BUF_WRAP(uint32_t AddrSel, uint8_t* pBuf, uint16_t len, uint32_t AddrWrap, uint16_t wraplen)
+{
+#if((_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_SPI_))
+   uint8_t spi_data[2][3];
+
+   if(WIZCHIP.IF.SPI._read_burst_wrap)    // both bursts prepared at once
+   {
+      wiz_iovec wr[2] = {{spi_data[0], 3}, {spi_data[1], 3}};
+      wiz_iovec rd[2] = {{pBuf, len}, {pBuf + len, wraplen}};
+
+      spi_data[0][0] = 0x0F;
+      spi_data[0][1] = (uint16_t)(AddrSel & 0xFF00) >>  8;
+      spi_data[0][2] = (uint16_t)(AddrSel & 0x00FF) >>  0;
+      spi_data[1][0] = 0x0F;
+      spi_data[1][1] = (uint16_t)(AddrWrap & 0xFF00) >>  8;
+      spi_data[1][2] = (uint16_t)(AddrWrap & 0x00FF) >>  0;
+
+      wizchip_critical_enter_idle();
+      WIZCHIP.CS._select();
+      WIZCHIP.IF.SPI._read_burst_wrap(wr, rd);
+      WIZCHIP.CS._deselect();
+      WIZCHIP_CRITICAL_EXIT();
+      return;
+   }
+#elif ( (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_) )
+   uint16_t i;
+
+   // the address is only rewritten, no need to leave the critical section in between
+   wizchip_critical_enter_idle();
+   WIZCHIP.CS._select();
+   WIZCHIP.IF.BUS._write_data(IDM_AR0,(AddrSel & 0xFF00) >>  8);
+   WIZCHIP.IF.BUS._write_data(IDM_AR1,(AddrSel & 0x00FF));
+   if(WIZCHIP.IF.BUS._read_data_buf)
+      WIZCHIP.IF.BUS._read_data_buf(IDM_DR, pBuf, len);
+   else
+   {
+      for(i = 0 ; i < len; i++)
+         pBuf[i]	= WIZCHIP.IF.BUS._read_data(IDM_DR);
+   }
+   WIZCHIP.IF.BUS._write_data(IDM_AR0,(AddrWrap & 0xFF00) >>  8);
+   WIZCHIP.IF.BUS._write_data(IDM_AR1,(AddrWrap & 0x00FF));
+   if(WIZCHIP.IF.BUS._read_data_buf)
+      WIZCHIP.IF.BUS._read_data_buf(IDM_DR, pBuf + len, wraplen);
+   else
+   {
+      for(i = 0 ; i < wraplen; i++)
+         pBuf[len + i]	= WIZCHIP.IF.BUS._read_data(IDM_DR);
+   }
+   WIZCHIP.CS._deselect();
+   WIZCHIP_CRITICAL_EXIT();
+   return;
+#endif
+
+   WIZCHIP_READ_BUF(AddrSel, pBuf, len);
+   WIZCHIP_READ_BUF(AddrWrap, pBuf + len, wraplen);
+}
+
+/**
+@brief  This function starts writing into W5100S memory(Buffer) in the background
+*/
+int8_t   WIZCHIP_WRITE_BUF_ASYNC(uint32_t AddrSel, uint8_t* pBuf, uint16_t len, void (*done)(void* arg), void* arg)
+{
+#if((_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_SPI_))
+   uint8_t spi_data[3];
+
+   if(WIZCHIP.IF.SPI._write_burst_async && WIZCHIP.IF.SPI._write_burst && len)
+   {
+      wizchip_critical_enter_idle();
+
+      wizchip_spiburst_async_begin(done, arg);
+
+      WIZCHIP.CS._select();
+
+      spi_data[0] = 0xF0;
+      spi_data[1] = (((uint16_t)AddrSel) & 0xFF00) >>  8;
+      spi_data[2] = (((uint16_t)AddrSel) & 0x00FF) >>  0;
+      WIZCHIP.IF.SPI._write_burst(spi_data, 3);
+
+      // CS is released by wizchip_spiburst_async_done()
+      WIZCHIP.IF.SPI._write_burst_async(pBuf, len);
+
+      WIZCHIP_CRITICAL_EXIT();
+      return 1;
+   }
+#endif
+
+   WIZCHIP_WRITE_BUF(AddrSel, pBuf, len);
+   if(done) done(arg);
+   return 0;
+}
+
+/**
+@brief  This function starts reading from W5100S memory(Buffer) in the background
+*/
+int8_t   WIZCHIP_READ_BUF_ASYNC (uint32_t AddrSel, uint8_t* pBuf, uint16_t len, void (*done)(void* arg), void* arg)
+{
+#if((_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_SPI_))
+   uint8_t spi_data[3];
+
+   if(WIZCHIP.IF.SPI._read_burst_async && WIZCHIP.IF.SPI._write_burst && len)
+   {
+      wizchip_critical_enter_idle();
+
+      wizchip_spiburst_async_begin(done, arg);
+
+      WIZCHIP.CS._select();
+
+      spi_data[0] = 0x0F;
+      spi_data[1] = (((uint16_t)AddrSel) & 0xFF00) >>  8;
+      spi_data[2] = (((uint16_t)AddrSel) & 0x00FF) >>  0;
+      WIZCHIP.IF.SPI._write_burst(spi_data, 3);
+
+      // CS is released by wizchip_spiburst_async_done()
+      WIZCHIP.IF.SPI._read_burst_async(pBuf, len);
+
+      WIZCHIP_CRITICAL_EXIT();
+      return 1;
+   }
+#endif
+
+   WIZCHIP_READ_BUF(AddrSel, pBuf, len);
+   if(done) done(arg);
+   return 0;
+}
+
 ///////////////////////////////////
 // Socket N regsiter IO function //
 ///////////////////////////////////
@@ -356,34 +608,88 @@ uint16_t getSn_RX_RSR(uint8_t sn)
    return val;
 }
 
+#define SN_SNAPSHOT_SIZE   (Sn_RX_WR(0) + 2 - Sn_MR(0))
+#define SN_SNAPSHOT_AT(reg) (reg(0) - Sn_MR(0))
+
+void wiz_socket_snapshot(uint8_t sn, wiz_SnSnapshot* snap)
+{
+   uint8_t reg[SN_SNAPSHOT_SIZE];
+   uint8_t chk[Sn_RX_RD(0) - Sn_TX_FSR(0)];
+   uint8_t* sizes = &reg[SN_SNAPSHOT_AT(Sn_TX_FSR)];
+
+   WIZCHIP_READ_BUF(Sn_MR(sn), reg, sizeof(reg));
+
+   // like getSn_TX_FSR() and getSn_RX_RSR(), read the sizes again until they match, but
+   // only while they can change: data received, or Sn_TX_WR != Sn_TX_RD while sending
+   while(sizes[6] | sizes[7] | (sizes[2] ^ sizes[4]) | (sizes[3] ^ sizes[5]))
+   {
+      WIZCHIP_READ_BUF(Sn_TX_FSR(sn), chk, sizeof(chk));
+      if(chk[0] == sizes[0] && chk[1] == sizes[1] && chk[6] == sizes[6] && chk[7] == sizes[7])
+         break;
+      memcpy(sizes, chk, sizeof(chk));
+   }
+
+   snap->mr     = reg[SN_SNAPSHOT_AT(Sn_MR)];
+   snap->cr     = reg[SN_SNAPSHOT_AT(Sn_CR)];
+   snap->ir     = reg[SN_SNAPSHOT_AT(Sn_IR)];
+   snap->sr     = reg[SN_SNAPSHOT_AT(Sn_SR)];
+   snap->tx_fsr = ((uint16_t)reg[SN_SNAPSHOT_AT(Sn_TX_FSR)] << 8) | reg[SN_SNAPSHOT_AT(Sn_TX_FSR) + 1];
+   snap->tx_rd  = ((uint16_t)reg[SN_SNAPSHOT_AT(Sn_TX_RD)]  << 8) | reg[SN_SNAPSHOT_AT(Sn_TX_RD) + 1];
+   snap->tx_wr  = ((uint16_t)reg[SN_SNAPSHOT_AT(Sn_TX_WR)]  << 8) | reg[SN_SNAPSHOT_AT(Sn_TX_WR) + 1];
+   snap->rx_rsr = ((uint16_t)reg[SN_SNAPSHOT_AT(Sn_RX_RSR)] << 8) | reg[SN_SNAPSHOT_AT(Sn_RX_RSR) + 1];
+   snap->rx_rd  = ((uint16_t)reg[SN_SNAPSHOT_AT(Sn_RX_RD)]  << 8) | reg[SN_SNAPSHOT_AT(Sn_RX_RD) + 1];
+   snap->rx_wr  = ((uint16_t)reg[SN_SNAPSHOT_AT(Sn_RX_WR)]  << 8) | reg[SN_SNAPSHOT_AT(Sn_RX_WR) + 1];
+}
+
 /////////////////////////////////////
 // Sn_TXBUF & Sn_RXBUF IO function //
 /////////////////////////////////////
-uint32_t getSn_RxBASE(uint8_t sn)
+// for each instance, refer to _WIZCHIP_INSTANCES_
+static wiz_SnBuf wiz_sn_buf_tables[_WIZCHIP_INSTANCES_][_WIZCHIP_SOCK_NUM_];
+static uint8_t   wiz_sn_buf_valids[_WIZCHIP_INSTANCES_];
+#define wiz_sn_buf_table   (wiz_sn_buf_tables[WIZCHIP_INST])
+#define wiz_sn_buf_valid   (wiz_sn_buf_valids[WIZCHIP_INST])
+
+void wiz_sn_buf_update(void)
 {
    int8_t  i;
+   uint8_t tmsr = getTMSR();
+   uint8_t rmsr = getRMSR();
 #if ( _WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_DIR_)
+   uint32_t txbase = _W5100S_IO_BASE_ + _WIZCHIP_IO_TXBUF_;
    uint32_t rxbase = _W5100S_IO_BASE_ + _WIZCHIP_IO_RXBUF_;
 #else   
+   uint32_t txbase = _WIZCHIP_IO_TXBUF_;
    uint32_t rxbase = _WIZCHIP_IO_RXBUF_;
 #endif   
-   for(i = 0; i < sn; i++)
-      rxbase += getSn_RxMAX(i);
+   uint32_t txend  = txbase + 0x2000;
+   uint32_t rxend  = rxbase + 0x2000;
+   uint16_t txmax, rxmax;
 
-   return rxbase;
+   for(i = 0; i < _WIZCHIP_SOCK_NUM_; i++)
+   {
+      txmax = (uint16_t)(0x0001 << ((tmsr >> (2*i)) & 0x03)) << 10;
+      rxmax = (uint16_t)(0x0001 << ((rmsr >> (2*i)) & 0x03)) << 10;
+      wiz_sn_buf_table[i].txbase = txbase;
+      wiz_sn_buf_table[i].rxbase = rxbase;
+      // a socket beyond the 8KB has no buffer, refer to wizchip_init_profile()
+      wiz_sn_buf_table[i].txmax  = (txbase + txmax <= txend) ? txmax : 0;
+      wiz_sn_buf_table[i].rxmax  = (rxbase + rxmax <= rxend) ? rxmax : 0;
+      txbase += txmax;
+      rxbase += rxmax;
+   }
+   wiz_sn_buf_valid = 1;
 }
 
-uint32_t getSn_TxBASE(uint8_t sn)
+void wiz_sn_buf_invalidate(void)
 {
-   int8_t  i;
-#if ( _WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_DIR_)
-   uint32_t txbase = _W5100S_IO_BASE_ + _WIZCHIP_IO_TXBUF_;
-#else   
-   uint32_t txbase = _WIZCHIP_IO_TXBUF_;
-#endif   
-   for(i = 0; i < sn; i++)
-      txbase += getSn_TxMAX(i);
-   return txbase;
+   wiz_sn_buf_valid = 0;
+}
+
+const wiz_SnBuf* wiz_sn_buf(uint8_t sn)
+{
+   if(!wiz_sn_buf_valid) wiz_sn_buf_update();
+   return &wiz_sn_buf_table[sn];
 }
 
 /**
@@ -400,32 +706,35 @@ the Tx memory uper-bound of socket.
 void wiz_send_data(uint8_t sn, uint8_t *wizdata, uint16_t len)
 {
   uint16_t ptr;
+
+  ptr = getSn_TX_WR(sn);
+
+  wiz_send_data_at(sn, ptr, wizdata, len);
+
+  ptr += len;
+
+  setSn_TX_WR(sn, ptr);  
+}
+
+void wiz_send_data_at(uint8_t sn, uint16_t ptr, uint8_t *wizdata, uint16_t len)
+{
   uint16_t size;
   uint16_t dst_mask;
   uint16_t dst_ptr;
+  const wiz_SnBuf* buf = wiz_sn_buf(sn);
 
-  ptr = getSn_TX_WR(sn);
-
-  dst_mask = ptr & getSn_TxMASK(sn);
-  dst_ptr = getSn_TxBASE(sn) + dst_mask;
+  dst_mask = ptr & (buf->txmax - 1);
+  dst_ptr = buf->txbase + dst_mask;
   
-  if (dst_mask + len > getSn_TxMAX(sn)) 
+  if (dst_mask + len > buf->txmax) 
   {
-    size = getSn_TxMAX(sn) - dst_mask;
-    WIZCHIP_WRITE_BUF(dst_ptr, wizdata, size);
-    wizdata += size;
-    size = len - size;
-    dst_ptr = getSn_TxBASE(sn);
-    WIZCHIP_WRITE_BUF(dst_ptr, wizdata, size);
+    size = buf->txmax - dst_mask;
+    WIZCHIP_WRITE_BUF_WRAP(dst_ptr, wizdata, size, buf->txbase, len - size);
   } 
   else
   {
     WIZCHIP_WRITE_BUF(dst_ptr, wizdata, len);
   }
-
-  ptr += len;
-
-  setSn_TX_WR(sn, ptr);  
 }
 
 
@@ -439,33 +748,35 @@ It calculate the actual physical address where one has to read
 the data from Receive buffer. Here also take care of the condition while it exceed
 the Rx memory uper-bound of socket.
 */
-void wiz_recv_data(uint8_t sn, uint8_t *wizdata, uint16_t len)
+void wiz_recv_data_at(uint8_t sn, uint16_t ptr, uint8_t *wizdata, uint16_t len)
 {
-  uint16_t ptr;
   uint16_t size;
   uint16_t src_mask;
   uint16_t src_ptr;
+  const wiz_SnBuf* buf = wiz_sn_buf(sn);
 
-  ptr = getSn_RX_RD(sn);
-  
-  src_mask = (uint32_t)ptr & getSn_RxMASK(sn);
-  src_ptr = (getSn_RxBASE(sn) + src_mask);
+  src_mask = ptr & (buf->rxmax - 1);
+  src_ptr = buf->rxbase + src_mask;
 
-  
-  if( (src_mask + len) > getSn_RxMAX(sn) ) 
+  if( (src_mask + len) > buf->rxmax ) 
   {
-    size = getSn_RxMAX(sn) - src_mask;
-    WIZCHIP_READ_BUF((uint32_t)src_ptr, (uint8_t*)wizdata, size);
-    wizdata += size;
-    size = len - size;
-	src_ptr = getSn_RxBASE(sn);
-    WIZCHIP_READ_BUF(src_ptr, (uint8_t*)wizdata, size);
+    size = buf->rxmax - src_mask;
+    WIZCHIP_READ_BUF_WRAP((uint32_t)src_ptr, (uint8_t*)wizdata, size, buf->rxbase, len - size);
   } 
   else
   {
     WIZCHIP_READ_BUF(src_ptr, (uint8_t*)wizdata, len);
   }
-    
+}
+
+void wiz_recv_data(uint8_t sn, uint8_t *wizdata, uint16_t len)
+{
+  uint16_t ptr;
+
+  ptr = getSn_RX_RD(sn);
+
+  wiz_recv_data_at(sn, ptr, wizdata, len);
+
   ptr += len;
   
   setSn_RX_RD(sn, ptr);
@@ -67,7 +67,7 @@ extern "C" {
 #if (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_DIR_)
    #define _W5100S_IO_BASE_     _WIZCHIP_IO_BASE_
 #elif (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_)
-	#define IDM_OR             ((_WIZCHIP_IO_BASE  + 0x0000))
+	#define IDM_OR             ((_WIZCHIP_IO_BASE_ + 0x0000))
 	#define IDM_AR0            ((_WIZCHIP_IO_BASE_ + 0x0001))
 	#define IDM_AR1            ((_WIZCHIP_IO_BASE_ + 0x0002))
 	#define IDM_DR             ((_WIZCHIP_IO_BASE_ + 0x0003))
@@ -117,7 +117,7 @@ extern "C" {
  * 	-# @b Mode \n
  *    getMR(), setMR()
  * 	-# @b Interrupt \n
- *    getIR(), setIR(), getIMR(), setIMR(),
+ *    getIR(), setIR(), getIMR(), setIMR(), getINTPTMR(), setINTPTMR(),
  * 	-# <b> Network Information </b> \n
  *    getSHAR(), setSHAR(), getGAR(), setGAR(), getSUBR(), setSUBR(), getSIPR(), setSIPR()
  * 	-# @b Retransmission \n
@@ -244,8 +244,14 @@ extern "C" {
  */
 #define SIPR    			(_W5100S_IO_BASE_ + (0x000F)) // Source IP Address
 
-// Reserved					(_W5100S_IO_BASE_ + (0x0013))
-// Reserved					(_W5100S_IO_BASE_ + (0x0014))
+/**
+ * @ingroup Common_register_group_W5100S
+ * @brief Interrupt Pending Time Register(R/W)
+ * @details \ref INTPTMR configures the time INTn stays released after the host has cleared \ref IR,
+ * before it is asserted again for an interrupt that is pending or occurs meanwhile, in steps of 4 system clocks.
+ * 0 asserts it again at once. It bounds the interrupt rate without delaying the first interrupt.
+ */
+#define INTPTMR				(_W5100S_IO_BASE_ + (0x0013)) // Interrupt Pending Time
 
 /**
  * @ingroup Common_register_group_W5100S
@@ -1786,6 +1792,7 @@ connection.
 //
 //M20150601 :  uint16_t AddrSel --> uint32_t AddrSel
 //
+#ifndef _WIZCHIP_SPI_INLINE_   // else defined in w5100s_inline.h
 /**
  * @ingroup Basic_IO_function_W5100S 
  * @brief It reads 1 byte value from a register.
@@ -1802,6 +1809,7 @@ uint8_t  WIZCHIP_READ (uint32_t AddrSel);
  * @return void
  */
 void     WIZCHIP_WRITE(uint32_t AddrSel, uint8_t wb );
+#endif
 
 /**
  * @ingroup Basic_IO_function_W5100S
@@ -1821,6 +1829,60 @@ void     WIZCHIP_READ_BUF (uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
  */
 void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
 
+/**
+ * @ingroup Basic_IO_function_W5100S
+ * @brief It reads sequence data that goes on at another address, as at the end of a socket buffer.
+ * @details Both parts are read in one critical section, with the callbacks of reg_wizchip_spiburst_wrap_cbfunc()
+ * when they are registered, else as two WIZCHIP_READ_BUF().
+ * @param AddrSel Address of the first part
+ * @param pBuf Pointer buffer to read data, len + wraplen bytes
+ * @param len Length of the first part, not 0
+ * @param AddrWrap Address of the second part
+ * @param wraplen Length of the second part, not 0
+ */
+void     WIZCHIP_READ_BUF_WRAP (uint32_t AddrSel, uint8_t* pBuf, uint16_t len, uint32_t AddrWrap, uint16_t wraplen);
+
+/**
+ * @ingroup Basic_IO_function_W5100S
+ * @brief It writes sequence data that goes on at another address, as at the end of a socket buffer.
+ * @details Both parts are written in one critical section, with the callbacks of reg_wizchip_spiburst_wrap_cbfunc()
+ * when they are registered, else as two WIZCHIP_WRITE_BUF().
+ * @param AddrSel Address of the first part
+ * @param pBuf Pointer buffer to write data, len + wraplen bytes
+ * @param len Length of the first part, not 0
+ * @param AddrWrap Address of the second part
+ * @param wraplen Length of the second part, not 0
+ */
+void     WIZCHIP_WRITE_BUF_WRAP(uint32_t AddrSel, uint8_t* pBuf, uint16_t len, uint32_t AddrWrap, uint16_t wraplen);
+
+/**
+ * @ingroup Basic_IO_function_W5100S
+ * @brief It starts writing sequence data to registers and returns without waiting.
+ * @details Needs the callbacks of reg_wizchip_spiburst_async_cbfunc(), without them it writes with
+ * WIZCHIP_WRITE_BUF() and calls done before returning. Other accesses wait until the transfer completes.
+ * @param AddrSel Register address
+ * @param pBuf Pointer buffer to write data, it must stay valid until done is called
+ * @param len Data length
+ * @param done Called when the transfer has completed, from the platform's completion interrupt. It may be NULL.
+ * @param arg Argument of done
+ * @return 1 while the transfer is in flight, 0 when it has already completed
+ */
+int8_t   WIZCHIP_WRITE_BUF_ASYNC(uint32_t AddrSel, uint8_t* pBuf, uint16_t len, void (*done)(void* arg), void* arg);
+
+/**
+ * @ingroup Basic_IO_function_W5100S
+ * @brief It starts reading sequence data from registers and returns without waiting.
+ * @details Needs the callbacks of reg_wizchip_spiburst_async_cbfunc(), without them it reads with
+ * WIZCHIP_READ_BUF() and calls done before returning. Other accesses wait until the transfer completes.
+ * @param AddrSel Register address
+ * @param pBuf Pointer buffer to read data, valid once done is called
+ * @param len Data length
+ * @param done Called when the transfer has completed, from the platform's completion interrupt. It may be NULL.
+ * @param arg Argument of done
+ * @return 1 while the transfer is in flight, 0 when it has already completed
+ */
+int8_t   WIZCHIP_READ_BUF_ASYNC (uint32_t AddrSel, uint8_t* pBuf, uint16_t len, void (*done)(void* arg), void* arg);
+
 
 /////////////////////////////////
 // Common Register IO function //
@@ -1834,6 +1896,8 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
  */
 #if (_WIZCHIP_IO_MODE_ & _WIZCHIP_IO_MODE_SPI_)
    #define setMR(mr) 	WIZCHIP_WRITE(MR,mr)
+#elif (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_)
+   #define setMR(mr)    WIZCHIP.IF.BUS._write_data(IDM_OR,mr)  // MR is IDM_OR, not memory mapped behind bus callbacks
 #else
    #define setMR(mr)    (*((uint8_t*)MR) = mr)
 #endif
@@ -1846,6 +1910,8 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
  */
 #if (_WIZCHIP_IO_MODE_ & _WIZCHIP_IO_MODE_SPI_)
    #define getMR() 		WIZCHIP_READ(MR)
+#elif (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_)
+   #define getMR()      WIZCHIP.IF.BUS._read_data(IDM_OR)
 #else
    #define getMR()      (*(uint8_t*)MR)
 #endif
@@ -1962,6 +2028,26 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
 #define getIMR() \
 		WIZCHIP_READ(_IMR_)
 
+/**
+ * @ingroup Common_register_access_function_W5100S
+ * @brief Set \ref INTPTMR register
+ * @param (uint16_t)intptmr Value to set @ref INTPTMR register.
+ * @sa getINTPTMR()
+ */
+#define setINTPTMR(intptmr)   {\
+		WIZCHIP_WRITE(INTPTMR,   (uint8_t)((intptmr) >> 8)); \
+		WIZCHIP_WRITE(WIZCHIP_OFFSET_INC(INTPTMR,1), (uint8_t)(intptmr)); \
+	}
+
+/**
+ * @ingroup Common_register_access_function_W5100S
+ * @brief Get \ref INTPTMR register
+ * @return uint16_t. Value of @ref INTPTMR register.
+ * @sa setINTPTMR()
+ */
+#define getINTPTMR() \
+		(((uint16_t)WIZCHIP_READ(INTPTMR) << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(INTPTMR,1)))
+
 /**
  * @ingroup Common_register_access_function_W5100S
  * @brief Set \ref _RTR_ register
@@ -2005,8 +2091,10 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
  * @brief Get \ref RMSR register
  * @sa getRMSR()
  */
-#define setRMSR(rmsr)   \
-      WIZCHIP_WRITE(RMSR,rmsr) // Receicve Memory Size
+#define setRMSR(rmsr) { \
+      WIZCHIP_WRITE(RMSR,rmsr); \
+      wiz_sn_buf_invalidate(); \
+   }
 
 /**
  * @ingroup Common_register_access_function_W5100S
@@ -2022,8 +2110,10 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
  * @brief Get \ref TMSR register
  * @sa getTMSR()
  */
-#define setTMSR(tmsr)   \
-      WIZCHIP_WRITE(TMSR,tmsr) // Receicve Memory Size
+#define setTMSR(tmsr) { \
+      WIZCHIP_WRITE(TMSR,tmsr); \
+      wiz_sn_buf_invalidate(); \
+   }
 
 /**
  * @ingroup Common_register_access_function_W5100S
@@ -2931,8 +3021,10 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
  * @param (uint8_t)rxmemsize Value to set \ref Sn_RXMEM_SIZE
  * @sa getSn_RXMEM_SIZE()
  */
-#define  setSn_RXMEM_SIZE(sn, rxmemsize) \
-      WIZCHIP_WRITE(RMSR, (WIZCHIP_READ(RMSR) & ~(0x03 << (2*sn))) | (rxmemsize << (2*sn)))
+#define  setSn_RXMEM_SIZE(sn, rxmemsize) { \
+      WIZCHIP_WRITE(RMSR, (WIZCHIP_READ(RMSR) & ~(0x03 << (2*sn))) | (rxmemsize << (2*sn))); \
+      wiz_sn_buf_invalidate(); \
+   }
 #define setSn_RXBUF_SIZE(sn,rxmemsize) setSn_RXMEM_SIZE(sn,rxmemsize)
 /**
  * @ingroup Socket_register_access_function_W5100S
@@ -2952,8 +3044,10 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
  * @param (uint8_t)txmemsize Value to set \ref Sn_TXMEM_SIZE
  * @sa getSn_TXMEM_SIZE()
  */
-#define setSn_TXMEM_SIZE(sn, txmemsize) \
-      WIZCHIP_WRITE(TMSR, (WIZCHIP_READ(TMSR) & ~(0x03 << (2*sn))) | (txmemsize << (2*sn)))
+#define setSn_TXMEM_SIZE(sn, txmemsize) { \
+      WIZCHIP_WRITE(TMSR, (WIZCHIP_READ(TMSR) & ~(0x03 << (2*sn))) | (txmemsize << (2*sn))); \
+      wiz_sn_buf_invalidate(); \
+   }
 #define  setSn_TXBUF_SIZE(sn, txmemsize) setSn_TXMEM_SIZE(sn,txmemsize)
 
 /**
@@ -3014,6 +3108,35 @@ uint16_t getSn_TX_FSR(uint8_t sn);
  */
 uint16_t getSn_RX_RSR(uint8_t sn);
 
+/**
+ * @ingroup DATA_TYPE
+ * @brief The socket registers decoded by wiz_socket_snapshot()
+ */
+typedef struct wiz_SnSnapshot_t
+{
+   uint8_t  mr;         ///< @ref Sn_MR
+   uint8_t  cr;         ///< @ref Sn_CR
+   uint8_t  ir;         ///< @ref Sn_IR
+   uint8_t  sr;         ///< @ref Sn_SR
+   uint16_t tx_fsr;     ///< @ref Sn_TX_FSR
+   uint16_t tx_rd;      ///< @ref Sn_TX_RD
+   uint16_t tx_wr;      ///< @ref Sn_TX_WR
+   uint16_t rx_rsr;     ///< @ref Sn_RX_RSR
+   uint16_t rx_rd;      ///< @ref Sn_RX_RD
+   uint16_t rx_wr;      ///< @ref Sn_RX_WR
+}wiz_SnSnapshot;
+
+/**
+ * @ingroup Socket_register_access_function_W5100S
+ * @brief Get @ref Sn_MR to @ref Sn_RX_WR with one burst read
+ * @details Replaces separate getSn_SR(), getSn_IR(), getSn_TX_FSR(), getSn_RX_RSR() ... calls, each of
+ * them a register access of its own. Like getSn_TX_FSR() and getSn_RX_RSR(), non zero sizes are read again
+ * until two reads agree.
+ * @param (uint8_t)sn Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param (wiz_SnSnapshot*)snap Decoded register values
+ */
+void wiz_socket_snapshot(uint8_t sn, wiz_SnSnapshot* snap);
+
 /**
  * @ingroup Socket_register_access_function_W5100S
  * @brief Set @ref Sn_RX_RD register
@@ -3080,6 +3203,43 @@ uint16_t getSn_RX_RSR(uint8_t sn);
 #define getSn_FRAGR(sn) \
 		(((uint16_t)WIZCHIP_READ(Sn_FRAGR(sn)) << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_FRAGR(sn),1)))
 
+/**
+ * @ingroup DATA_TYPE
+ * @brief The TX/RX buffer layout of one socket, derived from @ref TMSR and @ref RMSR
+ */
+typedef struct wiz_SnBuf_t
+{
+   uint32_t txbase;     ///< Address of the socket TX buffer
+   uint32_t rxbase;     ///< Address of the socket RX buffer
+   uint16_t txmax;      ///< Size of the socket TX buffer
+   uint16_t rxmax;      ///< Size of the socket RX buffer
+}wiz_SnBuf;
+
+/**
+ * @ingroup Socket_register_access_function_W5100S
+ * @brief Get the buffer layout of socket sn
+ * @details The layout is kept in RAM, so the data path doesn't read @ref TMSR and @ref RMSR for every
+ * send and receive. It is computed again from the registers on the first call after wiz_sn_buf_invalidate().
+ * @param (uint8_t)sn Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @return const wiz_SnBuf*. Buffer layout of the socket
+ */
+const wiz_SnBuf* wiz_sn_buf(uint8_t sn);
+
+/**
+ * @ingroup Socket_register_access_function_W5100S
+ * @brief Compute the buffer layout of all sockets from @ref TMSR and @ref RMSR
+ * @details Called by wizchip_init(), after the buffer sizes have been set.
+ */
+void wiz_sn_buf_update(void);
+
+/**
+ * @ingroup Socket_register_access_function_W5100S
+ * @brief Mark the buffer layout as stale
+ * @details Called by setSn_TXMEM_SIZE(), setSn_RXMEM_SIZE() and wizchip_sw_reset(). Code writing
+ * @ref TMSR or @ref RMSR directly should call it too.
+ */
+void wiz_sn_buf_invalidate(void);
+
 /**
  * @ingroup Socket_register_access_function_W5100S
  * @brief Get the max RX buffer size of socket sn
@@ -3087,7 +3247,7 @@ uint16_t getSn_RX_RSR(uint8_t sn);
  * @return uint16_t. Max buffer size
  */
 #define getSn_RxMAX(sn) \
-		((uint16_t)(0x0001 << getSn_RXMEM_SIZE(sn)) << 10)
+		(wiz_sn_buf(sn)->rxmax)
 
 
 /**
@@ -3097,7 +3257,7 @@ uint16_t getSn_RX_RSR(uint8_t sn);
  * @return uint16_t. Max buffer size
  */
 #define getSn_TxMAX(sn) \
-		((uint16_t)(0x0001 << getSn_TXMEM_SIZE(sn)) << 10)
+		(wiz_sn_buf(sn)->txmax)
 
 /**
  * @ingroup Socket_register_access_function_W5100S
@@ -3124,7 +3284,8 @@ uint16_t getSn_RX_RSR(uint8_t sn);
  * @param sn Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
  * @return uint16_t. Value of Socket n RX buffer base address.
  */
-uint32_t getSn_RxBASE(uint8_t sn);
+#define getSn_RxBASE(sn) \
+		(wiz_sn_buf(sn)->rxbase)
 
 /**
  * @ingroup Socket_register_access_function_W5100S
@@ -3132,7 +3293,8 @@ uint32_t getSn_RxBASE(uint8_t sn);
  * @param sn Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
  * @return uint16_t. Value of Socket n TX buffer base address.
  */
-uint32_t getSn_TxBASE(uint8_t sn);
+#define getSn_TxBASE(sn) \
+		(wiz_sn_buf(sn)->txbase)
 
 
 /*socket register W5100S only*/
@@ -3258,6 +3420,21 @@ uint32_t getSn_TxBASE(uint8_t sn);
  */
 void wiz_send_data(uint8_t sn, uint8_t *wizdata, uint16_t len);
 
+/**
+ * @ingroup Basic_IO_function_W5100S
+ * @brief It copies data to internal TX memory at a given pointer
+ *
+ * @details Like wiz_send_data(), but the data goes to the Tx pointer <i>ptr</i> and the Tx write pointer register
+ * is left alone. The streaming send() uses it to queue data behind a SEND command still in progress.
+ *
+ * @param sn Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param ptr Tx pointer, in the same unit as @ref Sn_TX_WR
+ * @param wizdata Pointer buffer to write data
+ * @param len Data length
+ * @sa wiz_send_data()
+ */
+void wiz_send_data_at(uint8_t sn, uint16_t ptr, uint8_t *wizdata, uint16_t len);
+
 /**
  * @ingroup Basic_IO_function_W5100S
  * @brief It copies data to your buffer from internal RX memory
@@ -3274,6 +3451,21 @@ void wiz_send_data(uint8_t sn, uint8_t *wizdata, uint16_t len);
  */
 void wiz_recv_data(uint8_t sn, uint8_t *wizdata, uint16_t len);
 
+/**
+ * @ingroup Basic_IO_function_W5100S
+ * @brief It copies data to your buffer from internal RX memory at a given pointer
+ *
+ * @details Like wiz_recv_data(), but the data comes from the Rx pointer <i>ptr</i> and the Rx read pointer register
+ * is left alone. recv_peek() uses it to look at received data without consuming it.
+ *
+ * @param sn Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param ptr Rx pointer, in the same unit as @ref Sn_RX_RD
+ * @param wizdata Pointer buffer to read data
+ * @param len Data length
+ * @sa wiz_recv_data()
+ */
+void wiz_recv_data_at(uint8_t sn, uint16_t ptr, uint8_t *wizdata, uint16_t len);
+
 /**
  * @ingroup Basic_IO_function_W5100S
  * @brief It discard the received data in RX memory.
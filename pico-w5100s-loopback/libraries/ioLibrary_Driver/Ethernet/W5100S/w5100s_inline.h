@@ -0,0 +1,129 @@
+//*****************************************************************************
+//
+//! \file w5100s_inline.h
+//! \brief W5100S register access functions built on inline SPI port primitives.
+//! \details When \_WIZCHIP_SPI_INLINE_ names a port header, WIZCHIP_READ() and WIZCHIP_WRITE()
+//!          are defined here as static inline functions instead of in w5100s.c. They call the
+//!          primitives of the port header directly, not the SPI callbacks registered with
+//!          reg_wizchip_spi_cbfunc() and reg_wizchip_spiburst_cbfunc(). \n
+//!          The port header defines these static inline functions :
+//!          - void wizchip_port_select(void)
+//!          - void wizchip_port_deselect(void)
+//!          - void wizchip_port_write(const uint8_t* pBuf, uint16_t len)
+//!          - void wizchip_port_read(uint8_t* pBuf, uint16_t len)
+//!
+//!          The buffer functions and the critical section still use the registered callbacks.
+//! \version 1.0.0
+//! \date 2021/08/25
+//! \copyright
+//!
+//! Copyright (c)  2021, WIZnet Co., LTD.
+//! All rights reserved.
+//!
+//! Redistribution and use in source and binary forms, with or without
+//! modification, are permitted provided that the following conditions
+//! are met:
+//!
+//!     * Redistributions of source code must retain the above copyright
+//! notice, this list of conditions and the following disclaimer.
+//!     * Redistributions in binary form must reproduce the above copyright
+//! notice, this list of conditions and the following disclaimer in the
+//! documentation and/or other materials provided with the distribution.
+//!     * Neither the name of the <ORGANIZATION> nor the names of its
+//! contributors may be used to endorse or promote products derived
+//! from this software without specific prior written permission.
+//!
+//! THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//! AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//! IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+//! ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+//! LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+//! CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//! SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//! INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+//! CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+//! ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+//! THE POSSIBILITY OF SUCH DAMAGE.
+//
+//*****************************************************************************
+
+#ifndef	_W5100S_INLINE_H_
+#define	_W5100S_INLINE_H_
+
+#include <stdint.h>
+#include _WIZCHIP_SPI_INLINE_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if (_WIZCHIP_IO_MODE_ != _WIZCHIP_IO_MODE_SPI_)
+   #error "_WIZCHIP_SPI_INLINE_ needs _WIZCHIP_IO_MODE_SPI_ in W5100S. !!!"
+#endif
+
+/**
+ * @brief Enters the critical section with no asynchronous burst in flight, refer to WIZCHIP_WRITE_BUF_ASYNC()
+ */
+static inline void wizchip_inline_enter(void)
+{
+   WIZCHIP.CRIS._enter();
+
+   while(WIZCHIP.ASYNC._busy)
+   {
+      WIZCHIP.CRIS._exit();
+      WIZCHIP.CRIS._enter();
+   }
+}
+
+/**
+ * @ingroup Basic_IO_function_W5100S
+ * @brief It reads 1 byte value from a register.
+ * @param AddrSel Register address
+ * @return The value of register
+ */
+static inline uint8_t WIZCHIP_READ(uint32_t AddrSel)
+{
+   uint8_t spi_data[3];
+
+   spi_data[0] = 0x0F;
+   spi_data[1] = (AddrSel & 0xFF00) >>  8;
+   spi_data[2] = (AddrSel & 0x00FF) >>  0;
+
+   wizchip_inline_enter();
+   wizchip_port_select();
+   wizchip_port_write(spi_data, 3);
+   wizchip_port_read(spi_data, 1);
+   wizchip_port_deselect();
+   WIZCHIP.CRIS._exit();
+
+   return spi_data[0];
+}
+
+/**
+ * @ingroup Basic_IO_function_W5100S
+ * @brief It writes 1 byte value to a register.
+ * @param AddrSel Register address
+ * @param wb Write data
+ * @return void
+ */
+static inline void WIZCHIP_WRITE(uint32_t AddrSel, uint8_t wb)
+{
+   uint8_t spi_data[4];
+
+   spi_data[0] = 0xF0;
+   spi_data[1] = (AddrSel & 0xFF00) >>  8;
+   spi_data[2] = (AddrSel & 0x00FF) >>  0;
+   spi_data[3] = wb;
+
+   wizchip_inline_enter();
+   wizchip_port_select();
+   wizchip_port_write(spi_data, 4);
+   wizchip_port_deselect();
+   WIZCHIP.CRIS._exit();
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _W5100S_INLINE_H_
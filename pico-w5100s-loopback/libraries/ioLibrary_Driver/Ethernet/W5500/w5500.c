@@ -65,27 +65,38 @@
 uint8_t  WIZCHIP_READ(uint32_t AddrSel)
 {
    uint8_t ret;
-   uint8_t spi_data[3];
+   uint8_t spi_data[4];
 
    WIZCHIP_CRITICAL_ENTER();
    WIZCHIP.CS._select();
 
    AddrSel |= (_W5500_SPI_READ_ | _W5500_SPI_VDM_OP_);
 
-   if(!WIZCHIP.IF.SPI._read_burst || !WIZCHIP.IF.SPI._write_burst) 	// byte operation
-   {
-	   WIZCHIP.IF.SPI._write_byte((AddrSel & 0x00FF0000) >> 16);
-		WIZCHIP.IF.SPI._write_byte((AddrSel & 0x0000FF00) >>  8);
-		WIZCHIP.IF.SPI._write_byte((AddrSel & 0x000000FF) >>  0);
-   }
-   else																// burst operation
+   if(WIZCHIP.IF.SPI._xfer_reg)     // register frame operation
    {
 		spi_data[0] = (AddrSel & 0x00FF0000) >> 16;
 		spi_data[1] = (AddrSel & 0x0000FF00) >> 8;
 		spi_data[2] = (AddrSel & 0x000000FF) >> 0;
-		WIZCHIP.IF.SPI._write_burst(spi_data, 3);
+		spi_data[3] = 0xFF;      // dummy, clocks the data in
+		ret = WIZCHIP.IF.SPI._xfer_reg(spi_data);
+   }
+   else
+   {
+      if(!WIZCHIP.IF.SPI._read_burst || !WIZCHIP.IF.SPI._write_burst) 	// byte operation
+      {
+		   WIZCHIP.IF.SPI._write_byte((AddrSel & 0x00FF0000) >> 16);
+		   WIZCHIP.IF.SPI._write_byte((AddrSel & 0x0000FF00) >>  8);
+		   WIZCHIP.IF.SPI._write_byte((AddrSel & 0x000000FF) >>  0);
+      }
+      else																// burst operation
+      {
+		   spi_data[0] = (AddrSel & 0x00FF0000) >> 16;
+		   spi_data[1] = (AddrSel & 0x0000FF00) >> 8;
+		   spi_data[2] = (AddrSel & 0x000000FF) >> 0;
+		   WIZCHIP.IF.SPI._write_burst(spi_data, 3);
+      }
+      ret = WIZCHIP.IF.SPI._read_byte();
    }
-   ret = WIZCHIP.IF.SPI._read_byte();
 
    WIZCHIP.CS._deselect();
    WIZCHIP_CRITICAL_EXIT();
@@ -101,8 +112,16 @@ void     WIZCHIP_WRITE(uint32_t AddrSel, uint8_t wb )
 
    AddrSel |= (_W5500_SPI_WRITE_ | _W5500_SPI_VDM_OP_);
 
-   //if(!WIZCHIP.IF.SPI._read_burst || !WIZCHIP.IF.SPI._write_burst) 	// byte operation
-   if(!WIZCHIP.IF.SPI._write_burst) 	// byte operation
+   if(WIZCHIP.IF.SPI._xfer_reg)     // register frame operation
+   {
+		spi_data[0] = (AddrSel & 0x00FF0000) >> 16;
+		spi_data[1] = (AddrSel & 0x0000FF00) >> 8;
+		spi_data[2] = (AddrSel & 0x000000FF) >> 0;
+		spi_data[3] = wb;
+		WIZCHIP.IF.SPI._xfer_reg(spi_data);
+   }
+   //else if(!WIZCHIP.IF.SPI._read_burst || !WIZCHIP.IF.SPI._write_burst) 	// byte operation
+   else if(!WIZCHIP.IF.SPI._write_burst) 	// byte operation
    {
 		WIZCHIP.IF.SPI._write_byte((AddrSel & 0x00FF0000) >> 16);
 		WIZCHIP.IF.SPI._write_byte((AddrSel & 0x0000FF00) >>  8);
@@ -145,8 +164,17 @@ void     WIZCHIP_READ_BUF (uint32_t AddrSel, uint8_t* pBuf, uint16_t len)
 		spi_data[0] = (AddrSel & 0x00FF0000) >> 16;
 		spi_data[1] = (AddrSel & 0x0000FF00) >> 8;
 		spi_data[2] = (AddrSel & 0x000000FF) >> 0;
-		WIZCHIP.IF.SPI._write_burst(spi_data, 3);
-		WIZCHIP.IF.SPI._read_burst(pBuf, len);
+		if(WIZCHIP.IF.SPI._read_burst_vec)     // header and data in one transfer
+		{
+			wiz_iovec wr = {spi_data, 3};
+			wiz_iovec rd = {pBuf, len};
+			WIZCHIP.IF.SPI._read_burst_vec(&wr, &rd);
+		}
+		else
+		{
+			WIZCHIP.IF.SPI._write_burst(spi_data, 3);
+			WIZCHIP.IF.SPI._read_burst(pBuf, len);
+		}
    }
 
    WIZCHIP.CS._deselect();
@@ -176,8 +204,16 @@ void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len)
 		spi_data[0] = (AddrSel & 0x00FF0000) >> 16;
 		spi_data[1] = (AddrSel & 0x0000FF00) >> 8;
 		spi_data[2] = (AddrSel & 0x000000FF) >> 0;
-		WIZCHIP.IF.SPI._write_burst(spi_data, 3);
-		WIZCHIP.IF.SPI._write_burst(pBuf, len);
+		if(WIZCHIP.IF.SPI._write_burst_vec)    // header and data in one transfer
+		{
+			wiz_iovec iov[2] = {{spi_data, 3}, {pBuf, len}};
+			WIZCHIP.IF.SPI._write_burst_vec(iov, len ? 2 : 1);
+		}
+		else
+		{
+			WIZCHIP.IF.SPI._write_burst(spi_data, 3);
+			WIZCHIP.IF.SPI._write_burst(pBuf, len);
+		}
    }
 
    WIZCHIP.CS._deselect();
@@ -237,6 +273,25 @@ void wiz_send_data(uint8_t sn, uint8_t *wizdata, uint16_t len)
    setSn_TX_WR(sn,ptr);
 }
 
+void wiz_send_data_at(uint8_t sn, uint16_t ptr, uint8_t *wizdata, uint16_t len)
+{
+   uint32_t addrsel = 0;
+
+   if(len == 0) return;
+   addrsel = ((uint32_t)ptr << 8) + (WIZCHIP_TXBUF_BLOCK(sn) << 3);
+   WIZCHIP_WRITE_BUF(addrsel, wizdata, len);
+}
+
+void wiz_recv_data_at(uint8_t sn, uint16_t ptr, uint8_t *wizdata, uint16_t len)
+{
+   uint32_t addrsel = 0;
+
+   if(len == 0) return;
+   // the RX buffer block wraps the 16 bit pointer itself
+   addrsel = ((uint32_t)ptr << 8) + (WIZCHIP_RXBUF_BLOCK(sn) << 3);
+   WIZCHIP_READ_BUF(addrsel, wizdata, len);
+}
+
 void wiz_recv_data(uint8_t sn, uint8_t *wizdata, uint16_t len)
 {
    uint16_t ptr = 0;
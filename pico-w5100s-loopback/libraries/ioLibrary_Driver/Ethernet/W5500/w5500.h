@@ -2127,6 +2127,21 @@ uint16_t getSn_RX_RSR(uint8_t sn);
  */
 void wiz_send_data(uint8_t sn, uint8_t *wizdata, uint16_t len);
 
+/**
+ * @ingroup Basic_IO_function
+ * @brief It copies data to internal TX memory at a given pointer
+ *
+ * @details Like wiz_send_data(), but the data goes to the Tx pointer <i>ptr</i> and the Tx write pointer register
+ * is left alone. wiz_splice() uses it to write a batch before one update of the pointer.
+ *
+ * @param (uint8_t)sn Socket number. It should be <b>0 ~ 7</b>.
+ * @param ptr Tx pointer, in the same unit as @ref Sn_TX_WR
+ * @param wizdata Pointer buffer to write data
+ * @param len Data length
+ * @sa wiz_send_data()
+ */
+void wiz_send_data_at(uint8_t sn, uint16_t ptr, uint8_t *wizdata, uint16_t len);
+
 /**
  * @ingroup Basic_IO_function
  * @brief It copies data to your buffer from internal RX memory
@@ -2143,6 +2158,21 @@ void wiz_send_data(uint8_t sn, uint8_t *wizdata, uint16_t len);
  */
 void wiz_recv_data(uint8_t sn, uint8_t *wizdata, uint16_t len);
 
+/**
+ * @ingroup Basic_IO_function
+ * @brief It copies data to your buffer from internal RX memory at a given pointer
+ *
+ * @details Like wiz_recv_data(), but the data comes from the Rx pointer <i>ptr</i> and the Rx read pointer register
+ * is left alone. recv_peek() uses it to look at received data without consuming it.
+ *
+ * @param (uint8_t)sn Socket number. It should be <b>0 ~ 7</b>.
+ * @param ptr Rx pointer, in the same unit as @ref Sn_RX_RD
+ * @param wizdata Pointer buffer to read data
+ * @param len Data length
+ * @sa wiz_recv_data()
+ */
+void wiz_recv_data_at(uint8_t sn, uint16_t ptr, uint8_t *wizdata, uint16_t len);
+
 /**
  * @ingroup Basic_IO_function
  * @brief It discard the received data in RX memory.
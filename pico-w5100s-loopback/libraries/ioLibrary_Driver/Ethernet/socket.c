@@ -59,19 +59,84 @@
 //#define SOCK_ANY_PORT_NUM  0xC000;
 #define SOCK_ANY_PORT_NUM  0xC000
 
+// shared by the instances, the ports of each chip only need to differ from each other
 static uint16_t sock_any_port = SOCK_ANY_PORT_NUM;
-static uint16_t sock_io_mode = 0;
-static uint16_t sock_is_sending = 0;
 
-static uint16_t sock_remained_size[_WIZCHIP_SOCK_NUM_] = {0,0,};
+// The state of the SOCKETs of a chip, one for each of _WIZCHIP_INSTANCES_.
+// The aliases below refer to the one of the selected chip, refer to wizchip_use().
+typedef struct wiz_SockState_t
+{
+   uint16_t io_mode;
+   uint16_t is_sending;
+   uint16_t cmd_async;     // CS_SET_CMDMODE
+   uint16_t cmd_pending;   // written to Sn_CR, not seen accepted yet
+   uint16_t remained_size[_WIZCHIP_SOCK_NUM_];
+   wiz_SockProfile profile[_WIZCHIP_SOCK_NUM_];   // SO_PROFILE
+#if _WIZCHIP_ != W5100S
+   // the common RTR and RCR, switched to the profile of the socket issuing a command
+   uint16_t retry_profiled;   // sockets with a profile rtr
+   uint8_t  retry_saved;      // the defaults are read
+   uint16_t retry_rtr_default;
+   uint8_t  retry_rcr_default;
+   uint16_t retry_rtr;        // written to RTR and RCR
+   uint8_t  retry_rcr;
+#endif
+#if _WIZCHIP_INSTANCES_ > 1
+   uint8_t  pack_info[_WIZCHIP_SOCK_NUM_];
+#endif
+#if _WIZCHIP_ == 5200
+   uint16_t next_rd[_WIZCHIP_SOCK_NUM_];
+#endif
+#if _WIZCHIP_ == W5100S
+   uint16_t send_stream;
+   uint16_t tx_queued[_WIZCHIP_SOCK_NUM_]; // written past Sn_TX_WR, not yet handed to the chip
+   void (*event_cb[_WIZCHIP_SOCK_NUM_])(uint8_t sn, uint8_t events);
+   uint8_t  event_mask[_WIZCHIP_SOCK_NUM_];
+   uint8_t  event_held[_WIZCHIP_SOCK_NUM_];   // Sn_IR bits reported, masked until cleared
+   uint16_t poll_armed;   // interrupts enabled by wiz_poll()
+   uint16_t poll_level;   // data left or waiting for the application, looked at on every wiz_poll()
+#endif
+} wiz_SockState;
+
+static wiz_SockState sock_state[_WIZCHIP_INSTANCES_];
+
+#define sock_io_mode          (sock_state[WIZCHIP_INST].io_mode)
+#define sock_is_sending       (sock_state[WIZCHIP_INST].is_sending)
+#define sock_cmd_async        (sock_state[WIZCHIP_INST].cmd_async)
+#define sock_cmd_pending      (sock_state[WIZCHIP_INST].cmd_pending)
+#define sock_remained_size    (sock_state[WIZCHIP_INST].remained_size)
+#define sock_profile          (sock_state[WIZCHIP_INST].profile)
 
+#if _WIZCHIP_INSTANCES_ > 1
+   #define sock_pack_info     (sock_state[WIZCHIP_INST].pack_info)
+#else
 //M20150601 : For extern decleation
 //static uint8_t  sock_pack_info[_WIZCHIP_SOCK_NUM_] = {0,};
 uint8_t  sock_pack_info[_WIZCHIP_SOCK_NUM_] = {0,};
 //
+#endif
 
 #if _WIZCHIP_ == 5200
-   static uint16_t sock_next_rd[_WIZCHIP_SOCK_NUM_] ={0,};
+   #define sock_next_rd       (sock_state[WIZCHIP_INST].next_rd)
+#endif
+
+#if _WIZCHIP_ == W5100S
+   #define sock_send_stream   (sock_state[WIZCHIP_INST].send_stream)
+   #define sock_tx_queued     (sock_state[WIZCHIP_INST].tx_queued)
+   #define sock_event_cb      (sock_state[WIZCHIP_INST].event_cb)
+   #define sock_event_mask    (sock_state[WIZCHIP_INST].event_mask)
+   #define sock_event_held    (sock_state[WIZCHIP_INST].event_held)
+   #define sock_poll_armed    (sock_state[WIZCHIP_INST].poll_armed)
+   #define sock_poll_level    (sock_state[WIZCHIP_INST].poll_level)
+
+   static volatile uint8_t sock_event_flag = 0;
+   static uint32_t (*sock_poll_ms)(void) = 0;
+   static void (*sock_poll_wait)(uint32_t timeout_ms) = 0;
+
+   // clearing SENDOK or TIMEOUT gives them back to sockevent_dispatch()
+   #define SOCK_CLR_IR(sn, ir)   sockevent_clear(sn, ir)
+#else
+   #define SOCK_CLR_IR(sn, ir)   setSn_IR(sn, ir)
 #endif
 
 //A20150601 : For integrating with W5300
@@ -80,9 +145,26 @@ uint8_t  sock_pack_info[_WIZCHIP_SOCK_NUM_] = {0,};
 #endif
 
 
+// The bitmasks above hold a bit per SOCKET. Another core or an IRQ may drive another SOCKET,
+// so their read-modify-writes are done in the critical section, refer to reg_wizchip_cris_cbfunc().
+#define SOCK_BIT_SET(bits, sn)   \
+   do{                           \
+      WIZCHIP_CRITICAL_ENTER();  \
+      (bits) |= (1 << (sn));     \
+      WIZCHIP_CRITICAL_EXIT();   \
+   }while(0)
+
+#define SOCK_BIT_CLR(bits, sn)   \
+   do{                           \
+      WIZCHIP_CRITICAL_ENTER();  \
+      (bits) &= ~(1 << (sn));    \
+      WIZCHIP_CRITICAL_EXIT();   \
+   }while(0)
+
 #define CHECK_SOCKNUM()   \
    do{                    \
       if(sn > _WIZCHIP_SOCK_NUM_) return SOCKERR_SOCKNUM;   \
+      sock_cmd_wait(sn);  \
    }while(0);             \
 
 #define CHECK_SOCKMODE(mode)  \
@@ -100,6 +182,79 @@ uint8_t  sock_pack_info[_WIZCHIP_SOCK_NUM_] = {0,};
       if(len == 0) return SOCKERR_DATALEN;   \
    }while(0);              \
 
+/*
+ * SOCK_CMD_ASYNC: a command is only written, Sn_CR is read back for its completion right
+ * before the next access to the socket, by CHECK_SOCKNUM() or the next sock_cmd(). Until then
+ * the spins on Sn_CR are left for the chip to finish the command while other sockets are served.
+ */
+static void sock_cmd_wait(uint8_t sn)
+{
+   if(!(sock_cmd_pending & (1<<sn))) return;
+   while(getSn_CR(sn));
+   SOCK_BIT_CLR(sock_cmd_pending, sn);
+}
+
+#if _WIZCHIP_ != W5100S
+static void sock_retry(uint8_t sn, uint8_t cr)
+{
+   wiz_SockState* st = &sock_state[WIZCHIP_INST];
+   uint16_t rtr;
+   uint8_t  rcr;
+
+   if(!st->retry_saved) return;
+   if((cr != Sn_CR_CONNECT) && (cr != Sn_CR_SEND) && (cr != Sn_CR_SEND_KEEP) && (cr != Sn_CR_DISCON)) return;
+   if(st->retry_profiled & (1<<sn))
+   {
+      rtr = sock_profile[sn].rtr;
+      rcr = sock_profile[sn].rcr;
+   }
+   else
+   {
+      rtr = st->retry_rtr_default;
+      rcr = st->retry_rcr_default;
+   }
+   if(rtr != st->retry_rtr)
+   {
+      setRTR(rtr);
+      st->retry_rtr = rtr;
+   }
+   if(rcr != st->retry_rcr)
+   {
+      setRCR(rcr);
+      st->retry_rcr = rcr;
+   }
+}
+#endif
+
+// the registers of the profile of an open socket, Sn_MR_ND is written by socket()
+static void sock_profile_apply(uint8_t sn)
+{
+   wiz_SockProfile* pf = &sock_profile[sn];
+
+   if(pf->mss) setSn_MSSR(sn, pf->mss);
+#if _WIZCHIP_ == W5100S
+   if(pf->rtr)
+   {
+      setSn_RTR(sn, pf->rtr);
+      setSn_RCR(sn, pf->rcr);
+   }
+#endif
+#if !( (_WIZCHIP_ == 5100) || (_WIZCHIP_ == 5200) )
+   if(pf->keepalive && ((getSn_MR(sn) & 0x0F) == Sn_MR_TCP)) setSn_KPALVTR(sn, pf->keepalive);
+#endif
+}
+
+static void sock_cmd(uint8_t sn, uint8_t cr)
+{
+   sock_cmd_wait(sn);
+#if _WIZCHIP_ != W5100S
+   sock_retry(sn, cr);
+#endif
+   setSn_CR(sn, cr);
+   if(sock_cmd_async & (1<<sn)) SOCK_BIT_SET(sock_cmd_pending, sn);
+   else                         while(getSn_CR(sn));
+}
+
 
 
 int8_t socket(uint8_t sn, uint8_t protocol, uint16_t port, uint8_t flag)
@@ -133,6 +288,10 @@ int8_t socket(uint8_t sn, uint8_t protocol, uint16_t port, uint8_t flag)
 	//M20150601 : For SF_TCP_ALIGN & W5300
 	//if((flag & 0x06) != 0) return SOCKERR_SOCKFLAG;
 	if((flag & 0x04) != 0) return SOCKERR_SOCKFLAG;
+#if _WIZCHIP_ == W5100S
+	// no buffer left to this socket by the TMSR/RMSR split
+	if(getSn_TxMAX(sn) == 0 || getSn_RxMAX(sn) == 0) return SOCKERR_SOCKNUM;
+#endif
 #if _WIZCHIP_ == 5200
    if(flag & 0x10) return SOCKERR_SOCKFLAG;
 #endif
@@ -168,6 +327,7 @@ int8_t socket(uint8_t sn, uint8_t protocol, uint16_t port, uint8_t flag)
    }
 	close(sn);
 	//M20150601
+	if((protocol == Sn_MR_TCP) && sock_profile[sn].nodelay) flag |= SF_TCP_NODELAY;
 	#if _WIZCHIP_ == 5300
 	   setSn_MR(sn, ((uint16_t)(protocol | (flag & 0xF0))) | (((uint16_t)(flag & 0x02)) << 7) );
     #else
@@ -175,17 +335,22 @@ int8_t socket(uint8_t sn, uint8_t protocol, uint16_t port, uint8_t flag)
     #endif
 	if(!port)
 	{
+	   WIZCHIP_CRITICAL_ENTER();
 	   port = sock_any_port++;
 	   if(sock_any_port == 0xFFF0) sock_any_port = SOCK_ANY_PORT_NUM;
+	   WIZCHIP_CRITICAL_EXIT();
 	}
    setSn_PORT(sn,port);	
-   setSn_CR(sn,Sn_CR_OPEN);
-   while(getSn_CR(sn));
+   sock_cmd(sn, Sn_CR_OPEN);
+   sock_profile_apply(sn);
    //A20150401 : For release the previous sock_io_mode
-   sock_io_mode &= ~(1 <<sn);
+   SOCK_BIT_CLR(sock_io_mode, sn);
    //
-	sock_io_mode |= ((flag & SF_IO_NONBLOCK) << sn);   
-   sock_is_sending &= ~(1<<sn);
+	if(flag & SF_IO_NONBLOCK) SOCK_BIT_SET(sock_io_mode, sn);
+   SOCK_BIT_CLR(sock_is_sending, sn);
+#if _WIZCHIP_ == W5100S
+   sock_tx_queued[sn] = 0;
+#endif
    sock_remained_size[sn] = 0;
    //M20150601 : repalce 0 with PACK_COMPLETED
    //sock_pack_info[sn] = 0;
@@ -223,15 +388,21 @@ int8_t close(uint8_t sn)
       sendto(sn,destip,1,destip,0x3000); // send the dummy data to an unknown destination(0.0.0.1).
    };   
 #endif 
-	setSn_CR(sn,Sn_CR_CLOSE);
-   /* wait to process the command... */
-	while( getSn_CR(sn) );
+	sock_cmd(sn, Sn_CR_CLOSE);
+	/* wait to process the command, before its interrupts are cleared */
+	sock_cmd_wait(sn);
 	/* clear all interrupt of the socket. */
-	setSn_IR(sn, 0xFF);
+	SOCK_CLR_IR(sn, 0xFF);
 	//A20150401 : Release the sock_io_mode of socket n.
-	sock_io_mode &= ~(1<<sn);
+	SOCK_BIT_CLR(sock_io_mode, sn);
 	//
-	sock_is_sending &= ~(1<<sn);
+	SOCK_BIT_CLR(sock_is_sending, sn);
+#if _WIZCHIP_ == W5100S
+	SOCK_BIT_CLR(sock_send_stream, sn);
+	sock_tx_queued[sn] = 0;
+	// closed without an interrupt, wiz_poll() reports it
+	SOCK_BIT_SET(sock_poll_level, sn);
+#endif
 	sock_remained_size[sn] = 0;
 	sock_pack_info[sn] = 0;
 	while(getSn_SR(sn) != SOCK_CLOSED);
@@ -243,8 +414,9 @@ int8_t listen(uint8_t sn)
 	CHECK_SOCKNUM();
    CHECK_SOCKMODE(Sn_MR_TCP);
 	CHECK_SOCKINIT();
-	setSn_CR(sn,Sn_CR_LISTEN);
-	while(getSn_CR(sn));
+	sock_cmd(sn, Sn_CR_LISTEN);
+	/* Sn_SR is only LISTEN once the command is processed */
+	sock_cmd_wait(sn);
    while(getSn_SR(sn) != SOCK_LISTEN)
    {
          close(sn);
@@ -274,14 +446,13 @@ int8_t connect(uint8_t sn, uint8_t * addr, uint16_t port)
 	if(port == 0) return SOCKERR_PORTZERO;
 	setSn_DIPR(sn,addr);
 	setSn_DPORT(sn,port);
-	setSn_CR(sn,Sn_CR_CONNECT);
-   while(getSn_CR(sn));
+	sock_cmd(sn, Sn_CR_CONNECT);
    if(sock_io_mode & (1<<sn)) return SOCK_BUSY;
    while(getSn_SR(sn) != SOCK_ESTABLISHED)
    {
 		if (getSn_IR(sn) & Sn_IR_TIMEOUT)
 		{
-			setSn_IR(sn, Sn_IR_TIMEOUT);
+			SOCK_CLR_IR(sn, Sn_IR_TIMEOUT);
             return SOCKERR_TIMEOUT;
 		}
 
@@ -296,12 +467,28 @@ int8_t connect(uint8_t sn, uint8_t * addr, uint16_t port)
 
 int8_t disconnect(uint8_t sn)
 {
+#if _WIZCHIP_ == W5100S
+   int32_t ret;
+#endif
    CHECK_SOCKNUM();
    CHECK_SOCKMODE(Sn_MR_TCP);
-	setSn_CR(sn,Sn_CR_DISCON);
-	/* wait to process the command... */
-	while(getSn_CR(sn));
-	sock_is_sending &= ~(1<<sn);
+#if _WIZCHIP_ == W5100S
+   // hand the queued stream data to the chip before the FIN
+   while(sock_tx_queued[sn])
+   {
+      ret = send(sn, 0, 0);
+      if(ret == SOCK_BUSY)
+      {
+         if(sock_io_mode & (1<<sn)) return SOCK_BUSY;
+      }
+      else if(ret != SOCK_OK) return (int8_t)ret;
+   }
+#endif
+	sock_cmd(sn, Sn_CR_DISCON);
+	SOCK_BIT_CLR(sock_is_sending, sn);
+#if _WIZCHIP_ == W5100S
+	sock_tx_queued[sn] = 0;
+#endif
    if(sock_io_mode & (1<<sn)) return SOCK_BUSY;
 	while(getSn_SR(sn) != SOCK_CLOSED)
 	{
@@ -314,33 +501,116 @@ int8_t disconnect(uint8_t sn)
 	return SOCK_OK;
 }
 
+#if _WIZCHIP_ == W5100S
+/*
+ * SOCK_SEND_STREAM: when the SEND in progress is acknowledged by SENDOK, hand the
+ * queued data to the chip with the next SEND. Sn_CR isn't polled after SEND, the
+ * next command of the socket is written only after SENDOK (or by close()/disconnect()).
+ */
+static int8_t send_stream_kick(uint8_t sn, wiz_SnSnapshot* snap)
+{
+   if(sock_is_sending & (1<<sn))
+   {
+      if(snap->ir & Sn_IR_SENDOK)
+      {
+         SOCK_CLR_IR(sn, Sn_IR_SENDOK);
+         // send_stream() kicks again with this snapshot, the SENDOK isn't the next SEND's
+         snap->ir &= ~Sn_IR_SENDOK;
+         SOCK_BIT_CLR(sock_is_sending, sn);
+      }
+      else if(snap->ir & Sn_IR_TIMEOUT)
+      {
+         close(sn);
+         return SOCKERR_TIMEOUT;
+      }
+      else return SOCK_BUSY;
+   }
+   if(sock_tx_queued[sn] == 0) return SOCK_OK;
+   // the free size counts from Sn_TX_WR, so moving it keeps tx_fsr - queued unchanged
+   snap->tx_wr  += sock_tx_queued[sn];
+   snap->tx_fsr -= sock_tx_queued[sn];
+   sock_tx_queued[sn] = 0;
+   setSn_TX_WR(sn, snap->tx_wr);
+   setSn_CR(sn,Sn_CR_SEND);
+   SOCK_BIT_SET(sock_is_sending, sn);
+   return SOCK_BUSY;
+}
+
+static int32_t send_stream(uint8_t sn, uint8_t * buf, uint16_t len)
+{
+   int8_t   ret;
+   uint16_t freesize=0;
+   wiz_SnSnapshot snap;
+
+   // nothing queued nor in flight, nothing to read from the chip
+   if((len == 0) && !(sock_is_sending & (1<<sn)) && (sock_tx_queued[sn] == 0)) return SOCK_OK;
+   while(1)
+   {
+      wiz_socket_snapshot(sn, &snap);
+      if((snap.mr & 0x0F) != Sn_MR_TCP) return SOCKERR_SOCKMODE;
+      if((snap.sr != SOCK_ESTABLISHED) && (snap.sr != SOCK_CLOSE_WAIT))
+      {
+         close(sn);
+         return SOCKERR_SOCKSTATUS;
+      }
+      ret = send_stream_kick(sn, &snap);
+      if(ret < 0) return ret;
+      if(len == 0) return ret;
+      freesize = snap.tx_fsr - sock_tx_queued[sn];
+      if(freesize) break;
+      if(sock_io_mode & (1<<sn)) return SOCK_BUSY;
+   }
+   if(len > freesize) len = freesize;
+   wiz_send_data_at(sn, snap.tx_wr + sock_tx_queued[sn], buf, len);
+   sock_tx_queued[sn] += len;
+   // no SEND in progress, start one right away
+   send_stream_kick(sn, &snap);
+   return (int32_t)len;
+}
+#endif
+
 int32_t send(uint8_t sn, uint8_t * buf, uint16_t len)
 {
    uint8_t tmp=0;
    uint16_t freesize=0;
+#if _WIZCHIP_ == W5100S
+   wiz_SnSnapshot snap;
+#endif
    
    CHECK_SOCKNUM();
+#if _WIZCHIP_ == W5100S
+   if(sock_send_stream & (1<<sn)) return send_stream(sn, buf, len);
+   // one burst for all the socket registers used below
+   wiz_socket_snapshot(sn, &snap);
+   if((snap.mr & 0x0F) != Sn_MR_TCP) return SOCKERR_SOCKMODE;
+   CHECK_SOCKDATA();
+   tmp = snap.sr;
+#else
    CHECK_SOCKMODE(Sn_MR_TCP);
    CHECK_SOCKDATA();
    tmp = getSn_SR(sn);
+#endif
    if(tmp != SOCK_ESTABLISHED && tmp != SOCK_CLOSE_WAIT) return SOCKERR_SOCKSTATUS;
    if( sock_is_sending & (1<<sn) )
    {
+#if _WIZCHIP_ == W5100S
+      tmp = snap.ir;
+#else
       tmp = getSn_IR(sn);
+#endif
       if(tmp & Sn_IR_SENDOK)
       {
-         setSn_IR(sn, Sn_IR_SENDOK);
+         SOCK_CLR_IR(sn, Sn_IR_SENDOK);
          //M20150401 : Typing Error
          //#if _WZICHIP_ == 5200
          #if _WIZCHIP_ == 5200
             if(getSn_TX_RD(sn) != sock_next_rd[sn])
             {
-               setSn_CR(sn,Sn_CR_SEND);
-               while(getSn_CR(sn));
+               sock_cmd(sn, Sn_CR_SEND);
                return SOCK_BUSY;
             }
          #endif
-         sock_is_sending &= ~(1<<sn);         
+         SOCK_BIT_CLR(sock_is_sending, sn);         
       }
       else if(tmp & Sn_IR_TIMEOUT)
       {
@@ -353,8 +623,13 @@ int32_t send(uint8_t sn, uint8_t * buf, uint16_t len)
    if (len > freesize) len = freesize; // check size not to exceed MAX size.
    while(1)
    {
+#if _WIZCHIP_ == W5100S
+      freesize = snap.tx_fsr;
+      tmp = snap.sr;
+#else
       freesize = getSn_TX_FSR(sn);
       tmp = getSn_SR(sn);
+#endif
       if ((tmp != SOCK_ESTABLISHED) && (tmp != SOCK_CLOSE_WAIT))
       {
          close(sn);
@@ -362,6 +637,9 @@ int32_t send(uint8_t sn, uint8_t * buf, uint16_t len)
       }
       if( (sock_io_mode & (1<<sn)) && (len > freesize) ) return SOCK_BUSY;
       if(len <= freesize) break;
+#if _WIZCHIP_ == W5100S
+      wiz_socket_snapshot(sn, &snap);
+#endif
    }
    wiz_send_data(sn, buf, len);
    #if _WIZCHIP_ == 5200
@@ -372,10 +650,8 @@ int32_t send(uint8_t sn, uint8_t * buf, uint16_t len)
       setSn_TX_WRSR(sn,len);
    #endif
    
-   setSn_CR(sn,Sn_CR_SEND);
-   /* wait to process the command... */
-   while(getSn_CR(sn));
-   sock_is_sending |= (1 << sn);
+   sock_cmd(sn, Sn_CR_SEND);
+   SOCK_BIT_SET(sock_is_sending, sn);
    //M20150409 : Explicit Type Casting
    //return len;
    return (int32_t)len;
@@ -391,9 +667,18 @@ int32_t recv(uint8_t sn, uint8_t * buf, uint16_t len)
    uint8_t head[2];
    uint16_t mr;
 #endif
+#if _WIZCHIP_ == W5100S
+   wiz_SnSnapshot snap;
+#endif
 //
    CHECK_SOCKNUM();
+#if _WIZCHIP_ == W5100S
+   // one burst for all the socket registers used below
+   wiz_socket_snapshot(sn, &snap);
+   if((snap.mr & 0x0F) != Sn_MR_TCP) return SOCKERR_SOCKMODE;
+#else
    CHECK_SOCKMODE(Sn_MR_TCP);
+#endif
    CHECK_SOCKDATA();
    
    recvsize = getSn_RxMAX(sn);
@@ -408,14 +693,23 @@ int32_t recv(uint8_t sn, uint8_t * buf, uint16_t len)
 //
       while(1)
       {
+#if _WIZCHIP_ == W5100S
+         recvsize = snap.rx_rsr;
+         tmp = snap.sr;
+#else
          recvsize = getSn_RX_RSR(sn);
          tmp = getSn_SR(sn);
+#endif
          if (tmp != SOCK_ESTABLISHED)
          {
             if(tmp == SOCK_CLOSE_WAIT)
             {
                if(recvsize != 0) break;
+#if _WIZCHIP_ == W5100S
+               else if(snap.tx_fsr == getSn_TxMAX(sn))
+#else
                else if(getSn_TX_FSR(sn) == getSn_TxMAX(sn))
+#endif
                {
                   close(sn);
                   return SOCKERR_SOCKSTATUS;
@@ -429,6 +723,9 @@ int32_t recv(uint8_t sn, uint8_t * buf, uint16_t len)
          }
          if((sock_io_mode & (1<<sn)) && (recvsize == 0)) return SOCK_BUSY;
          if(recvsize != 0) break;
+#if _WIZCHIP_ == W5100S
+         wiz_socket_snapshot(sn, &snap);
+#endif
       };
 #if _WIZCHIP_ == 5300
    }
@@ -463,8 +760,7 @@ int32_t recv(uint8_t sn, uint8_t * buf, uint16_t len)
    if(recvsize != 0)
    {
       wiz_recv_data(sn, buf, recvsize);
-      setSn_CR(sn,Sn_CR_RECV);
-      while(getSn_CR(sn));
+      sock_cmd(sn, Sn_CR_RECV);
    }
    sock_remained_size[sn] -= recvsize;
    if(sock_remained_size[sn] != 0)
@@ -478,8 +774,7 @@ int32_t recv(uint8_t sn, uint8_t * buf, uint16_t len)
 #else   
    if(recvsize < len) len = recvsize;   
    wiz_recv_data(sn, buf, len);
-   setSn_CR(sn,Sn_CR_RECV);
-   while(getSn_CR(sn));
+   sock_cmd(sn, Sn_CR_RECV);
 #endif
      
    //M20150409 : Explicit Type Casting
@@ -487,6 +782,164 @@ int32_t recv(uint8_t sn, uint8_t * buf, uint16_t len)
    return (int32_t)len;
 }
 
+#if (_WIZCHIP_ == W5100S) || (_WIZCHIP_ == W5500)
+int32_t recv_peek(uint8_t sn, uint8_t * buf, uint16_t len, uint16_t offset)
+{
+   uint8_t  sr;
+   uint16_t rsr, rd;
+#if _WIZCHIP_ == W5100S
+   wiz_SnSnapshot snap;
+#endif
+
+   CHECK_SOCKNUM();
+#if _WIZCHIP_ == W5100S
+   wiz_socket_snapshot(sn, &snap);
+   if((snap.mr & 0x0F) != Sn_MR_TCP) return SOCKERR_SOCKMODE;
+#else
+   CHECK_SOCKMODE(Sn_MR_TCP);
+#endif
+   CHECK_SOCKDATA();
+
+   while(1)
+   {
+#if _WIZCHIP_ == W5100S
+      sr  = snap.sr;
+      rsr = snap.rx_rsr;
+      rd  = snap.rx_rd;
+#else
+      sr  = getSn_SR(sn);
+      rsr = getSn_RX_RSR(sn);
+      rd  = getSn_RX_RD(sn);
+#endif
+      if(rsr > offset) break;
+      // the data up to offset is left to recv_commit(), the socket isn't closed under it
+      if(sr == SOCK_CLOSE_WAIT) return SOCKERR_SOCKSTATUS;
+      if(sr != SOCK_ESTABLISHED)
+      {
+         close(sn);
+         return SOCKERR_SOCKSTATUS;
+      }
+      if(sock_io_mode & (1<<sn)) return SOCK_BUSY;
+#if _WIZCHIP_ == W5100S
+      wiz_socket_snapshot(sn, &snap);
+#endif
+   }
+   if(len > rsr - offset) len = rsr - offset;
+   wiz_recv_data_at(sn, rd + offset, buf, len);
+   return (int32_t)len;
+}
+
+int32_t recv_commit(uint8_t sn, uint16_t len)
+{
+   uint16_t rsr, rd;
+#if _WIZCHIP_ == W5100S
+   wiz_SnSnapshot snap;
+#endif
+
+   CHECK_SOCKNUM();
+#if _WIZCHIP_ == W5100S
+   wiz_socket_snapshot(sn, &snap);
+   if((snap.mr & 0x0F) != Sn_MR_TCP) return SOCKERR_SOCKMODE;
+   rsr = snap.rx_rsr;
+   rd  = snap.rx_rd;
+#else
+   CHECK_SOCKMODE(Sn_MR_TCP);
+   rsr = getSn_RX_RSR(sn);
+   rd  = getSn_RX_RD(sn);
+#endif
+   CHECK_SOCKDATA();
+   if(len > rsr) return SOCKERR_DATALEN;
+   rd += len;
+   setSn_RX_RD(sn, rd);
+   sock_cmd(sn, Sn_CR_RECV);
+   return (int32_t)len;
+}
+
+/*
+ * wiz_splice() copies sn_in's RX buffer to sn_out's TX buffer through splice_buf, one
+ * WIZ_SPLICE_CHUNK at a time with the burst callbacks, DMA on the pico port. Both
+ * buffers are addressed from the pointers read once, the registers are written once
+ * at the end: Sn_RX_RD and RECV on one side, Sn_TX_WR and SEND on the other.
+ */
+static uint8_t splice_buf[WIZ_SPLICE_CHUNK];
+
+int32_t wiz_splice(uint8_t sn_in, uint8_t sn_out, uint16_t max)
+{
+   uint8_t  sr_in, sr_out, ir_out;
+   uint16_t rsr, rd, fsr, wr;
+   uint16_t size, left, len;
+#if _WIZCHIP_ == W5100S
+   wiz_SnSnapshot snap_in, snap_out;
+#endif
+
+   if((sn_in > _WIZCHIP_SOCK_NUM_) || (sn_out > _WIZCHIP_SOCK_NUM_) || (sn_in == sn_out)) return SOCKERR_SOCKNUM;
+   sock_cmd_wait(sn_in);
+   sock_cmd_wait(sn_out);
+   if(max == 0) return SOCKERR_DATALEN;
+#if _WIZCHIP_ == W5100S
+   // the queued data of SOCK_SEND_STREAM sits where the copy would go
+   if(sock_send_stream & (1<<sn_out)) return SOCKERR_SOCKMODE;
+   wiz_socket_snapshot(sn_in, &snap_in);
+   wiz_socket_snapshot(sn_out, &snap_out);
+   if(((snap_in.mr & 0x0F) != Sn_MR_TCP) || ((snap_out.mr & 0x0F) != Sn_MR_TCP)) return SOCKERR_SOCKMODE;
+   sr_in  = snap_in.sr;
+   rsr    = snap_in.rx_rsr;
+   rd     = snap_in.rx_rd;
+   sr_out = snap_out.sr;
+   ir_out = snap_out.ir;
+   fsr    = snap_out.tx_fsr;
+   wr     = snap_out.tx_wr;
+#else
+   if(((getSn_MR(sn_in) & 0x0F) != Sn_MR_TCP) || ((getSn_MR(sn_out) & 0x0F) != Sn_MR_TCP)) return SOCKERR_SOCKMODE;
+   sr_in  = getSn_SR(sn_in);
+   rsr    = getSn_RX_RSR(sn_in);
+   rd     = getSn_RX_RD(sn_in);
+   sr_out = getSn_SR(sn_out);
+   ir_out = getSn_IR(sn_out);
+   fsr    = getSn_TX_FSR(sn_out);
+   wr     = getSn_TX_WR(sn_out);
+#endif
+   if((sr_out != SOCK_ESTABLISHED) && (sr_out != SOCK_CLOSE_WAIT)) return SOCKERR_SOCKSTATUS;
+   // the peer of sn_in is done and everything is moved
+   if((rsr == 0) && (sr_in != SOCK_ESTABLISHED)) return SOCKERR_SOCKSTATUS;
+   if(sock_is_sending & (1<<sn_out))
+   {
+      if(ir_out & Sn_IR_SENDOK)
+      {
+         SOCK_CLR_IR(sn_out, Sn_IR_SENDOK);
+         SOCK_BIT_CLR(sock_is_sending, sn_out);
+      }
+      else if(ir_out & Sn_IR_TIMEOUT)
+      {
+         close(sn_out);
+         return SOCKERR_TIMEOUT;
+      }
+      else return SOCK_BUSY;
+   }
+
+   size = max;
+   if(size > rsr) size = rsr;
+   if(size > fsr) size = fsr;
+   if(size == 0) return SOCK_BUSY;
+
+   for(left = size; left; left -= len)
+   {
+      len = (left > WIZ_SPLICE_CHUNK) ? WIZ_SPLICE_CHUNK : left;
+      wiz_recv_data_at(sn_in, rd, splice_buf, len);
+      wiz_send_data_at(sn_out, wr, splice_buf, len);
+      rd += len;
+      wr += len;
+   }
+
+   setSn_TX_WR(sn_out, wr);
+   setSn_RX_RD(sn_in, rd);
+   sock_cmd(sn_in, Sn_CR_RECV);
+   sock_cmd(sn_out, Sn_CR_SEND);
+   SOCK_BIT_SET(sock_is_sending, sn_out);
+   return (int32_t)size;
+}
+#endif
+
 int32_t sendto(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t port)
 {
    uint8_t tmp = 0;
@@ -555,22 +1008,20 @@ int32_t sendto(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t
    setSn_TX_WRSR(sn, len);
 #endif
 //   
-	setSn_CR(sn,Sn_CR_SEND);
-	/* wait to process the command... */
-	while(getSn_CR(sn));
+	sock_cmd(sn, Sn_CR_SEND);
    while(1)
    {
       tmp = getSn_IR(sn);
       if(tmp & Sn_IR_SENDOK)
       {
-         setSn_IR(sn, Sn_IR_SENDOK);
+         SOCK_CLR_IR(sn, Sn_IR_SENDOK);
          break;
       }
       //M:20131104
       //else if(tmp & Sn_IR_TIMEOUT) return SOCKERR_TIMEOUT;
       else if(tmp & Sn_IR_TIMEOUT)
       {
-         setSn_IR(sn, Sn_IR_TIMEOUT);
+         SOCK_CLR_IR(sn, Sn_IR_TIMEOUT);
          //M20150409 : Fixed the lost of sign bits by type casting.
          //len = (uint16_t)SOCKERR_TIMEOUT;
          //break;
@@ -643,8 +1094,7 @@ int32_t recvfrom(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16
 	      if(sock_remained_size[sn] == 0)
 	      {
    			wiz_recv_data(sn, head, 8);
-   			setSn_CR(sn,Sn_CR_RECV);
-   			while(getSn_CR(sn));
+   			sock_cmd(sn, Sn_CR_RECV);
    			// read peer's IP address, port number & packet length
    	   //A20150601 : For W5300
    		#if _WIZCHIP_ == 5300
@@ -697,8 +1147,7 @@ int32_t recvfrom(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16
 	      if(sock_remained_size[sn] == 0)
 	      {
    			wiz_recv_data(sn, head, 2);
-   			setSn_CR(sn,Sn_CR_RECV);
-   			while(getSn_CR(sn));
+   			sock_cmd(sn, Sn_CR_RECV);
    			// read peer's IP address, port number & packet length
     			sock_remained_size[sn] = head[0];
    			sock_remained_size[sn] = (sock_remained_size[sn] <<8) + head[1] -2;
@@ -724,8 +1173,7 @@ int32_t recvfrom(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16
 		   if(sock_remained_size[sn] == 0)
 		   {
    			wiz_recv_data(sn, head, 6);
-   			setSn_CR(sn,Sn_CR_RECV);
-   			while(getSn_CR(sn));
+   			sock_cmd(sn, Sn_CR_RECV);
    			addr[0] = head[0];
    			addr[1] = head[1];
    			addr[2] = head[2];
@@ -749,9 +1197,7 @@ int32_t recvfrom(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16
          sock_remained_size[sn] = pack_len;
          break;
    }
-	setSn_CR(sn,Sn_CR_RECV);
-	/* wait to process the command... */
-	while(getSn_CR(sn)) ;
+	sock_cmd(sn, Sn_CR_RECV);
 	sock_remained_size[sn] -= pack_len;
 	//M20150601 : 
 	//if(sock_remained_size[sn] != 0) sock_pack_info[sn] |= 0x01;
@@ -772,6 +1218,129 @@ int32_t recvfrom(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16
    return (int32_t)pack_len;
 }
 
+#if _WIZCHIP_ != 5300
+// One datagram of sendto_multi(), the destination registers are written only with setdest
+static int32_t sendto_next(uint8_t sn, wiz_Datagram* dg, uint16_t len, uint8_t setdest, uint8_t first)
+{
+   uint8_t tmp;
+   uint16_t freesize;
+
+   if(len == 0) return SOCKERR_DATALEN;
+   if((dg->addr[0] | dg->addr[1] | dg->addr[2] | dg->addr[3]) == 0) return SOCKERR_IPINVALID;
+   if(dg->port == 0) return SOCKERR_PORTZERO;
+   if(setdest)
+   {
+      setSn_DIPR(sn, dg->addr);
+      setSn_DPORT(sn, dg->port);
+   }
+   // after the SENDOK of the previous datagram the whole TX buffer is free
+   while(first)
+   {
+      freesize = getSn_TX_FSR(sn);
+      if(getSn_SR(sn) == SOCK_CLOSED) return SOCKERR_SOCKCLOSED;
+      if( (sock_io_mode & (1<<sn)) && (len > freesize) ) return SOCK_BUSY;
+      if(len <= freesize) break;
+   }
+   wiz_send_data(sn, dg->buf, len);
+   sock_cmd(sn, Sn_CR_SEND);
+   while(1)
+   {
+      tmp = getSn_IR(sn);
+      if(tmp & Sn_IR_SENDOK)
+      {
+         SOCK_CLR_IR(sn, Sn_IR_SENDOK);
+         return (int32_t)len;
+      }
+      else if(tmp & Sn_IR_TIMEOUT)
+      {
+         SOCK_CLR_IR(sn, Sn_IR_TIMEOUT);
+         return SOCKERR_TIMEOUT;
+      }
+   }
+}
+
+int32_t sendto_multi(uint8_t sn, wiz_Datagram* dgs, uint8_t count)
+{
+   int32_t  ret = 0;
+   uint8_t  i, setdest;
+   uint16_t len, txmax;
+#if _WIZCHIP_ < 5500
+   uint32_t taddr = 0;
+#endif
+
+   CHECK_SOCKNUM();
+   CHECK_SOCKMODE(Sn_MR_UDP);
+   if(count == 0) return SOCKERR_DATALEN;
+   if(getSn_SR(sn) != SOCK_UDP) return SOCKERR_SOCKSTATUS;
+   txmax = getSn_TxMAX(sn);
+
+   #if _WIZCHIP_ < 5500   //M20150401 : for WIZCHIP Errata #4, #5 (ARP errata)
+      getSIPR((uint8_t*)&taddr);
+      if(taddr == 0)
+      {
+         getSUBR((uint8_t*)&taddr);
+         setSUBR((uint8_t*)"\x00\x00\x00\x00");
+      }
+      else taddr = 0;
+   #endif
+   for(i = 0; i < count; i++)
+   {
+      setdest = (i == 0) || (dgs[i].port != dgs[i-1].port) ||
+                (dgs[i].addr[0] != dgs[i-1].addr[0]) || (dgs[i].addr[1] != dgs[i-1].addr[1]) ||
+                (dgs[i].addr[2] != dgs[i-1].addr[2]) || (dgs[i].addr[3] != dgs[i-1].addr[3]);
+      len = (dgs[i].len > txmax) ? txmax : dgs[i].len;
+      if((ret = sendto_next(sn, &dgs[i], len, setdest, (i == 0))) < 0) break;
+   }
+   #if _WIZCHIP_ < 5500   //M20150401 : for WIZCHIP Errata #4, #5 (ARP errata)
+      if(taddr) setSUBR((uint8_t*)&taddr);
+   #endif
+   // the error of a later datagram is left to the next call, as sendmmsg()
+   if(i == 0) return ret;
+   return (int32_t)i;
+}
+
+int32_t recvfrom_multi(uint8_t sn, wiz_Datagram* dgs, uint8_t count)
+{
+   uint8_t  head[8];
+   uint8_t  i;
+   uint16_t rsr, pack_len, len;
+
+   CHECK_SOCKNUM();
+   CHECK_SOCKMODE(Sn_MR_UDP);
+   if(count == 0) return SOCKERR_DATALEN;
+   // the rest of a datagram partly read by recvfrom() is read with recvfrom()
+   if(sock_remained_size[sn] != 0) return SOCKERR_SOCKSTATUS;
+   while(1)
+   {
+      rsr = getSn_RX_RSR(sn);
+      if(getSn_SR(sn) == SOCK_CLOSED) return SOCKERR_SOCKCLOSED;
+      if( (sock_io_mode & (1<<sn)) && (rsr == 0) ) return SOCK_BUSY;
+      if(rsr != 0) break;
+   }
+   for(i = 0; (i < count) && (rsr >= 8); i++)
+   {
+      wiz_recv_data(sn, head, 8);
+      dgs[i].addr[0] = head[0];
+      dgs[i].addr[1] = head[1];
+      dgs[i].addr[2] = head[2];
+      dgs[i].addr[3] = head[3];
+      dgs[i].port = ((uint16_t)head[4] << 8) + head[5];
+      pack_len = ((uint16_t)head[6] << 8) + head[7];
+      if(pack_len > rsr - 8) pack_len = rsr - 8;
+      len = (dgs[i].len < pack_len) ? dgs[i].len : pack_len;
+      wiz_recv_data(sn, dgs[i].buf, len);
+      // the rest of a datagram larger than buf is dropped, as recvmmsg()
+      if(pack_len > len) wiz_recv_ignore(sn, pack_len - len);
+      dgs[i].len = len;
+      rsr -= 8 + pack_len;
+   }
+   // one RECV for the whole batch
+   sock_cmd(sn, Sn_CR_RECV);
+   sock_pack_info[sn] = PACK_COMPLETED;
+   return (int32_t)i;
+}
+#endif
+
 
 int8_t  ctlsocket(uint8_t sn, ctlsock_type cstype, void* arg)
 {
@@ -781,8 +1350,8 @@ int8_t  ctlsocket(uint8_t sn, ctlsock_type cstype, void* arg)
    {
       case CS_SET_IOMODE:
          tmp = *((uint8_t*)arg);
-         if(tmp == SOCK_IO_NONBLOCK)  sock_io_mode |= (1<<sn);
-         else if(tmp == SOCK_IO_BLOCK) sock_io_mode &= ~(1<<sn);
+         if(tmp == SOCK_IO_NONBLOCK)  SOCK_BIT_SET(sock_io_mode, sn);
+         else if(tmp == SOCK_IO_BLOCK) SOCK_BIT_CLR(sock_io_mode, sn);
          else return SOCKERR_ARG;
          break;
       case CS_GET_IOMODE:   
@@ -799,7 +1368,7 @@ int8_t  ctlsocket(uint8_t sn, ctlsock_type cstype, void* arg)
          break;
       case CS_CLR_INTERRUPT:
          if( (*(uint8_t*)arg) > SIK_ALL) return SOCKERR_ARG;
-         setSn_IR(sn,*(uint8_t*)arg);
+         SOCK_CLR_IR(sn,*(uint8_t*)arg);
          break;
       case CS_GET_INTERRUPT:
          *((uint8_t*)arg) = getSn_IR(sn);
@@ -812,6 +1381,30 @@ int8_t  ctlsocket(uint8_t sn, ctlsock_type cstype, void* arg)
       case CS_GET_INTMASK:   
          *((uint8_t*)arg) = getSn_IMR(sn);
          break;
+   #endif
+      case CS_SET_CMDMODE:
+         tmp = *((uint8_t*)arg);
+         if(tmp == SOCK_CMD_ASYNC) SOCK_BIT_SET(sock_cmd_async, sn);
+         else if(tmp == SOCK_CMD_SYNC) SOCK_BIT_CLR(sock_cmd_async, sn);
+         else return SOCKERR_ARG;
+         break;
+      case CS_GET_CMDMODE:
+         *((uint8_t*)arg) = (uint8_t)((sock_cmd_async >> sn) & 0x0001);
+         break;
+   #if _WIZCHIP_ == W5100S
+      case CS_SET_SENDMODE:
+         tmp = *((uint8_t*)arg);
+         if(tmp == SOCK_SEND_STREAM) SOCK_BIT_SET(sock_send_stream, sn);
+         else if(tmp == SOCK_SEND_ONESHOT)
+         {
+            if(sock_tx_queued[sn]) return SOCK_BUSY;
+            SOCK_BIT_CLR(sock_send_stream, sn);
+         }
+         else return SOCKERR_ARG;
+         break;
+      case CS_GET_SENDMODE:
+         *((uint8_t*)arg) = (uint8_t)((sock_send_stream >> sn) & 0x0001);
+         break;
    #endif
       default:
          return SOCKERR_ARG;
@@ -846,6 +1439,9 @@ int8_t  setsockopt(uint8_t sn, sockopt_type sotype, void* arg)
          CHECK_SOCKMODE(Sn_MR_TCP);
          #if _WIZCHIP_ > 5200
             if(getSn_KPALVTR(sn) != 0) return SOCKERR_SOCKOPT;
+         #endif
+         #if _WIZCHIP_ != W5100S
+            sock_retry(sn, Sn_CR_SEND_KEEP);
          #endif
             setSn_CR(sn,Sn_CR_SEND_KEEP);
             while(getSn_CR(sn) != 0)
@@ -854,7 +1450,7 @@ int8_t  setsockopt(uint8_t sn, sockopt_type sotype, void* arg)
          		//if ((tmp = getSn_IR(sn)) & Sn_IR_TIMEOUT)
                if (getSn_IR(sn) & Sn_IR_TIMEOUT)
          		{
-         			setSn_IR(sn, Sn_IR_TIMEOUT);
+         			SOCK_CLR_IR(sn, Sn_IR_TIMEOUT);
                   return SOCKERR_TIMEOUT;
          		}
             }
@@ -866,6 +1462,39 @@ int8_t  setsockopt(uint8_t sn, sockopt_type sotype, void* arg)
          break;
    #endif      
 #endif   
+      case SO_PROFILE:
+      {
+         wiz_SockProfile* pf = (wiz_SockProfile*)arg;
+      #if !( (_WIZCHIP_ == 5100) || (_WIZCHIP_ == 5200) )
+         if(pf->nodelay > 1) return SOCKERR_SOCKOPT;
+      #else
+         if((pf->nodelay > 1) || pf->keepalive) return SOCKERR_SOCKOPT;
+      #endif
+         sock_profile[sn] = *pf;
+      #if _WIZCHIP_ != W5100S
+         {
+            wiz_SockState* st = &sock_state[WIZCHIP_INST];
+            if(pf->rtr && !st->retry_saved)
+            {
+               // the values of wizchip_settimeout() for the sockets without a profile
+               st->retry_rtr_default = st->retry_rtr = getRTR();
+               st->retry_rcr_default = st->retry_rcr = getRCR();
+               st->retry_saved = 1;
+            }
+            if(pf->rtr) SOCK_BIT_SET(st->retry_profiled, sn);
+            else        SOCK_BIT_CLR(st->retry_profiled, sn);
+         }
+      #else
+         // back to the chip-wide RTR and RCR
+         if(!pf->rtr)
+         {
+            setSn_RTR(sn, getRTR());
+            setSn_RCR(sn, getRCR());
+         }
+      #endif
+         if(getSn_SR(sn) != SOCK_CLOSED) sock_profile_apply(sn);
+         break;
+      }
       default:
          return SOCKERR_ARG;
    }   
@@ -924,8 +1553,201 @@ int8_t  getsockopt(uint8_t sn, sockopt_type sotype, void* arg)
 #endif
          *(uint8_t*)arg = sock_pack_info[sn];
          break;
+      case SO_PROFILE:
+         *(wiz_SockProfile*)arg = sock_profile[sn];
+         break;
       default:
          return SOCKERR_SOCKOPT;
    }
    return SOCK_OK;
 }
+
+#if _WIZCHIP_ == W5100S
+static void sockevent_arm(uint8_t sn, uint8_t events)
+{
+   sock_event_mask[sn] = events;
+   sock_event_held[sn] = 0;
+   setSn_IMR(sn, events);
+   if(events) setIMR(getIMR() | (1<<sn));
+   else       setIMR(getIMR() & ~(1<<sn));
+   // INTn stays high until the global interrupt enable is set, SLIR of wizchip_sl_start() needs it too
+   if((getIMR() & 0x0F) || getSLIMR()) setMR2(getMR2() | MR2_G_IEN);
+   else                setMR2(getMR2() & ~MR2_G_IEN);
+}
+
+int8_t reg_sockevent_cbfunc(uint8_t sn, uint8_t events, void (*cb)(uint8_t sn, uint8_t events))
+{
+   CHECK_SOCKNUM();
+   if(events > SIK_ALL) return SOCKERR_ARG;
+   if(!cb) events = 0;
+   sock_event_cb[sn] = cb;
+   SOCK_BIT_CLR(sock_poll_armed, sn);
+   SOCK_BIT_CLR(sock_poll_level, sn);
+   sockevent_arm(sn, events);
+   return SOCK_OK;
+}
+
+void sockevent_clear(uint8_t sn, uint8_t events)
+{
+   setSn_IR(sn, events);
+   if(sock_event_held[sn] & events)
+   {
+      sock_event_held[sn] &= ~events;
+      setSn_IMR(sn, sock_event_mask[sn] & ~sock_event_held[sn]);
+   }
+}
+
+void sockevent_isr(void)
+{
+   sock_event_flag = 1;
+}
+
+uint8_t sockevent_pending(void)
+{
+   return sock_event_flag;
+}
+
+int8_t sockevent_dispatch(void)
+{
+   uint8_t sn, ir, sir, held;
+   int8_t  count = 0, found;
+
+   // cleared first, an edge during the dispatch is caught by the next one
+   sock_event_flag = 0;
+   // the socket-less command, SLIR isn't in IR
+   count += wizchip_sl_poll();
+   do
+   {
+      found = 0;
+      // getIR() masks the socket bits off
+      sir = WIZCHIP_READ(IR) & 0x0F;
+      for(sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++)
+      {
+         // the sockets of wiz_poll() have no callback
+         if(!(sir & (1<<sn)) || !sock_event_cb[sn] || !sock_event_mask[sn]) continue;
+         // held bits are still set, they were reported already
+         ir = getSn_IR(sn) & sock_event_mask[sn] & ~sock_event_held[sn];
+         if(!ir) continue;
+         held = ir & (Sn_IR_SENDOK | Sn_IR_TIMEOUT);
+         if(ir & ~held) setSn_IR(sn, ir & ~held);
+         if(held)
+         {
+            // send() and friends read and clear them, masked so that INTn is released meanwhile
+            sock_event_held[sn] |= held;
+            setSn_IMR(sn, sock_event_mask[sn] & ~sock_event_held[sn]);
+         }
+         found = 1;
+         count++;
+         sock_event_cb[sn](sn, ir);
+      }
+   }while(found);
+   return count;
+}
+
+void reg_wizpoll_cbfunc(uint32_t (*ms)(void), void (*wait)(uint32_t timeout_ms))
+{
+   sock_poll_ms = ms;
+   sock_poll_wait = wait;
+}
+
+/*
+ * wiz_poll() reads IR, then the registers of the flagged sockets only, with a snapshot
+ * each. RECV and DISCON are cleared there, they only say to look at the sizes and the
+ * state. CON, SENDOK and TIMEOUT are held like in sockevent_dispatch(), masked in Sn_IMR
+ * so that IR and INTn are released, and reported from RAM until the application or the
+ * socket APIs clear them with sockevent_clear(). A socket with data left or in a state
+ * only the application moves it out of is in sock_poll_level and looked at again on the
+ * next call, any other costs nothing beyond the IR read until its next interrupt.
+ */
+#define SOCK_POLL_HELD     (Sn_IR_CON | Sn_IR_SENDOK | Sn_IR_TIMEOUT)
+
+static uint8_t wiz_poll_held(uint8_t sn, uint8_t events)
+{
+   uint8_t held = sock_event_held[sn];
+   uint8_t rev = 0;
+
+   if((events & WIZ_POLLIN) && (held & Sn_IR_CON)) rev |= WIZ_POLLIN;
+   if((events & WIZ_POLLOUT) && (held & Sn_IR_SENDOK)) rev |= WIZ_POLLOUT;
+   if(held & Sn_IR_TIMEOUT) rev |= WIZ_POLLERR;
+   return rev;
+}
+
+static uint8_t wiz_poll_socket(uint8_t sn, uint8_t events)
+{
+   uint8_t ir, held, rev;
+   wiz_SnSnapshot snap;
+
+   // Sn_RX_RSR is stale until a RECV posted in SOCK_CMD_ASYNC is processed
+   sock_cmd_wait(sn);
+   wiz_socket_snapshot(sn, &snap);
+   ir = snap.ir & sock_event_mask[sn] & ~sock_event_held[sn];
+   if(ir & ~SOCK_POLL_HELD) setSn_IR(sn, ir & ~SOCK_POLL_HELD);
+   held = ir & SOCK_POLL_HELD;
+   if(held)
+   {
+      sock_event_held[sn] |= held;
+      setSn_IMR(sn, sock_event_mask[sn] & ~sock_event_held[sn]);
+   }
+   rev = wiz_poll_held(sn, events);
+   if((snap.sr == SOCK_CLOSED) || (snap.sr == SOCK_INIT) || (snap.sr == SOCK_CLOSE_WAIT)) rev |= WIZ_POLLHUP;
+   if(snap.rx_rsr || (rev & WIZ_POLLHUP)) SOCK_BIT_SET(sock_poll_level, sn);
+   else                                    SOCK_BIT_CLR(sock_poll_level, sn);
+   if((events & WIZ_POLLIN) && snap.rx_rsr) rev |= WIZ_POLLIN;
+   return rev;
+}
+
+int16_t wiz_poll(wiz_pollfd* fds, uint8_t nfds, int32_t timeout_ms)
+{
+   uint8_t  i, sn, sir;
+   uint16_t seen;
+   int16_t  count;
+   uint32_t start = 0, elapsed;
+
+   if(sock_poll_ms) start = sock_poll_ms();
+   while(1)
+   {
+      // cleared first, an edge during the scan ends the wait below
+      sock_event_flag = 0;
+      // getIR() masks the socket bits off
+      sir = WIZCHIP_READ(IR) & 0x0F;
+      seen = 0;
+      count = 0;
+      for(i = 0; i < nfds; i++)
+      {
+         sn = fds[i].sn;
+         if((sn >= _WIZCHIP_SOCK_NUM_) || sock_event_cb[sn])
+         {
+            fds[i].revents = WIZ_POLLNVAL;
+            count++;
+            continue;
+         }
+         if(!(sock_poll_armed & (1<<sn)))
+         {
+            // the state is read on the first call, then on interrupts
+            sockevent_arm(sn, SIK_ALL);
+            SOCK_BIT_SET(sock_poll_armed, sn);
+            SOCK_BIT_SET(sock_poll_level, sn);
+         }
+         if((sir | sock_poll_level) & (1<<sn))
+         {
+            fds[i].revents = wiz_poll_socket(sn, fds[i].events);
+            seen |= (1<<sn);
+         }
+         else fds[i].revents = wiz_poll_held(sn, fds[i].events);
+         if(fds[i].revents) count++;
+      }
+      // the other sockets of wiz_poll() are released too, or INTn would stay low
+      for(sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++)
+      {
+         if((sir & sock_poll_armed & ~seen) & (1<<sn)) wiz_poll_socket(sn, 0);
+      }
+      // and SLIR, the command's callback is called from here
+      wizchip_sl_poll();
+      if(count || (timeout_ms == 0) || !sock_poll_ms) return count;
+      elapsed = sock_poll_ms() - start;
+      if((timeout_ms > 0) && (elapsed >= (uint32_t)timeout_ms)) return 0;
+      // without the wait IR is read again right away
+      if(sock_poll_wait) sock_poll_wait((timeout_ms > 0) ? ((uint32_t)timeout_ms - elapsed) : WIZ_POLL_WAIT_FOREVER);
+   }
+}
+#endif
@@ -236,6 +236,10 @@ int8_t  disconnect(uint8_t sn);
  * @note    It is valid only in TCP server or client mode. It can't send data greater than socket buffer size. \n
  *          In block io mode, It doesn't return until data send is completed - socket buffer size is greater than data. \n
  *          In non-block io mode, It return @ref SOCK_BUSY immediately when socket buffer is not enough. \n
+ *          In @ref SOCK_SEND_STREAM mode (W5100S only, refer to @ref CS_SET_SENDMODE), the data is queued in the free
+ *          TX buffer even while the previous SEND command is in progress, and is handed to the chip by the first call seeing
+ *          SENDOK. It returns the queued size, which can be less than len. \n
+ *          With len 0 it only does that hand over, and returns @ref SOCK_OK once nothing is left queued. \n
  * @param sn Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
  * @param buf Pointer buffer containing data to be sent.
  * @param len The byte length of data in buf.
@@ -271,6 +275,74 @@ int32_t send(uint8_t sn, uint8_t * buf, uint16_t len);
  */
 int32_t recv(uint8_t sn, uint8_t * buf, uint16_t len);
 
+#if (_WIZCHIP_ == W5100S) || (_WIZCHIP_ == W5500)
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief	Read received data without consuming it.
+ * @details Copies the data from <I>offset</I> bytes past @ref Sn_RX_RD, which is left as it is. The data stays in the
+ *          RX buffer until recv_commit(), a parser can look at a header first and then read or commit exactly its length.
+ * @note    It is valid only in TCP server or client mode. \n
+ *          In block io mode, it waits for data past <I>offset</I>. In non-block io mode, it returns @ref SOCK_BUSY when there is none. \n
+ *          In @ref SOCK_CLOSE_WAIT with nothing past <I>offset</I> it returns @ref SOCKERR_SOCKSTATUS and leaves the socket open. \n
+ *          Only in W5100S and W5500.
+ *
+ * @param sn  Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param buf Pointer buffer to read incoming data.
+ * @param len The max data length of data in buf.
+ * @param offset Bytes of the received data to skip, not committed yet.
+ * @return	@b Success : The copied data size, less than <I>len</I> when less is received \n
+ *          @b Fail    :\n
+ *                     @ref SOCKERR_SOCKSTATUS - Invalid socket status for socket operation \n
+ *                     @ref SOCKERR_SOCKMODE   - Invalid operation in the socket \n
+ *                     @ref SOCKERR_SOCKNUM    - Invalid socket number \n
+ *                     @ref SOCKERR_DATALEN    - zero data length \n
+ *                     @ref SOCK_BUSY          - No data past offset.
+ */
+int32_t recv_peek(uint8_t sn, uint8_t * buf, uint16_t len, uint16_t offset);
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief	Consume received data looked at with recv_peek().
+ * @details Moves @ref Sn_RX_RD over <I>len</I> bytes and gives their space back to the peer with one @ref Sn_CR_RECV. Only in W5100S and W5500.
+ *
+ * @param sn  Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param len The data length to consume.
+ * @return	@b Success : <I>len</I> \n
+ *          @b Fail    :\n
+ *                     @ref SOCKERR_SOCKMODE   - Invalid operation in the socket \n
+ *                     @ref SOCKERR_SOCKNUM    - Invalid socket number \n
+ *                     @ref SOCKERR_DATALEN    - zero data length or more than received.
+ */
+int32_t recv_commit(uint8_t sn, uint16_t len);
+
+#ifndef WIZ_SPLICE_CHUNK
+#define WIZ_SPLICE_CHUNK      512   ///< Bytes of a wiz_splice() burst, the RAM it takes
+#endif
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief	Move received data of a socket to the TX buffer of another, like a recv() and send() without a buffer of the application.
+ * @details Copies as much as <I>max</I>, the data received by <I>sn_in</I> and the free TX buffer of <I>sn_out</I> allow, in
+ *          @ref WIZ_SPLICE_CHUNK bursts. It ends with one @ref Sn_CR_RECV on <I>sn_in</I> and one @ref Sn_CR_SEND on <I>sn_out</I>.
+ *          The next send() or wiz_splice() on <I>sn_out</I> waits for its SENDOK.
+ * @note    It is valid only between two connected TCP sockets. It doesn't wait, whatever the io mode. \n
+ *          <I>sn_out</I> can't be in @ref SOCK_SEND_STREAM mode. Only in W5100S and W5500.
+ *
+ * @param sn_in  Socket number to receive from. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param sn_out Socket number to send to. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param max The max data length to move.
+ * @return	@b Success : The moved data size \n
+ *          @b Fail    :\n
+ *                     @ref SOCKERR_SOCKSTATUS - <I>sn_out</I> isn't connected, or <I>sn_in</I> has nothing left and isn't connected \n
+ *                     @ref SOCKERR_SOCKMODE   - Invalid operation in the socket \n
+ *                     @ref SOCKERR_SOCKNUM    - Invalid socket number, or the same one twice \n
+ *                     @ref SOCKERR_TIMEOUT    - The last SEND of <I>sn_out</I> timed out, it is closed \n
+ *                     @ref SOCKERR_DATALEN    - zero data length \n
+ *                     @ref SOCK_BUSY          - Nothing received, no free TX buffer or the last SEND in progress.
+ */
+int32_t wiz_splice(uint8_t sn_in, uint8_t sn_out, uint16_t max);
+#endif
+
 /**
  * @ingroup WIZnet_socket_APIs
  * @brief	Sends datagram to the peer with destination IP address and port number passed as parameter.
@@ -329,12 +401,73 @@ int32_t sendto(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t
  */
 int32_t recvfrom(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t *port);
 
+#if _WIZCHIP_ != 5300
+/**
+ * @ingroup DATA_TYPE
+ * @brief A datagram of @ref sendto_multi() and @ref recvfrom_multi()
+ */
+typedef struct wiz_Datagram_t
+{
+   uint8_t* buf;       ///< Data to send, or buffer to receive in
+   uint16_t len;       ///< Length of the data to send, or size of buf, set to the received length by recvfrom_multi()
+   uint8_t  addr[4];   ///< Destination IP address, or the peer's one
+   uint16_t port;      ///< Destination port number, or the peer's one
+}wiz_Datagram;
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief	Sends several UDP datagrams, as sendmmsg()
+ * @details Like @ref sendto() for each datagram, but @ref Sn_DIPR and @ref Sn_DPORT are written only when the destination
+ *          differs from the previous datagram's, and the free size of the SOCKET buffer is checked only for the first one.
+ *          A datagram longer than the SOCKET buffer is cut as by sendto().
+ * @note    In block io mode, It doesn't return until the datagrams are sent.
+ *          In non-block io mode, It return @ref SOCK_BUSY immediately when socket buffer is not enough for the first one.
+ *
+ * @param sn    Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param dgs   Datagrams to send
+ * @param count Number of datagrams in dgs
+ *
+ * @return @b Success : The number of datagrams sent. When a datagram fails after the first, those before it are reported
+ *                      and the error is returned by the next call. \n
+ *         @b Fail    : The errors of @ref sendto() for the first datagram
+ */
+int32_t sendto_multi(uint8_t sn, wiz_Datagram* dgs, uint8_t count);
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief	Receives the UDP datagrams in the SOCKET buffer, as recvmmsg()
+ * @details Reads up to count datagrams and gives the space back to the chip with one RECV command, where
+ *          @ref recvfrom() issues one per datagram. The rest of a datagram larger than its buf is dropped.
+ *          A datagram partly read by @ref recvfrom() must be finished with recvfrom() first.
+ * @note    In block io mode, it doesn't return until a datagram is received.
+ *          In non-block io mode, it return @ref SOCK_BUSY immediately when the socket buffer is empty.
+ *
+ * @param sn    Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param dgs   Datagrams to receive, buf and len set by the caller
+ * @param count Number of datagrams in dgs
+ *
+ * @return @b Success : The number of datagrams received \n
+ *         @b Fail    : @ref SOCKERR_DATALEN    - zero count \n
+ *                      @ref SOCKERR_SOCKMODE   - Not a UDP socket \n
+ *                      @ref SOCKERR_SOCKSTATUS - A datagram partly read by recvfrom() \n
+ *                      @ref SOCKERR_SOCKCLOSED - Socket unexpectedly closed \n
+ *                      @ref SOCK_BUSY          - Socket is busy.
+ */
+int32_t recvfrom_multi(uint8_t sn, wiz_Datagram* dgs, uint8_t count);
+#endif
+
 
 /////////////////////////////
 // SOCKET CONTROL & OPTION //
 /////////////////////////////
 #define SOCK_IO_BLOCK         0  ///< Socket Block IO Mode in @ref setsockopt().
 #define SOCK_IO_NONBLOCK      1  ///< Socket Non-block IO Mode in @ref setsockopt().
+#define SOCK_CMD_SYNC         0  ///< Every command waits until the chip has processed it. Refer to @ref CS_SET_CMDMODE.
+#define SOCK_CMD_ASYNC        1  ///< Commands are posted, their completion is checked by the next call on the socket. Refer to @ref CS_SET_CMDMODE.
+#if _WIZCHIP_ == W5100S
+#define SOCK_SEND_ONESHOT     0  ///< One SEND command at a time, send() waits for SENDOK before writing more. Refer to @ref CS_SET_SENDMODE.
+#define SOCK_SEND_STREAM      1  ///< send() queues data behind the SEND command in progress. Refer to @ref CS_SET_SENDMODE.
+#endif
 
 /**
  * @defgroup DATA_TYPE DATA TYPE
@@ -369,9 +502,15 @@ typedef enum
    CS_GET_MAXRXBUF,        ///< get the size of socket buffer allocated in RX memory
    CS_CLR_INTERRUPT,       ///< clear the interrupt of socket with @ref sockint_kind
    CS_GET_INTERRUPT,       ///< get the socket interrupt. refer to @ref sockint_kind
+   CS_SET_CMDMODE,         ///< set socket command mode with @ref SOCK_CMD_SYNC or @ref SOCK_CMD_ASYNC
+   CS_GET_CMDMODE,         ///< get socket command mode
 #if _WIZCHIP_ > 5100
    CS_SET_INTMASK,         ///< set the interrupt mask of socket with @ref sockint_kind, Not supported in W5100
-   CS_GET_INTMASK          ///< get the masked interrupt of socket. refer to @ref sockint_kind, Not supported in W5100
+   CS_GET_INTMASK,         ///< get the masked interrupt of socket. refer to @ref sockint_kind, Not supported in W5100
+#endif
+#if _WIZCHIP_ == W5100S
+   CS_SET_SENDMODE,        ///< set TCP send mode with @ref SOCK_SEND_ONESHOT or @ref SOCK_SEND_STREAM, Only in W5100S
+   CS_GET_SENDMODE         ///< get TCP send mode, Only in W5100S
 #endif
 }ctlsock_type;
 
@@ -398,9 +537,32 @@ typedef enum
    SO_RECVBUF,          ///< Valid only in getsockopt. Get the received data size in socket RX buffer. @ref Sn_RX_RSR, @ref getSn_RX_RSR()
    SO_STATUS,           ///< Valid only in getsockopt. Get the socket status. @ref Sn_SR, @ref getSn_SR()
    SO_REMAINSIZE,       ///< Valid only in getsockopt. Get the remained packet size in other then TCP mode.
-   SO_PACKINFO          ///< Valid only in getsockopt. Get the packet information as @ref PACK_FIRST, @ref PACK_REMAINED, and @ref PACK_COMPLETED in other then TCP mode.
+   SO_PACKINFO,         ///< Valid only in getsockopt. Get the packet information as @ref PACK_FIRST, @ref PACK_REMAINED, and @ref PACK_COMPLETED in other then TCP mode.
+   SO_PROFILE           ///< Set/Get the TCP tuning of the socket, @ref wiz_SockProfile. It's kept over socket() and close().
 }sockopt_type;
 
+/**
+ * @ingroup DATA_TYPE
+ * @brief TCP tuning of a socket, @ref SO_PROFILE
+ * @details Applied by socket() and, when the socket is open, by setsockopt() too, except @b nodelay, which is
+ *          a bit of @ref Sn_MR and waits for the next socket(). The zero values leave the chip's defaults.
+ *          The W5100S has per-socket @ref Sn_RTR and @ref Sn_RCR. The other chips have the common RTR and RCR only, they are
+ *          rewritten before the CONNECT, SEND, SEND_KEEP and DISCON of a socket when they differ from what it needs, and
+ *          restored to the values they had at the first SO_PROFILE for the sockets without one. On those chips a
+ *          retransmission of one socket may run with the values of another, and wizchip_settimeout() should be called before.
+ */
+typedef struct wiz_SockProfile_t
+{
+   uint8_t  nodelay;     ///< 1 for @ref Sn_MR_ND, ACKs sent at once rather than delayed, as @ref SF_TCP_NODELAY
+   uint16_t mss;         ///< @ref Sn_MSSR, 0 for the default
+   uint16_t rtr;         ///< Retransmission time in 100us, 0 for the one of wizchip_settimeout() and rcr ignored
+   uint8_t  rcr;         ///< Retransmission count, with rtr
+   uint8_t  keepalive;   ///< Keep-alive interval in 5s, as @ref SO_KEEPALIVEAUTO, 0 for none. Not in W5100, W5200
+}wiz_SockProfile;
+
+#define SOCK_PROFILE_DEFAULT       {0, 0, 0, 0, 0}      ///< The chip's defaults, as without @ref SO_PROFILE
+#define SOCK_PROFILE_LOW_LATENCY   {1, 0, 100, 8, 0}    ///< No delayed ACK, 10ms first retransmission, for peers on the LAN
+
 /**
  * @ingroup WIZnet_socket_APIs
  *  @brief Control socket.
@@ -414,9 +576,16 @@ typedef enum
  *                  <tr> <td> @ref CS_SET_IOMODE \n @ref CS_GET_IOMODE </td> <td> uint8_t </td><td>@ref SOCK_IO_BLOCK @ref SOCK_IO_NONBLOCK</td></tr>
  *                  <tr> <td> @ref CS_GET_MAXTXBUF \n @ref CS_GET_MAXRXBUF </td> <td> uint16_t </td><td> 0 ~ 16K </td></tr>
  *                  <tr> <td> @ref CS_CLR_INTERRUPT \n @ref CS_GET_INTERRUPT \n @ref CS_SET_INTMASK \n @ref CS_GET_INTMASK </td> <td> @ref sockint_kind </td><td> @ref SIK_CONNECTED, etc.  </td></tr> 
+ *                  <tr> <td> @ref CS_SET_CMDMODE \n @ref CS_GET_CMDMODE </td> <td> uint8_t </td><td>@ref SOCK_CMD_SYNC @ref SOCK_CMD_ASYNC</td></tr>
+ *                  <tr> <td> @ref CS_SET_SENDMODE \n @ref CS_GET_SENDMODE </td> <td> uint8_t </td><td>@ref SOCK_SEND_ONESHOT @ref SOCK_SEND_STREAM</td></tr>
  *             </table>
+ *           In @ref SOCK_CMD_ASYNC mode the SEND, RECV, OPEN, CONNECT and DISCON commands of the socket functions aren't
+ *           waited for. Sn_CR is read back right before the next call on the socket.
+ *           LISTEN and CLOSE are still waited for, their result is read right away. The mode is kept across close() and socket().
+ *           Registers read directly, as getSn_RX_RSR(), may be stale until the next call on the socket, use getsockopt() for them.
  *  @return @b Success @ref SOCK_OK \n
  *          @b fail    @ref SOCKERR_ARG         - Invalid argument\n
+ *                     @ref SOCK_BUSY           - @ref CS_SET_SENDMODE to @ref SOCK_SEND_ONESHOT with data still queued, flush it with send() of length 0\n
  */
 int8_t  ctlsocket(uint8_t sn, ctlsock_type cstype, void* arg);
 
@@ -437,6 +606,7 @@ int8_t  ctlsocket(uint8_t sn, ctlsock_type cstype, void* arg);
  *                  <tr> <td> @ref SO_DESTPORT </td> <td> uint16_t </td><td> 0 ~ 65535 </td></tr> 
  *                  <tr> <td> @ref SO_KEEPALIVESEND </td> <td> null </td><td> null </td></tr> 
  *                  <tr> <td> @ref SO_KEEPALIVEAUTO </td> <td> uint8_t </td><td> 0 ~ 255 </td></tr> 
+ *                  <tr> <td> @ref SO_PROFILE </td> <td> @ref wiz_SockProfile </td><td> @ref SOCK_PROFILE_LOW_LATENCY, etc. </td></tr> 
  *             </table>
  * @return 
  * - @b Success : @ref SOCK_OK \n
@@ -468,6 +638,7 @@ int8_t  setsockopt(uint8_t sn, sockopt_type sotype, void* arg);
  *                  <tr> <td> @ref SO_STATUS </td> <td> uint8_t </td><td> @ref SOCK_ESTABLISHED, etc.. </td></tr>  
  *                  <tr> <td> @ref SO_REMAINSIZE </td> <td> uint16_t </td><td> 0~ 65535 </td></tr>
  *                  <tr> <td> @ref SO_PACKINFO </td> <td> uint8_t </td><td> @ref PACK_FIRST, etc... </td></tr>
+ *                  <tr> <td> @ref SO_PROFILE </td> <td> @ref wiz_SockProfile </td><td>  </td></tr>
  *             </table>
  * @return 
  * - @b Success : @ref SOCK_OK \n
@@ -482,6 +653,116 @@ int8_t  setsockopt(uint8_t sn, sockopt_type sotype, void* arg);
   */
 int8_t  getsockopt(uint8_t sn, sockopt_type sotype, void* arg);
 
+#if _WIZCHIP_ == W5100S
+//////////////////
+// SOCKET EVENT //
+//////////////////
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief Register the event callback of a socket.
+ * @details Enables the interrupts in @b events (@ref sockint_kind) of the socket on the INTn pin,
+ *          and has sockevent_dispatch() call @b cb with the ones that occurred.
+ *          A NULL @b cb or zero @b events disables them. Only in W5100S.
+ * @param sn Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param events Interrupts to report, @ref SIK_CONNECTED, @ref SIK_RECEIVED, etc.
+ * @param cb Callback, called in the context of sockevent_dispatch()
+ * @return @b Success : @ref SOCK_OK \n
+ *         @b Fail    : @ref SOCKERR_SOCKNUM - Invalid socket number \n
+ *                      @ref SOCKERR_ARG     - Invalid events
+ */
+int8_t  reg_sockevent_cbfunc(uint8_t sn, uint8_t events, void (*cb)(uint8_t sn, uint8_t events));
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief Clear interrupts of a socket.
+ * @details Like setSn_IR(), and gives the bits held by sockevent_dispatch() or wiz_poll() back to INTn.
+ *          The socket APIs use it, code checking those bits itself should too. Only in W5100S, setSn_IR() on the other chips.
+ * @param sn Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param events Interrupts to clear, refer to @ref Sn_IR
+ */
+void    sockevent_clear(uint8_t sn, uint8_t events);
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief Note that INTn was asserted.
+ * @details Call it from the interrupt handler of the pin INTn is wired to (falling edge).
+ *          It only sets a flag, the chip is accessed by sockevent_dispatch(). Only in W5100S.
+ */
+void    sockevent_isr(void);
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief Check for events to dispatch.
+ * @return 1 when sockevent_isr() was called since the last sockevent_dispatch(), 0 otherwise
+ */
+uint8_t sockevent_pending(void);
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief Read the socket interrupts and call the registered callbacks.
+ * @details Reads @ref IR, then @ref Sn_IR of the flagged sockets only, until no registered interrupt is left
+ *          and INTn is released. The reported bits are cleared, except @ref Sn_IR_SENDOK and @ref Sn_IR_TIMEOUT, which
+ *          send(), connect(), close() etc. still have to see. Those are masked until cleared with sockevent_clear().
+ *          A socket-less command of wizchip_sl_start() is completed first, with wizchip_sl_poll().
+ *          Call it from thread context, not from the interrupt handler. Only in W5100S.
+ * @return The number of callbacks called
+ */
+int8_t  sockevent_dispatch(void);
+
+/////////////////
+// SOCKET POLL //
+/////////////////
+#define WIZ_POLLIN      0x01   ///< Data to read, or connected (@ref Sn_IR_CON until sockevent_clear())
+#define WIZ_POLLOUT     0x04   ///< The last SEND is done (@ref Sn_IR_SENDOK until the next send())
+#define WIZ_POLLERR     0x08   ///< @ref Sn_IR_TIMEOUT until cleared, reported without being requested
+#define WIZ_POLLHUP     0x10   ///< @ref SOCK_CLOSED, @ref SOCK_INIT or @ref SOCK_CLOSE_WAIT, reported without being requested
+#define WIZ_POLLNVAL    0x20   ///< Invalid socket number, or a socket with an event callback
+
+#define WIZ_POLL_WAIT_FOREVER 0xFFFFFFFF   ///< Timeout passed to the wait callback of wiz_poll() with a negative timeout
+
+/**
+ * @ingroup DATA_TYPE
+ * @brief A socket to wait for with wiz_poll()
+ */
+typedef struct wiz_pollfd
+{
+   uint8_t sn;        ///< Socket number
+   uint8_t events;    ///< Requested, @ref WIZ_POLLIN and/or @ref WIZ_POLLOUT
+   uint8_t revents;   ///< Returned, the requested ones that are ready and the ones always reported
+}wiz_pollfd;
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief Register the clock and the wait of wiz_poll().
+ * @details @b ms returns a millisecond count, without it wiz_poll() doesn't wait. @b wait returns after
+ *          @b timeout_ms or earlier, when sockevent_isr() was called. Without it wiz_poll() reads @ref IR
+ *          again right away. Only in W5100S.
+ * @param ms Millisecond clock
+ * @param wait Wait for INTn, NULL to poll the chip
+ */
+void    reg_wizpoll_cbfunc(uint32_t (*ms)(void), void (*wait)(uint32_t timeout_ms));
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief Wait for sockets to be ready, like poll().
+ * @details Reads @ref IR once, then the registers of the flagged sockets only, with one snapshot each. Sockets
+ *          with data left or waiting for the application in @ref WIZ_POLLHUP states are read on every call, the
+ *          others cost nothing until their next interrupt. The sockets are given the interrupts of the chip on
+ *          their first call, do not mix it with reg_sockevent_cbfunc() on a socket.
+ *          @ref Sn_IR_CON is held until the application clears it with sockevent_clear(), like
+ *          @ref Sn_IR_SENDOK and @ref Sn_IR_TIMEOUT by the socket APIs. A socket-less command of
+ *          wizchip_sl_start() is completed on every pass, with wizchip_sl_poll(). Only in W5100S.
+ * @param fds Sockets and requested events
+ * @param nfds Number of fds
+ * @param timeout_ms 0 to return at once, negative to wait until a socket is ready
+ * @return The number of fds with revents, 0 on timeout
+ */
+int16_t wiz_poll(wiz_pollfd* fds, uint8_t nfds, int32_t timeout_ms);
+#else
+// no interrupts held on the other chips
+#define sockevent_clear(sn, events)    setSn_IR(sn, events)
+#endif
+
 #ifdef __cplusplus
  }
 #endif
@@ -51,6 +51,7 @@
 //A20140501 : for use the type - ptrdiff_t
 #include <stddef.h>
 //
+#include <string.h>
 
 #include "wizchip_conf.h"
 
@@ -162,7 +163,13 @@ _WIZCHIP  WIZCHIP =
 //    .IF.SPI._write_byte  = wizchip_spi_writebyte
       };
 */      
-_WIZCHIP  WIZCHIP =
+#if _WIZCHIP_INSTANCES_ > 1
+   #define WIZCHIP_DEFAULT   wizchip_default
+#else
+   #define WIZCHIP_DEFAULT   WIZCHIP
+#endif
+
+_WIZCHIP  WIZCHIP_DEFAULT =
 {
     _WIZCHIP_IO_MODE_,
     _WIZCHIP_ID_ ,
@@ -187,8 +194,45 @@ _WIZCHIP  WIZCHIP =
 };
 
 
-static uint8_t    _DNS_[4];      // DNS server ip address
-static dhcp_mode  _DHCP_;        // DHCP mode
+#if _WIZCHIP_INSTANCES_ > 1
+_WIZCHIP* wizchip_cur = &wizchip_default;
+static uint8_t wizchip_instances = 1;
+static _WIZCHIP* wizchip_async_chip = &wizchip_default;   // of the burst in flight, its interrupt may come while another is selected
+#else
+   #define wizchip_async_chip   (&WIZCHIP)
+#endif
+
+static uint8_t    wizchip_dns[_WIZCHIP_INSTANCES_][4];    // DNS server ip address
+static dhcp_mode  wizchip_dhcp[_WIZCHIP_INSTANCES_];      // DHCP mode
+#define _DNS_     (wizchip_dns[WIZCHIP_INST])
+#define _DHCP_    (wizchip_dhcp[WIZCHIP_INST])
+
+#if _WIZCHIP_ == W5100S
+// identifier of the echo requests of wizchip_sl_start()
+#define WIZCHIP_SL_PING_ID    0x5753
+
+typedef struct
+{
+   uint8_t  busy;          // started, SLIR not seen complete yet
+   uint8_t  cmd;
+   uint16_t seq;
+   uint32_t start_us;
+   void (*done)(wiz_SLResult* res, void* arg);
+   void* arg;
+   uint8_t  set;           // the registers below hold what was written last, cleared by a reset
+   uint8_t  ip[4];         // SLPIPR
+   uint16_t rtr;           // SLRTR
+   uint8_t  rcr;           // SLRCR
+} wiz_SLState;
+
+static wiz_SLState wizchip_sl[_WIZCHIP_INSTANCES_];
+#define _SL_      (wizchip_sl[WIZCHIP_INST])
+
+// one INTn and one clock for the instances, as sockevent_isr()
+static uint32_t (*wizchip_sl_us)(void) = 0;
+static volatile uint8_t  wizchip_sl_edge = 0;
+static volatile uint32_t wizchip_sl_edge_us;
+#endif
 
 void reg_wizchip_cris_cbfunc(void(*cris_en)(void), void(*cris_ex)(void))
 {
@@ -248,6 +292,15 @@ void reg_wizchip_bus_cbfunc(iodata_t(*bus_rb)(uint32_t addr), void (*bus_wb)(uin
    }
 }
 
+void reg_wizchip_busbuf_cbfunc(void (*bus_rb)(uint32_t addr, iodata_t* pBuf, uint16_t len), void (*bus_wb)(uint32_t addr, iodata_t* pBuf, uint16_t len))
+{
+   while(!(WIZCHIP.if_mode & _WIZCHIP_IO_MODE_BUS_));
+
+   // NULL goes back to one bus access per data
+   WIZCHIP.IF.BUS._read_data_buf   = bus_rb;
+   WIZCHIP.IF.BUS._write_data_buf  = bus_wb;
+}
+
 void reg_wizchip_spi_cbfunc(uint8_t (*spi_rb)(void), void (*spi_wb)(uint8_t wb))
 {
    while(!(WIZCHIP.if_mode & _WIZCHIP_IO_MODE_SPI_));
@@ -281,6 +334,122 @@ void reg_wizchip_spiburst_cbfunc(void (*spi_rb)(uint8_t* pBuf, uint16_t len), vo
    }
 }
 
+void reg_wizchip_spiburst_vec_cbfunc(void (*spi_rb)(wiz_iovec* wr, wiz_iovec* rd), void (*spi_wb)(wiz_iovec* iov, uint8_t iovcnt))
+{
+   while(!(WIZCHIP.if_mode & _WIZCHIP_IO_MODE_SPI_));
+
+   // NULL goes back to separate header and data bursts
+   WIZCHIP.IF.SPI._read_burst_vec   = spi_rb;
+   WIZCHIP.IF.SPI._write_burst_vec  = spi_wb;
+}
+
+#if _WIZCHIP_INSTANCES_ > 1
+int8_t wizchip_instance_init(wizchip_t* chip)
+{
+   uint8_t inst;
+
+   WIZCHIP_CRITICAL_ENTER();
+   if(wizchip_instances >= _WIZCHIP_INSTANCES_)
+   {
+      WIZCHIP_CRITICAL_EXIT();
+      return -1;
+   }
+   inst = wizchip_instances++;
+   WIZCHIP_CRITICAL_EXIT();
+
+   // the callbacks registered so far, the ones that differ are registered after wizchip_use()
+   *chip = wizchip_default;
+   chip->ASYNC._busy = 0;
+   chip->ASYNC._done = 0;
+   chip->ASYNC._arg  = 0;
+   chip->inst = inst;
+   return 0;
+}
+
+wizchip_t* wizchip_use(wizchip_t* chip)
+{
+   wizchip_t* prev = wizchip_cur;
+
+   wizchip_cur = chip ? chip : &wizchip_default;
+   return prev;
+}
+#endif
+
+void reg_wizchip_spiburst_wrap_cbfunc(void (*spi_rb)(wiz_iovec* wr, wiz_iovec* rd), void (*spi_wb)(wiz_iovec* iov))
+{
+   while(!(WIZCHIP.if_mode & _WIZCHIP_IO_MODE_SPI_));
+
+   // NULL goes back to one WIZCHIP_READ_BUF()/WIZCHIP_WRITE_BUF() per burst
+   WIZCHIP.IF.SPI._read_burst_wrap   = spi_rb;
+   WIZCHIP.IF.SPI._write_burst_wrap  = spi_wb;
+}
+
+void reg_wizchip_spireg_cbfunc(uint8_t (*spi_reg)(uint8_t* frame))
+{
+   while(!(WIZCHIP.if_mode & _WIZCHIP_IO_MODE_SPI_));
+
+   // NULL goes back to the byte or burst callbacks
+   WIZCHIP.IF.SPI._xfer_reg  = spi_reg;
+}
+
+void reg_wizchip_spiburst_async_cbfunc(void (*spi_rb)(uint8_t* pBuf, uint16_t len), void (*spi_wb)(uint8_t* pBuf, uint16_t len))
+{
+   while(!(WIZCHIP.if_mode & _WIZCHIP_IO_MODE_SPI_));
+
+   wizchip_spiburst_async_wait();
+
+   // NULL leaves the asynchronous functions on the blocking path
+   WIZCHIP.IF.SPI._read_burst_async   = spi_rb;
+   WIZCHIP.IF.SPI._write_burst_async  = spi_wb;
+}
+
+void wizchip_spiburst_async_begin(void (*done)(void* arg), void* arg)
+{
+   WIZCHIP.ASYNC._done = done;
+   WIZCHIP.ASYNC._arg  = arg;
+   WIZCHIP.ASYNC._busy = 1;
+#if _WIZCHIP_INSTANCES_ > 1
+   wizchip_async_chip = wizchip_cur;
+#endif
+}
+
+void wizchip_spiburst_async_done(void)
+{
+   _WIZCHIP* chip = wizchip_async_chip;
+   void (*done)(void* arg) = chip->ASYNC._done;
+   void* arg = chip->ASYNC._arg;
+#if _WIZCHIP_INSTANCES_ > 1
+   // the chip of the burst for its chip select and done, the interrupted code gets its own back
+   _WIZCHIP* prev = wizchip_use(chip);
+#endif
+
+   chip->CS._deselect();
+   chip->ASYNC._busy = 0;
+
+   if(done) done(arg);
+#if _WIZCHIP_INSTANCES_ > 1
+   wizchip_use(prev);
+#endif
+}
+
+uint8_t wizchip_spiburst_async_busy(void)
+{
+   // the instances share the platform's burst engine, one burst is in flight for all of them
+   return wizchip_async_chip->ASYNC._busy;
+}
+
+void wizchip_spiburst_async_wait(void)
+{
+   while(WIZCHIP.ASYNC._busy);
+}
+
+uint8_t wizchip_spiburst_async_enabled(void)
+{
+   if(!(WIZCHIP.if_mode & _WIZCHIP_IO_MODE_SPI_)) return 0;
+   // same condition as WIZCHIP_READ_BUF_ASYNC() and WIZCHIP_WRITE_BUF_ASYNC()
+   return (WIZCHIP.IF.SPI._read_burst_async && WIZCHIP.IF.SPI._write_burst_async && WIZCHIP.IF.SPI._write_burst) ? 1 : 0;
+}
+
 int8_t ctlwizchip(ctlwizchip_type cwtype, void* arg)
 {
 #if	_WIZCHIP_ == W5100S || _WIZCHIP_ == W5200 || _WIZCHIP_ == W5500
@@ -299,6 +468,10 @@ int8_t ctlwizchip(ctlwizchip_type cwtype, void* arg)
             ptmp[1] = ptmp[0] + _WIZCHIP_SOCK_NUM_;
          }
          return wizchip_init(ptmp[0], ptmp[1]);
+   #if _WIZCHIP_ < W5200
+      case CW_INIT_WIZCHIP_PROFILE:
+         return wizchip_init_profile((wiz_BufProfile*)arg);
+   #endif
       case CW_CLR_INTERRUPT:
          wizchip_clrinterrupt(*((intr_kind*)arg));
          break;
@@ -320,6 +493,14 @@ int8_t ctlwizchip(ctlwizchip_type cwtype, void* arg)
       case CW_GET_INTRTIME:
          *(uint16_t*)arg = getINTLEVEL();
          break;
+   #elif _WIZCHIP_ == W5100S
+      // the W5100S holds INTn off for INTPTMR after IR is cleared
+      case CW_SET_INTRTIME:
+         setINTPTMR(*(uint16_t*)arg);
+         break;
+      case CW_GET_INTRTIME:
+         *(uint16_t*)arg = getINTPTMR();
+         break;
    #endif
       case CW_GET_ID:
          ((uint8_t*)arg)[0] = WIZCHIP.id[0];
@@ -401,6 +582,10 @@ void wizchip_sw_reset(void)
    uint16_t mr = (uint16_t)getMR();
    setMR(mr | MR_IND);
 #endif
+#if (_WIZCHIP_ == W5100S) && (_WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_)
+   // every access writes the address first, auto-increment stays on for the buffers
+   mr |= MR_AI;
+#endif
 //
    getSHAR(mac);
    getGAR(gw);  getSUBR(sn);  getSIPR(sip);
@@ -415,6 +600,12 @@ void wizchip_sw_reset(void)
    setGAR(gw);
    setSUBR(sn);
    setSIPR(sip);
+#if _WIZCHIP_ == W5100S
+   wiz_sn_buf_invalidate(); // reset puts TMSR and RMSR back to 2KB per socket
+   // and the socket-less registers to 0, a command in flight is gone
+   _SL_.busy = 0;
+   _SL_.set  = 0;
+#endif
 }
 
 int8_t wizchip_init(uint8_t* txsize, uint8_t* rxsize)
@@ -496,8 +687,71 @@ int8_t wizchip_init(uint8_t* txsize, uint8_t* rxsize)
 		}
 	#endif
    }
+#if _WIZCHIP_ == W5100S
+   wiz_sn_buf_update(); // socket buffer base/size table for the data path
+#endif
+   return 0;
+}
+
+#if _WIZCHIP_ < W5200
+static int8_t wizchip_profile_check(uint8_t* size)
+{
+   int8_t i;
+   uint8_t tmp = 0;
+
+   for(i = 0 ; i < _WIZCHIP_SOCK_NUM_; i++)
+   {
+      if(size[i] & (size[i] - 1)) return -1;   // 0, 1, 2, 4 or 8KB
+      // 0KB is written as 1KB, it must lie beyond the 8KB of the SOCKETs below
+      if(size[i] == 0 && tmp < 8) return -1;
+      tmp += size[i];
+      if(tmp > 8) return -1;
+   }
+   return 0;
+}
+
+int8_t wizchip_init_profile(wiz_BufProfile* profile)
+{
+   int8_t i, j;
+   uint8_t txsize[_WIZCHIP_SOCK_NUM_];
+   uint8_t rxsize[_WIZCHIP_SOCK_NUM_];
+
+   for(i = 0 ; i < _WIZCHIP_SOCK_NUM_; i++)
+   {
+      switch(profile->profile)
+      {
+         case BUF_BALANCED:
+            txsize[i] = rxsize[i] = 8 / _WIZCHIP_SOCK_NUM_;
+            break;
+         case BUF_ONE_FAT:
+            txsize[i] = rxsize[i] = (i == 0) ? 8 : 0;
+            break;
+         case BUF_CUSTOM:
+            txsize[i] = profile->txsize[i];
+            rxsize[i] = profile->rxsize[i];
+            break;
+         default:
+            return -1;
+      }
+   }
+   if(wizchip_profile_check(txsize) || wizchip_profile_check(rxsize)) return -1;
+
+   // the buffers of open SOCKETs would move under them
+   for(i = 0 ; i < _WIZCHIP_SOCK_NUM_; i++)
+      if(getSn_SR(i) != SOCK_CLOSED) return -1;
+
+   for(i = 0 ; i < _WIZCHIP_SOCK_NUM_; i++)
+   {
+      j = 0;
+      while(txsize[i] >> j > 1) j++;
+      setSn_TXBUF_SIZE(i, j);
+      j = 0;
+      while(rxsize[i] >> j > 1) j++;
+      setSn_RXBUF_SIZE(i, j);
+   }
    return 0;
 }
+#endif
 
 void wizchip_clrinterrupt(intr_kind intr)
 {
@@ -907,3 +1161,95 @@ void wizchip_gettimeout(wiz_NetTimeout* nettime)
    nettime->retry_cnt = getRCR();
    nettime->time_100us = getRTR();
 }
+
+#if _WIZCHIP_ == W5100S
+void reg_wizchip_sl_cbfunc(uint32_t (*us)(void))
+{
+   wizchip_sl_us = us;
+}
+
+int8_t wizchip_sl_start(uint8_t cmd, uint8_t* ip, uint16_t time_100us, uint8_t retry_cnt, void (*done)(wiz_SLResult* res, void* arg), void* arg)
+{
+   if((cmd != SLCMD_ARP) && (cmd != SLCMD_PING)) return -2;
+   // a command nobody polled may be over already
+   if(_SL_.busy) wizchip_sl_poll();
+   if(_SL_.busy) return -1;
+
+   if(!_SL_.set)
+   {
+      // SLIR raises INTn with the socket interrupts, the global enable is kept by sockevent_arm()
+      setSLIMR(SLIR_TIMEOUT | SLIR_ARP | SLIR_PING);
+      setMR2(getMR2() | MR2_G_IEN);
+      setPINGIDR(WIZCHIP_SL_PING_ID);
+   }
+   if(!_SL_.set || memcmp(_SL_.ip, ip, 4))
+   {
+      setSLPIPR(ip);
+      memcpy(_SL_.ip, ip, 4);
+   }
+   if(!_SL_.set || (_SL_.rtr != time_100us))
+   {
+      setSLRTR(time_100us);
+      _SL_.rtr = time_100us;
+   }
+   if(!_SL_.set || (_SL_.rcr != retry_cnt))
+   {
+      setSLRCR(retry_cnt);
+      _SL_.rcr = retry_cnt;
+   }
+   _SL_.set = 1;
+   if(cmd == SLCMD_PING) setPINGSEQR(++_SL_.seq);
+
+   _SL_.cmd  = cmd;
+   _SL_.done = done;
+   _SL_.arg  = arg;
+   _SL_.busy = 1;
+   // an edge before the command isn't its completion
+   wizchip_sl_edge = 0;
+   setSLCR(cmd);
+   _SL_.start_us = wizchip_sl_us ? wizchip_sl_us() : 0;
+   return 0;
+}
+
+uint8_t wizchip_sl_busy(void)
+{
+   return _SL_.busy;
+}
+
+int8_t wizchip_sl_poll(void)
+{
+   uint8_t ir;
+   uint32_t end;
+   wiz_SLResult res;
+
+   if(!_SL_.busy) return 0;
+   ir = getSLIR() & (SLIR_TIMEOUT | SLIR_ARP | SLIR_PING);
+   if(!ir)
+   {
+      // the edge was another interrupt's, the next one may be the command's
+      wizchip_sl_edge = 0;
+      return 0;
+   }
+   end = wizchip_sl_us ? (wizchip_sl_edge ? wizchip_sl_edge_us : wizchip_sl_us()) : 0;
+   setSLIR(ir);
+   _SL_.busy = 0;
+
+   memset(&res, 0, sizeof(res));
+   res.cmd = _SL_.cmd;
+   res.ok  = (ir & SLIR_TIMEOUT) ? 0 : 1;
+   memcpy(res.ip, _SL_.ip, 4);
+   if(res.ok && (res.cmd == SLCMD_ARP)) getSLPHAR(res.mac);
+   if(res.cmd == SLCMD_PING) res.seq = _SL_.seq;
+   res.rtt_us = end - _SL_.start_us;
+
+   if(_SL_.done) _SL_.done(&res, _SL_.arg);
+   return 1;
+}
+
+void wizchip_sl_isr(void)
+{
+   if(wizchip_sl_edge || !wizchip_sl_us) return;
+   wizchip_sl_edge_us = wizchip_sl_us();
+   wizchip_sl_edge = 1;
+}
+#endif
@@ -111,9 +111,11 @@ extern "C" {
 * @brief Define interface mode.
 * @todo you should select interface mode as chip. Select one of @ref \_WIZCHIP_IO_MODE_SPI_ , @ref \_WIZCHIP_IO_MODE_BUS_DIR_ or @ref \_WIZCHIP_IO_MODE_BUS_INDIR_
 */
+#ifndef _WIZCHIP_IO_MODE_
 //	#define _WIZCHIP_IO_MODE_           _WIZCHIP_IO_MODE_BUS_INDIR_
 	//#define _WIZCHIP_IO_MODE_           _WIZCHIP_IO_MODE_SPI_5500_
 	#define _WIZCHIP_IO_MODE_           _WIZCHIP_IO_MODE_SPI_
+#endif
 
 //A20150601 : Define the unit of IO DATA.
    typedef   uint8_t   iodata_t;
@@ -191,6 +193,15 @@ extern "C" {
    #error "Undefined _WIZCHIP_IO_MODE_. You should define it !!!"
 #endif
 
+/**
+ * @brief Port header with static inline SPI primitives for the register accesses. Not defined by default.
+ * @details When defined, WIZCHIP_READ() and WIZCHIP_WRITE() are static inline functions calling the primitives of
+ *          this header instead of the registered SPI callbacks, refer to W5100S/w5100s_inline.h. Valid only W5100S in
+ *          @ref \_WIZCHIP_IO_MODE_SPI_. \n\n
+ *       ex> <code> #define \_WIZCHIP_SPI_INLINE_      "w5x00_spi_port.h" </code>
+ */
+//#define _WIZCHIP_SPI_INLINE_              "w5x00_spi_port.h"
+
 /**
  * @brief Define I/O base address when BUS IF mode.
  * @todo Should re-define it to fit your system when BUS IF Mode (@ref \_WIZCHIP_IO_MODE_BUS_,
@@ -222,10 +233,34 @@ extern "C" {
    #define _WIZCHIP_SOCK_NUM_   4   ///< The count of independant socket of @b WIZCHIP
 #endif      
 
+/**
+ * @brief The count of @ref \_WIZCHIP_ chips of the same type driven by the library
+ * @details With more than one, @ref WIZCHIP is the instance selected by @ref wizchip_use() and the socket
+ * APIs keep their state for each instance, refer to @ref wizchip_instance_init().
+ * ex> <code> #define \_WIZCHIP_INSTANCES_   2 </code>
+ */
+#ifndef _WIZCHIP_INSTANCES_
+   #define _WIZCHIP_INSTANCES_   1
+#endif
+
+#if (_WIZCHIP_INSTANCES_ > 1) && (_WIZCHIP_ == 5300)
+   #error "_WIZCHIP_INSTANCES_ isn't supported in W5300, its driver shares sock_pack_info."
+#endif
+
 
 /********************************************************
 * WIZCHIP BASIC IF functions for SPI, SDIO, I2C , ETC.
 *********************************************************/
+/**
+ * @ingroup DATA_TYPE
+ * @brief One segment of a vectored SPI burst, see @ref reg_wizchip_spiburst_vec_cbfunc().
+ */
+typedef struct wiz_iovec_t
+{
+   uint8_t* buf;                    ///< segment data
+   uint16_t len;                    ///< segment length
+}wiz_iovec;
+
 /**
  * @ingroup DATA_TYPE
  * @brief The set of callback functions for W5500:@ref WIZCHIP_IO_Functions W5200:@ref WIZCHIP_IO_Functions_W5200
@@ -268,6 +303,8 @@ typedef struct __WIZCHIP
       {
          iodata_t  (*_read_data)   (uint32_t AddrSel);
          void      (*_write_data)  (uint32_t AddrSel, iodata_t wb);
+         void      (*_read_data_buf)  (uint32_t AddrSel, iodata_t* pBuf, uint16_t len);   ///< reads len data from the same address
+         void      (*_write_data_buf) (uint32_t AddrSel, iodata_t* pBuf, uint16_t len);   ///< writes len data to the same address
       }BUS;      
 
       /**
@@ -279,13 +316,44 @@ typedef struct __WIZCHIP
          void    (*_write_byte)  (uint8_t wb);
          void    (*_read_burst)  (uint8_t* pBuf, uint16_t len);
          void    (*_write_burst) (uint8_t* pBuf, uint16_t len);
+         void    (*_read_burst_async)  (uint8_t* pBuf, uint16_t len);   ///< starts a burst read, completion is reported with @ref wizchip_spiburst_async_done()
+         void    (*_write_burst_async) (uint8_t* pBuf, uint16_t len);   ///< starts a burst write, completion is reported with @ref wizchip_spiburst_async_done()
+         void    (*_read_burst_vec)  (wiz_iovec* wr, wiz_iovec* rd);    ///< writes wr then reads rd as one burst
+         void    (*_write_burst_vec) (wiz_iovec* iov, uint8_t iovcnt);  ///< writes iovcnt segments as one burst
+         void    (*_read_burst_wrap)  (wiz_iovec* wr, wiz_iovec* rd);   ///< two header and read bursts, the chip deselected between them
+         void    (*_write_burst_wrap) (wiz_iovec* iov);                 ///< two header and data bursts, the chip deselected between them
+         uint8_t (*_xfer_reg) (uint8_t* frame);                         ///< clocks out a 4 byte register frame, returns the last byte clocked in
       }SPI;
       // To be added
       //
    }IF;
+   /**
+    * The asynchronous burst in flight, @ref \_WIZCHIP_ stays selected until it completes.
+    */
+   struct _ASYNC
+   {
+      volatile uint8_t _busy;       ///< a burst was started and has not completed yet
+      void (*_done)(void* arg);     ///< completion callback of the burst
+      void* _arg;                   ///< argument of the completion callback
+   }ASYNC;
+   uint8_t inst;                    ///< index of the instance, the state of the socket APIs is kept per index
 }_WIZCHIP;
 
+/**
+ * @ingroup DATA_TYPE
+ * @brief Handle of a @ref \_WIZCHIP_ chip, refer to @ref wizchip_instance_init().
+ */
+typedef _WIZCHIP wizchip_t;
+
+#if _WIZCHIP_INSTANCES_ > 1
+extern _WIZCHIP* wizchip_cur;
+// the register access and socket APIs work on the instance selected by wizchip_use()
+#define WIZCHIP         (*wizchip_cur)
+#define WIZCHIP_INST    (wizchip_cur->inst)
+#else
 extern _WIZCHIP  WIZCHIP;
+#define WIZCHIP_INST    0
+#endif
 
 /**
  * @ingroup DATA_TYPE
@@ -299,8 +367,8 @@ typedef enum
    CW_CLR_INTERRUPT,   ///< Clears interrupt
    CW_SET_INTRMASK,    ///< Masks interrupt
    CW_GET_INTRMASK,    ///< Get interrupt mask
-   CW_SET_INTRTIME,    ///< Set interval time between the current and next interrupt. 
-   CW_GET_INTRTIME,    ///< Set interval time between the current and next interrupt. 
+   CW_SET_INTRTIME,    ///< Set interval time between the current and next interrupt, INTLEVEL or INTPTMR of W5100S. 
+   CW_GET_INTRTIME,    ///< Get interval time between the current and next interrupt, INTLEVEL or INTPTMR of W5100S. 
    CW_GET_ID,          ///< Gets WIZCHIP name.
 
 //D20150601 : For no modification your application code
@@ -314,8 +382,9 @@ typedef enum
 //D20150601 : For no modification your application code
 //#if _WIZCHIP_ == W5200 || _WIZCHIP_ == W5500
    CW_GET_PHYPOWMODE,  ///< Get PHY Power mode as down or normal, Valid Only W5100, W5200
-   CW_GET_PHYLINK      ///< Get PHY Link status, Valid Only W5100, W5200
+   CW_GET_PHYLINK,     ///< Get PHY Link status, Valid Only W5100, W5200
 //#endif
+   CW_INIT_WIZCHIP_PROFILE ///< Re-sizes the SOCKET buffers with @ref wiz_BufProfile without reset. Valid only W5100, W5100S
 }ctlwizchip_type;
 
 /**
@@ -452,6 +521,44 @@ typedef struct wiz_NetTimeout_t
    uint16_t time_100us;    ///< time unit 100us
 }wiz_NetTimeout;
 
+#if _WIZCHIP_ == W5100S
+/**
+ * @ingroup DATA_TYPE
+ * @brief Outcome of a socket-less command, passed to the callback of @ref wizchip_sl_start().
+ */
+typedef struct wiz_SLResult_t
+{
+   uint8_t  cmd;           ///< @ref SLCMD_ARP or @ref SLCMD_PING
+   uint8_t  ok;            ///< 1 when the peer answered, 0 when the command timed out after its retries
+   uint8_t  ip[4];         ///< the peer's IP address
+   uint8_t  mac[6];        ///< the peer's MAC address from @ref SLPHAR, ARP answered only
+   uint16_t seq;           ///< sequence number of the echo request, PING only
+   uint32_t rtt_us;        ///< from the command to its completion in us, 0 without the clock of @ref reg_wizchip_sl_cbfunc()
+}wiz_SLResult;
+#endif
+
+/**
+ * @ingroup DATA_TYPE
+ *  SOCKET buffer split used in @ref wiz_BufProfile
+ */
+typedef enum
+{
+   BUF_BALANCED,     ///< The same size for every SOCKET, 2KB each in W5100S
+   BUF_ONE_FAT,      ///< All TX and RX memory to SOCKET 0, 8KB/8KB in W5100S. The other SOCKETs can not be opened.
+   BUF_CUSTOM        ///< The sizes in @ref wiz_BufProfile::txsize and @ref wiz_BufProfile::rxsize
+}buf_profile;
+
+/**
+ * @ingroup DATA_TYPE
+ *  Used in CW_INIT_WIZCHIP_PROFILE of @ref ctlwizchip() for the SOCKET buffer sizes.
+ */
+typedef struct wiz_BufProfile_t
+{
+   buf_profile profile;                   ///< Split of the TX and RX memory
+   uint8_t txsize[_WIZCHIP_SOCK_NUM_];    ///< TX KB of each SOCKET with BUF_CUSTOM : 0, 1, 2, 4 or 8.
+   uint8_t rxsize[_WIZCHIP_SOCK_NUM_];    ///< RX KB of each SOCKET with BUF_CUSTOM : 0, 1, 2, 4 or 8.
+}wiz_BufProfile;
+
 /**
  *@brief Registers call back function for critical section of I/O functions such as
  *\ref WIZCHIP_READ, @ref WIZCHIP_WRITE, @ref WIZCHIP_READ_BUF and @ref WIZCHIP_WRITE_BUF.
@@ -484,6 +591,16 @@ void reg_wizchip_cs_cbfunc(void(*cs_sel)(void), void(*cs_desel)(void));
 //void reg_wizchip_bus_cbfunc(uint8_t (*bus_rb)(uint32_t addr), void (*bus_wb)(uint32_t addr, uint8_t wb));
 void reg_wizchip_bus_cbfunc(iodata_t (*bus_rb)(uint32_t addr), void (*bus_wb)(uint32_t addr, iodata_t wb));
 
+/**
+ *@brief Registers call back function for bus block transfers.
+ *@param bus_rb : callback function to read len data from one bus address
+ *@param bus_wb : callback function to write len data to one bus address
+ *@details In \ref _WIZCHIP_IO_MODE_BUS_INDIR_ the data register auto-increments, so WIZCHIP_READ_BUF()
+ *and WIZCHIP_WRITE_BUF() hand the whole buffer over at once, e.g. to a DMA.
+ *@note If you do not register them, the buffer is moved with one \ref reg_wizchip_bus_cbfunc call per data.
+ */
+void reg_wizchip_busbuf_cbfunc(void (*bus_rb)(uint32_t addr, iodata_t* pBuf, uint16_t len), void (*bus_wb)(uint32_t addr, iodata_t* pBuf, uint16_t len));
+
 /**
  *@brief Registers call back function for SPI interface.
  *@param spi_rb : callback function to read byte using SPI
@@ -504,6 +621,117 @@ void reg_wizchip_spi_cbfunc(uint8_t (*spi_rb)(void), void (*spi_wb)(uint8_t wb))
  */
 void reg_wizchip_spiburst_cbfunc(void (*spi_rb)(uint8_t* pBuf, uint16_t len), void (*spi_wb)(uint8_t* pBuf, uint16_t len));
 
+/**
+ *@brief Registers call back function for vectored SPI burst.
+ *@param spi_rb : callback function to write a header and then burst read using SPI
+ *@param spi_wb : callback function to burst write several segments using SPI
+ *@details WIZCHIP_READ_BUF() and WIZCHIP_WRITE_BUF() pass the opcode/address header and the data
+ *as one transfer, so a DMA implementation can chain the segments instead of setting up one DMA per call.
+ *@note If you do not register them, the header and the data are sent with separate \ref reg_wizchip_spiburst_cbfunc bursts.
+ */
+void reg_wizchip_spiburst_vec_cbfunc(void (*spi_rb)(wiz_iovec* wr, wiz_iovec* rd), void (*spi_wb)(wiz_iovec* iov, uint8_t iovcnt));
+
+/**
+ *@brief Registers call back function for SPI bursts across the end of a socket buffer.
+ *@param spi_rb : callback function to read wr[0]/rd[0] and then wr[1]/rd[1] using SPI
+ *@param spi_wb : callback function to write iov[0..1] and then iov[2..3] using SPI
+ *@details A transfer that crosses the end of a socket buffer goes on at its start, which needs a second
+ *opcode/address header. WIZCHIP_READ_BUF_WRAP() and WIZCHIP_WRITE_BUF_WRAP() pass both bursts at once, with the
+ *chip selected, so the second one can be set up while the first is on the bus. The callbacks deselect and select
+ *the chip again between the two bursts themselves. All segments are non-empty.
+ *@note If you do not register them, each burst is a separate WIZCHIP_READ_BUF() or WIZCHIP_WRITE_BUF().
+ */
+void reg_wizchip_spiburst_wrap_cbfunc(void (*spi_rb)(wiz_iovec* wr, wiz_iovec* rd), void (*spi_wb)(wiz_iovec* iov));
+
+/**
+ *@brief Registers call back function for SPI register access.
+ *@param spi_reg : callback function to transfer a register frame using SPI
+ *@details WIZCHIP_READ() and WIZCHIP_WRITE() pass their opcode, address and data bytes as one 4 byte frame,
+ *a read frame ends with a dummy byte. spi_reg clocks out the 4 bytes and returns the byte clocked in with the last one,
+ *so all of them can be queued in the SPI FIFO at once instead of waiting for each byte.
+ *@note If you do not register it, the frame is sent with \ref reg_wizchip_spi_cbfunc or \ref reg_wizchip_spiburst_cbfunc callbacks.
+ */
+void reg_wizchip_spireg_cbfunc(uint8_t (*spi_reg)(uint8_t* frame));
+
+/**
+ *@brief Registers call back function for asynchronous SPI burst.
+ *@param spi_rb : callback function to start a burst read using SPI
+ *@param spi_wb : callback function to start a burst write using SPI
+ *@details Both callbacks start the transfer (DMA for example) and return without waiting,
+ *the platform calls @ref wizchip_spiburst_async_done() from its completion interrupt.
+ *They are used by WIZCHIP_READ_BUF_ASYNC() and WIZCHIP_WRITE_BUF_ASYNC().
+ *@note If you do not register them, the asynchronous functions fall back to the blocking ones.
+ */
+void reg_wizchip_spiburst_async_cbfunc(void (*spi_rb)(uint8_t* pBuf, uint16_t len), void (*spi_wb)(uint8_t* pBuf, uint16_t len));
+
+/**
+ *@brief Records the asynchronous burst started on @ref WIZCHIP.
+ *@details Called by the chip driver in the critical section, before the asynchronous callback starts the burst.
+ *@param done : completion callback of the burst, may be NULL
+ *@param arg : argument of the completion callback
+ */
+void wizchip_spiburst_async_begin(void (*done)(void* arg), void* arg);
+
+/**
+ *@brief Completes the asynchronous burst in flight.
+ *@details Called by the platform once the burst started by the asynchronous callback has
+ *completed. It deselects @ref \_WIZCHIP_ and then runs the completion callback, which may start the next burst.
+ */
+void wizchip_spiburst_async_done(void);
+
+/**
+ *@brief Checks for an asynchronous burst in flight.
+ *@return 1 while a burst started by WIZCHIP_READ_BUF_ASYNC() or WIZCHIP_WRITE_BUF_ASYNC() has not completed, 0 otherwise
+ */
+uint8_t wizchip_spiburst_async_busy(void);
+
+/**
+ *@brief Waits for the asynchronous burst in flight, if any, to complete.
+ */
+void wizchip_spiburst_async_wait(void);
+
+/**
+ *@brief Checks whether the asynchronous bursts run in the background.
+ *@return 1 when WIZCHIP_READ_BUF_ASYNC() and WIZCHIP_WRITE_BUF_ASYNC() start a transfer and return before it completes,
+ *0 when they fall back to the blocking functions and call the completion callback before returning
+ */
+uint8_t wizchip_spiburst_async_enabled(void);
+
+#if _WIZCHIP_INSTANCES_ > 1
+/**
+ *@brief Initializes another instance to drive one more chip.
+ *@details The instance starts with the interface mode and the callbacks registered so far on the default instance.
+ *Select it with @ref wizchip_use() and register the callbacks that differ, the chip select of a second chip on
+ *the same bus for example, then initialize the chip with @ref ctlwizchip() as the first one.
+ *@param chip : instance to initialize, it must stay valid while it is used
+ *@return 0 : Success \n
+ *       -1 : Fail, @ref \_WIZCHIP_INSTANCES_ instances are in use already
+ */
+int8_t wizchip_instance_init(wizchip_t* chip);
+
+/**
+ *@brief Selects the instance the register access and socket APIs work on.
+ *@details The selection is shared by all the contexts. A context driving another chip selects it, and the
+ *previous one back when done, inside its own locking, refer to @ref WIZCHIP_WITH.
+ *@param chip : instance of @ref wizchip_instance_init(), or NULL for the default instance
+ *@return the instance selected before
+ */
+wizchip_t* wizchip_use(wizchip_t* chip);
+
+/**
+ * @brief Runs stmt on the instance chip, with the previous instance selected again afterwards.
+ * ex> <code> WIZCHIP_WITH(&chip1, len = send(0, buf, size)); </code>
+ */
+#define WIZCHIP_WITH(chip, stmt)                            \
+   do{                                                     \
+      wizchip_t* wizchip_prev_ = wizchip_use(chip);        \
+      stmt;                                                \
+      wizchip_use(wizchip_prev_);                          \
+   }while(0)
+#else
+#define WIZCHIP_WITH(chip, stmt)   do{ (void)(chip); stmt; }while(0)
+#endif
+
 /**
  * @ingroup extra_functions
  * @brief Controls to the WIZCHIP.
@@ -549,6 +777,20 @@ void   wizchip_sw_reset(void);
  */
 int8_t wizchip_init(uint8_t* txsize, uint8_t* rxsize);
 
+#if _WIZCHIP_ < W5200
+/**
+ * @ingroup extra_functions
+ * @brief Re-sizes the socket buffers with a profile, without resetting WIZCHIP
+ * @details The network information and the registers other than @ref TMSR and @ref RMSR are kept.
+ *          Every SOCKET must be closed, the buffer addresses of all of them move. \n
+ *          0KB is allowed only once the SOCKETs below take all 8KB, such a SOCKET can not be opened.
+ * @param profile : @ref wiz_BufProfile
+ * @return 0 : succcess \n
+ *        -1 : fail. Invalid buffer size, or a SOCKET is not closed
+ */
+int8_t wizchip_init_profile(wiz_BufProfile* profile);
+#endif
+
 /** 
  * @ingroup extra_functions
  * @brief Clear Interrupt of WIZCHIP.
@@ -654,8 +896,72 @@ void wizchip_settimeout(wiz_NetTimeout* nettime);
  * @param nettime @ref _RTR_ value and @ref _RCR_ value. Refer to @ref wiz_NetTimeout. 
  */
 void wizchip_gettimeout(wiz_NetTimeout* nettime);
+
+#if _WIZCHIP_ == W5100S
+/**
+ * @ingroup extra_functions
+ * @brief Registers the clock of the socket-less commands.
+ * @details @b us returns a free running count of microseconds. It times the commands of @ref wizchip_sl_start()
+ *          and is read by @ref wizchip_sl_isr(), so it must be callable from an interrupt.
+ *          Without it @ref wiz_SLResult.rtt_us is 0.
+ * @param us : microsecond clock, NULL for none
+ */
+void reg_wizchip_sl_cbfunc(uint32_t (*us)(void));
+
+/**
+ * @ingroup extra_functions
+ * @brief Starts a socket-less ARP or ping, without waiting for it.
+ * @details The W5100S resolves @b ip with ARP requests, and for @ref SLCMD_PING sends it an ICMP echo request,
+ *          on its own registers: no SOCKET is used. One command runs at a time per chip. The peer, the timeout,
+ *          the retries and the ping identifier are written only when they differ from the last command's,
+ *          so a periodic check of the same peer costs the sequence number and @ref SLCR.
+ *          The command completes on an interrupt of @ref SLIMR, read by @ref sockevent_dispatch(), @ref wiz_poll()
+ *          or @ref wizchip_sl_poll(), which then call @b done. The round trip ends at the first INTn edge seen by
+ *          @ref wizchip_sl_isr() since the command, or at the read that finds it complete without one.
+ *          A socket's edge in between makes it shorter, one that came while the chip was still waiting is discarded on the read.
+ * @param cmd : @ref SLCMD_ARP or @ref SLCMD_PING
+ * @param ip : the peer's IP address
+ * @param time_100us : time of each try in 100us, @ref SLRTR
+ * @param retry_cnt : tries after the first one, @ref SLRCR
+ * @param done : called with the result when the command completes, may be NULL
+ * @param arg : argument of @b done
+ * @return 0 : Started \n
+ *        -1 : Another command is running \n
+ *        -2 : Invalid command
+ */
+int8_t wizchip_sl_start(uint8_t cmd, uint8_t* ip, uint16_t time_100us, uint8_t retry_cnt, void (*done)(wiz_SLResult* res, void* arg), void* arg);
+
+/**
+ * @ingroup extra_functions
+ * @brief Checks for a socket-less command in flight.
+ * @return 1 while the command of @ref wizchip_sl_start() has not been seen complete, 0 otherwise
+ */
+uint8_t wizchip_sl_busy(void);
+
+/**
+ * @ingroup extra_functions
+ * @brief Completes the socket-less command when the chip is done with it.
+ * @details Reads @ref SLIR once, and when the command completed clears it, releasing INTn, and calls the callback.
+ *          Without a command in flight it does not access the chip. @ref sockevent_dispatch() and @ref wiz_poll()
+ *          call it, the application calls it when it uses neither.
+ * @return 1 when the command completed, 0 otherwise
+ */
+int8_t wizchip_sl_poll(void);
+
+/**
+ * @ingroup extra_functions
+ * @brief Time stamps an INTn edge for the round trips of the socket-less commands.
+ * @details Call it from the INTn interrupt, before any coalescing of the edges. It only reads the clock of
+ *          @ref reg_wizchip_sl_cbfunc(), once per command. It is shared by the instances, as @ref sockevent_isr().
+ */
+void wizchip_sl_isr(void);
+#endif
 #ifdef __cplusplus
  }
 #endif
 
+#if (_WIZCHIP_ == W5100S) && defined(_WIZCHIP_SPI_INLINE_)
+   #include "W5100S/w5100s_inline.h"   // after WIZCHIP, the inline accessors use it
+#endif
+
 #endif   // _WIZCHIP_CONF_H_
@@ -0,0 +1,105 @@
+//*****************************************************************************
+//
+//! \file wizchip_port_rp2040.c
+//! \brief WIZCHIP critical section and SOCKET locks for the RP2040.
+//! \version 1.0.0
+//! \date 2021/08/25
+//! \copyright
+//!
+//! Copyright (c)  2021, WIZnet Co., LTD.
+//! All rights reserved.
+//!
+//! Redistribution and use in source and binary forms, with or without
+//! modification, are permitted provided that the following conditions
+//! are met:
+//!
+//!     * Redistributions of source code must retain the above copyright
+//! notice, this list of conditions and the following disclaimer.
+//!     * Redistributions in binary form must reproduce the above copyright
+//! notice, this list of conditions and the following disclaimer in the
+//! documentation and/or other materials provided with the distribution.
+//!     * Neither the name of the <ORGANIZATION> nor the names of its
+//! contributors may be used to endorse or promote products derived
+//! from this software without specific prior written permission.
+//!
+//! THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//! AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//! IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+//! ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+//! LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+//! CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//! SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//! INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+//! CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+//! ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+//! THE POSSIBILITY OF SUCH DAMAGE.
+//
+//*****************************************************************************
+
+#include "pico/stdlib.h"
+#include "pico/mutex.h"
+#include "hardware/sync.h"
+
+#include "wizchip_conf.h"
+#include "wizchip_port_rp2040.h"
+
+#define CRIS_NO_OWNER   0xFF
+
+static spin_lock_t*      cris_lock;
+static volatile uint8_t  cris_owner = CRIS_NO_OWNER;  // core holding cris_lock
+static uint8_t           cris_depth;
+static uint32_t          cris_save;                   // interrupts of cris_owner before it took cris_lock
+
+static wizchip_port_lock_mode sock_lock_mode;
+static recursive_mutex_t      sock_lock[_WIZCHIP_SOCK_NUM_];
+
+static void wizchip_port_cris_enter(void)
+{
+   uint32_t save = save_and_disable_interrupts();
+   uint8_t  core = (uint8_t)get_core_num();
+
+   // cris_owner only equals this core when it set it itself
+   if(cris_owner == core)
+   {
+      cris_depth++;
+      return;
+   }
+   spin_lock_unsafe_blocking(cris_lock);
+   cris_owner = core;
+   cris_depth = 1;
+   cris_save  = save;
+}
+
+static void wizchip_port_cris_exit(void)
+{
+   uint32_t save;
+
+   if(--cris_depth) return;
+   save = cris_save;
+   cris_owner = CRIS_NO_OWNER;
+   spin_unlock_unsafe(cris_lock);
+   restore_interrupts(save);
+}
+
+void wizchip_port_rp2040_init(wizchip_port_lock_mode mode)
+{
+   uint8_t i;
+
+   cris_lock = spin_lock_instance((uint)spin_lock_claim_unused(true));
+
+   sock_lock_mode = mode;
+   for(i = 0; i < _WIZCHIP_SOCK_NUM_; i++)
+      recursive_mutex_init(&sock_lock[i]);
+
+   reg_wizchip_cris_cbfunc(wizchip_port_cris_enter, wizchip_port_cris_exit);
+}
+
+void wizchip_port_sock_lock(uint8_t sn)
+{
+   recursive_mutex_enter_blocking(&sock_lock[sock_lock_mode == WIZCHIP_PORT_LOCK_SOCKET ? sn : 0]);
+}
+
+void wizchip_port_sock_unlock(uint8_t sn)
+{
+   recursive_mutex_exit(&sock_lock[sock_lock_mode == WIZCHIP_PORT_LOCK_SOCKET ? sn : 0]);
+}
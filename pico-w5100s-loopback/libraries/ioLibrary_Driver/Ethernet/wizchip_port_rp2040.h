@@ -0,0 +1,94 @@
+//*****************************************************************************
+//
+//! \file wizchip_port_rp2040.h
+//! \brief WIZCHIP critical section and SOCKET locks for the RP2040.
+//! \details The critical section of the I/O functions, refer to reg_wizchip_cris_cbfunc(), is a hardware
+//!          spinlock taken with the interrupts of the calling core disabled. Both cores and the IRQ handlers
+//!          can then access WIZCHIP. \n
+//!          A register access or a buffer transfer is atomic, a SOCKET operation such as send() is not.
+//!          wizchip_port_sock_lock() serializes them : with @ref WIZCHIP_PORT_LOCK_CHIP one core at a time drives
+//!          the SOCKETs, with @ref WIZCHIP_PORT_LOCK_SOCKET each SOCKET has its own lock and the cores can drive
+//!          different SOCKETs concurrently.
+//! \version 1.0.0
+//! \date 2021/08/25
+//! \copyright
+//!
+//! Copyright (c)  2021, WIZnet Co., LTD.
+//! All rights reserved.
+//!
+//! Redistribution and use in source and binary forms, with or without
+//! modification, are permitted provided that the following conditions
+//! are met:
+//!
+//!     * Redistributions of source code must retain the above copyright
+//! notice, this list of conditions and the following disclaimer.
+//!     * Redistributions in binary form must reproduce the above copyright
+//! notice, this list of conditions and the following disclaimer in the
+//! documentation and/or other materials provided with the distribution.
+//!     * Neither the name of the <ORGANIZATION> nor the names of its
+//! contributors may be used to endorse or promote products derived
+//! from this software without specific prior written permission.
+//!
+//! THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//! AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//! IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+//! ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+//! LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+//! CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//! SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//! INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+//! CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+//! ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+//! THE POSSIBILITY OF SUCH DAMAGE.
+//
+//*****************************************************************************
+
+#ifndef  _WIZCHIP_PORT_RP2040_H_
+#define  _WIZCHIP_PORT_RP2040_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @ingroup DATA_TYPE
+ *  SOCKET lock mode of wizchip_port_rp2040_init()
+ */
+typedef enum
+{
+   WIZCHIP_PORT_LOCK_CHIP,    ///< One lock for all the SOCKETs
+   WIZCHIP_PORT_LOCK_SOCKET   ///< One lock per SOCKET
+}wizchip_port_lock_mode;
+
+/**
+ * @ingroup extra_functions
+ * @brief Claims a hardware spinlock and registers the critical section with reg_wizchip_cris_cbfunc()
+ * @details Call it once, before the other WIZCHIP functions. The critical section can be entered again by the
+ *          core holding it.
+ * @param mode : @ref wizchip_port_lock_mode of wizchip_port_sock_lock()
+ */
+void wizchip_port_rp2040_init(wizchip_port_lock_mode mode);
+
+/**
+ * @ingroup extra_functions
+ * @brief Takes the lock of SOCKET sn, blocking
+ * @details Held around the SOCKET functions called for sn, a blocking send() or recv() keeps it.
+ *          The core holding it can take it again.
+ * @param sn : SOCKET number
+ */
+void wizchip_port_sock_lock(uint8_t sn);
+
+/**
+ * @ingroup extra_functions
+ * @brief Releases the lock of SOCKET sn taken by wizchip_port_sock_lock()
+ * @param sn : SOCKET number
+ */
+void wizchip_port_sock_unlock(uint8_t sn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _WIZCHIP_PORT_RP2040_H_
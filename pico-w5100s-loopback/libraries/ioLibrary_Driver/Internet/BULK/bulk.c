@@ -0,0 +1,408 @@
+/**
+ @file		bulk.c
+ @brief 	Reliable bulk transfer over UDP, see bulk.h
+ */
+
+#include <string.h>
+
+#include "timebase.h"
+#include "socket.h"
+#include "bulk.h"
+
+#ifdef _BULK_DEBUG_
+	#include <stdio.h>
+#endif
+
+#define BULK_WINDOW_WORDS	(BULK_WINDOW / 32)
+#define BULK_STATUS_SIZE	(BULK_HEAD_SIZE + BULK_WINDOW / 8)
+#define BULK_DGRAM_MAX		(BULK_HEAD_SIZE + BULK_CHUNK_SIZE)
+
+/* REQs and STATUSes taken per recvfrom_multi() */
+#define BULK_RX_BATCH		4
+
+/* Time the rate is given tokens for at once, its product with the rate stays in 32 bits */
+#define BULK_TOKENS_US_MAX	10000
+#define BULK_RATE_MAX_KBPS	100000		// the W5100S's 100 Mbit/s
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+static uint8_t BULK_SOCKET;
+static uint8_t * pBULK_BUF;
+static wiz_BulkSource BULK_SOURCES[BULK_SOURCE_MAX];
+static wiz_BulkStats bulk_stats;
+
+/* The transfer in progress, chunk numbers from 0 */
+static struct
+{
+	uint8_t		active;
+	uint8_t		source;
+	uint8_t		addr[4];
+	uint16_t	port;
+	uint32_t	session;
+	uint32_t	size;
+	uint32_t	chunks;						// size / BULK_CHUNK_SIZE + 1, the last one shorter
+	uint32_t	base;						// received in order, of the last STATUS
+	uint32_t	next;						// first chunk not sent yet
+	uint32_t	resend[BULK_WINDOW_WORDS];	// chunks to send again, bit 0 is base
+	uint32_t	rate_max_kbps;
+	uint32_t	rate_kbps;
+	uint32_t	recover;					// next at the last cut, the losses before it don't cut again
+	int32_t		tokens;						// bytes the rate allows now
+	uint32_t	tokens_us;
+	uint32_t	status_us;					// of the last STATUS, or of the REQ
+}bulk;
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+static void bulk_input(uint8_t * msg, uint16_t len, uint8_t * addr, uint16_t port);
+static void bulk_start(uint8_t source, uint32_t session, uint32_t rate_kbps, uint8_t * addr, uint16_t port);
+static void bulk_status(uint32_t ack, uint8_t * bits);
+static void bulk_send(void);
+static int32_t bulk_next_chunk(void);
+static void bulk_finish(uint8_t code, uint8_t reply);
+static void bulk_send_end(uint8_t * addr, uint16_t port, uint32_t session, uint8_t code);
+static void bulk_head(uint8_t * buf, uint8_t type, uint8_t source, uint32_t session, uint32_t seq, uint32_t arg);
+static uint8_t bulk_peer(uint32_t session, uint8_t * addr, uint16_t port);
+static uint32_t bulk_get32(const uint8_t * buf);
+static void bulk_put32(uint8_t * buf, uint32_t val);
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+void BULK_init(uint8_t sn, uint8_t * buf)
+{
+	BULK_SOCKET = sn;
+	pBULK_BUF = buf;
+	memset(&bulk, 0, sizeof(bulk));
+
+	// Non-blocking, BULK_run() never waits on the chip
+	socket(sn, Sn_MR_UDP, BULK_PORT, SF_IO_NONBLOCK);
+}
+
+uint8_t BULK_source(uint8_t id, const wiz_BulkSource * source)
+{
+	if(id >= BULK_SOURCE_MAX) return 0;
+
+	BULK_SOURCES[id] = *source;
+	return 1;
+}
+
+uint8_t BULK_run(void)
+{
+	wiz_Datagram dgs[BULK_RX_BATCH];
+	uint8_t msgs[BULK_RX_BATCH][BULK_STATUS_SIZE];
+	int32_t n, i;
+
+	switch(getSn_SR(BULK_SOCKET))
+	{
+		case SOCK_UDP:
+			break;
+
+		case SOCK_CLOSED:
+			// A transfer doesn't outlive its socket
+			if(bulk.active) bulk_finish(BULK_END_TIMEOUT, 0);
+			socket(BULK_SOCKET, Sn_MR_UDP, BULK_PORT, SF_IO_NONBLOCK);
+			return 0;
+
+		default:
+			return bulk.active;
+	}
+
+	// The REQs and STATUSes, a batch read with one RECV
+	for(i = 0; i < BULK_RX_BATCH; i++)
+	{
+		dgs[i].buf = msgs[i];
+		dgs[i].len = sizeof(msgs[i]);
+	}
+	if((n = recvfrom_multi(BULK_SOCKET, dgs, BULK_RX_BATCH)) > 0)
+	{
+		for(i = 0; i < n; i++) bulk_input(dgs[i].buf, dgs[i].len, dgs[i].addr, dgs[i].port);
+	}
+
+	if(bulk.active && ((timebase_us() - bulk.status_us) > (uint32_t)BULK_TIMEOUT_MS * 1000))
+	{
+#ifdef _BULK_DEBUG_
+		printf("> BULK : session %lu timed out at %lu of %lu chunks\r\n", bulk.session, bulk.base, bulk.chunks);
+#endif
+		bulk_finish(BULK_END_TIMEOUT, 1);
+	}
+
+	if(bulk.active) bulk_send();
+
+	return bulk.active;
+}
+
+void BULK_get_stats(wiz_BulkStats * stats)
+{
+	bulk_stats.rate_kbps = bulk.active ? bulk.rate_kbps : 0;
+	memcpy(stats, &bulk_stats, sizeof(*stats));
+}
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+static void bulk_input(uint8_t * msg, uint16_t len, uint8_t * addr, uint16_t port)
+{
+	uint32_t session;
+
+	if((len < BULK_HEAD_SIZE) || (bulk_get32(msg) != BULK_MAGIC)) return;
+	session = bulk_get32(msg + 8);
+
+	switch(msg[4])
+	{
+		case BULK_REQ:
+			if(bulk.active)
+			{
+				// The REQ repeated, its first DATA not there yet
+				if(bulk_peer(session, addr, port)) return;
+				bulk_send_end(addr, port, session, BULK_END_BUSY);
+				return;
+			}
+			if((msg[5] >= BULK_SOURCE_MAX) || !BULK_SOURCES[msg[5]].read || !BULK_SOURCES[msg[5]].size)
+			{
+				bulk_send_end(addr, port, session, BULK_END_NOSOURCE);
+				return;
+			}
+			bulk_start(msg[5], session, bulk_get32(msg + 16), addr, port);
+			break;
+
+		case BULK_STATUS:
+			if(!bulk.active || !bulk_peer(session, addr, port) || (len < BULK_STATUS_SIZE)) return;
+			bulk_status(bulk_get32(msg + 12), msg + BULK_HEAD_SIZE);
+			break;
+
+		case BULK_END:
+			if(bulk.active && bulk_peer(session, addr, port)) bulk_finish(BULK_END_CANCEL, 0);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void bulk_start(uint8_t source, uint32_t session, uint32_t rate_kbps, uint8_t * addr, uint16_t port)
+{
+	memset(&bulk, 0, sizeof(bulk));
+	bulk.active = 1;
+	bulk.source = source;
+	memcpy(bulk.addr, addr, 4);
+	bulk.port = port;
+	bulk.session = session;
+	bulk.size = BULK_SOURCES[source].size(BULK_SOURCES[source].arg);
+	bulk.chunks = bulk.size / BULK_CHUNK_SIZE + 1;
+
+	// The rate starts at the limit, the losses bring it down
+	bulk.rate_max_kbps = rate_kbps ? rate_kbps : BULK_RATE_KBPS;
+	if(bulk.rate_max_kbps < BULK_RATE_MIN_KBPS) bulk.rate_max_kbps = BULK_RATE_MIN_KBPS;
+	if(bulk.rate_max_kbps > BULK_RATE_MAX_KBPS) bulk.rate_max_kbps = BULK_RATE_MAX_KBPS;
+	bulk.rate_kbps = bulk.rate_max_kbps;
+	bulk.tokens_us = bulk.status_us = timebase_us();
+
+	bulk_stats.transfers++;
+#ifdef _BULK_DEBUG_
+	printf("> BULK : session %lu, source %d, %lu bytes to %d.%d.%d.%d:%d at %lu kbit/s\r\n", session, source, bulk.size,
+		addr[0], addr[1], addr[2], addr[3], port, bulk.rate_kbps);
+#endif
+}
+
+static void bulk_status(uint32_t ack, uint8_t * bits)
+{
+	uint32_t shift, sent, lost, word, i;
+
+	// A STATUS overtaken by a later one, or acknowledging what wasn't sent
+	if((ack < bulk.base) || (ack > bulk.next)) return;
+
+	bulk.status_us = timebase_us();
+
+	if(ack == bulk.chunks)
+	{
+#ifdef _BULK_DEBUG_
+		printf("> BULK : session %lu complete, %lu bytes\r\n", bulk.session, bulk.size);
+#endif
+		bulk_stats.completed++;
+		bulk_stats.bytes += bulk.size;
+		bulk_finish(BULK_END_OK, 1);
+		return;
+	}
+
+	// The window moves up to ack
+	shift = ack - bulk.base;
+	bulk.base = ack;
+	while(shift >= 32)
+	{
+		for(i = 0; i < BULK_WINDOW_WORDS - 1; i++) bulk.resend[i] = bulk.resend[i + 1];
+		bulk.resend[BULK_WINDOW_WORDS - 1] = 0;
+		shift -= 32;
+	}
+	if(shift)
+	{
+		for(i = 0; i < BULK_WINDOW_WORDS - 1; i++) bulk.resend[i] = (bulk.resend[i] >> shift) | (bulk.resend[i + 1] << (32 - shift));
+		bulk.resend[BULK_WINDOW_WORDS - 1] >>= shift;
+	}
+
+	// The chunks to send again, of the ones sent: the host asks for the tail it hasn't seen
+	sent = bulk.next - bulk.base;
+	lost = 0;
+	for(i = 0; i < BULK_WINDOW_WORDS; i++)
+	{
+		word = bulk_get32(bits + 4 * i);
+		if(sent <= 32 * i) word = 0;
+		else if(sent < 32 * (i + 1)) word &= (1UL << (sent - 32 * i)) - 1;
+
+		lost += __builtin_popcount(word & ~bulk.resend[i]);
+		bulk.resend[i] |= word;
+	}
+
+	// Once per window in flight: the losses of the chunks sent at the old rate are reported over several STATUSes
+	if(lost && (ack >= bulk.recover))
+	{
+		bulk.recover = bulk.next;
+		bulk.rate_kbps -= bulk.rate_kbps / 4;
+		if(bulk.rate_kbps < BULK_RATE_MIN_KBPS) bulk.rate_kbps = BULK_RATE_MIN_KBPS;
+	}
+	else if(!lost && (bulk.rate_kbps < bulk.rate_max_kbps))
+	{
+		bulk.rate_kbps += BULK_RATE_STEP_KBPS;
+		if(bulk.rate_kbps > bulk.rate_max_kbps) bulk.rate_kbps = bulk.rate_max_kbps;
+	}
+}
+
+/**
+ @brief	send the chunks the rate, the window and the chip's TX buffer have room for, in one sendto_multi()
+ */
+static void bulk_send(void)
+{
+	wiz_Datagram dgs[BULK_BATCH];
+	int32_t chunks[BULK_BATCH];
+	uint32_t now, elapsed, add, offset;
+	uint16_t free, len;
+	int32_t chunk, ret, i;
+	uint8_t count;
+	uint8_t * buf;
+
+	now = timebase_us();
+	elapsed = now - bulk.tokens_us;
+	if(elapsed > BULK_TOKENS_US_MAX) elapsed = BULK_TOKENS_US_MAX;
+
+	// kbit/s are bytes per 8000 us, a batch is the burst. The time is kept until it makes a
+	// byte, a loop going round faster than that would otherwise never fill the bucket
+	add = elapsed * bulk.rate_kbps / 8000;
+	if(add)
+	{
+		bulk.tokens_us = now;
+		bulk.tokens += (int32_t)add;
+		if(bulk.tokens > BULK_BATCH * BULK_DGRAM_MAX) bulk.tokens = BULK_BATCH * BULK_DGRAM_MAX;
+	}
+
+	free = getSn_TX_FSR(BULK_SOCKET);
+	count = 0;
+	while((count < BULK_BATCH) && (bulk.tokens >= BULK_DGRAM_MAX))
+	{
+		if(free < BULK_DGRAM_MAX)
+		{
+			bulk_stats.busy++;
+			break;
+		}
+		if((chunk = bulk_next_chunk()) < 0) break;
+
+		offset = (uint32_t)chunk * BULK_CHUNK_SIZE;
+		len = ((bulk.size - offset) < BULK_CHUNK_SIZE) ? (uint16_t)(bulk.size - offset) : BULK_CHUNK_SIZE;
+
+		buf = pBULK_BUF + count * BULK_DGRAM_MAX;
+		bulk_head(buf, BULK_DATA, bulk.source, bulk.session, (uint32_t)chunk, bulk.size);
+		if(len && (BULK_SOURCES[bulk.source].read(BULK_SOURCES[bulk.source].arg, offset, buf + BULK_HEAD_SIZE, len) != len))
+		{
+			bulk_finish(BULK_END_READ, 1);
+			return;
+		}
+
+		dgs[count].buf = buf;
+		dgs[count].len = BULK_HEAD_SIZE + len;
+		memcpy(dgs[count].addr, bulk.addr, 4);
+		dgs[count].port = bulk.port;
+		chunks[count] = chunk;
+		count++;
+
+		bulk.tokens -= BULK_HEAD_SIZE + len;
+		free -= BULK_HEAD_SIZE + len;
+	}
+	if(count == 0) return;
+
+	// One SEND setup for the batch, the destination written once
+	if((ret = sendto_multi(BULK_SOCKET, dgs, count)) < 0) ret = 0;
+	bulk_stats.sent += ret;
+
+	// Those the chip didn't take go out again first
+	for(i = ret; i < count; i++) bulk.resend[(chunks[i] - bulk.base) / 32] |= 1UL << ((chunks[i] - bulk.base) % 32);
+}
+
+/**
+ @brief	the next chunk to send, the ones to send again first
+ @return the chunk, -1 if none until the next STATUS
+ */
+static int32_t bulk_next_chunk(void)
+{
+	uint32_t i, bit;
+
+	for(i = 0; i < BULK_WINDOW_WORDS; i++)
+	{
+		if(!bulk.resend[i]) continue;
+
+		bit = __builtin_ctz(bulk.resend[i]);
+		bulk.resend[i] &= ~(1UL << bit);
+		bulk_stats.resent++;
+		return (int32_t)(bulk.base + 32 * i + bit);
+	}
+
+	if((bulk.next < bulk.chunks) && (bulk.next - bulk.base < BULK_WINDOW)) return (int32_t)bulk.next++;
+
+	return -1;
+}
+
+static void bulk_finish(uint8_t code, uint8_t reply)
+{
+	if(code != BULK_END_OK) bulk_stats.aborted++;
+	if(reply) bulk_send_end(bulk.addr, bulk.port, bulk.session, code);
+	bulk.active = 0;
+}
+
+static void bulk_send_end(uint8_t * addr, uint16_t port, uint32_t session, uint8_t code)
+{
+	uint8_t msg[BULK_HEAD_SIZE];
+
+	// Not sent again if the chip has no room, the host times out
+	bulk_head(msg, BULK_END, 0, session, 0, code);
+	sendto(BULK_SOCKET, msg, sizeof(msg), addr, port);
+}
+
+static void bulk_head(uint8_t * buf, uint8_t type, uint8_t source, uint32_t session, uint32_t seq, uint32_t arg)
+{
+	bulk_put32(buf, BULK_MAGIC);
+	buf[4] = type;
+	buf[5] = source;
+	buf[6] = 0;
+	buf[7] = 0;
+	bulk_put32(buf + 8, session);
+	bulk_put32(buf + 12, seq);
+	bulk_put32(buf + 16, arg);
+}
+
+static uint8_t bulk_peer(uint32_t session, uint8_t * addr, uint16_t port)
+{
+	return (session == bulk.session) && (port == bulk.port) && !memcmp(addr, bulk.addr, 4);
+}
+
+static uint32_t bulk_get32(const uint8_t * buf)
+{
+	return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | buf[3];
+}
+
+static void bulk_put32(uint8_t * buf, uint32_t val)
+{
+	buf[0] = (uint8_t)(val >> 24);
+	buf[1] = (uint8_t)(val >> 16);
+	buf[2] = (uint8_t)(val >> 8);
+	buf[3] = (uint8_t)val;
+}
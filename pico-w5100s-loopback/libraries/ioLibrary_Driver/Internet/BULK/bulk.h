@@ -0,0 +1,146 @@
+/**
+ @file		bulk.h
+ @brief 	Reliable bulk transfer over UDP, the board sending a log, a firmware image or any
+ 			other source to a host that asks for it.
+
+ TCP on the W5100S is held back by its window, no more than the socket buffer, and by the
+ round trips of send(). A transfer here goes out as sequenced datagrams, several written
+ to the chip per sendto_multi(), paced to a rate and limited by a window of chunks. The
+ receiver reports, every few ms, the chunks it has in order and a bitmap of the missing
+ ones after them, and those are sent again. The receiver is tools/bulk_recv.py.
+
+ Every datagram starts with a header of BULK_HEAD_SIZE bytes, big endian:
+ 	magic 'BULK', type, source, 2 bytes of 0, session, seq, arg
+ - REQ    host to board: asks for source, seq 0, arg the rate limit in kbit/s (0 for the board's)
+ - DATA   board to host: chunk seq of BULK_CHUNK_SIZE bytes at seq * BULK_CHUNK_SIZE,
+ 		  arg the size of the transfer, the last chunk is shorter or empty
+ - STATUS host to board: seq the chunks received in order, arg 0, then BULK_WINDOW bits of
+ 		  the chunks to send again from seq on, from the first word's bit 0. The host sets
+ 		  the bit of a missing chunk once, and again only if the resend doesn't come either
+ - END    either way: the transfer is over, arg BULK_END_xxx
+ */
+
+#ifndef	_BULK_H_
+#define	_BULK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * @brief Define it for Debug & Monitor BULK processing.
+ * @note If defined, it dependens on <stdio.h>
+ */
+//#define _BULK_DEBUG_
+
+#define BULK_PORT			5011		///< UDP port of the board
+
+#define BULK_MAGIC			0x42554C4B	///< 'BULK'
+#define BULK_HEAD_SIZE		20
+#define BULK_CHUNK_SIZE		1024		///< Data of a DATA datagram, the last one shorter
+
+/* Types */
+#define BULK_REQ			1
+#define BULK_DATA			2
+#define BULK_STATUS			3
+#define BULK_END			4
+
+/* arg of END */
+#define BULK_END_OK			0			///< Every chunk was received
+#define BULK_END_CANCEL		1			///< The host gave up
+#define BULK_END_NOSOURCE	2			///< No such source registered
+#define BULK_END_BUSY		3			///< Another transfer is in progress
+#define BULK_END_TIMEOUT	4			///< No STATUS for BULK_TIMEOUT_MS
+#define BULK_END_READ		5			///< The source failed to read
+
+#define BULK_SOURCE_MAX		4			///< Sources registered with BULK_source()
+
+/* Chunks sent ahead of the ones received in order, the bits of a STATUS */
+#define BULK_WINDOW			128
+
+/* Datagrams built and written to the chip by one sendto_multi(), the buffer of BULK_init() holds them */
+#ifndef BULK_BATCH
+#define BULK_BATCH			4
+#endif
+
+#define BULK_BUF_SIZE		(BULK_BATCH * (BULK_HEAD_SIZE + BULK_CHUNK_SIZE))
+
+/* Rate of the datagrams, headers included. It starts at the limit, is cut by a quarter
+   when a STATUS reports new losses, at most once per window in flight, and goes back up by
+   BULK_RATE_STEP_KBPS for each STATUS that reports none */
+#ifndef BULK_RATE_KBPS
+#define BULK_RATE_KBPS		20000		///< Limit when the REQ leaves it to the board
+#endif
+
+#ifndef BULK_RATE_MIN_KBPS
+#define BULK_RATE_MIN_KBPS	500
+#endif
+
+#ifndef BULK_RATE_STEP_KBPS
+#define BULK_RATE_STEP_KBPS	250
+#endif
+
+/* A transfer the host doesn't report on for this long is dropped */
+#ifndef BULK_TIMEOUT_MS
+#define BULK_TIMEOUT_MS		2000
+#endif
+
+/**
+ * @brief A source of transfers
+ * @details size() is taken when a transfer is requested. read() is asked for any part of it
+ *          again for a resend, until the transfer ends: a log has to keep what it gave.
+ */
+typedef struct wiz_BulkSource_t
+{
+	uint32_t (*size)(void * arg);												///< Bytes of a transfer
+	int32_t (*read)(void * arg, uint32_t offset, uint8_t * buf, uint16_t len);	///< Bytes read at offset, < 0 on error
+	void * arg;
+}wiz_BulkSource;
+
+/**
+ * @brief Counters of the transfers
+ */
+typedef struct wiz_BulkStats_t
+{
+	uint32_t transfers;		///< Transfers started
+	uint32_t completed;		///< Ended with every chunk received
+	uint32_t aborted;		///< Cancelled, timed out or failed to read
+	uint32_t sent;			///< DATA datagrams, the resends included
+	uint32_t resent;		///< Chunks sent again, reported missing
+	uint32_t busy;			///< Runs the chip's TX buffer had no room for a datagram
+	uint32_t bytes;			///< Bytes of the transfers completed
+	uint32_t rate_kbps;		///< Rate of the transfer in progress
+}wiz_BulkStats;
+
+/**
+ * @brief Open the UDP socket of the transfers
+ * @param sn  Socket number, in non-block io mode after this
+ * @param buf BULK_BUF_SIZE bytes the datagrams are built in
+ */
+void BULK_init(uint8_t sn, uint8_t * buf);
+
+/**
+ * @brief Register a source, the id a REQ names
+ * @return 1 on success, 0 if id is out of range
+ */
+uint8_t BULK_source(uint8_t id, const wiz_BulkSource * source);
+
+/**
+ * @brief Take the REQs and STATUSes received and send what the rate and the window allow.
+ *        Call it as often as the application loop goes round, it doesn't wait.
+ * @return 1 while a transfer is in progress, 0 when idle
+ */
+uint8_t BULK_run(void);
+
+/**
+ * @brief Copy the counters
+ */
+void BULK_get_stats(wiz_BulkStats * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _BULK_H_ */
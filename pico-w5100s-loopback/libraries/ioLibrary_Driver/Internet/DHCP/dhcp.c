@@ -67,6 +67,7 @@
 #define STATE_DHCP_REREQUEST     4        ///< send REQUEST for maintaining leased IP
 #define STATE_DHCP_RELEASE       5        ///< No use
 #define STATE_DHCP_STOP          6        ///< Stop processing DHCP
+#define STATE_DHCP_REBOOT        7        ///< send REQUEST for the lease before a reset and wait ACK or NACK
 
 #define DHCP_FLAGSBROADCAST      0x8000   ///< The broadcast value of flags in @ref RIP_MSG 
 #define DHCP_FLAGSUNICAST        0x0000   ///< The unicast   value of flags in @ref RIP_MSG
@@ -208,7 +209,12 @@ int8_t   dhcp_retry_count  = 0;
 
 uint32_t dhcp_lease_time   			= INFINITE_LEASETIME;
 volatile uint32_t dhcp_tick_1s      = 0;                 // unit 1 second
-uint32_t dhcp_tick_next    			= DHCP_WAIT_TIME ;
+volatile uint32_t dhcp_tick_ms      = 0;                 // unit 1 millisecond, for retransmission
+volatile uint32_t dhcp_tick_ms_1s   = 0;                 // milliseconds not yet counted in dhcp_tick_1s
+uint32_t dhcp_tick_next    			= DHCP_WAIT_TIME * 1000; // unit 1 millisecond
+
+wiz_DhcpLease dhcp_lease;               // Lease loaded by DHCP_init() or last saved
+uint8_t  dhcp_reboot       = 0;         // 1 : INIT-REBOOT with dhcp_lease from STATE_DHCP_INIT
 
 uint32_t DHCP_XID;      // Any number
 
@@ -230,6 +236,12 @@ void (*dhcp_ip_conflict)(void) = default_ip_conflict;   /* handler to be called
 
 void reg_dhcp_cbfunc(void(*ip_assign)(void), void(*ip_update)(void), void(*ip_conflict)(void));
 
+/* Lease storage handler, no INIT-REBOOT without them */
+uint8_t (*dhcp_lease_load)(wiz_DhcpLease* lease)       = 0;
+void    (*dhcp_lease_save)(const wiz_DhcpLease* lease) = 0;
+
+void reg_dhcp_lease_cbfunc(uint8_t(*lease_load)(wiz_DhcpLease* lease), void(*lease_save)(const wiz_DhcpLease* lease));
+
 char NibbleToHex(uint8_t nibble);
     
 /* send DISCOVER message to DHCP server */
@@ -250,6 +262,12 @@ uint8_t  check_DHCP_timeout(void);
 /* Initialize to timeout process.  */
 void     reset_DHCP_timeout(void);
 
+/* Retransmission wait of the current state, unit 1 millisecond */
+uint32_t wait_DHCP_timeout(void);
+
+/* Save the leased IP by the lease_save callback if it changed */
+void     save_DHCP_lease(void);
+
 /* Parse message as OFFER and ACK and NACK from DHCP server.*/
 int8_t   parseDHCPCMSG(void);
 
@@ -291,6 +309,13 @@ void reg_dhcp_cbfunc(void(*ip_assign)(void), void(*ip_update)(void), void(*ip_co
    if(ip_conflict) dhcp_ip_conflict = ip_conflict;
 }
 
+/* register the lease storage call back func. */
+void reg_dhcp_lease_cbfunc(uint8_t(*lease_load)(wiz_DhcpLease* lease), void(*lease_save)(const wiz_DhcpLease* lease))
+{
+   dhcp_lease_load = lease_load;
+   dhcp_lease_save = lease_save;
+}
+
 /* make the common DHCP message */
 void makeDHCPMSG(void)
 {
@@ -479,12 +504,16 @@ void send_DHCP_REQUEST(void)
 		pDHCPMSG->OPT[k++] = DHCP_allocated_ip[2];
 		pDHCPMSG->OPT[k++] = DHCP_allocated_ip[3];
 	
-		pDHCPMSG->OPT[k++] = dhcpServerIdentifier;
-		pDHCPMSG->OPT[k++] = 0x04;
-		pDHCPMSG->OPT[k++] = DHCP_SIP[0];
-		pDHCPMSG->OPT[k++] = DHCP_SIP[1];
-		pDHCPMSG->OPT[k++] = DHCP_SIP[2];
-		pDHCPMSG->OPT[k++] = DHCP_SIP[3];
+		// INIT-REBOOT MUST NOT fill in the server identifier (cf. RFC2131 4.3.2)
+		if(dhcp_state != STATE_DHCP_REBOOT)
+		{
+			pDHCPMSG->OPT[k++] = dhcpServerIdentifier;
+			pDHCPMSG->OPT[k++] = 0x04;
+			pDHCPMSG->OPT[k++] = DHCP_SIP[0];
+			pDHCPMSG->OPT[k++] = DHCP_SIP[1];
+			pDHCPMSG->OPT[k++] = DHCP_SIP[2];
+			pDHCPMSG->OPT[k++] = DHCP_SIP[3];
+		}
 	}
 
 	// host name
@@ -707,6 +736,7 @@ uint8_t DHCP_run(void)
 {
 	uint8_t  type;
 	uint8_t  ret;
+	uint8_t  i;
 
 	if(dhcp_state == STATE_DHCP_STOP) return DHCP_STOPPED;
 
@@ -718,6 +748,20 @@ uint8_t DHCP_run(void)
 
 	switch ( dhcp_state ) {
 	   case STATE_DHCP_INIT     :
+         if(dhcp_reboot)
+         {
+            dhcp_reboot = 0;
+            // any server may answer, option 54 of the ACK sets DHCP_SIP
+            for(i = 0; i < 4; i++) DHCP_SIP[i] = DHCP_REAL_SIP[i] = 0;
+            DHCP_allocated_ip[0] = dhcp_lease.ip[0];
+            DHCP_allocated_ip[1] = dhcp_lease.ip[1];
+            DHCP_allocated_ip[2] = dhcp_lease.ip[2];
+            DHCP_allocated_ip[3] = dhcp_lease.ip[3];
+            dhcp_state = STATE_DHCP_REBOOT;
+            reset_DHCP_timeout();
+            send_DHCP_REQUEST();
+            break;
+         }
          DHCP_allocated_ip[0] = 0;
          DHCP_allocated_ip[1] = 0;
          DHCP_allocated_ip[2] = 0;
@@ -749,6 +793,7 @@ uint8_t DHCP_run(void)
 				if (check_DHCP_leasedIP()) {
 					// Network info assignment from DHCP
 					dhcp_ip_assign();
+					save_DHCP_lease();
 					reset_DHCP_timeout();
 
 					dhcp_state = STATE_DHCP_LEASED;
@@ -770,6 +815,42 @@ uint8_t DHCP_run(void)
 			} else ret = check_DHCP_timeout();
 		break;
 
+		case STATE_DHCP_REBOOT :
+			if (type == DHCP_ACK) {
+
+#ifdef _DHCP_DEBUG_
+				printf("> Receive DHCP_ACK of the INIT-REBOOT\r\n");
+#endif
+				// The IP address was leased before the reset, no ARP probe
+				if((DHCP_SIP[0] | DHCP_SIP[1] | DHCP_SIP[2] | DHCP_SIP[3]) == 0)
+				{
+					DHCP_SIP[0] = dhcp_lease.sip[0];
+					DHCP_SIP[1] = dhcp_lease.sip[1];
+					DHCP_SIP[2] = dhcp_lease.sip[2];
+					DHCP_SIP[3] = dhcp_lease.sip[3];
+				}
+				dhcp_ip_assign();
+				save_DHCP_lease();
+				reset_DHCP_timeout();
+
+				dhcp_state = STATE_DHCP_LEASED;
+			} else if (type == DHCP_NAK) {
+
+#ifdef _DHCP_DEBUG_
+				printf("> Receive DHCP_NACK, the lease before the reset is not valid\r\n");
+#endif
+				DHCP_allocated_ip[0] = 0;
+				DHCP_allocated_ip[1] = 0;
+				DHCP_allocated_ip[2] = 0;
+				DHCP_allocated_ip[3] = 0;
+				save_DHCP_lease();
+
+				send_DHCP_DISCOVER();
+				dhcp_state = STATE_DHCP_DISCOVER;
+				reset_DHCP_timeout();
+			} else ret = check_DHCP_timeout();
+		break;
+
 		case STATE_DHCP_LEASED :
 		   ret = DHCP_IP_LEASED;
 			if ((dhcp_lease_time != INFINITE_LEASETIME) && ((dhcp_lease_time/2) < dhcp_tick_1s)) {
@@ -798,6 +879,7 @@ uint8_t DHCP_run(void)
 		   ret = DHCP_IP_LEASED;
 			if (type == DHCP_ACK) {
 				dhcp_retry_count = 0;
+				save_DHCP_lease();
 				if (OLD_allocated_ip[0] != DHCP_allocated_ip[0] || 
 				    OLD_allocated_ip[1] != DHCP_allocated_ip[1] ||
 				    OLD_allocated_ip[2] != DHCP_allocated_ip[2] ||
@@ -843,8 +925,8 @@ uint8_t check_DHCP_timeout(void)
 {
 	uint8_t ret = DHCP_RUNNING;
 	
-	if (dhcp_retry_count < MAX_DHCP_RETRY) {
-		if (dhcp_tick_next < dhcp_tick_1s) {
+	if (dhcp_retry_count < ((dhcp_state == STATE_DHCP_REBOOT) ? MAX_DHCP_REBOOT_RETRY : MAX_DHCP_RETRY)) {
+		if (dhcp_tick_next < dhcp_tick_ms) {
 
 			switch ( dhcp_state ) {
 				case STATE_DHCP_DISCOVER :
@@ -863,13 +945,17 @@ uint8_t check_DHCP_timeout(void)
 					
 					send_DHCP_REQUEST();
 				break;
+
+				case STATE_DHCP_REBOOT :
+					send_DHCP_REQUEST();
+				break;
 		
 				default :
 				break;
 			}
 
-			dhcp_tick_1s = 0;
-			dhcp_tick_next = dhcp_tick_1s + DHCP_WAIT_TIME;
+			dhcp_tick_ms = 0;
+			dhcp_tick_next = wait_DHCP_timeout();
 			dhcp_retry_count++;
 		}
 	} else { // timeout occurred
@@ -881,6 +967,7 @@ uint8_t check_DHCP_timeout(void)
 				break;
 			case STATE_DHCP_REQUEST:
 			case STATE_DHCP_REREQUEST:
+			case STATE_DHCP_REBOOT:
 				send_DHCP_DISCOVER();
 				dhcp_state = STATE_DHCP_DISCOVER;
 				break;
@@ -930,6 +1017,7 @@ int8_t check_DHCP_leasedIP(void)
 void DHCP_init(uint8_t s, uint8_t * buf)
 {
    uint8_t zeroip[4] = {0,0,0,0};
+   uint8_t i;
    getSHAR(DHCP_CHADDR);
    if((DHCP_CHADDR[0] | DHCP_CHADDR[1]  | DHCP_CHADDR[2] | DHCP_CHADDR[3] | DHCP_CHADDR[4] | DHCP_CHADDR[5]) == 0x00)
    {
@@ -956,6 +1044,21 @@ void DHCP_init(uint8_t s, uint8_t * buf)
 	setSIPR(zeroip);
 	setGAR(zeroip);
 
+	// INIT-REBOOT with the lease of this MAC address before the reset
+	dhcp_reboot = 0;
+	if(dhcp_lease_load && dhcp_lease_load(&dhcp_lease))
+	{
+		if( (dhcp_lease.mac[0] == DHCP_CHADDR[0]) && (dhcp_lease.mac[1] == DHCP_CHADDR[1]) &&
+		    (dhcp_lease.mac[2] == DHCP_CHADDR[2]) && (dhcp_lease.mac[3] == DHCP_CHADDR[3]) &&
+		    (dhcp_lease.mac[4] == DHCP_CHADDR[4]) && (dhcp_lease.mac[5] == DHCP_CHADDR[5]) &&
+		    ((dhcp_lease.ip[0] | dhcp_lease.ip[1] | dhcp_lease.ip[2] | dhcp_lease.ip[3]) != 0) )
+			dhcp_reboot = 1;
+	}
+	else
+	{
+		for(i = 0; i < sizeof(dhcp_lease); i++) ((uint8_t*)&dhcp_lease)[i] = 0;
+	}
+
 	reset_DHCP_timeout();
 	dhcp_state = STATE_DHCP_INIT;
 }
@@ -965,13 +1068,56 @@ void DHCP_init(uint8_t s, uint8_t * buf)
 void reset_DHCP_timeout(void)
 {
 	dhcp_tick_1s = 0;
-	dhcp_tick_next = DHCP_WAIT_TIME;
+	dhcp_tick_ms = 0;
+	dhcp_tick_ms_1s = 0;
+	dhcp_tick_next = wait_DHCP_timeout();
 	dhcp_retry_count = 0;
 }
 
+uint32_t wait_DHCP_timeout(void)
+{
+	if(dhcp_state == STATE_DHCP_REBOOT) return DHCP_REBOOT_WAIT_TIME;
+	return DHCP_WAIT_TIME * 1000;
+}
+
+void save_DHCP_lease(void)
+{
+	wiz_DhcpLease lease;
+	uint8_t i;
+	uint8_t changed = 0;
+
+	if(dhcp_lease_save == 0) return;
+
+	for(i = 0; i < 6; i++) lease.mac[i] = DHCP_CHADDR[i];
+	for(i = 0; i < 4; i++) lease.ip[i]  = DHCP_allocated_ip[i];
+	for(i = 0; i < 4; i++) lease.sip[i] = DHCP_SIP[i];
+	lease.lease_time = dhcp_lease_time;
+
+	// a renewal of the same lease doesn't write it again
+	for(i = 0; i < 6; i++) if(lease.mac[i] != dhcp_lease.mac[i]) changed = 1;
+	for(i = 0; i < 4; i++) if(lease.ip[i]  != dhcp_lease.ip[i])  changed = 1;
+	for(i = 0; i < 4; i++) if(lease.sip[i] != dhcp_lease.sip[i]) changed = 1;
+	if(lease.lease_time != dhcp_lease.lease_time) changed = 1;
+	if(!changed) return;
+
+	dhcp_lease = lease;
+	dhcp_lease_save(&dhcp_lease);
+}
+
 void DHCP_time_handler(void)
 {
-	dhcp_tick_1s++;
+	DHCP_time_handler_ms(1000);
+}
+
+void DHCP_time_handler_ms(uint32_t ms)
+{
+	dhcp_tick_ms += ms;
+	dhcp_tick_ms_1s += ms;
+	while(dhcp_tick_ms_1s >= 1000)
+	{
+		dhcp_tick_ms_1s -= 1000;
+		dhcp_tick_1s++;
+	}
 }
 
 void getIPfromDHCP(uint8_t* ip)
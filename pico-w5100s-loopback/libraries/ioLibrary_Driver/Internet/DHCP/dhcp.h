@@ -62,6 +62,10 @@ extern "C" {
 #define	MAX_DHCP_RETRY          2        ///< Maximum retry count
 #define	DHCP_WAIT_TIME          10       ///< Wait Time 10s
 
+/* Retry to processing INIT-REBOOT with a lease loaded by @ref reg_dhcp_lease_cbfunc() */
+#define	MAX_DHCP_REBOOT_RETRY   2        ///< Maximum retry count before DISCOVER
+#define	DHCP_REBOOT_WAIT_TIME   500      ///< Wait Time 500ms
+
 
 /* UDP port numbers for DHCP */
 #define DHCP_SERVER_PORT      	67	      ///< DHCP server port number
@@ -85,8 +89,21 @@ enum
    DHCP_STOPPED      ///< Stop processing DHCP protocol
 };
 
+/*
+ * @brief Lease kept over a reset, refer to @ref reg_dhcp_lease_cbfunc()
+ */
+typedef struct wiz_DhcpLease_t
+{
+   uint8_t  mac[6];     ///< Client MAC address the lease is bound to
+   uint8_t  ip[4];      ///< Leased IP address, 0.0.0.0 for no lease
+   uint8_t  sip[4];     ///< DHCP server identifier
+   uint32_t lease_time; ///< Lease time of the last ACK, unit 1s
+} wiz_DhcpLease;
+
 /*
  * @brief DHCP client initialization (outside of the main loop)
+ * @details With a lease from the lease_load callback of @ref reg_dhcp_lease_cbfunc() for the current MAC address,
+ *          DHCP_run() starts in INIT-REBOOT and requests that IP address without DISCOVER (cf. RFC2131 3.2).
  * @param s   - socket number
  * @param buf - buffer for processing DHCP message
  */
@@ -94,10 +111,18 @@ void DHCP_init(uint8_t s, uint8_t * buf);
 
 /*
  * @brief DHCP 1s Tick Timer handler
- * @note SHOULD BE register to your system 1s Tick timer handler 
+ * @note SHOULD BE register to your system 1s Tick timer handler, or call @ref DHCP_time_handler_ms()
  */
 void DHCP_time_handler(void);
 
+/*
+ * @brief DHCP Tick Timer handler of any period
+ * @details The retransmission timers have a resolution of the period, the INIT-REBOOT waits @ref DHCP_REBOOT_WAIT_TIME.
+ * @param ms - milliseconds elapsed since the last call
+ * @note Call it instead of @ref DHCP_time_handler() from your system Tick timer handler
+ */
+void DHCP_time_handler_ms(uint32_t ms);
+
 /* 
  * @brief Register call back function 
  * @param ip_assign   - callback func when IP is assigned from DHCP server first
@@ -106,6 +131,15 @@ void DHCP_time_handler(void);
  */
 void reg_dhcp_cbfunc(void(*ip_assign)(void), void(*ip_update)(void), void(*ip_conflict)(void));
 
+/*
+ * @brief Register the lease storage call back function
+ * @details lease_save is called when an ACK changes the lease, and with a lease of IP 0.0.0.0 when the server NAKs it.
+ * @param lease_load  - callback func filling the lease saved before a reset, returns 1 if there was one. Called by DHCP_init().
+ * @param lease_save  - callback func keeping the lease over a reset, in flash for example.
+ * @note Call it before DHCP_init()
+ */
+void reg_dhcp_lease_cbfunc(uint8_t(*lease_load)(wiz_DhcpLease* lease), void(*lease_save)(const wiz_DhcpLease* lease));
+
 /*
  * @brief DHCP client in the main loop
  * @return    The value is as the follow \n
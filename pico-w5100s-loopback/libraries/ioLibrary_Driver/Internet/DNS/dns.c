@@ -115,12 +115,40 @@ struct dhdr
 };
 
 
+/* Query of DNS_query() */
+struct dns_query
+{
+	uint8_t  state;      /* State of the query */
+#define	QUERY_FREE     0
+#define	QUERY_RUNNING  1
+#define	QUERY_DONE     2
+#define	QUERY_FAILED   3
+	uint8_t  retry;      /* Requery count */
+	uint16_t id;         /* Message ID of the query */
+	uint32_t sent;       /* dns_1s_tick of the last send */
+	uint8_t  server[4];  /* DNS server ip */
+	uint8_t  ip[4];      /* IP address from DNS server */
+	char     name[MAX_DOMAIN_NAME];
+};
+
+/* Answer kept for its TTL */
+struct dns_cache
+{
+	uint32_t expire;     /* dns_1s_tick the TTL ends, 0 : free entry */
+	uint32_t used;       /* dns_cache_use of the last lookup */
+	uint8_t  ip[4];
+	char     name[DNS_CACHE_NAME];
+};
+
 uint8_t* pDNSMSG;       // DNS message buffer
 uint8_t  DNS_SOCKET;    // SOCKET number for DNS
 uint16_t DNS_MSGID;     // DNS message ID
 
-uint32_t dns_1s_tick;   // for timout of DNS processing
-static uint8_t retry_count;
+uint32_t dns_1s_tick;   // for timout of DNS processing and the TTL of the cache
+
+static struct dns_query dns_queries[DNS_MAX_QUERY];
+static struct dns_cache dns_caches[DNS_CACHE_SIZE];
+static uint32_t dns_cache_use;   // LRU clock of the cache
 
 /* converts uint16_t from network buffer to a host byte order integer. */
 uint16_t get16(uint8_t * s)
@@ -233,13 +261,16 @@ uint8_t * dns_question(uint8_t * msg, uint8_t * cp)
  *              PARSE ANSER SECTION
  *
  * Description : This function parses the answer record of the reply message.
- * Arguments   : msg - is a pointer to the reply message
- *               cp  - is a pointer to the answer record.
+ * Arguments   : msg   - is a pointer to the reply message
+ *               cp    - is a pointer to the answer record.
+ *               ttl   - is lowered to the TTL of the record.
+ *               found - is set to 1 by an address record.
  * Returns     : a pointer the to next record.
  */
-uint8_t * dns_answer(uint8_t * msg, uint8_t * cp, uint8_t * ip_from_dns)
+uint8_t * dns_answer(uint8_t * msg, uint8_t * cp, uint8_t * ip_from_dns, uint32_t * ttl, uint8_t * found)
 {
 	int len, type;
+	uint32_t rttl;
 	char name[MAXCNAME];
 
 	len = parse_name(msg, cp, name, MAXCNAME);
@@ -250,14 +281,19 @@ uint8_t * dns_answer(uint8_t * msg, uint8_t * cp, uint8_t * ip_from_dns)
 	type = get16(cp);
 	cp += 2;		/* type */
 	cp += 2;		/* class */
+	rttl = ((uint32_t)get16(cp) << 16) | get16(cp + 2);
 	cp += 4;		/* ttl */
 	cp += 2;		/* len */
 
+	/* The chain of CNAME up to the address is valid as long as its shortest TTL (cf. RFC2181 8) */
+	if (rttl & 0x80000000) rttl = 0;
+	if (rttl < *ttl) *ttl = rttl;
 
 	switch (type)
 	{
 	case TYPE_A:
 		/* Just read the address directly into the structure */
+		*found = 1;
 		ip_from_dns[0] = *cp++;
 		ip_from_dns[1] = *cp++;
 		ip_from_dns[2] = *cp++;
@@ -327,17 +363,18 @@ uint8_t * dns_answer(uint8_t * msg, uint8_t * cp, uint8_t * ip_from_dns)
  * Description : This function parses the reply message from DNS server.
  * Arguments   : dhdr - is a pointer to the header for DNS message
  *               buf  - is a pointer to the reply message.
- *               len  - is the size of reply message.
+ *               ttl  - is the TTL of the address, unit 1s.
  * Returns     : -1 - Domain name lenght is too big
- *                0 - Fail (Timout or parse error)
+ *                0 - Fail (Timout or parse error, or no address)
  *                1 - Success,
  */
-int8_t parseDNSMSG(struct dhdr * pdhdr, uint8_t * pbuf, uint8_t * ip_from_dns)
+int8_t parseDNSMSG(struct dhdr * pdhdr, uint8_t * pbuf, uint8_t * ip_from_dns, uint32_t * ttl)
 {
 	uint16_t tmp;
 	uint16_t i;
 	uint8_t * msg;
 	uint8_t * cp;
+	uint8_t found = 0;
 
 	msg = pbuf;
 	memset(pdhdr, 0, sizeof(*pdhdr));
@@ -362,6 +399,7 @@ int8_t parseDNSMSG(struct dhdr * pdhdr, uint8_t * pbuf, uint8_t * ip_from_dns)
 
 	/* Now parse the variable length sections */
 	cp = &msg[12];
+	*ttl = 0xFFFFFFFF;
 
 	/* Question section */
 	for (i = 0; i < pdhdr->qdcount; i++)
@@ -376,7 +414,7 @@ int8_t parseDNSMSG(struct dhdr * pdhdr, uint8_t * pbuf, uint8_t * ip_from_dns)
 	/* Answer section */
 	for (i = 0; i < pdhdr->ancount; i++)
 	{
-		cp = dns_answer(msg, cp, ip_from_dns);
+		cp = dns_answer(msg, cp, ip_from_dns, ttl, &found);
    #ifdef _DNS_DEUBG_
       printf("MAX_DOMAIN_NAME is too small, it should be redfine in dns.h");
    #endif
@@ -395,7 +433,7 @@ int8_t parseDNSMSG(struct dhdr * pdhdr, uint8_t * pbuf, uint8_t * ip_from_dns)
 		;
 	}
 
-	if(pdhdr->rcode == 0) return 1;		// No error
+	if((pdhdr->rcode == 0) && found) return 1;		// No error
 	else return 0;
 }
 
@@ -405,24 +443,27 @@ int8_t parseDNSMSG(struct dhdr * pdhdr, uint8_t * pbuf, uint8_t * ip_from_dns)
  *
  * Description : This function makes DNS query message.
  * Arguments   : op   - Recursion desired
+ *               id   - is the message ID.
  *               name - is a pointer to the domain name.
  *               buf  - is a pointer to the buffer for DNS message.
  *               len  - is the MAX. size of buffer.
- * Returns     : the pointer to the DNS message.
+ * Returns     : the length of the DNS message, -1 if the name doesn't fit.
  */
-int16_t dns_makequery(uint16_t op, char * name, uint8_t * buf, uint16_t len)
+int16_t dns_makequery(uint16_t op, uint16_t id, char * name, uint8_t * buf, uint16_t len)
 {
 	uint8_t *cp;
 	char *cp1;
-	char sname[MAXCNAME];
 	char *dname;
 	uint16_t p;
 	uint16_t dlen;
 
+	/* header, a length byte more than the name, the root and type and class */
+	dlen = strlen(name);
+	if ((dlen >= MAX_DOMAIN_NAME) || ((12 + 1 + dlen + 1 + 4) > len)) return -1;
+
 	cp = buf;
 
-	DNS_MSGID++;
-	cp = put16(cp, DNS_MSGID);
+	cp = put16(cp, id);
 	p = (op << 11) | 0x0100;			/* Recursion desired */
 	cp = put16(cp, p);
 	cp = put16(cp, 1);
@@ -430,9 +471,7 @@ int16_t dns_makequery(uint16_t op, char * name, uint8_t * buf, uint16_t len)
 	cp = put16(cp, 0);
 	cp = put16(cp, 0);
 
-	strcpy(sname, name);
-	dname = sname;
-	dlen = strlen(dname);
+	dname = name;
 	for (;;)
 	{
 		/* Look for next dot */
@@ -441,6 +480,8 @@ int16_t dns_makequery(uint16_t op, char * name, uint8_t * buf, uint16_t len)
 		if (cp1 != NULL) len = cp1 - dname;	/* More to come */
 		else len = dlen;			/* Last component */
 
+		if (len > 63) return -1;		/* Label too long (cf. RFC1035 2.3.4) */
+
 		*cp++ = len;				/* Write length of component */
 		if (len == 0) break;
 
@@ -463,32 +504,119 @@ int16_t dns_makequery(uint16_t op, char * name, uint8_t * buf, uint16_t len)
 }
 
 /*
- *              CHECK DNS TIMEOUT
+ *              CACHE OF THE ANSWERS
  *
- * Description : This function check the DNS timeout
- * Arguments   : None.
- * Returns     : -1 - timeout occurred, 0 - timer over, but no timeout, 1 - no timer over, no timeout occur
- * Note        : timeout : retry count and timer both over.
+ * Description : These functions keep the answers for their TTL. Names are compared regardless
+ *               of the case, the least recently used entry is replaced when the cache is full.
  */
+static int8_t dns_name_equal(char * a, char * b)
+{
+	char ca, cb;
+
+	do {
+		ca = *a++;
+		cb = *b++;
+		if ((ca >= 'A') && (ca <= 'Z')) ca += 'a' - 'A';
+		if ((cb >= 'A') && (cb <= 'Z')) cb += 'a' - 'A';
+		if (ca != cb) return 0;
+	} while (ca != 0);
+
+	return 1;
+}
+
+static int8_t dns_cache_valid(struct dns_cache * pc)
+{
+	if (pc->expire == 0) return 0;
+
+	if ((int32_t)(pc->expire - dns_1s_tick) <= 0)
+	{
+		pc->expire = 0;	/* TTL over */
+		return 0;
+	}
+
+	return 1;
+}
+
+static int8_t dns_cache_lookup(char * name, uint8_t * ip_from_dns)
+{
+	uint8_t i;
+
+	for (i = 0; i < DNS_CACHE_SIZE; i++)
+	{
+		if (!dns_cache_valid(&dns_caches[i]) || !dns_name_equal(dns_caches[i].name, name)) continue;
 
-int8_t check_DNS_timeout(void)
+		dns_caches[i].used = ++dns_cache_use;
+		memcpy(ip_from_dns, dns_caches[i].ip, 4);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void dns_cache_insert(char * name, uint8_t * ip, uint32_t ttl)
 {
+	uint8_t i;
+	uint8_t victim = 0;
 
-	if(dns_1s_tick >= DNS_WAIT_TIME)
+	if ((ttl == 0) || (strlen(name) >= DNS_CACHE_NAME)) return;
+
+	/* Same name, else a free entry, else the least recently used one */
+	for (i = 0; i < DNS_CACHE_SIZE; i++)
+		if (dns_cache_valid(&dns_caches[i]) && dns_name_equal(dns_caches[i].name, name)) break;
+
+	if (i == DNS_CACHE_SIZE)
 	{
-		dns_1s_tick = 0;
-		if(retry_count >= MAX_DNS_RETRY) {
-			retry_count = 0;
-			return -1; // timeout occurred
+		for (i = 0; i < DNS_CACHE_SIZE; i++)
+		{
+			if (dns_caches[i].expire == 0)
+			{
+				victim = i;
+				break;
+			}
+			if (dns_caches[i].used < dns_caches[victim].used) victim = i;
 		}
-		retry_count++;
-		return 0; // timer over, but no timeout
+		i = victim;
 	}
 
-	return 1; // no timer over, no timeout occur
+	strcpy(dns_caches[i].name, name);
+	memcpy(dns_caches[i].ip, ip, 4);
+	dns_caches[i].expire = dns_1s_tick + ttl;
+	if (dns_caches[i].expire == 0) dns_caches[i].expire = 1;
+	dns_caches[i].used = ++dns_cache_use;
 }
 
+void DNS_cache_flush(void)
+{
+	memset(dns_caches, 0, sizeof(dns_caches));
+}
 
+/*
+ *              SEND A QUERY
+ *
+ * Description : This function sends the query message, opening the DNS socket.
+ * Arguments   : pq - is a pointer to the query.
+ * Returns     : -1 - the name doesn't fit a query message, 0 - sent.
+ */
+static uint8_t dns_socket_open;	/* DNS_SOCKET opened by dns_send_query() */
+
+static int8_t dns_send_query(struct dns_query * pq)
+{
+	int16_t len;
+
+	len = dns_makequery(0, pq->id, pq->name, pDNSMSG, MAX_DNS_BUF_SIZE);
+	if (len < 0) return -1;
+
+	if (!dns_socket_open)
+	{
+		socket(DNS_SOCKET, Sn_MR_UDP, 0, 0);
+		dns_socket_open = 1;
+	}
+
+	sendto(DNS_SOCKET, pDNSMSG, len, pq->server, IPPORT_DOMAIN);
+	pq->sent = dns_1s_tick;
+
+	return 0;
+}
 
 /* DNS CLIENT INIT */
 void DNS_init(uint8_t s, uint8_t * buf)
@@ -496,64 +624,159 @@ void DNS_init(uint8_t s, uint8_t * buf)
 	DNS_SOCKET = s; // SOCK_DNS
 	pDNSMSG = buf; // User's shared buffer
 	DNS_MSGID = DNS_MSG_ID;
+	memset(dns_queries, 0, sizeof(dns_queries));
+	dns_socket_open = 0;
 }
 
 /* DNS CLIENT RUN */
 int8_t DNS_run(uint8_t * dns_ip, uint8_t * name, uint8_t * ip_from_dns)
 {
+	int8_t q;
 	int8_t ret;
-	struct dhdr dhp;
-	uint8_t ip[4];
-	uint16_t len, port;
-	int8_t ret_check_timeout;
 
-	retry_count = 0;
-	dns_1s_tick = 0;
+#ifdef _DNS_DEBUG_
+	printf("> DNS Query to DNS Server : %d.%d.%d.%d\r\n", dns_ip[0], dns_ip[1], dns_ip[2], dns_ip[3]);
+#endif
+
+	q = DNS_query(dns_ip, name);
+	if (q == -1) return -1;
+	if (q < 0) return 0;
 
-   // Socket open
-   socket(DNS_SOCKET, Sn_MR_UDP, 0, 0);
+	while ((ret = DNS_result(q, ip_from_dns)) == DNS_RUNNING)
+		DNS_process();
 
 #ifdef _DNS_DEBUG_
-	printf("> DNS Query to DNS Server : %d.%d.%d.%d\r\n", dns_ip[0], dns_ip[1], dns_ip[2], dns_ip[3]);
+	if (ret == 0) printf("> DNS Server is not responding : %d.%d.%d.%d\r\n", dns_ip[0], dns_ip[1], dns_ip[2], dns_ip[3]);
 #endif
 
-	len = dns_makequery(0, (char *)name, pDNSMSG, MAX_DNS_BUF_SIZE);
-	sendto(DNS_SOCKET, pDNSMSG, len, dns_ip, IPPORT_DOMAIN);
+	// Return value
+	// 0 > :  failed / 1 - success
+	return ret;
+}
+
+/* DNS CLIENT QUERY */
+int8_t DNS_query(uint8_t * dns_ip, uint8_t * name)
+{
+	int8_t q;
+	struct dns_query * pq;
+
+	if (strlen((char *)name) >= MAX_DOMAIN_NAME) return -1;
+
+	for (q = 0; q < DNS_MAX_QUERY; q++)
+		if (dns_queries[q].state == QUERY_FREE) break;
+
+	if (q == DNS_MAX_QUERY) return -2;
+
+	pq = &dns_queries[q];
+	strcpy(pq->name, (char *)name);
+	memcpy(pq->server, dns_ip, 4);
+	pq->retry = 0;
+
+	if (dns_cache_lookup(pq->name, pq->ip))
+	{
+		pq->state = QUERY_DONE;
+		return q;
+	}
+
+	pq->id = ++DNS_MSGID;
+	if (dns_send_query(pq) < 0) return -1;
+
+	pq->state = QUERY_RUNNING;
+
+	return q;
+}
+
+/* DNS CLIENT PROCESS */
+void DNS_process(void)
+{
+	struct dhdr dhp;
+	uint8_t ip[4];
+	uint8_t ip_from_dns[4];
+	uint16_t len, port, id;
+	uint32_t ttl;
+	uint8_t q;
+	uint8_t running;
+	struct dns_query * pq;
+
+	if (!dns_socket_open) return;
 
-	while (1)
+	while ((len = getSn_RX_RSR(DNS_SOCKET)) > 0)
 	{
-		if ((len = getSn_RX_RSR(DNS_SOCKET)) > 0)
+		if (len > MAX_DNS_BUF_SIZE) len = MAX_DNS_BUF_SIZE;
+		len = recvfrom(DNS_SOCKET, pDNSMSG, len, ip, &port);
+   #ifdef _DNS_DEBUG_
+	   printf("> Receive DNS message from %d.%d.%d.%d(%d). len = %d\r\n", ip[0], ip[1], ip[2], ip[3],port,len);
+   #endif
+		if ((len < 12) || (port != IPPORT_DOMAIN) || !(pDNSMSG[2] & 0x80)) continue;
+
+		/* The query in flight of this ID and server, a late answer finds none */
+		id = get16(&pDNSMSG[0]);
+		for (q = 0; q < DNS_MAX_QUERY; q++)
 		{
-			if (len > MAX_DNS_BUF_SIZE) len = MAX_DNS_BUF_SIZE;
-			len = recvfrom(DNS_SOCKET, pDNSMSG, len, ip, &port);
-      #ifdef _DNS_DEBUG_
-	      printf("> Receive DNS message from %d.%d.%d.%d(%d). len = %d\r\n", ip[0], ip[1], ip[2], ip[3],port,len);
-      #endif
-         ret = parseDNSMSG(&dhp, pDNSMSG, ip_from_dns);
-			break;
+			pq = &dns_queries[q];
+			if ((pq->state == QUERY_RUNNING) && (pq->id == id) && (memcmp(pq->server, ip, 4) == 0)) break;
 		}
-		// Check Timeout
-		ret_check_timeout = check_DNS_timeout();
-		if (ret_check_timeout < 0) {
+		if (q == DNS_MAX_QUERY) continue;
 
-#ifdef _DNS_DEBUG_
-			printf("> DNS Server is not responding : %d.%d.%d.%d\r\n", dns_ip[0], dns_ip[1], dns_ip[2], dns_ip[3]);
-#endif
-			close(DNS_SOCKET);
-			return 0; // timeout occurred
+		if (parseDNSMSG(&dhp, pDNSMSG, ip_from_dns, &ttl) == 1)
+		{
+			memcpy(pq->ip, ip_from_dns, 4);
+			dns_cache_insert(pq->name, pq->ip, ttl);
+			pq->state = QUERY_DONE;
 		}
-		else if (ret_check_timeout == 0) {
+		else pq->state = QUERY_FAILED;
+	}
+
+	// Check Timeout
+	running = 0;
+	for (q = 0; q < DNS_MAX_QUERY; q++)
+	{
+		pq = &dns_queries[q];
+		if (pq->state != QUERY_RUNNING) continue;
 
+		if ((dns_1s_tick - pq->sent) >= DNS_WAIT_TIME)
+		{
+			if (pq->retry >= MAX_DNS_RETRY)
+			{
+				pq->state = QUERY_FAILED; // timeout occurred
+				continue;
+			}
 #ifdef _DNS_DEBUG_
 			printf("> DNS Timeout\r\n");
 #endif
-			sendto(DNS_SOCKET, pDNSMSG, len, dns_ip, IPPORT_DOMAIN);
+			pq->retry++;
+			dns_send_query(pq);
 		}
+		running = 1;
+	}
+
+	if (!running)
+	{
+		close(DNS_SOCKET);
+		dns_socket_open = 0;
+	}
+}
+
+/* DNS CLIENT RESULT */
+int8_t DNS_result(int8_t q, uint8_t * ip_from_dns)
+{
+	struct dns_query * pq;
+
+	if ((q < 0) || (q >= DNS_MAX_QUERY)) return 0;
+
+	pq = &dns_queries[q];
+	switch (pq->state)
+	{
+	case QUERY_RUNNING:
+		return DNS_RUNNING;
+	case QUERY_DONE:
+		memcpy(ip_from_dns, pq->ip, 4);
+		pq->state = QUERY_FREE;
+		return 1;
+	default:
+		pq->state = QUERY_FREE;
+		return 0;
 	}
-	close(DNS_SOCKET);
-	// Return value
-	// 0 > :  failed / 1 - success
-	return ret;
 }
 
 
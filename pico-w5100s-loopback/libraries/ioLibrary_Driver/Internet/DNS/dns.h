@@ -62,13 +62,14 @@ extern "C" {
  */
 //#define _DNS_DEBUG_
 
-#define	MAX_DNS_BUF_SIZE	256		///< maximum size of DNS buffer. */
+#define	MAX_DNS_BUF_SIZE	512		///< maximum size of DNS buffer, a UDP DNS message. */
 /*
  * @brief Maxium length of your queried Domain name 
  * @todo SHOULD BE defined it equal as or greater than your Domain name lenght + null character(1)
  * @note SHOULD BE careful to stack overflow because it is allocated 1.5 times as MAX_DOMAIN_NAME in stack.
+ *       Each of the @ref DNS_MAX_QUERY queries keeps its name.
  */
-#define  MAX_DOMAIN_NAME   16       // for example "www.google.com"
+#define  MAX_DOMAIN_NAME   254      // 253 characters of a full domain name (cf. RFC1035 2.3.4)
 
 #define	MAX_DNS_RETRY     2        ///< Requery Count
 #define	DNS_WAIT_TIME     3        ///< Wait response time. unit 1s.
@@ -76,6 +77,17 @@ extern "C" {
 #define	IPPORT_DOMAIN     53       ///< DNS server port number
 
 #define DNS_MSG_ID         0x1122   ///< ID for DNS message. You can be modifyed it any number
+
+#define	DNS_MAX_QUERY     4        ///< Queries in flight on the DNS socket, refer to @ref DNS_query()
+
+/*
+ * @brief Answers kept for their TTL, the least recently used one is replaced
+ * @note Names of @ref DNS_CACHE_NAME or more characters are queried every time
+ */
+#define	DNS_CACHE_SIZE    16       ///< Cached names
+#define	DNS_CACHE_NAME    64       ///< Name size of a cache entry, with the null character
+
+#define	DNS_RUNNING       2        ///< @ref DNS_result() of a query waiting for the answer
 /*
  * @brief DNS process initialize
  * @param s   : Socket number for DNS
@@ -92,10 +104,47 @@ void DNS_init(uint8_t s, uint8_t * buf);
  * @return  -1 : failed. @ref MAX_DOMIN_NAME is too small \n
  *           0 : failed  (Timeout or Parse error)\n
  *           1 : success
- * @note This funtion blocks until success or fail. max time = @ref MAX_DNS_RETRY * @ref DNS_WAIT_TIME
+ * @note This funtion blocks until success or fail. max time = @ref MAX_DNS_RETRY * @ref DNS_WAIT_TIME \n
+ *       A cached answer returns at once. Queries of @ref DNS_query() in flight are processed meanwhile.
  */
 int8_t DNS_run(uint8_t * dns_ip, uint8_t * name, uint8_t * ip_from_dns);
 
+/*
+ * @brief Start a DNS query without waiting for the answer
+ * @details A cached answer completes the query at once, without a message. Else the query is sent with
+ *          its own message ID on the DNS socket, opened here and shared by all the queries in flight.
+ * @param dns_ip        : DNS server ip
+ * @param name          : Domain name to be queryed
+ * @return  0 ~ @ref DNS_MAX_QUERY - 1 : query number for @ref DNS_result() \n
+ *          -1 : failed. @ref MAX_DOMAIN_NAME is too small \n
+ *          -2 : failed. @ref DNS_MAX_QUERY queries are in flight
+ */
+int8_t DNS_query(uint8_t * dns_ip, uint8_t * name);
+
+/*
+ * @brief Receive the DNS answers and resend the queries timed out, without blocking
+ * @details The answers are matched with the queries by message ID and server, and cached.
+ *          The DNS socket is closed when no query is in flight.
+ * @note This function is called by you main task while queries are in flight.
+ */
+void DNS_process(void);
+
+/*
+ * @brief Get the result of a query of @ref DNS_query()
+ * @param q             : query number
+ * @param ip_from_dns   : IP address from DNS server
+ * @return  @ref DNS_RUNNING : no answer yet \n
+ *           0 : failed  (Timeout or Parse error)\n
+ *           1 : success
+ * @note The query number is free again once 0 or 1 is returned.
+ */
+int8_t DNS_result(int8_t q, uint8_t * ip_from_dns);
+
+/*
+ * @brief Forget all the cached answers
+ */
+void DNS_cache_flush(void);
+
 /*
  * @brief DNS 1s Tick Timer handler
  * @note SHOULD BE register to your system 1s Tick timer handler 
@@ -126,6 +126,30 @@ int fsprintf(uint8_t s, const char *format, ...)
 	return i;
 }
 
+/* send all of a chunk on the data socket, as much as the TX buffer has room for each time */
+static long send_data(uint8_t s, uint8_t * buf, uint32_t len)
+{
+	long ret;
+	uint32_t sent = 0;
+
+	while(sent < len)
+	{
+		ret = send(s, buf + sent, len - sent);
+		if(ret == SOCK_BUSY) continue;
+		if(ret < 0) return ret;
+		sent += ret;
+	}
+	return sent;
+}
+
+/* wait for the chunks queued on the data socket to be handed to the chip, before disconnecting */
+static void flush_data(uint8_t s)
+{
+#if _WIZCHIP_ == W5100S
+	while(send(s, NULL, 0) == SOCK_BUSY);
+#endif
+}
+
 void ftpd_init(uint8_t * src_ip)
 {
 	ftp.state = FTPS_NOT_LOGIN;
@@ -269,6 +293,13 @@ uint8_t ftpd_run(uint8_t * dbuf)
     		{
 #if defined(_FTP_DEBUG_)
     			printf("%d:FTP Data socket Connected\r\n", DATA_SOCK);
+#endif
+#if _WIZCHIP_ == W5100S
+    			{
+    				// send() queues the next chunk behind the SEND in progress, the next f_read() overlaps its transmission
+    				uint8_t sendmode = SOCK_SEND_STREAM;
+    				ctlsocket(DATA_SOCK, CS_SET_SENDMODE, &sendmode);
+    			}
 #endif
     			connect_state_data = 1;
     		}
@@ -292,7 +323,8 @@ uint8_t ftpd_run(uint8_t * dbuf)
     					size = sprintf(dbuf, "drwxr-xr-x 1 ftp ftp 0 Dec 31 2014 $Recycle.Bin\r\n-rwxr-xr-x 1 ftp ftp 512 Dec 31 2014 test.txt\r\n");
 #endif
     				size = strlen(dbuf);
-    				send(DATA_SOCK, dbuf, size);
+    				send_data(DATA_SOCK, dbuf, size);
+    				flush_data(DATA_SOCK);
     				ftp.current_cmd = NO_CMD;
     				disconnect(DATA_SOCK);
     				size = sprintf(dbuf, "226 Successfully transferred \"%s\"\r\n", ftp.workingdir);
@@ -315,22 +347,22 @@ uint8_t ftpd_run(uint8_t * dbuf)
 #if defined(_FTP_DEBUG_)
     						//printf("remained file size: %d\r\n", ftp.fil.fsize);
 #endif
-    						memset(dbuf, 0, _MAX_SS);
-
-    						if(remain_filesize > _MAX_SS)
-    							send_byte = _MAX_SS;
+    						// whole sectors are read by disk_read() straight into dbuf
+    						if(remain_filesize > FTP_DATA_CHUNK_SIZE)
+    							send_byte = FTP_DATA_CHUNK_SIZE;
     						else
     							send_byte = remain_filesize;
 
     						ftp.fr = f_read(&(ftp.fil), dbuf, send_byte , &blocklen);
-    						if(ftp.fr != FR_OK)
+    						if(ftp.fr != FR_OK || blocklen == 0)
     							break;
 #if defined(_FTP_DEBUG_)
     						printf("#");
     						//printf("----->fsize:%d recv:%d len:%d \r\n", remain_filesize, send_byte, blocklen);
     						//printf("----->fn:%s data:%s \r\n", ftp.filename, dbuf);
 #endif
-    						send(DATA_SOCK, dbuf, blocklen);
+    						if(send_data(DATA_SOCK, dbuf, blocklen) < 0)
+    							break;
     						remain_filesize -= blocklen;
     					}while(remain_filesize != 0);
 #if defined(_FTP_DEBUG_)
@@ -352,11 +384,13 @@ uint8_t ftpd_run(uint8_t * dbuf)
 
 						printf("########## dbuf:%s\r\n", dbuf);
 
-						send(DATA_SOCK, dbuf, blocklen);
+						if(send_data(DATA_SOCK, dbuf, blocklen) < 0)
+							break;
 						remain_filesize -= blocklen;
 					}while(remain_filesize != 0);
 
 #endif
+    				flush_data(DATA_SOCK);
     				ftp.current_cmd = NO_CMD;
     				disconnect(DATA_SOCK);
     				size = sprintf(dbuf, "226 Successfully transferred \"%s\"\r\n", ftp.filename);
@@ -377,10 +411,8 @@ uint8_t ftpd_run(uint8_t * dbuf)
     					while(1){
     						if((remain_datasize = getSn_RX_RSR(DATA_SOCK)) > 0){
     							while(1){
-    								memset(dbuf, 0, _MAX_SS);
-
-    								if(remain_datasize > _MAX_SS)
-    									recv_byte = _MAX_SS;
+    								if(remain_datasize > FTP_DATA_CHUNK_SIZE)
+    									recv_byte = FTP_DATA_CHUNK_SIZE;
     								else
     									recv_byte = remain_datasize;
 
@@ -34,6 +34,12 @@ extern "C" {
 #define _MAX_SS		512
 #endif
 
+/* Bytes read from the file and sent on the data socket at once, whole sectors, up to the
+ * socket TX buffer. The dbuf of ftpd_run() must hold as many. */
+#if !defined(FTP_DATA_CHUNK_SIZE)
+#define FTP_DATA_CHUNK_SIZE	_MAX_SS
+#endif
+
 #define CTRL_SOCK	2
 #define DATA_SOCK	3
 
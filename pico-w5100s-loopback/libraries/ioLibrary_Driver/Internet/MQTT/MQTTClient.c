@@ -15,6 +15,8 @@
  *******************************************************************************/
 #include "MQTTClient.h"
 
+#include <string.h>
+
 static void NewMessageData(MessageData* md, MQTTString* aTopicName, MQTTMessage* aMessage) {
     md->topicName = aTopicName;
     md->message = aMessage;
@@ -26,18 +28,19 @@ static int getNextPacketId(MQTTClient *c) {
 }
 
 
-static int sendPacket(MQTTClient* c, int length, Timer* timer)
+static int sendBuffer(MQTTClient* c, unsigned char* buf, int length, Timer* timer)
 {
     int rc = FAILURE,
         sent = 0;
 
-    while (sent < length && !TimerIsExpired(timer))
+    // tried once at least, an ack is sent from MQTTYield(c, 0) too
+    do
     {
-        rc = c->ipstack->mqttwrite(c->ipstack, &c->buf[sent], length, TimerLeftMS(timer));
+        rc = c->ipstack->mqttwrite(c->ipstack, &buf[sent], length - sent, TimerLeftMS(timer));
         if (rc < 0)  // there was an error writing the data
             break;
         sent += rc;
-    }
+    } while (sent < length && !TimerIsExpired(timer));
     if (sent == length)
     {
         TimerCountdown(&c->ping_timer, c->keepAliveInterval); // record the fact that we have successfully sent the packet
@@ -49,6 +52,65 @@ static int sendPacket(MQTTClient* c, int length, Timer* timer)
 }
 
 
+static int sendPacket(MQTTClient* c, int length, Timer* timer)
+{
+    return sendBuffer(c, c->buf, length, timer);
+}
+
+
+/* find the publish awaiting this ack, NULL if none */
+static struct InflightMessages* findInflight(MQTTClient* c, unsigned char ack, unsigned short id)
+{
+    unsigned int i;
+
+    for (i = 0; i < c->inflight_count; ++i)
+    {
+        struct InflightMessages* m = &c->inflight[(c->inflight_head + i) % MAX_INFLIGHT_MESSAGES];
+        if (m->id == id && m->ack == ack)
+            return m;
+    }
+    return NULL;
+}
+
+
+/* the publish is complete, its place is freed once the ones before are too */
+static void freeInflight(MQTTClient* c, struct InflightMessages* m)
+{
+    m->id = 0;
+    while (c->inflight_count > 0 && c->inflight[c->inflight_head].id == 0)
+    {
+        c->inflight_head = (c->inflight_head + 1) % MAX_INFLIGHT_MESSAGES;
+        c->inflight_count--;
+    }
+}
+
+
+static void clearInflight(MQTTClient* c)
+{
+    c->inflight_head = 0;
+    c->inflight_count = 0;
+}
+
+
+/* send the publishes and pubrels not acknowledged yet again, in their order */
+static int resendInflight(MQTTClient* c, Timer* timer)
+{
+    unsigned int i;
+    int rc = SUCCESSS;
+
+    for (i = 0; i < c->inflight_count && rc == SUCCESSS; ++i)
+    {
+        struct InflightMessages* m = &c->inflight[(c->inflight_head + i) % MAX_INFLIGHT_MESSAGES];
+        if (m->id == 0 || m->len == 0)
+            continue;
+        if (m->ack != PUBCOMP)
+            m->packet[0] |= 0x08; /* DUP, the PUBLISH was sent before */
+        rc = sendBuffer(c, m->packet, m->len, timer);
+    }
+    return rc;
+}
+
+
 void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeout_ms,
 		unsigned char* sendbuf, size_t sendbuf_size, unsigned char* readbuf, size_t readbuf_size)
 {
@@ -57,15 +119,22 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
 
     for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
         c->messageHandlers[i].topicFilter = 0;
+    c->topicNodeCount = 1;
+    c->topicNodes[0].child = -1;
+    c->topicNodes[0].handler = -1;
     c->command_timeout_ms = command_timeout_ms;
     c->buf = sendbuf;
     c->buf_size = sendbuf_size;
     c->readbuf = readbuf;
     c->readbuf_size = readbuf_size;
+    c->readbuf_len = 0;
+    c->readbuf_pkt = 0;
+    c->readbuf_skip = 0;
     c->isconnected = 0;
     c->ping_outstanding = 0;
     c->defaultMessageHandler = NULL;
 	c->next_packetid = 1;
+    clearInflight(c);
     TimerInit(&c->ping_timer);
 #if defined(MQTT_TASK)
 	MutexInit(&c->mutex);
@@ -73,7 +142,8 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
 }
 
 
-static int decodePacket(MQTTClient* c, int* value, int timeout)
+/* decode the remaining length from readbuf, returns its length in bytes, 0 if not received yet */
+static int decodePacket(MQTTClient* c, int* value)
 {
     unsigned char i;
     int multiplier = 1;
@@ -83,47 +153,78 @@ static int decodePacket(MQTTClient* c, int* value, int timeout)
     *value = 0;
     do
     {
-        int rc = MQTTPACKET_READ_ERROR;
-
         if (++len > MAX_NO_OF_REMAINING_LENGTH_BYTES)
-        {
-            rc = MQTTPACKET_READ_ERROR; /* bad data */
-            goto exit;
-        }
-        rc = c->ipstack->mqttread(c->ipstack, &i, 1, timeout);
-        if (rc != 1)
-            goto exit;
+            return MQTTPACKET_READ_ERROR; /* bad data */
+        if ((size_t)len >= c->readbuf_len)
+            return 0;
+        i = c->readbuf[len];
         *value += (i & 127) * multiplier;
         multiplier *= 128;
     } while ((i & 128) != 0);
-exit:
+
     return len;
 }
 
 
+/* drop n bytes from the start of readbuf */
+static void dropPacket(MQTTClient* c, size_t n)
+{
+    c->readbuf_len -= n;
+    memmove(c->readbuf, c->readbuf + n, c->readbuf_len);
+}
+
+
 static int readPacket(MQTTClient* c, Timer* timer)
 {
-    int rc = FAILURE;
+    int rc = 0;
     MQTTHeader header = {0};
     int len = 0;
     int rem_len = 0;
+    size_t n;
 
-    /* 1. read the header byte.  This has the packet type in it */
-    if (c->ipstack->mqttread(c->ipstack, c->readbuf, 1, TimerLeftMS(timer)) != 1)
-        goto exit;
+    /* 1. the packet handled by the last call is dropped, it stayed for the caller of waitfor() */
+    if (c->readbuf_pkt > 0)
+    {
+        dropPacket(c, c->readbuf_pkt);
+        c->readbuf_pkt = 0;
+    }
+
+    /* 2. pull all the data received, in one read, packets are decoded in readbuf without another copy */
+    if (c->readbuf_len < c->readbuf_size)
+    {
+        if ((rc = c->ipstack->mqttread(c->ipstack, c->readbuf + c->readbuf_len, c->readbuf_size - c->readbuf_len, TimerLeftMS(timer))) < 0)
+            return FAILURE;
+        c->readbuf_len += rc;
+    }
+    if (c->readbuf_skip > 0)
+    {
+        n = (c->readbuf_skip < c->readbuf_len) ? c->readbuf_skip : c->readbuf_len;
+        dropPacket(c, n);
+        c->readbuf_skip -= n;
+        if (c->readbuf_skip > 0)
+            return 0;
+    }
+    if (c->readbuf_len == 0)
+        return 0;
 
-    len = 1;
-    /* 2. read the remaining length.  This is variable in itself */
-    decodePacket(c, &rem_len, TimerLeftMS(timer));
-    len += MQTTPacket_encode(c->readbuf + 1, rem_len); /* put the original remaining length back into the buffer */
+    /* 3. the header byte then the remaining length, the packet is handled once received whole */
+    if ((len = decodePacket(c, &rem_len)) <= 0)
+        return (len < 0) ? FAILURE : 0;
+    len += 1 + rem_len;
 
-    /* 3. read the rest of the buffer using a callback to supply the rest of the data */
-    if (rem_len > 0 && (c->ipstack->mqttread(c->ipstack, c->readbuf + len, rem_len, TimerLeftMS(timer)) != rem_len))
-        goto exit;
+    if ((size_t)len > c->readbuf_size)
+    {
+        /* too long for readbuf, dropped as it comes */
+        c->readbuf_skip = len - c->readbuf_len;
+        c->readbuf_len = 0;
+        return 0;
+    }
+    if ((size_t)len > c->readbuf_len)
+        return 0;
 
+    c->readbuf_pkt = len;
     header.byte = c->readbuf[0];
     rc = header.bits.type;
-exit:
     return rc;
 }
 
@@ -159,26 +260,148 @@ static char isTopicMatched(char* topicFilter, MQTTString* topicName)
 }
 
 
-int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
+/* add the levels of a topic filter to the tree, FAILURE when the nodes run out */
+static int addTopicNode(MQTTClient* c, const char* topicFilter, int handler)
+{
+    const char* level = topicFilter;
+    int node = 0;
+
+    while (1)
+    {
+        const char* end = strchr(level, '/');
+        int len = end ? (int)(end - level) : (int)strlen(level);
+        int child;
+
+        for (child = c->topicNodes[node].child; child >= 0; child = c->topicNodes[child].next)
+        {
+            if (c->topicNodes[child].len == len && strncmp(c->topicNodes[child].level, level, len) == 0)
+                break;
+        }
+        if (child < 0)
+        {
+            if (c->topicNodeCount >= MAX_TOPIC_NODES)
+                return FAILURE;
+            child = c->topicNodeCount++;
+            c->topicNodes[child].level = level;
+            c->topicNodes[child].len = len;
+            c->topicNodes[child].child = -1;
+            c->topicNodes[child].handler = -1;
+            c->topicNodes[child].next = c->topicNodes[node].child;
+            c->topicNodes[node].child = child;
+        }
+        node = child;
+        if (end == NULL)
+            break;
+        level = end + 1;
+    }
+    c->topicNodes[node].handler = handler;
+    return SUCCESSS;
+}
+
+
+/* build the tree of the topic filters again, after a handler was set */
+static void buildTopicTree(MQTTClient* c)
 {
     int i;
-    int rc = FAILURE;
 
-    // we have to find the right message handler - indexed by topic
+    c->topicNodeCount = 1;
+    c->topicNodes[0].child = -1;
+    c->topicNodes[0].handler = -1;
     for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
     {
-        if (c->messageHandlers[i].topicFilter != 0 && (MQTTPacket_equals(topicName, (char*)c->messageHandlers[i].topicFilter) ||
-                isTopicMatched((char*)c->messageHandlers[i].topicFilter, topicName)))
+        if (c->messageHandlers[i].topicFilter != 0 && addTopicNode(c, c->messageHandlers[i].topicFilter, i) == FAILURE)
+        {
+            c->topicNodeCount = 0;
+            break;
+        }
+    }
+}
+
+
+/* collect the handlers below node matching the topic from level on, each level of the topic is looked at once */
+static int matchTopicNode(MQTTClient* c, int node, const char* level, const char* end, short* found, int count)
+{
+    const char* next = memchr(level, '/', end - level);
+    int len = next ? (int)(next - level) : (int)(end - level);
+    int child;
+
+    for (child = c->topicNodes[node].child; child >= 0; child = c->topicNodes[child].next)
+    {
+        struct TopicNode* t = &c->topicNodes[child];
+        char wild = (t->len == 1 && (t->level[0] == '+' || t->level[0] == '#')) ? t->level[0] : 0;
+        int grandchild;
+
+        if (wild && node == 0 && len > 0 && level[0] == '$')
+            continue; // wildcards don't match the topics starting with $
+        if (wild == '#')
+        {
+            if (t->handler >= 0)
+                found[count++] = t->handler;
+            continue;
+        }
+        if (wild != '+' && (t->len != len || memcmp(t->level, level, len) != 0))
+            continue;
+
+        if (next)
+            count = matchTopicNode(c, child, next + 1, end, found, count);
+        else
         {
-            if (c->messageHandlers[i].fp != NULL)
+            if (t->handler >= 0)
+                found[count++] = t->handler;
+            for (grandchild = t->child; grandchild >= 0; grandchild = c->topicNodes[grandchild].next)
             {
-                MessageData md;
-                NewMessageData(&md, topicName, message);
-                c->messageHandlers[i].fp(&md);
-                rc = SUCCESSS;
+                // "a/#" matches "a" as well
+                if (c->topicNodes[grandchild].len == 1 && c->topicNodes[grandchild].level[0] == '#' &&
+                    c->topicNodes[grandchild].handler >= 0)
+                    found[count++] = c->topicNodes[grandchild].handler;
             }
         }
     }
+    return count;
+}
+
+
+int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
+{
+    int i, j;
+    int rc = FAILURE;
+    short found[MAX_MESSAGE_HANDLERS];
+    int count = 0;
+
+    // we have to find the right message handler - indexed by topic
+    if (c->topicNodeCount > 0)
+    {
+        count = matchTopicNode(c, 0, topicName->lenstring.data, topicName->lenstring.data + topicName->lenstring.len, found, 0);
+
+        // called in the order they were set, as when they were matched one by one
+        for (i = 1; i < count; ++i)
+        {
+            short h = found[i];
+            for (j = i; j > 0 && found[j - 1] > h; --j)
+                found[j] = found[j - 1];
+            found[j] = h;
+        }
+    }
+    else
+    {
+        for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+        {
+            if (c->messageHandlers[i].topicFilter != 0 && (MQTTPacket_equals(topicName, (char*)c->messageHandlers[i].topicFilter) ||
+                    isTopicMatched((char*)c->messageHandlers[i].topicFilter, topicName)))
+                found[count++] = i;
+        }
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        if (c->messageHandlers[found[i]].fp != NULL)
+        {
+            MessageData md;
+            NewMessageData(&md, topicName, message);
+            c->messageHandlers[found[i]].fp(&md);
+            rc = SUCCESSS;
+        }
+    }
 
     if (rc == FAILURE && c->defaultMessageHandler != NULL)
     {
@@ -192,6 +415,37 @@ int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
 }
 
 
+/* set the handler of a topic filter, a NULL one removes it, FAILURE when all the handlers are taken */
+static int setMessageHandler(MQTTClient* c, const char* topicFilter, messageHandler messageHandler)
+{
+    int i, rc = FAILURE;
+
+    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+    {
+        if (c->messageHandlers[i].topicFilter != 0 && strcmp(c->messageHandlers[i].topicFilter, topicFilter) == 0)
+        {
+            if (messageHandler == NULL)
+                c->messageHandlers[i].topicFilter = 0;
+            else
+                c->messageHandlers[i].fp = messageHandler;
+            rc = SUCCESSS;
+            break;
+        }
+    }
+    for (i = 0; rc == FAILURE && messageHandler != NULL && i < MAX_MESSAGE_HANDLERS; ++i)
+    {
+        if (c->messageHandlers[i].topicFilter == 0)
+        {
+            c->messageHandlers[i].topicFilter = topicFilter;
+            c->messageHandlers[i].fp = messageHandler;
+            rc = SUCCESSS;
+        }
+    }
+    buildTopicTree(c);
+    return rc;
+}
+
+
 int keepalive(MQTTClient* c)
 {
     int rc = FAILURE;
@@ -223,17 +477,33 @@ exit:
 int cycle(MQTTClient* c, Timer* timer)
 {
     // read the socket, see what work is due
-    unsigned short packet_type = readPacket(c, timer);
+    int packet_type = readPacket(c, timer);
 
     int len = 0,
         rc = SUCCESSS;
 
     switch (packet_type)
     {
+        case FAILURE: /* the connection is lost or the data is corrupted */
+            c->isconnected = 0;
+            rc = FAILURE;
+            goto exit;
+        case 0: /* no packet received whole yet */
+            break;
         case CONNACK:
-        case PUBACK:
         case SUBACK:
             break;
+        case PUBACK:
+        case PUBCOMP:
+        {
+            unsigned short mypacketid;
+            unsigned char dup, type;
+            struct InflightMessages* m;
+            if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) == 1 &&
+                (m = findInflight(c, type, mypacketid)) != NULL)
+                freeInflight(c, m);
+            break;
+        }
         case PUBLISH:
         {
             MQTTString topicName;
@@ -263,18 +533,30 @@ int cycle(MQTTClient* c, Timer* timer)
         {
             unsigned short mypacketid;
             unsigned char dup, type;
+            struct InflightMessages* m = NULL;
             if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
                 rc = FAILURE;
             else if ((len = MQTTSerialize_ack(c->buf, c->buf_size, PUBREL, 0, mypacketid)) <= 0)
                 rc = FAILURE;
-            else if ((rc = sendPacket(c, len, timer)) != SUCCESSS) // send the PUBREL packet
-                rc = FAILURE; // there was a problem
+            else
+            {
+                if ((m = findInflight(c, PUBREC, mypacketid)) != NULL)
+                {
+                    /* the PUBREL replaces the PUBLISH, to be sent again until PUBCOMP */
+                    m->ack = PUBCOMP;
+                    if (m->len > 0)
+                    {
+                        memcpy(m->packet, c->buf, len);
+                        m->len = len;
+                    }
+                }
+                if ((rc = sendPacket(c, len, timer)) != SUCCESSS) // send the PUBREL packet
+                    rc = FAILURE; // there was a problem
+            }
             if (rc == FAILURE)
                 goto exit; // there was a problem
             break;
         }
-        case PUBCOMP:
-            break;
         case PINGRESP:
             c->ping_outstanding = 0;
             break;
@@ -295,12 +577,14 @@ int MQTTYield(MQTTClient* c, int timeout_ms)
     TimerInit(&timer);
     TimerCountdownMS(&timer, timeout_ms);
 
-    if (cycle(c, &timer) == FAILURE)
+    /* the packets pulled in together are handled together, a cycle without one ends it */
+    do
     {
-        rc = FAILURE;
-    }
+        if ((rc = cycle(c, &timer)) == FAILURE)
+            return FAILURE;
+    } while (rc > 0 && !TimerIsExpired(&timer));
 
-    return rc;
+    return SUCCESSS;
 }
 
 
@@ -367,6 +651,11 @@ int MQTTConnect(MQTTClient* c, MQTTPacket_connectData* options)
     if (options == 0)
         options = &default_options; /* set default options if none were supplied */
 
+    /* nothing of a previous connection is kept */
+    c->readbuf_len = 0;
+    c->readbuf_pkt = 0;
+    c->readbuf_skip = 0;
+
     c->keepAliveInterval = options->keepAliveInterval;
     TimerCountdown(&c->ping_timer, c->keepAliveInterval);
     if ((len = MQTTSerialize_connect(c->buf, c->buf_size, options)) <= 0)
@@ -387,6 +676,15 @@ int MQTTConnect(MQTTClient* c, MQTTPacket_connectData* options)
     else
         rc = FAILURE;
 
+    // the publishes of a kept session are completed, a clean session drops them
+    if (rc == SUCCESSS)
+    {
+        if (options->cleansession)
+            clearInflight(c);
+        else
+            rc = resendInflight(c, &connect_timer);
+    }
+
 exit:
     if (rc == SUCCESSS)
         c->isconnected = 1;
@@ -432,19 +730,7 @@ int MQTTSubscribe(MQTTClient* c, const char* topicFilter, enum QoS qos, messageH
         if (MQTTDeserialize_suback(&mypacketid, 1, &count, &grantedQoS, c->readbuf, c->readbuf_size) == 1)
             rc = grantedQoS; // 0, 1, 2 or 0x80
         if (rc != 0x80)
-        {
-            int i;
-            for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
-            {
-                if (c->messageHandlers[i].topicFilter == 0)
-                {
-                    c->messageHandlers[i].topicFilter = topicFilter;
-                    c->messageHandlers[i].fp = messageHandler;
-                    rc = 0;
-                    break;
-                }
-            }
-        }
+            rc = setMessageHandler(c, topicFilter, messageHandler);
     }
     else
         rc = FAILURE;
@@ -483,7 +769,10 @@ int MQTTUnsubscribe(MQTTClient* c, const char* topicFilter)
     {
         unsigned short mypacketid;  // should be the same as the packetid above
         if (MQTTDeserialize_unsuback(&mypacketid, c->readbuf, c->readbuf_size) == 1)
+        {
+            setMessageHandler(c, topicFilter, NULL);
             rc = 0;
+        }
     }
     else
         rc = FAILURE;
@@ -503,6 +792,7 @@ int MQTTPublish(MQTTClient* c, const char* topicName, MQTTMessage* message)
     MQTTString topic = MQTTString_initializer;
     topic.cstring = (char *)topicName;
     int len = 0;
+    struct InflightMessages* m = NULL;
 
 #if defined(MQTT_TASK)
 	MutexLock(&c->mutex);
@@ -514,38 +804,52 @@ int MQTTPublish(MQTTClient* c, const char* topicName, MQTTMessage* message)
     TimerCountdownMS(&timer, c->command_timeout_ms);
 
     if (message->qos == QOS1 || message->qos == QOS2)
+    {
+        // wait for the acks of the oldest publish when they all wait
+        while (c->inflight_count == MAX_INFLIGHT_MESSAGES)
+        {
+            if (TimerIsExpired(&timer) || cycle(c, &timer) == FAILURE)
+                goto exit;
+        }
         message->id = getNextPacketId(c);
+    }
 
     len = MQTTSerialize_publish(c->buf, c->buf_size, 0, message->qos, message->retained, message->id,
               topic, (unsigned char*)message->payload, message->payloadlen);
     if (len <= 0)
         goto exit;
-    if ((rc = sendPacket(c, len, &timer)) != SUCCESSS) // send the subscribe packet
-        goto exit; // there was a problem
 
-    if (message->qos == QOS1)
+    if (message->qos == QOS1 || message->qos == QOS2)
     {
-        if (waitfor(c, PUBACK, &timer) == PUBACK)
-        {
-            unsigned short mypacketid;
-            unsigned char dup, type;
-            if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
-                rc = FAILURE;
-        }
-        else
-            rc = FAILURE;
+        m = &c->inflight[(c->inflight_head + c->inflight_count) % MAX_INFLIGHT_MESSAGES];
+        m->id = message->id;
+        m->ack = (message->qos == QOS1) ? PUBACK : PUBREC;
+        m->len = (len <= MAX_INFLIGHT_PACKET_SIZE) ? len : 0;
+        if (m->len > 0)
+            memcpy(m->packet, c->buf, len);
+        c->inflight_count++;
     }
-    else if (message->qos == QOS2)
+
+    if ((rc = sendPacket(c, len, &timer)) != SUCCESSS) // send the publish packet
+    {
+        // there was a problem, a kept publish is sent again on reconnection
+        if (m != NULL && m->len == 0)
+            freeInflight(c, m);
+        goto exit;
+    }
+
+    // one too long to be kept is completed now
+    if (m != NULL && m->len == 0)
     {
-        if (waitfor(c, PUBCOMP, &timer) == PUBCOMP)
+        while (m->id == message->id)
         {
-            unsigned short mypacketid;
-            unsigned char dup, type;
-            if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
+            if (TimerIsExpired(&timer) || cycle(c, &timer) == FAILURE)
+            {
+                freeInflight(c, m);
                 rc = FAILURE;
+                break;
+            }
         }
-        else
-            rc = FAILURE;
     }
 
 exit:
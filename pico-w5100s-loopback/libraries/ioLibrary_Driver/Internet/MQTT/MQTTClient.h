@@ -43,6 +43,18 @@
 #define MAX_MESSAGE_HANDLERS 5 /* redefinable - how many subscriptions do you want? */
 #endif
 
+#if !defined(MAX_TOPIC_NODES)
+#define MAX_TOPIC_NODES (MAX_MESSAGE_HANDLERS * 4) /* redefinable - how many topic levels do the subscriptions have together? */
+#endif
+
+#if !defined(MAX_INFLIGHT_MESSAGES)
+#define MAX_INFLIGHT_MESSAGES 8 /* redefinable - how many QoS1/2 publishes may wait for their acks? */
+#endif
+
+#if !defined(MAX_INFLIGHT_PACKET_SIZE)
+#define MAX_INFLIGHT_PACKET_SIZE 128 /* redefinable - longest publish kept to be sent again, longer ones wait for their acks */
+#endif
+
 enum QoS { QOS0, QOS1, QOS2 };
 
 /* all failure return codes must be negative */
@@ -91,6 +103,9 @@ typedef struct MQTTClient
       readbuf_size;
     unsigned char *buf,
       *readbuf;
+    size_t readbuf_len,      /* bytes pulled into readbuf, packets are decoded in place */
+      readbuf_pkt;           /* length of the packet at the start of readbuf, dropped by the next read */
+    unsigned long readbuf_skip;  /* bytes still to drop of a packet longer than readbuf */
     unsigned int keepAliveInterval;
     char ping_outstanding;
     int isconnected;
@@ -101,8 +116,28 @@ typedef struct MQTTClient
         void (*fp) (MessageData*);
     } messageHandlers[MAX_MESSAGE_HANDLERS];      /* Message handlers are indexed by subscription topic */
 
+    struct TopicNode
+    {
+        const char* level;      /* the level in the topic filter of a handler, not terminated */
+        unsigned short len;
+        short child,            /* first child and next sibling, -1 if none */
+          next;
+        short handler;          /* index of the handler whose filter ends here, -1 if none */
+    } topicNodes[MAX_TOPIC_NODES];                /* the levels of the topic filters, topicNodes[0] is the root */
+    int topicNodeCount;         /* 0 when the filters didn't fit, they are matched one by one then */
+
     void (*defaultMessageHandler) (MessageData*);
 
+    struct InflightMessages
+    {
+        unsigned short id;      /* packet id, 0 once acknowledged */
+        unsigned char ack;      /* PUBACK, PUBREC or PUBCOMP awaited */
+        unsigned short len;     /* length of packet, 0 if it was too long to be kept */
+        unsigned char packet[MAX_INFLIGHT_PACKET_SIZE];  /* the PUBLISH, then the PUBREL, sent again on reconnection */
+    } inflight[MAX_INFLIGHT_MESSAGES];            /* in the order they were sent, from inflight_head */
+    unsigned int inflight_head,
+      inflight_count;
+
     Network* ipstack;
     Timer ping_timer;
 #if defined(MQTT_TASK)
@@ -126,15 +161,18 @@ DLLExport void MQTTClientInit(MQTTClient* client, Network* network, unsigned int
 
 /** MQTT Connect - send an MQTT connect packet down the network and wait for a Connack
  *  The nework object must be connected to the network endpoint before calling this
+ *  The publishes not acknowledged yet are sent again when cleansession is 0, dropped otherwise
  *  @param options - connect options
  *  @return success code
  */
 DLLExport int MQTTConnect(MQTTClient* client, MQTTPacket_connectData* options);
 
-/** MQTT Publish - send an MQTT publish packet and wait for all acks to complete for all QoSs
+/** MQTT Publish - send an MQTT publish packet
+ *  A QoS1/2 publish returns once sent, its acks are handled by the next calls, up to MAX_INFLIGHT_MESSAGES at a time.
+ *  It waits for a free place when they are all taken, and for its own acks if it is longer than MAX_INFLIGHT_PACKET_SIZE.
  *  @param client - the client object to use
  *  @param topic - the topic to publish to
- *  @param message - the message to send
+ *  @param message - the message to send, its id is set for QoS1/2
  *  @return success code
  */
 DLLExport int MQTTPublish(MQTTClient* client, const char*, MQTTMessage*);
@@ -161,9 +199,10 @@ DLLExport int MQTTUnsubscribe(MQTTClient* client, const char* topicFilter);
 DLLExport int MQTTDisconnect(MQTTClient* client);
 
 /** MQTT Yield - MQTT background
+ *  Handles the packets received, without waiting for the ones not complete yet.
  *  @param client - the client object to use
- *  @param time - the time, in milliseconds, to yield for 
- *  @return success code
+ *  @param time - the time, in milliseconds, to yield for, 0 to handle the packets received so far
+ *  @return success code, FAILURE once the connection is lost
  */
 DLLExport int MQTTYield(MQTTClient* client, int time);
 
@@ -115,23 +115,77 @@ void NewNetwork(Network* n, int sn) {
 	n->mqttread = w5x00_read;
 	n->mqttwrite = w5x00_write;
 	n->disconnect = w5x00_disconnect;
+	n->events = 0;
+	n->readable = 1;
 }
 
+#if _WIZCHIP_ == W5100S
+static Network* event_network[_WIZCHIP_SOCK_NUM_];
+
+static void w5x00_event(uint8_t sn, uint8_t events)
+{
+	if(event_network[sn]) event_network[sn]->readable = 1;
+}
+
+/*
+ * @brief Read the socket only after its events
+ * @note   w5x00_read() then doesn't access the chip until the socket reports data, a disconnection
+ *         or a timeout, it calls sockevent_dispatch() itself. INTn must call sockevent_isr().
+ * @param  n : pointer to a Network structure
+ *         that contains the configuration information for the Network.
+ * @retval SOCK_OK or SOCKERR code
+ */
+int NetworkEventEnable(Network* n)
+{
+	int8_t ret;
+
+	event_network[n->my_socket] = n;
+	ret = reg_sockevent_cbfunc(n->my_socket, SIK_RECEIVED | SIK_DISCONNECTED | SIK_TIMEOUT, w5x00_event);
+	if(ret == SOCK_OK) n->events = 1;
+	n->readable = 1;
+
+	return ret;
+}
+#endif
+
 /*
  * @brief read function
+ * @note   Doesn't wait, all the received data up to len is read at once.
  * @param  n : pointer to a Network structure
  *         that contains the configuration information for the Network.
  *         buffer : pointer to a read buffer.
  *         len : buffer length.
- * @retval received data length or SOCKERR code
+ * @retval received data length, 0 if none, or SOCKERR code once the connection is lost
  */
 int w5x00_read(Network* n, unsigned char* buffer, int len, long time)
 {
+	uint16_t rsr;
+	int32_t ret;
 
-	if((getSn_SR(n->my_socket) == SOCK_ESTABLISHED) && (getSn_RX_RSR(n->my_socket)>0))
-		return recv(n->my_socket, buffer, len);
+#if _WIZCHIP_ == W5100S
+	if(n->events)
+	{
+		if(sockevent_pending()) sockevent_dispatch();
+		if(!n->readable) return 0; // nothing happened since the socket was drained
+		n->readable = 0;
+	}
+#endif
 
-	return SOCK_ERROR;
+	if((rsr = getSn_RX_RSR(n->my_socket)) == 0)
+	{
+		if(getSn_SR(n->my_socket) == SOCK_ESTABLISHED) return 0;
+
+		n->readable = 1;
+		return SOCKERR_SOCKSTATUS;
+	}
+
+	if(len > 0xFFFF) len = 0xFFFF;
+	ret = recv(n->my_socket, buffer, len);
+
+	// the rest won't be reported by another event
+	if((ret < 0) || (ret < rsr)) n->readable = 1;
+
+	return ret;
 }
 
 /*
@@ -173,4 +227,5 @@ void ConnectNetwork(Network* n, uint8_t* ip, uint16_t port)
 
 	socket(n->my_socket,Sn_MR_TCP,myport,0);
 	connect(n->my_socket,ip,port);
+	n->readable = 1;
 }
@@ -213,6 +213,7 @@ int main(void)
 #define __MQTT_INTERFACE_H_
 
 #include <stdint.h>
+#include "wizchip_conf.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -244,6 +245,8 @@ struct Network
 	int (*mqttread) (Network*, unsigned char*, int, long);
 	int (*mqttwrite) (Network*, unsigned char*, int, long);
 	void (*disconnect) (Network*);
+	uint8_t events;		// NetworkEventEnable() was called
+	uint8_t readable;	// data or a disconnection may wait in the socket, with events
 };
 
 /*
@@ -263,6 +266,9 @@ int w5x00_write(Network*, unsigned char*, int, long);
 void w5x00_disconnect(Network*);
 void NewNetwork(Network* n, int sn);
 void ConnectNetwork(Network* n, uint8_t* ip, uint16_t port);
+#if _WIZCHIP_ == W5100S
+int NetworkEventEnable(Network* n);
+#endif
 
 #ifdef __cplusplus
 }
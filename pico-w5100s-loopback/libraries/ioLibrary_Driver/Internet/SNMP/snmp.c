@@ -12,7 +12,10 @@
 /* SNMP : Functions declaration                                                             */
 /********************************************************************************************/
 // SNMP Parsing functions
+int32_t compareOID(const uint8_t *oid1, int32_t len1, const uint8_t *oid2, int32_t len2);
+void initEntryIndex(void);
 int32_t findEntry(uint8_t *oid, int32_t len);
+int32_t findNextEntry(uint8_t *oid, int32_t len);
 int32_t getOID(int32_t id, uint8_t *oid, uint8_t *len);
 int32_t getValue( uint8_t *vptr, int32_t vlen);
 int32_t getEntry(int32_t id, uint8_t *dataType, void *ptr, int32_t *len);
@@ -28,6 +31,7 @@ int32_t parseSequenceOf(int32_t reqType);
 int32_t parseRequest();
 int32_t parseCommunity();
 int32_t parseVersion();
+int32_t parseBulkRequest();
 int32_t parseSNMPMessage();
 
 // Debugging function
@@ -56,6 +60,13 @@ static uint8_t SOCK_SNMP_TRAP;
 uint8_t packet_trap[MAX_TRAPMSG_LEN] = {0,};
 uint8_t errorStatus, errorIndex;
 
+// Entries of snmpData[] sorted by OID, for the binary searches of GET and GETNEXT
+static int16_t entryIndex[MAX_DATA_ENTRY];
+static int32_t entryCount = 0;
+
+// Version of the request, the response is in the same
+static uint8_t snmpVersion = SNMP_V1;
+
 
 /********************************************************************************************/
 /* SNMP : Time handler                                                                      */
@@ -109,6 +120,7 @@ void snmpd_init(uint8_t * managerIP, uint8_t * agentIP, uint8_t sn_agent, uint8_
 
     startTime = getSNMPTimeTick(); // Start time (unit: 10ms)
     initTable(); // Settings for OID entry values
+    initEntryIndex(); // Sorted OID index of the entries
     
     initial_Trap(managerIP, agentIP);
 
@@ -157,6 +169,7 @@ int32_t snmpd_run(void)
 		case SOCK_UDP :
 			if ( (len = getSn_RX_RSR(SOCK_SNMP_AGENT)) > 0)
 			{
+				if (len > MAX_SNMPMSG_LEN) len = MAX_SNMPMSG_LEN;
 				request_msg.len= recvfrom(SOCK_SNMP_AGENT, request_msg.buffer, len, svr_addr, &svr_port);
 			}
 			else
@@ -204,22 +217,98 @@ int32_t snmpd_run(void)
 }
 
 
-int32_t findEntry(uint8_t *oid, int32_t len)
+/* Compares two BER encoded OIDs by their sub-identifiers, the encoded bytes don't sort as the
+ * sub-identifiers of several bytes do. Returns <0, 0 or >0 as oid1 is before, equal to or after oid2. */
+int32_t compareOID(const uint8_t *oid1, int32_t len1, const uint8_t *oid2, int32_t len2)
+{
+	int32_t i = 0, j = 0;
+	uint32_t sub1, sub2;
+
+	while ((i < len1) && (j < len2))
+	{
+		sub1 = sub2 = 0;
+		do { sub1 = (sub1 << 7) | (oid1[i] & 0x7f); } while ((oid1[i++] & 0x80) && (i < len1));
+		do { sub2 = (sub2 << 7) | (oid2[j] & 0x7f); } while ((oid2[j++] & 0x80) && (j < len2));
+
+		if (sub1 != sub2) return (sub1 < sub2) ? -1 : 1;
+	}
+
+	if (i < len1) return 1;
+	if (j < len2) return -1;
+	return 0;
+}
+
+
+/* Sorts the entries of snmpData[] by OID at init, snmpData[] can be in any order */
+void initEntryIndex(void)
 {
-	int32_t i;
+	int32_t i, j;
+	int16_t id;
+
+	entryCount = (maxData < MAX_DATA_ENTRY) ? maxData : MAX_DATA_ENTRY;
+#ifdef _SNMP_DEBUG_
+	if (maxData > MAX_DATA_ENTRY) printf(" - SNMP : %d entries over MAX_DATA_ENTRY left out\r\n", (int)(maxData - MAX_DATA_ENTRY));
+#endif
 
-	for (i = 0 ; i < maxData ; i++)
+	for (i = 0 ; i < entryCount ; i++)
 	{
-		if (len == snmpData[i].oidlen)
+		id = (int16_t)i;
+		for (j = i ; (j > 0) && (compareOID(snmpData[entryIndex[j-1]].oid, snmpData[entryIndex[j-1]].oidlen, snmpData[id].oid, snmpData[id].oidlen) > 0) ; j--)
 		{
-			if (!memcmp(snmpData[i].oid, oid, len)) return(i);
+			entryIndex[j] = entryIndex[j-1];
 		}
+		entryIndex[j] = id;
+	}
+}
+
+
+/* Position in entryIndex of the first entry not before the OID, entryCount if none */
+static int32_t searchEntryIndex(uint8_t *oid, int32_t len)
+{
+	int32_t low = 0, high = entryCount, mid;
+
+	while (low < high)
+	{
+		mid = (low + high) / 2;
+		if (compareOID(snmpData[entryIndex[mid]].oid, snmpData[entryIndex[mid]].oidlen, oid, len) < 0) low = mid + 1;
+		else high = mid;
 	}
 
+	return low;
+}
+
+
+int32_t findEntry(uint8_t *oid, int32_t len)
+{
+	int32_t pos = searchEntryIndex(oid, len);
+
+	if ((pos < entryCount) && (compareOID(snmpData[entryIndex[pos]].oid, snmpData[entryIndex[pos]].oidlen, oid, len) == 0))
+		return entryIndex[pos];
+
 	return OID_NOT_FOUND;
 }
 
 
+/* Position in entryIndex of the first entry after the OID, its lexicographic successor as GETNEXT wants */
+static int32_t searchNextEntryIndex(uint8_t *oid, int32_t len)
+{
+	int32_t pos = searchEntryIndex(oid, len);
+
+	if ((pos < entryCount) && (compareOID(snmpData[entryIndex[pos]].oid, snmpData[entryIndex[pos]].oidlen, oid, len) == 0))
+		pos++;
+
+	return pos;
+}
+
+
+int32_t findNextEntry(uint8_t *oid, int32_t len)
+{
+	int32_t pos = searchNextEntryIndex(oid, len);
+
+	return (pos < entryCount) ? entryIndex[pos] : OID_NOT_FOUND;
+}
+
+
 int32_t getOID(int32_t id, uint8_t *oid, uint8_t *len)
 {
 	int32_t j;
@@ -471,7 +560,8 @@ int32_t parseVarBind(int32_t reqType, int32_t index)
 
 	if ( request_msg.buffer[name.start] != SNMPDTYPE_OBJ_ID ) return -1;
 
-	id = findEntry(&request_msg.buffer[name.vstart], name.len);
+	if (reqType == GET_NEXT_REQUEST) id = findNextEntry(&request_msg.buffer[name.vstart], name.len);
+	else id = findEntry(&request_msg.buffer[name.vstart], name.len);
 
 	if ((reqType == GET_REQUEST) || (reqType == SET_REQUEST))
 	{
@@ -483,9 +573,8 @@ int32_t parseVarBind(int32_t reqType, int32_t index)
 	{
 		response_msg.buffer[response_msg.index] = request_msg.buffer[name.start];
 
-		if (++id >= maxData)
+		if (id == OID_NOT_FOUND)
 		{
-			id = OID_NOT_FOUND;
 			seglen = name.nstart - name.start;
 			COPY_SEGMENT(name);
 			size = seglen;
@@ -533,8 +622,16 @@ int32_t parseVarBind(int32_t reqType, int32_t index)
 		seglen = value.nstart - value.start;
 		COPY_SEGMENT(value);
 
-		errorIndex = index;
-		errorStatus = NO_SUCH_NAME;
+		if ((snmpVersion == SNMP_V2C) && (reqType != SET_REQUEST) && (seglen == 2))
+		{
+			// SNMPv2c answers with an exception in place of the NULL value, not with an error
+			response_msg.buffer[response_msg.index - 2] = (reqType == GET_NEXT_REQUEST) ? SNMPDTYPE_END_OF_MIB_VIEW : SNMPDTYPE_NO_SUCH_OBJECT;
+		}
+		else
+		{
+			errorIndex = index;
+			errorStatus = NO_SUCH_NAME;
+		}
 	}
 
 	size += seglen;
@@ -660,7 +757,9 @@ int32_t parseCommunity()
 		size += seglen;
 		COPY_SEGMENT(community);
 
-		size += parseRequest();
+		seglen = parseRequest();
+		if (seglen == -1) return -1;
+		size += seglen;
 	}
 	else
 	{
@@ -678,8 +777,9 @@ int32_t parseVersion()
 
 	size = parseTLV(request_msg.buffer, request_msg.index, &tlv);
 
-	if (!((request_msg.buffer[tlv.start] == SNMPDTYPE_INTEGER) && (request_msg.buffer[tlv.vstart] == SNMP_V1)))
+	if (!((request_msg.buffer[tlv.start] == SNMPDTYPE_INTEGER) && ((request_msg.buffer[tlv.vstart] == SNMP_V1) || (request_msg.buffer[tlv.vstart] == SNMP_V2C))))
 		return -1;
+	snmpVersion = request_msg.buffer[tlv.vstart];
 
 	seglen = tlv.nstart - tlv.start;
 	size += seglen;
@@ -691,11 +791,197 @@ int32_t parseVersion()
 }
 
 
+/* Starts a constructed TLV of the GETBULK response, with a length of 2 bytes filled in by endBulkHeader() */
+static int32_t putBulkHeader(uint8_t type)
+{
+	int32_t loc = response_msg.index;
+
+	response_msg.buffer[response_msg.index++] = type;
+	response_msg.buffer[response_msg.index++] = 0x82;
+	response_msg.index += 2;
+
+	return loc;
+}
+
+
+static void endBulkHeader(int32_t loc)
+{
+	int32_t len = response_msg.index - (loc + 4);
+
+	response_msg.buffer[loc+2] = (uint8_t)(len >> 8);
+	response_msg.buffer[loc+3] = (uint8_t)len;
+}
+
+
+/* Appends the variable binding of the entry at pos in entryIndex to the GETBULK response, endOfMibView after
+ * the last one, named as the previous variable binding of the repetitions from first on. -1 when it doesn't fit. */
+static int32_t putBulkVarBind(int32_t pos, int32_t first, const uint8_t *oid, int32_t oidlen)
+{
+	uint8_t *buf = response_msg.buffer;
+	int32_t loc = response_msg.index, i = loc + 2, len;
+	uint8_t dataType;
+
+	if (pos >= entryCount && pos > first)
+	{
+		oid = snmpData[entryIndex[pos-1]].oid;
+		oidlen = snmpData[entryIndex[pos-1]].oidlen;
+	}
+	else if (pos < entryCount)
+	{
+		oid = snmpData[entryIndex[pos]].oid;
+		oidlen = snmpData[entryIndex[pos]].oidlen;
+	}
+
+	// a value and the lengths are up to 2 bytes each
+	if ((oidlen > 0x7f) || (loc + 4 + 2 + oidlen + 2 + MAX_STRING > MAX_SNMPMSG_LEN)) return -1;
+
+	buf[i++] = SNMPDTYPE_OBJ_ID;
+	buf[i++] = (uint8_t)oidlen;
+	memcpy(&buf[i], oid, oidlen);
+	i += oidlen;
+
+	if (pos < entryCount)
+	{
+		getEntry(entryIndex[pos], &dataType, &buf[i+2], &len);
+		buf[i++] = dataType;
+		buf[i++] = (uint8_t)len;
+		i += len;
+	}
+	else
+	{
+		buf[i++] = SNMPDTYPE_END_OF_MIB_VIEW;
+		buf[i++] = 0;
+	}
+
+	len = i - (loc + 2);
+	buf[loc] = SNMPDTYPE_SEQUENCE;
+	if (len > 0x7f)
+	{
+		memmove(&buf[loc+3], &buf[loc+2], len);
+		buf[loc+1] = 0x81;
+		buf[loc+2] = (uint8_t)len;
+		i++;
+	}
+	else
+	{
+		buf[loc+1] = (uint8_t)len;
+	}
+	response_msg.index = i;
+
+	return 0;
+}
+
+
+/* Builds the whole response of an SNMPv2c GETBULK: one GETNEXT for each of the non-repeaters, up to
+ * max-repetitions for the others, as many as the response has room for.
+ * Returns -1 if the message isn't a GETBULK, -2 if the GETBULK is to be dropped. */
+int32_t parseBulkRequest()
+{
+	tlvStructType msg, version, community, pdu, reqid, nonrep, maxrep, list, varbind, name;
+	uint8_t *buf = request_msg.buffer;
+	int32_t msgLoc, pduLoc, listLoc, index, end;
+	int32_t nonRepeaters, maxRepetitions, rep, count = 0, repeaters = 0, i, more;
+	int16_t pos[MAX_SNMPMSG_LEN / 8], first[MAX_SNMPMSG_LEN / 8];
+	int32_t oidLoc[MAX_SNMPMSG_LEN / 8];
+	uint8_t oidLen[MAX_SNMPMSG_LEN / 8];
+
+	parseTLV(buf, 0, &msg);
+	if (buf[msg.start] != SNMPDTYPE_SEQUENCE) return -1;
+	parseTLV(buf, msg.nstart, &version);
+	if ((buf[version.start] != SNMPDTYPE_INTEGER) || (buf[version.vstart] != SNMP_V2C) || (version.nstart >= request_msg.len)) return -1;
+	parseTLV(buf, version.nstart, &community);
+	if (community.nstart >= request_msg.len) return -1;
+	parseTLV(buf, community.nstart, &pdu);
+	if (buf[pdu.start] != GET_BULK_REQUEST) return -1;
+
+	if (!((buf[community.start] == SNMPDTYPE_OCTET_STRING) && (community.len == COMMUNITY_SIZE) &&
+		!memcmp(&buf[community.vstart], (int8_t *)COMMUNITY, COMMUNITY_SIZE))) return -2;
+
+	// GETBULK carries non-repeaters and max-repetitions in place of error-status and error-index
+	parseTLV(buf, pdu.vstart, &reqid);
+	if (reqid.nstart >= request_msg.len) return -2;
+	parseTLV(buf, reqid.nstart, &nonrep);
+	if (nonrep.nstart >= request_msg.len) return -2;
+	parseTLV(buf, nonrep.nstart, &maxrep);
+	if (maxrep.nstart >= request_msg.len) return -2;
+	parseTLV(buf, maxrep.nstart, &list);
+	if ((buf[reqid.start] != SNMPDTYPE_INTEGER) || (buf[list.start] != SNMPDTYPE_SEQUENCE_OF) || (list.vstart + list.len > request_msg.len)) return -2;
+
+	nonRepeaters = (buf[nonrep.vstart] & 0x80) ? 0 : getValue(&buf[nonrep.vstart], nonrep.len);
+	maxRepetitions = (buf[maxrep.vstart] & 0x80) ? 0 : getValue(&buf[maxrep.vstart], maxrep.len);
+
+	response_msg.index = 0;
+	msgLoc = putBulkHeader(SNMPDTYPE_SEQUENCE);
+	memcpy(&response_msg.buffer[response_msg.index], &buf[version.start], community.nstart - version.start);
+	response_msg.index += community.nstart - version.start;
+	pduLoc = putBulkHeader(GET_RESPONSE);
+	memcpy(&response_msg.buffer[response_msg.index], &buf[reqid.start], reqid.nstart - reqid.start);
+	response_msg.index += reqid.nstart - reqid.start;
+	for (i = 0 ; i < 2 ; i++)
+	{
+		// error-status and error-index
+		response_msg.buffer[response_msg.index++] = SNMPDTYPE_INTEGER;
+		response_msg.buffer[response_msg.index++] = 1;
+		response_msg.buffer[response_msg.index++] = 0;
+	}
+	listLoc = putBulkHeader(SNMPDTYPE_SEQUENCE);
+
+	end = list.vstart + list.len;
+	for (index = list.vstart ; index < end ; index = varbind.vstart + varbind.len)
+	{
+		parseTLV(buf, index, &varbind);
+		if (varbind.vstart >= end) return -2;
+		parseTLV(buf, varbind.vstart, &name);
+		if ((buf[varbind.start] != SNMPDTYPE_SEQUENCE) || (buf[name.start] != SNMPDTYPE_OBJ_ID) || (name.nstart > end)) return -2;
+
+		if (count++ < nonRepeaters)
+		{
+			i = searchNextEntryIndex(&buf[name.vstart], name.len);
+			if (putBulkVarBind(i, i, &buf[name.vstart], name.len) < 0) break;
+		}
+		else if (repeaters < (int32_t)(sizeof(pos) / sizeof(pos[0])))
+		{
+			pos[repeaters] = first[repeaters] = (int16_t)searchNextEntryIndex(&buf[name.vstart], name.len);
+			oidLoc[repeaters] = name.vstart;
+			oidLen[repeaters++] = (uint8_t)((name.len > 0xff) ? 0xff : name.len);
+		}
+	}
+
+	for (rep = 0, more = 1 ; (rep < maxRepetitions) && more ; rep++)
+	{
+		more = 0;
+		for (i = 0 ; i < repeaters ; i++)
+		{
+			if (putBulkVarBind(pos[i], first[i], &buf[oidLoc[i]], oidLen[i]) < 0)
+			{
+				more = 0;
+				break;
+			}
+			if (pos[i] < entryCount)
+			{
+				pos[i]++;
+				more = 1;
+			}
+		}
+	}
+
+	endBulkHeader(listLoc);
+	endBulkHeader(pduLoc);
+	endBulkHeader(msgLoc);
+
+	return 0;
+}
+
+
 int32_t parseSNMPMessage()
 {
 	int32_t size = 0, seglen, respLoc;
 	tlvStructType tlv;
 
+	// GETBULK responses are built on their own, they are longer than the requests
+	size = parseBulkRequest();
+	if (size != -1) return size;
+
 	parseTLV(request_msg.buffer, request_msg.index, &tlv);
 
 	if (request_msg.buffer[tlv.start] != SNMPDTYPE_SEQUENCE_OF) return -1;
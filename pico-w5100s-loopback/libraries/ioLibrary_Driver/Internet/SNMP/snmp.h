@@ -12,11 +12,15 @@ extern "C" {
 #define PORT_SNMP_TRAP				162
 
 #define SNMP_V1						0
+#define SNMP_V2C					1
 
 #define MAX_OID						12
 #define MAX_STRING					64
 #define MAX_SNMPMSG_LEN				512
 #define MAX_TRAPMSG_LEN				512
+#ifndef MAX_DATA_ENTRY
+#define MAX_DATA_ENTRY				64		// Entries of snmpData[] in the sorted OID index
+#endif
 
 // SNMP Error code
 #define SNMP_SUCCESS				0
@@ -26,6 +30,7 @@ extern "C" {
 #define INVALID_ENTRY_ID			-4
 #define INVALID_DATA_TYPE			-5
 
+#define TOO_BIG						1
 #define NO_SUCH_NAME				2
 #define BAD_VALUE					3
 
@@ -34,6 +39,7 @@ extern "C" {
 #define GET_NEXT_REQUEST			0xa1
 #define GET_RESPONSE				0xa2
 #define SET_REQUEST					0xa3
+#define GET_BULK_REQUEST			0xa5	// SNMPv2c
 
 // Macros: SNMPv1 request validation checker
 #define VALID_REQUEST(x)			((x == GET_REQUEST) || (x == GET_NEXT_REQUEST) || (x == SET_REQUEST))
@@ -51,6 +57,11 @@ extern "C" {
 #define SNMPDTYPE_TIME_TICKS		0x43
 #define SNMPDTYPE_OPAQUE			0x44
 
+// SNMPv2c Exceptions, in place of the value of a variable binding
+#define SNMPDTYPE_NO_SUCH_OBJECT	0x80
+#define SNMPDTYPE_NO_SUCH_INSTANCE	0x81
+#define SNMPDTYPE_END_OF_MIB_VIEW	0x82
+
 // SNMP Trap: Standard Trap Types (Generic)
 #define SNMPTRAP_COLDSTART			0x00	// Generic trap-type 0: Cold Start
 #define SNMPTRAP_WARMSTART			0x01	// Generic trap-type 1: Warm Start
@@ -19,6 +19,17 @@ uint8_t NTP_SOCKET;
 uint8_t time_zone;
 uint16_t ntp_retry_cnt=0; //counting the ntp retry number
 
+static uint64_t (*sntp_clock_us)(void) = 0;
+static uint64_t sntp_t1_us;		// clock when the request was sent
+static tstamp sntp_cookie;		// transmit timestamp of the request, the answer echoes it as origin
+static uint8_t sntp_synced = 0;
+static uint64_t clk_base_us;	// the disciplined clock was clk_base_ntp at clk_base_us
+static tstamp clk_base_ntp;
+static int64_t clk_slew_us;		// offset slewed away from clk_base_us on
+static int32_t sntp_offset_us, sntp_delay_us;
+
+static tstamp apply_time_zone(tstamp seconds);
+
 /*
 00)UTC-12:00 Baker Island, Howland Island (both uninhabited)
 01) UTC-11:00 American Samoa, Samoa
@@ -79,6 +90,13 @@ void get_seconds_from_ntp_server(uint8_t *buf, uint16_t idx)
 	{
 		seconds = (seconds << 8) | buf[idx + i];
 	}
+
+	//calculation for date
+	calcdatetime(apply_time_zone(seconds));
+}
+
+static tstamp apply_time_zone(tstamp seconds)
+{
 	switch (time_zone)
 	{
 	case 0:
@@ -211,8 +229,152 @@ void get_seconds_from_ntp_server(uint8_t *buf, uint16_t idx)
 
 	}
 
-	//calculation for date
-	calcdatetime(seconds);
+	return seconds;
+}
+
+static tstamp get_timestamp(uint8_t *buf)
+{
+	tstamp ts = 0;
+	uint8_t i;
+
+	for (i = 0; i < 8; i++)
+	{
+		ts = (ts << 8) | buf[i];
+	}
+	return ts;
+}
+
+static void put_timestamp(uint8_t *buf, tstamp ts)
+{
+	uint8_t i;
+
+	for (i = 8; i > 0; i--)
+	{
+		buf[i - 1] = (uint8_t)ts;
+		ts >>= 8;
+	}
+}
+
+/* us to the 32.32 fixed point of the timestamps, and back for the differences of timestamps */
+static tstamp us_to_ntp(uint64_t us)
+{
+	return ((us / 1000000) << 32) + (((us % 1000000) << 32) / 1000000);
+}
+
+static int64_t ntp_to_us(int64_t ntp)
+{
+	uint64_t mag = (ntp < 0) ? -(uint64_t)ntp : (uint64_t)ntp;
+	int64_t us = (int64_t)((mag >> 32) * 1000000 + (((mag & 0xFFFFFFFFULL) * 1000000) >> 32));
+
+	return (ntp < 0) ? -us : us;
+}
+
+/* time of the disciplined clock at now_us, the slew applied at SNTP_SLEW_PPM until it is all in */
+static tstamp sntp_local_time(uint64_t now_us)
+{
+	uint64_t elapsed = now_us - clk_base_us;
+	int64_t slew = (int64_t)(elapsed * SNTP_SLEW_PPM / 1000000);
+	tstamp t = clk_base_ntp + us_to_ntp(elapsed);
+
+	if (clk_slew_us >= 0)
+	{
+		if (slew > clk_slew_us) slew = clk_slew_us;
+		return t + us_to_ntp(slew);
+	}
+	if (slew > -clk_slew_us) slew = -clk_slew_us;
+	return t - us_to_ntp(slew);
+}
+
+/* take the answer in the receive buffer, received at t4_us, into the clock. 0 if it isn't the answer */
+static int8_t sntp_discipline(uint8_t *buf, uint16_t len, uint64_t t4_us)
+{
+	tstamp t1, t2, t3, t4, now;
+	int64_t offset, delay;
+
+	// a server answer, synchronized, to the last request
+	if ((len < 48) || ((buf[0] & 0x07) != 4) || ((buf[0] >> 6) == 3) || (buf[1] == 0)) return 0;
+	if (get_timestamp(&buf[24]) != sntp_cookie) return 0;
+
+	t2 = get_timestamp(&buf[32]);
+	t3 = get_timestamp(&buf[40]);
+	if (t3 == 0) return 0;
+
+	now = sntp_local_time(t4_us);
+	if (!sntp_synced)
+	{
+		// nothing to compare the server time to yet, the clock is the server time half the round trip after t3
+		delay = (int64_t)(t4_us - sntp_t1_us) - ntp_to_us((int64_t)(t3 - t2));
+		if (delay < 0) delay = 0;
+		clk_base_ntp = t3 + us_to_ntp(delay / 2);
+		clk_slew_us = 0;
+		offset = ntp_to_us((int64_t)(clk_base_ntp - now));
+		sntp_synced = 1;
+	}
+	else
+	{
+		t1 = sntp_local_time(sntp_t1_us);
+		t4 = now;
+		// the differences are taken modulo 2^64, halved before adding not to overflow
+		offset = ntp_to_us((int64_t)(t2 - t1) / 2 + (int64_t)(t3 - t4) / 2);
+		delay = ntp_to_us((int64_t)(t4 - t1) - (int64_t)(t3 - t2));
+		if (delay < 0) delay = 0;
+
+		if ((offset > (int64_t)SNTP_STEP_US) || (offset < -(int64_t)SNTP_STEP_US))
+		{
+			clk_base_ntp = now + (tstamp)(offset >= 0 ? us_to_ntp(offset) : -us_to_ntp(-offset));
+			clk_slew_us = 0;
+		}
+		else
+		{
+			clk_base_ntp = now;
+			clk_slew_us = offset;
+		}
+	}
+	clk_base_us = t4_us;
+
+	sntp_offset_us = (int32_t)((offset > INT32_MAX) ? INT32_MAX : ((offset < INT32_MIN) ? INT32_MIN : offset));
+	sntp_delay_us = (int32_t)((delay > INT32_MAX) ? INT32_MAX : delay);
+#ifdef _SNTP_DEBUG_
+	printf("ntp offset %ld us, delay %ld us\r\n", (long)sntp_offset_us, (long)sntp_delay_us);
+#endif
+	return 1;
+}
+
+static void sntp_send_request(void)
+{
+	if (sntp_clock_us)
+	{
+		// any value the answer can be matched with, the clock time as NTP does
+		sntp_cookie = sntp_local_time(sntp_clock_us()) | 1;
+		put_timestamp(&ntpmessage[40], sntp_cookie);
+	}
+	sendto(NTP_SOCKET,ntpmessage,sizeof(ntpmessage),NTPformat.dstaddr,ntp_port);
+	// sendto() returns once the request is sent
+	if (sntp_clock_us) sntp_t1_us = sntp_clock_us();
+}
+
+void reg_sntp_clock_cbfunc(uint64_t (*clock_us)(void))
+{
+	sntp_clock_us = clock_us;
+	sntp_synced = 0;
+}
+
+int8_t SNTP_get_time(tstamp *ntp)
+{
+	if (!sntp_clock_us || !sntp_synced) return 0;
+
+	*ntp = sntp_local_time(sntp_clock_us());
+	return 1;
+}
+
+int32_t SNTP_get_offset_us(void)
+{
+	return sntp_offset_us;
+}
+
+int32_t SNTP_get_delay_us(void)
+{
+	return sntp_delay_us;
 }
 
 void SNTP_init(uint8_t s, uint8_t *ntp_server, uint8_t tz, uint8_t *buf)
@@ -253,16 +415,28 @@ int8_t SNTP_run(datetime *time)
 	uint32_t destip = 0;
 	uint16_t destport;
 	uint16_t startindex = 40; //last 8-byte of data_buf[size is 48 byte] is xmt, so the startindex should be 40
+	uint64_t t4_us;
+	tstamp now;
 
 	switch(getSn_SR(NTP_SOCKET))
 	{
 	case SOCK_UDP:
 		if ((RSR_len = getSn_RX_RSR(NTP_SOCKET)) > 0)
 		{
+			t4_us = sntp_clock_us ? sntp_clock_us() : 0;	// as soon as the answer is seen, before reading it
 			if (RSR_len > MAX_SNTP_BUF_SIZE) RSR_len = MAX_SNTP_BUF_SIZE;	// if Rx data size is lager than TX_RX_MAX_BUF_SIZE
-			recvfrom(NTP_SOCKET, data_buf, RSR_len, (uint8_t *)&destip, &destport);
+			RSR_len = recvfrom(NTP_SOCKET, data_buf, RSR_len, (uint8_t *)&destip, &destport);
 
-			get_seconds_from_ntp_server(data_buf,startindex);
+			if (sntp_clock_us)
+			{
+				if (!sntp_discipline(data_buf, RSR_len, t4_us)) break;	// not the answer, keep waiting
+				now = sntp_local_time(t4_us);
+				calcdatetime(apply_time_zone(now >> 32));
+			}
+			else
+			{
+				get_seconds_from_ntp_server(data_buf,startindex);
+			}
 			time->yy = Nowdatetime.yy;
 			time->mo = Nowdatetime.mo;
 			time->dd = Nowdatetime.dd;
@@ -280,14 +454,14 @@ int8_t SNTP_run(datetime *time)
 		{
 			if(ntp_retry_cnt==0)//first send request, no need to wait
 			{
-				sendto(NTP_SOCKET,ntpmessage,sizeof(ntpmessage),NTPformat.dstaddr,ntp_port);
+				sntp_send_request();
 				ntp_retry_cnt++;
 			}
 			else // send request again? it should wait for a while
 			{
 				if((ntp_retry_cnt % 0xFFF) == 0) //wait time
 				{
-					sendto(NTP_SOCKET,ntpmessage,sizeof(ntpmessage),NTPformat.dstaddr,ntp_port);
+					sntp_send_request();
 #ifdef _SNTP_DEBUG_
 					printf("ntp retry: %d\r\n", ntp_retry_cnt);
 #endif
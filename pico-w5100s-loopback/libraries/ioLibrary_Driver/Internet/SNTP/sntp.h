@@ -63,12 +63,37 @@ typedef struct _datetime
 #define UTC_ADJ_HRS		9              	        // SEOUL : GMT+9
 #define EPOCH			1900                    // NTP start year
 
+#ifndef SNTP_STEP_US
+#define SNTP_STEP_US	128000UL				// offsets over it step the clock, smaller ones are slewed
+#endif
+#ifndef SNTP_SLEW_PPM
+#define SNTP_SLEW_PPM	500UL					// rate of the slew, in us per second
+#endif
+
 void get_seconds_from_ntp_server(uint8_t *buf, uint16_t idx);
 void SNTP_init(uint8_t s, uint8_t *ntp_server, uint8_t tz, uint8_t *buf);
 int8_t SNTP_run(datetime *time);
 tstamp changedatetime_to_seconds(void);
 void calcdatetime(tstamp seconds);
 
+/*
+ * @brief Register the microsecond clock the exchanges are timed with, time_us_64() on the RP2040
+ * @details With it SNTP_run() takes the originate, receive and transmit timestamps into account,
+ *          the offset and the round trip delay are computed as NTP does, and the local clock is
+ *          stepped on the first answer then slewed at SNTP_SLEW_PPM. Without it the time is the
+ *          transmit timestamp of the server, to the second.
+ */
+void reg_sntp_clock_cbfunc(uint64_t (*clock_us)(void));
+/*
+ * @brief Get the time of the disciplined clock, NTP timestamp with 32 bits of fraction
+ * @return 1 once SNTP_run() synchronized it, 0 before or without a registered clock
+ */
+int8_t SNTP_get_time(tstamp *ntp);
+/* @brief Offset of the last answer corrected, in us */
+int32_t SNTP_get_offset_us(void);
+/* @brief Round trip delay of the last answer, the server time excluded, in us */
+int32_t SNTP_get_delay_us(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -34,6 +34,11 @@ static uint16_t g_local_port = 0;
 static uint32_t g_tftp_state = STATE_NONE;
 static uint16_t g_block_num = 0;
 
+static uint16_t g_blk_size = TFTP_BLK_SIZE;
+static uint16_t g_window_size = 1;
+static uint16_t g_window_cnt = 0;		// blocks received since the last ACK
+static uint8_t g_gap_acked = 0;			// ACK sent for a block out of order, until the next one in order
+
 static uint32_t g_timeout = 5;
 static uint32_t g_resend_flag = 0;
 static uint32_t tftp_time_cnt = 0;
@@ -41,10 +46,15 @@ static uint32_t tftp_retry_cnt = 0;
 
 static uint8_t *g_tftp_rcv_buf = NULL;
 
-static TFTP_OPTION default_tftp_opt = {
-	.code = (uint8_t *)"timeout",
-	.value = (uint8_t *)"5"
+static uint8_t g_blk_size_opt[6];
+static uint8_t g_window_size_opt[6];
+
+static TFTP_OPTION default_tftp_opt[] = {
+	{ .code = (uint8_t *)"timeout", .value = (uint8_t *)"5" },
+	{ .code = (uint8_t *)"blksize", .value = g_blk_size_opt },
+	{ .code = (uint8_t *)"windowsize", .value = g_window_size_opt }
 };
+#define DEFAULT_TFTP_OPT_NUM	(sizeof(default_tftp_opt) / sizeof(default_tftp_opt[0]))
 
 uint8_t g_progress_state = TFTP_PROGRESS;
 
@@ -187,6 +197,7 @@ static int recv_udp_packet(int socket, uint8_t *packet, uint32_t len, uint32_t *
 
 			return recv_len;
 		}
+		return 0;
 	}
 	return -1;
 }
@@ -208,6 +219,12 @@ static void init_tftp(void)
 	set_tftp_state(STATE_NONE);
 	set_block_number(0);
 
+	set_tftp_timeout(5);
+	g_blk_size = TFTP_BLK_SIZE;
+	g_window_size = 1;
+	g_window_cnt = 0;
+	g_gap_acked = 0;
+
 	/* timeout flag */
 	g_resend_flag = 0;
 	tftp_retry_cnt = tftp_time_cnt = 0;
@@ -231,9 +248,100 @@ static void tftp_reg_timeout()
 	}
 }
 
-static void process_tftp_option(uint8_t *msg, uint32_t msg_len)
+static void set_option_value(uint8_t *value, uint32_t num)
+{
+	uint8_t digits[5];
+	uint32_t i = 0;
+
+	do {
+		digits[i++] = '0' + num % 10;
+		num /= 10;
+	} while(num && i < sizeof(digits));
+
+	while(i)
+		*value++ = digits[--i];
+	*value = 0;
+}
+
+static uint32_t get_option_value(uint8_t *value)
+{
+	uint32_t num = 0;
+
+	while(*value >= '0' && *value <= '9' && num < 100000)
+		num = num * 10 + (*value++ - '0');
+
+	return *value ? 0 : num;
+}
+
+/* option names are case insensitive, RFC 2347 */
+static int is_option(uint8_t *opt, const char *name)
+{
+	while(*name) {
+		if((*opt++ | 0x20) != *name++)
+			return 0;
+	}
+	return *opt == 0;
+}
+
+/* blksize and windowsize for the RRQ, as many blocks as the socket RX buffer holds */
+static void set_request_option(void)
 {
-	/* TODO Option Process */
+	uint32_t rx_max = getSn_RxMAX(g_tftp_socket);
+	uint32_t blk_size = TFTP_BLK_SIZE_MAX, window_size;
+
+	/* every DATA takes its 4 bytes of header and the 8 bytes of UDP header of the W5x00 */
+	if(blk_size + 12 > rx_max)
+		blk_size = rx_max - 12;
+	window_size = rx_max / (blk_size + 12);
+	if(window_size > TFTP_WINDOW_SIZE_MAX)
+		window_size = TFTP_WINDOW_SIZE_MAX;
+
+	set_option_value(g_blk_size_opt, blk_size);
+	set_option_value(g_window_size_opt, window_size);
+}
+
+/* take the options of an OACK, -1 if one is more than asked for */
+static int process_tftp_option(uint8_t *msg, uint32_t msg_len)
+{
+	uint8_t *opt = msg + 2, *end = msg + msg_len, *value, *next;
+	uint32_t num;
+
+	/* the options missing from the OACK were refused */
+	g_blk_size = TFTP_BLK_SIZE;
+	g_window_size = 1;
+
+	while(opt < end) {
+		value = memchr(opt, 0, end - opt);
+		if(value == NULL || ++value >= end)
+			break;
+		next = memchr(value, 0, end - value);
+		if(next == NULL)
+			break;
+
+		num = get_option_value(value);
+		if(is_option(opt, "blksize")) {
+			if(num < 8 || num > get_option_value(g_blk_size_opt))
+				return -1;
+			g_blk_size = num;
+		}
+		else if(is_option(opt, "windowsize")) {
+			if(num < 1 || num > get_option_value(g_window_size_opt))
+				return -1;
+			g_window_size = num;
+		}
+		else if(is_option(opt, "timeout")) {
+			if(num < 1 || num > 255)
+				return -1;
+			set_tftp_timeout(num);
+		}
+
+		opt = next + 1;
+	}
+
+#ifdef __TFTP_DEBUG__
+	DBG_PRINT(INFO_DBG, "[%s] blksize(%d), windowsize(%d), timeout(%d)\r\n", __func__, g_blk_size, g_window_size, get_tftp_timeout());
+#endif
+	return 0;
 }
 
 static void send_tftp_rrq(uint8_t *filename, uint8_t *mode, TFTP_OPTION *opt, uint8_t opt_len)
@@ -415,37 +523,40 @@ static void recv_tftp_data(uint8_t *msg, uint32_t msg_len)
 	switch(get_tftp_state())
 	{
 		case STATE_RRQ :
+			/* no OACK, the server ignored the options */
+			g_blk_size = TFTP_BLK_SIZE;
+			g_window_size = 1;
+			/* fall through */
 		case STATE_OACK :
-			if(data->block_num == 1) {
-				set_tftp_state(STATE_DATA);
-				set_block_number(data->block_num);
-#ifdef F_STORAGE
-				save_data(data->data, msg_len - 4, data->block_num);
-#endif
-				tftp_cancel_timeout();
-			}
-			send_tftp_ack(data->block_num);
-
-			if((msg_len - 4) < TFTP_BLK_SIZE) {
-				init_tftp();
-				g_progress_state = TFTP_SUCCESS;
-			}
-
-			break;
-			
 		case STATE_DATA :
-			if(data->block_num == (get_block_number() + 1)) {
+			if(data->block_num == (uint16_t)(get_block_number() + 1)) {
+				set_tftp_state(STATE_DATA);
 				set_block_number(data->block_num);
 #ifdef F_STORAGE
 				save_data(data->data, msg_len - 4, data->block_num);
 #endif
 				tftp_cancel_timeout();
+				g_gap_acked = 0;
+
+				/* ACK the last block of a window, the server sends the next window meanwhile */
+				if(((msg_len - 4) < g_blk_size) || (++g_window_cnt >= g_window_size)) {
+					send_tftp_ack(data->block_num);
+					g_window_cnt = 0;
+				}
+				else {
+					tftp_reg_timeout();
+				}
+
+				if((msg_len - 4) < g_blk_size) {
+					init_tftp();
+					g_progress_state = TFTP_SUCCESS;
+				}
 			}
-			send_tftp_ack(data->block_num);
-
-			if((msg_len - 4) < TFTP_BLK_SIZE) {
-				init_tftp();
-				g_progress_state = TFTP_SUCCESS;
+			else if((g_window_size == 1) || (g_gap_acked == 0)) {
+				/* a block lost or sent again, the server goes on after the last one in order */
+				send_tftp_ack(get_block_number());
+				g_window_cnt = 0;
+				g_gap_acked = 1;
 			}
 
 			break;
@@ -485,7 +596,14 @@ static void recv_tftp_oack(uint8_t *msg, uint32_t msg_len)
 	switch(get_tftp_state())
 	{
 		case STATE_RRQ :
-			process_tftp_option(msg, msg_len);	
+			if(process_tftp_option(msg, msg_len) < 0) {
+#ifdef __TFTP_DEBUG__
+				DBG_PRINT(ERROR_DBG, "[%s] Option faults\r\n", __func__);
+#endif
+				init_tftp();
+				g_progress_state = TFTP_FAIL;
+				break;
+			}
 			set_tftp_state(STATE_OACK);
 			tftp_cancel_timeout();
 			send_tftp_ack(0);
@@ -592,7 +710,8 @@ void TFTP_exit(void)
 
 int TFTP_run(void)
 {
-	uint16_t len, from_port;
+	int len;
+	uint16_t from_port;
 	uint32_t from_ip;
 
 	/* Timeout Process */
@@ -603,7 +722,7 @@ int TFTP_run(void)
 				break;
 
 			case STATE_RRQ:
-				send_tftp_rrq(g_filename, (uint8_t *)TRANS_BINARY, &default_tftp_opt, 1);
+				send_tftp_rrq(g_filename, (uint8_t *)TRANS_BINARY, default_tftp_opt, DEFAULT_TFTP_OPT_NUM);
 				break;
 
 			case STATE_OACK:
@@ -630,9 +749,10 @@ int TFTP_run(void)
 
 	/* Receive Packet Process */
 	len = recv_udp_packet(g_tftp_socket, g_tftp_rcv_buf, MAX_MTU_SIZE, &from_ip, &from_port);
-	if(len < 0) {
+	if(len <= 0) {
 #ifdef __TFTP_DEBUG__
-		DBG_PRINT(ERROR_DBG, "[%s] recv_udp_packet error\r\n", __func__);
+		if(len < 0)
+			DBG_PRINT(ERROR_DBG, "[%s] recv_udp_packet error\r\n", __func__);
 #endif
 		return g_progress_state;
 	}
@@ -650,7 +770,8 @@ void TFTP_read_request(uint32_t server_ip, uint8_t *filename)
 #endif
 
 	g_progress_state = TFTP_PROGRESS;
-	send_tftp_rrq(filename, (uint8_t *)TRANS_BINARY, &default_tftp_opt, 1);
+	set_request_option();
+	send_tftp_rrq(filename, (uint8_t *)TRANS_BINARY, default_tftp_opt, DEFAULT_TFTP_OPT_NUM);
 }
 
 void tftp_timeout_handler(void)
@@ -64,6 +64,12 @@ extern int dbg_level;
 #define TFTP_SERVER_PORT		69
 #define TFTP_TEMP_PORT			51000
 #define TFTP_BLK_SIZE			512
+#ifndef TFTP_BLK_SIZE_MAX
+#define TFTP_BLK_SIZE_MAX		1428	// RFC 2348 blksize asked for, a DATA in one Ethernet frame
+#endif
+#ifndef TFTP_WINDOW_SIZE_MAX
+#define TFTP_WINDOW_SIZE_MAX	16		// RFC 7440 windowsize asked for at most, less if the socket RX buffer holds less
+#endif
 #define MAX_MTU_SIZE			1514
 #define FILE_NAME_SIZE			20
 
@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "socket.h"
 #include "httpParser.h"
 
@@ -19,6 +20,35 @@ uint8_t BUFPUB[256];
  ****************************************************************************/
 static void replacetochar(uint8_t * str, uint8_t oldchar, uint8_t newchar); 	/* Replace old character with new character in the string */
 static uint8_t C2D(uint8_t c); 												/* Convert a character to HEX */
+static uint16_t http_scan(const uint8_t * buf, uint16_t pos, uint16_t end, uint8_t c);	/* Find a character, a word at a time */
+static void http_parse_request_line(st_http_parser * parser, const uint8_t * buf, uint16_t pos, uint16_t end);
+static void http_parse_header(st_http_parser * parser, const uint8_t * buf, uint16_t pos, uint16_t end);
+static void http_parse_params(st_http_parser * parser, const uint8_t * buf, uint16_t pos, uint16_t end);
+static uint8_t http_strnieq(const uint8_t * s1, const char * s2, uint16_t n);				/* Compare, case insensitive */
+static uint8_t http_token_prefix(const uint8_t * buf, const st_http_token * val, const char * s);
+static uint8_t http_token_gzip(const uint8_t * buf, const st_http_token * val);
+static void http_token_copy(const uint8_t * buf, const st_http_token * val, uint8_t * dst, uint16_t size);
+static uint32_t http_token_num(const uint8_t * buf, const st_http_token * val);
+
+// A word with a zero byte, for the scan of 4 bytes at a time
+#define HTTP_WORD_ONES			0x01010101UL
+#define HTTP_WORD_HAS_ZERO(w)	(((w) - HTTP_WORD_ONES) & ~(w) & 0x80808080UL)
+
+// Names of the headers kept, lower case, in the order of HTTP_HDR_xxx
+static const struct
+{
+	const char *	name;
+	uint8_t			len;
+} http_headers[HTTP_HDR_CNT] =
+{
+	{ "connection", 10 },
+	{ "content-length", 14 },
+	{ "accept-encoding", 15 },
+	{ "if-none-match", 13 },
+	{ "upgrade", 7 },
+	{ "sec-websocket-version", 21 },
+	{ "sec-websocket-key", 17 },
+};
 
 /**
  @brief	convert escape characters(%XX) to ASCII character
@@ -129,41 +159,393 @@ void parse_http_request(
 	uint8_t * buf				/**< pointer to be parsed */
 	)
 {
-  char * nexttok;
-  nexttok = strtok((char*)buf," ");
-  if(!nexttok)
-  {
-    request->METHOD = METHOD_ERR;
-    return;
-  }
-  if(!strcmp(nexttok, "GET") || !strcmp(nexttok,"get"))
-  {
-    request->METHOD = METHOD_GET;
-    nexttok = strtok(NULL," ");
-
-  }
-  else if (!strcmp(nexttok, "HEAD") || !strcmp(nexttok,"head"))
-  {
-    request->METHOD = METHOD_HEAD;
-    nexttok = strtok(NULL," ");
-
-  }
-  else if (!strcmp(nexttok, "POST") || !strcmp(nexttok,"post"))
-  {
-    nexttok = strtok(NULL,"\0");
-    request->METHOD = METHOD_POST;
-  }
-  else
-  {
-    request->METHOD = METHOD_ERR;
-  }
-
-  if(!nexttok)
-  {
-    request->METHOD = METHOD_ERR;
-    return;
-  }
-  strcpy((char *)request->URI, nexttok);
+	st_http_parser parser;
+	uint16_t len;
+
+	// the whole null terminated request, a cut short one as it is
+	len = (uint16_t)strlen((char*)buf);
+	http_parser_init(&parser);
+	if(!http_parser_run(&parser, buf, len)) http_parser_end(&parser, len);
+	http_parser_request(&parser, buf, request);
+}
+
+/**
+ @brief	get the length of the first request in the buffer, the header and the Content-Length body
+ @return the length, 0 if the request is not complete yet
+ */
+uint32_t get_http_request_len(
+	uint8_t * buf,	/**< received requests */
+	uint32_t len	/**< length of the received requests */
+	)
+{
+	st_http_parser parser;
+
+	http_parser_init(&parser);
+	return http_parser_run(&parser, buf, (uint16_t)len);
+}
+
+/**
+ @brief	start the parsing of a new request
+ */
+void http_parser_init(st_http_parser * parser)
+{
+	memset(parser, 0, sizeof(*parser));
+}
+
+/**
+ @brief	tokenise the lines of the request received since the last call, and its body once all there
+ @return the length of the request once complete, 0 while more of it is to come
+ */
+uint32_t http_parser_run(
+	st_http_parser * parser,	/**< state, kept across the calls */
+	const uint8_t * buf,		/**< the request from its start, what was given before unchanged */
+	uint16_t len				/**< bytes received */
+	)
+{
+	uint16_t nl, end;
+
+	while(parser->state < HTTP_PARSE_BODY)
+	{
+		nl = http_scan(buf, parser->pos, len, '\n');
+		if(nl == len)
+		{
+			// the line is cut short, the next call scans only what comes after
+			parser->pos = len;
+			return 0;
+		}
+
+		end = nl;
+		if((end > parser->line) && (buf[end - 1] == '\r')) end--;
+
+		if(parser->state == HTTP_PARSE_LINE)
+		{
+			http_parse_request_line(parser, buf, parser->line, end);
+			parser->state = HTTP_PARSE_HEAD;
+		}
+		else if(end == parser->line)
+		{
+			// the blank line, the body follows
+			parser->head_len = nl + 1;
+			parser->content_len = http_token_num(buf, &parser->header[HTTP_HDR_CONTENT_LENGTH]);
+			parser->state = HTTP_PARSE_BODY;
+		}
+		else
+		{
+			http_parse_header(parser, buf, parser->line, end);
+		}
+
+		parser->line = parser->pos = nl + 1;
+	}
+
+	if(parser->state == HTTP_PARSE_BODY)
+	{
+		if((uint32_t)(len - parser->head_len) < parser->content_len) return 0;
+
+		parser->body.off = parser->head_len;
+		parser->body.len = (uint16_t)parser->content_len;
+		if(parser->METHOD == METHOD_POST) http_parse_params(parser, buf, parser->body.off, parser->body.off + parser->body.len);
+		parser->state = HTTP_PARSE_DONE;
+	}
+
+	return (uint32_t)parser->head_len + parser->body.len;
+}
+
+/**
+ @brief	end a request the buffer can't take whole, with what was received of it
+ @return the length of the request, len
+ */
+uint32_t http_parser_end(
+	st_http_parser * parser,	/**< state of the calls to http_parser_run() */
+	uint16_t len				/**< bytes received */
+	)
+{
+	// without its request line, it is not understood
+	if(parser->state == HTTP_PARSE_LINE) parser->METHOD = METHOD_ERR;
+	if(parser->state < HTTP_PARSE_BODY) parser->head_len = len;
+
+	parser->body.off = parser->head_len;
+	parser->body.len = len - parser->head_len;
+	parser->state = HTTP_PARSE_DONE;
+
+	return len;
+}
+
+/**
+ @brief	fill the request structure from the tokens of a complete request
+ */
+void http_parser_request(
+	st_http_parser * parser,	/**< state, HTTP_PARSE_DONE */
+	const uint8_t * buf,		/**< the request tokenised */
+	st_http_request * request	/**< request to be returned */
+	)
+{
+	const st_http_token * val;
+	uint16_t end, len, i;
+
+	request->METHOD = parser->METHOD;
+
+	// the URI, for a POST up to the end of its body where get_http_param_value() looks for it
+	end = parser->uri.off + parser->uri.len;
+	if(parser->METHOD == METHOD_POST) end = parser->body.off + parser->body.len;
+	len = end - parser->uri.off;
+	if(len > MAX_URI_SIZE - 1) len = MAX_URI_SIZE - 1;
+	memcpy(request->URI, buf + parser->uri.off, len);
+	request->URI[len] = '\0';
+	end = parser->uri.off + len;
+
+	// the parameters copied along whole, rebased on URI
+	request->PARAM_CNT = 0;
+	for(i = 0; i < parser->param_cnt; i++)
+	{
+		if(parser->param[i].value.off + parser->param[i].value.len > end) break;
+		request->PARAM[i] = parser->param[i];
+		request->PARAM[i].name.off -= parser->uri.off;
+		request->PARAM[i].value.off -= parser->uri.off;
+		request->PARAM_CNT++;
+	}
+
+	// HTTP/1.1 keeps the connection unless 'Connection: close', HTTP/1.0 only with 'Connection: keep-alive'
+	request->KEEPALIVE = parser->http11;
+	val = &parser->header[HTTP_HDR_CONNECTION];
+	if(http_token_prefix(buf, val, "close")) request->KEEPALIVE = 0;
+	else if(http_token_prefix(buf, val, "keep-alive")) request->KEEPALIVE = 1;
+
+	// Content negotiation and conditional GET, 'gzip;q=0' refuses gzip
+	request->ACCEPT_GZIP = http_token_gzip(buf, &parser->header[HTTP_HDR_ACCEPT_ENCODING]);
+	http_token_copy(buf, &parser->header[HTTP_HDR_IF_NONE_MATCH], request->IF_NONE_MATCH, sizeof(request->IF_NONE_MATCH));
+
+	// WebSocket upgrade (RFC 6455), only version 13 is spoken, the key of another is dropped
+	request->UPGRADE_WS = http_token_prefix(buf, &parser->header[HTTP_HDR_UPGRADE], "websocket");
+	request->WS_KEY[0] = '\0';
+	val = &parser->header[HTTP_HDR_WS_VERSION];
+	if(request->UPGRADE_WS && (val->len == 2) && !memcmp(buf + val->off, "13", 2))
+	{
+		http_token_copy(buf, &parser->header[HTTP_HDR_WS_KEY], request->WS_KEY, sizeof(request->WS_KEY));
+	}
+}
+
+/**
+ @brief	get a parameter value from the query, or the form body of a POST, tokenised by http_parser_request()
+ @return the value unescaped in a shared buffer, 0 if the request has no such parameter
+ */
+uint8_t * get_http_request_param(st_http_request * request, char * param_name)
+{
+	const st_http_param * param;
+	uint16_t name_len, len, i;
+
+	if(!request || !param_name) return 0;
+
+	name_len = (uint16_t)strlen(param_name);
+	for(i = 0; i < request->PARAM_CNT; i++)
+	{
+		param = &request->PARAM[i];
+		if((param->name.len != name_len) || memcmp(request->URI + param->name.off, param_name, name_len)) continue;
+
+		len = param->value.len;
+		if(len > sizeof(BUFPUB) - 1) len = sizeof(BUFPUB) - 1;
+		memcpy(BUFPUB, request->URI + param->value.off, len);
+		BUFPUB[len] = '\0';
+
+		// '+' first, a '%2B' stays a '+'
+		replacetochar(BUFPUB, '+', ' ');
+		unescape_http_url((char *)BUFPUB);
+#ifdef _HTTPPARSER_DEBUG_
+		printf("  %s=%s\r\n", param_name, BUFPUB);
+#endif
+		return BUFPUB;
+	}
+
+	return 0;
+}
+
+/**
+ @brief	find a character, a word at a time once aligned
+ @return its offset, end if not found
+ */
+static uint16_t http_scan(const uint8_t * buf, uint16_t pos, uint16_t end, uint8_t c)
+{
+	uint32_t pattern = HTTP_WORD_ONES * c;
+	uint32_t word;
+
+	while((pos < end) && ((uintptr_t)(buf + pos) & (sizeof(word) - 1)))
+	{
+		if(buf[pos] == c) return pos;
+		pos++;
+	}
+
+	// the bytes equal to c are zero in word ^ pattern, the loop below finds which one
+	while((uint16_t)(end - pos) >= sizeof(word))
+	{
+		memcpy(&word, buf + pos, sizeof(word));
+		word ^= pattern;
+		if(HTTP_WORD_HAS_ZERO(word)) break;
+		pos += sizeof(word);
+	}
+
+	while((pos < end) && (buf[pos] != c)) pos++;
+	return pos;
+}
+
+/**
+ @brief	tokenise the request line: the method, the URI and its query, the version
+ */
+static void http_parse_request_line(st_http_parser * parser, const uint8_t * buf, uint16_t pos, uint16_t end)
+{
+	uint16_t sp, q;
+
+	sp = http_scan(buf, pos, end, ' ');
+	if((sp - pos == 3) && http_strnieq(buf + pos, "get", 3))		parser->METHOD = METHOD_GET;
+	else if((sp - pos == 4) && http_strnieq(buf + pos, "head", 4))	parser->METHOD = METHOD_HEAD;
+	else if((sp - pos == 4) && http_strnieq(buf + pos, "post", 4))	parser->METHOD = METHOD_POST;
+	else															parser->METHOD = METHOD_ERR;
+
+	if(sp == end)
+	{
+		parser->METHOD = METHOD_ERR;
+		return;
+	}
+
+	pos = sp + 1;
+	sp = http_scan(buf, pos, end, ' ');
+	if(sp == pos) parser->METHOD = METHOD_ERR;
+
+	parser->uri.off = pos;
+	parser->uri.len = sp - pos;
+	parser->http11 = (end - sp == 9) && !memcmp(buf + sp + 1, "HTTP/1.1", 8);
+
+	q = http_scan(buf, pos, sp, '?');
+	if(q < sp)
+	{
+		parser->query.off = q + 1;
+		parser->query.len = sp - q - 1;
+		http_parse_params(parser, buf, q + 1, sp);
+	}
+}
+
+/**
+ @brief	tokenise a header line, the value of the ones kept
+ */
+static void http_parse_header(st_http_parser * parser, const uint8_t * buf, uint16_t pos, uint16_t end)
+{
+	uint16_t colon, i;
+
+	colon = http_scan(buf, pos, end, ':');
+	if(colon == end) return;
+
+	for(i = 0; i < HTTP_HDR_CNT; i++)
+	{
+		if((colon - pos == http_headers[i].len) && http_strnieq(buf + pos, http_headers[i].name, colon - pos)) break;
+	}
+	if(i == HTTP_HDR_CNT) return;
+
+	pos = colon + 1;
+	while((pos < end) && ((buf[pos] == ' ') || (buf[pos] == '\t'))) pos++;
+	while((end > pos) && ((buf[end - 1] == ' ') || (buf[end - 1] == '\t'))) end--;
+
+	parser->header[i].off = pos;
+	parser->header[i].len = end - pos;
+}
+
+/**
+ @brief	tokenise name=value pairs separated by '&'
+ */
+static void http_parse_params(st_http_parser * parser, const uint8_t * buf, uint16_t pos, uint16_t end)
+{
+	st_http_param * param;
+	uint16_t amp, eq;
+
+	while((pos < end) && (parser->param_cnt < MAX_HTTP_PARAMS))
+	{
+		amp = http_scan(buf, pos, end, '&');
+		if(amp > pos)
+		{
+			eq = http_scan(buf, pos, amp, '=');
+			param = &parser->param[parser->param_cnt++];
+			param->name.off = pos;
+			param->name.len = eq - pos;
+			param->value.off = (eq < amp) ? eq + 1 : amp;
+			param->value.len = amp - param->value.off;
+		}
+		pos = amp + 1;
+	}
+}
+
+/**
+ @brief	compare n characters, the ones of s2 lower case
+ @return 1 if equal but for the case
+ */
+static uint8_t http_strnieq(const uint8_t * s1, const char * s2, uint16_t n)
+{
+	uint16_t i;
+	uint8_t c;
+
+	for(i = 0; i < n; i++)
+	{
+		c = s1[i];
+		if((c >= 'A') && (c <= 'Z')) c += 'a' - 'A';
+		if(c != (uint8_t)s2[i]) return 0;
+	}
+	return 1;
+}
+
+/**
+ @brief	check the start of a header value, s lower case
+ @return 1 if the value starts with s but for the case
+ */
+static uint8_t http_token_prefix(const uint8_t * buf, const st_http_token * val, const char * s)
+{
+	uint16_t n = (uint16_t)strlen(s);
+
+	return (val->len >= n) && http_strnieq(buf + val->off, s, n);
+}
+
+/**
+ @brief	check an Accept-Encoding value for gzip, not refused by a zero q
+ @return 1 if gzip is accepted
+ */
+static uint8_t http_token_gzip(const uint8_t * buf, const st_http_token * val)
+{
+	uint16_t pos, end;
+
+	end = val->off + val->len;
+	for(pos = val->off; pos + 4 <= end; pos++)
+	{
+		if(!http_strnieq(buf + pos, "gzip", 4)) continue;
+
+		pos += 4;
+		if((end - pos < 3) || memcmp(buf + pos, ";q=", 3)) return 1;
+
+		// 'q=0', 'q=0.0' and the like refuse it
+		for(pos += 3; (pos < end) && ((buf[pos] == '0') || (buf[pos] == '.')); pos++);
+		return (pos < end) && (buf[pos] >= '1') && (buf[pos] <= '9');
+	}
+	return 0;
+}
+
+/**
+ @brief	copy a header value, a value longer than dst is cut short, still null terminated
+ */
+static void http_token_copy(const uint8_t * buf, const st_http_token * val, uint8_t * dst, uint16_t size)
+{
+	uint16_t len = val->len;
+
+	if(len > size - 1) len = size - 1;
+	memcpy(dst, buf + val->off, len);
+	dst[len] = '\0';
+}
+
+/**
+ @brief	convert a decimal header value
+ @return the value, 0 if absent
+ */
+static uint32_t http_token_num(const uint8_t * buf, const st_http_token * val)
+{
+	uint32_t num = 0;
+	uint16_t i;
+
+	for(i = 0; (i < val->len) && (buf[val->off + i] >= '0') && (buf[val->off + i] <= '9'); i++)
+		num = num * 10 + (buf[val->off + i] - '0');
+	return num;
 }
 
 #ifdef _OLD_
@@ -288,7 +670,7 @@ uint8_t get_http_uri_name(uint8_t * uri, uint8_t * uri_buf)
 	uri_ptr = (uint8_t *)strtok((char *)uri_buf, " ?");
 
 	if(strcmp((char *)uri_ptr,"/")) uri_ptr++;
-	strcpy((char *)uri_buf, (char *)uri_ptr);
+	memmove(uri_buf, uri_ptr, strlen((char *)uri_ptr) + 1); // overlapping, strcpy() may not copy it
 
 #ifdef _HTTPPARSER_DEBUG_
 	printf("  uri_name = %s\r\n", uri_buf);
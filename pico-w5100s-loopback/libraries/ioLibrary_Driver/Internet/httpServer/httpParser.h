@@ -47,6 +47,7 @@ extern "C" {
 
 
 /* HTTP response */
+#define		STATUS_SWITCH_PROTO	101
 #define		STATUS_OK			200
 #define		STATUS_CREATED		201
 #define		STATUS_ACCEPTED		202
@@ -64,14 +65,20 @@ extern "C" {
 #define		STATUS_SERV_UNAVAIL	503
 
 /* HTML Doc. for ERROR */
-static const char  	ERROR_HTML_PAGE[] = "HTTP/1.1 404 Not Found\r\nContent-Type: text/html\r\nContent-Length: 78\r\n\r\n<HTML>\r\n<BODY>\r\nSorry, the page you requested was not found.\r\n</BODY>\r\n</HTML>\r\n\0";
-static const char 	ERROR_REQUEST_PAGE[] = "HTTP/1.1 400 OK\r\nContent-Type: text/html\r\nContent-Length: 50\r\n\r\n<HTML>\r\n<BODY>\r\nInvalid request.\r\n</BODY>\r\n</HTML>\r\n\0";
+static const char  	ERROR_HTML_PAGE[] = "HTTP/1.1 404 Not Found\r\nContent-Type: text/html\r\nContent-Length: 80\r\n\r\n<HTML>\r\n<BODY>\r\nSorry, the page you requested was not found.\r\n</BODY>\r\n</HTML>\r\n\0";
+static const char 	ERROR_REQUEST_PAGE[] = "HTTP/1.1 400 Bad Request\r\nContent-Type: text/html\r\nContent-Length: 52\r\n\r\n<HTML>\r\n<BODY>\r\nInvalid request.\r\n</BODY>\r\n</HTML>\r\n\0";
+
+/* Response header for a content the client has, its ETag matched */
+#define RES_NOT_MODIF	"HTTP/1.1 304 Not Modified\r\n\r\n"
+
+/* Response header of a WebSocket upgrade, followed by the accept key and a blank line */
+#define RES_WS_SWITCH	"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: "
 
 /* HTML Doc. for CGI result  */
 #define HTML_HEADER "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: "
 
 /* Response header for HTML*/
-#define RES_HTMLHEAD_OK	"HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nConnection: keep-alive\r\nContent-Length: "
+#define RES_HTMLHEAD_OK	"HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: "
 
 /* Response head for TEXT */
 #define RES_TEXTHEAD_OK	"HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: "
@@ -89,7 +96,7 @@ static const char 	ERROR_REQUEST_PAGE[] = "HTTP/1.1 400 OK\r\nContent-Type: text
 #define RES_FLASHHEAD_OK "HTTP/1.1 200 OK\r\nContent-Type: application/x-shockwave-flash\r\nContent-Length: "
 
 /* Response head for XML */
-#define RES_XMLHEAD_OK "HTTP/1.1 200 OK\r\nContent-Type: text/xml\r\nConnection: keep-alive\r\nContent-Length: "
+#define RES_XMLHEAD_OK "HTTP/1.1 200 OK\r\nContent-Type: text/xml\r\nContent-Length: "
 
 /* Response head for CSS */
 #define RES_CSSHEAD_OK	"HTTP/1.1 200 OK\r\nContent-Type: text/css\r\nContent-Length: "		
@@ -127,21 +134,95 @@ static const char 	ERROR_REQUEST_PAGE[] = "HTTP/1.1 400 OK\r\nContent-Type: text
 
 //#define MAX_URI_SIZE	1461
 #define MAX_URI_SIZE	512
+#define MAX_ETAG_LIST_SIZE	64		// If-None-Match kept, a few ETags
+#define MAX_WS_KEY_SIZE		32		// Sec-WebSocket-Key kept, 24 characters of base64
+
+#define MAX_HTTP_PARAMS		8		// Parameters of the query or of the form body tokenised, the ones after aren't found
+
+/* Headers the incremental parser keeps, indexes of st_http_parser.header */
+#define HTTP_HDR_CONNECTION		0
+#define HTTP_HDR_CONTENT_LENGTH	1
+#define HTTP_HDR_ACCEPT_ENCODING	2
+#define HTTP_HDR_IF_NONE_MATCH	3
+#define HTTP_HDR_UPGRADE		4
+#define HTTP_HDR_WS_VERSION		5
+#define HTTP_HDR_WS_KEY			6
+#define HTTP_HDR_CNT			7
+
+/* States of the incremental parser, a zeroed one waits for the request line */
+#define HTTP_PARSE_LINE			0		/**< Request line not received whole yet. */
+#define HTTP_PARSE_HEAD			1		/**< Headers, up to the blank line.        */
+#define HTTP_PARSE_BODY			2		/**< Content-Length bytes of body.         */
+#define HTTP_PARSE_DONE			3		/**< Request complete.                     */
+
+/**
+ @brief 	Part of a request, as an offset and a length in the buffer it was received in
+ */
+typedef struct _st_http_token
+{
+	uint16_t	off;
+	uint16_t	len;					/**< 0 if the part is absent. */
+}st_http_token;
+
+typedef struct _st_http_param
+{
+	st_http_token	name;
+	st_http_token	value;
+}st_http_param;
+
+/**
+ @brief 	State of the incremental parser, nothing in it points into the buffer
+
+ The buffer is given again to each call with the bytes received since appended, a call
+ only scans those. As it keeps offsets, the buffer may be used for something else between
+ the calls, as long as the same bytes are back at the same offsets.
+ */
+typedef struct _st_http_parser
+{
+	uint8_t			state;				/**< HTTP_PARSE_LINE... */
+	uint8_t			METHOD;				/**< request method(METHOD_GET...). */
+	uint8_t			http11;				/**< 1 if the request line ends in HTTP/1.1. */
+	uint8_t			param_cnt;
+	uint16_t		pos;				/**< bytes scanned, the next call goes on from there. */
+	uint16_t		line;				/**< start of the line being scanned. */
+	uint16_t		head_len;			/**< request line and headers, the blank line included. */
+	uint32_t		content_len;
+	st_http_token	uri;				/**< path and query, as sent. */
+	st_http_token	query;				/**< after the '?', empty if none. */
+	st_http_token	body;
+	st_http_token	header[HTTP_HDR_CNT];	/**< values of the headers kept, without the spaces around them. */
+	st_http_param	param[MAX_HTTP_PARAMS];	/**< of the query, then of the body of a POST. */
+}st_http_parser;
 
 typedef struct _st_http_request
 {
 	uint8_t	METHOD;						/**< request method(METHOD_GET...). */
 	uint8_t	TYPE;						/**< request type(PTYPE_HTML...).   */
 	uint8_t	URI[MAX_URI_SIZE];			/**< request file name.             */
+	uint8_t	KEEPALIVE;					/**< 1 if the peer keeps the connection (HTTP/1.1, Connection: keep-alive). */
+	uint8_t	ACCEPT_GZIP;				/**< 1 if the peer takes a gzip Content-Encoding (Accept-Encoding: gzip). */
+	uint8_t	IF_NONE_MATCH[MAX_ETAG_LIST_SIZE];	/**< ETags of If-None-Match the peer has, empty if none. */
+	uint8_t	UPGRADE_WS;					/**< 1 if the peer asks for the WebSocket protocol (Upgrade: websocket). */
+	uint8_t	WS_KEY[MAX_WS_KEY_SIZE];	/**< Sec-WebSocket-Key of a version 13 upgrade, empty if none. */
+	uint8_t	PARAM_CNT;
+	st_http_param	PARAM[MAX_HTTP_PARAMS];	/**< parameters of the query and of a POST's body, as offsets in URI. */
 }st_http_request;
 
 // HTTP Parsing functions
 void unescape_http_url(char * url);								/* convert escape character to ascii */
 void parse_http_request(st_http_request *, uint8_t *);			/* parse request from peer */
+uint32_t get_http_request_len(uint8_t * buf, uint32_t len);	/* length of the first request in the buffer, 0 if incomplete */
 void find_http_uri_type(uint8_t *, uint8_t *);					/* find MIME type of a file */
 void make_http_response_head(char *, char, uint32_t);			/* make response header */
 uint8_t * get_http_param_value(char* uri, char* param_name);	/* get the user-specific parameter value */
 uint8_t get_http_uri_name(uint8_t * uri, uint8_t * uri_buf);	/* get the requested URI name */
+uint8_t * get_http_request_param(st_http_request * request, char * param_name);	/* get a parameter value from the tokens of the request */
+
+// Incremental parsing, the request is tokenised as it is received
+void http_parser_init(st_http_parser * parser);
+uint32_t http_parser_run(st_http_parser * parser, const uint8_t * buf, uint16_t len);	/* length of the request once complete, 0 before */
+uint32_t http_parser_end(st_http_parser * parser, uint16_t len);						/* takes the len bytes as the whole request */
+void http_parser_request(st_http_parser * parser, const uint8_t * buf, st_http_request * request);
 #ifdef _OLD_
 uint8_t * get_http_uri_name(uint8_t * uri);
 #endif
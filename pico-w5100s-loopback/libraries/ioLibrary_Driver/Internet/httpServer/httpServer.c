@@ -17,6 +17,13 @@
 	#define DATA_BUF_SIZE		2048
 #endif
 
+// Connection header inserted at the end of the response header
+#define HTTP_CONN_KEEPALIVE		"\r\nConnection: keep-alive"
+#define HTTP_CONN_CLOSE			"\r\nConnection: close"
+
+// Largest CGI response, the shared buffer takes its header too
+#define HTTP_CGI_BODY_MAX		(DATA_BUF_SIZE-(strlen(RES_CGIHEAD_OK)+8+strlen(HTTP_CONN_KEEPALIVE)))
+
 /*****************************************************************************
  * Private types/enumerations/variables
  ****************************************************************************/
@@ -30,6 +37,20 @@ static uint8_t * http_response;						/**< Pointer to HTTP response */
 
 // Number of registered web content in code flash memory
 static uint16_t total_content_cnt = 0;
+
+// Web content packed at build time, numbered from MAX_CONTENT_CALLBACK on
+static const httpServer_webPack * web_pack = NULL;
+
+// Content rendered by the application as it is sent
+static httpServer_generated generated_content[MAX_GENERATED_CALLBACK];
+static uint8_t total_generated_cnt = 0;
+
+#ifdef _USE_WEBSOCKET_
+// WebSocket handlers, no open handler denies every upgrade
+static uint8_t (*ws_open_cb)(uint8_t s, uint8_t * uri) = NULL;
+static void (*ws_recv_cb)(uint8_t s, uint8_t opcode, const uint8_t * data, uint16_t len, uint8_t last) = NULL;
+static void (*ws_close_cb)(uint8_t s) = NULL;
+#endif
 /*****************************************************************************
  * Public types/enumerations/variables
  ****************************************************************************/
@@ -57,6 +78,25 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request);
 static void send_http_response_header(uint8_t s, uint8_t content_type, uint32_t body_len, uint16_t http_status);
 static void send_http_response_body(uint8_t s, uint8_t * uri_name, uint8_t * buf, uint32_t start_addr, uint32_t file_len);
 static void send_http_response_cgi(uint8_t s, uint8_t * buf, uint8_t * http_body, uint16_t file_len);
+static int32_t http_send_avail(uint8_t s, uint8_t * buf, uint32_t len);
+static void http_send_all(uint8_t s, uint8_t * buf, uint32_t len);
+static void http_socket_reset(int8_t seqnum);
+static uint32_t http_connection_head(uint8_t s, uint8_t * buf);
+static void http_content_head(uint8_t s, uint8_t * buf, uint16_t http_status);
+static uint32_t http_insert_head(uint8_t * buf, const char * head);
+static uint8_t http_etag_match(st_http_request * p_http_request, uint32_t etag);
+static uint32_t http_content_etag(uint8_t * content, uint32_t len);
+static uint8_t find_gzip_webContent(uint8_t * content_name, uint16_t * content_num, uint32_t * file_len);
+static int32_t find_webPack_content(const uint8_t * content_name);
+static uint32_t webPack_hash(uint32_t seed, const uint8_t * name);
+static const httpServer_webContent * get_webContent(uint16_t content_num);
+static const httpServer_generated * find_generated_content(uint8_t * content_name);
+#ifdef _USE_WEBSOCKET_
+static void http_websocket_upgrade(uint8_t s, st_http_request * p_http_request, uint8_t * uri_name);
+static void http_websocket_process(uint8_t s, uint8_t seqnum);
+static void http_websocket_frame(void * arg, uint8_t opcode, const uint8_t * data, size_t len, bool last);
+static void http_websocket_end(uint8_t s, uint8_t seqnum);
+#endif
 
 /*****************************************************************************
  * Public functions
@@ -118,7 +158,12 @@ void httpServer_run(uint8_t seqnum)
 {
 	uint8_t s;	// socket number
 	uint16_t len;
-	uint32_t gettime = 0;
+	uint32_t req_len;
+	int32_t ret;
+	uint8_t * buf;
+#if _WIZCHIP_ == W5100S
+	wiz_pollfd pfd;
+#endif
 
 #ifdef _HTTPSERVER_DEBUG_
 	uint8_t destip[4] = {0, };
@@ -131,6 +176,17 @@ void httpServer_run(uint8_t seqnum)
 	// Get the H/W socket number
 	s = getHTTPSocketNum(seqnum);
 
+#if _WIZCHIP_ == W5100S
+	// An idle socket has only its keep-alive timeout to check until something is received, a response goes on regardless
+	if((HTTPSock_Status[seqnum].sock_status == STATE_HTTP_IDLE) && (HTTPSock_Status[seqnum].peek_len == 0) &&
+	   ((get_httpServer_timecount() - HTTPSock_Status[seqnum].res_time) <= HTTP_KEEPALIVE_TIMEOUT_SEC))
+	{
+		pfd.sn = s;
+		pfd.events = WIZ_POLLIN;
+		if(wiz_poll(&pfd, 1, 0) == 0) return;
+	}
+#endif
+
 	/* HTTP Service Start */
 	switch(getSn_SR(s))
 	{
@@ -138,7 +194,8 @@ void httpServer_run(uint8_t seqnum)
 			// Interrupt clear
 			if(getSn_IR(s) & Sn_IR_CON)
 			{
-				setSn_IR(s, Sn_IR_CON);
+				sockevent_clear(s, Sn_IR_CON);
+				HTTPSock_Status[seqnum].res_time = get_httpServer_timecount(); // Waiting for the first request
 			}
 
 			// HTTP Process states
@@ -146,42 +203,73 @@ void httpServer_run(uint8_t seqnum)
 			{
 
 				case STATE_HTTP_IDLE :
-					if ((len = getSn_RX_RSR(s)) > 0)
-					{
-						if (len > DATA_BUF_SIZE) len = DATA_BUF_SIZE;
-						len = recv(s, (uint8_t *)http_request, len);
+					buf = (uint8_t *)http_request;
 
-						*(((uint8_t *)http_request) + len) = '\0';
+					// Looked at in the RX buffer, the requests pipelined behind this one stay there for the next calls
+					len = 0;
+					if((ret = recv_peek(s, buf, DATA_BUF_SIZE - 1, 0)) > 0) len = (uint16_t)ret;
 
-						parse_http_request(parsed_http_request, (uint8_t *)http_request);
-#ifdef _HTTPSERVER_DEBUG_
-						getSn_DIPR(s, destip);
-						destport = getSn_DPORT(s);
-						printf("\r\n");
-						printf("> HTTPSocket[%d] : HTTP Request received ", s);
-						printf("from %d.%d.%d.%d : %d\r\n", destip[0], destip[1], destip[2], destip[3], destport);
-#endif
+					if(len == HTTPSock_Status[seqnum].peek_len)
+					{
+						// Nothing new to answer, a connection left idle is closed to free the socket
+						if((get_httpServer_timecount() - HTTPSock_Status[seqnum].res_time) > HTTP_KEEPALIVE_TIMEOUT_SEC)
+						{
 #ifdef _HTTPSERVER_DEBUG_
-						printf("> HTTPSocket[%d] : [State] STATE_HTTP_REQ_DONE\r\n", s);
+							printf("> HTTPSocket[%d] : [State] STATE_HTTP_IDLE: Keep-alive timeout\r\n", s);
 #endif
-						// HTTP 'response' handler; includes send_http_response_header / body function
-						http_process_handler(s, parsed_http_request);
+							http_disconnect(s);
+						}
+						break;
+					}
+
+					// pHTTP_RX is shared by the sockets, the peek brings this request's bytes back to the offsets the parser has
+					req_len = http_parser_run(&HTTPSock_Status[seqnum].parser, buf, len);
 
-						gettime = get_httpServer_timecount();
-						// Check the TX socket buffer for End of HTTP response sends
-						while(getSn_TX_FSR(s) != (getSn_TxMAX(s)))
+					HTTPSock_Status[seqnum].keepalive = 1;
+					if(req_len == 0)
+					{
+						// A request cut short waits for its remainder, unless the buffers can't take more of it
+						if((len < DATA_BUF_SIZE - 1) && (len < getSn_RxMAX(s)))
 						{
-							if((get_httpServer_timecount() - gettime) > 3)
-							{
+							HTTPSock_Status[seqnum].peek_len = len;
+							HTTPSock_Status[seqnum].res_time = get_httpServer_timecount();
+							break;
+						}
+						// Answered as it is, the connection is closed after
+						req_len = http_parser_end(&HTTPSock_Status[seqnum].parser, len);
+						HTTPSock_Status[seqnum].keepalive = 0;
+					}
+
+					// Only this request is consumed
+					recv_commit(s, (uint16_t)req_len);
+					HTTPSock_Status[seqnum].peek_len = 0;
+
+					http_parser_request(&HTTPSock_Status[seqnum].parser, buf, parsed_http_request);
+					http_parser_init(&HTTPSock_Status[seqnum].parser);
+					if(!parsed_http_request->KEEPALIVE) HTTPSock_Status[seqnum].keepalive = 0;
 #ifdef _HTTPSERVER_DEBUG_
-								printf("> HTTPSocket[%d] : [State] STATE_HTTP_REQ_DONE: TX Buffer clear timeout\r\n", s);
+					getSn_DIPR(s, destip);
+					destport = getSn_DPORT(s);
+					printf("\r\n");
+					printf("> HTTPSocket[%d] : HTTP Request received ", s);
+					printf("from %d.%d.%d.%d : %d\r\n", destip[0], destip[1], destip[2], destip[3], destport);
 #endif
-								break;
-							}
-						}
+#ifdef _HTTPSERVER_DEBUG_
+					printf("> HTTPSocket[%d] : [State] STATE_HTTP_REQ_DONE\r\n", s);
+#endif
+					// HTTP 'response' handler; includes send_http_response_header / body function
+					http_process_handler(s, parsed_http_request);
 
-						if(HTTPSock_Status[seqnum].file_len > 0) HTTPSock_Status[seqnum].sock_status = STATE_HTTP_RES_INPROC;
-						else HTTPSock_Status[seqnum].sock_status = STATE_HTTP_RES_DONE; // Send the 'HTTP response' end
+#ifdef _USE_WEBSOCKET_
+					// Upgraded, the 101 is out and the frames follow
+					if(HTTPSock_Status[seqnum].sock_status == STATE_HTTP_WEBSOCKET) break;
+#endif
+					// The body is streamed by the next calls as the TX buffer frees, without waiting here
+					if(HTTPSock_Status[seqnum].file_len > 0) HTTPSock_Status[seqnum].sock_status = STATE_HTTP_RES_INPROC;
+					else
+					{
+						HTTPSock_Status[seqnum].res_time = get_httpServer_timecount();
+						HTTPSock_Status[seqnum].sock_status = STATE_HTTP_RES_DONE; // Send the 'HTTP response' end
 					}
 					break;
 
@@ -190,21 +278,43 @@ void httpServer_run(uint8_t seqnum)
 #ifdef _HTTPSERVER_DEBUG_
 					printf("> HTTPSocket[%d] : [State] STATE_HTTP_RES_INPROC\r\n", s);
 #endif
-					// Repeatedly send remaining data to client
+					// Repeatedly send remaining data to client, as much as the TX buffer takes
 					send_http_response_body(s, 0, http_response, 0, 0);
 
-					if(HTTPSock_Status[seqnum].file_len == 0) HTTPSock_Status[seqnum].sock_status = STATE_HTTP_RES_DONE;
+					if(HTTPSock_Status[seqnum].file_len == 0)
+					{
+						HTTPSock_Status[seqnum].res_time = get_httpServer_timecount();
+						HTTPSock_Status[seqnum].sock_status = STATE_HTTP_RES_DONE;
+					}
 					break;
 
 				case STATE_HTTP_RES_DONE :
+					// Check the TX socket buffer for End of HTTP response sends, the other sockets are served meanwhile
+#if _WIZCHIP_ == W5100S
+					// hands the data queued behind the last SEND to the chip, SOCK_OK once none is left
+					if((send(s, http_response, 0) != SOCK_OK) || (getSn_TX_FSR(s) != getSn_TxMAX(s)))
+#else
+					if(getSn_TX_FSR(s) != getSn_TxMAX(s))
+#endif
+					{
+						if((get_httpServer_timecount() - HTTPSock_Status[seqnum].res_time) <= HTTP_MAX_TIMEOUT_SEC) break;
+#ifdef _HTTPSERVER_DEBUG_
+						printf("> HTTPSocket[%d] : [State] STATE_HTTP_RES_DONE: TX Buffer clear timeout\r\n", s);
+#endif
+						HTTPSock_Status[seqnum].keepalive = 0;
+					}
 #ifdef _HTTPSERVER_DEBUG_
 					printf("> HTTPSocket[%d] : [State] STATE_HTTP_RES_DONE\r\n", s);
 #endif
 					// Socket file info structure re-initialize
-					HTTPSock_Status[seqnum].file_len = 0;
-					HTTPSock_Status[seqnum].file_offset = 0;
-					HTTPSock_Status[seqnum].file_start = 0;
-					HTTPSock_Status[seqnum].sock_status = STATE_HTTP_IDLE;
+					http_socket_reset(seqnum);
+
+					// A kept connection waits for the next request, the pipelined ones first
+					if(HTTPSock_Status[seqnum].keepalive)
+					{
+						HTTPSock_Status[seqnum].res_time = get_httpServer_timecount();
+						break;
+					}
 
 //#ifdef _USE_SDCARD_
 //					f_close(&fs);
@@ -215,6 +325,12 @@ void httpServer_run(uint8_t seqnum)
 					http_disconnect(s);
 					break;
 
+#ifdef _USE_WEBSOCKET_
+				case STATE_HTTP_WEBSOCKET :
+					http_websocket_process(s, seqnum);
+					break;
+#endif
+
 				default :
 					break;
 			}
@@ -231,8 +347,24 @@ void httpServer_run(uint8_t seqnum)
 #ifdef _HTTPSERVER_DEBUG_
 			printf("> HTTPSocket[%d] : CLOSED\r\n", s);
 #endif
-			if(socket(s, Sn_MR_TCP, HTTP_SERVER_PORT, 0x00) == s)    /* Reinitialize the socket */
+#ifdef _USE_WEBSOCKET_
+			// An upgraded connection gone without a CLOSE
+			http_websocket_end(s, seqnum);
+#endif
+			// A response cut short by the client doesn't carry over to the next connection
+			http_socket_reset(seqnum);
+			HTTPSock_Status[seqnum].keepalive = 0;
+			HTTPSock_Status[seqnum].peek_len = 0;
+			http_parser_init(&HTTPSock_Status[seqnum].parser);
+
+			// Non-blocking, send() takes what the TX buffer has room for
+			if(socket(s, Sn_MR_TCP, HTTP_SERVER_PORT, SF_IO_NONBLOCK) == s)    /* Reinitialize the socket */
 			{
+#if _WIZCHIP_ == W5100S
+				// send() queues behind the SEND in progress instead of waiting for its SENDOK
+				uint8_t sendmode = SOCK_SEND_STREAM;
+				ctlsocket(s, CS_SET_SENDMODE, &sendmode);
+#endif
 #ifdef _HTTPSERVER_DEBUG_
 				printf("> HTTPSocket[%d] : OPEN\r\n", s);
 #endif
@@ -244,6 +376,10 @@ void httpServer_run(uint8_t seqnum)
 			break;
 
 		case SOCK_LISTEN:
+#if _WIZCHIP_ == W5100S
+			// Looked at again after HTTP_KEEPALIVE_TIMEOUT_SEC, or on the next connection
+			HTTPSock_Status[seqnum].res_time = get_httpServer_timecount();
+#endif
 			break;
 
 		default :
@@ -261,6 +397,9 @@ void httpServer_run(uint8_t seqnum)
 ////////////////////////////////////////////
 static void send_http_response_header(uint8_t s, uint8_t content_type, uint32_t body_len, uint16_t http_status)
 {
+	int8_t get_seqnum;
+	uint32_t send_len;
+
 	switch(http_status)
 	{
 		case STATUS_OK: 		// HTTP/1.1 200 OK
@@ -278,6 +417,9 @@ static void send_http_response_header(uint8_t s, uint8_t content_type, uint32_t
 #endif
 				// CGI/XML type request does not respond HTTP header to client
 				http_status = 0;
+
+				// Its end is only told by the disconnection
+				if((get_seqnum = getHTTPSequenceNum(s)) != -1) HTTPSock_Status[get_seqnum].keepalive = 0;
 			}
 			break;
 		case STATUS_BAD_REQ: 	// HTTP/1.1 400 OK
@@ -292,6 +434,12 @@ static void send_http_response_header(uint8_t s, uint8_t content_type, uint32_t
 #endif
 			memcpy(http_response, ERROR_HTML_PAGE, sizeof(ERROR_HTML_PAGE));
 			break;
+		case STATUS_NOT_MODIF:	// HTTP/1.1 304 Not Modified
+#ifdef _HTTPSERVER_DEBUG_
+			printf("> HTTPSocket[%d] : HTTP Response Header - STATUS_NOT_MODIF\r\n", s);
+#endif
+			strcpy((char *)http_response, RES_NOT_MODIF);
+			break;
 		default:
 			break;
 	}
@@ -299,10 +447,12 @@ static void send_http_response_header(uint8_t s, uint8_t content_type, uint32_t
 	// Send the HTTP Response 'header'
 	if(http_status)
 	{
+		http_content_head(s, http_response, http_status);
+		send_len = http_connection_head(s, http_response);
 #ifdef _HTTPSERVER_DEBUG_
-		printf("> HTTPSocket[%d] : [Send] HTTP Response Header [ %d ]byte\r\n", s, (uint16_t)strlen((char *)http_response));
+		printf("> HTTPSocket[%d] : [Send] HTTP Response Header [ %d ]byte\r\n", s, (uint16_t)send_len);
 #endif
-		send(s, http_response, strlen((char *)http_response));
+		http_send_all(s, http_response, send_len);
 	}
 }
 
@@ -310,8 +460,8 @@ static void send_http_response_body(uint8_t s, uint8_t * uri_name, uint8_t * buf
 {
 	int8_t get_seqnum;
 	uint32_t send_len;
-
-	uint8_t flag_datasend_end = 0;
+	int32_t ret;
+	st_http_socket * hs;
 
 #ifdef _USE_SDCARD_
 	uint16_t blocklen;
@@ -321,68 +471,24 @@ static void send_http_response_body(uint8_t s, uint8_t * uri_name, uint8_t * buf
 #endif
 
 	if((get_seqnum = getHTTPSequenceNum(s)) == -1) return; // exception handling; invalid number
+	hs = &HTTPSock_Status[get_seqnum];
 
 	// Send the HTTP Response 'body'; requested file
-	if(!HTTPSock_Status[get_seqnum].file_len) // ### Send HTTP response body: First part ###
+	if(file_len) // ### Send HTTP response body: First part ###
 	{
-		if (file_len > DATA_BUF_SIZE - 1)
-		{
-			HTTPSock_Status[get_seqnum].file_start = start_addr;
-			HTTPSock_Status[get_seqnum].file_len = file_len;
-			send_len = DATA_BUF_SIZE - 1;
+		hs->file_start = start_addr;
+		hs->file_len = file_len;
+		hs->file_offset = 0;
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 // ## 20141219 Eric added, for 'File object structure' (fs) allocation reduced (8 -> 1)
-			memset(HTTPSock_Status[get_seqnum].file_name, 0x00, MAX_CONTENT_NAME_LEN);
-			strcpy((char *)HTTPSock_Status[get_seqnum].file_name, (char *)uri_name);
+		memset(hs->file_name, 0x00, MAX_CONTENT_NAME_LEN);
+		strncpy((char *)hs->file_name, (char *)uri_name, MAX_CONTENT_NAME_LEN - 1);
 #ifdef _HTTPSERVER_DEBUG_
-			printf("> HTTPSocket[%d] : HTTP Response body - file name [ %s ]\r\n", s, HTTPSock_Status[get_seqnum].file_name);
+		printf("> HTTPSocket[%d] : HTTP Response body - file name [ %s ]\r\n", s, hs->file_name);
+		printf("> HTTPSocket[%d] : HTTP Response body - file len [ %ld ]byte\r\n", s, file_len);
 #endif
 /////////////////////////////////////////////////////////////////////////////////////////////////
-
-#ifdef _HTTPSERVER_DEBUG_
-			printf("> HTTPSocket[%d] : HTTP Response body - file len [ %ld ]byte\r\n", s, file_len);
-#endif
-		}
-		else
-		{
-			// Send process end
-			send_len = file_len;
-
-#ifdef _HTTPSERVER_DEBUG_
-			printf("> HTTPSocket[%d] : HTTP Response end - file len [ %ld ]byte\r\n", s, send_len);
-#endif
-		}
-#ifdef _USE_FLASH_
-		if(HTTPSock_Status[get_seqnum]->storage_type == DATAFLASH) addr = start_addr;
-#endif
-	}
-	else // remained parts
-	{
-#ifdef _USE_FLASH_
-		if(HTTPSock_Status[get_seqnum]->storage_type == DATAFLASH)
-		{
-			addr = HTTPSock_Status[get_seqnum].file_start + HTTPSock_Status[get_seqnum].file_offset;
-		}
-#endif
-		send_len = HTTPSock_Status[get_seqnum].file_len - HTTPSock_Status[get_seqnum].file_offset;
-
-		if(send_len > DATA_BUF_SIZE - 1)
-		{
-			send_len = DATA_BUF_SIZE - 1;
-			//HTTPSock_Status[get_seqnum]->file_offset += send_len;
-		}
-		else
-		{
-#ifdef _HTTPSERVER_DEBUG_
-			printf("> HTTPSocket[%d] : HTTP Response end - file len [ %ld ]byte\r\n", s, HTTPSock_Status[get_seqnum].file_len);
-#endif
-			// Send process end
-			flag_datasend_end = 1;
-		}
-#ifdef _HTTPSERVER_DEBUG_
-			printf("> HTTPSocket[%d] : HTTP Response body - send len [ %ld ]byte\r\n", s, send_len);
-#endif
 	}
 
 /*****************************************************/
@@ -392,70 +498,90 @@ static void send_http_response_body(uint8_t s, uint8_t * uri_name, uint8_t * buf
 	//HTTPSock_Status[get_seqnum]->storage_type == DATAFLASH
 /*****************************************************/
 
-	if(HTTPSock_Status[get_seqnum].storage_type == CODEFLASH)
+	// Fill the TX buffer as far as it has room, the rest is sent by the next calls
+	while(hs->file_offset < hs->file_len)
 	{
-		if(HTTPSock_Status[get_seqnum].file_len) start_addr = HTTPSock_Status[get_seqnum].file_start;
-		read_userReg_webContent(start_addr, &buf[0], HTTPSock_Status[get_seqnum].file_offset, send_len);
-	}
+		send_len = hs->file_len - hs->file_offset;
+		if(send_len > 0xFFFF) send_len = 0xFFFF;
+
+		if(hs->storage_type == CODEFLASH)
+		{
+			// Straight from the content, in XIP flash or RAM, into the TX buffer
+			if(!hs->content) ret = SOCKERR_ARG;
+			else ret = http_send_avail(s, (uint8_t *)hs->content->content + hs->file_offset, send_len);
+		}
 #ifdef _USE_SDCARD_
-	else if(HTTPSock_Status[get_seqnum].storage_type == SDCARD)
-	{
-		// Data read from SD Card
-		fr = f_read(&fs, &buf[0], send_len, (void *)&blocklen);
-		if(fr != FR_OK)
+		else if(hs->storage_type == SDCARD)
 		{
-			send_len = 0;
+			// Data read from SD Card, as much as the TX buffer takes, the file is reopened by name every time
+			if(send_len > getSn_TX_FSR(s)) send_len = getSn_TX_FSR(s);
+			if(send_len > DATA_BUF_SIZE - 1) send_len = DATA_BUF_SIZE - 1;
+			if(send_len == 0) break;
+
+			if((fr = f_open(&fs, (const char *)hs->file_name, FA_READ)) == FR_OK)
+			{
+				if((fr = f_lseek(&fs, hs->file_offset)) == FR_OK) fr = f_read(&fs, &buf[0], send_len, (void *)&blocklen);
+				f_close(&fs);
+			}
+			if((fr != FR_OK) || (blocklen == 0))
+			{
+				ret = SOCKERR_ARG;
 #ifdef _HTTPSERVER_DEBUG_
-		printf("> HTTPSocket[%d] : [FatFs] Error code return: %d (File Read) / HTTP Send Failed - %s\r\n", s, fr, HTTPSock_Status[get_seqnum].file_name);
+				printf("> HTTPSocket[%d] : [FatFs] Error code return: %d (File Read) / HTTP Send Failed - %s\r\n", s, fr, hs->file_name);
 #endif
+			}
+			else ret = http_send_avail(s, buf, blocklen);
 		}
-		else
+#endif
+#ifdef _USE_FLASH_
+		else if(hs->storage_type == DATAFLASH)
 		{
-			*(buf+send_len+1) = 0; // Insert '/0' for indicates the 'End of String' (null terminated)
+			// Data read from external data flash memory
+			addr = hs->file_start + hs->file_offset;
+			if(send_len > getSn_TX_FSR(s)) send_len = getSn_TX_FSR(s);
+			if(send_len > DATA_BUF_SIZE - 1) send_len = DATA_BUF_SIZE - 1;
+			if(send_len == 0) break;
+
+			read_from_flashbuf(addr, &buf[0], send_len);
+			ret = http_send_avail(s, buf, send_len);
 		}
-	}
 #endif
+		else if(hs->storage_type == GENERATED)
+		{
+			// Rendered into the shared buffer, no more than the TX buffer takes so the next read follows on
+			if(send_len > getSn_TX_FSR(s)) send_len = getSn_TX_FSR(s);
+			if(send_len > DATA_BUF_SIZE - 1) send_len = DATA_BUF_SIZE - 1;
+			if(send_len == 0) break;
 
-#ifdef _USE_FLASH_
-	else if(HTTPSock_Status[get_seqnum]->storage_type == DATAFLASH)
-	{
-		// Data read from external data flash memory
-		read_from_flashbuf(addr, &buf[0], send_len);
-		*(buf+send_len+1) = 0; // Insert '/0' for indicates the 'End of String' (null terminated)
+			if(!hs->generated || !(send_len = hs->generated->read(s, hs->file_offset, buf, (uint16_t)send_len))) ret = SOCKERR_ARG;
+			else ret = http_send_avail(s, buf, send_len);
+		}
+		else
+		{
+			ret = SOCKERR_ARG;
+		}
+
+		if(ret < 0) hs->file_offset = hs->file_len; // give up the body
+		else if(ret == 0) break;                    // TX buffer full, or the SEND in progress not done yet
+		else hs->file_offset += ret;
 	}
-#endif
-	else
+
+	if(hs->file_offset >= hs->file_len)
 	{
-		send_len = 0;
-	}
-	// Requested content send to HTTP client
+		// Send process end
 #ifdef _HTTPSERVER_DEBUG_
-	printf("> HTTPSocket[%d] : [Send] HTTP Response body [ %ld ]byte\r\n", s, send_len);
+		printf("> HTTPSocket[%d] : HTTP Response end - file len [ %ld ]byte\r\n", s, hs->file_len);
 #endif
-
-	if(send_len) send(s, buf, send_len);
-	else flag_datasend_end = 1;
-
-	if(flag_datasend_end)
-	{
-		HTTPSock_Status[get_seqnum].file_start = 0;
-		HTTPSock_Status[get_seqnum].file_len = 0;
-		HTTPSock_Status[get_seqnum].file_offset = 0;
-		flag_datasend_end = 0;
+		hs->file_start = 0;
+		hs->file_len = 0;
+		hs->file_offset = 0;
 	}
+#ifdef _HTTPSERVER_DEBUG_
 	else
 	{
-		HTTPSock_Status[get_seqnum].file_offset += send_len;
-#ifdef _HTTPSERVER_DEBUG_
-		printf("> HTTPSocket[%d] : HTTP Response body - offset [ %ld ]\r\n", s, HTTPSock_Status[get_seqnum].file_offset);
-#endif
+		printf("> HTTPSocket[%d] : HTTP Response body - offset [ %ld ]\r\n", s, hs->file_offset);
 	}
-
-// ## 20141219 Eric added, for 'File object structure' (fs) allocation reduced (8 -> 1)
-#ifdef _USE_SDCARD_
-	f_close(&fs);
 #endif
-// ## 20141219 added end
 }
 
 static void send_http_response_cgi(uint8_t s, uint8_t * buf, uint8_t * http_body, uint16_t file_len)
@@ -465,12 +591,117 @@ static void send_http_response_cgi(uint8_t s, uint8_t * buf, uint8_t * http_body
 #ifdef _HTTPSERVER_DEBUG_
 	printf("> HTTPSocket[%d] : HTTP Response Header + Body - CGI\r\n", s);
 #endif
-	send_len = sprintf((char *)buf, "%s%d\r\n\r\n%s", RES_CGIHEAD_OK, file_len, http_body);
+	sprintf((char *)buf, "%s%d\r\n\r\n%s", RES_CGIHEAD_OK, file_len, http_body);
+	send_len = http_connection_head(s, buf);
 #ifdef _HTTPSERVER_DEBUG_
 	printf("> HTTPSocket[%d] : HTTP Response Header + Body - send len [ %d ]byte\r\n", s, send_len);
 #endif
 
-	send(s, buf, send_len);
+	http_send_all(s, buf, send_len);
+}
+
+/* Send up to len bytes without waiting, returns the bytes taken by the TX buffer or a SOCKERR */
+static int32_t http_send_avail(uint8_t s, uint8_t * buf, uint32_t len)
+{
+	int32_t ret;
+	uint16_t freesize;
+
+	freesize = getSn_TX_FSR(s);
+	if(len > freesize) len = freesize;
+	if(len == 0) return 0;
+
+	ret = send(s, buf, (uint16_t)len);
+	if(ret == SOCK_BUSY) return 0;
+
+	return ret;
+}
+
+/*
+ * Send a response from the shared buffer, which doesn't outlive this call.
+ * It is sent into a TX buffer emptied at STATE_HTTP_RES_DONE, so it normally takes it at once.
+ */
+static void http_send_all(uint8_t s, uint8_t * buf, uint32_t len)
+{
+	int32_t ret;
+
+	while(len)
+	{
+		if((ret = http_send_avail(s, buf, len)) < 0) break;
+		buf += ret;
+		len -= ret;
+	}
+}
+
+/* Insert the Connection header at the end of the response header in buf, returns the response length */
+static uint32_t http_connection_head(uint8_t s, uint8_t * buf)
+{
+	int8_t seqnum;
+
+	if((seqnum = getHTTPSequenceNum(s)) == -1) return strlen((char *)buf);
+
+	return http_insert_head(buf, HTTPSock_Status[seqnum].keepalive ? HTTP_CONN_KEEPALIVE : HTTP_CONN_CLOSE);
+}
+
+/* Insert the caching headers of the registered content of the response, and its encoding */
+static void http_content_head(uint8_t s, uint8_t * buf, uint16_t http_status)
+{
+	int8_t seqnum;
+	const httpServer_webContent * content;
+	uint16_t content_num;
+	uint32_t file_len;
+	char head[32 + sizeof(HTTP_CACHE_CONTROL)];
+
+	if((seqnum = getHTTPSequenceNum(s)) == -1) return;
+	if(!(content = HTTPSock_Status[seqnum].content)) return;
+
+	sprintf(head, "\r\nETag: \"%08lx\"\r\nCache-Control: " HTTP_CACHE_CONTROL, (unsigned long)content->content_etag);
+	http_insert_head(buf, head);
+
+	// A 304 has no body to be encoded, the client keeps the Content-Encoding of its copy
+	if(content->content_gzip && (http_status == STATUS_OK)) http_insert_head(buf, "\r\nContent-Encoding: gzip");
+
+	// The response depends on Accept-Encoding if the content is a gzip variant, or has one
+	if(content->content_gzip || find_gzip_webContent((uint8_t *)content->content_name, &content_num, &file_len))
+		http_insert_head(buf, "\r\nVary: Accept-Encoding");
+}
+
+/* Insert a header line, CRLF first, at the end of the response header in buf, returns the response length */
+static uint32_t http_insert_head(uint8_t * buf, const char * head)
+{
+	char * head_end;
+	uint32_t len, head_len;
+
+	len = strlen((char *)buf);
+	if(!(head_end = strstr((char *)buf, "\r\n\r\n"))) return len;
+
+	head_len = strlen(head);
+
+	memmove(head_end + head_len, head_end, len - (uint32_t)(head_end - (char *)buf) + 1);
+	memcpy(head_end, head, head_len);
+
+	return len + head_len;
+}
+
+/* 1 if If-None-Match of the request has the ETag, weak ones compare equal as well */
+static uint8_t http_etag_match(st_http_request * p_http_request, uint32_t etag)
+{
+	char tag[12];
+
+	if(!strcmp((char *)p_http_request->IF_NONE_MATCH, "*")) return 1;
+
+	sprintf(tag, "\"%08lx\"", (unsigned long)etag);
+
+	return (strstr((char *)p_http_request->IF_NONE_MATCH, tag) != NULL);
+}
+
+static void http_socket_reset(int8_t seqnum)
+{
+	HTTPSock_Status[seqnum].file_len = 0;
+	HTTPSock_Status[seqnum].file_offset = 0;
+	HTTPSock_Status[seqnum].file_start = 0;
+	HTTPSock_Status[seqnum].sock_status = STATE_HTTP_IDLE;
+	HTTPSock_Status[seqnum].content = NULL;
+	HTTPSock_Status[seqnum].generated = NULL;
 }
 
 
@@ -502,6 +733,8 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 	http_status = 0;
 	http_response = pHTTP_RX;
 	file_len = 0;
+	HTTPSock_Status[get_seqnum].content = NULL;
+	HTTPSock_Status[get_seqnum].generated = NULL;
 
 	//method Analyze
 	switch (p_http_request->METHOD)
@@ -527,10 +760,18 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 			printf("> HTTPSocket[%d] : Request URI = %s\r\n", s, uri_name);
 #endif
 
+#ifdef _USE_WEBSOCKET_
+			if(p_http_request->UPGRADE_WS && (p_http_request->METHOD == METHOD_GET))
+			{
+				http_websocket_upgrade(s, p_http_request, uri_name);
+				break;
+			}
+#endif
+
 			if(p_http_request->TYPE == PTYPE_CGI)
 			{
 				content_found = http_get_cgi_handler(uri_name, pHTTP_TX, &file_len);
-				if(content_found && (file_len <= (DATA_BUF_SIZE-(strlen(RES_CGIHEAD_OK)+8))))
+				if(content_found && (file_len <= HTTP_CGI_BODY_MAX))
 				{
 					send_http_response_cgi(s, http_response, pHTTP_TX, (uint16_t)file_len);
 				}
@@ -541,12 +782,23 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 			}
 			else
 			{
-				// Find the User registered index for web content
-				if(find_userReg_webContent(uri_buf, &content_num, &file_len))
+				// Generated content first, its length is known once open has taken what it renders
+				if((HTTPSock_Status[get_seqnum].generated = find_generated_content(uri_buf)) != NULL)
+				{
+					content_found = 1;
+					file_len = HTTPSock_Status[get_seqnum].generated->open(s);
+					HTTPSock_Status[get_seqnum].storage_type = GENERATED;
+					p_http_request->TYPE = HTTPSock_Status[get_seqnum].generated->content_type;
+				}
+				// Find the User registered index for web content, its gzip variant first if the client takes it
+				else if((p_http_request->ACCEPT_GZIP && find_gzip_webContent(uri_buf, &content_num, &file_len)) ||
+				   find_userReg_webContent(uri_buf, &content_num, &file_len))
 				{
 					content_found = 1; // Web content found in code flash memory
 					content_addr = (uint32_t)content_num;
 					HTTPSock_Status[get_seqnum].storage_type = CODEFLASH;
+					HTTPSock_Status[get_seqnum].content = get_webContent(content_num);
+					p_http_request->TYPE = HTTPSock_Status[get_seqnum].content->content_type;
 				}
 				// Not CGI request, Web content in 'SD card' or 'Data flash' requested
 #ifdef _USE_SDCARD_
@@ -586,7 +838,10 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 #ifdef _HTTPSERVER_DEBUG_
 					printf("> HTTPSocket[%d] : Find Content [%s] ok - Start [%ld] len [ %ld ]byte\r\n", s, uri_name, content_addr, file_len);
 #endif
-					http_status = STATUS_OK;
+					// The client has this content already, only the header is sent
+					if(HTTPSock_Status[get_seqnum].content &&
+					   http_etag_match(p_http_request, HTTPSock_Status[get_seqnum].content->content_etag)) http_status = STATUS_NOT_MODIF;
+					else http_status = STATUS_OK;
 				}
 
 				// Send HTTP header
@@ -598,8 +853,8 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 					send_http_response_header(s, p_http_request->TYPE, file_len, http_status);
 				}
 
-				// Send HTTP body (content)
-				if(http_status == STATUS_OK)
+				// Send HTTP body (content), none for HEAD
+				if((http_status == STATUS_OK) && (p_http_request->METHOD == METHOD_GET))
 				{
 					send_http_response_body(s, uri_name, http_response, content_addr, file_len);
 				}
@@ -623,7 +878,7 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 #ifdef _HTTPSERVER_DEBUG_
 				printf("> HTTPSocket[%d] : [CGI: %s] / Response len [ %ld ]byte\r\n", s, content_found?"Content found":"Content not found", file_len);
 #endif
-				if(content_found && (file_len <= (DATA_BUF_SIZE-(strlen(RES_CGIHEAD_OK)+8))))
+				if(content_found && (file_len <= HTTP_CGI_BODY_MAX))
 				{
 					send_http_response_cgi(s, pHTTP_TX, http_response, (uint16_t)file_len);
 
@@ -659,9 +914,18 @@ uint32_t get_httpServer_timecount(void)
 }
 
 void reg_httpServer_webContent(uint8_t * content_name, uint8_t * content)
+{
+	if(content == NULL) return;
+
+	reg_httpServer_webContent_len(content_name, content, strlen((char *)content));
+}
+
+/* A content of any bytes, as a gzip variant registered as content_name + HTTP_GZIP_SUFFIX */
+void reg_httpServer_webContent_len(uint8_t * content_name, uint8_t * content, uint32_t content_len)
 {
 	uint16_t name_len;
-	uint32_t content_len;
+	uint16_t suffix_len;
+	uint8_t * name;
 
 	if(content_name == NULL || content == NULL)
 	{
@@ -673,16 +937,69 @@ void reg_httpServer_webContent(uint8_t * content_name, uint8_t * content)
 	}
 
 	name_len = strlen((char *)content_name);
-	content_len = strlen((char *)content);
+	suffix_len = strlen(HTTP_GZIP_SUFFIX);
+
+	if((name = malloc(name_len+1)) == NULL) return;
+	strcpy((char *)name, (const char *)content_name);
 
-	web_content[total_content_cnt].content_name = malloc(name_len+1);
-	strcpy((char *)web_content[total_content_cnt].content_name, (const char *)content_name);
+	web_content[total_content_cnt].content_name = name;
 	web_content[total_content_cnt].content_len = content_len;
 	web_content[total_content_cnt].content = content;
 
+	// Made once here, the content is only read again for its requests
+	web_content[total_content_cnt].content_etag = http_content_etag(content, content_len);
+	web_content[total_content_cnt].content_gzip = (name_len > suffix_len) && !strcmp((char *)content_name + name_len - suffix_len, HTTP_GZIP_SUFFIX);
+	find_http_uri_type(&web_content[total_content_cnt].content_type, content_name);
+
 	total_content_cnt++;
 }
 
+/* FNV-1a 32-bit of the content, as its strong ETag */
+static uint32_t http_content_etag(uint8_t * content, uint32_t len)
+{
+	uint32_t hash = 2166136261u;
+
+	while(len--)
+	{
+		hash ^= *content++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* Content rendered by open and read for each GET of content_name, looked up before the others */
+void reg_httpServer_generated(uint8_t * content_name, uint8_t content_type,
+                              uint32_t(*open)(uint8_t s), uint16_t(*read)(uint8_t s, uint32_t offset, uint8_t * buf, uint16_t size))
+{
+	if(content_name == NULL || open == NULL || read == NULL) return;
+	if(total_generated_cnt >= MAX_GENERATED_CALLBACK) return;
+
+	generated_content[total_generated_cnt].content_name = content_name;
+	generated_content[total_generated_cnt].content_type = content_type;
+	generated_content[total_generated_cnt].open = open;
+	generated_content[total_generated_cnt].read = read;
+	total_generated_cnt++;
+}
+
+static const httpServer_generated * find_generated_content(uint8_t * content_name)
+{
+	uint8_t i;
+
+	for(i = 0; i < total_generated_cnt; i++)
+	{
+		if(!strcmp((char *)content_name, (char *)generated_content[i].content_name)) return &generated_content[i];
+	}
+
+	return NULL;
+}
+
+/* Web content packed by tools/web_pack.py, looked up before the registered one */
+void reg_httpServer_webPack(const httpServer_webPack * pack)
+{
+	web_pack = pack;
+}
+
 uint8_t display_reg_webContent_list(void)
 {
 	uint16_t i;
@@ -701,6 +1018,7 @@ uint8_t display_reg_webContent_list(void)
 			printf(" [%d] ", i+1);
 			printf("%s, ", web_content[i].content_name);
 			printf("%ld byte, ", web_content[i].content_len);
+			printf("ETag \"%08lx\", ", (unsigned long)web_content[i].content_etag);
 
 			if(web_content[i].content_len < 30) printf("[%s]\r\n", web_content[i].content);
 			else printf("[ ... ]\r\n");
@@ -709,14 +1027,29 @@ uint8_t display_reg_webContent_list(void)
 		ret = 1;
 	}
 
+	if(web_pack)
+	{
+		printf("=== %d Web content packed in flash ===\r\n\r\n", web_pack->content_cnt);
+		ret = 1;
+	}
+
 	return ret;
 }
 
 uint8_t find_userReg_webContent(uint8_t * content_name, uint16_t * content_num, uint32_t * file_len)
 {
 	uint16_t i;
+	int32_t num;
 	uint8_t ret = 0; // '0' means 'File Not Found'
 
+	// The packed content first, found in a hash or two and one strcmp
+	if((num = find_webPack_content(content_name)) >= 0)
+	{
+		*file_len = web_pack->content[num].content_len;
+		*content_num = (uint16_t)(MAX_CONTENT_CALLBACK + num);
+		return 1;
+	}
+
 	for(i = 0; i < total_content_cnt; i++)
 	{
 		if(!strcmp((char *)content_name, (char *)web_content[i].content_name))
@@ -730,20 +1063,276 @@ uint8_t find_userReg_webContent(uint8_t * content_name, uint16_t * content_num,
 	return ret;
 }
 
+/* Find the gzip variant of a content, registered as its name + HTTP_GZIP_SUFFIX */
+static uint8_t find_gzip_webContent(uint8_t * content_name, uint16_t * content_num, uint32_t * file_len)
+{
+	uint8_t gz_name[MAX_CONTENT_NAME_LEN];
+
+	if(strlen((char *)content_name) + strlen(HTTP_GZIP_SUFFIX) >= MAX_CONTENT_NAME_LEN) return 0;
+
+	strcpy((char *)gz_name, (char *)content_name);
+	strcat((char *)gz_name, HTTP_GZIP_SUFFIX);
+
+	return find_userReg_webContent(gz_name, content_num, file_len);
+}
+
+/*
+ * Minimal perfect hash of tools/web_pack.py: the first hash picks a bucket, whose index entry is
+ * the content number itself (negative, -1 - number) or the seed of a second hash giving it.
+ * A name that isn't packed lands on some content too, the strcmp tells them apart.
+ */
+static int32_t find_webPack_content(const uint8_t * content_name)
+{
+	int16_t d;
+	uint32_t num;
+
+	if(!web_pack || !web_pack->content_cnt) return -1;
+
+	d = web_pack->index[webPack_hash(0, content_name) % web_pack->content_cnt];
+	if(d < 0) num = (uint32_t)(-1 - d);
+	else num = webPack_hash((uint32_t)d, content_name) % web_pack->content_cnt;
+
+	if(strcmp((char *)content_name, (char *)web_pack->content[num].content_name)) return -1;
+
+	return (int32_t)num;
+}
+
+/* FNV-1a 32-bit from a seeded basis and a final mix, the same in tools/web_pack.py */
+static uint32_t webPack_hash(uint32_t seed, const uint8_t * name)
+{
+	uint32_t hash = 2166136261u ^ seed;
+
+	while(*name)
+	{
+		hash ^= *name++;
+		hash *= 16777619u;
+	}
+
+	// FNV's low bits only depend on the low bits of its input, the mix spreads the seed down
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+/* Registered content by its number, the packed one from MAX_CONTENT_CALLBACK on */
+static const httpServer_webContent * get_webContent(uint16_t content_num)
+{
+	if(content_num < total_content_cnt) return &web_content[content_num];
+
+	if(web_pack && (content_num >= MAX_CONTENT_CALLBACK) && (content_num - MAX_CONTENT_CALLBACK < web_pack->content_cnt))
+		return &web_pack->content[content_num - MAX_CONTENT_CALLBACK];
+
+	return NULL;
+}
+
 
 uint16_t read_userReg_webContent(uint16_t content_num, uint8_t * buf, uint32_t offset, uint16_t size)
 {
 	uint16_t ret = 0;
-	uint8_t * ptr;
+	const httpServer_webContent * content;
 
-	if(content_num > total_content_cnt) return 0;
+	if((content = get_webContent(content_num)) == NULL) return 0;
+	if(offset >= content->content_len) return 0;
 
-	ptr = web_content[content_num].content;
-	if(offset) ptr += offset;
+	// Any bytes of the content, up to its length
+	ret = size;
+	if(ret > content->content_len - offset) ret = (uint16_t)(content->content_len - offset);
 
-	strncpy((char *)buf, (char *)ptr, size);
-	*(buf+size) = 0; // Insert '/0' for indicates the 'End of String' (null terminated)
+	memcpy(buf, content->content + offset, ret);
+	*(buf+ret) = 0; // Insert '/0' for indicates the 'End of String' (null terminated)
 
-	ret = strlen((void *)buf);
 	return ret;
 }
+
+#ifdef _USE_WEBSOCKET_
+/* Register the WebSocket handlers, see httpServer.h */
+void reg_httpServer_websocket(uint8_t(*open)(uint8_t s, uint8_t * uri),
+                              void(*recv)(uint8_t s, uint8_t opcode, const uint8_t * data, uint16_t len, uint8_t last),
+                              void(*close)(uint8_t s))
+{
+	ws_open_cb = open;
+	ws_recv_cb = recv;
+	ws_close_cb = close;
+}
+
+/*
+ * Send a message in one frame on an upgraded connection: head and payload framed together and handed to the TX buffer
+ * with one send(), a frame is queued whole or not at all.
+ * Returns SOCK_OK, SOCK_BUSY if the TX buffer has no room for it now, or a SOCKERR (SOCKERR_DATALEN above HTTP_WS_MSG_MAX)
+ */
+int32_t httpServer_websocket_send(uint8_t s, uint8_t opcode, const uint8_t * data, uint16_t len)
+{
+	int8_t seqnum;
+	st_http_socket * hs;
+	uint8_t frame[WS_HEAD_MAX + HTTP_WS_MSG_MAX];
+	uint32_t frame_len;
+	int32_t ret;
+
+	if((seqnum = getHTTPSequenceNum(s)) == -1) return SOCKERR_SOCKNUM;
+	hs = &HTTPSock_Status[seqnum];
+
+	if((hs->sock_status != STATE_HTTP_WEBSOCKET) || hs->ws_closing) return SOCKERR_SOCKSTATUS;
+	if(len > HTTP_WS_MSG_MAX) return SOCKERR_DATALEN;
+
+	frame_len = ws_frame_head(frame, opcode, len);
+	if(len) memcpy(frame + frame_len, data, len);
+	frame_len += len;
+
+	if(getSn_TX_FSR(s) < frame_len) return SOCK_BUSY;
+	if((ret = http_send_avail(s, frame, frame_len)) == 0) return SOCK_BUSY;
+
+	if(ret != (int32_t)frame_len)
+	{
+		// A head without all of its payload breaks the stream, the connection is closed by the next call
+		hs->ws_closing = 1;
+		return (ret < 0) ? ret : SOCKERR_SOCKSTATUS;
+	}
+
+	hs->res_time = get_httpServer_timecount();
+
+	return SOCK_OK;
+}
+
+/* httpServer_websocket_send() the message to every upgraded connection, returns the number it was queued on */
+uint8_t httpServer_websocket_broadcast(uint8_t opcode, const uint8_t * data, uint16_t len)
+{
+	uint8_t i;
+	uint8_t cnt = 0;
+
+	for(i = 0; i < _WIZCHIP_SOCK_NUM_; i++)
+	{
+		if(HTTPSock_Status[i].sock_status != STATE_HTTP_WEBSOCKET) continue;
+		if(httpServer_websocket_send(getHTTPSocketNum(i), opcode, data, len) == SOCK_OK) cnt++;
+	}
+
+	return cnt;
+}
+
+/* Answer a GET with Upgrade: websocket, 101 if the open handler takes it, 400 for a bad handshake, 404 if denied */
+static void http_websocket_upgrade(uint8_t s, st_http_request * p_http_request, uint8_t * uri_name)
+{
+	int8_t seqnum;
+	st_http_socket * hs;
+	char accept[WS_ACCEPT_LEN + 1];
+	uint32_t key_len;
+
+	if((seqnum = getHTTPSequenceNum(s)) == -1) return;
+	hs = &HTTPSock_Status[seqnum];
+
+	key_len = strlen((char *)p_http_request->WS_KEY);
+	while(key_len && (p_http_request->WS_KEY[key_len - 1] == ' ')) key_len--;
+
+	if(key_len == 0)
+	{
+#ifdef _HTTPSERVER_DEBUG_
+		printf("> HTTPSocket[%d] : WebSocket upgrade without a key or version 13\r\n", s);
+#endif
+		send_http_response_header(s, 0, 0, STATUS_BAD_REQ);
+		return;
+	}
+	if(!ws_open_cb || !ws_open_cb(s, uri_name))
+	{
+#ifdef _HTTPSERVER_DEBUG_
+		printf("> HTTPSocket[%d] : WebSocket upgrade of [%s] denied\r\n", s, uri_name);
+#endif
+		send_http_response_header(s, 0, 0, STATUS_NOT_FOUND);
+		return;
+	}
+
+	ws_accept_key((char *)p_http_request->WS_KEY, key_len, accept);
+	sprintf((char *)http_response, "%s%s\r\n\r\n", RES_WS_SWITCH, accept);
+	http_send_all(s, http_response, strlen((char *)http_response));
+
+	// Upgraded from here on, the close handler is called when it goes
+	ws_rx_init(&hs->ws_rx);
+	hs->ws_closing = 0;
+	hs->res_time = get_httpServer_timecount();
+	hs->sock_status = STATE_HTTP_WEBSOCKET;
+#ifdef _HTTPSERVER_DEBUG_
+	printf("> HTTPSocket[%d] : [State] STATE_HTTP_WEBSOCKET [%s]\r\n", s, uri_name);
+#endif
+}
+
+/* Frames of the client on an upgraded connection, a PING when it has been idle, the close once it is closing */
+static void http_websocket_process(uint8_t s, uint8_t seqnum)
+{
+	st_http_socket * hs = &HTTPSock_Status[seqnum];
+	uint8_t frame[4];
+	uint16_t code;
+	int32_t len;
+
+#if _WIZCHIP_ == W5100S
+	// hands the frames queued behind the SEND in progress to the chip
+	send(s, pHTTP_RX, 0);
+#endif
+
+	// As much as the shared buffer takes at a time, a frame longer than that is parsed across the calls
+	if(!hs->ws_closing && (getSn_RX_RSR(s) > 0) && ((len = recv(s, pHTTP_RX, DATA_BUF_SIZE)) > 0))
+	{
+		if((code = ws_rx_input(&hs->ws_rx, pHTTP_RX, (size_t)len, http_websocket_frame, &s)) != 0)
+		{
+#ifdef _HTTPSERVER_DEBUG_
+			printf("> HTTPSocket[%d] : WebSocket protocol error, close %d\r\n", s, code);
+#endif
+			http_send_all(s, frame, ws_close_frame(frame, code));
+			hs->ws_closing = 1;
+		}
+	}
+
+	if(hs->ws_closing)
+	{
+		// The frames sent are flushed and the connection closed by STATE_HTTP_RES_DONE
+		http_websocket_end(s, seqnum);
+		hs->keepalive = 0;
+		hs->res_time = get_httpServer_timecount();
+		hs->sock_status = STATE_HTTP_RES_DONE;
+		return;
+	}
+
+	// Nothing sent for a while, the chip finds out with the PING whether the peer is still there
+	if((get_httpServer_timecount() - hs->res_time) > HTTP_WS_PING_SEC) httpServer_websocket_send(s, WS_OP_PING, NULL, 0);
+}
+
+/* ws_rx_fn of the frames of the client: PING and CLOSE are answered here, the data goes to the recv handler */
+static void http_websocket_frame(void * arg, uint8_t opcode, const uint8_t * data, size_t len, bool last)
+{
+	uint8_t s = *(uint8_t *)arg;
+	int8_t seqnum;
+
+	if((seqnum = getHTTPSequenceNum(s)) == -1) return;
+	if(HTTPSock_Status[seqnum].ws_closing) return;
+
+	switch(opcode)
+	{
+		case WS_OP_PING :
+			httpServer_websocket_send(s, WS_OP_PONG, data, (uint16_t)len);
+			break;
+
+		case WS_OP_PONG :
+			break;
+
+		case WS_OP_CLOSE :
+			// Its status code echoed
+			httpServer_websocket_send(s, WS_OP_CLOSE, data, (uint16_t)((len < 2) ? len : 2));
+			HTTPSock_Status[seqnum].ws_closing = 1;
+			break;
+
+		default :
+			if(ws_recv_cb) ws_recv_cb(s, opcode, data, (uint16_t)len, last);
+			break;
+	}
+}
+
+/* The close handler of an upgraded connection, once */
+static void http_websocket_end(uint8_t s, uint8_t seqnum)
+{
+	if(HTTPSock_Status[seqnum].sock_status != STATE_HTTP_WEBSOCKET) return;
+
+	HTTPSock_Status[seqnum].sock_status = STATE_HTTP_IDLE;
+	if(ws_close_cb) ws_close_cb(s);
+}
+#endif
@@ -4,6 +4,7 @@
  */
 
 #include <stdint.h>
+#include "httpParser.h"
 
 #ifndef	__HTTPSERVER_H__
 #define	__HTTPSERVER_H__
@@ -33,6 +34,13 @@ extern "C" {
 /* Watchdog timer */
 //#define _USE_WATCHDOG_
 
+/* WebSocket upgrade of a GET, see reg_httpServer_websocket(). Needs the websocket library (framing) linked */
+#define _USE_WEBSOCKET_
+
+#ifdef _USE_WEBSOCKET_
+#include "websocket.h"
+#endif
+
 /*********************************************
 * HTTP Process states list
 *********************************************/
@@ -40,7 +48,8 @@ extern "C" {
 #define STATE_HTTP_REQ_INPROC  		1           /* Received HTTP request from HTTP client */
 #define STATE_HTTP_REQ_DONE    		2           /* The end of HTTP request parse */
 #define STATE_HTTP_RES_INPROC  		3           /* Sending the HTTP response to HTTP client (in progress) */
-#define STATE_HTTP_RES_DONE    		4           /* The end of HTTP response send (HTTP transaction ended) */
+#define STATE_HTTP_RES_DONE    		4           /* The end of HTTP response send, waiting for the TX buffer to be sent (HTTP transaction ended) */
+#define STATE_HTTP_WEBSOCKET		5           /* Upgraded to the WebSocket protocol, frames are exchanged until the close */
 
 /*********************************************
 * HTTP Simple Return Value
@@ -57,14 +66,41 @@ extern "C" {
 /*********************************************
 * HTTP Timeout
 *********************************************/
-#define HTTP_MAX_TIMEOUT_SEC		3			// Sec.
+#define HTTP_MAX_TIMEOUT_SEC		3			// Sec. the TX buffer is given to be sent before the disconnection
+#define HTTP_KEEPALIVE_TIMEOUT_SEC	5			// Sec. a kept connection waits for the next request
+
+/*********************************************
+* HTTP Caching of the registered web content
+*********************************************/
+// Cache-Control of the content, sent with its ETag. "no-cache" has the client ask again every time,
+// a matching If-None-Match is answered by a 304 without the body; "max-age=<sec>" saves asking too
+#ifndef HTTP_CACHE_CONTROL
+#define HTTP_CACHE_CONTROL			"no-cache"
+#endif
+
+// A content registered with this suffix is the gzip variant of the content without it
+#define HTTP_GZIP_SUFFIX			".gz"
+
+/*********************************************
+* HTTP WebSocket
+*********************************************/
+// Largest message of httpServer_websocket_send(), framed on the stack and sent with one SEND
+#ifndef HTTP_WS_MSG_MAX
+#define HTTP_WS_MSG_MAX				256
+#endif
+
+// Sec. an upgraded connection may go without sending before a PING, a peer gone away is then closed by the chip's retransmission timeout
+#ifndef HTTP_WS_PING_SEC
+#define HTTP_WS_PING_SEC			10
+#endif
 
 typedef enum
 {
    NONE,		///< Web storage none
    CODEFLASH,	///< Code flash memory
    SDCARD,    	///< SD card
-   DATAFLASH	///< External data flash memory
+   DATAFLASH,	///< External data flash memory
+   GENERATED	///< Rendered by its read callback as it is sent, see reg_httpServer_generated()
 }StorageType;
 
 typedef struct _st_http_socket
@@ -75,6 +111,16 @@ typedef struct _st_http_socket
 	uint32_t 		file_len;
 	uint32_t 		file_offset; // (start addr + sent size...)
 	uint8_t			storage_type; // Storage type; Code flash, SDcard, Data flash ...
+	uint32_t		res_time; // get_httpServer_timecount() at STATE_HTTP_RES_DONE, or since the connection waits for a request
+	uint8_t			keepalive; // The connection is kept after the response
+	uint16_t		peek_len; // Length of a request cut short, left in the RX buffer until its remainder
+	st_http_parser	parser; // Tokens of the request in the RX buffer, its bytes after peek_len are the only ones scanned next
+	const struct _httpServer_webContent * content; // Registered content of the response, its ETag is sent with the header
+	const struct _httpServer_generated * generated; // Generated content of the response
+#ifdef _USE_WEBSOCKET_
+	uint8_t			ws_closing; // CLOSE sent, or a frame could not be sent whole, disconnected by the next call
+	struct ws_rx	ws_rx; // Frames of the client, parsed across the calls
+#endif
 }st_http_socket;
 
 // Web content structure for file in code flash memory
@@ -82,21 +128,67 @@ typedef struct _st_http_socket
 
 typedef struct _httpServer_webContent
 {
-	uint8_t	*	content_name;
+	const uint8_t *	content_name;
 	uint32_t	content_len;
-	uint8_t * 	content;
+	const uint8_t *	content;
+	uint32_t	content_etag;	// Strong ETag, a hash of the content made at the registration
+	uint8_t		content_gzip;	// The content is gzip compressed, its name ends with HTTP_GZIP_SUFFIX
+	uint8_t		content_type;	// PTYPE_ of the content name, for its Content-Type
 }httpServer_webContent;
 
+// Web content packed at build time by tools/web_pack.py, index and content both const in flash.
+// Found by a minimal perfect hash of the name, see find_webPack_content(), and numbered after the
+// MAX_CONTENT_CALLBACK registered ones, with no limit of its own
+typedef struct _httpServer_webPack
+{
+	uint16_t	content_cnt;
+	const int16_t *	index;		// Per bucket of the first hash: the seed of the second, or -1 - the content number
+	const httpServer_webContent * content;
+}httpServer_webPack;
+
+
+// Content made by the application for each request, e.g. counters: open is called by the GET and returns the length of
+// the body, sent as its Content-Length; read then renders size bytes of it from offset into buf, by the H/W socket number
+// of the connection, as the TX buffer has room. The reads follow each other, a read may come again from an offset before
+// the last one when a SEND was not taken
+#define MAX_GENERATED_CALLBACK		4
+
+typedef struct _httpServer_generated
+{
+	const uint8_t *	content_name;
+	uint8_t		content_type;	// PTYPE_ of the body, for its Content-Type
+	uint32_t	(*open)(uint8_t s);
+	uint16_t	(*read)(uint8_t s, uint32_t offset, uint8_t * buf, uint16_t size);
+}httpServer_generated;
 
 void httpServer_init(uint8_t * tx_buf, uint8_t * rx_buf, uint8_t cnt, uint8_t * socklist);
 void reg_httpServer_cbfunc(void(*mcu_reset)(void), void(*wdt_reset)(void));
 void httpServer_run(uint8_t seqnum);
 
 void reg_httpServer_webContent(uint8_t * content_name, uint8_t * content);
+void reg_httpServer_webContent_len(uint8_t * content_name, uint8_t * content, uint32_t content_len);
+void reg_httpServer_webPack(const httpServer_webPack * pack);
+void reg_httpServer_generated(uint8_t * content_name, uint8_t content_type,
+                              uint32_t(*open)(uint8_t s), uint16_t(*read)(uint8_t s, uint32_t offset, uint8_t * buf, uint16_t size));
 uint8_t find_userReg_webContent(uint8_t * content_name, uint16_t * content_num, uint32_t * file_len);
 uint16_t read_userReg_webContent(uint16_t content_num, uint8_t * buf, uint32_t offset, uint16_t size);
 uint8_t display_reg_webContent_list(void);
 
+#ifdef _USE_WEBSOCKET_
+/*
+ * WebSocket handlers, by the H/W socket number of the connection:
+ * open is called for a GET asking for the upgrade, 1 accepts it, 0 answers 404;
+ * recv gets the unmasked payload of the data frames in pieces, the opcode (WS_OP_TEXT or WS_OP_BINARY) of their message
+ * and last on its last piece, PING and CLOSE are answered by the server; close is called when an upgraded connection goes.
+ * recv and close may be NULL.
+ */
+void reg_httpServer_websocket(uint8_t(*open)(uint8_t s, uint8_t * uri),
+                              void(*recv)(uint8_t s, uint8_t opcode, const uint8_t * data, uint16_t len, uint8_t last),
+                              void(*close)(uint8_t s));
+int32_t httpServer_websocket_send(uint8_t s, uint8_t opcode, const uint8_t * data, uint16_t len);
+uint8_t httpServer_websocket_broadcast(uint8_t opcode, const uint8_t * data, uint16_t len);
+#endif
+
 /*
  * @brief HTTP Server 1sec Tick Timer handler
  * @note SHOULD BE register to your system 1s Tick timer handler
@@ -0,0 +1,356 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include "pico/stdlib.h"
+
+#include "timebase.h"
+
+#include "w5x00_co.hpp"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Ready coroutines, each frame is in it once at most */
+#define CO_READY_MAX (W5X00_CO_FRAMES + 1)
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+namespace wiz
+{
+namespace
+{
+/* Frame arena, blocks on a free list */
+union frame
+{
+    frame *next;
+    alignas(std::max_align_t) uint8_t data[W5X00_CO_FRAME_SIZE];
+};
+
+frame g_frames[W5X00_CO_FRAMES];
+frame *g_frame_free;
+bool g_frame_init;
+
+/* Ready ring */
+std::coroutine_handle<> g_ready[CO_READY_MAX];
+uint32_t g_ready_head;
+uint32_t g_ready_tail;
+
+/* Waiters of each socket, and the sleepers */
+waiter *g_waiters[_WIZCHIP_SOCK_NUM_];
+sleep_awaiter *g_sleepers;
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+uint32_t now_ms(void)
+{
+    return timebase_ms();
+}
+
+void ready_push(std::coroutine_handle<> h)
+{
+    g_ready[g_ready_tail] = h;
+    g_ready_tail = (g_ready_tail + 1) % CO_READY_MAX;
+}
+
+/* Non-blocking for the awaiters, the socket may have been opened blocking */
+void nonblock(uint8_t sn)
+{
+    uint8_t mode = SOCK_IO_NONBLOCK;
+
+    ctlsocket(sn, CS_SET_IOMODE, &mode);
+}
+
+/* The waiters of sn that are done, or all of them with retry_all, to the ready ring */
+uint32_t waiters_attempt(uint8_t sn, uint8_t revents, bool retry_all)
+{
+    waiter **link = &g_waiters[sn];
+    uint32_t resumed = 0;
+
+    while (*link != nullptr)
+    {
+        waiter *w = *link;
+
+        // HUP and ERR go to everyone, the attempt returns the error
+        if ((retry_all || w->retry || (revents & (w->events | WIZ_POLLHUP | WIZ_POLLERR))) &&
+            ((w->result = w->attempt()) != SOCK_BUSY))
+        {
+            *link = w->next;
+            ready_push(w->h);
+            resumed++;
+        }
+        else
+        {
+            link = &w->next;
+        }
+    }
+
+    return resumed;
+}
+
+/* The sleepers past their deadline to the ready ring, the time left to the next one */
+int32_t sleepers_expire(int32_t timeout_ms)
+{
+    sleep_awaiter **link = &g_sleepers;
+    uint32_t now = now_ms();
+
+    while (*link != nullptr)
+    {
+        sleep_awaiter *s = *link;
+        int32_t left = (int32_t)(s->deadline - now);
+
+        if (left <= 0)
+        {
+            *link = s->next;
+            ready_push(s->h);
+
+            continue;
+        }
+
+        if ((timeout_ms < 0) || (left < timeout_ms))
+            timeout_ms = left;
+
+        link = &s->next;
+    }
+
+    return timeout_ms;
+}
+
+/* Wait for socket events up to timeout_ms, the waiters they concern are attempted */
+void sockets_wait(int32_t timeout_ms)
+{
+    uint32_t sn;
+    bool retry = false;
+
+    for (sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++)
+    {
+        for (waiter *w = g_waiters[sn]; w != nullptr; w = w->next)
+            retry |= w->retry;
+    }
+
+#if _WIZCHIP_ == W5100S
+    wiz_pollfd fds[_WIZCHIP_SOCK_NUM_];
+    uint8_t nfds = 0;
+
+    for (sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++)
+    {
+        uint8_t events = 0;
+
+        for (waiter *w = g_waiters[sn]; w != nullptr; w = w->next)
+            events |= w->events;
+
+        if (events)
+        {
+            fds[nfds].sn = sn;
+            fds[nfds].events = events;
+            nfds++;
+        }
+    }
+
+    if (retry && ((timeout_ms < 0) || (timeout_ms > W5X00_CO_RETRY_MS)))
+        timeout_ms = W5X00_CO_RETRY_MS;
+
+    if (nfds == 0)
+    {
+        if (timeout_ms > 0)
+            sleep_ms(timeout_ms);
+
+        return;
+    }
+
+    // sleeps until INTn when the port registered the wait callback
+    wiz_poll(fds, nfds, timeout_ms);
+
+    for (uint8_t i = 0; i < nfds; i++)
+        waiters_attempt(fds[i].sn, fds[i].revents, false);
+#else
+    bool waiting = false;
+
+    for (sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++)
+        waiting |= (g_waiters[sn] != nullptr);
+
+    // no socket interrupts to wait for on this chip, the registers are read again
+    if (waiting && ((timeout_ms < 0) || (timeout_ms > W5X00_CO_RETRY_MS)))
+        timeout_ms = W5X00_CO_RETRY_MS;
+
+    if (timeout_ms > 0)
+        sleep_ms(timeout_ms);
+
+    for (sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++)
+        waiters_attempt(sn, 0, true);
+#endif
+}
+} // namespace
+
+void *task::promise_type::operator new(std::size_t size) noexcept
+{
+    frame *f;
+
+    if (!g_frame_init)
+    {
+        for (uint32_t i = 0; i < W5X00_CO_FRAMES; i++)
+        {
+            g_frames[i].next = g_frame_free;
+            g_frame_free = &g_frames[i];
+        }
+
+        g_frame_init = true;
+    }
+
+    if ((size > sizeof(frame)) || (g_frame_free == nullptr))
+        return nullptr;
+
+    f = g_frame_free;
+    g_frame_free = f->next;
+
+    return f;
+}
+
+void task::promise_type::operator delete(void *ptr) noexcept
+{
+    frame *f = static_cast<frame *>(ptr);
+
+    f->next = g_frame_free;
+    g_frame_free = f;
+}
+
+void task::promise_type::unhandled_exception() const noexcept
+{
+    panic("wiz::task exception");
+}
+
+std::coroutine_handle<> task::final_awaiter::await_suspend(handle h) noexcept
+{
+    std::coroutine_handle<> continuation = h.promise().continuation;
+
+    if (continuation)
+        return continuation;
+
+    // spawned, nobody holds the task
+    if (h.promise().detached)
+        h.destroy();
+
+    return std::noop_coroutine();
+}
+
+void waiter::await_suspend(std::coroutine_handle<> awaiting) noexcept
+{
+    h = awaiting;
+    next = g_waiters[sn];
+    g_waiters[sn] = this;
+}
+
+int32_t recv_awaiter::attempt()
+{
+    nonblock(sn);
+
+    return ::recv(sn, buf, len);
+}
+
+int32_t send_awaiter::attempt()
+{
+    int32_t ret;
+    uint16_t need = (len < getSn_TxMAX(sn)) ? len : getSn_TxMAX(sn);
+
+    nonblock(sn);
+    ret = ::send(sn, buf, len);
+
+    // SENDOK ends the wait for the last SEND, the room for this one comes with ACKs that don't interrupt
+    if (ret == SOCK_BUSY)
+        retry = (getSn_TX_FSR(sn) < need);
+
+    return ret;
+}
+
+int32_t established_awaiter::attempt()
+{
+    switch (getSn_SR(sn))
+    {
+    case SOCK_ESTABLISHED:
+#if _WIZCHIP_ == W5100S
+        // held by wiz_poll() until cleared
+        sockevent_clear(sn, Sn_IR_CON);
+#else
+        setSn_IR(sn, Sn_IR_CON);
+#endif
+        return SOCK_OK;
+
+    case SOCK_LISTEN:
+    case SOCK_SYNSENT:
+    case SOCK_SYNRECV:
+        return SOCK_BUSY;
+
+    default:
+        return SOCKERR_SOCKSTATUS;
+    }
+}
+
+void sleep_awaiter::await_suspend(std::coroutine_handle<> awaiting) noexcept
+{
+    h = awaiting;
+    deadline = now_ms() + ms;
+    next = g_sleepers;
+    g_sleepers = this;
+}
+
+bool spawn(task &&t)
+{
+    if (!t)
+        return false;
+
+    t.m_handle.promise().detached = true;
+    ready_push(t.m_handle);
+    t.m_handle = nullptr;
+
+    return true;
+}
+
+uint32_t poll(int32_t timeout_ms)
+{
+    uint32_t resumed = 0;
+
+    // the ones made ready while these run wait for the next pass
+    for (uint32_t n = (g_ready_tail + CO_READY_MAX - g_ready_head) % CO_READY_MAX; n != 0; n--)
+    {
+        std::coroutine_handle<> h = g_ready[g_ready_head];
+
+        g_ready_head = (g_ready_head + 1) % CO_READY_MAX;
+        h.resume();
+        resumed++;
+    }
+
+    if (g_ready_head != g_ready_tail)
+        timeout_ms = 0;
+
+    timeout_ms = sleepers_expire(timeout_ms);
+
+    if (g_ready_head == g_ready_tail)
+    {
+        sockets_wait(timeout_ms);
+        sleepers_expire(0);
+    }
+
+    return resumed;
+}
+
+void run(void)
+{
+    while (true)
+        poll(-1);
+}
+} // namespace wiz
@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _W5X00_CO_HPP_
+#define _W5X00_CO_HPP_
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <cstddef>
+#include <cstdint>
+#include <coroutine>
+
+#include "wizchip_conf.h"
+#include "socket.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Coroutine frames of the static arena, a frame larger than W5X00_CO_FRAME_SIZE doesn't start */
+#ifndef W5X00_CO_FRAMES
+#define W5X00_CO_FRAMES 8
+#endif
+
+#ifndef W5X00_CO_FRAME_SIZE
+#define W5X00_CO_FRAME_SIZE 512
+#endif
+
+/* A send() waiting for TX buffer space with no SEND in flight is tried again this often, the ACKs
+   that free the space don't interrupt. Every waiter is tried this often without wiz_poll(), on
+   the chips other than the W5100S */
+#ifndef W5X00_CO_RETRY_MS
+#define W5X00_CO_RETRY_MS 1
+#endif
+
+/* Events of the waiters, wiz_poll() is W5100S only and the other chips never report them */
+#if _WIZCHIP_ != W5100S
+#define WIZ_POLLIN 0x01
+#define WIZ_POLLOUT 0x04
+#define WIZ_POLLERR 0x08
+#define WIZ_POLLHUP 0x10
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+namespace wiz
+{
+/*! \brief Coroutine of the executor, started with spawn() or awaited from another one
+ *
+ *  It starts suspended. Awaited, it runs until it returns and the awaiting coroutine
+ *  continues. Spawned, it runs from run() and its frame goes back to the arena when it returns.
+ *  Its frame comes from the arena of W5X00_CO_FRAMES blocks, never the heap. When none is
+ *  free the task is empty: spawn() fails and awaiting it returns at once.
+ */
+class task
+{
+public:
+    struct promise_type;
+    using handle = std::coroutine_handle<promise_type>;
+
+    struct final_awaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(handle h) noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    struct promise_type
+    {
+        std::coroutine_handle<> continuation; // coroutine awaiting it, none when spawned
+        bool detached = false;
+
+        task get_return_object() noexcept { return task(handle::from_promise(*this)); }
+        static task get_return_object_on_allocation_failure() noexcept { return task(); }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        final_awaiter final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept;
+
+        static void *operator new(std::size_t size) noexcept;
+        static void operator delete(void *frame) noexcept;
+    };
+
+    struct awaiter
+    {
+        handle h;
+
+        bool await_ready() const noexcept { return !h; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            h.promise().continuation = awaiting;
+
+            return h;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    task() noexcept = default;
+    task(task &&other) noexcept : m_handle(other.m_handle) { other.m_handle = nullptr; }
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+    ~task()
+    {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+    explicit operator bool() const noexcept { return static_cast<bool>(m_handle); }
+
+    awaiter operator co_await() const noexcept { return awaiter{m_handle}; }
+
+private:
+    explicit task(handle h) noexcept : m_handle(h) {}
+
+    friend bool spawn(task &&t);
+
+    handle m_handle;
+};
+
+/* A coroutine suspended on a socket, the result of attempt() other than SOCK_BUSY resumes it */
+struct waiter
+{
+    std::coroutine_handle<> h;
+    waiter *next;
+    int32_t result;
+    uint8_t sn;
+    uint8_t events; // WIZ_POLLIN or WIZ_POLLOUT
+    bool retry;     // attempted every W5X00_CO_RETRY_MS too, not only on the socket's events
+
+    virtual int32_t attempt() = 0;
+
+    bool await_ready()
+    {
+        result = attempt();
+
+        return result != SOCK_BUSY;
+    }
+    void await_suspend(std::coroutine_handle<> awaiting) noexcept;
+    int32_t await_resume() const noexcept { return result; }
+};
+
+/* recv() of the socket once it has data */
+struct recv_awaiter : waiter
+{
+    uint8_t *buf;
+    uint16_t len;
+
+    recv_awaiter(uint8_t sn_, uint8_t *buf_, uint16_t len_) : buf(buf_), len(len_)
+    {
+        sn = sn_;
+        events = WIZ_POLLIN;
+        retry = false;
+    }
+    int32_t attempt() override;
+};
+
+/* send() of the socket once it has the room */
+struct send_awaiter : waiter
+{
+    uint8_t *buf;
+    uint16_t len;
+
+    send_awaiter(uint8_t sn_, uint8_t *buf_, uint16_t len_) : buf(buf_), len(len_)
+    {
+        sn = sn_;
+        events = WIZ_POLLOUT;
+        retry = false;
+    }
+    int32_t attempt() override;
+};
+
+/* The socket in SOCK_ESTABLISHED */
+struct established_awaiter : waiter
+{
+    explicit established_awaiter(uint8_t sn_)
+    {
+        sn = sn_;
+        events = WIZ_POLLIN;
+        retry = false;
+    }
+    int32_t attempt() override;
+};
+
+/* A coroutine suspended until a deadline */
+struct sleep_awaiter
+{
+    std::coroutine_handle<> h;
+    sleep_awaiter *next;
+    uint32_t deadline;
+    uint32_t ms;
+
+    bool await_ready() const noexcept { return ms == 0; }
+    void await_suspend(std::coroutine_handle<> awaiting) noexcept;
+    void await_resume() const noexcept {}
+};
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+/*! \brief Start a coroutine, it runs from the next run() or poll()
+ *
+ *  \param t task of the coroutine, given up
+ *  \return false when its frame didn't fit in the arena
+ */
+bool spawn(task &&t);
+
+/*! \brief Run the coroutines, forever
+ *
+ *  The coroutines waiting on sockets cost nothing until the socket has an event: they wait
+ *  with wiz_poll(), which sleeps until INTn with w5x00_pico_port_int_enable(). Without INTn, or
+ *  on the chips other than the W5100S, the waiters are tried every W5X00_CO_RETRY_MS.
+ *  Call it from one core only, the executor isn't shared.
+ */
+[[noreturn]] void run(void);
+
+/*! \brief Resume the coroutines that can run, for a loop that does other work too
+ *
+ *  \param timeout_ms longest wait for a socket or a deadline, 0 doesn't wait, -1 waits for one
+ *  \return coroutines resumed
+ */
+uint32_t poll(int32_t timeout_ms);
+
+/*! \brief Receive, as recv() in non-blocking mode, once the socket has data or isn't connected
+ *
+ *  \return bytes received, or a SOCKERR_ code, never SOCK_BUSY
+ */
+inline recv_awaiter recv(uint8_t sn, uint8_t *buf, uint16_t len)
+{
+    return recv_awaiter(sn, buf, len);
+}
+
+/*! \brief Send, as send() in non-blocking mode, once the last SEND is done and len fits
+ *
+ *  \return bytes sent, at most the TX buffer size, or a SOCKERR_ code, never SOCK_BUSY
+ */
+inline send_awaiter send(uint8_t sn, uint8_t *buf, uint16_t len)
+{
+    return send_awaiter(sn, buf, len);
+}
+
+/*! \brief Wait for a connection on a listening or connecting socket
+ *
+ *  \return SOCK_OK in SOCK_ESTABLISHED, SOCKERR_SOCKSTATUS when the socket went back to SOCK_CLOSED
+ */
+inline established_awaiter established(uint8_t sn)
+{
+    return established_awaiter(sn);
+}
+
+/*! \brief Wait for ms milliseconds, other coroutines run meanwhile
+ */
+inline sleep_awaiter sleep(uint32_t ms)
+{
+    return sleep_awaiter{nullptr, nullptr, 0, ms};
+}
+
+} // namespace wiz
+
+#endif /* _W5X00_CO_HPP_ */
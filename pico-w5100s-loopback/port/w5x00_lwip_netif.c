@@ -0,0 +1,289 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "timebase.h"
+
+#include "lwip/etharp.h"
+#include "lwip/ethip6.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "netif/ethernet.h"
+
+#include "wizchip_conf.h"
+
+#include "w5x00_lwip_netif.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* MACRAW frames start with their length, header included */
+#define MACRAW_HEADER_LEN 2
+
+/* Buffer memory of the chip in KB, each direction */
+#if _WIZCHIP_ == W5500
+#define MACRAW_BUF_KB 16
+#else
+#define MACRAW_BUF_KB 8
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+static w5x00_lwip_netif_stats_t g_lwip_netif_stats;
+
+/* a SEND was issued and its SEND_OK not seen yet */
+static bool g_lwip_netif_tx_pending;
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static void w5x00_lwip_netif_command(uint8_t cr)
+{
+    setSn_CR(W5X00_LWIP_NETIF_SOCKET, cr);
+    while (getSn_CR(W5X00_LWIP_NETIF_SOCKET))
+        ;
+}
+
+/* Socket 0 from its registers, socket() and its state in socket.c aren't used for MACRAW */
+static err_t w5x00_lwip_netif_open(void)
+{
+    w5x00_lwip_netif_command(Sn_CR_CLOSE);
+    setSn_IR(W5X00_LWIP_NETIF_SOCKET, 0xFF);
+
+    // broadcast, multicast and the frames to SHAR, the chip drops the rest
+    setSn_MR(W5X00_LWIP_NETIF_SOCKET, Sn_MR_MACRAW | Sn_MR_MFEN);
+    w5x00_lwip_netif_command(Sn_CR_OPEN);
+
+    g_lwip_netif_tx_pending = false;
+
+    return (getSn_SR(W5X00_LWIP_NETIF_SOCKET) == SOCK_MACRAW) ? ERR_OK : ERR_IF;
+}
+
+/* The SEND_OK of the previous frame, it is left to the chip until the next one so the
+   transmission overlaps lwIP's work on the following frame */
+static void w5x00_lwip_netif_tx_wait(void)
+{
+    uint32_t start;
+
+    if (!g_lwip_netif_tx_pending)
+    {
+        return;
+    }
+
+    start = timebase_us();
+
+    while (!(getSn_IR(W5X00_LWIP_NETIF_SOCKET) & Sn_IR_SENDOK))
+    {
+        if ((timebase_us() - start) >= W5X00_LWIP_NETIF_TX_TIMEOUT_US)
+        {
+            g_lwip_netif_stats.tx_timeout++;
+
+            break;
+        }
+    }
+
+    setSn_IR(W5X00_LWIP_NETIF_SOCKET, Sn_IR_SENDOK);
+
+    g_lwip_netif_tx_pending = false;
+}
+
+static err_t w5x00_lwip_netif_output(struct netif *netif, struct pbuf *p)
+{
+    struct pbuf *q;
+
+    if (p->tot_len > W5X00_LWIP_NETIF_FRAME_MAX)
+    {
+        g_lwip_netif_stats.tx_dropped++;
+
+        return ERR_IF;
+    }
+
+    // the previous frame is out, the whole TX buffer is free again
+    w5x00_lwip_netif_tx_wait();
+
+    for (q = p; q != NULL; q = q->next)
+    {
+        wiz_send_data(W5X00_LWIP_NETIF_SOCKET, q->payload, q->len);
+    }
+
+    w5x00_lwip_netif_command(Sn_CR_SEND);
+
+    g_lwip_netif_tx_pending = true;
+    g_lwip_netif_stats.tx_frames++;
+
+    return ERR_OK;
+}
+
+static void w5x00_lwip_netif_link_poll(void *arg)
+{
+    struct netif *netif = (struct netif *)arg;
+
+    if (wizphy_getphylink() == PHY_LINK_ON)
+    {
+        if (!netif_is_link_up(netif))
+        {
+            netif_set_link_up(netif);
+        }
+    }
+    else if (netif_is_link_up(netif))
+    {
+        netif_set_link_down(netif);
+    }
+
+    sys_timeout(netif_is_link_up(netif) ? W5X00_LWIP_NETIF_LINK_POLL_MS : W5X00_LWIP_NETIF_LINK_POLL_DOWN_MS,
+                w5x00_lwip_netif_link_poll, netif);
+}
+
+static err_t w5x00_lwip_netif_low_init(struct netif *netif)
+{
+    netif->linkoutput = w5x00_lwip_netif_output;
+    netif->output = etharp_output;
+#if LWIP_IPV6
+    netif->output_ip6 = ethip6_output;
+#endif
+    netif->mtu = 1500;
+    netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_IGMP | NETIF_FLAG_MLD6;
+    netif->hwaddr_len = ETH_HWADDR_LEN;
+
+    return ERR_OK;
+}
+
+err_t w5x00_lwip_netif_init(struct netif *netif, const uint8_t *mac)
+{
+    uint8_t sipr[4] = {0, 0, 0, 0};
+
+    // all the buffer memory on the MACRAW socket, TX then RX sizes in KB
+#if _WIZCHIP_ == W5500
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{MACRAW_BUF_KB, 0, 0, 0, 0, 0, 0, 0}, {MACRAW_BUF_KB, 0, 0, 0, 0, 0, 0, 0}};
+#else
+    uint8_t memsize[2][_WIZCHIP_SOCK_NUM_] = {{MACRAW_BUF_KB, 0, 0, 0}, {MACRAW_BUF_KB, 0, 0, 0}};
+#endif
+
+    if (ctlwizchip(CW_INIT_WIZCHIP, (void *)memsize) == -1)
+    {
+        return ERR_IF;
+    }
+
+    // SHAR for the MAC filter, no address for the chip's own stack so it answers nothing
+    setSHAR((uint8_t *)mac);
+    setSIPR(sipr);
+
+    if (w5x00_lwip_netif_open() != ERR_OK)
+    {
+        return ERR_IF;
+    }
+
+    memset(&g_lwip_netif_stats, 0, sizeof(g_lwip_netif_stats));
+
+    if (netif_add(netif, IP4_ADDR_ANY4, IP4_ADDR_ANY4, IP4_ADDR_ANY4, NULL, w5x00_lwip_netif_low_init, netif_input) == NULL)
+    {
+        w5x00_lwip_netif_command(Sn_CR_CLOSE);
+
+        return ERR_IF;
+    }
+
+    netif->name[0] = 'w';
+    netif->name[1] = '0';
+    memcpy(netif->hwaddr, mac, ETH_HWADDR_LEN);
+
+    w5x00_lwip_netif_link_poll(netif);
+
+    return ERR_OK;
+}
+
+void w5x00_lwip_netif_poll(struct netif *netif)
+{
+    uint16_t received;
+    uint16_t consumed = 0;
+    uint8_t head[MACRAW_HEADER_LEN];
+    uint16_t len;
+    struct pbuf *p;
+    struct pbuf *q;
+
+    received = getSn_RX_RSR(W5X00_LWIP_NETIF_SOCKET);
+
+#if LWIP_TCP && LWIP_TCP_OUTPUT_BATCH
+    // the ACKs and segments of the frames in the buffer go out after the last of them
+    tcp_output_batch_begin();
+#endif
+
+    while ((uint16_t)(received - consumed) > MACRAW_HEADER_LEN)
+    {
+        wiz_recv_data(W5X00_LWIP_NETIF_SOCKET, head, MACRAW_HEADER_LEN);
+
+        len = (((uint16_t)head[0] << 8) | head[1]) - MACRAW_HEADER_LEN;
+
+        // out of step with the frames in the buffer, start over from an empty one
+        if ((len < SIZEOF_ETH_HDR) || (len > W5X00_LWIP_NETIF_FRAME_MAX) || (len > (uint16_t)(received - consumed - MACRAW_HEADER_LEN)))
+        {
+            g_lwip_netif_stats.rx_errors++;
+
+            w5x00_lwip_netif_open();
+
+#if LWIP_TCP && LWIP_TCP_OUTPUT_BATCH
+            tcp_output_batch_end();
+#endif
+
+            return;
+        }
+
+        consumed += MACRAW_HEADER_LEN + len;
+
+        p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+
+        if (p == NULL)
+        {
+            wiz_recv_ignore(W5X00_LWIP_NETIF_SOCKET, len);
+
+            g_lwip_netif_stats.rx_nobuf++;
+
+            continue;
+        }
+
+        for (q = p; q != NULL; q = q->next)
+        {
+            wiz_recv_data(W5X00_LWIP_NETIF_SOCKET, q->payload, q->len);
+        }
+
+        g_lwip_netif_stats.rx_frames++;
+
+        if (netif->input(p, netif) != ERR_OK)
+        {
+            pbuf_free(p);
+        }
+    }
+
+    if (consumed != 0)
+    {
+        // one RECV hands the space of all the frames back to the chip
+        w5x00_lwip_netif_command(Sn_CR_RECV);
+    }
+
+#if LWIP_TCP && LWIP_TCP_OUTPUT_BATCH
+    tcp_output_batch_end();
+#endif
+}
+
+void w5x00_lwip_netif_get_stats(w5x00_lwip_netif_stats_t *stats)
+{
+    *stats = g_lwip_netif_stats;
+}
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _W5X00_LWIP_NETIF_H_
+#define _W5X00_LWIP_NETIF_H_
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdint.h>
+
+#include "lwip/err.h"
+#include "lwip/netif.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* MACRAW is only available on socket 0 */
+#define W5X00_LWIP_NETIF_SOCKET 0
+
+/* Ethernet header and payload, the W5x00 doesn't pass the FCS */
+#define W5X00_LWIP_NETIF_FRAME_MAX 1514
+
+/* PHY link polling interval, from an lwIP timer */
+#ifndef W5X00_LWIP_NETIF_LINK_POLL_MS
+#define W5X00_LWIP_NETIF_LINK_POLL_MS 100
+#endif
+
+/* The same while the link is down, so lwIP sees it come up, and sends its gratuitous ARP, sooner */
+#ifndef W5X00_LWIP_NETIF_LINK_POLL_DOWN_MS
+#define W5X00_LWIP_NETIF_LINK_POLL_DOWN_MS 20
+#endif
+
+/* Longest wait for the SEND_OK of the previous frame, a full frame takes 1.2ms at 10Mbit/s */
+#ifndef W5X00_LWIP_NETIF_TX_TIMEOUT_US
+#define W5X00_LWIP_NETIF_TX_TIMEOUT_US 10000
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Frame counters of the netif */
+typedef struct w5x00_lwip_netif_stats_t
+{
+    uint32_t rx_frames;  // passed to lwIP
+    uint32_t rx_nobuf;   // dropped in the chip, no pbuf
+    uint32_t rx_errors;  // bad MACRAW length header, the socket was reopened
+    uint32_t tx_frames;  // SEND issued
+    uint32_t tx_timeout; // SEND_OK missing after W5X00_LWIP_NETIF_TX_TIMEOUT_US
+    uint32_t tx_dropped; // longer than W5X00_LWIP_NETIF_FRAME_MAX
+} w5x00_lwip_netif_stats_t;
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+/*! \brief Add the W5x00 as an lwIP Ethernet netif, socket 0 in MACRAW mode
+ *
+ *  Call it after lwip_init(), w5x00_pico_port_init(), w5x00_pico_port_reset() and
+ *  wizchip_port_rp2040_init(). The chip is initialized with all its TX and RX buffer memory
+ *  on socket 0, its own TCP/IP stack is left without an address and lwIP does IP, ARP and
+ *  the rest. Socket 0 receives broadcast, multicast and frames to mac only.
+ *
+ *  \param netif netif to add, its addresses are set by the caller
+ *  \param mac MAC address, written to SHAR
+ *  \return ERR_OK, or ERR_IF when the chip didn't initialize or socket 0 didn't open
+ */
+err_t w5x00_lwip_netif_init(struct netif *netif, const uint8_t *mac);
+
+/*! \brief Pass the frames received by socket 0 to lwIP
+ *
+ *  Every frame in the RX buffer is read, from the 2 byte MACRAW length header into a
+ *  PBUF_POOL chain, and given to netif->input. The buffer space is released to the chip
+ *  with one RECV command for all of them. Call it from the lwIP loop, with sys_check_timeouts().
+ *
+ *  \param netif netif of w5x00_lwip_netif_init()
+ */
+void w5x00_lwip_netif_poll(struct netif *netif);
+
+/*! \brief Get the frame counters
+ *
+ *  \param stats counters to fill
+ */
+void w5x00_lwip_netif_get_stats(w5x00_lwip_netif_stats_t *stats);
+
+#endif /* _W5X00_LWIP_NETIF_H_ */
@@ -0,0 +1,440 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+#include "wizchip_conf.h"
+#include "socket.h"
+
+#include "w5x00_pico_port.h"
+#include "w5x00_mc.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+#if (W5X00_MC_RING_SIZE & (W5X00_MC_RING_SIZE - 1)) != 0
+#error "W5X00_MC_RING_SIZE must be a power of 2"
+#endif
+
+#if W5X00_MC_SOCKETS > _WIZCHIP_SOCK_NUM_
+#error "W5X00_MC_SOCKETS is larger than the sockets of the chip"
+#endif
+
+#define W5X00_MC_RING_MASK (W5X00_MC_RING_SIZE - 1u)
+
+/* What a round of w5x00_mc_service() did */
+#define W5X00_MC_MOVED 0x01u   // data or a state changed, the application core is told
+#define W5X00_MC_WAITING 0x02u // something is left that no interrupt will report
+
+/* CON and TIMEOUT are held by wiz_poll() until cleared, as SENDOK for send() */
+#if _WIZCHIP_ == W5100S
+#define W5X00_MC_CLR_IR(sn, ir) sockevent_clear(sn, ir)
+#else
+#define W5X00_MC_CLR_IR(sn, ir) setSn_IR(sn, ir)
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* The rings of a socket. Each index has one writer, the data before an index is written
+   before the index is published */
+typedef struct
+{
+    uint8_t rx[W5X00_MC_RING_SIZE];
+    uint8_t tx[W5X00_MC_RING_SIZE];
+    volatile uint32_t rx_head;  // core 1
+    volatile uint32_t rx_tail;  // core 0
+    volatile uint32_t tx_head;  // core 0
+    volatile uint32_t tx_tail;  // core 1
+    volatile uint16_t port;     // core 0, w5x00_mc_listen()
+    volatile uint8_t close_req; // core 0, counts w5x00_mc_close()
+    volatile uint8_t close_ack; // core 1, close_req once the socket is closed
+    volatile uint8_t state;     // core 1, w5x00_mc_state_t
+    volatile uint32_t rx_start; // core 1, rx_head when close_ack was set, the next connection's first byte
+    bool rx_drop;               // core 0, the RX ring is emptied up to rx_start at close_ack
+} w5x00_mc_socket_t;
+
+static w5x00_mc_socket_t g_mc[W5X00_MC_SOCKETS];
+
+/* Core 1 only */
+static uint16_t g_mc_listen_port[W5X00_MC_SOCKETS]; // port of the open socket
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static inline void w5x00_mc_doorbell(void)
+{
+    // the rings carry the work, a full FIFO already has a doorbell in it
+    if (multicore_fifo_wready())
+        multicore_fifo_push_blocking(0);
+}
+
+static inline uint32_t w5x00_mc_min(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+/* Core 1: the chip's RX buffer to the RX ring, one RECV per contiguous part */
+static uint8_t w5x00_mc_rx_move(uint8_t sn)
+{
+    w5x00_mc_socket_t *s = &g_mc[sn];
+    uint32_t head = s->rx_head;
+    uint32_t space = W5X00_MC_RING_SIZE - (head - s->rx_tail);
+    uint32_t size = getSn_RX_RSR(sn);
+    uint8_t ret = 0;
+    int32_t n;
+
+    while ((size != 0) && (space != 0))
+    {
+        n = w5x00_mc_min(w5x00_mc_min(size, space), W5X00_MC_RING_SIZE - (head & W5X00_MC_RING_MASK));
+        n = recv(sn, &s->rx[head & W5X00_MC_RING_MASK], (uint16_t)n);
+
+        if (n <= 0)
+            break;
+
+        head += n;
+        size -= n;
+        space -= n;
+
+        __dmb();
+        s->rx_head = head;
+        ret = W5X00_MC_MOVED;
+    }
+
+    // the chip has more than the ring takes, the application core frees space without an interrupt
+    if (size != 0)
+        ret |= W5X00_MC_WAITING;
+
+    return ret;
+}
+
+/* Core 1: the TX ring to the chip's TX buffer, one SEND at a time */
+static uint8_t w5x00_mc_tx_move(uint8_t sn)
+{
+    w5x00_mc_socket_t *s = &g_mc[sn];
+    uint32_t tail = s->tx_tail;
+    uint32_t count = s->tx_head - tail;
+    int32_t n;
+
+    if (count == 0)
+        return 0;
+
+    __dmb();
+
+    n = w5x00_mc_min(w5x00_mc_min(count, W5X00_MC_RING_SIZE - (tail & W5X00_MC_RING_MASK)), getSn_TX_FSR(sn));
+
+    // SOCK_BUSY until the SENDOK of the last SEND, the ACKs that free the buffer don't interrupt
+    if ((n == 0) || ((n = send(sn, &s->tx[tail & W5X00_MC_RING_MASK], (uint16_t)n)) <= 0))
+        return W5X00_MC_WAITING;
+
+    __dmb();
+    s->tx_tail = tail + n;
+
+    return W5X00_MC_MOVED | ((count > (uint32_t)n) ? W5X00_MC_WAITING : 0);
+}
+
+/* Core 1: one round of socket sn */
+static uint8_t w5x00_mc_service(uint8_t sn)
+{
+    w5x00_mc_socket_t *s = &g_mc[sn];
+    bool closing = (s->close_req != s->close_ack);
+    uint16_t port = s->port;
+    uint8_t sr = getSn_SR(sn);
+    uint8_t ret = 0;
+
+    switch (sr)
+    {
+    case SOCK_ESTABLISHED:
+    case SOCK_CLOSE_WAIT:
+        if (s->state == W5X00_MC_LISTEN)
+        {
+            W5X00_MC_CLR_IR(sn, Sn_IR_CON);
+            s->state = W5X00_MC_ESTABLISHED;
+            ret |= W5X00_MC_MOVED;
+        }
+
+        // after w5x00_mc_close() received data is dropped with the connection
+        if (!closing)
+            ret |= w5x00_mc_rx_move(sn);
+
+        ret |= w5x00_mc_tx_move(sn);
+
+        if (closing)
+        {
+            // the FIN follows what the chip was given
+            if (s->tx_head == s->tx_tail)
+                disconnect(sn);
+
+            ret |= W5X00_MC_WAITING;
+        }
+        else if ((sr == SOCK_CLOSE_WAIT) && (s->state == W5X00_MC_ESTABLISHED) && (getSn_RX_RSR(sn) == 0))
+        {
+            s->state = W5X00_MC_CLOSE_WAIT;
+            ret |= W5X00_MC_MOVED;
+        }
+        break;
+
+    case SOCK_CLOSED:
+        if (closing)
+        {
+            // unsent data of the old connection, core 0 sends nothing more until close_ack
+            s->tx_tail = s->tx_head;
+            s->rx_start = s->rx_head;
+            __dmb();
+            s->close_ack = s->close_req;
+            ret |= W5X00_MC_MOVED;
+        }
+        else if ((s->state == W5X00_MC_ESTABLISHED) || (s->state == W5X00_MC_CLOSE_WAIT))
+        {
+            // reset or timed out, kept closed until the application has seen it
+            W5X00_MC_CLR_IR(sn, Sn_IR_TIMEOUT);
+            s->state = W5X00_MC_ABORTED;
+
+            return W5X00_MC_MOVED;
+        }
+        else if (s->state == W5X00_MC_ABORTED)
+        {
+            break;
+        }
+
+        if (port == 0)
+        {
+            if (s->state != W5X00_MC_CLOSED)
+            {
+                s->state = W5X00_MC_CLOSED;
+                ret |= W5X00_MC_MOVED;
+            }
+            break;
+        }
+
+        if ((socket(sn, Sn_MR_TCP, port, SF_IO_NONBLOCK) != sn) || (listen(sn) != SOCK_OK))
+        {
+            close(sn);
+
+            return ret | W5X00_MC_WAITING;
+        }
+
+        g_mc_listen_port[sn] = port;
+        s->state = W5X00_MC_LISTEN;
+        ret |= W5X00_MC_MOVED;
+        break;
+
+    case SOCK_INIT:
+    case SOCK_LISTEN:
+        // closed, then opened again or not by the next round
+        if (closing || (port != g_mc_listen_port[sn]))
+        {
+            close(sn);
+            ret |= W5X00_MC_WAITING;
+        }
+        break;
+
+    default:
+        // SYNRECV, FIN_WAIT, TIME_WAIT and the others, the chip moves on by itself
+        ret |= W5X00_MC_WAITING;
+        break;
+    }
+
+    return ret;
+}
+
+void w5x00_mc_run(void)
+{
+    absolute_time_t timeout;
+    uint32_t timeout_ms;
+    uint8_t ret, sn;
+#if _WIZCHIP_ == W5100S
+    wiz_pollfd fds[W5X00_MC_SOCKETS];
+
+    for (sn = 0; sn < W5X00_MC_SOCKETS; sn++)
+    {
+        fds[sn].sn = sn;
+        fds[sn].events = WIZ_POLLIN | WIZ_POLLOUT;
+    }
+
+    // the GPIO IRQ of INTn on this core
+    w5x00_pico_port_int_enable();
+#endif
+
+    while (true)
+    {
+#if _WIZCHIP_ == W5100S
+        // releases IR and INTn, the sockets are looked at below whatever it reports
+        wiz_poll(fds, W5X00_MC_SOCKETS, 0);
+#endif
+
+        // rate limited, the link callback runs on this core
+        w5x00_pico_port_link_poll();
+
+        // drained first, a doorbell rung during the round ends the next wait
+        while (multicore_fifo_rvalid())
+            (void)multicore_fifo_pop_blocking();
+
+        ret = 0;
+
+        for (sn = 0; sn < W5X00_MC_SOCKETS; sn++)
+            ret |= w5x00_mc_service(sn);
+
+        if (ret & W5X00_MC_MOVED)
+        {
+            w5x00_mc_doorbell();
+
+            continue;
+        }
+
+#if _WIZCHIP_ == W5100S
+        timeout_ms = (ret & W5X00_MC_WAITING) ? W5X00_MC_RETRY_MS : W5X00_MC_IDLE_MS;
+#else
+        timeout_ms = W5X00_MC_RETRY_MS;
+#endif
+        timeout = make_timeout_time_ms(timeout_ms);
+
+        // the GPIO IRQ of INTn and the FIFO of the other core end the wfe
+#if _WIZCHIP_ == W5100S
+        while (!sockevent_pending() && !multicore_fifo_rvalid() && !best_effort_wfe_or_timeout(timeout))
+            ;
+#else
+        while (!multicore_fifo_rvalid() && !best_effort_wfe_or_timeout(timeout))
+            ;
+#endif
+    }
+}
+
+/* Core 0: the RX ring without the data of a closed connection */
+static bool w5x00_mc_rx_ready(w5x00_mc_socket_t *s)
+{
+    if (s->close_req != s->close_ack)
+        return false;
+
+    if (s->rx_drop)
+    {
+        __dmb();
+        s->rx_tail = s->rx_start;
+        s->rx_drop = false;
+    }
+
+    return true;
+}
+
+void w5x00_mc_listen(uint8_t sn, uint16_t port)
+{
+    g_mc[sn].port = port;
+
+    w5x00_mc_doorbell();
+}
+
+w5x00_mc_state_t w5x00_mc_state(uint8_t sn)
+{
+    w5x00_mc_socket_t *s = &g_mc[sn];
+    w5x00_mc_state_t state = (w5x00_mc_state_t)s->state;
+
+    if (s->close_req != s->close_ack)
+        return W5X00_MC_CLOSING;
+
+    // the state before the ring, what the ring had before the state was set is read after it
+    __dmb();
+
+    return state;
+}
+
+uint32_t w5x00_mc_recv(uint8_t sn, uint8_t *buf, uint32_t len)
+{
+    w5x00_mc_socket_t *s = &g_mc[sn];
+    uint32_t tail, count, off, n, first;
+
+    if (!w5x00_mc_rx_ready(s))
+        return 0;
+
+    tail = s->rx_tail;
+    count = s->rx_head - tail;
+    off = tail & W5X00_MC_RING_MASK;
+    n = w5x00_mc_min(count, len);
+
+    if (n == 0)
+        return 0;
+
+    __dmb();
+
+    first = w5x00_mc_min(n, W5X00_MC_RING_SIZE - off);
+    memcpy(buf, &s->rx[off], first);
+    memcpy(buf + first, &s->rx[0], n - first);
+
+    __dmb();
+    s->rx_tail = tail + n;
+
+    // core 1 leaves data in the chip while the ring is full
+    if (count == W5X00_MC_RING_SIZE)
+        w5x00_mc_doorbell();
+
+    return n;
+}
+
+uint32_t w5x00_mc_send(uint8_t sn, const uint8_t *buf, uint32_t len)
+{
+    w5x00_mc_socket_t *s = &g_mc[sn];
+    uint32_t head = s->tx_head;
+    uint32_t off = head & W5X00_MC_RING_MASK;
+    uint32_t n, first;
+    w5x00_mc_state_t state = w5x00_mc_state(sn);
+
+    if ((state != W5X00_MC_ESTABLISHED) && (state != W5X00_MC_CLOSE_WAIT))
+        return 0;
+
+    n = w5x00_mc_min(W5X00_MC_RING_SIZE - (head - s->tx_tail), len);
+
+    if (n == 0)
+        return 0;
+
+    first = w5x00_mc_min(n, W5X00_MC_RING_SIZE - off);
+    memcpy(&s->tx[off], buf, first);
+    memcpy(&s->tx[0], buf + first, n - first);
+
+    __dmb();
+    s->tx_head = head + n;
+
+    w5x00_mc_doorbell();
+
+    return n;
+}
+
+uint32_t w5x00_mc_recv_available(uint8_t sn)
+{
+    if (!w5x00_mc_rx_ready(&g_mc[sn]))
+        return 0;
+
+    return g_mc[sn].rx_head - g_mc[sn].rx_tail;
+}
+
+uint32_t w5x00_mc_send_space(uint8_t sn)
+{
+    return W5X00_MC_RING_SIZE - (g_mc[sn].tx_head - g_mc[sn].tx_tail);
+}
+
+void w5x00_mc_close(uint8_t sn)
+{
+    w5x00_mc_socket_t *s = &g_mc[sn];
+
+    // what core 1 still adds before it sees the request is dropped too, at close_ack
+    s->rx_drop = true;
+    s->close_req++;
+
+    w5x00_mc_doorbell();
+}
@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _W5X00_MC_H_
+#define _W5X00_MC_H_
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wizchip_conf.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Bytes of each ring between the cores, one each way per socket, a power of 2 */
+#ifndef W5X00_MC_RING_SIZE
+#define W5X00_MC_RING_SIZE 2048u
+#endif
+
+/* Sockets served by w5x00_mc_run(), from socket 0 */
+#ifndef W5X00_MC_SOCKETS
+#define W5X00_MC_SOCKETS _WIZCHIP_SOCK_NUM_
+#endif
+
+/* A socket with data waiting for TX buffer space or for a full RX ring is tried again this
+   often, the ACKs that free the space don't interrupt. Every socket is tried this often on the
+   chips other than the W5100S, which have no wiz_poll() */
+#ifndef W5X00_MC_RETRY_MS
+#define W5X00_MC_RETRY_MS 1u
+#endif
+
+/* Longest sleep of the W5100S between INTn edges and doorbells, a board without INTn wired is
+   served this often */
+#ifndef W5X00_MC_IDLE_MS
+#define W5X00_MC_IDLE_MS 100u
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* State of a socket, as the application core sees it */
+typedef enum
+{
+    W5X00_MC_CLOSED = 0,  // not listening
+    W5X00_MC_LISTEN,      // waiting for a connection on the port of w5x00_mc_listen()
+    W5X00_MC_ESTABLISHED, // connected
+    W5X00_MC_CLOSE_WAIT,  // the peer closed, what it sent is all in the RX ring
+    W5X00_MC_ABORTED,     // reset or timed out, what was received is in the RX ring
+    W5X00_MC_CLOSING,     // after w5x00_mc_close(), the TX ring is being sent and the connection closed
+} w5x00_mc_state_t;
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+/*! \brief Serve the sockets on the calling core, core 1, never returns
+ *
+ *  Call it after w5x00_pico_port_init(), the chip set up and ctlnetwork() on the same core, so
+ *  that the DMA and INTn interrupts of the port are taken there and socket.c is only ever run
+ *  there. On the W5100S INTn is enabled with w5x00_pico_port_int_enable() and the core sleeps in
+ *  wfe between INTn edges and the doorbells of the application core, on the other chips it polls
+ *  every W5X00_MC_RETRY_MS. Each round moves received data from the chip to the RX ring of its
+ *  socket and the TX ring to the chip, opens and closes the sockets, then rings the doorbell of
+ *  the application core when anything changed. w5x00_pico_port_link_poll() is called every
+ *  round, its callback runs on this core. The SIO FIFOs carry the doorbells and are not
+ *  usable for anything else meanwhile.
+ */
+void w5x00_mc_run(void);
+
+/*! \brief Listen for TCP connections on socket sn, again after each one is closed
+ *
+ *  From the application core, as the other functions below. None of them touches the chip,
+ *  they copy to and from the rings and return at once.
+ *
+ *  \param sn socket, below W5X00_MC_SOCKETS
+ *  \param port local port, 0 stops listening once the socket is closed
+ */
+void w5x00_mc_listen(uint8_t sn, uint16_t port);
+
+/*! \brief Get the state of socket sn
+ *
+ *  Once W5X00_MC_CLOSE_WAIT or W5X00_MC_ABORTED is read, an empty RX ring means everything the peer
+ *  sent was received.
+ *
+ *  \param sn socket
+ *  \return state
+ */
+w5x00_mc_state_t w5x00_mc_state(uint8_t sn);
+
+/*! \brief Copy received data out of the RX ring of socket sn
+ *
+ *  \param sn socket
+ *  \param buf buffer
+ *  \param len size of buf
+ *  \return bytes copied, 0 when the ring is empty
+ */
+uint32_t w5x00_mc_recv(uint8_t sn, uint8_t *buf, uint32_t len);
+
+/*! \brief Copy data to send into the TX ring of socket sn
+ *
+ *  \param sn socket
+ *  \param buf data
+ *  \param len length of data
+ *  \return bytes copied, fewer than len when the ring is short of space, 0 unless
+ *          W5X00_MC_ESTABLISHED or W5X00_MC_CLOSE_WAIT
+ */
+uint32_t w5x00_mc_send(uint8_t sn, const uint8_t *buf, uint32_t len);
+
+/*! \brief Get the bytes in the RX ring of socket sn
+ *
+ *  \param sn socket
+ *  \return bytes w5x00_mc_recv() would copy
+ */
+uint32_t w5x00_mc_recv_available(uint8_t sn);
+
+/*! \brief Get the free space of the TX ring of socket sn
+ *
+ *  \param sn socket
+ *  \return bytes w5x00_mc_send() would take
+ */
+uint32_t w5x00_mc_send_space(uint8_t sn);
+
+/*! \brief Close the connection of socket sn
+ *
+ *  Anything left in the RX ring is dropped. What is in the TX ring is sent, then the connection is
+ *  closed and the socket listens again when it has a port. A connection that ended on its own,
+ *  W5X00_MC_CLOSE_WAIT or W5X00_MC_ABORTED, stays so until this is called, so no data of the next
+ *  one mixes with it.
+ *
+ *  \param sn socket
+ */
+void w5x00_mc_close(uint8_t sn);
+
+/*! \brief Sleep in wfe until a doorbell of w5x00_mc_run() or the timeout
+ *
+ *  \param timeout_us longest sleep
+ *  \return true if a doorbell was rung
+ */
+bool w5x00_mc_wait(uint32_t timeout_us);
+
+#endif /* _W5X00_MC_H_ */
@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include "wizchip_conf.h"
+
+#include "w5x00_pico_port.h"
+#include "w5x00_metrics.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* The sockets of the chip, X(label) */
+#if _WIZCHIP_SOCK_NUM_ > 4
+#define W5X00_METRICS_SOCKETS(X) X("0") X("1") X("2") X("3") X("4") X("5") X("6") X("7")
+#else
+#define W5X00_METRICS_SOCKETS(X) X("0") X("1") X("2") X("3")
+#endif
+
+#define W5X00_METRICS_STATE(sn) METRICS_SAMPLE("w5x00_socket_state{sn=\"" sn "\"}"),
+#define W5X00_METRICS_RX(sn) METRICS_SAMPLE("w5x00_socket_rx_bytes{sn=\"" sn "\"}"),
+#define W5X00_METRICS_TX(sn) METRICS_SAMPLE("w5x00_socket_tx_free_bytes{sn=\"" sn "\"}"),
+
+/* Samples of g_chip_lines */
+#define W5X00_METRICS_OWN_VALUES (3 * _WIZCHIP_SOCK_NUM_ + 3)
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+static const metrics_line_t g_chip_lines[] = {
+    METRICS_FAMILY("w5x00_socket_state", "gauge", "Sn_SR of a socket, 0x17 established"),
+    W5X00_METRICS_SOCKETS(W5X00_METRICS_STATE)
+    METRICS_FAMILY("w5x00_socket_rx_bytes", "gauge", "Bytes in the RX buffer of a socket, Sn_RX_RSR"),
+    W5X00_METRICS_SOCKETS(W5X00_METRICS_RX)
+    METRICS_FAMILY("w5x00_socket_tx_free_bytes", "gauge", "Free bytes of the TX buffer of a socket, Sn_TX_FSR"),
+    W5X00_METRICS_SOCKETS(W5X00_METRICS_TX)
+    METRICS_FAMILY("w5x00_int_edges_total", "counter", "Falling edges of INTn"),
+    METRICS_SAMPLE("w5x00_int_edges_total"),
+    METRICS_FAMILY("w5x00_int_held_total", "counter", "Edges of INTn passed at the end of their coalescing window"),
+    METRICS_SAMPLE("w5x00_int_held_total"),
+    METRICS_FAMILY("w5x00_int_window_microseconds", "gauge", "Coalescing window of INTn"),
+    METRICS_SAMPLE("w5x00_int_window_microseconds"),
+};
+
+static void w5x00_metrics_collect(uint64_t *values);
+
+static const metrics_section_t g_chip_section = {
+    g_chip_lines,
+    sizeof(g_chip_lines) / sizeof(g_chip_lines[0]),
+    w5x00_metrics_collect
+};
+
+static const metrics_section_t *g_sections[W5X00_METRICS_SECTIONS] = { &g_chip_section };
+static uint8_t g_nsections = 1;
+
+/* A scrape per socket, the connection of the socket reads it */
+static struct
+{
+    metrics_scrape_t scrape;
+    uint64_t values[W5X00_METRICS_OWN_VALUES + W5X00_METRICS_VALUES];
+} g_scrapes[_WIZCHIP_SOCK_NUM_];
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* In the order of g_chip_lines */
+static void w5x00_metrics_collect(uint64_t *values)
+{
+    w5x00_pico_port_int_stats_t stats;
+    uint8_t sn;
+
+    for (sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++)
+    {
+        values[sn] = getSn_SR(sn);
+        values[_WIZCHIP_SOCK_NUM_ + sn] = getSn_RX_RSR(sn);
+        values[2 * _WIZCHIP_SOCK_NUM_ + sn] = getSn_TX_FSR(sn);
+    }
+
+    w5x00_pico_port_int_get_stats(&stats);
+
+    values[3 * _WIZCHIP_SOCK_NUM_] = stats.edges;
+    values[3 * _WIZCHIP_SOCK_NUM_ + 1] = stats.held;
+    values[3 * _WIZCHIP_SOCK_NUM_ + 2] = stats.window_us;
+}
+
+int w5x00_metrics_add(const metrics_section_t *section)
+{
+    uint32_t values = metrics_section_values(section);
+    uint8_t i;
+
+    for (i = 1; i < g_nsections; i++)
+    {
+        values += metrics_section_values(g_sections[i]);
+    }
+
+    if (g_nsections == W5X00_METRICS_SECTIONS || values > W5X00_METRICS_VALUES)
+    {
+        return -1;
+    }
+
+    g_sections[g_nsections++] = section;
+
+    return 0;
+}
+
+uint32_t w5x00_metrics_open(uint8_t sn)
+{
+    if (sn >= _WIZCHIP_SOCK_NUM_)
+    {
+        return 0;
+    }
+
+    return metrics_scrape_begin(&g_scrapes[sn].scrape, g_sections, g_nsections, g_scrapes[sn].values);
+}
+
+uint16_t w5x00_metrics_read(uint8_t sn, uint32_t offset, uint8_t *buf, uint16_t size)
+{
+    if (sn >= _WIZCHIP_SOCK_NUM_)
+    {
+        return 0;
+    }
+
+    return (uint16_t)metrics_scrape_read(&g_scrapes[sn].scrape, offset, (char *)buf, size);
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _W5X00_METRICS_H_
+#define _W5X00_METRICS_H_
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdint.h>
+
+#include "metrics.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Name the httpServer serves the counters as, its URIs go without the leading '/' */
+#ifndef W5X00_METRICS_URI
+#define W5X00_METRICS_URI "metrics"
+#endif
+
+/* Sections, the chip's own included */
+#ifndef W5X00_METRICS_SECTIONS
+#define W5X00_METRICS_SECTIONS 4
+#endif
+
+/* Samples of the sections added, the values a scrape keeps on top of the chip's */
+#ifndef W5X00_METRICS_VALUES
+#define W5X00_METRICS_VALUES 32
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+/*! \brief Add a section to the scrapes
+ *
+ *  The counters of the chip come first: the state, the bytes received and the free TX
+ *  buffer of each socket and the INTn edges of the port. The sections added follow. The
+ *  section is kept, not copied.
+ *
+ *  \param section lines and collect function, see metrics.h
+ *  \return 0, -1 without room for it or its values
+ */
+int w5x00_metrics_add(const metrics_section_t *section);
+
+/*! \brief Start a scrape for the connection of socket sn
+ *
+ *  Takes the values of all the sections, reading the socket registers over SPI, from the
+ *  context that runs the other ioLibrary calls. One scrape per socket, a new one replaces
+ *  the last. The open callback of reg_httpServer_generated():
+ *
+ *      reg_httpServer_generated((uint8_t *)W5X00_METRICS_URI, PTYPE_TEXT, w5x00_metrics_open, w5x00_metrics_read);
+ *
+ *  \param sn socket of the connection
+ *  \return bytes of the Prometheus text
+ */
+uint32_t w5x00_metrics_open(uint8_t sn);
+
+/*! \brief Render the scrape of socket sn
+ *
+ *  The read callback of reg_httpServer_generated(): the text from offset, rendered into
+ *  buf, which the server sends as it is.
+ *
+ *  \param sn socket of the connection
+ *  \param offset in the text
+ *  \param buf where it goes
+ *  \param size bytes wanted
+ *  \return bytes rendered, 0 at the end
+ */
+uint16_t w5x00_metrics_read(uint8_t sn, uint32_t offset, uint8_t *buf, uint16_t size);
+
+#endif /* _W5X00_METRICS_H_ */
@@ -0,0 +1,1486 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#include "hardware/pio.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "timebase.h"
+
+#include "wizchip_conf.h"
+#include "socket.h"
+
+#include "w5x00_pico_port.h"
+
+#include "w5x00_spi.pio.h"
+#include "w5x00_bus.pio.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+#if _WIZCHIP_IO_MODE_ == _WIZCHIP_IO_MODE_BUS_INDIR_
+#define W5X00_PICO_PORT_BUS
+#endif
+
+/* Version register, it reads the chip's version once the chip is out of reset */
+#if _WIZCHIP_ == W5500
+#define PORT_VERSION 0x04
+#define PORT_GET_VERSION() getVERSIONR()
+#else
+#define PORT_VERSION 0x51
+#define PORT_GET_VERSION() getVER()
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+static w5x00_pico_port_config_t g_port_config;
+
+#ifndef W5X00_PICO_PORT_BUS
+/* SPI, the PL022 data register or the PIO state machine FIFOs */
+static uint g_spi_sm;
+static void *g_spi_tx_fifo;
+static void *g_spi_rx_fifo;
+static uint g_spi_dreq_tx;
+static uint g_spi_dreq_rx;
+
+/* DMA */
+static uint dma_tx;
+static uint dma_rx;
+static uint dma_tx_hdr;
+static uint dma_rx_hdr;
+static dma_channel_config dma_channel_config_tx;
+static dma_channel_config dma_channel_config_rx;
+static dma_channel_config dma_channel_config_tx_hdr;
+static dma_channel_config dma_channel_config_rx_hdr;
+
+/* Chip select of each chip, from w5x00_pico_port_add_chip() */
+#if _WIZCHIP_INSTANCES_ > 1
+static uint g_port_pin_cs[_WIZCHIP_INSTANCES_];
+#define WIZCHIP_PIN_CS (g_port_pin_cs[WIZCHIP_INST])
+#else
+#define WIZCHIP_PIN_CS (g_port_config.pin_cs)
+#endif
+
+// dummy source/sink of the idle DMA channel, static as asynchronous bursts outlive the call
+static uint8_t dummy_data;
+static uint16_t dummy_data16;
+
+// an asynchronous burst in 16-bit frames, the DMA interrupt goes back to 8 bits
+static volatile bool g_burst_frame16;
+
+// shortest blocking burst moved by DMA, shorter ones go through wizchip_fifo_xfer()
+static uint16_t g_dma_min = W5X00_PICO_PORT_DMA_MIN;
+#else
+/* PIO bus */
+static uint g_bus_sm;
+static uint g_bus_dma_tx;
+static uint g_bus_dma_rx;
+#endif
+
+/* PHY link of w5x00_pico_port_link_poll() */
+static w5x00_pico_port_link_callback_t g_link_callback;
+static uint32_t g_link_poll_ms;
+static bool g_link_polled;
+static bool g_link_up;
+
+#if _WIZCHIP_ == W5100S
+/* INTn coalescing */
+static w5x00_pico_port_coalesce_t g_int_coalesce;
+static w5x00_pico_port_int_stats_t g_int_stats;
+static uint32_t g_int_window_us;
+static uint32_t g_int_window_start;
+static uint16_t g_int_window_count;
+static bool g_int_window_held;
+static volatile alarm_id_t g_int_alarm;
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+#ifndef W5X00_PICO_PORT_BUS
+/* SPI */
+static inline void wizchip_select(void)
+{
+    gpio_put(WIZCHIP_PIN_CS, 0);
+}
+
+static inline void wizchip_deselect(void)
+{
+    gpio_put(WIZCHIP_PIN_CS, 1);
+}
+
+static uint8_t wizchip_read(void)
+{
+    uint8_t rx_data = 0;
+    uint8_t tx_data = 0xFF;
+
+    spi_read_blocking(g_port_config.spi, tx_data, &rx_data, 1);
+
+    return rx_data;
+}
+
+static void wizchip_write(uint8_t tx_data)
+{
+    spi_write_blocking(g_port_config.spi, &tx_data, 1);
+}
+
+static uint8_t wizchip_xfer_reg(uint8_t *frame)
+{
+    spi_hw_t *hw = spi_get_hw(g_port_config.spi);
+    uint8_t i;
+
+    // the 4 bytes fit the 8 deep FIFOs, they go out back to back
+    for (i = 0; i < 4; i++)
+        hw->dr = (uint32_t)frame[i];
+
+    for (i = 0; i < 3; i++)
+    {
+        while (!spi_is_readable(g_port_config.spi))
+            tight_loop_contents();
+
+        (void)hw->dr;
+    }
+
+    while (!spi_is_readable(g_port_config.spi))
+        tight_loop_contents();
+
+    return (uint8_t)hw->dr;
+}
+
+static uint32_t wizchip_spi_initialize(void)
+{
+    uint32_t baudrate = spi_init(g_port_config.spi, g_port_config.baudrate);
+
+    gpio_set_function(g_port_config.pin_sck, GPIO_FUNC_SPI);
+    gpio_set_function(g_port_config.pin_mosi, GPIO_FUNC_SPI);
+    gpio_set_function(g_port_config.pin_miso, GPIO_FUNC_SPI);
+
+    g_spi_tx_fifo = (void *)&spi_get_hw(g_port_config.spi)->dr;
+    g_spi_rx_fifo = (void *)&spi_get_hw(g_port_config.spi)->dr;
+    g_spi_dreq_tx = spi_get_dreq(g_port_config.spi, true);
+    g_spi_dreq_rx = spi_get_dreq(g_port_config.spi, false);
+
+    return baudrate;
+}
+
+/* PIO SPI */
+static uint8_t wizchip_pio_read(void)
+{
+    // a byte goes out for every byte clocked in
+    *(io_rw_8 *)g_spi_tx_fifo = 0xFF;
+
+    while (pio_sm_is_rx_fifo_empty(g_port_config.pio, g_spi_sm))
+        tight_loop_contents();
+
+    return *(io_rw_8 *)g_spi_rx_fifo;
+}
+
+static void wizchip_pio_write(uint8_t tx_data)
+{
+    *(io_rw_8 *)g_spi_tx_fifo = tx_data;
+
+    // the RX FIFO is drained too, and the byte is out before CS goes high
+    while (pio_sm_is_rx_fifo_empty(g_port_config.pio, g_spi_sm))
+        tight_loop_contents();
+
+    (void)*(io_rw_8 *)g_spi_rx_fifo;
+}
+
+static uint8_t wizchip_pio_xfer_reg(uint8_t *frame)
+{
+    uint8_t i;
+
+    // the 4 bytes fit the 4 deep FIFOs of the state machine
+    for (i = 0; i < 4; i++)
+        *(io_rw_8 *)g_spi_tx_fifo = frame[i];
+
+    for (i = 0; i < 3; i++)
+    {
+        while (pio_sm_is_rx_fifo_empty(g_port_config.pio, g_spi_sm))
+            tight_loop_contents();
+
+        (void)*(io_rw_8 *)g_spi_rx_fifo;
+    }
+
+    while (pio_sm_is_rx_fifo_empty(g_port_config.pio, g_spi_sm))
+        tight_loop_contents();
+
+    return *(io_rw_8 *)g_spi_rx_fifo;
+}
+
+static uint32_t wizchip_spi_pio_initialize(void)
+{
+    PIO pio = g_port_config.pio;
+    uint offset = pio_add_program(pio, &w5x00_spi_program);
+    uint32_t clk = clock_get_hz(clk_sys);
+    // 4 cycles per bit, a whole divider keeps SCK at 50% duty
+    uint32_t div = (clk + 4 * g_port_config.baudrate - 1) / (4 * g_port_config.baudrate);
+
+    g_spi_sm = pio_claim_unused_sm(pio, true);
+    w5x00_spi_program_init(pio, g_spi_sm, offset, (float)div,
+                           g_port_config.pin_sck, g_port_config.pin_mosi, g_port_config.pin_miso);
+
+    g_spi_tx_fifo = (void *)&pio->txf[g_spi_sm];
+    g_spi_rx_fifo = (void *)&pio->rxf[g_spi_sm];
+    g_spi_dreq_tx = pio_get_dreq(pio, g_spi_sm, true);
+    g_spi_dreq_rx = pio_get_dreq(pio, g_spi_sm, false);
+
+    return clk / (4 * div);
+}
+
+/* FIFO loop of the bursts below g_dma_min, PL022 or PIO SPI. A 3 byte header or a short recv is
+   over before two DMA channels would be configured. Up to the FIFO depth is in flight, so the
+   RX FIFO can't overflow, and the last byte is in before CS goes high */
+static inline bool wizchip_fifo_readable(void)
+{
+    if (g_port_config.use_pio)
+        return !pio_sm_is_rx_fifo_empty(g_port_config.pio, g_spi_sm);
+
+    return spi_is_readable(g_port_config.spi);
+}
+
+static void wizchip_fifo_xfer(const uint8_t *tx, uint8_t *rx, uint16_t len)
+{
+    uint16_t depth = g_port_config.use_pio ? 4 : 8;
+    uint16_t sent = 0, received = 0;
+    uint8_t data;
+
+    while (received < len)
+    {
+        if (sent < len && (uint16_t)(sent - received) < depth)
+        {
+            *(io_rw_8 *)g_spi_tx_fifo = tx ? tx[sent] : 0xFF;
+            sent++;
+        }
+
+        if (wizchip_fifo_readable())
+        {
+            data = *(io_rw_8 *)g_spi_rx_fifo;
+            if (rx)
+                rx[received] = data;
+            received++;
+        }
+    }
+}
+
+/* DMA */
+static void wizchip_read_burst_start(uint8_t *pBuf, uint16_t len)
+{
+    dummy_data = 0xFF;
+
+    channel_config_set_read_increment(&dma_channel_config_tx, false);
+    channel_config_set_write_increment(&dma_channel_config_tx, false);
+    dma_channel_configure(dma_tx, &dma_channel_config_tx,
+                          g_spi_tx_fifo,             // write address
+                          &dummy_data,               // read address
+                          len,                       // element count (each element is of size transfer_data_size)
+                          false);                    // don't start yet
+
+    channel_config_set_read_increment(&dma_channel_config_rx, false);
+    channel_config_set_write_increment(&dma_channel_config_rx, true);
+    dma_channel_configure(dma_rx, &dma_channel_config_rx,
+                          pBuf,                      // write address
+                          g_spi_rx_fifo,             // read address
+                          len,                       // element count (each element is of size transfer_data_size)
+                          false);                    // don't start yet
+
+    dma_start_channel_mask((1u << dma_tx) | (1u << dma_rx));
+}
+
+static void wizchip_write_burst_start(uint8_t *pBuf, uint16_t len)
+{
+    channel_config_set_read_increment(&dma_channel_config_tx, true);
+    channel_config_set_write_increment(&dma_channel_config_tx, false);
+    dma_channel_configure(dma_tx, &dma_channel_config_tx,
+                          g_spi_tx_fifo,             // write address
+                          pBuf,                      // read address
+                          len,                       // element count (each element is of size transfer_data_size)
+                          false);                    // don't start yet
+
+    channel_config_set_read_increment(&dma_channel_config_rx, false);
+    channel_config_set_write_increment(&dma_channel_config_rx, false);
+    dma_channel_configure(dma_rx, &dma_channel_config_rx,
+                          &dummy_data,               // write address
+                          g_spi_rx_fifo,             // read address
+                          len,                       // element count (each element is of size transfer_data_size)
+                          false);                    // don't start yet
+
+    dma_start_channel_mask((1u << dma_tx) | (1u << dma_rx));
+}
+
+/* 16-bit frames of the PL022 for the payload, the header before it stays in 8-bit frames.
+   A frame goes out MSB first, the DMA swaps the bytes of each halfword so that the buffer's
+   byte order is kept. Half the FIFO entries and DMA transfers, for halfword aligned buffers */
+static inline bool wizchip_burst_frame16(const uint8_t *pBuf, uint16_t len)
+{
+    return g_port_config.use_frame16 && !((uintptr_t)pBuf & 1u) && (len >= W5X00_PICO_PORT_FRAME16_MIN);
+}
+
+static void wizchip_spi_frame_bits(uint bits)
+{
+    // DSS is only changed with the shifter idle, after the header or the last halfword
+    while (spi_is_busy(g_port_config.spi))
+        tight_loop_contents();
+
+    spi_set_format(g_port_config.spi, bits, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+}
+
+/* The channel configs of the 8-bit bursts are left as they are, copies are set to halfwords */
+static void wizchip_burst16_start(uint8_t *pBuf, uint16_t count, bool read)
+{
+    dma_channel_config config_tx = dma_channel_config_tx;
+    dma_channel_config config_rx = dma_channel_config_rx;
+
+    dummy_data16 = 0xFFFF;
+
+    channel_config_set_transfer_data_size(&config_tx, DMA_SIZE_16);
+    channel_config_set_bswap(&config_tx, true);
+    channel_config_set_read_increment(&config_tx, !read);
+    channel_config_set_write_increment(&config_tx, false);
+    dma_channel_configure(dma_tx, &config_tx,
+                          g_spi_tx_fifo,
+                          read ? (void *)&dummy_data16 : (void *)pBuf,
+                          count, false);
+
+    channel_config_set_transfer_data_size(&config_rx, DMA_SIZE_16);
+    channel_config_set_bswap(&config_rx, true);
+    channel_config_set_read_increment(&config_rx, false);
+    channel_config_set_write_increment(&config_rx, read);
+    dma_channel_configure(dma_rx, &config_rx,
+                          read ? (void *)pBuf : (void *)&dummy_data16,
+                          g_spi_rx_fifo,
+                          count, false);
+
+    dma_start_channel_mask((1u << dma_tx) | (1u << dma_rx));
+}
+
+static void wizchip_read_burst(uint8_t *pBuf, uint16_t len)
+{
+    if (len < g_dma_min)
+    {
+        wizchip_fifo_xfer(NULL, pBuf, len);
+        return;
+    }
+
+    if (wizchip_burst_frame16(pBuf, len))
+    {
+        wizchip_spi_frame_bits(16);
+        wizchip_burst16_start(pBuf, len / 2, true);
+        dma_channel_wait_for_finish_blocking(dma_rx);
+        wizchip_spi_frame_bits(8);
+
+        // the odd byte in an 8-bit frame
+        if (len & 1u)
+            pBuf[len - 1] = wizchip_read();
+
+        return;
+    }
+
+    wizchip_read_burst_start(pBuf, len);
+    dma_channel_wait_for_finish_blocking(dma_rx);
+}
+
+static void wizchip_write_burst(uint8_t *pBuf, uint16_t len)
+{
+    if (len < g_dma_min)
+    {
+        wizchip_fifo_xfer(pBuf, NULL, len);
+        return;
+    }
+
+    if (wizchip_burst_frame16(pBuf, len))
+    {
+        wizchip_spi_frame_bits(16);
+        wizchip_burst16_start(pBuf, len / 2, false);
+        dma_channel_wait_for_finish_blocking(dma_rx);
+        wizchip_spi_frame_bits(8);
+
+        if (len & 1u)
+            wizchip_write(pBuf[len - 1]);
+
+        return;
+    }
+
+    wizchip_write_burst_start(pBuf, len);
+    dma_channel_wait_for_finish_blocking(dma_rx);
+}
+
+/* Header and data channels of a vectored read, rd->len is not 0 */
+static void wizchip_read_burst_vec_start(wiz_iovec *wr, wiz_iovec *rd)
+{
+    dummy_data = 0xFF;
+
+    // header from dma_tx_hdr, then dummy bytes clocking the data in
+    channel_config_set_read_increment(&dma_channel_config_tx, false);
+    channel_config_set_write_increment(&dma_channel_config_tx, false);
+    dma_channel_configure(dma_tx, &dma_channel_config_tx,
+                          g_spi_tx_fifo, &dummy_data, rd->len, false);
+    dma_channel_configure(dma_tx_hdr, &dma_channel_config_tx_hdr,
+                          g_spi_tx_fifo, wr->buf, wr->len, false);
+
+    // header echo dropped by dma_rx_hdr, then the data into rd
+    channel_config_set_read_increment(&dma_channel_config_rx, false);
+    channel_config_set_write_increment(&dma_channel_config_rx, true);
+    dma_channel_configure(dma_rx, &dma_channel_config_rx,
+                          rd->buf, g_spi_rx_fifo, rd->len, false);
+    dma_channel_configure(dma_rx_hdr, &dma_channel_config_rx_hdr,
+                          &dummy_data, g_spi_rx_fifo, wr->len, false);
+
+    // dma_rx is only triggered by the chain, wait for its raw completion flag rather
+    // than BUSY, which is also clear before the header has been received
+    dma_hw->intr = 1u << dma_rx;
+    dma_start_channel_mask((1u << dma_tx_hdr) | (1u << dma_rx_hdr));
+}
+
+static void wizchip_read_burst_vec_wait(void)
+{
+    while (!(dma_hw->intr & (1u << dma_rx)))
+        tight_loop_contents();
+}
+
+static void wizchip_read_burst_vec(wiz_iovec *wr, wiz_iovec *rd)
+{
+    if (rd->len == 0)
+    {
+        wizchip_write_burst(wr->buf, wr->len);
+        return;
+    }
+
+    // the threshold is on the data, the header is short anyway
+    if (rd->len < g_dma_min)
+    {
+        wizchip_fifo_xfer(wr->buf, NULL, wr->len);
+        wizchip_fifo_xfer(NULL, rd->buf, rd->len);
+        return;
+    }
+
+    wizchip_read_burst_vec_start(wr, rd);
+    wizchip_read_burst_vec_wait();
+}
+
+/* Header and data channels of a vectored write, both segments non-empty */
+static void wizchip_write_burst_vec_start(wiz_iovec *iov)
+{
+    channel_config_set_read_increment(&dma_channel_config_tx, true);
+    channel_config_set_write_increment(&dma_channel_config_tx, false);
+    dma_channel_configure(dma_tx, &dma_channel_config_tx,
+                          g_spi_tx_fifo, iov[1].buf, iov[1].len, false);
+    dma_channel_configure(dma_tx_hdr, &dma_channel_config_tx_hdr,
+                          g_spi_tx_fifo, iov[0].buf, iov[0].len, false);
+
+    // everything clocked back in is dropped, one channel covers both segments
+    channel_config_set_read_increment(&dma_channel_config_rx, false);
+    channel_config_set_write_increment(&dma_channel_config_rx, false);
+    dma_channel_configure(dma_rx, &dma_channel_config_rx,
+                          &dummy_data, g_spi_rx_fifo, iov[0].len + iov[1].len, false);
+
+    dma_start_channel_mask((1u << dma_tx_hdr) | (1u << dma_rx));
+}
+
+static void wizchip_write_burst_vec(wiz_iovec *iov, uint8_t iovcnt)
+{
+    uint8_t i;
+
+    if (iovcnt != 2 || iov[0].len == 0 || iov[1].len == 0 || iov[1].len < g_dma_min)
+    {
+        // same CS-low window, one DMA or FIFO loop per segment
+        for (i = 0; i < iovcnt; i++)
+        {
+            if (iov[i].len)
+                wizchip_write_burst(iov[i].buf, iov[i].len);
+        }
+
+        return;
+    }
+
+    wizchip_write_burst_vec_start(iov);
+    dma_channel_wait_for_finish_blocking(dma_rx);
+}
+
+/* Two vectored reads, the second header is set up in the header channels while the first
+   frame's data is still being clocked in, so only the data channels and CS are left
+   between the frames. CS is a GPIO, the CPU toggles it once the first frame is in */
+static void wizchip_read_burst_wrap(wiz_iovec *wr, wiz_iovec *rd)
+{
+    // a short frame goes through the FIFO loop, the frames one after the other
+    if (rd[0].len < g_dma_min || rd[1].len < g_dma_min)
+    {
+        wizchip_read_burst_vec(&wr[0], &rd[0]);
+        wizchip_deselect();
+        wizchip_select();
+        wizchip_read_burst_vec(&wr[1], &rd[1]);
+        return;
+    }
+
+    wizchip_read_burst_vec_start(&wr[0], &rd[0]);
+
+    // the header channels are free once they have chained to the data channels
+    dma_channel_wait_for_finish_blocking(dma_rx_hdr);
+    dma_channel_configure(dma_tx_hdr, &dma_channel_config_tx_hdr,
+                          g_spi_tx_fifo, wr[1].buf, wr[1].len, false);
+    dma_channel_configure(dma_rx_hdr, &dma_channel_config_rx_hdr,
+                          &dummy_data, g_spi_rx_fifo, wr[1].len, false);
+
+    wizchip_read_burst_vec_wait();
+
+    // the data channel configs still hold the increments of the first frame
+    dma_channel_configure(dma_tx, &dma_channel_config_tx,
+                          g_spi_tx_fifo, &dummy_data, rd[1].len, false);
+    dma_channel_configure(dma_rx, &dma_channel_config_rx,
+                          rd[1].buf, g_spi_rx_fifo, rd[1].len, false);
+
+    wizchip_deselect();
+    wizchip_select();
+
+    dma_hw->intr = 1u << dma_rx;
+    dma_start_channel_mask((1u << dma_tx_hdr) | (1u << dma_rx_hdr));
+
+    wizchip_read_burst_vec_wait();
+}
+
+/* Two vectored writes, iov[0..1] then iov[2..3], as wizchip_read_burst_wrap() */
+static void wizchip_write_burst_wrap(wiz_iovec *iov)
+{
+    if (iov[1].len < g_dma_min || iov[3].len < g_dma_min)
+    {
+        wizchip_write_burst_vec(&iov[0], 2);
+        wizchip_deselect();
+        wizchip_select();
+        wizchip_write_burst_vec(&iov[2], 2);
+        return;
+    }
+
+    wizchip_write_burst_vec_start(&iov[0]);
+
+    dma_channel_wait_for_finish_blocking(dma_tx_hdr);
+    dma_channel_configure(dma_tx_hdr, &dma_channel_config_tx_hdr,
+                          g_spi_tx_fifo, iov[2].buf, iov[2].len, false);
+
+    // dma_rx counts the first frame until its last byte is clocked out
+    dma_channel_wait_for_finish_blocking(dma_rx);
+
+    dma_channel_configure(dma_tx, &dma_channel_config_tx,
+                          g_spi_tx_fifo, iov[3].buf, iov[3].len, false);
+    dma_channel_configure(dma_rx, &dma_channel_config_rx,
+                          &dummy_data, g_spi_rx_fifo, iov[2].len + iov[3].len, false);
+
+    wizchip_deselect();
+    wizchip_select();
+
+    dma_start_channel_mask((1u << dma_tx_hdr) | (1u << dma_rx));
+    dma_channel_wait_for_finish_blocking(dma_rx);
+}
+
+static void wizchip_read_burst_async(uint8_t *pBuf, uint16_t len)
+{
+    // blocking bursts leave the raw interrupt of the RX channel set
+    dma_channel_acknowledge_irq0(dma_rx);
+    dma_channel_set_irq0_enabled(dma_rx, true);
+
+    // even lengths only, the interrupt has no odd byte to send
+    if (wizchip_burst_frame16(pBuf, len) && !(len & 1u))
+    {
+        g_burst_frame16 = true;
+        wizchip_spi_frame_bits(16);
+        wizchip_burst16_start(pBuf, len / 2, true);
+        return;
+    }
+
+    wizchip_read_burst_start(pBuf, len);
+}
+
+static void wizchip_write_burst_async(uint8_t *pBuf, uint16_t len)
+{
+    // blocking bursts leave the raw interrupt of the RX channel set
+    dma_channel_acknowledge_irq0(dma_rx);
+    dma_channel_set_irq0_enabled(dma_rx, true);
+
+    if (wizchip_burst_frame16(pBuf, len) && !(len & 1u))
+    {
+        g_burst_frame16 = true;
+        wizchip_spi_frame_bits(16);
+        wizchip_burst16_start(pBuf, len / 2, false);
+        return;
+    }
+
+    wizchip_write_burst_start(pBuf, len);
+}
+
+static void wizchip_dma_irq_handler(void)
+{
+    if (dma_channel_get_irq0_status(dma_rx))
+    {
+        // blocking bursts leave the interrupt disabled, only asynchronous ones get here
+        dma_channel_acknowledge_irq0(dma_rx);
+        dma_channel_set_irq0_enabled(dma_rx, false);
+
+        // the last halfword is in, the next header goes out in 8-bit frames
+        if (g_burst_frame16)
+        {
+            g_burst_frame16 = false;
+            wizchip_spi_frame_bits(8);
+        }
+
+        wizchip_spiburst_async_done();
+    }
+}
+
+static void wizchip_dma_initialize(void)
+{
+    dma_tx = dma_claim_unused_channel(true);
+    dma_rx = dma_claim_unused_channel(true);
+
+    dma_channel_config_tx = dma_channel_get_default_config(dma_tx);
+    channel_config_set_transfer_data_size(&dma_channel_config_tx, DMA_SIZE_8);
+    channel_config_set_dreq(&dma_channel_config_tx, g_spi_dreq_tx);
+
+    // We set the inbound DMA to transfer from the SPI receive FIFO to a memory buffer paced by the SPI RX FIFO DREQ
+    // We coinfigure the read address to remain unchanged for each element, but the write
+    // address to increment (so data is written throughout the buffer)
+    dma_channel_config_rx = dma_channel_get_default_config(dma_rx);
+    channel_config_set_transfer_data_size(&dma_channel_config_rx, DMA_SIZE_8);
+    channel_config_set_dreq(&dma_channel_config_rx, g_spi_dreq_rx);
+    channel_config_set_read_increment(&dma_channel_config_rx, false);
+    channel_config_set_write_increment(&dma_channel_config_rx, true);
+
+    // vectored bursts send the opcode/address header from their own channels, chained
+    // to the data channels so header and data go out in one CS-low window
+    dma_tx_hdr = dma_claim_unused_channel(true);
+    dma_rx_hdr = dma_claim_unused_channel(true);
+
+    dma_channel_config_tx_hdr = dma_channel_get_default_config(dma_tx_hdr);
+    channel_config_set_transfer_data_size(&dma_channel_config_tx_hdr, DMA_SIZE_8);
+    channel_config_set_dreq(&dma_channel_config_tx_hdr, g_spi_dreq_tx);
+    channel_config_set_read_increment(&dma_channel_config_tx_hdr, true);
+    channel_config_set_write_increment(&dma_channel_config_tx_hdr, false);
+    channel_config_set_chain_to(&dma_channel_config_tx_hdr, dma_tx);
+
+    dma_channel_config_rx_hdr = dma_channel_get_default_config(dma_rx_hdr);
+    channel_config_set_transfer_data_size(&dma_channel_config_rx_hdr, DMA_SIZE_8);
+    channel_config_set_dreq(&dma_channel_config_rx_hdr, g_spi_dreq_rx);
+    channel_config_set_read_increment(&dma_channel_config_rx_hdr, false);
+    channel_config_set_write_increment(&dma_channel_config_rx_hdr, false);
+    channel_config_set_chain_to(&dma_channel_config_rx_hdr, dma_rx);
+
+    // the RX channel finishes last, its interrupt completes asynchronous bursts
+    irq_set_exclusive_handler(DMA_IRQ_0, wizchip_dma_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+#else
+/* PIO bus */
+static uint32_t wizchip_bus_pio_initialize(void)
+{
+    PIO pio = g_port_config.pio;
+    uint offset = pio_add_program(pio, &w5x00_bus_program);
+    uint32_t clk = clock_get_hz(clk_sys);
+    uint32_t div = (clk + g_port_config.baudrate - 1) / g_port_config.baudrate;
+    dma_channel_config c;
+
+    g_bus_sm = pio_claim_unused_sm(pio, true);
+    w5x00_bus_program_init(pio, g_bus_sm, offset, (float)div, g_port_config.pin_bus_d0, g_port_config.pin_bus_cs);
+
+    if (!g_port_config.use_dma)
+        return clk / div;
+
+    // buffers go through DMA, one byte per FIFO word
+    g_bus_dma_tx = dma_claim_unused_channel(true);
+    g_bus_dma_rx = dma_claim_unused_channel(true);
+
+    c = dma_channel_get_default_config(g_bus_dma_tx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, g_bus_sm, true));
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_set_config(g_bus_dma_tx, &c, false);
+    dma_channel_set_write_addr(g_bus_dma_tx, &pio->txf[g_bus_sm], false);
+
+    c = dma_channel_get_default_config(g_bus_dma_rx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, g_bus_sm, false));
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    dma_channel_set_config(g_bus_dma_rx, &c, false);
+    dma_channel_set_read_addr(g_bus_dma_rx, &pio->rxf[g_bus_sm], false);
+
+    return clk / div;
+}
+
+static iodata_t wizchip_bus_read(uint32_t addr)
+{
+    pio_sm_put_blocking(g_port_config.pio, g_bus_sm, w5x00_bus_cmd(addr, true, 1));
+
+    return (iodata_t)pio_sm_get_blocking(g_port_config.pio, g_bus_sm);
+}
+
+static void wizchip_bus_write(uint32_t addr, iodata_t wb)
+{
+    // the FIFO keeps the order, a following read waits for this write
+    pio_sm_put_blocking(g_port_config.pio, g_bus_sm, w5x00_bus_cmd(addr, false, 1));
+    pio_sm_put_blocking(g_port_config.pio, g_bus_sm, wb);
+}
+
+static void wizchip_bus_read_buf(uint32_t addr, iodata_t *pBuf, uint16_t len)
+{
+    if (len == 0)
+        return;
+
+    dma_channel_set_write_addr(g_bus_dma_rx, pBuf, false);
+    dma_channel_set_trans_count(g_bus_dma_rx, len, true);
+
+    pio_sm_put_blocking(g_port_config.pio, g_bus_sm, w5x00_bus_cmd(addr, true, len));
+
+    dma_channel_wait_for_finish_blocking(g_bus_dma_rx);
+}
+
+static void wizchip_bus_write_buf(uint32_t addr, iodata_t *pBuf, uint16_t len)
+{
+    if (len == 0)
+        return;
+
+    pio_sm_put_blocking(g_port_config.pio, g_bus_sm, w5x00_bus_cmd(addr, false, len));
+
+    dma_channel_set_read_addr(g_bus_dma_tx, pBuf, false);
+    dma_channel_set_trans_count(g_bus_dma_tx, len, true);
+
+    // pBuf is free again once the last byte is in the FIFO
+    dma_channel_wait_for_finish_blocking(g_bus_dma_tx);
+}
+#endif
+
+/* W5x00 */
+void w5x00_pico_port_get_default_config(w5x00_pico_port_config_t *config)
+{
+    config->spi = spi0;
+    config->pio = pio0;
+    config->pin_sck = 18;
+    config->pin_mosi = 19;
+    config->pin_miso = 16;
+    config->pin_cs = 17;
+    config->pin_rst = 20;
+    config->pin_int = 21;
+    config->pin_bus_d0 = 0;
+    config->pin_bus_cs = 10;
+#ifdef W5X00_PICO_PORT_BUS
+    config->baudrate = 62500 * 1000;
+#else
+    config->baudrate = 50000 * 1000;
+#endif
+    config->use_dma = true;
+    config->use_pio = false;
+    config->use_frame16 = true;
+}
+
+#if _WIZCHIP_ == W5100S
+static uint32_t wizchip_poll_ms(void)
+{
+    return timebase_ms();
+}
+
+static void wizchip_poll_wait(uint32_t timeout_ms)
+{
+    absolute_time_t timeout = make_timeout_time_ms(timeout_ms);
+
+    // the GPIO IRQ of INTn ends the wfe
+    while (!sockevent_pending() && !best_effort_wfe_or_timeout(timeout))
+        ;
+}
+#endif
+
+uint32_t w5x00_pico_port_init(const w5x00_pico_port_config_t *config)
+{
+    uint32_t baudrate;
+
+    g_port_config = *config;
+
+    if (g_port_config.pin_rst != W5X00_PICO_PORT_PIN_NONE)
+    {
+        // RSTn is active low, the W5x00 runs until w5x00_pico_port_reset()
+        gpio_init(g_port_config.pin_rst);
+        gpio_put(g_port_config.pin_rst, 1);
+        gpio_set_dir(g_port_config.pin_rst, GPIO_OUT);
+    }
+
+#if _WIZCHIP_ == W5100S
+    // the timeouts of wiz_poll(), INTn isn't waited for until w5x00_pico_port_int_enable()
+    reg_wizpoll_cbfunc(wizchip_poll_ms, NULL);
+    // the round trips of the socket-less ARP and ping
+    reg_wizchip_sl_cbfunc(timebase_us);
+#endif
+
+#ifdef W5X00_PICO_PORT_BUS
+    baudrate = wizchip_bus_pio_initialize();
+
+    /* BUS function register, the PIO drives CSn itself */
+    reg_wizchip_cs_cbfunc(NULL, NULL);
+    reg_wizchip_bus_cbfunc(wizchip_bus_read, wizchip_bus_write);
+
+    if (g_port_config.use_dma)
+        reg_wizchip_busbuf_cbfunc(wizchip_bus_read_buf, wizchip_bus_write_buf);
+#else
+#ifdef _WIZCHIP_SPI_INLINE_
+    // WIZCHIP_READ()/WIZCHIP_WRITE() drive the SPI and CS of w5x00_spi_port.h
+    hard_assert(!g_port_config.use_pio && g_port_config.spi == WIZCHIP_PORT_SPI && g_port_config.pin_cs == WIZCHIP_PORT_PIN_CS);
+#endif
+
+    if (g_port_config.use_pio)
+    {
+        // the PIO SPI program shifts 8-bit frames only
+        g_port_config.use_frame16 = false;
+        baudrate = wizchip_spi_pio_initialize();
+    }
+    else
+    {
+        baudrate = wizchip_spi_initialize();
+    }
+
+    // chip select is active-low, so we'll initialise it to a driven-high state
+    gpio_init(g_port_config.pin_cs);
+    gpio_set_dir(g_port_config.pin_cs, GPIO_OUT);
+    gpio_put(g_port_config.pin_cs, 1);
+
+#if _WIZCHIP_INSTANCES_ > 1
+    g_port_pin_cs[0] = g_port_config.pin_cs;
+#endif
+
+    /* CS function register */
+    reg_wizchip_cs_cbfunc(wizchip_select, wizchip_deselect);
+
+    /* SPI function register, registers are a 4 byte frame rather than 4 byte or DMA transfers */
+    if (g_port_config.use_pio)
+    {
+        reg_wizchip_spi_cbfunc(wizchip_pio_read, wizchip_pio_write);
+        reg_wizchip_spireg_cbfunc(wizchip_pio_xfer_reg);
+    }
+    else
+    {
+        reg_wizchip_spi_cbfunc(wizchip_read, wizchip_write);
+        reg_wizchip_spireg_cbfunc(wizchip_xfer_reg);
+    }
+
+    if (g_port_config.use_dma)
+    {
+        wizchip_dma_initialize();
+
+        reg_wizchip_spiburst_cbfunc(wizchip_read_burst, wizchip_write_burst);
+        reg_wizchip_spiburst_vec_cbfunc(wizchip_read_burst_vec, wizchip_write_burst_vec);
+        reg_wizchip_spiburst_wrap_cbfunc(wizchip_read_burst_wrap, wizchip_write_burst_wrap);
+        reg_wizchip_spiburst_async_cbfunc(wizchip_read_burst_async, wizchip_write_burst_async);
+    }
+#endif
+
+    return baudrate;
+}
+
+bool w5x00_pico_port_reset(void)
+{
+    uint32_t start;
+
+    if (g_port_config.pin_rst != W5X00_PICO_PORT_PIN_NONE)
+    {
+        gpio_put(g_port_config.pin_rst, 0);
+        sleep_us(W5X00_PICO_PORT_RESET_LOW_US);
+
+        gpio_put(g_port_config.pin_rst, 1);
+    }
+
+    // the chip answers once its PLL has locked, usually well before the longest wait
+    start = timebase_ms();
+
+    while (PORT_GET_VERSION() != PORT_VERSION)
+    {
+        if ((timebase_ms() - start) >= W5X00_PICO_PORT_RESET_READY_MS)
+            return false;
+
+        sleep_us(100);
+    }
+
+    return true;
+}
+
+void w5x00_pico_port_link_callback(w5x00_pico_port_link_callback_t callback)
+{
+    g_link_callback = callback;
+}
+
+bool w5x00_pico_port_link_poll(void)
+{
+    uint32_t now = timebase_ms();
+    bool up;
+
+    if (g_link_polled && (now - g_link_poll_ms) < W5X00_PICO_PORT_LINK_POLL_MS)
+        return g_link_up;
+
+    g_link_poll_ms = now;
+    up = (wizphy_getphylink() == PHY_LINK_ON);
+
+    if (g_link_polled && up == g_link_up)
+        return up;
+
+    g_link_polled = true;
+    g_link_up = up;
+
+    // the address is announced before anything is sent on the new link
+    if (up)
+        w5x00_pico_port_gratuitous_arp();
+
+    if (g_link_callback != NULL)
+        g_link_callback(up);
+
+    return up;
+}
+
+int8_t w5x00_pico_port_gratuitous_arp(void)
+{
+#if _WIZCHIP_ == W5100S
+    uint8_t ip[4];
+
+    getSIPR(ip);
+
+    // a socket-less ARP request for the chip's own address, left to time out on its own:
+    // a reply would come from another host with the address
+    return (wizchip_sl_start(SLCMD_ARP, ip, W5X00_PICO_PORT_GARP_RTR, 0, NULL, NULL) == 0) ? 0 : -1;
+#else
+    return -1;
+#endif
+}
+
+#if _WIZCHIP_ == W5100S
+static void wizchip_int_window_end(uint32_t now)
+{
+    // adaptive: longer while edges wait, shorter again once the rate drops
+    if (g_int_window_held)
+    {
+        g_int_window_us *= 2;
+
+        if (g_int_window_us > g_int_coalesce.window_max_us)
+            g_int_window_us = g_int_coalesce.window_max_us;
+    }
+    else if (g_int_window_count <= g_int_coalesce.count / 2)
+    {
+        g_int_window_us /= 2;
+
+        if (g_int_window_us < g_int_coalesce.window_us)
+            g_int_window_us = g_int_coalesce.window_us;
+    }
+
+    g_int_window_start = now;
+    g_int_window_count = 0;
+    g_int_window_held = false;
+}
+
+static int64_t wizchip_int_alarm_callback(alarm_id_t id, void *user_data)
+{
+    // INTn stays asserted while the edge is held, no other edge came meanwhile
+    wizchip_int_window_end(timebase_us());
+    g_int_window_count = 1;
+    g_int_alarm = 0;
+
+    sockevent_isr();
+
+    return 0;
+}
+
+static void wizchip_int_irq_handler(uint gpio, uint32_t events)
+{
+    uint32_t now = timebase_us();
+
+    g_int_stats.edges++;
+
+    // the completion of a socket-less command, before the coalescing holds the edge
+    wizchip_sl_isr();
+
+    if (g_int_coalesce.count != 0)
+    {
+        if ((now - g_int_window_start) >= g_int_window_us)
+            wizchip_int_window_end(now);
+
+        if (g_int_window_count >= g_int_coalesce.count)
+        {
+            g_int_stats.held++;
+            g_int_window_held = true;
+
+            if (g_int_alarm <= 0)
+                g_int_alarm = add_alarm_in_us(g_int_window_us - (now - g_int_window_start), wizchip_int_alarm_callback, NULL, true);
+
+            return;
+        }
+
+        g_int_window_count++;
+    }
+
+    // the chip is read by sockevent_dispatch() or wiz_poll() outside of the interrupt
+    sockevent_isr();
+}
+
+void w5x00_pico_port_int_enable(void)
+{
+    if (g_port_config.pin_int == W5X00_PICO_PORT_PIN_NONE)
+        return;
+
+    memset(&g_int_stats, 0, sizeof(g_int_stats));
+
+    // INTn is open drain, active low
+    gpio_init(g_port_config.pin_int);
+    gpio_set_dir(g_port_config.pin_int, GPIO_IN);
+    gpio_pull_up(g_port_config.pin_int);
+    gpio_set_irq_enabled_with_callback(g_port_config.pin_int, GPIO_IRQ_EDGE_FALL, true, &wizchip_int_irq_handler);
+
+    // wiz_poll() sleeps until INTn
+    reg_wizpoll_cbfunc(wizchip_poll_ms, wizchip_poll_wait);
+}
+
+void w5x00_pico_port_int_coalesce(const w5x00_pico_port_coalesce_t *coalesce)
+{
+    w5x00_pico_port_coalesce_t off = {0, 0, 0, 0};
+    uint32_t irq = save_and_disable_interrupts();
+
+    if (coalesce == NULL)
+        coalesce = &off;
+
+    g_int_coalesce = *coalesce;
+
+    if (g_int_coalesce.window_max_us < g_int_coalesce.window_us)
+        g_int_coalesce.window_max_us = g_int_coalesce.window_us;
+
+    g_int_window_us = g_int_coalesce.window_us;
+    g_int_window_start = timebase_us();
+    g_int_window_count = 0;
+    g_int_window_held = false;
+
+    restore_interrupts(irq);
+
+    // a held edge is passed now, with the settings that follow
+    if (g_int_alarm > 0)
+    {
+        cancel_alarm(g_int_alarm);
+        g_int_alarm = 0;
+
+        sockevent_isr();
+    }
+
+    ctlwizchip(CW_SET_INTRTIME, &g_int_coalesce.intptmr);
+}
+
+void w5x00_pico_port_int_get_stats(w5x00_pico_port_int_stats_t *stats)
+{
+    *stats = g_int_stats;
+    stats->window_us = g_int_window_us;
+}
+#endif
+
+#if !defined(W5X00_PICO_PORT_BUS) && _WIZCHIP_INSTANCES_ > 1
+int8_t w5x00_pico_port_add_chip(wizchip_t *chip, uint pin_cs)
+{
+#ifdef _WIZCHIP_SPI_INLINE_
+    hard_assert(false);
+#endif
+
+    if (wizchip_instance_init(chip) != 0)
+        return -1;
+
+    g_port_pin_cs[chip->inst] = pin_cs;
+
+    gpio_init(pin_cs);
+    gpio_set_dir(pin_cs, GPIO_OUT);
+    gpio_put(pin_cs, 1);
+
+    return 0;
+}
+#endif
+
+#ifndef W5X00_PICO_PORT_BUS
+/* Calibration */
+#define CAL_REG_READS 64 // version register reads of a try, the register frames
+
+static uint8_t g_cal_tx[W5X00_PICO_PORT_CAL_LEN];
+static uint8_t g_cal_rx[W5X00_PICO_PORT_CAL_LEN];
+static uint32_t g_cal_addr;
+static uint16_t g_cal_len;
+static uint32_t g_cal_seed = 0x12345678;
+static uint32_t g_port_errors;
+
+static const uint8_t g_cal_drive[] = {GPIO_DRIVE_STRENGTH_4MA, GPIO_DRIVE_STRENGTH_8MA, GPIO_DRIVE_STRENGTH_12MA};
+
+/* SCK of divider step div, baudrate = clk_peri / (2 * div) or clk_sys / (4 * div) with the PIO SPI */
+static uint32_t wizchip_cal_clk(void)
+{
+    return g_port_config.use_pio ? clock_get_hz(clk_sys) / 4 : clock_get_hz(clk_peri) / 2;
+}
+
+static uint32_t wizchip_cal_set_baudrate(uint32_t div)
+{
+    if (g_port_config.use_pio)
+    {
+        pio_sm_set_clkdiv_int_frac(g_port_config.pio, g_spi_sm, (uint16_t)div, 0);
+        pio_sm_clkdiv_restart(g_port_config.pio, g_spi_sm);
+
+        return wizchip_cal_clk() / div;
+    }
+
+    return spi_set_baudrate(g_port_config.spi, wizchip_cal_clk() / div);
+}
+
+static void wizchip_cal_set_pins(uint8_t drive, bool sample_early)
+{
+    gpio_set_drive_strength(g_port_config.pin_sck, (enum gpio_drive_strength)drive);
+    gpio_set_drive_strength(g_port_config.pin_mosi, (enum gpio_drive_strength)drive);
+
+    // the 2 cycle synchroniser delay moves the MISO sample before the rising edge
+    if (g_port_config.use_pio)
+    {
+        if (sample_early)
+            hw_clear_bits(&g_port_config.pio->input_sync_bypass, 1u << g_port_config.pin_miso);
+        else
+            hw_set_bits(&g_port_config.pio->input_sync_bypass, 1u << g_port_config.pin_miso);
+    }
+}
+
+/* The TX buffer of sn, from the slowest SCK before its registers are trusted */
+static void wizchip_cal_buffer(uint8_t sn)
+{
+#if _WIZCHIP_ == W5500
+    g_cal_addr = (uint32_t)WIZCHIP_TXBUF_BLOCK(sn) << 3;
+#else
+    g_cal_addr = getSn_TxBASE(sn);
+#endif
+    g_cal_len = getSn_TxMAX(sn);
+
+    if (g_cal_len > W5X00_PICO_PORT_CAL_LEN)
+        g_cal_len = W5X00_PICO_PORT_CAL_LEN;
+}
+
+static void wizchip_cal_pattern(uint8_t pattern)
+{
+    uint16_t i;
+
+    for (i = 0; i < g_cal_len; i++)
+    {
+        switch (pattern)
+        {
+        case 0:
+            g_cal_tx[i] = (i & 1) ? 0x00 : 0xFF;
+            break;
+        case 1:
+            g_cal_tx[i] = (i & 1) ? 0x55 : 0xAA;
+            break;
+        case 2:
+            // walking one, then walking zero
+            g_cal_tx[i] = (uint8_t)((1u << (i & 7)) ^ ((i & 8) ? 0xFF : 0x00));
+            break;
+        default:
+            // xorshift32, a new sequence every try
+            g_cal_seed ^= g_cal_seed << 13;
+            g_cal_seed ^= g_cal_seed >> 17;
+            g_cal_seed ^= g_cal_seed << 5;
+            g_cal_tx[i] = (uint8_t)g_cal_seed;
+            break;
+        }
+    }
+}
+
+static uint32_t wizchip_cal_try(void)
+{
+    uint32_t errors = 0;
+    uint8_t pattern;
+    uint16_t i;
+
+    for (i = 0; i < CAL_REG_READS; i++)
+    {
+        if (PORT_GET_VERSION() != PORT_VERSION)
+            errors++;
+    }
+
+    for (pattern = 0; pattern < 4; pattern++)
+    {
+        wizchip_cal_pattern(pattern);
+        WIZCHIP_WRITE_BUF(g_cal_addr, g_cal_tx, g_cal_len);
+
+        // the complement, a dead MISO doesn't read back a pattern left over
+        for (i = 0; i < g_cal_len; i++)
+            g_cal_rx[i] = (uint8_t)~g_cal_tx[i];
+
+        WIZCHIP_READ_BUF(g_cal_addr, g_cal_rx, g_cal_len);
+
+        for (i = 0; i < g_cal_len; i++)
+        {
+            if (g_cal_rx[i] != g_cal_tx[i])
+                errors++;
+        }
+    }
+
+    return errors;
+}
+
+uint32_t w5x00_pico_port_calibrate(uint8_t sn, w5x00_pico_port_cal_t *cal)
+{
+    w5x00_pico_port_cal_t result = {0};
+    uint32_t clk = wizchip_cal_clk();
+    uint32_t div_min = (clk + g_port_config.baudrate - 1) / g_port_config.baudrate;
+    uint32_t div_max = clk / W5X00_PICO_PORT_CAL_MIN_HZ;
+    uint32_t div, fastest_div = 0, errors, rounds;
+    uint32_t baudrate, last = 0;
+    uint8_t d, samples = g_port_config.use_pio ? 2 : 1, s;
+    bool found = false;
+
+    if (div_min == 0)
+        div_min = 1;
+    if (g_port_config.use_pio && div_max > 0xFFFF)
+        div_max = 0xFFFF;
+    if (div_max < div_min)
+        div_max = div_min;
+
+    wizchip_cal_set_pins(GPIO_DRIVE_STRENGTH_4MA, false);
+    wizchip_cal_set_baudrate(div_max);
+    wizchip_cal_buffer(sn);
+
+    for (div = div_min; (div <= div_max) && !found && g_cal_len; div++)
+    {
+        baudrate = wizchip_cal_set_baudrate(div);
+
+        // the PL022 prescaler makes some steps the same SCK
+        if (baudrate == last)
+            continue;
+        last = baudrate;
+
+        // the lowest drive and the late sample first, the defaults of w5x00_pico_port_init()
+        for (d = 0; (d < count_of(g_cal_drive)) && !found; d++)
+        {
+            for (s = 0; (s < samples) && !found; s++)
+            {
+                wizchip_cal_set_pins(g_cal_drive[d], s != 0);
+
+                errors = wizchip_cal_try();
+                result.tested++;
+                result.errors += errors;
+
+                if (errors == 0)
+                {
+                    found = true;
+                    fastest_div = div;
+                    result.fastest = baudrate;
+                    result.drive = g_cal_drive[d];
+                    result.sample_early = (s != 0);
+                }
+            }
+        }
+    }
+
+    if (found)
+    {
+        wizchip_cal_set_pins(result.drive, result.sample_early);
+
+        div = fastest_div + W5X00_PICO_PORT_CAL_MARGIN;
+        if (div > div_max)
+            div = div_max;
+
+        for (; (div <= div_max) && (result.baudrate == 0); div++)
+        {
+            baudrate = wizchip_cal_set_baudrate(div);
+
+            for (rounds = 0; rounds < W5X00_PICO_PORT_CAL_ROUNDS; rounds++)
+            {
+                errors = wizchip_cal_try();
+
+                if (errors)
+                {
+                    g_port_errors += errors;
+                    break;
+                }
+            }
+
+            if (rounds == W5X00_PICO_PORT_CAL_ROUNDS)
+                result.baudrate = baudrate;
+        }
+    }
+
+    if (result.baudrate == 0)
+    {
+        wizchip_cal_set_pins(GPIO_DRIVE_STRENGTH_4MA, false);
+        wizchip_cal_set_baudrate(div_min);
+    }
+
+    if (g_port_config.pin_rst != W5X00_PICO_PORT_PIN_NONE)
+    {
+        w5x00_pico_port_reset();
+#if _WIZCHIP_ == W5100S
+        // the buffer layout was read before the reset
+        wiz_sn_buf_invalidate();
+#endif
+    }
+
+    if (cal)
+        *cal = result;
+
+    return result.baudrate;
+}
+
+uint32_t w5x00_pico_port_selftest(uint8_t sn)
+{
+    uint32_t errors;
+
+    wizchip_cal_buffer(sn);
+    errors = wizchip_cal_try();
+    g_port_errors += errors;
+
+    return errors;
+}
+
+uint32_t w5x00_pico_port_get_errors(void)
+{
+    return g_port_errors;
+}
+
+/* Writes and reads of len bytes in the buffer of wizchip_cal_buffer(), with the threshold dma_min */
+static uint32_t wizchip_dma_cal_time(uint16_t len, uint16_t dma_min)
+{
+    uint32_t irq, start, us;
+    uint16_t i;
+
+    g_dma_min = dma_min;
+
+    // USB and timer interrupts would land in one run and not the other
+    irq = save_and_disable_interrupts();
+    start = timebase_us();
+
+    for (i = 0; i < W5X00_PICO_PORT_DMA_CAL_REPEAT; i++)
+    {
+        WIZCHIP_WRITE_BUF(g_cal_addr, g_cal_tx, len);
+        WIZCHIP_READ_BUF(g_cal_addr, g_cal_rx, len);
+    }
+
+    us = timebase_us() - start;
+    restore_interrupts(irq);
+
+    return us;
+}
+
+uint16_t w5x00_pico_port_dma_calibrate(uint8_t sn)
+{
+    uint16_t len, max, found = 0;
+    uint32_t fifo_us, dma_us;
+
+    if (!g_port_config.use_dma)
+        return 0;
+
+    wizchip_cal_buffer(sn);
+    wizchip_cal_pattern(3);
+
+    max = W5X00_PICO_PORT_DMA_CAL_MAX;
+    if (max > g_cal_len)
+        max = g_cal_len;
+
+    // finer steps where the setup matters most: 1, 2, 3, 4, 6, 8, 11, 14, 18, 23, ...
+    for (len = 1; len <= max; len += len / 4 + 1)
+    {
+        fifo_us = wizchip_dma_cal_time(len, len + 1);
+        dma_us = wizchip_dma_cal_time(len, len);
+
+        if (dma_us >= fifo_us)
+            found = 0;
+        else if (found == 0)
+            found = len;
+        else
+            break;
+    }
+
+    g_dma_min = found ? found : max;
+
+    return g_dma_min;
+}
+
+uint16_t w5x00_pico_port_get_dma_min(void)
+{
+    return g_dma_min;
+}
+
+void w5x00_pico_port_set_dma_min(uint16_t len)
+{
+    g_dma_min = len;
+}
+#endif
+
+/* Flash */
+#define FLASH_RECORD_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE) // last sector
+#define FLASH_RECORD_MAGIC 0x57354C53                                    // "W5LS"
+
+typedef struct flash_record_t
+{
+    uint32_t magic;
+    uint16_t len;
+    uint16_t sum; // of len and the data, an interrupted erase or program doesn't load
+    uint8_t data[W5X00_PICO_PORT_FLASH_MAX];
+} flash_record_t;
+
+static uint16_t flash_record_sum(const uint8_t *data, size_t len)
+{
+    uint16_t sum = (uint16_t)len;
+
+    for (size_t i = 0; i < len; i++)
+        sum = (uint16_t)((sum << 1) | (sum >> 15)) + data[i];
+
+    return sum;
+}
+
+bool w5x00_pico_port_flash_load(void *data, size_t len)
+{
+    const flash_record_t *record = (const flash_record_t *)(XIP_BASE + FLASH_RECORD_OFFSET);
+
+    if ((len > W5X00_PICO_PORT_FLASH_MAX) || (record->magic != FLASH_RECORD_MAGIC) || (record->len != len))
+        return false;
+
+    if (record->sum != flash_record_sum(record->data, len))
+        return false;
+
+    memcpy(data, record->data, len);
+
+    return true;
+}
+
+bool w5x00_pico_port_flash_save(const void *data, size_t len)
+{
+    static flash_record_t record; // a flash page, off the stack
+    uint32_t status;
+
+    if (len > W5X00_PICO_PORT_FLASH_MAX)
+        return false;
+
+    // every save wears the sector, skip the ones not changing it
+    if (w5x00_pico_port_flash_load(record.data, len) && (memcmp(record.data, data, len) == 0))
+        return true;
+
+    memset(&record, 0xFF, sizeof(record));
+    record.magic = FLASH_RECORD_MAGIC;
+    record.len = (uint16_t)len;
+    record.sum = flash_record_sum(data, len);
+    memcpy(record.data, data, len);
+
+    // XIP is off while erasing and programming, nothing may run from flash
+    status = save_and_disable_interrupts();
+    flash_range_erase(FLASH_RECORD_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(FLASH_RECORD_OFFSET, (const uint8_t *)&record, sizeof(record));
+    restore_interrupts(status);
+
+    return true;
+}
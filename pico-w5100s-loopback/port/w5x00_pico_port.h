@@ -0,0 +1,341 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _W5X00_PICO_PORT_H_
+#define _W5X00_PICO_PORT_H_
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+#include "hardware/spi.h"
+#include "hardware/pio.h"
+
+#include "wizchip_conf.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* No pin, for pin_rst and pin_int */
+#define W5X00_PICO_PORT_PIN_NONE 0xFFu
+
+/* Largest record of w5x00_pico_port_flash_save(), a flash page less the header */
+#define W5X00_PICO_PORT_FLASH_MAX 248u
+
+/* Bytes of each write/readback pattern of w5x00_pico_port_calibrate(), at most the socket TX buffer */
+#ifndef W5X00_PICO_PORT_CAL_LEN
+#define W5X00_PICO_PORT_CAL_LEN 1024u
+#endif
+
+/* Shortest burst moved in 16-bit frames with use_frame16, shorter ones don't make up for the
+   two format switches */
+#ifndef W5X00_PICO_PORT_FRAME16_MIN
+#define W5X00_PICO_PORT_FRAME16_MIN 16u
+#endif
+
+/* Shortest blocking burst moved by DMA with use_dma, shorter ones are a CPU loop over the FIFOs,
+   until w5x00_pico_port_dma_calibrate() measures it. The length is the data's, without the header */
+#ifndef W5X00_PICO_PORT_DMA_MIN
+#define W5X00_PICO_PORT_DMA_MIN 16u
+#endif
+
+/* Longest burst timed by w5x00_pico_port_dma_calibrate(), and the frames timed per length and way */
+#ifndef W5X00_PICO_PORT_DMA_CAL_MAX
+#define W5X00_PICO_PORT_DMA_CAL_MAX 128u
+#endif
+
+#ifndef W5X00_PICO_PORT_DMA_CAL_REPEAT
+#define W5X00_PICO_PORT_DMA_CAL_REPEAT 32u
+#endif
+
+/* RSTn low time of w5x00_pico_port_reset() */
+#ifndef W5X00_PICO_PORT_RESET_LOW_US
+#define W5X00_PICO_PORT_RESET_LOW_US 1000u
+#endif
+
+/* Longest wait of w5x00_pico_port_reset() for the chip to answer after RSTn goes high */
+#ifndef W5X00_PICO_PORT_RESET_READY_MS
+#define W5X00_PICO_PORT_RESET_READY_MS 100u
+#endif
+
+/* Interval of the PHY link reads of w5x00_pico_port_link_poll() */
+#ifndef W5X00_PICO_PORT_LINK_POLL_MS
+#define W5X00_PICO_PORT_LINK_POLL_MS 20u
+#endif
+
+/* Time the gratuitous ARP of w5x00_pico_port_gratuitous_arp() waits for a reply, in 100us */
+#ifndef W5X00_PICO_PORT_GARP_RTR
+#define W5X00_PICO_PORT_GARP_RTR 2000u
+#endif
+
+/* Slowest SCK tried by w5x00_pico_port_calibrate() */
+#ifndef W5X00_PICO_PORT_CAL_MIN_HZ
+#define W5X00_PICO_PORT_CAL_MIN_HZ (1000 * 1000)
+#endif
+
+/* Divider steps kept below the fastest error-free SCK */
+#ifndef W5X00_PICO_PORT_CAL_MARGIN
+#define W5X00_PICO_PORT_CAL_MARGIN 1u
+#endif
+
+/* Error-free rounds of all the patterns needed at the SCK chosen with the margin */
+#ifndef W5X00_PICO_PORT_CAL_ROUNDS
+#define W5X00_PICO_PORT_CAL_ROUNDS 16u
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* W5x00 interface of the RP2040 */
+typedef struct w5x00_pico_port_config_t
+{
+    spi_inst_t *spi;   // PL022 SPI instance, unused with use_pio
+    PIO pio;           // PIO of the PIO SPI and of the indirect bus
+    uint pin_sck;
+    uint pin_mosi;
+    uint pin_miso;
+    uint pin_cs;       // SPI chip select, driven as a GPIO
+    uint pin_rst;      // RSTn, or W5X00_PICO_PORT_PIN_NONE
+    uint pin_int;      // INTn, or W5X00_PICO_PORT_PIN_NONE
+    uint pin_bus_d0;   // Bus D7:D0 and A1:A0 on pin_bus_d0 to pin_bus_d0 + 9
+    uint pin_bus_cs;   // Bus CSn, WRn and RDn on pin_bus_cs to pin_bus_cs + 2
+    uint32_t baudrate; // SCK in Hz, or the bus PIO clock with a byte every 8 cycles
+    bool use_dma;      // buffers and bursts through DMA
+    bool use_pio;      // SCK from a PIO state machine instead of spi
+    bool use_frame16;  // payload of the DMA bursts in 16-bit frames, not with use_pio
+} w5x00_pico_port_config_t;
+
+/* Setting chosen by w5x00_pico_port_calibrate() */
+typedef struct w5x00_pico_port_cal_t
+{
+    uint32_t baudrate;  // SCK in Hz, margin included, or 0 when no setting was error-free
+    uint32_t fastest;   // fastest error-free SCK in Hz
+    uint8_t drive;      // enum gpio_drive_strength of SCK and MOSI
+    bool sample_early;  // PIO SPI: MISO through the input synchroniser, sampled 2 cycles earlier
+    uint32_t tested;    // settings tried
+    uint32_t errors;    // bytes and register reads wrong over all of them
+} w5x00_pico_port_cal_t;
+
+/* Interrupt coalescing of w5x00_pico_port_int_coalesce() */
+typedef struct w5x00_pico_port_coalesce_t
+{
+    uint16_t intptmr;       // INTPTMR of the chip, INTn held off after IR is cleared, in steps of 4 system clocks
+    uint16_t count;         // INTn edges passed at once in each window, 0 passes them all
+    uint32_t window_us;     // window of count, the edges after count wait for its end
+    uint32_t window_max_us; // adaptive, more than window_us lets the window grow up to it
+} w5x00_pico_port_coalesce_t;
+
+/* Called by w5x00_pico_port_link_poll() when the link changed */
+typedef void (*w5x00_pico_port_link_callback_t)(bool up);
+
+/* Counters of w5x00_pico_port_int_get_stats() */
+typedef struct w5x00_pico_port_int_stats_t
+{
+    uint32_t edges;     // falling edges of INTn
+    uint32_t held;      // of them, passed at the end of their window
+    uint32_t window_us; // current window, it differs from window_us when adaptive
+} w5x00_pico_port_int_stats_t;
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+/*! \brief Get the configuration of the W5100S-EVB-Pico and the Ethernet HAT
+ *
+ *  spi0 on GP16 to GP19, RSTn GP20, INTn GP21, 50MHz, DMA.
+ *  The indirect bus is on GP0 to GP12 at 62.5MHz, neither board routes it.
+ *
+ *  \param config configuration to fill
+ */
+void w5x00_pico_port_get_default_config(w5x00_pico_port_config_t *config);
+
+/*! \brief Initialize the W5x00 interface and register it with the ioLibrary
+ *
+ *  Sets up the pins, the SPI or PIO and the DMA channels, then registers the chip select,
+ *  SPI or bus, burst, vectored and asynchronous burst callbacks.
+ *  The indirect bus is used when _WIZCHIP_IO_MODE_ is _WIZCHIP_IO_MODE_BUS_INDIR_.
+ *  Asynchronous bursts complete on DMA_IRQ_0, claimed here.
+ *  Set the clk_sys and clk_peri frequencies before, SCK is derived from them.
+ *  The configuration is copied.
+ *
+ *  \param config configuration of the interface
+ *  \return SCK or bus PIO clock achieved in Hz
+ */
+uint32_t w5x00_pico_port_init(const w5x00_pico_port_config_t *config);
+
+/*! \brief Reset the W5x00 with RSTn and wait until it answers
+ *
+ *  RSTn is held low for W5X00_PICO_PORT_RESET_LOW_US, then the version register is read every
+ *  100us until it holds the chip's version, instead of sleeping for the longest start-up.
+ *  Without pin_rst only the wait is done.
+ *
+ *  \return true once the chip answered, false after W5X00_PICO_PORT_RESET_READY_MS
+ */
+bool w5x00_pico_port_reset(void);
+
+/*! \brief Set the callback of w5x00_pico_port_link_poll()
+ *
+ *  \param callback called with the new link state, NULL for none
+ */
+void w5x00_pico_port_link_callback(w5x00_pico_port_link_callback_t callback);
+
+/*! \brief Follow the PHY link, call it from the main loop
+ *
+ *  Reads the link once every W5X00_PICO_PORT_LINK_POLL_MS at most, the calls in between
+ *  return the last state. The first read and every change call the callback, after a
+ *  w5x00_pico_port_gratuitous_arp() when the link came up. Work that needs the link can
+ *  wait for it here instead of sleeping.
+ *
+ *  \return true while the link is up
+ */
+bool w5x00_pico_port_link_poll(void);
+
+/*! \brief Announce the address of SIPR with a gratuitous ARP
+ *
+ *  The W5100S sends a socket-less ARP request for its own address with wizchip_sl_start()
+ *  and returns, peers update their ARP caches without waiting for the first connection.
+ *  The request holds the socket-less commands for W5X00_PICO_PORT_GARP_RTR. The W5500 has
+ *  no socket-less commands.
+ *
+ *  \return 0, or -1 while another socket-less command runs or on the W5500
+ */
+int8_t w5x00_pico_port_gratuitous_arp(void);
+
+/*! \brief Call sockevent_isr() on the falling edges of INTn
+ *
+ *  INTn is pulled up and takes the GPIO IRQ callback of the calling core, and wiz_poll()
+ *  waits for it with wfe. Each edge is also time stamped with wizchip_sl_isr(), for the
+ *  round trips of the socket-less commands. Only with the W5100S, as sockevent_isr().
+ */
+void w5x00_pico_port_int_enable(void);
+
+/*! \brief Coalesce the interrupts of INTn
+ *
+ *  Two stages, both off by default. INTPTMR has the chip hold INTn off for a while after IR is
+ *  cleared, so packets arriving meanwhile raise one interrupt. In software, the first count edges
+ *  of each window are passed to sockevent_isr() at once, which keeps the latency of sparse traffic,
+ *  and a later one waits for the end of the window, which bounds the rate at count per window.
+ *  When window_max_us is larger, a window in which an edge had to wait doubles the next one up to
+ *  window_max_us and a window with no more than count / 2 edges halves it down to window_us, the
+ *  window follows the packet rate. Only with the W5100S, as sockevent_isr().
+ *
+ *  \param coalesce configuration, copied, NULL turns both off
+ */
+void w5x00_pico_port_int_coalesce(const w5x00_pico_port_coalesce_t *coalesce);
+
+/*! \brief Get the INTn counters since w5x00_pico_port_int_enable()
+ *
+ *  \param stats counters to fill
+ */
+void w5x00_pico_port_int_get_stats(w5x00_pico_port_int_stats_t *stats);
+
+#if _WIZCHIP_INSTANCES_ > 1
+/*! \brief Add another W5x00 on the SPI of w5x00_pico_port_init(), with its own chip select
+ *
+ *  The chip is set up with wizchip_instance_init() and shares SCK, MOSI, MISO, the DMA channels
+ *  and the callbacks of the first one, pin_rst resets all of them. Select it with wizchip_use()
+ *  or WIZCHIP_WITH() before ioLibrary calls, then call wizchip_init() and the rest for it as
+ *  for the first. One burst is in flight at a time for all the chips. Not with the indirect
+ *  bus or _WIZCHIP_SPI_INLINE_, whose chip select is fixed.
+ *
+ *  \param chip instance to set up
+ *  \param pin_cs chip select of the chip, active low
+ *  \return 0, or -1 when _WIZCHIP_INSTANCES_ are in use
+ */
+int8_t w5x00_pico_port_add_chip(wizchip_t *chip, uint pin_cs);
+#endif
+
+/*! \brief Find the fastest SCK the wiring holds
+ *
+ *  From the configured baudrate down to W5X00_PICO_PORT_CAL_MIN_HZ, one divider step at a time,
+ *  each SCK is tried with 4, 8 and 12mA on SCK and MOSI and, with the PIO SPI, MISO sampled late
+ *  or early. A try reads the version register and writes and reads back 0x00/0xFF, 0x55/0xAA,
+ *  walking ones and pseudo-random patterns of W5X00_PICO_PORT_CAL_LEN bytes in the TX buffer of
+ *  sn. The first error-free setting is the fastest, the one W5X00_PICO_PORT_CAL_MARGIN
+ *  steps slower must then pass W5X00_PICO_PORT_CAL_ROUNDS rounds and is kept.
+ *
+ *  Call it after w5x00_pico_port_init() and w5x00_pico_port_reset(), before wizchip_init() and
+ *  with sn closed. A wrong address bit may have written elsewhere in the chip, so it is reset
+ *  again at the end when pin_rst is connected. Not with the indirect bus.
+ *
+ *  \param sn socket of the TX buffer
+ *  \param cal setting chosen, may be NULL
+ *  \return SCK in Hz, or 0 when nothing was error-free and the configured baudrate is left
+ */
+uint32_t w5x00_pico_port_calibrate(uint8_t sn, w5x00_pico_port_cal_t *cal);
+
+/*! \brief Run the patterns of w5x00_pico_port_calibrate() once at the current setting
+ *
+ *  The TX buffer of sn is overwritten, call it with sn closed.
+ *
+ *  \param sn socket of the TX buffer
+ *  \return bytes and register reads wrong, also added to w5x00_pico_port_get_errors()
+ */
+uint32_t w5x00_pico_port_selftest(uint8_t sn);
+
+/*! \brief Get the errors of w5x00_pico_port_selftest() and of the checks of the chosen setting since boot
+ */
+uint32_t w5x00_pico_port_get_errors(void);
+
+/*! \brief Find the burst length from which DMA is faster than the CPU FIFO loop
+ *
+ *  Both DMA channels are configured and started for every burst, which costs more than
+ *  the 3 byte header or a short recv takes on the wire. For lengths from 1 to
+ *  W5X00_PICO_PORT_DMA_CAL_MAX, W5X00_PICO_PORT_DMA_CAL_REPEAT writes and reads of the TX
+ *  buffer of sn are timed with interrupts off, once with the data through the FIFO loop
+ *  and once through DMA. The shortest length at which DMA is faster, and also at the next
+ *  length timed, becomes the threshold of the blocking bursts. Asynchronous bursts always
+ *  use DMA. W5X00_PICO_PORT_DMA_CAL_MAX is kept when the loop is never slower.
+ *
+ *  Call it after wizchip_init(), with sn closed. Not with the indirect bus.
+ *
+ *  \param sn socket of the TX buffer
+ *  \return threshold in bytes, or 0 without use_dma
+ */
+uint16_t w5x00_pico_port_dma_calibrate(uint8_t sn);
+
+/*! \brief Get the shortest burst moved by DMA
+ */
+uint16_t w5x00_pico_port_get_dma_min(void);
+
+/*! \brief Set the shortest burst moved by DMA
+ *
+ *  \param len threshold in bytes, 0 moves every burst by DMA
+ */
+void w5x00_pico_port_set_dma_min(uint16_t len);
+
+/*! \brief Load the record saved by w5x00_pico_port_flash_save()
+ *
+ *  \param data buffer of the record
+ *  \param len length of the record, a saved record of another length doesn't load
+ *  \return true if the record was loaded
+ */
+bool w5x00_pico_port_flash_load(void *data, size_t len);
+
+/*! \brief Save a record in the last flash sector, to keep a DHCP lease over a reset for example
+ *
+ *  The sector is erased and programmed with the interrupts disabled, for some 50ms, unless it
+ *  already holds the record. The other core must not run from flash meanwhile.
+ *  The binary must leave the last sector free.
+ *
+ *  \param data record to save
+ *  \param len length of the record, up to W5X00_PICO_PORT_FLASH_MAX
+ *  \return false if the record is too long
+ */
+bool w5x00_pico_port_flash_save(const void *data, size_t len);
+
+#endif /* _W5X00_PICO_PORT_H_ */
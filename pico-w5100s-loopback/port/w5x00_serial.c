@@ -0,0 +1,405 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/uart.h"
+
+#include "wizchip_conf.h"
+#include "socket.h"
+
+#include "w5x00_serial.h"
+
+#include "timebase.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+#if (W5X00_SERIAL_RING_SIZE & (W5X00_SERIAL_RING_SIZE - 1)) != 0
+#error "W5X00_SERIAL_RING_SIZE must be a power of 2"
+#endif
+
+#if (W5X00_SERIAL_RING_SIZE < 256) || (W5X00_SERIAL_RING_SIZE > 32768)
+#error "W5X00_SERIAL_RING_SIZE must be from 256 to 32768, the DMA ring sizes"
+#endif
+
+#if W5X00_SERIAL_PORTS > NUM_UARTS
+#error "W5X00_SERIAL_PORTS is larger than the UARTs of the RP2040"
+#endif
+
+#define W5X00_SERIAL_RING_MASK (W5X00_SERIAL_RING_SIZE - 1u)
+
+/* What the UART has sent is committed in parts of this, each commit is a RECV that opens the window */
+#define W5X00_SERIAL_COMMIT_LEN (W5X00_SERIAL_RING_SIZE / 4u)
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* A DMA channel on a ring, its position is the ring index it reads or writes next */
+typedef struct
+{
+    int ch;
+    uint32_t start; // position it was started at
+    uint32_t count; // its transfer count then
+} w5x00_serial_dma_t;
+
+/* A pair. Positions are free-running, the ring index is position & W5X00_SERIAL_RING_MASK */
+typedef struct
+{
+    w5x00_serial_config_t config;
+    uint32_t idle_us;      // idle_chars at the actual baudrate
+    bool used;
+
+    // UART to TCP: the DMA writes from rx_tail + RING_SIZE back to rx_head
+    w5x00_serial_dma_t rx_dma;
+    uint32_t rx_head;      // written by the DMA
+    uint32_t rx_tail;      // given to the socket
+    uint32_t rx_change_us; // rx_head last moved
+    uint32_t rx_first_us;  // the byte at rx_tail came
+
+    // TCP to UART: peeked up to tx_head, sent by the DMA up to tx_tail, committed up to tx_commit
+    w5x00_serial_dma_t tx_dma;
+    uint32_t tx_head;
+    uint32_t tx_tail;
+    uint32_t tx_commit;
+
+    w5x00_serial_stats_t stats;
+} w5x00_serial_pair_t;
+
+static w5x00_serial_pair_t g_serial[W5X00_SERIAL_PORTS];
+
+/* The DMA wraps on the low bits of the address, the rings are aligned to their size */
+static uint8_t g_serial_rx_ring[W5X00_SERIAL_PORTS][W5X00_SERIAL_RING_SIZE] __attribute__((aligned(W5X00_SERIAL_RING_SIZE)));
+static uint8_t g_serial_tx_ring[W5X00_SERIAL_PORTS][W5X00_SERIAL_RING_SIZE] __attribute__((aligned(W5X00_SERIAL_RING_SIZE)));
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+static inline uint32_t w5x00_serial_min(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+/* The count goes down as the channel issues its transfers, a byte counted is in RAM or in
+   the UART long before the socket or the next restart gets to it */
+static inline uint32_t w5x00_serial_dma_pos(const w5x00_serial_dma_t *d)
+{
+    return d->start + d->count - dma_channel_hw_addr(d->ch)->transfer_count;
+}
+
+/* Keeps the channel going up to position limit. An idle channel is started on what there is,
+   a busy one is left alone while it has half of that left, else it is aborted and started
+   again on all of it, so that the UART FIFO only covers the time between two polls.
+   Returns its position */
+static uint32_t w5x00_serial_dma_run(w5x00_serial_dma_t *d, uint8_t *ring, bool write, uint32_t limit)
+{
+    uint32_t pos;
+
+    if (dma_channel_is_busy(d->ch))
+    {
+        pos = w5x00_serial_dma_pos(d);
+
+        if (limit - pos <= 2 * (d->start + d->count - pos))
+            return pos;
+
+        // a transfer in flight completes first, the count is exact after
+        dma_channel_abort(d->ch);
+    }
+
+    pos = w5x00_serial_dma_pos(d);
+
+    if (pos == limit)
+        return pos;
+
+    d->start = pos;
+    d->count = limit - pos;
+
+    if (write)
+        dma_channel_set_write_addr(d->ch, &ring[pos & W5X00_SERIAL_RING_MASK], false);
+    else
+        dma_channel_set_read_addr(d->ch, &ring[pos & W5X00_SERIAL_RING_MASK], false);
+
+    dma_channel_set_trans_count(d->ch, d->count, true);
+
+    return pos;
+}
+
+/* UART to TCP: what the DMA wrote since the last poll, and the overruns while the ring was full */
+static void w5x00_serial_rx_update(w5x00_serial_pair_t *p, uint32_t now)
+{
+    uart_hw_t *hw = uart_get_hw(p->config.uart);
+    uint32_t head = w5x00_serial_dma_run(&p->rx_dma, g_serial_rx_ring[p - g_serial], true, p->rx_tail + W5X00_SERIAL_RING_SIZE);
+
+    if (head != p->rx_head)
+    {
+        if (p->rx_head == p->rx_tail)
+            p->rx_first_us = now;
+
+        p->stats.uart_rx += head - p->rx_head;
+        p->rx_head = head;
+        p->rx_change_us = now;
+    }
+
+    if (hw->rsr & UART_UARTRSR_OE_BITS)
+    {
+        hw->rsr = 0;
+        p->stats.overruns++;
+    }
+}
+
+/* UART to TCP: the RX ring to the socket's TX buffer, when one of the triggers is met */
+static void w5x00_serial_rx_flush(w5x00_serial_pair_t *p, uint32_t now)
+{
+    uint8_t *ring = g_serial_rx_ring[p - g_serial];
+    uint32_t count = p->rx_head - p->rx_tail;
+    uint32_t *flushes;
+    uint32_t tail, off;
+    int32_t n;
+
+    if (count == 0)
+        return;
+
+    if (!p->stats.connected)
+    {
+        p->stats.dropped += count;
+        p->rx_tail = p->rx_head;
+
+        return;
+    }
+
+    if (count >= p->config.flush_len)
+        flushes = &p->stats.flush_size;
+    else if ((p->idle_us != 0) && (now - p->rx_change_us >= p->idle_us))
+        flushes = &p->stats.flush_idle;
+    else if ((p->config.deadline_us != 0) && (now - p->rx_first_us >= p->config.deadline_us))
+        flushes = &p->stats.flush_deadline;
+    else
+        return;
+
+    // straight from the ring, in two parts when it wraps. SOCK_BUSY or less than asked while the
+    // TX buffer is full, the rest goes as soon as it has room, the trigger stays met
+    tail = p->rx_tail;
+
+    while (count != 0)
+    {
+        off = p->rx_tail & W5X00_SERIAL_RING_MASK;
+        n = send(p->config.sn, &ring[off], (uint16_t)w5x00_serial_min(count, W5X00_SERIAL_RING_SIZE - off));
+
+        if (n <= 0)
+            break;
+
+        p->rx_tail += n;
+        p->stats.tcp_tx += n;
+        count -= n;
+    }
+
+    if (p->rx_tail != tail)
+        (*flushes)++;
+}
+
+/* TCP to UART: commits what the UART has sent, peeks what fits into the TX ring after it and
+   keeps the DMA on that */
+static void w5x00_serial_tx_move(w5x00_serial_pair_t *p)
+{
+    uint8_t *ring = g_serial_tx_ring[p - g_serial];
+    uint8_t sn = p->config.sn;
+    uint32_t space, off;
+    int32_t n;
+
+    p->tx_tail = w5x00_serial_dma_pos(&p->tx_dma);
+
+    // a RECV per W5X00_SERIAL_COMMIT_LEN, or once the UART has sent everything. Negative after a
+    // new connection while the UART still sends the old one's data
+    n = (int32_t)(p->tx_tail - p->tx_commit);
+
+    if ((n >= (int32_t)W5X00_SERIAL_COMMIT_LEN) || ((n > 0) && (p->tx_tail == p->tx_head)))
+    {
+        if (recv_commit(sn, (uint16_t)n) > 0)
+            p->tx_commit = p->tx_tail;
+    }
+
+    // what is peeked stays in the chip's RX buffer, the ring is never ahead of it by more than that
+    space = W5X00_SERIAL_RING_SIZE - (p->tx_head - p->tx_tail);
+
+    while (space != 0)
+    {
+        off = p->tx_head & W5X00_SERIAL_RING_MASK;
+        n = recv_peek(sn, &ring[off], (uint16_t)w5x00_serial_min(space, W5X00_SERIAL_RING_SIZE - off),
+                      (uint16_t)(p->tx_head - p->tx_commit));
+
+        if (n <= 0)
+            break;
+
+        p->tx_head += n;
+        p->stats.tcp_rx += n;
+        space -= n;
+    }
+
+    p->tx_tail = w5x00_serial_dma_run(&p->tx_dma, ring, false, p->tx_head);
+}
+
+/* One poll of a pair, the socket as loopback_tcps() runs it */
+static void w5x00_serial_service(w5x00_serial_pair_t *p, uint32_t now)
+{
+    uint8_t sn = p->config.sn;
+#if _WIZCHIP_ == W5100S
+    uint8_t mode = SOCK_SEND_STREAM;
+#endif
+
+    w5x00_serial_rx_update(p, now);
+
+    switch (getSn_SR(sn))
+    {
+    case SOCK_ESTABLISHED:
+        if (!p->stats.connected)
+        {
+            // what the UART received before is dropped, the peeks of the new connection start at its first byte
+            w5x00_serial_rx_flush(p, now);
+            p->tx_commit = p->tx_head;
+            p->stats.connected = true;
+            p->stats.connections++;
+        }
+
+        w5x00_serial_rx_flush(p, now);
+#if _WIZCHIP_ == W5100S
+        // the data queued behind a SEND goes once the chip reports it done
+        send(sn, g_serial_rx_ring[p - g_serial], 0);
+#endif
+        w5x00_serial_tx_move(p);
+        break;
+
+    case SOCK_CLOSE_WAIT:
+        // the UART gets everything the peer sent, then the connection is closed
+        w5x00_serial_rx_flush(p, now);
+        w5x00_serial_tx_move(p);
+
+        if (getSn_RX_RSR(sn) != 0)
+            break;
+
+#if _WIZCHIP_ == W5100S
+        if (send(sn, g_serial_rx_ring[p - g_serial], 0) != SOCK_OK)
+            break;
+#endif
+
+        disconnect(sn);
+        p->stats.connected = false;
+        break;
+
+    case SOCK_CLOSED:
+        // reset or timed out as well
+        p->stats.connected = false;
+
+        if (socket(sn, Sn_MR_TCP, p->config.port, SF_IO_NONBLOCK | SF_TCP_NODELAY) != sn)
+            break;
+
+#if _WIZCHIP_ == W5100S
+        ctlsocket(sn, CS_SET_SENDMODE, &mode);
+#endif
+        listen(sn);
+        break;
+
+    case SOCK_INIT:
+        listen(sn);
+        break;
+
+    default:
+        // LISTEN, SYNRECV, FIN_WAIT and the others, the chip moves on by itself
+        break;
+    }
+
+    // without a connection the UART's data goes nowhere
+    if (!p->stats.connected)
+        w5x00_serial_rx_flush(p, now);
+}
+
+void w5x00_serial_get_default_config(uint8_t idx, w5x00_serial_config_t *config)
+{
+    config->uart = (idx == 0) ? uart0 : uart1;
+    config->pin_tx = (idx == 0) ? 0 : 4;
+    config->pin_rx = (idx == 0) ? 1 : 5;
+    config->baudrate = 115200;
+    config->sn = idx;
+    config->port = 5020 + idx;
+    config->flush_len = W5X00_SERIAL_FLUSH_LEN;
+    config->idle_chars = W5X00_SERIAL_IDLE_CHARS;
+    config->deadline_us = W5X00_SERIAL_DEADLINE_US;
+}
+
+uint32_t w5x00_serial_init(uint8_t idx, const w5x00_serial_config_t *config)
+{
+    w5x00_serial_pair_t *p = &g_serial[idx];
+    io_rw_32 *dr = &uart_get_hw(config->uart)->dr;
+    dma_channel_config c;
+    uint32_t baudrate;
+
+    memset(p, 0, sizeof(*p));
+    p->config = *config;
+
+    // uart_init() enables both DREQs
+    baudrate = uart_init(config->uart, config->baudrate);
+
+    gpio_set_function(config->pin_tx, GPIO_FUNC_UART);
+    gpio_set_function(config->pin_rx, GPIO_FUNC_UART);
+
+    // a character is 10 bits, rounded up
+    p->idle_us = (uint32_t)(((uint64_t)config->idle_chars * 10u * 1000000u + baudrate - 1) / baudrate);
+
+    // the UART's data register into the RX ring, wrapping on it
+    p->rx_dma.ch = dma_claim_unused_channel(true);
+    c = dma_channel_get_default_config(p->rx_dma.ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, __builtin_ctz(W5X00_SERIAL_RING_SIZE));
+    channel_config_set_dreq(&c, uart_get_dreq(config->uart, false));
+    dma_channel_configure(p->rx_dma.ch, &c, g_serial_rx_ring[idx], dr, 0, false);
+
+    // the TX ring into the data register
+    p->tx_dma.ch = dma_claim_unused_channel(true);
+    c = dma_channel_get_default_config(p->tx_dma.ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, __builtin_ctz(W5X00_SERIAL_RING_SIZE));
+    channel_config_set_dreq(&c, uart_get_dreq(config->uart, true));
+    dma_channel_configure(p->tx_dma.ch, &c, dr, g_serial_tx_ring[idx], 0, false);
+
+    p->used = true;
+
+    // the RX DMA runs from here on
+    w5x00_serial_rx_update(p, timebase_us());
+
+    return baudrate;
+}
+
+void w5x00_serial_poll(void)
+{
+    uint32_t now = timebase_us();
+
+    for (uint8_t i = 0; i < W5X00_SERIAL_PORTS; i++)
+    {
+        if (g_serial[i].used)
+            w5x00_serial_service(&g_serial[i], now);
+    }
+}
+
+void w5x00_serial_get_stats(uint8_t idx, w5x00_serial_stats_t *stats)
+{
+    *stats = g_serial[idx].stats;
+}
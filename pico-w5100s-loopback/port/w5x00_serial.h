@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _W5X00_SERIAL_H_
+#define _W5X00_SERIAL_H_
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/uart.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* UART and socket pairs, one per UART of the RP2040 */
+#ifndef W5X00_SERIAL_PORTS
+#define W5X00_SERIAL_PORTS 2
+#endif
+
+/* Bytes of each ring, one per direction and pair, a power of 2 as the DMA wraps on it.
+   The RX ring holds what comes from the UART while the socket's TX buffer is full */
+#ifndef W5X00_SERIAL_RING_SIZE
+#define W5X00_SERIAL_RING_SIZE 4096u
+#endif
+
+/* Defaults of w5x00_serial_get_default_config(): a full segment, about 4 characters of a
+   quiet line, and no byte held longer than 2ms */
+#ifndef W5X00_SERIAL_FLUSH_LEN
+#define W5X00_SERIAL_FLUSH_LEN 1460u
+#endif
+
+#ifndef W5X00_SERIAL_IDLE_CHARS
+#define W5X00_SERIAL_IDLE_CHARS 4u
+#endif
+
+#ifndef W5X00_SERIAL_DEADLINE_US
+#define W5X00_SERIAL_DEADLINE_US 2000u
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* A UART and the TCP server socket it is bridged to */
+typedef struct w5x00_serial_config_t
+{
+    uart_inst_t *uart;
+    uint pin_tx;
+    uint pin_rx;
+    uint32_t baudrate;
+    uint8_t sn;           // socket, a TCP server on port with one connection at a time
+    uint16_t port;
+    uint16_t flush_len;   // UART bytes that go to the socket at once
+    uint16_t idle_chars;  // character times of a quiet line after which they go, 0 never
+    uint32_t deadline_us; // longest a byte waits for either, 0 never
+} w5x00_serial_config_t;
+
+/* Counters of w5x00_serial_get_stats(), bytes unless named otherwise */
+typedef struct w5x00_serial_stats_t
+{
+    uint32_t uart_rx;        // received by the UART
+    uint32_t tcp_tx;         // of them, given to the socket
+    uint32_t dropped;        // of them, received without a connection
+    uint32_t flush_size;     // flushes of flush_len bytes
+    uint32_t flush_idle;     // flushes after a quiet line
+    uint32_t flush_deadline; // flushes at deadline_us
+    uint32_t tcp_rx;         // received by the socket, for the UART
+    uint32_t overruns;       // UART FIFO overruns seen, characters were lost while the RX ring was full
+    uint32_t connections;
+    bool connected;
+} w5x00_serial_stats_t;
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+/*! \brief Get the default configuration of pair idx
+ *
+ *  uart0 on GP0 and GP1 with socket 0 on port 5020, uart1 on GP4 and GP5 with socket 1 on
+ *  port 5021, both at 115200 baud.
+ *
+ *  \param idx pair, below W5X00_SERIAL_PORTS
+ *  \param config configuration to fill
+ */
+void w5x00_serial_get_default_config(uint8_t idx, w5x00_serial_config_t *config);
+
+/*! \brief Bridge a UART to a TCP server socket
+ *
+ *  Sets up the UART and two DMA channels paced by it. One writes what the UART receives
+ *  into the RX ring, the other reads the TX ring into the UART. Call it after the chip is
+ *  set up with ctlnetwork(), the socket is opened by w5x00_serial_poll().
+ *
+ *  \param idx pair, below W5X00_SERIAL_PORTS
+ *  \param config configuration
+ *  \return actual baudrate
+ */
+uint32_t w5x00_serial_init(uint8_t idx, const w5x00_serial_config_t *config);
+
+/*! \brief Move the data of all the pairs, from the main loop
+ *
+ *  The RX ring goes to the socket's TX buffer once it holds flush_len bytes, after
+ *  idle_chars of a quiet line or when its first byte is deadline_us old, each as soon as
+ *  the poll after sees it. The received data is peeked from the socket into the TX ring
+ *  and committed once the UART has sent it, so the TCP window is what the UART drains.
+ *  The DMA channels are restarted when the rings have room.
+ */
+void w5x00_serial_poll(void);
+
+/*! \brief Get the counters of pair idx
+ *
+ *  \param idx pair
+ *  \param stats counters to fill
+ */
+void w5x00_serial_get_stats(uint8_t idx, w5x00_serial_stats_t *stats);
+
+#endif /* _W5X00_SERIAL_H_ */
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _W5X00_SPI_PORT_H_
+#define _W5X00_SPI_PORT_H_
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdint.h>
+
+#include "hardware/gpio.h"
+#include "hardware/spi.h"
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* SPI, the same as spi and pin_cs of the w5x00_pico_port_init() configuration */
+#ifndef WIZCHIP_PORT_SPI
+#define WIZCHIP_PORT_SPI spi0
+#endif
+
+#ifndef WIZCHIP_PORT_PIN_CS
+#define WIZCHIP_PORT_PIN_CS 17
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* SPI primitives of W5100S/w5100s_inline.h, the PL022 FIFOs are polled directly */
+static inline void wizchip_port_select(void)
+{
+    gpio_put(WIZCHIP_PORT_PIN_CS, 0);
+}
+
+static inline void wizchip_port_deselect(void)
+{
+    gpio_put(WIZCHIP_PORT_PIN_CS, 1);
+}
+
+static inline void wizchip_port_write(const uint8_t *pBuf, uint16_t len)
+{
+    spi_hw_t *hw = spi_get_hw(WIZCHIP_PORT_SPI);
+    uint16_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        while (!spi_is_writable(WIZCHIP_PORT_SPI))
+            tight_loop_contents();
+
+        hw->dr = (uint32_t)pBuf[i];
+    }
+
+    // the last byte is out before CS goes high, and nothing is left in the RX FIFO
+    while (spi_is_busy(WIZCHIP_PORT_SPI))
+        tight_loop_contents();
+
+    while (spi_is_readable(WIZCHIP_PORT_SPI))
+        (void)hw->dr;
+
+    hw->icr = SPI_SSPICR_RORIC_BITS;
+}
+
+static inline void wizchip_port_read(uint8_t *pBuf, uint16_t len)
+{
+    spi_hw_t *hw = spi_get_hw(WIZCHIP_PORT_SPI);
+    uint16_t tx = len;
+    uint16_t rx = len;
+
+    // keep at most a FIFO depth of bytes in flight, the RX FIFO holds 8
+    while (tx || rx)
+    {
+        if (tx && spi_is_writable(WIZCHIP_PORT_SPI) && (rx < tx + 8))
+        {
+            hw->dr = 0xFF;
+            tx--;
+        }
+
+        if (rx && spi_is_readable(WIZCHIP_PORT_SPI))
+        {
+            *pBuf++ = (uint8_t)hw->dr;
+            rx--;
+        }
+    }
+}
+
+#endif /* _W5X00_SPI_PORT_H_ */
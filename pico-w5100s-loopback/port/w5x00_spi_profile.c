@@ -0,0 +1,285 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+
+#include "wizchip_conf.h"
+
+#include "w5x00_spi_profile.h"
+
+#if W5X00_SPI_PROFILE
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Longest register access, the W5100S and W5500 frames are 3 header bytes and a data byte */
+#define PROFILE_REG_BYTES 4
+
+/* SysTick CSR: enabled, clocked from clk_sys */
+#define PROFILE_SYSTICK_CSR 0x5
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+static const char *const g_profile_op_names[W5X00_SPI_PROFILE_OPS] = {"other", "send", "recv", "sendto", "recvfrom"};
+
+static w5x00_spi_profile_counters_t g_profile[W5X00_SPI_PROFILE_OPS];
+static w5x00_spi_profile_op_t g_profile_op = W5X00_SPI_PROFILE_OTHER;
+static bool g_profile_installed;
+
+/* transaction in flight, an asynchronous burst ends in the DMA interrupt */
+static w5x00_spi_profile_op_t g_profile_tr_op;
+static uint32_t g_profile_tr_start;
+static uint32_t g_profile_tr_bytes;
+static bool g_profile_tr_reg;
+
+/* callbacks registered by w5x00_pico_port_init() */
+static void (*g_select)(void);
+static void (*g_deselect)(void);
+static uint8_t (*g_read_byte)(void);
+static void (*g_write_byte)(uint8_t wb);
+static void (*g_read_burst)(uint8_t *pBuf, uint16_t len);
+static void (*g_write_burst)(uint8_t *pBuf, uint16_t len);
+static void (*g_read_burst_vec)(wiz_iovec *wr, wiz_iovec *rd);
+static void (*g_write_burst_vec)(wiz_iovec *iov, uint8_t iovcnt);
+static uint8_t (*g_xfer_reg)(uint8_t *frame);
+static void (*g_read_burst_async)(uint8_t *pBuf, uint16_t len);
+static void (*g_write_burst_async)(uint8_t *pBuf, uint16_t len);
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Wrappers */
+static void profile_select(void)
+{
+    g_select();
+
+    g_profile_tr_op = g_profile_op;
+    g_profile_tr_bytes = 0;
+    g_profile_tr_reg = false;
+    g_profile_tr_start = systick_hw->cvr;
+}
+
+static void profile_deselect(void)
+{
+    uint32_t end = systick_hw->cvr;
+    w5x00_spi_profile_counters_t *counters = &g_profile[g_profile_tr_op];
+    uint32_t cycles;
+
+    g_deselect();
+
+    // SysTick counts down from RVR, a transaction is shorter than a wrap
+    if (g_profile_tr_start >= end)
+        cycles = g_profile_tr_start - end;
+    else
+        cycles = g_profile_tr_start + systick_hw->rvr + 1 - end;
+
+    if (g_profile_tr_reg || g_profile_tr_bytes <= PROFILE_REG_BYTES)
+    {
+        counters->reg_transactions++;
+        counters->reg_bytes += g_profile_tr_bytes;
+        counters->reg_cycles += cycles;
+    }
+    else
+    {
+        counters->buf_transactions++;
+        counters->buf_bytes += g_profile_tr_bytes;
+        counters->buf_cycles += cycles;
+    }
+}
+
+static uint8_t profile_read_byte(void)
+{
+    g_profile_tr_bytes++;
+
+    return g_read_byte();
+}
+
+static void profile_write_byte(uint8_t wb)
+{
+    g_profile_tr_bytes++;
+    g_write_byte(wb);
+}
+
+static void profile_read_burst(uint8_t *pBuf, uint16_t len)
+{
+    g_profile_tr_bytes += len;
+    g_read_burst(pBuf, len);
+}
+
+static void profile_write_burst(uint8_t *pBuf, uint16_t len)
+{
+    g_profile_tr_bytes += len;
+    g_write_burst(pBuf, len);
+}
+
+static void profile_read_burst_vec(wiz_iovec *wr, wiz_iovec *rd)
+{
+    g_profile_tr_bytes += wr->len + rd->len;
+    g_read_burst_vec(wr, rd);
+}
+
+static void profile_write_burst_vec(wiz_iovec *iov, uint8_t iovcnt)
+{
+    uint8_t i;
+
+    for (i = 0; i < iovcnt; i++)
+        g_profile_tr_bytes += iov[i].len;
+
+    g_write_burst_vec(iov, iovcnt);
+}
+
+static uint8_t profile_xfer_reg(uint8_t *frame)
+{
+    g_profile_tr_bytes += PROFILE_REG_BYTES;
+    g_profile_tr_reg = true;
+
+    return g_xfer_reg(frame);
+}
+
+static void profile_read_burst_async(uint8_t *pBuf, uint16_t len)
+{
+    g_profile_tr_bytes += len;
+    g_read_burst_async(pBuf, len);
+}
+
+static void profile_write_burst_async(uint8_t *pBuf, uint16_t len)
+{
+    g_profile_tr_bytes += len;
+    g_write_burst_async(pBuf, len);
+}
+
+/* Profile */
+void w5x00_spi_profile_install(void)
+{
+    if (g_profile_installed || !(WIZCHIP.if_mode & _WIZCHIP_IO_MODE_SPI_))
+        return;
+
+    g_profile_installed = true;
+
+    // a running SysTick, a FreeRTOS tick for example, is read as it is
+    if (!(systick_hw->csr & 0x1))
+    {
+        systick_hw->rvr = 0x00FFFFFF;
+        systick_hw->cvr = 0;
+        systick_hw->csr = PROFILE_SYSTICK_CSR;
+    }
+
+    g_select = WIZCHIP.CS._select;
+    g_deselect = WIZCHIP.CS._deselect;
+    g_read_byte = WIZCHIP.IF.SPI._read_byte;
+    g_write_byte = WIZCHIP.IF.SPI._write_byte;
+    g_read_burst = WIZCHIP.IF.SPI._read_burst;
+    g_write_burst = WIZCHIP.IF.SPI._write_burst;
+    g_read_burst_vec = WIZCHIP.IF.SPI._read_burst_vec;
+    g_write_burst_vec = WIZCHIP.IF.SPI._write_burst_vec;
+    g_xfer_reg = WIZCHIP.IF.SPI._xfer_reg;
+    g_read_burst_async = WIZCHIP.IF.SPI._read_burst_async;
+    g_write_burst_async = WIZCHIP.IF.SPI._write_burst_async;
+
+    reg_wizchip_cs_cbfunc(profile_select, profile_deselect);
+    reg_wizchip_spi_cbfunc(profile_read_byte, profile_write_byte);
+    reg_wizchip_spiburst_cbfunc(profile_read_burst, profile_write_burst);
+
+    // the ioLibrary picks its path from the optional callbacks, they stay unset if they were
+    if (g_read_burst_vec && g_write_burst_vec)
+        reg_wizchip_spiburst_vec_cbfunc(profile_read_burst_vec, profile_write_burst_vec);
+
+    if (g_xfer_reg)
+        reg_wizchip_spireg_cbfunc(profile_xfer_reg);
+
+    if (g_read_burst_async && g_write_burst_async)
+        reg_wizchip_spiburst_async_cbfunc(profile_read_burst_async, profile_write_burst_async);
+
+    w5x00_spi_profile_reset();
+}
+
+void w5x00_spi_profile_reset(void)
+{
+    memset(g_profile, 0, sizeof(g_profile));
+}
+
+w5x00_spi_profile_op_t w5x00_spi_profile_begin(w5x00_spi_profile_op_t op)
+{
+    w5x00_spi_profile_op_t prev = g_profile_op;
+
+    g_profile[op].calls++;
+    g_profile_op = op;
+
+    return prev;
+}
+
+void w5x00_spi_profile_end(w5x00_spi_profile_op_t prev)
+{
+    g_profile_op = prev;
+}
+
+void w5x00_spi_profile_get(w5x00_spi_profile_op_t op, w5x00_spi_profile_counters_t *counters)
+{
+    *counters = g_profile[op];
+}
+
+/* tenths of value / div */
+static uint32_t profile_tenths(uint64_t value, uint32_t div)
+{
+    return div ? (uint32_t)((value * 10 + div / 2) / div) : 0;
+}
+
+void w5x00_spi_profile_print(void)
+{
+    uint32_t cycles_per_us = clock_get_hz(clk_sys) / 1000000;
+    int op;
+
+    for (op = 0; op < W5X00_SPI_PROFILE_OPS; op++)
+    {
+        const w5x00_spi_profile_counters_t *c = &g_profile[op];
+        uint32_t reg_us = (uint32_t)(c->reg_cycles / cycles_per_us);
+        uint32_t buf_us = (uint32_t)(c->buf_cycles / cycles_per_us);
+        uint32_t reg_tr, buf_tr, bytes, us;
+
+        if (c->calls == 0 && c->reg_transactions == 0 && c->buf_transactions == 0)
+            continue;
+
+        printf(" spi %-8s %lu calls, reg %lu tr %lu B %lu us, buf %lu tr %lu B %lu us",
+               g_profile_op_names[op], (unsigned long)c->calls,
+               (unsigned long)c->reg_transactions, (unsigned long)c->reg_bytes, (unsigned long)reg_us,
+               (unsigned long)c->buf_transactions, (unsigned long)c->buf_bytes, (unsigned long)buf_us);
+
+        if (c->calls)
+        {
+            // per call, with a decimal
+            reg_tr = profile_tenths(c->reg_transactions, c->calls);
+            buf_tr = profile_tenths(c->buf_transactions, c->calls);
+            bytes = profile_tenths(c->buf_bytes, c->calls);
+            us = profile_tenths((c->reg_cycles + c->buf_cycles) / cycles_per_us, c->calls);
+
+            printf(", per call reg %lu.%lu tr, buf %lu.%lu tr %lu.%lu B, CS low %lu.%lu us",
+                   (unsigned long)(reg_tr / 10), (unsigned long)(reg_tr % 10),
+                   (unsigned long)(buf_tr / 10), (unsigned long)(buf_tr % 10),
+                   (unsigned long)(bytes / 10), (unsigned long)(bytes % 10),
+                   (unsigned long)(us / 10), (unsigned long)(us % 10));
+        }
+
+        printf("\n");
+    }
+}
+#endif
@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2021 WIZnet Co.,Ltd
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _W5X00_SPI_PROFILE_H_
+#define _W5X00_SPI_PROFILE_H_
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Includes
+  * ----------------------------------------------------------------------------------------------------
+  */
+#include <stdint.h>
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Macros
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Count the SPI transactions of the ioLibrary, configured with -DWIZCHIP_SPI_PROFILE=ON */
+#ifndef W5X00_SPI_PROFILE
+#define W5X00_SPI_PROFILE 0
+#endif
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Variables
+  * ----------------------------------------------------------------------------------------------------
+  */
+/* Socket operation the transactions are counted for */
+typedef enum w5x00_spi_profile_op_t
+{
+    W5X00_SPI_PROFILE_OTHER,    // outside of W5X00_SPI_PROFILE_CALL(), status polls for example
+    W5X00_SPI_PROFILE_SEND,
+    W5X00_SPI_PROFILE_RECV,
+    W5X00_SPI_PROFILE_SENDTO,
+    W5X00_SPI_PROFILE_RECVFROM,
+    W5X00_SPI_PROFILE_OPS
+} w5x00_spi_profile_op_t;
+
+/* Counters of one operation, a transaction is one CS-low window */
+typedef struct w5x00_spi_profile_counters_t
+{
+    uint32_t calls;            // W5X00_SPI_PROFILE_CALL() of the operation
+    uint32_t reg_transactions; // register accesses, transactions of up to 4 bytes
+    uint32_t reg_bytes;        // opcode, address and data bytes
+    uint64_t reg_cycles;       // clk_sys cycles with CS low
+    uint32_t buf_transactions; // buffer transfers, everything longer
+    uint32_t buf_bytes;
+    uint64_t buf_cycles;
+} w5x00_spi_profile_counters_t;
+
+/**
+  * ----------------------------------------------------------------------------------------------------
+  * Functions
+  * ----------------------------------------------------------------------------------------------------
+  */
+#if W5X00_SPI_PROFILE
+/*! \brief Wrap the chip select, SPI, burst, vectored, register and asynchronous burst callbacks
+ *
+ *  Call it after w5x00_pico_port_init(), the callbacks it registered are called by the wrappers.
+ *  CS-low time is measured with SysTick, which is started from clk_sys unless it already runs.
+ *  The wrappers add some cycles to each transaction, the byte callbacks the most.
+ *  The indirect bus and the inlined WIZCHIP_READ()/WIZCHIP_WRITE() of _WIZCHIP_SPI_INLINE_
+ *  don't go through the SPI callbacks and aren't seen.
+ */
+void w5x00_spi_profile_install(void);
+
+/*! \brief Clear the counters of all the operations
+ */
+void w5x00_spi_profile_reset(void);
+
+/*! \brief Count the following transactions for an operation
+ *
+ *  Used by W5X00_SPI_PROFILE_CALL(), from one core.
+ *
+ *  \param op operation
+ *  \return operation counted before, for w5x00_spi_profile_end()
+ */
+w5x00_spi_profile_op_t w5x00_spi_profile_begin(w5x00_spi_profile_op_t op);
+
+/*! \brief Go back to the operation counted before w5x00_spi_profile_begin()
+ *
+ *  \param prev return value of w5x00_spi_profile_begin()
+ */
+void w5x00_spi_profile_end(w5x00_spi_profile_op_t prev);
+
+/*! \brief Get the counters of an operation
+ *
+ *  \param op operation
+ *  \param counters counters to fill
+ */
+void w5x00_spi_profile_get(w5x00_spi_profile_op_t op, w5x00_spi_profile_counters_t *counters);
+
+/*! \brief Print the transactions, bytes and CS-low time of each operation, in total and per call
+ */
+void w5x00_spi_profile_print(void);
+
+/* Evaluate a socket call with its transactions counted for op, e.g.
+   ret = W5X00_SPI_PROFILE_CALL(W5X00_SPI_PROFILE_SEND, send(sn, buf, len)); */
+#define W5X00_SPI_PROFILE_CALL(op, call)                                                \
+    ({                                                                                  \
+        w5x00_spi_profile_op_t _w5x00_spi_profile_prev = w5x00_spi_profile_begin(op);   \
+        __typeof__(call) _w5x00_spi_profile_ret = (call);                               \
+        w5x00_spi_profile_end(_w5x00_spi_profile_prev);                                 \
+        _w5x00_spi_profile_ret;                                                         \
+    })
+#else
+#define W5X00_SPI_PROFILE_CALL(op, call) (call)
+#endif
+
+#endif /* _W5X00_SPI_PROFILE_H_ */
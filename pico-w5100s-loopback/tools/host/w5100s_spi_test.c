@@ -0,0 +1,913 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "socket.h"
+#include "wizchip_conf.h"
+
+// runs the W5100S ioLibrary (w5100s.c, wizchip_conf.c and socket.c) against a byte level
+// model of the chip: the SPI frames (0xF0 write / 0x0F read, address high, address low, then
+// data with the address incremented), its 32 KB of registers and buffers, and the socket
+// commands, pointers and sizes the socket APIs use. The callbacks play the platform and check
+// that every byte is clocked with the chip selected, that selects and deselects pair up, that
+// no frame ends in its header and that critical sections don't nest.
+//
+// - register and buffer accesses with the byte, burst, vectored, register frame and wrap
+//   callbacks registered in turn: round trip, CS windows and critical sections per access
+// - WIZCHIP_WRITE_BUF_ASYNC()/WIZCHIP_READ_BUF_ASYNC() without async callbacks, then with
+//   completion delivered from the critical section exit like an interrupt left pending: the
+//   data, the access waiting for a burst in flight and a burst chained from a completion
+// - wiz_socket_snapshot() against the register getters, the SPI cost of an idle poll either
+//   way, and data arriving between the two bytes of Sn_RX_RSR
+// - send() in SOCK_SEND_STREAM mode with SENDOK delayed: data queued behind a SEND in
+//   progress, the mode switch refused while data is queued, and disconnect() handing it
+//   all to the chip before the FIN
+// - setTMSR()/setRMSR() moving the socket buffers under the data path
+// The exit status is 1 on the first failure
+//
+// usage: w5100s_spi_test [random rounds, default 1000]
+
+#define CHIP_MEM_SIZE 0x8000
+#define CHIP_SOCKETS 4
+#define CHIP_TXBUF 0x4000
+#define CHIP_RXBUF 0x6000
+
+// critical section exits until an asynchronous burst completes
+#define ASYNC_IRQ_EXITS 2
+
+#define SN_REG(sn, offset) (0x0400 + 0x0100 * (sn) + (offset))
+
+struct chip {
+    uint8_t mem[CHIP_MEM_SIZE];
+    uint8_t selected;
+    uint8_t critical;
+    uint32_t frame_pos;
+    uint8_t frame_op;
+    uint16_t frame_addr;
+
+    // what the accesses cost
+    uint32_t windows;
+    uint32_t bytes;
+    uint32_t criticals;
+    uint32_t byte_calls;
+    uint32_t burst_calls;
+    uint32_t vec_calls;
+    uint32_t wrap_calls;
+    uint32_t reg_calls;
+
+    // SEND in progress per socket, SENDOK comes sendok_delay CS windows after it
+    uint32_t sendok_delay;
+    uint8_t send_pending[CHIP_SOCKETS];
+    uint16_t send_end[CHIP_SOCKETS];
+    uint32_t send_due[CHIP_SOCKETS];
+    uint32_t sends;
+
+    // TCP data that left socket 0, and how much of it had when DISCON was written
+    uint8_t sent[32768];
+    uint32_t sent_len;
+    uint32_t sent_at_discon;
+
+    // bytes received on a socket between the reads of the two bytes of its Sn_RX_RSR
+    int arrival_sn;
+    uint16_t arrival_len;
+
+    // asynchronous burst in flight
+    uint8_t *async_buf;
+    uint16_t async_len;
+    uint8_t async_write;
+    uint32_t async_exits;
+};
+
+static struct chip chip;
+
+static void fail(const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+
+    exit(1);
+}
+
+static uint16_t get16(uint16_t addr) {
+    return ((uint16_t)chip.mem[addr] << 8) | chip.mem[addr + 1];
+}
+
+static void set16(uint16_t addr, uint16_t value) {
+    chip.mem[addr] = value >> 8;
+    chip.mem[addr + 1] = value;
+}
+
+// the socket buffers as the chip lays them out from TMSR and RMSR
+static uint16_t buf_size(uint8_t msr, int sn) {
+    return 1024 << ((msr >> (2 * sn)) & 3);
+}
+
+static uint16_t buf_base(uint16_t base, uint8_t msr, int sn) {
+    for (int i = 0; i < sn; i++) {
+        base += buf_size(msr, i);
+    }
+
+    return base;
+}
+
+static uint16_t tx_size(int sn) {
+    return buf_size(chip.mem[TMSR], sn);
+}
+
+static uint16_t rx_size(int sn) {
+    return buf_size(chip.mem[RMSR], sn);
+}
+
+static void chip_reset(void) {
+    memset(chip.mem, 0, SN_REG(CHIP_SOCKETS, 0));
+    chip.mem[RMSR] = 0x55;
+    chip.mem[TMSR] = 0x55;
+    memset(chip.send_pending, 0, sizeof(chip.send_pending));
+}
+
+static void chip_receive(int sn, const uint8_t *data, uint16_t len) {
+    uint16_t base = buf_base(CHIP_RXBUF, chip.mem[RMSR], sn);
+    uint16_t wr = get16(SN_REG(sn, 0x2a));
+
+    for (uint16_t i = 0; i < len; i++, wr++) {
+        chip.mem[base + (wr & (rx_size(sn) - 1))] = data[i];
+    }
+
+    set16(SN_REG(sn, 0x2a), wr);
+}
+
+static void chip_send_done(int sn) {
+    uint16_t base = buf_base(CHIP_TXBUF, chip.mem[TMSR], sn);
+    uint16_t rd = get16(SN_REG(sn, 0x22));
+
+    for (; rd != chip.send_end[sn]; rd++) {
+        if (sn == 0) {
+            if (chip.sent_len == sizeof(chip.sent)) {
+                fail("socket 0 sent more than %u bytes", (unsigned)sizeof(chip.sent));
+            }
+
+            chip.sent[chip.sent_len++] = chip.mem[base + (rd & (tx_size(sn) - 1))];
+        }
+    }
+
+    set16(SN_REG(sn, 0x22), rd);
+    chip.mem[SN_REG(sn, 0x02)] |= Sn_IR_SENDOK;
+    chip.send_pending[sn] = 0;
+}
+
+static void chip_command(int sn, uint8_t cr) {
+    uint8_t *sr = &chip.mem[SN_REG(sn, 0x03)];
+    uint8_t *ir = &chip.mem[SN_REG(sn, 0x02)];
+
+    switch (cr) {
+    case Sn_CR_OPEN:
+        *sr = (chip.mem[SN_REG(sn, 0x00)] & 0x0f) == Sn_MR_TCP ? SOCK_INIT : SOCK_UDP;
+        break;
+    case Sn_CR_CONNECT:
+        if (*sr != SOCK_INIT) {
+            fail("socket %d: CONNECT in state %02x", sn, *sr);
+        }
+
+        *sr = SOCK_ESTABLISHED;
+        *ir |= Sn_IR_CON;
+        break;
+    case Sn_CR_SEND:
+        if (chip.send_pending[sn]) {
+            fail("socket %d: SEND before the SENDOK of the previous one", sn);
+        }
+
+        chip.sends++;
+        chip.send_end[sn] = get16(SN_REG(sn, 0x24));
+        chip.send_pending[sn] = 1;
+        chip.send_due[sn] = chip.windows + chip.sendok_delay;
+        break;
+    case Sn_CR_RECV:
+        break;
+    case Sn_CR_DISCON:
+        // what was handed over goes before the FIN
+        if (chip.send_pending[sn]) {
+            chip_send_done(sn);
+        }
+
+        if (sn == 0) {
+            chip.sent_at_discon = chip.sent_len;
+        }
+
+        *sr = SOCK_CLOSED;
+        *ir |= Sn_IR_DISCON;
+        break;
+    case Sn_CR_CLOSE:
+        *sr = SOCK_CLOSED;
+        chip.send_pending[sn] = 0;
+        break;
+    default:
+        fail("socket %d: unexpected command %02x", sn, cr);
+    }
+}
+
+static uint8_t chip_read(uint16_t addr) {
+    if (addr >= SN_REG(0, 0) && addr < SN_REG(CHIP_SOCKETS, 0)) {
+        int sn = (addr - SN_REG(0, 0)) >> 8;
+        uint16_t fsr = tx_size(sn) - (uint16_t)(get16(SN_REG(sn, 0x24)) - get16(SN_REG(sn, 0x22)));
+        uint16_t rsr = get16(SN_REG(sn, 0x2a)) - get16(SN_REG(sn, 0x28));
+
+        switch (addr & 0xff) {
+        case 0x01:
+            return 0; // commands complete at once
+        case 0x20:
+            return fsr >> 8;
+        case 0x21:
+            return fsr;
+        case 0x26:
+            if (chip.arrival_sn == sn) {
+                uint8_t data[256];
+
+                for (int i = 0; i < chip.arrival_len; i++) {
+                    data[i] = rand();
+                }
+
+                chip_receive(sn, data, chip.arrival_len);
+                chip.arrival_sn = -1;
+            }
+
+            return rsr >> 8;
+        case 0x27:
+            return rsr;
+        }
+    }
+
+    return chip.mem[addr];
+}
+
+static void chip_write(uint16_t addr, uint8_t value) {
+    if (addr == MR) {
+        if (value & MR_RST) {
+            chip_reset();
+            return;
+        }
+    } else if (addr >= SN_REG(0, 0) && addr < SN_REG(CHIP_SOCKETS, 0)) {
+        int sn = (addr - SN_REG(0, 0)) >> 8;
+
+        switch (addr & 0xff) {
+        case 0x01:
+            chip_command(sn, value);
+            return;
+        case 0x02:
+            chip.mem[addr] &= ~value;
+            return;
+        case 0x20: case 0x21: case 0x22: case 0x23: case 0x26: case 0x27: case 0x2a: case 0x2b:
+            return; // read only
+        }
+    }
+
+    chip.mem[addr] = value;
+}
+
+// one byte each way on the bus
+static uint8_t chip_xfer(uint8_t out) {
+    if (!chip.selected) {
+        fail("byte %02x clocked with the chip deselected", out);
+    }
+
+    chip.bytes++;
+
+    switch (chip.frame_pos++) {
+    case 0:
+        if (out != 0xf0 && out != 0x0f) {
+            fail("frame opcode %02x", out);
+        }
+
+        chip.frame_op = out;
+        return 0;
+    case 1:
+        chip.frame_addr = out << 8;
+        return 1;
+    case 2:
+        chip.frame_addr |= out;
+        return 2;
+    }
+
+    if (chip.frame_addr >= CHIP_MEM_SIZE) {
+        fail("access to %04x beyond the chip's memory", chip.frame_addr);
+    }
+
+    if (chip.frame_op == 0xf0) {
+        chip_write(chip.frame_addr++, out);
+        return 0;
+    }
+
+    return chip_read(chip.frame_addr++);
+}
+
+static void cs_select(void) {
+    if (chip.selected) {
+        fail("chip selected twice");
+    }
+
+    chip.selected = 1;
+    chip.frame_pos = 0;
+    chip.windows++;
+}
+
+static void cs_deselect(void) {
+    if (!chip.selected) {
+        fail("chip deselected twice");
+    }
+
+    if (chip.frame_pos != 0 && chip.frame_pos < 3) {
+        fail("frame ended after %u header bytes", chip.frame_pos);
+    }
+
+    chip.selected = 0;
+
+    for (int sn = 0; sn < CHIP_SOCKETS; sn++) {
+        if (chip.send_pending[sn] && chip.windows >= chip.send_due[sn]) {
+            chip_send_done(sn);
+        }
+    }
+}
+
+// the burst in flight runs to its end and the platform's interrupt reports it
+static void async_complete(void) {
+    for (uint16_t i = 0; i < chip.async_len; i++) {
+        if (chip.async_write) {
+            chip_xfer(chip.async_buf[i]);
+        } else {
+            chip.async_buf[i] = chip_xfer(0xff);
+        }
+    }
+
+    chip.async_buf = NULL;
+    wizchip_spiburst_async_done();
+}
+
+static void cris_enter(void) {
+    if (chip.critical) {
+        fail("critical section entered twice");
+    }
+
+    chip.critical = 1;
+    chip.criticals++;
+}
+
+static void cris_exit(void) {
+    if (!chip.critical) {
+        fail("critical section left twice");
+    }
+
+    chip.critical = 0;
+
+    // an interrupt raised meanwhile is taken as the section ends
+    if (chip.async_buf && --chip.async_exits == 0) {
+        async_complete();
+    }
+}
+
+static uint8_t spi_read_byte(void) {
+    chip.byte_calls++;
+    return chip_xfer(0xff);
+}
+
+static void spi_write_byte(uint8_t wb) {
+    chip.byte_calls++;
+    chip_xfer(wb);
+}
+
+static void spi_read_burst(uint8_t *buf, uint16_t len) {
+    chip.burst_calls++;
+
+    for (uint16_t i = 0; i < len; i++) {
+        buf[i] = chip_xfer(0xff);
+    }
+}
+
+static void spi_write_burst(uint8_t *buf, uint16_t len) {
+    chip.burst_calls++;
+
+    for (uint16_t i = 0; i < len; i++) {
+        chip_xfer(buf[i]);
+    }
+}
+
+static void iov_write(wiz_iovec *iov) {
+    for (uint16_t i = 0; i < iov->len; i++) {
+        chip_xfer(iov->buf[i]);
+    }
+}
+
+static void iov_read(wiz_iovec *iov) {
+    for (uint16_t i = 0; i < iov->len; i++) {
+        iov->buf[i] = chip_xfer(0xff);
+    }
+}
+
+static void spi_read_burst_vec(wiz_iovec *wr, wiz_iovec *rd) {
+    chip.vec_calls++;
+    iov_write(wr);
+    iov_read(rd);
+}
+
+static void spi_write_burst_vec(wiz_iovec *iov, uint8_t iovcnt) {
+    chip.vec_calls++;
+
+    for (uint8_t i = 0; i < iovcnt; i++) {
+        iov_write(&iov[i]);
+    }
+}
+
+static void spi_read_burst_wrap(wiz_iovec *wr, wiz_iovec *rd) {
+    chip.wrap_calls++;
+    iov_write(&wr[0]);
+    iov_read(&rd[0]);
+    cs_deselect();
+    cs_select();
+    iov_write(&wr[1]);
+    iov_read(&rd[1]);
+}
+
+static void spi_write_burst_wrap(wiz_iovec *iov) {
+    chip.wrap_calls++;
+    iov_write(&iov[0]);
+    iov_write(&iov[1]);
+    cs_deselect();
+    cs_select();
+    iov_write(&iov[2]);
+    iov_write(&iov[3]);
+}
+
+static uint8_t spi_xfer_reg(uint8_t *frame) {
+    uint8_t in = 0;
+
+    chip.reg_calls++;
+
+    for (int i = 0; i < 4; i++) {
+        in = chip_xfer(frame[i]);
+    }
+
+    return in;
+}
+
+static void spi_start_burst(uint8_t *buf, uint16_t len, uint8_t write) {
+    if (!chip.selected || chip.frame_pos != 3) {
+        fail("asynchronous burst started without its header");
+    }
+
+    chip.async_buf = buf;
+    chip.async_len = len;
+    chip.async_write = write;
+    chip.async_exits = ASYNC_IRQ_EXITS;
+}
+
+static void spi_read_burst_async(uint8_t *buf, uint16_t len) {
+    spi_start_burst(buf, len, 0);
+}
+
+static void spi_write_burst_async(uint8_t *buf, uint16_t len) {
+    spi_start_burst(buf, len, 1);
+}
+
+// an idle loop, leaving the interrupts a window
+static void async_wait(void) {
+    while (wizchip_spiburst_async_busy()) {
+        WIZCHIP_CRITICAL_ENTER();
+        WIZCHIP_CRITICAL_EXIT();
+    }
+}
+
+static void counters_reset(void) {
+    chip.windows = 0;
+    chip.bytes = 0;
+    chip.criticals = 0;
+    chip.byte_calls = 0;
+    chip.burst_calls = 0;
+    chip.vec_calls = 0;
+    chip.wrap_calls = 0;
+    chip.reg_calls = 0;
+}
+
+static void random_fill(uint8_t *buf, unsigned len) {
+    for (unsigned i = 0; i < len; i++) {
+        buf[i] = rand();
+    }
+}
+
+static void chip_init(void) {
+    uint8_t size[CHIP_SOCKETS] = {2, 2, 2, 2};
+    uint8_t ip[4] = {192, 168, 1, 15};
+
+    if (wizchip_init(size, size) != 0) {
+        fail("wizchip_init() failed");
+    }
+
+    setSIPR(ip);
+}
+
+// register and buffer round trips through the callbacks registered so far
+static void test_access(const char *name, unsigned rounds) {
+    uint8_t data[2048];
+    uint8_t back[2048];
+    unsigned criticals = 0;
+
+    chip_init();
+
+    for (unsigned round = 0; round < rounds; round++) {
+        uint16_t addr = SN_REG(rand() % CHIP_SOCKETS, 0x04 + rand() % 12);
+        uint8_t value = rand();
+
+        counters_reset();
+        WIZCHIP_WRITE(addr, value);
+
+        if (chip.mem[addr] != value || chip.windows != 1) {
+            fail("%-6s register write %04x: %02x in %u CS windows", name, addr, chip.mem[addr], chip.windows);
+        }
+
+        chip.mem[addr] = value ^ 0x5a;
+        counters_reset();
+
+        if (WIZCHIP_READ(addr) != (value ^ 0x5a) || chip.windows != 1) {
+            fail("%-6s register read %04x in %u CS windows", name, addr, chip.windows);
+        }
+
+        if (WIZCHIP.IF.SPI._xfer_reg && (chip.reg_calls != 1 || chip.byte_calls || chip.burst_calls)) {
+            fail("%-6s register read not one frame callback", name);
+        }
+
+        // a buffer access anywhere in the TX and RX memory
+        uint16_t len = rand() % sizeof(data);
+        addr = CHIP_TXBUF + rand() % (0x4000 - len);
+
+        random_fill(data, len);
+        counters_reset();
+        WIZCHIP_WRITE_BUF(addr, data, len);
+
+        if (memcmp(&chip.mem[addr], data, len) || chip.windows != 1) {
+            fail("%-6s buffer write %04x+%u in %u CS windows", name, addr, len, chip.windows);
+        }
+
+        if (WIZCHIP.IF.SPI._write_burst_vec && chip.vec_calls != 1) {
+            fail("%-6s buffer write in %u vectored calls", name, chip.vec_calls);
+        }
+
+        random_fill(&chip.mem[addr], len);
+        counters_reset();
+        WIZCHIP_READ_BUF(addr, back, len);
+
+        if (memcmp(&chip.mem[addr], back, len) || chip.windows != 1) {
+            fail("%-6s buffer read %04x+%u in %u CS windows", name, addr, len, chip.windows);
+        }
+
+        // a socket's data across the end of its buffer
+        int sn = rand() % CHIP_SOCKETS;
+        uint16_t size = tx_size(sn);
+        uint16_t at = 1 + rand() % 63;
+        uint16_t ptr = size - at + size * (rand() % 8);
+        uint16_t base = buf_base(CHIP_TXBUF, chip.mem[TMSR], sn);
+
+        len = at + 1 + rand() % (size - at - 1);
+        random_fill(data, len);
+        counters_reset();
+        wiz_send_data_at(sn, ptr, data, len);
+
+        if (memcmp(&chip.mem[base + size - at], data, at) || memcmp(&chip.mem[base], data + at, len - at)) {
+            fail("%-6s socket %d wrapped write of %u at %u", name, sn, len, at);
+        }
+
+        if (chip.windows != 2) {
+            fail("%-6s socket %d wrapped write in %u CS windows", name, sn, chip.windows);
+        }
+
+        criticals = chip.criticals;
+        base = buf_base(CHIP_RXBUF, chip.mem[RMSR], sn);
+        random_fill(&chip.mem[base], size);
+        counters_reset();
+        wiz_recv_data_at(sn, ptr, back, len);
+
+        if (memcmp(&chip.mem[base + size - at], back, at) || memcmp(&chip.mem[base], back + at, len - at)) {
+            fail("%-6s socket %d wrapped read of %u at %u", name, sn, len, at);
+        }
+
+        if (chip.windows != 2 || chip.criticals != criticals) {
+            fail("%-6s socket %d wrapped read in %u CS windows", name, sn, chip.windows);
+        }
+
+        if (WIZCHIP.IF.SPI._write_burst_wrap ? (criticals != 1 || chip.wrap_calls != 1) : criticals != 2) {
+            fail("%-6s socket %d wrapped read in %u critical sections", name, sn, criticals);
+        }
+    }
+
+    printf("%-6s registers 1 CS window, buffers 1, wrapped 2 in %u critical section%s, %u rounds ok\n",
+        name, criticals, criticals == 1 ? "" : "s", rounds);
+}
+
+static void async_done(void *arg) {
+    (*(int *)arg)++;
+}
+
+static uint8_t chain_data[512];
+
+// starts the next burst from the completion of the first
+static void async_chain(void *arg) {
+    (*(int *)arg)++;
+    WIZCHIP_WRITE_BUF_ASYNC(CHIP_RXBUF, chain_data, sizeof(chain_data), async_done, arg);
+}
+
+static void test_async(void) {
+    uint8_t data[1024];
+    uint8_t back[1024];
+    int done = 0;
+
+    random_fill(data, sizeof(data));
+
+    // no async callbacks, the blocking path and the callback before returning
+    if (WIZCHIP_WRITE_BUF_ASYNC(CHIP_TXBUF, data, sizeof(data), async_done, &done) != 0 || done != 1 ||
+        memcmp(&chip.mem[CHIP_TXBUF], data, sizeof(data))) {
+        fail("async write fallback");
+    }
+
+    if (WIZCHIP_READ_BUF_ASYNC(CHIP_TXBUF, back, sizeof(back), async_done, &done) != 0 || done != 2 ||
+        memcmp(back, data, sizeof(data))) {
+        fail("async read fallback");
+    }
+
+    reg_wizchip_spiburst_async_cbfunc(spi_read_burst_async, spi_write_burst_async);
+
+    if (!wizchip_spiburst_async_enabled()) {
+        fail("async callbacks registered but not enabled");
+    }
+
+    // a register access right behind a burst in flight waits for it
+    random_fill(data, sizeof(data));
+    done = 0;
+    counters_reset();
+
+    if (WIZCHIP_WRITE_BUF_ASYNC(CHIP_TXBUF, data, sizeof(data), async_done, &done) != 1 || done != 0) {
+        fail("async write not started");
+    }
+
+    if (!chip.selected || !wizchip_spiburst_async_busy()) {
+        fail("async write not in flight");
+    }
+
+    if (WIZCHIP_READ(CHIP_TXBUF + sizeof(data) - 1) != data[sizeof(data) - 1] || done != 1) {
+        fail("register read didn't wait for the async write");
+    }
+
+    if (memcmp(&chip.mem[CHIP_TXBUF], data, sizeof(data)) || chip.windows != 2) {
+        fail("async write data, %u CS windows", chip.windows);
+    }
+
+    random_fill(&chip.mem[CHIP_RXBUF], sizeof(back));
+
+    if (WIZCHIP_READ_BUF_ASYNC(CHIP_RXBUF, back, sizeof(back), async_done, &done) != 1) {
+        fail("async read not started");
+    }
+
+    async_wait();
+
+    if (done != 2 || memcmp(back, &chip.mem[CHIP_RXBUF], sizeof(back))) {
+        fail("async read data");
+    }
+
+    // the wait inside the next access sees the chained burst as well
+    random_fill(data, sizeof(data));
+    random_fill(chain_data, sizeof(chain_data));
+    done = 0;
+
+    WIZCHIP_WRITE_BUF_ASYNC(CHIP_TXBUF, data, sizeof(data), async_chain, &done);
+    WIZCHIP_READ_BUF(CHIP_RXBUF, back, sizeof(chain_data));
+
+    if (done != 2 || memcmp(back, chain_data, sizeof(chain_data)) || memcmp(&chip.mem[CHIP_TXBUF], data, sizeof(data))) {
+        fail("chained async write, %d completions", done);
+    }
+
+    reg_wizchip_spiburst_async_cbfunc(NULL, NULL);
+
+    printf("async  fallback, read, write, access behind a burst and chained burst ok\n");
+}
+
+static void socket_establish(uint8_t sn) {
+    uint8_t peer[4] = {192, 168, 1, 2};
+
+    if (socket(sn, Sn_MR_TCP, 5000 + sn, 0) != sn || connect(sn, peer, 5001) != SOCK_OK) {
+        fail("socket %u not established", sn);
+    }
+}
+
+static void test_snapshot(unsigned rounds) {
+    wiz_SnSnapshot snap;
+
+    chip_init();
+
+    for (uint8_t sn = 0; sn < CHIP_SOCKETS; sn++) {
+        socket_establish(sn);
+    }
+
+    for (unsigned round = 0; round < rounds; round++) {
+        uint8_t sn = rand() % CHIP_SOCKETS;
+        uint16_t tx_rd = rand();
+        uint16_t rx_rd = rand();
+
+        set16(SN_REG(sn, 0x22), tx_rd);
+        set16(SN_REG(sn, 0x24), tx_rd + (rand() % 2 ? rand() % tx_size(sn) : 0));
+        set16(SN_REG(sn, 0x28), rx_rd);
+        set16(SN_REG(sn, 0x2a), rx_rd + (rand() % 2 ? rand() % rx_size(sn) : 0));
+        chip.mem[SN_REG(sn, 0x02)] = rand() & 0x1f;
+
+        wiz_socket_snapshot(sn, &snap);
+
+        if (snap.mr != getSn_MR(sn) || snap.cr != getSn_CR(sn) || snap.ir != getSn_IR(sn) ||
+            snap.sr != getSn_SR(sn) || snap.tx_fsr != getSn_TX_FSR(sn) || snap.tx_rd != getSn_TX_RD(sn) ||
+            snap.tx_wr != getSn_TX_WR(sn) || snap.rx_rsr != getSn_RX_RSR(sn) ||
+            snap.rx_rd != getSn_RX_RD(sn) || snap.rx_wr != getSn_RX_WR(sn)) {
+            fail("socket %u snapshot differs from the getters", sn);
+        }
+    }
+
+    // an idle established socket, as a poll finds it
+    set16(SN_REG(0, 0x24), get16(SN_REG(0, 0x22)));
+    set16(SN_REG(0, 0x2a), get16(SN_REG(0, 0x28)));
+    chip.mem[SN_REG(0, 0x02)] = 0;
+
+    counters_reset();
+    wiz_socket_snapshot(0, &snap);
+    uint32_t windows = chip.windows;
+    uint32_t bytes = chip.bytes;
+
+    counters_reset();
+    getSn_SR(0);
+    getSn_IR(0);
+    getSn_RX_RSR(0);
+
+    if (windows != 1) {
+        fail("idle snapshot in %u CS windows", windows);
+    }
+
+    printf("snap   %u rounds against the getters ok, idle poll %u CS window %u bytes (getters %u and %u)\n",
+        rounds, windows, bytes, chip.windows, chip.bytes);
+
+    // 0x20 bytes land between the high and the low byte of Sn_RX_RSR, 0x00f0 -> 0x0110
+    set16(SN_REG(1, 0x2a), get16(SN_REG(1, 0x28)) + 0xf0);
+    chip.arrival_sn = 1;
+    chip.arrival_len = 0x20;
+    wiz_socket_snapshot(1, &snap);
+
+    if (snap.rx_rsr != 0x0110 || chip.arrival_sn != -1) {
+        fail("snapshot of Sn_RX_RSR changing in its read: %04x", snap.rx_rsr);
+    }
+}
+
+static void test_send_stream(void) {
+    static uint8_t data[20000];
+    uint8_t mode = SOCK_SEND_STREAM;
+    uint8_t io = SOCK_IO_NONBLOCK;
+    uint32_t offset = 0;
+    unsigned queued_in_flight = 0;
+    int32_t ret;
+
+    chip_init();
+    socket_establish(0);
+    random_fill(data, sizeof(data));
+    chip.sent_len = 0;
+    chip.sends = 0;
+    chip.sendok_delay = 8;
+
+    if (ctlsocket(0, CS_SET_SENDMODE, &mode) != SOCK_OK || ctlsocket(0, CS_SET_IOMODE, &io) != SOCK_OK) {
+        fail("stream mode not set");
+    }
+
+    while (offset < sizeof(data) / 2) {
+        uint16_t len = 1 + rand() % 3000;
+        uint8_t in_flight = chip.send_pending[0];
+
+        if (len > sizeof(data) - offset) {
+            len = sizeof(data) - offset;
+        }
+
+        ret = send(0, data + offset, len);
+
+        if (ret > 0) {
+            offset += ret;
+            queued_in_flight += in_flight;
+        } else if (ret < 0) {
+            fail("stream send() returned %d", ret);
+        }
+    }
+
+    if (queued_in_flight == 0) {
+        fail("stream send() never queued behind a SEND in progress");
+    }
+
+    // a SEND in progress with data queued behind it, the mode can't be left yet
+    chip.sendok_delay = 1000;
+
+    while (!chip.send_pending[0]) {
+        if ((ret = send(0, data + offset, 100)) > 0) {
+            offset += ret;
+        }
+    }
+
+    if ((ret = send(0, data + offset, 100)) != 100) {
+        fail("stream send() behind a SEND in progress returned %d", ret);
+    }
+
+    offset += ret;
+    mode = SOCK_SEND_ONESHOT;
+
+    if (ctlsocket(0, CS_SET_SENDMODE, &mode) != SOCK_BUSY) {
+        fail("SOCK_SEND_ONESHOT taken with data queued");
+    }
+
+    chip.sendok_delay = 8;
+
+    while (offset < sizeof(data)) {
+        ret = send(0, data + offset, sizeof(data) - offset);
+
+        if (ret > 0) {
+            offset += ret;
+        }
+    }
+
+    // blocking, disconnect() hands what is queued to the chip before the FIN
+    io = SOCK_IO_BLOCK;
+    ctlsocket(0, CS_SET_IOMODE, &io);
+
+    if (disconnect(0) != SOCK_OK) {
+        fail("disconnect() with data queued");
+    }
+
+    if (chip.sent_at_discon != sizeof(data) || memcmp(chip.sent, data, sizeof(data))) {
+        fail("stream sent %u of %u bytes before the FIN", chip.sent_at_discon, (unsigned)sizeof(data));
+    }
+
+    chip.sendok_delay = 0;
+
+    printf("stream %u bytes in %u SENDs, %u send() calls queued behind one in progress, flushed by disconnect() ok\n",
+        (unsigned)sizeof(data), chip.sends, queued_in_flight);
+}
+
+static void test_buffer_sizes(void) {
+    uint8_t data[300];
+
+    chip_init();
+
+    if (wiz_sn_buf(0)->txmax != 2048 || wiz_sn_buf(3)->rxmax != 2048) {
+        fail("2 KB sockets after wizchip_init()");
+    }
+
+    // all 8 KB to socket 0, the other sockets have none
+    setTMSR(0x03);
+    setRMSR(0x03);
+
+    if (wiz_sn_buf(0)->txmax != 8192 || wiz_sn_buf(0)->rxmax != 8192 || wiz_sn_buf(1)->txmax != 0 ||
+        getSn_TxMAX(0) != 8192) {
+        fail("socket buffers kept across setTMSR()/setRMSR(): %u", wiz_sn_buf(0)->txmax);
+    }
+
+    random_fill(data, sizeof(data));
+    wiz_send_data_at(0, 8000, data, sizeof(data));
+
+    if (memcmp(&chip.mem[CHIP_TXBUF + 8000], data, 192) || memcmp(&chip.mem[CHIP_TXBUF], data + 192, 108)) {
+        fail("socket 0 write across the end of its 8 KB");
+    }
+
+    printf("sizes  socket buffers follow setTMSR()/setRMSR() ok\n");
+}
+
+int main(int argc, char **argv) {
+    unsigned rounds = argc > 1 ? atoi(argv[1]) : 1000;
+
+    srand(1);
+    chip.arrival_sn = -1;
+
+    reg_wizchip_cris_cbfunc(cris_enter, cris_exit);
+    reg_wizchip_cs_cbfunc(cs_select, cs_deselect);
+    reg_wizchip_spi_cbfunc(spi_read_byte, spi_write_byte);
+    test_access("byte", rounds);
+
+    reg_wizchip_spiburst_cbfunc(spi_read_burst, spi_write_burst);
+    test_access("burst", rounds);
+
+    reg_wizchip_spiburst_vec_cbfunc(spi_read_burst_vec, spi_write_burst_vec);
+    test_access("vec", rounds);
+
+    reg_wizchip_spireg_cbfunc(spi_xfer_reg);
+    test_access("reg", rounds);
+
+    reg_wizchip_spiburst_wrap_cbfunc(spi_read_burst_wrap, spi_write_burst_wrap);
+    test_access("wrap", rounds);
+
+    test_async();
+    test_snapshot(rounds);
+    test_send_stream();
+    test_buffer_sizes();
+
+    return 0;
+}
@@ -0,0 +1,35 @@
+# web_pack_add(<target> <name> <directory> [GZIP])
+#
+# Packs the web content of a directory at build time with tools/web_pack.py, into the sources
+# of <target>: the const httpServer_webPack <name>, declared by <name>.h, for the
+# reg_httpServer_webPack() of the ioLibrary httpServer. GZIP adds the gzip variants of the
+# text files. The pack is made again when a file in the directory changes
+
+set(WEB_PACK_TOOL ${CMAKE_CURRENT_LIST_DIR}/../tools/web_pack.py)
+
+function(web_pack_add TARGET NAME DIR)
+    cmake_parse_arguments(WEB_PACK "GZIP" "" "" ${ARGN})
+
+    find_package(Python3 REQUIRED COMPONENTS Interpreter)
+
+    get_filename_component(WEB_PACK_DIR ${DIR} ABSOLUTE)
+    file(GLOB_RECURSE WEB_PACK_FILES CONFIGURE_DEPENDS ${WEB_PACK_DIR}/*)
+
+    set(WEB_PACK_OUT ${CMAKE_CURRENT_BINARY_DIR}/${NAME}.c)
+    set(WEB_PACK_ARGS ${WEB_PACK_DIR} -o ${WEB_PACK_OUT} --name ${NAME})
+
+    if(WEB_PACK_GZIP)
+        list(APPEND WEB_PACK_ARGS --gzip)
+    endif()
+
+    add_custom_command(
+        OUTPUT ${WEB_PACK_OUT} ${CMAKE_CURRENT_BINARY_DIR}/${NAME}.h
+        COMMAND ${Python3_EXECUTABLE} ${WEB_PACK_TOOL} ${WEB_PACK_ARGS}
+        DEPENDS ${WEB_PACK_TOOL} ${WEB_PACK_FILES}
+        COMMENT "Packing the web content of ${DIR}"
+        VERBATIM
+        )
+
+    target_sources(${TARGET} PRIVATE ${WEB_PACK_OUT})
+    target_include_directories(${TARGET} PRIVATE ${CMAKE_CURRENT_BINARY_DIR})
+endfunction()
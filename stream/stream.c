@@ -0,0 +1,452 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "timebase.h"
+
+#include "stream.h"
+
+// transfers of the sink, the most RP2350's 28-bit count takes. A sink that runs out is
+// started again from the interrupt
+#define STREAM_SINK_COUNT 0x0fffffffu
+
+// the ADC's clock, from the USB PLL whatever clk_sys is
+#define STREAM_ADC_CLOCK_HZ 48000000u
+
+enum stream_slot_state {
+    STREAM_SLOT_FREE,
+    STREAM_SLOT_CAPTURE, // the DMA writes into it
+    STREAM_SLOT_FULL,    // waiting for the stack
+    STREAM_SLOT_SENDING, // the stack has it
+};
+
+struct stream_slot {
+    volatile uint8_t state;
+    uint8_t flags;
+    uint32_t first;      // index of its first sample
+    uint32_t time_us;    // its last sample written
+};
+
+static struct stream {
+    struct stream_config config;
+    int chan;
+    spin_lock_t *lock;   // the capture's state, between the interrupt and stream_poll() on either core
+    dma_channel_config slot_config;
+    dma_channel_config sink_config;
+    const volatile void *fifo;
+
+    struct stream_slot slots[STREAM_SLOTS];
+    uint8_t capture;     // slot the DMA writes into, or the next one while stalled
+    uint8_t send;        // oldest slot not given to the stack
+    volatile bool stalled;
+    bool sinking;        // the DMA counts the ADC's samples into sink while stalled
+    uint32_t stall_start_us;
+    uint32_t sample_next; // index of the next sample the source gives
+
+    uint8_t host[4];
+    uint16_t host_port;
+    bool streaming;
+    uint32_t host_seen_ms;
+    uint32_t seq;
+
+    struct stream_stats stats; // since the host asked
+    struct stream_stats reported;
+    uint32_t start_ms;
+    uint32_t report_ms;
+} stream;
+
+static uint32_t stream_sink;
+
+static uint16_t stream_datagram_len(void) {
+    return STREAM_HEADER_SIZE + stream.config.samples * stream.config.sample_size;
+}
+
+static uint8_t stream_slots_free(void) {
+    uint8_t n = 0;
+
+    for (uint i = 0; i < STREAM_SLOTS; i++) {
+        n += (stream.slots[i].state == STREAM_SLOT_FREE);
+    }
+
+    return n;
+}
+
+// the DMA into a free slot, behind its header
+static void stream_capture_start(uint8_t slot) {
+    struct stream_slot *s = &stream.slots[slot];
+
+    s->state = STREAM_SLOT_CAPTURE;
+    s->first = stream.sample_next;
+
+    dma_channel_configure(stream.chan, &stream.slot_config, stream_stack_slot(slot) + STREAM_HEADER_SIZE,
+                          stream.fifo, stream.config.samples, true);
+}
+
+// no slot free: a PIO source waits on its full FIFO, the ADC's samples are counted away
+static void stream_capture_stall(void) {
+    stream.stalled = true;
+    stream.stall_start_us = timebase_us();
+    stream.stats.stalls++;
+
+    if (stream.config.source == STREAM_SOURCE_ADC) {
+        stream.sinking = true;
+        dma_channel_configure(stream.chan, &stream.sink_config, &stream_sink, stream.fifo, STREAM_SINK_COUNT, true);
+    }
+}
+
+// the slot the DMA finished is full, the next one gets the DMA if it is free
+static void stream_capture_next(void) {
+    struct stream_slot *s = &stream.slots[stream.capture];
+
+    s->time_us = timebase_us();
+    s->state = STREAM_SLOT_FULL;
+    stream.sample_next += stream.config.samples;
+    stream.stats.samples += stream.config.samples;
+
+    stream.capture = (stream.capture + 1) % STREAM_SLOTS;
+
+    uint8_t free = stream_slots_free();
+
+    if (free < stream.stats.slots_free_min) {
+        stream.stats.slots_free_min = free;
+    }
+
+    if (stream.slots[stream.capture].state == STREAM_SLOT_FREE) {
+        stream_capture_start(stream.capture);
+    } else {
+        stream_capture_stall();
+    }
+}
+
+// DMA_IRQ_1, shared with the RMII driver: the next free slot gets the DMA as soon as the last
+// one is full, the source's FIFO holds the samples meanwhile
+static void stream_dma_handler(void) {
+    if (!dma_channel_get_irq1_status(stream.chan)) {
+        return;
+    }
+
+    // again under the lock, a resume on the other core may have taken the completion
+    uint32_t save = spin_lock_blocking(stream.lock);
+
+    if (!dma_channel_get_irq1_status(stream.chan)) {
+        spin_unlock(stream.lock, save);
+        return;
+    }
+
+    dma_channel_acknowledge_irq1(stream.chan);
+
+    if (stream.sinking) {
+        stream.sample_next += STREAM_SINK_COUNT;
+        stream.stats.samples_lost += STREAM_SINK_COUNT;
+        dma_channel_set_trans_count(stream.chan, STREAM_SINK_COUNT, true);
+    } else {
+        stream_capture_next();
+    }
+
+    spin_unlock(stream.lock, save);
+}
+
+// a stalled capture back on the next slot once it is free, from stream_poll()
+static void stream_capture_resume(void) {
+    if (!stream.stalled || (stream.slots[stream.capture].state != STREAM_SLOT_FREE)) {
+        return;
+    }
+
+    uint32_t save = spin_lock_blocking(stream.lock);
+
+    if (stream.sinking) {
+        // the transfers the sink made are the samples lost, the FIFO holds the rest
+        dma_channel_set_irq1_enabled(stream.chan, false);
+        dma_channel_abort(stream.chan);
+        dma_channel_acknowledge_irq1(stream.chan);
+        dma_channel_set_irq1_enabled(stream.chan, true);
+
+        uint32_t lost = STREAM_SINK_COUNT - dma_channel_hw_addr(stream.chan)->transfer_count;
+
+        stream.sample_next += lost;
+        stream.stats.samples_lost += lost;
+        stream.sinking = false;
+
+        if (lost != 0) {
+            stream.slots[stream.capture].flags |= STREAM_FLAG_LOST;
+        }
+    }
+
+    stream.stats.stall_us += timebase_us() - stream.stall_start_us;
+    stream.stalled = false;
+    stream_capture_start(stream.capture);
+
+    spin_unlock(stream.lock, save);
+}
+
+static void stream_put32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+// the full slots in capture order, the first the stack can't take yet stops them
+static void stream_send(void) {
+    uint16_t len = stream_datagram_len();
+
+    while (stream.slots[stream.send].state == STREAM_SLOT_FULL) {
+        uint8_t slot = stream.send;
+        struct stream_slot *s = &stream.slots[slot];
+        uint8_t *h = stream_stack_slot(slot);
+
+        h[0] = STREAM_MAGIC >> 8;
+        h[1] = STREAM_MAGIC & 0xff;
+        h[2] = stream.config.sample_size;
+        h[3] = s->flags;
+        stream_put32(h + 4, stream.seq);
+        stream_put32(h + 8, s->first);
+        stream_put32(h + 12, s->time_us);
+
+        // before the call, the stack may be done with it before it returns
+        s->state = STREAM_SLOT_SENDING;
+
+        enum stream_send ret = stream_stack_send(slot, len, stream.host, stream.host_port);
+
+        if (ret == STREAM_SEND_LATER) {
+            s->state = STREAM_SLOT_FULL;
+            stream.stats.deferred++;
+            return;
+        }
+
+        if (ret == STREAM_SEND_FAILED) {
+            s->state = STREAM_SLOT_FREE;
+            stream.stats.errors++;
+        } else {
+            stream.stats.datagrams++;
+        }
+
+        s->flags = 0;
+        stream.seq++;
+        stream.send = (slot + 1) % STREAM_SLOTS;
+    }
+}
+
+static void stream_capture_stop(void) {
+    uint32_t save = spin_lock_blocking(stream.lock);
+
+    dma_channel_set_irq1_enabled(stream.chan, false);
+    dma_channel_abort(stream.chan);
+    dma_channel_acknowledge_irq1(stream.chan);
+    dma_channel_set_irq1_enabled(stream.chan, true);
+
+    if (stream.config.source == STREAM_SOURCE_ADC) {
+        adc_run(false);
+        adc_fifo_drain();
+    }
+
+    // slots with the stack come back through stream_slot_sent()
+    for (uint i = 0; i < STREAM_SLOTS; i++) {
+        if (stream.slots[i].state != STREAM_SLOT_SENDING) {
+            stream.slots[i].state = STREAM_SLOT_FREE;
+        }
+        stream.slots[i].flags = 0;
+    }
+
+    stream.stalled = false;
+    stream.sinking = false;
+
+    spin_unlock(stream.lock, save);
+}
+
+static void stream_capture_begin(void) {
+    memset(&stream.stats, 0, sizeof(stream.stats));
+    stream.stats.slots_free_min = STREAM_SLOTS;
+    stream.sample_next = 0;
+    stream.seq = 0;
+
+    // the first slot after those the stack still has, in order
+    for (uint i = 0; (i < STREAM_SLOTS) && (stream.slots[stream.capture].state != STREAM_SLOT_FREE); i++) {
+        stream.capture = (stream.capture + 1) % STREAM_SLOTS;
+    }
+    stream.send = stream.capture;
+
+    uint32_t save = spin_lock_blocking(stream.lock);
+
+    if (stream.slots[stream.capture].state == STREAM_SLOT_FREE) {
+        stream_capture_start(stream.capture);
+    } else {
+        stream_capture_stall();
+    }
+
+    spin_unlock(stream.lock, save);
+
+    if (stream.config.source == STREAM_SOURCE_ADC) {
+        adc_run(true);
+    }
+}
+
+static void stream_print(const char *name, const struct stream_stats *s, uint32_t ms) {
+    uint32_t bytes = s->samples * stream.config.sample_size;
+
+    printf("stream %s: %lu samples/s, %lu kbit/s of samples, %lu datagrams, %lu lost, %lu stalls %lu us, %lu deferred, %lu errors, %u slots free at least\n",
+           name, (unsigned long)(ms ? (uint64_t)s->samples * 1000 / ms : 0),
+           (unsigned long)(ms ? (uint64_t)bytes * 8 / ms : 0), (unsigned long)s->datagrams,
+           (unsigned long)s->samples_lost, (unsigned long)s->stalls, (unsigned long)s->stall_us,
+           (unsigned long)s->deferred, (unsigned long)s->errors, stream.stats.slots_free_min);
+}
+
+bool stream_init(const struct stream_config *config) {
+    int chan = dma_claim_unused_channel(false);
+
+    if (chan < 0) {
+        return false;
+    }
+
+    memset(&stream, 0, sizeof(stream));
+    stream.config = *config;
+    stream.chan = chan;
+    stream.lock = spin_lock_init(spin_lock_claim_unused(true));
+
+    if (stream.config.source == STREAM_SOURCE_ADC) {
+        // 12 bits in halfwords or the top 8 in bytes
+        if (stream.config.sample_size != 1) {
+            stream.config.sample_size = 2;
+        }
+
+        if (stream.config.adc_input < 4) {
+            adc_gpio_init(26 + stream.config.adc_input);
+        }
+
+        adc_init();
+        adc_set_temp_sensor_enabled(stream.config.adc_input == 4);
+        adc_select_input(stream.config.adc_input);
+        adc_fifo_setup(true, true, 1, false, stream.config.sample_size == 1);
+
+        // a conversion takes 96 clocks, clkdiv counts the clocks between two starts
+        uint32_t rate = stream.config.adc_rate_hz ? stream.config.adc_rate_hz : 1;
+        adc_set_clkdiv(((STREAM_ADC_CLOCK_HZ / rate) > 96) ? (float)(STREAM_ADC_CLOCK_HZ / rate) - 1 : 0);
+
+        stream.fifo = &adc_hw->fifo;
+    } else {
+        if (stream.config.sample_size != 1 && stream.config.sample_size != 2) {
+            stream.config.sample_size = 4;
+        }
+
+        stream.fifo = &stream.config.pio->rxf[stream.config.sm];
+    }
+
+    uint16_t samples_max = (STREAM_DATAGRAM_MAX - STREAM_HEADER_SIZE) / stream.config.sample_size;
+
+    if (stream.config.samples == 0 || stream.config.samples > samples_max) {
+        stream.config.samples = samples_max;
+    }
+
+    enum dma_channel_transfer_size size = (stream.config.sample_size == 1) ? DMA_SIZE_8 :
+                                          (stream.config.sample_size == 2) ? DMA_SIZE_16 : DMA_SIZE_32;
+    uint dreq = (stream.config.source == STREAM_SOURCE_ADC) ? DREQ_ADC :
+                pio_get_dreq(stream.config.pio, stream.config.sm, false);
+
+    stream.slot_config = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&stream.slot_config, size);
+    channel_config_set_read_increment(&stream.slot_config, false);
+    channel_config_set_write_increment(&stream.slot_config, true);
+    channel_config_set_dreq(&stream.slot_config, dreq);
+
+    stream.sink_config = stream.slot_config;
+    channel_config_set_write_increment(&stream.sink_config, false);
+
+    dma_channel_set_irq1_enabled(chan, true);
+    irq_add_shared_handler(DMA_IRQ_1, stream_dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    stream_stack_start(STREAM_PORT);
+
+    printf("stream: %s, %u byte samples, %u per datagram of %u bytes, port %u\n",
+           (stream.config.source == STREAM_SOURCE_ADC) ? "adc" : "pio", stream.config.sample_size,
+           stream.config.samples, stream_datagram_len(), STREAM_PORT);
+
+    return true;
+}
+
+void stream_subscribe(const uint8_t addr[4], uint16_t port) {
+    stream.host_seen_ms = timebase_ms();
+
+    if (stream.streaming && (memcmp(addr, stream.host, 4) == 0) && (port == stream.host_port)) {
+        return;
+    }
+
+    // another host takes over from the next datagram
+    memcpy(stream.host, addr, 4);
+    stream.host_port = port;
+
+    printf("stream: to %u.%u.%u.%u:%u\n", addr[0], addr[1], addr[2], addr[3], port);
+
+    if (!stream.streaming) {
+        stream.streaming = true;
+        stream.start_ms = stream.report_ms = stream.host_seen_ms;
+        memset(&stream.reported, 0, sizeof(stream.reported));
+        stream_capture_begin();
+    }
+}
+
+void stream_slot_sent(uint8_t slot) {
+    stream.slots[slot].state = STREAM_SLOT_FREE;
+}
+
+void stream_count_error(void) {
+    stream.stats.errors++;
+}
+
+void stream_poll(void) {
+    stream_stack_poll();
+
+    if (!stream.streaming) {
+        return;
+    }
+
+    uint32_t now = timebase_ms();
+
+    if ((now - stream.host_seen_ms) >= STREAM_TIMEOUT_MS) {
+        stream.streaming = false;
+        stream_capture_stop();
+        printf("stream: host gone\n");
+        stream_print("total", &stream.stats, now - stream.start_ms);
+        return;
+    }
+
+    stream_send();
+    stream_capture_resume();
+
+#if STREAM_REPORT_MS
+    if ((now - stream.report_ms) >= STREAM_REPORT_MS) {
+        struct stream_stats period = stream.stats;
+
+        period.datagrams -= stream.reported.datagrams;
+        period.samples -= stream.reported.samples;
+        period.samples_lost -= stream.reported.samples_lost;
+        period.stalls -= stream.reported.stalls;
+        period.stall_us -= stream.reported.stall_us;
+        period.deferred -= stream.reported.deferred;
+        period.errors -= stream.reported.errors;
+
+        stream_print("period", &period, now - stream.report_ms);
+
+        stream.reported = stream.stats;
+        stream.report_ms = now;
+    }
+#endif
+}
+
+void stream_get_stats(struct stream_stats *stats) {
+    uint32_t save = spin_lock_blocking(stream.lock);
+
+    *stats = stream.stats;
+
+    spin_unlock(stream.lock, save);
+}
@@ -0,0 +1,139 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/pio.h"
+
+// Sample streaming of both firmwares, from the ADC or a PIO state machine to a host over
+// UDP with no copy of the samples on the board.
+//
+// A DMA channel paced by the source writes the samples straight into a slot, behind the
+// datagram's header and, on lwIP, behind room for the UDP, IP and Ethernet headers. A full
+// slot goes to the stack as it is. lwIP sends it with udp_sendto() as a pbuf of the slot,
+// and the RMII driver streams the frame out of it. On the W5100S a DMA burst writes it into
+// the socket's TX buffer. The slot is free again once the stack is done with it: when the
+// frame is out, or when the bytes are in the chip.
+//
+// The stack is only given a slot it can take whole, so nothing is dropped between the
+// source and the wire. When the link is slower than the source, every slot ends up full or
+// sending, and the capture stops until one is free. A PIO source then stalls on its full RX
+// FIFO and loses nothing. The ADC keeps sampling, so the DMA counts the samples into a sink
+// until a slot is free. stream_get_stats() reports them, and the sample index of the next
+// datagram jumps over them.
+//
+// A host asks for the stream with any datagram to STREAM_PORT, and the samples go to it
+// for as long as it asks again within STREAM_TIMEOUT_MS. tools/stream_recv.py does that.
+
+// slots, captured, full or with the stack
+#ifndef STREAM_SLOTS
+#define STREAM_SLOTS 8
+#endif
+
+// largest datagram, header included, one frame at a 1500 byte MTU
+#ifndef STREAM_DATAGRAM_MAX
+#define STREAM_DATAGRAM_MAX 1472
+#endif
+
+// where the host asks for the stream
+#ifndef STREAM_PORT
+#define STREAM_PORT 5012
+#endif
+
+// a host that stops asking for this long gets no more
+#ifndef STREAM_TIMEOUT_MS
+#define STREAM_TIMEOUT_MS 3000
+#endif
+
+// interval of the report lines on stdio while a host is streaming, 0 for none
+#ifndef STREAM_REPORT_MS
+#define STREAM_REPORT_MS 1000
+#endif
+
+// every datagram starts with it, big endian:
+//   0  magic "SM"
+//   2  bytes per sample
+//   3  flags, STREAM_FLAG_
+//   4  sequence number of the datagram, from 0 for each host
+//   8  index of its first sample, samples lost included
+//   12 time its last sample was written, the board's us since boot
+// the samples follow, little endian as the source wrote them
+#define STREAM_HEADER_SIZE 16
+#define STREAM_MAGIC 0x534d
+
+// samples were lost just before this datagram
+#define STREAM_FLAG_LOST 0x01
+
+enum stream_source {
+    STREAM_SOURCE_ADC,
+    STREAM_SOURCE_PIO
+};
+
+struct stream_config {
+    enum stream_source source;
+    uint8_t adc_input;      // ADC: input 0 to 3 on GPIO 26 to 29, 4 the temperature sensor
+    uint32_t adc_rate_hz;   // ADC: samples per second, up to 500000
+    PIO pio;                // PIO: the state machine whose RX FIFO holds the samples, set up
+    uint sm;                //      and started by the caller
+    uint8_t sample_size;    // 1 or 2 bytes from the ADC (8 or 12 bits), 1, 2 or 4 bytes of
+                            // each RX FIFO word from the PIO
+    uint16_t samples;       // per datagram, lowered to what STREAM_DATAGRAM_MAX holds
+};
+
+struct stream_stats {
+    uint32_t datagrams;     // taken by the stack
+    uint32_t samples;       // captured into slots
+    uint32_t samples_lost;  // of the ADC while no slot was free
+    uint32_t stalls;        // times the capture found no free slot
+    uint32_t stall_us;
+    uint32_t deferred;      // datagrams the stack had no room for yet, sent later
+    uint32_t errors;        // datagrams the stack refused, dropped
+    uint8_t slots_free_min; // fewest slots free at the end of a capture
+};
+
+// claim a DMA channel and a spin lock, set up the source and listen on STREAM_PORT. The
+// capture's DMA_IRQ_1 handler runs on this core, stream_poll() may run on either. False
+// when no DMA channel is left
+bool stream_init(const struct stream_config *config);
+
+// the full slots to the stack, the capture started again when a slot is free, and the
+// report. Call it as often as the network loop runs, from the network context
+void stream_poll(void);
+
+void stream_get_stats(struct stream_stats *stats);
+
+// stack side: a datagram from a host to STREAM_PORT, which asks for the stream
+void stream_subscribe(const uint8_t addr[4], uint16_t port);
+
+// stack side: the stack is done with a slot it took, from any context
+void stream_slot_sent(uint8_t slot);
+
+// stack side: a datagram the stack took was lost after all
+void stream_count_error(void);
+
+enum stream_send {
+    STREAM_SEND_TAKEN,   // the stack has it and calls stream_slot_sent() when done
+    STREAM_SEND_LATER,   // no room now, the same slot is offered again
+    STREAM_SEND_FAILED   // dropped
+};
+
+// stack side, one implementation per firmware
+
+// listen for the hosts on port, passing their datagrams to stream_subscribe()
+void stream_stack_start(uint16_t port);
+
+// the memory of a slot's datagram, STREAM_DATAGRAM_MAX bytes, 4-byte aligned
+uint8_t *stream_stack_slot(uint8_t slot);
+
+// send a slot's datagram of len bytes to the host
+enum stream_send stream_stack_send(uint8_t slot, uint16_t len, const uint8_t addr[4], uint16_t port);
+
+// read the hosts' datagrams and finish the sends, called from stream_poll()
+void stream_stack_poll(void);
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// stream.h on lwIP's raw API, NO_SYS, stream_poll() runs from an lwIP timer
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "stream.h"
+
+// stream_poll() interval, a full slot waits up to this for the stack
+#ifndef STREAM_LWIP_POLL_MS
+#define STREAM_LWIP_POLL_MS 1
+#endif
+
+// 0 sends the datagrams without a UDP checksum, which IPv4 allows: no pass over the samples
+// at all on the board
+#ifndef STREAM_LWIP_CHECKSUM
+#define STREAM_LWIP_CHECKSUM 1
+#endif
+
+// a slot is the pbuf of its datagram: udp_sendto() adds the UDP header in front of the
+// payload and the IP and Ethernet headers go in front of that, all in mem, and the driver
+// streams the frame out of it. PBUF_RAM lets pbuf_add_header() move into mem, which starts
+// after the struct like the payload of a pbuf_alloc()
+struct stream_lwip_slot {
+    struct pbuf_custom pc; // must be first, pbuf_free() hands it to stream_lwip_free()
+    uint8_t slot;
+    volatile bool taken;   // by udp_sendto(), the free function hands the slot back
+    uint8_t mem[LWIP_MEM_ALIGN_SIZE(PBUF_TRANSPORT) + STREAM_DATAGRAM_MAX] __attribute__((aligned(4)));
+};
+
+static struct stream_lwip_slot stream_lwip_slots[STREAM_SLOTS];
+static struct udp_pcb *stream_lwip_pcb;
+
+static void stream_lwip_timer(void *arg) {
+    stream_poll();
+
+    sys_timeout(STREAM_LWIP_POLL_MS, stream_lwip_timer, NULL);
+}
+
+// pbuf_custom free function, once the driver is done with the frame, from whichever core
+// releases it
+static void stream_lwip_free(struct pbuf *p) {
+    struct stream_lwip_slot *s = (struct stream_lwip_slot *)p;
+
+    if (s->taken) {
+        s->taken = false;
+        stream_slot_sent(s->slot);
+    }
+}
+
+static void stream_lwip_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    pbuf_free(p);
+
+    if (IP_IS_V4(addr)) {
+        uint32_t a = ip4_addr_get_u32(ip_2_ip4(addr));
+        uint8_t host[4] = { a, a >> 8, a >> 16, a >> 24 };
+
+        stream_subscribe(host, port);
+    }
+}
+
+void stream_stack_start(uint16_t port) {
+    for (uint i = 0; i < STREAM_SLOTS; i++) {
+        stream_lwip_slots[i].slot = i;
+        stream_lwip_slots[i].pc.custom_free_function = stream_lwip_free;
+    }
+
+    stream_lwip_pcb = udp_new();
+
+    if (stream_lwip_pcb == NULL || udp_bind(stream_lwip_pcb, IP_ADDR_ANY, port) != ERR_OK) {
+        return;
+    }
+
+#if !STREAM_LWIP_CHECKSUM
+    udp_setflags(stream_lwip_pcb, udp_flags(stream_lwip_pcb) | UDP_FLAGS_NOCHKSUM);
+#endif
+
+    udp_recv(stream_lwip_pcb, stream_lwip_recv, NULL);
+
+    sys_timeout(STREAM_LWIP_POLL_MS, stream_lwip_timer, NULL);
+}
+
+uint8_t *stream_stack_slot(uint8_t slot) {
+    return stream_lwip_slots[slot].mem + LWIP_MEM_ALIGN_SIZE(PBUF_TRANSPORT);
+}
+
+enum stream_send stream_stack_send(uint8_t slot, uint16_t len, const uint8_t addr[4], uint16_t port) {
+    struct stream_lwip_slot *s = &stream_lwip_slots[slot];
+    ip_addr_t dst;
+
+    if (stream_lwip_pcb == NULL) {
+        return STREAM_SEND_FAILED;
+    }
+
+    struct pbuf *p = pbuf_alloced_custom(PBUF_TRANSPORT, len, PBUF_RAM, &s->pc, s->mem, sizeof(s->mem));
+
+    IP_ADDR4(&dst, addr[0], addr[1], addr[2], addr[3]);
+
+    // the driver takes a reference until the frame is out, ARP one while it resolves
+    err_t err = udp_sendto(stream_lwip_pcb, p, &dst, port);
+
+    // on an error nothing else holds it, this free is the last and stream.c keeps the slot
+    s->taken = (err == ERR_OK);
+    pbuf_free(p);
+
+    if (err == ERR_OK) {
+        return STREAM_SEND_TAKEN;
+    }
+
+    return (err == ERR_MEM || err == ERR_BUF) ? STREAM_SEND_LATER : STREAM_SEND_FAILED;
+}
+
+void stream_stack_poll(void) {
+    // lwIP calls back, there is nothing to poll
+}
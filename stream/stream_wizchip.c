@@ -0,0 +1,203 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// stream.h on the ioLibrary, polled from stream_poll() in main's loop.
+//
+// On the W5100S a slot is written into the socket's TX buffer past Sn_TX_WR by an
+// asynchronous DMA burst, WIZCHIP_WRITE_BUF_ASYNC(), and the slot is free once the burst
+// is done. The SEND that makes it a datagram waits for the SENDOK of the one before, so the
+// next datagram crosses the SPI bus while the last one goes out on the wire. sendto() would
+// wait for each SENDOK in turn. The other chips use sendto().
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "wizchip_conf.h"
+#include "socket.h"
+
+#include "stream.h"
+
+// the socket of the stream, give it the whole TX buffer the chip has
+#ifndef STREAM_WIZCHIP_SOCKET
+#define STREAM_WIZCHIP_SOCKET 0
+#endif
+
+// no slot is used until stream_stack_send() takes one
+#define STREAM_WIZCHIP_NONE 0xff
+
+static uint8_t stream_wizchip_slots[STREAM_SLOTS][STREAM_DATAGRAM_MAX] __attribute__((aligned(4)));
+
+// the hosts' requests, only their address matters
+static uint8_t stream_wizchip_request[16];
+
+#if _WIZCHIP_ == W5100S
+static struct {
+    volatile uint8_t writing; // slot of the burst in flight
+    volatile bool written;    // a datagram is in the TX buffer past Sn_TX_WR, not sent
+    bool sending;             // SEND issued, no SENDOK yet
+    uint16_t tx_wr;           // Sn_TX_WR as last written
+    uint16_t len;             // of the datagram written
+    uint16_t first;           // its bytes before the end of the TX buffer
+    uint8_t addr[4];          // Sn_DIPR and Sn_DPORT as last written
+    uint16_t port;
+} stream_wizchip = { .writing = STREAM_WIZCHIP_NONE };
+
+// from the DMA interrupt or, with blocking bursts, before WIZCHIP_WRITE_BUF_ASYNC() returns
+static void stream_wizchip_write_done(void *arg) {
+    uint8_t slot = stream_wizchip.writing;
+
+    // what wrapped goes to the start of the TX buffer
+    if (arg == NULL && stream_wizchip.first < stream_wizchip.len) {
+        const wiz_SnBuf *sb = wiz_sn_buf(STREAM_WIZCHIP_SOCKET);
+
+        WIZCHIP_WRITE_BUF_ASYNC(sb->txbase, stream_wizchip_slots[slot] + stream_wizchip.first,
+                                stream_wizchip.len - stream_wizchip.first, stream_wizchip_write_done, (void *)1);
+        return;
+    }
+
+    stream_wizchip.writing = STREAM_WIZCHIP_NONE;
+    stream_wizchip.written = true;
+    stream_slot_sent(slot);
+}
+
+// the datagram written becomes the next SEND once the last one is out
+static void stream_wizchip_send_written(void) {
+    uint8_t sn = STREAM_WIZCHIP_SOCKET;
+
+    // a register access would wait for the burst
+    if (stream_wizchip.writing != STREAM_WIZCHIP_NONE) {
+        return;
+    }
+
+    if (stream_wizchip.sending) {
+        uint8_t ir = getSn_IR(sn);
+
+        if (ir & Sn_IR_TIMEOUT) {
+            // ARP found no host, the datagram is lost
+            sockevent_clear(sn, Sn_IR_TIMEOUT);
+            stream_count_error();
+            stream_wizchip.sending = false;
+        } else if (ir & Sn_IR_SENDOK) {
+            sockevent_clear(sn, Sn_IR_SENDOK);
+            stream_wizchip.sending = false;
+        } else {
+            return;
+        }
+    }
+
+    if (!stream_wizchip.written) {
+        return;
+    }
+
+    stream_wizchip.tx_wr += stream_wizchip.len;
+    stream_wizchip.written = false;
+
+    setSn_TX_WR(sn, stream_wizchip.tx_wr);
+    setSn_CR(sn, Sn_CR_SEND);
+    while (getSn_CR(sn))
+        tight_loop_contents();
+
+    stream_wizchip.sending = true;
+}
+
+enum stream_send stream_stack_send(uint8_t slot, uint16_t len, const uint8_t addr[4], uint16_t port) {
+    uint8_t sn = STREAM_WIZCHIP_SOCKET;
+    const wiz_SnBuf *sb = wiz_sn_buf(sn);
+
+    stream_wizchip_send_written();
+
+    // one datagram past Sn_TX_WR at a time, it goes whole into the free space
+    if (stream_wizchip.writing != STREAM_WIZCHIP_NONE || stream_wizchip.written || getSn_TX_FSR(sn) < len) {
+        return STREAM_SEND_LATER;
+    }
+
+    if (memcmp(addr, stream_wizchip.addr, 4) != 0 || port != stream_wizchip.port) {
+        // the destination of a SEND in progress stays as it is
+        if (stream_wizchip.sending) {
+            return STREAM_SEND_LATER;
+        }
+
+        memcpy(stream_wizchip.addr, addr, 4);
+        stream_wizchip.port = port;
+        setSn_DIPR(sn, stream_wizchip.addr);
+        setSn_DPORT(sn, port);
+    }
+
+    uint16_t offset = stream_wizchip.tx_wr & (sb->txmax - 1);
+
+    stream_wizchip.len = len;
+    stream_wizchip.first = (len < sb->txmax - offset) ? len : sb->txmax - offset;
+    stream_wizchip.writing = slot;
+
+    WIZCHIP_WRITE_BUF_ASYNC(sb->txbase + offset, stream_wizchip_slots[slot], stream_wizchip.first,
+                            stream_wizchip_write_done, NULL);
+
+    // sent at once when the burst is already done, blocking without the async callbacks
+    stream_wizchip_send_written();
+
+    return STREAM_SEND_TAKEN;
+}
+#else
+enum stream_send stream_stack_send(uint8_t slot, uint16_t len, const uint8_t addr[4], uint16_t port) {
+    uint8_t sn = STREAM_WIZCHIP_SOCKET;
+
+    if (getSn_TX_FSR(sn) < len) {
+        return STREAM_SEND_LATER;
+    }
+
+    int32_t ret = sendto(sn, stream_wizchip_slots[slot], len, (uint8_t *)addr, port);
+
+    if (ret == SOCK_BUSY) {
+        return STREAM_SEND_LATER;
+    }
+
+    if (ret < 0) {
+        return STREAM_SEND_FAILED;
+    }
+
+    // the bytes are in the chip
+    stream_slot_sent(slot);
+
+    return STREAM_SEND_TAKEN;
+}
+#endif
+
+void stream_stack_start(uint16_t port) {
+    uint8_t sn = STREAM_WIZCHIP_SOCKET;
+
+    if (socket(sn, Sn_MR_UDP, port, SF_IO_NONBLOCK) != sn) {
+        return;
+    }
+
+#if _WIZCHIP_ == W5100S
+    stream_wizchip.tx_wr = getSn_TX_WR(sn);
+#endif
+}
+
+uint8_t *stream_stack_slot(uint8_t slot) {
+    return stream_wizchip_slots[slot];
+}
+
+void stream_stack_poll(void) {
+    uint8_t sn = STREAM_WIZCHIP_SOCKET;
+    uint8_t addr[4];
+    uint16_t port;
+
+#if _WIZCHIP_ == W5100S
+    if (stream_wizchip.writing != STREAM_WIZCHIP_NONE) {
+        return;
+    }
+
+    stream_wizchip_send_written();
+#endif
+
+    while (getSn_RX_RSR(sn) != 0) {
+        if (recvfrom(sn, stream_wizchip_request, sizeof(stream_wizchip_request), addr, &port) < 0) {
+            return;
+        }
+
+        stream_subscribe(addr, port);
+    }
+}
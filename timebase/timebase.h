@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _TIMEBASE_H_
+#define _TIMEBASE_H_
+
+#include <stdint.h>
+
+#include "pico.h"
+#include "hardware/timer.h"
+
+// Time of both firmwares: lwIP's sys_now(), the ioLibrary ports' ms clocks, the drivers'
+// stats and profiles and the trace ring all read the 1 us timer through these, so their
+// times compare.
+//
+// The timer's raw registers are read, not the latched TIMELR/TIMEHR pair, so either core
+// and any IRQ handler can read it at the same time. ms come from the 64-bit count with
+// 32-bit arithmetic, which the M0+ and the SIO divider do in a few cycles, where
+// to_ms_since_boot(get_absolute_time()) divides 64 bits in software. They equal its low
+// 32 bits.
+
+// us since boot, wrapping every 71.6 minutes: intervals up to that are `now - start`
+static inline uint32_t timebase_us(void) {
+    return timer_hw->timerawl;
+}
+
+// us since boot
+static inline uint64_t timebase_us_64(void) {
+    uint32_t hi = timer_hw->timerawh;
+    uint32_t lo;
+
+    // the low word wrapped between the reads, read both again
+    while (1) {
+        lo = timer_hw->timerawl;
+
+        uint32_t next_hi = timer_hw->timerawh;
+
+        if (hi == next_hi) {
+            break;
+        }
+
+        hi = next_hi;
+    }
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// ms since boot, wrapping every 49.7 days. With 2^32 = 4294967 * 1000 + 296,
+// (hi * 2^32 + lo) / 1000 = hi * 4294967 + lo / 1000 + (hi * 296 + lo % 1000) / 1000,
+// and hi * 296 stays in 32 bits for 1900 years
+static inline uint32_t timebase_ms(void) {
+    uint64_t us = timebase_us_64();
+    uint32_t hi = (uint32_t)(us >> 32);
+    uint32_t lo = (uint32_t)us;
+
+    return hi * 4294967u + lo / 1000u + (hi * 296u + lo % 1000u) / 1000u;
+}
+
+#endif
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+#
+# Comparator of two benchmark runs of the W5100S and LAN8720 firmwares. Reads the
+# pico-bench/1 records of each, the "result" lines the bench firmwares print at the end of
+# a scenario and the --result file of loopback_bench.py, pairs them by source, board and
+# scenario, and prints the change of every metric. Python 3.7 or later, standard library
+# only.
+#
+# usage: bench_compare.py before.log after.log
+# usage: bench_compare.py before.jsonl after.jsonl --threshold 3 --key build
+#
+# A record is one line of JSON with "schema": "pico-bench/1", anything before its "{" is
+# skipped, so a USB stdio capture of the board is read as it is:
+#   board, build, clk_sys_hz, clk_peri_hz, options   what ran, the options "key=value" pairs
+#   scenario, duration_ms                             what was measured
+#   rx_kbps, tx_kbps, ops_per_s, errors               the totals
+#   latency_us {count, min, mean, p50, p99, p999, max} or null
+#   cpu_pct                                           busy share of the network core, or null
+#   cpu_split {class: share, ...}                     its time by class, where the firmware
+#                                                     splits it, not compared
+# kbps_per_cpu, rx and tx kbit/s per percent busy, is derived from them: the throughput
+# a core's worth of CPU buys, what hardware is planned by.
+# A run holding several records of a pair is taken at their median.
+#
+# A change of more than --threshold percent (5) the wrong way is a regression: throughput
+# and operations down, latency and CPU use up, and any error more. The exit status is 1
+# when there is one, for scripts and CI.
+
+import argparse
+import json
+import statistics
+import sys
+
+SCHEMA = "pico-bench/1"
+
+# metric, the record's value, whether more is better
+METRICS = (
+    ("rx_kbps", lambda r: r.get("rx_kbps"), True),
+    ("tx_kbps", lambda r: r.get("tx_kbps"), True),
+    ("ops_per_s", lambda r: r.get("ops_per_s"), True),
+    ("p50_us", lambda r: (r.get("latency_us") or {}).get("p50"), False),
+    ("p99_us", lambda r: (r.get("latency_us") or {}).get("p99"), False),
+    ("p999_us", lambda r: (r.get("latency_us") or {}).get("p999"), False),
+    ("cpu_pct", lambda r: r.get("cpu_pct"), False),
+    ("kbps_per_cpu", lambda r: kbps_per_cpu(r), True),
+    ("errors", lambda r: r.get("errors"), False),
+)
+
+KEYS = ("source", "board", "scenario")
+
+
+def kbps_per_cpu(record):
+    """rx and tx kbit/s per percent of CPU, None without a CPU figure"""
+    cpu = record.get("cpu_pct")
+    if not cpu:
+        return None
+    return round(((record.get("rx_kbps") or 0) + (record.get("tx_kbps") or 0)) / cpu, 1)
+
+
+def load(path):
+    """The pico-bench/1 records of a file, other lines are skipped"""
+    records = []
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            start = line.find("{")
+            if start < 0:
+                continue
+            try:
+                record = json.loads(line[start:])
+            except ValueError:
+                continue
+            if isinstance(record, dict) and record.get("schema") == SCHEMA:
+                records.append(record)
+    return records
+
+
+def group(records, keys):
+    runs = {}
+    for r in records:
+        runs.setdefault(tuple(str(r.get(k, "")) for k in keys), []).append(r)
+    return runs
+
+
+def median(records, value):
+    values = [v for v in (value(r) for r in records) if v is not None]
+    return statistics.median(values) if values else None
+
+
+def compare(before, after, threshold):
+    """Lines of the metrics of one pair, and whether one of them regressed"""
+    lines = []
+    regressed = False
+    for name, value, higher_better in METRICS:
+        b = median(before, value)
+        a = median(after, value)
+        if b is None or a is None:
+            continue
+        if name == "errors":
+            worse = a > b
+            change = "" if b == 0 else "%+.1f%%" % ((a - b) * 100.0 / b)
+        else:
+            delta = (a - b) * 100.0 / b if b else (0.0 if a == b else float("inf"))
+            worse = (delta < -threshold) if higher_better else (delta > threshold)
+            change = "%+.1f%%" % delta
+        flag = "REGRESSION" if worse else ""
+        regressed |= worse
+        lines.append("  %-10s %12s %12s %9s %s" % (name, fmt(b), fmt(a), change, flag))
+    return lines, regressed
+
+
+def fmt(v):
+    return ("%.1f" % v) if isinstance(v, float) and not v.is_integer() else str(int(v))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="compare two benchmark runs, pico-bench/1 records")
+    parser.add_argument("before", help="records of the baseline, a board log or a --result file")
+    parser.add_argument("after", help="records of the run to check")
+    parser.add_argument("--threshold", type=float, default=5.0, help="percent a metric may get worse (default 5)")
+    parser.add_argument("--key", action="append", default=[], help="also pair on this field, e.g. build or options")
+    args = parser.parse_args()
+
+    keys = KEYS + tuple(args.key)
+    before = group(load(args.before), keys)
+    after = group(load(args.after), keys)
+
+    if not before or not after:
+        print("no %s records in %s" % (SCHEMA, args.before if not before else args.after), file=sys.stderr)
+        return 2
+
+    regressions = 0
+    for key in sorted(set(before) | set(after)):
+        label = " ".join(k for k in key if k)
+        if key not in before or key not in after:
+            print("%s: only %s" % (label, "after" if key in after else "before"))
+            continue
+        lines, regressed = compare(before[key], after[key], args.threshold)
+        print("%s: %d before, %d after%s" % (label, len(before[key]), len(after[key]), ", REGRESSED" if regressed else ""))
+        print("  %-10s %12s %12s %9s" % ("metric", "before", "after", "change"))
+        for line in lines:
+            print(line.rstrip())
+        regressions += regressed
+
+    if regressions:
+        print("%d regressed" % regressions)
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+#
+# Receiver of the bulk transfers of the W5100S firmware, Internet/BULK/bulk.h of its ioLibrary.
+#
+# Asks the board for a source on UDP port 5011, takes the chunks as they come, in any
+# order, and every --status-ms reports the chunks it has in order and asks again for the
+# missing ones. A chunk is asked for once when a later one arrives, and again only when
+# --holdoff-ms passes without it. Prints the transfer as JSON. Python 3.7 or later,
+# standard library only.
+#
+# usage: bulk_recv.py 192.168.1.15 --source 0 --check counter
+# usage: bulk_recv.py 192.168.1.15 --source 1 -o firmware.bin
+#
+# --rate caps the board's rate in kbit/s, headers included. The board starts there and
+# backs off by a quarter for each status that asks for chunks again. The exit status is 1
+# when the transfer fails or a --check finds a wrong byte.
+
+import argparse
+import json
+import os
+import select
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x42554C4B
+HEAD = struct.Struct(">IBBHIII")
+CHUNK_SIZE = 1024
+WINDOW = 128
+
+REQ, DATA, STATUS, END = 1, 2, 3, 4
+END_CODES = {0: "ok", 1: "cancel", 2: "no such source", 3: "busy", 4: "timeout", 5: "read error"}
+
+
+class Transfer:
+    """Chunks of one transfer, received and asked for again"""
+
+    def __init__(self, size):
+        self.size = size
+        self.chunks = size // CHUNK_SIZE + 1
+        self.data = bytearray(size)
+        self.have = bytearray(self.chunks)
+        self.ack = 0
+        self.high = 0
+        self.asked = {}
+        self.received = 0
+        self.duplicates = 0
+        self.nacks = 0
+
+    def put(self, seq, payload):
+        if seq >= self.chunks:
+            return
+        if self.have[seq]:
+            self.duplicates += 1
+            return
+        offset = seq * CHUNK_SIZE
+        self.data[offset:offset + len(payload)] = payload
+        self.have[seq] = 1
+        self.received += 1
+        self.asked.pop(seq, None)
+        self.high = max(self.high, seq + 1)
+        while self.ack < self.chunks and self.have[self.ack]:
+            self.ack += 1
+
+    def done(self):
+        return self.ack == self.chunks
+
+    def missing(self, now, holdoff, idle):
+        """the bitmap of the chunks to send again, the tail too once the data stops"""
+        words = [0] * (WINDOW // 32)
+        end = min(self.chunks, self.ack + WINDOW)
+        if not idle:
+            end = min(end, self.high)
+        for seq in range(self.ack, end):
+            if self.have[seq] or now - self.asked.get(seq, -holdoff) < holdoff:
+                continue
+            self.asked[seq] = now
+            self.nacks += 1
+            bit = seq - self.ack
+            words[bit // 32] |= 1 << (bit % 32)
+        return struct.pack(">%dI" % len(words), *words)
+
+
+def message(kind, source, session, seq=0, arg=0, payload=b""):
+    return HEAD.pack(MAGIC, kind, source, 0, session, seq, arg) + payload
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Receive a bulk transfer from the W5100S firmware")
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=5011)
+    parser.add_argument("--source", type=int, default=0, help="0 the counter pattern, 1 the firmware image")
+    parser.add_argument("--rate", type=int, default=0, help="kbit/s the board may send at, 0 for its own limit")
+    parser.add_argument("-o", "--output", help="file the transfer is written to")
+    parser.add_argument("--check", choices=("counter",), help="check the bytes of the pattern source")
+    parser.add_argument("--status-ms", type=float, default=10)
+    parser.add_argument("--holdoff-ms", type=float, default=30)
+    parser.add_argument("--timeout", type=float, default=5, help="seconds without a datagram before giving up")
+    args = parser.parse_args()
+
+    session = struct.unpack(">I", os.urandom(4))[0]
+    addr = (socket.gethostbyname(args.host), args.port)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+
+    status_s = args.status_ms / 1000
+    holdoff_s = args.holdoff_ms / 1000
+    transfer = None
+    error = None
+    start = time.monotonic()
+    last_rx = start
+    last_status = 0
+    last_req = 0
+
+    while True:
+        now = time.monotonic()
+
+        if transfer is None and now - last_req >= 0.2:
+            # the REQ again until the first DATA, the board takes a repeated one as the same
+            sock.sendto(message(REQ, args.source, session, 0, args.rate), addr)
+            last_req = now
+
+        if transfer is not None and now - last_status >= status_s:
+            idle = now - last_rx >= holdoff_s
+            sock.sendto(message(STATUS, args.source, session, transfer.ack, 0,
+                                transfer.missing(now, holdoff_s, idle)), addr)
+            last_status = now
+            if transfer.done():
+                break
+
+        if now - last_rx >= args.timeout:
+            error = "timeout"
+            break
+
+        readable, _, _ = select.select([sock], [], [], status_s)
+        if not readable:
+            continue
+
+        # everything queued before the next status
+        while True:
+            try:
+                msg, _ = sock.recvfrom(65536, socket.MSG_DONTWAIT)
+            except BlockingIOError:
+                break
+            if len(msg) < HEAD.size:
+                continue
+            magic, kind, _, _, msg_session, seq, arg = HEAD.unpack_from(msg)
+            if magic != MAGIC or msg_session != session:
+                continue
+            last_rx = time.monotonic()
+            if kind == DATA:
+                if transfer is None:
+                    transfer = Transfer(arg)
+                transfer.put(seq, msg[HEAD.size:])
+            elif kind == END and arg != 0:
+                error = END_CODES.get(arg, str(arg))
+                break
+        if error:
+            break
+
+    elapsed = time.monotonic() - start
+    result = {
+        "source": args.source,
+        "bytes": transfer.size if transfer else 0,
+        "seconds": round(elapsed, 3),
+        "kbps": round(transfer.size * 8 / elapsed / 1000) if transfer and transfer.done() else 0,
+        "datagrams": transfer.received if transfer else 0,
+        "duplicates": transfer.duplicates if transfer else 0,
+        "nacks": transfer.nacks if transfer else 0,
+        "error": error,
+    }
+
+    if transfer and transfer.done():
+        if args.check == "counter":
+            result["check_errors"] = sum(1 for i, b in enumerate(transfer.data) if b != i & 0xff)
+            if result["check_errors"]:
+                error = "check"
+        if args.output:
+            with open(args.output, "wb") as f:
+                f.write(transfer.data)
+    else:
+        # the board stops at once rather than at its timeout
+        sock.sendto(message(END, args.source, session, 0, 1), addr)
+
+    print(json.dumps(result))
+    return 1 if error else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
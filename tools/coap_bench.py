@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+#
+# Benchmark of the CoAP server of both firmwares, examples/coap of pico-w5100s-loopback and
+# pico-lan8720-loopback, the resources of coap/coap_demo.h, against the HTTP server of the
+# firmware on the same file.
+#
+# --pollers clients each poll --path as fast as they get answers, for --seconds: a CON GET
+# and its piggybacked ACK over CoAP, a connection and a GET over HTTP/1.0 (--http-port 0
+# skips it, w5x00_coap has no HTTP server). Each response is checked against the first.
+# Prints the requests per second and the latency percentiles of both as JSON, then the
+# time of a block-wise GET of coap://host/blob and the server's counters of
+# coap://host/stats. Python 3.7 or later, standard library only.
+#
+# usage: coap_bench.py 192.168.1.15
+# usage: coap_bench.py 192.168.1.15 --pollers 1 8 --path status.json --seconds 5
+#
+# The exit status is 1 when a response was wrong or did not come.
+
+import argparse
+import json
+import os
+import selectors
+import socket
+import statistics
+import struct
+import sys
+import threading
+import time
+
+CON, NON, ACK, RST = 0, 1, 2, 3
+GET = 1
+CONTENT = 0x45
+
+OPT_URI_PATH = 11
+OPT_BLOCK2 = 23
+
+TIMEOUT_S = 2.0
+CHUNK = 4096
+
+
+def option(number, last, value):
+    delta = number - last
+    length = len(value)
+    head = b""
+    ext = b""
+    for v in (delta, length):
+        if v < 13:
+            head += bytes([v])
+        elif v < 269:
+            head += bytes([13])
+            ext += bytes([v - 13])
+        else:
+            head += bytes([14])
+            ext += struct.pack(">H", v - 269)
+    return bytes([(head[0] << 4) | head[1]]) + ext + value
+
+
+def uint(v):
+    return v.to_bytes((v.bit_length() + 7) // 8, "big")
+
+
+def request(mid, token, path, block2=None):
+    msg = struct.pack(">BBH", 0x40 | (CON << 4) | len(token), GET, mid) + token
+    last = 0
+    for segment in path.strip("/").split("/"):
+        msg += option(OPT_URI_PATH, last, segment.encode())
+        last = OPT_URI_PATH
+    if block2 is not None:
+        msg += option(OPT_BLOCK2, last, uint(block2))
+    return msg
+
+
+def parse(msg):
+    if len(msg) < 4 or msg[0] >> 6 != 1:
+        return None
+    tkl = msg[0] & 0x0F
+    out = {"type": (msg[0] >> 4) & 3, "code": msg[1], "mid": struct.unpack_from(">H", msg, 2)[0],
+           "token": msg[4:4 + tkl], "options": {}, "payload": b""}
+    i = 4 + tkl
+    number = 0
+    while i < len(msg):
+        if msg[i] == 0xFF:
+            out["payload"] = msg[i + 1:]
+            break
+        delta, length = msg[i] >> 4, msg[i] & 0x0F
+        i += 1
+        if delta == 13:
+            delta, i = 13 + msg[i], i + 1
+        elif delta == 14:
+            delta, i = 269 + struct.unpack_from(">H", msg, i)[0], i + 2
+        if length == 13:
+            length, i = 13 + msg[i], i + 1
+        elif length == 14:
+            length, i = 269 + struct.unpack_from(">H", msg, i)[0], i + 2
+        number += delta
+        out["options"][number] = msg[i:i + length]
+        i += length
+    return out
+
+
+def percentiles(name, times, elapsed, errors):
+    times.sort()
+    if not times:
+        return {"protocol": name, "requests": 0, "errors": errors}
+    return {
+        "protocol": name,
+        "requests": len(times),
+        "errors": errors,
+        "req_per_s": round(len(times) / elapsed),
+        "median_ms": round(statistics.median(times), 3),
+        "p99_ms": round(times[min(len(times) - 1, len(times) * 99 // 100)], 3),
+        "max_ms": round(times[-1], 3),
+    }
+
+
+def coap_run(host, port, path, pollers, seconds):
+    sel = selectors.DefaultSelector()
+    socks = []
+    pending = {}
+    mid = int.from_bytes(os.urandom(2), "big")
+    times = []
+    errors = 0
+    expect = None
+
+    def send(sock):
+        nonlocal mid
+        mid = (mid + 1) & 0xFFFF
+        token = os.urandom(4)
+        pending[sock] = (mid, token, time.monotonic())
+        sock.send(request(mid, token, path))
+
+    for _ in range(pollers):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.connect((host, port))
+        sock.setblocking(False)
+        sel.register(sock, selectors.EVENT_READ)
+        socks.append(sock)
+
+    start = time.monotonic()
+    for sock in socks:
+        send(sock)
+
+    try:
+        while pending:
+            events = sel.select(TIMEOUT_S)
+            if not events:
+                raise socket.timeout("no CoAP response in %.0f s" % TIMEOUT_S)
+            for key, _ in events:
+                sock = key.fileobj
+                msg = parse(sock.recv(CHUNK))
+                now = time.monotonic()
+                if msg is None or sock not in pending or msg["mid"] != pending[sock][0]:
+                    continue
+                _, token, sent = pending.pop(sock)
+                if expect is None:
+                    expect = msg["payload"]
+                if msg["type"] != ACK or msg["token"] != token or msg["code"] != CONTENT or msg["payload"] != expect:
+                    errors += 1
+                times.append((now - sent) * 1000)
+                if now - start < seconds:
+                    send(sock)
+    finally:
+        for sock in socks:
+            sock.close()
+
+    return percentiles("coap", times, time.monotonic() - start, errors), expect
+
+
+def http_get(host, port, path):
+    with socket.create_connection((host, port), timeout=TIMEOUT_S) as sock:
+        sock.sendall(("GET /%s HTTP/1.0\r\nHost: %s\r\n\r\n" % (path.strip("/"), host)).encode())
+        data = b""
+        while True:
+            chunk = sock.recv(CHUNK)
+            if not chunk:
+                break
+            data += chunk
+    head, _, body = data.partition(b"\r\n\r\n")
+    return head.startswith(b"HTTP/1.") and b" 200 " in head.split(b"\r\n")[0], body
+
+
+def http_run(host, port, path, pollers, seconds, expect):
+    times = []
+    errors = [0]
+    lock = threading.Lock()
+    start = time.monotonic()
+
+    def poller():
+        while time.monotonic() - start < seconds:
+            sent = time.monotonic()
+            try:
+                ok, body = http_get(host, port, path)
+            except OSError:
+                ok, body = False, None
+            done = time.monotonic()
+            with lock:
+                if not ok or (expect is not None and body != expect):
+                    errors[0] += 1
+                else:
+                    times.append((done - sent) * 1000)
+
+    threads = [threading.Thread(target=poller) for _ in range(pollers)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    return percentiles("http", times, time.monotonic() - start, errors[0])
+
+
+def coap_get(sock, path, block2=None):
+    mid = int.from_bytes(os.urandom(2), "big")
+    token = os.urandom(4)
+    sock.send(request(mid, token, path, block2))
+    while True:
+        msg = parse(sock.recv(CHUNK))
+        if msg is not None and msg["mid"] == mid and msg["token"] == token:
+            return msg
+
+
+def blob(host, port):
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+        sock.connect((host, port))
+        sock.settimeout(TIMEOUT_S)
+        data = b""
+        num = 0
+        start = time.monotonic()
+        while True:
+            msg = coap_get(sock, "blob", (num << 4) | 6)
+            if msg["code"] != CONTENT:
+                return None
+            data += msg["payload"]
+            value = int.from_bytes(msg["options"].get(OPT_BLOCK2, b""), "big")
+            if not value & 0x08:
+                break
+            num += 1
+        elapsed = time.monotonic() - start
+        ok = all(b == i & 0xFF for i, b in enumerate(data))
+        return {"bytes": len(data), "blocks": num + 1, "ms": round(elapsed * 1000, 3), "ok": ok}
+
+
+def stats(host, port):
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+        sock.connect((host, port))
+        sock.settimeout(TIMEOUT_S)
+        msg = coap_get(sock, "stats")
+        return json.loads(msg["payload"]) if msg["code"] == CONTENT else None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the CoAP server of both firmwares against their HTTP server")
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=5683)
+    parser.add_argument("--http-port", type=int, default=80, help="0: CoAP only")
+    parser.add_argument("--path", default="status.json", help="a file of the HTTP content, or a resource")
+    parser.add_argument("--pollers", type=int, nargs="+", default=[1, 8])
+    parser.add_argument("--seconds", type=float, default=3)
+    args = parser.parse_args()
+
+    results = []
+    try:
+        for pollers in args.pollers:
+            run, expect = coap_run(args.host, args.port, args.path, pollers, args.seconds)
+            run["pollers"] = pollers
+            results.append(run)
+            if args.http_port:
+                run = http_run(args.host, args.http_port, args.path, pollers, args.seconds, expect)
+                run["pollers"] = pollers
+                results.append(run)
+        block = blob(args.host, args.port)
+        server = stats(args.host, args.port)
+    except (socket.timeout, OSError) as e:
+        print(json.dumps({"error": str(e), "runs": results}))
+        return 1
+
+    print(json.dumps({"runs": results, "blob": block, "server": server}))
+
+    ok = all(r["requests"] and not r["errors"] for r in results) and block is not None and block["ok"]
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
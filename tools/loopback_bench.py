@@ -0,0 +1,411 @@
+#!/usr/bin/env python3
+#
+# Loopback benchmark client for the W5100S and LAN8720 firmwares, in place of AX2.exe.
+#
+# Opens N TCP connections to the echo port (5000), streams a payload pattern on each,
+# checks that every byte comes back unchanged and in order, and prints the throughput,
+# the round trip times of the messages and the error counts as JSON. Python 3.7 or
+# later, standard library only, so it runs the same on Linux, macOS and Windows.
+#
+# usage: loopback_bench.py 192.168.1.15 -c 4 -t 10 -s 1024 -w 4 --pattern counter
+#
+# The RTT of a message is the time from its write to the arrival of its last echoed
+# byte. With a window of one message that is the plain echo latency, larger windows
+# keep several messages in flight and measure throughput with queueing included.
+#
+# With --connect every connection is opened, echoes -n messages (1 by default) and is
+# closed again, over and over, for the rate of connections the server keeps up with:
+#
+# usage: loopback_bench.py 192.168.1.15 --connect -c 4 -t 10 -s 64
+#
+# With --control-port a UDP datagram also goes to that port every --control-interval ms
+# while the TCP connections run, control traffic for the board to time on its own, as
+# pico_rmii_ethernet_bench_priority does in the "prio" lines of its reports:
+#
+# usage: loopback_bench.py 192.168.1.15 -p 5009 -c 4 -w 8 --control-port 5008
+#
+# With --result the run is also appended to a file as a pico-bench/1 record, one line of
+# JSON as the board prints at the end of a scenario, for tools/bench_compare.py:
+#
+# usage: loopback_bench.py 192.168.1.15 -p 5002 -s 512 --board lan8720 --result after.jsonl
+# The exit status is 1 when any error is counted, for scripts and CI.
+
+import argparse
+import asyncio
+import collections
+import json
+import random
+import socket
+import sys
+import time
+
+PATTERNS = ("zeros", "ones", "counter", "ascii", "random")
+
+
+class Pattern:
+    """Endless byte stream of one connection, the same for the sender and the checker"""
+
+    def __init__(self, name, seed):
+        self.name = name
+        self.offset = 0
+        self.rng = random.Random(seed)
+        if name == "zeros":
+            self.cycle = bytes(256)
+        elif name == "ones":
+            self.cycle = b"\xff" * 256
+        elif name == "counter":
+            self.cycle = bytes(range(256))
+        elif name == "ascii":
+            # the printable characters of a chargen (RFC 864) line
+            self.cycle = bytes(range(0x20, 0x7f))
+        else:
+            self.cycle = None
+
+    def next(self, size):
+        if self.cycle is None:
+            data = self.rng.getrandbits(size * 8).to_bytes(size, "little")
+        else:
+            start = self.offset % len(self.cycle)
+            repeat = (start + size + len(self.cycle) - 1) // len(self.cycle)
+            data = (self.cycle * repeat)[start:start + size]
+        self.offset += size
+        return data
+
+
+class Connection:
+    def __init__(self, index):
+        self.index = index
+        self.tx_bytes = 0
+        self.rx_bytes = 0
+        self.messages = 0
+        self.rtt_ns = []
+        self.connect_ns = []  # --connect: open to established
+        self.cycle_ns = []    # --connect: open to closed, messages included
+        self.errors = collections.Counter()
+        self.first_mismatch = None
+        self.elapsed_s = 0.0
+
+
+async def run_connection(conn, args, start_at, stop_at):
+    pattern = Pattern(args.pattern, args.seed + conn.index)
+    expected = bytearray()
+    inflight = collections.deque()  # (end offset, time written)
+    window = args.size * args.window
+
+    try:
+        reader, writer = await asyncio.wait_for(asyncio.open_connection(args.host, args.port), args.timeout)
+    except (OSError, asyncio.TimeoutError):
+        conn.errors["connect"] += 1
+        return
+
+    sock = writer.get_extra_info("socket")
+    if sock is not None:
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    # all the connections are up before the clock starts
+    await asyncio.sleep(max(0.0, start_at - time.monotonic()))
+    begin = time.perf_counter_ns()
+
+    try:
+        while True:
+            sending = time.monotonic() < stop_at and (args.messages == 0 or conn.messages < args.messages)
+            if not sending and conn.rx_bytes == conn.tx_bytes:
+                break
+
+            while sending and conn.tx_bytes - conn.rx_bytes < window:
+                data = pattern.next(args.size)
+                writer.write(data)
+                expected += data
+                conn.tx_bytes += len(data)
+                conn.messages += 1
+                inflight.append((conn.tx_bytes, time.perf_counter_ns()))
+                sending = args.messages == 0 or conn.messages < args.messages
+            await writer.drain()
+
+            data = await asyncio.wait_for(reader.read(65536), args.timeout)
+            now = time.perf_counter_ns()
+            if not data:
+                conn.errors["closed"] += 1
+                break
+            if len(data) > len(expected):
+                conn.errors["excess_bytes"] += len(data) - len(expected)
+                data = data[:len(expected)]
+
+            if expected[:len(data)] != data:
+                bad = sum(1 for a, b in zip(expected, data) if a != b)
+                conn.errors["mismatch_bytes"] += bad
+                if conn.first_mismatch is None:
+                    conn.first_mismatch = conn.rx_bytes + next(i for i, (a, b) in enumerate(zip(expected, data)) if a != b)
+            del expected[:len(data)]
+            conn.rx_bytes += len(data)
+
+            while inflight and inflight[0][0] <= conn.rx_bytes:
+                conn.rtt_ns.append(now - inflight.popleft()[1])
+    except asyncio.TimeoutError:
+        conn.errors["timeout"] += 1
+    except (ConnectionError, OSError):
+        conn.errors["reset"] += 1
+    finally:
+        conn.elapsed_s = (time.perf_counter_ns() - begin) / 1e9
+        writer.close()
+        try:
+            await writer.wait_closed()
+        except (ConnectionError, OSError, AttributeError):
+            pass
+
+
+async def run_connect_cycles(conn, args, start_at, stop_at):
+    """--connect: one connection after the other, each echoing a few messages"""
+    pattern = Pattern(args.pattern, args.seed + conn.index)
+    messages = args.messages or 1
+
+    await asyncio.sleep(max(0.0, start_at - time.monotonic()))
+    begin = time.perf_counter_ns()
+
+    while time.monotonic() < stop_at:
+        opened = time.perf_counter_ns()
+        try:
+            reader, writer = await asyncio.wait_for(asyncio.open_connection(args.host, args.port), args.timeout)
+        except (OSError, asyncio.TimeoutError):
+            conn.errors["connect"] += 1
+            continue
+        conn.connect_ns.append(time.perf_counter_ns() - opened)
+
+        sock = writer.get_extra_info("socket")
+        if sock is not None:
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+        try:
+            for _ in range(messages):
+                data = pattern.next(args.size)
+                written = time.perf_counter_ns()
+                writer.write(data)
+                conn.tx_bytes += len(data)
+                conn.messages += 1
+                echoed = await asyncio.wait_for(reader.readexactly(len(data)), args.timeout)
+                conn.rtt_ns.append(time.perf_counter_ns() - written)
+                conn.rx_bytes += len(echoed)
+                if echoed != data:
+                    conn.errors["mismatch_bytes"] += sum(1 for a, b in zip(data, echoed) if a != b)
+            writer.write_eof()
+            # the server closes its side once it has seen ours
+            if await asyncio.wait_for(reader.read(1), args.timeout):
+                conn.errors["excess_bytes"] += 1
+            conn.cycle_ns.append(time.perf_counter_ns() - opened)
+        except asyncio.IncompleteReadError:
+            conn.errors["closed"] += 1
+        except asyncio.TimeoutError:
+            conn.errors["timeout"] += 1
+        except (ConnectionError, OSError):
+            conn.errors["reset"] += 1
+        finally:
+            writer.close()
+            try:
+                await writer.wait_closed()
+            except (ConnectionError, OSError, AttributeError):
+                pass
+
+    conn.elapsed_s = (time.perf_counter_ns() - begin) / 1e9
+
+
+async def run_control(args, start_at, stop_at, control):
+    """--control-port: a small datagram every --control-interval ms, not answered"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setblocking(False)
+    address = (socket.gethostbyname(args.host), args.control_port)
+    interval = args.control_interval / 1000.0
+    seq = 0
+
+    await asyncio.sleep(max(0.0, start_at - time.monotonic()))
+    next_at = time.monotonic()
+
+    try:
+        while time.monotonic() < stop_at:
+            try:
+                sock.sendto(seq.to_bytes(4, "big") + bytes(args.control_size - 4), address)
+                control["sent"] += 1
+            except OSError:
+                control["errors"] += 1
+            seq += 1
+            # on the schedule, not after the last send, a late one doesn't shift the rest
+            next_at += interval
+            await asyncio.sleep(max(0.0, next_at - time.monotonic()))
+    finally:
+        sock.close()
+
+
+def percentile(samples, p):
+    """Nearest rank percentile of sorted samples"""
+    if not samples:
+        return None
+    rank = max(1, int(-(-p * len(samples) // 100)))
+    return samples[min(rank, len(samples)) - 1]
+
+
+def rtt_summary(samples_ns):
+    samples = sorted(s / 1000.0 for s in samples_ns)
+    if not samples:
+        return {"count": 0}
+    return {
+        "count": len(samples),
+        "min": round(samples[0], 1),
+        "mean": round(sum(samples) / len(samples), 1),
+        "p50": round(percentile(samples, 50), 1),
+        "p99": round(percentile(samples, 99), 1),
+        "p999": round(percentile(samples, 99.9), 1),
+        "max": round(samples[-1], 1),
+    }
+
+
+def mbps(nbytes, seconds):
+    return round(nbytes * 8 / seconds / 1e6, 3) if seconds > 0 else 0.0
+
+
+async def run(args):
+    conns = [Connection(i) for i in range(args.connections)]
+    start_at = time.monotonic() + args.ramp
+    stop_at = start_at + args.duration
+    worker = run_connect_cycles if args.connect else run_connection
+    control = {"sent": 0, "errors": 0}
+    tasks = [worker(c, args, start_at, stop_at) for c in conns]
+    if args.control_port:
+        tasks.append(run_control(args, start_at, stop_at, control))
+    await asyncio.gather(*tasks)
+    return conns, control
+
+
+def report(args, conns, control):
+    errors = collections.Counter()
+    for c in conns:
+        errors.update(c.errors)
+    elapsed = max((c.elapsed_s for c in conns), default=0.0)
+    tx = sum(c.tx_bytes for c in conns)
+    rx = sum(c.rx_bytes for c in conns)
+
+    result = {
+        "host": args.host,
+        "port": args.port,
+        "connections": args.connections,
+        "pattern": args.pattern,
+        "message_size": args.size,
+        "window": args.window,
+        "elapsed_s": round(elapsed, 3),
+        "tx_bytes": tx,
+        "rx_bytes": rx,
+        "throughput_mbps": mbps(rx, elapsed),
+        "rtt_us": rtt_summary([s for c in conns for s in c.rtt_ns]),
+        "errors": {k: errors[k] for k in ("connect", "reset", "timeout", "closed", "mismatch_bytes", "excess_bytes")},
+        "per_connection": [
+            {
+                "index": c.index,
+                "tx_bytes": c.tx_bytes,
+                "rx_bytes": c.rx_bytes,
+                "throughput_mbps": mbps(c.rx_bytes, c.elapsed_s),
+                "rtt_us": rtt_summary(c.rtt_ns),
+                "errors": dict(c.errors),
+                "first_mismatch": c.first_mismatch,
+            }
+            for c in conns
+        ],
+    }
+
+    if args.connect:
+        cycles = sum(len(c.cycle_ns) for c in conns)
+        result["connect"] = {
+            "completed": cycles,
+            "per_s": round(cycles / elapsed, 1) if elapsed > 0 else 0.0,
+            "connect_us": rtt_summary([s for c in conns for s in c.connect_ns]),
+            "cycle_us": rtt_summary([s for c in conns for s in c.cycle_ns]),
+        }
+        for c, entry in zip(conns, result["per_connection"]):
+            entry["completed"] = len(c.cycle_ns)
+
+    if args.control_port:
+        result["control"] = {
+            "port": args.control_port,
+            "interval_ms": args.control_interval,
+            "size": args.control_size,
+            "sent": control["sent"],
+            "errors": control["errors"],
+        }
+
+    return result
+
+
+def result_record(args, result, cpu_s):
+    """The run as a pico-bench/1 record, the schema of the board's "result" lines"""
+    elapsed = result["elapsed_s"]
+    rtt = result["rtt_us"]
+    if args.connect:
+        ops = result["connect"]["completed"]
+    else:
+        ops = rtt["count"]
+    return {
+        "schema": "pico-bench/1",
+        "source": "host",
+        "board": args.board or args.host,
+        "build": args.build,
+        "clk_sys_hz": None,
+        "clk_peri_hz": None,
+        "options": "connections=%d size=%d window=%d" % (args.connections, args.size, args.window),
+        "scenario": args.scenario or ("connect" if args.connect else "echo_%d" % args.size),
+        "duration_ms": int(elapsed * 1000),
+        "rx_kbps": int(result["rx_bytes"] * 8 / elapsed / 1000) if elapsed > 0 else 0,
+        "tx_kbps": int(result["tx_bytes"] * 8 / elapsed / 1000) if elapsed > 0 else 0,
+        "ops_per_s": int(ops / elapsed) if elapsed > 0 else 0,
+        "errors": sum(result["errors"].values()),
+        "latency_us": {k: rtt[k] for k in ("count", "min", "mean", "p50", "p99", "p999", "max")} if rtt["count"] else None,
+        # the client's own, a run near 100 measured the host
+        "cpu_pct": round(cpu_s * 100 / elapsed, 1) if elapsed > 0 else None,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="TCP echo loopback benchmark, JSON report on stdout")
+    parser.add_argument("host", help="board address, 192.168.1.15 in both firmwares")
+    parser.add_argument("-p", "--port", type=int, default=5000, help="echo port (default 5000)")
+    parser.add_argument("-c", "--connections", type=int, default=1, help="parallel connections (default 1)")
+    parser.add_argument("-t", "--duration", type=float, default=10.0, help="seconds of sending (default 10)")
+    parser.add_argument("-n", "--messages", type=int, default=0, help="stop each connection after this many messages, 0 for no limit")
+    parser.add_argument("-s", "--size", type=int, default=1024, help="message size in bytes (default 1024)")
+    parser.add_argument("-w", "--window", type=int, default=1, help="messages in flight per connection (default 1)")
+    parser.add_argument("--pattern", choices=PATTERNS, default="counter", help="payload pattern (default counter)")
+    parser.add_argument("--seed", type=int, default=1, help="seed of the random pattern, plus the connection index")
+    parser.add_argument("--timeout", type=float, default=5.0, help="seconds without an echo before a connection gives up (default 5)")
+    parser.add_argument("--ramp", type=float, default=0.5, help="seconds to open the connections before the clock starts (default 0.5)")
+    parser.add_argument("--connect", action="store_true", help="open, echo -n messages (default 1) and close each connection, over and over, for the connection rate")
+    parser.add_argument("--control-port", type=int, default=0, help="also send a UDP datagram to this port every --control-interval ms while the connections run, 0 for none (default)")
+    parser.add_argument("--control-interval", type=float, default=1.0, help="ms between the control datagrams (default 1)")
+    parser.add_argument("--control-size", type=int, default=32, help="bytes in a control datagram, 4 or more (default 32)")
+    parser.add_argument("-o", "--output", help="write the JSON report to this file instead of stdout")
+    parser.add_argument("--result", help="append the run to this file as a pico-bench/1 record for bench_compare.py")
+    parser.add_argument("--board", help="board of the record, the host address by default")
+    parser.add_argument("--build", default="", help="firmware build of the record, e.g. pico_rmii_ethernet_bench")
+    parser.add_argument("--scenario", help="scenario of the record, echo_<size> or connect by default")
+    args = parser.parse_args()
+
+    if args.connections < 1 or args.size < 1 or args.window < 1:
+        parser.error("connections, size and window must be at least 1")
+    if args.control_port and (args.control_size < 4 or args.control_interval <= 0):
+        parser.error("control size must be at least 4 and the interval above 0")
+
+    cpu_start = time.process_time()
+    conns, control = asyncio.run(run(args))
+    result = report(args, conns, control)
+    text = json.dumps(result, indent=2)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+
+    if args.result:
+        with open(args.result, "a") as f:
+            f.write(json.dumps(result_record(args, result, time.process_time() - cpu_start), separators=(",", ":")) + "\n")
+
+    return 1 if any(result["errors"].values()) else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+#
+# Benchmark of the Modbus/TCP server of both firmwares, examples/modbus of
+# pico-w5100s-loopback and pico-lan8720-loopback, the device of modbus/modbus_demo.h.
+#
+# Keeps --depth requests in flight on one connection, the way a SCADA master pipelines its
+# polls: pairs of a write of --registers holding registers (function 16) and a read of them
+# back (function 3), each read checked against its write. Runs each depth for --seconds and
+# prints the transactions per second and the latency percentiles as JSON, then the server's
+# own counters from its input registers. Python 3.7 or later, standard library only.
+#
+# usage: modbus_bench.py 192.168.1.15
+# usage: modbus_bench.py 192.168.1.15 --depth 1 4 16 --registers 8 --seconds 5
+#
+# The exit status is 1 when a response was wrong or did not come.
+
+import argparse
+import json
+import socket
+import statistics
+import struct
+import sys
+import time
+
+REGISTERS = 1000
+CHUNK = 4096
+
+
+class Client:
+    def __init__(self, host, port, timeout_s):
+        self.sock = socket.create_connection((host, port), timeout=timeout_s)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.buf = b""
+
+    def send(self, frames):
+        self.sock.sendall(b"".join(frames))
+
+    def response(self):
+        while True:
+            if len(self.buf) >= 7:
+                size = 6 + struct.unpack_from(">H", self.buf, 4)[0]
+                if len(self.buf) >= size:
+                    frame, self.buf = self.buf[:size], self.buf[size:]
+                    return frame
+            data = self.sock.recv(CHUNK)
+            if not data:
+                raise ConnectionError("closed by the board")
+            self.buf += data
+
+    def close(self):
+        self.sock.close()
+
+
+def values(pair, qty):
+    return [(pair * 31 + k) & 0xFFFF for k in range(qty)]
+
+
+def request(tid, qty):
+    # tid even: the pair's write, odd: its read
+    pair = tid // 2
+    addr = (pair % (REGISTERS // qty)) * qty
+    if tid & 1:
+        pdu = struct.pack(">BHH", 3, addr, qty)
+    else:
+        pdu = struct.pack(">BHHB", 16, addr, qty, 2 * qty) + struct.pack(">%dH" % qty, *values(pair, qty))
+    return struct.pack(">HHHB", tid & 0xFFFF, 0, 1 + len(pdu), 1) + pdu
+
+
+def check(tid, qty, frame):
+    if struct.unpack_from(">H", frame)[0] != tid & 0xFFFF:
+        return False
+    if tid & 1:
+        return frame[7] == 3 and frame[8] == 2 * qty and list(struct.unpack_from(">%dH" % qty, frame, 9)) == values(tid // 2, qty)
+    return frame[7] == 16 and len(frame) == 12
+
+
+def run(client, depth, qty, seconds):
+    sent = {}
+    times = []
+    errors = 0
+    answered = 0
+
+    start = time.monotonic()
+    for t in range(depth):
+        sent[t] = start
+    client.send([request(t, qty) for t in range(depth)])
+    tid = depth
+
+    while True:
+        frame = client.response()
+        now = time.monotonic()
+        if not check(answered, qty, frame):
+            errors += 1
+        times.append((now - sent.pop(answered)) * 1000)
+        answered += 1
+
+        if now - start < seconds:
+            sent[tid] = time.monotonic()
+            client.send([request(tid, qty)])
+            tid += 1
+        elif answered == tid:
+            break
+
+    elapsed = time.monotonic() - start
+    times.sort()
+    return {
+        "depth": depth,
+        "registers": qty,
+        "transactions": answered,
+        "errors": errors,
+        "tr_per_s": round(answered / elapsed),
+        "median_ms": round(statistics.median(times), 3),
+        "p99_ms": round(times[min(len(times) - 1, len(times) * 99 // 100)], 3),
+        "max_ms": round(times[-1], 3),
+    }
+
+
+def counters(client):
+    client.send([struct.pack(">HHHBBHH", 0xFFFF, 0, 6, 1, 4, 0, 10)])
+    frame = client.response()
+    if frame[7] != 4:
+        return None
+    v = struct.unpack_from(">5I", frame, 9)
+    return {"uptime_ms": v[0], "requests": v[1], "exceptions": v[2], "services": v[3], "batch_max": v[4]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the Modbus/TCP server of both firmwares")
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=502)
+    parser.add_argument("--depth", type=int, nargs="+", default=[1, 4, 16], help="requests in flight")
+    parser.add_argument("--registers", type=int, default=8, help="registers a request writes or reads, up to 123")
+    parser.add_argument("--seconds", type=float, default=3)
+    args = parser.parse_args()
+
+    client = Client(args.host, args.port, 2.0)
+    results = []
+    try:
+        for depth in args.depth:
+            results.append(run(client, depth, args.registers, args.seconds))
+        server = counters(client)
+    except (socket.timeout, ConnectionError) as e:
+        print(json.dumps({"error": str(e), "runs": results}))
+        return 1
+    finally:
+        client.close()
+
+    print(json.dumps({"runs": results, "server": server}))
+
+    return 0 if all(r["transactions"] and not r["errors"] for r in results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,18 @@
+# ram_map_add(<target>)
+#
+# Prints the RAM of <target> per subsystem after every link, from its linker map with
+# tools/ram_map.py, and writes it next to the ELF as <target>.ram.txt, with the 20 largest
+# input sections. The map is the one pico_add_extra_outputs() asks the linker for
+
+set(RAM_MAP_TOOL ${CMAKE_CURRENT_LIST_DIR}/ram_map.py)
+
+function(ram_map_add TARGET)
+    find_package(Python3 REQUIRED COMPONENTS Interpreter)
+
+    add_custom_command(TARGET ${TARGET} POST_BUILD
+        COMMAND ${Python3_EXECUTABLE} ${RAM_MAP_TOOL} $<TARGET_FILE:${TARGET}>.map
+            --top 20 --output $<TARGET_FILE_DIR:${TARGET}>/${TARGET}.ram.txt
+        COMMENT "RAM map of ${TARGET}"
+        VERBATIM
+        )
+endfunction()
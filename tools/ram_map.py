@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+#
+# RAM of an RP2040 firmware per subsystem, from the GNU ld map of its ELF: every input
+# section the link placed in a writable memory region (RAM, SCRATCH_X, SCRATCH_Y), put
+# down to the driver, lwIP, the ioLibrary, the SDK, the shared modules of this
+# repository or the application by the path of its object. Python 3.7 or later,
+# standard library only.
+#
+# usage: ram_map.py build/examples/loopback/pico_rmii_ethernet_loopback.elf.map
+# usage: ram_map.py <elf>.map --top 20 --output <elf>.ram.txt
+#
+# pico_add_extra_outputs() writes the map next to the ELF, ram_map_add() of
+# tools/ram_map.cmake runs this after every link of a target. The columns:
+#   code   functions linked into RAM (.time_critical, PICO_RMII_HOT_IN_RAM)
+#   data   initialised variables, their flash copy isn't counted
+#   bss    zeroed and NOLOAD variables: the DMA buffers, lwIP's heap and pools, stacks
+# Space an output section has beyond its input sections (alignment, the SDK's stack
+# reservations) is counted as the section's own.
+
+import argparse
+import re
+import sys
+
+# subsystem of an object, the first rule whose text is in its path wins. CMake builds the
+# sources of the INTERFACE libraries in the target's directory, the part of the path
+# up to <target>.dir/ is dropped first as it names the target. The heap and the pools
+# are lwIP's, from the wrappers of mem.c and memp.c
+RULES = (
+    ("rmii_ethernet", ("src/rmii_ethernet",)),
+    ("lwip apps", ("lwip/src/apps/",)),
+    ("lwip", ("lwip/src/", "src/lwip/lwip_mem.c", "src/lwip/lwip_memp.c")),
+    ("lwip port", ("src/lwip/",)),
+    ("iolibrary", ("ioLibrary_Driver/", "_FILES.a(")),
+    ("w5x00 port", ("W5X00_PICO_PORT", "/port/")),
+    ("mbedtls", ("mbedtls",)),
+    ("freertos", ("FreeRTOS",)),
+    ("tinyusb", ("tinyusb",)),
+    ("bench", ("bench/",)),
+    ("trace", ("trace/",)),
+    ("timebase", ("timebase/",)),
+    ("boot", ("boot/",)),
+    ("websocket", ("websocket/",)),
+    ("pico-sdk", ("pico-sdk", "src/rp2_common/", "src/common/", "src/rp2040/", "src/rp2350/", "src/host/")),
+    ("libc", ("libc.a(", "libc_nano.a(", "libg.a(", "libg_nano.a(", "libm.a(", "libnosys.a(", "libgcc.a(", "libstdc++")),
+    ("app", ("examples/",)),
+)
+
+# input sections of the stacks and heap the SDK reserves, by name
+RESERVED = (".stack", ".heap")
+
+REGION = re.compile(r"^(\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S+))?$")
+# ".name 0xaddr 0xsize", at the start of the line, the name alone when it is long
+OUTPUT = re.compile(r"^(\.\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+).*)?$")
+# " .name 0xaddr 0xsize object", *fill* without an object
+INPUT = re.compile(r"^ (\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*))?)?$")
+WRAPPED = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*))?$")
+TARGET_DIR = re.compile(r"^.*?CMakeFiles/[^/]+\.dir/")
+
+
+def regions(lines):
+    """The writable memory regions of the map's Memory Configuration"""
+    found = []
+    try:
+        start = lines.index("Memory Configuration")
+    except ValueError:
+        return found
+
+    for line in lines[start + 1:]:
+        if line.startswith("Linker script and memory map"):
+            break
+        m = REGION.match(line)
+        if m and m.group(1) != "*default*" and "w" in (m.group(4) or ""):
+            found.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16)))
+    return found
+
+
+def subsystem(obj, section):
+    if section.startswith(RESERVED):
+        return "stacks, heap"
+    if obj is None:
+        return "padding"
+
+    path = TARGET_DIR.sub("", obj.replace("\\", "/"))
+    for name, texts in RULES:
+        if any(t in path for t in texts):
+            return name
+
+    # the target's own sources are left with no directory, or the example's
+    return "app" if "/" not in path.split("(", 1)[0] else "other"
+
+
+def kind(section, output):
+    if section.startswith((".time_critical", ".text", ".ram_text")):
+        return "code"
+    if section.startswith((".data", ".sdata", ".rodata")) or (output == ".data" and not section.startswith(".bss")):
+        return "data"
+    return "bss"
+
+
+def sections(lines, ram):
+    """(output, input, address, size, object) of every input section in ram"""
+    def in_ram(address):
+        return any(origin <= address < origin + length for _, origin, length in ram)
+
+    output = None       # (name, address, size) while it is in RAM
+    pending = None      # name of an output or input section wrapped to the next line
+    pending_output = False
+    covered = 0
+
+    for line in lines:
+        if pending is not None:
+            m = WRAPPED.match(line)
+            name, was_output = pending, pending_output
+            pending = None
+            if m:
+                address, size, obj = int(m.group(1), 16), int(m.group(2), 16), m.group(3)
+                if was_output:
+                    if output is not None:
+                        yield output[0], None, output[1] + covered, output[2] - covered, None
+                    output = (name, address, size) if in_ram(address) and size else None
+                    covered = 0
+                elif output is not None and size:
+                    covered += size
+                    yield output[0], name, address, size, obj
+                continue
+
+        m = OUTPUT.match(line)
+        if m:
+            if m.group(2) is None:
+                pending, pending_output = m.group(1), True
+                continue
+            if output is not None:
+                yield output[0], None, output[1] + covered, output[2] - covered, None
+            address, size = int(m.group(2), 16), int(m.group(3), 16)
+            output = (m.group(1), address, size) if in_ram(address) and size else None
+            covered = 0
+            continue
+
+        if output is None:
+            continue
+
+        m = INPUT.match(line)
+        if m:
+            if m.group(2) is None:
+                pending, pending_output = m.group(1), False
+                continue
+            size = int(m.group(3), 16)
+            if size:
+                covered += size
+                obj = m.group(4) if m.group(1) != "*fill*" else None
+                yield output[0], m.group(1), int(m.group(2), 16), size, obj
+
+    if output is not None:
+        yield output[0], None, output[1] + covered, output[2] - covered, None
+
+
+def report(path, lines, top):
+    ram = regions(lines)
+    if not ram:
+        sys.exit("ram_map.py: %s has no writable memory regions, is it a GNU ld map?" % path)
+
+    try:
+        lines = lines[lines.index("Linker script and memory map"):]
+    except ValueError:
+        sys.exit("ram_map.py: %s is not a GNU ld map" % path)
+
+    totals = {}
+    found = []
+    for output, name, address, size, obj in sections(lines, ram):
+        if size <= 0:
+            continue
+        if name is None:
+            # what the output section has beyond its inputs
+            name, group = output, ("stacks, heap" if output.startswith(RESERVED) or "stack" in output else "padding")
+        else:
+            group = subsystem(obj, name)
+        k = kind(name, output)
+        row = totals.setdefault(group, {"code": 0, "data": 0, "bss": 0})
+        row[k] += size
+        found.append((size, name, group, obj or ""))
+
+    out = []
+    capacity = sum(length for _, _, length in ram)
+    out.append("RAM map of %s: %s" % (path.rsplit("/", 1)[-1], ", ".join("%s %d KB" % (n, length // 1024) for n, _, length in ram)))
+    out.append("")
+    out.append("%-16s %8s %8s %8s %8s" % ("subsystem", "code", "data", "bss", "total"))
+
+    used = 0
+    for group, row in sorted(totals.items(), key=lambda kv: -sum(kv[1].values())):
+        total = sum(row.values())
+        used += total
+        out.append("%-16s %8d %8d %8d %8d" % (group, row["code"], row["data"], row["bss"], total))
+
+    out.append("%-16s %8s %8s %8s %8d of %d (%d%%)" % ("total", "", "", "", used, capacity, used * 100 // capacity))
+
+    if top:
+        out.append("")
+        out.append("largest input sections:")
+        for size, name, group, obj in sorted(found, reverse=True)[:top]:
+            out.append("%8d  %-40s %-14s %s" % (size, name, group, TARGET_DIR.sub("", obj).rsplit("/", 1)[-1]))
+
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RAM per subsystem from a GNU ld map")
+    parser.add_argument("map", help="the map of the ELF, <elf>.map")
+    parser.add_argument("--top", type=int, default=0, help="also list the N largest input sections")
+    parser.add_argument("--output", help="write the report to this file too")
+    args = parser.parse_args()
+
+    with open(args.map, encoding="utf-8", errors="replace") as f:
+        lines = f.read().splitlines()
+
+    out = report(args.map, lines, args.top)
+    print("\n".join(out))
+
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as f:
+            f.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()
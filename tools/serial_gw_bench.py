@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+#
+# Benchmark of the serial gateway of the W5100S firmware, examples/serial_gateway of
+# pico-w5100s-loopback, with its UARTs jumpered to each other (GP0 to GP5, GP4 to GP1).
+#
+# What is sent to one TCP port goes out of one UART, into the other and out of the other
+# port. The throughput run sends a counter pattern both ways at once for --seconds and
+# checks every byte that comes back. The latency run then sends --count messages of --size
+# bytes one at a time and times each until all of it is out of the other port, through
+# both UARTs. Prints both as JSON. Python 3.7 or later, standard library only.
+#
+# usage: serial_gw_bench.py 192.168.1.15
+# usage: serial_gw_bench.py 192.168.1.15 --seconds 10 --size 16 --count 1000
+#
+# --baud is the UARTs', the throughput is also given as a share of its 8N1 byte rate. The
+# exit status is 1 when nothing came through or a byte was wrong.
+
+import argparse
+import json
+import select
+import socket
+import statistics
+import sys
+import time
+
+CHUNK = 4096
+
+
+def pattern(offset, n):
+    return bytes((offset + i) & 0xFF for i in range(n))
+
+
+def connect(host, port):
+    sock = socket.create_connection((host, port), timeout=5)
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    sock.setblocking(False)
+    return sock
+
+
+def drain(socks, quiet_s):
+    # what is left of an earlier run, until the line is quiet
+    while True:
+        readable, _, _ = select.select(socks, [], [], quiet_s)
+        if not readable:
+            return
+        for sock in readable:
+            if not sock.recv(CHUNK):
+                raise ConnectionError("closed by the board")
+
+
+def throughput(a, b, seconds, quiet_s):
+    # both ways at once: a to b and b to a, each with its own counter
+    ways = [
+        {"tx": a, "rx": b, "sent": 0, "received": 0, "errors": 0, "first": None, "last": None},
+        {"tx": b, "rx": a, "sent": 0, "received": 0, "errors": 0, "first": None, "last": None},
+    ]
+    start = time.monotonic()
+    last_rx = start
+
+    while True:
+        now = time.monotonic()
+        sending = now - start < seconds
+        if not sending and now - last_rx >= quiet_s:
+            break
+
+        writers = [w["tx"] for w in ways] if sending else []
+        readable, writable, _ = select.select([a, b], writers, [], quiet_s)
+
+        for w in ways:
+            if w["tx"] in writable:
+                try:
+                    w["sent"] += w["tx"].send(pattern(w["sent"], CHUNK))
+                except BlockingIOError:
+                    pass
+            if w["rx"] in readable:
+                data = w["rx"].recv(CHUNK)
+                if not data:
+                    raise ConnectionError("closed by the board")
+                if data != pattern(w["received"], len(data)):
+                    w["errors"] += sum(1 for i, c in enumerate(data) if c != (w["received"] + i) & 0xFF)
+                last_rx = time.monotonic()
+                if w["first"] is None:
+                    w["first"] = last_rx
+                w["last"] = last_rx
+                w["received"] += len(data)
+
+    result = []
+    for w in ways:
+        rx_s = w["last"] - w["first"] if w["first"] is not None and w["last"] > w["first"] else 0
+        result.append({
+            "sent": w["sent"],
+            "received": w["received"],
+            "errors": w["errors"],
+            "seconds": round(rx_s, 3),
+            "kbps": round(w["received"] * 8 / rx_s / 1000) if rx_s else 0,
+        })
+    return result
+
+
+def latency(a, b, size, count, timeout_s):
+    times = []
+    lost = 0
+
+    for n in range(count):
+        msg = pattern(n, size)
+        start = time.monotonic()
+        a.send(msg)
+        got = b""
+        while len(got) < size:
+            readable, _, _ = select.select([b], [], [], timeout_s)
+            if not readable:
+                break
+            data = b.recv(CHUNK)
+            if not data:
+                raise ConnectionError("closed by the board")
+            got += data
+        if got[:size] != msg:
+            lost += 1
+            drain([a, b], 0.2)
+            continue
+        times.append((time.monotonic() - start) * 1000)
+
+    times.sort()
+    return {
+        "size": size,
+        "count": count,
+        "lost": lost,
+        "min_ms": round(times[0], 3) if times else None,
+        "median_ms": round(statistics.median(times), 3) if times else None,
+        "p99_ms": round(times[min(len(times) - 1, len(times) * 99 // 100)], 3) if times else None,
+        "max_ms": round(times[-1], 3) if times else None,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the serial gateway of the W5100S firmware")
+    parser.add_argument("host")
+    parser.add_argument("--ports", type=int, nargs=2, default=[5020, 5021])
+    parser.add_argument("--seconds", type=float, default=5)
+    parser.add_argument("--size", type=int, default=32, help="bytes of a latency message")
+    parser.add_argument("--count", type=int, default=200, help="latency messages")
+    parser.add_argument("--baud", type=int, default=3000000)
+    args = parser.parse_args()
+
+    a = connect(args.host, args.ports[0])
+    b = connect(args.host, args.ports[1])
+    drain([a, b], 0.2)
+
+    ways = throughput(a, b, args.seconds, 1.0)
+    drain([a, b], 0.2)
+    lat = latency(a, b, args.size, args.count, 1.0)
+
+    a.close()
+    b.close()
+
+    byte_rate = args.baud / 10
+    for w in ways:
+        w["of_uart"] = round(w["kbps"] * 1000 / 8 / byte_rate, 3)
+
+    # the time a message is on the UART line, the rest is TCP, SPI and the flushes
+    lat["uart_ms"] = round(args.size * 10 / args.baud * 1000, 3)
+
+    print(json.dumps({"baud": args.baud, "a_to_b": ways[0], "b_to_a": ways[1], "latency": lat}))
+
+    ok = all(w["received"] and not w["errors"] for w in ways)
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+#
+# Receiver of the sample streams of both firmwares, stream/stream.h of the repository root.
+#
+# Asks the board for the stream on UDP port 5012, and again every --keepalive-ms so that it
+# keeps sending, for --seconds. Counts the datagrams, the ones lost on the way (gaps in the
+# sequence numbers) and the samples the board lost with no slot free (gaps in the sample
+# index, the datagrams flagged). Prints the stream as JSON. Python 3.7 or later, standard
+# library only.
+#
+# usage: stream_recv.py 192.168.1.15 --seconds 10
+# usage: stream_recv.py 192.168.1.15 -o samples.bin
+#
+# -o writes the samples as they came, little endian, with zeros where samples were lost
+# so that the file keeps the board's time base. The exit status is 1 when no datagram came.
+
+import argparse
+import json
+import select
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x534D
+HEAD = struct.Struct(">HBBIII")
+FLAG_LOST = 0x01
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Receive a sample stream from either firmware")
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=5012)
+    parser.add_argument("--seconds", type=float, default=10)
+    parser.add_argument("--keepalive-ms", type=float, default=1000)
+    parser.add_argument("-o", "--output", help="file the samples are written to")
+    args = parser.parse_args()
+
+    addr = (socket.gethostbyname(args.host), args.port)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+
+    out = open(args.output, "wb") if args.output else None
+    keepalive_s = args.keepalive_ms / 1000
+    sample_size = 0
+    datagrams = 0
+    samples = 0
+    seq_next = None
+    seq_lost = 0
+    out_of_order = 0
+    index_next = None
+    samples_lost = 0
+    flagged = 0
+    first_us = None
+    last_us = None
+    start = time.monotonic()
+    first_rx = None
+    last_rx = None
+    last_req = 0
+
+    while True:
+        now = time.monotonic()
+        if now - start >= args.seconds:
+            break
+
+        if now - last_req >= keepalive_s:
+            sock.sendto(b"stream", addr)
+            last_req = now
+
+        readable, _, _ = select.select([sock], [], [], keepalive_s)
+        if not readable:
+            continue
+
+        while True:
+            try:
+                msg, _ = sock.recvfrom(65536, socket.MSG_DONTWAIT)
+            except BlockingIOError:
+                break
+            if len(msg) < HEAD.size:
+                continue
+            magic, size, flags, seq, index, time_us = HEAD.unpack_from(msg)
+            if magic != MAGIC or size == 0:
+                continue
+
+            last_rx = time.monotonic()
+            if first_rx is None:
+                first_rx = last_rx
+                first_us = time_us
+            last_us = time_us
+
+            n = (len(msg) - HEAD.size) // size
+            datagrams += 1
+            samples += n
+            sample_size = size
+            flagged += 1 if flags & FLAG_LOST else 0
+
+            if seq_next is not None and seq != seq_next:
+                if (seq - seq_next) & 0xFFFFFFFF < 0x80000000:
+                    seq_lost += (seq - seq_next) & 0xFFFFFFFF
+                else:
+                    out_of_order += 1
+                    continue
+            seq_next = (seq + 1) & 0xFFFFFFFF
+
+            # samples of the datagrams lost on the way are not the board's
+            gap = 0
+            if index_next is not None:
+                gap = (index - index_next) & 0xFFFFFFFF
+                if flags & FLAG_LOST:
+                    samples_lost += gap
+            index_next = (index + n) & 0xFFFFFFFF
+
+            if out:
+                out.write(bytes(gap * size))
+                out.write(msg[HEAD.size:HEAD.size + n * size])
+
+    if out:
+        out.close()
+
+    rx_s = (last_rx - first_rx) if first_rx is not None and last_rx > first_rx else 0
+    board_s = ((last_us - first_us) & 0xFFFFFFFF) / 1e6 if first_us is not None else 0
+    result = {
+        "seconds": round(rx_s, 3),
+        "sample_size": sample_size,
+        "datagrams": datagrams,
+        "datagrams_lost": seq_lost,
+        "out_of_order": out_of_order,
+        "samples": samples,
+        "samples_lost": samples_lost,
+        "datagrams_flagged": flagged,
+        "samples_per_s": round(samples / board_s) if board_s else 0,
+        "kbps": round(samples * sample_size * 8 / rx_s / 1000) if rx_s else 0,
+    }
+
+    print(json.dumps(result))
+    return 0 if datagrams else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
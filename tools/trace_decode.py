@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+#
+# Decoder of the binary trace frames of trace/trace.c, built with TRACE_BINARY=1, for the
+# W5100S and LAN8720 firmwares. Reads the USB CDC stream from a file or stdin and prints a
+# line per record, as trace_drain() does on the board with TRACE_BINARY=0. The formats come
+# from trace/trace_events.h, so the two stay in step. Python 3.7 or later, standard library
+# only.
+#
+# usage: trace_decode.py /dev/ttyACM0
+# usage: trace_decode.py capture.bin --events trace/trace_events.h
+#
+# A frame is TRACE_FRAME_START (0xA5), TRACE_FRAME_CORE (0xC0) ORed with the core, then the
+# 16 byte record, little endian: time_us, id, arg0 (16 bits), arg1 and arg2. Bytes between
+# frames, the text the firmware still prints, are passed through to stderr.
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+FRAME_START = 0xA5
+FRAME_CORE = 0xC0
+RECORD = struct.Struct("<IHHII")
+
+EVENT = re.compile(r'TRACE_EVENT\((\w+),\s*"((?:[^"\\]|\\.)*)"\)')
+CONVERSION = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diouxXc%])")
+
+
+def load_events(path):
+    """Names and formats of trace_events.h, the index is the event id"""
+    with open(path, encoding="utf-8") as f:
+        text = f.read()
+    return [(name, bytes(fmt, "utf-8").decode("unicode_escape")) for name, fmt in EVENT.findall(text)]
+
+
+def format_event(fmt, args):
+    """printf of the firmware, the arguments in order and %d/%i as signed 32 bit"""
+    values = iter(args)
+
+    def convert(m):
+        flags, _, kind = m.groups()
+        if kind == "%":
+            return "%"
+        value = next(values, 0)
+        if kind in "di" and value & 0x80000000:
+            value -= 1 << 32
+        return ("%" + flags + kind) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode(stream, events, out, text):
+    buf = b""
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buf += chunk
+        while True:
+            start = buf.find(bytes([FRAME_START]))
+            if start < 0:
+                text.write(buf.decode("latin-1"))
+                buf = b""
+                break
+            if start > 0:
+                text.write(buf[:start].decode("latin-1"))
+                buf = buf[start:]
+            if len(buf) < 2 + RECORD.size:
+                break
+            if buf[1] & 0xFE != FRAME_CORE:
+                # not a frame, 0xA5 of the text
+                text.write(buf[:1].decode("latin-1"))
+                buf = buf[1:]
+                continue
+            core = buf[1] & 1
+            time_us, event_id, arg0, arg1, arg2 = RECORD.unpack_from(buf, 2)
+            buf = buf[2 + RECORD.size:]
+            if event_id < len(events):
+                line = format_event(events[event_id][1], (arg0, arg1, arg2))
+            else:
+                line = "event %u: %u %u %u" % (event_id, arg0, arg1, arg2)
+            out.write("%10u %u %s\n" % (time_us, core, line))
+            out.flush()
+
+
+def main():
+    default_events = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "trace", "trace_events.h")
+
+    parser = argparse.ArgumentParser(description="Binary trace frames of trace/trace.c to text lines")
+    parser.add_argument("input", nargs="?", help="serial device or capture file, stdin without it")
+    parser.add_argument("--events", default=default_events, help="trace_events.h of the firmware (default trace/trace_events.h)")
+    args = parser.parse_args()
+
+    events = load_events(args.events)
+    if not events:
+        sys.exit("no TRACE_EVENT in %s" % args.events)
+
+    try:
+        if args.input:
+            with open(args.input, "rb", buffering=0) as stream:
+                decode(stream, events, sys.stdout, sys.stderr)
+        else:
+            decode(sys.stdin.buffer, events, sys.stdout, sys.stderr)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+#
+# Packer of the web content of the W5100S httpServer (ioLibrary Internet/httpServer). Turns a
+# directory into a C source of const data, in flash on the RP2040 and sent from there (XIP)
+# into the socket TX buffer: one httpServer_webContent per file, with its length, ETag and
+# Content-Type made here, and the index of a minimal perfect hash of the names, as
+# find_webPack_content() of httpServer.c looks them up. Python 3.7 or later, standard library
+# only.
+#
+# usage: web_pack.py web/ -o web_pack.c [--name web_pack] [--gzip]
+#
+# The names are the paths under the directory with '/', as the URI without its leading '/'.
+# --gzip adds a gzip variant, <name>.gz, of the text files it makes smaller, served to the
+# clients that take it. The firmware registers the pack with
+#
+#   extern const httpServer_webPack web_pack; // or #include "web_pack.h", written next to it
+#   reg_httpServer_webPack(&web_pack);
+#
+# The hash is built as in "hash, displace and compress": the names go into buckets by a first
+# hash, the buckets of several names get the seed of a second hash that puts them all into
+# free slots, those of one name are given a free slot directly, as -1 - slot.
+
+import argparse
+import gzip
+import os
+import sys
+
+MASK = 0xFFFFFFFF
+
+# MAX_CONTENT_NAME_LEN of httpServer.h, the name is copied with its terminator
+MAX_CONTENT_NAME_LEN = 128
+
+# MAX_CONTENT_CALLBACK of httpServer.h, the packed content is numbered after the registered one
+MAX_CONTENT_CALLBACK = 20
+
+# largest seed of the int16_t index
+MAX_SEED = 0x7FFF
+
+# find_http_uri_type() of httpParser.c, in its order: the first extension found in the name wins
+URI_TYPES = [
+    ((".htm", ".html"), "PTYPE_HTML"),
+    ((".gif",), "PTYPE_GIF"),
+    ((".text", ".txt"), "PTYPE_TEXT"),
+    ((".jpeg", ".jpg"), "PTYPE_JPEG"),
+    ((".swf",), "PTYPE_FLASH"),
+    ((".cgi", ".CGI"), "PTYPE_CGI"),
+    ((".json", ".JSON"), "PTYPE_JSON"),
+    ((".js", ".JS"), "PTYPE_JS"),
+    ((".xml", ".XML"), "PTYPE_XML"),
+    ((".css", ".CSS"), "PTYPE_CSS"),
+    ((".png", ".PNG"), "PTYPE_PNG"),
+    ((".ico", ".ICO"), "PTYPE_ICO"),
+    ((".ttf", ".TTF"), "PTYPE_TTF"),
+    ((".otf", ".OTF"), "PTYPE_OTF"),
+    ((".woff", ".WOFF"), "PTYPE_WOFF"),
+    ((".eot", ".EOT"), "PTYPE_EOT"),
+    ((".svg", ".SVG"), "PTYPE_SVG"),
+]
+
+# worth a gzip variant, the images and fonts are compressed already
+GZIP_TYPES = {"PTYPE_HTML", "PTYPE_TEXT", "PTYPE_JSON", "PTYPE_JS", "PTYPE_XML", "PTYPE_CSS", "PTYPE_SVG"}
+
+# HTTP_GZIP_SUFFIX of httpServer.h
+GZIP_SUFFIX = ".gz"
+
+
+def uri_type(name):
+    for exts, ptype in URI_TYPES:
+        if any(ext in name for ext in exts):
+            return ptype
+    return "PTYPE_ERR"
+
+
+def content_etag(data):
+    """FNV-1a 32-bit, as http_content_etag() of httpServer.c"""
+    h = 2166136261
+    for c in data:
+        h = ((h ^ c) * 16777619) & MASK
+    return h
+
+
+def pack_hash(seed, name):
+    """FNV-1a from a seeded basis and a final mix, as webPack_hash() of httpServer.c"""
+    h = (2166136261 ^ seed) & MASK
+    for c in name:
+        h = ((h ^ c) * 16777619) & MASK
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & MASK
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & MASK
+    h ^= h >> 16
+    return h
+
+
+def build_index(names):
+    """Index of the buckets and the name of each slot, the order of the content"""
+    n = len(names)
+    buckets = [[] for _ in range(n)]
+    for i, name in enumerate(names):
+        buckets[pack_hash(0, name) % n].append(i)
+
+    index = [0] * n
+    slots = [None] * n
+
+    # the full buckets first, while most slots are free
+    order = sorted(range(n), key=lambda b: -len(buckets[b]))
+    for b in order:
+        items = buckets[b]
+        if len(items) < 2:
+            break
+        for seed in range(1, MAX_SEED + 1):
+            pos = [pack_hash(seed, names[i]) % n for i in items]
+            if len(set(pos)) == len(pos) and all(slots[p] is None for p in pos):
+                break
+        else:
+            sys.exit("no seed up to %d places %d names of a bucket" % (MAX_SEED, len(items)))
+        index[b] = seed
+        for p, i in zip(pos, items):
+            slots[p] = i
+
+    free = [p for p in range(n) if slots[p] is None]
+    for b in order:
+        if len(buckets[b]) == 1:
+            p = free.pop()
+            slots[p] = buckets[b][0]
+            index[b] = -1 - p
+
+    return index, slots
+
+
+def load_content(root, add_gzip):
+    contents = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames.sort()
+        for filename in sorted(filenames):
+            path = os.path.join(dirpath, filename)
+            name = os.path.relpath(path, root).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                data = f.read()
+            contents.append((name, data))
+            if add_gzip and uri_type(name) in GZIP_TYPES and not name.endswith(GZIP_SUFFIX):
+                # mtime 0, the same content packs to the same bytes and ETag
+                packed = gzip.compress(data, compresslevel=9, mtime=0)
+                if len(packed) < len(data):
+                    contents.append((name + GZIP_SUFFIX, packed))
+
+    for name, _ in contents:
+        if len(name.encode("utf-8")) >= MAX_CONTENT_NAME_LEN:
+            sys.exit("%s: name longer than MAX_CONTENT_NAME_LEN - 1" % name)
+        if '"' in name or "\\" in name:
+            sys.exit("%s: name can't be a C string as it is" % name)
+
+    return contents
+
+
+def write_source(out, header, var, contents, index, slots, root):
+    out.write("/* Web content of %s, generated by tools/web_pack.py, do not edit */\n\n" % root)
+    out.write("#include <stdint.h>\n\n")
+    out.write('#include "httpParser.h"\n')
+    out.write('#include "httpServer.h"\n\n')
+
+    for slot, i in enumerate(slots):
+        name, data = contents[i]
+        out.write("/* %s, %d bytes */\n" % (name, len(data)))
+        out.write("static const uint8_t %s_%d[] = {\n" % (var, slot))
+        for off in range(0, len(data), 16):
+            out.write("    " + " ".join("0x%02x," % c for c in data[off:off + 16]) + "\n")
+        if not data:
+            out.write("    0x00,\n")
+        out.write("};\n\n")
+
+    out.write("static const httpServer_webContent %s_content[] = {\n" % var)
+    for slot, i in enumerate(slots):
+        name, data = contents[i]
+        out.write("    {.content_name = (const uint8_t *)\"%s\", .content_len = %d, .content = %s_%d,\n"
+                  % (name, len(data), var, slot))
+        out.write("     .content_etag = 0x%08x, .content_gzip = %d, .content_type = %s},\n"
+                  % (content_etag(data), name.endswith(GZIP_SUFFIX), uri_type(name)))
+    out.write("};\n\n")
+
+    out.write("static const int16_t %s_index[] = {\n" % var)
+    for off in range(0, len(index), 12):
+        out.write("    " + " ".join("%d," % d for d in index[off:off + 12]) + "\n")
+    out.write("};\n\n")
+
+    out.write("const httpServer_webPack %s = {%d, %s_index, %s_content};\n" % (var, len(slots), var, var))
+
+    guard = "__%s_H__" % var.upper()
+    header.write("/* Web content of %s, generated by tools/web_pack.py, do not edit */\n\n" % root)
+    header.write("#ifndef %s\n#define %s\n\n" % (guard, guard))
+    header.write('#include "httpServer.h"\n\n')
+    header.write("extern const httpServer_webPack %s;\n\n" % var)
+    header.write("#endif\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Web content of a directory to a const httpServer_webPack")
+    parser.add_argument("root", help="directory of the web content")
+    parser.add_argument("-o", "--output", required=True, help="C source to write, its .h next to it")
+    parser.add_argument("--name", default="web_pack", help="name of the httpServer_webPack (default web_pack)")
+    parser.add_argument("--gzip", action="store_true", help="add <name>.gz variants of the text files")
+    args = parser.parse_args()
+
+    contents = load_content(args.root, args.gzip)
+    if not contents:
+        sys.exit("no content in %s" % args.root)
+    if len(contents) > 0xFFFF - MAX_CONTENT_CALLBACK:
+        sys.exit("%d contents, the numbers after MAX_CONTENT_CALLBACK are 16 bits" % len(contents))
+
+    index, slots = build_index([name.encode("utf-8") for name, _ in contents])
+
+    header_path = os.path.splitext(args.output)[0] + ".h"
+    with open(args.output, "w", encoding="utf-8") as out, open(header_path, "w", encoding="utf-8") as header:
+        write_source(out, header, args.name, contents, index, slots, os.path.basename(os.path.normpath(args.root)))
+
+    size = sum(len(data) for _, data in contents)
+    print("%s: %d contents, %d bytes, index %d bytes" % (args.output, len(contents), size, 2 * len(index)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,90 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "trace.h"
+
+struct trace_ring trace_rings[NUM_CORES];
+
+static const char *const trace_formats[TRACE_EVENT_IDS] = {
+#define TRACE_EVENT(name, fmt) fmt,
+    TRACE_EVENTS
+#undef TRACE_EVENT
+};
+
+// dropped count of each ring already reported
+static uint32_t trace_dropped_seen[NUM_CORES];
+
+const char *trace_format(uint16_t id) {
+    return (id < TRACE_EVENT_IDS) ? trace_formats[id] : NULL;
+}
+
+static void trace_output(uint core, const struct trace_record *r) {
+#if TRACE_BINARY
+    const uint8_t *p = (const uint8_t *)r;
+
+    // raw, without the CR of the CRLF translation
+    putchar_raw(TRACE_FRAME_START);
+    putchar_raw(TRACE_FRAME_CORE | core);
+
+    for (uint i = 0; i < sizeof(*r); i++) {
+        putchar_raw(p[i]);
+    }
+#else
+    const char *fmt = trace_format(r->id);
+
+    printf("%10lu %u ", (unsigned long)r->time_us, core);
+
+    if (fmt == NULL) {
+        printf("event %u: %lu %lu %lu\n", r->id, (unsigned long)r->arg0, (unsigned long)r->arg1, (unsigned long)r->arg2);
+    } else {
+        printf(fmt, (unsigned long)r->arg0, (unsigned long)r->arg1, (unsigned long)r->arg2);
+        printf("\n");
+    }
+#endif
+}
+
+uint32_t trace_drain(uint32_t max) {
+    uint32_t drained = 0;
+
+    for (uint core = 0; core < NUM_CORES; core++) {
+        struct trace_ring *ring = &trace_rings[core];
+        uint32_t dropped = ring->dropped;
+
+        while ((drained < max) && (ring->tail != ring->head)) {
+            struct trace_record r;
+
+            // the record after the head that published it
+            __dmb();
+
+            r = ring->records[ring->tail & (TRACE_RING_SIZE - 1)];
+
+            // copied before the slot is handed back
+            __dmb();
+
+            ring->tail++;
+            drained++;
+
+            trace_output(core, &r);
+        }
+
+        if (dropped != trace_dropped_seen[core]) {
+            struct trace_record r = {
+                .time_us = timebase_us(),
+                .id = TRACE_DROPPED,
+                .arg0 = core,
+                .arg1 = dropped - trace_dropped_seen[core],
+            };
+
+            trace_dropped_seen[core] = dropped;
+
+            trace_output(core, &r);
+        }
+    }
+
+    return drained;
+}
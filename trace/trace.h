@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico.h"
+#include "hardware/sync.h"
+
+#include "timebase.h"
+
+#include "trace_events.h"
+
+// Binary trace ring shared by the W5100S (ioLibrary) and LAN8720 (lwIP) firmwares, in place
+// of printf on the hot paths.
+//
+// TRACE() stores a 16 byte record, the 1 us timer, the event id of trace_events.h and its
+// arguments, and nothing is formatted. Each core has a ring of its own, and only the core's
+// interrupts are masked for the few stores of a record, so the cores never wait for each
+// other. trace_drain() formats the records on core 0 when it is idle, or sends them as
+// binary frames for tools/trace_decode.py to format on the host.
+
+// records of each core's ring, a power of 2
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 256
+#endif
+
+// trace_drain() output: 0 printf lines, 1 binary frames of tools/trace_decode.py
+#ifndef TRACE_BINARY
+#define TRACE_BINARY 0
+#endif
+
+// records formatted by one trace_drain() call, the rest wait for the next one
+#ifndef TRACE_DRAIN_MAX
+#define TRACE_DRAIN_MAX 16
+#endif
+
+// start byte of a binary frame, the core number with TRACE_FRAME_CORE follows, then the record
+#define TRACE_FRAME_START 0xA5
+#define TRACE_FRAME_CORE 0xC0
+
+enum trace_event_id {
+#define TRACE_EVENT(name, fmt) TRACE_##name,
+    TRACE_EVENTS
+#undef TRACE_EVENT
+    TRACE_EVENT_IDS
+};
+
+struct trace_record {
+    uint32_t time_us;
+    uint16_t id;
+    uint16_t arg0;
+    uint32_t arg1;
+    uint32_t arg2;
+};
+
+// head is written by the core of the ring, tail by trace_drain() on core 0
+struct trace_ring {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped; // the ring was full
+    struct trace_record records[TRACE_RING_SIZE];
+};
+
+extern struct trace_ring trace_rings[NUM_CORES];
+
+// records an event, from either core, an IRQ handler included. A full ring drops it.
+// The arguments are evaluated once
+static inline void trace_write(enum trace_event_id id, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+    struct trace_ring *ring = &trace_rings[get_core_num()];
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t head = ring->head;
+
+    if (head - ring->tail >= TRACE_RING_SIZE) {
+        ring->dropped++;
+    } else {
+        struct trace_record *r = &ring->records[head & (TRACE_RING_SIZE - 1)];
+
+        r->time_us = timebase_us();
+        r->id = (uint16_t)id;
+        r->arg0 = (uint16_t)arg0;
+        r->arg1 = arg1;
+        r->arg2 = arg2;
+
+        // the record before the head that publishes it
+        __dmb();
+
+        ring->head = head + 1;
+    }
+
+    restore_interrupts(save);
+}
+
+#define TRACE(id, arg0, arg1, arg2) trace_write((id), (uint32_t)(arg0), (uint32_t)(arg1), (uint32_t)(arg2))
+
+// prints or sends up to `max` records of both rings, oldest first in each, and a DROPPED
+// record for a ring that dropped some since the last call. Call it from core 0 only, when
+// it has nothing else to do, returns the records drained
+uint32_t trace_drain(uint32_t max);
+
+// printf format of an event, NULL for an unknown id
+const char *trace_format(uint16_t id);
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _TRACE_EVENTS_H_
+#define _TRACE_EVENTS_H_
+
+// Events of TRACE(), in the order of their ids. Each has a printf format of its arguments,
+// always passed as arg0, arg1 and arg2, all unsigned long: trace_drain() prints it with them
+// and tools/trace_decode.py reads this file for the same output on the host. A new event goes
+// at the end, the ids of the ones before it stay those of the recorded traces.
+//
+// arg0 has 16 bits, arg1 and arg2 32. An IPv4 address is one argument, first byte highest.
+
+#define TRACE_EVENTS \
+    TRACE_EVENT(DROPPED, "trace: core %lu dropped %lu records") \
+    TRACE_EVENT(RMII_RX_FRAME, "rmii rx: %lu bytes") \
+    TRACE_EVENT(RMII_TX_FRAME, "rmii tx: %lu bytes in %lu blocks") \
+    TRACE_EVENT(RMII_LINK_UP, "rmii link up: %lu Mbit/s") \
+    TRACE_EVENT(RMII_LINK_DOWN, "rmii link down: %lu flaps") \
+    TRACE_EVENT(LOOPBACK_CONNECTED, "%lu:Connected - %08lx : %lu") \
+    TRACE_EVENT(LOOPBACK_CONNECTING, "%lu:Try to connect to the %08lx : %lu") \
+    TRACE_EVENT(LOOPBACK_CLOSED, "%lu:Socket Closed") \
+    TRACE_EVENT(LOOPBACK_LISTEN, "%lu:Listen, TCP server loopback, port [%lu]") \
+    TRACE_EVENT(LOOPBACK_UDP_OPEN, "%lu:Opened, UDP loopback, port [%lu]") \
+    TRACE_EVENT(LOOPBACK_RECVFROM_ERROR, "%lu: recvfrom error. %ld") \
+    TRACE_EVENT(LOOPBACK_SENDTO_ERROR, "%lu: sendto error. %ld") \
+    TRACE_EVENT(LOOPBACK_ERROR, "%lu:Loopback error : %ld") \
+    TRACE_EVENT(LOOPBACK_RECYCLED, "%lu:Recycled, no socket listening")
+
+#endif
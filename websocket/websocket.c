@@ -0,0 +1,306 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "websocket.h"
+
+// appended to the Sec-WebSocket-Key for the Sec-WebSocket-Accept, RFC 6455 1.3
+static const char ws_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+static const char ws_base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+struct ws_sha1 {
+    uint32_t h[5];
+    uint8_t block[64];
+    uint32_t block_len;
+    uint32_t total;
+};
+
+static uint32_t ws_rol(uint32_t x, unsigned int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static void ws_sha1_block(struct ws_sha1 *sha, const uint8_t *block) {
+    uint32_t w[16];
+    uint32_t a = sha->h[0], b = sha->h[1], c = sha->h[2], d = sha->h[3], e = sha->h[4];
+
+    for (unsigned int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+               ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+    }
+
+    // the 80 words of the schedule in a ring of 16
+    for (unsigned int i = 0; i < 80; i++) {
+        uint32_t f, k, t;
+
+        if (i >= 16) {
+            w[i & 15] = ws_rol(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+        }
+
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+
+        t = ws_rol(a, 5) + f + e + k + w[i & 15];
+        e = d;
+        d = c;
+        c = ws_rol(b, 30);
+        b = a;
+        a = t;
+    }
+
+    sha->h[0] += a;
+    sha->h[1] += b;
+    sha->h[2] += c;
+    sha->h[3] += d;
+    sha->h[4] += e;
+}
+
+static void ws_sha1_update(struct ws_sha1 *sha, const uint8_t *data, size_t len) {
+    sha->total += len;
+
+    while (len) {
+        size_t n = 64 - sha->block_len;
+
+        if (n > len) {
+            n = len;
+        }
+
+        memcpy(sha->block + sha->block_len, data, n);
+        sha->block_len += n;
+        data += n;
+        len -= n;
+
+        if (sha->block_len == 64) {
+            ws_sha1_block(sha, sha->block);
+            sha->block_len = 0;
+        }
+    }
+}
+
+static void ws_sha1_final(struct ws_sha1 *sha, uint8_t *digest) {
+    uint64_t bits = (uint64_t)sha->total * 8;
+    uint8_t pad = 0x80;
+
+    ws_sha1_update(sha, &pad, 1);
+
+    pad = 0;
+    while (sha->block_len != 56) {
+        ws_sha1_update(sha, &pad, 1);
+    }
+
+    for (int i = 7; i >= 0; i--) {
+        uint8_t b = (uint8_t)(bits >> (8 * i));
+
+        ws_sha1_update(sha, &b, 1);
+    }
+
+    for (unsigned int i = 0; i < 20; i++) {
+        digest[i] = (uint8_t)(sha->h[i / 4] >> (24 - 8 * (i & 3)));
+    }
+}
+
+void ws_accept_key(const char *key, size_t key_len, char *accept) {
+    struct ws_sha1 sha = {
+        .h = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 },
+    };
+    uint8_t digest[21];
+
+    ws_sha1_update(&sha, (const uint8_t *)key, key_len);
+    ws_sha1_update(&sha, (const uint8_t *)ws_guid, sizeof(ws_guid) - 1);
+    ws_sha1_final(&sha, digest);
+
+    // 20 bytes are 6 groups of 3 and 2 left, the last group padded with one '='
+    digest[20] = 0;
+
+    for (unsigned int i = 0; i < 21; i += 3) {
+        uint32_t v = ((uint32_t)digest[i] << 16) | ((uint32_t)digest[i + 1] << 8) | digest[i + 2];
+
+        *accept++ = ws_base64[(v >> 18) & 63];
+        *accept++ = ws_base64[(v >> 12) & 63];
+        *accept++ = ws_base64[(v >> 6) & 63];
+        *accept++ = (i == 18) ? '=' : ws_base64[v & 63];
+    }
+
+    *accept = '\0';
+}
+
+size_t ws_frame_head(uint8_t *head, uint8_t opcode, size_t len) {
+    head[0] = 0x80 | opcode;
+
+    if (len < 126) {
+        head[1] = (uint8_t)len;
+
+        return 2;
+    }
+
+    if (len <= 0xffff) {
+        head[1] = 126;
+        head[2] = (uint8_t)(len >> 8);
+        head[3] = (uint8_t)len;
+
+        return 4;
+    }
+
+    head[1] = 127;
+
+    for (unsigned int i = 0; i < 8; i++) {
+        head[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+    }
+
+    return 10;
+}
+
+size_t ws_close_frame(uint8_t *frame, uint16_t code) {
+    size_t n = ws_frame_head(frame, WS_OP_CLOSE, 2);
+
+    frame[n] = (uint8_t)(code >> 8);
+    frame[n + 1] = (uint8_t)code;
+
+    return n + 2;
+}
+
+void ws_rx_init(struct ws_rx *rx) {
+    memset(rx, 0, sizeof(*rx));
+}
+
+// length of the head of the frame in rx, the first 2 bytes received
+static unsigned int ws_rx_head_size(const struct ws_rx *rx) {
+    unsigned int len7 = rx->head[1] & 0x7f;
+
+    return 2 + ((len7 == 126) ? 2 : (len7 == 127) ? 8 : 0) + ((rx->head[1] & 0x80) ? 4 : 0);
+}
+
+// checks the complete head in rx and starts its payload, the close code of an error or 0
+static uint16_t ws_rx_start(struct ws_rx *rx) {
+    unsigned int len7 = rx->head[1] & 0x7f;
+    uint64_t len = len7;
+
+    rx->fin = (rx->head[0] & 0x80) != 0;
+    rx->opcode = rx->head[0] & 0x0f;
+
+    // no extension was negotiated, a client always masks
+    if ((rx->head[0] & 0x70) || !(rx->head[1] & 0x80)) {
+        return WS_CLOSE_PROTOCOL;
+    }
+
+    if (len7 == 126) {
+        len = ((unsigned int)rx->head[2] << 8) | rx->head[3];
+    } else if (len7 == 127) {
+        len = 0;
+
+        for (unsigned int i = 0; i < 8; i++) {
+            len = (len << 8) | rx->head[2 + i];
+        }
+    }
+
+    if (rx->opcode & 0x8) {
+        if ((rx->opcode > WS_OP_PONG) || !rx->fin || (len > WS_CONTROL_MAX)) {
+            return WS_CLOSE_PROTOCOL;
+        }
+    } else if (rx->opcode == WS_OP_CONT) {
+        if (!rx->message) {
+            return WS_CLOSE_PROTOCOL;
+        }
+    } else if ((rx->opcode == WS_OP_TEXT) || (rx->opcode == WS_OP_BINARY)) {
+        // a new message in the middle of one
+        if (rx->message) {
+            return WS_CLOSE_PROTOCOL;
+        }
+
+        rx->message = rx->opcode;
+    } else {
+        return WS_CLOSE_PROTOCOL;
+    }
+
+    if (len > WS_FRAME_MAX) {
+        return WS_CLOSE_TOO_BIG;
+    }
+
+    rx->left = (uint32_t)len;
+    rx->offset = 0;
+    rx->control_len = 0;
+    rx->payload = true;
+
+    return 0;
+}
+
+// the payload of the frame is complete
+static void ws_rx_end(struct ws_rx *rx, ws_rx_fn fn, void *arg) {
+    if (rx->opcode & 0x8) {
+        fn(arg, rx->opcode, rx->control, rx->control_len, true);
+    } else if (rx->fin) {
+        rx->message = 0;
+    }
+
+    rx->head_len = 0;
+    rx->payload = false;
+}
+
+uint16_t ws_rx_input(struct ws_rx *rx, uint8_t *data, size_t len, ws_rx_fn fn, void *arg) {
+    while (len) {
+        if (!rx->payload) {
+            rx->head[rx->head_len++] = *data++;
+            len--;
+
+            if ((rx->head_len < 2) || (rx->head_len < ws_rx_head_size(rx))) {
+                continue;
+            }
+
+            uint16_t code = ws_rx_start(rx);
+
+            if (code) {
+                return code;
+            }
+
+            // an empty frame, the last of its message too
+            if (rx->left == 0) {
+                if (!(rx->opcode & 0x8) && rx->fin) {
+                    fn(arg, rx->message, data, 0, true);
+                }
+
+                ws_rx_end(rx, fn, arg);
+            }
+
+            continue;
+        }
+
+        const uint8_t *mask = &rx->head[rx->head_len - 4];
+        size_t n = (len < rx->left) ? len : rx->left;
+
+        for (size_t i = 0; i < n; i++) {
+            data[i] ^= mask[(rx->offset + i) & 3];
+        }
+
+        rx->offset += n;
+        rx->left -= n;
+
+        if (rx->opcode & 0x8) {
+            memcpy(rx->control + rx->control_len, data, n);
+            rx->control_len += n;
+        } else {
+            fn(arg, rx->message, data, n, rx->fin && (rx->left == 0));
+        }
+
+        data += n;
+        len -= n;
+
+        if (rx->left == 0) {
+            ws_rx_end(rx, fn, arg);
+        }
+    }
+
+    return 0;
+}
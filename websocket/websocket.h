@@ -0,0 +1,79 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _WEBSOCKET_H_
+#define _WEBSOCKET_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// RFC 6455 framing shared by the WebSocket upgrades of the W5100S httpServer and of lwIP's
+// httpd: the Sec-WebSocket-Accept of the handshake, the head of the frames the server sends
+// and a parser of the frames it receives. No allocation and no SDK, so the host builds it too.
+
+#define WS_OP_CONT 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xa
+
+// close codes of a CLOSE frame
+#define WS_CLOSE_NORMAL 1000
+#define WS_CLOSE_PROTOCOL 1002
+#define WS_CLOSE_TOO_BIG 1009
+
+// Sec-WebSocket-Accept, base64 of a SHA-1, without its terminator
+#define WS_ACCEPT_LEN 28
+
+// longest head of a server frame: 2 bytes, 8 of length, no mask
+#define WS_HEAD_MAX 10
+
+// payload of a control frame, whole in ws_rx
+#define WS_CONTROL_MAX 125
+
+// largest data frame taken, the server pushes small messages and only gets small ones
+#ifndef WS_FRAME_MAX
+#define WS_FRAME_MAX 0xffff
+#endif
+
+// Sec-WebSocket-Accept of the Sec-WebSocket-Key key, key_len bytes of it without the spaces
+// around, into accept[WS_ACCEPT_LEN + 1]
+void ws_accept_key(const char *key, size_t key_len, char *accept);
+
+// Head of an unmasked server frame of len bytes, FIN set, into head[WS_HEAD_MAX]. Returns
+// its length: 2 up to 125 bytes, 4 up to 65535, 10 above
+size_t ws_frame_head(uint8_t *head, uint8_t opcode, size_t len);
+
+// A CLOSE frame with the code, into frame[4], returns its length
+size_t ws_close_frame(uint8_t *frame, uint16_t code);
+
+// Payload of the frames from the client, unmasked. Data frames come in pieces as the bytes
+// arrive, the opcode of their message (TEXT or BINARY, not CONT) and last on the last piece
+// of the message. Control frames come whole, once.
+typedef void (*ws_rx_fn)(void *arg, uint8_t opcode, const uint8_t *data, size_t len, bool last);
+
+struct ws_rx {
+    uint8_t head[14];
+    uint8_t head_len;     // received of head
+    bool payload;         // head complete, its payload is being received
+    uint8_t opcode;       // of the frame
+    uint8_t message;      // opcode of the data message the frame takes part in, 0 for none
+    bool fin;
+    uint32_t left;        // payload of the frame still to come
+    uint32_t offset;      // payload of the frame received, for the mask
+    uint8_t control[WS_CONTROL_MAX];
+    uint8_t control_len;
+};
+
+void ws_rx_init(struct ws_rx *rx);
+
+// Parses len bytes of the client and unmasks the payload in place, calling fn for it.
+// Returns 0, or the close code of a protocol error, after which the connection is to be
+// closed: a frame not masked, a control frame fragmented or longer than WS_CONTROL_MAX, a
+// data frame longer than WS_FRAME_MAX, a CONT without a message or a message without CONT
+uint16_t ws_rx_input(struct ws_rx *rx, uint8_t *data, size_t len, ws_rx_fn fn, void *arg);
+
+#endif